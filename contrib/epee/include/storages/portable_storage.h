@@ -81,6 +81,7 @@ namespace epee
       //-------------------------------------------------------------------------------
       bool		store_to_binary(binarybuffer& target);
       bool		load_from_binary(const binarybuffer& target);
+      bool		load_from_binary(const void* data, size_t size);
       template<class trace_policy>
       bool		  dump_as_xml(std::string& targetObj, const std::string& root_name = "");
       bool		  dump_as_json(std::string& targetObj, size_t indent = 0, bool insert_newlines = true);
@@ -146,15 +147,20 @@ namespace epee
     }
     inline
     bool portable_storage::load_from_binary(const binarybuffer& source)
+    {
+      return load_from_binary(source.data(), source.size());
+    }
+    inline
+    bool portable_storage::load_from_binary(const void* data, size_t size)
     {
       m_root.m_entries.clear();
-      if(source.size() < sizeof(storage_block_header))
+      if(size < sizeof(storage_block_header))
       {
-        LOG_WARNING("portable_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)="
+        LOG_WARNING("portable_storage: wrong binary format, packet size = " << size << " less than expected sizeof(storage_block_header)="
             << sizeof(storage_block_header), LOG_LEVEL_2)
         return false;
       }
-      storage_block_header* pbuff = (storage_block_header*)source.data();
+      const storage_block_header* pbuff = (const storage_block_header*)data;
       if(pbuff->m_signature_a != PORTABLE_STORAGE_SIGNATUREA || 
         pbuff->m_signature_b != PORTABLE_STORAGE_SIGNATUREB 
         )
@@ -168,7 +174,7 @@ namespace epee
         return false;
       }
       TRY_ENTRY();
-      throwable_buffer_reader buf_reader(source.data()+sizeof(storage_block_header), source.size()-sizeof(storage_block_header));
+      throwable_buffer_reader buf_reader((const char*)data+sizeof(storage_block_header), size-sizeof(storage_block_header));
       buf_reader.read(m_root);
       return true;//TODO:
       CATCH_ENTRY("portable_storage::load_from_binary", false);
@@ -22,6 +22,8 @@
 #include <system_error>
 #include <vector>
 
+#include <boost/optional.hpp>
+
 #include "crypto/crypto.h"
 #include "cryptonote_core/cryptonote_basic.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
@@ -52,6 +54,9 @@ struct BlockCompleteEntry {
   crypto::hash blockHash;
   CryptoNote::blobdata block;
   std::list<CryptoNote::blobdata> txs;
+  // In-process nodes hand the block and its transactions over as objects, blobs are left empty then
+  boost::optional<CryptoNote::Block> parsedBlock;
+  std::list<CryptoNote::Transaction> parsedTxs;
 };
 
 class INode {
@@ -76,7 +81,13 @@ public:
   virtual void getRandomOutsByAmounts(std::vector<uint64_t>&& amounts, uint64_t outsCount, std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result, const Callback& callback) = 0;
   virtual void getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks, uint64_t& startHeight, const Callback& callback) = 0;
   virtual void getTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices, const Callback& callback) = 0;
+  // Indices of all transactions in one request, outsGlobalIndices get them in the order of transactionHashes
+  virtual void getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices, const Callback& callback) = 0;
   virtual void queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) = 0;
+  // Same as queryBlocks, but the node scans blocks with the tracking keys and returns only transactions with outputs to
+  // the tracked addresses, ones spending knownKeyImages and ones referencing outputs to the addresses found by the same query
+  virtual void queryBlocksFiltered(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::vector<TrackingKey>&& trackingKeys,
+    std::vector<crypto::key_image>&& knownKeyImages, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) = 0;
   virtual void getPoolSymmetricDifference(std::vector<crypto::hash>&& known_pool_tx_ids, crypto::hash known_block_id, bool& is_bc_actual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, const Callback& callback) = 0;
 };
 
@@ -19,6 +19,7 @@
 
 #include <array>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace CryptoNote {
@@ -167,6 +168,8 @@ public:
 
   // signing
   virtual void signInputKey(size_t input, const TransactionTypes::InputKeyInfo& info, const TransactionTypes::KeyPair& ephKeys) = 0;
+  // signs key inputs from 0 to inputs.size() - 1 in one call
+  virtual void signInputKeys(const std::vector<std::pair<TransactionTypes::InputKeyInfo, TransactionTypes::KeyPair>>& inputs) = 0;
   virtual void signInputMultisignature(size_t input, const PublicKey& sourceTransactionKey, size_t outputIndex, const AccountKeys& accountKeys) = 0;
 };
 
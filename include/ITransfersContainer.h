@@ -18,6 +18,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <limits>
 #include <vector>
 #include "crypto/hash.h"
@@ -100,6 +101,19 @@ public:
   virtual std::vector<TransactionOutputInformation> getTransactionOutputs(const Hash& transactionHash, uint32_t flags = IncludeDefault) = 0;
   virtual void getUnconfirmedTransactions(std::vector<crypto::hash>& transactions) = 0;
   virtual std::vector<TransactionSpentOutputInformation> getSpentOutputs() = 0;
+  // Visits transfers of transactions with block height in [firstHeight, lastHeight] in blockchain order until visitor
+  // returns false. Unspent transfers are filtered by flags, spent ones by output type only and only if includeSpent
+  // is set. Visitor is called under the container lock and must not call the container.
+  virtual void getTransfersByHeight(uint64_t firstHeight, uint64_t lastHeight, uint32_t flags, bool includeSpent,
+    const std::function<bool(const TransactionOutputInformation&, uint64_t blockHeight, bool spent)>& visitor) = 0;
+
+  // Appends outputs matching flags worth at least neededMoney to transfers and returns their sum, which is less if the
+  // container hasn't enough. The smallest amount covering what is left is taken, if there is none the largest amounts
+  // are taken until there is. Outputs not above dustThreshold are used only after the others, except for one taken
+  // first if addDust is set. Outputs of the same amount are picked at random, skip rejects outputs already in use.
+  virtual uint64_t selectOutputs(uint64_t neededMoney, uint64_t dustThreshold, bool addDust,
+    const std::function<bool(const TransactionOutputInformation&)>& skip, std::vector<TransactionOutputInformation>& transfers,
+    uint32_t flags = IncludeDefault) = 0;
 };
 
 }
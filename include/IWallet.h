@@ -37,6 +37,14 @@ struct Transfer {
   int64_t amount;
 };
 
+struct TransactionParameters {
+  std::vector<Transfer> transfers;
+  uint64_t fee;
+  std::string extra;
+  uint64_t mixIn;
+  uint64_t unlockTimestamp;
+};
+
 const TransactionId INVALID_TRANSACTION_ID    = std::numeric_limits<TransactionId>::max();
 const TransferId INVALID_TRANSFER_ID          = std::numeric_limits<TransferId>::max();
 const uint64_t UNCONFIRMED_TRANSACTION_HEIGHT = std::numeric_limits<uint64_t>::max();
@@ -65,6 +73,21 @@ struct TransactionInfo {
   TransactionState state;
 };
 
+struct IncomingTransfersFilter {
+  uint64_t firstHeight;
+  uint64_t lastHeight;
+  bool     includeUnspent;
+  bool     includeSpent;
+  uint64_t minAmount;
+};
+
+struct IncomingTransfer {
+  TransactionHash transactionHash;
+  uint64_t        amount;
+  uint64_t        blockHeight;
+  bool            spent;
+};
+
 typedef std::array<uint8_t, 32> WalletPublicKey;
 typedef std::array<uint8_t, 32> WalletSecretKey;
 
@@ -88,6 +111,19 @@ public:
   virtual void externalTransactionCreated(TransactionId transactionId) {}
   virtual void sendTransactionCompleted(TransactionId transactionId, std::error_code result) {}
   virtual void transactionUpdated(TransactionId transactionId) {}
+  // Transaction events of a processed block range, each transaction is reported once: created ones only as created,
+  // before the updated ones. By default they are passed to the methods above one by one.
+  virtual void externalTransactionsCreated(const std::vector<TransactionId>& transactionIds) {
+    for (TransactionId transactionId : transactionIds) {
+      externalTransactionCreated(transactionId);
+    }
+  }
+
+  virtual void transactionsUpdated(const std::vector<TransactionId>& transactionIds) {
+    for (TransactionId transactionId : transactionIds) {
+      transactionUpdated(transactionId);
+    }
+  }
 };
 
 class IWallet {
@@ -118,9 +154,17 @@ public:
   
   virtual bool getTransaction(TransactionId transactionId, TransactionInfo& transaction) = 0;
   virtual bool getTransfer(TransferId transferId, Transfer& transfer) = 0;
+  // a page of transactions with block height in [firstHeight, lastHeight] ordered by height, pass
+  // UNCONFIRMED_TRANSACTION_HEIGHT as lastHeight to include unconfirmed ones
+  virtual std::vector<TransactionId> getTransactionsByHeight(uint64_t firstHeight, uint64_t lastHeight, size_t offset, size_t limit) = 0;
+  // a page of outputs received by the wallet which pass the filter, ordered by height
+  virtual std::vector<IncomingTransfer> getIncomingTransfers(const IncomingTransfersFilter& filter, size_t offset, size_t limit) = 0;
 
   virtual TransactionId sendTransaction(const Transfer& transfer, uint64_t fee, const std::string& extra = "", uint64_t mixIn = 0, uint64_t unlockTimestamp = 0) = 0;
   virtual TransactionId sendTransaction(const std::vector<Transfer>& transfers, uint64_t fee, const std::string& extra = "", uint64_t mixIn = 0, uint64_t unlockTimestamp = 0) = 0;
+  // Sends independent transactions at once: random outputs for all of them are requested together and they are signed
+  // in parallel. Each one completes separately, ids are returned in the order of parameters.
+  virtual std::vector<TransactionId> sendTransactions(const std::vector<TransactionParameters>& transactions) = 0;
   virtual std::error_code cancelTransaction(size_t transferId) = 0;
 
   virtual void getAccountKeys(WalletAccountKeys& keys) = 0;
@@ -0,0 +1,126 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <future>
+#include <memory>
+
+#include "INode.h"
+
+namespace CryptoNote {
+
+template <typename T>
+struct NodeResult {
+  std::error_code error;
+  T value;
+};
+
+struct QueriedBlocks {
+  uint64_t startHeight;
+  std::list<BlockCompleteEntry> newBlocks;
+};
+
+struct PoolDifference {
+  bool isLastKnownBlockActual;
+  std::vector<Transaction> newTxs;
+  std::vector<crypto::hash> deletedTxIds;
+};
+
+// INode requests returning futures instead of taking callbacks with output references. Outputs are owned by the
+// shared state of each request, so several requests can be started before waiting for any of them and a caller that
+// gives up on a future does not leave the node writing into a destroyed object.
+class NodeFutures {
+public:
+  explicit NodeFutures(INode& node) : m_node(node) {
+  }
+
+  std::future<std::error_code> relayTransaction(const Transaction& transaction) {
+    std::shared_ptr<std::promise<std::error_code>> promise = std::make_shared<std::promise<std::error_code>>();
+    std::future<std::error_code> future = promise->get_future();
+    m_node.relayTransaction(transaction, [promise](std::error_code ec) { promise->set_value(ec); });
+    return future;
+  }
+
+  std::future<NodeResult<std::vector<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>>> getRandomOutsByAmounts(
+    std::vector<uint64_t>&& amounts, uint64_t outsCount) {
+    return start<std::vector<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>>(
+      [&](std::vector<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& outs, const INode::Callback& callback) {
+      m_node.getRandomOutsByAmounts(std::move(amounts), outsCount, outs, callback);
+    });
+  }
+
+  std::future<NodeResult<std::vector<uint64_t>>> getTransactionOutsGlobalIndices(const crypto::hash& transactionHash) {
+    return start<std::vector<uint64_t>>([&](std::vector<uint64_t>& indices, const INode::Callback& callback) {
+      m_node.getTransactionOutsGlobalIndices(transactionHash, indices, callback);
+    });
+  }
+
+  std::future<NodeResult<std::vector<std::vector<uint64_t>>>> getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes) {
+    return start<std::vector<std::vector<uint64_t>>>([&](std::vector<std::vector<uint64_t>>& indices, const INode::Callback& callback) {
+      m_node.getTransactionsOutsGlobalIndices(std::move(transactionHashes), indices, callback);
+    });
+  }
+
+  std::future<NodeResult<QueriedBlocks>> queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp) {
+    return start<QueriedBlocks>([&](QueriedBlocks& blocks, const INode::Callback& callback) {
+      blocks.startHeight = 0;
+      m_node.queryBlocks(std::move(knownBlockIds), timestamp, blocks.newBlocks, blocks.startHeight, callback);
+    });
+  }
+
+  std::future<NodeResult<QueriedBlocks>> queryBlocksFiltered(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp,
+    std::vector<TrackingKey>&& trackingKeys, std::vector<crypto::key_image>&& knownKeyImages) {
+    return start<QueriedBlocks>([&](QueriedBlocks& blocks, const INode::Callback& callback) {
+      blocks.startHeight = 0;
+      m_node.queryBlocksFiltered(std::move(knownBlockIds), timestamp, std::move(trackingKeys), std::move(knownKeyImages),
+        blocks.newBlocks, blocks.startHeight, callback);
+    });
+  }
+
+  std::future<NodeResult<PoolDifference>> getPoolSymmetricDifference(std::vector<crypto::hash>&& knownPoolTxIds, const crypto::hash& knownBlockId) {
+    return start<PoolDifference>([&](PoolDifference& difference, const INode::Callback& callback) {
+      difference.isLastKnownBlockActual = false;
+      m_node.getPoolSymmetricDifference(std::move(knownPoolTxIds), knownBlockId, difference.isLastKnownBlockActual,
+        difference.newTxs, difference.deletedTxIds, callback);
+    });
+  }
+
+private:
+  template <typename T>
+  struct Request {
+    std::promise<NodeResult<T>> promise;
+    NodeResult<T> result;
+  };
+
+  // Node may call back before the request function returns, the future is taken out of the state beforehand
+  template <typename T, typename RequestFunction>
+  std::future<NodeResult<T>> start(RequestFunction requestFunction) {
+    std::shared_ptr<Request<T>> request = std::make_shared<Request<T>>();
+    std::future<NodeResult<T>> future = request->promise.get_future();
+    requestFunction(request->result.value, [request](std::error_code ec) {
+      request->result.error = ec;
+      request->promise.set_value(std::move(request->result));
+    });
+
+    return future;
+  }
+
+  INode& m_node;
+};
+
+}
@@ -0,0 +1,576 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Deflate.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include <boost/crc.hpp>
+
+namespace Common {
+
+namespace {
+
+const size_t WINDOW_SIZE = 32768;
+const size_t MIN_MATCH = 3;
+const size_t MAX_MATCH = 258;
+const size_t HASH_BITS = 14;
+// candidates tried per position, longer chains gain little on JSON
+const size_t MAX_CHAIN = 32;
+// input is encoded as a block once this much is pending
+const size_t BLOCK_SIZE = 64 * 1024;
+const size_t MAX_STORED_SIZE = 65535;
+const uint32_t NO_POSITION = std::numeric_limits<uint32_t>::max();
+const uint32_t ADLER_MODULO = 65521;
+
+const unsigned END_OF_BLOCK = 256;
+const size_t LITERAL_SYMBOLS = 286;
+const size_t DISTANCE_SYMBOLS = 30;
+const size_t CODE_LENGTH_SYMBOLS = 19;
+const unsigned MAX_CODE_LENGTH = 15;
+const unsigned MAX_CODE_LENGTH_CODE_LENGTH = 7;
+const unsigned REPEAT_PREVIOUS = 16;
+const unsigned REPEAT_ZERO = 17;
+const unsigned REPEAT_ZERO_LONG = 18;
+
+const uint8_t CODE_LENGTH_ORDER[CODE_LENGTH_SYMBOLS] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+const uint16_t LENGTH_BASE[] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+const uint8_t LENGTH_EXTRA[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+const uint16_t DISTANCE_BASE[] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577
+};
+
+const uint8_t DISTANCE_EXTRA[] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Codes are kept bit reversed, as they are packed starting from the most significant bit
+struct HuffmanCode {
+  std::vector<uint8_t> lengths;
+  std::vector<uint16_t> codes;
+};
+
+// Code length symbol with its repeat count in extra bits
+struct CodeLengthRun {
+  uint8_t symbol;
+  uint8_t extra;
+};
+
+// index of the last table entry not greater than value
+template <size_t N>
+size_t findCode(const uint16_t (&base)[N], size_t value) {
+  return std::upper_bound(base, base + N, value) - base - 1;
+}
+
+size_t hash(const char* data) {
+  uint32_t sequence = static_cast<uint8_t>(data[0]) | static_cast<uint8_t>(data[1]) << 8 | static_cast<uint8_t>(data[2]) << 16;
+  return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+unsigned extraBits(unsigned codeLengthSymbol) {
+  return codeLengthSymbol == REPEAT_PREVIOUS ? 2 : codeLengthSymbol == REPEAT_ZERO ? 3 : codeLengthSymbol == REPEAT_ZERO_LONG ? 7 : 0;
+}
+
+// Canonical codes for the lengths, as decoders rebuild them
+void assignCodes(HuffmanCode& code) {
+  uint16_t counts[MAX_CODE_LENGTH + 1] = { 0 };
+  for (uint8_t length : code.lengths) {
+    ++counts[length];
+  }
+
+  counts[0] = 0;
+  uint16_t nextCodes[MAX_CODE_LENGTH + 1] = { 0 };
+  uint16_t value = 0;
+  for (unsigned length = 1; length <= MAX_CODE_LENGTH; ++length) {
+    value = static_cast<uint16_t>((value + counts[length - 1]) << 1);
+    nextCodes[length] = value;
+  }
+
+  code.codes.assign(code.lengths.size(), 0);
+  for (size_t symbol = 0; symbol < code.lengths.size(); ++symbol) {
+    unsigned length = code.lengths[symbol];
+    if (length != 0) {
+      uint16_t canonical = nextCodes[length]++;
+      uint16_t reversed = 0;
+      for (unsigned i = 0; i < length; ++i) {
+        reversed = static_cast<uint16_t>(reversed << 1 | (canonical >> i & 1));
+      }
+
+      code.codes[symbol] = reversed;
+    }
+  }
+}
+
+// Huffman tree is built again from halved frequencies until it fits the length limit, which rarely happens for a block
+// sized input. Decoders reject codes of a single symbol, so at least two symbols get lengths.
+HuffmanCode buildCode(const std::vector<uint32_t>& frequencies, unsigned maxLength) {
+  std::vector<uint32_t> weights(frequencies);
+  size_t used = std::count_if(weights.begin(), weights.end(), [](uint32_t weight) { return weight != 0; });
+  for (size_t symbol = 0; used < 2; ++symbol) {
+    if (weights[symbol] == 0) {
+      weights[symbol] = 1;
+      ++used;
+    }
+  }
+
+  size_t symbolCount = weights.size();
+  HuffmanCode code;
+  for (;;) {
+    typedef std::pair<uint64_t, size_t> Node;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+    std::vector<size_t> parents(2 * symbolCount, 0);
+    for (size_t symbol = 0; symbol < symbolCount; ++symbol) {
+      if (weights[symbol] != 0) {
+        queue.push(Node(weights[symbol], symbol));
+      }
+    }
+
+    size_t nextNode = symbolCount;
+    while (queue.size() > 1) {
+      Node first = queue.top();
+      queue.pop();
+      Node second = queue.top();
+      queue.pop();
+      parents[first.second] = nextNode;
+      parents[second.second] = nextNode;
+      queue.push(Node(first.first + second.first, nextNode));
+      ++nextNode;
+    }
+
+    // parents are created after their children, so depths are known going down from the root
+    std::vector<unsigned> depths(nextNode, 0);
+    for (size_t node = nextNode - 1; node-- > 0;) {
+      if (node >= symbolCount || weights[node] != 0) {
+        depths[node] = depths[parents[node]] + 1;
+      }
+    }
+
+    code.lengths.assign(symbolCount, 0);
+    unsigned longest = 0;
+    for (size_t symbol = 0; symbol < symbolCount; ++symbol) {
+      if (weights[symbol] != 0) {
+        code.lengths[symbol] = static_cast<uint8_t>(depths[symbol]);
+        longest = std::max(longest, depths[symbol]);
+      }
+    }
+
+    if (longest <= maxLength) {
+      break;
+    }
+
+    for (uint32_t& weight : weights) {
+      if (weight != 0) {
+        weight = weight >> 1 | 1;
+      }
+    }
+  }
+
+  assignCodes(code);
+  return code;
+}
+
+HuffmanCode makeFixedLiteralCode() {
+  HuffmanCode code;
+  code.lengths.resize(288);
+  for (size_t symbol = 0; symbol < code.lengths.size(); ++symbol) {
+    code.lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+  }
+
+  assignCodes(code);
+  return code;
+}
+
+HuffmanCode makeFixedDistanceCode() {
+  HuffmanCode code;
+  code.lengths.assign(DISTANCE_SYMBOLS, 5);
+  assignCodes(code);
+  return code;
+}
+
+const HuffmanCode FIXED_LITERAL_CODE = makeFixedLiteralCode();
+const HuffmanCode FIXED_DISTANCE_CODE = makeFixedDistanceCode();
+
+// Run length coding of the lengths of both codes sent in a dynamic block header
+std::vector<CodeLengthRun> encodeLengths(const std::vector<uint8_t>& lengths) {
+  std::vector<CodeLengthRun> runs;
+  for (size_t i = 0; i < lengths.size();) {
+    uint8_t value = lengths[i];
+    size_t count = 1;
+    while (i + count < lengths.size() && lengths[i + count] == value) {
+      ++count;
+    }
+
+    i += count;
+    if (value == 0) {
+      while (count >= 11) {
+        size_t repeat = std::min<size_t>(count, 138);
+        runs.push_back({ static_cast<uint8_t>(REPEAT_ZERO_LONG), static_cast<uint8_t>(repeat - 11) });
+        count -= repeat;
+      }
+
+      if (count >= 3) {
+        runs.push_back({ static_cast<uint8_t>(REPEAT_ZERO), static_cast<uint8_t>(count - 3) });
+        count = 0;
+      }
+    } else {
+      runs.push_back({ value, 0 });
+      --count;
+      while (count >= 3) {
+        size_t repeat = std::min<size_t>(count, 6);
+        runs.push_back({ static_cast<uint8_t>(REPEAT_PREVIOUS), static_cast<uint8_t>(repeat - 3) });
+        count -= repeat;
+      }
+    }
+
+    for (; count > 0; --count) {
+      runs.push_back({ value, 0 });
+    }
+  }
+
+  return runs;
+}
+
+// bits of the block body coded with the given codes
+uint64_t bodySize(const std::vector<uint32_t>& literalFrequencies, const std::vector<uint32_t>& distanceFrequencies,
+  const HuffmanCode& literalCode, const HuffmanCode& distanceCode) {
+  uint64_t size = 0;
+  for (size_t symbol = 0; symbol < LITERAL_SYMBOLS; ++symbol) {
+    size += static_cast<uint64_t>(literalFrequencies[symbol]) * (literalCode.lengths[symbol] + (symbol > END_OF_BLOCK ? LENGTH_EXTRA[symbol - 257] : 0));
+  }
+
+  for (size_t symbol = 0; symbol < DISTANCE_SYMBOLS; ++symbol) {
+    size += static_cast<uint64_t>(distanceFrequencies[symbol]) * (distanceCode.lengths[symbol] + DISTANCE_EXTRA[symbol]);
+  }
+
+  return size;
+}
+
+}
+
+DeflateEncoder::DeflateEncoder(Format format) : m_format(format), m_headerWritten(false), m_dataStart(0), m_position(0),
+  m_head(static_cast<size_t>(1) << HASH_BITS, NO_POSITION), m_previous(WINDOW_SIZE, NO_POSITION), m_bitBuffer(0),
+  m_bitCount(0), m_crcRemainder(boost::crc_32_type().get_interim_remainder()), m_adlerA(1), m_adlerB(0), m_totalSize(0) {
+}
+
+void DeflateEncoder::write(const char* data, size_t size, std::string& out) {
+  writeHeader(out);
+  if (m_format == GZIP) {
+    boost::crc_32_type crc;
+    crc.reset(m_crcRemainder);
+    crc.process_bytes(data, size);
+    m_crcRemainder = crc.get_interim_remainder();
+  } else {
+    // sums are reduced once per 5552 bytes, the largest run that can't overflow them
+    for (size_t offset = 0; offset < size; offset += 5552) {
+      size_t end = std::min(size, offset + 5552);
+      for (size_t i = offset; i < end; ++i) {
+        m_adlerA += static_cast<uint8_t>(data[i]);
+        m_adlerB += m_adlerA;
+      }
+
+      m_adlerA %= ADLER_MODULO;
+      m_adlerB %= ADLER_MODULO;
+    }
+  }
+
+  m_totalSize += static_cast<uint32_t>(size);
+  // large input is taken by blocks, so only the window and one block are kept
+  while (size > 0) {
+    size_t part = std::min(size, BLOCK_SIZE);
+    m_data.append(data, part);
+    data += part;
+    size -= part;
+    if (m_data.size() - m_position >= BLOCK_SIZE) {
+      encode(false, out);
+    }
+  }
+}
+
+void DeflateEncoder::finish(std::string& out) {
+  writeHeader(out);
+  encode(true, out);
+  flushBits(out);
+
+  if (m_format == GZIP) {
+    boost::crc_32_type crc;
+    crc.reset(m_crcRemainder);
+    uint32_t checksum = crc.checksum();
+    for (unsigned i = 0; i < 4; ++i) {
+      out.push_back(static_cast<char>(checksum >> (8 * i)));
+    }
+
+    for (unsigned i = 0; i < 4; ++i) {
+      out.push_back(static_cast<char>(m_totalSize >> (8 * i)));
+    }
+  } else {
+    uint32_t adler = m_adlerB << 16 | m_adlerA;
+    for (unsigned i = 4; i > 0; --i) {
+      out.push_back(static_cast<char>(adler >> (8 * (i - 1))));
+    }
+  }
+}
+
+void DeflateEncoder::writeHeader(std::string& out) {
+  if (m_headerWritten) {
+    return;
+  }
+
+  m_headerWritten = true;
+  if (m_format == GZIP) {
+    // no file name and time, unknown operating system
+    static const char GZIP_HEADER[] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+    out.append(GZIP_HEADER, sizeof(GZIP_HEADER));
+  } else {
+    // 32 KB window, no dictionary, check bits make the pair divisible by 31
+    out.push_back('\x78');
+    out.push_back('\x01');
+  }
+}
+
+// Non final block leaves the last MAX_MATCH bytes pending, so matches aren't cut at block boundaries
+void DeflateEncoder::encode(bool final, std::string& out) {
+  size_t blockStart = m_position;
+  size_t end = m_data.size();
+  size_t limit = final ? end : end - MAX_MATCH;
+  m_tokens.clear();
+  while (m_position < limit) {
+    size_t distance = 0;
+    size_t length = findMatch(m_position, end, distance);
+    if (length >= MIN_MATCH) {
+      m_tokens.push_back(static_cast<uint32_t>(distance << 16 | length));
+      for (size_t i = 0; i < length; ++i) {
+        insertHash(m_position + i);
+      }
+
+      m_position += length;
+    } else {
+      m_tokens.push_back(static_cast<uint8_t>(m_data[m_position]));
+      insertHash(m_position);
+      ++m_position;
+    }
+  }
+
+  writeBlock(final, blockStart, out);
+
+  if (m_position > WINDOW_SIZE) {
+    size_t dropped = m_position - WINDOW_SIZE;
+    m_data.erase(0, dropped);
+    m_dataStart += static_cast<uint32_t>(dropped);
+    m_position = WINDOW_SIZE;
+  }
+}
+
+void DeflateEncoder::insertHash(size_t position) {
+  if (position + MIN_MATCH > m_data.size()) {
+    return;
+  }
+
+  uint32_t absolute = m_dataStart + static_cast<uint32_t>(position);
+  size_t slot = hash(m_data.data() + position);
+  m_previous[absolute % WINDOW_SIZE] = m_head[slot];
+  m_head[slot] = absolute;
+}
+
+// Returns the longest match length, chains may hold entries overwritten by newer positions, they are recognized by
+// not going back in the stream
+size_t DeflateEncoder::findMatch(size_t position, size_t end, size_t& distance) const {
+  if (position + MIN_MATCH > end) {
+    return 0;
+  }
+
+  uint32_t absolute = m_dataStart + static_cast<uint32_t>(position);
+  size_t maxLength = std::min(MAX_MATCH, end - position);
+  size_t bestLength = 0;
+  uint32_t candidate = m_head[hash(m_data.data() + position)];
+  for (size_t chain = 0; chain < MAX_CHAIN; ++chain) {
+    if (candidate == NO_POSITION || candidate < m_dataStart || candidate >= absolute || absolute - candidate > WINDOW_SIZE) {
+      break;
+    }
+
+    const char* match = m_data.data() + (candidate - m_dataStart);
+    const char* current = m_data.data() + position;
+    if (match[bestLength] == current[bestLength]) {
+      size_t length = 0;
+      while (length < maxLength && match[length] == current[length]) {
+        ++length;
+      }
+
+      if (length > bestLength) {
+        bestLength = length;
+        distance = absolute - candidate;
+        if (length == maxLength) {
+          break;
+        }
+      }
+    }
+
+    uint32_t previous = m_previous[candidate % WINDOW_SIZE];
+    if (previous != NO_POSITION && previous >= candidate) {
+      break;
+    }
+
+    candidate = previous;
+  }
+
+  return bestLength;
+}
+
+void DeflateEncoder::putBits(uint32_t value, unsigned count, std::string& out) {
+  m_bitBuffer |= value << m_bitCount;
+  m_bitCount += count;
+  while (m_bitCount >= 8) {
+    out.push_back(static_cast<char>(m_bitBuffer & 0xff));
+    m_bitBuffer >>= 8;
+    m_bitCount -= 8;
+  }
+}
+
+void DeflateEncoder::flushBits(std::string& out) {
+  if (m_bitCount > 0) {
+    out.push_back(static_cast<char>(m_bitBuffer & 0xff));
+    m_bitBuffer = 0;
+    m_bitCount = 0;
+  }
+}
+
+void DeflateEncoder::writeBlock(bool final, size_t blockStart, std::string& out) {
+  std::vector<uint32_t> literalFrequencies(LITERAL_SYMBOLS, 0);
+  std::vector<uint32_t> distanceFrequencies(DISTANCE_SYMBOLS, 0);
+  for (uint32_t token : m_tokens) {
+    uint32_t distance = token >> 16;
+    if (distance == 0) {
+      ++literalFrequencies[token];
+    } else {
+      ++literalFrequencies[257 + findCode(LENGTH_BASE, token & 0xffff)];
+      ++distanceFrequencies[findCode(DISTANCE_BASE, distance)];
+    }
+  }
+
+  ++literalFrequencies[END_OF_BLOCK];
+
+  HuffmanCode literalCode = buildCode(literalFrequencies, MAX_CODE_LENGTH);
+  HuffmanCode distanceCode = buildCode(distanceFrequencies, MAX_CODE_LENGTH);
+  size_t literalCount = LITERAL_SYMBOLS;
+  while (literalCount > 257 && literalCode.lengths[literalCount - 1] == 0) {
+    --literalCount;
+  }
+
+  size_t distanceCount = DISTANCE_SYMBOLS;
+  while (distanceCount > 1 && distanceCode.lengths[distanceCount - 1] == 0) {
+    --distanceCount;
+  }
+
+  std::vector<uint8_t> lengths(literalCode.lengths.begin(), literalCode.lengths.begin() + literalCount);
+  lengths.insert(lengths.end(), distanceCode.lengths.begin(), distanceCode.lengths.begin() + distanceCount);
+  std::vector<CodeLengthRun> runs = encodeLengths(lengths);
+  std::vector<uint32_t> runFrequencies(CODE_LENGTH_SYMBOLS, 0);
+  for (const CodeLengthRun& run : runs) {
+    ++runFrequencies[run.symbol];
+  }
+
+  HuffmanCode runCode = buildCode(runFrequencies, MAX_CODE_LENGTH_CODE_LENGTH);
+  size_t runCodeCount = CODE_LENGTH_SYMBOLS;
+  while (runCodeCount > 4 && runCode.lengths[CODE_LENGTH_ORDER[runCodeCount - 1]] == 0) {
+    --runCodeCount;
+  }
+
+  uint64_t dynamicSize = 3 + 5 + 5 + 4 + 3 * runCodeCount;
+  for (const CodeLengthRun& run : runs) {
+    dynamicSize += runCode.lengths[run.symbol] + extraBits(run.symbol);
+  }
+
+  dynamicSize += bodySize(literalFrequencies, distanceFrequencies, literalCode, distanceCode);
+  uint64_t fixedSize = 3 + bodySize(literalFrequencies, distanceFrequencies, FIXED_LITERAL_CODE, FIXED_DISTANCE_CODE);
+  size_t storedLength = m_position - blockStart;
+  uint64_t storedSize = (storedLength / MAX_STORED_SIZE + 1) * (3 + 7 + 32) + 8 * static_cast<uint64_t>(storedLength);
+  if (storedSize < dynamicSize && storedSize < fixedSize) {
+    writeStoredBlocks(final, blockStart, out);
+    return;
+  }
+
+  putBits(final ? 1 : 0, 1, out);
+  const HuffmanCode* literals = &FIXED_LITERAL_CODE;
+  const HuffmanCode* distances = &FIXED_DISTANCE_CODE;
+  if (dynamicSize < fixedSize) {
+    putBits(2, 2, out);
+    putBits(static_cast<uint32_t>(literalCount - 257), 5, out);
+    putBits(static_cast<uint32_t>(distanceCount - 1), 5, out);
+    putBits(static_cast<uint32_t>(runCodeCount - 4), 4, out);
+    for (size_t i = 0; i < runCodeCount; ++i) {
+      putBits(runCode.lengths[CODE_LENGTH_ORDER[i]], 3, out);
+    }
+
+    for (const CodeLengthRun& run : runs) {
+      putBits(runCode.codes[run.symbol], runCode.lengths[run.symbol], out);
+      putBits(run.extra, extraBits(run.symbol), out);
+    }
+
+    literals = &literalCode;
+    distances = &distanceCode;
+  } else {
+    putBits(1, 2, out);
+  }
+
+  for (uint32_t token : m_tokens) {
+    uint32_t distance = token >> 16;
+    if (distance == 0) {
+      putBits(literals->codes[token], literals->lengths[token], out);
+      continue;
+    }
+
+    uint32_t length = token & 0xffff;
+    size_t lengthCode = findCode(LENGTH_BASE, length);
+    putBits(literals->codes[257 + lengthCode], literals->lengths[257 + lengthCode], out);
+    putBits(length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode], out);
+    size_t distanceCode = findCode(DISTANCE_BASE, distance);
+    putBits(distances->codes[distanceCode], distances->lengths[distanceCode], out);
+    putBits(distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode], out);
+  }
+
+  putBits(literals->codes[END_OF_BLOCK], literals->lengths[END_OF_BLOCK], out);
+}
+
+// Stored block holds at most 64 KB, so the input may take several of them
+void DeflateEncoder::writeStoredBlocks(bool final, size_t blockStart, std::string& out) {
+  size_t offset = blockStart;
+  do {
+    size_t length = std::min(MAX_STORED_SIZE, m_position - offset);
+    bool last = offset + length == m_position;
+    putBits(final && last ? 1 : 0, 1, out);
+    putBits(0, 2, out);
+    flushBits(out);
+    out.push_back(static_cast<char>(length & 0xff));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(~length & 0xff));
+    out.push_back(static_cast<char>((~length >> 8) & 0xff));
+    out.append(m_data, offset, length);
+    offset += length;
+  } while (offset < m_position);
+}
+
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Common {
+
+// Streaming DEFLATE encoder for gzip and zlib (HTTP "deflate") formats. Matches are found by hash chains over a 32 KB
+// window, every block of about 64 KB is coded with its own Huffman tables, the fixed ones or stored as is, whichever
+// is the shortest. Positions are 32 bit, so a stream is limited to 4 GB.
+class DeflateEncoder {
+public:
+  enum Format {
+    GZIP,
+    ZLIB
+  };
+
+  explicit DeflateEncoder(Format format);
+
+  // Appends output for the data written so far to out, the tail of the input is held until there is enough of it
+  void write(const char* data, size_t size, std::string& out);
+  // Appends the rest of the output and the format trailer
+  void finish(std::string& out);
+
+private:
+  void writeHeader(std::string& out);
+  void encode(bool final, std::string& out);
+  void insertHash(size_t position);
+  size_t findMatch(size_t position, size_t limit, size_t& distance) const;
+  void putBits(uint32_t value, unsigned count, std::string& out);
+  void flushBits(std::string& out);
+  void writeBlock(bool final, size_t blockStart, std::string& out);
+  void writeStoredBlocks(bool final, size_t blockStart, std::string& out);
+
+  Format m_format;
+  bool m_headerWritten;
+  // window history followed by input not encoded yet
+  std::string m_data;
+  uint32_t m_dataStart;
+  size_t m_position;
+  // literals and matches of the current block, distance in the upper half and literal or length in the lower one
+  std::vector<uint32_t> m_tokens;
+  std::vector<uint32_t> m_head;
+  std::vector<uint32_t> m_previous;
+  uint32_t m_bitBuffer;
+  unsigned m_bitCount;
+  uint32_t m_crcRemainder;
+  uint32_t m_adlerA;
+  uint32_t m_adlerB;
+  uint32_t m_totalSize;
+};
+
+}
@@ -16,11 +16,94 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "JsonValue.h"
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 
 namespace Common {
 
+JsonValue::Object::iterator JsonValue::Object::find(const Key& key) {
+  iterator it = lowerBound(key);
+  return it != items.end() && it->first == key ? it : items.end();
+}
+
+JsonValue::Object::const_iterator JsonValue::Object::find(const Key& key) const {
+  const_iterator it = lowerBound(key);
+  return it != items.end() && it->first == key ? it : items.end();
+}
+
+std::size_t JsonValue::Object::count(const Key& key) const {
+  return find(key) != items.end() ? 1 : 0;
+}
+
+JsonValue& JsonValue::Object::at(const Key& key) {
+  iterator it = find(key);
+  if (it == items.end()) {
+    throw std::out_of_range("JsonValue object has no member " + key);
+  }
+
+  return it->second;
+}
+
+const JsonValue& JsonValue::Object::at(const Key& key) const {
+  const_iterator it = find(key);
+  if (it == items.end()) {
+    throw std::out_of_range("JsonValue object has no member " + key);
+  }
+
+  return it->second;
+}
+
+JsonValue& JsonValue::Object::operator[](const Key& key) {
+  return emplace(key, JsonValue()).first->second;
+}
+
+std::pair<JsonValue::Object::iterator, bool> JsonValue::Object::emplace(const Key& key, const JsonValue& value) {
+  iterator it = lowerBound(key);
+  if (it != items.end() && it->first == key) {
+    return std::make_pair(it, false);
+  }
+
+  return std::make_pair(items.emplace(it, key, value), true);
+}
+
+std::pair<JsonValue::Object::iterator, bool> JsonValue::Object::emplace(const Key& key, JsonValue&& value) {
+  iterator it = lowerBound(key);
+  if (it != items.end() && it->first == key) {
+    return std::make_pair(it, false);
+  }
+
+  return std::make_pair(items.emplace(it, key, std::move(value)), true);
+}
+
+std::size_t JsonValue::Object::erase(const Key& key) {
+  iterator it = find(key);
+  if (it == items.end()) {
+    return 0;
+  }
+
+  items.erase(it);
+  return 1;
+}
+
+// members usually come in key order, written by JsonValue itself, so appending is checked first
+JsonValue::Object::iterator JsonValue::Object::lowerBound(const Key& key) {
+  if (items.empty() || items.back().first < key) {
+    return items.end();
+  }
+
+  return std::lower_bound(items.begin(), items.end(), key, [](const value_type& item, const Key& key) { return item.first < key; });
+}
+
+JsonValue::Object::const_iterator JsonValue::Object::lowerBound(const Key& key) const {
+  if (items.empty() || items.back().first < key) {
+    return items.end();
+  }
+
+  return std::lower_bound(items.begin(), items.end(), key, [](const value_type& item, const Key& key) { return item.first < key; });
+}
+
 JsonValue::JsonValue() : type(NIL) {
 }
 
@@ -19,8 +19,8 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace Common {
@@ -33,10 +33,45 @@ public:
   typedef bool Bool;
   typedef int64_t Integer;
   typedef std::nullptr_t Nil;
-  typedef std::map<Key, JsonValue> Object;
+  class Object;
   typedef double Real;
   typedef std::string String;
 
+  // Members sorted by key in one vector, an object takes a single allocation and members are iterated in the
+  // same order as in std::map. Inserting or erasing a member invalidates references to other members.
+  class Object {
+  public:
+    typedef std::pair<Key, JsonValue> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    iterator begin() { return items.begin(); }
+    const_iterator begin() const { return items.begin(); }
+    iterator end() { return items.end(); }
+    const_iterator end() const { return items.end(); }
+    bool empty() const { return items.empty(); }
+    std::size_t size() const { return items.size(); }
+    void reserve(std::size_t size) { items.reserve(size); }
+    void clear() { items.clear(); }
+    void swap(Object& other) { items.swap(other.items); }
+
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    std::size_t count(const Key& key) const;
+    JsonValue& at(const Key& key);
+    const JsonValue& at(const Key& key) const;
+    JsonValue& operator[](const Key& key);
+    std::pair<iterator, bool> emplace(const Key& key, const JsonValue& value);
+    std::pair<iterator, bool> emplace(const Key& key, JsonValue&& value);
+    std::size_t erase(const Key& key);
+
+  private:
+    std::vector<value_type> items;
+
+    iterator lowerBound(const Key& key);
+    const_iterator lowerBound(const Key& key) const;
+  };
+
   enum Type {
     ARRAY,
     BOOL,
@@ -0,0 +1,175 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Lz4.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace Common {
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+// format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+const size_t LAST_LITERALS = 5;
+const size_t MATCH_START_LIMIT = 12;
+const size_t MAX_DISTANCE = 65535;
+const size_t HASH_BITS = 12;
+
+uint32_t read32(const char* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof value);
+  return value;
+}
+
+size_t hash(uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+// length above the 15 kept in the token
+void writeLength(std::vector<char>& compressed, size_t length) {
+  while (length >= 255) {
+    compressed.push_back(static_cast<char>(255));
+    length -= 255;
+  }
+
+  compressed.push_back(static_cast<char>(length));
+}
+
+bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length) {
+  unsigned char byte;
+  do {
+    if (in == end) {
+      return false;
+    }
+
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+
+  return true;
+}
+
+void writeSequence(std::vector<char>& compressed, const char* literals, size_t literalCount) {
+  compressed.push_back(static_cast<char>((literalCount >= 15 ? 15 : literalCount) << 4));
+  if (literalCount >= 15) {
+    writeLength(compressed, literalCount - 15);
+  }
+
+  compressed.insert(compressed.end(), literals, literals + literalCount);
+}
+
+}
+
+void lz4Compress(const char* data, size_t size, std::vector<char>& compressed) {
+  compressed.clear();
+  compressed.reserve(size + size / 255 + 16);
+
+  // positions plus one, 0 is empty slot
+  std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_BITS, 0);
+  size_t anchor = 0;
+  size_t position = 0;
+  while (size > MATCH_START_LIMIT && position < size - MATCH_START_LIMIT) {
+    uint32_t sequence = read32(data + position);
+    size_t slot = hash(sequence);
+    size_t candidate = table[slot];
+    table[slot] = static_cast<uint32_t>(position + 1);
+    if (candidate == 0 || position - (candidate - 1) > MAX_DISTANCE || read32(data + candidate - 1) != sequence) {
+      ++position;
+      continue;
+    }
+
+    size_t match = candidate - 1;
+    size_t length = MIN_MATCH;
+    size_t lengthLimit = size - LAST_LITERALS - position;
+    while (length < lengthLimit && data[match + length] == data[position + length]) {
+      ++length;
+    }
+
+    size_t tokenPosition = compressed.size();
+    writeSequence(compressed, data + anchor, position - anchor);
+    size_t offset = position - match;
+    compressed.push_back(static_cast<char>(offset & 0xff));
+    compressed.push_back(static_cast<char>(offset >> 8));
+    size_t matchCode = length - MIN_MATCH;
+    compressed[tokenPosition] = static_cast<char>(compressed[tokenPosition] | (matchCode >= 15 ? 15 : matchCode));
+    if (matchCode >= 15) {
+      writeLength(compressed, matchCode - 15);
+    }
+
+    position += length;
+    anchor = position;
+  }
+
+  writeSequence(compressed, data + anchor, size - anchor);
+}
+
+bool lz4Decompress(const char* data, size_t compressedSize, char* output, size_t size) {
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* end = in + compressedSize;
+  size_t outputSize = 0;
+  while (in != end) {
+    unsigned char token = *in++;
+    size_t literalCount = token >> 4;
+    if (literalCount == 15 && !readLength(in, end, literalCount)) {
+      return false;
+    }
+
+    if (literalCount > static_cast<size_t>(end - in) || literalCount > size - outputSize) {
+      return false;
+    }
+
+    memcpy(output + outputSize, in, literalCount);
+    in += literalCount;
+    outputSize += literalCount;
+    if (in == end) {
+      break;
+    }
+
+    if (end - in < 2) {
+      return false;
+    }
+
+    size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+    in += 2;
+    if (offset == 0 || offset > outputSize) {
+      return false;
+    }
+
+    size_t length = token & 15;
+    if (length == 15 && !readLength(in, end, length)) {
+      return false;
+    }
+
+    length += MIN_MATCH;
+    if (length > size - outputSize) {
+      return false;
+    }
+
+    // source and destination overlap when offset is less than length, so bytes are copied one by one
+    for (size_t i = 0; i < length; ++i) {
+      output[outputSize + i] = output[outputSize - offset + i];
+    }
+
+    outputSize += length;
+  }
+
+  return outputSize == size;
+}
+
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Common {
+
+// LZ4 block format without frame, the caller stores the uncompressed size. Compression is a single greedy pass with
+// a small hash table, fast enough to run on every block pushed.
+void lz4Compress(const char* data, size_t size, std::vector<char>& compressed);
+// Returns false if the data is corrupted or doesn't decompress to exactly size bytes
+bool lz4Decompress(const char* data, size_t compressedSize, char* output, size_t size);
+
+}
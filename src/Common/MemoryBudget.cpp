@@ -0,0 +1,163 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Metrics.h"
+
+namespace Common {
+
+MemoryBudget::MemoryBudget(uint64_t budget) : m_budget(budget) {
+}
+
+void MemoryBudget::setBudget(uint64_t budget) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_budget = budget;
+}
+
+uint64_t MemoryBudget::getBudget() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_budget;
+}
+
+void MemoryBudget::addConsumer(const std::string& name, uint32_t weight, UsageFunction usage, LimitFunction setLimit) {
+  if (weight == 0) {
+    throw std::invalid_argument("Memory consumer weight must not be 0");
+  }
+
+  MetricsRegistry& registry = MetricsRegistry::global();
+  Consumer consumer;
+  consumer.state.name = name;
+  consumer.state.weight = weight;
+  consumer.state.usage = 0;
+  consumer.state.limit = 0;
+  consumer.usage = std::move(usage);
+  consumer.setLimit = std::move(setLimit);
+  consumer.usageGauge = &registry.gauge("memory_usage_bytes", "Memory used by a cache as of the last budget update", { { "consumer", name } });
+  consumer.limitGauge = &registry.gauge("memory_limit_bytes", "Memory limit of a cache given by the budget, 0 if none", { { "consumer", name } });
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_consumers.push_back(std::move(consumer));
+}
+
+void MemoryBudget::removeConsumer(const std::string& name) {
+  std::lock_guard<std::mutex> updateLock(m_updateMutex);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_consumers.erase(std::remove_if(m_consumers.begin(), m_consumers.end(), [&name](const Consumer& consumer) {
+    return consumer.state.name == name;
+  }), m_consumers.end());
+}
+
+void MemoryBudget::update() {
+  std::lock_guard<std::mutex> updateLock(m_updateMutex);
+  uint64_t budget;
+  std::vector<Consumer> consumers;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    budget = m_budget;
+    consumers = m_consumers;
+  }
+
+  std::vector<uint64_t> usages;
+  std::vector<uint32_t> weights;
+  for (const Consumer& consumer : consumers) {
+    usages.push_back(consumer.usage());
+    weights.push_back(consumer.state.weight);
+  }
+
+  std::vector<uint64_t> limits = computeLimits(budget, usages, weights);
+  for (size_t i = 0; i < consumers.size(); ++i) {
+    if (limits[i] != consumers[i].state.limit) {
+      consumers[i].setLimit(limits[i]);
+    }
+
+    consumers[i].usageGauge->set(static_cast<int64_t>(usages[i]));
+    consumers[i].limitGauge->set(static_cast<int64_t>(limits[i]));
+  }
+
+  // consumers are added and removed only by name, positions are matched by name
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (size_t i = 0; i < consumers.size(); ++i) {
+    for (Consumer& consumer : m_consumers) {
+      if (consumer.state.name == consumers[i].state.name) {
+        consumer.state.usage = usages[i];
+        consumer.state.limit = limits[i];
+      }
+    }
+  }
+}
+
+std::vector<MemoryBudget::ConsumerUsage> MemoryBudget::getUsage() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<ConsumerUsage> usage;
+  for (const Consumer& consumer : m_consumers) {
+    usage.push_back(consumer.state);
+  }
+
+  return usage;
+}
+
+std::vector<uint64_t> MemoryBudget::computeLimits(uint64_t budget, const std::vector<uint64_t>& usages, const std::vector<uint32_t>& weights) {
+  std::vector<uint64_t> limits(usages.size(), 0);
+  if (budget == 0) {
+    return limits;
+  }
+
+  std::vector<bool> settled(usages.size(), false);
+  uint64_t remaining = budget;
+  for (;;) {
+    uint64_t weightSum = 0;
+    for (size_t i = 0; i < usages.size(); ++i) {
+      if (!settled[i]) {
+        weightSum += weights[i];
+      }
+    }
+
+    if (weightSum == 0) {
+      break;
+    }
+
+    bool anySettled = false;
+    uint64_t used = 0;
+    for (size_t i = 0; i < usages.size(); ++i) {
+      if (settled[i]) {
+        continue;
+      }
+
+      // shares are computed in floating point, budget times weight may not fit 64 bits
+      limits[i] = std::max<uint64_t>(static_cast<uint64_t>(static_cast<double>(remaining) * weights[i] / weightSum), 1);
+      if (usages[i] <= limits[i]) {
+        settled[i] = true;
+        anySettled = true;
+        used += usages[i];
+      }
+    }
+
+    if (!anySettled) {
+      break;
+    }
+
+    remaining -= std::min(used, remaining);
+  }
+
+  return limits;
+}
+
+}
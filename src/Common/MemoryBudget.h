@@ -0,0 +1,82 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Common {
+
+class MetricGauge;
+
+// Caches of a process registered as consumers share one memory budget. On update every consumer is measured and given
+// a limit: the budget is split by weights, a consumer using less than its share keeps the share as its limit and the
+// rest of the budget is split between the others the same way. Limits may add up to more than the budget while
+// consumers below their shares grow, the next update takes it back. Without a budget consumers are not limited.
+class MemoryBudget {
+public:
+  typedef std::function<uint64_t()> UsageFunction;
+  // Consumer keeps its memory within the limit in bytes, 0 means no limit
+  typedef std::function<void(uint64_t)> LimitFunction;
+
+  struct ConsumerUsage {
+    std::string name;
+    uint32_t weight;
+    uint64_t usage;
+    uint64_t limit;
+  };
+
+  explicit MemoryBudget(uint64_t budget = 0);
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  // 0 means no budget, takes effect on the next update
+  void setBudget(uint64_t budget);
+  uint64_t getBudget() const;
+
+  // Functions are called on update from the thread calling it, they have to be thread safe on their own
+  void addConsumer(const std::string& name, uint32_t weight, UsageFunction usage, LimitFunction setLimit);
+  void removeConsumer(const std::string& name);
+
+  void update();
+  // As of the last update
+  std::vector<ConsumerUsage> getUsage() const;
+
+  // Limits for given usages and weights, exposed for tests
+  static std::vector<uint64_t> computeLimits(uint64_t budget, const std::vector<uint64_t>& usages, const std::vector<uint32_t>& weights);
+
+private:
+  struct Consumer {
+    ConsumerUsage state;
+    UsageFunction usage;
+    LimitFunction setLimit;
+    MetricGauge* usageGauge;
+    MetricGauge* limitGauge;
+  };
+
+  mutable std::mutex m_mutex;
+  // serializes updates, consumers are called without m_mutex
+  std::mutex m_updateMutex;
+  uint64_t m_budget;
+  std::vector<Consumer> m_consumers;
+};
+
+}
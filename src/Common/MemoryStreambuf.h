@@ -0,0 +1,63 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <streambuf>
+
+namespace Common {
+
+// Read-only std::streambuf over memory block, lets binary_archive deserialize directly from mapped file or blob
+// without copying it into a stringstream first.
+class MemoryStreambuf : public std::streambuf {
+public:
+  MemoryStreambuf(const char* data, size_t size) {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+
+  // Unread part of the block, readers may decode from it directly and skip what they have taken
+  const unsigned char* position() const { return reinterpret_cast<const unsigned char*>(gptr()); }
+  const unsigned char* end() const { return reinterpret_cast<const unsigned char*>(egptr()); }
+  void skip(size_t size) { setg(eback(), gptr() + size, egptr()); }
+
+protected:
+  virtual pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+    char* position;
+    if (direction == std::ios_base::beg) {
+      position = eback() + offset;
+    } else if (direction == std::ios_base::cur) {
+      position = gptr() + offset;
+    } else {
+      position = egptr() + offset;
+    }
+
+    if (position < eback() || position > egptr()) {
+      return pos_type(off_type(-1));
+    }
+
+    setg(eback(), position, egptr());
+    return pos_type(position - eback());
+  }
+
+  virtual pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+    return seekoff(off_type(position), std::ios_base::beg, which);
+  }
+};
+
+}
@@ -0,0 +1,187 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Metrics.h"
+
+#include <sstream>
+#include <stdexcept>
+
+namespace Common {
+
+namespace {
+
+std::string escapeLabelValue(const std::string& value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+
+  return escaped;
+}
+
+// Labels without braces, so histogram buckets can append theirs
+std::string formatLabels(const MetricsRegistry::Labels& labels) {
+  std::string formatted;
+  for (const auto& label : labels) {
+    if (!formatted.empty()) {
+      formatted += ',';
+    }
+
+    formatted += label.first + "=\"" + escapeLabelValue(label.second) + '"';
+  }
+
+  return formatted;
+}
+
+std::string braced(const std::string& labels) {
+  return labels.empty() ? std::string() : '{' + labels + '}';
+}
+
+template<typename Metric>
+Metric& getMetric(std::map<std::string, std::unique_ptr<Metric>>& metrics, const MetricsRegistry::Labels& labels) {
+  std::unique_ptr<Metric>& metric = metrics[formatLabels(labels)];
+  if (!metric) {
+    metric.reset(new Metric());
+  }
+
+  return *metric;
+}
+
+}
+
+MetricHistogram::MetricHistogram() : count(0), sum(0) {
+  for (auto& bucket : buckets) {
+    bucket = 0;
+  }
+}
+
+void MetricHistogram::observe(uint64_t value) {
+  size_t bucket = 0;
+  while (bucket < BUCKET_COUNT - 1 && getBucketBound(bucket) < value) {
+    ++bucket;
+  }
+
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void MetricHistogram::observe(std::chrono::steady_clock::duration duration) {
+  observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+}
+
+uint64_t MetricHistogram::getBucketBound(size_t bucket) {
+  return static_cast<uint64_t>(1) << bucket;
+}
+
+uint64_t MetricHistogram::getBucketCount(size_t bucket) const {
+  return buckets[bucket].load(std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getCount() const {
+  return count.load(std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getSum() const {
+  return sum.load(std::memory_order_relaxed);
+}
+
+MetricsRegistry::MetricsRegistry() {
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help, const Labels& labels) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return getMetric(getFamily(name, help, COUNTER).counters, labels);
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const Labels& labels) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return getMetric(getFamily(name, help, GAUGE).gauges, labels);
+}
+
+MetricHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const Labels& labels) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return getMetric(getFamily(name, help, HISTOGRAM).histograms, labels);
+}
+
+std::string MetricsRegistry::format() const {
+  static const char* TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+
+  std::ostringstream stream;
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& familyEntry : families) {
+    const std::string& name = familyEntry.first;
+    const Family& family = familyEntry.second;
+    stream << "# HELP " << name << ' ' << family.help << '\n';
+    stream << "# TYPE " << name << ' ' << TYPE_NAMES[family.type] << '\n';
+
+    for (const auto& counter : family.counters) {
+      stream << name << braced(counter.first) << ' ' << counter.second->get() << '\n';
+    }
+
+    for (const auto& gauge : family.gauges) {
+      stream << name << braced(gauge.first) << ' ' << gauge.second->get() << '\n';
+    }
+
+    for (const auto& histogramEntry : family.histograms) {
+      const std::string& labels = histogramEntry.first;
+      const MetricHistogram& histogram = *histogramEntry.second;
+      std::string separator = labels.empty() ? "" : ",";
+      uint64_t cumulative = 0;
+      for (size_t bucket = 0; bucket < MetricHistogram::BUCKET_COUNT; ++bucket) {
+        cumulative += histogram.getBucketCount(bucket);
+        std::string bound = bucket + 1 < MetricHistogram::BUCKET_COUNT ? std::to_string(MetricHistogram::getBucketBound(bucket)) : "+Inf";
+        stream << name << "_bucket{" << labels << separator << "le=\"" << bound << "\"} " << cumulative << '\n';
+      }
+
+      stream << name << "_sum" << braced(labels) << ' ' << histogram.getSum() << '\n';
+      stream << name << "_count" << braced(labels) << ' ' << histogram.getCount() << '\n';
+    }
+  }
+
+  return stream.str();
+}
+
+MetricsRegistry& MetricsRegistry::global() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::Family& MetricsRegistry::getFamily(const std::string& name, const std::string& help, Type type) {
+  auto it = families.find(name);
+  if (it == families.end()) {
+    Family& family = families[name];
+    family.type = type;
+    family.help = help;
+    return family;
+  }
+
+  if (it->second.type != type) {
+    throw std::runtime_error("Metric " + name + " is registered with another type");
+  }
+
+  return it->second;
+}
+
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Common {
+
+// Metrics are updated with relaxed atomics from any thread, values read while they are updated may be a bit stale
+class MetricCounter {
+public:
+  MetricCounter() : value(0) {
+  }
+
+  MetricCounter(const MetricCounter&) = delete;
+  MetricCounter& operator=(const MetricCounter&) = delete;
+
+  void increment(uint64_t count = 1) {
+    value.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  uint64_t get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> value;
+};
+
+class MetricGauge {
+public:
+  MetricGauge() : value(0) {
+  }
+
+  MetricGauge(const MetricGauge&) = delete;
+  MetricGauge& operator=(const MetricGauge&) = delete;
+
+  void set(int64_t newValue) {
+    value.store(newValue, std::memory_order_relaxed);
+  }
+
+  void add(int64_t delta) {
+    value.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  int64_t get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> value;
+};
+
+// Latency histogram in microseconds. Bucket i counts values up to 2^i, the last one counts the rest, so relative
+// error of a quantile is below a factor of two whatever the range of latencies is.
+class MetricHistogram {
+public:
+  static const size_t BUCKET_COUNT = 28;
+
+  MetricHistogram();
+  MetricHistogram(const MetricHistogram&) = delete;
+  MetricHistogram& operator=(const MetricHistogram&) = delete;
+
+  void observe(uint64_t value);
+  void observe(std::chrono::steady_clock::duration duration);
+
+  // Upper bound of the bucket, the last bucket has none
+  static uint64_t getBucketBound(size_t bucket);
+  uint64_t getBucketCount(size_t bucket) const;
+  uint64_t getCount() const;
+  uint64_t getSum() const;
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+};
+
+// Observes the time from construction to destruction, so every return and exception path of a scope is measured
+class MetricTimer {
+public:
+  explicit MetricTimer(MetricHistogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {
+  }
+
+  MetricTimer(const MetricTimer&) = delete;
+  MetricTimer& operator=(const MetricTimer&) = delete;
+
+  ~MetricTimer() {
+    histogram.observe(std::chrono::steady_clock::now() - start);
+  }
+
+private:
+  MetricHistogram& histogram;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Named metrics of the process. A metric is created on the first request for its name and labels and lives as long
+// as the registry, so callers keep references to metrics they update often instead of looking them up each time.
+// Label values must come from a bounded set, every distinct value is a separate metric forever.
+class MetricsRegistry {
+public:
+  typedef std::vector<std::pair<std::string, std::string>> Labels;
+
+  MetricsRegistry();
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  // Throw std::runtime_error if the name is registered with another metric type
+  MetricCounter& counter(const std::string& name, const std::string& help, const Labels& labels = Labels());
+  MetricGauge& gauge(const std::string& name, const std::string& help, const Labels& labels = Labels());
+  MetricHistogram& histogram(const std::string& name, const std::string& help, const Labels& labels = Labels());
+
+  // Prometheus text exposition format
+  std::string format() const;
+
+  static MetricsRegistry& global();
+
+private:
+  enum Type {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM
+  };
+
+  struct Family {
+    Type type;
+    std::string help;
+    // keyed by formatted labels
+    std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+    std::map<std::string, std::unique_ptr<MetricGauge>> gauges;
+    std::map<std::string, std::unique_ptr<MetricHistogram>> histograms;
+  };
+
+  Family& getFamily(const std::string& name, const std::string& help, Type type);
+
+  mutable std::mutex mutex;
+  std::map<std::string, Family> families;
+};
+
+}
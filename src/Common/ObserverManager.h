@@ -18,103 +18,90 @@
 #pragma once
 
 #include <algorithm>
+#include <memory>
 #include <mutex>
 #include <vector>
 
 namespace tools {
 
+// Observers are kept in an immutable list which add and remove replace with a modified copy, so notify only takes
+// the current list by an atomic load and doesn't lock or allocate. Observer removed during notification can still be
+// called by it.
 template<typename T>
 class ObserverManager {
 public:
+  ObserverManager() : m_observers(std::make_shared<const std::vector<T*>>()) {
+  }
+
   bool add(T* observer) {
     std::unique_lock<std::mutex> lock(m_observersMutex);
-    auto it = std::find(m_observers.begin(), m_observers.end(), observer);
-    if (m_observers.end() == it) {
-      m_observers.push_back(observer);
-      return true;
-    } else {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    if (std::find(observers->begin(), observers->end(), observer) != observers->end()) {
       return false;
     }
+
+    std::shared_ptr<std::vector<T*>> newObservers = std::make_shared<std::vector<T*>>(*observers);
+    newObservers->push_back(observer);
+    std::atomic_store(&m_observers, std::shared_ptr<const std::vector<T*>>(std::move(newObservers)));
+    return true;
   }
 
   bool remove(T* observer) {
     std::unique_lock<std::mutex> lock(m_observersMutex);
-    auto it = std::find(m_observers.begin(), m_observers.end(), observer);
-    if (m_observers.end() == it) {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    auto it = std::find(observers->begin(), observers->end(), observer);
+    if (it == observers->end()) {
       return false;
-    } else {
-      m_observers.erase(it);
-      return true;
     }
+
+    std::shared_ptr<std::vector<T*>> newObservers = std::make_shared<std::vector<T*>>(*observers);
+    newObservers->erase(newObservers->begin() + (it - observers->begin()));
+    std::atomic_store(&m_observers, std::shared_ptr<const std::vector<T*>>(std::move(newObservers)));
+    return true;
   }
 
   void clear() {
     std::unique_lock<std::mutex> lock(m_observersMutex);
-    m_observers.clear();
+    std::atomic_store(&m_observers, std::make_shared<const std::vector<T*>>());
   }
 
 #if defined(_MSC_VER)
   template<typename F>
   void notify(F notification) {
-    std::vector<T*> observersCopy;
-    {
-      std::unique_lock<std::mutex> lock(m_observersMutex);
-      observersCopy = m_observers;
-    }
-
-    for (T* observer : observersCopy) {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    for (T* observer : *observers) {
       (observer->*notification)();
     }
   }
 
   template<typename F, typename Arg0>
   void notify(F notification, const Arg0& arg0) {
-    std::vector<T*> observersCopy;
-    {
-      std::unique_lock<std::mutex> lock(m_observersMutex);
-      observersCopy = m_observers;
-    }
-
-    for (T* observer : observersCopy) {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    for (T* observer : *observers) {
       (observer->*notification)(arg0);
     }
   }
 
   template<typename F, typename Arg0, typename Arg1>
   void notify(F notification, const Arg0& arg0, const Arg1& arg1) {
-    std::vector<T*> observersCopy;
-    {
-      std::unique_lock<std::mutex> lock(m_observersMutex);
-      observersCopy = m_observers;
-    }
-
-    for (T* observer : observersCopy) {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    for (T* observer : *observers) {
       (observer->*notification)(arg0, arg1);
     }
   }
 
   template<typename F, typename Arg0, typename Arg1, typename Arg2>
   void notify(F notification, const Arg0& arg0, const Arg1& arg1, const Arg2& arg2) {
-    std::vector<T*> observersCopy;
-    {
-      std::unique_lock<std::mutex> lock(m_observersMutex);
-      observersCopy = m_observers;
-    }
-
-    for (T* observer : observersCopy) {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    for (T* observer : *observers) {
       (observer->*notification)(arg0, arg1, arg2);
     }
   }
 
   template<typename F, typename Arg0, typename Arg1, typename Arg2, typename Arg3>
   void notify(F notification, const Arg0& arg0, const Arg1& arg1, const Arg2& arg2, const Arg3& arg3) {
-    std::vector<T*> observersCopy;
-    {
-      std::unique_lock<std::mutex> lock(m_observersMutex);
-      observersCopy = m_observers;
-    }
-
-    for (T* observer : observersCopy) {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    for (T* observer : *observers) {
       (observer->*notification)(arg0, arg1, arg2, arg3);
     }
   }
@@ -122,21 +109,17 @@ public:
 #else
 
   template<typename F, typename... Args>
-  void notify(F notification, Args... args) {
-    std::vector<T*> observersCopy;
-    {
-      std::unique_lock<std::mutex> lock(m_observersMutex);
-      observersCopy = m_observers;
-    }
-
-    for (T* observer : observersCopy) {
+  void notify(F notification, const Args&... args) {
+    std::shared_ptr<const std::vector<T*>> observers = std::atomic_load(&m_observers);
+    for (T* observer : *observers) {
       (observer->*notification)(args...);
     }
   }
 #endif
 
 private:
-  std::vector<T*> m_observers;
+  // accessed by std::atomic_load and std::atomic_store only, m_observersMutex serializes writers
+  std::shared_ptr<const std::vector<T*>> m_observers;
   std::mutex m_observersMutex;
 };
 
@@ -0,0 +1,100 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "RecursiveSharedMutex.h"
+
+#include <stdexcept>
+
+namespace Common {
+
+RecursiveSharedMutex::RecursiveSharedMutex() : m_writerDepth(0), m_waitingWriters(0) {
+}
+
+void RecursiveSharedMutex::lock() {
+  std::thread::id self = std::this_thread::get_id();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_writerDepth != 0 && m_writer == self) {
+    ++m_writerDepth;
+    return;
+  }
+
+  if (m_readers.count(self) != 0) {
+    throw std::logic_error("RecursiveSharedMutex: shared lock cannot be upgraded to exclusive");
+  }
+
+  ++m_waitingWriters;
+  while (m_writerDepth != 0 || !m_readers.empty()) {
+    m_released.wait(lock);
+  }
+
+  --m_waitingWriters;
+  m_writer = self;
+  m_writerDepth = 1;
+}
+
+void RecursiveSharedMutex::unlock() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (--m_writerDepth == 0) {
+    m_writer = std::thread::id();
+    m_released.notify_all();
+  }
+}
+
+void RecursiveSharedMutex::lock_shared() {
+  std::thread::id self = std::this_thread::get_id();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_writerDepth != 0 && m_writer == self) {
+    // Shared lock inside exclusive one is just another level of recursion.
+    ++m_writerDepth;
+    return;
+  }
+
+  auto it = m_readers.find(self);
+  if (it != m_readers.end()) {
+    ++it->second;
+    return;
+  }
+
+  while (m_writerDepth != 0 || m_waitingWriters != 0) {
+    m_released.wait(lock);
+  }
+
+  m_readers.insert(std::make_pair(self, static_cast<std::size_t>(1)));
+}
+
+void RecursiveSharedMutex::unlock_shared() {
+  std::thread::id self = std::this_thread::get_id();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_writerDepth != 0 && m_writer == self) {
+    if (--m_writerDepth == 0) {
+      m_writer = std::thread::id();
+      m_released.notify_all();
+    }
+
+    return;
+  }
+
+  auto it = m_readers.find(self);
+  if (it != m_readers.end() && --it->second == 0) {
+    m_readers.erase(it);
+    if (m_readers.empty()) {
+      m_released.notify_all();
+    }
+  }
+}
+
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace Common {
+
+// Reader/writer mutex with recursion in both modes.
+// A thread owning exclusive lock may take it again or take shared lock, a thread owning shared lock may take shared lock again.
+// Upgrading shared lock to exclusive is not supported and throws std::logic_error instead of deadlocking.
+// Waiting writers block new readers, but threads which already hold shared lock proceed.
+class RecursiveSharedMutex {
+public:
+  RecursiveSharedMutex();
+  RecursiveSharedMutex(const RecursiveSharedMutex&) = delete;
+  RecursiveSharedMutex& operator=(const RecursiveSharedMutex&) = delete;
+
+  void lock();
+  void unlock();
+  void lock_shared();
+  void unlock_shared();
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_released;
+  std::thread::id m_writer;
+  std::size_t m_writerDepth;
+  std::size_t m_waitingWriters;
+  std::map<std::thread::id, std::size_t> m_readers;
+};
+
+template<typename Mutex> class SharedLockGuard {
+public:
+  explicit SharedLockGuard(Mutex& mutex) : m_mutex(mutex) {
+    m_mutex.lock_shared();
+  }
+
+  SharedLockGuard(const SharedLockGuard&) = delete;
+  SharedLockGuard& operator=(const SharedLockGuard&) = delete;
+
+  ~SharedLockGuard() {
+    m_mutex.unlock_shared();
+  }
+
+private:
+  Mutex& m_mutex;
+};
+
+}
@@ -0,0 +1,298 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bounded multi-producer multi-consumer queue on a ring of slots. Every slot carries a sequence number telling
+// whether it may be written or read at the current position, so producers and consumers only claim positions with
+// compare and swap. Mutex and condition variables are used only to sleep while the queue is full or empty.
+// Close semantics are those of BlockingQueue, so it can be used with GroupClose.
+template <typename T>
+class RingQueue {
+public:
+
+  typedef RingQueue<T> ThisType;
+
+  // Capacity is rounded up to a power of two of at least 2, with a single slot the sequence number of a written slot
+  // would also mean the slot is free for the next position
+  RingQueue(size_t maxSize = 1) :
+    m_cells(roundCapacity(maxSize)), m_mask(m_cells.size() - 1), m_enqueuePosition(0), m_dequeuePosition(0),
+    m_closed(false), m_pushing(0), m_waitingPushers(0), m_waitingPoppers(0) {
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  template <typename TT>
+  bool push(TT&& v) {
+    ++m_pushing;
+    bool pushed = false;
+    while (!m_closed) {
+      if (tryPush(std::forward<TT>(v))) {
+        pushed = true;
+        break;
+      }
+
+      waitForSpace();
+    }
+
+    --m_pushing;
+    notifyPoppers(m_closed);
+    return pushed;
+  }
+
+  // Moves items from the range, returns how many were pushed before the queue was closed
+  template <typename Iterator>
+  size_t pushBatch(Iterator first, Iterator last) {
+    ++m_pushing;
+    size_t count = 0;
+    while (first != last && !m_closed) {
+      if (tryPush(std::move(*first))) {
+        ++first;
+        ++count;
+        continue;
+      }
+
+      notifyPoppers(true);
+      waitForSpace();
+    }
+
+    --m_pushing;
+    notifyPoppers(count > 1 || m_closed);
+    return count;
+  }
+
+  bool pop(T& v) {
+    for (;;) {
+      if (tryPop(v)) {
+        notifyPushers();
+        return true;
+      }
+
+      if (!waitForData()) {
+        // all data has been processed, queue is closed
+        return false;
+      }
+    }
+  }
+
+  // Waits for at least one item and takes up to maxCount items available, returns 0 once the queue is closed and empty
+  size_t popBatch(std::vector<T>& items, size_t maxCount) {
+    items.clear();
+    for (;;) {
+      T v;
+      while (items.size() < maxCount && tryPop(v)) {
+        items.push_back(std::move(v));
+      }
+
+      if (!items.empty()) {
+        notifyPushers();
+        return items.size();
+      }
+
+      if (!waitForData()) {
+        return 0;
+      }
+    }
+  }
+
+  void close(bool wait = false) {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_closed = true;
+    m_haveData.notify_all(); // wake up threads in pop()
+    m_haveSpace.notify_all();
+
+    if (wait) {
+      ++m_waitingPushers;
+      while (!empty()) {
+        m_haveSpace.wait(lk);
+      }
+
+      --m_waitingPushers;
+    }
+  }
+
+  size_t size() {
+    size_t dequeuePosition = m_dequeuePosition.load();
+    size_t enqueuePosition = m_enqueuePosition.load();
+    return enqueuePosition > dequeuePosition ? enqueuePosition - dequeuePosition : 0;
+  }
+
+  size_t capacity() const {
+    return m_cells.size();
+  }
+
+private:
+
+  // Rounds of yield before going to sleep, items are usually taken or freed within them under load
+  static const size_t SPIN_COUNT = 16;
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t roundCapacity(size_t maxSize) {
+    size_t capacity = 2;
+    while (capacity < maxSize) {
+      capacity <<= 1;
+    }
+
+    return capacity;
+  }
+
+  // Dequeue position is read first, so it never gets ahead of the enqueue position read after it
+  bool full() {
+    size_t dequeuePosition = m_dequeuePosition.load();
+    return m_enqueuePosition.load() - dequeuePosition >= m_cells.size();
+  }
+
+  bool empty() {
+    return m_enqueuePosition.load() == m_dequeuePosition.load();
+  }
+
+  template <typename TT>
+  bool tryPush(TT&& v) {
+    size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = m_cells[position & m_mask];
+      intptr_t difference = static_cast<intptr_t>(cell.sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (m_enqueuePosition.compare_exchange_weak(position, position + 1)) {
+          cell.value = std::forward<TT>(v);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = m_enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool tryPop(T& v) {
+    size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = m_cells[position & m_mask];
+      intptr_t difference = static_cast<intptr_t>(cell.sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position + 1);
+      if (difference == 0) {
+        if (m_dequeuePosition.compare_exchange_weak(position, position + 1)) {
+          v = std::move(cell.value);
+          cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = m_dequeuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Waiters are counted before the condition is checked and notifiers look at the counters after changing positions,
+  // so either the waiter sees the change or the notifier sees the waiter
+  void waitForSpace() {
+    // slot may be claimed but not yet released by another thread, which has to get the processor to finish
+    for (size_t i = 0; i < SPIN_COUNT; ++i) {
+      std::this_thread::yield();
+      if (m_closed || !full()) {
+        return;
+      }
+    }
+
+    std::unique_lock<std::mutex> lk(m_mutex);
+    ++m_waitingPushers;
+    while (!m_closed && full()) {
+      m_haveSpace.wait(lk);
+    }
+
+    --m_waitingPushers;
+  }
+
+  // Returns false if the queue is closed, empty and no push is in progress
+  bool waitForData() {
+    for (size_t i = 0; i < SPIN_COUNT; ++i) {
+      std::this_thread::yield();
+      if (!empty()) {
+        return true;
+      }
+
+      if (m_closed && m_pushing == 0) {
+        return !empty();
+      }
+    }
+
+    std::unique_lock<std::mutex> lk(m_mutex);
+    ++m_waitingPoppers;
+    while (empty() && !(m_closed && m_pushing == 0)) {
+      m_haveData.wait(lk);
+    }
+
+    --m_waitingPoppers;
+    return !empty();
+  }
+
+  void notifyPoppers(bool all) {
+    if (m_waitingPoppers != 0) {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      if (all) {
+        m_haveData.notify_all();
+      } else {
+        m_haveData.notify_one();
+      }
+    }
+  }
+
+  void notifyPushers() {
+    if (m_waitingPushers != 0) {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      // after close only close(true) callers wait for space, each of them has to recheck
+      if (m_closed) {
+        m_haveSpace.notify_all();
+      } else {
+        m_haveSpace.notify_one();
+      }
+    }
+  }
+
+  std::vector<Cell> m_cells;
+  const size_t m_mask;
+
+  char m_enqueuePadding[CACHE_LINE_SIZE];
+  std::atomic<size_t> m_enqueuePosition;
+  char m_dequeuePadding[CACHE_LINE_SIZE];
+  std::atomic<size_t> m_dequeuePosition;
+  char m_statePadding[CACHE_LINE_SIZE];
+
+  std::atomic<bool> m_closed;
+  std::atomic<size_t> m_pushing;
+  std::atomic<size_t> m_waitingPushers;
+  std::atomic<size_t> m_waitingPoppers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_haveData;
+  std::condition_variable m_haveSpace;
+};
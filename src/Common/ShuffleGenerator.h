@@ -60,10 +60,16 @@ public:
     selected.clear();
   }
 
+  // starts a new sequence over n values, keeps generator state and allocated memory
+  void reset(T n) {
+    N = n;
+    reset();
+  }
+
 private:
 
   std::unordered_map<T, T> selected;
   T count;
-  const T N;
+  T N;
   Gen generator;
 };
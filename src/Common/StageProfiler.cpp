@@ -0,0 +1,88 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "StageProfiler.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace Common {
+
+namespace {
+
+std::string formatQuantile(const MetricHistogram& histogram, double quantile) {
+  uint64_t rank = static_cast<uint64_t>(histogram.getCount() * quantile);
+  uint64_t cumulative = 0;
+  for (size_t bucket = 0; bucket + 1 < MetricHistogram::BUCKET_COUNT; ++bucket) {
+    cumulative += histogram.getBucketCount(bucket);
+    if (cumulative > rank) {
+      return "<=" + std::to_string(MetricHistogram::getBucketBound(bucket));
+    }
+  }
+
+  return ">" + std::to_string(MetricHistogram::getBucketBound(MetricHistogram::BUCKET_COUNT - 2));
+}
+
+}
+
+std::atomic<bool> StageProfiler::enabled(false);
+std::mutex StageProfiler::mutex;
+std::vector<std::pair<std::string, MetricHistogram*>> StageProfiler::stages;
+
+void StageProfiler::setEnabled(bool value) {
+  enabled.store(value, std::memory_order_relaxed);
+}
+
+MetricHistogram& StageProfiler::stage(const std::string& name) {
+  MetricHistogram& histogram = MetricsRegistry::global().histogram("stage_duration_microseconds",
+    "Time spent in profiled stages", {{"stage", name}});
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& stage : stages) {
+    if (stage.first == name) {
+      return histogram;
+    }
+  }
+
+  stages.emplace_back(name, &histogram);
+  return histogram;
+}
+
+std::string StageProfiler::format() {
+  std::ostringstream stream;
+  stream << std::left << std::setw(28) << "stage" << std::right << std::setw(10) << "count" << std::setw(14) << "mean, us" <<
+    std::setw(14) << "p50, us" << std::setw(14) << "p90, us" << std::setw(14) << "p99, us" << std::setw(14) << "total, ms" << '\n';
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& stage : stages) {
+    const MetricHistogram& histogram = *stage.second;
+    uint64_t count = histogram.getCount();
+    uint64_t sum = histogram.getSum();
+    stream << std::left << std::setw(28) << stage.first << std::right << std::setw(10) << count;
+    if (count == 0) {
+      stream << std::setw(14) << '-' << std::setw(14) << '-' << std::setw(14) << '-' << std::setw(14) << '-' << std::setw(14) << 0 << '\n';
+      continue;
+    }
+
+    stream << std::setw(14) << sum / count << std::setw(14) << formatQuantile(histogram, 0.5) << std::setw(14) <<
+      formatQuantile(histogram, 0.9) << std::setw(14) << formatQuantile(histogram, 0.99) << std::setw(14) << sum / 1000 << '\n';
+  }
+
+  return stream.str();
+}
+
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Metrics.h"
+
+namespace Common {
+
+// Durations of the stages of an operation, to find out which one makes it slow. Stages are histograms of the global
+// metrics registry labelled with the stage name. Profiling is off by default, a stage timer then costs one relaxed load.
+class StageProfiler {
+public:
+  static bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  static void setEnabled(bool value);
+
+  // Registers the stage on the first call, callers keep the reference
+  static MetricHistogram& stage(const std::string& name);
+
+  // Stages in registration order with count, mean and quantiles, quantiles are bucket bounds of the histograms
+  static std::string format();
+
+private:
+  static std::atomic<bool> enabled;
+  static std::mutex mutex;
+  static std::vector<std::pair<std::string, MetricHistogram*>> stages;
+};
+
+// Observes the time from construction to destruction or stop if profiling was enabled at construction
+class StageTimer {
+public:
+  explicit StageTimer(MetricHistogram& histogram) : histogram(StageProfiler::isEnabled() ? &histogram : nullptr) {
+    if (this->histogram != nullptr) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  StageTimer(const StageTimer&) = delete;
+  StageTimer& operator=(const StageTimer&) = delete;
+
+  ~StageTimer() {
+    stop();
+  }
+
+  void stop() {
+    if (histogram != nullptr) {
+      histogram->observe(std::chrono::steady_clock::now() - start);
+      histogram = nullptr;
+    }
+  }
+
+private:
+  MetricHistogram* histogram;
+  std::chrono::steady_clock::time_point start;
+};
+
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace Common {
+
+namespace {
+
+struct ParallelForState {
+  ParallelForState(size_t count, std::function<void(size_t)>&& body) : count(count), body(std::move(body)), next(0), finished(0) {
+  }
+
+  const size_t count;
+  const std::function<void(size_t)> body;
+  std::atomic<size_t> next;
+  std::mutex mutex;
+  std::condition_variable allFinished;
+  size_t finished;
+  std::exception_ptr exception;
+
+  // Helpers which start after all indexes were taken do not touch body, caller may already be gone then
+  void run() {
+    for (;;) {
+      size_t index = next++;
+      if (index >= count) {
+        return;
+      }
+
+      std::exception_ptr error;
+      try {
+        body(index);
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (error && !exception) {
+        exception = error;
+      }
+
+      if (++finished == count) {
+        allFinished.notify_all();
+      }
+    }
+  }
+};
+
+}
+
+ThreadPool::ThreadPool(size_t threadCount, std::function<void()> threadInit) : m_tasks(std::numeric_limits<size_t>::max()) {
+  m_threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_threads.emplace_back(&ThreadPool::workerThread, this, threadInit);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  m_tasks.close();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::threadCount() const {
+  return m_threads.size();
+}
+
+std::future<void> ThreadPool::addTask(std::function<void()> task) {
+  auto packagedTask = std::make_shared<std::packaged_task<void()>>(std::move(task));
+  std::future<void> result = packagedTask->get_future();
+  if (!m_tasks.push(std::function<void()>([packagedTask] { (*packagedTask)(); }))) {
+    throw std::runtime_error("ThreadPool::addTask: pool is stopped");
+  }
+
+  return result;
+}
+
+void ThreadPool::parallelFor(size_t count, std::function<void(size_t)> body) {
+  if (count == 0) {
+    return;
+  }
+
+  auto state = std::make_shared<ParallelForState>(count, std::move(body));
+  size_t helperCount = std::min(m_threads.size(), count - 1);
+  for (size_t i = 0; i < helperCount; ++i) {
+    m_tasks.push(std::function<void()>([state] { state->run(); }));
+  }
+
+  state->run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (state->finished != count) {
+    state->allFinished.wait(lock);
+  }
+
+  if (state->exception) {
+    std::rethrow_exception(state->exception);
+  }
+}
+
+void ThreadPool::workerThread(std::function<void()> threadInit) {
+  if (threadInit) {
+    threadInit();
+  }
+
+  std::function<void()> task;
+  while (m_tasks.pop(task)) {
+    task();
+    task = nullptr;
+  }
+}
+
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "BlockingQueue.h"
+
+namespace Common {
+
+// Fixed set of worker threads executing queued tasks.
+class ThreadPool {
+public:
+  // threadInit is called first by every pool thread, e.g. to apply thread placement
+  explicit ThreadPool(size_t threadCount, std::function<void()> threadInit = std::function<void()>());
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  size_t threadCount() const;
+  std::future<void> addTask(std::function<void()> task);
+
+  // Calls body for every index in [0, count) on pool threads and calling thread, returns when all calls are finished.
+  // First exception thrown by body is rethrown. Calling thread takes part in work, so nested calls from pool threads do not deadlock.
+  void parallelFor(size_t count, std::function<void(size_t)> body);
+
+private:
+  BlockingQueue<std::function<void()>> m_tasks;
+  std::vector<std::thread> m_threads;
+
+  void workerThread(std::function<void()> threadInit);
+};
+
+}
@@ -0,0 +1,217 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ThreadTopology.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace Common {
+
+namespace {
+
+// Offsets from the process nice value on Linux, threads are scheduled by their own nice value there
+const int LOW_PRIORITY_NICE = 10;
+const int HIGH_PRIORITY_NICE = -5;
+const unsigned MAX_CPU = 1023;
+
+bool parseNumber(const std::string& text, unsigned& number) {
+  if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 4) {
+    return false;
+  }
+
+  number = static_cast<unsigned>(std::strtoul(text.c_str(), nullptr, 10));
+  return number <= MAX_CPU;
+}
+
+std::vector<unsigned> getProcessCpus() {
+  std::vector<unsigned> cpus;
+#if defined(_WIN32)
+  DWORD_PTR processMask;
+  DWORD_PTR systemMask;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) != 0) {
+    for (unsigned cpu = 0; cpu < sizeof(processMask) * 8; ++cpu) {
+      if ((processMask >> cpu) & 1) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+int getProcessNice() {
+#if defined(__linux__)
+  errno = 0;
+  int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+  return errno == 0 ? nice : 0;
+#else
+  return 0;
+#endif
+}
+
+// Empty set is left alone, it means the CPUs of the process could not be read
+bool setAffinity(const std::vector<unsigned>& cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+
+#if defined(_WIN32)
+  DWORD_PTR mask = 0;
+  for (unsigned cpu : cpus) {
+    if (cpu >= sizeof(mask) * 8) {
+      return false;
+    }
+
+    mask |= static_cast<DWORD_PTR>(1) << cpu;
+  }
+
+  return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned cpu : cpus) {
+    if (cpu >= CPU_SETSIZE) {
+      return false;
+    }
+
+    CPU_SET(cpu, &set);
+  }
+
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+bool setPriority(ThreadPriority priority, int processNice) {
+#if defined(_WIN32)
+  int value = priority == ThreadPriority::LOW ? THREAD_PRIORITY_BELOW_NORMAL :
+    priority == ThreadPriority::HIGH ? THREAD_PRIORITY_ABOVE_NORMAL : THREAD_PRIORITY_NORMAL;
+  return SetThreadPriority(GetCurrentThread(), value) != 0;
+#elif defined(__linux__)
+  int nice = processNice + (priority == ThreadPriority::LOW ? LOW_PRIORITY_NICE : priority == ThreadPriority::HIGH ? HIGH_PRIORITY_NICE : 0);
+  return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) == 0;
+#else
+  // priority is per process elsewhere
+  return priority == ThreadPriority::NORMAL;
+#endif
+}
+
+}
+
+ThreadTopology& ThreadTopology::global() {
+  static ThreadTopology topology;
+  return topology;
+}
+
+ThreadTopology::ThreadTopology() : m_processCpus(getProcessCpus()), m_processNice(getProcessNice()) {
+}
+
+void ThreadTopology::setPlacement(ThreadClass threadClass, const ThreadPlacement& placement) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_placements[static_cast<size_t>(threadClass)] = placement;
+}
+
+ThreadPlacement ThreadTopology::getPlacement(ThreadClass threadClass) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_placements[static_cast<size_t>(threadClass)];
+}
+
+bool ThreadTopology::applyToCurrentThread(ThreadClass threadClass) const {
+  return applyToCurrentThread(getPlacement(threadClass));
+}
+
+bool ThreadTopology::applyToCurrentThread(const ThreadPlacement& placement) const {
+  bool applied = setAffinity(placement.cpus.empty() ? m_processCpus : placement.cpus);
+  return setPriority(placement.priority, m_processNice) && applied;
+}
+
+bool ThreadTopology::parseCpus(const std::string& text, std::vector<unsigned>& cpus) {
+  cpus.clear();
+  if (text.empty()) {
+    return true;
+  }
+
+  std::istringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    size_t dash = item.find('-');
+    unsigned first;
+    unsigned last;
+    if (dash == std::string::npos) {
+      if (!parseNumber(item, first)) {
+        return false;
+      }
+
+      last = first;
+    } else if (!parseNumber(item.substr(0, dash), first) || !parseNumber(item.substr(dash + 1), last) || last < first) {
+      return false;
+    }
+
+    for (unsigned cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return !cpus.empty();
+}
+
+bool ThreadTopology::parsePriority(const std::string& text, ThreadPriority& priority) {
+  if (text == "low") {
+    priority = ThreadPriority::LOW;
+  } else if (text == "normal") {
+    priority = ThreadPriority::NORMAL;
+  } else if (text == "high") {
+    priority = ThreadPriority::HIGH;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+}
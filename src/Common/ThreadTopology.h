@@ -0,0 +1,79 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Common {
+
+enum class ThreadClass {
+  MINER,
+  NETWORK,
+  VERIFICATION
+};
+
+enum class ThreadPriority {
+  LOW,
+  NORMAL,
+  HIGH
+};
+
+// CPUs a thread may run on, empty means any, and its scheduling priority
+struct ThreadPlacement {
+  std::vector<unsigned> cpus;
+  ThreadPriority priority;
+
+  ThreadPlacement() : priority(ThreadPriority::NORMAL) {
+  }
+};
+
+// Placement of every thread class of the process. Threads apply the placement of their class when they start, so it
+// has to be set before the threads are created. Threads inherit affinity and priority of the thread creating them, so
+// class without CPUs gets the CPUs the process had when the topology was created and priority is relative to the
+// process one. Placement is supported on Linux and Windows, on Linux raising priority needs CAP_SYS_NICE.
+class ThreadTopology {
+public:
+  static ThreadTopology& global();
+
+  ThreadTopology();
+  ThreadTopology(const ThreadTopology&) = delete;
+  ThreadTopology& operator=(const ThreadTopology&) = delete;
+
+  void setPlacement(ThreadClass threadClass, const ThreadPlacement& placement);
+  ThreadPlacement getPlacement(ThreadClass threadClass) const;
+  // Returns false if the platform refused or does not support the placement, the thread keeps running as it was then
+  bool applyToCurrentThread(ThreadClass threadClass) const;
+  bool applyToCurrentThread(const ThreadPlacement& placement) const;
+
+  // CPU set as comma separated numbers and ranges, e.g. "0-3,6"
+  static bool parseCpus(const std::string& text, std::vector<unsigned>& cpus);
+  // "low", "normal" or "high"
+  static bool parsePriority(const std::string& text, ThreadPriority& priority);
+
+private:
+  static const size_t THREAD_CLASS_COUNT = 3;
+
+  mutable std::mutex m_mutex;
+  ThreadPlacement m_placements[THREAD_CLASS_COUNT];
+  std::vector<unsigned> m_processCpus;
+  int m_processNice;
+};
+
+}
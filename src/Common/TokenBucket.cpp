@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TokenBucket.h"
+
+#include <algorithm>
+
+namespace Common {
+
+TokenBucket::TokenBucket() : m_rate(0), m_burst(0), m_balance(0) {
+}
+
+TokenBucket::TokenBucket(uint64_t rate, uint64_t burst, Clock::time_point now) :
+  m_rate(static_cast<double>(rate)), m_burst(static_cast<double>(std::max(burst, rate))), m_balance(m_burst), m_updated(now) {
+}
+
+bool TokenBucket::isLimited() const {
+  return m_rate != 0;
+}
+
+void TokenBucket::charge(uint64_t cost, Clock::time_point now) {
+  if (m_rate == 0) {
+    return;
+  }
+
+  refill(now);
+  m_balance -= static_cast<double>(cost);
+}
+
+TokenBucket::Clock::duration TokenBucket::getDelay(Clock::time_point now) {
+  if (m_rate == 0) {
+    return Clock::duration::zero();
+  }
+
+  refill(now);
+  if (m_balance >= 0) {
+    return Clock::duration::zero();
+  }
+
+  return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(-m_balance / m_rate));
+}
+
+bool TokenBucket::isFull(Clock::time_point now) {
+  if (m_rate == 0) {
+    return true;
+  }
+
+  refill(now);
+  return m_balance >= m_burst;
+}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now > m_updated) {
+    m_balance = std::min(m_burst, m_balance + std::chrono::duration<double>(now - m_updated).count() * m_rate);
+    m_updated = now;
+  }
+}
+
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace Common {
+
+// Work units a client may spend, refilled at rate units per second up to burst. Work is charged after it is done, so
+// a costly request takes the balance below zero and the client waits until the debt is paid back before the next one.
+// Rate 0 means no limit.
+class TokenBucket {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  TokenBucket();
+  TokenBucket(uint64_t rate, uint64_t burst, Clock::time_point now);
+
+  bool isLimited() const;
+  void charge(uint64_t cost, Clock::time_point now);
+  // Time left until the balance is not negative
+  Clock::duration getDelay(Clock::time_point now);
+  // Bucket is refilled up to burst, the client has been idle long enough to be forgotten
+  bool isFull(Clock::time_point now);
+
+private:
+  void refill(Clock::time_point now);
+
+  double m_rate;
+  double m_burst;
+  double m_balance;
+  Clock::time_point m_updated;
+};
+
+}
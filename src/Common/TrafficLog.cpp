@@ -0,0 +1,145 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TrafficLog.h"
+
+#include <cstring>
+
+namespace Common {
+
+namespace {
+
+const char TRAFFIC_LOG_SIGNATURE[] = "CNTRAFF1";
+// Record fields before the strings: time, kind, flags, command, stream, url size, body size
+const size_t RECORD_HEADER_SIZE = 8 + 1 + 1 + 4 + 8 + 4 + 4;
+// Keeps damaged size fields from causing huge allocations
+const uint32_t MAX_FIELD_SIZE = 256 * 1024 * 1024;
+
+template <typename T>
+void append(std::string& buffer, T value) {
+  char bytes[sizeof(value)];
+  memcpy(bytes, &value, sizeof(value));
+  buffer.append(bytes, sizeof(value));
+}
+
+template <typename T>
+T extract(const char*& position) {
+  T value;
+  memcpy(&value, position, sizeof(value));
+  position += sizeof(value);
+  return value;
+}
+
+}
+
+TrafficLogWriter::TrafficLogWriter() : m_start(Clock::now()) {
+}
+
+bool TrafficLogWriter::open(const std::string& fileName) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_file.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!m_file) {
+    return false;
+  }
+
+  m_file.write(TRAFFIC_LOG_SIGNATURE, sizeof(TRAFFIC_LOG_SIGNATURE) - 1);
+  m_start = Clock::now();
+  return static_cast<bool>(m_file);
+}
+
+void TrafficLogWriter::write(uint8_t kind, uint8_t flags, uint32_t command, uint64_t stream, const std::string& url, const std::string& body) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_file.is_open()) {
+    return;
+  }
+
+  uint64_t time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_start).count());
+  m_buffer.clear();
+  append(m_buffer, time);
+  append(m_buffer, kind);
+  append(m_buffer, flags);
+  append(m_buffer, command);
+  append(m_buffer, stream);
+  append(m_buffer, static_cast<uint32_t>(url.size()));
+  append(m_buffer, static_cast<uint32_t>(body.size()));
+  m_buffer.append(url);
+  m_file.write(m_buffer.data(), m_buffer.size());
+  m_file.write(body.data(), body.size());
+}
+
+void TrafficLogWriter::close() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_file.is_open()) {
+    m_file.close();
+  }
+}
+
+bool TrafficLogReader::open(const std::string& fileName) {
+  m_file.open(fileName, std::ios::in | std::ios::binary);
+  char signature[sizeof(TRAFFIC_LOG_SIGNATURE) - 1];
+  m_file.read(signature, sizeof(signature));
+  m_failed = m_file.gcount() != sizeof(signature) || memcmp(signature, TRAFFIC_LOG_SIGNATURE, sizeof(signature)) != 0;
+  return !m_failed;
+}
+
+bool TrafficLogReader::read(TrafficRecord& record) {
+  if (m_failed) {
+    return false;
+  }
+
+  char header[RECORD_HEADER_SIZE];
+  m_file.read(header, sizeof(header));
+  if (m_file.gcount() == 0 && m_file.eof()) {
+    return false;
+  }
+
+  m_failed = true;
+  if (m_file.gcount() != sizeof(header)) {
+    return false;
+  }
+
+  const char* position = header;
+  record.time = extract<uint64_t>(position);
+  record.kind = extract<uint8_t>(position);
+  record.flags = extract<uint8_t>(position);
+  record.command = extract<uint32_t>(position);
+  record.stream = extract<uint64_t>(position);
+  uint32_t urlSize = extract<uint32_t>(position);
+  uint32_t bodySize = extract<uint32_t>(position);
+  if (urlSize > MAX_FIELD_SIZE || bodySize > MAX_FIELD_SIZE) {
+    return false;
+  }
+
+  record.url.resize(urlSize);
+  record.body.resize(bodySize);
+  if (urlSize != 0 && !m_file.read(&record.url[0], urlSize)) {
+    return false;
+  }
+
+  if (bodySize != 0 && !m_file.read(&record.body[0], bodySize)) {
+    return false;
+  }
+
+  m_failed = false;
+  return true;
+}
+
+bool TrafficLogReader::failed() const {
+  return m_failed;
+}
+
+}
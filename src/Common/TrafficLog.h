@@ -0,0 +1,86 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace Common {
+
+// One inbound message: a Levin command of a peer connection or an RPC request
+struct TrafficRecord {
+  enum Kind : uint8_t {
+    P2P = 1,
+    RPC = 2
+  };
+
+  enum Flags : uint8_t {
+    NOTIFY = 1,
+    RESPONSE = 2
+  };
+
+  // microseconds since recording started
+  uint64_t time;
+  uint8_t kind;
+  uint8_t flags;
+  // Levin command id, 0 for RPC
+  uint32_t command;
+  // messages of one stream were received on one connection, RPC ones from one client address
+  uint64_t stream;
+  // RPC url, empty for P2P
+  std::string url;
+  std::string body;
+};
+
+// Log starts with a signature, every record follows as fixed size fields and two length prefixed strings. Writing is
+// thread safe, records are appended in the order they were received.
+class TrafficLogWriter {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  TrafficLogWriter();
+  TrafficLogWriter(const TrafficLogWriter&) = delete;
+  TrafficLogWriter& operator=(const TrafficLogWriter&) = delete;
+
+  bool open(const std::string& fileName);
+  void write(uint8_t kind, uint8_t flags, uint32_t command, uint64_t stream, const std::string& url, const std::string& body);
+  void close();
+
+private:
+  std::mutex m_mutex;
+  std::ofstream m_file;
+  Clock::time_point m_start;
+  std::string m_buffer;
+};
+
+class TrafficLogReader {
+public:
+  bool open(const std::string& fileName);
+  // Returns false at the end of the log, failed() tells if it's truncated or damaged
+  bool read(TrafficRecord& record);
+  bool failed() const;
+
+private:
+  std::ifstream m_file;
+  bool m_failed = false;
+};
+
+}
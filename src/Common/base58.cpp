@@ -17,7 +17,9 @@
 
 #include "base58.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <string.h>
 #include <string>
 #include <vector>
 
@@ -119,18 +121,42 @@ namespace tools
         memcpy(data, reinterpret_cast<uint8_t*>(&num_be) + sizeof(uint64_t) - size, size);
       }
 
+      // 58^5 < 2^32, a full block is split into limbs of 5, 5 and 1 digits
+      const uint32_t limb_digits = 5;
+      const uint32_t limb_base = 58 * 58 * 58 * 58 * 58;
+
+      void encode_limb(uint32_t limb, size_t count, char* res)
+      {
+        for (size_t i = count; 0 < i; --i)
+        {
+          res[i - 1] = alphabet[limb % alphabet_size];
+          limb /= alphabet_size;
+        }
+      }
+
       void encode_block(const char* block, size_t size, char* res)
       {
         assert(1 <= size && size <= full_block_size);
 
         uint64_t num = uint_8be_to_64(reinterpret_cast<const uint8_t*>(block), size);
-        int i = static_cast<int>(encoded_block_sizes[size]) - 1;
-        while (0 < num)
+        size_t count = encoded_block_sizes[size];
+
+        // Digits of every limb come from 32-bit divisions independent of other limbs
+        uint32_t low = static_cast<uint32_t>(num % limb_base);
+        num /= limb_base;
+        uint32_t middle = static_cast<uint32_t>(num % limb_base);
+        uint32_t high = static_cast<uint32_t>(num / limb_base);
+
+        size_t low_count = std::min<size_t>(count, limb_digits);
+        encode_limb(low, low_count, res + count - low_count);
+        if (count > limb_digits)
         {
-          uint64_t remainder = num % alphabet_size;
-          num /= alphabet_size;
-          res[i] = alphabet[remainder];
-          --i;
+          size_t middle_count = std::min<size_t>(count - limb_digits, limb_digits);
+          encode_limb(middle, middle_count, res + count - limb_digits - middle_count);
+          if (count > 2 * limb_digits)
+          {
+            encode_limb(high, count - 2 * limb_digits, res);
+          }
         }
       }
 
@@ -142,21 +168,31 @@ namespace tools
         if (res_size <= 0)
           return false; // Invalid block size
 
+        // 58^10 < 2^64, only the last digit of a full block may overflow
+        size_t plain_size = std::min<size_t>(size, full_encoded_block_size - 1);
         uint64_t res_num = 0;
-        uint64_t order = 1;
-        for (size_t i = size - 1; i < size; --i)
+        for (size_t i = 0; i < plain_size; ++i)
         {
           int digit = reverse_alphabet::instance(block[i]);
           if (digit < 0)
             return false; // Invalid symbol
 
+          res_num = res_num * alphabet_size + static_cast<uint64_t>(digit);
+        }
+
+        if (plain_size < size)
+        {
+          int digit = reverse_alphabet::instance(block[plain_size]);
+          if (digit < 0)
+            return false; // Invalid symbol
+
           uint64_t product_hi;
-          uint64_t tmp = res_num + mul128(order, digit, &product_hi);
-          if (tmp < res_num || 0 != product_hi)
+          uint64_t product = mul128(res_num, alphabet_size, &product_hi);
+          uint64_t tmp = product + static_cast<uint64_t>(digit);
+          if (tmp < product || 0 != product_hi)
             return false; // Overflow
 
           res_num = tmp;
-          order *= alphabet_size; // Never overflows, 58^10 < 2^64
         }
 
         if (static_cast<size_t>(res_size) < full_block_size && (UINT64_C(1) << (8 * res_size)) <= res_num)
@@ -168,61 +204,122 @@ namespace tools
       }
     }
 
-    std::string encode(const std::string& data)
+    size_t encoded_size(size_t size)
     {
-      if (data.empty())
-        return std::string();
-
-      size_t full_block_count = data.size() / full_block_size;
-      size_t last_block_size = data.size() % full_block_size;
-      size_t res_size = full_block_count * full_encoded_block_size + encoded_block_sizes[last_block_size];
+      return size / full_block_size * full_encoded_block_size + encoded_block_sizes[size % full_block_size];
+    }
 
-      std::string res(res_size, alphabet[0]);
+    void encode(const void* data, size_t size, char* res)
+    {
+      const char* block = static_cast<const char*>(data);
+      size_t full_block_count = size / full_block_size;
+      size_t last_block_size = size % full_block_size;
       for (size_t i = 0; i < full_block_count; ++i)
       {
-        encode_block(data.data() + i * full_block_size, full_block_size, &res[i * full_encoded_block_size]);
+        encode_block(block + i * full_block_size, full_block_size, res + i * full_encoded_block_size);
       }
 
       if (0 < last_block_size)
       {
-        encode_block(data.data() + full_block_count * full_block_size, last_block_size, &res[full_block_count * full_encoded_block_size]);
+        encode_block(block + full_block_count * full_block_size, last_block_size, res + full_block_count * full_encoded_block_size);
       }
-
-      return res;
     }
 
-    bool decode(const std::string& enc, std::string& data)
+    bool decode(const char* enc, size_t enc_size, void* data, size_t capacity, size_t& size)
     {
-      if (enc.empty())
-      {
-        data.clear();
-        return true;
-      }
-
-      size_t full_block_count = enc.size() / full_encoded_block_size;
-      size_t last_block_size = enc.size() % full_encoded_block_size;
+      size_t full_block_count = enc_size / full_encoded_block_size;
+      size_t last_block_size = enc_size % full_encoded_block_size;
       int last_block_decoded_size = decoded_block_sizes::instance(last_block_size);
       if (last_block_decoded_size < 0)
         return false; // Invalid enc length
-      size_t data_size = full_block_count * full_block_size + last_block_decoded_size;
+      size = full_block_count * full_block_size + last_block_decoded_size;
+      if (size > capacity)
+        return false;
 
-      data.resize(data_size, 0);
+      char* res = static_cast<char*>(data);
       for (size_t i = 0; i < full_block_count; ++i)
       {
-        if (!decode_block(enc.data() + i * full_encoded_block_size, full_encoded_block_size, &data[i * full_block_size]))
+        if (!decode_block(enc + i * full_encoded_block_size, full_encoded_block_size, res + i * full_block_size))
           return false;
       }
 
       if (0 < last_block_size)
       {
-        if (!decode_block(enc.data() + full_block_count * full_encoded_block_size, last_block_size,
-          &data[full_block_count * full_block_size]))
+        if (!decode_block(enc + full_block_count * full_encoded_block_size, last_block_size, res + full_block_count * full_block_size))
           return false;
       }
 
       return true;
     }
 
+    std::string encode(const std::string& data)
+    {
+      if (data.empty())
+        return std::string();
+
+      std::string res(encoded_size(data.size()), alphabet[0]);
+      encode(data.data(), data.size(), &res[0]);
+      return res;
+    }
+
+    bool decode(const std::string& enc, std::string& data)
+    {
+      if (enc.empty())
+      {
+        data.clear();
+        return true;
+      }
+
+      size_t data_size = (enc.size() / full_encoded_block_size + 1) * full_block_size;
+      data.resize(data_size, 0);
+      if (!decode(enc.data(), enc.size(), &data[0], data.size(), data_size))
+        return false;
+
+      data.resize(data_size);
+      return true;
+    }
+
+    bool encode_addr(uint64_t tag, const void* data, size_t size, addr_buffer& addr)
+    {
+      char buf[max_addr_size];
+      char* end = buf;
+      write_varint(end, tag);
+      size_t buf_size = static_cast<size_t>(end - buf) + size + addr_checksum_size;
+      if (buf_size > max_addr_size || encoded_size(buf_size) > max_addr_size)
+        return false;
+
+      memcpy(end, data, size);
+      end += size;
+      crypto::hash hash = crypto::cn_fast_hash(buf, end - buf);
+      memcpy(end, &hash, addr_checksum_size);
+
+      addr.resize(encoded_size(buf_size));
+      encode(buf, buf_size, addr.getData());
+      return true;
+    }
+
+    bool decode_addr(const char* addr, size_t addr_size, uint64_t& tag, void* data, size_t capacity, size_t& size)
+    {
+      char buf[max_addr_size];
+      size_t buf_size;
+      if (addr_size > max_addr_size || !decode(addr, addr_size, buf, sizeof(buf), buf_size))
+        return false;
+      if (buf_size <= addr_checksum_size) return false;
+
+      buf_size -= addr_checksum_size;
+      crypto::hash hash = crypto::cn_fast_hash(buf, buf_size);
+      if (memcmp(&hash, buf + buf_size, addr_checksum_size) != 0) return false;
+
+      int read = tools::read_varint(static_cast<const char*>(buf), static_cast<const char*>(buf) + buf_size, tag);
+      if (read <= 0) return false;
+
+      size = buf_size - read;
+      if (size > capacity) return false;
+
+      memcpy(data, buf + read, size);
+      return true;
+    }
+
     std::string encode_addr(uint64_t tag, const std::string& data)
     {
       std::string buf = get_varint_data(tag);
@@ -20,14 +20,28 @@
 #include <cstdint>
 #include <string>
 
+#include "StringBuffer.h"
+
 namespace tools
 {
   namespace base58
   {
+    // Fits an address with two public keys, any tag and checksum
+    const size_t max_addr_size = 128;
+    typedef Common::StringBuffer<max_addr_size> addr_buffer;
+
     std::string encode(const std::string& data);
     bool decode(const std::string& enc, std::string& data);
 
     std::string encode_addr(uint64_t tag, const std::string& data);
     bool decode_addr(std::string addr, uint64_t& tag, std::string& data);
+
+    // Buffer versions do not allocate, 'res' of encode must hold 'encoded_size(size)' characters
+    size_t encoded_size(size_t size);
+    void encode(const void* data, size_t size, char* res);
+    bool decode(const char* enc, size_t enc_size, void* data, size_t capacity, size_t& size);
+
+    bool encode_addr(uint64_t tag, const void* data, size_t size, addr_buffer& addr);
+    bool decode_addr(const char* addr, size_t addr_size, uint64_t& tag, void* data, size_t capacity, size_t& size);
   }
 }
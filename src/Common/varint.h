@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <sstream>
 #include <string>
@@ -72,4 +74,60 @@ namespace tools {
     int read_varint(InputIt &&first, InputIt &&last, T &i) {
         return read_varint<std::numeric_limits<T>::digits, InputIt, T>(std::move(first), std::move(last), i);
     }
+
+    // Decodes a varint from a contiguous buffer, returns the number of bytes taken or 0 if the varint is cut off by the
+    // end of the buffer, overflows or isn't canonical, the caller reads it again with read_varint to handle these.
+    // Values of one and two bytes (sizes, versions, most key offsets) are taken without a loop, longer ones are
+    // measured by their terminating byte first and then assembled without checking each byte for the end.
+    template<int bits, typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && 8 <= bits && bits <= std::numeric_limits<T>::digits, size_t>::type
+    read_varint_buffer(const unsigned char *first, const unsigned char *last, T &i) {
+        size_t available = last - first;
+        if (available != 0 && first[0] < 0x80) {
+            i = static_cast<T>(first[0]);
+            return 1;
+        }
+
+        if (available < 2) {
+            return 0;
+        }
+
+        if (first[1] < 0x80) {
+            uint64_t value = static_cast<uint64_t>(first[0] & 0x7f) | static_cast<uint64_t>(first[1]) << 7;
+            if (first[1] == 0 || (bits < 14 && (value >> (bits < 14 ? bits : 0)) != 0)) {
+                return 0;
+            }
+
+            i = static_cast<T>(value);
+            return 2;
+        }
+
+        const size_t maxSize = (bits + 6) / 7;
+        size_t size = 2;
+        while (size < available && size < maxSize && first[size] >= 0x80) {
+            ++size;
+        }
+
+        if (size == available || size == maxSize || first[size] == 0) {
+            return 0;
+        }
+
+        ++size;
+        if (size == maxSize && first[size - 1] >= 1 << (bits - 7 * (maxSize - 1))) {
+            return 0;
+        }
+
+        uint64_t value = 0;
+        for (size_t j = size; j != 0; --j) {
+            value = (value << 7) | (first[j - 1] & 0x7f);
+        }
+
+        i = static_cast<T>(value);
+        return size;
+    }
+
+    template<typename T>
+    size_t read_varint_buffer(const unsigned char *first, const unsigned char *last, T &i) {
+        return read_varint_buffer<std::numeric_limits<T>::digits, T>(first, last, i);
+    }
 }
@@ -37,7 +37,9 @@ namespace CryptoNote {
 HttpResponse::HTTP_STATUS HttpParser::parseResponseStatusFromString(const std::string& status) {
   if (status == "200 OK" || status == "200 Ok") return CryptoNote::HttpResponse::STATUS_200;
   else if (status == "404 Not Found") return CryptoNote::HttpResponse::STATUS_404;
+  else if (status == "429 Too Many Requests") return CryptoNote::HttpResponse::STATUS_429;
   else if (status == "500 Internal Server Error") return CryptoNote::HttpResponse::STATUS_500;
+  else if (status == "503 Service Unavailable") return CryptoNote::HttpResponse::STATUS_503;
   else throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL),
       "Unknown HTTP status code is given");
 
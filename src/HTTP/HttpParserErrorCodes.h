@@ -44,7 +44,8 @@ enum HttpParserErrorCodes {
   STREAM_NOT_GOOD = 1,
   END_OF_STREAM,
   UNEXPECTED_SYMBOL,
-  EMPTY_HEADER
+  EMPTY_HEADER,
+  MESSAGE_TOO_LARGE
 };
 
 // custom category:
@@ -66,6 +67,7 @@ public:
       case END_OF_STREAM: return "The stream is ended";
       case UNEXPECTED_SYMBOL: return "Unexpected symbol";
       case EMPTY_HEADER: return "The header name is empty";
+      case MESSAGE_TOO_LARGE: return "The message is too large";
       default: return "Unknown error";
     }
   }
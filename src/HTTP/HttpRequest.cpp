@@ -35,6 +35,10 @@ namespace CryptoNote {
     return body;
   }
 
+  uint32_t HttpRequest::getPeerAddress() const {
+    return peerAddress;
+  }
+
   void HttpRequest::addHeader(const std::string& name, const std::string& value) {
     headers[name] = value;
   }
@@ -52,6 +56,10 @@ namespace CryptoNote {
     url = u;
   }
 
+  void HttpRequest::setPeerAddress(uint32_t address) {
+    peerAddress = address;
+  }
+
   std::ostream& HttpRequest::printHttpRequest(std::ostream& os) const {
     os << "POST " << url << " HTTP/1.1\r\n";
     auto host = headers.find("Host");
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <string>
@@ -30,18 +31,23 @@ namespace CryptoNote {
     const std::string& getUrl() const;
     const Headers& getHeaders() const;
     const std::string& getBody() const;
+    // IPv4 address of the client in host byte order, 0 if unknown or not an IP client
+    uint32_t getPeerAddress() const;
 
     void addHeader(const std::string& name, const std::string& value);
     void setBody(const std::string& b);
     void setUrl(const std::string& uri);
+    void setPeerAddress(uint32_t address);
 
   private:
     friend class HttpParser;
+    friend class HttpStreamParser;
 
     std::string method;
     std::string url;
     Headers headers;
     std::string body;
+    uint32_t peerAddress = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const HttpRequest& resp);
     std::ostream& printHttpRequest(std::ostream& os) const;
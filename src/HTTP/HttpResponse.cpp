@@ -17,8 +17,11 @@
 
 #include "HttpResponse.h"
 
+#include <cctype>
 #include <stdexcept>
 
+#include "Common/Deflate.h"
+
 namespace {
 
 const char* getStatusString(CryptoNote::HttpResponse::HTTP_STATUS status) {
@@ -27,8 +30,12 @@ const char* getStatusString(CryptoNote::HttpResponse::HTTP_STATUS status) {
     return "200 OK";
   case CryptoNote::HttpResponse::STATUS_404:
     return "404 Not Found";
+  case CryptoNote::HttpResponse::STATUS_429:
+    return "429 Too Many Requests";
   case CryptoNote::HttpResponse::STATUS_500:
     return "500 Internal Server Error";
+  case CryptoNote::HttpResponse::STATUS_503:
+    return "503 Service Unavailable";
   default:
     throw std::runtime_error("Unknown HTTP status code is given");
   }
@@ -40,8 +47,12 @@ const char* getErrorBody(CryptoNote::HttpResponse::HTTP_STATUS status) {
   switch (status) {
   case CryptoNote::HttpResponse::STATUS_404:
     return "Requested url is not found\n";
+  case CryptoNote::HttpResponse::STATUS_429:
+    return "Too many requests, try again later\n";
   case CryptoNote::HttpResponse::STATUS_500:
     return "Internal server error is occured\n";
+  case CryptoNote::HttpResponse::STATUS_503:
+    return "Server is busy, try again later\n";
   default:
     throw std::runtime_error("Error body for given status is not available");
   }
@@ -49,6 +60,73 @@ const char* getErrorBody(CryptoNote::HttpResponse::HTTP_STATUS status) {
   return ""; //unaccessible
 }
 
+bool equalsIgnoreCase(const std::string& left, const std::string& right) {
+  if (left.size() != right.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < left.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(left[i])) != std::tolower(static_cast<unsigned char>(right[i]))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::string trim(const std::string& value) {
+  size_t begin = value.find_first_not_of(" \t");
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+
+  return value.substr(begin, value.find_last_not_of(" \t") + 1 - begin);
+}
+
+// Picks gzip over deflate, encodings with zero quality are refused
+bool chooseEncoding(const CryptoNote::HttpRequest& request, Common::DeflateEncoder::Format& format) {
+  bool gzip = false;
+  bool deflate = false;
+  for (auto& header : request.getHeaders()) {
+    if (!equalsIgnoreCase(header.first, "Accept-Encoding")) {
+      continue;
+    }
+
+    size_t begin = 0;
+    while (begin <= header.second.size()) {
+      size_t end = header.second.find(',', begin);
+      if (end == std::string::npos) {
+        end = header.second.size();
+      }
+
+      std::string item = header.second.substr(begin, end - begin);
+      begin = end + 1;
+      size_t parameters = item.find(';');
+      std::string coding = trim(item.substr(0, parameters));
+      if (parameters != std::string::npos) {
+        std::string quality = trim(item.substr(parameters + 1));
+        if (quality.size() > 2 && (quality[0] == 'q' || quality[0] == 'Q') && quality[1] == '=' &&
+          quality.find_first_not_of("0.", 2) == std::string::npos) {
+          continue;
+        }
+      }
+
+      if (equalsIgnoreCase(coding, "gzip") || coding == "*") {
+        gzip = true;
+      } else if (equalsIgnoreCase(coding, "deflate")) {
+        deflate = true;
+      }
+    }
+  }
+
+  if (!gzip && !deflate) {
+    return false;
+  }
+
+  format = gzip ? Common::DeflateEncoder::GZIP : Common::DeflateEncoder::ZLIB;
+  return true;
+}
+
 } //namespace
 
 namespace CryptoNote {
@@ -72,6 +150,8 @@ void HttpResponse::addHeader(const std::string& name, const std::string& value)
 
 void HttpResponse::setBody(const std::string& b) {
   body = b;
+  bodyProducer = nullptr;
+  headers.erase("Transfer-Encoding");
   if (!body.empty()) {
     headers["Content-Length"] = std::to_string(body.size());
   } else {
@@ -79,15 +159,80 @@ void HttpResponse::setBody(const std::string& b) {
   }
 }
 
-std::ostream& HttpResponse::printHttpResponse(std::ostream& os) const {
-  os << "HTTP/1.1 " << getStatusString(status) << "\r\n";
+void HttpResponse::setBodyProducer(BodyProducer producer) {
+  body.clear();
+  bodyProducer = std::move(producer);
+  headers.erase("Content-Length");
+  headers["Transfer-Encoding"] = "chunked";
+}
 
-  for (auto pair: headers) {
-    os << pair.first << ": " << pair.second << "\r\n";
+bool HttpResponse::compressBody(const HttpRequest& request, size_t minSize) {
+  Common::DeflateEncoder::Format format;
+  if (headers.count("Content-Encoding") != 0 || !chooseEncoding(request, format)) {
+    return false;
   }
-  os << "\r\n";
 
-  if (!body.empty()) {
+  if (bodyProducer) {
+    BodyProducer producer = std::move(bodyProducer);
+    setBodyProducer([producer, format](const ChunkWriter& writer) {
+      Common::DeflateEncoder encoder(format);
+      std::string compressed;
+      producer([&](const std::string& chunk) {
+        encoder.write(chunk.data(), chunk.size(), compressed);
+        if (!compressed.empty()) {
+          writer(compressed);
+          compressed.clear();
+        }
+      });
+
+      encoder.finish(compressed);
+      writer(compressed);
+    });
+  } else {
+    if (body.size() < minSize) {
+      return false;
+    }
+
+    Common::DeflateEncoder encoder(format);
+    std::string compressed;
+    encoder.write(body.data(), body.size(), compressed);
+    encoder.finish(compressed);
+    setBody(compressed);
+  }
+
+  headers["Content-Encoding"] = format == Common::DeflateEncoder::GZIP ? "gzip" : "deflate";
+  headers["Vary"] = "Accept-Encoding";
+  return true;
+}
+
+void HttpResponse::appendHead(std::string& head) const {
+  head += "HTTP/1.1 ";
+  head += getStatusString(status);
+  head += "\r\n";
+  for (auto& pair: headers) {
+    head += pair.first;
+    head += ": ";
+    head += pair.second;
+    head += "\r\n";
+  }
+
+  head += "\r\n";
+}
+
+std::ostream& HttpResponse::printHttpResponse(std::ostream& os) const {
+  std::string head;
+  appendHead(head);
+  os << head;
+  if (bodyProducer) {
+    // empty chunk would end the body
+    bodyProducer([&os](const std::string& chunk) {
+      if (!chunk.empty()) {
+        os << std::hex << chunk.size() << std::dec << "\r\n" << chunk << "\r\n";
+      }
+    });
+
+    os << "0\r\n\r\n";
+  } else if (!body.empty()) {
     os << body;
   }
 
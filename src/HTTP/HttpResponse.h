@@ -17,10 +17,13 @@
 
 #pragma once
 
+#include <functional>
 #include <ostream>
 #include <string>
 #include <map>
 
+#include "HttpRequest.h"
+
 namespace CryptoNote {
 
   class HttpResponse {
@@ -28,18 +31,33 @@ namespace CryptoNote {
     enum HTTP_STATUS {
       STATUS_200,
       STATUS_404,
-      STATUS_500
+      STATUS_429,
+      STATUS_500,
+      STATUS_503
     };
 
+    typedef std::function<void(const std::string& chunk)> ChunkWriter;
+    // Writes the body by pieces while the response is being sent
+    typedef std::function<void(const ChunkWriter& writer)> BodyProducer;
+
     HttpResponse();
 
     void setStatus(HTTP_STATUS s);
     void addHeader(const std::string& name, const std::string& value);
     void setBody(const std::string& b);
+    // Body is sent with chunked transfer encoding as the producer writes it instead of the stored one
+    void setBodyProducer(BodyProducer producer);
+    // Compresses the body with gzip or deflate if the request accepts either of them. Stored body shorter than minSize
+    // is left as is, produced one is compressed as it is written. Returns false if the body isn't compressed.
+    bool compressBody(const HttpRequest& request, size_t minSize);
 
     const std::map<std::string, std::string>& getHeaders() const { return headers; }
     HTTP_STATUS getStatus() const { return status; }
     const std::string& getBody() const { return body; }
+    const BodyProducer& getBodyProducer() const { return bodyProducer; }
+
+    // Appends status line and headers, the body can be sent after them without copying
+    void appendHead(std::string& head) const;
 
   private:
     friend std::ostream& operator<<(std::ostream& os, const HttpResponse& resp);
@@ -48,6 +66,7 @@ namespace CryptoNote {
     HTTP_STATUS status;
     std::map<std::string, std::string> headers;
     std::string body;
+    BodyProducer bodyProducer;
   };
 
   inline std::ostream& operator<<(std::ostream& os, const HttpResponse& resp) {
@@ -0,0 +1,411 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HttpStreamParser.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <string>
+
+#include "HttpParser.h"
+#include "HttpParserErrorCodes.h"
+
+using namespace Common;
+
+namespace CryptoNote {
+
+namespace {
+
+const size_t INITIAL_BUFFER_SIZE = 4096;
+const size_t MAX_HEADERS = 64;
+
+void throwError(error::HttpParserErrorCodes code) {
+  throw std::system_error(make_error_code(code));
+}
+
+StringView trim(StringView value) {
+  while (!value.isEmpty() && (value.first() == ' ' || value.first() == '\t')) {
+    value = value.unhead(1);
+  }
+
+  while (!value.isEmpty() && (value.last() == ' ' || value.last() == '\t')) {
+    value = value.untail(1);
+  }
+
+  return value;
+}
+
+bool equalsIgnoreCase(StringView left, StringView right) {
+  if (left.getSize() != right.getSize()) {
+    return false;
+  }
+
+  for (StringView::Size i = 0; i < left.getSize(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(left[i])) != std::tolower(static_cast<unsigned char>(right[i]))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+
+  return -1;
+}
+
+// Splits off the part before the first space, the rest is returned in tail
+StringView splitWord(StringView line, StringView& tail) {
+  StringView::Size space = line.find(' ');
+  if (space == StringView::INVALID || space == 0) {
+    throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+  }
+
+  tail = line.unhead(space + 1);
+  return line.head(space);
+}
+
+}
+
+HttpStreamParser::HttpStreamParser(size_t maxMessageSize) : m_maxMessageSize(maxMessageSize), m_size(0), m_scanned(0),
+  m_headSize(0), m_bodySize(0), m_chunkedSize(0), m_chunked(false), m_complete(false), m_request(false), m_method(StringView::NIL), m_url(StringView::NIL),
+  m_status(StringView::NIL), m_version(StringView::NIL) {
+}
+
+uint8_t* HttpStreamParser::getReadBuffer(size_t& size) {
+  if (m_size == m_buffer.size()) {
+    if (m_buffer.size() >= m_maxMessageSize) {
+      throwError(error::HttpParserErrorCodes::MESSAGE_TOO_LARGE);
+    }
+
+    // body size is known once the head is parsed, the buffer is grown for the whole message at once then
+    size_t bufferSize = std::max(INITIAL_BUFFER_SIZE, m_buffer.size() * 2);
+    if (m_headSize != 0 && !m_chunked) {
+      bufferSize = std::max(bufferSize, m_headSize + m_bodySize);
+    }
+
+    m_buffer.resize(std::min(bufferSize, m_maxMessageSize));
+    if (m_headSize != 0) {
+      // parsed slices pointed to the old buffer
+      parseHead();
+    }
+  }
+
+  size = m_buffer.size() - m_size;
+  return m_buffer.data() + m_size;
+}
+
+void HttpStreamParser::commit(size_t size) {
+  assert(size <= m_buffer.size() - m_size);
+  m_size += size;
+}
+
+bool HttpStreamParser::parseRequest() {
+  m_request = true;
+  return parse();
+}
+
+bool HttpStreamParser::parseResponse() {
+  m_request = false;
+  return parse();
+}
+
+void HttpStreamParser::consume() {
+  assert(m_complete);
+  size_t messageSize = m_chunked ? m_chunkedSize : m_headSize + m_bodySize;
+  assert(messageSize <= m_size);
+  std::memmove(m_buffer.data(), m_buffer.data() + messageSize, m_size - messageSize);
+  m_size -= messageSize;
+  resetMessage();
+}
+
+void HttpStreamParser::clear() {
+  m_size = 0;
+  resetMessage();
+}
+
+StringView HttpStreamParser::getMethod() const {
+  return m_method;
+}
+
+StringView HttpStreamParser::getUrl() const {
+  return m_url;
+}
+
+StringView HttpStreamParser::getStatus() const {
+  return m_status;
+}
+
+StringView HttpStreamParser::getVersion() const {
+  return m_version;
+}
+
+bool HttpStreamParser::keepAlive() const {
+  StringView connection = findHeader("Connection");
+  if (m_version == StringView("HTTP/1.1")) {
+    return connection.isNil() || !equalsIgnoreCase(connection, "close");
+  }
+
+  return !connection.isNil() && equalsIgnoreCase(connection, "keep-alive");
+}
+
+const std::vector<HttpStreamParser::Header>& HttpStreamParser::getHeaders() const {
+  return m_headers;
+}
+
+StringView HttpStreamParser::findHeader(StringView name) const {
+  for (const Header& header : m_headers) {
+    if (equalsIgnoreCase(header.name, name)) {
+      return header.value;
+    }
+  }
+
+  return StringView::NIL;
+}
+
+StringView HttpStreamParser::getBody() const {
+  assert(m_headSize != 0);
+  return StringView(reinterpret_cast<const char*>(m_buffer.data()) + m_headSize, m_bodySize);
+}
+
+void HttpStreamParser::getRequest(HttpRequest& request) const {
+  assert(m_headSize != 0);
+  request.method.assign(m_method.getData(), m_method.getSize());
+  request.url.assign(m_url.getData(), m_url.getSize());
+  request.headers.clear();
+  for (const Header& header : m_headers) {
+    request.headers[std::string(header.name)] = std::string(header.value);
+  }
+
+  StringView body = getBody();
+  request.body.assign(body.getData(), body.getSize());
+}
+
+void HttpStreamParser::getResponse(HttpResponse& response) const {
+  assert(m_headSize != 0);
+  response.setStatus(HttpParser::parseResponseStatusFromString(std::string(m_status)));
+  for (const Header& header : m_headers) {
+    response.addHeader(std::string(header.name), std::string(header.value));
+  }
+
+  response.setBody(std::string(getBody()));
+}
+
+bool HttpStreamParser::parse() {
+  if (m_headSize == 0) {
+    if (m_size == 0) {
+      return false;
+    }
+
+    // the end of the head may have been split between reads, the last bytes scanned are looked at again
+    size_t start = m_scanned < 3 ? 0 : m_scanned - 3;
+    StringView received(reinterpret_cast<const char*>(m_buffer.data()) + start, m_size - start);
+    StringView::Size position = received.find(StringView("\r\n\r\n"));
+    if (position == StringView::INVALID) {
+      m_scanned = m_size;
+      if (m_size >= m_maxMessageSize) {
+        throwError(error::HttpParserErrorCodes::MESSAGE_TOO_LARGE);
+      }
+
+      return false;
+    }
+
+    m_headSize = start + position + 4;
+    parseHead();
+    parseBodyLength();
+  }
+
+  if (!m_complete) {
+    m_complete = m_chunked ? parseChunks() : m_size >= m_headSize + m_bodySize;
+  }
+
+  return m_complete;
+}
+
+bool HttpStreamParser::parseChunks() {
+  for (;;) {
+    StringView pending(reinterpret_cast<const char*>(m_buffer.data()) + m_chunkedSize, m_size - m_chunkedSize);
+    StringView::Size lineEnd = pending.find(StringView("\r\n"));
+    if (lineEnd == StringView::INVALID) {
+      return false;
+    }
+
+    // chunk extensions after the size are ignored
+    StringView sizeLine = pending.head(lineEnd);
+    StringView::Size extension = sizeLine.find(';');
+    if (extension != StringView::INVALID) {
+      sizeLine = sizeLine.head(extension);
+    }
+
+    sizeLine = trim(sizeLine);
+    if (sizeLine.isEmpty()) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
+
+    size_t chunkSize = 0;
+    for (char c : sizeLine) {
+      int digit = hexDigit(c);
+      if (digit < 0) {
+        throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+      }
+
+      if (chunkSize > (m_maxMessageSize - digit) / 16) {
+        throwError(error::HttpParserErrorCodes::MESSAGE_TOO_LARGE);
+      }
+
+      chunkSize = chunkSize * 16 + digit;
+    }
+
+    if (chunkSize == 0) {
+      // the last chunk is followed by optional trailer headers and an empty line, trailers are dropped
+      StringView trailer = pending.unhead(lineEnd);
+      StringView::Size end = trailer.find(StringView("\r\n\r\n"));
+      if (end == StringView::INVALID) {
+        return false;
+      }
+
+      m_chunkedSize += lineEnd + end + 4;
+      return true;
+    }
+
+    if (chunkSize > m_maxMessageSize - m_headSize - m_bodySize) {
+      throwError(error::HttpParserErrorCodes::MESSAGE_TOO_LARGE);
+    }
+
+    size_t chunkEnd = lineEnd + 2 + chunkSize + 2;
+    if (pending.getSize() < chunkEnd) {
+      return false;
+    }
+
+    if (pending[chunkEnd - 2] != '\r' || pending[chunkEnd - 1] != '\n') {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
+
+    std::memmove(m_buffer.data() + m_headSize + m_bodySize, pending.getData() + lineEnd + 2, chunkSize);
+    m_bodySize += chunkSize;
+    m_chunkedSize += chunkEnd;
+  }
+}
+
+void HttpStreamParser::resetMessage() {
+  m_scanned = 0;
+  m_headSize = 0;
+  m_bodySize = 0;
+  m_chunkedSize = 0;
+  m_chunked = false;
+  m_complete = false;
+  m_method = StringView::NIL;
+  m_url = StringView::NIL;
+  m_status = StringView::NIL;
+  m_version = StringView::NIL;
+  m_headers.clear();
+}
+
+void HttpStreamParser::parseHead() {
+  // every line of the head ends with CRLF, the empty line after them is not included
+  StringView head(reinterpret_cast<const char*>(m_buffer.data()), m_headSize - 2);
+  StringView::Size lineEnd = head.find(StringView("\r\n"));
+  StringView startLine = head.head(lineEnd);
+  StringView lines = head.unhead(lineEnd + 2);
+  StringView tail;
+  if (m_request) {
+    m_method = splitWord(startLine, tail);
+    m_url = splitWord(tail, tail);
+    if (tail.isEmpty()) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
+
+    m_version = tail;
+  } else {
+    m_version = splitWord(startLine, tail);
+    m_status = tail;
+  }
+
+  m_headers.clear();
+  while (!lines.isEmpty()) {
+    lineEnd = lines.find(StringView("\r\n"));
+    StringView line = lines.head(lineEnd);
+    lines = lines.unhead(lineEnd + 2);
+
+    StringView::Size colon = line.find(':');
+    if (colon == StringView::INVALID) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
+
+    if (colon == 0) {
+      throwError(error::HttpParserErrorCodes::EMPTY_HEADER);
+    }
+
+    if (m_headers.size() == MAX_HEADERS) {
+      throwError(error::HttpParserErrorCodes::MESSAGE_TOO_LARGE);
+    }
+
+    m_headers.push_back(Header{ line.head(colon), trim(line.unhead(colon + 1)) });
+  }
+}
+
+void HttpStreamParser::parseBodyLength() {
+  StringView encoding = findHeader("Transfer-Encoding");
+  if (!encoding.isNil() && !equalsIgnoreCase(encoding, "identity")) {
+    if (!equalsIgnoreCase(encoding, "chunked")) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
+
+    m_chunked = true;
+    m_chunkedSize = m_headSize;
+    return;
+  }
+
+  m_bodySize = 0;
+  StringView length = findHeader("Content-Length");
+  if (!length.isNil()) {
+    if (length.isEmpty()) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
+
+    for (char c : length) {
+      if (c < '0' || c > '9') {
+        throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+      }
+
+      if (m_bodySize > (m_maxMessageSize - (c - '0')) / 10) {
+        throwError(error::HttpParserErrorCodes::MESSAGE_TOO_LARGE);
+      }
+
+      m_bodySize = m_bodySize * 10 + (c - '0');
+    }
+  }
+
+  if (m_bodySize > m_maxMessageSize - m_headSize) {
+    throwError(error::HttpParserErrorCodes::MESSAGE_TOO_LARGE);
+  }
+}
+
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Common/StringView.h>
+
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+namespace CryptoNote {
+
+// Incremental parser of HTTP messages received into one contiguous buffer. Caller reads from the connection into
+// getReadBuffer() and reports read bytes by commit() until parseRequest() or parseResponse() returns true. Parsed
+// slices point into the buffer and stay valid until consume(), which drops the message and keeps the bytes already
+// received after it. The buffer grows up to maxMessageSize and is reused by all messages of the connection.
+// Chunked bodies are decoded in place, the body of such a message is contiguous as well.
+// Parser errors are reported as std::system_error with HttpParserErrorCodes.
+class HttpStreamParser {
+public:
+  struct Header {
+    Common::StringView name;
+    Common::StringView value;
+  };
+
+  explicit HttpStreamParser(size_t maxMessageSize);
+
+  uint8_t* getReadBuffer(size_t& size);
+  void commit(size_t size);
+  bool parseRequest();
+  bool parseResponse();
+  void consume();
+  // Drops all received bytes, for example after reconnection
+  void clear();
+
+  Common::StringView getMethod() const;
+  Common::StringView getUrl() const;
+  Common::StringView getStatus() const;
+  Common::StringView getVersion() const;
+  // Whether the peer keeps the connection after this message, HTTP/1.1 does unless it sends "Connection: close"
+  bool keepAlive() const;
+  const std::vector<Header>& getHeaders() const;
+  // Header names are compared case-insensitively, returns NIL if there is no such header
+  Common::StringView findHeader(Common::StringView name) const;
+  Common::StringView getBody() const;
+
+  void getRequest(HttpRequest& request) const;
+  void getResponse(HttpResponse& response) const;
+
+private:
+  bool parse();
+  bool parseChunks();
+  void resetMessage();
+  void parseHead();
+  void parseBodyLength();
+
+  std::vector<uint8_t> m_buffer;
+  size_t m_maxMessageSize;
+  size_t m_size;
+  size_t m_scanned;
+  size_t m_headSize;
+  size_t m_bodySize;
+  // received bytes of a chunked message decoded so far, the decoded body is moved right after the head
+  size_t m_chunkedSize;
+  bool m_chunked;
+  bool m_complete;
+  bool m_request;
+  Common::StringView m_method;
+  Common::StringView m_url;
+  Common::StringView m_status;
+  Common::StringView m_version;
+  std::vector<Header> m_headers;
+};
+
+}
@@ -17,6 +17,7 @@
 
 #include "InProcessNode.h"
 
+#include <algorithm>
 #include <functional>
 #include <boost/utility/value_init.hpp>
 
@@ -27,10 +28,11 @@
 
 namespace CryptoNote {
 
-InProcessNode::InProcessNode(CryptoNote::ICore& core, CryptoNote::ICryptonoteProtocolQuery& protocol) :
+InProcessNode::InProcessNode(CryptoNote::ICore& core, CryptoNote::ICryptonoteProtocolQuery& protocol, size_t threadCount) :
     state(NOT_INITIALIZED),
     core(core),
-    protocol(protocol)
+    protocol(protocol),
+    threadCount(std::max<size_t>(threadCount, 1))
 {
 }
 
@@ -65,7 +67,12 @@ void InProcessNode::init(const Callback& callback) {
     core.addObserver(this);
 
     work.reset(new boost::asio::io_service::work(ioService));
-    workerThread.reset(new std::thread(&InProcessNode::workerFunc, this));
+    bulkWork.reset(new boost::asio::io_service::work(bulkIoService));
+    for (size_t i = 0; i < threadCount; ++i) {
+      workerThreads.emplace_back(&InProcessNode::workerFunc, this, std::ref(ioService));
+    }
+
+    workerThreads.emplace_back(&InProcessNode::workerFunc, this, std::ref(bulkIoService));
 
     state = INITIALIZED;
   }
@@ -88,14 +95,23 @@ bool InProcessNode::doShutdown() {
   state = NOT_INITIALIZED;
 
   work.reset();
+  bulkWork.reset();
   ioService.stop();
-  workerThread->join();
+  bulkIoService.stop();
+
+  // requests in progress still run on the core, which outlives the node
+  for (auto& thread : workerThreads) {
+    thread.join();
+  }
+
+  workerThreads.clear();
   ioService.reset();
+  bulkIoService.reset();
   return true;
 }
 
-void InProcessNode::workerFunc() {
-    ioService.run();
+void InProcessNode::workerFunc(boost::asio::io_service& service) {
+    service.run();
 }
 
 void InProcessNode::getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks,
@@ -108,7 +124,7 @@ void InProcessNode::getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::l
     return;
   }
 
-  ioService.post(
+  bulkIoService.post(
     std::bind(&InProcessNode::getNewBlocksAsync,
       this,
       std::move(knownBlockIds),
@@ -122,16 +138,11 @@ void InProcessNode::getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::l
 void InProcessNode::getNewBlocksAsync(std::list<crypto::hash>& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks,
     uint64_t& startHeight, const Callback& callback)
 {
-  std::error_code ec;
-  {
-    std::unique_lock<std::mutex> lock(mutex);
-    ec = doGetNewBlocks(std::move(knownBlockIds), newBlocks, startHeight);
-  }
+  std::error_code ec = doGetNewBlocks(std::move(knownBlockIds), newBlocks, startHeight);
 
   callback(ec);
 }
 
-//it's always protected with mutex
 std::error_code InProcessNode::doGetNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks, uint64_t& startHeight) {
   if (state != INITIALIZED) {
     return make_error_code(CryptoNote::error::NOT_INITIALIZED);
@@ -185,17 +196,44 @@ void InProcessNode::getTransactionOutsGlobalIndices(const crypto::hash& transact
 
 void InProcessNode::getTransactionOutsGlobalIndicesAsync(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices,
     const Callback& callback)
+{
+  std::error_code ec = doGetTransactionOutsGlobalIndices(transactionHash, outsGlobalIndices);
+
+  callback(ec);
+}
+
+void InProcessNode::getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes,
+    std::vector<std::vector<uint64_t>>& outsGlobalIndices, const Callback& callback)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (state != INITIALIZED) {
+    lock.unlock();
+    callback(make_error_code(CryptoNote::error::NOT_INITIALIZED));
+    return;
+  }
+
+  ioService.post(
+    std::bind(&InProcessNode::getTransactionsOutsGlobalIndicesAsync,
+      this,
+      std::move(transactionHashes),
+      std::ref(outsGlobalIndices),
+      callback
+    )
+  );
+}
+
+void InProcessNode::getTransactionsOutsGlobalIndicesAsync(std::vector<crypto::hash>& transactionHashes,
+    std::vector<std::vector<uint64_t>>& outsGlobalIndices, const Callback& callback)
 {
   std::error_code ec;
-  {
-    std::unique_lock<std::mutex> lock(mutex);
-    ec = doGetTransactionOutsGlobalIndices(transactionHash, outsGlobalIndices);
+  outsGlobalIndices.resize(transactionHashes.size());
+  for (size_t i = 0; i < transactionHashes.size() && !ec; ++i) {
+    ec = doGetTransactionOutsGlobalIndices(transactionHashes[i], outsGlobalIndices[i]);
   }
 
   callback(ec);
 }
 
-//it's always protected with mutex
 std::error_code InProcessNode::doGetTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices) {
   if (state != INITIALIZED) {
     return make_error_code(CryptoNote::error::NOT_INITIALIZED);
@@ -239,16 +277,11 @@ void InProcessNode::getRandomOutsByAmounts(std::vector<uint64_t>&& amounts, uint
 void InProcessNode::getRandomOutsByAmountsAsync(std::vector<uint64_t>& amounts, uint64_t outsCount,
   std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result, const Callback& callback)
 {
-  std::error_code ec;
-  {
-    std::unique_lock<std::mutex> lock(mutex);
-    ec = doGetRandomOutsByAmounts(std::move(amounts), outsCount, result);
-  }
+  std::error_code ec = doGetRandomOutsByAmounts(std::move(amounts), outsCount, result);
 
   callback(ec);
 }
 
-//it's always protected with mutex
 std::error_code InProcessNode::doGetRandomOutsByAmounts(std::vector<uint64_t>&& amounts, uint64_t outsCount, std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result) {
   if (state != INITIALIZED) {
     return make_error_code(CryptoNote::error::NOT_INITIALIZED);
@@ -294,16 +327,11 @@ void InProcessNode::relayTransaction(const CryptoNote::Transaction& transaction,
 }
 
 void InProcessNode::relayTransactionAsync(const CryptoNote::Transaction& transaction, const Callback& callback) {
-  std::error_code ec;
-  {
-    std::unique_lock<std::mutex> lock(mutex);
-    ec = doRelayTransaction(transaction);
-  }
+  std::error_code ec = doRelayTransaction(transaction);
 
   callback(ec);
 }
 
-//it's always protected with mutex
 std::error_code InProcessNode::doRelayTransaction(const CryptoNote::Transaction& transaction) {
   if (state != INITIALIZED) {
     return make_error_code(CryptoNote::error::NOT_INITIALIZED);
@@ -450,7 +478,7 @@ void InProcessNode::queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_
     return;
   }
 
-  ioService.post(
+  bulkIoService.post(
     std::bind(&InProcessNode::queryBlocksAsync,
       this,
       std::move(knownBlockIds),
@@ -465,29 +493,43 @@ void InProcessNode::queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_
 void InProcessNode::queryBlocksAsync(std::list<crypto::hash>& knownBlockIds, uint64_t timestamp,
   std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback)
 {
-  std::error_code ec;
-  {
-    std::unique_lock<std::mutex> lock(mutex);
-    ec = doQueryBlocks(std::move(knownBlockIds), timestamp, newBlocks, startHeight);
-  }
+  std::error_code ec = doQueryBlocks(std::move(knownBlockIds), timestamp, newBlocks, startHeight);
 
   callback(ec);
 }
 
+namespace {
+
+void appendBlockEntries(std::list<CryptoNote::BlockFullInfo>& entries, std::list<BlockCompleteEntry>& newBlocks) {
+  for (auto& entry: entries) {
+    BlockCompleteEntry bce;
+    bce.blockHash = entry.block_id;
+    bce.block = std::move(entry.block);
+    bce.txs = std::move(entry.txs);
+
+    newBlocks.push_back(std::move(bce));
+  }
+}
+
+}
+
+// blocks are handed over as objects, they aren't serialized here and parsed again by the synchronizer
 std::error_code InProcessNode::doQueryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp,
     std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight) {
   uint64_t currentHeight, fullOffset;
-  std::list<CryptoNote::BlockFullInfo> entries;
+  std::list<CryptoNote::BlockParsedInfo> entries;
 
-  if (!core.queryBlocks(knownBlockIds, timestamp, startHeight, currentHeight, fullOffset, entries)) {
+  if (!core.queryBlocksParsed(knownBlockIds, timestamp, startHeight, currentHeight, fullOffset, entries)) {
     return make_error_code(CryptoNote::error::INTERNAL_NODE_ERROR);
   }
 
-  for (const auto& entry: entries) {
+  for (auto& entry : entries) {
     BlockCompleteEntry bce;
-    bce.blockHash = entry.block_id;
-    bce.block = entry.block;
-    std::copy(entry.txs.begin(), entry.txs.end(), std::back_inserter(bce.txs));
+    bce.blockHash = entry.blockId;
+    if (entry.hasBlock) {
+      bce.parsedBlock = std::move(entry.block);
+      bce.parsedTxs = std::move(entry.txs);
+    }
 
     newBlocks.push_back(std::move(bce));
   }
@@ -495,6 +537,51 @@ std::error_code InProcessNode::doQueryBlocks(std::list<crypto::hash>&& knownBloc
   return std::error_code();
 }
 
+void InProcessNode::queryBlocksFiltered(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::vector<TrackingKey>&& trackingKeys,
+    std::vector<crypto::key_image>&& knownKeyImages, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (state != INITIALIZED) {
+    lock.unlock();
+    callback(make_error_code(CryptoNote::error::NOT_INITIALIZED));
+    return;
+  }
+
+  bulkIoService.post(
+    std::bind(&InProcessNode::queryBlocksFilteredAsync,
+      this,
+      std::move(knownBlockIds),
+      timestamp,
+      std::move(trackingKeys),
+      std::move(knownKeyImages),
+      std::ref(newBlocks),
+      std::ref(startHeight),
+      callback
+    )
+  );
+}
+
+void InProcessNode::queryBlocksFilteredAsync(std::list<crypto::hash>& knownBlockIds, uint64_t timestamp, std::vector<TrackingKey>& trackingKeys,
+  std::vector<crypto::key_image>& knownKeyImages, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback)
+{
+  std::error_code ec;
+  if (state != INITIALIZED) {
+    ec = make_error_code(CryptoNote::error::NOT_INITIALIZED);
+  }
+
+  if (!ec) {
+    uint64_t currentHeight, fullOffset;
+    std::list<CryptoNote::BlockFullInfo> entries;
+    if (core.queryBlocksFiltered(knownBlockIds, timestamp, trackingKeys, knownKeyImages, startHeight, currentHeight, fullOffset, entries)) {
+      appendBlockEntries(entries, newBlocks);
+    } else {
+      ec = make_error_code(CryptoNote::error::INTERNAL_NODE_ERROR);
+    }
+  }
+
+  callback(ec);
+}
+
 void InProcessNode::getPoolSymmetricDifference(std::vector<crypto::hash>&& knownPoolTxIds, crypto::hash knownBlockId, bool& isBcActual, std::vector<CryptoNote::Transaction>& newTxs,
   std::vector<crypto::hash>& deletedTxIds, const Callback& callback) {
 
@@ -521,13 +608,12 @@ void InProcessNode::getPoolSymmetricDifference(std::vector<crypto::hash>&& known
 void InProcessNode::getPoolSymmetricDifferenceAsync(std::vector<crypto::hash>& known_pool_tx_ids, crypto::hash known_block_id, bool& is_bc_actual, std::vector<CryptoNote::Transaction>& new_txs,
   std::vector<crypto::hash>& deleted_tx_ids, const Callback& callback) {
   std::error_code ec = std::error_code();
-
-  std::unique_lock<std::mutex> lock(mutex);
-  if (!core.getPoolSymmetricDifference(known_pool_tx_ids, known_block_id, is_bc_actual, new_txs, deleted_tx_ids)) {
+  if (state != INITIALIZED) {
+    ec = make_error_code(CryptoNote::error::NOT_INITIALIZED);
+  } else if (!core.getPoolSymmetricDifference(known_pool_tx_ids, known_block_id, is_bc_actual, new_txs, deleted_tx_ids)) {
     ec = make_error_code(CryptoNote::error::INTERNAL_NODE_ERROR);
   }
 
-  lock.unlock();
   callback(ec);
 }
 
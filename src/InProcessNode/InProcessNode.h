@@ -24,7 +24,9 @@
 #include "cryptonote_core/ICoreObserver.h"
 #include "Common/ObserverManager.h"
 
+#include <atomic>
 #include <thread>
+#include <vector>
 #include <boost/asio.hpp>
 
 namespace CryptoNote {
@@ -33,7 +35,10 @@ class core;
 
 class InProcessNode : public INode, public CryptoNote::ICryptonoteProtocolObserver, public CryptoNote::ICoreObserver {
 public:
-  InProcessNode(CryptoNote::ICore& core, CryptoNote::ICryptonoteProtocolQuery& protocol);
+  // Requests run on threadCount workers without holding the node lock. Blockchain sync queries (getNewBlocks, queryBlocks,
+  // queryBlocksFiltered) have a worker of their own, so a long scan never delays interactive requests such as
+  // getRandomOutsByAmounts or relayTransaction.
+  InProcessNode(CryptoNote::ICore& core, CryptoNote::ICryptonoteProtocolQuery& protocol, size_t threadCount = 2);
 
   InProcessNode(const InProcessNode&) = delete;
   InProcessNode(InProcessNode&&) = delete;
@@ -58,11 +63,15 @@ public:
 
   virtual void getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks, uint64_t& startHeight, const Callback& callback) override;
   virtual void getTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices, const Callback& callback) override;
+  virtual void getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices,
+      const Callback& callback) override;
   virtual void getRandomOutsByAmounts(std::vector<uint64_t>&& amounts, uint64_t outsCount,
       std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result, const Callback& callback) override;
   virtual void relayTransaction(const CryptoNote::Transaction& transaction, const Callback& callback) override;
   virtual void queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight,
       const Callback& callback) override;
+  virtual void queryBlocksFiltered(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::vector<TrackingKey>&& trackingKeys,
+      std::vector<crypto::key_image>&& knownKeyImages, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) override;
   virtual void getPoolSymmetricDifference(std::vector<crypto::hash>&& known_pool_tx_ids, crypto::hash known_block_id, bool& is_bc_actual, std::vector<CryptoNote::Transaction>& new_txs,
     std::vector<crypto::hash>& deleted_tx_ids, const Callback& callback) override;
 
@@ -78,6 +87,8 @@ private:
 
   void getTransactionOutsGlobalIndicesAsync(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices, const Callback& callback);
   std::error_code doGetTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices);
+  void getTransactionsOutsGlobalIndicesAsync(std::vector<crypto::hash>& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices,
+      const Callback& callback);
 
   void getRandomOutsByAmountsAsync(std::vector<uint64_t>& amounts, uint64_t outsCount,
       std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result, const Callback& callback);
@@ -91,10 +102,13 @@ private:
       const Callback& callback);
   std::error_code doQueryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight);
 
+  void queryBlocksFilteredAsync(std::list<crypto::hash>& knownBlockIds, uint64_t timestamp, std::vector<TrackingKey>& trackingKeys,
+      std::vector<crypto::key_image>& knownKeyImages, std::list<BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback);
+
   void getPoolSymmetricDifferenceAsync(std::vector<crypto::hash>& known_pool_tx_ids, crypto::hash known_block_id, bool& is_bc_actual, std::vector<CryptoNote::Transaction>& new_txs,
     std::vector<crypto::hash>& deleted_tx_ids, const Callback& callback);
 
-  void workerFunc();
+  void workerFunc(boost::asio::io_service& service);
   bool doShutdown();
 
   enum State {
@@ -102,14 +116,18 @@ private:
     INITIALIZED
   };
 
-  State state;
+  // changed under mutex, read by the workers without it
+  std::atomic<State> state;
   CryptoNote::ICore& core;
   CryptoNote::ICryptonoteProtocolQuery& protocol;
   tools::ObserverManager<INodeObserver> observerManager;
+  size_t threadCount;
 
   boost::asio::io_service ioService;
-  std::unique_ptr<std::thread> workerThread;
+  boost::asio::io_service bulkIoService;
+  std::vector<std::thread> workerThreads;
   std::unique_ptr<boost::asio::io_service::work> work;
+  std::unique_ptr<boost::asio::io_service::work> bulkWork;
 
   mutable std::mutex mutex;
 };
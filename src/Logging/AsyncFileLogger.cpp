@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "AsyncFileLogger.h"
+
+#include <cassert>
+#include <chrono>
+
+namespace Logging {
+
+namespace {
+
+// the writer sleeps while the queue is empty, logging threads don't signal it
+const std::chrono::milliseconds WRITER_IDLE_PERIOD(5);
+const size_t WRITER_SPIN_ROUNDS = 64;
+
+size_t roundUpToPowerOfTwo(size_t value) {
+  size_t result = 2;
+  while (result < value) {
+    result <<= 1;
+  }
+
+  return result;
+}
+
+}
+
+AsyncFileLogger::AsyncFileLogger(Level level, size_t capacity) :
+  FileLogger(level),
+  cells(new Cell[roundUpToPowerOfTwo(capacity)]),
+  mask(roundUpToPowerOfTwo(capacity) - 1),
+  enqueuePosition(0),
+  dequeuePosition(0),
+  stopping(false) {
+  for (size_t i = 0; i <= mask; ++i) {
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+AsyncFileLogger::~AsyncFileLogger() {
+  stopping = true;
+  if (writer.joinable()) {
+    writer.join();
+  }
+}
+
+void AsyncFileLogger::init(const std::string& filename) {
+  assert(!writer.joinable());
+  FileLogger::init(filename);
+  writer = std::thread(&AsyncFileLogger::writerProcedure, this);
+}
+
+// bounded multi-producer queue: a cell is free for position p when its sequence is p, filled when it is p + 1
+void AsyncFileLogger::doLogString(const std::string& message) {
+  if (!writer.joinable()) {
+    return;
+  }
+
+  size_t position = enqueuePosition.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;) {
+    cell = &cells[position & mask];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if (sequence == position) {
+      if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (sequence < position) {
+      // the writer is a whole queue behind
+      std::this_thread::yield();
+      position = enqueuePosition.load(std::memory_order_relaxed);
+    } else {
+      position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->message = message;
+  cell->sequence.store(position + 1, std::memory_order_release);
+}
+
+void AsyncFileLogger::writerProcedure() {
+  size_t idleRounds = 0;
+  for (;;) {
+    // messages logged before stop was requested are all written
+    bool stop = stopping.load();
+    if (writeBatch() != 0) {
+      idleRounds = 0;
+      continue;
+    }
+
+    if (stop) {
+      break;
+    }
+
+    // a busy queue refills soon, an idle one doesn't need the writer
+    if (++idleRounds < WRITER_SPIN_ROUNDS) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(WRITER_IDLE_PERIOD);
+    }
+  }
+}
+
+size_t AsyncFileLogger::writeBatch() {
+  size_t count = 0;
+  for (;;) {
+    Cell& cell = cells[dequeuePosition & mask];
+    if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+      break;
+    }
+
+    if (stream != nullptr && stream->good()) {
+      writeText(cell.message);
+    }
+
+    cell.message.clear();
+    cell.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+    ++dequeuePosition;
+    ++count;
+  }
+
+  if (count != 0 && stream != nullptr) {
+    *stream << std::flush;
+  }
+
+  return count;
+}
+
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "FileLogger.h"
+
+namespace Logging {
+
+// File logger writing from a background thread. Messages formatted by the logging threads go through a bounded
+// lock-free queue, the writer thread takes them in batches and flushes the file once per batch. A logging thread
+// waits only when the queue is full.
+class AsyncFileLogger : public FileLogger {
+public:
+  AsyncFileLogger(Level level = DEBUGGING, size_t capacity = 1 << 14);
+  ~AsyncFileLogger();
+
+  void init(const std::string& filename);
+
+protected:
+  virtual void doLogString(const std::string& message) override;
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    std::string message;
+  };
+
+  void writerProcedure();
+  size_t writeBatch();
+
+  std::unique_ptr<Cell[]> cells;
+  const size_t mask;
+  std::atomic<size_t> enqueuePosition;
+  size_t dequeuePosition;
+  std::atomic<bool> stopping;
+  std::thread writer;
+};
+
+}
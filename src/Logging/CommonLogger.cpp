@@ -74,16 +74,23 @@ void CommonLogger::operator()(const std::string& category, Level level, boost::p
   }
 }
 
+bool CommonLogger::isEnabled(size_t categoryId, Level level) const {
+  return level <= logLevel.load(std::memory_order_relaxed) &&
+    (categoryId >= CATEGORY_SLOTS || !disabledCategoryIds[categoryId].load(std::memory_order_relaxed));
+}
+
 void CommonLogger::setPattern(const std::string& pattern) {
   this->pattern = pattern;
 }
 
 void CommonLogger::enableCategory(const std::string& category) {
   disabledCategories.erase(category);
+  setCategoryDisabled(category, false);
 }
 
 void CommonLogger::disableCategory(const std::string& category) {
   disabledCategories.insert(category);
+  setCategoryDisabled(category, true);
 }
 
 void CommonLogger::setMaxLevel(Level level) {
@@ -91,9 +98,37 @@ void CommonLogger::setMaxLevel(Level level) {
 }
 
 CommonLogger::CommonLogger(Level level) : logLevel(level), pattern("%D %T %L [%C] ") {
+  for (auto& disabled : disabledCategoryIds) {
+    disabled = false;
+  }
+}
+
+CommonLogger::CommonLogger(const CommonLogger& other) :
+  disabledCategories(other.disabledCategories), logLevel(other.logLevel.load()), pattern(other.pattern) {
+  for (size_t i = 0; i < CATEGORY_SLOTS; ++i) {
+    disabledCategoryIds[i] = other.disabledCategoryIds[i].load();
+  }
+}
+
+CommonLogger& CommonLogger::operator=(const CommonLogger& other) {
+  disabledCategories = other.disabledCategories;
+  for (size_t i = 0; i < CATEGORY_SLOTS; ++i) {
+    disabledCategoryIds[i] = other.disabledCategoryIds[i].load();
+  }
+
+  logLevel = other.logLevel.load();
+  pattern = other.pattern;
+  return *this;
 }
 
 void CommonLogger::doLogString(const std::string& message) {
 }
 
+void CommonLogger::setCategoryDisabled(const std::string& category, bool disabled) {
+  size_t categoryId = getCategoryId(category);
+  if (categoryId < CATEGORY_SLOTS) {
+    disabledCategoryIds[categoryId] = disabled;
+  }
+}
+
 }
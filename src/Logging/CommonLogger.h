@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <set>
 #include "ILogger.h"
 
@@ -26,6 +28,7 @@ class CommonLogger : public ILogger {
 public:
 
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override;
+  virtual bool isEnabled(size_t categoryId, Level level) const override;
   virtual void enableCategory(const std::string& category);
   virtual void disableCategory(const std::string& category);
   virtual void setMaxLevel(Level level);
@@ -33,12 +36,22 @@ public:
   void setPattern(const std::string& pattern);
 
 protected:
+  // Categories with ids past the table are only filtered by name
+  static const size_t CATEGORY_SLOTS = 256;
+
   std::set<std::string> disabledCategories;
-  Level logLevel;
+  std::array<std::atomic<bool>, CATEGORY_SLOTS> disabledCategoryIds;
+  std::atomic<Level> logLevel;
   std::string pattern;
 
   CommonLogger(Level level);
+  // atomics aren't copyable, their current values are copied
+  CommonLogger(const CommonLogger& other);
+  CommonLogger& operator=(const CommonLogger& other);
   virtual void doLogString(const std::string& message);
+
+private:
+  void setCategoryDisabled(const std::string& category, bool disabled);
 };
 
 }
@@ -16,6 +16,8 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ILogger.h"
+#include <mutex>
+#include <unordered_map>
 
 namespace Logging {
 
@@ -46,4 +48,12 @@ const std::array<std::string, 6> ILogger::LEVEL_NAMES = {
   "TRACE"}
 };
 
+size_t ILogger::getCategoryId(const std::string& category) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, size_t> ids;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return ids.emplace(category, ids.size()).first->second;
+}
+
 }
@@ -57,6 +57,12 @@ public:
   const static std::array<std::string, 6> LEVEL_NAMES;
 
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) = 0;
+
+  // Cheap check made before a message is formatted, a message passing it may still be dropped by operator()
+  virtual bool isEnabled(size_t categoryId, Level level) const = 0;
+
+  // Process wide id of the category name, ids are dense and start from 0
+  static size_t getCategoryId(const std::string& category);
 };
 
 }
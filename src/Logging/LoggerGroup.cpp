@@ -31,6 +31,20 @@ void LoggerGroup::removeLogger(ILogger& logger) {
   loggers.erase(std::remove(loggers.begin(), loggers.end(), &logger), loggers.end());
 }
 
+bool LoggerGroup::isEnabled(size_t categoryId, Level level) const {
+  if (!CommonLogger::isEnabled(categoryId, level)) {
+    return false;
+  }
+
+  for (auto& logger : loggers) {
+    if (logger->isEnabled(categoryId, level)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 void LoggerGroup::operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) {
   if (level <= logLevel && disabledCategories.count(category) == 0) {
     for (auto& logger : loggers) {
@@ -29,6 +29,7 @@ public:
   void addLogger(ILogger& logger);
   void removeLogger(ILogger& logger);
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override;
+  virtual bool isEnabled(size_t categoryId, Level level) const override;
 
 protected:
   std::vector<ILogger*> loggers;
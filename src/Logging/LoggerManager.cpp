@@ -16,9 +16,12 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "LoggerManager.h"
+#include <algorithm>
+#include <set>
 #include <thread>
 #include "ConsoleLogger.h"
 #include "FileLogger.h"
+#include "AsyncFileLogger.h"
 
 namespace Logging {
 
@@ -32,10 +35,22 @@ void LoggerManager::operator()(const std::string& category, Level level, boost::
   LoggerGroup::operator()(category, level, time, body);
 }
 
+// Filters of the loggers are folded into the own ones by configure, so the check doesn't walk them under the lock
+bool LoggerManager::isEnabled(size_t categoryId, Level level) const {
+  return CommonLogger::isEnabled(categoryId, level);
+}
+
 void LoggerManager::configure(const JsonValue& val) {
   std::unique_lock<std::mutex> lock(reconfigureLock);
   loggers.clear();
   LoggerGroup::loggers.clear();
+  for (const auto& category : loggersDisabledCategories) {
+    enableCategory(category);
+  }
+  loggersDisabledCategories.clear();
+
+  Level maxLoggerLevel = FATAL;
+  std::set<std::string> loggerCategories;
   Level globalLevel;
   if (val.count("globalLevel")) {
     auto levelVal = val("globalLevel");
@@ -79,6 +94,8 @@ void LoggerManager::configure(const JsonValue& val) {
           level = static_cast<Level>(loggerConfiguration("level").getInteger());
         }
 
+        maxLoggerLevel = std::max(maxLoggerLevel, level);
+
         std::string type = loggerConfiguration("type").getString();
         std::unique_ptr<Logging::CommonLogger> logger;
 
@@ -86,9 +103,15 @@ void LoggerManager::configure(const JsonValue& val) {
           logger.reset(new ConsoleLogger(level));
         } else if (type == "file") {
           std::string filename = loggerConfiguration("filename").getString();
-          auto fileLogger = new FileLogger(level);
-          fileLogger->init(filename);
-          logger.reset(fileLogger);
+          if (loggerConfiguration.count("async") && loggerConfiguration("async").getBool()) {
+            auto fileLogger = new AsyncFileLogger(level);
+            fileLogger->init(filename);
+            logger.reset(fileLogger);
+          } else {
+            auto fileLogger = new FileLogger(level);
+            fileLogger->init(filename);
+            logger.reset(fileLogger);
+          }
         } else {
           throw std::runtime_error("Unknown logger type: " + type);
         }
@@ -105,6 +128,7 @@ void LoggerManager::configure(const JsonValue& val) {
             auto categoryVal = disabledCategoriesVal[i];
             if (categoryVal.isString()) {
               logger->disableCategory(categoryVal.getString());
+              loggerCategories.insert(categoryVal.getString());
             }
           }
         }
@@ -118,10 +142,22 @@ void LoggerManager::configure(const JsonValue& val) {
   } else {
     throw std::runtime_error("loggers parameter missing");
   }
-  setMaxLevel(globalLevel);
+  setMaxLevel(std::min(globalLevel, maxLoggerLevel));
   for (const auto& category : globalDisabledCategories) {
     disableCategory(category);
   }
+
+  for (const auto& category : loggerCategories) {
+    size_t categoryId = getCategoryId(category);
+    bool disabledEverywhere = std::none_of(loggers.begin(), loggers.end(), [categoryId](const std::unique_ptr<CommonLogger>& logger) {
+      return logger->isEnabled(categoryId, FATAL);
+    });
+
+    if (disabledEverywhere && CommonLogger::isEnabled(categoryId, FATAL)) {
+      disableCategory(category);
+      loggersDisabledCategories.push_back(category);
+    }
+  }
 }
 
 }
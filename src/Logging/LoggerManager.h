@@ -30,9 +30,12 @@ public:
   LoggerManager();
   void configure(const Common::JsonValue& val);
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override;
+  virtual bool isEnabled(size_t categoryId, Level level) const override;
 
 private:
   std::vector<std::unique_ptr<CommonLogger>> loggers;
+  // categories disabled by configure because every logger disables them
+  std::vector<std::string> loggersDisabledCategories;
   std::mutex reconfigureLock;
 };
 
@@ -19,15 +19,19 @@
 
 namespace Logging {
 
-LoggerMessage::LoggerMessage(ILogger& logger, const std::string& category, Level level, const std::string& color)
+LoggerMessage::LoggerMessage(ILogger& logger, const std::string& category, Level level, const std::string& color, bool enabled)
   : std::ostream(this)
   , std::streambuf()
   , logger(logger)
-  , category(category)
+  , category(enabled ? category : std::string())
   , logLevel(level)
-  , message(color)
-  , timestamp(boost::posix_time::microsec_clock::local_time())
-  , gotText(false) {
+  , message(enabled ? color : std::string())
+  , timestamp(enabled ? boost::posix_time::microsec_clock::local_time() : boost::posix_time::ptime())
+  , gotText(false)
+  , enabled(enabled) {
+  if (!enabled) {
+    setstate(std::ios_base::badbit);
+  }
 }
 
 LoggerMessage::~LoggerMessage() {
@@ -45,7 +49,8 @@ LoggerMessage::LoggerMessage(LoggerMessage&& other)
   , logger(other.logger)
   , message(other.message)
   , timestamp(boost::posix_time::microsec_clock::local_time())
-  , gotText(false) {
+  , gotText(false)
+  , enabled(other.enabled) {
   this->set_rdbuf(this);
 }
 #else
@@ -57,7 +62,8 @@ LoggerMessage::LoggerMessage(LoggerMessage&& other)
   , logger(other.logger)
   , message(other.message)
   , timestamp(boost::posix_time::microsec_clock::local_time())
-  , gotText(false) {
+  , gotText(false)
+  , enabled(other.enabled) {
   if (this != &other) {
     _M_tie = nullptr;
     _M_streambuf = nullptr;
@@ -98,6 +104,10 @@ LoggerMessage::LoggerMessage(LoggerMessage&& other)
 #endif
 
 int LoggerMessage::sync() {
+  if (!enabled) {
+    return 0;
+  }
+
   logger(category, logLevel, timestamp, message);
   gotText = false;
   message = DEFAULT;
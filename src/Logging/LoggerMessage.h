@@ -24,12 +24,50 @@ namespace Logging {
 
 class LoggerMessage : public std::ostream, std::streambuf {
 public:
-  LoggerMessage(ILogger& logger, const std::string& category, Level level, const std::string& color);
+  // A disabled message is a bad stream, so nothing written to it gets formatted
+  LoggerMessage(ILogger& logger, const std::string& category, Level level, const std::string& color, bool enabled = true);
   ~LoggerMessage();
   LoggerMessage(const LoggerMessage&) = delete;
   LoggerMessage& operator=(const LoggerMessage&) = delete;
   LoggerMessage(LoggerMessage&& other);
 
+  // Skip the inserters altogether when the message is disabled, the bad stream state only covers the standard ones
+  template<typename T> friend LoggerMessage& operator<<(LoggerMessage& message, const T& value) {
+    if (message.enabled) {
+      static_cast<std::ostream&>(message) << value;
+    }
+
+    return message;
+  }
+
+  template<typename T> friend LoggerMessage& operator<<(LoggerMessage&& message, const T& value) {
+    return message << value;
+  }
+
+  friend LoggerMessage& operator<<(LoggerMessage& message, std::ostream& (*manipulator)(std::ostream&)) {
+    if (message.enabled) {
+      manipulator(message);
+    }
+
+    return message;
+  }
+
+  friend LoggerMessage& operator<<(LoggerMessage&& message, std::ostream& (*manipulator)(std::ostream&)) {
+    return message << manipulator;
+  }
+
+  friend LoggerMessage& operator<<(LoggerMessage& message, std::ios_base& (*manipulator)(std::ios_base&)) {
+    if (message.enabled) {
+      manipulator(message);
+    }
+
+    return message;
+  }
+
+  friend LoggerMessage& operator<<(LoggerMessage&& message, std::ios_base& (*manipulator)(std::ios_base&)) {
+    return message << manipulator;
+  }
+
 private:
   int sync() override;
   int overflow(int c) override;
@@ -40,6 +78,7 @@ private:
   ILogger& logger;
   boost::posix_time::ptime timestamp;
   bool gotText;
+  bool enabled;
 };
 
 }
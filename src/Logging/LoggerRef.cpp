@@ -19,11 +19,11 @@
 
 namespace Logging {
 
-LoggerRef::LoggerRef(ILogger& logger, const std::string& category) : logger(&logger), category(category) {
+LoggerRef::LoggerRef(ILogger& logger, const std::string& category) : logger(&logger), category(category), categoryId(ILogger::getCategoryId(category)) {
 }
 
 LoggerMessage LoggerRef::operator()(Level level, const std::string& color) const {
-  return LoggerMessage(*logger, category, level, color);
+  return LoggerMessage(*logger, category, level, color, logger->isEnabled(categoryId, level));
 }
 
 ILogger& LoggerRef::getLogger() const {
@@ -31,6 +31,7 @@ public:
 private:
   ILogger* logger;
   std::string category;
+  size_t categoryId;
 };
 
 }
@@ -34,17 +34,20 @@ void StreamLogger::attachToStream(std::ostream& stream) {
 void StreamLogger::doLogString(const std::string& message) {
   if (stream != nullptr && stream->good()) {
     std::lock_guard<std::mutex> lock(mutex);
-    bool readingText = true;
-    for (size_t charPos = 0; charPos < message.size(); ++charPos) {
-      if (message[charPos] == ILogger::COLOR_DELIMETER) {
-        readingText = !readingText;
-      } else if (readingText) {
-        *stream << message[charPos];
-      }
-    }
-
+    writeText(message);
     *stream << std::flush;
   }
 }
 
+void StreamLogger::writeText(const std::string& message) {
+  bool readingText = true;
+  for (size_t charPos = 0; charPos < message.size(); ++charPos) {
+    if (message[charPos] == ILogger::COLOR_DELIMETER) {
+      readingText = !readingText;
+    } else if (readingText) {
+      *stream << message[charPos];
+    }
+  }
+}
+
 }
@@ -30,6 +30,8 @@ public:
 
 protected:
   virtual void doLogString(const std::string& message) override;
+  // writes the message without color markers, the caller synchronizes and flushes
+  void writeText(const std::string& message);
 
 protected:
   std::ostream* stream;
@@ -16,10 +16,13 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Dispatcher.h"
+#include <System/DispatcherTracer.h>
 #include <cassert>
+#include <ctime>
 
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/timerfd.h>
 #include <ucontext.h>
 #include <unistd.h>
@@ -27,7 +30,33 @@
 
 namespace System {
 
-Dispatcher::Dispatcher() {
+namespace {
+
+// idle contexts above this count are freed when their procedures finish, memory of a connection spike is returned
+const std::size_t MAX_REUSABLE_CONTEXTS = 256;
+
+struct CoroutineContext {
+  ucontext_t context;
+  uint8_t* mapping;
+  std::size_t mappingSize;
+};
+
+void freeContext(void* context) {
+  CoroutineContext* coroutineContext = static_cast<CoroutineContext*>(context);
+  int result = munmap(coroutineContext->mapping, coroutineContext->mappingSize);
+  assert(result == 0);
+  delete coroutineContext;
+}
+
+}
+
+Dispatcher::Dispatcher() : Dispatcher(DEFAULT_STACK_SIZE) {
+}
+
+Dispatcher::Dispatcher(std::size_t stackSize) {
+  std::size_t pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  this->stackSize = (stackSize + pageSize - 1) / pageSize * pageSize;
+
   std::string message;
   epoll = ::epoll_create1(0);
   if (epoll == -1) {
@@ -51,9 +80,30 @@ Dispatcher::Dispatcher() {
         if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
           message = "epoll_ctl() failed, errno=" + std::to_string(errno);
         } else {
-          contextCount = 0;
-          *reinterpret_cast<pthread_mutex_t*>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
-          return;
+          timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+          if (timer == -1) {
+            message = "timerfd_create() fail errno=" + std::to_string(errno);
+          } else {
+            timerEventContext.writeContext = nullptr;
+            timerEventContext.readContext = nullptr;
+
+            epoll_event timerEpollEvent;
+            timerEpollEvent.events = EPOLLIN;
+            timerEpollEvent.data.ptr = &timerEventContext;
+
+            if (epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &timerEpollEvent) == -1) {
+              message = "epoll_ctl() failed, errno=" + std::to_string(errno);
+            } else {
+              contextCount = 0;
+              tracer = nullptr;
+              currentSite = nullptr;
+              timerArmedTime = 0;
+              return;
+            }
+
+            auto result = close(timer);
+            assert(result == 0);
+          }
         }
 
         auto result = close(remoteSpawnEvent);
@@ -72,49 +122,34 @@ Dispatcher::~Dispatcher() {
   assert(resumingContexts.empty());
   assert(reusableContexts.size() == contextCount);
   assert(spawningProcedures.empty());
-  assert(reusableContexts.size() == allocatedStacks.size());
   while (!reusableContexts.empty()) {
-    delete[] allocatedStacks.top();
-    allocatedStacks.pop();
-    delete static_cast<ucontext_t*>(reusableContexts.top());
+    freeContext(reusableContexts.top());
     reusableContexts.pop();
   }
 
-  while (!timers.empty()) {
-    int result = ::close(timers.top());
-    assert(result == 0);
-    timers.pop();
-  }
-
+  assert(timers.empty());
   auto result = close(epoll);
   assert(result == 0);
   result = close(remoteSpawnEvent);
   assert(result == 0);
-  result = pthread_mutex_destroy(reinterpret_cast<pthread_mutex_t*>(this->mutex));
+  result = close(timer);
   assert(result == 0);
 }
 
 void Dispatcher::clear() {
   while (!reusableContexts.empty()) {
-    delete[] allocatedStacks.top();
-    allocatedStacks.pop();
-    delete static_cast<ucontext_t*>(reusableContexts.top());
+    freeContext(reusableContexts.top());
     reusableContexts.pop();
     --contextCount;
   }
-
-  while (!timers.empty()) {
-    int result = ::close(timers.top());
-    if (result == -1) {
-      throw std::runtime_error("Dispatcher::clear, close failed, errno="  + std::to_string(errno));
-    }
-
-    timers.pop();
-  }
 }
 
 void Dispatcher::dispatch() {
   void* context;
+  if (tracer != nullptr) {
+    tracer->contextRan(std::chrono::steady_clock::now() - contextResumeTime, currentSite);
+  }
+
   for (;;) {
     if (!resumingContexts.empty()) {
       context = resumingContexts.front();
@@ -123,38 +158,36 @@ void Dispatcher::dispatch() {
     }
 
     epoll_event event;
+    std::chrono::steady_clock::time_point waitStart;
+    if (tracer != nullptr) {
+      waitStart = std::chrono::steady_clock::now();
+    }
+
     int count = epoll_wait(epoll, &event, 1, -1);
+    if (tracer != nullptr) {
+      tracer->eventsWaited(std::chrono::steady_clock::now() - waitStart);
+    }
+
     if (count == 1) {
       ContextPair *contextPair = static_cast<ContextPair*>(event.data.ptr);
-      if(((event.events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
+      if (contextPair == &timerEventContext) {
+        expireTimers();
+        continue;
+      }
+
+      if (contextPair == &eventContext) {
         uint64_t buf;
         auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
         if(transferred == -1) {
             throw std::runtime_error("Dispatcher::dispatch() read(remoteSpawnEvent) fail errno=" + std::to_string(errno));
         }
 
-        pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-        while (!remoteSpawningProcedures.empty()) {
-          spawn(std::move(remoteSpawningProcedures.front()));
-          remoteSpawningProcedures.pop();
-        }
-
-        pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-        continue;
-      }
-
-      if ((event.events & EPOLLOUT) != 0) {
-        context = contextPair->writeContext->context;
-        contextPair->writeContext->events = event.events;
-      } else if ((event.events & EPOLLIN) != 0) {
-        context = contextPair->readContext->context;
-        contextPair->readContext->events = event.events;
-      } else {
+        spawnRemoteProcedures();
         continue;
       }
 
-      assert(context != nullptr);
-      break;
+      resumeOperations(contextPair, event.events);
+      continue;
     }
 
     if (errno != EINTR) {
@@ -162,12 +195,20 @@ void Dispatcher::dispatch() {
     }
   }
 
+  if (tracer != nullptr) {
+    tracer->contextResumed(resumingContexts.size());
+    contextResumeTime = std::chrono::steady_clock::now();
+  }
+
   if (context != currentContext) {
+    const char* site = currentSite;
     ucontext_t* oldContext = static_cast<ucontext_t*>(currentContext);
     currentContext = context;
     if (swapcontext(oldContext, static_cast<ucontext_t *>(context)) == -1) {
       throw std::runtime_error("Dispatcher::dispatch()  swapcontext() failed, errno=" + std::to_string(errno));
     }
+
+    currentSite = site;
   }
 }
 
@@ -175,32 +216,68 @@ void* Dispatcher::getCurrentContext() const {
   return currentContext;
 }
 
+std::size_t Dispatcher::getRemoteSpawnQueueSize() const {
+  return remoteSpawningProcedures.size();
+}
+
 void Dispatcher::pushContext(void* context) {
   resumingContexts.push(context);
 }
 
 void Dispatcher::remoteSpawn(std::function<void()>&& procedure) {
-  pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-  remoteSpawningProcedures.push(std::move(procedure));
-  pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-  uint64_t one = 1;
-  auto transferred = write(remoteSpawnEvent, &one, sizeof one);
-  if(transferred == - 1) {
-    throw std::runtime_error("Dispatcher::remoteSpawn, write() failed errno = " + std::to_string(errno));
+  // dispatcher takes all queued procedures on one wakeup, only the first one of them has to signal it
+  if (remoteSpawningProcedures.push(std::move(procedure))) {
+    uint64_t one = 1;
+    auto transferred = write(remoteSpawnEvent, &one, sizeof one);
+    if(transferred == - 1) {
+      throw std::runtime_error("Dispatcher::remoteSpawn, write() failed errno = " + std::to_string(errno));
+    }
+  }
+}
+
+void Dispatcher::spawnRemoteProcedures() {
+  std::queue<std::function<void()>> procedures;
+  remoteSpawningProcedures.takeAll(procedures);
+
+  while (!procedures.empty()) {
+    spawn(std::move(procedures.front()));
+    procedures.pop();
   }
 }
 
 void Dispatcher::spawn(std::function<void()>&& procedure) {
+  spawn(std::move(procedure), nullptr);
+}
+
+void Dispatcher::spawn(std::function<void()>&& procedure, const char* site) {
   ucontext_t *context;
   if (reusableContexts.empty()) {
-    context = new ucontext_t;
+    std::size_t pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t mappingSize = stackSize + pageSize;
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("Dispatcher::spawn(), mmap() fail errno=" + std::to_string(errno));
+    }
+
+    // stack grows down, the guard page is at the lowest address
+    if (mprotect(mapping, pageSize, PROT_NONE) == -1) {
+      int error = errno;
+      munmap(mapping, mappingSize);
+      throw std::runtime_error("Dispatcher::spawn(), mprotect() fail errno=" + std::to_string(error));
+    }
+
+    CoroutineContext* coroutineContext = new CoroutineContext;
+    coroutineContext->mapping = static_cast<uint8_t*>(mapping);
+    coroutineContext->mappingSize = mappingSize;
+    context = &coroutineContext->context;
     if (getcontext(context) == -1) { //makecontext precondition
-      throw std::runtime_error("Dispatcher::spawn(), getcontext() fail errno=" + std::to_string(errno));
+      int error = errno;
+      freeContext(coroutineContext);
+      throw std::runtime_error("Dispatcher::spawn(), getcontext() fail errno=" + std::to_string(error));
     }
-    auto stackPointer = new uint8_t[64 * 1024];
-    context->uc_stack.ss_sp = stackPointer;
-    allocatedStacks.push(stackPointer);
-    context->uc_stack.ss_size = 64 * 1024;
+
+    context->uc_stack.ss_sp = coroutineContext->mapping + pageSize;
+    context->uc_stack.ss_size = stackSize;
     makecontext(context, (void(*)())contextProcedureStatic, 1, reinterpret_cast<int*>(this));
     ++contextCount;
   } else {
@@ -210,6 +287,12 @@ void Dispatcher::spawn(std::function<void()>&& procedure) {
 
   resumingContexts.push(context);
   spawningProcedures.emplace(std::move(procedure));
+  spawningSites.push(site);
+}
+
+void Dispatcher::setTracer(DispatcherTracer* tracer) {
+  this->tracer = tracer;
+  contextResumeTime = std::chrono::steady_clock::now();
 }
 
 void Dispatcher::yield() {
@@ -223,32 +306,23 @@ void Dispatcher::yield() {
     if(count > 0) {
       for(int i = 0; i < count; ++i) {
         ContextPair *contextPair = static_cast<ContextPair*>(events[i].data.ptr);
-        if(((events[i].events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
+        if (contextPair == &timerEventContext) {
+          expireTimers();
+          continue;
+        }
+
+        if (contextPair == &eventContext) {
           uint64_t buf;
           auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
           if(transferred == -1) {
             throw std::runtime_error("Dispatcher::dispatch() read(remoteSpawnEvent) fail errno=" + std::to_string(errno));
           }
 
-          pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-          while (!remoteSpawningProcedures.empty()) {
-            spawn(std::move(remoteSpawningProcedures.front()));
-            remoteSpawningProcedures.pop();
-          }
-
-          pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
+          spawnRemoteProcedures();
           continue;
         }
 
-        if ((events[i].events & EPOLLOUT) != 0) {
-          resumingContexts.push(contextPair->writeContext->context);
-          contextPair->writeContext->events = events[i].events;
-        } else if ((events[i].events & EPOLLIN) != 0) {
-          resumingContexts.push(contextPair->readContext->context);
-          contextPair->readContext->events = events[i].events;
-        } else {
-          continue;
-        }
+        resumeOperations(contextPair, events[i].events);
       }
     } else {
       if (errno != EINTR) {
@@ -263,31 +337,80 @@ void Dispatcher::yield() {
   }
 }
 
+void Dispatcher::addTimer(uint64_t time, void* context) {
+  timers.insert(std::make_pair(time, context));
+  if (timerArmedTime == 0 || time < timerArmedTime) {
+    armTimer(time);
+  }
+}
+
 int Dispatcher::getEpoll() const {
   return epoll;
 }
 
-int Dispatcher::getTimer() {
-  int timer;
-  if (timers.empty()) {
-    timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
-    epoll_event timerEvent;
-    timerEvent.events = 0;
-    timerEvent.data.ptr = nullptr;
-
-    if (epoll_ctl(getEpoll(), EPOLL_CTL_ADD, timer, &timerEvent) == -1) {
-      throw std::runtime_error("Dispatcher::getTimer(), epoll_ctl() failed, errno="  + std::to_string(errno));
+// Timerfd stays armed for an interrupted timer, it wakes dispatcher once for nothing then
+void Dispatcher::interruptTimer(uint64_t time, void* context) {
+  auto range = timers.equal_range(time);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == context) {
+      resumingContexts.push(context);
+      timers.erase(it);
+      break;
     }
-  } else {
-    timer = timers.top();
-    timers.pop();
+  }
+}
+
+void Dispatcher::armTimer(uint64_t time) {
+  itimerspec expires;
+  expires.it_interval.tv_sec = 0;
+  expires.it_interval.tv_nsec = 0;
+  expires.it_value.tv_sec = time / 1000000000;
+  expires.it_value.tv_nsec = time % 1000000000;
+  if (timerfd_settime(timer, TFD_TIMER_ABSTIME, &expires, nullptr) == -1) {
+    throw std::runtime_error("Dispatcher::armTimer, timerfd_settime() failed, errno=" + std::to_string(errno));
+  }
+
+  timerArmedTime = time;
+}
+
+void Dispatcher::expireTimers() {
+  uint64_t value;
+  if (read(timer, &value, sizeof value) == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+    throw std::runtime_error("Dispatcher::expireTimers, read() failed, errno=" + std::to_string(errno));
+  }
+
+  timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == -1) {
+    throw std::runtime_error("Dispatcher::expireTimers, clock_gettime() failed, errno=" + std::to_string(errno));
   }
 
-  return timer;
+  uint64_t currentTime = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  auto timerContextPair = timers.begin();
+  while (timerContextPair != timers.end() && timerContextPair->first <= currentTime) {
+    resumingContexts.push(timerContextPair->second);
+    timerContextPair = timers.erase(timerContextPair);
+  }
+
+  if (timers.empty()) {
+    timerArmedTime = 0;
+  } else {
+    armTimer(timers.begin()->first);
+  }
 }
 
-void Dispatcher::pushTimer(int timer) {
-  timers.push(timer);
+// Sockets may report readiness nobody waits for, only waiting operations are resumed and detached from the pair
+void Dispatcher::resumeOperations(ContextPair* contextPair, uint32_t events) {
+  if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0 && contextPair->writeContext != nullptr) {
+    contextPair->writeContext->events = events;
+    resumingContexts.push(contextPair->writeContext->context);
+    contextPair->writeContext = nullptr;
+  }
+
+  if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) != 0 && contextPair->readContext != nullptr) {
+    contextPair->readContext->events = events;
+    resumingContexts.push(contextPair->readContext->context);
+    contextPair->readContext = nullptr;
+  }
 }
 
 void Dispatcher::contextProcedure() {
@@ -296,7 +419,17 @@ void Dispatcher::contextProcedure() {
     assert(!spawningProcedures.empty());
     std::function<void()> procedure = std::move(spawningProcedures.front());
     spawningProcedures.pop();
+    currentSite = spawningSites.front();
+    spawningSites.pop();
     procedure();
+
+    // own stack can't be freed while running on it, another idle context is freed instead
+    if (reusableContexts.size() >= MAX_REUSABLE_CONTEXTS) {
+      freeContext(reusableContexts.top());
+      reusableContexts.pop();
+      --contextCount;
+    }
+
     reusableContexts.push(context);
     dispatch();
   }
@@ -17,24 +17,42 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <queue>
 #include <stack>
 
+#include <System/RemoteProcedureQueue.h>
+
 namespace System {
 
+class DispatcherTracer;
+
 class Dispatcher {
 public:
+  // Coroutine stacks have an inaccessible guard page below them, overflowing one crashes instead of corrupting memory
+  static const std::size_t DEFAULT_STACK_SIZE = 64 * 1024;
+
   Dispatcher();
+  explicit Dispatcher(std::size_t stackSize);
   Dispatcher(const Dispatcher&) = delete;
   ~Dispatcher();
   Dispatcher& operator=(const Dispatcher&) = delete;
   void clear();
   void dispatch();
   void* getCurrentContext() const;
+  // Procedures queued by remoteSpawn and not spawned yet, can be called from any thread
+  std::size_t getRemoteSpawnQueueSize() const;
   void pushContext(void* context);
   void remoteSpawn(std::function<void()>&& procedure);
   void spawn(std::function<void()>&& procedure);
+  // Site tags the procedure for tracing and must stay valid while the dispatcher exists, a string literal names it best
+  void spawn(std::function<void()>&& procedure, const char* site);
+  // Scheduling events are reported to the tracer until it is replaced or reset with nullptr
+  void setTracer(DispatcherTracer* tracer);
   void yield();
 
   struct OperationContext {
@@ -49,35 +67,37 @@ public:
   };
 
   // system-dependent
+  // Timers share one timerfd armed for the earliest of them, time is CLOCK_MONOTONIC in nanoseconds
+  void addTimer(uint64_t time, void* context);
   int getEpoll() const;
-  int getTimer();
-  void pushTimer(int timer);
-
-#ifdef __x86_64__
-# if __WORDSIZE == 64
-  static const int SIZEOF_PTHREAD_MUTEX_T = 40;
-# else
-  static const int SIZEOF_PTHREAD_MUTEX_T = 32
-# endif
-#else
-  static const int SIZEOF_PTHREAD_MUTEX_T = 24
-#endif
+  void interruptTimer(uint64_t time, void* context);
 
 private:
-  std::stack<uint8_t *> allocatedStacks;
   std::size_t contextCount;
   void* currentContext;
   int epoll;
   ContextPair eventContext;
-  uint8_t mutex[SIZEOF_PTHREAD_MUTEX_T];
   int remoteSpawnEvent;
-  std::queue<std::function<void()>> remoteSpawningProcedures;
+  RemoteProcedureQueue remoteSpawningProcedures;
   std::queue<void*> resumingContexts;
   std::stack<void*> reusableContexts;
   std::queue<std::function<void()>> spawningProcedures;
-  std::stack<int> timers;
+  std::queue<const char*> spawningSites;
+  std::size_t stackSize;
+  int timer;
+  uint64_t timerArmedTime;
+  ContextPair timerEventContext;
+  std::multimap<uint64_t, void*> timers;
+  DispatcherTracer* tracer;
+  // tag of the running context, contexts keep their own on the stack while switched out
+  const char* currentSite;
+  std::chrono::steady_clock::time_point contextResumeTime;
 
+  void armTimer(uint64_t time);
   void contextProcedure();
+  void expireTimers();
+  void resumeOperations(ContextPair* contextPair, uint32_t events);
+  void spawnRemoteProcedures();
   static void contextProcedureStatic(void* context);
 };
 
@@ -16,17 +16,26 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "TcpConnection.h"
+#include <algorithm>
 #include <cassert>
 
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <System/InterruptedException.h>
 #include <System/Ipv4Address.h>
 
 namespace System {
 
+namespace {
+
+const std::size_t MAX_WRITE_BUFFERS = 16;
+
+}
+
 TcpConnection::TcpConnection() : dispatcher(nullptr) {
 }
 
@@ -38,6 +47,7 @@ TcpConnection::TcpConnection(TcpConnection&& other) : dispatcher(other.dispatche
     stopped = other.stopped;
     contextPair = other.contextPair;
     other.dispatcher = nullptr;
+    registerConnection(EPOLL_CTL_MOD);
   }
 }
 
@@ -67,6 +77,7 @@ TcpConnection& TcpConnection::operator=(TcpConnection&& other) {
     stopped = other.stopped;
     contextPair = other.contextPair;
     other.dispatcher = nullptr;
+    registerConnection(EPOLL_CTL_MOD);
   }
 
   return *this;
@@ -81,23 +92,16 @@ void TcpConnection::start() {
 void TcpConnection::stop() {
   assert(dispatcher != nullptr);
   assert(!stopped);
-
-  epoll_event connectionEvent;
-  connectionEvent.events = 0;
-  connectionEvent.data.ptr = nullptr;
-
-  if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-    throw std::runtime_error("TcpConnection::stop, epoll_ctl() fail" + std::to_string(errno));
-  }
-
   if(contextPair.readContext != nullptr) {
     contextPair.readContext->interrupted = true;
     dispatcher->pushContext(contextPair.readContext->context);
+    contextPair.readContext = nullptr;
   }
 
   if(contextPair.writeContext != nullptr) {
     contextPair.writeContext->interrupted = true;
     dispatcher->pushContext(contextPair.writeContext->context);
+    contextPair.writeContext = nullptr;
   }
   
   stopped = true;
@@ -110,171 +114,125 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
     throw InterruptedException();
   }
 
-  std::string message;
-  ssize_t transferred = ::recv(connection, (void *)data, size, 0);
-  if (transferred == -1) {
+  for (;;) {
+    ssize_t transferred = ::recv(connection, (void *)data, size, 0);
+    if (transferred != -1) {
+      assert(transferred <= static_cast<ssize_t>(size));
+      return transferred;
+    }
+
     if (errno != EAGAIN  && errno != EWOULDBLOCK) {
-      message = "recv failed, errno=" + std::to_string(errno);
-    } else {
-      epoll_event connectionEvent;
-      Dispatcher::OperationContext operationContext;
-      operationContext.interrupted = false;
-      operationContext.context = dispatcher->getCurrentContext();
-      contextPair.readContext = &operationContext;
-      connectionEvent.data.ptr = &contextPair;
-
-      if(contextPair.writeContext != nullptr) {
-        connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
-      } else {
-        connectionEvent.events = EPOLLIN | EPOLLONESHOT;
-      }
-
-      if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-        message = "epoll_ctl() failed, errno=" + std::to_string(errno);
-      } else {
-        dispatcher->dispatch();
-        assert(dispatcher != nullptr);
-        assert(operationContext.context == dispatcher->getCurrentContext());
-        assert(contextPair.readContext == &operationContext);
-
-        if (operationContext.interrupted) {
-          contextPair.readContext = nullptr;
-          throw InterruptedException();
-        }
-
-        contextPair.readContext = nullptr;
-        if(contextPair.writeContext != nullptr) { //write is presented, rearm
-          epoll_event connectionEvent;
-          connectionEvent.events = EPOLLOUT | EPOLLONESHOT;
-          connectionEvent.data.ptr = &contextPair;
-
-          if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-            message = "epoll_ctl() failed, errno=" + std::to_string(errno);
-            throw std::runtime_error("TcpConnection::read");
-          }
-        }
-
-        if((operationContext.events & (EPOLLERR | EPOLLHUP)) != 0) {
-          throw std::runtime_error("TcpConnection::read");
-        }
-
-        ssize_t transferred = ::recv(connection, (void *)data, size, 0);
-        if (transferred == -1) {
-          message = "recv failed, errno=" + std::to_string(errno);
-        } else {
-          assert(transferred <= static_cast<ssize_t>(size));
-          return transferred;
-        }
-      }
+      throw std::runtime_error("TcpConnection::read, recv failed, errno=" + std::to_string(errno));
     }
 
-    throw std::runtime_error("TcpConnection::read, "+ message);
+    waitReadiness(contextPair.readContext);
   }
-
-  assert(transferred <= static_cast<ssize_t>(size));
-  return transferred;
 }
 
 std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    assert(dispatcher != nullptr);
+    assert(contextPair.writeContext == nullptr);
+    if (stopped) {
+      throw InterruptedException();
+    }
+
+    if (shutdown(connection, SHUT_WR) == -1) {
+      throw std::runtime_error("TcpConnection::write, shutdown failed, result=" + std::to_string(errno));
+    }
+
+    return 0;
+  }
+
+  Buffer buffer = { data, size };
+  return write(&buffer, 1);
+}
+
+std::size_t TcpConnection::write(const Buffer* buffers, std::size_t count) {
   assert(dispatcher != nullptr);
   assert(contextPair.writeContext == nullptr);
   if (stopped) {
     throw InterruptedException();
   }
 
-  std::string message;
-  if(size == 0) {
-    if(shutdown(connection, SHUT_WR) == -1) {
-      throw std::runtime_error("TcpConnection::write, shutdown failed, result=" + std::to_string(errno));
-    }
+  // buffers after MAX_WRITE_BUFFERS are left for the next call, as any data not sent at once
+  iovec vectors[MAX_WRITE_BUFFERS];
+  count = std::min(count, MAX_WRITE_BUFFERS);
+  size_t size = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    vectors[i].iov_base = const_cast<uint8_t*>(buffers[i].data);
+    vectors[i].iov_len = buffers[i].size;
+    size += buffers[i].size;
+  }
 
+  if (size == 0) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, MSG_NOSIGNAL);
-  if (transferred == -1) {
+  msghdr header = {};
+  header.msg_iov = vectors;
+  header.msg_iovlen = count;
+  for (;;) {
+    ssize_t transferred = ::sendmsg(connection, &header, MSG_NOSIGNAL);
+    if (transferred != -1) {
+      assert(transferred <= static_cast<ssize_t>(size));
+      return transferred;
+    }
+
     if (errno != EAGAIN  && errno != EWOULDBLOCK) {
-      message = "send failed, result=" + std::to_string(errno);
-    } else {
-      epoll_event connectionEvent;
-      Dispatcher::OperationContext operationContext;
-      operationContext.interrupted = false;
-      operationContext.context = dispatcher->getCurrentContext();
-      contextPair.writeContext = &operationContext;
-      connectionEvent.data.ptr = &contextPair;
-
-      if(contextPair.readContext != nullptr) {
-        connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
-      } else {
-        connectionEvent.events = EPOLLOUT | EPOLLONESHOT;
-      }
-
-      if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-        message = "epoll_ctl() failed, errno=" + std::to_string(errno);
-      } else {
-        dispatcher->dispatch();
-        assert(dispatcher != nullptr);
-        assert(operationContext.context == dispatcher->getCurrentContext());
-        assert(contextPair.writeContext == &operationContext);
-
-        if (operationContext.interrupted) {
-          contextPair.writeContext = nullptr;
-          throw InterruptedException();
-        }
-
-        contextPair.writeContext = nullptr;
-        if(contextPair.readContext != nullptr) { //read is presented, rearm
-          epoll_event connectionEvent;
-          connectionEvent.events = EPOLLIN | EPOLLONESHOT;
-          connectionEvent.data.ptr = &contextPair;
-
-          if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, connection, &connectionEvent) == -1) {
-            message = "epoll_ctl() failed, errno=" + std::to_string(errno);
-            throw std::runtime_error("TcpConnection::write");
-          }
-        }
-
-        if((operationContext.events & (EPOLLERR | EPOLLHUP)) != 0) {
-          throw std::runtime_error("TcpConnection::write");
-        }
-
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
-        if (transferred == -1) {
-          message = "send failed, errno="  + std::to_string(errno);
-        } else {
-          assert(transferred <= static_cast<ssize_t>(size));
-          return transferred;
-        }
-      }
+      throw std::runtime_error("TcpConnection::write, send failed, errno=" + std::to_string(errno));
     }
 
-    throw std::runtime_error("TcpConnection::write, "+message);
+    waitReadiness(contextPair.writeContext);
   }
-
-  assert(transferred <= static_cast<ssize_t>(size));
-  return transferred;
 }
 
 std::pair<Ipv4Address, uint16_t> TcpConnection::getPeerAddressAndPort() {
-  sockaddr_in addr;
+  sockaddr_storage addr;
   socklen_t size = sizeof(addr);
   if (getpeername(connection, reinterpret_cast<sockaddr*>(&addr), &size) != 0) {
     throw std::runtime_error("TcpConnection::getPeerAddress, getpeername failed, result=" + std::to_string(errno));
   }
 
+  // peers of Unix domain sockets have no address
+  if (addr.ss_family != AF_INET) {
+    return std::make_pair(Ipv4Address(0), static_cast<uint16_t>(0));
+  }
+
   assert(size == sizeof(sockaddr_in));
-  return std::make_pair(Ipv4Address(htonl(addr.sin_addr.s_addr)), htons(addr.sin_port));
+  const sockaddr_in& inetAddr = reinterpret_cast<const sockaddr_in&>(addr);
+  return std::make_pair(Ipv4Address(htonl(inetAddr.sin_addr.s_addr)), htons(inetAddr.sin_port));
 }
 
 TcpConnection::TcpConnection(Dispatcher& dispatcher, int socket) : dispatcher(&dispatcher), connection(socket), stopped(false) {
   contextPair.readContext = nullptr;
   contextPair.writeContext = nullptr;
+  registerConnection(EPOLL_CTL_ADD);
+}
+
+// Socket stays registered edge-triggered for both directions, blocked operations cost no epoll_ctl() calls
+void TcpConnection::registerConnection(int operation) {
   epoll_event connectionEvent;
-  connectionEvent.events = EPOLLONESHOT;
-  connectionEvent.data.ptr = nullptr;
+  connectionEvent.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  connectionEvent.data.ptr = &contextPair;
 
-  if (epoll_ctl(dispatcher.getEpoll(), EPOLL_CTL_ADD, socket, &connectionEvent) == -1) {
-    throw std::runtime_error("TcpConnection::TcpConnection, epoll_ctl() fail" + std::to_string(errno));
+  if (epoll_ctl(dispatcher->getEpoll(), operation, connection, &connectionEvent) == -1) {
+    throw std::runtime_error("TcpConnection::registerConnection, epoll_ctl() fail" + std::to_string(errno));
+  }
+}
+
+// Readiness may be reported for data consumed already, so the caller retries the operation after waking up
+void TcpConnection::waitReadiness(Dispatcher::OperationContext*& operation) {
+  Dispatcher::OperationContext operationContext;
+  operationContext.interrupted = false;
+  operationContext.context = dispatcher->getCurrentContext();
+  operation = &operationContext;
+  dispatcher->dispatch();
+  assert(dispatcher != nullptr);
+  assert(operationContext.context == dispatcher->getCurrentContext());
+  assert(operation == nullptr);
+  if (operationContext.interrupted) {
+    throw InterruptedException();
   }
 }
 
@@ -28,6 +28,11 @@ class Ipv4Address;
 
 class TcpConnection {
 public:
+  struct Buffer {
+    const uint8_t* data;
+    std::size_t size;
+  };
+
   TcpConnection();
   TcpConnection(const TcpConnection&) = delete;
   TcpConnection(TcpConnection&& other);
@@ -38,6 +43,8 @@ public:
   void stop();
   std::size_t read(uint8_t* data, std::size_t size);
   std::size_t write(const uint8_t* data, std::size_t size);
+  // Gathers buffers into one send, returns count of bytes sent which may be less than total size of buffers
+  std::size_t write(const Buffer* buffers, std::size_t count);
   std::pair<Ipv4Address, uint16_t> getPeerAddressAndPort();
 
 private:
@@ -50,6 +57,8 @@ private:
   Dispatcher::ContextPair contextPair;
 
   TcpConnection(Dispatcher& dispatcher, int socket);
+  void registerConnection(int operation);
+  void waitReadiness(Dispatcher::OperationContext*& operation);
 };
 
 }
@@ -17,11 +17,14 @@
 
 #include "TcpListener.h"
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 #include <fcntl.h>
 #include <netdb.h>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #include "Dispatcher.h"
@@ -35,48 +38,25 @@ TcpListener::TcpListener() : dispatcher(nullptr) {
 }
 
 TcpListener::TcpListener(Dispatcher& dispatcher, const Ipv4Address& addr, uint16_t port) : dispatcher(&dispatcher) {
-  std::string message;
-  listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (listener == -1) {
-    message = "socket() failed, errno=" + std::to_string(errno);
-  } else {
-    int flags = fcntl(listener, F_GETFL, 0);
-    if (flags == -1 || fcntl(listener, F_SETFL, flags | O_NONBLOCK) == -1) {
-      message = "fcntl() failed errno=" + std::to_string(errno);
-    } else {
-      int on = 1;
-      if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on) == -1) {
-        message = "setsockopt failed, errno=" + std::to_string(errno);
-      } else {
-        sockaddr_in address;
-        address.sin_family = AF_INET;
-        address.sin_port = htons(port);
-        address.sin_addr.s_addr = htonl( addr.getValue());
-        if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof address) != 0) {
-          message = "bind failed, errno=" + std::to_string(errno);
-        } else if (listen(listener, SOMAXCONN) != 0) {
-          message = "listen failed, errno=" + std::to_string(errno);
-        } else {
-          epoll_event listenEvent;
-          listenEvent.events = 0;
-          listenEvent.data.ptr = nullptr;
-
-          if (epoll_ctl(dispatcher.getEpoll(), EPOLL_CTL_ADD, listener, &listenEvent) == -1) {
-            message = "epoll_ctl() failed, errno=" + std::to_string(errno);
-          } else {
-            stopped = false;
-            context = nullptr;
-            return;
-          }
-        }
-      }
-    }
+  sockaddr_in address;
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl( addr.getValue());
+  open(AF_INET, IPPROTO_TCP, &address, sizeof address);
+}
 
-    int result = close(listener);
-    assert(result != -1);
+TcpListener::TcpListener(Dispatcher& dispatcher, const std::string& path) : dispatcher(&dispatcher) {
+  sockaddr_un address;
+  if (path.size() >= sizeof address.sun_path) {
+    throw std::runtime_error("TcpListener::TcpListener, socket path is too long");
   }
 
-  throw std::runtime_error("TcpListener::TcpListener, " + message);
+  memset(&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, path.data(), path.size());
+  // socket file left by a previous run would fail bind
+  unlink(path.c_str());
+  open(AF_UNIX, 0, &address, sizeof address);
 }
 
 TcpListener::TcpListener(TcpListener&& other) : dispatcher(other.dispatcher) {
@@ -152,56 +132,95 @@ TcpConnection TcpListener::accept() {
     throw InterruptedException();
   }
 
-  Dispatcher::ContextPair contextPair;
-  Dispatcher::OperationContext listenerContext;
-  listenerContext.interrupted = false;
-  listenerContext.context = dispatcher->getCurrentContext();
-
-  contextPair.writeContext = nullptr;
-  contextPair.readContext = &listenerContext;
-
-  epoll_event listenEvent;
-  listenEvent.events = EPOLLIN | EPOLLONESHOT;
-  listenEvent.data.ptr = &contextPair;
   std::string message;
-  if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, listener, &listenEvent) == -1) {
-    message = "epoll_ctl() failed, errno=" + std::to_string(errno);
+  // pending connections are taken right away, the listener is armed in epoll only when the backlog is empty
+  int connection = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+  if (connection != -1) {
+    return TcpConnection(*dispatcher, connection);
+  }
+
+  if (errno != EAGAIN && errno != EWOULDBLOCK) {
+    message = "accept4() failed, errno=" + std::to_string(errno);
   } else {
-    context = &listenerContext;
-    dispatcher->dispatch();
-    assert(dispatcher != nullptr);
-    assert(listenerContext.context == dispatcher->getCurrentContext());
-    assert(contextPair.writeContext == nullptr);
-    assert(context == &listenerContext);
-    context = nullptr;
-    listenerContext.context = nullptr;
-    if (listenerContext.interrupted) {
-      throw InterruptedException();
-    }
+    Dispatcher::ContextPair contextPair;
+    Dispatcher::OperationContext listenerContext;
+    listenerContext.interrupted = false;
+    listenerContext.context = dispatcher->getCurrentContext();
+
+    contextPair.writeContext = nullptr;
+    contextPair.readContext = &listenerContext;
+
+    epoll_event listenEvent;
+    listenEvent.events = EPOLLIN | EPOLLONESHOT;
+    listenEvent.data.ptr = &contextPair;
+    if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, listener, &listenEvent) == -1) {
+      message = "epoll_ctl() failed, errno=" + std::to_string(errno);
+    } else {
+      context = &listenerContext;
+      dispatcher->dispatch();
+      assert(dispatcher != nullptr);
+      assert(listenerContext.context == dispatcher->getCurrentContext());
+      assert(contextPair.writeContext == nullptr);
+      assert(context == &listenerContext);
+      context = nullptr;
+      listenerContext.context = nullptr;
+      if (listenerContext.interrupted) {
+        throw InterruptedException();
+      }
 
-    if((listenerContext.events & (EPOLLERR | EPOLLHUP)) != 0) {
-      throw std::runtime_error("TcpListener::accept, accepting failed");
-    }
+      if((listenerContext.events & (EPOLLERR | EPOLLHUP)) != 0) {
+        throw std::runtime_error("TcpListener::accept, accepting failed");
+      }
 
-    sockaddr inAddr;
-    socklen_t inLen = sizeof(inAddr);
-    int connection = ::accept(listener, &inAddr, &inLen);
-    if (connection == -1) {
-      message = "accept() failed, errno=" + std::to_string(errno);
-    } else {
-      int flags = fcntl(connection, F_GETFL, 0);
-      if (flags == -1 || fcntl(connection, F_SETFL, flags | O_NONBLOCK) == -1) {
-        message = "fcntl() failed errno=" + std::to_string(errno);
+      connection = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+      if (connection == -1) {
+        message = "accept4() failed, errno=" + std::to_string(errno);
       } else {
         return TcpConnection(*dispatcher, connection);
       }
-
-      int result = close(connection);
-      assert(result != -1);
     }
   }
 
   throw std::runtime_error("TcpListener::accept, " + message);
 }
 
+void TcpListener::open(int family, int protocol, const void* address, size_t addressSize) {
+  std::string message;
+  listener = socket(family, SOCK_STREAM, protocol);
+  if (listener == -1) {
+    message = "socket() failed, errno=" + std::to_string(errno);
+  } else {
+    int flags = fcntl(listener, F_GETFL, 0);
+    if (flags == -1 || fcntl(listener, F_SETFL, flags | O_NONBLOCK) == -1) {
+      message = "fcntl() failed errno=" + std::to_string(errno);
+    } else {
+      int on = 1;
+      if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on) == -1) {
+        message = "setsockopt failed, errno=" + std::to_string(errno);
+      } else if (bind(listener, static_cast<const sockaddr*>(address), static_cast<socklen_t>(addressSize)) != 0) {
+        message = "bind failed, errno=" + std::to_string(errno);
+      } else if (listen(listener, SOMAXCONN) != 0) {
+        message = "listen failed, errno=" + std::to_string(errno);
+      } else {
+        epoll_event listenEvent;
+        listenEvent.events = 0;
+        listenEvent.data.ptr = nullptr;
+
+        if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_ADD, listener, &listenEvent) == -1) {
+          message = "epoll_ctl() failed, errno=" + std::to_string(errno);
+        } else {
+          stopped = false;
+          context = nullptr;
+          return;
+        }
+      }
+    }
+
+    int result = close(listener);
+    assert(result != -1);
+  }
+
+  throw std::runtime_error("TcpListener::TcpListener, " + message);
+}
+
 }
@@ -30,6 +30,8 @@ class TcpListener {
 public:
   TcpListener();
   TcpListener(Dispatcher& dispatcher, const Ipv4Address& address, uint16_t port);
+  // Listens on a Unix domain stream socket, a socket file left at the path is removed first
+  TcpListener(Dispatcher& dispatcher, const std::string& path);
   TcpListener(const TcpListener&) = delete;
   TcpListener(TcpListener&& other);
   ~TcpListener();
@@ -40,6 +42,8 @@ public:
   TcpConnection accept();
 
 private:
+  void open(int family, int protocol, const void* address, size_t addressSize);
+
   Dispatcher* dispatcher;
   void* context;
   int listener;
@@ -17,27 +17,34 @@
 
 #include "Timer.h"
 #include <cassert>
+#include <ctime>
 #include <stdexcept>
-
-#include <sys/timerfd.h>
-#include <sys/epoll.h>
-#include <unistd.h>
+#include <string>
 
 #include "Dispatcher.h"
 #include <System/InterruptedException.h>
 
 namespace System {
 
+namespace {
+
+struct TimerContext {
+  uint64_t time;
+  void* context;
+  bool interrupted;
+};
+
+}
+
 Timer::Timer() : dispatcher(nullptr) {
 }
 
-Timer::Timer(Dispatcher& dispatcher) : dispatcher(&dispatcher), context(nullptr),  stopped(false),  timer(-1) {
+Timer::Timer(Dispatcher& dispatcher) : dispatcher(&dispatcher), context(nullptr), stopped(false) {
 }
 
 Timer::Timer(Timer&& other) : dispatcher(other.dispatcher) {
   if (other.dispatcher != nullptr) {
     assert(other.context == nullptr);
-    timer = other.timer;
     stopped = other.stopped;
     context = nullptr;
     other.dispatcher = nullptr;
@@ -53,11 +60,9 @@ Timer& Timer::operator=(Timer&& other) {
   dispatcher = other.dispatcher;
   if (other.dispatcher != nullptr) {
     assert(other.context == nullptr);
-    timer = other.timer;
     stopped = other.stopped;
     context = nullptr;
     other.dispatcher = nullptr;
-    other.timer = -1;
   }
 
   return *this;
@@ -72,31 +77,11 @@ void Timer::start() {
 void Timer::stop() {
   assert(dispatcher != nullptr);
   assert(!stopped);
-
   if (context != nullptr) {
-    Dispatcher::OperationContext* timerContext = static_cast<Dispatcher::OperationContext*>(context);
+    TimerContext* timerContext = static_cast<TimerContext*>(context);
     if (!timerContext->interrupted) {
-
-      uint64_t value = 0;
-      if(::read(timer, &value, sizeof value) == -1 ){
-        if(errno == EAGAIN || errno == EWOULDBLOCK) {
-          timerContext->interrupted = true;
-          dispatcher->pushContext(timerContext->context);
-        } else {
-          throw std::runtime_error("Timer::stop, read failed, errno="  + std::to_string(errno));
-        }
-      } else {
-        assert(value>0);
-        dispatcher->pushContext(timerContext->context);
-      }
-
-      epoll_event timerEvent;
-      timerEvent.events = 0;
-      timerEvent.data.ptr = nullptr;
-
-      if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, timer, &timerEvent) == -1) {
-        throw std::runtime_error("Timer::stop epoll_ctl() failed, errno=" + std::to_string(errno));
-      }
+      dispatcher->interruptTimer(timerContext->time, timerContext->context);
+      timerContext->interrupted = true;
     }
   }
 
@@ -113,39 +98,20 @@ void Timer::sleep(std::chrono::nanoseconds duration) {
   if(duration.count() == 0 ) {
     dispatcher->yield();
   } else {
-    timer = dispatcher->getTimer();
-
-    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
-    itimerspec expires;
-    expires.it_interval.tv_nsec = expires.it_interval.tv_sec = 0;
-    expires.it_value.tv_sec = seconds.count();
-    expires.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(duration - seconds).count();
-    timerfd_settime(timer, 0, &expires, NULL);
-
-    Dispatcher::ContextPair contextPair;
-    Dispatcher::OperationContext timerContext;
-    timerContext.interrupted = false;
-    timerContext.context = dispatcher->getCurrentContext();
-    contextPair.writeContext = nullptr;
-    contextPair.readContext = &timerContext;
-
-    epoll_event timerEvent;
-    timerEvent.events = EPOLLIN | EPOLLONESHOT;
-    timerEvent.data.ptr = &contextPair;
-
-    if (epoll_ctl(dispatcher->getEpoll(), EPOLL_CTL_MOD, timer, &timerEvent) == -1) {
-      throw std::runtime_error("Timer::sleep, epoll_ctl() failed, errno=" + std::to_string(errno));
+    timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == -1) {
+      throw std::runtime_error("Timer::sleep, clock_gettime() failed, errno=" + std::to_string(errno));
     }
 
+    uint64_t time = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec + duration.count();
+    TimerContext timerContext{ time, dispatcher->getCurrentContext(), false };
     context = &timerContext;
+    dispatcher->addTimer(time, timerContext.context);
     dispatcher->dispatch();
     assert(dispatcher != nullptr);
     assert(timerContext.context == dispatcher->getCurrentContext());
-    assert(contextPair.writeContext == nullptr);
     assert(context == &timerContext);
     context = nullptr;
-    timerContext.context = nullptr;
-    dispatcher->pushTimer(timer);
     if (timerContext.interrupted) {
       throw InterruptedException();
     }
@@ -40,7 +40,6 @@ private:
   Dispatcher* dispatcher;
   void* context;
   bool stopped;
-  int timer;
 };
 
 }
@@ -16,6 +16,7 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Dispatcher.h"
+#include <System/DispatcherTracer.h>
 #include <cassert>
 #include <string>
 
@@ -31,7 +32,10 @@
 
 namespace System {
 
-Dispatcher::Dispatcher() : lastCreatedTimer(0) {
+Dispatcher::Dispatcher() : Dispatcher(DEFAULT_STACK_SIZE) {
+}
+
+Dispatcher::Dispatcher(std::size_t stackSize) : lastCreatedTimer(0), stackSize(stackSize) {
   std::string message;
   kqueue = ::kqueue();
   if (kqueue == -1) {
@@ -46,13 +50,10 @@ Dispatcher::Dispatcher() : lastCreatedTimer(0) {
       if (kevent(kqueue, &event, 1, NULL, 0, NULL) == -1) {
         message = "kevent() fail errno=" + std::to_string(errno);
       } else {
-        if(pthread_mutex_init(reinterpret_cast<pthread_mutex_t*>(this->mutex), NULL) == -1) {
-          message = "pthread_mutex_init() fail errno=" + std::to_string(errno);
-        } else {
-          remoteSpawned = false;
-          contextCount = 0;
-          return;
-        }
+        contextCount = 0;
+        tracer = nullptr;
+        currentSite = nullptr;
+        return;
       }
     }
 
@@ -77,8 +78,6 @@ Dispatcher::~Dispatcher() {
 
   auto result = close(kqueue);
   assert(result != -1);
-  result = pthread_mutex_destroy(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-  assert(result != -1);
 }
 
 void Dispatcher::clear() {
@@ -93,6 +92,10 @@ void Dispatcher::clear() {
 
 void Dispatcher::dispatch() {
   void* context;
+  if (tracer != nullptr) {
+    tracer->contextRan(std::chrono::steady_clock::now() - contextResumeTime, currentSite);
+  }
+
   for (;;) {
     if (!resumingContexts.empty()) {
       context = resumingContexts.front();
@@ -100,20 +103,22 @@ void Dispatcher::dispatch() {
       break;
     }
 
-    if(remoteSpawned.load() == true) {
-      pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-      while (!remoteSpawningProcedures.empty()) {
-        spawn(std::move(remoteSpawningProcedures.front()));
-        remoteSpawningProcedures.pop();
-      }
-
-      remoteSpawned = false;
-      pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
+    if (!remoteSpawningProcedures.empty()) {
+      spawnRemoteProcedures();
       continue;
     }
 
     struct kevent event;
+    std::chrono::steady_clock::time_point waitStart;
+    if (tracer != nullptr) {
+      waitStart = std::chrono::steady_clock::now();
+    }
+
     int count = kevent(kqueue, NULL, 0, &event, 1, NULL);
+    if (tracer != nullptr) {
+      tracer->eventsWaited(std::chrono::steady_clock::now() - waitStart);
+    }
+
     if (count == 1) {
       if (event.filter == EVFILT_USER && event.ident == 0) {
         struct kevent event;
@@ -132,22 +137,24 @@ void Dispatcher::dispatch() {
     if (errno != EINTR) {
       throw std::runtime_error("Dispatcher::dispatch(), kqueue() fail errno=" + std::to_string(errno));
     } else {
-      pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-      while (!remoteSpawningProcedures.empty()) {
-        spawn(std::move(remoteSpawningProcedures.front()));
-        remoteSpawningProcedures.pop();
-      }
-
-      pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
+      spawnRemoteProcedures();
     }
   }
 
+  if (tracer != nullptr) {
+    tracer->contextResumed(resumingContexts.size());
+    contextResumeTime = std::chrono::steady_clock::now();
+  }
+
   if (context != currentContext) {
+    const char* site = currentSite;
     uctx* oldContext = static_cast<uctx*>(currentContext);
     currentContext = context;
     if (swapcontext(oldContext,static_cast<uctx*>(currentContext)) == -1) {
       throw std::runtime_error("Dispatcher::dispatch(), swapcontext() failed, errno=" + std::to_string(errno));
     }
+
+    currentSite = site;
   }
 }
 
@@ -155,34 +162,47 @@ void* Dispatcher::getCurrentContext() const {
   return currentContext;
 }
 
+std::size_t Dispatcher::getRemoteSpawnQueueSize() const {
+  return remoteSpawningProcedures.size();
+}
+
 void Dispatcher::pushContext(void* context) {
   resumingContexts.push(context);
 }
 
 void Dispatcher::remoteSpawn(std::function<void()>&& procedure) {
-  pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-  remoteSpawningProcedures.push(std::move(procedure));
-  if(remoteSpawned == false) {
-    remoteSpawned = true;
+  // dispatcher takes all queued procedures on one wakeup, only the first one of them has to signal it
+  if (remoteSpawningProcedures.push(std::move(procedure))) {
     struct kevent event;
     EV_SET(&event, 0, EVFILT_USER, EV_ADD | EV_ONESHOT, NOTE_FFCOPY | NOTE_TRIGGER, 0, NULL);
     if (kevent(kqueue, &event, 1, NULL, 0, NULL) == -1) {
       throw std::runtime_error("Dispatcher::remoteSpawn(), kevent() fail errno=" + std::to_string(errno));
     };
   }
+}
 
-  pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
+void Dispatcher::spawnRemoteProcedures() {
+  std::queue<std::function<void()>> procedures;
+  remoteSpawningProcedures.takeAll(procedures);
+  while (!procedures.empty()) {
+    spawn(std::move(procedures.front()));
+    procedures.pop();
+  }
 }
 
 void Dispatcher::spawn(std::function<void()>&& procedure) {
+  spawn(std::move(procedure), nullptr);
+}
+
+void Dispatcher::spawn(std::function<void()>&& procedure, const char* site) {
   void* context;
   if (reusableContexts.empty()) {
     context = new uctx;
-    uint8_t* stackPointer = new uint8_t[64 * 1024];
+    uint8_t* stackPointer = new uint8_t[stackSize];
     allocatedStacks.push(stackPointer);
 
     static_cast<uctx*>(context)->uc_stack.ss_sp = stackPointer;
-    static_cast<uctx*>(context)->uc_stack.ss_size = 64 * 1024;
+    static_cast<uctx*>(context)->uc_stack.ss_size = stackSize;
     makecontext(static_cast<uctx*>(context), reinterpret_cast<void(*)()>(contextProcedureStatic), reinterpret_cast<intptr_t>(this));
     
     ++contextCount;
@@ -193,6 +213,12 @@ void Dispatcher::spawn(std::function<void()>&& procedure) {
 
   resumingContexts.push(context);
   spawningProcedures.emplace(std::move(procedure));
+  spawningSites.push(site);
+}
+
+void Dispatcher::setTracer(DispatcherTracer* tracer) {
+  this->tracer = tracer;
+  contextResumeTime = std::chrono::steady_clock::now();
 }
 
 void Dispatcher::yield() {
@@ -213,14 +239,7 @@ void Dispatcher::yield() {
             throw std::runtime_error("kevent() fail errno=" + std::to_string(errno));
           }
           
-          pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
-          while (!remoteSpawningProcedures.empty()) {
-            spawn(std::move(remoteSpawningProcedures.front()));
-            remoteSpawningProcedures.pop();
-          }
-
-          remoteSpawned = false;
-          pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(this->mutex));
+          spawnRemoteProcedures();
           continue;
         }
 
@@ -265,6 +284,8 @@ void Dispatcher::contextProcedure() {
     assert(!spawningProcedures.empty());
     std::function<void()> procedure = std::move(spawningProcedures.front());
     spawningProcedures.pop();
+    currentSite = spawningSites.front();
+    spawningSites.pop();
     procedure();
     reusableContexts.push(context);
     dispatch();
@@ -17,25 +17,39 @@
 
 #pragma once
 
-#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <queue>
 #include <stack>
 
+#include <System/RemoteProcedureQueue.h>
+
 namespace System {
 
+class DispatcherTracer;
+
 class Dispatcher {
 public:
+  static const std::size_t DEFAULT_STACK_SIZE = 64 * 1024;
+
   Dispatcher();
+  explicit Dispatcher(std::size_t stackSize);
   Dispatcher(const Dispatcher&) = delete;
   ~Dispatcher();
   Dispatcher& operator=(const Dispatcher&) = delete;
   void clear();
   void dispatch();
   void* getCurrentContext() const;
+  // Procedures queued by remoteSpawn and not spawned yet, can be called from any thread
+  std::size_t getRemoteSpawnQueueSize() const;
   void pushContext(void* context);
   void remoteSpawn(std::function<void()>&& procedure);
   void spawn(std::function<void()>&& procedure);
+  // Site tags the procedure for tracing and must stay valid while the dispatcher exists, a string literal names it best
+  void spawn(std::function<void()>&& procedure, const char* site);
+  // Scheduling events are reported to the tracer until it is replaced or reset with nullptr
+  void setTracer(DispatcherTracer* tracer);
   void yield();
 
   struct OperationContext {
@@ -47,27 +61,26 @@ public:
   int getTimer();
   void pushTimer(int timer);
 
-#ifdef __LP64__
-  static const int SIZEOF_PTHREAD_MUTEX_T = 56 + sizeof(long);
-#else
-  static const int SIZEOF_PTHREAD_MUTEX_T = 40 + sizeof(long);
-#endif
-
 private:
   std::stack<uint8_t*> allocatedStacks;
   std::size_t contextCount;
   void* currentContext;
   int kqueue;
   int lastCreatedTimer;
-  uint8_t mutex[SIZEOF_PTHREAD_MUTEX_T];
-  std::atomic<bool> remoteSpawned;
-  std::queue<std::function<void()>> remoteSpawningProcedures;
+  RemoteProcedureQueue remoteSpawningProcedures;
   std::queue<void*> resumingContexts;
   std::queue<std::function<void()>> spawningProcedures;
+  std::queue<const char*> spawningSites;
   std::stack<void*> reusableContexts;
+  std::size_t stackSize;
   std::stack<int> timers;
+  DispatcherTracer* tracer;
+  // tag of the running context, contexts keep their own on the stack while switched out
+  const char* currentSite;
+  std::chrono::steady_clock::time_point contextResumeTime;
 
   void contextProcedure();
+  void spawnRemoteProcedures();
   static void contextProcedureStatic(intptr_t context);
 };
 
@@ -16,12 +16,14 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "TcpConnection.h"
+#include <algorithm>
 #include <cassert>
 
 #include <netinet/in.h>
 #include <sys/event.h>
 #include <sys/errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "Dispatcher.h"
@@ -30,6 +32,12 @@
 
 namespace System {
 
+namespace {
+
+const std::size_t MAX_WRITE_BUFFERS = 16;
+
+}
+
 TcpConnection::TcpConnection() : dispatcher(nullptr) {
 }
 
@@ -169,6 +177,25 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 }
 
 size_t TcpConnection::write(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    assert(dispatcher != nullptr);
+    assert(writeContext == nullptr);
+    if (stopped) {
+      throw InterruptedException();
+    }
+
+    if (shutdown(connection, SHUT_WR) == -1) {
+      throw std::runtime_error("TcpConnection::write, shutdown failed, result=" + std::to_string(errno));
+    }
+
+    return 0;
+  }
+
+  Buffer buffer = { data, size };
+  return write(&buffer, 1);
+}
+
+size_t TcpConnection::write(const Buffer* buffers, std::size_t count) {
   assert(dispatcher != nullptr);
   assert(writeContext == nullptr);
   if (stopped) {
@@ -176,15 +203,24 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
   }
 
   std::string message;
-  if (size == 0) {
-    if (shutdown(connection, SHUT_WR) == -1) {
-      throw std::runtime_error("TcpConnection::write, shutdown failed, result=" + std::to_string(errno));
-    }
+  // buffers after MAX_WRITE_BUFFERS are left for the next call, as any data not sent at once
+  iovec vectors[MAX_WRITE_BUFFERS];
+  count = std::min(count, MAX_WRITE_BUFFERS);
+  size_t size = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    vectors[i].iov_base = const_cast<uint8_t*>(buffers[i].data);
+    vectors[i].iov_len = buffers[i].size;
+    size += buffers[i].size;
+  }
 
+  if (size == 0) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, 0);
+  msghdr header = {};
+  header.msg_iov = vectors;
+  header.msg_iovlen = count;
+  ssize_t transferred = ::sendmsg(connection, &header, 0);
   if (transferred == -1) {
     if (errno != EAGAIN  && errno != EWOULDBLOCK) {
       message = "send failed, result=" + std::to_string(errno);
@@ -208,7 +244,7 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
           throw InterruptedException();
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
+        ssize_t transferred = ::sendmsg(connection, &header, 0);
         if (transferred == -1) {
           message = "send failed, errno=" + std::to_string(errno);
         } else {
@@ -226,14 +262,20 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
 }
 
 std::pair<Ipv4Address, uint16_t> TcpConnection::getPeerAddressAndPort() {
-  sockaddr_in addr;
+  sockaddr_storage addr;
   socklen_t size = sizeof(addr);
   if (getpeername(connection, reinterpret_cast<sockaddr*>(&addr), &size) != 0) {
     throw std::runtime_error("TcpConnection::getPeerAddress, getpeername failed, result=" + std::to_string(errno));
   }
 
+  // peers of Unix domain sockets have no address
+  if (addr.ss_family != AF_INET) {
+    return std::make_pair(Ipv4Address(0), static_cast<uint16_t>(0));
+  }
+
   assert(size == sizeof(sockaddr_in));
-  return std::make_pair(Ipv4Address(htonl(addr.sin_addr.s_addr)), htons(addr.sin_port));
+  const sockaddr_in& inetAddr = reinterpret_cast<const sockaddr_in&>(addr);
+  return std::make_pair(Ipv4Address(htonl(inetAddr.sin_addr.s_addr)), htons(inetAddr.sin_port));
 }
 
 TcpConnection::TcpConnection(Dispatcher& dispatcher, int socket) : dispatcher(&dispatcher), connection(socket), stopped(false), readContext(nullptr), writeContext(nullptr) {
@@ -17,12 +17,14 @@
 
 #include "TcpConnector.h"
 #include <cassert>
+#include <cstring>
 
 #include <fcntl.h>
 #include <netdb.h>
 #include <sys/errno.h>
 #include <sys/event.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -97,6 +99,26 @@ void TcpConnector::stop() {
 }
 
 TcpConnection TcpConnector::connect(const Ipv4Address& address, uint16_t port) {
+  sockaddr_in addressData;
+  addressData.sin_family = AF_INET;
+  addressData.sin_port = htons(port);
+  addressData.sin_addr.s_addr = htonl(address.getValue());
+  return connect(AF_INET, IPPROTO_TCP, &addressData, sizeof addressData);
+}
+
+TcpConnection TcpConnector::connect(const std::string& path) {
+  sockaddr_un addressData;
+  if (path.size() >= sizeof addressData.sun_path) {
+    throw std::runtime_error("TcpConnector::connect, socket path is too long");
+  }
+
+  memset(&addressData, 0, sizeof addressData);
+  addressData.sun_family = AF_UNIX;
+  memcpy(addressData.sun_path, path.data(), path.size());
+  return connect(AF_UNIX, 0, &addressData, sizeof addressData);
+}
+
+TcpConnection TcpConnector::connect(int family, int protocol, const void* address, size_t addressSize) {
   assert(dispatcher != nullptr);
   assert(context == nullptr);
   if (stopped) {
@@ -104,7 +126,7 @@ TcpConnection TcpConnector::connect(const Ipv4Address& address, uint16_t port) {
   }
 
   std::string message;
-  int connection = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int connection = ::socket(family, SOCK_STREAM, protocol);
   if (connection == -1) {
     message = "socket() failed, errno=" + std::to_string(errno);
   } else {
@@ -112,18 +134,14 @@ TcpConnection TcpConnector::connect(const Ipv4Address& address, uint16_t port) {
     bindAddress.sin_family = AF_INET;
     bindAddress.sin_port = 0;
     bindAddress.sin_addr.s_addr = INADDR_ANY;
-    if (bind(connection, reinterpret_cast<sockaddr*>(&bindAddress), sizeof bindAddress) != 0) {
+    if (family == AF_INET && bind(connection, reinterpret_cast<sockaddr*>(&bindAddress), sizeof bindAddress) != 0) {
       message = "bind failed, errno=" + std::to_string(errno);
     } else {
       int flags = fcntl(connection, F_GETFL, 0);
       if (flags == -1 || fcntl(connection, F_SETFL, flags | O_NONBLOCK) == -1) {
         message = "fcntl() failed errno=" + std::to_string(errno);
       } else {
-        sockaddr_in addressData;
-        addressData.sin_family = AF_INET;
-        addressData.sin_port = htons(port);
-        addressData.sin_addr.s_addr = htonl(address.getValue());
-        int result = ::connect(connection, reinterpret_cast<sockaddr *>(&addressData), sizeof addressData);
+        int result = ::connect(connection, static_cast<const sockaddr*>(address), static_cast<socklen_t>(addressSize));
         if (result == -1) {
           if (errno == EINPROGRESS) {
             ConnectorContext connectorContext;
@@ -167,6 +185,8 @@ TcpConnection TcpConnector::connect(const Ipv4Address& address, uint16_t port) {
                 }
               }
             }
+          } else {
+            message = "connect failed, errno=" + std::to_string(errno);
           }
         } else {
           return TcpConnection(*dispatcher, connection);
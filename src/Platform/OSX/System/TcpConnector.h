@@ -38,8 +38,12 @@ public:
   void start();
   void stop();
   TcpConnection connect(const Ipv4Address& address, uint16_t port);
+  // Connects to a Unix domain stream socket
+  TcpConnection connect(const std::string& path);
 
 private:
+  TcpConnection connect(int family, int protocol, const void* address, size_t addressSize);
+
   void* context;
   Dispatcher* dispatcher;
   bool stopped;
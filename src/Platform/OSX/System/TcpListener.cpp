@@ -17,6 +17,7 @@
 
 #include "TcpListener.h"
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 #include <fcntl.h>
@@ -24,6 +25,7 @@
 #include <sys/errno.h>
 #include <sys/event.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -38,48 +40,25 @@ TcpListener::TcpListener() : dispatcher(nullptr) {
 }
 
 TcpListener::TcpListener(Dispatcher& dispatcher, const Ipv4Address& addr, uint16_t port) : dispatcher(&dispatcher) {
-  std::string message;
-  listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (listener == -1) {
-    message = "socket() failed, errno=" + std::to_string(errno);
-  } else {
-    int flags = fcntl(listener, F_GETFL, 0);
-    if (flags == -1 || (fcntl(listener, F_SETFL, flags | O_NONBLOCK) == -1)) {
-      message = "fcntl() failed errno=" + std::to_string(errno);
-    } else {
-      int on = 1;
-      if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on) == -1) {
-        message = "setsockopt failed, errno=" + std::to_string(errno);
-      } else {
-        sockaddr_in address;
-        address.sin_family = AF_INET;
-        address.sin_port = htons(port);
-        address.sin_addr.s_addr = htonl(addr.getValue());
-        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0) {
-          message = "bind failed, errno=" + std::to_string(errno);
-        } else if (listen(listener, SOMAXCONN) != 0) {
-          message = "listen failed, errno=" + std::to_string(errno);
-        } else {
-          struct kevent event;
-          EV_SET(&event, listener, EVFILT_READ, EV_ADD | EV_DISABLE, 0, SOMAXCONN, NULL);
-
-          if (kevent(dispatcher.getKqueue(), &event, 1, NULL, 0, NULL) == -1) {
-            message = "kevent() failed, errno=" + std::to_string(errno);
-          } else {
-            stopped = false;
-            context = nullptr;
-            return;
-          }
-        }
-      }
-    }
+  sockaddr_in address;
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(addr.getValue());
+  open(AF_INET, IPPROTO_TCP, &address, sizeof address);
+}
 
-    if (close(listener) == -1) {
-      message = "close failed, errno=" + std::to_string(errno);
-    }
+TcpListener::TcpListener(Dispatcher& dispatcher, const std::string& path) : dispatcher(&dispatcher) {
+  sockaddr_un address;
+  if (path.size() >= sizeof address.sun_path) {
+    throw std::runtime_error("TcpListener::TcpListener, socket path is too long");
   }
 
-  throw std::runtime_error("TcpListener::TcpListener, " + message);
+  memset(&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, path.data(), path.size());
+  // socket file left by a previous run would fail bind
+  unlink(path.c_str());
+  open(AF_UNIX, 0, &address, sizeof address);
 }
 
 TcpListener::TcpListener(TcpListener&& other) : dispatcher(other.dispatcher) {
@@ -193,4 +172,43 @@ TcpConnection TcpListener::accept() {
   throw std::runtime_error("TcpListener::accept, " + message);
 }
 
+void TcpListener::open(int family, int protocol, const void* address, size_t addressSize) {
+  std::string message;
+  listener = socket(family, SOCK_STREAM, protocol);
+  if (listener == -1) {
+    message = "socket() failed, errno=" + std::to_string(errno);
+  } else {
+    int flags = fcntl(listener, F_GETFL, 0);
+    if (flags == -1 || (fcntl(listener, F_SETFL, flags | O_NONBLOCK) == -1)) {
+      message = "fcntl() failed errno=" + std::to_string(errno);
+    } else {
+      int on = 1;
+      if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on) == -1) {
+        message = "setsockopt failed, errno=" + std::to_string(errno);
+      } else if (bind(listener, static_cast<const sockaddr*>(address), static_cast<socklen_t>(addressSize)) != 0) {
+        message = "bind failed, errno=" + std::to_string(errno);
+      } else if (listen(listener, SOMAXCONN) != 0) {
+        message = "listen failed, errno=" + std::to_string(errno);
+      } else {
+        struct kevent event;
+        EV_SET(&event, listener, EVFILT_READ, EV_ADD | EV_DISABLE, 0, SOMAXCONN, NULL);
+
+        if (kevent(dispatcher->getKqueue(), &event, 1, NULL, 0, NULL) == -1) {
+          message = "kevent() failed, errno=" + std::to_string(errno);
+        } else {
+          stopped = false;
+          context = nullptr;
+          return;
+        }
+      }
+    }
+
+    if (close(listener) == -1) {
+      message = "close failed, errno=" + std::to_string(errno);
+    }
+  }
+
+  throw std::runtime_error("TcpListener::TcpListener, " + message);
+}
+
 }
@@ -16,6 +16,8 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Dispatcher.h"
+#include <System/DispatcherTracer.h>
+#include <algorithm>
 #include <cassert>
 #include <string>
 #ifndef WIN32_LEAN_AND_MEAN
@@ -36,10 +38,10 @@ struct DispatcherContext : public OVERLAPPED {
 
 }
 
-Dispatcher::Dispatcher() {
-  static_assert(sizeof(CRITICAL_SECTION) == sizeof(Dispatcher::criticalSection), "CRITICAL_SECTION size doesn't fit sizeof(Dispatcher::criticalSection)");
-  BOOL result = InitializeCriticalSectionAndSpinCount(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection), 4000);
-  assert(result != FALSE);
+Dispatcher::Dispatcher() : Dispatcher(DEFAULT_STACK_SIZE) {
+}
+
+Dispatcher::Dispatcher(std::size_t stackSize) : stackSize(stackSize) {
   std::string message;
   if (ConvertThreadToFiberEx(NULL, 0) == NULL) {
     message = "ConvertThreadToFiberEx failed, result=" + std::to_string(GetLastError());
@@ -58,7 +60,8 @@ Dispatcher::Dispatcher() {
           message = "WSAStartup failed, result=" + std::to_string(wsaResult);
         } else {
           contextCount = 0;
-          remoteNotificationSent = false;
+          tracer = nullptr;
+          currentSite = nullptr;
           reinterpret_cast<LPOVERLAPPED>(remoteSpawnOverlapped)->hEvent = NULL;
           threadId = GetCurrentThreadId();
           return;
@@ -75,8 +78,7 @@ Dispatcher::Dispatcher() {
     BOOL result = ConvertFiberToThread();
     assert(result == TRUE);
   }
-  
-  DeleteCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
+
   throw std::runtime_error("Dispatcher::Dispatcher, " + message);
 }
 
@@ -98,7 +100,6 @@ Dispatcher::~Dispatcher() {
   assert(result == TRUE);
   result = ConvertFiberToThread();
   assert(result == TRUE);
-  DeleteCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
 }
 
 void Dispatcher::clear() {
@@ -113,6 +114,10 @@ void Dispatcher::clear() {
 void Dispatcher::dispatch() {
   assert(GetCurrentThreadId() == threadId);
   void* context;
+  if (tracer != nullptr) {
+    tracer->contextRan(std::chrono::steady_clock::now() - contextResumeTime, currentSite);
+  }
+
   for (;;) {
     if (!resumingContexts.empty()) {
       context = resumingContexts.front();
@@ -141,18 +146,20 @@ void Dispatcher::dispatch() {
     DWORD timeout = timers.empty() ? INFINITE : static_cast<DWORD>(std::min(timers.begin()->first - currentTime, static_cast<uint64_t>(INFINITE - 1)));
     OVERLAPPED_ENTRY entry;
     ULONG actual = 0;
-    if (GetQueuedCompletionStatusEx(completionPort, &entry, 1, &actual, timeout, TRUE) == TRUE) {
+    std::chrono::steady_clock::time_point waitStart;
+    if (tracer != nullptr) {
+      waitStart = std::chrono::steady_clock::now();
+    }
+
+    BOOL completed = GetQueuedCompletionStatusEx(completionPort, &entry, 1, &actual, timeout, TRUE);
+    DWORD lastError = GetLastError();
+    if (tracer != nullptr) {
+      tracer->eventsWaited(std::chrono::steady_clock::now() - waitStart);
+    }
+
+    if (completed == TRUE) {
       if (entry.lpOverlapped == reinterpret_cast<LPOVERLAPPED>(remoteSpawnOverlapped)) {
-        EnterCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
-        assert(remoteNotificationSent);
-        assert(!remoteSpawningProcedures.empty());
-        do {
-          spawn(std::move(remoteSpawningProcedures.front()));
-          remoteSpawningProcedures.pop();
-        } while (!remoteSpawningProcedures.empty());
-
-        remoteNotificationSent = false;
-        LeaveCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
+        spawnRemoteProcedures();
         continue;
       }
 
@@ -160,7 +167,6 @@ void Dispatcher::dispatch() {
       break;
     }
 
-    DWORD lastError = GetLastError();
     if (lastError == WAIT_TIMEOUT) {
       continue;
     }
@@ -170,8 +176,15 @@ void Dispatcher::dispatch() {
     }
   }
 
+  if (tracer != nullptr) {
+    tracer->contextResumed(resumingContexts.size());
+    contextResumeTime = std::chrono::steady_clock::now();
+  }
+
   if (context != GetCurrentFiber()) {
+    const char* site = currentSite;
     SwitchToFiber(context);
+    currentSite = site;
   }
 }
 
@@ -180,30 +193,43 @@ void* Dispatcher::getCurrentContext() const {
   return GetCurrentFiber();
 }
 
+std::size_t Dispatcher::getRemoteSpawnQueueSize() const {
+  return remoteSpawningProcedures.size();
+}
+
 void Dispatcher::pushContext(void* context) {
   assert(GetCurrentThreadId() == threadId);
   resumingContexts.push(context);
 }
 
 void Dispatcher::remoteSpawn(std::function<void()>&& procedure) {
-  EnterCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
-  remoteSpawningProcedures.push(std::move(procedure));
-  if (!remoteNotificationSent) {
-    remoteNotificationSent = true;
+  // dispatcher takes all queued procedures on one completion, only the first one of them has to post it
+  if (remoteSpawningProcedures.push(std::move(procedure))) {
     if (PostQueuedCompletionStatus(completionPort, 0, 0, reinterpret_cast<LPOVERLAPPED>(remoteSpawnOverlapped)) == NULL) {
-      LeaveCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
       throw std::runtime_error("Dispatcher::remoteSpawn, PostQueuedCompletionStatus failed, result=" + std::to_string(GetLastError()));
     };
   }
+}
 
-  LeaveCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
+void Dispatcher::spawnRemoteProcedures() {
+  std::queue<std::function<void()>> procedures;
+  remoteSpawningProcedures.takeAll(procedures);
+  assert(!procedures.empty());
+  while (!procedures.empty()) {
+    spawn(std::move(procedures.front()));
+    procedures.pop();
+  }
 }
 
 void Dispatcher::spawn(std::function<void()>&& procedure) {
+  spawn(std::move(procedure), nullptr);
+}
+
+void Dispatcher::spawn(std::function<void()>&& procedure, const char* site) {
   assert(GetCurrentThreadId() == threadId);
   void* context;
   if (reusableContexts.empty()) {
-    context = CreateFiberEx(16384, 131072, 0, contextProcedureStatic, this);
+    context = CreateFiberEx(std::min<std::size_t>(16384, stackSize), stackSize, 0, contextProcedureStatic, this);
     if (context == NULL) {
       throw std::runtime_error("Dispatcher::spawn, CreateFiberEx failed, result=" + std::to_string(GetLastError()));
     }
@@ -216,6 +242,12 @@ void Dispatcher::spawn(std::function<void()>&& procedure) {
 
   resumingContexts.push(context);
   spawningProcedures.emplace(std::move(procedure));
+  spawningSites.push(site);
+}
+
+void Dispatcher::setTracer(DispatcherTracer* tracer) {
+  this->tracer = tracer;
+  contextResumeTime = std::chrono::steady_clock::now();
 }
 
 void Dispatcher::yield() {
@@ -239,16 +271,7 @@ void Dispatcher::yield() {
       assert(actual > 0);
       for (ULONG i = 0; i < actual; ++i) {
         if (entries[i].lpOverlapped == reinterpret_cast<LPOVERLAPPED>(remoteSpawnOverlapped)) {
-          EnterCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
-          assert(remoteNotificationSent);
-          assert(!remoteSpawningProcedures.empty());
-          do {
-            spawn(std::move(remoteSpawningProcedures.front()));
-            remoteSpawningProcedures.pop();
-          } while (!remoteSpawningProcedures.empty());
-
-          remoteNotificationSent = false;
-          LeaveCriticalSection(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection));
+          spawnRemoteProcedures();
           continue;
         }
 
@@ -298,6 +321,8 @@ void Dispatcher::contextProcedure() {
     assert(!spawningProcedures.empty());
     std::function<void()> procedure = std::move(spawningProcedures.front());
     spawningProcedures.pop();
+    currentSite = spawningSites.front();
+    spawningSites.pop();
     procedure();
     reusableContexts.push(GetCurrentFiber());
     dispatch();
@@ -17,26 +17,41 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <map>
 #include <queue>
 #include <stack>
 
+#include <System/RemoteProcedureQueue.h>
+
 namespace System {
 
+class DispatcherTracer;
+
 class Dispatcher {
 public:
+  // Fiber stacks reserve stackSize bytes and commit pages on demand, Windows keeps a guard page below them
+  static const std::size_t DEFAULT_STACK_SIZE = 128 * 1024;
+
   Dispatcher();
+  explicit Dispatcher(std::size_t stackSize);
   Dispatcher(const Dispatcher&) = delete;
   ~Dispatcher();
   Dispatcher& operator=(const Dispatcher&) = delete;
   void clear();
   void dispatch();
   void* getCurrentContext() const;
+  // Procedures queued by remoteSpawn and not spawned yet, can be called from any thread
+  std::size_t getRemoteSpawnQueueSize() const;
   void pushContext(void* context);
   void remoteSpawn(std::function<void()>&& procedure);
   void spawn(std::function<void()>&& procedure);
+  // Site tags the procedure for tracing and must stay valid while the dispatcher exists, a string literal names it best
+  void spawn(std::function<void()>&& procedure, const char* site);
+  // Scheduling events are reported to the tracer until it is replaced or reset with nullptr
+  void setTracer(DispatcherTracer* tracer);
   void yield();
 
   // Platform-specific
@@ -47,18 +62,23 @@ public:
 private:
   void* completionPort;
   std::size_t contextCount;
-  uint8_t criticalSection[2 * sizeof(long) + 4 * sizeof(void*)];
   std::queue<void*> resumingContexts;
-  bool remoteNotificationSent;
-  std::queue<std::function<void()>> remoteSpawningProcedures;
+  RemoteProcedureQueue remoteSpawningProcedures;
   uint8_t remoteSpawnOverlapped[4 * sizeof(void*)];
   std::stack<void*> reusableContexts;
   std::queue<std::function<void()>> spawningProcedures;
+  std::queue<const char*> spawningSites;
+  std::size_t stackSize;
   void* threadHandle;
   uint32_t threadId;
   std::multimap<uint64_t, void*> timers;
+  DispatcherTracer* tracer;
+  // tag of the running context, contexts keep their own on the stack while switched out
+  const char* currentSite;
+  std::chrono::steady_clock::time_point contextResumeTime;
 
   void contextProcedure();
+  void spawnRemoteProcedures();
   static void __stdcall contextProcedureStatic(void* context);
 };
 
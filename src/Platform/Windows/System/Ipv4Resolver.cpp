@@ -18,10 +18,7 @@
 #include "Ipv4Resolver.h"
 #include <cassert>
 #include <random>
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-#include <ws2tcpip.h>
+#include <System/HostLookup.h>
 #include <System/InterruptedException.h>
 #include <System/Ipv4Address.h>
 
@@ -71,28 +68,14 @@ Ipv4Address Ipv4Resolver::resolve(const std::string& host) {
     throw InterruptedException();
   }
 
-  addrinfo hints = { 0, AF_INET, SOCK_STREAM, IPPROTO_TCP, 0, NULL, NULL, NULL };
-  addrinfo* addressInfos;
-  int result = getaddrinfo(host.c_str(), NULL, &hints, &addressInfos);
-  if (result != 0) {
-    throw std::runtime_error("Ipv4Resolver::resolve, getaddrinfo failed, result=" + std::to_string(result));
-  }
-  
-  std::size_t count = 0;
-  for (addrinfo* addressInfo = addressInfos; addressInfo != nullptr; addressInfo = addressInfo->ai_next) {
-    ++count;
+  std::vector<uint32_t> addresses = lookupIpv4Addresses(*dispatcher, host);
+  if (stopped) {
+    throw InterruptedException();
   }
 
   std::mt19937 generator{ std::random_device()() };
-  std::size_t index = std::uniform_int_distribution<std::size_t>(0, count - 1)(generator);
-  addrinfo* addressInfo = addressInfos;
-  for (std::size_t i = 0; i < index; ++i) {
-    addressInfo = addressInfo->ai_next;
-  }
-
-  Ipv4Address address(ntohl(reinterpret_cast<sockaddr_in*>(addressInfo->ai_addr)->sin_addr.S_un.S_addr));
-  freeaddrinfo(addressInfo);
-  return address;
+  std::size_t index = std::uniform_int_distribution<std::size_t>(0, addresses.size() - 1)(generator);
+  return Ipv4Address(addresses[index]);
 }
 
 }
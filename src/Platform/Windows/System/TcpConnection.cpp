@@ -16,10 +16,14 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "TcpConnection.h"
+#include <algorithm>
 #include <cassert>
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <winsock2.h>
 #include <ws2ipdef.h>
 #include <System/InterruptedException.h>
@@ -30,6 +34,8 @@ namespace System {
 
 namespace {
 
+const std::size_t MAX_WRITE_BUFFERS = 16;
+
 struct TcpConnectionContext : public OVERLAPPED {
   void* context;
   bool interrupted;
@@ -168,24 +174,48 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 }
 
 std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    assert(dispatcher != nullptr);
+    assert(writeContext == nullptr);
+    if (stopped) {
+      throw InterruptedException();
+    }
+
+    if (shutdown(connection, SD_SEND) != 0) {
+      throw std::runtime_error("TcpConnection::write, shutdown failed, result=" + std::to_string(WSAGetLastError()));
+    }
+
+    return 0;
+  }
+
+  Buffer buffer = { data, size };
+  return write(&buffer, 1);
+}
+
+std::size_t TcpConnection::write(const Buffer* buffers, std::size_t count) {
   assert(dispatcher != nullptr);
   assert(writeContext == nullptr);
   if (stopped) {
     throw InterruptedException();
   }
 
-  if (size == 0) {
-    if (shutdown(connection, SD_SEND) != 0) {
-      throw std::runtime_error("TcpConnection::write, shutdown failed, result=" + std::to_string(WSAGetLastError()));
-    }
+  // buffers after MAX_WRITE_BUFFERS are left for the next call
+  WSABUF wsaBuffers[MAX_WRITE_BUFFERS];
+  count = std::min(count, MAX_WRITE_BUFFERS);
+  size_t size = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    wsaBuffers[i].len = static_cast<ULONG>(buffers[i].size);
+    wsaBuffers[i].buf = reinterpret_cast<char*>(const_cast<uint8_t*>(buffers[i].data));
+    size += buffers[i].size;
+  }
 
+  if (size == 0) {
     return 0;
   }
 
-  WSABUF buf{static_cast<ULONG>(size), reinterpret_cast<char*>(const_cast<uint8_t*>(data))};
   TcpConnectionContext context;
   context.hEvent = NULL;
-  if (WSASend(connection, &buf, 1, NULL, 0, &context, NULL) != 0) {
+  if (WSASend(connection, wsaBuffers, static_cast<DWORD>(count), NULL, 0, &context, NULL) != 0) {
     int lastError = WSAGetLastError();
     if (lastError != WSA_IO_PENDING) {
       throw std::runtime_error("TcpConnection::write, WSASend failed, result=" + std::to_string(lastError));
@@ -187,4 +187,8 @@ TcpConnection TcpConnector::connect(const Ipv4Address& address, uint16_t port) {
   throw std::runtime_error("TcpConnector::connect, " + message);
 }
 
+TcpConnection TcpConnector::connect(const std::string& path) {
+  throw std::runtime_error("TcpConnector::connect, Unix domain sockets are not supported");
+}
+
 }
@@ -38,6 +38,8 @@ public:
   void start();
   void stop();
   TcpConnection connect(const Ipv4Address& address, uint16_t port);
+  // Unix domain sockets are not supported on Windows, throws std::runtime_error
+  TcpConnection connect(const std::string& path);
 
 private:
   Dispatcher* dispatcher;
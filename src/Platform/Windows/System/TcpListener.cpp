@@ -81,6 +81,10 @@ TcpListener::TcpListener(Dispatcher& dispatcher, const Ipv4Address& address, uin
   throw std::runtime_error("TcpListener::TcpListener, " + message);
 }
 
+TcpListener::TcpListener(Dispatcher& dispatcher, const std::string& path) : dispatcher(nullptr) {
+  throw std::runtime_error("TcpListener::TcpListener, Unix domain sockets are not supported");
+}
+
 TcpListener::TcpListener(TcpListener&& other) : dispatcher(other.dispatcher) {
   if (dispatcher != nullptr) {
     assert(other.context == nullptr);
@@ -30,6 +30,8 @@ class TcpListener {
 public:
   TcpListener();
   TcpListener(Dispatcher& dispatcher, const Ipv4Address& address, uint16_t port);
+  // Unix domain sockets are not supported on Windows, throws std::runtime_error
+  TcpListener(Dispatcher& dispatcher, const std::string& path);
   TcpListener(const TcpListener&) = delete;
   TcpListener(TcpListener&& other);
   ~TcpListener();
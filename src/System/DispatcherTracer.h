@@ -0,0 +1,40 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace System {
+
+// Receives scheduling events of a dispatcher on its thread. Dispatcher without a tracer only checks for one.
+class DispatcherTracer {
+public:
+  virtual ~DispatcherTracer() {
+  }
+
+  // A context ran from being resumed until it blocked or yielded, site is the tag its procedure was spawned with
+  // or nullptr for untagged procedures and the context that runs the dispatcher
+  virtual void contextRan(std::chrono::nanoseconds duration, const char* site) = 0;
+  // Contexts left waiting to run when the dispatcher resumed one
+  virtual void contextResumed(std::size_t runQueueLength) = 0;
+  // Dispatcher had nothing to run and waited for events
+  virtual void eventsWaited(std::chrono::nanoseconds duration) = 0;
+};
+
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HostLookup.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#endif
+
+#include <System/Dispatcher.h>
+
+namespace System {
+
+namespace {
+
+const std::chrono::minutes HOST_LOOKUP_CACHE_TIME(5);
+// Names of seed and exclusive nodes are few, the limit only keeps arbitrary names from growing the cache
+const std::size_t HOST_LOOKUP_CACHE_SIZE = 1024;
+
+struct CachedLookup {
+  std::vector<uint32_t> addresses;
+  std::chrono::steady_clock::time_point expiration;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedLookup> cache;
+
+bool findCached(const std::string& host, std::vector<uint32_t>& addresses) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto it = cache.find(host);
+  if (it == cache.end()) {
+    return false;
+  }
+
+  if (it->second.expiration <= std::chrono::steady_clock::now()) {
+    cache.erase(it);
+    return false;
+  }
+
+  addresses = it->second.addresses;
+  return true;
+}
+
+void storeCached(const std::string& host, const std::vector<uint32_t>& addresses) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto now = std::chrono::steady_clock::now();
+  if (cache.size() >= HOST_LOOKUP_CACHE_SIZE) {
+    for (auto it = cache.begin(); it != cache.end();) {
+      if (it->second.expiration <= now) {
+        it = cache.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    if (cache.size() >= HOST_LOOKUP_CACHE_SIZE) {
+      return;
+    }
+  }
+
+  CachedLookup& entry = cache[host];
+  entry.addresses = addresses;
+  entry.expiration = now + HOST_LOOKUP_CACHE_TIME;
+}
+
+// Blocking lookup, returns getaddrinfo result
+int getAddresses(const std::string& host, std::vector<uint32_t>& addresses) {
+  addrinfo hints = { 0, AF_INET, SOCK_STREAM, IPPROTO_TCP, 0, NULL, NULL, NULL };
+  addrinfo* addressInfos;
+  int result = getaddrinfo(host.c_str(), NULL, &hints, &addressInfos);
+  if (result != 0) {
+    return result;
+  }
+
+  for (addrinfo* addressInfo = addressInfos; addressInfo != nullptr; addressInfo = addressInfo->ai_next) {
+    addresses.push_back(ntohl(reinterpret_cast<sockaddr_in*>(addressInfo->ai_addr)->sin_addr.s_addr));
+  }
+
+  freeaddrinfo(addressInfos);
+  return 0;
+}
+
+}
+
+std::vector<uint32_t> lookupIpv4Addresses(Dispatcher& dispatcher, const std::string& host) {
+  std::vector<uint32_t> addresses;
+  if (findCached(host, addresses)) {
+    return addresses;
+  }
+
+  // Context is resumed only after the helper thread is done with the locals, so it may use them by reference
+  int result = 0;
+  void* context = dispatcher.getCurrentContext();
+  std::thread([&] {
+    result = getAddresses(host, addresses);
+    dispatcher.remoteSpawn([&dispatcher, context] { dispatcher.pushContext(context); });
+  }).detach();
+
+  dispatcher.dispatch();
+  if (result != 0) {
+    throw std::runtime_error("Ipv4Resolver::resolve, getaddrinfo failed, result=" + std::to_string(result));
+  }
+
+  if (addresses.empty()) {
+    throw std::runtime_error("Ipv4Resolver::resolve, no addresses found");
+  }
+
+  storeCached(host, addresses);
+  return addresses;
+}
+
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace System {
+
+class Dispatcher;
+
+// Returns IPv4 addresses of the host in host byte order, throws std::runtime_error if it can't be resolved.
+// getaddrinfo runs on a helper thread while the calling context waits, so other contexts of the dispatcher keep
+// running while the name resolves or DNS times out. The lookup itself can't be interrupted. Results are cached for
+// HOST_LOOKUP_CACHE_TIME, getaddrinfo doesn't report TTL of the records.
+std::vector<uint32_t> lookupIpv4Addresses(Dispatcher& dispatcher, const std::string& host);
+
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Mutex.h"
+#include <cassert>
+#include <utility>
+
+namespace System {
+
+Mutex::Mutex() {
+}
+
+Mutex::Mutex(Dispatcher& dispatcher) : semaphore(dispatcher, 1) {
+}
+
+Mutex::Mutex(Mutex&& other) : semaphore(std::move(other.semaphore)) {
+}
+
+Mutex& Mutex::operator=(Mutex&& other) {
+  semaphore = std::move(other.semaphore);
+  return *this;
+}
+
+void Mutex::lock() {
+  semaphore.acquire();
+}
+
+bool Mutex::try_lock() {
+  return semaphore.tryAcquire();
+}
+
+void Mutex::unlock() {
+  assert(semaphore.get() == 0);
+  semaphore.release();
+}
+
+}
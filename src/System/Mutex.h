@@ -0,0 +1,44 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <System/Semaphore.h>
+
+namespace System {
+
+class Dispatcher;
+
+// Mutex for contexts of one dispatcher, lock suspends the context instead of blocking the thread. It is not recursive.
+// Method names match std::mutex, so it works with std::lock_guard and std::unique_lock.
+class Mutex {
+public:
+  Mutex();
+  explicit Mutex(Dispatcher& dispatcher);
+  Mutex(const Mutex&) = delete;
+  Mutex(Mutex&& other);
+  Mutex& operator=(const Mutex&) = delete;
+  Mutex& operator=(Mutex&& other);
+  void lock();
+  bool try_lock();
+  void unlock();
+
+private:
+  Semaphore semaphore;
+};
+
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <queue>
+
+namespace System {
+
+// Lock-free queue of procedures pushed by any thread and taken by the dispatcher thread. Pushed procedures form
+// a stack, the consumer takes it whole and reverses it, so procedures are taken in the order they were pushed.
+class RemoteProcedureQueue {
+public:
+  RemoteProcedureQueue() : head(nullptr), count(0) {
+  }
+
+  RemoteProcedureQueue(const RemoteProcedureQueue&) = delete;
+
+  ~RemoteProcedureQueue() {
+    Node* node = head.load(std::memory_order_acquire);
+    while (node != nullptr) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  RemoteProcedureQueue& operator=(const RemoteProcedureQueue&) = delete;
+
+  // Returns true if the queue was empty, the consumer has to be woken up only then
+  bool push(std::function<void()>&& procedure) {
+    Node* node = new Node(std::move(procedure));
+    count.fetch_add(1, std::memory_order_relaxed);
+    // once published, the node belongs to the consumer, so the head it replaced is kept here
+    Node* expected = head.load(std::memory_order_relaxed);
+    do {
+      node->next = expected;
+    } while (!head.compare_exchange_weak(expected, node, std::memory_order_release, std::memory_order_relaxed));
+
+    return expected == nullptr;
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_relaxed) == nullptr;
+  }
+
+  // Approximate while procedures are pushed
+  size_t size() const {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  // Appends all pushed procedures to procedures
+  void takeAll(std::queue<std::function<void()>>& procedures) {
+    Node* node = head.exchange(nullptr, std::memory_order_acquire);
+    Node* first = nullptr;
+    while (node != nullptr) {
+      Node* next = node->next;
+      node->next = first;
+      first = node;
+      node = next;
+    }
+
+    size_t taken = 0;
+    while (first != nullptr) {
+      Node* next = first->next;
+      procedures.push(std::move(first->procedure));
+      delete first;
+      first = next;
+      ++taken;
+    }
+
+    count.fetch_sub(taken, std::memory_order_relaxed);
+  }
+
+private:
+  struct Node {
+    explicit Node(std::function<void()>&& procedure) : procedure(std::move(procedure)), next(nullptr) {
+    }
+
+    std::function<void()> procedure;
+    Node* next;
+  };
+
+  std::atomic<Node*> head;
+  std::atomic<size_t> count;
+};
+
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Semaphore.h"
+#include <cassert>
+#include <System/Dispatcher.h>
+
+namespace System {
+
+namespace {
+
+struct SemaphoreWaiter {
+  SemaphoreWaiter* next;
+  void* context;
+};
+
+}
+
+Semaphore::Semaphore() : dispatcher(nullptr) {
+}
+
+Semaphore::Semaphore(Dispatcher& dispatcher, std::size_t value) : dispatcher(&dispatcher), value(value), first(nullptr) {
+}
+
+Semaphore::Semaphore(Semaphore&& other) : dispatcher(other.dispatcher) {
+  if (dispatcher != nullptr) {
+    assert(other.first == nullptr);
+    value = other.value;
+    first = nullptr;
+    other.dispatcher = nullptr;
+  }
+}
+
+Semaphore::~Semaphore() {
+  assert(dispatcher == nullptr || first == nullptr);
+}
+
+Semaphore& Semaphore::operator=(Semaphore&& other) {
+  assert(dispatcher == nullptr || first == nullptr);
+  dispatcher = other.dispatcher;
+  if (dispatcher != nullptr) {
+    assert(other.first == nullptr);
+    value = other.value;
+    first = nullptr;
+    other.dispatcher = nullptr;
+  }
+
+  return *this;
+}
+
+std::size_t Semaphore::get() const {
+  assert(dispatcher != nullptr);
+  return value;
+}
+
+void Semaphore::acquire() {
+  assert(dispatcher != nullptr);
+  if (tryAcquire()) {
+    return;
+  }
+
+  SemaphoreWaiter waiter = {nullptr, dispatcher->getCurrentContext()};
+  if (first != nullptr) {
+    static_cast<SemaphoreWaiter*>(last)->next = &waiter;
+  } else {
+    first = &waiter;
+  }
+
+  last = &waiter;
+  // release takes the waiter out of the queue and gives it the unit before resuming it
+  dispatcher->dispatch();
+  assert(waiter.context == dispatcher->getCurrentContext());
+  assert(dispatcher != nullptr);
+}
+
+bool Semaphore::tryAcquire() {
+  assert(dispatcher != nullptr);
+  // units go to waiters first, otherwise a context acquiring repeatedly could starve them
+  if (value == 0 || first != nullptr) {
+    return false;
+  }
+
+  --value;
+  return true;
+}
+
+void Semaphore::release() {
+  assert(dispatcher != nullptr);
+  if (first != nullptr) {
+    SemaphoreWaiter* waiter = static_cast<SemaphoreWaiter*>(first);
+    first = waiter->next;
+    dispatcher->pushContext(waiter->context);
+  } else {
+    ++value;
+  }
+}
+
+}
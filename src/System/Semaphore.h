@@ -0,0 +1,49 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+
+namespace System {
+
+class Dispatcher;
+
+// Counting semaphore for contexts of one dispatcher, acquire suspends the context instead of blocking the thread.
+// Waiters are served in order, release hands the unit to the first of them.
+class Semaphore {
+public:
+  Semaphore();
+  Semaphore(Dispatcher& dispatcher, std::size_t value);
+  Semaphore(const Semaphore&) = delete;
+  Semaphore(Semaphore&& other);
+  ~Semaphore();
+  Semaphore& operator=(const Semaphore&) = delete;
+  Semaphore& operator=(Semaphore&& other);
+  std::size_t get() const;
+  void acquire();
+  bool tryAcquire();
+  void release();
+
+private:
+  Dispatcher* dispatcher;
+  std::size_t value;
+  void* first;
+  void* last;
+};
+
+}
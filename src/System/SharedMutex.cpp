@@ -0,0 +1,148 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "SharedMutex.h"
+#include <cassert>
+#include <System/Dispatcher.h>
+
+namespace System {
+
+namespace {
+
+struct SharedMutexWaiter {
+  SharedMutexWaiter* next;
+  void* context;
+  bool exclusive;
+};
+
+}
+
+SharedMutex::SharedMutex() : dispatcher(nullptr) {
+}
+
+SharedMutex::SharedMutex(Dispatcher& dispatcher) : dispatcher(&dispatcher), writer(false), readers(0), first(nullptr) {
+}
+
+SharedMutex::SharedMutex(SharedMutex&& other) : dispatcher(other.dispatcher) {
+  if (dispatcher != nullptr) {
+    assert(!other.writer && other.readers == 0);
+    writer = false;
+    readers = 0;
+    first = nullptr;
+    other.dispatcher = nullptr;
+  }
+}
+
+SharedMutex::~SharedMutex() {
+  assert(dispatcher == nullptr || (!writer && readers == 0));
+}
+
+SharedMutex& SharedMutex::operator=(SharedMutex&& other) {
+  assert(dispatcher == nullptr || (!writer && readers == 0));
+  dispatcher = other.dispatcher;
+  if (dispatcher != nullptr) {
+    assert(!other.writer && other.readers == 0);
+    writer = false;
+    readers = 0;
+    first = nullptr;
+    other.dispatcher = nullptr;
+  }
+
+  return *this;
+}
+
+void SharedMutex::lock() {
+  if (!try_lock()) {
+    wait(true);
+  }
+}
+
+bool SharedMutex::try_lock() {
+  assert(dispatcher != nullptr);
+  if (writer || readers > 0 || first != nullptr) {
+    return false;
+  }
+
+  writer = true;
+  return true;
+}
+
+void SharedMutex::unlock() {
+  assert(dispatcher != nullptr);
+  assert(writer);
+  writer = false;
+  resumeWaiters();
+}
+
+void SharedMutex::lock_shared() {
+  if (!try_lock_shared()) {
+    wait(false);
+  }
+}
+
+bool SharedMutex::try_lock_shared() {
+  assert(dispatcher != nullptr);
+  if (writer || first != nullptr) {
+    return false;
+  }
+
+  ++readers;
+  return true;
+}
+
+void SharedMutex::unlock_shared() {
+  assert(dispatcher != nullptr);
+  assert(readers > 0);
+  --readers;
+  if (readers == 0) {
+    resumeWaiters();
+  }
+}
+
+void SharedMutex::wait(bool exclusive) {
+  SharedMutexWaiter waiter = {nullptr, dispatcher->getCurrentContext(), exclusive};
+  if (first != nullptr) {
+    static_cast<SharedMutexWaiter*>(last)->next = &waiter;
+  } else {
+    first = &waiter;
+  }
+
+  last = &waiter;
+  // resumeWaiters takes the waiter out of the queue and gives it the lock before resuming it
+  dispatcher->dispatch();
+  assert(waiter.context == dispatcher->getCurrentContext());
+  assert(dispatcher != nullptr);
+}
+
+void SharedMutex::resumeWaiters() {
+  SharedMutexWaiter* waiter = static_cast<SharedMutexWaiter*>(first);
+  if (waiter != nullptr && waiter->exclusive) {
+    writer = true;
+    first = waiter->next;
+    dispatcher->pushContext(waiter->context);
+    return;
+  }
+
+  while (waiter != nullptr && !waiter->exclusive) {
+    ++readers;
+    first = waiter->next;
+    dispatcher->pushContext(waiter->context);
+    waiter = static_cast<SharedMutexWaiter*>(first);
+  }
+}
+
+}
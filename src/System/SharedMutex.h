@@ -0,0 +1,57 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+
+namespace System {
+
+class Dispatcher;
+
+// Reader/writer mutex for contexts of one dispatcher, locking suspends the context instead of blocking the thread.
+// Waiters are served in order: a waiting writer holds back readers that come after it, and a released lock goes to
+// the first waiting writer or to all readers waiting before the next writer. It is not recursive.
+// Method names match std::shared_timed_mutex, so it works with std::lock_guard and Common::SharedLockGuard.
+class SharedMutex {
+public:
+  SharedMutex();
+  explicit SharedMutex(Dispatcher& dispatcher);
+  SharedMutex(const SharedMutex&) = delete;
+  SharedMutex(SharedMutex&& other);
+  ~SharedMutex();
+  SharedMutex& operator=(const SharedMutex&) = delete;
+  SharedMutex& operator=(SharedMutex&& other);
+  void lock();
+  bool try_lock();
+  void unlock();
+  void lock_shared();
+  bool try_lock_shared();
+  void unlock_shared();
+
+private:
+  Dispatcher* dispatcher;
+  bool writer;
+  std::size_t readers;
+  void* first;
+  void* last;
+
+  void wait(bool exclusive);
+  void resumeWaiters();
+};
+
+}
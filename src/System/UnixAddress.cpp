@@ -0,0 +1,37 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "UnixAddress.h"
+
+namespace System {
+
+namespace {
+
+const char UNIX_ADDRESS_PREFIX[] = "unix:";
+const size_t UNIX_ADDRESS_PREFIX_SIZE = sizeof(UNIX_ADDRESS_PREFIX) - 1;
+
+}
+
+bool isUnixAddress(const std::string& address) {
+  return address.compare(0, UNIX_ADDRESS_PREFIX_SIZE, UNIX_ADDRESS_PREFIX) == 0;
+}
+
+std::string getUnixPath(const std::string& address) {
+  return address.substr(UNIX_ADDRESS_PREFIX_SIZE);
+}
+
+}
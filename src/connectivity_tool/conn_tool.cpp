@@ -15,8 +15,13 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <chrono>
+#include <deque>
+#include <set>
+
 #include <boost/optional.hpp>
 #include <boost/program_options.hpp>
+#include <boost/uuid/uuid.hpp>
 
 #include <System/Dispatcher.h>
 #include <System/Event.h>
@@ -30,6 +35,7 @@
 #include "Common/command_line.h"
 #include "Common/StringTools.h"
 #include "crypto/crypto.h"
+#include "p2p/p2p_networks.h"
 #include "p2p/p2p_protocol_defs.h"
 #include "p2p/LevinProtocol.h"
 #include "rpc/core_rpc_server_commands_defs.h"
@@ -40,7 +46,7 @@ namespace po = boost::program_options;
 using namespace CryptoNote;
 
 namespace {
-  const command_line::arg_descriptor<std::string, true> arg_ip           = {"ip", "set ip"};
+  const command_line::arg_descriptor<std::string> arg_ip                 = {"ip", "set ip", ""};
   const command_line::arg_descriptor<uint16_t>      arg_port = { "port", "set port" };
   const command_line::arg_descriptor<uint16_t>      arg_rpc_port           = {"rpc_port", "set rpc port"};
   const command_line::arg_descriptor<uint32_t, true> arg_timeout         = {"timeout", "set timeout"};
@@ -50,6 +56,9 @@ namespace {
   const command_line::arg_descriptor<bool>        arg_request_stat_info  = {"request_stat_info", "request statistics information"};
   const command_line::arg_descriptor<bool>        arg_request_net_state  = {"request_net_state", "request network state information (peer list, connections count)"};
   const command_line::arg_descriptor<bool>        arg_get_daemon_info    = {"rpc_get_daemon_info", "request daemon state info vie rpc (--rpc_port option should be set ).", "", true};
+  const command_line::arg_descriptor<bool>        arg_crawl              = {"crawl", "walk peer lists starting from --ip or seed nodes and print all nodes found as json"};
+  const command_line::arg_descriptor<size_t>      arg_crawl_concurrency  = {"crawl_concurrency", "nodes crawled at once", 256};
+  const command_line::arg_descriptor<size_t>      arg_crawl_max_nodes    = {"crawl_max_nodes", "stop discovering nodes after this many", 100000};
 }
 
 struct response_schema {
@@ -185,12 +194,24 @@ bool print_COMMAND_REQUEST_NETWORK_STATE(const COMMAND_REQUEST_NETWORK_STATE::re
   return true;
 }
 //---------------------------------------------------------------------------------------------------------------
+void sign_proof_of_trust(proof_of_trust& pot, const crypto::secret_key& prvk) {
+  crypto::public_key pubk = AUTO_VAL_INIT(pubk);
+  Common::podFromHex(P2P_STAT_TRUSTED_PUB_KEY, pubk);
+  crypto::hash h = get_proof_of_trust_hash(pot);
+  crypto::generate_signature(h, pubk, prvk, pot.sign);
+}
+//---------------------------------------------------------------------------------------------------------------
 bool handle_get_daemon_info(po::variables_map& vm) {
   if(!command_line::has_arg(vm, arg_rpc_port)) {
     std::cout << "ERROR: rpc port not set" << ENDL;
     return false;
   }
 
+  if (command_line::get_arg(vm, arg_ip).empty()) {
+    std::cout << "ERROR: ip not set" << ENDL;
+    return false;
+  }
+
   try {
     System::Dispatcher dispatcher;
     HttpClient httpClient(dispatcher, command_line::get_arg(vm, arg_ip), command_line::get_arg(vm, arg_rpc_port));
@@ -220,6 +241,11 @@ bool handle_get_daemon_info(po::variables_map& vm) {
 }
 //---------------------------------------------------------------------------------------------------------------
 bool handle_request_stat(po::variables_map& vm, peerid_type peer_id) {
+  if (command_line::get_arg(vm, arg_ip).empty()) {
+    std::cout << "{" << ENDL << "  \"status\": \"ERROR: " << "ip not set \"" << ENDL << "}";
+    return false;
+  }
+
   if(!command_line::has_arg(vm, arg_priv_key)) {
     std::cout << "{" << ENDL << "  \"status\": \"ERROR: " << "secret key not set \"" << ENDL << "}";
     return false;
@@ -265,10 +291,7 @@ bool handle_request_stat(po::variables_map& vm, peerid_type peer_id) {
     proof_of_trust pot = AUTO_VAL_INIT(pot);
     pot.peer_id = peer_id;
     pot.time = time(NULL);
-    crypto::public_key pubk = AUTO_VAL_INIT(pubk);
-    Common::podFromHex(P2P_STAT_TRUSTED_PUB_KEY, pubk);
-    crypto::hash h = get_proof_of_trust_hash(pot);
-    crypto::generate_signature(h, pubk, prvk, pot.sign);
+    sign_proof_of_trust(pot, prvk);
 
     if (command_line::get_arg(vm, arg_request_stat_info)) {
       COMMAND_REQUEST_STAT_INFO::request req = AUTO_VAL_INIT(req);
@@ -293,8 +316,7 @@ bool handle_request_stat(po::variables_map& vm, peerid_type peer_id) {
 
     if (command_line::get_arg(vm, arg_request_net_state))  {
       ++pot.time;
-      h = get_proof_of_trust_hash(pot);
-      crypto::generate_signature(h, pubk, prvk, pot.sign);
+      sign_proof_of_trust(pot, prvk);
       COMMAND_REQUEST_NETWORK_STATE::request req = AUTO_VAL_INIT(req);
       COMMAND_REQUEST_NETWORK_STATE::response res = AUTO_VAL_INIT(res);
       req.tr = pot;
@@ -322,6 +344,196 @@ bool handle_request_stat(po::variables_map& vm, peerid_type peer_id) {
   return true;
 }
 
+//---------------------------------------------------------------------------------------------------------------
+struct crawled_node {
+  net_address adr;
+  std::string status;
+  peerid_type peer_id;
+  uint64_t height;
+  crypto::hash top_id;
+  uint8_t p2p_version;
+  std::string version;
+  uint64_t rtt;
+  size_t peers_count;
+};
+
+// Handshake is answered by any node without a trusted key and carries its height, protocol version and a part of its
+// white peer list. Crawler announces port 0, so the node does not try to connect back and add it to peer lists.
+void crawl_node(System::Dispatcher& dispatcher, crawled_node& node, unsigned timeout, const crypto::secret_key* prvk,
+                std::list<peerlist_entry>& peers) {
+  System::TcpConnector connector(dispatcher);
+  System::TcpConnection connection;
+
+  auto start = std::chrono::steady_clock::now();
+  withTimeout(dispatcher, connector, timeout, [&] {
+    connection = connector.connect(System::Ipv4Address(Common::ipAddressToString(node.adr.ip)), static_cast<uint16_t>(node.adr.port));
+  });
+
+  node.rtt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  LevinProtocol levin(connection);
+  COMMAND_HANDSHAKE::request req = AUTO_VAL_INIT(req);
+  COMMAND_HANDSHAKE::response rsp = AUTO_VAL_INIT(rsp);
+  req.node_data.network_id = BYTECOIN_NETWORK;
+  req.node_data.local_time = time(NULL);
+  req.node_data.my_port = 0;
+  req.node_data.peer_id = crypto::rand<peerid_type>();
+  req.payload_data.current_height = 0;
+  req.payload_data.top_id = null_hash;
+
+  withTimeout(dispatcher, connection, timeout, [&] {
+    levin.invoke(COMMAND_HANDSHAKE::ID, req, rsp);
+  });
+
+  if (rsp.node_data.network_id != BYTECOIN_NETWORK) {
+    throw std::runtime_error("wrong network");
+  }
+
+  node.status = "OK";
+  node.peer_id = rsp.node_data.peer_id;
+  node.height = rsp.payload_data.current_height;
+  node.top_id = rsp.payload_data.top_id;
+  node.p2p_version = rsp.payload_data.version;
+  node.peers_count = rsp.local_peerlist.size();
+  peers = std::move(rsp.local_peerlist);
+
+  if (prvk != nullptr) {
+    COMMAND_REQUEST_STAT_INFO::request statReq = AUTO_VAL_INIT(statReq);
+    COMMAND_REQUEST_STAT_INFO::response statRsp = AUTO_VAL_INIT(statRsp);
+    statReq.tr.peer_id = node.peer_id;
+    statReq.tr.time = time(NULL);
+    sign_proof_of_trust(statReq.tr, *prvk);
+
+    try {
+      withTimeout(dispatcher, connection, timeout, [&] {
+        levin.invoke(COMMAND_REQUEST_STAT_INFO::ID, statReq, statRsp);
+      });
+      node.version = statRsp.version;
+    } catch (const std::exception&) {
+      // node is reachable anyway, version is optional
+    }
+  }
+}
+//---------------------------------------------------------------------------------------------------------------
+bool handle_crawl(po::variables_map& vm) {
+  unsigned timeout = command_line::get_arg(vm, arg_timeout);
+  size_t concurrency = std::max<size_t>(1, command_line::get_arg(vm, arg_crawl_concurrency));
+  size_t maxNodes = command_line::get_arg(vm, arg_crawl_max_nodes);
+
+  crypto::secret_key prvk = AUTO_VAL_INIT(prvk);
+  bool hasKey = command_line::has_arg(vm, arg_priv_key) && !command_line::get_arg(vm, arg_priv_key).empty();
+  if (hasKey && !Common::podFromHex(command_line::get_arg(vm, arg_priv_key), prvk)) {
+    std::cout << "ERROR: wrong secret key set" << ENDL;
+    return false;
+  }
+
+  // coroutines keep references to their nodes while others append, deque does not move elements
+  std::deque<crawled_node> nodes;
+  std::set<std::pair<uint32_t, uint32_t>> knownAddresses;
+  std::deque<size_t> pending;
+  auto addNode = [&](const net_address& adr) {
+    if (adr.ip == 0 || adr.port == 0 || nodes.size() >= maxNodes || !knownAddresses.insert(std::make_pair(adr.ip, adr.port)).second) {
+      return;
+    }
+
+    crawled_node node = AUTO_VAL_INIT(node);
+    node.adr = adr;
+    nodes.push_back(node);
+    pending.push_back(nodes.size() - 1);
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  try {
+    System::Dispatcher dispatcher;
+    System::Ipv4Resolver resolver(dispatcher);
+
+    // crawl starts from the node given by --ip and --port, or from the seed nodes
+    std::vector<std::string> seeds;
+    if (!command_line::get_arg(vm, arg_ip).empty()) {
+      uint16_t port = command_line::has_arg(vm, arg_port) ? command_line::get_arg(vm, arg_port) : static_cast<uint16_t>(P2P_DEFAULT_PORT);
+      seeds.push_back(command_line::get_arg(vm, arg_ip) + ":" + std::to_string(port));
+    } else {
+      seeds.assign(std::begin(SEED_NODES), std::end(SEED_NODES));
+    }
+
+    for (const std::string& seed : seeds) {
+      size_t pos = seed.find_last_of(':');
+      try {
+        auto addr = resolver.resolve(seed.substr(0, pos));
+        addNode(net_address{ hostToNetwork(addr.getValue()), Common::fromString<uint32_t>(seed.substr(pos + 1)) });
+      } catch (const std::exception& e) {
+        std::cerr << "Failed to resolve " << seed << ": " << e.what() << ENDL;
+      }
+    }
+
+    // every node is crawled in its own coroutine, at most concurrency of them are in flight
+    System::Event nodeCrawled(dispatcher);
+    size_t active = 0;
+    for (;;) {
+      while (!pending.empty() && active < concurrency) {
+        size_t index = pending.front();
+        pending.pop_front();
+        ++active;
+        dispatcher.spawn([&, index] {
+          std::list<peerlist_entry> peers;
+          try {
+            crawl_node(dispatcher, nodes[index], timeout, hasKey ? &prvk : nullptr, peers);
+          } catch (const std::exception& e) {
+            nodes[index].status = std::string("ERROR: ") + e.what();
+          }
+
+          for (const peerlist_entry& peer : peers) {
+            addNode(peer.adr);
+          }
+
+          --active;
+          nodeCrawled.set();
+        });
+      }
+
+      if (active == 0) {
+        break;
+      }
+
+      nodeCrawled.wait();
+      nodeCrawled.clear();
+      std::cerr << "Crawled " << nodes.size() - pending.size() - active << " of " << nodes.size() << " nodes\r";
+    }
+  } catch (const std::exception& e) {
+    std::cout << "ERROR: " << e.what() << std::endl;
+    return false;
+  }
+
+  size_t reachable = 0;
+  for (const crawled_node& node : nodes) {
+    if (node.status == "OK") {
+      ++reachable;
+    }
+  }
+
+  std::cout << "{" << ENDL
+    << "  \"elapsed_ms\": " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << "," << ENDL
+    << "  \"discovered\": " << nodes.size() << "," << ENDL
+    << "  \"reachable\": " << reachable << "," << ENDL
+    << "  \"nodes\": [" << ENDL;
+
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const crawled_node& node = nodes[i];
+    std::cout << "    {\"ip\": \"" << Common::ipAddressToString(node.adr.ip) << "\", \"port\": " << node.adr.port;
+    if (node.status == "OK") {
+      std::cout << ", \"peer_id\": \"" << node.peer_id << "\", \"height\": " << node.height << ", \"top_id\": \"" <<
+        Common::podToHex(node.top_id) << "\", \"p2p_version\": " << static_cast<unsigned>(node.p2p_version) << ", \"version\": \"" <<
+        node.version << "\", \"rtt_ms\": " << node.rtt << ", \"peers\": " << node.peers_count;
+    }
+
+    std::cout << ", \"status\": \"" << (node.status.empty() ? std::string("ERROR: not crawled") : node.status) << "\"}" <<
+      (i + 1 != nodes.size() ? "," : "") << ENDL;
+  }
+
+  std::cout << "  ]" << ENDL << "}" << std::endl;
+  return true;
+}
+
 //---------------------------------------------------------------------------------------------------------------
 bool generate_and_print_keys() {
   crypto::public_key pk = AUTO_VAL_INIT(pk);
@@ -348,6 +560,9 @@ int main(int argc, char *argv[]) {
   command_line::add_arg(desc_params, arg_peer_id);
   command_line::add_arg(desc_params, arg_priv_key);
   command_line::add_arg(desc_params, arg_get_daemon_info);
+  command_line::add_arg(desc_params, arg_crawl);
+  command_line::add_arg(desc_params, arg_crawl_concurrency);
+  command_line::add_arg(desc_params, arg_crawl_max_nodes);
 
   po::options_description desc_all;
   desc_all.add(desc_general).add(desc_params);
@@ -378,6 +593,10 @@ int main(int argc, char *argv[]) {
     return handle_get_daemon_info(vm) ? 0 : 1;
   } 
   
+  if (command_line::has_arg(vm, arg_crawl)) {
+    return handle_crawl(vm) ? 0 : 1;
+  }
+
   if (command_line::has_arg(vm, arg_generate_keys)) {
     return generate_and_print_keys() ? 0 : 1;
   }
@@ -8,7 +8,16 @@ Public domain.
 #include <stdio.h>
 #include <sys/param.h>
 
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
 #include "chacha8.h"
+#include "initializer.h"
 #include "Common/int-util.h"
 
 /*
@@ -37,7 +46,8 @@ Public domain.
 
 static const char sigma[] = "expand 32-byte k";
 
-void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+/* Starts at block counter, so it continues where the vectorized version stops */
+static void chacha8_ref(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, uint64_t counter, char* cipher) {
   uint32_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
   uint32_t j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
   char* ctarget = 0;
@@ -58,8 +68,8 @@ void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t*
   j9  = U8TO32_LITTLE(key + 20);
   j10 = U8TO32_LITTLE(key + 24);
   j11 = U8TO32_LITTLE(key + 28);
-  j12 = 0;
-  j13 = 0;
+  j12 = (uint32_t)counter;
+  j13 = (uint32_t)(counter >> 32);
   j14 = U8TO32_LITTLE(iv + 0);
   j15 = U8TO32_LITTLE(iv + 4);
 
@@ -165,3 +175,105 @@ void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t*
     data = (uint8_t*)data + 64;
   }
 }
+
+#define ROTATE_SSE2(v,c) (_mm_or_si128(_mm_slli_epi32((v), (c)), _mm_srli_epi32((v), 32 - (c))))
+
+/* swaps 16-bit halves of each word */
+#define ROTATE16_SSE2(v) (_mm_shufflehi_epi16(_mm_shufflelo_epi16((v), 0xb1), 0xb1))
+
+#define QUARTERROUND_SSE2(a,b,c,d) \
+  a = _mm_add_epi32(a,b); d = ROTATE16_SSE2(_mm_xor_si128(d,a)); \
+  c = _mm_add_epi32(c,d); b = ROTATE_SSE2(_mm_xor_si128(b,c),12); \
+  a = _mm_add_epi32(a,b); d = ROTATE_SSE2(_mm_xor_si128(d,a), 8); \
+  c = _mm_add_epi32(c,d); b = ROTATE_SSE2(_mm_xor_si128(b,c), 7);
+
+/*
+ * Four consecutive blocks at once, lane k of x[i] is word i of block k. Words are transposed back to blocks for
+ * the xor with data, the tail shorter than four blocks is left to chacha8_ref. Data is little endian on x86.
+ */
+static void chacha8_sse2(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+  uint32_t input[16];
+  __m128i j[16];
+  __m128i x[16];
+  uint64_t counter = 0;
+  int i;
+
+  input[0] = U8TO32_LITTLE(sigma + 0);
+  input[1] = U8TO32_LITTLE(sigma + 4);
+  input[2] = U8TO32_LITTLE(sigma + 8);
+  input[3] = U8TO32_LITTLE(sigma + 12);
+  for (i = 0; i < 8; ++i) {
+    input[4 + i] = U8TO32_LITTLE(key + 4 * i);
+  }
+  input[14] = U8TO32_LITTLE(iv + 0);
+  input[15] = U8TO32_LITTLE(iv + 4);
+  for (i = 0; i < 16; ++i) {
+    j[i] = _mm_set1_epi32((int)input[i]);
+  }
+
+  while (length >= 256) {
+    j[12] = _mm_set_epi32((int)(uint32_t)(counter + 3), (int)(uint32_t)(counter + 2), (int)(uint32_t)(counter + 1), (int)(uint32_t)counter);
+    j[13] = _mm_set_epi32((int)(uint32_t)((counter + 3) >> 32), (int)(uint32_t)((counter + 2) >> 32), (int)(uint32_t)((counter + 1) >> 32), (int)(uint32_t)(counter >> 32));
+    for (i = 0; i < 16; ++i) {
+      x[i] = j[i];
+    }
+
+    for (i = 8; i > 0; i -= 2) {
+      QUARTERROUND_SSE2(x[0], x[4], x[8],x[12])
+      QUARTERROUND_SSE2(x[1], x[5], x[9],x[13])
+      QUARTERROUND_SSE2(x[2], x[6],x[10],x[14])
+      QUARTERROUND_SSE2(x[3], x[7],x[11],x[15])
+      QUARTERROUND_SSE2(x[0], x[5],x[10],x[15])
+      QUARTERROUND_SSE2(x[1], x[6],x[11],x[12])
+      QUARTERROUND_SSE2(x[2], x[7], x[8],x[13])
+      QUARTERROUND_SSE2(x[3], x[4], x[9],x[14])
+    }
+
+    for (i = 0; i < 16; i += 4) {
+      __m128i a0 = _mm_add_epi32(x[i + 0], j[i + 0]);
+      __m128i a1 = _mm_add_epi32(x[i + 1], j[i + 1]);
+      __m128i a2 = _mm_add_epi32(x[i + 2], j[i + 2]);
+      __m128i a3 = _mm_add_epi32(x[i + 3], j[i + 3]);
+      __m128i t0 = _mm_unpacklo_epi32(a0, a1);
+      __m128i t1 = _mm_unpacklo_epi32(a2, a3);
+      __m128i t2 = _mm_unpackhi_epi32(a0, a1);
+      __m128i t3 = _mm_unpackhi_epi32(a2, a3);
+      const __m128i* in = (const __m128i*)((const uint8_t*)data + 4 * i);
+      __m128i* out = (__m128i*)(cipher + 4 * i);
+      _mm_storeu_si128(out + 0, _mm_xor_si128(_mm_loadu_si128(in + 0), _mm_unpacklo_epi64(t0, t1)));
+      _mm_storeu_si128(out + 4, _mm_xor_si128(_mm_loadu_si128(in + 4), _mm_unpackhi_epi64(t0, t1)));
+      _mm_storeu_si128(out + 8, _mm_xor_si128(_mm_loadu_si128(in + 8), _mm_unpacklo_epi64(t2, t3)));
+      _mm_storeu_si128(out + 12, _mm_xor_si128(_mm_loadu_si128(in + 12), _mm_unpackhi_epi64(t2, t3)));
+    }
+
+    counter += 4;
+    length -= 256;
+    cipher += 256;
+    data = (const uint8_t*)data + 256;
+  }
+
+  chacha8_ref(data, length, key, iv, counter, cipher);
+}
+
+static void chacha8_generic(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+  chacha8_ref(data, length, key, iv, 0, cipher);
+}
+
+static void (*chacha8_fp)(const void*, size_t, const uint8_t*, const uint8_t*, char*) = &chacha8_generic;
+
+void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher) {
+  (*chacha8_fp)(data, length, key, iv, cipher);
+}
+
+INITIALIZER(detect_sse2) {
+  int edx;
+#if defined(_MSC_VER)
+  int cpuinfo[4];
+  __cpuid(cpuinfo, 1);
+  edx = cpuinfo[3];
+#else
+  int a, b, c;
+  __cpuid(1, a, b, c, edx);
+#endif
+  chacha8_fp = (edx & (1 << 26)) != 0 ? &chacha8_sse2 : &chacha8_generic;
+}
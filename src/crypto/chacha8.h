@@ -8,6 +8,7 @@
 
 #if defined(__cplusplus)
 #include <memory.h>
+#include <string>
 
 #include "hash.h"
 
@@ -830,6 +830,842 @@ const ge_precomp ge_base[32][8] = {
   }
 };
 
+/* base16[i][j] = (j+1)*16*256^i*B, odd radix 16 positions, so ge_scalarmult_base needs no doublings */
+const ge_precomp ge_base16[32][8] = {
+  {
+    {{26223094, -12506805, -817594, -6574538, -18413955, 13765386, 18686369, -3396849, -7690672, 5303412},
+     {20852230, 1340053, -15306791, 6107716, -23311853, 8966632, -17691495, -15696681, -20600407, -13383612},
+     {-24458581, -6348954, 15021041, 7419977, 24989846, 1575285, -1464843, 14432789, -30182382, 8836379}},
+    {{25502114, 10391924, -26826463, -4050907, -26716962, 3269111, 7668966, -13852660, -8419601, -520106},
+     {-24607933, -125399, 27759914, 11704479, -13092015, -4246277, -31528997, 7225004, -27484501, 2725107},
+     {-27564026, 11085236, -17642282, 12970677, -175541, 5844177, -25815899, -6927864, -28278469, -10902258}},
+    {{28030621, 12483271, -25195826, -5406909, -18234667, -6891922, -33047916, 5155062, 24723735, 13276372},
+     {-27129960, 3588874, -22456573, 13304690, 24473799, 11062727, 24979328, 5931312, 13919550, 6259887},
+     {-10189769, -7263816, -279947, 13385854, 29420949, -12969307, -23945129, 9247089, -8854330, 2360016}},
+    {{1486148, 257970, 33324453, 14599991, 21718373, 12985333, -7620229, -14188035, 11555299, -15970292},
+     {-6462181, -12130342, 6177105, -16246374, -8117458, 9121956, 16433140, 14850752, 11457245, 14449899},
+     {-1000256, 6079, 25942700, -9008072, -29696963, 8709793, -3663384, 13501444, -31660106, -13571732}},
+    {{20816112, 1931570, 19511135, -12874295, -18560501, 13026401, -14689286, 3158043, -2185620, -4741347},
+     {12122792, 2690359, 8480807, -1350476, -31706150, -8656851, 4373013, 11230151, -14211542, -916169},
+     {5110021, 4273512, 5925105, 5605386, -1315143, -10679911, 5648811, 2137817, 1243403, -9785047}},
+    {{25121076, 8602287, 29936647, -6877539, -33413339, -6767260, -20407100, 4635621, 19352480, 7360883},
+     {-20371192, -3368241, 3938506, 1520415, 22365898, 1723267, 26933925, -15185683, -1996297, 7239312},
+     {32757571, 923933, -12720547, -8693969, 14249519, 5990430, 18635548, 12333130, 1140694, 9249959}},
+    {{17407970, -15257465, -16996093, 9855303, 18142982, 2391553, -2035036, 8245277, -12340585, -14058334},
+     {7843323, -8705304, -15486198, -9908390, 14745055, -11217004, -30032107, -11577090, -5326908, -10019347},
+     {-27472011, -9057975, 25934454, 889001, -29071154, -16189314, 30398126, -3704042, -21726816, -4450942}},
+    {{18572438, 13390462, -1291416, -13971098, -21571726, -14145612, 21104946, -15003393, 18527392, -8247942},
+     {-8672907, -5790586, 22819840, 15232814, -27083876, -8187835, -27833833, -10942465, -18512588, -3852411},
+     {16280619, -12797117, -352962, 9451951, -19811304, 12151784, -19903486, 5076884, -16935204, -3175527}}
+  },
+  {
+    {{-29755419, 6305835, -22834437, 1218102, 14106849, -3320406, 33180036, 7098280, 16480428, -10816293},
+     {-25409045, -2090218, -3321267, 6706121, 1684499, -3393205, -5561614, -6662956, 6948745, -9283878},
+     {18131284, -12160957, -11401895, -5986896, -5516845, -492965, -4079275, 1219798, -15173186, 3647927}},
+    {{-22513286, 12246326, -18464073, -7350751, 33281396, 9110981, 1027358, -6331104, 7679661, 2842418},
+     {-12261954, -5253859, 6370637, 4487386, -9942686, -11121872, -1484289, 3910609, 8734779, -9653790},
+     {20187343, -12265314, -5076413, 1625266, -5489572, 4035687, 31030596, -7400186, -25735164, 2419199}},
+    {{11080345, 5771544, -25438435, 2341831, 33357664, -7709139, 989408, 10996986, 7088054, -1307096},
+     {-32057391, 2062735, -27657054, 14997402, -24256513, 747392, -18904030, 8416795, 26888753, -5729108},
+     {-9858810, 4617589, -12692517, -2172298, 21515963, 12161333, 7668390, -3483423, -581023, -10257578}},
+    {{-15739746, -11220585, 19995470, -7561731, -31096311, -2785751, 23370033, 2652913, -19683896, -1586607},
+     {21052810, -1610886, 13610781, 11319631, -3579929, -8738841, 29919090, 7572283, 29080032, -5602195},
+     {-20410884, 9161070, 2962171, -11180144, 9727648, -11619100, -30948360, -4939465, 29083304, -638292}},
+    {{-21773417, -1508058, 10896193, 12876401, 4668072, -9102352, -28546348, -15462477, 32835806, 6796376},
+     {-16684034, -14049046, 23966554, 7312936, -29277827, 14955947, 8826854, -864916, 4594064, 6718517},
+     {-2300195, 9123234, 32090817, 2372390, 33346979, 8403512, 16034065, 8360168, -15362715, -14618773}},
+    {{14319862, -2932051, -255270, 3129732, -32956167, 7314853, 2700503, 15679648, 17420152, 7455050},
+     {-13305271, 247074, -23322801, -8277974, 4308014, -1898563, 3913714, 2081858, 10346090, 13245188},
+     {-11626284, -6326110, 25953886, -11678736, 5442956, 6333322, 15626037, -16250128, -22370389, 8779608}},
+    {{-24375608, -3674512, 5263740, -3729328, 191392, -9678996, 30183127, 12667180, -18489489, 1840682},
+     {9313987, -969719, -1420361, -16094298, -8267168, 5645141, 21859230, -13851699, 33002917, -90360},
+     {-13502849, 12628279, -10126019, 4752872, -4941834, 6086069, 626606, -8795943, 20581562, 13551728}},
+    {{-18641829, -1151976, -25627818, 7354577, -16878411, -13424373, -13158667, 14873054, 24830217, 7401132},
+     {8228420, -5980670, 8316609, -4287605, -2919655, -1418908, -26013645, 1778869, -18502634, -6918179},
+     {-3491920, 11306418, 7963539, -6275618, 32872270, 4872405, -31217624, -13497777, -21941853, 2607490}}
+  },
+  {
+    {{19274469, -5125445, 2025249, 13387528, -26551745, -13237864, 8572282, -5701955, -7605577, 3755890},
+     {-1003765, -3998347, -29431273, 5708148, 20949970, -10765004, 2582995, 4041757, 28570893, 242978},
+     {24217466, 683998, 12990241, -14980929, 24711442, 2582675, -18704628, -10573407, 27632805, 10325174}},
+    {{-1376293, 10581090, 17601840, -2177403, -23669777, 2515960, 7946113, 5265099, -30565938, 15659181},
+     {11690190, -256939, -28435932, 7575499, -10373362, 8175929, -1669485, -6706172, -29188463, 11378246},
+     {3934827, -895850, 14579491, -4161754, 26542055, 14629900, -19665954, 12702562, -9783987, -15825989}},
+    {{-7905285, -7567146, 24242009, -9981986, -10005548, 2864673, -12432996, -290370, -32192614, -12380245},
+     {21648538, 5875995, -25737427, 5595486, -2079098, 2667116, -30134869, -9286435, 2742570, -4025892},
+     {-17630385, -4775178, -17556574, -12786114, 22223083, 9281306, 25269654, 16741825, 7733910, -4295804}},
+    {{18931912, -5979763, 8372851, -1816752, 17694526, -3581508, -27130390, -2408709, 18843966, -5880493},
+     {31572541, 1387635, -27527774, 1197914, -15555676, 13484267, -12740138, 13093864, 20957081, -3614436},
+     {11695417, -11068051, -11229652, -9956937, -13423087, 6286991, 6574490, -8543138, -31992930, -3252886}},
+    {{4406854, -203587, 23268839, -16188749, 3696359, -3025310, -2374384, -14048190, 25835549, 14199049},
+     {-9053661, 9666137, 17702016, 13681030, 31673492, -7546596, 25994291, 7426565, 11705204, -499004},
+     {-9704638, 7750859, 4780558, -9879028, 3972007, -1273251, 9397471, 6020439, 9390255, -13657745}},
+    {{-4038073, 4122774, 15819690, -2689661, 32461321, 5475061, 7223123, 15194198, 6509018, -10905669},
+     {-9539544, 2095849, 29789961, 61126, 24968268, -13581175, -2582874, -12225942, 13866993, 1421457},
+     {-4214256, -4717999, 22567784, 3736576, 19253254, -4356505, 28225722, -14220075, 2798085, 8570919}},
+    {{-21155172, -14003898, 8717306, -11400688, 17970583, 10837346, 31185163, -6616264, 6612499, -14261069},
+     {8368990, -7533904, -5084524, 4262330, 745608, 13759847, -15288234, 15767429, -2114388, -1422552},
+     {16253406, -12125540, 5328056, 520783, 7323359, -5067190, 25388761, -12503796, 13788611, 15592195}},
+    {{-18007641, -11299895, -22979045, 15904833, -24466524, -2430858, 14251255, -13476220, 30848991, 13037900},
+     {113900, 16486627, 15167557, -13760546, 21770965, -6995991, 13113953, -1349366, -31585887, 10056458},
+     {25229681, -12266646, 5569512, 8982737, 32063203, -5581096, -1437669, 4966335, 13017505, 11031479}}
+  },
+  {
+    {{-7747423, 9283212, 16885577, 15459439, 25972200, 15573013, -33536708, 522134, -27572165, 11723471},
+     {2772043, 16117691, 1948422, 1594977, 11683210, 14644609, 19125577, -11518681, -30198843, -4147809},
+     {-14970719, -16387341, -14039331, -11274100, 13553527, 6014471, 8651844, 4302826, 944768, 9457783}},
+    {{25367933, 9925423, 1217074, 10032740, 15893633, -7285020, -21001184, 13591837, 15590119, 6888531},
+     {-1053008, -3203632, -15488193, 5115517, -19937346, 3036256, -16932496, 9411692, 11827739, -10643384},
+     {11974674, 3048430, -771228, -4998519, -19084529, -1036918, 27844685, 12465445, -19625526, -12787241}},
+    {{-25956653, -12255812, 24522558, -9746296, -23652022, 230925, 9724355, -12665711, 7329542, -3626927},
+     {20097826, -14840878, -8161024, -4621726, 32179128, 11048424, 27972941, 1059821, 14340256, 14287005},
+     {13600812, -9962902, 20158995, 8659885, -12409259, 11574470, -32794224, 1224150, 4403633, -7718084}},
+    {{7654660, 7028247, -28691608, 540979, -19280698, -5394104, 9795209, 8516409, 13848267, -1499300},
+     {30465487, -13875670, 357144, -6273628, -4648327, 10924293, 4789084, 2863329, 27548793, -6193966},
+     {4433141, 3224307, -2806764, 5354430, 31289755, -461331, 22067864, -4713425, 2154528, 4684644}},
+    {{-1403958, -1741809, 24799460, 10590365, 1395551, -8503429, 28864881, -8546382, 31138022, -1292228},
+     {-17832188, -6421901, 26054946, -9496460, -31678298, 11448778, -26652215, 6547852, 18183957, 6621583},
+     {-28299910, 12504930, -26590470, 2262325, -19557535, 972638, 11625555, 13979573, 28514419, 213985}},
+    {{24519105, -11597889, -29444913, -12967244, 27722451, -5096431, -5686781, 16364260, 8723084, 14806813},
+     {-8616707, 12913566, 807665, 3681606, -3143279, -1699128, 23760372, -12159793, 23694807, 12446998},
+     {-28137048, 5428051, 6680625, 9942468, -21535496, 1824313, -20798373, 14263050, 29191327, 16544139}},
+    {{9398608, -11563003, -11646986, -15947939, 1349980, 5197359, -18481524, 3237354, -14923730, -16662985},
+     {26283058, -3686364, 2459090, -16384105, -23888576, 9598009, -13957769, -14726119, -340227, -7544671},
+     {-15130889, 12798752, -20048948, 909824, 20905484, 16479172, -20502723, -741616, 29265753, -12361483}},
+    {{13874816, -13376467, 30152726, -13956199, -23325064, 13021371, -24134600, 14450792, 13790612, -10418809},
+     {18487466, 935344, -33484627, -8443849, 11904660, 6601985, -7750533, 16303926, -15507119, -6926203},
+     {-19759966, 11298845, 14718846, 13623030, -16980751, 6469663, -19011727, 11615538, 11731611, 768756}}
+  },
+  {
+    {{-20258635, -7120467, 11453541, -6332845, 32959413, 13781704, -10523784, 10616930, -7375307, 11149822},
+     {4536597, -7124298, 27508502, 7816921, 29384726, -2965218, 30191588, -11586218, -30257971, -11614795},
+     {77135, 15628759, -27441852, 9328400, 3300633, -10653494, -15124044, 8300023, 12084288, 3054740}},
+    {{-17273444, 14034146, 11836332, -4781612, 25536070, 11173207, 8964775, -4233782, 25146892, 13305965},
+     {-23305164, -12173503, 31479650, -15972020, -17779631, -14348649, -232634, 3747945, -25152809, -1147712},
+     {27133824, 586572, -21447921, 805820, -4254913, 701432, -25327283, 7219467, 1516428, 4919925}},
+    {{-8809150, 15205857, 29876534, 8214191, 25802562, -9431905, 6190966, 10041152, 6949444, 5277385},
+     {-1558679, 2968832, 24781098, 15495403, 8788080, -16587504, 23862282, -11100668, 12990749, 9708672},
+     {2402247, -15817821, -2184875, 444291, 1247189, -12666404, 19858950, -6523465, 4491850, 11195713}},
+    {{6109965, -1369913, 26057601, -7352580, 23168326, -9182544, 3992655, 2862676, 15421102, -3405869},
+     {-15770113, 9030044, 17073626, 718504, -27225159, 6870038, 32915018, 4714511, -31763938, -4043028},
+     {-26071999, 7984758, -28087167, 8099324, -23473273, 2221418, 17986974, -10193023, 19196845, 14943647}},
+    {{-17690082, 12669673, 20380407, -9074644, -7674053, -4133441, 6120570, -9623555, -10022611, -13437694},
+     {-30064868, -10252561, 7087359, 7207762, 19996121, 5645904, 31617719, 9156087, -26563046, 2059452},
+     {29720969, 995338, -5496468, 1238411, 23470990, 15773069, -16119314, 5301623, -20495997, -1164366}},
+    {{3697542, -4629441, 26797664, 971220, -9819131, 9864026, -96924, -16076052, -31780053, -4480985},
+     {13794499, 9444875, 16235673, -14688437, -9705715, 13901471, 32089413, -3557805, 24520430, -3537902},
+     {16614970, -13710209, 18395785, 5370482, 12553636, 8976933, 14955496, -14296187, -7530701, 5174393}},
+    {{33211681, -1215545, 9045064, -7636310, 13201557, -7243860, 30174131, 9936993, -10159990, 8077411},
+     {23153096, 13841946, 22477413, 12324549, -6986529, 1190805, 26252247, -13237895, 16454666, -16277057},
+     {173763, 3663982, -8739130, 3806570, -31441379, 12952789, 8828535, 12263775, -6062884, -3037038}},
+    {{14238208, -13232994, -16224806, 2003324, 8999610, -4207177, 23598910, 10246308, 18611982, -6260531},
+     {-8676618, 7221067, -9815386, -5652509, 20976677, -7121811, -1600797, -1498010, 21150529, 8555924},
+     {-16560296, -13801631, 31420781, -7275248, 12463560, 6639844, -28685603, 15035685, 14966100, -11633690}}
+  },
+  {
+    {{-2057689, -13794612, -24133317, -8462964, -15854653, 11926895, 24462524, -10400996, -8692214, -12157994},
+     {-9483899, 153323, 31677098, 14319101, 1299253, 816448, -15243115, 5297074, 4923922, 11471160},
+     {19188924, 16119364, -32390388, 2999380, 32178693, -9424395, -21396285, -10705542, -18306160, -7811606}},
+    {{-12971386, 13407111, -26731979, -7600085, 6443508, -7595666, -20270123, -3340436, -27786526, -98287},
+     {-16790999, -4431934, 2967930, 14371159, -8905849, -11582799, 28841649, 5898474, -12207839, -8552185},
+     {-24369384, 12934401, -20983894, -11610004, -33503754, -7565858, -2722696, -13433312, -4494273, -362586}},
+    {{-28491536, -13657943, -24904191, 8921751, -18343578, 10764853, -30445391, 14544953, 25829926, -13442905},
+     {-26901066, 2465512, 24265387, -16464052, -27318668, 11775406, -7713353, -6340074, -24163015, -16228224},
+     {-4692332, -13983486, -22584392, 16013620, 2128896, 298625, -1624766, 4556699, -30150049, -1917882}},
+    {{23409055, 7340959, 29156936, 15107907, -6620265, -4158425, 26665342, -4693455, -25180668, -6278125},
+     {-11486532, -4524797, 25022595, -13549308, 5513673, -4078739, -28846115, -5524381, -20106536, 3415915},
+     {22717419, 9458330, 31735608, 6303028, -9793359, -7104961, -32388032, 10252174, 19973013, 8665651}},
+    {{-103367, 3954766, 10159466, 12760864, -8123661, 5644140, 7905446, -7200170, 9241231, -12139025},
+     {10951705, 8420484, -33278584, -8937986, 27891587, -13225225, 23178781, 15226760, -15178256, -10769865},
+     {-11316967, -8465676, 18096127, -3213176, -2989450, 3908390, -25873715, 14571456, 18304282, 6456444}},
+    {{-25534676, -7391563, 14352251, -1813240, -4178157, 6595633, 28183879, -3102081, -28261981, 1288880},
+     {-9717207, 14510800, 17156110, 12896498, -25489701, -10513686, 475507, -10734791, -9457471, 12709967},
+     {-7686662, -12318605, -31628145, 4907649, -1012463, 5640354, -13058649, -6640668, 25962257, -15505028}},
+    {{30993119, -4220190, 13906475, 9376137, -6627759, -12260529, -30282595, 7722927, -10000608, -3568176},
+     {28847816, -13543428, 30031976, -9828123, -20616306, -283436, 5967048, 12842824, -32165144, -2475148},
+     {-8456547, -9265989, -10191775, 16484183, 26784716, 12868456, 1277658, -6839522, 4939055, -12260018}},
+    {{-17609474, -4152861, -19543099, 5098039, -29348848, 12420371, 24509421, -1037150, -23559591, -7903522},
+     {-14051170, -15163342, 12298459, 8559429, 19812335, -9020791, -6307607, 4484220, -28599798, 13843190},
+     {28825950, -9845550, -24587047, 12656477, -24129723, -12040139, -8525508, 2482307, -17643768, -5811846}}
+  },
+  {
+    {{17912732, -16092699, -23476692, 3944828, -10517612, -7179213, 20648131, 3965321, 25469530, -3442254},
+     {17267796, 4369299, 20216911, -7939165, -30519798, 12392099, -15110587, -9548329, -20275099, -3661740},
+     {-9788656, 11359472, 29586899, -11795605, 1321283, -44743, 28967383, 3240535, -10200090, 938826}},
+    {{-30063177, 5835117, -28123481, -735266, 5676682, -9446010, -30843342, 10343790, -24897229, -1612201},
+     {25095668, -3632031, -25646677, 15666421, -7485125, -8818634, 10553094, 15233358, -9930050, 15528461},
+     {26598792, 10725764, 17168817, -12521779, -23850141, -10978889, -18530094, -11449726, -29909881, -8162213}},
+    {{20858827, 7716357, -20871520, 10528024, -18963043, -10644188, -9151709, -11451866, 1577263, -13006193},
+     {-8264340, 11670045, 5858996, -13190140, 23445499, -5786029, -4655634, 13678963, 1684698, -9952556},
+     {23771014, -13958892, -28853989, -16083794, 23423949, -16633663, -18277778, 3775198, -24631884, 2402240}},
+    {{22439197, 6073835, -18681498, -3015329, 352366, 5109476, 10943265, -16128583, 30589587, 12639673},
+     {-3083565, -8358797, -9442335, -8713834, 30259461, -7479673, 2234642, 10981484, -13673465, 7924042},
+     {22652335, 6515168, -25265582, 13236281, 28274803, 13460880, -4372059, 2427596, -20657332, -11572556}},
+    {{19725763, -11865887, 27358001, 11194039, 11732154, -10829189, 15818702, -2937313, 18322843, -12784080},
+     {13150166, -3213849, 20334997, 8011597, 20261326, 16121344, 33068193, 15359641, -6562832, 427264},
+     {-891886, -5082612, 16059063, 4783539, 7017123, -8942606, -2103306, 7854757, 27722026, 12635359}},
+    {{-19726895, -11586817, 1381102, 12172594, -13753842, -13317338, 396980, -5937666, 29854147, 10125267},
+     {1875343, -16217949, -25038165, -4664102, 518917, 5982423, -20399159, 6516690, 23468862, -11541835},
+     {9267085, 1044336, 23257472, -14944919, 20340927, 15041265, -13244711, -12019696, 18740243, 10858954}},
+    {{-21449314, 9208183, 4856822, -16367543, 18443179, 7494936, 31493197, 16398886, 2498321, 9215196},
+     {-2428009, 16222925, 9858848, 13520177, -12321768, -10797543, -23947861, 16257348, 29699595, 11384160},
+     {-29460071, -11471655, 6981537, 1446853, 27152467, 6395638, 33056313, -11053624, 33039455, -2041072}},
+    {{1151868, -12082912, -12248755, -9209951, -15023342, -12612269, 17683376, -12601632, 27176316, 4618238},
+     {32070292, 9778898, 28212468, 8406405, 21384023, 719879, 7526632, -1635932, 1232678, -9087008},
+     {11738445, 12055293, 17975421, -6256476, -15122178, 867096, -13344125, -10936354, -12725087, 13257295}}
+  },
+  {
+    {{166991, -15976393, 15612707, -12414786, 3859799, 10068474, 15791766, 8882529, -13904217, -16113556},
+     {5878335, -11030369, 10377567, -1004952, -26821707, -12500491, -32589455, 1330441, 20157226, 5246228},
+     {-10703555, -5134677, 32878464, 10118550, -16188877, -13117789, -18307586, -12382964, 4281976, 2841433}},
+    {{-7176526, -14530030, 17755939, -8800171, 13593436, -15587581, -7176951, 11682802, -17650183, -11954511},
+     {24898741, 9496464, 5033731, 6719600, 19600974, 9612324, 29526147, 4615092, -30745039, 4637079},
+     {-16993447, -570329, -1406964, 2180914, -10106635, -10114385, 981040, -16698728, -5368639, -15756431}},
+    {{29542070, -2182933, -7168690, -4764788, -12344156, 4582134, 29160811, -8922022, 6050304, -14977506},
+     {20489514, 11664490, -27510910, -10908666, 18661539, -3332790, 2854782, -14555153, 2555760, -2911023},
+     {-10712936, 28558, 6884883, -5300244, 19667819, -14481644, 423572, -7844175, 16634613, 11281690}},
+    {{-16801750, -1762975, -22467725, 9434440, -9951831, -8933476, 27827120, -3222516, -32374318, 7290746},
+     {-16659543, -2982994, 20476665, 10859803, -32517917, 4205786, -15350323, -1086381, 17401998, -5907683},
+     {6969781, 9774089, -5109431, 16204799, -10945801, -14454277, 29242247, -2434264, 9253113, -5791284}},
+    {{-3669226, 3129507, 31416816, -6565690, 27965531, -13838685, -711700, -13280343, 9391828, -7974698},
+     {-27869520, 10677334, -8828821, -2983317, -1840345, -12009354, 20734475, 12867382, -9533141, 16434110},
+     {17014661, -6877276, -11191730, -1067110, -16537698, 420500, -12178760, -4473581, 8518315, 15782726}},
+    {{-7956, 12772300, 32978859, 8517266, 27953488, 6824388, -1319335, 7161177, 11931082, -8295195},
+     {10460864, -11872344, 17958900, -8539875, 7777518, 14231236, 30537017, 7189523, 18087307, 14485069},
+     {-23257390, 1423639, 20207261, -5020483, -4218590, 6221438, -26758641, -7211487, 29919858, 12403424}},
+    {{-2469315, -11851734, 4851051, -5102376, 13157069, 12165049, -27074990, -12296615, 9797749, -1265251},
+     {6820283, 9377919, 124462, 4395148, -26029759, -6727852, 10086820, -413999, -11524269, 13780629},
+     {-19755809, 5857808, -3720534, 9870103, 4940095, -13136305, -5936654, -3243695, 33015652, 13484}},
+    {{-23811906, -14818544, 25006789, 7818556, 2841551, -9159601, 23314567, -6712687, -10834224, -2520603},
+     {7162490, 8520820, -235608, 2918152, -17043438, -12026913, 6511583, -12247282, 23271856, -4675124},
+     {-19555662, 2820406, -33502507, -949064, -14455339, -11775334, -6229176, 2263280, 30370950, -10340844}}
+  },
+  {
+    {{-3837602, 13045718, 28443955, 15948611, -27578806, -14460236, -29347292, -252415, -28687142, 11603313},
+     {-14406401, 916949, -27375369, 6685201, 9811730, -2545467, 25034225, -8324028, 29022371, -14440283},
+     {16286546, -893152, 25911489, -3780305, 3806294, 2014063, -6126197, -16659809, 19533296, -1102562}},
+    {{5383362, -13359103, -14007394, 14372650, 30801004, 9041537, 29182249, 2690795, -33462474, 7189273},
+     {-3721620, -461813, -12849007, 2632908, 19840529, 11366335, -28594834, 14080560, 12447689, -10691972},
+     {23299755, 6701149, 1736245, -559789, 13956935, 10200200, -29845082, 6434963, -24888610, -7345734}},
+    {{-28614985, -9456779, 10429491, 6686314, 24709062, -3498274, 238113, -5440539, 26162616, 1842414},
+     {26722664, -16247591, 15809068, 312980, -25309744, 5749280, -9176935, -1932522, 27292487, 13656831},
+     {15020244, -15082733, -12674552, 3791600, 2986753, -5004514, -25705075, 5841100, -32165104, 12718938}},
+    {{-33349104, -12968546, -10808498, 8713650, 33524436, 13108626, -1419451, 4669469, -5523721, -3186258},
+     {-8099411, -5380176, -31015873, 2560818, 5636160, -9168869, 12687448, 15176521, 15747510, 15632705},
+     {28990153, 11360283, 28664170, 8248719, -22786756, -16472522, 11077326, 12281365, -13134018, -6271260}},
+    {{-15368644, -13462083, 18136627, -8194135, 5092566, -16410180, -25707578, 8240042, -17674365, -699957},
+     {-12507199, -13888243, -1789173, -3926048, 4289554, 1601359, 16514210, -14673047, -7607028, 6136737},
+     {-13378982, -1977492, -12633570, 15578906, 216825, 10284750, 21305294, 7030757, -7195356, -9147474}},
+    {{-31742072, -1053778, -23975, 16716574, -18794104, 8654288, -2956882, 13009257, 12372728, -389384},
+     {30237642, -6624058, 17252020, 9506435, 27013206, -11482442, -22336111, 5535246, 30475505, 8645734},
+     {26853683, -15762533, -259021, -9293731, -31965059, 15227278, 24684743, 12160374, 10472519, -2433654}},
+    {{-30490426, -8624043, 11380809, -7253077, 22421015, 10597312, 2953892, 1303465, 13457662, -8235397},
+     {23234298, 13840477, -22048989, 12499537, -9487540, 7519719, 26349813, -14864434, 9507613, 522337},
+     {15563273, -336150, -15497256, -2152428, 19396363, 1152040, 31927966, -1488739, 22800712, 14124973}},
+    {{-26424185, -10781027, -13852000, -951650, 15474996, 10668212, 24279721, 13459047, -6237183, -10048830},
+     {24350163, 12173425, -8529029, -5401735, -1631271, 15818485, 11878433, 10161213, 33224202, 15370052},
+     {-27349979, -12905691, -18411784, 2293916, 6365638, 11138129, -6185985, -12006553, 15502955, 6395806}}
+  },
+  {
+    {{-31752550, -8452702, 9056473, 3887422, -2454335, -1493608, -13028399, -171987, 14026798, 1572583},
+     {27775746, 11317923, 17097773, 15519649, 14265191, -2278283, -27492312, -3385907, 28653834, -16717595},
+     {20930892, -88067, 26662083, -14115021, 25414360, -12285276, 6256602, 3300085, 5699050, -1530678}},
+    {{23302914, -15658466, -1730796, 10126900, 19633094, 1767878, 28234852, 196118, -11245455, 15155201},
+     {3008648, 7723116, 29614439, -617974, 24990778, 14788928, -3003375, -9227048, -2108344, 1321150},
+     {-28255369, -15807254, 24529008, 15586857, 28229536, -4730088, 10491543, 14278611, -20745542, 11365884}},
+    {{20629748, -15723688, 15045843, -10496833, 20984049, -3227120, 8546576, -14823192, -13082549, 7111039},
+     {-717073, -15536287, -15935880, 13395092, 21118002, 12052078, -5061660, -14997379, -29734918, 4053335},
+     {-28634308, -13939211, 18967230, -1375802, 17856594, 2912238, -12463893, -6959955, 29916687, 352087}},
+    {{-14764745, -6994634, 11694757, 716682, -6811806, -11671880, -26238841, -16121200, -13614211, -11907386},
+     {-11222704, -1321919, 23862869, 2970041, -10583355, -6040463, 14464259, 3040525, -19389344, -7036015},
+     {-3345863, 3678291, -9280390, 7081144, -28631785, -11264420, 12367405, -13692564, -15990240, -16608968}},
+    {{-3813227, 6001747, 610521, 13100340, -3656446, 2550366, -14760732, -10885913, 23425437, 15149273},
+     {-14620054, 1729108, 12786517, 9069328, -5746033, -15992641, 16672133, -6419456, -30849046, 14144417},
+     {-7882916, 1821660, 922346, -16770473, -15166789, 13848023, 2847189, 11658201, -32619506, 1403952}},
+    {{-22856267, 11014876, 14395810, 11475721, 23018800, 4512103, -28624137, -11169250, 13805958, -7132974},
+     {24337682, 6840162, -12702579, 11481878, -9585505, 3757698, 30512181, -1788935, 5056155, 14216704},
+     {12882240, 2328185, 30241579, 7398702, -4247315, 6002902, 24457341, -16570204, -21897653, -4091153}},
+    {{-28040919, 3151953, -9300910, -9046933, -3437813, 11271708, -30642757, 14154213, 31997282, 546283},
+     {-25754028, 7885911, 472867, 3830780, -22639733, -904950, -7174753, 15822501, -16072069, -2774579},
+     {-6683765, -5911929, -620599, -11274494, 12139418, 14398666, 19151799, 11300916, -24580912, 6967612}},
+    {{2319062, 2758214, -11045016, -4435351, -18449066, -8037897, 5903291, 7033251, -25898398, 10160192},
+     {17011570, 4670548, 14408373, -4403631, 12275167, -13210773, 16864895, -13454290, 29190402, 1884324},
+     {30155528, -12097542, -17855342, 13190891, 26931544, -14403119, 32936115, -9885446, -19997959, -14202425}}
+  },
+  {
+    {{1466931, 6920868, 81906, -9248881, -3631797, -7282819, -4002752, -577600, -2046153, -12744640},
+     {-9673188, -8089957, -14215533, 2884955, -23247878, -4031904, 14654684, -14180722, 15170242, -12458993},
+     {-2212300, 4413816, -676769, 9818067, -12803306, 1459473, 3636451, -7302343, 4498007, 9916704}},
+    {{16919400, -15661710, -29375088, 788854, 22709065, -4825587, -11475732, -10166778, -16952540, -16383675},
+     {-1461905, 574386, -13912147, 921132, 3852007, -4804097, 31744587, -1323224, -31409235, 12484286},
+     {-28793381, -3171741, 488608, 3533994, -18241312, -2771362, -26159196, 6255600, -27946083, 5734944}},
+    {{-6930613, -16376897, -8736493, 451357, 19038266, -9692007, 300533, 13382813, 21800307, -9951755},
+     {6034582, 1921245, 2196036, -1125949, -9700108, 7455568, -3435626, -4375395, 26430431, 15139308},
+     {-3545259, -10335546, 29296041, -7059068, -12529674, 5999578, -725847, 994694, -14937652, 12283828}},
+    {{8888927, -3934348, -23208510, 11198962, -26094395, -5555530, -30697656, 7752898, 4539597, 2184177},
+     {-15359790, -5687054, -5659965, -7880287, 21858547, -1533493, -5663516, -11218210, -4561268, 16071223},
+     {32353580, 15216981, -4404163, -555710, 9622736, -4545032, -8252350, -3037329, -7763384, -6406645}},
+    {{-8956266, 7753750, -29662271, 14804683, -4504423, 12378480, -19524208, -12673196, -32600823, 4062684},
+     {-24114073, 4670198, 13030953, -10164071, 13952457, -13227063, 9718022, -12850761, -1414985, -13241528},
+     {8761375, 8057205, -26433829, 9905518, -24549998, 1154254, -20299679, -5507027, 9537249, -15416947}},
+    {{-16309084, -16434421, -20221227, 605502, 7260294, 9063152, 2403511, 13364645, 13423223, -6828350},
+     {-20054243, -9162646, -25832804, 11485713, 22535108, -13643926, 28295885, 3009938, -11230337, 1702788},
+     {26739191, 11009990, -18481770, 16585992, -25896844, -184502, 9343419, -244546, -25100783, 4797376}},
+    {{28402825, 3806924, 25125539, -4269176, -29447309, -11869638, 6224465, 1582902, -22740014, 1561392},
+     {26079848, 10174068, 7784834, -12016685, -16297528, -3589280, -23184902, 13911438, -30523400, -5271909},
+     {4277711, -16537680, 6920641, -15710284, -14909484, -7845980, -29931818, -9128021, -32879317, -7235157}},
+    {{-13113012, -11600435, 31634969, -1011958, 32691622, -13580464, -27929075, 9242993, -129472, 10712363},
+     {448786, 5297823, 6384904, -15869444, -14137103, -3415431, 29201369, 580246, 5011189, 7722222},
+     {13344599, 2986769, -4722760, -10019693, 6459271, -16492604, 1721111, -14299322, -8871735, -13556176}}
+  },
+  {
+    {{6083246, 12395507, -20041050, -713102, 11444551, -15587007, 23416873, 10372699, 26431488, -14797209},
+     {15803991, -10657305, 29704098, 10955216, -6242370, -4502552, -28051410, -15443577, -14004028, 2921542},
+     {12255955, 11948580, -31284309, -7834093, 21202979, 15865602, 17908903, -16731059, -12339931, -13163379}},
+    {{-9680504, 16317181, 2402138, -14042063, -10652521, 2467095, 30023376, -16188146, -11779811, -5312013},
+     {-8354103, 10686468, 28908656, -4408072, 16637852, -774988, -9496537, 15765471, -3446083, -11954714},
+     {10816854, -1624971, 24102798, -4311051, -19361534, -8349905, 14656539, -6328833, 3879723, 56674}},
+    {{7719343, 16458075, -6383311, 1818, -7272941, 9467445, -4862499, -12918451, -11067592, -6653773},
+     {13306195, 7123786, 10035200, -16549663, 26209607, 14010929, -20756242, 13375158, -2571184, -6517193},
+     {10212123, 5954793, -28059294, -10937196, 617142, -11150927, 10452256, -8964465, -32242055, -3505130}},
+    {{-18545207, -11910535, -28966478, -10616503, -27055645, -5168344, -5589803, -9900290, -4713414, -926170},
+     {13182109, -6272313, -1371049, -9369335, 25827772, -979250, -18686929, -4192873, 27141691, 957129},
+     {-30204747, 7174328, 8658488, 7385061, 23756150, -2542927, -31688514, 14480373, -16660972, 11067504}},
+    {{20190850, 3116205, -31809800, -14627204, 10459946, -11032743, -17044523, 5591658, 31112684, -10746600},
+     {-3665452, 15081076, 11335059, 637623, -30542682, 7400957, 19345470, 1493531, -17267648, -8981863},
+     {9526309, -3026933, -25082483, -12560278, 7304007, -4964513, -16720252, 4737995, -33205350, 9787092}},
+    {{-1809433, 2541410, 7581448, 14053339, -21678427, -14312547, 3906475, 1408389, -23318237, -5824484},
+     {-19017175, 2610330, -32961032, -12695780, -9202301, 14639870, -20328751, 3300749, -25275667, -1435028},
+     {12271394, 4021509, 26283881, -14321946, 27467580, -1212226, -3559235, -7766618, 8779644, 9919534}},
+    {{-15014700, -10007953, -23227639, 3788747, 22734611, 10177342, -6161567, 15814757, -25588888, 8890937},
+     {-30673698, 7403102, -16422870, 16333359, 2161933, -14426667, -5433593, -10189521, -31024546, 5126378},
+     {-27624529, -4379365, -32747272, 14351887, -12016012, -13494711, 4983919, 503880, -14788050, -9344261}},
+    {{-16342477, -8800379, 30990426, -15692932, 32336203, -15320229, -12518815, 13139001, 6688050, 9467092},
+     {-12833317, 9092398, 12690062, 16437288, -17753039, -8277969, -31500781, -7217133, -5114726, 3738925},
+     {-21212473, -15723708, -29446787, -2257603, -21423987, 6140972, -32798871, 13796702, 23487581, 7747574}}
+  },
+  {
+    {{-30587084, -4629784, -20009115, -10744271, -15524787, 10280576, -28667146, 7716332, 24015220, 15147052},
+     {-5646697, -13269764, -13947040, -14622668, 3346795, -337258, -1015199, 7124142, 4664896, 15322844},
+     {-8229784, 5997383, 8085987, -15578361, -2326588, -4766867, 25901074, 5262370, 25656743, 3392425}},
+    {{-5860243, 11777295, 769126, -15776754, -8901554, 6810940, -33061713, -5528741, 28019812, -9002317},
+     {30723280, -14669513, -5004498, 15511447, 9149397, 14075675, -15080544, 8780012, -6507584, -1125302},
+     {-26208846, -6712689, 29530263, 7885954, 30958908, 617491, 10886354, -6441812, 17398271, -5028867}},
+    {{4956577, -12669076, -6361090, -1974546, -12324368, -8776931, -22792445, -11783036, 18817572, -7313138},
+     {-12310337, 1702372, -21202916, -8048502, 5377387, 403765, -24479332, 9674308, 9302088, -7454061},
+     {-33117989, -5351766, 12466361, 16089921, -29020674, 16555776, 26195362, -6322866, 5646086, 12810190}},
+    {{12375359, -4411558, 31344248, -8172991, -15128721, -3466513, -8976863, 16561847, -26205910, -9394891},
+     {29358073, -9242956, -18683448, 1114915, -14399942, -15164073, -26780152, 13440858, -23247769, 7151756},
+     {22427521, -8216631, -13953689, 5390460, 9717898, -15420189, -24996943, -3843860, -27420816, 8959577}},
+    {{-30126184, -13656189, 25625075, 6569873, -5456214, 14774032, 15970087, -4369508, 21072393, -15754951},
+     {-9261855, 6283629, -1899634, -11914810, -33141702, -4158631, -27884874, -97164, 29917072, 2936988},
+     {-30028170, -8874873, 5361707, 7325840, -17285067, -8528659, 392275, 14456831, 9885372, -10694473}},
+    {{-26182647, 15674824, 15490680, 6526093, 13923950, 14064179, 1521517, 1040394, 32631944, -12010168},
+     {13523352, -4449934, 22306302, 8760927, -17036716, 12043353, -28278000, -16076403, -14476251, 13913407},
+     {27496510, -16264770, -8813338, -4404436, -14389617, -7726065, 10852392, 3110348, 24164752, -1314133}},
+    {{-8115330, 5274428, 14202128, 3980639, 22519493, -8892418, -28849278, 1503631, -8717104, -9616760},
+     {12107329, -8694487, 6010956, -16196217, -29313968, -1561933, -31909401, 16345151, -27510098, 4331499},
+     {20321045, -16524868, 8205169, 1278080, 6363273, 10637440, -22872718, 6556862, -7078489, 2662793}},
+    {{-20210390, -6496548, 22819522, 4633575, -1324763, -10609782, -2827669, -12753155, -3455290, -9249699},
+     {8174749, 12907021, 7366869, 10800649, 14755747, -2733367, 18391108, -2299491, -11855318, 8180997},
+     {-21517309, 7971553, -17356463, -12788426, -3116187, -7501968, -10418063, -13057315, 16249265, -871572}}
+  },
+  {
+    {{10346599, -476640, -10862894, -11213802, -7409626, 11386694, 27912709, 11780332, -10622439, -1151873},
+     {-14368516, 11729809, -8979461, 4324523, 1380618, 3235999, -2796427, -6292513, 6562440, -6112356},
+     {7457804, -13484963, 5733892, -4539260, -28012359, -1807520, -5223958, 12543215, 27429848, 11816789}},
+    {{-17925550, 6763423, 22706144, -4775257, -22840501, -5719270, 13600196, 14354316, 24469649, 14182103},
+     {-13256467, -9141865, 24575833, 13904658, -22844886, -14562032, 23414943, -5564006, -18301039, -5370616},
+     {-24984379, 8166081, 32884399, -7176833, 26433100, 13158336, -17384044, -15010054, -21555397, -5617170}},
+    {{-20018965, 1057168, 1151406, -11794570, -3961825, -8876069, 19411079, 15840644, -29122348, 1422923},
+     {7226966, -9661466, -32807954, -9007287, 4228865, 12624757, -6291562, 11689760, -7574398, 7645616},
+     {4040116, -9935425, -2489503, 1187245, 31415971, -3049192, 18788684, 8315099, 21959221, -6557998}},
+    {{19073494, -4037188, -22594853, 3100191, -9442162, -11197422, -16689028, -4093733, 5601348, 10233900},
+     {6033336, 9711222, 19885731, -13869448, -12140687, -16144022, -11316798, 13313507, 32398080, 5470206},
+     {-7984180, -4091862, 25152576, 13826189, -33084670, -3069252, -4095445, -15830519, -31898193, 6722296}},
+    {{7783583, -4032592, -25245671, -7079437, 26603500, 10502852, -15623946, -2062323, 8907598, 5426645},
+     {10887197, -3556024, 23008116, 1996959, 26345745, 3272147, 28549059, -4705972, -32379590, -3477772},
+     {-10036134, -11590357, 28169681, -590927, -5404463, -5048366, -16315336, 7298578, 2556075, -12833680}},
+    {{28500562, -12029136, -22720704, 666096, 19635978, -11450261, -6855447, 10918147, 4448423, -6115419},
+     {1659386, 1696246, 15694894, 7705734, -24893262, 14051188, 1560607, -9790233, -15680315, 2700818},
+     {-8184354, 11645186, -31343806, 12217059, 3573955, -2882335, 11112246, 1960278, -26489020, -16508218}},
+    {{31780082, -9226930, -11094895, -9950546, 23760847, -8521683, -15065910, -16260468, 31531331, 4776660},
+     {13776507, -10579833, -18898851, 15234424, 19621869, -14400384, -13397031, 6697642, 30566815, -138050},
+     {-2827996, 1762456, 16884081, -3034827, 25313726, -7684846, 28564061, 10091930, -14815436, 10607355}},
+    {{-24476149, -13841201, -5563725, 5192812, 20614618, 9319711, -3169617, -9007496, 19645471, -11264161},
+     {-15448412, -12956327, 8297361, -16338695, 26001315, 11118805, 20972297, -15046251, -6231662, -14424208},
+     {26571535, 13254858, -31603811, -15423465, 32650027, -3348869, -3007991, 3994168, 26626691, -10612448}}
+  },
+  {
+    {{-28008380, 2647815, -557320, -14434835, 19427705, 15870322, 31787181, -4082468, 22278890, 6317806},
+     {-13667269, 11157205, 5128927, -16632537, -9482053, -6380415, -5071418, -2069913, -14534284, -16673198},
+     {-33280380, -1122728, -18708174, 13874374, 32782178, -105835, 25547284, 10785151, -26078720, 14346764}},
+    {{-14201112, -5815658, 23263515, -7142398, 18278913, 5627820, -26408943, 6765544, -30248805, -2144123},
+     {-28971948, -5050927, 14867138, 15835556, -626782, 2262239, -33194126, -4810459, 9241906, -15610919},
+     {11375832, 10181657, 5007665, -1255503, -23668956, -4111883, 7766691, 11637141, 3564243, 11636475}},
+    {{25622719, 6475425, -19000502, -4825715, -25453460, 3693811, -15535279, -15059647, -9577091, 7842950},
+     {-25659051, -8166661, 3600381, -675936, -18386874, -13280049, -2077427, -2362823, -10927060, 9020604},
+     {6737791, 16017032, -6623060, 6450788, 16805878, -15888542, -11313305, 777007, -12966005, -6340770}},
+    {{-28419990, -1416873, 24102316, -14529035, 26731487, 1913811, -5837063, -4336319, -14566214, 6386410},
+     {-12655499, -15958340, -5090882, 5566744, -26775554, 2542258, -24597337, 1518118, 32425009, 3373400},
+     {14928705, -5805827, -17837455, -5634115, -17035700, 4602756, 16940648, -2252724, -9834809, 16458858}},
+    {{10698818, -11801108, -23789066, 6282064, 18449787, -464218, -18979741, -15540503, -7034545, -1474910},
+     {-8296787, -8530178, -17439788, -3712921, 20444833, -1377912, 1535073, -6318272, -2023628, 5241709},
+     {-3315807, -10229115, -22877613, 810718, -27690110, 8930740, -20523753, -11410723, -2799202, 14021862}},
+    {{21756920, -9753338, 5449988, -7481556, 20307856, -15502688, -30369985, -12835873, -1634313, 15349274},
+     {12242540, -1566740, -12336168, 6350205, -14364280, -8210917, -7446001, -157297, -22388875, 11948678},
+     {28309867, 3364693, -18600469, 14920372, -18285911, -10149250, 9555145, 7065272, 3944235, -5834675}},
+    {{4951523, 15690522, 14880855, 8519248, -24390881, 9874089, -3572240, 7259760, 12989831, 8402230},
+     {26724669, 4675512, -30154303, 16337449, 20792326, 3467676, -12788488, 13812359, -18558388, -647099},
+     {9679678, 12276434, -13859823, -658738, 16510921, -5905145, 24074350, -5072148, 23600090, -5930513}},
+    {{-14440190, -3214043, 30041968, 11753827, 32540373, 7885479, 21494429, -4186953, -27772691, 10678751},
+     {14556385, -8354790, -8126760, -13076762, -6073244, -11205210, -71666, -385922, 20790980, 14145741},
+     {-27426762, 10365497, -23982985, 303514, 26055800, 9233714, 1544212, 10783003, -6067369, 15255216}}
+  },
+  {
+    {{13709443, -5310645, 30658614, -13647152, -27739891, 14679756, 29939045, 1891282, 27601955, -11772417},
+     {6456676, -7170684, -1668316, -1751641, 11087586, -6058429, 18004340, 9296837, 27258448, 15922863},
+     {12181132, -14302828, -21793544, -2222066, 16009888, -9772148, -23645078, -12877747, 3515930, -1614618}},
+    {{22615882, 7758979, 26919993, 9915811, -26236665, -7749685, -12447737, -58302, 21424870, -1612162},
+     {20038096, -11305584, -16491737, -15976605, 30802515, 5895106, -25753230, 5261453, -28528333, -5224460},
+     {6763013, 13765978, -13787601, -12458665, 14809004, 16769926, -29819221, 11742263, 22770778, 12963910}},
+    {{-16605113, 3054095, -19332353, 12056446, 21005442, -11088926, 30273803, 2846210, -32384631, 8452371},
+     {-8767989, 4219950, 14703898, -16462673, -26810867, 149419, -1049475, -11470934, 5115191, 10341261},
+     {-4594766, -7360882, -12289327, -11824677, 4288262, 6031202, -5100333, -15039990, -23743276, -10885819}},
+    {{21711231, -16012093, 26271973, 3526118, 8119692, 1142597, -24864148, -10451213, -31452154, 1382966},
+     {-16550601, -687739, 5065324, -4880418, -7847240, -1470289, -24818286, -8440430, 9270014, -14909132},
+     {20080625, -10917250, 30490655, 7210668, -12894370, -15146353, -17731974, 6968387, 18462259, -15308870}},
+    {{-31791751, -14984478, 20682127, 8893813, 13020185, 2452812, -21821280, 12305540, 5493274, 12394874},
+     {14739307, 8925852, -32335240, 13063418, -20664407, -14216573, -17865630, 329002, -31843043, 3200232},
+     {537606, -3071769, 9471571, -92834, 29333654, -13268969, -1523546, -13137307, 5805055, -6962026}},
+    {{-16191937, 10995446, 16388152, 2978592, -8966808, 10742696, -10425367, -16370954, 27860305, 5652808},
+     {-22671007, 781773, 1381250, 15312553, -7194557, -6647433, -30299592, 50892, 12601078, 13360121},
+     {-7271732, 15222706, 16107540, -3699863, -29339776, -5138987, -7312298, 9200467, 5434008, 7268345}},
+    {{3568783, -6609549, 6404588, 10180702, 10815493, 7961328, 23281271, 7940263, -13457221, -8734293},
+     {-2797647, 7754797, -25674438, -589718, 11894387, 5228204, 23276368, -6739400, -18628148, -6880696},
+     {15800573, 14255173, -6967792, -2317915, 11329250, 15310656, 33197658, 13831758, 25312629, -1930587}},
+    {{-17288697, 9375896, -23677282, 10374474, -22027693, -161800, 4589981, 2497038, 17920358, 6412770},
+     {9186017, 1882711, -7769002, 11741429, 27738098, 15184939, 21462049, -2725754, 1190574, -8952229},
+     {-15970161, 14138394, -25693621, 1427938, -33132767, 14483520, 9915704, -7437809, -5840242, -10046162}}
+  },
+  {
+    {{30624416, -13126242, -25953584, 418414, -13619589, -10675952, -19780750, -133977, -22060553, 12064616},
+     {-10199003, 9477007, 10089317, 8504039, 13126086, -9573819, -25173649, -3230644, 17558158, 1638976},
+     {-31724711, -1833290, 16865417, -1626396, 26770535, -3512281, 2769244, -1784691, 13565448, 10809822}},
+    {{18870803, -1739352, -21421351, -15365439, -13778108, -11299402, 21598286, -9834178, 16981576, -12393717},
+     {-16346986, 2595842, 3223760, 11478824, -22323860, 1704264, 28019409, -5521154, -15652842, 1187792},
+     {-24491659, -12385790, 26429703, 10127433, 29357889, -9451299, -5790376, 11625206, -11285062, -13888177}},
+    {{-4107564, -12040502, -20498463, 5105880, 24840609, 7318424, 26629447, -16249919, 30739409, 1389103},
+     {-13435015, -8441977, 32732045, 16260520, -5384278, 517639, -23775690, -14606434, 22353688, 13910451},
+     {30345040, 2902983, 5162772, -14827595, 19759779, -12562534, -19524886, 4538331, 31805532, -3432267}},
+    {{24583426, 7569242, -30425061, 7038944, 17041883, 11611847, -23579122, -15980151, 23229697, 10575612},
+     {14173403, 14311420, 23670113, 15125454, -18068511, -2486496, -23010463, 4340309, -23753497, -1183599},
+     {16869553, 6557632, -33508380, 10353713, -10623105, -1372388, 24588191, 1741860, 11830688, -12306463}},
+    {{-16072335, 15868402, -18463594, 12573710, -20722027, -8860644, -26273805, -928922, 7355221, -13377612},
+     {-25714182, 5041893, -28904280, -15524663, 30650606, -2952870, -30773733, -12106936, 5130284, 11850181},
+     {16510498, -14739098, -3822213, -15377746, -25617200, 7737542, 33231369, -11238894, -22214113, -13101174}},
+    {{26207936, 15850744, -28531962, 14065220, -7401020, -15289724, -23189631, -4782208, 32197845, 6641181},
+     {-11329741, 14342291, -11044013, 7584389, 17459672, 2345856, 16421236, -1025155, 23625929, -7979935},
+     {-29780071, -4742204, 3083701, -14546963, 32200811, 3498973, -26474449, 1431142, -18698700, 5757691}},
+    {{-28974552, 8642277, 28800851, -9515936, -3300987, 2142241, -26057223, -2406959, -23712367, -5331776},
+     {32258658, 15909644, -25669435, 2656712, -33277779, -2440539, -10331107, 5254930, -25501015, 10739106},
+     {8708797, -8496810, 11839434, 14605987, -17462289, -1448667, 11949319, 8059627, 13314843, -4587253}},
+    {{-28172399, 1658246, -4767066, -3886846, 26752027, 6228089, 12901930, 16123303, -17330499, -13808625},
+     {-30881170, -11597196, 19381794, 517552, -18133739, 15347008, 20409297, -15254296, 15007530, 2276981},
+     {-21185048, 2732272, 30486111, 5693908, 20725545, -4202630, 15365220, -2691595, -25577947, 3620022}}
+  },
+  {
+    {{-7570426, -524391, 20097620, -16661414, -8606086, -5438902, -2513010, 10337285, 10198951, -1104705},
+     {-6980636, -15417090, 2662804, -16317394, -24179607, 8716369, 17742056, 5985806, 15380671, 2812132},
+     {1759737, -275552, -12102669, 10734975, -32659979, -10917039, -10879009, -14934751, -8530948, 629933}},
+    {{25995253, 15321678, 20676051, -13905342, -5344615, 12928226, 26535743, 5834045, 32469870, 9220744},
+     {-32995849, 11707082, 25397526, -10218086, -24075856, -684171, -15920372, 5550704, 12235466, -3115905},
+     {20957975, 5279561, 23238636, -11021873, 2228468, 5359535, -16683060, 2719281, -33251788, 1049551}},
+    {{7240454, 15271080, 11273695, 2712681, 5348885, 8032711, -7735829, -4293645, 7428075, 13241387},
+     {-27146917, -8315473, -18688646, 12461725, 14323547, 14167305, 19720948, 14642646, -23573131, 3294684},
+     {-13145624, 695982, 29721039, -3953268, 1212790, -3347743, 19469174, -16513750, 3686075, 3532094}},
+    {{-6102612, -15517206, -15274115, -534898, 17071973, -10519397, -28251257, -10304793, -30207362, 3511881},
+     {-32172300, -8555800, 29933543, 8070229, -4587153, -12935436, -6416931, 14179867, -14546646, 2485296},
+     {27907910, 15385928, -10176367, -11095850, -23393364, 13320966, -30011805, -11735988, -22462796, -56256}},
+    {{8172112, -545433, 645285, -11888318, -27963834, 13577339, 29966526, -12436792, -21004912, -5003785},
+     {-10725063, 3964808, 25067649, 15849772, 6962365, -3729815, 11063679, 15714325, 20748469, -6921286},
+     {-17316702, -9815740, 10896567, 9140583, -5406512, -12720840, -5719565, -10454851, -32980692, -3389825}},
+    {{32798541, -9546936, -18551031, -10238786, -16938042, 5657132, 2875422, 4345059, 19486241, 15948449},
+     {-940853, 304405, -17760858, 5130154, -17590137, 12511162, 26577308, 5349209, 11135620, 12621286},
+     {-18044519, -13130609, 2484222, 202566, -17389204, 9997023, 13565515, 445687, -24828319, 16599809}},
+    {{-20703546, 3139196, -20041141, 12406424, -21878464, 14591148, -22751861, 11349075, 29986961, 1524641},
+     {-32288295, 11084683, -25493507, 10998779, 10586397, -8200719, 30732987, -7659157, 12216683, -8191935},
+     {-23282025, -8910792, 32407716, 11905118, -1564687, -15605914, -25800824, -3561742, -23414418, 14292210}},
+    {{-20584495, 15739967, -6829946, 2777159, 29961914, 9932699, 19292707, -451010, -19519450, -14144514},
+     {15964992, 7223198, -12744997, -7519682, 33360822, -4374562, -26678467, -3316604, -20369475, -5652160},
+     {17388308, -71784, -27321053, 10491141, -16512130, 6691084, 15825661, -3737631, -1176112, -6274009}}
+  },
+  {
+    {{5874757, 7110952, 27386301, -11380547, -8031533, -8796840, 32909584, -16548809, -6486255, 10014663},
+     {30546551, -2712447, -23426461, -15295030, -20774639, -10622243, 16328175, -944709, -26611440, 1916188},
+     {25925923, 13655488, 2627647, 14901375, -23353213, -11221248, 16380834, 1006284, -26273228, -8704564}},
+    {{15231383, 12075450, -26181667, -211323, -27161394, 453616, 2361173, 5902990, 26037340, 929186},
+     {-27657394, -9910583, 10876067, 12148310, 2458574, -13347637, -23595449, 212407, -32749716, 14727325},
+     {-20033370, 7423843, 19471986, -3313303, 12913475, -14366080, -22213312, -2811030, 11899473, 8829674}},
+    {{556835, -11698116, -17790351, -3222549, 19994722, 2058336, 25292634, -14832290, 6039490, 2682971},
+     {-12561104, 5164340, 22996126, 5380164, 15799209, 435330, -18707584, -15881285, -7827279, 4602596},
+     {9731920, -14219789, -28351747, -13281777, -13427785, 15765079, 4810584, 7175148, -31275396, -14407984}},
+    {{7337550, 5873052, 10988340, 15232053, 4384079, 6032278, 7402343, -7533815, -26138751, 11939300},
+     {-119159, -14583143, -27421804, 8942753, -17273154, 16514684, 30754115, -9596433, 33487209, 4113918},
+     {-3960789, -9335892, 15011643, 9719616, 31254661, -16703303, 24322161, -11683727, -15224142, 2537614}},
+    {{20099555, 14936171, 23364117, 14619580, -5852236, -12719856, -21635044, -13445871, 31316564, -6566537},
+     {-28506033, 8800916, 3299181, -15204017, 13808514, 16431851, -30593835, -11169019, 28158336, -4820438},
+     {10056483, -10043703, -5907888, -542847, 7266178, -13710209, -6056197, -4651659, 16140026, 788077}},
+    {{-21767061, 7111994, 32290273, -5411863, 16635343, 664496, 15516680, 12515843, -27740733, 14986639},
+     {-28097075, 6401366, -30588780, 8775201, -4481640, 16460358, -29763012, 10636564, -633193, 14808880},
+     {508440, 15431463, 7325714, 11512214, -15362312, -8175573, 32931467, 6671483, 11465440, -8009555}},
+    {{30084687, 2004320, 19741398, 3590690, 10764224, 14473759, 374027, -3464947, -9068434, -11164853},
+     {12404655, 11190203, 6365186, -2562397, 22448540, -9976020, 32879621, 8732224, 5022657, 15043813},
+     {-13119500, -13753593, -14782046, -15193663, 1497751, -7874215, 14549596, -1270179, -28725800, -5263739}},
+    {{-678578, -12898735, 29248392, 15218180, -26007912, -7777208, 20041027, -345609, -25108726, -9825940},
+     {28422467, -8382679, 28591009, -3932530, 28651951, -196633, -20235478, -2839073, -24371998, 2486440},
+     {32216266, 6254487, -7796323, -3906683, 14893713, -9842537, -9999791, 16283784, -33192, 2640168}}
+  },
+  {
+    {{7184873, -15884065, -4733995, -8847922, -1636825, 6148438, 65127, -3521018, 32228732, 10657574},
+     {18746717, -11476172, -27193064, 6954600, 12791172, -7111732, 17243081, 4299795, 28465943, -15375283},
+     {13737629, -10164614, 8386336, 6074657, -29227449, -3718492, 10775460, 9999959, -26378316, 14666953}},
+    {{2208029, 4805874, 3925618, 1183512, 26981643, 4334333, -1701752, 13754574, 1841441, 12708077},
+     {23031304, -6170131, -12566090, -6629118, 19467983, 11504761, 19740480, 16022638, 18286074, 4057599},
+     {-21668621, 14107100, -28618275, -176019, 12522715, 11978472, 12683246, -1419312, 5777339, -11161151}},
+    {{-769018, 14942347, -22636759, -525178, -22065010, 16280891, 5550205, -2330944, 28058403, 12392111},
+     {-18229046, 13917377, -23260731, -11983815, -7367542, 11100342, -2180186, -4900950, 27025099, -4379386},
+     {15698557, -2997070, 30133302, -909349, -6930796, -2873392, -1691976, 4028086, -25042463, -5681587}},
+    {{9716706, -4112507, -4529664, 13382375, 21965595, -14757449, 2982314, 7579175, -3486448, -10413430},
+     {30535305, 9719401, 19996283, -1573733, -33221354, 14780613, 18347648, -12081172, 22919350, 4015328},
+     {-21985513, -9213176, 20417023, 11306903, 27239114, -8717671, 10333970, -15316863, -19369844, 3474736}},
+    {{21678587, 1746058, 16240689, 3058346, 9197741, -9348733, -2219518, 8401562, 28390588, -12341697},
+     {17724937, -6252161, 14744055, -12198777, -7246599, -447365, 22310736, 6008392, 1651488, -6198072},
+     {-21810976, -3165770, 33437719, 3709309, -32272096, 10870498, 28944738, 5918309, -15030323, -9047564}},
+    {{-9198219, 4214695, 14427770, 12207969, -28740675, -12156839, -26015121, 8852736, 21096874, -1915925},
+     {-28659806, 13742047, -25020953, -10327545, -18998248, 8132068, -7981723, -5660118, -22375286, 16570687},
+     {17151112, -5698437, -7350293, -10165685, -23801958, -826085, -23734332, -7963379, 367975, 591360}},
+    {{-13047276, -12378252, -11090681, 365708, 32617327, -9403657, -1581245, 3937693, -21353062, -13328105},
+     {-8758281, 1965993, 30865878, 1518895, -9596740, -15568711, -9936220, 5478493, 22253125, -14825767},
+     {7368945, 14678033, -17041558, 1797803, -13722351, 56268, -19815525, 16718455, -26238979, -13915408}},
+    {{11127026, 5058353, 29814084, 14964337, -1055756, -15621957, 24216141, -9191423, -32064374, 1161450},
+     {14219148, 288656, 29501638, 2745224, -25138577, -15671942, -23751995, 10266894, -12734414, 7975199},
+     {3737297, -7008068, -3849571, 10951446, 19400309, -4050745, -26216889, 12815642, -330056, -791047}}
+  },
+  {
+    {{32848944, 14869187, -32304465, 5534472, 11039196, 5740254, -2934758, -8833159, 27856026, 9081406},
+     {-12649604, 4231155, 22186379, 13513185, 28360494, -3678076, 13136226, 10172232, -18198137, 3756407},
+     {20950123, -9423069, 25144688, -10012895, 22175542, 54021, -4289030, 2542214, -1029927, -16422958}},
+    {{-2996167, -12228049, 23768721, 4029825, 31214093, -6119041, 18178853, 1976855, 18066803, 1578133},
+     {31661618, -10911218, -3537898, 11280430, -2066321, 14335082, -14668934, -13713663, 21817116, 5458167},
+     {-22904939, 6521443, -33251769, -2339570, 28698123, -11677108, 10502673, 3702605, -17157584, -3756454}},
+    {{-25126552, 2261441, 7484961, -11511266, 17746384, 427757, 28563327, 10336595, -511137, -8291405},
+     {32310012, 16136403, 5588409, -10302599, 4540368, 207066, 19571111, -10201196, -1498094, 14015039},
+     {3408964, 170331, -7999388, -12814547, -25217594, -13627509, -30367815, 6237883, -17428652, -1424193}},
+    {{-30583401, -2890881, -27163480, 172985, 9933425, -9760510, 2716365, -7782376, -18662473, 13577818},
+     {-19129770, -15329384, 15177281, -9255746, -25413540, 7358525, 23090983, -13120656, 14859744, -7788452},
+     {-15636196, 655648, 9235246, 14742194, -32888048, 2192264, 12508915, 7376392, -17843516, -3647329}},
+    {{17510178, 2486032, 17342374, -12734851, -3767945, -11023755, 5050104, -14660571, 26982434, 9534086},
+     {-13193752, 979170, -31059206, -8509034, 12341387, -16663612, -12254535, -727211, -8489734, -13479500},
+     {13924363, -14050722, -248356, -2013044, 6447849, 834904, 33341881, 6961646, -26506410, -6330292}},
+    {{-20434804, -4393756, -23763600, -10252451, -32882848, -16373058, -31614109, 2633744, -8185196, 3332403},
+     {12414490, -499219, -3240435, 1982096, 28982280, 13130288, -11200612, 15815289, 32757594, -2578956},
+     {-11770997, 4132053, 17573382, 15149583, -18510479, -5060823, 13950829, -4627781, -29411466, -14381829}},
+    {{10429614, 6389639, -28151961, 11340058, 20929227, 14634338, 27445773, 10590678, -17480994, -5890050},
+     {29359181, 15089315, -24466350, -9524626, -8077419, 15880854, -16191507, -9814408, 14476776, -7721904},
+     {-8161988, 9457828, -13440772, -1821864, 25976571, -15034327, 28156319, -10110121, -29022080, 1914421}},
+    {{14881928, 1929648, -23688957, -6876926, 8802471, -14140571, 31769881, 16723524, 11747879, 13665112},
+     {785476, -625839, 33222759, -15894132, 30045363, -13885328, 5395004, -13118456, -16537803, -15204164},
+     {-104950, 9353132, -20340908, 10673924, 31496315, -15318013, -33222888, 7514244, 23570557, -9721287}}
+  },
+  {
+    {{-6069670, -5052251, -5462350, -15363256, -21086622, 10493066, -4240204, 10782758, 19715924, -10609716},
+     {-20837039, 11879200, -28543308, -9107892, -15126666, -36018, 4729185, -11056419, -9260288, -14375140},
+     {-32242881, -1949709, -2333073, -12442631, -3258303, -14955346, -33321070, 15757667, 12526404, -13498899}},
+    {{738455, 15209961, 21522471, 13794043, -18272072, 14800413, 30429911, -7705559, 27832414, -1931956},
+     {7453038, 1368394, -29924865, -10811872, -8062337, -13351933, -22238829, 9010656, -16295049, 2678542},
+     {-19900866, -8627185, 3435928, -7976663, -29672159, -8117016, 32080383, 11402077, -29170196, -3492341}},
+    {{-16626749, 2417754, 33249389, -9811327, -29776058, 6245162, 24518258, -8872034, 32127821, 1670554},
+     {-17078794, -6058641, -25942028, 4690837, 15161979, 16163792, 6736582, -3297897, 1522395, 6083038},
+     {20110157, 2863573, -9031360, -14541031, -18766188, -5769962, -4019862, -8320702, -3996712, 6731694}},
+    {{-3991660, -9527471, 10802081, -222831, 9552676, 1668152, 32465931, -9801628, 25695594, 10570178},
+     {-1386077, 3332181, 7198948, -358053, 22465318, 168113, 28159978, -2337220, -15485647, 12543796},
+     {-551221, -11413806, 32145656, 10133860, -11854144, -14354305, -23987682, 3851704, 24621200, -6994241}},
+    {{30788031, 9648360, 9186580, -1538053, -17965427, -2943377, -10018285, 4678129, 9767830, -10927632},
+     {11190930, -5329963, -12253015, -10119901, -2369088, 2871273, -24269397, -15996154, -13033224, -15547248},
+     {24198774, -4444684, -7437759, 13151704, 13959055, 14276941, -25834619, -10853590, -3171068, -7607434}},
+    {{-3258969, -1107846, 13617051, -11682071, -13259561, -10031320, 5628962, 14824464, -17458055, -4514030},
+     {26779764, -10117419, -3884841, 7631434, 24902215, -14153592, -6937947, 1596055, 10102388, 8633413},
+     {-16144222, -1353508, -3168799, 7414019, -31826021, 3514682, -8518921, -15534058, 25911198, 5742629}},
+    {{-5217833, 8080727, 14682554, -8609568, 17526836, -7982066, 3072255, 8940582, 19981658, -10826958},
+     {4072283, -8659133, 31253685, -135014, 28370694, -3816665, -26174953, -1623825, -7790558, 544083},
+     {-20986443, -1611350, 7152575, -5964046, 773770, -6057817, 32307559, 7108196, -4688051, -1080814}},
+    {{-16254428, -4363307, 22954637, -1086624, -33161422, -5987332, -17684638, -6201010, -10761944, -3138478},
+     {-12626493, 7542435, -28044909, -14024969, 1591133, 11995702, 13303707, 12795301, 21854370, 8234601},
+     {-1578358, 10796253, -12174098, 9852963, 10851551, -14200866, 3317610, -13843590, 4680659, 12478641}}
+  },
+  {
+    {{22514622, -9142449, 2166950, -6940349, 11376442, 13509235, -33293707, -9958222, 5161867, 2412512},
+     {-5883134, 12235213, 11132467, 15344146, 11665129, -6953919, 4018212, 2010037, -31830517, -16465592},
+     {21587062, 14311011, 24712437, 16246189, -33257813, -11299725, -32933954, 10704060, 6677587, 2094364}},
+    {{-18290749, 8672615, 5547528, -11754940, -3537207, -8236827, 30807836, -14773950, 9784229, 338920},
+     {26029005, 986953, -18351861, 7174918, 6031977, -9816191, -1774815, -10191038, -6059200, 7371135},
+     {-5020052, 6668295, 26687846, 9592831, 13369729, 8921916, -7811955, 7111975, -10234643, 10773009}},
+    {{1750782, -11669265, 4726644, 10119869, 718929, 10871286, -6681860, 3219099, -16724792, -10120239},
+     {4959226, -15072905, 26746984, 15903927, 11556605, -6611653, -8187301, -2579591, 17439217, 16480865},
+     {17393683, 8963403, 20110473, 13337651, 24126229, 11533166, -19200733, -5162010, 2065776, -10599081}},
+    {{1566649, 5953730, -33237314, -15081047, -33410651, 13562370, 21765546, 6858313, 8692869, -11599288},
+     {-18822673, 9680709, 5436102, 7311888, 18492958, 16085950, 18594642, -14335181, -15144673, 7995124},
+     {30126015, -16441220, -23283109, -5010676, 9204919, 10837144, -21288079, 12501360, 25340489, 16405875}},
+    {{29047378, 8190936, -14166681, -14060087, -29700094, 12656501, -13146596, 9696956, 23228220, -6998534},
+     {-19835853, -2828400, -32211822, -11506796, -12462683, 14574472, 32050901, 12494879, 8189001, 5282082},
+     {8203499, -13371561, 26688685, 16169406, -32785729, -413524, -1199767, -4756447, 3883865, 2993835}},
+    {{-16733893, 11449742, -26319863, 10408893, -17301361, -12929270, -8281294, 8542988, 4786208, 75191},
+     {-31261013, -7671070, -30019747, 11957701, 18733193, 14943924, 21585529, 10494795, 24661569, -744192},
+     {-25271456, -13753487, 10584975, -13342556, 1909073, 903984, -16925281, -10193879, 28588036, 4329724}},
+    {{-14391122, -2503815, 19937966, -9593691, -12096980, -9908242, 28081993, 4004783, 13948268, -816869},
+     {-10324259, 4265294, -6604609, 7256867, -13015978, -13210822, -13719409, 14193247, -18536807, 4545838},
+     {-8339866, -15981664, -26020065, 5875023, 24965859, -3396820, 11591322, 13509397, -5002833, -3931880}},
+    {{27093406, -911231, -3329016, -15936755, 9290559, -8241685, -14841576, 9033888, -17137912, 7629846},
+     {1807870, 5197188, 9490047, -3507334, -1327922, -15342237, 12169160, -4969782, 17140545, -94266},
+     {23852594, -7238535, 5530489, 8614556, -11671892, -12577138, 6471427, -14906965, -30915538, -10909350}}
+  },
+  {
+    {{30119711, -9784270, 21311901, -11731286, 4545195, -5268616, -7194613, -13285313, -24895243, 8364851},
+     {529615, -9340280, -18344979, -16036583, -32500516, -3623762, -9921389, 12824930, -16870557, 131951},
+     {837674, 6366159, -3502508, 1326053, 14882179, 5587264, -26143641, -5363199, -32492502, 1085539}},
+    {{8479303, 1252296, -17667299, -4777089, -29963573, -12038778, 12659471, -8719634, 16278315, 2131977},
+     {-786593, -8743829, -15249100, -13009385, -26325342, 7257437, 6671327, -9722489, 4813412, 4535646},
+     {-14947165, 7266075, -26298784, -9554087, 22340862, -4791061, -23852980, -2854366, 14275706, 7033170}},
+    {{-1442074, -419004, -14601202, 58052, -22950679, -423596, 10928135, 4916762, -9667792, -16303774},
+     {10111229, 10446862, -18622037, -11217982, -20037997, 14388845, 12258710, 8943835, 29136865, 14105927},
+     {-26165195, -15797898, -25113802, 8706189, -5531152, -8900645, 6223962, 1200883, 2084980, -7046968}},
+    {{-16994639, 15280136, 22189231, -8986236, 31096112, 248622, 8877467, 5184062, 31974465, -16619719},
+     {-13580849, -10411780, 25270984, 11606798, 20140754, 8660652, 7503954, -2261550, -3044331, 2872438},
+     {-28237316, 6525923, 33293145, 2547665, 32946773, 4394489, 5572331, -610204, -28130141, -6698486}},
+    {{21420854, 2996234, -11078219, 13883690, 7353236, 14501979, 6565171, -10751863, -27457930, -229631},
+     {7063979, -7832266, 33378537, -870413, -19582481, -5389779, 17961664, -5824273, -29254767, 7001328},
+     {27174589, -7944692, -31761634, 4313360, 79392, 3821387, -11202876, -6125701, -26346080, -13179249}},
+    {{-4752261, 12594931, -16172245, -11235444, -8981998, 2677172, -8366241, -1585249, 29908274, -9206623},
+     {27002709, -1274130, 32461213, -9558104, 14096220, -6598461, -15242889, -4968508, 24021301, 14205308},
+     {11582971, -5911706, -3447241, 3499319, 32917532, 9069983, 25721928, 4635854, -26280464, -12326133}},
+    {{-17544753, 13050302, -23354069, 5306454, 21416865, 9327901, 15046741, 13391872, 26496835, -5725363},
+     {-7860371, 15367383, 16277114, 6739999, -4739052, -1003101, -11792387, 9737491, -21314077, -14249287},
+     {10961139, 12893057, 3048727, -1253772, 5293295, 12651584, -19205516, -5542305, 26438365, -852282}},
+    {{3598048, 5152435, 31306191, -14947645, -1578273, 14808293, -3454627, 9422666, -1051148, 7361217},
+     {-7767763, 7827611, 13407330, 3592841, 7127763, -15398823, -4348312, 8454549, 32616457, 7835919},
+     {11031204, -14748603, -25828563, -7306841, 22994355, -6459910, 15573512, 9596005, 25601393, -8662791}}
+  },
+  {
+    {{23839531, -1616502, 30191244, 10928297, -26946045, 3795407, -19357780, 3675677, -24296558, -12062547},
+     {-4379010, -4481858, -1454303, 11568342, 1526211, -12474204, -25222435, 5304748, -26097292, -15529886},
+     {31631775, -768539, 5383026, -16164005, 7420284, 2405746, 7571514, -10957978, -24853259, -4608392}},
+    {{831643, -15219650, 2764144, 14858017, 30256467, 15702468, -15707421, -1550249, -20170233, -8572415},
+     {-14818991, 9958291, 310270, 4131042, -10418429, 7642248, -27663318, -4250453, 26806497, 11838609},
+     {17257197, -9290657, 16782189, -3785737, -31427699, -10290716, -24479698, -5695369, 22801425, -6572681}},
+    {{-3537795, -8588685, 32341526, 6267561, -33091893, 7561108, 17340066, 9542139, 7856640, 8162947},
+     {-5109603, 2650243, -25014361, -15944089, -33420076, 9949972, -8010186, -1828715, -4182008, 12235747},
+     {29103472, -11428103, -26108345, 1076694, 1002340, 16375966, 21844350, -7731990, -14036148, 2163452}},
+    {{-13114133, -13100320, 26827179, 4173643, -30210690, -10912305, -28977046, 104197, -33159356, 9546751},
+     {1094279, -8467081, -28070098, 7005184, 10247599, -5093115, -22940572, 5165032, -31908780, 791511},
+     {-1813727, 2333247, -33143045, 4589243, -31971883, -11924170, 25819077, 6597075, -20613827, 9871603}},
+    {{22197986, -2520498, 13595618, 7358881, 13593976, 655068, -23947797, 1654761, -10727314, 1767492},
+     {-19392911, 9163324, 31932932, -15049634, 25755397, 2222320, -30538527, 12977091, 33335170, -835946},
+     {-30788494, -8033682, -2522285, 11686552, 8918065, 12324350, 20726420, 14922996, 10592750, -8779300}},
+    {{-30172044, 12190353, -10699520, -13287424, 13655366, 4230318, -13725810, 12437137, -20576836, 11741793},
+     {25782876, 9724139, -27343192, -2147221, -6185748, 10706789, -8835127, 2114957, -4999061, 2572605},
+     {25017985, -11055802, -753754, -11247832, 8515772, 5957912, 32271769, -5782334, 24278850, -1521292}},
+    {{-30800022, 10436704, 19651994, 16298418, -10608222, -7195674, -15894455, -3372459, -15221989, 11083384},
+     {23985653, -5345548, 17119751, 12461245, -24636067, -973208, -26954924, 3150286, -7265380, -13308822},
+     {-2414832, -4480115, -7031860, 16168482, 6447443, 7438648, -32415031, -2919292, -7715930, 10401109}},
+    {{-28899460, 10442980, 735595, -16186098, -29958834, -1180211, -15784250, 15968916, -9108559, 2098511},
+     {20254068, -4762939, 3597545, 4682921, -12517585, -7966005, -14996214, -12821234, -530471, -12305822},
+     {-29436957, -5806909, 14965685, -7443707, 16048572, -5615898, -2708385, 15030531, 22347379, 9370165}}
+  },
+  {
+    {{4863460, 14069888, 16285550, 1692464, 13072445, -14101095, -20389917, 10588017, -27305040, -11077015},
+     {-294417, 2704020, 1566698, 4841377, -20479788, 11152593, 21433955, -12053643, -31481288, 13143650},
+     {-2409006, 1487693, -21216864, -1833630, 280270, -7803925, 23803448, -8804078, -15314800, -2344265}},
+    {{5271993, 15573096, -1614278, 13741208, 8920470, 8512526, 11834556, 15322080, 15231907, 5962612},
+     {-28407331, 8288280, -14225270, -138294, -16675828, 10897757, 20597419, 8350628, 30016864, 2529749},
+     {2570165, -13429813, -18846758, 6385254, 17751672, 12860915, 286247, 14157436, 984918, 1771233}},
+    {{-16613265, -5791769, -20443842, 5415913, -13631990, 4393321, 30684377, -13744206, 13893159, -15016221},
+     {-7800713, 2716073, -19558703, 10941846, 697776, -7591176, 16359822, -2437991, 22366751, 14197005},
+     {-25236493, 4727232, -24707792, -13010293, 20113840, -9504023, -32815703, -6872159, 17054083, -8747804}},
+    {{30650370, 13564213, 17829349, 13324366, -20991793, 12371149, -4599212, -13541268, -24877534, 9115365},
+     {7352052, 9905981, -26891998, 16537902, 18121436, 2092926, 9966376, -10131869, 24939823, -6965722},
+     {-12744391, 3293073, -3532437, -9218964, -31030483, -278949, 21670277, 2150201, 23910396, 3246488}},
+    {{-764732, -991617, -17944068, -7893722, 18257574, 13850901, 17791965, 3298706, 30048706, -16039389},
+     {7976498, -5373294, 4039680, -9283887, 26106314, 8398266, -2602597, 15795833, 7289905, -14914941},
+     {1462681, 8637928, 6844923, -4307705, 2845550, 7727136, 33488484, 14476319, -25116128, 7588603}},
+    {{-20954814, -10779007, 18862854, 2022087, -29103822, 11635649, 24829550, -7552968, 16914092, -6178766},
+     {-10353985, -8620115, -11224996, 5150484, -28665864, 651732, -14386306, -13946973, 5323717, -2946256},
+     {21206458, -9521431, 13452278, -16420755, -19896309, -6063096, 16436318, 6404067, -20061052, -5747997}},
+    {{-22090894, 16211975, 17706791, -11138420, 166531, -14600524, 28955024, -1884908, 9423135, -14505246},
+     {30709209, 12224462, -4219109, 7508729, 23375972, -6742757, -27360667, -6882446, -29521679, 4710391},
+     {3208225, -2120554, -8339324, -11809999, 46515, -16487890, -28312426, 8007900, 19443785, -2617982}},
+    {{22678277, 4340058, 7435910, -12228163, 28491836, -11308159, 23820114, 4492251, 21720515, 16553995},
+     {-32704058, 13660549, 11756599, 9893485, -5584216, 10783541, -6913787, -9627595, -25262124, 8746293},
+     {-3477092, 9563543, 13261078, 1936790, 19258999, -1252638, 12606955, 471348, -29561714, 5227107}}
+  },
+  {
+    {{-11299124, 15664638, 15253659, 12490691, 27761291, -12670010, 5164283, 12212424, -10276126, -8288808},
+     {-3240036, 13514210, 17935985, -15594547, -19359388, -11456146, 29773433, 12133902, -579801, -14398926},
+     {21030896, 5096381, -32200700, -5435505, 2376540, -16336889, -27957586, 4630727, -11103153, -5707879}},
+    {{302749, 6657501, -22715468, -15939598, -1100357, 5387943, 31893606, 14439993, -2885244, 8223521},
+     {-7277574, -11169736, 12407514, 7790545, 28371416, -1884988, 32998573, -3472226, -1756973, -16113030},
+     {-24327307, 13168845, 31273439, 4123707, -21165432, -333929, 32337455, -1432545, -21992454, 9468050}},
+    {{-25117768, 12527257, -16699435, 9936927, 9083964, -226016, -14656114, 8242746, -10581035, 11475289},
+     {24025353, -6056469, 828733, 4217393, 20072835, -14763189, 4396883, 1239008, -313127, -9499874},
+     {23834003, -8968214, 16489755, -1118006, -6930746, -15179868, -23497421, -16380669, -5229400, 8353201}},
+    {{30996412, 15313227, 22541186, 6420462, 11988094, 587701, -15130577, -12799292, -31736211, -14474619},
+     {31201534, -13065451, 24879437, 13212879, -7373190, 14870099, -31354440, -8270026, 3386957, 14155263},
+     {23356504, 5676822, -20791416, 12454214, -12021045, -280301, -18553725, -693241, 19350570, -16032092}},
+    {{-12737073, -14528027, -12741323, 7739212, 19489352, -1725364, 4194314, 2683611, 24425611, -15410613},
+     {-17355034, 8714491, -23270964, 13770087, 27152992, 11864267, -29462729, 10903531, 30478283, -4213657},
+     {5610607, -2660758, -3892305, 456706, -3102587, 9603687, 32576749, 4557380, -5844081, 1637659}},
+    {{-13342412, -15782450, -24582351, 3786309, -23257108, 4534399, -20965167, 858482, 15128623, -6421442},
+     {-11311449, 9478744, -10118566, 2757789, -14102901, -2246307, -2698396, -5524722, 4388627, -9939792},
+     {-30900793, 14937909, -2988067, -15201022, 30089039, -6805926, 32786015, 8415886, 18190875, -3370327}},
+    {{2315486, 16627386, -11684444, -11160903, 27625793, -7456815, -24437902, 2487149, 6101555, -9260736},
+     {3980942, 5291291, 577711, -7718522, -24687213, 3948992, -9663895, 12206994, -31527059, 2155398},
+     {31693079, 5583674, 17355160, 6039283, 23914512, -4301458, 5443161, -2074469, -4355998, -16519642}},
+    {{-21952652, -4845097, -18293584, -16548214, 29691257, -16624078, -4118681, -3185018, 32147346, -13870944},
+     {-18991199, -9788391, -19124071, 26861, 17331860, 9585369, 21174325, 1789712, 10916049, 15825177},
+     {-8309868, 4224323, 17111608, 9156467, -8677316, 4154378, -12301924, -16170601, -27299851, -7991530}}
+  },
+  {
+    {{7030396, 10563936, 1008588, -2147605, -15213978, -8859037, -1266598, -9563795, -22536999, 16130906},
+     {207890, -9611941, -12101257, -4634292, -8534457, -1211972, -4615337, 8304704, -4813856, -3754077},
+     {5166985, -6380344, 29708655, 6094085, 30981931, -3258233, -661961, -626972, 22609670, 13681032}},
+    {{-25480761, 8798667, 188316, -5418308, 20310898, -12086492, 20665156, -8560168, 30539173, -4868491},
+     {32882505, -9934344, 1203212, -9526373, 10032630, -3394826, -27771974, -413956, 23711190, 2717266},
+     {28344707, 6906554, -15637418, -7468318, -633022, -16120552, 9550659, 7066928, -5523469, 13426995}},
+    {{-31356019, -15163766, 25962104, 16661824, -5635384, -12673305, 5805452, 733835, -2039053, 1935647},
+     {10667976, -1533437, 33245070, 2325938, 7160328, 3266270, 26889770, -7258774, 16169082, -11935026},
+     {1455981, 4291973, 24414812, -4969121, -5087555, -5866441, -10845422, -10476323, 24067408, -9190495}},
+    {{28525224, -5010353, -16918570, 14426478, -13726323, -8449040, -30207935, 12115218, -22747283, 7229667},
+     {-18298188, 5905607, -27738407, 16145021, 24674768, 13483070, -23203130, -4266571, -31024783, 12023803},
+     {-26279123, 1957766, 6623562, -7832131, 1699048, -15745674, -18558207, -14638299, -10696895, -4725034}},
+    {{13295188, -993582, 5119388, 16617876, 27926812, 10492778, 19206688, -1757567, 23069622, -14911138},
+     {-606769, 4606538, 3754072, -3014165, -29473210, -6414494, -30592186, -935036, -8368447, 5658642},
+     {15546303, -5313301, 27089747, -5289724, 32018575, 11451106, -30533604, -3808102, -16923173, -12382885}},
+    {{-13518473, -10012729, -10585602, 2909481, -3007834, 9183109, 12137205, -8387951, 31011501, -2021041},
+     {29557528, -13643568, -4603588, 9181377, -4528104, 1976738, 14706542, 11933743, 9466867, 7798254},
+     {16533792, 8288197, -219725, 6693453, 31142616, -3211261, 26631667, 1922178, -30060800, 16666465}},
+    {{31541624, -16468898, -1319594, -6430880, -112384, 6540840, -13503997, 12577119, -25093537, 4148743},
+     {-33239400, 16374312, -26726352, 15737395, 27147996, 8973740, 16959411, -13412942, 20263601, -9007805},
+     {3596135, -5555415, -19063221, -12225713, 4337030, -10681492, 12805558, -1440741, -6296021, -6986401}},
+    {{184492, 5252852, -13314120, 2993767, 26843145, 14583276, 12509821, -1986490, 11971966, 784973},
+     {16909071, 2891754, -30902827, -11033825, -1953318, 7895649, 4305694, 9765558, 21505658, 2337476},
+     {-4724108, -12828620, 5610988, -6484390, 9053657, 15893986, -16373145, -11879782, 4759879, 12649008}}
+  },
+  {
+    {{33464231, 6447153, -21430216, -11826305, -13265506, -6971257, 2286057, -13610964, -14259000, -4674051},
+     {-29884627, -13249106, -31941316, 8277056, -5164846, -276552, -20364550, -11470373, 7945759, 13374677},
+     {-3975518, 596542, 26638736, 1100986, -25712918, -4713631, -7254437, -11774601, -5833748, -15497210}},
+    {{-20287776, 736494, 1593599, -997467, 23084581, 320855, 9962387, -8150863, 2452762, -5067349},
+     {14333831, 11129045, 6510744, -1936008, -29788879, 8621848, -32380639, 10311406, 16158158, -2987994},
+     {12705395, -514037, -18121828, -356821, 825752, -12927253, -31885180, 12633474, 21813176, -5627776}},
+    {{-11539583, 7626540, 9730594, 1415637, 1322729, 11824176, 10886775, -5332246, 11648040, -11338898},
+     {7634888, 10796969, 24196261, 4783405, -9418095, 4695247, -19618340, -7742714, 15290669, -13246537},
+     {-1959780, 3690846, 8957689, -11010866, -24145474, -13413564, -26221513, 13968937, 31966241, 15358294}},
+    {{12233317, 14834208, -25048942, 2593837, 20079295, 5523638, 22269394, -3146263, 17455019, -11934956},
+     {2806510, -12366339, -8478133, 2409744, -30547072, -7779149, 25411866, -6190166, 14935193, 729401},
+     {21760935, -9167606, -600918, -3737400, -2788069, -5340313, -630073, 2932238, -26732275, -10348194}},
+    {{31612118, 867343, -23930901, -8997877, -18735325, 8513683, -24048310, -890335, 27227940, -6454348},
+     {-17862377, -3896249, -27723121, 595189, 21024964, -15361129, -17776049, -13029549, 28882387, 9512534},
+     {3531104, 15265259, 707795, -142303, 12268509, 8408839, -32535584, 10281822, 3245423, 3562224}},
+    {{7669236, -11719629, -28240325, -6244837, 13317121, -10304867, -11354108, -8447641, -7194719, -9438809},
+     {29699458, 3120605, 22488675, -5593467, 20110739, 7814545, -6384666, -15641222, 4723251, 15717190},
+     {10572222, -5578850, -18062584, 5032010, -17848765, 13099830, 12498725, -974866, -13476038, -13536393}},
+    {{-5637886, -12428806, 13617903, -1934630, 11591672, -8930746, 11738393, 6649420, -7486763, 15261050},
+     {26257131, -5385384, -23291873, -14586424, 8628743, -13543584, -21512500, -8112872, 2501320, 13551448},
+     {21880317, 7982027, 16322600, 12785200, -6575110, -12800047, 21113900, 6866040, -17498217, -15014626}},
+    {{22558130, -11266301, 9265731, 4186438, 11042895, -1415602, 5298117, -3939180, -7728847, -15727911},
+     {-7332260, -22252, -17809020, -4649946, 11283903, -15410296, -14207, 2645169, -10192806, 14437437},
+     {-18015805, 7199014, -28965056, -7902828, 13074475, -3533391, 21244866, -2561471, 7711948, 1747686}}
+  },
+  {
+    {{2645815, -14611604, 18609641, 8535934, -31634334, 2135963, -26195716, 11481775, -33122795, 3726902},
+     {20621035, 10751310, -29776383, -7534242, 11354181, 9683490, -312328, -9064604, -7558269, -15980792},
+     {-16295339, 10771553, -287937, 9656325, 19885419, 4058894, 14063211, -15798523, 9920468, 1982229}},
+    {{3385738, 1234670, -26862528, -10392990, 17948024, 11331859, 19006271, 1386324, -29533984, 10262724},
+     {8884032, -1096438, 3420412, 15266977, 5052635, -9223773, -1791853, -6878749, 12243607, -8919499},
+     {13175655, -1838021, -21807507, 14192674, -4193002, -10962788, 19914268, -13253426, -22594958, -15951981}},
+    {{-9833040, -15161676, -8479323, 7793366, 11085939, 11720315, -18542677, 8758951, 17054491, -9031261},
+     {-12831578, -9323567, -15176528, 16516832, 26533242, -13161042, -23682258, -14096128, -6842648, -14312786},
+     {-4969699, 13325177, 236998, -10963677, -10405527, -7625755, -31704188, 8843013, -12483346, -2116485}},
+    {{-23925459, -11469272, -13057268, -11013575, -20895620, 15744848, -2145197, -8672972, -17577894, -9032651},
+     {1587635, -13086776, -30656517, -15601168, -21250048, -10674204, 25327670, -8907061, -5065168, -11828712},
+     {21820090, 1997481, 14475848, -11009831, -10710632, -8718338, 31358693, -6271736, -21668179, 1348305}},
+    {{-8216916, 3615591, -12970109, -12210260, 9353717, -13090253, -16181963, -7260055, -13730485, 6915139},
+     {5523395, -11046983, 12443554, 13650176, 28553428, 7698891, -29613525, -12012747, -31363456, -10008309},
+     {-26634305, 13621946, -13334032, -11423550, 27338201, -16075483, -17866548, 11062577, 10341151, -11792006}},
+    {{21364261, 9385891, 5918875, 13050407, -17495288, -8505959, 13319184, 5657866, -695954, -2553051},
+     {-11316261, 15520182, -3909263, 6124169, -789815, -16062736, -28925845, -9717387, -27308163, 10194668},
+     {26605796, 16165329, -2718620, 6040534, -8805838, 5845615, -28882162, -15251463, 10575004, 2931151}},
+    {{29375061, -1053730, -10886712, 2778587, 12705468, -12721249, -22469906, -10552647, 1341093, 358819},
+     {25120806, 13699632, -7013673, -14689579, -25507383, -15088059, 30572941, 12606575, 14375334, 8861920},
+     {420427, -11922296, 31356987, 9546629, -27950855, 7047758, -13839471, -4640667, 9566447, -8955356}},
+    {{20000919, 9004137, 17712032, -8998600, -14109397, -15991519, 9814680, 15274196, -6629414, -10773743},
+     {-2897834, -14600272, -28796554, 4561664, 5804813, -6509305, 4646191, -8579329, 14298159, 15481181},
+     {-21120282, -12594607, -1099551, -15362319, 24676024, 5438168, -19269205, -8897236, -8851313, 2132693}}
+  },
+  {
+    {{12926894, -4621803, -92124, 612986, 27798555, 11958898, -33046416, 8250987, 3985534, 5752383},
+     {8181413, -14871953, -4457237, -11061318, 4090619, 8617513, 938880, 3172702, 30667196, -7426963},
+     {2684044, -12461844, 13362767, 174928, 1574941, -11969704, 32246114, 1161895, 28861941, 2212274}},
+    {{11801177, 4640846, 5077395, 9665750, 9498225, -3429443, -5986596, -6285506, -2291665, -8460019},
+     {20200978, -14112049, 12779120, -9697954, 6959529, 13434826, 15735530, 3617225, -18109923, -14495312},
+     {26483408, 7918962, 32543625, 15966796, -18494165, 6700637, 33515571, 1468472, -7434639, 3882936}},
+    {{20985698, -2287366, 20524682, -9146394, -2201032, -1782300, 20073259, 8823495, 14362703, 15566306},
+     {13922540, 12838887, 69320, 14492027, -19354830, -5395105, 1359405, 1049363, -19171131, -2218123},
+     {24049349, 9045571, 25122372, -7195022, -22730341, -16028472, 13876520, -15079208, -84172, -16196812}},
+    {{-25723383, 749559, -19675269, 6315202, 29803999, -15976807, -12439101, 4072354, 28610093, -9845167},
+     {22405748, -3140797, 23752851, 13509993, 28416399, -5679308, -2593577, 15179142, -32711793, 9985925},
+     {5983061, 1013072, 10563044, 2131346, 13237016, 2787398, -29812650, -9612409, -4120577, -2131800}},
+    {{13554397, -8068101, -9219988, 10441906, -30246212, 1445543, -2105255, -15574740, -12920712, -10651236},
+     {-4753240, -15338911, -31091178, -11616267, 21968691, -14722596, 22817408, -4879304, -15790616, 15231156},
+     {9423693, 952818, 1446704, 4799222, 13724062, -9688091, -3872640, -15316813, -28186869, -7609846}},
+    {{25827808, 9068954, 21900720, -16013636, -9281400, 13311816, 3119355, -7722955, 2870698, 13933703},
+     {33496055, 12104150, 1499403, 4839538, 5391639, -887943, -787136, -11356019, 11361396, -12862660},
+     {20957573, 10900616, -18298618, 6927441, 4333372, 12671653, 19978419, -8113718, 4386085, 11889846}},
+    {{23774534, -766138, -3839017, -10036218, 14534868, 16100900, -26739138, -6448087, -6536165, -12018956},
+     {-2892060, -330117, -13729702, -4601839, -11441018, 3187128, -8648193, 14175919, -6671121, -10860836},
+     {-1723065, -6611831, -19976386, -4974201, 29195586, -7676695, 32568503, -8356434, 31578317, 10424168}},
+    {{-15795703, 760921, 31196422, 1661734, -16035192, -10317121, 1054758, -1900255, -5602642, -8443438},
+     {-1946508, 8121488, -4182057, 16298638, 16335826, -8024598, -6722031, 2041813, 24492929, 6086127},
+     {2461349, 8450263, 27141221, -10265000, -31733527, 4464999, -20543849, 12937142, -3491992, 1221197}}
+  },
+  {
+    {{-14936374, -8966633, 16035159, -12459047, -28113932, -11200577, 9309498, -699242, 17539307, -14268189},
+     {-14913844, 2041963, 16152106, -1002060, -17493443, 8032684, -16924778, -2611573, 31650478, -2759542},
+     {-21329046, -14969697, 9403807, 3956363, 5669425, -9408529, 14897968, 1748830, -7404637, -7530518}},
+    {{30994596, 15923823, -27241862, 14674108, -9677648, -15226762, -17942848, -2109512, 13169703, 16280007},
+     {1435572, 12474308, 5012448, 15551904, 31734544, -1437433, 17256602, -15128153, -25283664, -11281360},
+     {12238178, -14092060, 17201416, -13101938, -33310834, -8847163, 1861226, -771824, -30282702, 11632385}},
+    {{-29004168, 12137537, -9291644, 939684, -31652565, 11993054, 24206801, 123570, -41951, -2660533},
+     {-16544926, 10765766, 32522199, -15839497, -7059235, -15890379, -887889, -8862829, -6144572, -6111558},
+     {-31004644, 7150990, 31173499, -4856575, -31041115, -1017932, 9215665, 9314632, 2100453, 12738185}},
+    {{-23739239, 12175642, -20909012, -6181563, 5010829, 13707831, 17477840, 7104010, -19240197, -10895057},
+     {-477089, 10341682, -31642904, -1045100, -3864955, 15033511, 14090074, -5701542, 19720252, -13711114},
+     {-17231175, -15554091, -31910418, -10042564, 24746366, -3617448, -19512878, -11548281, 68185, 11397287}},
+    {{-16775058, 4360432, -1079696, 16202168, -21022135, 4793045, 7551089, 12806060, -15402656, 4668026},
+     {12701398, 2088436, -27322240, -4860379, -30130045, 6937264, -32183617, -6551970, -10888864, -10072030},
+     {1424065, -4340490, 4949044, 15352543, -3865319, 5323858, -31201753, 7499179, -1708220, 6104219}},
+    {{-1441215, -9108123, 31115231, -15698297, 24310535, -13095796, 19359620, 3518970, -19894898, -4288325},
+     {6018510, -5456257, -31705412, -11071807, -28611939, -14017446, -26743204, -12282375, 1309731, -14289438},
+     {-9226446, -6253944, 15129679, 14842587, 33420224, 16402151, 1044866, -7155772, -30050295, -2004773}},
+    {{22117334, -15686121, -19988255, 4027178, 27997531, 5928803, 20758988, 12935188, -5353178, -12214336},
+     {-16691925, -1081511, -17731508, 14902587, -14595878, 744945, -1666002, -7214234, 12943433, 4893829},
+     {-11287370, -5605308, -12413014, 16537161, 5885809, 13376186, 861973, -12274401, -7191757, 13542570}},
+    {{26159853, 5695496, -13021323, 3774590, -12595062, 13031688, 19183275, -3499173, 24071151, -11664630},
+     {-6722558, 8201802, -18197574, 13042281, 3329729, -3134402, -12301504, -2743312, -24332108, 12474634},
+     {-24539875, -3555046, -1092694, 13129722, 16000542, -2442683, -8801996, 13867540, 31961542, -2259691}}
+  }
+};
+
 const ge_precomp ge_Bi[8] = {
   {{25967493, -14356035, 29566456, 3660896, -12694345, 4014787, 27544626, -11754271, -6079156, 2047605},
    {-12545711, 934262, -2722910, 3049990, -727428, 9406986, 12720692, 5043384, 19500929, -15469378},
@@ -1497,20 +1497,20 @@ static void ge_precomp_cmov(ge_precomp *t, const ge_precomp *u, unsigned char b)
   fe_cmov(t->xy2d, u->xy2d, b);
 }
 
-static void select(ge_precomp *t, int pos, signed char b) {
+static void select(ge_precomp *t, const ge_precomp *multiples, signed char b) {
   ge_precomp minust;
   unsigned char bnegative = negative(b);
   unsigned char babs = b - (((-bnegative) & b) << 1);
 
   ge_precomp_0(t);
-  ge_precomp_cmov(t, &ge_base[pos][0], equal(babs, 1));
-  ge_precomp_cmov(t, &ge_base[pos][1], equal(babs, 2));
-  ge_precomp_cmov(t, &ge_base[pos][2], equal(babs, 3));
-  ge_precomp_cmov(t, &ge_base[pos][3], equal(babs, 4));
-  ge_precomp_cmov(t, &ge_base[pos][4], equal(babs, 5));
-  ge_precomp_cmov(t, &ge_base[pos][5], equal(babs, 6));
-  ge_precomp_cmov(t, &ge_base[pos][6], equal(babs, 7));
-  ge_precomp_cmov(t, &ge_base[pos][7], equal(babs, 8));
+  ge_precomp_cmov(t, &multiples[0], equal(babs, 1));
+  ge_precomp_cmov(t, &multiples[1], equal(babs, 2));
+  ge_precomp_cmov(t, &multiples[2], equal(babs, 3));
+  ge_precomp_cmov(t, &multiples[3], equal(babs, 4));
+  ge_precomp_cmov(t, &multiples[4], equal(babs, 5));
+  ge_precomp_cmov(t, &multiples[5], equal(babs, 6));
+  ge_precomp_cmov(t, &multiples[6], equal(babs, 7));
+  ge_precomp_cmov(t, &multiples[7], equal(babs, 8));
   fe_copy(minust.yplusx, t->yminusx);
   fe_copy(minust.yminusx, t->yplusx);
   fe_neg(minust.xy2d, t->xy2d);
@@ -1530,7 +1530,6 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
   signed char e[64];
   signed char carry;
   ge_p1p1 r;
-  ge_p2 s;
   ge_precomp t;
   int i;
 
@@ -1551,19 +1550,10 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
   e[63] += carry;
   /* each e[i] is between -8 and 8 */
 
+  /* odd digits are looked up in the table of 16 times larger multiples instead of doubling their sum 4 times */
   ge_p3_0(h);
-  for (i = 1; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
-    ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
-  }
-
-  ge_p3_dbl(&r, h);  ge_p1p1_to_p2(&s, &r);
-  ge_p2_dbl(&r, &s); ge_p1p1_to_p2(&s, &r);
-  ge_p2_dbl(&r, &s); ge_p1p1_to_p2(&s, &r);
-  ge_p2_dbl(&r, &s); ge_p1p1_to_p3(h, &r);
-
-  for (i = 0; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
+  for (i = 0; i < 64; ++i) {
+    select(&t, (i & 1) ? ge_base16[i / 2] : ge_base[i / 2], e[i]);
     ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
   }
 }
@@ -1603,6 +1593,38 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+/* Same as ge_tobytes for count points, s receives 32 bytes per point. One inversion is shared by all points:
+   products[i] = h[0]->Z * ... * h[i]->Z, the inverse of the last product yields all inverses going back. */
+
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, size_t count, fe *products) {
+  fe recip;
+  fe inverse;
+  fe x;
+  fe y;
+  size_t i;
+
+  if (count == 0) {
+    return;
+  }
+  fe_copy(products[0], h[0].Z);
+  for (i = 1; i < count; i++) {
+    fe_mul(products[i], products[i - 1], h[i].Z);
+  }
+  fe_invert(inverse, products[count - 1]);
+  for (i = count - 1; i > 0; i--) {
+    fe_mul(recip, inverse, products[i - 1]);
+    fe_mul(inverse, inverse, h[i].Z);
+    fe_mul(x, h[i].X, recip);
+    fe_mul(y, h[i].Y, recip);
+    fe_tobytes(s + 32 * i, y);
+    s[32 * i + 31] ^= fe_isnegative(x) << 7;
+  }
+  fe_mul(x, h[0].X, inverse);
+  fe_mul(y, h[0].Y, inverse);
+  fe_tobytes(s, y);
+  s[31] ^= fe_isnegative(x) << 7;
+}
+
 /* From sc_reduce.c */
 
 /*
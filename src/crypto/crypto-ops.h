@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 /* From fe.h */
 
 typedef int32_t fe[10];
@@ -84,6 +86,7 @@ void ge_p3_tobytes(unsigned char *, const ge_p3 *);
 /* From ge_scalarmult_base.c */
 
 extern const ge_precomp ge_base[32][8];
+extern const ge_precomp ge_base16[32][8];
 void ge_scalarmult_base(ge_p3 *, const unsigned char *);
 
 /* From ge_sub.c */
@@ -93,6 +96,7 @@ void ge_sub(ge_p1p1 *, const ge_p3 *, const ge_cached *);
 /* From ge_tobytes.c */
 
 void ge_tobytes(unsigned char *, const ge_p2 *);
+void ge_tobytes_batch(unsigned char *, const ge_p2 *, size_t, fe *);
 
 /* From sc_reduce.c */
 
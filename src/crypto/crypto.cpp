@@ -5,7 +5,6 @@
 #include <cstdlib>
 #include <cstring>
 #include <memory>
-#include <mutex>
 
 #include "Common/varint.h"
 #include "crypto.h"
@@ -15,8 +14,6 @@ namespace crypto {
 
   using std::abort;
   using std::int32_t;
-  using std::lock_guard;
-  using std::mutex;
   using std::size_t;
 
   extern "C" {
@@ -24,8 +21,6 @@ namespace crypto {
 #include "random.h"
   }
 
-  mutex random_lock;
-
   static inline unsigned char *operator &(ec_point &point) {
     return &reinterpret_cast<unsigned char &>(point);
   }
@@ -55,7 +50,6 @@ namespace crypto {
   }
 
   void crypto_ops::generate_keys(public_key &pub, secret_key &sec) {
-    lock_guard<mutex> lock(random_lock);
     ge_p3 point;
     random_scalar(sec);
     ge_scalarmult_base(&point, &sec);
@@ -92,6 +86,29 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::generate_key_derivations(const public_key &key1, const secret_key *keys2, size_t count,
+    key_derivation *derivations) {
+    ge_p3 point;
+    if (ge_frombytes_vartime(&point, &key1) != 0) {
+      return false;
+    }
+    if (count == 0) {
+      return true;
+    }
+    std::vector<ge_p2> points(count);
+    for (size_t i = 0; i < count; ++i) {
+      ge_p2 point2;
+      ge_p1p1 point3;
+      assert(sc_check(&keys2[i]) == 0);
+      ge_scalarmult(&point2, &keys2[i], &point);
+      ge_mul8(&point3, &point2);
+      ge_p1p1_to_p2(&points[i], &point3);
+    }
+    std::unique_ptr<fe[]> products(new fe[count]);
+    ge_tobytes_batch(&derivations[0], points.data(), count, products.get());
+    return true;
+  }
+
   static void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     struct {
       key_derivation derivation;
@@ -124,6 +141,32 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::derive_public_keys(const key_derivation &derivation, const size_t *output_indexes, size_t count,
+    const public_key &base, public_key *derived_keys) {
+    ge_p3 point1;
+    ge_cached point2;
+    if (ge_frombytes_vartime(&point1, &base) != 0) {
+      return false;
+    }
+    if (count == 0) {
+      return true;
+    }
+    ge_p3_to_cached(&point2, &point1);
+    std::vector<ge_p2> points(count);
+    for (size_t i = 0; i < count; ++i) {
+      ec_scalar scalar;
+      ge_p3 point3;
+      ge_p1p1 point4;
+      derivation_to_scalar(derivation, output_indexes[i], scalar);
+      ge_scalarmult_base(&point3, &scalar);
+      ge_add(&point4, &point3, &point2);
+      ge_p1p1_to_p2(&points[i], &point4);
+    }
+    std::unique_ptr<fe[]> products(new fe[count]);
+    ge_tobytes_batch(&derived_keys[0], points.data(), count, products.get());
+    return true;
+  }
+
   void crypto_ops::derive_secret_key(const key_derivation &derivation, size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     ec_scalar scalar;
@@ -152,6 +195,43 @@ namespace crypto {
     return true;
   }
 
+  void crypto_ops::underive_public_keys(const key_derivation &derivation, const size_t *output_indexes,
+    const public_key *derived_keys, size_t count, public_key *bases, bool *valid) {
+    std::vector<ge_p2> points;
+    std::vector<size_t> pointIndexes;
+    points.reserve(count);
+    pointIndexes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      ec_scalar scalar;
+      ge_p3 point1;
+      ge_p3 point2;
+      ge_cached point3;
+      ge_p1p1 point4;
+      valid[i] = ge_frombytes_vartime(&point1, &derived_keys[i]) == 0;
+      if (!valid[i]) {
+        continue;
+      }
+      derivation_to_scalar(derivation, output_indexes[i], scalar);
+      ge_scalarmult_base(&point2, &scalar);
+      ge_p3_to_cached(&point3, &point2);
+      ge_sub(&point4, &point1, &point3);
+      points.emplace_back();
+      ge_p1p1_to_p2(&points.back(), &point4);
+      pointIndexes.push_back(i);
+    }
+
+    if (points.empty()) {
+      return;
+    }
+
+    std::vector<public_key> results(points.size());
+    std::unique_ptr<fe[]> products(new fe[points.size()]);
+    ge_tobytes_batch(&results[0], points.data(), points.size(), products.get());
+    for (size_t i = 0; i < points.size(); ++i) {
+      bases[pointIndexes[i]] = results[i];
+    }
+  }
+
   struct s_comm {
     hash h;
     ec_point key;
@@ -159,7 +239,6 @@ namespace crypto {
   };
 
   void crypto_ops::generate_signature(const hash &prefix_hash, const public_key &pub, const secret_key &sec, signature &sig) {
-    lock_guard<mutex> lock(random_lock);
     ge_p3 tmp3;
     ec_scalar k;
     s_comm buf;
@@ -241,7 +320,6 @@ namespace crypto {
     const public_key *const *pubs, size_t pubs_count,
     const secret_key &sec, size_t sec_index,
     signature *sig) {
-    lock_guard<mutex> lock(random_lock);
     size_t i;
     ge_p3 image_unp;
     ge_dsmp image_pre;
@@ -318,8 +396,9 @@ namespace crypto {
     ge_dsm_precomp(image_pre, &image_unp);
     sc_0(&sum);
     buf->h = prefix_hash;
+    // points are hashed in the order a0, b0, a1, b1, ..., all of them are converted to bytes at once
+    std::vector<ge_p2> points(2 * pubs_count);
     for (i = 0; i < pubs_count; i++) {
-      ge_p2 tmp2;
       ge_p3 tmp3;
       if (sc_check(&sig[i].c) != 0 || sc_check(&sig[i].r) != 0) {
         return false;
@@ -327,13 +406,15 @@ namespace crypto {
       if (ge_frombytes_vartime(&tmp3, &*pubs[i]) != 0) {
         abort();
       }
-      ge_double_scalarmult_base_vartime(&tmp2, &sig[i].c, &tmp3, &sig[i].r);
-      ge_tobytes(&buf->ab[i].a, &tmp2);
+      ge_double_scalarmult_base_vartime(&points[2 * i], &sig[i].c, &tmp3, &sig[i].r);
       hash_to_ec(*pubs[i], tmp3);
-      ge_double_scalarmult_precomp_vartime(&tmp2, &sig[i].r, &tmp3, &sig[i].c, image_pre);
-      ge_tobytes(&buf->ab[i].b, &tmp2);
+      ge_double_scalarmult_precomp_vartime(&points[2 * i + 1], &sig[i].r, &tmp3, &sig[i].c, image_pre);
       sc_add(&sum, &sum, &sig[i].c);
     }
+    if (pubs_count != 0) {
+      std::unique_ptr<fe[]> products(new fe[points.size()]);
+      ge_tobytes_batch(&buf->ab[0].a, points.data(), points.size(), products.get());
+    }
     hash_to_scalar(buf, rs_comm_size(pubs_count), h);
     sc_sub(&h, &h, &sum);
     return sc_isnonzero(&h) == 0;
@@ -17,8 +17,6 @@ namespace crypto {
 #include "random.h"
   }
 
-  extern std::mutex random_lock;
-
 #pragma pack(push, 1)
   POD_CLASS ec_point {
     char data[32];
@@ -69,12 +67,18 @@ namespace crypto {
     friend bool secret_key_to_public_key(const secret_key &, public_key &);
     static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
+    static bool generate_key_derivations(const public_key &, const secret_key *, std::size_t, key_derivation *);
+    friend bool generate_key_derivations(const public_key &, const secret_key *, std::size_t, key_derivation *);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     static void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static bool underive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool underive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
+    static bool derive_public_keys(const key_derivation &, const std::size_t *, std::size_t, const public_key &, public_key *);
+    friend bool derive_public_keys(const key_derivation &, const std::size_t *, std::size_t, const public_key &, public_key *);
+    static void underive_public_keys(const key_derivation &, const std::size_t *, const public_key *, std::size_t, public_key *, bool *);
+    friend void underive_public_keys(const key_derivation &, const std::size_t *, const public_key *, std::size_t, public_key *, bool *);
     static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
     friend void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
     static bool check_signature(const hash &, const public_key &, const signature &);
@@ -96,7 +100,6 @@ namespace crypto {
   template<typename T>
   typename std::enable_if<std::is_pod<T>::value, T>::type rand() {
     typename std::remove_cv<T>::type res;
-    std::lock_guard<std::mutex> lock(random_lock);
     generate_random_bytes(sizeof(T), &res);
     return res;
   }
@@ -157,10 +160,23 @@ namespace crypto {
   inline bool generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
     return crypto_ops::generate_key_derivation(key1, key2, derivation);
   }
+  /* Same as generate_key_derivation for count secret keys and one public key, the public key is decompressed once and
+   * derivations are converted to bytes together.
+   */
+  inline bool generate_key_derivations(const public_key &key1, const secret_key *keys2, std::size_t count,
+    key_derivation *derivations) {
+    return crypto_ops::generate_key_derivations(key1, keys2, count, derivations);
+  }
   inline bool derive_public_key(const key_derivation &derivation, std::size_t output_index,
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
   }
+  /* Same as derive_public_key for count output indexes and one base, points are converted to bytes together.
+   */
+  inline bool derive_public_keys(const key_derivation &derivation, const std::size_t *output_indexes, std::size_t count,
+    const public_key &base, public_key *derived_keys) {
+    return crypto_ops::derive_public_keys(derivation, output_indexes, count, base, derived_keys);
+  }
   inline void derive_secret_key(const key_derivation &derivation, std::size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     crypto_ops::derive_secret_key(derivation, output_index, base, derived_key);
@@ -173,6 +189,14 @@ namespace crypto {
     return crypto_ops::underive_public_key(derivation, output_index, derived_key, base);
   }
 
+  /* Same as underive_public_key for count keys of one transaction, points are converted to bytes together,
+   * which is cheaper than one by one. valid[i] is false if derived_keys[i] is not a point, bases[i] is left unchanged then.
+   */
+  inline void underive_public_keys(const key_derivation &derivation, const std::size_t *output_indexes,
+    const public_key *derived_keys, std::size_t count, public_key *bases, bool *valid) {
+    crypto_ops::underive_public_keys(derivation, output_indexes, derived_keys, count, bases, valid);
+  }
+
   /* Generation and checking of a standard signature.
    */
   inline void generate_signature(const hash &prefix_hash, const public_key &pub, const secret_key &sec, signature &sig) {
@@ -47,8 +47,11 @@ enum {
 };
 
 void cn_fast_hash(const void *data, size_t length, char *hash);
+// Same as four cn_fast_hash calls, hashes are computed together; hash[i] may point into any of the inputs
+void cn_fast_hash_x4(const void *const data[4], const size_t length[4], char *const hash[4]);
 
 void cn_slow_hash_f(void *, const void *, size_t, void *);
+void cn_slow_hash_multi_f(void *const *contexts, const void *const *data, const size_t *length, void *const *hash, size_t count);
 
 void hash_extra_blake(const void *data, size_t length, char *hash);
 void hash_extra_groestl(const void *data, size_t length, char *hash);
@@ -35,3 +35,7 @@ void cn_fast_hash(const void *data, size_t length, char *hash) {
   hash_process(&state, data, length);
   memcpy(hash, &state, HASH_SIZE);
 }
+
+void cn_fast_hash_x4(const void *const data[4], const size_t length[4], char *const hash[4]) {
+  keccak_x4((const uint8_t *const *) data, length, (uint8_t *const *) hash, HASH_SIZE);
+}
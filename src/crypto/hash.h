@@ -43,16 +43,40 @@ namespace crypto {
     void operator=(const cn_context &) = delete;
 #endif
 
+    // Scratchpad is allocated in large pages when the system has them available, otherwise in regular pages
+    bool uses_large_pages() const {
+      return large_pages;
+    }
+
   private:
 
     void *data;
+    bool large_pages;
     friend inline void cn_slow_hash(cn_context &, const void *, std::size_t, hash &);
+    friend inline void cn_slow_hash_multi(cn_context *const *, const void *const *, const std::size_t *, hash *, std::size_t);
   };
 
   inline void cn_slow_hash(cn_context &context, const void *data, std::size_t length, hash &hash) {
     (*cn_slow_hash_f)(context.data, data, length, reinterpret_cast<void *>(&hash));
   }
 
+  enum {
+    CN_SLOW_HASH_MAX_LANES = 4
+  };
+
+  // Computes count independent hashes, each with own context. Counts of 2 and 4 are interleaved on CPUs with AES-NI,
+  // so memory latency of one hash is hidden by the others, other counts are computed one by one.
+  inline void cn_slow_hash_multi(cn_context *const *contexts, const void *const *data, const std::size_t *lengths, hash *hashes, std::size_t count) {
+    void *contextData[CN_SLOW_HASH_MAX_LANES];
+    void *hashData[CN_SLOW_HASH_MAX_LANES];
+    for (std::size_t i = 0; i < count; ++i) {
+      contextData[i] = contexts[i]->data;
+      hashData[i] = &hashes[i];
+    }
+
+    cn_slow_hash_multi_f(contextData, data, lengths, hashData, count);
+  }
+
   inline void tree_hash(const hash *hashes, std::size_t count, hash &root_hash) {
     tree_hash(reinterpret_cast<const char (*)[HASH_SIZE]>(hashes), count, reinterpret_cast<char *>(&root_hash));
   }
@@ -3,6 +3,7 @@
 // A baseline Keccak (3rd round) implementation.
 
 #include "hash-ops.h"
+#include "initializer.h"
 #include "keccak.h"
 
 const uint64_t keccakf_rndc[24] = 
@@ -17,57 +18,159 @@ const uint64_t keccakf_rndc[24] =
     0x8000000000008080, 0x0000000080000001, 0x8000000080008008
 };
 
-const int keccakf_rotc[24] = 
-{
-    1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14, 
-    27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44
-};
+// One round shared by the scalar and the 4-lane permutation, theta, rho, pi and chi are unrolled.
+// XOR, ROL and ANDNOT(a, b) = ~a & b are the lane operations.
 
-const int keccakf_piln[24] = 
-{
-    10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4, 
-    15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1 
-};
+#define KECCAK_ROUND(st, round) \
+  do { \
+    c0 = XOR(XOR(XOR(st[0], st[5]), XOR(st[10], st[15])), st[20]); \
+    c1 = XOR(XOR(XOR(st[1], st[6]), XOR(st[11], st[16])), st[21]); \
+    c2 = XOR(XOR(XOR(st[2], st[7]), XOR(st[12], st[17])), st[22]); \
+    c3 = XOR(XOR(XOR(st[3], st[8]), XOR(st[13], st[18])), st[23]); \
+    c4 = XOR(XOR(XOR(st[4], st[9]), XOR(st[14], st[19])), st[24]); \
+    d0 = XOR(c4, ROL(c1, 1)); \
+    d1 = XOR(c0, ROL(c2, 1)); \
+    d2 = XOR(c1, ROL(c3, 1)); \
+    d3 = XOR(c2, ROL(c4, 1)); \
+    d4 = XOR(c3, ROL(c0, 1)); \
+    b00 = XOR(st[0], d0); \
+    b01 = ROL(XOR(st[6], d1), 44); \
+    b02 = ROL(XOR(st[12], d2), 43); \
+    b03 = ROL(XOR(st[18], d3), 21); \
+    b04 = ROL(XOR(st[24], d4), 14); \
+    b05 = ROL(XOR(st[3], d3), 28); \
+    b06 = ROL(XOR(st[9], d4), 20); \
+    b07 = ROL(XOR(st[10], d0), 3); \
+    b08 = ROL(XOR(st[16], d1), 45); \
+    b09 = ROL(XOR(st[22], d2), 61); \
+    b10 = ROL(XOR(st[1], d1), 1); \
+    b11 = ROL(XOR(st[7], d2), 6); \
+    b12 = ROL(XOR(st[13], d3), 25); \
+    b13 = ROL(XOR(st[19], d4), 8); \
+    b14 = ROL(XOR(st[20], d0), 18); \
+    b15 = ROL(XOR(st[4], d4), 27); \
+    b16 = ROL(XOR(st[5], d0), 36); \
+    b17 = ROL(XOR(st[11], d1), 10); \
+    b18 = ROL(XOR(st[17], d2), 15); \
+    b19 = ROL(XOR(st[23], d3), 56); \
+    b20 = ROL(XOR(st[2], d2), 62); \
+    b21 = ROL(XOR(st[8], d3), 55); \
+    b22 = ROL(XOR(st[14], d4), 39); \
+    b23 = ROL(XOR(st[15], d0), 41); \
+    b24 = ROL(XOR(st[21], d1), 2); \
+    st[0] = XOR(b00, ANDNOT(b01, b02)); \
+    st[1] = XOR(b01, ANDNOT(b02, b03)); \
+    st[2] = XOR(b02, ANDNOT(b03, b04)); \
+    st[3] = XOR(b03, ANDNOT(b04, b00)); \
+    st[4] = XOR(b04, ANDNOT(b00, b01)); \
+    st[5] = XOR(b05, ANDNOT(b06, b07)); \
+    st[6] = XOR(b06, ANDNOT(b07, b08)); \
+    st[7] = XOR(b07, ANDNOT(b08, b09)); \
+    st[8] = XOR(b08, ANDNOT(b09, b05)); \
+    st[9] = XOR(b09, ANDNOT(b05, b06)); \
+    st[10] = XOR(b10, ANDNOT(b11, b12)); \
+    st[11] = XOR(b11, ANDNOT(b12, b13)); \
+    st[12] = XOR(b12, ANDNOT(b13, b14)); \
+    st[13] = XOR(b13, ANDNOT(b14, b10)); \
+    st[14] = XOR(b14, ANDNOT(b10, b11)); \
+    st[15] = XOR(b15, ANDNOT(b16, b17)); \
+    st[16] = XOR(b16, ANDNOT(b17, b18)); \
+    st[17] = XOR(b17, ANDNOT(b18, b19)); \
+    st[18] = XOR(b18, ANDNOT(b19, b15)); \
+    st[19] = XOR(b19, ANDNOT(b15, b16)); \
+    st[20] = XOR(b20, ANDNOT(b21, b22)); \
+    st[21] = XOR(b21, ANDNOT(b22, b23)); \
+    st[22] = XOR(b22, ANDNOT(b23, b24)); \
+    st[23] = XOR(b23, ANDNOT(b24, b20)); \
+    st[24] = XOR(b24, ANDNOT(b20, b21)); \
+    st[0] = XOR(st[0], RC(round)); \
+  } while (0)
 
 // update the state with given number of rounds
 
 void keccakf(uint64_t st[25], int rounds)
 {
-    int i, j, round;
-    uint64_t t, bc[5];
+    int round;
+    uint64_t c0, c1, c2, c3, c4, d0, d1, d2, d3, d4;
+    uint64_t b00, b01, b02, b03, b04, b05, b06, b07, b08, b09, b10, b11, b12;
+    uint64_t b13, b14, b15, b16, b17, b18, b19, b20, b21, b22, b23, b24;
 
+#define XOR(a, b) ((a) ^ (b))
+#define ROL(a, n) ROTL64(a, n)
+#define ANDNOT(a, b) (~(a) & (b))
+#define RC(round) keccakf_rndc[round]
     for (round = 0; round < rounds; round++) {
+        KECCAK_ROUND(st, round);
+    }
+#undef XOR
+#undef ROL
+#undef ANDNOT
+#undef RC
+}
 
-        // Theta
-        for (i = 0; i < 5; i++)     
-            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+static void keccakf_x4_portable(uint64_t st[25][4], int rounds)
+{
+    uint64_t lane[25];
+    int i, l;
 
-        for (i = 0; i < 5; i++) {
-            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
-            for (j = 0; j < 25; j += 5)
-                st[j + i] ^= t;
-        }
+    for (l = 0; l < 4; l++) {
+        for (i = 0; i < 25; i++)
+            lane[i] = st[i][l];
+        keccakf(lane, rounds);
+        for (i = 0; i < 25; i++)
+            st[i][l] = lane[i];
+    }
+}
 
-        // Rho Pi
-        t = st[1];
-        for (i = 0; i < 24; i++) {
-            j = keccakf_piln[i];
-            bc[0] = st[j];
-            st[j] = ROTL64(t, keccakf_rotc[i]);
-            t = bc[0];
-        }
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
 
-        //  Chi
-        for (j = 0; j < 25; j += 5) {
-            for (i = 0; i < 5; i++)
-                bc[i] = st[j + i];
-            for (i = 0; i < 5; i++)
-                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
-        }
+#define KECCAK_HAS_AVX2
+
+__attribute__((target("avx2")))
+static void keccakf_x4_avx2(uint64_t st4[25][4], int rounds)
+{
+    int i, round;
+    __m256i st[25];
+    __m256i c0, c1, c2, c3, c4, d0, d1, d2, d3, d4;
+    __m256i b00, b01, b02, b03, b04, b05, b06, b07, b08, b09, b10, b11, b12;
+    __m256i b13, b14, b15, b16, b17, b18, b19, b20, b21, b22, b23, b24;
+
+    for (i = 0; i < 25; i++)
+        st[i] = _mm256_loadu_si256((const __m256i *) st4[i]);
 
-        //  Iota
-        st[0] ^= keccakf_rndc[round];
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define ROL(a, n) _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+#define ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define RC(round) _mm256_set1_epi64x((long long) keccakf_rndc[round])
+    for (round = 0; round < rounds; round++) {
+        KECCAK_ROUND(st, round);
     }
+#undef XOR
+#undef ROL
+#undef ANDNOT
+#undef RC
+
+    for (i = 0; i < 25; i++)
+        _mm256_storeu_si256((__m256i *) st4[i], st[i]);
+}
+#endif
+
+// states are lane-minor, so that word i of all lanes is one AVX2 register
+static void (*keccakf_x4_fp)(uint64_t st[25][4], int rounds) = &keccakf_x4_portable;
+
+#ifdef KECCAK_HAS_AVX2
+INITIALIZER(detect_avx2) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    keccakf_x4_fp = &keccakf_x4_avx2;
+  }
+}
+#endif
+
+void keccakf_x4(uint64_t st[25][4], int rounds)
+{
+    keccakf_x4_fp(st, rounds);
 }
 
 // compute a keccak hash (md) of given byte length from "in"
@@ -110,3 +213,54 @@ void keccak1600(const uint8_t *in, int inlen, uint8_t *md)
 {
     keccak(in, inlen, md, sizeof(state_t));
 }
+
+// four hashes of independent inputs, a lane whose input ends earlier takes its result after its last block;
+// results are written when all inputs are read, so they may overwrite inputs
+void keccak_x4(const uint8_t *const in[4], const size_t inlen[4], uint8_t *const md[4], int mdlen)
+{
+    uint64_t st[25][4];
+    state_t out[4];
+    uint8_t temp[144];
+    size_t blocks[4], maxBlocks = 0, block;
+    int i, l, rsiz, rsizw;
+
+    rsiz = sizeof(state_t) == mdlen ? HASH_DATA_AREA : 200 - 2 * mdlen;
+    rsizw = rsiz / 8;
+
+    memset(st, 0, sizeof(st));
+    for (l = 0; l < 4; l++) {
+        blocks[l] = inlen[l] / rsiz + 1;
+        if (blocks[l] > maxBlocks)
+            maxBlocks = blocks[l];
+    }
+
+    for (block = 0; block < maxBlocks; block++) {
+        for (l = 0; l < 4; l++) {
+            const uint8_t *data = in[l] + block * rsiz;
+            if (block + 1 < blocks[l]) {
+                for (i = 0; i < rsizw; i++)
+                    st[i][l] ^= ((const uint64_t *) data)[i];
+            } else if (block + 1 == blocks[l]) {
+                size_t tail = inlen[l] - block * rsiz;
+                memcpy(temp, data, tail);
+                temp[tail++] = 1;
+                memset(temp + tail, 0, rsiz - tail);
+                temp[rsiz - 1] |= 0x80;
+                for (i = 0; i < rsizw; i++)
+                    st[i][l] ^= ((uint64_t *) temp)[i];
+            }
+        }
+
+        keccakf_x4(st, KECCAK_ROUNDS);
+
+        for (l = 0; l < 4; l++) {
+            if (block + 1 == blocks[l]) {
+                for (i = 0; i < 25; i++)
+                    out[l][i] = st[i][l];
+            }
+        }
+    }
+
+    for (l = 0; l < 4; l++)
+        memcpy(md[l], out[l], mdlen);
+}
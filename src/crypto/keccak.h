@@ -4,6 +4,7 @@
 #ifndef KECCAK_H
 #define KECCAK_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -23,4 +24,10 @@ void keccakf(uint64_t st[25], int norounds);
 
 void keccak1600(const uint8_t *in, int inlen, uint8_t *md);
 
+// update four states at once, word i of lane l is st[i][l]; uses AVX2 when the CPU has it
+void keccakf_x4(uint64_t st[25][4], int norounds);
+
+// compute keccak hashes of four inputs of any lengths at once, md[l] may be one of the inputs
+void keccak_x4(const uint8_t *const in[4], const size_t inlen[4], uint8_t *const md[4], int mdlen);
+
 #endif
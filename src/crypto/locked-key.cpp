@@ -0,0 +1,105 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "locked-key.h"
+
+#include <new>
+
+#if defined(WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace crypto {
+
+  namespace {
+
+#if defined(WIN32)
+
+    size_t page_size() {
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+      return info.dwPageSize;
+    }
+
+    void *allocate_page() {
+      return VirtualAlloc(nullptr, page_size(), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    bool lock_page(void *page) {
+      return VirtualLock(page, page_size()) != 0;
+    }
+
+    void release_page(void *page, bool locked) {
+      if (locked) {
+        VirtualUnlock(page, page_size());
+      }
+
+      VirtualFree(page, 0, MEM_RELEASE);
+    }
+
+#else
+
+    size_t page_size() {
+      return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    void *allocate_page() {
+#if defined(__APPLE__)
+      void *page = mmap(nullptr, page_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+#else
+      void *page = mmap(nullptr, page_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+      return page != MAP_FAILED ? page : nullptr;
+    }
+
+    bool lock_page(void *page) {
+#if defined(MADV_DONTDUMP)
+      // nor into core dumps
+      madvise(page, page_size(), MADV_DONTDUMP);
+#endif
+      return mlock(page, page_size()) == 0;
+    }
+
+    void release_page(void *page, bool locked) {
+      if (locked) {
+        munlock(page, page_size());
+      }
+
+      munmap(page, page_size());
+    }
+
+#endif
+
+  }
+
+  locked_chacha8_key::locked_chacha8_key() : page(allocate_page()), locked(false) {
+    if (page == nullptr) {
+      throw std::bad_alloc();
+    }
+
+    locked = lock_page(page);
+    key = new (page) chacha8_key();
+  }
+
+  locked_chacha8_key::~locked_chacha8_key() {
+    key->~chacha8_key();
+    release_page(page, locked);
+  }
+}
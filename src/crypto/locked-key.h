@@ -0,0 +1,43 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "chacha8.h"
+
+namespace crypto {
+
+  // Chacha8 key held in its own page locked in memory, so it isn't written to swap, and wiped on destruction. Where
+  // the page can't be locked the key is kept in it all the same. Owners keep a key derived from a password for as
+  // long as they need it instead of deriving it with the slow hash again.
+  class locked_chacha8_key {
+  public:
+    locked_chacha8_key();
+    ~locked_chacha8_key();
+    locked_chacha8_key(const locked_chacha8_key&) = delete;
+    locked_chacha8_key& operator=(const locked_chacha8_key&) = delete;
+
+    chacha8_key& get() { return *key; }
+    const chacha8_key& get() const { return *key; }
+    bool is_locked() const { return locked; }
+
+  private:
+    void *page;
+    chacha8_key *key;
+    bool locked;
+  };
+}
@@ -17,10 +17,10 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "hash-ops.h"
-#include "initializer.h"
 #include "random.h"
 
 static void generate_system_random_bytes(size_t n, void *result);
@@ -77,54 +77,45 @@ static void generate_system_random_bytes(size_t n, void *result) {
 
 #endif
 
-static union hash_state state;
-
-#if !defined(NDEBUG)
-static volatile int curstate; /* To catch thread safety problems. */
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
 #endif
 
-FINALIZER(deinit_random) {
-#if !defined(NDEBUG)
-  assert(curstate == 1);
-  curstate = 0;
-#endif
-  memset(&state, 0, sizeof(union hash_state));
-}
+/* Permutations between reseeds, about 2 MB of output. */
+#define RESEED_INTERVAL 16384
 
-INITIALIZER(init_random) {
-  generate_system_random_bytes(32, &state);
-  REGISTER_FINALIZER(deinit_random);
-#if !defined(NDEBUG)
-  assert(curstate == 0);
-  curstate = 1;
-#endif
+/* Every thread keeps its own generator, so concurrent callers need no lock. The state is seeded from the system on
+ * the first call in a thread, and fresh system bytes are mixed into it periodically, so a state that leaked once does
+ * not predict all later output. */
+static THREAD_LOCAL union hash_state state;
+static THREAD_LOCAL size_t permutations_left;
+
+static void reseed(void) {
+  uint8_t seed[32];
+  size_t i;
+  generate_system_random_bytes(sizeof(seed), seed);
+  for (i = 0; i < sizeof(seed); ++i) {
+    state.b[i] ^= seed[i];
+  }
+  memset(seed, 0, sizeof(seed));
+  permutations_left = RESEED_INTERVAL;
 }
 
 void generate_random_bytes(size_t n, void *result) {
-#if !defined(NDEBUG)
-  assert(curstate == 1);
-  curstate = 2;
-#endif
-  if (n == 0) {
-#if !defined(NDEBUG)
-    assert(curstate == 2);
-    curstate = 1;
-#endif
-    return;
-  }
-  for (;;) {
+  while (n > 0) {
+    if (permutations_left == 0) {
+      reseed();
+    }
+    --permutations_left;
     hash_permutation(&state);
     if (n <= HASH_DATA_AREA) {
       memcpy(result, &state, n);
-#if !defined(NDEBUG)
-      assert(curstate == 2);
-      curstate = 1;
-#endif
       return;
-    } else {
-      memcpy(result, &state, HASH_DATA_AREA);
-      result = padd(result, HASH_DATA_AREA);
-      n -= HASH_DATA_AREA;
     }
+    memcpy(result, &state, HASH_DATA_AREA);
+    result = padd(result, HASH_DATA_AREA);
+    n -= HASH_DATA_AREA;
   }
 }
@@ -0,0 +1,171 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+// Computes CN_LANES hashes at once. Every lane is the same computation as cn_slow_hash_aesni with own context,
+// memory bound main loop is interleaved between lanes so that scratchpad accesses of one lane overlap the others.
+
+#define CN_MULTI_NAME_(lanes) cn_slow_hash_aesni_x ## lanes
+#define CN_MULTI_NAME(lanes) CN_MULTI_NAME_(lanes)
+
+static void CN_MULTI_NAME(CN_LANES)(void *const *contexts, const void *const *data, const size_t *length, void *const *hash)
+{
+  struct cn_ctx *ctxs[CN_LANES];
+  ALIGNED_DECL(uint8_t ExpandedKey[CN_LANES][256], 16);
+  ALIGNED_DECL(uint64_t a[CN_LANES][2], 16);
+  __m128i b_x[CN_LANES];
+  size_t i, l;
+
+  for (l = 0; l < CN_LANES; l++)
+  {
+    __m128i *longoutput, *expkey, *xmminput;
+    ctxs[l] = (struct cn_ctx *) contexts[l];
+    hash_process(&ctxs[l]->state.hs, (const uint8_t*) data[l], length[l]);
+    memcpy(ctxs[l]->text, ctxs[l]->state.init, INIT_SIZE_BYTE);
+    memcpy(ExpandedKey[l], ctxs[l]->state.hs.b, AES_KEY_SIZE);
+    ExpandAESKey256(ExpandedKey[l]);
+
+    longoutput = (__m128i *) ctxs[l]->long_state;
+    expkey = (__m128i *) ExpandedKey[l];
+    xmminput = (__m128i *) ctxs[l]->text;
+
+    for (i = 0; likely(i < MEMORY); i += INIT_SIZE_BYTE)
+    {
+      for(size_t j = 0; j < 10; j++)
+      {
+        xmminput[0] = _mm_aesenc_si128(xmminput[0], expkey[j]);
+        xmminput[1] = _mm_aesenc_si128(xmminput[1], expkey[j]);
+        xmminput[2] = _mm_aesenc_si128(xmminput[2], expkey[j]);
+        xmminput[3] = _mm_aesenc_si128(xmminput[3], expkey[j]);
+        xmminput[4] = _mm_aesenc_si128(xmminput[4], expkey[j]);
+        xmminput[5] = _mm_aesenc_si128(xmminput[5], expkey[j]);
+        xmminput[6] = _mm_aesenc_si128(xmminput[6], expkey[j]);
+        xmminput[7] = _mm_aesenc_si128(xmminput[7], expkey[j]);
+      }
+
+      _mm_store_si128(&(longoutput[(i >> 4)]), xmminput[0]);
+      _mm_store_si128(&(longoutput[(i >> 4) + 1]), xmminput[1]);
+      _mm_store_si128(&(longoutput[(i >> 4) + 2]), xmminput[2]);
+      _mm_store_si128(&(longoutput[(i >> 4) + 3]), xmminput[3]);
+      _mm_store_si128(&(longoutput[(i >> 4) + 4]), xmminput[4]);
+      _mm_store_si128(&(longoutput[(i >> 4) + 5]), xmminput[5]);
+      _mm_store_si128(&(longoutput[(i >> 4) + 6]), xmminput[6]);
+      _mm_store_si128(&(longoutput[(i >> 4) + 7]), xmminput[7]);
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+      ctxs[l]->a[i] = ((uint64_t *)ctxs[l]->state.k)[i] ^  ((uint64_t *)ctxs[l]->state.k)[i+4];
+      ctxs[l]->b[i] = ((uint64_t *)ctxs[l]->state.k)[i+2] ^  ((uint64_t *)ctxs[l]->state.k)[i+6];
+    }
+
+    b_x[l] = _mm_load_si128((__m128i *)ctxs[l]->b);
+    a[l][0] = ctxs[l]->a[0];
+    a[l][1] = ctxs[l]->a[1];
+  }
+
+  for(i = 0; likely(i < 0x80000); i++)
+  {
+    for (l = 0; l < CN_LANES; l++)
+    {
+      uint8_t *long_state = ctxs[l]->long_state;
+      __m128i c_x = _mm_load_si128((__m128i *)&long_state[a[l][0] & 0x1FFFF0]);
+      __m128i a_x = _mm_load_si128((__m128i *)a[l]);
+      ALIGNED_DECL(uint64_t c[2], 16);
+      ALIGNED_DECL(uint64_t b[2], 16);
+      uint64_t *nextblock, *dst;
+
+      c_x = _mm_aesenc_si128(c_x, a_x);
+      _mm_store_si128((__m128i *)c, c_x);
+
+      b_x[l] = _mm_xor_si128(b_x[l], c_x);
+      _mm_store_si128((__m128i *)&long_state[a[l][0] & 0x1FFFF0], b_x[l]);
+
+      nextblock = (uint64_t *)&long_state[c[0] & 0x1FFFF0];
+      b[0] = nextblock[0];
+      b[1] = nextblock[1];
+
+      {
+        uint64_t hi, lo;
+        // hi,lo = 64bit x 64bit multiply of c[0] and b[0]
+
+#if defined(__GNUC__) && defined(__x86_64__)
+        __asm__("mulq %3\n\t"
+          : "=d" (hi),
+          "=a" (lo)
+          : "%a" (c[0]),
+          "rm" (b[0])
+          : "cc" );
+#else
+        lo = mul128(c[0], b[0], &hi);
+#endif
+
+        a[l][0] += hi;
+        a[l][1] += lo;
+      }
+      dst = (uint64_t *) &long_state[c[0] & 0x1FFFF0];
+      dst[0] = a[l][0];
+      dst[1] = a[l][1];
+
+      a[l][0] ^= b[0];
+      a[l][1] ^= b[1];
+      b_x[l] = c_x;
+    }
+  }
+
+  for (l = 0; l < CN_LANES; l++)
+  {
+    __m128i *longoutput, *expkey, *xmminput;
+    memcpy(ctxs[l]->text, ctxs[l]->state.init, INIT_SIZE_BYTE);
+    memcpy(ExpandedKey[l], &ctxs[l]->state.hs.b[32], AES_KEY_SIZE);
+    ExpandAESKey256(ExpandedKey[l]);
+
+    longoutput = (__m128i *) ctxs[l]->long_state;
+    expkey = (__m128i *) ExpandedKey[l];
+    xmminput = (__m128i *) ctxs[l]->text;
+
+    for (i = 0; likely(i < MEMORY); i += INIT_SIZE_BYTE)
+    {
+      xmminput[0] = _mm_xor_si128(longoutput[(i >> 4)], xmminput[0]);
+      xmminput[1] = _mm_xor_si128(longoutput[(i >> 4) + 1], xmminput[1]);
+      xmminput[2] = _mm_xor_si128(longoutput[(i >> 4) + 2], xmminput[2]);
+      xmminput[3] = _mm_xor_si128(longoutput[(i >> 4) + 3], xmminput[3]);
+      xmminput[4] = _mm_xor_si128(longoutput[(i >> 4) + 4], xmminput[4]);
+      xmminput[5] = _mm_xor_si128(longoutput[(i >> 4) + 5], xmminput[5]);
+      xmminput[6] = _mm_xor_si128(longoutput[(i >> 4) + 6], xmminput[6]);
+      xmminput[7] = _mm_xor_si128(longoutput[(i >> 4) + 7], xmminput[7]);
+
+      for(size_t j = 0; j < 10; j++)
+      {
+        xmminput[0] = _mm_aesenc_si128(xmminput[0], expkey[j]);
+        xmminput[1] = _mm_aesenc_si128(xmminput[1], expkey[j]);
+        xmminput[2] = _mm_aesenc_si128(xmminput[2], expkey[j]);
+        xmminput[3] = _mm_aesenc_si128(xmminput[3], expkey[j]);
+        xmminput[4] = _mm_aesenc_si128(xmminput[4], expkey[j]);
+        xmminput[5] = _mm_aesenc_si128(xmminput[5], expkey[j]);
+        xmminput[6] = _mm_aesenc_si128(xmminput[6], expkey[j]);
+        xmminput[7] = _mm_aesenc_si128(xmminput[7], expkey[j]);
+      }
+    }
+
+    memcpy(ctxs[l]->state.init, ctxs[l]->text, INIT_SIZE_BYTE);
+    hash_permutation(&ctxs[l]->state.hs);
+    extra_hashes[ctxs[l]->state.hs.b[0] & 3](&ctxs[l]->state, 200, hash[l]);
+  }
+}
+
+#undef CN_MULTI_NAME
+#undef CN_MULTI_NAME_
@@ -179,6 +179,28 @@ static void (*const extra_hashes[4])(const void *, size_t, char *) =
 #define AESNI
 #include "slow-hash.inl"
 
+#define CN_LANES 2
+#include "slow-hash-multi.inl"
+#undef CN_LANES
+#define CN_LANES 4
+#include "slow-hash-multi.inl"
+#undef CN_LANES
+
+static int cn_slow_hash_has_aesni;
+
+void cn_slow_hash_multi_f(void *const *contexts, const void *const *data, const size_t *length, void *const *hash, size_t count) {
+  size_t i;
+  if (cn_slow_hash_has_aesni && count == 2) {
+    cn_slow_hash_aesni_x2(contexts, data, length, hash);
+  } else if (cn_slow_hash_has_aesni && count == 4) {
+    cn_slow_hash_aesni_x4(contexts, data, length, hash);
+  } else {
+    for (i = 0; i < count; i++) {
+      (*cn_slow_hash_fp)(contexts[i], data[i], length[i], hash[i]);
+    }
+  }
+}
+
 INITIALIZER(detect_aes) {
   int ecx;
 #if defined(_MSC_VER)
@@ -189,5 +211,6 @@ INITIALIZER(detect_aes) {
   int a, b, d;
   __cpuid(1, a, b, ecx, d);
 #endif
-  cn_slow_hash_fp = (ecx & (1 << 25)) ? &cn_slow_hash_aesni : &cn_slow_hash_noaesni;
+  cn_slow_hash_has_aesni = (ecx & (1 << 25)) != 0;
+  cn_slow_hash_fp = cn_slow_hash_has_aesni ? &cn_slow_hash_aesni : &cn_slow_hash_noaesni;
 }
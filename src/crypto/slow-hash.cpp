@@ -1,3 +1,5 @@
+#include <cstdint>
+#include <cstring>
 #include <new>
 
 #include "hash.h"
@@ -6,6 +8,10 @@
 #include <Windows.h>
 #else
 #include <sys/mman.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #endif
 
 using std::bad_alloc;
@@ -13,19 +19,70 @@ using std::bad_alloc;
 namespace crypto {
 
   enum {
-    MAP_SIZE = SLOW_HASH_CONTEXT_SIZE + ((-SLOW_HASH_CONTEXT_SIZE) & 0xfff)
+    MAP_SIZE = SLOW_HASH_CONTEXT_SIZE + ((-SLOW_HASH_CONTEXT_SIZE) & 0xfff),
+    // Context is the 2 MB scratchpad followed by a few hundred bytes of state. The scratchpad takes exactly one
+    // large page and the state is kept in a regular page right after it instead of allocating a second large page.
+    LARGE_PAGE_SIZE = 2 * 1024 * 1024,
+    TAIL_SIZE = MAP_SIZE - LARGE_PAGE_SIZE
   };
 
+  static_assert(TAIL_SIZE == 0x1000, "Slow hash context doesn't fit one large page and one regular page");
+
 #if defined(WIN32)
 
+  namespace {
+
+    // Large pages require SeLockMemoryPrivilege, allocation just fails without it. Address range is reserved
+    // first to find a place where the large page and the tail fit next to each other.
+    void *allocate_large_pages() {
+      if (GetLargePageMinimum() != LARGE_PAGE_SIZE) {
+        return nullptr;
+      }
+
+      for (int attempt = 0; attempt < 4; ++attempt) {
+        char *range = static_cast<char *>(VirtualAlloc(nullptr, 2 * LARGE_PAGE_SIZE, MEM_RESERVE, PAGE_NOACCESS));
+        if (range == nullptr) {
+          return nullptr;
+        }
+
+        char *page = reinterpret_cast<char *>((reinterpret_cast<ULONG_PTR>(range) + LARGE_PAGE_SIZE - 1) & ~static_cast<ULONG_PTR>(LARGE_PAGE_SIZE - 1));
+        VirtualFree(range, 0, MEM_RELEASE);
+        void *data = VirtualAlloc(page, LARGE_PAGE_SIZE, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (data == nullptr) {
+          // either no privilege or no free large pages, retrying won't help
+          return nullptr;
+        }
+
+        if (VirtualAlloc(page + LARGE_PAGE_SIZE, TAIL_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE) != nullptr) {
+          return data;
+        }
+
+        // another thread took the address after the page meanwhile
+        VirtualFree(data, 0, MEM_RELEASE);
+      }
+
+      return nullptr;
+    }
+
+  }
+
   cn_context::cn_context() {
-    data = VirtualAlloc(nullptr, MAP_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    data = allocate_large_pages();
+    large_pages = data != nullptr;
+    if (data == nullptr) {
+      data = VirtualAlloc(nullptr, MAP_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    }
+
     if (data == nullptr) {
       throw bad_alloc();
     }
   }
 
   cn_context::~cn_context() {
+    if (large_pages && !VirtualFree(static_cast<char *>(data) + LARGE_PAGE_SIZE, 0, MEM_RELEASE)) {
+      throw bad_alloc();
+    }
+
     if (!VirtualFree(data, 0, MEM_RELEASE)) {
       throw bad_alloc();
     }
@@ -33,20 +90,92 @@ namespace crypto {
 
 #else
 
-  cn_context::cn_context() {
-#if !defined(__APPLE__)
-    data = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  namespace {
+
+    int anonymous_flags() {
+#if defined(__APPLE__)
+      return MAP_PRIVATE | MAP_ANON;
+#else
+      return MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+    }
+
+    // Maps the scratchpad into one 2 MB huge page and the tail into a regular page after it. Huge page mappings
+    // must be aligned, so an address range of two huge pages is reserved first and trimmed afterwards.
+    void *map_large_pages() {
+#if defined(MAP_HUGETLB)
+      int hugeFlags = anonymous_flags() | MAP_HUGETLB | MAP_FIXED;
+#if defined(MAP_HUGE_2MB)
+      // without it the default huge page size is used, which may be 1 GB
+      hugeFlags |= MAP_HUGE_2MB;
+#endif
+
+      char *range = static_cast<char *>(mmap(nullptr, 2 * LARGE_PAGE_SIZE, PROT_NONE, anonymous_flags() | MAP_NORESERVE, -1, 0));
+      if (range == MAP_FAILED) {
+        return MAP_FAILED;
+      }
+
+      char *page = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(range) + LARGE_PAGE_SIZE - 1) & ~static_cast<std::uintptr_t>(LARGE_PAGE_SIZE - 1));
+      if (mmap(page, LARGE_PAGE_SIZE, PROT_READ | PROT_WRITE, hugeFlags, -1, 0) == MAP_FAILED ||
+        mmap(page + LARGE_PAGE_SIZE, TAIL_SIZE, PROT_READ | PROT_WRITE, anonymous_flags() | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        munmap(range, 2 * LARGE_PAGE_SIZE);
+        return MAP_FAILED;
+      }
+
+      if (page != range) {
+        munmap(range, page - range);
+      }
+
+      char *rangeEnd = range + 2 * LARGE_PAGE_SIZE;
+      char *tailEnd = page + MAP_SIZE;
+      if (tailEnd != rangeEnd) {
+        munmap(tailEnd, rangeEnd - tailEnd);
+      }
+
+      return page;
 #else
-    data = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+      return MAP_FAILED;
+#endif
+    }
+
+    // Pages are not populated at mmap time, so first touch happens after the policy is set and from the thread
+    // which creates the context. Miner threads create own contexts, so their scratchpads are allocated on
+    // the NUMA node the thread runs on even when the process was started with interleaving policy.
+    void bind_to_local_node(void *data, std::size_t size) {
+#if defined(__linux__) && defined(SYS_mbind)
+      const int MPOL_LOCAL_POLICY = 4;
+      syscall(SYS_mbind, data, size, MPOL_LOCAL_POLICY, nullptr, 0, 0);
 #endif
+    }
+
+  }
+
+  cn_context::cn_context() {
+    large_pages = true;
+    data = map_large_pages();
+    if (data == MAP_FAILED) {
+      large_pages = false;
+      data = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, anonymous_flags(), -1, 0);
+    }
+
     if (data == MAP_FAILED) {
       throw bad_alloc();
     }
-    mlock(data, MAP_SIZE);
+
+    bind_to_local_node(data, MAP_SIZE);
+    if (mlock(data, MAP_SIZE) != 0) {
+      // mlock faults pages in itself, without it they are touched explicitly so hashing doesn't pay for page faults
+      std::memset(data, 0, MAP_SIZE);
+    }
   }
 
   cn_context::~cn_context() {
-    if (munmap(data, MAP_SIZE) != 0) {
+    // huge page area and the tail are separate mappings, unmap them one by one
+    if (large_pages && munmap(static_cast<char *>(data) + LARGE_PAGE_SIZE, TAIL_SIZE) != 0) {
+      throw bad_alloc();
+    }
+
+    if (munmap(data, large_pages ? LARGE_PAGE_SIZE : MAP_SIZE) != 0) {
       throw bad_alloc();
     }
   }
@@ -22,6 +22,21 @@
 
 #include "hash-ops.h"
 
+// out[j] = hash of the pair in[2 * j], in[2 * j + 1], four pairs at a time. out may be in, every batch
+// is written after it is read and later batches read above what was written.
+static void hash_pairs(const char (*in)[HASH_SIZE], size_t count, char (*out)[HASH_SIZE]) {
+  static const size_t lengths[4] = {2 * HASH_SIZE, 2 * HASH_SIZE, 2 * HASH_SIZE, 2 * HASH_SIZE};
+  size_t j = 0;
+  for (; j + 4 <= count; j += 4) {
+    const void *data[4] = {in[2 * j], in[2 * j + 2], in[2 * j + 4], in[2 * j + 6]};
+    char *hashes[4] = {out[j], out[j + 1], out[j + 2], out[j + 3]};
+    cn_fast_hash_x4(data, lengths, hashes);
+  }
+  for (; j < count; ++j) {
+    cn_fast_hash(in[2 * j], 2 * HASH_SIZE, out[j]);
+  }
+}
+
 void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
   assert(count > 0);
   if (count == 1) {
@@ -29,7 +44,7 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
   } else if (count == 2) {
     cn_fast_hash(hashes, 2 * HASH_SIZE, root_hash);
   } else {
-    size_t i, j;
+    size_t i;
     size_t cnt = count - 1;
     char (*ints)[HASH_SIZE];
     for (i = 1; i < sizeof(size_t); i <<= 1) {
@@ -38,15 +53,10 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
     cnt &= ~(cnt >> 1);
     ints = alloca(cnt * HASH_SIZE);
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      cn_fast_hash(hashes[i], 64, ints[j]);
-    }
-    assert(i == count);
+    hash_pairs(hashes + 2 * cnt - count, count - cnt, ints + 2 * cnt - count);
     while (cnt > 2) {
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        cn_fast_hash(ints[i], 64, ints[j]);
-      }
+      hash_pairs(ints, cnt, ints);
     }
     cn_fast_hash(ints[0], 64, root_hash);
   }
@@ -66,7 +76,7 @@ size_t tree_depth(size_t count) {
 }
 
 void tree_branch(const char (*hashes)[HASH_SIZE], size_t count, char (*branch)[HASH_SIZE]) {
-  size_t i, j;
+  size_t i;
   size_t cnt = 1;
   size_t depth = 0;
   char (*ints)[HASH_SIZE];
@@ -81,18 +91,13 @@ void tree_branch(const char (*hashes)[HASH_SIZE], size_t count, char (*branch)[H
   assert(depth == tree_depth(count));
   ints = alloca((cnt - 1) * HASH_SIZE);
   memcpy(ints, hashes + 1, (2 * cnt - count - 1) * HASH_SIZE);
-  for (i = 2 * cnt - count, j = 2 * cnt - count - 1; j < cnt - 1; i += 2, ++j) {
-    cn_fast_hash(hashes[i], 2 * HASH_SIZE, ints[j]);
-  }
-  assert(i == count);
+  hash_pairs(hashes + 2 * cnt - count, count - cnt, ints + 2 * cnt - count - 1);
   while (depth > 0) {
     assert(cnt == 1ULL << depth);
     cnt >>= 1;
     --depth;
     memcpy(branch[depth], ints[0], HASH_SIZE);
-    for (i = 1, j = 0; j < cnt - 1; i += 2, ++j) {
-      cn_fast_hash(ints[i], 2 * HASH_SIZE, ints[j]);
-    }
+    hash_pairs(ints + 1, cnt - 1, ints);
   }
 }
 
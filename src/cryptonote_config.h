@@ -70,7 +70,11 @@ static_assert(UPGRADE_VOTING_WINDOW > 1, "Bad UPGRADE_VOTING_WINDOW");
 
 const char     CRYPTONOTE_BLOCKS_FILENAME[]                  = "blocks.dat";
 const char     CRYPTONOTE_BLOCKINDEXES_FILENAME[]            = "blockindexes.dat";
+const char     CRYPTONOTE_TRANSACTION_INDEX_FILENAME[]       = "txindex.dat";
 const char     CRYPTONOTE_BLOCKSCACHE_FILENAME[]             = "blockscache.dat";
+const char     CRYPTONOTE_BLOCKSCACHE_JOURNAL_FILENAME[]     = "blockscache.journal";
+const char     CRYPTONOTE_BLOCKS_LONGHASHES_FILENAME[]       = "blockslonghashes.dat";
+const char     CRYPTONOTE_SNAPSHOT_MANIFEST_FILENAME[]       = "snapshot.manifest";
 const char     CRYPTONOTE_POOLDATA_FILENAME[]                = "poolstate.bin";
 const char     P2P_NET_DATA_FILENAME[]                       = "p2pstate.bin";
 const char     MINER_CONFIG_FILE_NAME[]                      = "miner_conf.json";
@@ -86,7 +90,15 @@ const uint8_t  BLOCK_MINOR_VERSION_1                         =  1;
 
 const size_t   BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT        =  10000;  //by default, blocks ids count in synchronizing
 const size_t   BLOCKS_SYNCHRONIZING_DEFAULT_COUNT            =  200;    //by default, blocks count in blocks downloading
+const unsigned BLOCKS_SYNCHRONIZING_RESPONSE_TIME            =  2;      //seconds, blocks requested from a peer of measured speed are sized to download in this time
+const size_t   BLOCK_HEADERS_SYNCHRONIZING_COUNT             =  1000;   //block headers requested at once in synchronizing
+const unsigned BLOCK_HEADERS_SYNCHRONIZING_TIMEOUT           =  30;     //seconds, blocks of a chain entry whose headers aren't received in time are downloaded without checking them first
+const unsigned BLOCKS_SYNCHRONIZING_STALL_TIMEOUT            =  60;     //seconds, blocks not delivered in time are requested from other peers
+const size_t   BLOCKS_CACHE_DEFAULT_SIZE                     =  1024;   //blocks kept in memory by default
 const size_t   COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT         =  1000;
+const size_t   COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_MAX_COUNT =  1000;
+const size_t   COMMAND_RPC_GET_BLOCK_FILTERS_MAX_COUNT       =  10000;
+const size_t   COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES_MAX_COUNT = 1000;
 
 const int      P2P_DEFAULT_PORT                              =  8080;
 const int      RPC_DEFAULT_PORT                              =  8081;
@@ -94,9 +106,22 @@ const int      RPC_DEFAULT_PORT                              =  8081;
 const size_t   P2P_LOCAL_WHITE_PEERLIST_LIMIT                =  1000;
 const size_t   P2P_LOCAL_GRAY_PEERLIST_LIMIT                 =  5000;
 
+const uint8_t  P2P_CURRENT_VERSION                           = 3;
+const uint8_t  P2P_COMPACT_BLOCKS_VERSION                    = 1;             // peers of this version accept NOTIFY_NEW_COMPACT_BLOCK
+const uint8_t  P2P_TX_ANNOUNCE_VERSION                       = 2;             // peers of this version accept NOTIFY_TX_ANNOUNCE
+const uint8_t  P2P_BLOCK_HEADERS_VERSION                     = 3;             // peers of this version accept NOTIFY_REQUEST_BLOCK_HEADERS
+const uint32_t P2P_FEATURE_COMPRESSION                       = 1;             // handshake feature bit, peer accepts LZ4 compressed Levin notifications
+const uint32_t P2P_FEATURE_FRAGMENTS                         = 2;             // handshake feature bit, peer joins Levin messages split into fragments
+const uint32_t P2P_TX_REQUEST_TIMEOUT                        = 30;            // seconds, announced transaction not received in time is requested from another peer which announced it
+
 const uint32_t P2P_DEFAULT_CONNECTIONS_COUNT                 = 8;
+const uint32_t P2P_DEFAULT_CONNECTION_FANOUT                 = 8;             // outgoing connections attempted concurrently
+const uint32_t P2P_DEFAULT_REQUEST_RATE                      = 2000;          // work units per second a peer may spend on requests, about 500 blocks
+const uint32_t P2P_DEFAULT_REQUEST_BURST                     = 20000;         // work units a peer may spend at once
 const uint32_t P2P_DEFAULT_HANDSHAKE_INTERVAL                = 60;            // seconds
 const uint32_t P2P_DEFAULT_PACKET_MAX_SIZE                   = 50000000;      // 50000000 bytes maximum packet size
+const size_t   P2P_CONNECTION_MAX_WRITE_BUFFER_SIZE          = 32 * 1024 * 1024; // peer is dropped when more data than this waits to be sent to it
+const size_t   P2P_CONNECTION_FRAGMENT_SIZE                  = 64 * 1024;     // bulk notifications are written in parts of this size, new blocks are sent between them
 const uint32_t P2P_DEFAULT_PEERS_IN_HANDSHAKE                = 250;
 const uint32_t P2P_DEFAULT_CONNECTION_TIMEOUT                = 5000;          // 5 seconds
 const uint32_t P2P_DEFAULT_PING_CONNECTION_TIMEOUT           = 2000;          // 2 seconds
@@ -104,6 +129,8 @@ const uint64_t P2P_DEFAULT_INVOKE_TIMEOUT                    = 60 * 2 * 1000; //
 const size_t   P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT          = 5000;          // 5 seconds
 const char     P2P_STAT_TRUSTED_PUB_KEY[]                    = "93467628927eaa0b13a4e52e61864a75aa475e67f6b5748eb3fc1d2fe468aed4";
 const size_t   P2P_DEFAULT_WHITELIST_CONNECTIONS_PERCENT     = 70;
+const size_t   P2P_PEER_SELECTION_CANDIDATES                 = 3;             // outgoing connection goes to the fastest of this many random peers
+const size_t   P2P_PEER_EXPLORATION_PERCENT                  = 20;            // share of outgoing connections made to a random peer regardless of its record
 
 const unsigned THREAD_STACK_SIZE                             = 5 * 1024 * 1024;
 
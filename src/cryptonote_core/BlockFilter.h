@@ -0,0 +1,95 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+namespace CryptoNote
+{
+  // Compact Bloom filter of key images spent in one block. Wallets fetch filters of a range of blocks and check
+  // their unspent outputs against them, so blocks which certainly spend none of them needn't be downloaded for
+  // spend detection. Filter is a byte string, it is empty for blocks without key inputs.
+  class BlockFilter {
+
+  public:
+
+    static std::string build(const std::vector<crypto::key_image>& keyImages) {
+      std::string filter(keyImages.size() * BYTES_PER_KEY, '\0');
+      for (const crypto::key_image& keyImage : keyImages) {
+        uint64_t first;
+        uint64_t step;
+        hash(keyImage, first, step);
+        for (size_t i = 0; i < BITS_PER_KEY; ++i) {
+          uint64_t bit = (first + i * step) % (filter.size() * 8);
+          filter[static_cast<size_t>(bit / 8)] |= static_cast<char>(1 << (bit % 8));
+        }
+      }
+
+      return filter;
+    }
+
+    // false means the key image isn't spent in the block
+    static bool mayContain(const std::string& filter, const crypto::key_image& keyImage) {
+      if (filter.empty()) {
+        return false;
+      }
+
+      uint64_t first;
+      uint64_t step;
+      hash(keyImage, first, step);
+      for (size_t i = 0; i < BITS_PER_KEY; ++i) {
+        uint64_t bit = (first + i * step) % (filter.size() * 8);
+        if ((static_cast<uint8_t>(filter[static_cast<size_t>(bit / 8)]) & (1 << (bit % 8))) == 0) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+  private:
+
+    // 16 bits and 7 probes per key image give about 0.1% false positives
+    static const size_t BYTES_PER_KEY = 2;
+    static const size_t BITS_PER_KEY = 7;
+
+    static uint64_t finalize(uint64_t hash) {
+      hash ^= hash >> 31;
+      hash *= 0xbf58476d1ce4e5b9ULL;
+      hash ^= hash >> 29;
+      hash *= 0x94d049bb133111ebULL;
+      hash ^= hash >> 32;
+      return hash;
+    }
+
+    // probe positions are first + i * step, all bytes of the key image are folded so structured ones spread too
+    static void hash(const crypto::key_image& keyImage, uint64_t& first, uint64_t& step) {
+      uint64_t words[4];
+      memcpy(words, &keyImage, sizeof(words));
+      first = finalize(words[0] ^ (words[1] * 0x9e3779b97f4a7c15ULL) ^ (words[2] * 0xc2b2ae3d27d4eb4fULL) ^ (words[3] * 0x165667b19e3779f9ULL));
+      step = finalize(first ^ 0x2545f4914f6cdd1dULL) | 1;
+    }
+
+  };
+}
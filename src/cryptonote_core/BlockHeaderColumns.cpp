@@ -0,0 +1,103 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BlockHeaderColumns.h"
+
+#include <algorithm>
+
+#include "serialization/SerializationOverloads.h"
+
+namespace CryptoNote
+{
+  BlockSummary BlockHeaderColumns::get(uint64_t height) const {
+    size_t index = static_cast<size_t>(height);
+    BlockSummary summary = {m_timestamps[index], m_cumulativeDifficulties[index], m_cumulativeSizes[index], m_generatedCoins[index],
+      m_majorVersions[index], m_minorVersions[index]};
+    return summary;
+  }
+
+  void BlockHeaderColumns::push(const BlockSummary& summary) {
+    m_timestamps.push_back(summary.timestamp);
+    m_maxTimestamps.push_back(m_maxTimestamps.empty() ? summary.timestamp : std::max(m_maxTimestamps.back(), summary.timestamp));
+    m_cumulativeDifficulties.push_back(summary.cumulativeDifficulty);
+    m_cumulativeSizes.push_back(summary.cumulativeSize);
+    m_generatedCoins.push_back(summary.generatedCoins);
+    m_majorVersions.push_back(summary.majorVersion);
+    m_minorVersions.push_back(summary.minorVersion);
+  }
+
+  void BlockHeaderColumns::pop() {
+    m_timestamps.pop_back();
+    m_maxTimestamps.pop_back();
+    m_cumulativeDifficulties.pop_back();
+    m_cumulativeSizes.pop_back();
+    m_generatedCoins.pop_back();
+    m_majorVersions.pop_back();
+    m_minorVersions.pop_back();
+  }
+
+  void BlockHeaderColumns::clear() {
+    m_timestamps.clear();
+    m_maxTimestamps.clear();
+    m_cumulativeDifficulties.clear();
+    m_cumulativeSizes.clear();
+    m_generatedCoins.clear();
+    m_majorVersions.clear();
+    m_minorVersions.clear();
+  }
+
+  void BlockHeaderColumns::reserve(size_t count) {
+    m_timestamps.reserve(count);
+    m_maxTimestamps.reserve(count);
+    m_cumulativeDifficulties.reserve(count);
+    m_cumulativeSizes.reserve(count);
+    m_generatedCoins.reserve(count);
+    m_majorVersions.reserve(count);
+    m_minorVersions.reserve(count);
+  }
+
+  uint64_t BlockHeaderColumns::lowerBoundTimestamp(uint64_t startHeight, uint64_t timestamp) const {
+    if (startHeight >= m_timestamps.size())
+      return m_timestamps.size();
+
+    return std::lower_bound(m_maxTimestamps.begin() + static_cast<size_t>(startHeight), m_maxTimestamps.end(), timestamp) - m_maxTimestamps.begin();
+  }
+
+  void BlockHeaderColumns::serialize(ISerializer& s, const std::string& name) {
+    s.beginObject(name);
+    serializeAsBinary(m_timestamps, "timestamps", s);
+    serializeAsBinary(m_cumulativeDifficulties, "cumulative_difficulties", s);
+    serializeAsBinary(m_cumulativeSizes, "cumulative_sizes", s);
+    serializeAsBinary(m_generatedCoins, "generated_coins", s);
+    serializeAsBinary(m_majorVersions, "major_versions", s);
+    serializeAsBinary(m_minorVersions, "minor_versions", s);
+    s.endObject();
+
+    if (s.type() == ISerializer::INPUT) {
+      size_t count = m_timestamps.size();
+      if (m_cumulativeDifficulties.size() != count || m_cumulativeSizes.size() != count || m_generatedCoins.size() != count ||
+        m_majorVersions.size() != count || m_minorVersions.size() != count) {
+        clear();
+      }
+
+      m_maxTimestamps.resize(m_timestamps.size());
+      for (size_t i = 0; i < m_timestamps.size(); ++i) {
+        m_maxTimestamps[i] = i == 0 ? m_timestamps[0] : std::max(m_maxTimestamps[i - 1], m_timestamps[i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cryptonote_core/difficulty.h"
+
+namespace CryptoNote
+{
+  class ISerializer;
+
+  struct BlockSummary {
+    uint64_t timestamp;
+    difficulty_type cumulativeDifficulty;
+    uint64_t cumulativeSize;
+    uint64_t generatedCoins;
+    uint8_t majorVersion;
+    uint8_t minorVersion;
+  };
+
+  // Header fields of every main chain block by height, one array per field, so difficulty, median, upgrade and
+  // timestamp searches don't deserialize blocks. Takes 42 bytes per block.
+  class BlockHeaderColumns {
+
+  public:
+
+    size_t size() const {
+      return m_timestamps.size();
+    }
+
+    bool empty() const {
+      return m_timestamps.empty();
+    }
+
+    uint64_t timestamp(uint64_t height) const {
+      return m_timestamps[static_cast<size_t>(height)];
+    }
+
+    uint8_t majorVersion(uint64_t height) const {
+      return m_majorVersions[static_cast<size_t>(height)];
+    }
+
+    uint8_t minorVersion(uint64_t height) const {
+      return m_minorVersions[static_cast<size_t>(height)];
+    }
+
+    BlockSummary get(uint64_t height) const;
+    void push(const BlockSummary& summary);
+    void pop();
+    void clear();
+    void reserve(size_t count);
+
+    // First height not below startHeight where a block with timestamp not less than the given one is reached,
+    // size() if there is none. Block timestamps may go back, the search runs over running maximum of them.
+    uint64_t lowerBoundTimestamp(uint64_t startHeight, uint64_t timestamp) const;
+
+    void serialize(ISerializer& s, const std::string& name);
+
+  private:
+
+    std::vector<uint64_t> m_timestamps;
+    // maximum timestamp up to each height, not stored but rebuilt on load
+    std::vector<uint64_t> m_maxTimestamps;
+    std::vector<difficulty_type> m_cumulativeDifficulties;
+    std::vector<uint64_t> m_cumulativeSizes;
+    std::vector<uint64_t> m_generatedCoins;
+    std::vector<uint8_t> m_majorVersions;
+    std::vector<uint8_t> m_minorVersions;
+
+  };
+}
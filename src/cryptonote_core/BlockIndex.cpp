@@ -16,22 +16,65 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "BlockIndex.h"
+
+#include <cstring>
+
 #include <boost/utility/value_init.hpp>
 
+#include "serialization/SerializationOverloads.h"
+
 namespace CryptoNote
 {
+  void BlockIndex::pop() {
+    size_t hole = findSlot(m_ids.back());
+    m_table[hole] = EMPTY_SLOT;
+    // backward shift deletion, an entry moves to the hole unless its home lies cyclically in (hole, slot]
+    for (size_t slot = next(hole); m_table[slot] != EMPTY_SLOT; slot = next(slot)) {
+      size_t home = getHome(m_ids[m_table[slot] - 1]);
+      bool staysInPlace = hole < slot ? (home > hole && home <= slot) : (home > hole || home <= slot);
+      if (!staysInPlace) {
+        m_table[hole] = m_table[slot];
+        m_table[slot] = EMPTY_SLOT;
+        hole = slot;
+      }
+    }
+
+    m_ids.pop_back();
+  }
+
+  bool BlockIndex::push(const crypto::hash& h) {
+    size_t slot = findSlot(h);
+    if (m_table[slot] != EMPTY_SLOT)
+      return false;
+
+    if ((m_ids.size() + 1) * 2 > m_table.size()) {
+      m_ids.push_back(h);
+      rebuildTable(m_table.size() * 2);
+      return true;
+    }
+
+    m_ids.push_back(h);
+    m_table[slot] = static_cast<uint32_t>(m_ids.size());
+    return true;
+  }
+
+  void BlockIndex::clear() {
+    m_ids.clear();
+    m_table.assign(INITIAL_TABLE_SIZE, EMPTY_SLOT);
+  }
+
   crypto::hash BlockIndex::getBlockId(uint64_t height) const {
-    if (height >= m_container.size())
+    if (height >= m_ids.size())
       return boost::value_initialized<crypto::hash>();
-    return m_container[static_cast<size_t>(height)];
+    return m_ids[static_cast<size_t>(height)];
   }
 
   bool BlockIndex::getBlockIds(uint64_t startHeight, size_t maxCount, std::list<crypto::hash>& items) const {
-    if (startHeight >= m_container.size())
+    if (startHeight >= m_ids.size())
       return false;
 
-    for (size_t i = startHeight; i < (startHeight + maxCount) && i < m_container.size(); ++i) {
-      items.push_back(m_container[i]);
+    for (size_t i = startHeight; i < (startHeight + maxCount) && i < m_ids.size(); ++i) {
+      items.push_back(m_ids[i]);
     }
 
     return true;
@@ -60,7 +103,7 @@ namespace CryptoNote
     bool genesis_included = false;
 
     while (current_back_offset < sz) {
-      ids.push_back(m_container[sz - current_back_offset]);
+      ids.push_back(m_ids[sz - current_back_offset]);
       if (sz - current_back_offset == 0)
         genesis_included = true;
       if (i < 10) {
@@ -72,16 +115,51 @@ namespace CryptoNote
     }
 
     if (!genesis_included)
-      ids.push_back(m_container[0]);
+      ids.push_back(m_ids[0]);
 
     return true;
   }
 
   crypto::hash BlockIndex::getTailId() const {
-    if (m_container.empty())
+    if (m_ids.empty())
       return boost::value_initialized<crypto::hash>();
-    return m_container.back();
+    return m_ids.back();
   }
 
+  void BlockIndex::serialize(ISerializer& s, const std::string& name) {
+    // block ids are written as one binary blob
+    serializeAsBinary(m_ids, name, s);
+
+    if (s.type() == ISerializer::INPUT) {
+      size_t tableSize = INITIAL_TABLE_SIZE;
+      while (m_ids.size() * 2 > tableSize) {
+        tableSize *= 2;
+      }
+
+      rebuildTable(tableSize);
+    }
+  }
 
+  size_t BlockIndex::getHome(const crypto::hash& h) const {
+    // ids are uniformly distributed, their prefix is as good as a hash
+    uint64_t prefix;
+    memcpy(&prefix, &h, sizeof prefix);
+    return static_cast<size_t>(prefix) & (m_table.size() - 1);
+  }
+
+  size_t BlockIndex::findSlot(const crypto::hash& h) const {
+    size_t slot = getHome(h);
+    while (m_table[slot] != EMPTY_SLOT && m_ids[m_table[slot] - 1] != h) {
+      slot = next(slot);
+    }
+
+    return slot;
+  }
+
+  void BlockIndex::rebuildTable(size_t tableSize) {
+    m_table.assign(tableSize, EMPTY_SLOT);
+    for (size_t height = 0; height < m_ids.size(); ++height) {
+      m_table[findSlot(m_ids[height])] = static_cast<uint32_t>(height + 1);
+    }
+  }
 }
@@ -15,52 +15,47 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/random_access_index.hpp>
-
 #include "crypto/hash.h"
 #include <list>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace CryptoNote
 {
+  class ISerializer;
+
+  // Block ids by height in a contiguous array, plus an open addressing table of heights keyed by id prefix for
+  // lookups by id. Takes about 40 bytes per block.
   class BlockIndex {
 
   public:
 
-    BlockIndex() : 
-      m_index(m_container.get<1>()) {}
+    BlockIndex() : m_table(INITIAL_TABLE_SIZE, EMPTY_SLOT) {}
 
-    void pop() {
-      m_container.pop_back();
-    }
+    void pop();
 
     // returns true if new element was inserted, false if already exists
-    bool push(const crypto::hash& h) {
-      auto result = m_container.push_back(h);
-      return result.second;
-    }
+    bool push(const crypto::hash& h);
 
     bool hasBlock(const crypto::hash& h) const {
-      return m_index.find(h) != m_index.end();
+      return m_table[findSlot(h)] != EMPTY_SLOT;
     }
 
     bool getBlockHeight(const crypto::hash& h, uint64_t& height) const {
-      auto hi = m_index.find(h);
-      if (hi == m_index.end())
+      uint32_t slot = m_table[findSlot(h)];
+      if (slot == EMPTY_SLOT)
         return false;
 
-      height = std::distance(m_container.begin(), m_container.project<0>(hi));
+      height = slot - 1;
       return true;
     }
 
     size_t size() const {
-      return m_container.size();
+      return m_ids.size();
     }
 
-    void clear() {
-      m_container.clear();
-    }
+    void clear();
 
     crypto::hash getBlockId(uint64_t height) const;
     bool getBlockIds(uint64_t startHeight, size_t maxCount, std::list<crypto::hash>& items) const;
@@ -68,22 +63,27 @@ namespace CryptoNote
     bool getShortChainHistory(std::list<crypto::hash>& ids) const;
     crypto::hash getTailId() const;
 
-    template <class Archive> void serialize(Archive& ar, const unsigned int version) {
-      ar & m_container;
-    }
+    void serialize(ISerializer& s, const std::string& name);
 
   private:
 
-    typedef boost::multi_index_container <
-      crypto::hash,
-      boost::multi_index::indexed_by<
-        boost::multi_index::random_access<>,
-        boost::multi_index::hashed_unique<boost::multi_index::identity<crypto::hash>>
-      >
-    > ContainerT;
+    enum : uint32_t {
+      EMPTY_SLOT = 0,
+      INITIAL_TABLE_SIZE = 1024
+    };
+
+    size_t getHome(const crypto::hash& h) const;
+    size_t next(size_t slot) const {
+      return (slot + 1) & (m_table.size() - 1);
+    }
+
+    // slot holding height of the id plus one, or the empty slot it would be inserted into
+    size_t findSlot(const crypto::hash& h) const;
+    void rebuildTable(size_t tableSize);
 
-    ContainerT m_container;
-    ContainerT::nth_index<1>::type& m_index;
+    std::vector<crypto::hash> m_ids;
+    // power of two, at most half full
+    std::vector<uint32_t> m_table;
 
   };
 }
@@ -0,0 +1,92 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+namespace CryptoNote {
+
+// Key-value index of blockchain storage. Keys and values are plain data of fixed size, so an implementation may keep
+// them outside of process memory.
+template<class Key, class Value> class IBlockchainIndexStore {
+public:
+  typedef std::function<void(const Key&, const Value&)> Visitor;
+
+  virtual ~IBlockchainIndexStore() {
+  }
+
+  virtual size_t size() const = 0;
+  virtual bool contains(const Key& key) const = 0;
+  virtual bool find(const Key& key, Value& value) const = 0;
+  // returns false if the key is already stored, stored value is kept
+  virtual bool insert(const Key& key, const Value& value) = 0;
+  virtual bool erase(const Key& key) = 0;
+  virtual void clear() = 0;
+  virtual void reserve(size_t count) = 0;
+  virtual void forEach(const Visitor& visitor) const = 0;
+};
+
+template<class Key, class Value> class MemoryIndexStore : public IBlockchainIndexStore<Key, Value> {
+public:
+  virtual size_t size() const override {
+    return m_items.size();
+  }
+
+  virtual bool contains(const Key& key) const override {
+    return m_items.count(key) != 0;
+  }
+
+  virtual bool find(const Key& key, Value& value) const override {
+    auto it = m_items.find(key);
+    if (it == m_items.end()) {
+      return false;
+    }
+
+    value = it->second;
+    return true;
+  }
+
+  virtual bool insert(const Key& key, const Value& value) override {
+    return m_items.insert(std::make_pair(key, value)).second;
+  }
+
+  virtual bool erase(const Key& key) override {
+    return m_items.erase(key) != 0;
+  }
+
+  virtual void clear() override {
+    m_items.clear();
+  }
+
+  virtual void reserve(size_t count) override {
+    m_items.reserve(count);
+  }
+
+  virtual void forEach(const typename IBlockchainIndexStore<Key, Value>::Visitor& visitor) const override {
+    for (const auto& item : m_items) {
+      visitor(item.first, item.second);
+    }
+  }
+
+private:
+  std::unordered_map<Key, Value> m_items;
+};
+
+}
@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BlockchainSnapshot.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "Common/StringTools.h"
+
+namespace CryptoNote
+{
+  namespace {
+    const uint32_t SNAPSHOT_MANIFEST_VERSION = 1;
+    const size_t SNAPSHOT_HASH_CHUNK_SIZE = 4 * 1024 * 1024;
+  }
+
+  // One line per field: "version 1", "height <n>", "tail <hex>", then "file <name> <size> <hex>" per file
+  bool SnapshotManifest::store(const std::string& fileName) const {
+    std::ofstream file(fileName, std::ios::out | std::ios::trunc);
+    file << "version " << SNAPSHOT_MANIFEST_VERSION << '\n';
+    file << "height " << height << '\n';
+    file << "tail " << Common::podToHex(tailId) << '\n';
+    for (const File& entry : files) {
+      file << "file " << entry.name << ' ' << entry.size << ' ' << Common::podToHex(entry.hash) << '\n';
+    }
+
+    file.flush();
+    return static_cast<bool>(file);
+  }
+
+  bool SnapshotManifest::load(const std::string& fileName) {
+    std::ifstream file(fileName);
+    if (!file) {
+      return false;
+    }
+
+    files.clear();
+    bool hasVersion = false;
+    bool hasHeight = false;
+    bool hasTail = false;
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream fields(line);
+      std::string key;
+      std::string hex;
+      if (!(fields >> key)) {
+        continue;
+      }
+
+      if (key == "version") {
+        uint32_t version;
+        if (!(fields >> version) || version != SNAPSHOT_MANIFEST_VERSION) {
+          return false;
+        }
+
+        hasVersion = true;
+      } else if (key == "height") {
+        if (!(fields >> height)) {
+          return false;
+        }
+
+        hasHeight = true;
+      } else if (key == "tail") {
+        if (!(fields >> hex) || !Common::podFromHex(hex, tailId)) {
+          return false;
+        }
+
+        hasTail = true;
+      } else if (key == "file") {
+        File entry;
+        if (!(fields >> entry.name >> entry.size >> hex) || !Common::podFromHex(hex, entry.hash)) {
+          return false;
+        }
+
+        files.push_back(entry);
+      } else {
+        return false;
+      }
+    }
+
+    return hasVersion && hasHeight && hasTail;
+  }
+
+  bool copySnapshotFile(const std::string& source, const std::string& destination, uint64_t& size, crypto::hash& hash) {
+    std::ifstream input(source, std::ios::in | std::ios::binary);
+    if (!input) {
+      return false;
+    }
+
+    std::ofstream output;
+    if (!destination.empty()) {
+      output.open(destination, std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!output) {
+        return false;
+      }
+    }
+
+    std::vector<char> chunk(SNAPSHOT_HASH_CHUNK_SIZE);
+    std::string chunkHashes;
+    size = 0;
+    for (;;) {
+      input.read(chunk.data(), chunk.size());
+      size_t count = static_cast<size_t>(input.gcount());
+      if (count == 0) {
+        break;
+      }
+
+      crypto::hash chunkHash = crypto::cn_fast_hash(chunk.data(), count);
+      chunkHashes.append(reinterpret_cast<const char*>(&chunkHash), sizeof(chunkHash));
+      size += count;
+      if (output.is_open()) {
+        output.write(chunk.data(), count);
+      }
+    }
+
+    if (input.bad()) {
+      return false;
+    }
+
+    hash = crypto::cn_fast_hash(chunkHashes.data(), chunkHashes.size());
+    if (output.is_open()) {
+      output.flush();
+      return static_cast<bool>(output);
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace CryptoNote
+{
+  // Snapshot bundle is a directory with blocks files, blockchain cache and proof of work cache of a node, plus a
+  // manifest written last. Manifest names the chain tail the files were taken at and the size and hash of every file,
+  // so a new node copies them into its data directory and starts without rebuilding indexes.
+  struct SnapshotManifest {
+    struct File {
+      std::string name;
+      uint64_t size;
+      crypto::hash hash;
+    };
+
+    uint32_t height;
+    crypto::hash tailId;
+    std::vector<File> files;
+
+    bool store(const std::string& fileName) const;
+    bool load(const std::string& fileName);
+  };
+
+  // Copies source file to destination, or only reads it if destination is empty. The hash is taken over hashes of
+  // 4 MB chunks, so files of any size are hashed in one pass with bounded memory.
+  bool copySnapshotFile(const std::string& source, const std::string& destination, uint64_t& size, crypto::hash& hash);
+}
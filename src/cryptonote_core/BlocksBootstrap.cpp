@@ -0,0 +1,333 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BlocksBootstrap.h"
+
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <list>
+#include <vector>
+
+#include <boost/crc.hpp>
+#include <boost/utility/value_init.hpp>
+
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/verification_context.h"
+
+using namespace Logging;
+
+namespace CryptoNote
+{
+  namespace {
+    const char BOOTSTRAP_SIGNATURE[] = "CNBLOCKS";
+    const uint32_t BOOTSTRAP_VERSION = 1;
+    // Blocks read, hashed and written together
+    const uint64_t BOOTSTRAP_BATCH_SIZE = 200;
+    const uint64_t BOOTSTRAP_PROGRESS_INTERVAL = 10000;
+    // Record limit keeps corrupted size fields from causing huge allocations
+    const uint32_t MAX_RECORD_SIZE = 64 * 1024 * 1024;
+
+    struct BootstrapRecord {
+      blobdata block;
+      std::vector<blobdata> transactions;
+    };
+
+    struct BootstrapBatch {
+      std::vector<BootstrapRecord> records;
+      std::vector<Block> blocks;
+      bool ended;
+      bool failed;
+    };
+
+    void appendUint32(std::string& buffer, uint32_t value) {
+      char bytes[sizeof(value)];
+      memcpy(bytes, &value, sizeof(value));
+      buffer.append(bytes, sizeof(value));
+    }
+
+    bool readUint32(const char*& position, const char* end, uint32_t& value) {
+      if (static_cast<size_t>(end - position) < sizeof(value)) {
+        return false;
+      }
+
+      memcpy(&value, position, sizeof(value));
+      position += sizeof(value);
+      return true;
+    }
+
+    bool readBlob(const char*& position, const char* end, blobdata& blob) {
+      uint32_t size;
+      if (!readUint32(position, end, size) || static_cast<size_t>(end - position) < size) {
+        return false;
+      }
+
+      blob.assign(position, size);
+      position += size;
+      return true;
+    }
+
+    uint32_t checksum(const std::string& data) {
+      boost::crc_32_type crc;
+      crc.process_bytes(data.data(), data.size());
+      return crc.checksum();
+    }
+
+    void writeRecord(std::ofstream& file, const block_complete_entry& entry, std::string& buffer) {
+      buffer.clear();
+      appendUint32(buffer, static_cast<uint32_t>(entry.block.size()));
+      buffer.append(entry.block);
+      appendUint32(buffer, static_cast<uint32_t>(entry.txs.size()));
+      for (const blobdata& transaction : entry.txs) {
+        appendUint32(buffer, static_cast<uint32_t>(transaction.size()));
+        buffer.append(transaction);
+      }
+
+      std::string header;
+      appendUint32(header, static_cast<uint32_t>(buffer.size()));
+      appendUint32(header, checksum(buffer));
+      file.write(header.data(), header.size());
+      file.write(buffer.data(), buffer.size());
+    }
+
+    // Returns false on end of file, sets failed if the record is truncated or damaged
+    bool readRecord(std::ifstream& file, BootstrapRecord& record, std::string& buffer, bool& failed) {
+      char header[2 * sizeof(uint32_t)];
+      file.read(header, sizeof(header));
+      if (file.gcount() == 0 && file.eof()) {
+        return false;
+      }
+
+      failed = true;
+      if (file.gcount() != sizeof(header)) {
+        return false;
+      }
+
+      uint32_t size;
+      uint32_t expectedChecksum;
+      memcpy(&size, header, sizeof(size));
+      memcpy(&expectedChecksum, header + sizeof(size), sizeof(expectedChecksum));
+      if (size > MAX_RECORD_SIZE) {
+        return false;
+      }
+
+      buffer.resize(size);
+      file.read(&buffer[0], size);
+      if (static_cast<uint32_t>(file.gcount()) != size || checksum(buffer) != expectedChecksum) {
+        return false;
+      }
+
+      const char* position = buffer.data();
+      const char* end = position + buffer.size();
+      uint32_t transactionCount;
+      if (!readBlob(position, end, record.block) || !readUint32(position, end, transactionCount) || transactionCount > size) {
+        return false;
+      }
+
+      record.transactions.resize(transactionCount);
+      for (blobdata& transaction : record.transactions) {
+        if (!readBlob(position, end, transaction)) {
+          return false;
+        }
+      }
+
+      if (position != end) {
+        return false;
+      }
+
+      failed = false;
+      return true;
+    }
+
+    BootstrapBatch readBatch(std::ifstream& file) {
+      BootstrapBatch batch;
+      batch.ended = false;
+      batch.failed = false;
+      std::string buffer;
+      while (batch.records.size() < BOOTSTRAP_BATCH_SIZE) {
+        BootstrapRecord record;
+        if (!readRecord(file, record, buffer, batch.failed)) {
+          batch.ended = true;
+          break;
+        }
+
+        Block block;
+        if (!parse_and_validate_block_from_blob(record.block, block)) {
+          batch.ended = true;
+          batch.failed = true;
+          break;
+        }
+
+        batch.records.push_back(std::move(record));
+        batch.blocks.push_back(std::move(block));
+      }
+
+      return batch;
+    }
+  }
+
+  BlocksBootstrap::BlocksBootstrap(core& core, ILogger& logger) : m_core(core), logger(logger, "bootstrap") {
+  }
+
+  bool BlocksBootstrap::exportBlocks(const std::string& path, uint64_t endHeight) {
+    blockchain_storage& storage = m_core.get_blockchain_storage();
+    uint64_t height = storage.get_current_blockchain_height();
+    if (endHeight == 0 || endHeight > height) {
+      endHeight = height;
+    }
+
+    std::ofstream file(path, std::ios_base::binary | std::ios_base::trunc);
+    if (!file) {
+      logger(ERROR, BRIGHT_RED) << "Failed to open " << path << " for writing";
+      return false;
+    }
+
+    crypto::hash genesisHash = storage.get_block_id_by_height(0);
+    std::string header(BOOTSTRAP_SIGNATURE, sizeof(BOOTSTRAP_SIGNATURE) - 1);
+    appendUint32(header, BOOTSTRAP_VERSION);
+    header.append(reinterpret_cast<const char*>(&genesisHash), sizeof(genesisHash));
+    file.write(header.data(), header.size());
+
+    std::string buffer;
+    for (uint64_t start = 1; start < endHeight; start += BOOTSTRAP_BATCH_SIZE) {
+      std::vector<crypto::hash> ids;
+      for (uint64_t i = start; i < std::min(start + BOOTSTRAP_BATCH_SIZE, endHeight); ++i) {
+        ids.push_back(storage.get_block_id_by_height(i));
+      }
+
+      std::list<block_complete_entry> entries;
+      if (!storage.get_serialized_blocks(ids, entries)) {
+        // chain was reorganized below the exported height meanwhile
+        logger(ERROR, BRIGHT_RED) << "Failed to load blocks at height " << start;
+        return false;
+      }
+
+      for (const block_complete_entry& entry : entries) {
+        writeRecord(file, entry, buffer);
+      }
+
+      if (start / BOOTSTRAP_PROGRESS_INTERVAL != (start + ids.size()) / BOOTSTRAP_PROGRESS_INTERVAL) {
+        logger(INFO) << "Exported " << start + ids.size() << " of " << endHeight << " blocks";
+      }
+    }
+
+    file.flush();
+    if (!file) {
+      logger(ERROR, BRIGHT_RED) << "Failed to write " << path;
+      return false;
+    }
+
+    logger(INFO, BRIGHT_GREEN) << "Exported blocks below height " << endHeight << " to " << path;
+    return true;
+  }
+
+  bool BlocksBootstrap::importBlocks(const std::string& path, bool fastSync) {
+    std::ifstream file(path, std::ios_base::binary);
+    if (!file) {
+      logger(ERROR, BRIGHT_RED) << "Failed to open " << path;
+      return false;
+    }
+
+    char header[sizeof(BOOTSTRAP_SIGNATURE) - 1 + sizeof(uint32_t) + sizeof(crypto::hash)];
+    file.read(header, sizeof(header));
+    uint32_t version = 0;
+    if (file.gcount() == sizeof(header)) {
+      memcpy(&version, header + sizeof(BOOTSTRAP_SIGNATURE) - 1, sizeof(version));
+    }
+
+    if (version != BOOTSTRAP_VERSION || memcmp(header, BOOTSTRAP_SIGNATURE, sizeof(BOOTSTRAP_SIGNATURE) - 1) != 0) {
+      logger(ERROR, BRIGHT_RED) << path << " is not a blocks bootstrap file";
+      return false;
+    }
+
+    blockchain_storage& storage = m_core.get_blockchain_storage();
+    crypto::hash genesisHash = storage.get_block_id_by_height(0);
+    if (memcmp(header + sizeof(BOOTSTRAP_SIGNATURE) - 1 + sizeof(version), &genesisHash, sizeof(genesisHash)) != 0) {
+      logger(ERROR, BRIGHT_RED) << path << " contains blocks of another network";
+      return false;
+    }
+
+    bool previousFastSync = storage.is_fast_sync();
+    if (fastSync) {
+      storage.set_fast_sync(true);
+    }
+
+    bool result = true;
+    size_t added = 0;
+    BootstrapBatch batch = readBatch(file);
+    for (;;) {
+      std::future<BootstrapBatch> nextBatch;
+      if (!batch.ended) {
+        nextBatch = std::async(std::launch::async, [&file] { return readBatch(file); });
+      }
+
+      m_core.prepare_incoming_blocks(batch.blocks);
+      for (size_t i = 0; i < batch.records.size() && result; ++i) {
+        if (m_core.have_block(get_block_hash(batch.blocks[i]))) {
+          continue;
+        }
+
+        for (const blobdata& transaction : batch.records[i].transactions) {
+          tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+          m_core.handle_incoming_tx(transaction, tvc, true);
+          if (tvc.m_verifivation_failed) {
+            logger(ERROR, BRIGHT_RED) << "Transaction verification failed, tx_id = " << get_blob_hash(transaction);
+            result = false;
+            break;
+          }
+        }
+
+        block_verification_context bvc = boost::value_initialized<block_verification_context>();
+        if (result) {
+          m_core.handle_incoming_block_blob(batch.records[i].block, bvc, false, false);
+        }
+
+        if (result && (bvc.m_verifivation_failed || bvc.m_marked_as_orphaned)) {
+          logger(ERROR, BRIGHT_RED) << "Block " << get_block_hash(batch.blocks[i]) << " was not added to the chain";
+          result = false;
+        }
+
+        if (result && ++added % BOOTSTRAP_PROGRESS_INTERVAL == 0) {
+          logger(INFO) << "Imported " << added << " blocks, height " << m_core.get_current_blockchain_height();
+        }
+      }
+
+      if (batch.failed) {
+        logger(ERROR, BRIGHT_RED) << path << " is truncated or damaged";
+        result = false;
+      }
+
+      if (!nextBatch.valid()) {
+        break;
+      }
+
+      batch = nextBatch.get();
+      if (!result) {
+        break;
+      }
+    }
+
+    if (fastSync) {
+      storage.set_fast_sync(previousFastSync);
+    }
+
+    logger(INFO, result ? BRIGHT_GREEN : BRIGHT_RED) << "Imported " << added << " blocks, height " <<
+      m_core.get_current_blockchain_height();
+    return result;
+  }
+}
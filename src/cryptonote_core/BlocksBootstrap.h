@@ -0,0 +1,51 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <Logging/LoggerRef.h>
+
+namespace CryptoNote
+{
+  class core;
+
+  // Writes main chain blocks with their transactions to a flat file and adds them back to a node without going
+  // through P2P protocol. File starts with a signature and the genesis block hash, followed by records of a block
+  // blob and its transaction blobs, each record prefixed by its size and CRC32.
+  class BlocksBootstrap {
+
+  public:
+
+    BlocksBootstrap(core& core, Logging::ILogger& logger);
+
+    // Writes blocks from height 1 below endHeight, or the whole chain if endHeight is 0
+    bool exportBlocks(const std::string& path, uint64_t endHeight);
+    // Adds blocks from the file, ones already in the chain are skipped. Next batch is read and its proofs of work
+    // are computed while the current one is added. With fastSync ring signatures below the last checkpoint are not
+    // checked for the duration of the import.
+    bool importBlocks(const std::string& path, bool fastSync);
+
+  private:
+
+    core& m_core;
+    Logging::LoggerRef logger;
+
+  };
+}
@@ -0,0 +1,223 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ChainExport.h"
+
+#include <cassert>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "Common/StringTools.h"
+#include "cryptonote_core/blockchain_storage.h"
+
+using namespace Logging;
+
+namespace CryptoNote
+{
+  namespace {
+    // Rows read under one lock, a chunk of outputs takes about 100 bytes per row
+    const size_t EXPORT_CHUNK_SIZE = 10000;
+    const uint64_t EXPORT_PROGRESS_INTERVAL = 1000000;
+
+    // Writes rows column by column, values are added in column order and endRow() finishes a row
+    class TableWriter {
+    public:
+      TableWriter(const std::string& path, ChainExportFormat format, const std::vector<std::string>& columns) :
+        m_format(format), m_column(0), m_columnCount(columns.size()) {
+        if (m_format == ChainExportFormat::CSV) {
+          m_files.emplace_back(new std::ofstream(path, std::ios::out | std::ios::trunc));
+          for (size_t i = 0; i < columns.size(); ++i) {
+            *m_files.back() << (i == 0 ? "" : ",") << columns[i];
+          }
+
+          *m_files.back() << '\n';
+        } else {
+          for (const std::string& column : columns) {
+            m_files.emplace_back(new std::ofstream(path + "." + column, std::ios::out | std::ios::binary | std::ios::trunc));
+          }
+        }
+      }
+
+      bool good() const {
+        for (const auto& file : m_files) {
+          if (!*file) {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      // Integers go as text to CSV and as their native width to binary columns
+      template <typename T>
+      void add(T value) {
+        if (m_format == ChainExportFormat::CSV) {
+          separate() << static_cast<uint64_t>(value);
+        } else {
+          m_files[m_column]->write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        ++m_column;
+      }
+
+      // Hashes and keys go as hex to CSV and as raw bytes to binary columns
+      template <typename T>
+      void addPod(const T& value) {
+        if (m_format == ChainExportFormat::CSV) {
+          separate() << Common::podToHex(value);
+        } else {
+          m_files[m_column]->write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        ++m_column;
+      }
+
+      void endRow() {
+        assert(m_column == m_columnCount);
+        if (m_format == ChainExportFormat::CSV) {
+          *m_files.front() << '\n';
+        }
+
+        m_column = 0;
+      }
+
+      bool finish() {
+        for (auto& file : m_files) {
+          file->flush();
+        }
+
+        return good();
+      }
+
+    private:
+      std::ostream& separate() {
+        if (m_column != 0) {
+          *m_files.front() << ',';
+        }
+
+        return *m_files.front();
+      }
+
+      ChainExportFormat m_format;
+      size_t m_column;
+      size_t m_columnCount;
+      std::vector<std::unique_ptr<std::ofstream>> m_files;
+    };
+  }
+
+  ChainExport::ChainExport(blockchain_storage& storage, ILogger& logger) : m_storage(storage), logger(logger, "export") {
+  }
+
+  bool ChainExport::parseFormat(const std::string& name, ChainExportFormat& format) {
+    if (name == "csv") {
+      format = ChainExportFormat::CSV;
+    } else if (name == "binary") {
+      format = ChainExportFormat::BINARY;
+    } else {
+      return false;
+    }
+
+    return true;
+  }
+
+  bool ChainExport::exportBlocks(const std::string& path, ChainExportFormat format, uint64_t startHeight, uint64_t endHeight) {
+    TableWriter writer(path, format, { "height", "id", "timestamp", "difficulty", "cumulative_difficulty", "cumulative_size",
+      "generated_coins", "nonce", "major_version", "tx_count" });
+    if (!writer.good()) {
+      logger(ERROR, BRIGHT_RED) << "Failed to open " << path << " for writing";
+      return false;
+    }
+
+    uint64_t height = startHeight;
+    std::vector<blockchain_storage::BlockExportRow> rows;
+    while ((endHeight == 0 || height < endHeight) &&
+      m_storage.getBlockExportRows(height, endHeight == 0 ? EXPORT_CHUNK_SIZE : static_cast<size_t>(std::min<uint64_t>(EXPORT_CHUNK_SIZE, endHeight - height)), rows)) {
+      for (const blockchain_storage::BlockExportRow& row : rows) {
+        writer.add(row.height);
+        writer.addPod(row.id);
+        writer.add(row.timestamp);
+        writer.add(row.difficulty);
+        writer.add(row.cumulativeDifficulty);
+        writer.add(row.cumulativeSize);
+        writer.add(row.generatedCoins);
+        writer.add(row.nonce);
+        writer.add(row.majorVersion);
+        writer.add(row.transactionCount);
+        writer.endRow();
+      }
+
+      height += rows.size();
+      if (!writer.good()) {
+        break;
+      }
+    }
+
+    if (!writer.finish()) {
+      logger(ERROR, BRIGHT_RED) << "Failed to write " << path;
+      return false;
+    }
+
+    logger(INFO, BRIGHT_GREEN) << "Exported blocks from height " << startHeight << " below " << height << " to " << path;
+    return true;
+  }
+
+  bool ChainExport::exportOutputs(const std::string& path, ChainExportFormat format) {
+    TableWriter writer(path, format, { "amount", "global_index", "tx_hash", "output_index", "key", "unlock_time" });
+    if (!writer.good()) {
+      logger(ERROR, BRIGHT_RED) << "Failed to open " << path << " for writing";
+      return false;
+    }
+
+    uint64_t count = 0;
+    std::vector<blockchain_storage::OutputExportRow> rows;
+    for (uint64_t amount : m_storage.getKeyOutputAmounts()) {
+      for (uint32_t index = 0; m_storage.getKeyOutputExportRows(amount, index, EXPORT_CHUNK_SIZE, rows); index += static_cast<uint32_t>(rows.size())) {
+        for (const blockchain_storage::OutputExportRow& row : rows) {
+          writer.add(row.amount);
+          writer.add(row.globalIndex);
+          writer.addPod(row.transactionHash);
+          writer.add(row.outputIndex);
+          writer.addPod(row.key);
+          writer.add(row.unlockTime);
+          writer.endRow();
+        }
+
+        if (count / EXPORT_PROGRESS_INTERVAL != (count + rows.size()) / EXPORT_PROGRESS_INTERVAL) {
+          logger(INFO) << "Exported " << count + rows.size() << " outputs";
+        }
+
+        count += rows.size();
+        if (!writer.good()) {
+          break;
+        }
+      }
+
+      if (!writer.good()) {
+        break;
+      }
+    }
+
+    if (!writer.finish()) {
+      logger(ERROR, BRIGHT_RED) << "Failed to write " << path;
+      return false;
+    }
+
+    logger(INFO, BRIGHT_GREEN) << "Exported " << count << " outputs to " << path;
+    return true;
+  }
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <Logging/LoggerRef.h>
+
+namespace CryptoNote
+{
+  class blockchain_storage;
+
+  enum class ChainExportFormat {
+    // one file with a header line and a line per row, hashes and keys in hex
+    CSV,
+    // a file per column named <path>.<column>, fixed width little endian values, hashes and keys as 32 raw bytes
+    BINARY
+  };
+
+  // Writes main chain block headers or key outputs for analytics. Rows are read in chunks, each under the chain lock
+  // on its own, and written before the next one is read, so memory use and lock hold time do not grow with the chain.
+  class ChainExport {
+
+  public:
+
+    ChainExport(blockchain_storage& storage, Logging::ILogger& logger);
+
+    static bool parseFormat(const std::string& name, ChainExportFormat& format);
+
+    // Columns: height, id, timestamp, difficulty, cumulative_difficulty, cumulative_size, generated_coins, nonce,
+    // major_version, tx_count. Writes blocks from startHeight below endHeight, or up to the top if endHeight is 0.
+    bool exportBlocks(const std::string& path, ChainExportFormat format, uint64_t startHeight, uint64_t endHeight);
+    // Columns: amount, global_index, tx_hash, output_index, key, unlock_time. Outputs are ordered by amount and
+    // global index.
+    bool exportOutputs(const std::string& path, ChainExportFormat format);
+
+  private:
+
+    blockchain_storage& m_storage;
+    Logging::LoggerRef logger;
+
+  };
+}
@@ -17,19 +17,109 @@
 
 #include "CoreConfig.h"
 
+#include <stdexcept>
+
 #include "Common/util.h"
 #include "Common/command_line.h"
+#include "cryptonote_config.h"
 
 namespace CryptoNote {
 
+namespace {
+const command_line::arg_descriptor<bool> arg_map_blocks_file = {"map-blocks-file", "Read blocks through memory-mapped blocks file (64-bit builds only)"};
+const command_line::arg_descriptor<bool> arg_compress_blocks_file = {"compress-blocks-file", "Store blocks older than the last few hundred compressed, existing blocks are compressed on start"};
+const command_line::arg_descriptor<bool> arg_disk_indexes = {"disk-indexes", "Keep transaction index in a memory-mapped file, so the OS may page it out"};
+const command_line::arg_descriptor<bool> arg_explorer_indexes = {"explorer-indexes", "Index transactions by spent key images, output keys and payment ids for explorer RPC methods"};
+const command_line::arg_descriptor<uint64_t> arg_blocks_cache_size = {"blocks-cache-size", "Number of blocks kept in memory", BLOCKS_CACHE_DEFAULT_SIZE};
+const command_line::arg_descriptor<uint64_t> arg_blocks_cache_memory = {"blocks-cache-memory", "Memory for blocks kept in memory in megabytes, overrides blocks-cache-size, 0 means not set", 0};
+const command_line::arg_descriptor<std::string> arg_blocks_cache_policy = {"blocks-cache-policy", "Blocks cache replacement policy, lru or 2q. 2q keeps often read blocks when old blocks are read once, e.g. by syncing peers", "2q"};
+const command_line::arg_descriptor<std::string> arg_load_snapshot = {"load-snapshot", "Fill empty data directory from blockchain snapshot bundle in this directory, made by save_snapshot command", ""};
+const command_line::arg_descriptor<bool> arg_replica = {"replica", "Serve RPC from blocks of a node running on the same data directory, read-only and without P2P. The node must not compress its blocks file"};
+const command_line::arg_descriptor<bool> arg_fast_sync = {"fast-sync", "Do not check ring signatures of blocks below the last checkpoint"};
+const command_line::arg_descriptor<uint32_t> arg_verification_threads = {"verification-threads", "Number of threads verifying transaction signatures, 0 means number of CPU cores", 0};
+const command_line::arg_descriptor<uint64_t> arg_pool_max_transactions = {"pool-max-transactions", "Maximum number of transactions in memory pool, 0 means no limit", 0};
+const command_line::arg_descriptor<uint64_t> arg_pool_max_size = {"pool-max-size", "Maximum total size of transactions in memory pool in bytes, 0 means no limit", 0};
+const command_line::arg_descriptor<uint64_t> arg_memory_budget = {"memory-budget", "Memory in megabytes shared by blocks cache and memory pool, they shrink when it is exceeded, 0 means no budget", 0};
+}
+
 CoreConfig::CoreConfig() {
   configFolder = tools::get_default_data_dir();
+  mapBlocksFile = false;
+  compressBlocksFile = false;
+  diskIndexes = false;
+  explorerIndexes = false;
+  blocksCacheSize = BLOCKS_CACHE_DEFAULT_SIZE;
+  blocksCacheMemory = 0;
+  blocksCachePolicy = SwappedCachePolicy::TWO_QUEUE;
+  verificationThreads = 0;
+  fastSync = false;
+  replica = false;
+  poolMaxTransactions = 0;
+  poolMaxSize = 0;
+  memoryBudget = 0;
 }
 
 void CoreConfig::init(const boost::program_options::variables_map& options) {
   configFolder = command_line::get_arg(options, command_line::arg_data_dir);
+
+  if (command_line::has_arg(options, arg_map_blocks_file)) {
+    mapBlocksFile = true;
+  }
+
+  if (command_line::has_arg(options, arg_compress_blocks_file)) {
+    compressBlocksFile = true;
+  }
+
+  if (command_line::has_arg(options, arg_disk_indexes)) {
+    diskIndexes = true;
+  }
+
+  if (command_line::has_arg(options, arg_explorer_indexes)) {
+    explorerIndexes = true;
+  }
+
+  blocksCacheSize = command_line::get_arg(options, arg_blocks_cache_size);
+  blocksCacheMemory = command_line::get_arg(options, arg_blocks_cache_memory) * 1024 * 1024;
+
+  std::string blocksCachePolicyName = command_line::get_arg(options, arg_blocks_cache_policy);
+  if (blocksCachePolicyName == "lru") {
+    blocksCachePolicy = SwappedCachePolicy::LRU;
+  } else if (blocksCachePolicyName == "2q") {
+    blocksCachePolicy = SwappedCachePolicy::TWO_QUEUE;
+  } else {
+    throw std::runtime_error("Unknown blocks cache policy " + blocksCachePolicyName);
+  }
+
+  verificationThreads = command_line::get_arg(options, arg_verification_threads);
+  snapshotFolder = command_line::get_arg(options, arg_load_snapshot);
+
+  if (command_line::has_arg(options, arg_fast_sync)) {
+    fastSync = true;
+  }
+
+  if (command_line::has_arg(options, arg_replica)) {
+    replica = true;
+  }
+
+  poolMaxTransactions = command_line::get_arg(options, arg_pool_max_transactions);
+  poolMaxSize = command_line::get_arg(options, arg_pool_max_size);
+  memoryBudget = command_line::get_arg(options, arg_memory_budget) * 1024 * 1024;
 }
 
 void CoreConfig::initOptions(boost::program_options::options_description& desc) {
+  command_line::add_arg(desc, arg_map_blocks_file);
+  command_line::add_arg(desc, arg_compress_blocks_file);
+  command_line::add_arg(desc, arg_disk_indexes);
+  command_line::add_arg(desc, arg_explorer_indexes);
+  command_line::add_arg(desc, arg_blocks_cache_size);
+  command_line::add_arg(desc, arg_blocks_cache_memory);
+  command_line::add_arg(desc, arg_blocks_cache_policy);
+  command_line::add_arg(desc, arg_verification_threads);
+  command_line::add_arg(desc, arg_fast_sync);
+  command_line::add_arg(desc, arg_load_snapshot);
+  command_line::add_arg(desc, arg_replica);
+  command_line::add_arg(desc, arg_pool_max_transactions);
+  command_line::add_arg(desc, arg_pool_max_size);
+  command_line::add_arg(desc, arg_memory_budget);
 }
 } //namespace CryptoNote
@@ -17,10 +17,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include <boost/program_options.hpp>
 
+#include "SwappedCache.h"
+
 namespace CryptoNote {
 
 class CoreConfig {
@@ -31,6 +34,24 @@ public:
   void init(const boost::program_options::variables_map& options);
 
   std::string configFolder;
+  bool mapBlocksFile;
+  bool compressBlocksFile;
+  bool diskIndexes;
+  bool explorerIndexes;
+  uint64_t blocksCacheSize;
+  // bytes, overrides blocksCacheSize if not 0
+  uint64_t blocksCacheMemory;
+  SwappedCachePolicy blocksCachePolicy;
+  uint32_t verificationThreads;
+  bool fastSync;
+  // empty if not set
+  std::string snapshotFolder;
+  // blocks in configFolder are written by another node and followed read-only
+  bool replica;
+  uint64_t poolMaxTransactions;
+  uint64_t poolMaxSize;
+  // bytes shared by blocks cache and memory pool, 0 means no budget
+  uint64_t memoryBudget;
 };
 
 } //namespace CryptoNote
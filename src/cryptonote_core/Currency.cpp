@@ -46,7 +46,10 @@ bool Currency::init() {
     m_upgradeHeight = 0;
     m_blocksFileName = "testnet_" + m_blocksFileName;
     m_blocksCacheFileName = "testnet_" + m_blocksCacheFileName;
+    m_blocksCacheJournalFileName = "testnet_" + m_blocksCacheJournalFileName;
+    m_blocksLongHashesFileName = "testnet_" + m_blocksLongHashesFileName;
     m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
+    m_transactionIndexFileName = "testnet_" + m_transactionIndexFileName;
     m_txPoolFileName = "testnet_" + m_txPoolFileName;
   }
 
@@ -339,6 +342,10 @@ bool Currency::checkProofOfWorkV2(crypto::cn_context& context, const Block& bloc
     return false;
   }
 
+  return checkMergeMiningTag(block);
+}
+
+bool Currency::checkMergeMiningTag(const Block& block) const {
   tx_extra_merge_mining_tag mmTag;
   if (!get_mm_tag_from_extra(block.parentBlock.minerTx.extra, mmTag)) {
     logger(ERROR) << "merge mining tag wasn't found in extra of the parent block miner transaction";
@@ -376,6 +383,16 @@ bool Currency::checkProofOfWork(crypto::cn_context& context, const Block& block,
   return false;
 }
 
+bool Currency::checkProofOfWork(const Block& block, difficulty_type currentDiffic, const crypto::hash& proofOfWork) const {
+  switch (block.majorVersion) {
+  case BLOCK_MAJOR_VERSION_1: return check_hash(proofOfWork, currentDiffic);
+  case BLOCK_MAJOR_VERSION_2: return check_hash(proofOfWork, currentDiffic) && checkMergeMiningTag(block);
+  }
+
+  logger(ERROR, BRIGHT_RED) << "Unknown block major version: " << block.majorVersion << "." << block.minorVersion;
+  return false;
+}
+
 CurrencyBuilder::CurrencyBuilder(Logging::ILogger& log) : m_currency(log) {
   maxBlockNumber(parameters::CRYPTONOTE_MAX_BLOCK_NUMBER);
   maxBlockBlobSize(parameters::CRYPTONOTE_MAX_BLOCK_BLOB_SIZE);
@@ -420,7 +437,10 @@ CurrencyBuilder::CurrencyBuilder(Logging::ILogger& log) : m_currency(log) {
 
   blocksFileName(parameters::CRYPTONOTE_BLOCKS_FILENAME);
   blocksCacheFileName(parameters::CRYPTONOTE_BLOCKSCACHE_FILENAME);
+  blocksCacheJournalFileName(parameters::CRYPTONOTE_BLOCKSCACHE_JOURNAL_FILENAME);
+  blocksLongHashesFileName(parameters::CRYPTONOTE_BLOCKS_LONGHASHES_FILENAME);
   blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
+  transactionIndexFileName(parameters::CRYPTONOTE_TRANSACTION_INDEX_FILENAME);
   txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
 
   testnet(false);
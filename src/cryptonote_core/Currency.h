@@ -80,7 +80,10 @@ public:
 
   const std::string& blocksFileName() const { return m_blocksFileName; }
   const std::string& blocksCacheFileName() const { return m_blocksCacheFileName; }
+  const std::string& blocksCacheJournalFileName() const { return m_blocksCacheJournalFileName; }
+  const std::string& blocksLongHashesFileName() const { return m_blocksLongHashesFileName; }
   const std::string& blockIndexesFileName() const { return m_blockIndexesFileName; }
+  const std::string& transactionIndexFileName() const { return m_transactionIndexFileName; }
   const std::string& txPoolFileName() const { return m_txPoolFileName; }
 
   bool isTestnet() const { return m_testnet; }
@@ -107,11 +110,15 @@ public:
   bool checkProofOfWorkV1(crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, crypto::hash& proofOfWork) const;
   bool checkProofOfWorkV2(crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, crypto::hash& proofOfWork) const;
   bool checkProofOfWork(crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, crypto::hash& proofOfWork) const;
+  // Same check for proof of work computed in advance with get_block_longhash
+  bool checkProofOfWork(const Block& block, difficulty_type currentDiffic, const crypto::hash& proofOfWork) const;
 
 private:
   Currency(Logging::ILogger& log) : logger(log, "currency") {
   }
 
+  bool checkMergeMiningTag(const Block& block) const;
+
   bool init();
 
   bool generateGenesisBlock();
@@ -161,7 +168,10 @@ private:
 
   std::string m_blocksFileName;
   std::string m_blocksCacheFileName;
+  std::string m_blocksCacheJournalFileName;
+  std::string m_blocksLongHashesFileName;
   std::string m_blockIndexesFileName;
+  std::string m_transactionIndexFileName;
   std::string m_txPoolFileName;
 
   bool m_testnet;
@@ -228,7 +238,10 @@ public:
 
   CurrencyBuilder& blocksFileName(const std::string& val) { m_currency.m_blocksFileName = val; return *this; }
   CurrencyBuilder& blocksCacheFileName(const std::string& val) { m_currency.m_blocksCacheFileName = val; return *this; }
+  CurrencyBuilder& blocksCacheJournalFileName(const std::string& val) { m_currency.m_blocksCacheJournalFileName = val; return *this; }
+  CurrencyBuilder& blocksLongHashesFileName(const std::string& val) { m_currency.m_blocksLongHashesFileName = val; return *this; }
   CurrencyBuilder& blockIndexesFileName(const std::string& val) { m_currency.m_blockIndexesFileName = val; return *this; }
+  CurrencyBuilder& transactionIndexFileName(const std::string& val) { m_currency.m_transactionIndexFileName = val; return *this; }
   CurrencyBuilder& txPoolFileName(const std::string& val) { m_currency.m_txPoolFileName = val; return *this; }
 
   CurrencyBuilder& testnet(bool val) { m_currency.m_testnet = val; return *this; }
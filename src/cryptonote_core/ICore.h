@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include "Common/StringView.h"
 #include "crypto/hash.h"
 #include "cryptonote_protocol/blobdatatype.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
@@ -41,6 +42,16 @@ struct BlockFullInfo;
 class ICoreObserver;
 class Currency;
 
+// queryBlocks entry for callers in the same process, blocks and transactions aren't serialized.
+// Blocks older than the timestamp have only the hash.
+struct BlockParsedInfo {
+  crypto::hash blockId;
+  bool hasBlock;
+  Block block;
+  // in the order of block.txHashes
+  std::list<Transaction> txs;
+};
+
 class ICore {
 public:
   virtual ~ICore() {}
@@ -54,7 +65,10 @@ public:
   virtual bool on_idle() = 0;
   virtual void pause_mining() = 0;
   virtual void update_block_template_and_resume_mining() = 0;
-  virtual bool handle_incoming_block_blob(const CryptoNote::blobdata& block_blob, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) = 0;
+  virtual bool handle_incoming_block_blob(Common::StringView block_blob, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) = 0;
+  virtual void prepare_incoming_blocks(const std::vector<CryptoNote::Block>& blocks) = 0;
+  // Checks proofs of work of blocks without transactions before they are downloaded, see blockchain_storage::checkBlockHeaders
+  virtual bool check_block_headers(const std::vector<CryptoNote::Block>& headers, bool& checked, bool& heavier) = 0;
   virtual bool handle_get_objects(CryptoNote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, CryptoNote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) = 0;
   virtual void on_synchronized() = 0;
   virtual bool is_ready() = 0;
@@ -66,10 +80,24 @@ public:
   virtual bool get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response& res) = 0;
   virtual bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) = 0;
   virtual i_cryptonote_protocol* get_protocol() = 0;
-  virtual bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block) = 0;
+  virtual bool handle_incoming_tx(Common::StringView tx_blob, tx_verification_context& tvc, bool keeped_by_block) = 0;
+  // Handles transactions concurrently, tvcs receives a context per blob in the same order
+  virtual void handle_incoming_txs(const std::vector<Common::StringView>& tx_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block) = 0;
+  virtual bool havePoolTransaction(const crypto::hash& id) = 0;
+  virtual void getPoolTransactions(const std::list<crypto::hash>& ids, std::list<Transaction>& txs, std::list<crypto::hash>& missedIds) = 0;
   virtual bool getPoolSymmetricDifference(const std::vector<crypto::hash>& known_pool_tx_ids, const crypto::hash& known_block_id, bool& isBcActual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids) = 0;
+  // Pool changes since known_version, the version of the pool is returned in version. isVersionActual is false if the
+  // changes are not kept anymore, getPoolSymmetricDifference should be used then.
+  virtual bool getPoolChanges(uint64_t known_version, const crypto::hash& known_block_id, bool& isBcActual, bool& isVersionActual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version) = 0;
   virtual bool queryBlocks(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
       uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<BlockFullInfo>& entries) = 0;
+  virtual bool queryBlocksParsed(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
+      uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<BlockParsedInfo>& entries) = 0;
+  // Same as queryBlocks, but only transactions with outputs to the tracked addresses, spending one of key_images
+  // or referencing outputs to the tracked addresses found by the same query are returned
+  virtual bool queryBlocksFiltered(const std::list<crypto::hash>& block_ids, uint64_t timestamp, const std::vector<TrackingKey>& tracking_keys,
+      const std::vector<crypto::key_image>& key_images, uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset,
+      std::list<BlockFullInfo>& entries) = 0;
 
   virtual bool getBlockByHash(const crypto::hash &h, Block &blk) = 0;
 };
@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <vector>
+
+#include "crypto/hash.h"
+
 namespace CryptoNote {
 
 class ICoreObserver {
@@ -24,6 +28,7 @@ public:
   virtual ~ICoreObserver() {};
   virtual void blockchainUpdated() {};
   virtual void poolUpdated() {};
+  virtual void txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) {};
 };
 
 }
@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <vector>
+
+#include "crypto/hash.h"
+
 namespace CryptoNote {
 class ITxPoolObserver {
 public:
@@ -24,5 +28,7 @@ public:
   }
 
   virtual void txDeletedFromPool() = 0;
+  // lowest priority transactions were removed to keep pool within its size limits
+  virtual void txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) = 0;
 };
 }
@@ -0,0 +1,134 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+namespace CryptoNote
+{
+  // Blocked Bloom filter of key images. All bits of a key image are set in one 64 byte block, so a lookup touches
+  // a single cache line. Key images can't be removed, removed ones only add false positives until the owner
+  // rebuilds the filter. Filter doesn't synchronize access itself.
+  class KeyImagesFilter {
+
+  public:
+
+    KeyImagesFilter() : m_size(0), m_capacity(0) {}
+
+    void insert(const crypto::key_image& keyImage) {
+      uint64_t hash = mix(keyImage);
+      Block& block = m_blocks[blockIndex(hash)];
+      for (size_t i = 0; i < BITS_PER_KEY; ++i) {
+        size_t bit = (hash >> (9 * i)) & 511;
+        block.words[bit / 64] |= uint64_t(1) << (bit % 64);
+      }
+
+      ++m_size;
+    }
+
+    // false means the key image was never inserted
+    bool mayContain(const crypto::key_image& keyImage) const {
+      if (m_blocks.empty()) {
+        return false;
+      }
+
+      uint64_t hash = mix(keyImage);
+      const Block& block = m_blocks[blockIndex(hash)];
+      for (size_t i = 0; i < BITS_PER_KEY; ++i) {
+        size_t bit = (hash >> (9 * i)) & 511;
+        if ((block.words[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    // insert must not be called on a full filter, the owner resets it for more key images and inserts them again
+    bool full() const {
+      return m_size >= m_capacity;
+    }
+
+    // drops all key images and sizes the filter for the given count of them
+    void reset(size_t expectedCount) {
+      size_t blockCount = 1;
+      while (blockCount * KEYS_PER_BLOCK < expectedCount) {
+        blockCount *= 2;
+      }
+
+      m_blocks.assign(blockCount, Block());
+      m_size = 0;
+      m_capacity = blockCount * KEYS_PER_BLOCK;
+    }
+
+    void clear() {
+      m_blocks.clear();
+      m_size = 0;
+      m_capacity = 0;
+    }
+
+    // number of insert calls since the last reset
+    size_t size() const {
+      return m_size;
+    }
+
+  private:
+
+    // 7 bits in a 512 bit block per key image and 16 bits of filter per key image give about 0.1% false positives
+    static const size_t BITS_PER_KEY = 7;
+    static const size_t KEYS_PER_BLOCK = 32;
+
+    struct Block {
+      uint64_t words[8];
+
+      Block() {
+        memset(words, 0, sizeof(words));
+      }
+    };
+
+    static uint64_t finalize(uint64_t hash) {
+      hash ^= hash >> 31;
+      hash *= 0xbf58476d1ce4e5b9ULL;
+      hash ^= hash >> 29;
+      hash *= 0x94d049bb133111ebULL;
+      hash ^= hash >> 32;
+      return hash;
+    }
+
+    // key images are curve points, fold all of their bytes so that structured ones spread over blocks too
+    static uint64_t mix(const crypto::key_image& keyImage) {
+      uint64_t words[4];
+      memcpy(words, &keyImage, sizeof(words));
+      return finalize(words[0] ^ (words[1] * 0x9e3779b97f4a7c15ULL) ^ (words[2] * 0xc2b2ae3d27d4eb4fULL) ^ (words[3] * 0x165667b19e3779f9ULL));
+    }
+
+    // hash bits select bits inside the block, the block is chosen by a second hash derived from it
+    size_t blockIndex(uint64_t hash) const {
+      return static_cast<size_t>(finalize(hash ^ 0x2545f4914f6cdd1dULL)) & (m_blocks.size() - 1);
+    }
+
+    std::vector<Block> m_blocks;
+    size_t m_size;
+    size_t m_capacity;
+
+  };
+}
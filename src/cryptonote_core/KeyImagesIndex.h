@@ -0,0 +1,255 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "serialization/SerializationOverloads.h"
+
+namespace CryptoNote
+{
+  // Map of key image to ids of transactions spending it. Entries are kept in one open addressing table with the first
+  // transaction stored inline, only key images spent by several transactions (possible for transactions kept by
+  // alternative blocks) allocate separate storage.
+  class KeyImagesIndex {
+
+  public:
+
+    KeyImagesIndex() : m_size(0) {}
+
+    // returns false if this transaction is already registered for the key image
+    bool insert(const crypto::key_image& keyImage, const crypto::hash& transactionId) {
+      if (m_slots.empty() || (m_size + 1) * 4 > m_slots.size() * 3) {
+        rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+      }
+
+      size_t index = find(keyImage);
+      Slot& slot = m_slots[index];
+      if (!slot.used) {
+        slot.used = true;
+        slot.shared = false;
+        slot.keyImage = keyImage;
+        slot.transactionId = transactionId;
+        ++m_size;
+        return true;
+      }
+
+      if (slot.transactionId == transactionId) {
+        return false;
+      }
+
+      std::vector<crypto::hash>& others = m_others[keyImage];
+      if (std::find(others.begin(), others.end(), transactionId) != others.end()) {
+        return false;
+      }
+
+      others.push_back(transactionId);
+      slot.shared = true;
+      return true;
+    }
+
+    // returns false if this transaction is not registered for the key image
+    bool erase(const crypto::key_image& keyImage, const crypto::hash& transactionId) {
+      if (m_slots.empty()) {
+        return false;
+      }
+
+      size_t index = find(keyImage);
+      Slot& slot = m_slots[index];
+      if (!slot.used) {
+        return false;
+      }
+
+      if (slot.shared) {
+        auto it = m_others.find(keyImage);
+        std::vector<crypto::hash>& others = it->second;
+        if (slot.transactionId == transactionId) {
+          slot.transactionId = others.back();
+          others.pop_back();
+        } else {
+          auto other = std::find(others.begin(), others.end(), transactionId);
+          if (other == others.end()) {
+            return false;
+          }
+
+          *other = others.back();
+          others.pop_back();
+        }
+
+        if (others.empty()) {
+          m_others.erase(it);
+          slot.shared = false;
+        }
+
+        return true;
+      }
+
+      if (slot.transactionId != transactionId) {
+        return false;
+      }
+
+      removeSlot(index);
+      return true;
+    }
+
+    bool contains(const crypto::key_image& keyImage) const {
+      return !m_slots.empty() && m_slots[find(keyImage)].used;
+    }
+
+    // appends ids of transactions spending the key image
+    void getTransactions(const crypto::key_image& keyImage, std::vector<crypto::hash>& transactionIds) const {
+      if (m_slots.empty()) {
+        return;
+      }
+
+      const Slot& slot = m_slots[find(keyImage)];
+      if (!slot.used) {
+        return;
+      }
+
+      transactionIds.push_back(slot.transactionId);
+      if (slot.shared) {
+        const std::vector<crypto::hash>& others = m_others.find(keyImage)->second;
+        transactionIds.insert(transactionIds.end(), others.begin(), others.end());
+      }
+    }
+
+    // number of transactions spending the key image
+    size_t count(const crypto::key_image& keyImage) const {
+      if (m_slots.empty()) {
+        return 0;
+      }
+
+      const Slot& slot = m_slots[find(keyImage)];
+      if (!slot.used) {
+        return 0;
+      }
+
+      return slot.shared ? 1 + m_others.find(keyImage)->second.size() : 1;
+    }
+
+    // number of distinct key images
+    size_t size() const {
+      return m_size;
+    }
+
+    void clear() {
+      m_slots.clear();
+      m_others.clear();
+      m_size = 0;
+    }
+
+    // entries are written as one binary blob of key image and transaction id pairs
+    void serialize(ISerializer& s, const std::string& name) {
+      std::vector<Entry> entries;
+      if (s.type() == ISerializer::OUTPUT) {
+        entries.reserve(m_size);
+        for (const Slot& slot : m_slots) {
+          if (slot.used) {
+            entries.push_back(Entry{ slot.keyImage, slot.transactionId });
+            if (slot.shared) {
+              for (const crypto::hash& transactionId : m_others.find(slot.keyImage)->second) {
+                entries.push_back(Entry{ slot.keyImage, transactionId });
+              }
+            }
+          }
+        }
+      }
+
+      serializeAsBinary(entries, name, s);
+
+      if (s.type() == ISerializer::INPUT) {
+        clear();
+        for (const Entry& entry : entries) {
+          insert(entry.keyImage, entry.transactionId);
+        }
+      }
+    }
+
+  private:
+
+    struct Entry {
+      crypto::key_image keyImage;
+      crypto::hash transactionId;
+    };
+
+    struct Slot {
+      crypto::key_image keyImage;
+      crypto::hash transactionId;
+      bool used;
+      bool shared;
+    };
+
+    size_t home(const crypto::key_image& keyImage) const {
+      return std::hash<crypto::key_image>()(keyImage) & (m_slots.size() - 1);
+    }
+
+    // index of the slot holding key image or of the empty slot where it would be inserted, table must not be empty
+    size_t find(const crypto::key_image& keyImage) const {
+      size_t mask = m_slots.size() - 1;
+      size_t index = home(keyImage);
+      while (m_slots[index].used && m_slots[index].keyImage != keyImage) {
+        index = (index + 1) & mask;
+      }
+
+      return index;
+    }
+
+    // backward shift deletion, keeps probe sequences intact without tombstones
+    void removeSlot(size_t index) {
+      size_t mask = m_slots.size() - 1;
+      size_t next = (index + 1) & mask;
+      while (m_slots[next].used) {
+        size_t nextHome = home(m_slots[next].keyImage);
+        if (((next - nextHome) & mask) >= ((next - index) & mask)) {
+          m_slots[index] = m_slots[next];
+          index = next;
+        }
+
+        next = (next + 1) & mask;
+      }
+
+      m_slots[index].used = false;
+      --m_size;
+    }
+
+    void rehash(size_t capacity) {
+      std::vector<Slot> slots(capacity);
+      for (Slot& slot : slots) {
+        slot.used = false;
+      }
+
+      slots.swap(m_slots);
+      for (const Slot& slot : slots) {
+        if (slot.used) {
+          m_slots[find(slot.keyImage)] = slot;
+        }
+      }
+    }
+
+    std::vector<Slot> m_slots;
+    std::unordered_map<crypto::key_image, std::vector<crypto::hash>> m_others;
+    size_t m_size;
+
+  };
+}
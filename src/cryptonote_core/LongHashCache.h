@@ -0,0 +1,111 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include "crypto/hash.h"
+#include "serialization/SerializationOverloads.h"
+
+namespace CryptoNote
+{
+  // Bounded map of block id to proof of work hash, oldest entries are evicted first
+  class LongHashCache {
+
+  public:
+
+    explicit LongHashCache(size_t capacity) :
+      m_capacity(capacity), m_index(m_container.get<1>()) {}
+
+    bool get(const crypto::hash& blockId, crypto::hash& longHash) const {
+      auto it = m_index.find(blockId);
+      if (it == m_index.end())
+        return false;
+
+      longHash = it->longHash;
+      return true;
+    }
+
+    void put(const crypto::hash& blockId, const crypto::hash& longHash) {
+      Entry entry = { blockId, longHash };
+      if (!m_container.push_back(entry).second)
+        return;
+
+      while (m_container.size() > m_capacity) {
+        m_container.pop_front();
+      }
+    }
+
+    size_t size() const {
+      return m_container.size();
+    }
+
+    void clear() {
+      m_container.clear();
+    }
+
+    void serialize(ISerializer& s, const std::string& name) {
+      uint8_t version = CURRENT_VERSION;
+      s(version, "version");
+      if (s.type() == ISerializer::INPUT && version != CURRENT_VERSION) {
+        m_container.clear();
+        return;
+      }
+
+      // entries are written oldest first as one binary blob, so loading restores eviction order
+      std::vector<Entry> entries;
+      if (s.type() == ISerializer::OUTPUT) {
+        entries.assign(m_container.begin(), m_container.end());
+      }
+
+      serializeAsBinary(entries, name, s);
+
+      if (s.type() == ISerializer::INPUT) {
+        m_container.clear();
+        for (const Entry& entry : entries) {
+          put(entry.blockId, entry.longHash);
+        }
+      }
+    }
+
+  private:
+
+    static const uint8_t CURRENT_VERSION = 1;
+
+    struct Entry {
+      crypto::hash blockId;
+      crypto::hash longHash;
+    };
+
+    typedef boost::multi_index_container <
+      Entry,
+      boost::multi_index::indexed_by<
+        boost::multi_index::sequenced<>,
+        boost::multi_index::hashed_unique<boost::multi_index::member<Entry, crypto::hash, &Entry::blockId>>
+      >
+    > ContainerT;
+
+    size_t m_capacity;
+    ContainerT m_container;
+    ContainerT::nth_index<1>::type& m_index;
+
+  };
+}
@@ -0,0 +1,248 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "BlockchainIndexStore.h"
+
+namespace CryptoNote {
+
+// Open addressing hash table in a memory-mapped file. Pages of the table are written back and dropped by the OS
+// under memory pressure, so resident memory of the index is bounded by what the node can spare rather than by
+// chain size. The file is scratch space, it is recreated on open and filled from the blockchain cache like memory
+// store. Growing rehashes into a sibling file, so the table alternates between two file names.
+template<class Key, class Value> class MappedIndexStore : public IBlockchainIndexStore<Key, Value> {
+public:
+  enum {
+    INITIAL_CAPACITY = 1 << 16
+  };
+
+  MappedIndexStore() : m_count(0), m_capacity(0), m_onSibling(false), m_slots(nullptr) {
+  }
+
+  MappedIndexStore(const MappedIndexStore&) = delete;
+  MappedIndexStore& operator=(const MappedIndexStore&) = delete;
+
+  ~MappedIndexStore() {
+    unmap();
+  }
+
+  // Returns false if the file cannot be created or mapped
+  bool open(const std::string& fileName) {
+    unmap();
+    m_fileName = fileName;
+    m_onSibling = false;
+    boost::system::error_code ignored;
+    boost::filesystem::remove(getTableName(true), ignored);
+    return createTable(getTableName(false), INITIAL_CAPACITY);
+  }
+
+  virtual size_t size() const override {
+    return m_count;
+  }
+
+  virtual bool contains(const Key& key) const override {
+    return m_slots[findSlot(key)].used;
+  }
+
+  virtual bool find(const Key& key, Value& value) const override {
+    const Slot& slot = m_slots[findSlot(key)];
+    if (!slot.used) {
+      return false;
+    }
+
+    value = slot.value;
+    return true;
+  }
+
+  virtual bool insert(const Key& key, const Value& value) override {
+    size_t index = findSlot(key);
+    if (m_slots[index].used) {
+      return false;
+    }
+
+    if ((m_count + 1) * 4 > m_capacity * 3) {
+      grow(m_capacity * 2);
+      index = findSlot(key);
+    }
+
+    m_slots[index].key = key;
+    m_slots[index].value = value;
+    m_slots[index].used = true;
+    ++m_count;
+    return true;
+  }
+
+  // Backward shift deletion, probe chains stay without tombstones
+  virtual bool erase(const Key& key) override {
+    size_t hole = findSlot(key);
+    if (!m_slots[hole].used) {
+      return false;
+    }
+
+    m_slots[hole].used = false;
+    --m_count;
+    for (size_t index = next(hole); m_slots[index].used; index = next(index)) {
+      size_t home = getHome(m_slots[index].key);
+      // entry moves to the hole unless its home lies cyclically in (hole, index]
+      bool staysInPlace = hole < index ? (home > hole && home <= index) : (home > hole || home <= index);
+      if (!staysInPlace) {
+        m_slots[hole] = m_slots[index];
+        m_slots[index].used = false;
+        hole = index;
+      }
+    }
+
+    return true;
+  }
+
+  virtual void clear() override {
+    unmap();
+    if (!createTable(getTableName(m_onSibling), INITIAL_CAPACITY)) {
+      throw std::runtime_error("MappedIndexStore::clear");
+    }
+  }
+
+  virtual void reserve(size_t count) override {
+    size_t capacity = m_capacity;
+    while (count * 4 > capacity * 3) {
+      capacity *= 2;
+    }
+
+    if (capacity != m_capacity) {
+      grow(capacity);
+    }
+  }
+
+  virtual void forEach(const typename IBlockchainIndexStore<Key, Value>::Visitor& visitor) const override {
+    for (size_t index = 0; index < m_capacity; ++index) {
+      if (m_slots[index].used) {
+        visitor(m_slots[index].key, m_slots[index].value);
+      }
+    }
+  }
+
+private:
+  struct Slot {
+    Key key;
+    Value value;
+    bool used;
+  };
+
+  size_t getHome(const Key& key) const {
+    return std::hash<Key>()(key) & (m_capacity - 1);
+  }
+
+  size_t next(size_t index) const {
+    return (index + 1) & (m_capacity - 1);
+  }
+
+  // slot holding the key, or the empty slot it would be inserted into
+  size_t findSlot(const Key& key) const {
+    size_t index = getHome(key);
+    while (m_slots[index].used && !(m_slots[index].key == key)) {
+      index = next(index);
+    }
+
+    return index;
+  }
+
+  std::string getTableName(bool sibling) const {
+    return sibling ? m_fileName + ".grow" : m_fileName;
+  }
+
+  bool createTable(const std::string& fileName, size_t capacity) {
+    try {
+      {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file) {
+          return false;
+        }
+      }
+
+      // file is extended with zeros, so every slot starts unused
+      boost::filesystem::resize_file(fileName, capacity * sizeof(Slot));
+      m_mapping.reset(new boost::interprocess::file_mapping(fileName.c_str(), boost::interprocess::read_write));
+      m_region.reset(new boost::interprocess::mapped_region(*m_mapping, boost::interprocess::read_write));
+    } catch (std::exception&) {
+      unmap();
+      return false;
+    }
+
+    m_slots = static_cast<Slot*>(m_region->get_address());
+    m_capacity = capacity;
+    m_count = 0;
+    return true;
+  }
+
+  void grow(size_t capacity) {
+    std::unique_ptr<boost::interprocess::file_mapping> mapping(std::move(m_mapping));
+    std::unique_ptr<boost::interprocess::mapped_region> region(std::move(m_region));
+    Slot* slots = m_slots;
+    size_t oldCapacity = m_capacity;
+    size_t count = m_count;
+
+    if (!createTable(getTableName(!m_onSibling), capacity)) {
+      m_mapping = std::move(mapping);
+      m_region = std::move(region);
+      m_slots = slots;
+      m_capacity = oldCapacity;
+      m_count = count;
+      throw std::runtime_error("MappedIndexStore::grow");
+    }
+
+    for (size_t index = 0; index < oldCapacity; ++index) {
+      if (slots[index].used) {
+        m_slots[findSlot(slots[index].key)] = slots[index];
+      }
+    }
+
+    m_count = count;
+    region.reset();
+    mapping.reset();
+    boost::system::error_code ignored;
+    boost::filesystem::remove(getTableName(m_onSibling), ignored);
+    m_onSibling = !m_onSibling;
+  }
+
+  void unmap() {
+    m_region.reset();
+    m_mapping.reset();
+    m_slots = nullptr;
+    m_capacity = 0;
+    m_count = 0;
+  }
+
+  size_t m_count;
+  size_t m_capacity;
+  std::string m_fileName;
+  bool m_onSibling;
+  Slot* m_slots;
+  std::unique_ptr<boost::interprocess::file_mapping> m_mapping;
+  std::unique_ptr<boost::interprocess::mapped_region> m_region;
+};
+
+}
@@ -0,0 +1,200 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "BlockchainIndexStore.h"
+
+namespace CryptoNote {
+
+// Open addressing table keeping the first 8 bytes of each key only, for keys which are hashes themselves. The full
+// key of an entry is resolved from its value, e.g. from blockchain, when prefixes match, so lookups of missing keys
+// don't resolve anything. An entry takes 8 bytes plus the value.
+template<class Key, class Value> class PrefixIndexStore : public IBlockchainIndexStore<Key, Value> {
+public:
+  static_assert(sizeof(Key) >= sizeof(uint64_t), "Key is shorter than prefix");
+
+  // Returns false if the key of the value is not known, the entry is then taken as not matching
+  typedef std::function<bool(const Value&, Key&)> KeyResolver;
+  typedef std::function<void(uint64_t, const Value&)> PrefixVisitor;
+
+  enum {
+    INITIAL_CAPACITY = 1024
+  };
+
+  explicit PrefixIndexStore(const KeyResolver& resolver) : m_resolver(resolver), m_count(0), m_slots(INITIAL_CAPACITY) {
+  }
+
+  static uint64_t getPrefix(const Key& key) {
+    uint64_t prefix;
+    memcpy(&prefix, &key, sizeof prefix);
+    // 0 marks an empty slot
+    return prefix != 0 ? prefix : 1;
+  }
+
+  virtual size_t size() const override {
+    return m_count;
+  }
+
+  virtual bool contains(const Key& key) const override {
+    return findSlot(key) != m_slots.size();
+  }
+
+  virtual bool find(const Key& key, Value& value) const override {
+    size_t index = findSlot(key);
+    if (index == m_slots.size()) {
+      return false;
+    }
+
+    value = m_slots[index].value;
+    return true;
+  }
+
+  virtual bool insert(const Key& key, const Value& value) override {
+    if (contains(key)) {
+      return false;
+    }
+
+    insertPrefix(getPrefix(key), value);
+    return true;
+  }
+
+  virtual bool erase(const Key& key) override {
+    size_t hole = findSlot(key);
+    if (hole == m_slots.size()) {
+      return false;
+    }
+
+    m_slots[hole].prefix = 0;
+    --m_count;
+    // backward shift deletion, an entry moves to the hole unless its home lies cyclically in (hole, index]
+    for (size_t index = next(hole); m_slots[index].prefix != 0; index = next(index)) {
+      size_t home = getHome(m_slots[index].prefix);
+      bool staysInPlace = hole < index ? (home > hole && home <= index) : (home > hole || home <= index);
+      if (!staysInPlace) {
+        m_slots[hole] = m_slots[index];
+        m_slots[index].prefix = 0;
+        hole = index;
+      }
+    }
+
+    return true;
+  }
+
+  virtual void clear() override {
+    m_slots.assign(INITIAL_CAPACITY, Slot());
+    m_count = 0;
+  }
+
+  virtual void reserve(size_t count) override {
+    size_t capacity = m_slots.size();
+    while (count * 4 > capacity * 3) {
+      capacity *= 2;
+    }
+
+    if (capacity != m_slots.size()) {
+      rehash(capacity);
+    }
+  }
+
+  // Resolves key of every entry, use forEachPrefix where prefixes are enough
+  virtual void forEach(const typename IBlockchainIndexStore<Key, Value>::Visitor& visitor) const override {
+    for (const Slot& slot : m_slots) {
+      Key key;
+      if (slot.prefix != 0 && m_resolver(slot.value, key)) {
+        visitor(key, slot.value);
+      }
+    }
+  }
+
+  void forEachPrefix(const PrefixVisitor& visitor) const {
+    for (const Slot& slot : m_slots) {
+      if (slot.prefix != 0) {
+        visitor(slot.prefix, slot.value);
+      }
+    }
+  }
+
+  // Adds entry without checking that its key is new, for restoring entries saved by forEachPrefix
+  void insertPrefix(uint64_t prefix, const Value& value) {
+    if ((m_count + 1) * 4 > m_slots.size() * 3) {
+      rehash(m_slots.size() * 2);
+    }
+
+    size_t index = getHome(prefix);
+    while (m_slots[index].prefix != 0) {
+      index = next(index);
+    }
+
+    m_slots[index].prefix = prefix;
+    m_slots[index].value = value;
+    ++m_count;
+  }
+
+private:
+  struct Slot {
+    uint64_t prefix;
+    Value value;
+
+    Slot() : prefix(0), value() {
+    }
+  };
+
+  size_t getHome(uint64_t prefix) const {
+    return static_cast<size_t>(prefix) & (m_slots.size() - 1);
+  }
+
+  size_t next(size_t index) const {
+    return (index + 1) & (m_slots.size() - 1);
+  }
+
+  // slot of the key, or m_slots.size() if the key is not stored
+  size_t findSlot(const Key& key) const {
+    uint64_t prefix = getPrefix(key);
+    for (size_t index = getHome(prefix); m_slots[index].prefix != 0; index = next(index)) {
+      Key storedKey;
+      if (m_slots[index].prefix == prefix && m_resolver(m_slots[index].value, storedKey) && storedKey == key) {
+        return index;
+      }
+    }
+
+    return m_slots.size();
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Slot> slots(capacity);
+    std::swap(slots, m_slots);
+    m_count = 0;
+    for (const Slot& slot : slots) {
+      if (slot.prefix != 0) {
+        insertPrefix(slot.prefix, slot.value);
+      }
+    }
+  }
+
+  KeyResolver m_resolver;
+  size_t m_count;
+  // power of two, at most three quarters full
+  std::vector<Slot> m_slots;
+};
+
+}
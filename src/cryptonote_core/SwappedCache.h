@@ -0,0 +1,180 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+enum class SwappedCachePolicy {
+  // least recently used item is evicted
+  LRU,
+  // 2Q of Johnson and Shasha. Items read for the first time wait in a FIFO of a quarter of the capacity, keys of items
+  // evicted from it are remembered for another half of the capacity. Only items read again within that window get into
+  // the LRU part, so a sequential scan passes through the FIFO and doesn't evict frequently read items.
+  TWO_QUEUE
+};
+
+// Items of SwappedVector and SwappedMap kept in memory. Values live in hash table nodes, so pointers to them stay valid
+// until the item is evicted or erased.
+template<class Key, class Value> class SwappedCache {
+public:
+  explicit SwappedCache(size_t capacity = 1, SwappedCachePolicy policy = SwappedCachePolicy::LRU) : m_capacity(std::max<size_t>(capacity, 1)), m_policy(policy) {
+  }
+
+  SwappedCache(const SwappedCache&) = delete;
+  SwappedCache& operator=(const SwappedCache&) = delete;
+
+  size_t size() const {
+    return m_entries.size();
+  }
+
+  size_t capacity() const {
+    return m_capacity;
+  }
+
+  SwappedCachePolicy policy() const {
+    return m_policy;
+  }
+
+  // Most items inserted in a row that don't evict each other before they are read
+  size_t freshCapacity() const {
+    return m_policy == SwappedCachePolicy::TWO_QUEUE ? std::max<size_t>(m_capacity / 4, 1) : m_capacity;
+  }
+
+  // Unlike find, doesn't count as a use of the item
+  bool contains(const Key& key) const {
+    return m_entries.count(key) != 0;
+  }
+
+  // Evicts items over the new capacity, changing policy drops the cache
+  void reset(size_t capacity, SwappedCachePolicy policy) {
+    if (policy != m_policy) {
+      clear();
+      m_policy = policy;
+    }
+
+    m_capacity = std::max<size_t>(capacity, 1);
+    while (m_entries.size() > m_capacity) {
+      evict();
+    }
+
+    trimGhosts();
+  }
+
+  // Cached value or nullptr, a hit counts as a use of the item
+  Value* find(const Key& key) {
+    auto entryIter = m_entries.find(key);
+    if (entryIter == m_entries.end()) {
+      return nullptr;
+    }
+
+    Entry& entry = entryIter->second;
+    // a hit in the FIFO is a correlated reference, it doesn't prove the item is hot
+    if (entry.queue == &m_main && entry.position != --m_main.end()) {
+      m_main.splice(m_main.end(), m_main, entry.position);
+    }
+
+    return &entry.value;
+  }
+
+  // The key must not be cached
+  Value& insert(const Key& key, Value&& value) {
+    // ghosts are looked up before eviction, which may forget the oldest of them
+    std::list<Key>* queue = &m_main;
+    if (m_policy == SwappedCachePolicy::TWO_QUEUE) {
+      auto ghostIter = m_ghostPositions.find(key);
+      if (ghostIter != m_ghostPositions.end()) {
+        m_ghosts.erase(ghostIter->second);
+        m_ghostPositions.erase(ghostIter);
+      } else {
+        queue = &m_in;
+      }
+    }
+
+    while (m_entries.size() >= m_capacity) {
+      evict();
+    }
+
+    auto entryIter = m_entries.insert(std::make_pair(key, Entry(std::move(value)))).first;
+    entryIter->second.queue = queue;
+    entryIter->second.position = queue->insert(queue->end(), key);
+    return entryIter->second.value;
+  }
+
+  void erase(const Key& key) {
+    auto entryIter = m_entries.find(key);
+    if (entryIter != m_entries.end()) {
+      entryIter->second.queue->erase(entryIter->second.position);
+      m_entries.erase(entryIter);
+    }
+  }
+
+  void clear() {
+    m_entries.clear();
+    m_in.clear();
+    m_main.clear();
+    m_ghosts.clear();
+    m_ghostPositions.clear();
+  }
+
+private:
+  struct Entry {
+    explicit Entry(Value&& value) : value(std::move(value)), queue(nullptr) {
+    }
+
+    Value value;
+    std::list<Key>* queue;
+    typename std::list<Key>::iterator position;
+  };
+
+  void evict() {
+    size_t inCapacity = std::max<size_t>(m_capacity / 4, 1);
+    if (!m_in.empty() && (m_in.size() > inCapacity || m_main.empty())) {
+      Key key = m_in.front();
+      m_in.pop_front();
+      m_entries.erase(key);
+      m_ghostPositions[key] = m_ghosts.insert(m_ghosts.end(), key);
+      trimGhosts();
+    } else {
+      m_entries.erase(m_main.front());
+      m_main.pop_front();
+    }
+  }
+
+  void trimGhosts() {
+    size_t ghostCapacity = m_policy == SwappedCachePolicy::TWO_QUEUE ? std::max<size_t>(m_capacity / 2, 1) : 0;
+    while (m_ghosts.size() > ghostCapacity) {
+      m_ghostPositions.erase(m_ghosts.front());
+      m_ghosts.pop_front();
+    }
+  }
+
+  size_t m_capacity;
+  SwappedCachePolicy m_policy;
+  std::unordered_map<Key, Entry> m_entries;
+  // FIFO of items read once, empty with LRU policy
+  std::list<Key> m_in;
+  // LRU of the rest, least recently used first
+  std::list<Key> m_main;
+  // keys of items recently evicted from m_in, oldest first
+  std::list<Key> m_ghosts;
+  std::unordered_map<Key, typename std::list<Key>::iterator> m_ghostPositions;
+};
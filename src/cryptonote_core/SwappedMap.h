@@ -20,13 +20,14 @@
 #include <cstdint>
 #include <fstream>
 #include <iomanip>
-#include <list>
 #include <unordered_map>
 #include <string>
 #include <vector>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 
+#include "SwappedCache.h"
+
 template<class Key, class T> class SwappedMap {
 private:
   struct Descriptor {
@@ -85,7 +86,7 @@ public:
   ~SwappedMap();
   //SwappedMap& operator=(const SwappedMap&) = delete;
 
-  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize);
+  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, SwappedCachePolicy cachePolicy = SwappedCachePolicy::LRU);
   void close();
 
   uint64_t size() const;
@@ -101,16 +102,12 @@ public:
 private:
   std::fstream m_itemsFile;
   std::fstream m_indexesFile;
-  size_t m_poolSize;
   std::unordered_map<Key, Descriptor> m_descriptors;
   uint64_t m_itemsFileSize;
-  std::unordered_map<Key, T> m_items;
-  std::list<Key> m_cache;
-  std::unordered_map<Key, typename std::list<Key>::iterator> m_cacheIterators;
+  SwappedCache<Key, std::pair<const Key, T>> m_cache;
   uint64_t m_cacheHits;
   uint64_t m_cacheMisses;
 
-  std::pair<const Key, T>* prepare(const Key& key);
   const std::pair<const Key, T>* load(const Key& key, uint64_t offset);
 };
 
@@ -121,7 +118,7 @@ template<class Key, class T> SwappedMap<Key, T>::~SwappedMap() {
   close();
 }
 
-template<class Key, class T> bool SwappedMap<Key, T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize) {
+template<class Key, class T> bool SwappedMap<Key, T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, SwappedCachePolicy cachePolicy) {
   if (poolSize == 0) {
     return false;
   }
@@ -183,10 +180,8 @@ template<class Key, class T> bool SwappedMap<Key, T>::open(const std::string& it
     m_itemsFileSize = 0;
   }
 
-  m_poolSize = poolSize;
-  m_items.clear();
   m_cache.clear();
-  m_cacheIterators.clear();
+  m_cache.reset(poolSize, cachePolicy);
   m_cacheHits = 0;
   m_cacheMisses = 0;
   return true;
@@ -230,9 +225,7 @@ template<class Key, class T> void SwappedMap<Key, T>::clear() {
 
   m_descriptors.clear();
   m_itemsFileSize = 0;
-  m_items.clear();
   m_cache.clear();
-  m_cacheIterators.clear();
 }
 
 template<class Key, class T> void SwappedMap<Key, T>::erase(const_iterator iterator) {
@@ -248,13 +241,8 @@ template<class Key, class T> void SwappedMap<Key, T>::erase(const_iterator itera
     throw std::runtime_error("SwappedMap::erase");
   }
 
+  m_cache.erase(descriptorsIterator->first);
   m_descriptors.erase(descriptorsIterator);
-  auto cacheIteratorsIterator = m_cacheIterators.find(descriptorsIterator->first);
-  if (cacheIteratorsIterator != m_cacheIterators.end()) {
-    m_items.erase(descriptorsIterator->first);
-    m_cache.erase(cacheIteratorsIterator->second);
-    m_cacheIterators.erase(cacheIteratorsIterator);
-  }
 }
 
 template<class Key, class T> std::pair<typename SwappedMap<Key, T>::const_iterator, bool> SwappedMap<Key, T>::insert(const std::pair<const Key, T>& value) {
@@ -311,35 +299,16 @@ template<class Key, class T> std::pair<typename SwappedMap<Key, T>::const_iterat
   auto descriptorsInsert = m_descriptors.insert(std::make_pair(value.first, descriptor));
   m_itemsFileSize = itemsFileSize;
 
-  T* newItem = &prepare(value.first)->second;
-  *newItem = value.second;
+  m_cache.erase(value.first);
+  m_cache.insert(value.first, std::pair<const Key, T>(value));
   return std::make_pair(const_iterator(this, descriptorsInsert.first), true);
 }
 
-template<class Key, class T> std::pair<const Key, T>* SwappedMap<Key, T>::prepare(const Key& key) {
-  if (m_items.size() == m_poolSize) {
-    typename std::list<Key>::iterator cacheIter = m_cache.begin();
-    m_items.erase(*cacheIter);
-    m_cacheIterators.erase(*cacheIter);
-    m_cache.erase(cacheIter);
-  }
-
-  std::pair<typename std::unordered_map<Key, T>::iterator, bool> itemInsert = m_items.insert(std::make_pair(key, T()));
-  typename std::list<Key>::iterator cacheIter = m_cache.insert(m_cache.end(), key);
-  m_cacheIterators.insert(std::make_pair(key, cacheIter));
-  return &*itemInsert.first;
-}
-
 template<class Key, class T> const std::pair<const Key, T>* SwappedMap<Key, T>::load(const Key& key, uint64_t offset) {
-  auto itemIterator = m_items.find(key);
-  if (itemIterator != m_items.end()) {
-    auto cacheIteratorsIterator = m_cacheIterators.find(key);
-    if (cacheIteratorsIterator->second != --m_cache.end()) {
-      m_cache.splice(m_cache.end(), m_cache, cacheIteratorsIterator->second);
-    }
-
+  std::pair<const Key, T>* cachedItem = m_cache.find(key);
+  if (cachedItem != nullptr) {
     ++m_cacheHits;
-    return &*itemIterator;
+    return cachedItem;
   }
 
   typename std::unordered_map<Key, Descriptor>::iterator descriptorsIterator = m_descriptors.find(key);
@@ -360,7 +329,7 @@ template<class Key, class T> const std::pair<const Key, T>* SwappedMap<Key, T>::
     throw std::runtime_error("SwappedMap::load");
   }
 
-  std::pair<const Key, T>* item = prepare(key);
+  std::pair<const Key, T>* item = &m_cache.insert(key, std::pair<const Key, T>(key, T()));
   std::swap(tempItem, item->second);
   ++m_cacheMisses;
   return item;
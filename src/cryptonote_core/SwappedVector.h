@@ -17,15 +17,34 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <list>
-#include <map>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "Common/Lz4.h"
+#include "Common/MemoryStreambuf.h"
+#include "Common/Metrics.h"
 #include "serialization/binary_archive.h"
+#include "SwappedCache.h"
+
+struct SwappedVectorCacheStatistics {
+  uint64_t hits;
+  uint64_t misses;
+  // items cached now and most items the cache keeps
+  size_t size;
+  size_t capacity;
+};
 
 template<class T> class SwappedVector {
 public:
@@ -113,20 +132,23 @@ public:
       return m_index - other.m_index;
     }
 
-    const_iterator& operator-(difference_type n) const {
+    const_iterator operator-(difference_type n) const {
       return const_iterator(m_swappedVector, m_index - n);
     }
 
+    // Returned reference stays valid until iterator is dereferenced again or destroyed
     const T& operator*() const {
-      return (*m_swappedVector)[m_index];
+      m_item = (*m_swappedVector)[m_index];
+      return *m_item;
     }
 
     const T* operator->() const {
-      return &(*m_swappedVector)[m_index];
+      return &operator*();
     }
 
     const T& operator[](difference_type offset) const {
-      return (*m_swappedVector)[m_index + offset];
+      m_item = (*m_swappedVector)[m_index + offset];
+      return *m_item;
     }
 
     std::size_t index() const {
@@ -136,6 +158,7 @@ public:
   private:
     SwappedVector* m_swappedVector;
     std::size_t m_index;
+    mutable std::shared_ptr<const T> m_item;
   };
 
   SwappedVector();
@@ -143,60 +166,145 @@ public:
   ~SwappedVector();
   //SwappedVector& operator=(const SwappedVector&) = delete;
 
-  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize);
+  // If mapItems is set, cache misses are deserialized from memory-mapped items file instead of seek and read.
+  // Mapping is used on 64-bit builds only and silently falls back to file reads if it cannot be established.
+  // If compressItems is set, items older than the last UNCOMPRESSED_TAIL_ITEMS are stored in LZ4 compressed segments
+  // of SEGMENT_ITEMS items, listed in itemFileName.segments. Existing items are compressed on open. Segments stay
+  // readable when the vector is opened without compressItems later, only no new segments are made.
+  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, bool mapItems = false, bool compressItems = false);
+  // Opens files another process writes with push_back and pop_back, the vector is only read then. Compressed files are
+  // not supported, compaction moves items the reader may be reading. Items added or replaced by the writer are seen
+  // after refresh.
+  bool openReadOnly(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, bool mapItems = false);
+  // Reads indexes again from item from, items below it are taken as unchanged. Cached items from it on are dropped,
+  // so the ones the writer popped and pushed again are read anew. Must not run concurrently with readers.
+  bool refresh(uint64_t from);
   void close();
+  bool isMapped() const;
+
+  // Cache size and policy can be changed while the vector is open, shrinking evicts items the policy values least,
+  // changing policy drops cached items. These must not run concurrently with push_back or pop_back.
+  bool setPoolSize(size_t poolSize);
+  void setCachePolicy(SwappedCachePolicy policy);
+  // A miss right after the items read on the previous miss reads up to count following items in the same read, 0 or 1
+  // disables read-ahead. Read-ahead never exceeds half of what the cache holds of items read once.
+  void setReadAhead(size_t count);
+  SwappedVectorCacheStatistics getCacheStatistics();
+  // Serialized size of an item on average, 0 if the vector is empty
+  uint64_t getAverageItemSize() const;
 
   bool empty() const;
   uint64_t size() const;
   const_iterator begin();
   const_iterator end();
-  const T& operator[](uint64_t index);
-  const T& front();
-  const T& back();
+  // Items are shared with cache, so returned item stays valid after another reader evicts it from cache
+  std::shared_ptr<const T> operator[](uint64_t index);
+  // Reads item into caller's storage bypassing cache, can be called from several threads at once.
+  // Deserialization runs in parallel, must not be mixed with push_back or pop_back.
+  void load(uint64_t index, T& item);
+  // Caches items in [begin, end) with a single read of the file, as many as fit in the cache. Callers about to walk
+  // a range call it first, so the walk is served from cache.
+  void prefetch(uint64_t begin, uint64_t end);
+  std::shared_ptr<const T> front();
+  std::shared_ptr<const T> back();
   void clear();
+  // Items are written before their indexes and both are flushed, so a reader of the files sees only whole items
   void pop_back();
   void push_back(const T& item);
-
-private:
-  struct ItemEntry;
-  struct CacheEntry;
-
-  struct ItemEntry {
-  public:
-    T item;
-    typename std::list<CacheEntry>::iterator cacheIter;
-  };
-
-  struct CacheEntry {
-  public:
-    typename std::map<uint64_t, ItemEntry>::iterator itemIter;
+  // Writes buffered items and indexes to the files, so they can be copied while the vector is open. Can run together
+  // with readers, must not be mixed with push_back or pop_back.
+  bool flush();
+
+  enum {
+    SEGMENT_ITEMS = 32,
+    // covers reorganizations, which pop and push blocks at the tail
+    UNCOMPRESSED_TAIL_ITEMS = 256,
+    // segment count, then segment count after the pending relocation, its source and destination in items file
+    SEGMENTS_HEADER_SIZE = 4 * sizeof(uint64_t)
   };
 
+private:
   std::fstream m_itemsFile;
   std::fstream m_indexesFile;
-  size_t m_poolSize;
+  // offsets and total size of items as if all were stored uncompressed
   std::vector<uint64_t> m_offsets;
   uint64_t m_itemsFileSize;
-  std::map<uint64_t, ItemEntry> m_items;
-  std::list<CacheEntry> m_cache;
+  // Items file holds compressed segments from its start, then the rest of items as is. An item below
+  // m_segmentOffsets.size() * SEGMENT_ITEMS is found in its segment, others at m_compressedSize plus their offset
+  // from the first uncompressed item. A segment that doesn't shrink is stored as is, its stored size tells.
+  // Segments file holds the segment count, a pending relocation and stored sizes of segments. Compaction and expanding
+  // write the new stored bytes past the end of items file first and record a relocation of them to their place, so a
+  // crash at any point leaves either the old layout or a relocation that is finished on open.
+  std::fstream m_segmentsFile;
+  std::vector<uint64_t> m_segmentOffsets;
+  uint64_t m_compressedSize;
+  bool m_compressItems;
+  // the last segment read, consecutive items of a segment are decompressed once
+  uint64_t m_decompressedSegment;
+  std::vector<char> m_segmentBuffer;
+  SwappedCache<uint64_t, std::shared_ptr<const T>> m_cache;
   uint64_t m_cacheHits;
   uint64_t m_cacheMisses;
-
-  T* prepare(uint64_t index);
+  // process wide totals of all vectors
+  Common::MetricCounter* m_cacheHitsMetric;
+  Common::MetricCounter* m_cacheMissesMetric;
+  // operator[] updates cache and file position, so it is serialized even when owner allows concurrent readers
+  std::mutex m_readMutex;
+  size_t m_readAhead;
+  // index following the items read on the last miss
+  uint64_t m_nextSequentialIndex;
+  std::string m_itemsFileName;
+  bool m_mapItems;
+  std::unique_ptr<boost::interprocess::file_mapping> m_itemsMapping;
+  std::unique_ptr<boost::interprocess::mapped_region> m_itemsRegion;
+
+  void prepare(uint64_t index, const std::shared_ptr<const T>& item);
+  std::shared_ptr<const T> readItems(uint64_t begin, uint64_t end);
+  const char* readRange(uint64_t begin, uint64_t end, std::vector<char>& buffer);
+  const char* readStored(uint64_t offset, uint64_t size, std::vector<char>& buffer);
+  void decompressSegment(uint64_t segment);
+  uint64_t getItemOffset(uint64_t index) const;
+  uint64_t getCompressedCount() const;
+  uint64_t getStoredSize() const;
+  bool openSegments(const std::string& segmentsFileName, bool createIfMissing);
+  void createSegments(const std::string& segmentsFileName);
+  void writeSegmentCount();
+  void compactItems();
+  void expandLastSegment();
+  void commitRelocation(uint64_t source, uint64_t destination);
+  void completeRelocation(uint64_t source, uint64_t destination);
+  bool mapItemsFile(uint64_t size);
+  void unmapItemsFile();
 };
 
-template<class T> SwappedVector<T>::SwappedVector() {
+template<class T> SwappedVector<T>::SwappedVector() :
+  m_cacheHitsMetric(&Common::MetricsRegistry::global().counter("swapped_vector_cache_hits_total", "Items served from SwappedVector caches")),
+  m_cacheMissesMetric(&Common::MetricsRegistry::global().counter("swapped_vector_cache_misses_total", "Items read from SwappedVector files")),
+  m_readAhead(16),
+  m_nextSequentialIndex(0),
+  m_compressedSize(0),
+  m_compressItems(false),
+  m_decompressedSegment(std::numeric_limits<uint64_t>::max()),
+  m_mapItems(false) {
 }
 
 template<class T> SwappedVector<T>::~SwappedVector() {
   close();
 }
 
-template<class T> bool SwappedVector<T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize) {
+template<class T> bool SwappedVector<T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, bool mapItems, bool compressItems) {
   if (poolSize == 0) {
     return false;
   }
 
+  unmapItemsFile();
+  m_itemsFileName = itemFileName;
+  // Address space of 32-bit process is too small to map the whole blockchain
+  m_mapItems = mapItems && sizeof(void*) >= 8;
+  m_compressItems = compressItems;
+  m_decompressedSegment = std::numeric_limits<uint64_t>::max();
+  m_segmentsFile.close();
+
   m_itemsFile.open(itemFileName, std::ios::in | std::ios::out | std::ios::binary);
   m_indexesFile.open(indexFileName, std::ios::in | std::ios::out | std::ios::binary);
   if (m_itemsFile && m_indexesFile) {
@@ -221,6 +329,9 @@ template<class T> bool SwappedVector<T>::open(const std::string& itemFileName, c
 
     m_offsets.swap(offsets);
     m_itemsFileSize = itemsFileSize;
+    if (!openSegments(itemFileName + ".segments", compressItems)) {
+      return false;
+    }
   } else {
     m_itemsFile.open(itemFileName, std::ios::out | std::ios::binary);
     m_itemsFile.close();
@@ -236,20 +347,131 @@ template<class T> bool SwappedVector<T>::open(const std::string& itemFileName, c
     m_indexesFile.open(indexFileName, std::ios::in | std::ios::out | std::ios::binary);
     m_offsets.clear();
     m_itemsFileSize = 0;
+    m_segmentOffsets.clear();
+    m_compressedSize = 0;
+    if (compressItems || boost::filesystem::exists(itemFileName + ".segments")) {
+      createSegments(itemFileName + ".segments");
+      if (!m_segmentsFile) {
+        return false;
+      }
+    }
+  }
+
+  m_cache.clear();
+  m_cache.reset(poolSize, m_cache.policy());
+  m_nextSequentialIndex = 0;
+  m_cacheHits = 0;
+  m_cacheMisses = 0;
+  if (m_compressItems) {
+    compactItems();
+  }
+
+  return true;
+}
+
+template<class T> bool SwappedVector<T>::openReadOnly(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, bool mapItems) {
+  if (poolSize == 0 || boost::filesystem::exists(itemFileName + ".segments")) {
+    return false;
   }
 
-  m_poolSize = poolSize;
-  m_items.clear();
+  unmapItemsFile();
+  m_itemsFileName = itemFileName;
+  m_mapItems = mapItems && sizeof(void*) >= 8;
+  m_compressItems = false;
+  m_decompressedSegment = std::numeric_limits<uint64_t>::max();
+  m_segmentsFile.close();
+  m_segmentOffsets.clear();
+  m_compressedSize = 0;
+
+  m_itemsFile.open(itemFileName, std::ios::in | std::ios::binary);
+  m_indexesFile.open(indexFileName, std::ios::in | std::ios::binary);
+  if (!m_itemsFile || !m_indexesFile) {
+    return false;
+  }
+
+  m_offsets.clear();
+  m_itemsFileSize = 0;
   m_cache.clear();
+  m_cache.reset(poolSize, m_cache.policy());
   m_cacheHits = 0;
   m_cacheMisses = 0;
+  return refresh(0);
+}
+
+template<class T> bool SwappedVector<T>::refresh(uint64_t from) {
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  // the writer extends files behind our back, end of file hit by the last read is not final
+  m_indexesFile.clear();
+  m_itemsFile.clear();
+  m_indexesFile.seekg(0);
+  uint64_t count;
+  m_indexesFile.read(reinterpret_cast<char*>(&count), sizeof count);
+  if (!m_indexesFile) {
+    return false;
+  }
+
+  from = std::min<uint64_t>(std::min<uint64_t>(from, count), m_offsets.size());
+  std::vector<uint32_t> itemSizes(static_cast<size_t>(count - from));
+  m_indexesFile.seekg(sizeof(uint64_t) + sizeof(uint32_t) * from);
+  m_indexesFile.read(reinterpret_cast<char*>(itemSizes.data()), sizeof(uint32_t) * itemSizes.size());
+  if (!m_indexesFile) {
+    return false;
+  }
+
+  for (uint64_t index = from; index < m_offsets.size(); ++index) {
+    m_cache.erase(index);
+  }
+
+  m_itemsFileSize = getItemOffset(from);
+  m_offsets.resize(static_cast<size_t>(from));
+  for (uint32_t itemSize : itemSizes) {
+    m_offsets.push_back(m_itemsFileSize);
+    m_itemsFileSize += itemSize;
+  }
+
+  m_nextSequentialIndex = 0;
   return true;
 }
 
 template<class T> void SwappedVector<T>::close() {
+  unmapItemsFile();
   std::cout << "SwappedVector cache hits: " << m_cacheHits << ", misses: " << m_cacheMisses << " (" << std::fixed << std::setprecision(2) << static_cast<double>(m_cacheMisses) / (m_cacheHits + m_cacheMisses) * 100 << "%)" << std::endl;
 }
 
+template<class T> bool SwappedVector<T>::isMapped() const {
+  return m_mapItems;
+}
+
+template<class T> bool SwappedVector<T>::setPoolSize(size_t poolSize) {
+  if (poolSize == 0) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  m_cache.reset(poolSize, m_cache.policy());
+  return true;
+}
+
+template<class T> void SwappedVector<T>::setCachePolicy(SwappedCachePolicy policy) {
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  m_cache.reset(m_cache.capacity(), policy);
+}
+
+template<class T> void SwappedVector<T>::setReadAhead(size_t count) {
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  m_readAhead = count;
+}
+
+template<class T> SwappedVectorCacheStatistics SwappedVector<T>::getCacheStatistics() {
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  SwappedVectorCacheStatistics statistics = { m_cacheHits, m_cacheMisses, m_cache.size(), m_cache.capacity() };
+  return statistics;
+}
+
+template<class T> uint64_t SwappedVector<T>::getAverageItemSize() const {
+  return m_offsets.empty() ? 0 : m_itemsFileSize / m_offsets.size();
+}
+
 template<class T> bool SwappedVector<T>::empty() const {
   return m_offsets.empty();
 }
@@ -266,43 +488,80 @@ template<class T> typename SwappedVector<T>::const_iterator SwappedVector<T>::en
   return const_iterator(this, m_offsets.size());
 }
 
-template<class T> const T& SwappedVector<T>::operator[](uint64_t index) {
-  auto itemIter = m_items.find(index);
-  if (itemIter != m_items.end()) {
-    if (itemIter->second.cacheIter != --m_cache.end()) {
-      m_cache.splice(m_cache.end(), m_cache, itemIter->second.cacheIter);
-    }
-
+template<class T> std::shared_ptr<const T> SwappedVector<T>::operator[](uint64_t index) {
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  std::shared_ptr<const T>* cachedItem = m_cache.find(index);
+  if (cachedItem != nullptr) {
     ++m_cacheHits;
-    return itemIter->second.item;
+    m_cacheHitsMetric->increment();
+    return *cachedItem;
   }
 
   if (index >= m_offsets.size()) {
     throw std::runtime_error("SwappedVector::operator[]");
   }
 
-  if (!m_itemsFile) {
-    throw std::runtime_error("SwappedVector::operator[]");
+  uint64_t end = index + 1;
+  if (index == m_nextSequentialIndex && m_readAhead > 1) {
+    uint64_t count = std::min<uint64_t>(m_readAhead, std::max<uint64_t>(m_cache.freshCapacity() / 2, 1));
+    end = std::min<uint64_t>(index + count, m_offsets.size());
   }
 
-  m_itemsFile.seekg(m_offsets[index]);
-  T tempItem;
-  binary_archive<false> archive(m_itemsFile);
-  if (!do_serialize(archive, tempItem)) {
-    throw std::runtime_error("SwappedVector::operator[]");
+  std::shared_ptr<const T> item = readItems(index, end);
+  m_nextSequentialIndex = end;
+  ++m_cacheMisses;
+  m_cacheMissesMetric->increment();
+  return item;
+}
+
+template<class T> void SwappedVector<T>::load(uint64_t index, T& item) {
+  if (index >= m_offsets.size()) {
+    throw std::runtime_error("SwappedVector::load");
   }
 
-  T* item = prepare(index);
-  std::swap(tempItem, *item);
-  ++m_cacheMisses;
-  return *item;
+  // Only locating item bytes is serialized, deserialization of several items runs in parallel in both modes
+  const char* itemData = nullptr;
+  std::vector<char> itemBuffer;
+  size_t itemSize = static_cast<size_t>(getItemOffset(index + 1) - m_offsets[index]);
+  {
+    std::lock_guard<std::mutex> lock(m_readMutex);
+    itemData = readRange(index, index + 1, itemBuffer);
+    if (index < getCompressedCount()) {
+      // decompressed segment is reused by the next read
+      itemBuffer.assign(itemData, itemData + itemSize);
+      itemData = itemBuffer.data();
+    }
+  }
+
+  Common::MemoryStreambuf buffer(itemData, itemSize);
+  std::istream stream(&buffer);
+  binary_archive<false> archive(stream);
+  if (!do_serialize(archive, item)) {
+    throw std::runtime_error("SwappedVector::load");
+  }
 }
 
-template<class T> const T& SwappedVector<T>::front() {
+template<class T> void SwappedVector<T>::prefetch(uint64_t begin, uint64_t end) {
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  end = std::min<uint64_t>(std::min<uint64_t>(end, m_offsets.size()), begin + m_cache.freshCapacity());
+  while (begin < end && m_cache.contains(begin)) {
+    ++begin;
+  }
+
+  while (begin < end && m_cache.contains(end - 1)) {
+    --end;
+  }
+
+  if (begin < end) {
+    readItems(begin, end);
+  }
+}
+
+template<class T> std::shared_ptr<const T> SwappedVector<T>::front() {
   return operator[](0);
 }
 
-template<class T> const T& SwappedVector<T>::back() {
+template<class T> std::shared_ptr<const T> SwappedVector<T>::back() {
   return operator[](m_offsets.size() - 1);
 }
 
@@ -320,8 +579,13 @@ template<class T> void SwappedVector<T>::clear() {
 
   m_offsets.clear();
   m_itemsFileSize = 0;
-  m_items.clear();
   m_cache.clear();
+  if (!m_segmentOffsets.empty()) {
+    m_segmentOffsets.clear();
+    m_compressedSize = 0;
+    m_decompressedSegment = std::numeric_limits<uint64_t>::max();
+    writeSegmentCount();
+  }
 }
 
 template<class T> void SwappedVector<T>::pop_back() {
@@ -329,6 +593,10 @@ template<class T> void SwappedVector<T>::pop_back() {
     throw std::runtime_error("SwappedVector::pop_back");
   }
 
+  if (m_offsets.size() - 1 < getCompressedCount()) {
+    expandLastSegment();
+  }
+
   m_indexesFile.seekp(0);
   uint64_t count = m_offsets.size() - 1;
   m_indexesFile.write(reinterpret_cast<char*>(&count), sizeof count);
@@ -336,13 +604,10 @@ template<class T> void SwappedVector<T>::pop_back() {
     throw std::runtime_error("SwappedVector::pop_back");
   }
 
+  m_indexesFile.flush();
   m_itemsFileSize = m_offsets.back();
   m_offsets.pop_back();
-  auto itemIter = m_items.find(m_offsets.size());
-  if (itemIter != m_items.end()) {
-    m_cache.erase(itemIter->second.cacheIter);
-    m_items.erase(itemIter);
-  }
+  m_cache.erase(m_offsets.size());
 }
 
 template<class T> void SwappedVector<T>::push_back(const T& item) {
@@ -353,13 +618,16 @@ template<class T> void SwappedVector<T>::push_back(const T& item) {
       throw std::runtime_error("SwappedVector::push_back");
     }
 
-    m_itemsFile.seekp(m_itemsFileSize);
+    uint64_t storedSize = getStoredSize();
+    m_itemsFile.seekp(storedSize);
     binary_archive<true> archive(m_itemsFile);
     if (!do_serialize(archive, *const_cast<T*>(&item))) {
       throw std::runtime_error("SwappedVector::push_back");
     }
 
-    itemsFileSize = m_itemsFile.tellp();
+    itemsFileSize = m_itemsFileSize + (static_cast<uint64_t>(m_itemsFile.tellp()) - storedSize);
+    // Mapping and readers in other processes read the file through page cache, so written data must leave stream buffer
+    m_itemsFile.flush();
   }
 
   {
@@ -377,6 +645,7 @@ template<class T> void SwappedVector<T>::push_back(const T& item) {
     m_indexesFile.seekp(0);
     uint64_t count = m_offsets.size() + 1;
     m_indexesFile.write(reinterpret_cast<char*>(&count), sizeof count);
+    m_indexesFile.flush();
     if (!m_indexesFile) {
       throw std::runtime_error("SwappedVector::push_back");
     }
@@ -385,20 +654,374 @@ template<class T> void SwappedVector<T>::push_back(const T& item) {
   m_offsets.push_back(m_itemsFileSize);
   m_itemsFileSize = itemsFileSize;
 
-  T* newItem = prepare(m_offsets.size() - 1);
-  *newItem = item;
+  prepare(m_offsets.size() - 1, std::make_shared<T>(item));
+  if (m_compressItems) {
+    compactItems();
+  }
+}
+
+template<class T> bool SwappedVector<T>::flush() {
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  m_itemsFile.flush();
+  m_indexesFile.flush();
+  if (m_segmentsFile.is_open()) {
+    m_segmentsFile.flush();
+  }
+
+  return m_itemsFile && m_indexesFile;
+}
+
+template<class T> void SwappedVector<T>::prepare(uint64_t index, const std::shared_ptr<const T>& item) {
+  m_cache.insert(index, std::shared_ptr<const T>(item));
+}
+
+// Items of the range are read with one read of the file, or straight from mapping, and cached unless they already are.
+// Returns the first item if it wasn't cached.
+template<class T> std::shared_ptr<const T> SwappedVector<T>::readItems(uint64_t begin, uint64_t end) {
+  std::vector<char> rangeBuffer;
+  const char* rangeData = readRange(begin, end, rangeBuffer);
+
+  std::shared_ptr<const T> first;
+  for (uint64_t index = begin; index < end; ++index) {
+    if (m_cache.contains(index)) {
+      continue;
+    }
+
+    Common::MemoryStreambuf buffer(rangeData + (m_offsets[index] - m_offsets[begin]), static_cast<size_t>(getItemOffset(index + 1) - m_offsets[index]));
+    std::istream stream(&buffer);
+    binary_archive<false> archive(stream);
+    std::shared_ptr<T> item = std::make_shared<T>();
+    if (!do_serialize(archive, *item)) {
+      throw std::runtime_error("SwappedVector::readItems");
+    }
+
+    prepare(index, item);
+    if (index == begin) {
+      first = item;
+    }
+  }
+
+  return first;
+}
+
+// Uncompressed bytes of items [begin, end). Points to mapping, buffer or the decompressed segment, so it is valid until
+// the next read.
+template<class T> const char* SwappedVector<T>::readRange(uint64_t begin, uint64_t end, std::vector<char>& buffer) {
+  uint64_t compressedCount = getCompressedCount();
+  uint64_t rangeBegin = m_offsets[begin];
+  uint64_t rangeEnd = getItemOffset(end);
+  if (begin >= compressedCount) {
+    return readStored(m_compressedSize + rangeBegin - getItemOffset(compressedCount), rangeEnd - rangeBegin, buffer);
+  }
+
+  uint64_t segment = begin / SEGMENT_ITEMS;
+  if (end <= (segment + 1) * SEGMENT_ITEMS) {
+    decompressSegment(segment);
+    return m_segmentBuffer.data() + (rangeBegin - getItemOffset(segment * SEGMENT_ITEMS));
+  }
+
+  std::vector<char> range;
+  range.reserve(static_cast<size_t>(rangeEnd - rangeBegin));
+  for (; segment < m_segmentOffsets.size() && segment * SEGMENT_ITEMS < end; ++segment) {
+    decompressSegment(segment);
+    uint64_t segmentBegin = getItemOffset(segment * SEGMENT_ITEMS);
+    uint64_t from = std::max(rangeBegin, segmentBegin);
+    uint64_t to = std::min(rangeEnd, getItemOffset((segment + 1) * SEGMENT_ITEMS));
+    range.insert(range.end(), m_segmentBuffer.begin() + (from - segmentBegin), m_segmentBuffer.begin() + (to - segmentBegin));
+  }
+
+  if (end > compressedCount) {
+    uint64_t from = getItemOffset(compressedCount);
+    const char* data = readStored(m_compressedSize, rangeEnd - from, buffer);
+    range.insert(range.end(), data, data + (rangeEnd - from));
+  }
+
+  buffer.swap(range);
+  return buffer.data();
+}
+
+template<class T> const char* SwappedVector<T>::readStored(uint64_t offset, uint64_t size, std::vector<char>& buffer) {
+  if (m_mapItems && ((m_itemsRegion && m_itemsRegion->get_size() >= offset + size) || mapItemsFile(getStoredSize()))) {
+    return static_cast<const char*>(m_itemsRegion->get_address()) + offset;
+  }
+
+  if (!m_itemsFile) {
+    throw std::runtime_error("SwappedVector::readStored");
+  }
+
+  buffer.resize(static_cast<size_t>(size));
+  m_itemsFile.seekg(offset);
+  m_itemsFile.read(buffer.data(), buffer.size());
+  if (!m_itemsFile) {
+    throw std::runtime_error("SwappedVector::readStored");
+  }
+
+  return buffer.data();
+}
+
+template<class T> void SwappedVector<T>::decompressSegment(uint64_t segment) {
+  if (segment == m_decompressedSegment) {
+    return;
+  }
+
+  uint64_t storedEnd = segment + 1 < m_segmentOffsets.size() ? m_segmentOffsets[segment + 1] : m_compressedSize;
+  std::vector<char> storedBuffer;
+  const char* stored = readStored(m_segmentOffsets[segment], storedEnd - m_segmentOffsets[segment], storedBuffer);
+  size_t storedSize = static_cast<size_t>(storedEnd - m_segmentOffsets[segment]);
+  size_t size = static_cast<size_t>(getItemOffset((segment + 1) * SEGMENT_ITEMS) - getItemOffset(segment * SEGMENT_ITEMS));
+  m_decompressedSegment = std::numeric_limits<uint64_t>::max();
+  m_segmentBuffer.resize(size);
+  if (storedSize == size) {
+    std::copy(stored, stored + size, m_segmentBuffer.begin());
+  } else if (!Common::lz4Decompress(stored, storedSize, m_segmentBuffer.data(), size)) {
+    throw std::runtime_error("SwappedVector::decompressSegment");
+  }
+
+  m_decompressedSegment = segment;
+}
+
+template<class T> uint64_t SwappedVector<T>::getItemOffset(uint64_t index) const {
+  return index < m_offsets.size() ? m_offsets[index] : m_itemsFileSize;
 }
 
-template<class T> T* SwappedVector<T>::prepare(uint64_t index) {
-  if (m_items.size() == m_poolSize) {
-    auto cacheIter = m_cache.begin();
-    m_items.erase(cacheIter->itemIter);
-    m_cache.erase(cacheIter);
+template<class T> uint64_t SwappedVector<T>::getCompressedCount() const {
+  return m_segmentOffsets.size() * SEGMENT_ITEMS;
+}
+
+template<class T> uint64_t SwappedVector<T>::getStoredSize() const {
+  return m_compressedSize + m_itemsFileSize - getItemOffset(getCompressedCount());
+}
+
+template<class T> bool SwappedVector<T>::openSegments(const std::string& segmentsFileName, bool createIfMissing) {
+  m_segmentOffsets.clear();
+  m_compressedSize = 0;
+  m_segmentsFile.open(segmentsFileName, std::ios::in | std::ios::out | std::ios::binary);
+  if (!m_segmentsFile) {
+    m_segmentsFile.close();
+    if (!createIfMissing) {
+      return true;
+    }
+
+    createSegments(segmentsFileName);
+    return static_cast<bool>(m_segmentsFile);
   }
 
-  auto itemIter = m_items.insert(std::make_pair(index, ItemEntry()));
-  CacheEntry cacheEntry = { itemIter.first };
-  auto cacheIter = m_cache.insert(m_cache.end(), cacheEntry);
-  itemIter.first->second.cacheIter = cacheIter;
-  return &itemIter.first->second.item;
+  uint64_t header[4];
+  m_segmentsFile.read(reinterpret_cast<char*>(header), sizeof header);
+  uint64_t count = header[0];
+  uint64_t pendingCount = header[1];
+  uint64_t pendingSource = header[2];
+  uint64_t pendingDestination = header[3];
+  if (pendingSource != 0) {
+    count = pendingCount;
+  }
+
+  if (!m_segmentsFile || count > m_offsets.size() / SEGMENT_ITEMS) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    uint32_t storedSize;
+    m_segmentsFile.read(reinterpret_cast<char*>(&storedSize), sizeof storedSize);
+    if (!m_segmentsFile) {
+      return false;
+    }
+
+    m_segmentOffsets.push_back(m_compressedSize);
+    m_compressedSize += storedSize;
+  }
+
+  if (pendingSource != 0) {
+    // the last compaction or expanding was interrupted, its stored bytes are moved in place before anything is read
+    try {
+      completeRelocation(pendingSource, pendingDestination);
+    } catch (std::exception&) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template<class T> void SwappedVector<T>::createSegments(const std::string& segmentsFileName) {
+  m_segmentsFile.open(segmentsFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+  m_segmentsFile.close();
+  m_segmentsFile.open(segmentsFileName, std::ios::in | std::ios::out | std::ios::binary);
+  uint64_t header[4] = { 0, 0, 0, 0 };
+  m_segmentsFile.write(reinterpret_cast<char*>(header), sizeof header);
+  m_segmentsFile.flush();
+}
+
+template<class T> void SwappedVector<T>::writeSegmentCount() {
+  m_segmentsFile.seekp(0);
+  uint64_t count = m_segmentOffsets.size();
+  m_segmentsFile.write(reinterpret_cast<char*>(&count), sizeof count);
+  m_segmentsFile.flush();
+  if (!m_segmentsFile) {
+    throw std::runtime_error("SwappedVector::writeSegmentCount");
+  }
+}
+
+// Compresses segments older than the uncompressed tail. The segments and the tail after them are written past the end
+// of items file, then relocated over the items the segments were made of.
+template<class T> void SwappedVector<T>::compactItems() {
+  uint64_t segmentCount = m_offsets.size() > UNCOMPRESSED_TAIL_ITEMS ? (m_offsets.size() - UNCOMPRESSED_TAIL_ITEMS) / SEGMENT_ITEMS : 0;
+  if (segmentCount <= m_segmentOffsets.size()) {
+    return;
+  }
+
+  if (!m_itemsFile || !m_segmentsFile) {
+    throw std::runtime_error("SwappedVector::compactItems");
+  }
+
+  uint64_t storedSize = getStoredSize();
+  uint64_t readOffset = m_compressedSize;
+  uint64_t writeOffset = storedSize;
+  std::vector<uint64_t> segmentOffsets;
+  std::vector<char> segmentData;
+  std::vector<char> compressed;
+  for (uint64_t segment = m_segmentOffsets.size(); segment < segmentCount; ++segment) {
+    segmentData.resize(static_cast<size_t>(getItemOffset((segment + 1) * SEGMENT_ITEMS) - getItemOffset(segment * SEGMENT_ITEMS)));
+    m_itemsFile.seekg(readOffset);
+    m_itemsFile.read(segmentData.data(), segmentData.size());
+    readOffset += segmentData.size();
+
+    Common::lz4Compress(segmentData.data(), segmentData.size(), compressed);
+    const std::vector<char>& stored = compressed.size() < segmentData.size() ? compressed : segmentData;
+    m_itemsFile.seekp(writeOffset);
+    m_itemsFile.write(stored.data(), stored.size());
+    // sizes past the segment count are ignored until the relocation is recorded
+    m_segmentsFile.seekp(SEGMENTS_HEADER_SIZE + sizeof(uint32_t) * segment);
+    uint32_t size = static_cast<uint32_t>(stored.size());
+    m_segmentsFile.write(reinterpret_cast<char*>(&size), sizeof size);
+    if (!m_itemsFile || !m_segmentsFile) {
+      throw std::runtime_error("SwappedVector::compactItems");
+    }
+
+    segmentOffsets.push_back(m_compressedSize + (writeOffset - storedSize));
+    writeOffset += stored.size();
+  }
+
+  std::vector<char> tail(static_cast<size_t>(storedSize - readOffset));
+  m_itemsFile.seekg(readOffset);
+  m_itemsFile.read(tail.data(), tail.size());
+  m_itemsFile.seekp(writeOffset);
+  m_itemsFile.write(tail.data(), tail.size());
+  m_itemsFile.flush();
+  m_segmentsFile.flush();
+  if (!m_itemsFile || !m_segmentsFile) {
+    throw std::runtime_error("SwappedVector::compactItems");
+  }
+
+  uint64_t destination = m_compressedSize;
+  m_segmentOffsets.insert(m_segmentOffsets.end(), segmentOffsets.begin(), segmentOffsets.end());
+  m_compressedSize += writeOffset - storedSize;
+  commitRelocation(storedSize, destination);
+}
+
+// Stores the last segment uncompressed again, so its items can be popped. The segment and the tail are written past
+// the end of items file, far enough for the relocation not to overwrite what it has still to read.
+template<class T> void SwappedVector<T>::expandLastSegment() {
+  uint64_t segment = m_segmentOffsets.size() - 1;
+  decompressSegment(segment);
+  std::vector<char> segmentData;
+  segmentData.swap(m_segmentBuffer);
+  m_decompressedSegment = std::numeric_limits<uint64_t>::max();
+
+  uint64_t storedSize = getStoredSize();
+  uint64_t destination = m_segmentOffsets[segment];
+  std::vector<char> tail(static_cast<size_t>(storedSize - m_compressedSize));
+  m_itemsFile.seekg(m_compressedSize);
+  m_itemsFile.read(tail.data(), tail.size());
+  uint64_t source = std::max<uint64_t>(storedSize, destination + segmentData.size() + tail.size());
+  m_itemsFile.seekp(source);
+  m_itemsFile.write(segmentData.data(), segmentData.size());
+  m_itemsFile.write(tail.data(), tail.size());
+  m_itemsFile.flush();
+  if (!m_itemsFile) {
+    throw std::runtime_error("SwappedVector::expandLastSegment");
+  }
+
+  m_compressedSize = destination;
+  m_segmentOffsets.pop_back();
+  commitRelocation(source, destination);
+}
+
+// Records that stored bytes from source belong at destination and the segment count becomes the current one, then
+// moves them. The source is written last, it makes the record valid.
+template<class T> void SwappedVector<T>::commitRelocation(uint64_t source, uint64_t destination) {
+  uint64_t pending[3] = { m_segmentOffsets.size(), 0, destination };
+  m_segmentsFile.seekp(sizeof(uint64_t));
+  m_segmentsFile.write(reinterpret_cast<char*>(pending), sizeof pending);
+  m_segmentsFile.flush();
+  m_segmentsFile.seekp(2 * sizeof(uint64_t));
+  m_segmentsFile.write(reinterpret_cast<char*>(&source), sizeof source);
+  m_segmentsFile.flush();
+  if (!m_segmentsFile) {
+    throw std::runtime_error("SwappedVector::commitRelocation");
+  }
+
+  completeRelocation(source, destination);
+}
+
+// Moves stored bytes past the segments from source to destination, then updates the segment count and clears the
+// record. Bytes at source are never overwritten before they are read, so it can be repeated after a crash.
+template<class T> void SwappedVector<T>::completeRelocation(uint64_t source, uint64_t destination) {
+  uint64_t size = getStoredSize() - destination;
+  std::vector<char> chunk;
+  for (uint64_t moved = 0; moved < size;) {
+    chunk.resize(static_cast<size_t>(std::min<uint64_t>(size - moved, 1 << 20)));
+    m_itemsFile.seekg(source + moved);
+    m_itemsFile.read(chunk.data(), chunk.size());
+    m_itemsFile.seekp(destination + moved);
+    m_itemsFile.write(chunk.data(), chunk.size());
+    if (!m_itemsFile) {
+      throw std::runtime_error("SwappedVector::completeRelocation");
+    }
+
+    moved += chunk.size();
+  }
+
+  m_itemsFile.flush();
+  if (!m_itemsFile) {
+    throw std::runtime_error("SwappedVector::completeRelocation");
+  }
+
+  m_decompressedSegment = std::numeric_limits<uint64_t>::max();
+  writeSegmentCount();
+  uint64_t noSource = 0;
+  m_segmentsFile.seekp(2 * sizeof(uint64_t));
+  m_segmentsFile.write(reinterpret_cast<char*>(&noSource), sizeof noSource);
+  m_segmentsFile.flush();
+  if (!m_segmentsFile) {
+    throw std::runtime_error("SwappedVector::completeRelocation");
+  }
+
+  // space is given back when the file isn't mapped elsewhere, otherwise the next relocation retries
+  boost::system::error_code ignored;
+  boost::filesystem::resize_file(m_itemsFileName, getStoredSize(), ignored);
+}
+
+template<class T> bool SwappedVector<T>::mapItemsFile(uint64_t size) {
+  unmapItemsFile();
+  if (size == 0) {
+    return false;
+  }
+
+  try {
+    m_itemsMapping.reset(new boost::interprocess::file_mapping(m_itemsFileName.c_str(), boost::interprocess::read_only));
+    m_itemsRegion.reset(new boost::interprocess::mapped_region(*m_itemsMapping, boost::interprocess::read_only, 0, static_cast<size_t>(size)));
+  } catch (boost::interprocess::interprocess_exception& e) {
+    std::cout << "SwappedVector failed to map items file, falling back to file reads: " << e.what() << std::endl;
+    unmapItemsFile();
+    m_mapItems = false;
+    return false;
+  }
+
+  return true;
+}
+
+template<class T> void SwappedVector<T>::unmapItemsFile() {
+  m_itemsRegion.reset();
+  m_itemsMapping.reset();
 }
@@ -0,0 +1,115 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TrackingKeysFilter.h"
+
+#include <memory>
+#include <unordered_map>
+
+#include "cryptonote_core/cryptonote_format_utils.h"
+
+namespace CryptoNote
+{
+  TrackingKeysFilter::TrackingKeysFilter(const std::vector<TrackingKey>& keys) {
+    // secret keys are grouped by their bytes, public key has the same size and is hashable
+    std::unordered_map<crypto::public_key, size_t> viewKeyIndexes;
+    for (const TrackingKey& key : keys) {
+      const crypto::public_key& viewKeyBytes = reinterpret_cast<const crypto::public_key&>(key.viewSecretKey);
+      auto it = viewKeyIndexes.find(viewKeyBytes);
+      if (it == viewKeyIndexes.end()) {
+        it = viewKeyIndexes.emplace(viewKeyBytes, m_viewSecretKeys.size()).first;
+        m_viewSecretKeys.push_back(key.viewSecretKey);
+        m_spendPublicKeys.emplace_back();
+      }
+
+      m_spendPublicKeys[it->second].insert(key.spendPublicKey);
+    }
+  }
+
+  bool TrackingKeysFilter::findOutputs(const Transaction& tx, std::vector<size_t>& outputs) const {
+    if (m_viewSecretKeys.empty()) {
+      return false;
+    }
+
+    std::vector<crypto::public_key> keys;
+    std::vector<size_t> keyIndexes;
+    std::vector<size_t> outputIndexes;
+    // key outputs are derived with the number of keys before them, keys of multisignature outputs with the output index
+    for (size_t i = 0; i < tx.vout.size(); ++i) {
+      const TransactionOutputTarget& target = tx.vout[i].target;
+      if (target.type() == typeid(TransactionOutputToKey)) {
+        keyIndexes.push_back(keys.size());
+        keys.push_back(boost::get<TransactionOutputToKey>(target).key);
+        outputIndexes.push_back(i);
+      } else if (target.type() == typeid(TransactionOutputMultisignature)) {
+        for (const crypto::public_key& key : boost::get<TransactionOutputMultisignature>(target).keys) {
+          keyIndexes.push_back(i);
+          keys.push_back(key);
+          outputIndexes.push_back(i);
+        }
+      }
+    }
+
+    if (keys.empty()) {
+      return false;
+    }
+
+    crypto::public_key txPublicKey = get_tx_pub_key_from_extra(tx);
+    std::vector<crypto::key_derivation> derivations(m_viewSecretKeys.size());
+    if (txPublicKey == null_pkey || !crypto::generate_key_derivations(txPublicKey, m_viewSecretKeys.data(),
+      m_viewSecretKeys.size(), derivations.data())) {
+      return false;
+    }
+
+    std::vector<crypto::public_key> candidates(keys.size());
+    std::unique_ptr<bool[]> valid(new bool[keys.size()]);
+    std::vector<bool> found(tx.vout.size(), false);
+    for (size_t viewKeyIndex = 0; viewKeyIndex < derivations.size(); ++viewKeyIndex) {
+      const std::unordered_set<crypto::public_key>& spendKeys = m_spendPublicKeys[viewKeyIndex];
+      if (spendKeys.size() == 1) {
+        if (!crypto::derive_public_keys(derivations[viewKeyIndex], keyIndexes.data(), keyIndexes.size(), *spendKeys.begin(),
+          candidates.data())) {
+          continue;
+        }
+
+        for (size_t i = 0; i < keys.size(); ++i) {
+          if (candidates[i] == keys[i]) {
+            found[outputIndexes[i]] = true;
+          }
+        }
+      } else {
+        crypto::underive_public_keys(derivations[viewKeyIndex], keyIndexes.data(), keys.data(), keys.size(), candidates.data(),
+          valid.get());
+        for (size_t i = 0; i < keys.size(); ++i) {
+          if (valid[i] && spendKeys.count(candidates[i]) != 0) {
+            found[outputIndexes[i]] = true;
+          }
+        }
+      }
+    }
+
+    bool anyFound = false;
+    for (size_t i = 0; i < found.size(); ++i) {
+      if (found[i]) {
+        outputs.push_back(i);
+        anyFound = true;
+      }
+    }
+
+    return anyFound;
+  }
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_core/cryptonote_basic.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+
+namespace CryptoNote
+{
+  // Finds outputs of transactions sent to addresses given by tracking keys. Derivations for all view keys of a
+  // transaction are generated together, addresses sharing a view key are matched in one pass over the outputs.
+  class TrackingKeysFilter {
+
+  public:
+
+    explicit TrackingKeysFilter(const std::vector<TrackingKey>& keys);
+
+    // Appends indexes of transaction outputs to tracked addresses, returns false if there are none
+    bool findOutputs(const Transaction& tx, std::vector<size_t>& outputs) const;
+
+    bool empty() const {
+      return m_viewSecretKeys.empty();
+    }
+
+  private:
+
+    std::vector<crypto::secret_key> m_viewSecretKeys;
+    // spend public keys of addresses with the view key at the same position
+    std::vector<std::unordered_set<crypto::public_key>> m_spendPublicKeys;
+
+  };
+}
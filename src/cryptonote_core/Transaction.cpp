@@ -139,6 +139,7 @@ namespace CryptoNote {
     TransactionImpl();
     TransactionImpl(const Blob& txblob);
     TransactionImpl(const CryptoNote::Transaction& tx);
+    TransactionImpl(CryptoNote::Transaction&& tx, const crypto::hash& txHash);
   
     // ITransactionReader
     virtual Hash getTransactionHash() const override;
@@ -189,6 +190,7 @@ namespace CryptoNote {
     virtual size_t addOutput(uint64_t amount, const std::vector<AccountAddress>& to, uint32_t requiredSignatures) override;
 
     virtual void signInputKey(size_t input, const TransactionTypes::InputKeyInfo& info, const TransactionTypes::KeyPair& ephKeys) override;
+    virtual void signInputKeys(const std::vector<std::pair<TransactionTypes::InputKeyInfo, TransactionTypes::KeyPair>>& inputs) override;
     virtual void signInputMultisignature(size_t input, const PublicKey& sourceTransactionKey, size_t outputIndex, const AccountKeys& accountKeys) override;
 
     // secret key
@@ -197,8 +199,12 @@ namespace CryptoNote {
 
   private:
 
+    // prefix changed, both hashes are recomputed
     void invalidateHash();
+    // only signatures changed, prefix hash stays valid
+    void invalidateTransactionHash();
 
+    void signInputKey(size_t index, const crypto::hash& prefixHash, const TransactionTypes::InputKeyInfo& info, const TransactionTypes::KeyPair& ephKeys);
     std::vector<crypto::signature>& getSignatures(size_t input);
 
     const crypto::secret_key& txSecretKey() const {
@@ -217,6 +223,7 @@ namespace CryptoNote {
     CryptoNote::Transaction transaction;
     boost::optional<crypto::secret_key> secretKey;
     mutable boost::optional<crypto::hash> transactionHash;
+    mutable boost::optional<crypto::hash> transactionPrefixHash;
     TransactionExtra extra;
   };
 
@@ -237,6 +244,10 @@ namespace CryptoNote {
     return std::unique_ptr<ITransaction>(new TransactionImpl(tx));
   }
 
+  std::unique_ptr<ITransaction> createTransaction(CryptoNote::Transaction&& tx, const crypto::hash& transactionHash) {
+    return std::unique_ptr<ITransaction>(new TransactionImpl(std::move(tx), transactionHash));
+  }
+
   TransactionImpl::TransactionImpl() {   
     CryptoNote::KeyPair txKeys(CryptoNote::KeyPair::generate());
 
@@ -251,7 +262,7 @@ namespace CryptoNote {
   }
 
   TransactionImpl::TransactionImpl(const Blob& data) {
-    CryptoNote::blobdata blob(reinterpret_cast<const char*>(data.data()), data.size());
+    Common::StringView blob(reinterpret_cast<const char*>(data.data()), data.size());
     if (!parse_and_validate_tx_from_blob(blob, transaction)) {
       throw std::runtime_error("Invalid transaction data");
     }
@@ -264,7 +275,19 @@ namespace CryptoNote {
     extra.parse(transaction.extra);
   }
 
+  TransactionImpl::TransactionImpl(CryptoNote::Transaction&& tx, const crypto::hash& txHash) : transaction(std::move(tx)) {
+    extra.parse(transaction.extra);
+    transactionHash = txHash;
+  }
+
   void TransactionImpl::invalidateHash() {
+    invalidateTransactionHash();
+    if (transactionPrefixHash.is_initialized()) {
+      transactionPrefixHash = decltype(transactionPrefixHash)();
+    }
+  }
+
+  void TransactionImpl::invalidateTransactionHash() {
     if (transactionHash.is_initialized()) {
       transactionHash = decltype(transactionHash)();
     }
@@ -279,8 +302,11 @@ namespace CryptoNote {
   }
 
   Hash TransactionImpl::getTransactionPrefixHash() const {
-    auto hash = get_transaction_prefix_hash(transaction);
-    return reinterpret_cast<const Hash&>(hash);
+    if (!transactionPrefixHash.is_initialized()) {
+      transactionPrefixHash = get_transaction_prefix_hash(transaction);
+    }
+
+    return reinterpret_cast<const Hash&>(transactionPrefixHash.get());
   }
 
   PublicKey TransactionImpl::getTransactionPublicKey() const {
@@ -397,28 +423,39 @@ namespace CryptoNote {
   }
 
   void TransactionImpl::signInputKey(size_t index, const TransactionTypes::InputKeyInfo& info, const TransactionTypes::KeyPair& ephKeys) {
-    const auto& input = boost::get<TransactionInputToKey>(getInputChecked(transaction, index, InputType::Key));
     Hash prefixHash = getTransactionPrefixHash();
+    signInputKey(index, reinterpret_cast<const crypto::hash&>(prefixHash), info, ephKeys);
+    invalidateTransactionHash();
+  }
 
-    std::vector<crypto::signature> signatures;
-    std::vector<const crypto::public_key*> keysPtrs;
+  void TransactionImpl::signInputKeys(const std::vector<std::pair<TransactionTypes::InputKeyInfo, TransactionTypes::KeyPair>>& inputs) {
+    Hash prefixHash = getTransactionPrefixHash();
+    for (size_t index = 0; index < inputs.size(); ++index) {
+      signInputKey(index, reinterpret_cast<const crypto::hash&>(prefixHash), inputs[index].first, inputs[index].second);
+    }
 
+    invalidateTransactionHash();
+  }
+
+  void TransactionImpl::signInputKey(size_t index, const crypto::hash& prefixHash, const TransactionTypes::InputKeyInfo& info, const TransactionTypes::KeyPair& ephKeys) {
+    const auto& input = boost::get<TransactionInputToKey>(getInputChecked(transaction, index, InputType::Key));
+
+    std::vector<const crypto::public_key*> keysPtrs;
+    keysPtrs.reserve(info.outputs.size());
     for (const auto& o : info.outputs) {
       keysPtrs.push_back(reinterpret_cast<const crypto::public_key*>(&o.targetKey));
     }
 
+    std::vector<crypto::signature>& signatures = getSignatures(index);
     signatures.resize(keysPtrs.size());
 
     generate_ring_signature(
-      reinterpret_cast<const crypto::hash&>(prefixHash),
+      prefixHash,
       reinterpret_cast<const crypto::key_image&>(input.keyImage),
       keysPtrs,
       reinterpret_cast<const crypto::secret_key&>(ephKeys.secretKey),
       info.realOutput.transactionIndex,
       signatures.data());
-
-    getSignatures(index) = signatures;
-    invalidateHash();
   }
 
   void TransactionImpl::signInputMultisignature(size_t index, const PublicKey& sourceTransactionKey, size_t outputIndex, const AccountKeys& accountKeys) {
@@ -443,7 +480,7 @@ namespace CryptoNote {
       ephemeralPublicKey, ephemeralSecretKey, signature);
 
     getSignatures(index).push_back(signature);
-    invalidateHash();
+    invalidateTransactionHash();
   }
 
   std::vector<crypto::signature>& TransactionImpl::getSignatures(size_t input) {
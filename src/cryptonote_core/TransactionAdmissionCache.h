@@ -0,0 +1,109 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include "crypto/hash.h"
+
+namespace CryptoNote
+{
+  // Bounded memory of recently seen transaction blobs keyed by blob hash, so a transaction relayed by several peers
+  // is parsed and validated once. Accepted blobs remember transaction id, rejected ones are forgotten on demand,
+  // since blockchain change can make them valid. Oldest entries are evicted first.
+  class TransactionAdmissionCache {
+
+  public:
+
+    explicit TransactionAdmissionCache(size_t capacity) :
+      m_capacity(capacity), m_index(m_container.get<1>()) {}
+
+    bool getAccepted(const crypto::hash& blobHash, crypto::hash& transactionId) const {
+      auto it = m_index.find(blobHash);
+      if (it == m_index.end() || !it->accepted)
+        return false;
+
+      transactionId = it->transactionId;
+      return true;
+    }
+
+    bool isRejected(const crypto::hash& blobHash) const {
+      auto it = m_index.find(blobHash);
+      return it != m_index.end() && !it->accepted;
+    }
+
+    void addAccepted(const crypto::hash& blobHash, const crypto::hash& transactionId) {
+      add(Entry{ blobHash, transactionId, true });
+    }
+
+    void addRejected(const crypto::hash& blobHash) {
+      add(Entry{ blobHash, crypto::hash(), false });
+    }
+
+    void clearRejected() {
+      for (auto it = m_container.begin(); it != m_container.end();) {
+        if (it->accepted) {
+          ++it;
+        } else {
+          it = m_container.erase(it);
+        }
+      }
+    }
+
+    size_t size() const {
+      return m_container.size();
+    }
+
+  private:
+
+    struct Entry {
+      crypto::hash blobHash;
+      crypto::hash transactionId;
+      bool accepted;
+    };
+
+    void add(const Entry& entry) {
+      auto it = m_index.find(entry.blobHash);
+      if (it != m_index.end()) {
+        m_index.replace(it, entry);
+        return;
+      }
+
+      m_container.push_back(entry);
+      while (m_container.size() > m_capacity) {
+        m_container.pop_front();
+      }
+    }
+
+    typedef boost::multi_index_container <
+      Entry,
+      boost::multi_index::indexed_by<
+        boost::multi_index::sequenced<>,
+        boost::multi_index::hashed_unique<boost::multi_index::member<Entry, crypto::hash, &Entry::blobHash>>
+      >
+    > ContainerT;
+
+    size_t m_capacity;
+    ContainerT m_container;
+    ContainerT::nth_index<1>::type& m_index;
+
+  };
+}
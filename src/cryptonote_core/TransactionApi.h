@@ -19,6 +19,7 @@
 
 #include <memory>
 #include "ITransaction.h"
+#include "crypto/hash.h"
 
 namespace CryptoNote {
   struct Transaction;
@@ -28,4 +29,6 @@ namespace CryptoNote {
   std::unique_ptr<ITransaction> createTransaction();
   std::unique_ptr<ITransaction> createTransaction(const Blob& transactionBlob);
   std::unique_ptr<ITransaction> createTransaction(const CryptoNote::Transaction& tx);
+  // hash is known to the caller, the transaction isn't serialized to compute it
+  std::unique_ptr<ITransaction> createTransaction(CryptoNote::Transaction&& tx, const crypto::hash& transactionHash);
 }
@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <ctime>
 
+#include "cryptonote_core/BlockHeaderColumns.h"
 #include "cryptonote_core/Currency.h"
 #include "cryptonote_config.h"
 #include <Logging/LoggerRef.h>
@@ -35,6 +36,30 @@ namespace CryptoNote {
 
   static_assert(CryptoNote::UpgradeDetectorBase::UNDEF_HEIGHT == UINT64_C(0xFFFFFFFFFFFFFFFF), "UpgradeDetectorBase::UNDEF_HEIGHT has invalid value");
 
+  // Versions of blocks of a chain given as a sequence of block entries. Blocks are read through iterators, which keep
+  // items of SwappedVector alive while they are used
+  template <typename BC>
+  struct BlockVersionReader {
+    static uint8_t majorVersion(const BC& blockchain, uint64_t height) {
+      return (blockchain.begin() + height)->bl.majorVersion;
+    }
+
+    static uint8_t minorVersion(const BC& blockchain, uint64_t height) {
+      return (blockchain.begin() + height)->bl.minorVersion;
+    }
+  };
+
+  template <>
+  struct BlockVersionReader<BlockHeaderColumns> {
+    static uint8_t majorVersion(const BlockHeaderColumns& blockchain, uint64_t height) {
+      return blockchain.majorVersion(height);
+    }
+
+    static uint8_t minorVersion(const BlockHeaderColumns& blockchain, uint64_t height) {
+      return blockchain.minorVersion(height);
+    }
+  };
+
   template <typename BC>
   class BasicUpgradeDetector : public UpgradeDetectorBase {
   public:
@@ -50,14 +75,12 @@ namespace CryptoNote {
         if (m_blockchain.empty()) {
           m_votingCompleteHeight = UNDEF_HEIGHT;
 
-        } else if (m_targetVersion - 1 == m_blockchain.back().bl.majorVersion) {
+        } else if (m_targetVersion - 1 == blockMajorVersion(m_blockchain.size() - 1)) {
           m_votingCompleteHeight = findVotingCompleteHeight(m_blockchain.size() - 1);
 
-        } else if (m_targetVersion <= m_blockchain.back().bl.majorVersion) {
-          auto it = std::lower_bound(m_blockchain.begin(), m_blockchain.end(), m_targetVersion,
-            [](const typename BC::value_type& b, uint8_t v) { return b.bl.majorVersion < v; });
-          if (!(it != m_blockchain.end() && it->bl.majorVersion == m_targetVersion)) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: upgrade height isn't found"; return false; }
-          uint64_t upgradeHeight = it - m_blockchain.begin();
+        } else if (m_targetVersion <= blockMajorVersion(m_blockchain.size() - 1)) {
+          uint64_t upgradeHeight = findFirstBlockOfTargetVersion();
+          if (!(upgradeHeight != m_blockchain.size() && blockMajorVersion(upgradeHeight) == m_targetVersion)) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: upgrade height isn't found"; return false; }
           m_votingCompleteHeight = findVotingCompleteHeight(upgradeHeight);
           if (!(m_votingCompleteHeight != UNDEF_HEIGHT)) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: voting complete height isn't found, upgrade height = " << upgradeHeight; return false; }
 
@@ -66,14 +89,14 @@ namespace CryptoNote {
         }
       } else if (!m_blockchain.empty()) {
         if (m_blockchain.size() <= m_currency.upgradeHeight() + 1) {
-          if (!(m_blockchain.back().bl.majorVersion == m_targetVersion - 1)) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: block at height " << (m_blockchain.size() - 1) << " has invalid version " <<
-            static_cast<int>(m_blockchain.back().bl.majorVersion) << ", expected " << static_cast<int>(m_targetVersion); return false; }
+          if (!(blockMajorVersion(m_blockchain.size() - 1) == m_targetVersion - 1)) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: block at height " << (m_blockchain.size() - 1) << " has invalid version " <<
+            static_cast<int>(blockMajorVersion(m_blockchain.size() - 1)) << ", expected " << static_cast<int>(m_targetVersion); return false; }
         } else {
-          int blockVersionAtUpgradeHeight = m_blockchain[m_currency.upgradeHeight()].bl.majorVersion;
+          int blockVersionAtUpgradeHeight = blockMajorVersion(m_currency.upgradeHeight());
           if (!(blockVersionAtUpgradeHeight == m_targetVersion - 1)) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: block at height " << m_currency.upgradeHeight() << " has invalid version " <<
             blockVersionAtUpgradeHeight << ", expected " << static_cast<int>(m_targetVersion - 1); return false; }
 
-          int blockVersionAfterUpgradeHeight = m_blockchain[m_currency.upgradeHeight() + 1].bl.majorVersion;
+          int blockVersionAfterUpgradeHeight = blockMajorVersion(m_currency.upgradeHeight() + 1);
           if (!(blockVersionAfterUpgradeHeight == m_targetVersion)) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: block at height " << (m_currency.upgradeHeight() + 1) << " has invalid version " <<
             blockVersionAfterUpgradeHeight << ", expected " << static_cast<int>(m_targetVersion); return false; }
         }
@@ -98,27 +121,27 @@ namespace CryptoNote {
 
       if (m_currency.upgradeHeight() != UNDEF_HEIGHT) {
         if (m_blockchain.size() <= m_currency.upgradeHeight() + 1) {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion - 1);
+          assert(blockMajorVersion(m_blockchain.size() - 1) == m_targetVersion - 1);
         } else {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion);
+          assert(blockMajorVersion(m_blockchain.size() - 1) == m_targetVersion);
         }
 
       } else if (m_votingCompleteHeight != UNDEF_HEIGHT) {
         assert(m_blockchain.size() > m_votingCompleteHeight);
 
         if (m_blockchain.size() <= upgradeHeight()) {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion - 1);
+          assert(blockMajorVersion(m_blockchain.size() - 1) == m_targetVersion - 1);
 
           if (m_blockchain.size() % (60 * 60 / m_currency.difficultyTarget()) == 0) {
             logger(Logging::TRACE, Logging::BRIGHT_GREEN) << "###### UPGRADE is going to happen after height " << upgradeHeight() << "!";
           }
         } else if (m_blockchain.size() == upgradeHeight() + 1) {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion - 1);
+          assert(blockMajorVersion(m_blockchain.size() - 1) == m_targetVersion - 1);
 
           logger(Logging::TRACE, Logging::BRIGHT_GREEN) << "###### UPGRADE has happened! Starting from height " << (upgradeHeight() + 1) <<
             " blocks with major version below " << static_cast<int>(m_targetVersion) << " will be rejected!";
         } else {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion);
+          assert(blockMajorVersion(m_blockchain.size() - 1) == m_targetVersion);
         }
 
       } else {
@@ -145,6 +168,22 @@ namespace CryptoNote {
     }
 
   private:
+    // versions don't decrease with height
+    uint64_t findFirstBlockOfTargetVersion() const {
+      uint64_t low = 0;
+      uint64_t high = m_blockchain.size();
+      while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (blockMajorVersion(middle) < m_targetVersion) {
+          low = middle + 1;
+        } else {
+          high = middle;
+        }
+      }
+
+      return low;
+    }
+
     uint64_t findVotingCompleteHeight(uint64_t probableUpgradeHeight) {
       assert(m_currency.upgradeHeight() == UNDEF_HEIGHT);
 
@@ -170,14 +209,20 @@ namespace CryptoNote {
 
       unsigned int voteCounter = 0;
       for (size_t i = height + 1 - m_currency.upgradeVotingWindow(); i <= height; ++i) {
-        const auto& b = m_blockchain[i].bl;
-        voteCounter += (b.majorVersion == m_targetVersion - 1) && (b.minorVersion == BLOCK_MINOR_VERSION_1) ? 1 : 0;
+        voteCounter += (blockMajorVersion(i) == m_targetVersion - 1) && (blockMinorVersion(i) == BLOCK_MINOR_VERSION_1) ? 1 : 0;
       }
 
       return m_currency.upgradeVotingThreshold() * m_currency.upgradeVotingWindow() <= 100 * voteCounter;
     }
 
-  private:
+    uint8_t blockMajorVersion(uint64_t height) const {
+      return BlockVersionReader<BC>::majorVersion(m_blockchain, height);
+    }
+
+    uint8_t blockMinorVersion(uint64_t height) const {
+      return BlockVersionReader<BC>::minorVersion(m_blockchain, height);
+    }
+
     Logging::LoggerRef logger;
     const Currency& m_currency;
     BC& m_blockchain;
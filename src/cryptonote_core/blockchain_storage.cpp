@@ -18,20 +18,33 @@
 #include "blockchain_storage.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstdio>
-
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
-#include <boost/serialization/version.hpp>
 #include <boost/utility/value_init.hpp>
 
-#include "Common/boost_serialization_helper.h"
+#include "Common/MemoryStreambuf.h"
+#include "Common/Metrics.h"
 #include "Common/ShuffleGenerator.h"
+#include "Common/StageProfiler.h"
 #include "Common/StringTools.h"
+#include "Common/ThreadTopology.h"
 
 #include "cryptonote_format_utils.h"
+#include "MappedIndexStore.h"
+#include "cryptonote_serialization.h"
 #include "rpc/core_rpc_server_commands_defs.h"
+#include "serialization/BinarySerializationTools.h"
+#include "serialization/SerializationOverloads.h"
 
 using namespace Logging;
 
@@ -41,6 +54,42 @@ using namespace Logging;
 #endif
 
 namespace {
+// Rows read under one lock by print_blockchain and print_blockchain_outs
+const size_t EXPORT_CHUNK_SIZE = 1000;
+
+// Stages of adding a block to the main chain, printed by the print_profile daemon command
+struct BlockStages {
+  Common::MetricHistogram& pushBlock;
+  Common::MetricHistogram& headerChecks;
+  Common::MetricHistogram& difficulty;
+  Common::MetricHistogram& proofOfWork;
+  Common::MetricHistogram& txInputs;
+  Common::MetricHistogram& keyImages;
+  Common::MetricHistogram& ringSignatures;
+  Common::MetricHistogram& minerTransaction;
+  Common::MetricHistogram& indexUpdate;
+  Common::MetricCounter& poolVerifiedTransactions;
+
+  BlockStages() :
+    pushBlock(Common::StageProfiler::stage("push_block")),
+    headerChecks(Common::StageProfiler::stage("header_checks")),
+    difficulty(Common::StageProfiler::stage("difficulty")),
+    proofOfWork(Common::StageProfiler::stage("proof_of_work")),
+    txInputs(Common::StageProfiler::stage("check_tx_inputs")),
+    keyImages(Common::StageProfiler::stage("key_image_checks")),
+    ringSignatures(Common::StageProfiler::stage("ring_signatures")),
+    minerTransaction(Common::StageProfiler::stage("validate_miner_transaction")),
+    indexUpdate(Common::StageProfiler::stage("index_update")),
+    poolVerifiedTransactions(Common::MetricsRegistry::global().counter("block_pool_verified_transactions_total",
+      "Block transactions whose ring signatures were verified by the pool and not checked again")) {
+  }
+
+  static BlockStages& get() {
+    static BlockStages stages;
+    return stages;
+  }
+};
+
 std::string appendPath(const std::string& path, const std::string& fileName) {
   std::string result = path;
   if (!result.empty()) {
@@ -85,84 +134,390 @@ bool operator<(const crypto::key_image& keyImage1, const crypto::key_image& keyI
 }
 }
 
-#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 1
-
-namespace CryptoNote {
-class BlockCacheSerializer;
-}
-
-BOOST_CLASS_VERSION(CryptoNote::BlockCacheSerializer, CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER);
+#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 10
+
+// Cache snapshot is rewritten on shutdown only when this many blocks were pushed since the stored one,
+// the rest is replayed from blocks file on startup
+#define BLOCKCACHE_SNAPSHOT_INTERVAL 5000
+// Cache snapshot is rewritten in background when this many blocks were pushed since the stored one
+#define BLOCKCACHE_BACKGROUND_SNAPSHOT_INTERVAL 20000
+// Number of blocks loaded and hashed in parallel before they are merged into indexes
+#define BLOCKCACHE_REBUILD_BATCH_SIZE 1000
+// Alternative blocks kept at most, forks are dropped starting from the lowest one above this
+#define ALTERNATIVE_BLOCKS_LIMIT 1000
+// Blocks popped in a reorganization within this depth take their index changes back from undo records
+#define BLOCK_UNDO_DEPTH 1000
+// Proofs of work prepared for blocks which are never pushed are dropped after this many accumulate
+#define PREPARED_PROOFS_OF_WORK_LIMIT 10000
+// Number of recent block proofs of work kept to validate alternative chains and reorganizations without slow hashing
+#define LONGHASH_CACHE_SIZE 20000
+// Memory taken by a cached block is estimated as its serialized size times this, for containers and indexes
+#define BLOCKS_CACHE_ITEM_OVERHEAD 2
+// Number of blocks pushed between resizes of the blocks cache to its memory budget
+#define BLOCKS_CACHE_RESIZE_INTERVAL 1000
+// Blocks a replica keeps in memory to pop them when the writing node does, deeper reorganizations rebuild its indexes
+#define REPLICA_TAIL_BLOCKS 100
 
 namespace CryptoNote
 {
 
-template<class Archive> 
-void blockchain_storage::TransactionIndex::serialize(Archive& archive, unsigned int version) {
-  archive & block;
-  archive & transaction;
-}
-
-template<class Archive> 
-void blockchain_storage::MultisignatureOutputUsage::serialize(Archive& archive, unsigned int version) {
-  archive & transactionIndex;
-  archive & outputIndex;
-  archive & isUsed;
+void blockchain_storage::TransactionIndex::serialize(ISerializer& s, const std::string& name) {
+  s(block, "block");
+  uint32_t transactionIndex = transaction;
+  s(transactionIndex, "transaction");
+  transaction = static_cast<uint16_t>(transactionIndex);
 }
 
 class BlockCacheSerializer {
 
 public:
   BlockCacheSerializer(blockchain_storage& bs, const crypto::hash lastBlockHash, ILogger& logger) :
-    m_bs(bs), m_lastBlockHash(lastBlockHash), m_loaded(false), logger(logger, "BlockCacheSerializer") {
+    m_bs(bs), m_lastBlockHash(lastBlockHash), m_loaded(false), m_transactionMapLoaded(false), m_explorerIndexesLoaded(false),
+    logger(logger, "BlockCacheSerializer") {
   }
 
-  template<class Archive> void serialize(Archive& ar, unsigned int version) {
+  // Loading accepts snapshot for any tail, blockchain_storage brings it up to date with blocks file
+
+  void serialize(ISerializer& s, const std::string& name) {
+    uint32_t version = CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER;
+    s(version, "version");
 
     // ignore old versions, do rebuild
-    if (version < CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER)
+    if (version != CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER)
       return;
 
-    std::string operation;
-    if (Archive::is_loading::value) {
-      operation = "- loading ";
-      crypto::hash blockHash;
-      ar & blockHash;
+    s(m_lastBlockHash, "last_block");
+
+    // Each index is a separately serialized blob, blobs are encoded on own threads and decoded on own threads as soon
+    // as they are read, so loading takes as long as the largest index rather than all of them
+    const char* names[] = { "block_index", "transaction_map", "spent_keys", "outputs", "multisignature_outputs", "block_filters", "block_headers",
+      "explorer_indexes" };
+    std::function<void(ISerializer&)> sections[] = {
+      [this](ISerializer& s) { s(m_bs.m_blockIndex, "block_index"); },
+      [this](ISerializer& s) { serializeTransactionMap(s); },
+      [this](ISerializer& s) { serializeSpentKeys(s); },
+      [this](ISerializer& s) { serializeOutputs(s); },
+      [this](ISerializer& s) { serializeMultisignatureOutputs(s); },
+      [this](ISerializer& s) { serializeBlockFilters(s); },
+      [this](ISerializer& s) { s(m_bs.m_blockHeaders, "block_headers"); },
+      [this](ISerializer& s) { serializeExplorerIndexes(s); }
+    };
+
+    const size_t sectionCount = sizeof(names) / sizeof(names[0]);
+    std::vector<std::string> blobs(sectionCount);
+    std::vector<std::future<void>> tasks;
+    if (s.type() == ISerializer::INPUT) {
+      for (size_t i = 0; i < sectionCount; ++i) {
+        s.binary(blobs[i], names[i]);
+        tasks.push_back(std::async(std::launch::async, [this, &blobs, &names, &sections, i] {
+          logger(INFO) << "- loading " << names[i] << "...";
+          Common::MemoryStreambuf buffer(blobs[i].data(), blobs[i].size());
+          std::istream stream(&buffer);
+          BinaryInputStreamSerializer serializer(stream);
+          sections[i](serializer);
+          std::string().swap(blobs[i]);
+        }));
+      }
+    } else {
+      for (size_t i = 0; i < sectionCount; ++i) {
+        tasks.push_back(std::async(std::launch::async, [this, &blobs, &names, &sections, i] {
+          logger(INFO) << "- saving " << names[i] << "...";
+          std::ostringstream stream;
+          BinaryOutputStreamSerializer serializer(stream);
+          sections[i](serializer);
+          blobs[i] = stream.str();
+        }));
+      }
+    }
 
-      if (blockHash != m_lastBlockHash) {
-        return;
+    // all tasks finish before the first failure is rethrown, they refer to locals
+    for (auto& task : tasks) {
+      task.wait();
+    }
+
+    for (auto& task : tasks) {
+      task.get();
+    }
+
+    if (s.type() == ISerializer::OUTPUT) {
+      for (size_t i = 0; i < sectionCount; ++i) {
+        s.binary(blobs[i], names[i]);
       }
+    }
+
+    m_loaded = m_bs.m_blockIndex.size() != 0 && m_bs.m_blockIndex.getTailId() == m_lastBlockHash &&
+      m_bs.m_blockFilters.size() == m_bs.m_blockIndex.size() && m_bs.m_blockHeaders.size() == m_bs.m_blockIndex.size() &&
+      m_transactionMapLoaded && m_explorerIndexesLoaded;
+  }
+
+  bool loaded() const {
+    return m_loaded;
+  }
+
+private:
 
+  // Compact map is saved as hash prefixes, a snapshot of one kind of map is read but not loaded into the other
+  void serializeTransactionMap(ISerializer& s) {
+    bool compact = m_bs.m_compactTransactionMap != nullptr;
+    bool storedCompact = compact;
+    s(storedCompact, "compact_transactions");
+
+    size_t size = m_bs.m_transactionMap->size();
+    s.beginArray(size, "transactions");
+    if (s.type() == ISerializer::INPUT) {
+      m_transactionMapLoaded = storedCompact == compact;
+      m_bs.m_transactionMap->clear();
+      m_bs.m_transactionMap->reserve(m_transactionMapLoaded ? size : 0);
+      for (size_t i = 0; i < size; ++i) {
+        blockchain_storage::TransactionIndex index;
+        if (storedCompact) {
+          uint64_t prefix;
+          s(prefix, "prefix");
+          s(index, "index");
+          if (m_transactionMapLoaded) {
+            m_bs.m_compactTransactionMap->insertPrefix(prefix, index);
+          }
+        } else {
+          crypto::hash transactionHash;
+          s(transactionHash, "hash");
+          s(index, "index");
+          if (m_transactionMapLoaded) {
+            m_bs.m_transactionMap->insert(transactionHash, index);
+          }
+        }
+      }
+    } else if (compact) {
+      m_bs.m_compactTransactionMap->forEachPrefix([&s](uint64_t prefix, const blockchain_storage::TransactionIndex& index) {
+        blockchain_storage::TransactionIndex transactionIndex = index;
+        s(prefix, "prefix");
+        s(transactionIndex, "index");
+      });
     } else {
-      operation = "- saving ";
-      ar & m_lastBlockHash;
+      m_bs.m_transactionMap->forEach([&s](const crypto::hash& hash, const blockchain_storage::TransactionIndex& index) {
+        crypto::hash transactionHash = hash;
+        blockchain_storage::TransactionIndex transactionIndex = index;
+        s(transactionHash, "hash");
+        s(transactionIndex, "index");
+      });
     }
 
-    logger(INFO) << operation << "block index...";
-    ar & m_bs.m_blockIndex;
+    s.endArray();
+  }
+
+  void serializeSpentKeys(ISerializer& s) {
+    std::vector<crypto::key_image> keyImages;
+    if (s.type() == ISerializer::OUTPUT) {
+      keyImages.assign(m_bs.m_spent_keys.begin(), m_bs.m_spent_keys.end());
+    }
+
+    serializeAsBinary(keyImages, "spent_keys", s);
 
-    logger(INFO) << operation << "transaction map...";
-    ar & m_bs.m_transactionMap;
+    if (s.type() == ISerializer::INPUT) {
+      m_bs.m_spent_keys.clear();
+      m_bs.m_spent_keys.resize(keyImages.size());
+      m_bs.m_spent_keys.insert(keyImages.begin(), keyImages.end());
+      m_bs.rebuildSpentKeysFilter();
+    }
+  }
+
+  void serializeOutputs(ISerializer& s) {
+    size_t size = m_bs.m_outputs.size();
+    s.beginArray(size, "outputs");
+    if (s.type() == ISerializer::INPUT) {
+      m_bs.m_outputs.clear();
+      m_bs.m_outputs.resize(size);
+    }
 
-    logger(INFO) << operation << "spend keys...";
-    ar & m_bs.m_spent_keys;
+    auto it = m_bs.m_outputs.begin();
+    for (size_t i = 0; i < size; ++i) {
+      uint64_t amount = 0;
+      blockchain_storage::KeyOutputs emptyOutputs;
+      auto& outputs = s.type() == ISerializer::INPUT ? emptyOutputs : it->second;
+      if (s.type() == ISerializer::OUTPUT) {
+        amount = it->first;
+        ++it;
+      }
 
-    logger(INFO) << operation << "outputs...";
-    ar & m_bs.m_outputs;
+      s(amount, "amount");
+      size_t count = outputs.size();
+      s.beginArray(count, "outputs");
+      outputs.references.resize(count);
+      for (auto& output : outputs.references) {
+        s(output.first, "transaction_index");
+        uint32_t outputIndex = output.second;
+        s(outputIndex, "output_index");
+        output.second = static_cast<uint16_t>(outputIndex);
+      }
 
-    logger(INFO) << operation << "multi-signature outputs...";
-    ar & m_bs.m_multisignatureOutputs;
+      s.endArray();
+      serializeAsBinary(outputs.keys, "keys", s);
+      serializeAsBinary(outputs.unlockTimes, "unlock_times", s);
+      if (s.type() == ISerializer::INPUT) {
+        m_bs.m_outputs[amount] = std::move(outputs);
+      }
+    }
 
-    m_loaded = true;
+    s.endArray();
   }
 
-  bool loaded() const {
-    return m_loaded;
+  void serializeMultisignatureOutputs(ISerializer& s) {
+    size_t size = m_bs.m_multisignatureOutputs.size();
+    s.beginArray(size, "multisignature_outputs");
+    if (s.type() == ISerializer::INPUT) {
+      m_bs.m_multisignatureOutputs.clear();
+      m_bs.m_multisignatureOutputs.reserve(size);
+    }
+
+    auto it = m_bs.m_multisignatureOutputs.begin();
+    for (size_t i = 0; i < size; ++i) {
+      uint64_t amount = 0;
+      blockchain_storage::MultisignatureOutputs emptyOutputs;
+      auto& outputs = s.type() == ISerializer::INPUT ? emptyOutputs : it->second;
+      if (s.type() == ISerializer::OUTPUT) {
+        amount = it->first;
+        ++it;
+      }
+
+      s(amount, "amount");
+      size_t count = outputs.size();
+      s.beginArray(count, "outputs");
+      outputs.references.resize(count);
+      for (auto& output : outputs.references) {
+        s(output.first, "transaction_index");
+        uint32_t outputIndex = output.second;
+        s(outputIndex, "output_index");
+        output.second = static_cast<uint16_t>(outputIndex);
+      }
+
+      s.endArray();
+      serializeAsBinary(outputs.usedBits, "used_bits", s);
+      if (s.type() == ISerializer::INPUT) {
+        if (outputs.usedBits.size() != (count + 63) / 64) {
+          throw std::runtime_error("Invalid multisignature outputs used bits size");
+        }
+
+        m_bs.m_multisignatureOutputs[amount] = std::move(outputs);
+      }
+    }
+
+    s.endArray();
   }
 
-private:
+  // Snapshot taken with explorer indexes off has none, it is not loaded when they are on and the other way round
+  void serializeExplorerIndexes(ISerializer& s) {
+    blockchain_storage::ExplorerIndexes* indexes = m_bs.m_explorerIndexes.get();
+    bool enabled = indexes != nullptr;
+    bool storedEnabled = enabled;
+    s(storedEnabled, "enabled");
+    if (s.type() == ISerializer::INPUT) {
+      m_explorerIndexesLoaded = storedEnabled == enabled;
+      if (!storedEnabled || !m_explorerIndexesLoaded) {
+        return;
+      }
+    } else if (!enabled) {
+      return;
+    }
+
+    size_t size = indexes->keyImages.size();
+    s.beginArray(size, "key_images");
+    if (s.type() == ISerializer::INPUT) {
+      indexes->keyImages.clear();
+      indexes->keyImages.reserve(size);
+      for (size_t i = 0; i < size; ++i) {
+        crypto::key_image keyImage;
+        blockchain_storage::TransactionIndex index;
+        s(keyImage, "key_image");
+        s(index, "index");
+        indexes->keyImages.insert(std::make_pair(keyImage, index));
+      }
+    } else {
+      for (auto& entry : indexes->keyImages) {
+        crypto::key_image keyImage = entry.first;
+        s(keyImage, "key_image");
+        s(entry.second, "index");
+      }
+    }
+
+    s.endArray();
+
+    size = indexes->outputKeys.size();
+    s.beginArray(size, "output_keys");
+    if (s.type() == ISerializer::INPUT) {
+      indexes->outputKeys.clear();
+      indexes->outputKeys.reserve(size);
+    }
+
+    auto outputIt = indexes->outputKeys.begin();
+    for (size_t i = 0; i < size; ++i) {
+      crypto::public_key key;
+      std::pair<blockchain_storage::TransactionIndex, uint16_t> reference;
+      if (s.type() == ISerializer::OUTPUT) {
+        key = outputIt->first;
+        reference = outputIt->second;
+        ++outputIt;
+      }
+
+      s(key, "key");
+      s(reference.first, "transaction_index");
+      uint32_t outputIndex = reference.second;
+      s(outputIndex, "output_index");
+      if (s.type() == ISerializer::INPUT) {
+        reference.second = static_cast<uint16_t>(outputIndex);
+        indexes->outputKeys.insert(std::make_pair(key, reference));
+      }
+    }
+
+    s.endArray();
+
+    size = indexes->paymentIds.size();
+    s.beginArray(size, "payment_ids");
+    if (s.type() == ISerializer::INPUT) {
+      indexes->paymentIds.clear();
+      indexes->paymentIds.reserve(size);
+    }
+
+    auto paymentIdIt = indexes->paymentIds.begin();
+    for (size_t i = 0; i < size; ++i) {
+      crypto::hash paymentId;
+      std::vector<blockchain_storage::TransactionIndex> emptyTransactions;
+      auto& transactions = s.type() == ISerializer::INPUT ? emptyTransactions : paymentIdIt->second;
+      if (s.type() == ISerializer::OUTPUT) {
+        paymentId = paymentIdIt->first;
+        ++paymentIdIt;
+      }
+
+      s(paymentId, "payment_id");
+      size_t count = transactions.size();
+      s.beginArray(count, "transactions");
+      transactions.resize(count);
+      for (auto& index : transactions) {
+        s(index, "");
+      }
+
+      s.endArray();
+      if (s.type() == ISerializer::INPUT) {
+        indexes->paymentIds[paymentId] = std::move(transactions);
+      }
+    }
+
+    s.endArray();
+  }
+
+  void serializeBlockFilters(ISerializer& s) {
+    size_t size = m_bs.m_blockFilters.size();
+    s.beginArray(size, "block_filters");
+    m_bs.m_blockFilters.resize(size);
+    for (std::string& filter : m_bs.m_blockFilters) {
+      s.binary(filter, "");
+    }
+
+    s.endArray();
+  }
 
   LoggerRef logger;
   bool m_loaded;
+  bool m_transactionMapLoaded;
+  bool m_explorerIndexesLoaded;
   blockchain_storage& m_bs;
   crypto::hash m_lastBlockHash;
 };
@@ -175,7 +530,26 @@ m_tx_pool(tx_pool),
 m_current_block_cumul_sz_limit(0),
 m_is_in_checkpoint_zone(false),
 m_is_blockchain_storing(false),
-m_upgradeDetector(currency, m_blocks, BLOCK_MAJOR_VERSION_2, logger),
+m_mapBlocksFile(false),
+m_compressBlocksFile(false),
+m_diskIndexes(false),
+m_explorerIndexesEnabled(false),
+m_replica(false),
+m_blocksCacheSize(BLOCKS_CACHE_DEFAULT_SIZE),
+m_blocksCacheMemory(0),
+m_blocksCacheMemoryLimit(0),
+m_blocksCachePolicy(SwappedCachePolicy::TWO_QUEUE),
+m_fastSync(false),
+m_cacheHeight(0),
+m_storingCacheHeight(0),
+m_isCacheStoring(false),
+m_verificationThreads(std::max<size_t>(std::thread::hardware_concurrency(), 1)),
+m_longHashCache(LONGHASH_CACHE_SIZE),
+m_transactionMap(new PrefixIndexStore<crypto::hash, TransactionIndex>([this](const TransactionIndex& index, crypto::hash& transactionHash) {
+  return getIndexedTransactionHash(index, transactionHash);
+})),
+m_compactTransactionMap(static_cast<PrefixIndexStore<crypto::hash, TransactionIndex>*>(m_transactionMap.get())),
+m_upgradeDetector(currency, m_blockHeaders, BLOCK_MAJOR_VERSION_2, logger),
 m_checkpoints(logger) {
 
   m_outputs.set_deleted_key(0);
@@ -238,17 +612,47 @@ bool blockchain_storage::haveSpentKeyImages(const CryptoNote::Transaction& tx) {
 }
 
 bool blockchain_storage::have_tx(const crypto::hash &id) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  return m_transactionMap.find(id) != m_transactionMap.end();
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_transactionMap->contains(id);
 }
 
 bool blockchain_storage::have_tx_keyimg_as_spent(const crypto::key_image &key_im) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  return  m_spent_keys.find(key_im) != m_spent_keys.end();
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_spentKeysFilter.mayContain(key_im) && m_spent_keys.find(key_im) != m_spent_keys.end();
+}
+
+void blockchain_storage::addSpentKeyToFilter(const crypto::key_image& keyImage) {
+  if (m_spentKeysFilter.full()) {
+    // m_spent_keys already has the key image
+    rebuildSpentKeysFilter();
+  } else {
+    m_spentKeysFilter.insert(keyImage);
+  }
+}
+
+std::string blockchain_storage::buildBlockFilter(const BlockEntry& block) {
+  std::vector<crypto::key_image> keyImages;
+  for (const TransactionEntry& transaction : block.transactions) {
+    for (const auto& input : transaction.tx.vin) {
+      if (input.type() == typeid(TransactionInputToKey)) {
+        keyImages.push_back(::boost::get<TransactionInputToKey>(input).keyImage);
+      }
+    }
+  }
+
+  return BlockFilter::build(keyImages);
+}
+
+// Also drops key images removed from m_spent_keys since the last rebuild
+void blockchain_storage::rebuildSpentKeysFilter() {
+  m_spentKeysFilter.reset(m_spent_keys.size() * 2);
+  for (const crypto::key_image& keyImage : m_spent_keys) {
+    m_spentKeysFilter.insert(keyImage);
+  }
 }
 
 uint64_t blockchain_storage::get_current_blockchain_height() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_blocks.size();
 }
 
@@ -260,67 +664,112 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
   }
 
   m_config_folder = config_folder;
+  SnapshotManifest snapshotManifest;
+  bool snapshotInstalled = false;
+  if (load_existing && !m_replica && !m_snapshotFolder.empty()) {
+    if (boost::filesystem::exists(appendPath(config_folder, m_currency.blocksFileName()))) {
+      logger(INFO, BRIGHT_WHITE) << "Data directory already has blocks, snapshot in " << m_snapshotFolder << " is not used";
+    } else if (installSnapshot(config_folder, snapshotManifest)) {
+      snapshotInstalled = true;
+    } else {
+      return false;
+    }
+  }
 
-  if (!m_blocks.open(appendPath(config_folder, m_currency.blocksFileName()), appendPath(config_folder, m_currency.blockIndexesFileName()), 1024)) {
-    return false;
+  auto placeVerificationThread = [] { Common::ThreadTopology::global().applyToCurrentThread(Common::ThreadClass::VERIFICATION); };
+  m_verificationPool.reset(new Common::ThreadPool(m_verificationThreads > 1 ? m_verificationThreads - 1 : 0, placeVerificationThread));
+  m_proofOfWorkPool.reset(new Common::ThreadPool(m_verificationThreads > 1 ? m_verificationThreads - 1 : 0, placeVerificationThread));
+  logger(DEBUGGING) << "Proof of work scratchpad is allocated in " << (m_cn_context.uses_large_pages() ? "large pages" : "regular pages");
+
+  // index file is the writing node's scratch file, a replica keeps its index in memory
+  if (m_diskIndexes && !m_replica) {
+    std::unique_ptr<MappedIndexStore<crypto::hash, TransactionIndex>> transactionMap(new MappedIndexStore<crypto::hash, TransactionIndex>());
+    std::string transactionMapFileName = appendPath(config_folder, m_currency.transactionIndexFileName());
+    if (transactionMap->open(transactionMapFileName)) {
+      m_transactionMap = std::move(transactionMap);
+      m_compactTransactionMap = nullptr;
+    } else {
+      logger(WARNING, BRIGHT_YELLOW) << "Failed to map transaction index file " << transactionMapFileName << ", keeping the index in memory";
+    }
+  }
+
+  if (m_explorerIndexesEnabled) {
+    m_explorerIndexes.reset(new ExplorerIndexes());
+  }
+
+  if (m_replica) {
+    if (!m_blocks.openReadOnly(appendPath(config_folder, m_currency.blocksFileName()), appendPath(config_folder, m_currency.blockIndexesFileName()), m_blocksCacheSize, m_mapBlocksFile) || m_blocks.empty()) {
+      logger(ERROR, BRIGHT_RED) << "Failed to open blocks in " << config_folder << " read-only, the writing node must have run " <<
+        "there without blocks file compression";
+      return false;
+    }
+  } else {
+    if (m_compressBlocksFile) {
+      logger(INFO, BRIGHT_WHITE) << "Compressing blocks file, the first start with compression may take a while...";
+    }
+
+    if (!m_blocks.open(appendPath(config_folder, m_currency.blocksFileName()), appendPath(config_folder, m_currency.blockIndexesFileName()), m_blocksCacheSize, m_mapBlocksFile, m_compressBlocksFile)) {
+      return false;
+    }
+  }
+
+  m_blocks.setCachePolicy(m_blocksCachePolicy);
+  // the budget is translated into a number of blocks by their size, known once the blocks file is open
+  m_blocks.setPoolSize(getBlocksCachePoolSize());
+
+  if (m_mapBlocksFile && !m_blocks.isMapped()) {
+    logger(WARNING, BRIGHT_YELLOW) << "Memory-mapped blocks file is not supported on this platform, using file reads";
   }
 
   if (load_existing && !m_blocks.empty()) {
     logger(INFO, BRIGHT_WHITE) << "Loading blockchain...";
-    BlockCacheSerializer loader(*this, get_block_hash(m_blocks.back().bl), logger.getLogger());
-    tools::unserialize_obj_from_file(loader, appendPath(config_folder, m_currency.blocksCacheFileName()));
+    if (!loadFromBinaryFile(m_longHashCache, appendPath(config_folder, m_currency.blocksLongHashesFileName()))) {
+      m_longHashCache.clear();
+    }
 
-    if (!loader.loaded()) {
+    BlockCacheSerializer loader(*this, null_hash, logger.getLogger());
+    loadFromBinaryFile(loader, appendPath(config_folder, m_currency.blocksCacheFileName()));
+
+    uint32_t cacheHeight = static_cast<uint32_t>(m_blockIndex.size());
+    if (loader.loaded() && updateCache()) {
+      m_cacheHeight = cacheHeight;
+    } else {
       logger(WARNING, BRIGHT_YELLOW) << "No actual blockchain cache found, rebuilding internal structures...";
       std::chrono::steady_clock::time_point timePoint = std::chrono::steady_clock::now();
-      m_blockIndex.clear();
-      m_transactionMap.clear();
-      m_spent_keys.clear();
-      m_outputs.clear();
-      m_multisignatureOutputs.clear();
-      for (uint32_t b = 0; b < m_blocks.size(); ++b) {
-        if (b % 1000 == 0) {
-          logger(INFO, BRIGHT_WHITE) << "Height " << b << " of " << m_blocks.size();
-        }
-        const BlockEntry& block = m_blocks[b];
-        crypto::hash blockHash = get_block_hash(block.bl);
-        m_blockIndex.push(blockHash);
-        for (uint16_t t = 0; t < block.transactions.size(); ++t) {
-          const TransactionEntry& transaction = block.transactions[t];
-          crypto::hash transactionHash = get_transaction_hash(transaction.tx);
-          TransactionIndex transactionIndex = {b, t};
-          m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
-
-          // process inputs
-          for (auto& i : transaction.tx.vin) {
-            if (i.type() == typeid(TransactionInputToKey)) {
-              m_spent_keys.insert(::boost::get<TransactionInputToKey>(i).keyImage);
-            } else if (i.type() == typeid(TransactionInputMultisignature)) {
-              auto out = ::boost::get<TransactionInputMultisignature>(i);
-              m_multisignatureOutputs[out.amount][out.outputIndex].isUsed = true;
-            }
-          }
-
-          // process outputs
-          for (uint16_t o = 0; o < transaction.tx.vout.size(); ++o) {
-            const auto& out = transaction.tx.vout[o];
-            if (out.target.type() == typeid(TransactionOutputToKey)) {
-              m_outputs[out.amount].push_back(std::make_pair<>(transactionIndex, o));
-            } else if (out.target.type() == typeid(TransactionOutputMultisignature)) {
-              MultisignatureOutputUsage usage = {transactionIndex, o, false};
-              m_multisignatureOutputs[out.amount].push_back(usage);
-            }
-          }
-        }
-      }
+      clearCache();
+      rebuildCache(0);
 
       std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
       logger(INFO, BRIGHT_WHITE) << "Rebuilding internal structures took: " << duration.count();
+      m_cacheHeight = 0;
     }
   } else {
     m_blocks.clear();
   }
 
+  if (snapshotInstalled) {
+    if (m_cacheHeight == 0) {
+      logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache of the snapshot was not usable, indexes were rebuilt";
+    }
+
+    if (get_tail_id() != snapshotManifest.tailId || !checkCheckpoints()) {
+      logger(ERROR, BRIGHT_RED) << "Blockchain snapshot does not match checkpoints, remove the data directory " <<
+        config_folder << " before the next start";
+      return false;
+    }
+
+    logger(INFO, BRIGHT_WHITE) << "Blockchain snapshot at height " << snapshotManifest.height << " is loaded";
+  }
+
+  // Journal keeps popped blocks since the stored cache snapshot, it is required to rewind snapshot after reorganization
+  if (!m_replica) {
+    m_cacheJournal.open(appendPath(config_folder, m_currency.blocksCacheJournalFileName()), std::ios::binary | std::ios::out | (m_cacheHeight != 0 ? std::ios::app : std::ios::trunc));
+  }
+
+  if (!m_replica && !m_cacheJournal) {
+    logger(WARNING, BRIGHT_YELLOW) << "Failed to open blockchain cache journal, cache will be rebuilt on next start if a reorganization occurs";
+  }
+
   if (m_blocks.empty()) {
     logger(INFO, BRIGHT_WHITE)
       << "Blockchain not loaded, generating genesis block.";
@@ -332,7 +781,7 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
       return false;
     }
   } else {
-    crypto::hash firstBlockHash = get_block_hash(m_blocks[0].bl);
+    crypto::hash firstBlockHash = get_block_hash(m_blocks[0]->bl);
     if (!(firstBlockHash == m_currency.genesisBlockHash())) {
       logger(ERROR, BRIGHT_RED) << "Failed to init: genesis block mismatch. "
         "Probably you set --testnet flag with data "
@@ -348,9 +797,18 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
   }
 
   update_next_comulative_size_limit();
+  updateCheckpointZone();
+  if (m_is_in_checkpoint_zone) {
+    logger(INFO, BRIGHT_WHITE) << "Fast sync is enabled, ring signatures of blocks below the last checkpoint will not be checked";
+  }
+
+  if (m_replica) {
+    fillReplicaTail();
+    logger(INFO, BRIGHT_WHITE) << "Blockchain is a read-only replica of the node running in " << config_folder;
+  }
 
-  uint64_t timestamp_diff = time(NULL) - m_blocks.back().bl.timestamp;
-  if (!m_blocks.back().bl.timestamp) {
+  uint64_t timestamp_diff = time(NULL) - m_blocks.back()->bl.timestamp;
+  if (!m_blocks.back()->bl.timestamp) {
     timestamp_diff = time(NULL) - 1341378000;
   }
 
@@ -361,120 +819,714 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
   return true;
 }
 
-bool blockchain_storage::storeCache() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-
-  logger(INFO, BRIGHT_WHITE) << "Saving blockchain...";
-  BlockCacheSerializer ser(*this, get_tail_id(), logger.getLogger());
-  if (!tools::serialize_obj_to_file(ser, appendPath(m_config_folder, m_currency.blocksCacheFileName()))) {
-    logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
-    return false;
-  }
+bool blockchain_storage::refreshReplica() {
+  bool changed = false;
+  bool refreshed = true;
+  {
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    uint32_t height = static_cast<uint32_t>(m_blockIndex.size());
+    uint32_t tailHeight = height - static_cast<uint32_t>(m_replicaTail.size());
+    try {
+      // Blocks below the tail are taken as unchanged, tail blocks the writing node replaced are popped
+      refreshed = m_blocks.refresh(tailHeight);
+      uint32_t commonHeight = static_cast<uint32_t>(std::min<uint64_t>(height, m_blocks.size()));
+      while (refreshed && commonHeight > tailHeight && get_block_hash(m_blocks[commonHeight - 1]->bl) != m_blockIndex.getBlockId(commonHeight - 1)) {
+        --commonHeight;
+      }
 
-  return true;
-}
+      if (refreshed && (commonHeight != height || commonHeight != m_blocks.size())) {
+        changed = true;
+        if (commonHeight < tailHeight || (commonHeight != 0 && commonHeight < m_blocks.size() &&
+          m_blocks[commonHeight]->bl.prevId != m_blockIndex.getBlockId(commonHeight - 1))) {
+          logger(WARNING, BRIGHT_YELLOW) << "Writing node reorganized below the last " << m_replicaTail.size() << " blocks, rebuilding indexes...";
+          clearCache();
+          m_replicaTail.clear();
+          commonHeight = 0;
+        }
 
-bool blockchain_storage::deinit() {
-  storeCache();
-  return true;
-}
+        while (m_blockIndex.size() > commonHeight) {
+          popReplicaBlock();
+        }
 
-bool blockchain_storage::reset_and_set_genesis_block(const Block& b) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  m_blocks.clear();
-  m_blockIndex.clear();
-  m_transactionMap.clear();
+        rebuildCache(commonHeight);
+        fillReplicaTail();
+      }
+    } catch (std::exception& e) {
+      // Writing node may be replacing the blocks being read, indexed ones are consistent and the next refresh retries
+      logger(DEBUGGING) << "Failed to refresh replica at height " << m_blockIndex.size() << ": " << e.what();
+      refreshed = false;
+    }
 
-  m_spent_keys.clear();
-  m_alternative_chains.clear();
-  m_outputs.clear();
+    if (changed) {
+      if (!m_upgradeDetector.init()) {
+        logger(ERROR, BRIGHT_RED) << "Failed to initialize upgrade detector";
+      }
 
-  block_verification_context bvc = boost::value_initialized<block_verification_context>();
-  add_new_block(b, bvc);
-  return bvc.m_added_to_main_chain && !bvc.m_verifivation_failed;
-}
+      update_next_comulative_size_limit();
+      updateCheckpointZone();
+    }
+  }
 
-crypto::hash blockchain_storage::get_tail_id(uint64_t& height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  height = get_current_blockchain_height() - 1;
-  return get_tail_id();
-}
+  if (changed) {
+    m_observerManager.notify(&IBlockchainStorageObserver::blockchainUpdated);
+  }
 
-crypto::hash blockchain_storage::get_tail_id() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  return m_blockIndex.getTailId();
+  return refreshed;
 }
 
-bool blockchain_storage::getPoolSymmetricDifference(const std::vector<crypto::hash>& known_pool_tx_ids, const crypto::hash& known_block_id, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids) {
-  
-  std::lock_guard<decltype(m_tx_pool)> txLock(m_tx_pool);
-  std::lock_guard<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
-
-  if (known_block_id != get_tail_id()) {
-    return false;
+void blockchain_storage::popReplicaBlock() {
+  std::shared_ptr<const BlockEntry> block = m_replicaTail.back();
+  // the blocks file holds the block which replaced it, transaction map resolves hashes from this one
+  m_unstoredBlocks[static_cast<uint32_t>(m_blockIndex.size() - 1)] = block.get();
+  for (size_t i = block->transactions.size() - 1; i > 0; --i) {
+    popTransaction(block->transactions[i].tx, block->bl.txHashes[i - 1]);
   }
 
-  std::vector<crypto::hash> new_tx_ids;
-  m_tx_pool.get_difference(known_pool_tx_ids, new_tx_ids, deleted_tx_ids);
-
-  std::vector<crypto::hash> misses;
-  get_transactions(new_tx_ids, new_txs, misses, true);
-  assert(misses.empty());
-  return true;
+  popTransaction(block->bl.minerTx, get_transaction_hash(block->bl.minerTx));
+  m_unstoredBlocks.clear();
+  m_blockIndex.pop();
+  m_blockHeaders.pop();
+  m_blockFilters.pop_back();
+  m_replicaTail.pop_back();
 }
 
-bool blockchain_storage::get_short_chain_history(std::list<crypto::hash>& ids) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  return m_blockIndex.getShortChainHistory(ids);
-}
+// Extends the tail down to REPLICA_TAIL_BLOCKS from the blocks file, stops at a block the writing node replaced
+void blockchain_storage::fillReplicaTail() {
+  uint32_t height = static_cast<uint32_t>(m_blockIndex.size() - m_replicaTail.size());
+  while (height != 0 && m_replicaTail.size() < REPLICA_TAIL_BLOCKS) {
+    std::shared_ptr<const BlockEntry> block = m_blocks[height - 1];
+    if (get_block_hash(block->bl) != m_blockIndex.getBlockId(height - 1)) {
+      break;
+    }
 
-crypto::hash blockchain_storage::get_block_id_by_height(uint64_t height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  return m_blockIndex.getBlockId(height);
+    m_replicaTail.push_front(block);
+    --height;
+  }
 }
 
-bool blockchain_storage::get_block_by_hash(const crypto::hash& blockHash, Block& b) {
+bool blockchain_storage::storeCache() {
+  if (m_cacheStoreThread.joinable()) {
+    m_cacheStoreThread.join();
+  }
+
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
-  uint64_t height = 0;
+  if (!storeToBinaryFile(m_longHashCache, appendPath(m_config_folder, m_currency.blocksLongHashesFileName()))) {
+    logger(WARNING, BRIGHT_YELLOW) << "Failed to save proof of work cache";
+  }
 
-  if (m_blockIndex.getBlockHeight(blockHash, height)) {
-    b = m_blocks[height].bl;
+  if (m_cacheHeight != 0 && m_blocks.size() >= m_cacheHeight && m_blocks.size() - m_cacheHeight < BLOCKCACHE_SNAPSHOT_INTERVAL) {
+    logger(INFO, BRIGHT_WHITE) << "Blockchain cache is " << m_blocks.size() - m_cacheHeight << " blocks behind, it will be updated on next start";
     return true;
   }
 
-  auto blockByHashIterator = m_alternative_chains.find(blockHash);
-  if (blockByHashIterator != m_alternative_chains.end()) {
-    b = blockByHashIterator->second.bl;
-    return true;
+  logger(INFO, BRIGHT_WHITE) << "Saving blockchain...";
+  // Snapshot is written aside and renamed, so crash during store leaves previous snapshot and its journal usable
+  std::string cacheFileName = appendPath(m_config_folder, m_currency.blocksCacheFileName());
+  std::string temporaryFileName = cacheFileName + ".tmp";
+  BlockCacheSerializer ser(*this, get_tail_id(), logger.getLogger());
+  if (!storeToBinaryFile(ser, temporaryFileName)) {
+    logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
+    return false;
   }
 
-  return false;
+  boost::system::error_code ec;
+  boost::filesystem::rename(temporaryFileName, cacheFileName, ec);
+  if (ec) {
+    logger(ERROR, BRIGHT_RED) << "Failed to replace blockchain cache: " << ec.message();
+    return false;
+  }
+
+  m_cacheHeight = static_cast<uint32_t>(m_blocks.size());
+  m_cacheJournal.close();
+  m_cacheJournal.open(appendPath(m_config_folder, m_currency.blocksCacheJournalFileName()), std::ios::binary | std::ios::out | std::ios::trunc);
+  return true;
 }
 
-difficulty_type blockchain_storage::get_difficulty_for_next_block() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> commulative_difficulties;
-  size_t offset = m_blocks.size() - std::min(m_blocks.size(), static_cast<uint64_t>(m_currency.difficultyBlocksCount()));
-  if (offset == 0) {
-    ++offset;
+void blockchain_storage::storeCacheInBackground() {
+  if (m_isCacheStoring) {
+    return;
   }
 
-  for (; offset < m_blocks.size(); offset++) {
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
-    commulative_difficulties.push_back(m_blocks[offset].cumulative_difficulty);
+  if (m_cacheStoreThread.joinable()) {
+    m_cacheStoreThread.join();
   }
 
-  return m_currency.nextDifficulty(timestamps, commulative_difficulties);
+  {
+    Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    if (m_blocks.size() < m_cacheHeight + BLOCKCACHE_BACKGROUND_SNAPSHOT_INTERVAL) {
+      return;
+    }
+  }
+
+  m_isCacheStoring = true;
+  m_cacheStoreThread = std::thread(&blockchain_storage::storeCacheSnapshot, this);
 }
 
-uint64_t blockchain_storage::getCoinsInCirculation() {
+// Snapshot is serialized into memory under shared lock, readers go on meanwhile and blocks are pushed again once it
+// is written. Blocks popped since the snapshot was taken are kept in journal after it replaces the stored one.
+void blockchain_storage::storeCacheSnapshot() {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::stringstream snapshot;
+  uint32_t height;
+  std::streamoff journalOffset;
+
+  {
+    Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    height = static_cast<uint32_t>(m_blocks.size());
+    logger(INFO, BRIGHT_WHITE) << "Saving blockchain cache at height " << height << " in background...";
+    // popBlock journals under exclusive lock, so nothing is appended while the shared one is held
+    m_storingCacheHeight = height;
+    journalOffset = m_cacheJournal ? static_cast<std::streamoff>(m_cacheJournal.tellp()) : -1;
+
+    try {
+      BlockCacheSerializer ser(*this, get_tail_id(), logger.getLogger());
+      BinaryOutputStreamSerializer serializer(snapshot);
+      serializer(ser, "");
+    } catch (std::exception& e) {
+      logger(ERROR, BRIGHT_RED) << "Failed to take blockchain cache snapshot: " << e.what();
+      m_storingCacheHeight = 0;
+      m_isCacheStoring = false;
+      return;
+    }
+  }
+
+  std::chrono::duration<double> snapshotDuration = std::chrono::steady_clock::now() - start;
+
+  std::string cacheFileName = appendPath(m_config_folder, m_currency.blocksCacheFileName());
+  std::string temporaryFileName = cacheFileName + ".tmp";
+  bool stored = false;
+  {
+    std::ofstream file(temporaryFileName, std::ios::binary | std::ios::out | std::ios::trunc);
+    file << snapshot.rdbuf();
+    file.flush();
+    stored = static_cast<bool>(file);
+  }
+
+  boost::system::error_code ec;
+  if (stored) {
+    boost::filesystem::rename(temporaryFileName, cacheFileName, ec);
+  }
+
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  m_storingCacheHeight = 0;
+  if (!stored || ec) {
+    logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache" << (ec ? ": " + ec.message() : std::string());
+    m_isCacheStoring = false;
+    return;
+  }
+
+  m_cacheHeight = height;
+  std::string journalFileName = appendPath(m_config_folder, m_currency.blocksCacheJournalFileName());
+  std::string journalTail;
+  if (journalOffset >= 0) {
+    m_cacheJournal.close();
+    std::ifstream journal(journalFileName, std::ios::binary);
+    journal.seekg(journalOffset);
+    journalTail.assign(std::istreambuf_iterator<char>(journal), std::istreambuf_iterator<char>());
+  }
+
+  m_cacheJournal.close();
+  m_cacheJournal.clear();
+  m_cacheJournal.open(journalFileName, std::ios::binary | std::ios::out | std::ios::trunc);
+  m_cacheJournal.write(journalTail.data(), journalTail.size());
+  m_cacheJournal.flush();
+
+  std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+  logger(INFO, BRIGHT_WHITE) << "Blockchain cache is saved at height " << height << ", taking snapshot took " <<
+    snapshotDuration.count() << " s, saving took " << duration.count() << " s";
+  m_isCacheStoring = false;
+}
+
+// Files are copied under temporary names and renamed once all of them match the manifest, so a failed copy leaves no
+// blocks in the data directory
+bool blockchain_storage::installSnapshot(const std::string& config_folder, SnapshotManifest& manifest) {
+  if (!manifest.load(appendPath(m_snapshotFolder, parameters::CRYPTONOTE_SNAPSHOT_MANIFEST_FILENAME))) {
+    logger(ERROR, BRIGHT_RED) << "Failed to load blockchain snapshot manifest from " << m_snapshotFolder;
+    return false;
+  }
+
+  bool hasBlocks = false;
+  bool hasCache = false;
+  for (const SnapshotManifest::File& file : manifest.files) {
+    if (file.name.empty() || file.name.find_first_of("/\\:") != std::string::npos || file.name[0] == '.') {
+      logger(ERROR, BRIGHT_RED) << "Blockchain snapshot manifest has invalid file name " << file.name;
+      return false;
+    }
+
+    hasBlocks = hasBlocks || file.name == m_currency.blocksFileName();
+    hasCache = hasCache || file.name == m_currency.blocksCacheFileName();
+  }
+
+  if (!hasBlocks || !hasCache) {
+    logger(ERROR, BRIGHT_RED) << "Blockchain snapshot in " << m_snapshotFolder << " has no blocks or no blockchain cache";
+    return false;
+  }
+
+  logger(INFO, BRIGHT_WHITE) << "Copying blockchain snapshot at height " << manifest.height << " from " << m_snapshotFolder << "...";
+  std::vector<std::string> temporaryFileNames;
+  bool copied = true;
+  for (const SnapshotManifest::File& file : manifest.files) {
+    temporaryFileNames.push_back(appendPath(config_folder, file.name) + ".tmp");
+    uint64_t size;
+    crypto::hash hash;
+    if (!copySnapshotFile(appendPath(m_snapshotFolder, file.name), temporaryFileNames.back(), size, hash) ||
+      size != file.size || hash != file.hash) {
+      logger(ERROR, BRIGHT_RED) << "Blockchain snapshot file " << file.name << " does not match manifest";
+      copied = false;
+      break;
+    }
+  }
+
+  boost::system::error_code ec;
+  for (size_t i = 0; copied && i < temporaryFileNames.size(); ++i) {
+    boost::filesystem::rename(temporaryFileNames[i], appendPath(config_folder, manifest.files[i].name), ec);
+    if (ec) {
+      logger(ERROR, BRIGHT_RED) << "Failed to move blockchain snapshot file " << manifest.files[i].name << ": " << ec.message();
+      copied = false;
+    }
+  }
+
+  for (const std::string& fileName : temporaryFileNames) {
+    boost::filesystem::remove(fileName, ec);
+  }
+
+  return copied;
+}
+
+// Block index and blocks of an installed snapshot are trusted only as far as they agree with checkpoints
+bool blockchain_storage::checkCheckpoints() {
+  for (const auto& point : m_checkpoints.get_points()) {
+    if (point.first >= m_blocks.size()) {
+      break;
+    }
+
+    if (m_blockIndex.getBlockId(point.first) != point.second || get_block_hash(m_blocks[point.first]->bl) != point.second) {
+      logger(ERROR, BRIGHT_RED) << "Block at height " << point.first << " does not match checkpoint";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool blockchain_storage::storeSnapshot(const std::string& folder) {
+  if (!tools::create_directories_if_necessary(folder)) {
+    logger(ERROR, BRIGHT_RED) << "Failed to create snapshot directory: " << folder;
+    return false;
+  }
+
+  // Manifest is written last, a bundle without it is incomplete
+  boost::system::error_code ec;
+  boost::filesystem::remove(appendPath(folder, parameters::CRYPTONOTE_SNAPSHOT_MANIFEST_FILENAME), ec);
+
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  SnapshotManifest manifest;
+  manifest.height = static_cast<uint32_t>(m_blocks.size());
+  manifest.tailId = get_tail_id();
+  logger(INFO, BRIGHT_WHITE) << "Writing blockchain snapshot at height " << manifest.height << " to " << folder << "...";
+
+  BlockCacheSerializer ser(*this, manifest.tailId, logger.getLogger());
+  if (!storeToBinaryFile(ser, appendPath(folder, m_currency.blocksCacheFileName())) ||
+    !storeToBinaryFile(m_longHashCache, appendPath(folder, m_currency.blocksLongHashesFileName()))) {
+    logger(ERROR, BRIGHT_RED) << "Failed to write blockchain cache to " << folder;
+    return false;
+  }
+
+  if (!m_blocks.flush()) {
+    logger(ERROR, BRIGHT_RED) << "Failed to flush blocks file";
+    return false;
+  }
+
+  std::vector<std::pair<std::string, bool>> files;
+  files.push_back(std::make_pair(m_currency.blocksFileName(), true));
+  files.push_back(std::make_pair(m_currency.blockIndexesFileName(), true));
+  if (boost::filesystem::exists(appendPath(m_config_folder, m_currency.blocksFileName() + ".segments"))) {
+    files.push_back(std::make_pair(m_currency.blocksFileName() + ".segments", true));
+  }
+
+  // cache files are already in place, they are only hashed
+  files.push_back(std::make_pair(m_currency.blocksCacheFileName(), false));
+  files.push_back(std::make_pair(m_currency.blocksLongHashesFileName(), false));
+  for (const auto& file : files) {
+    SnapshotManifest::File entry;
+    entry.name = file.first;
+    std::string source = appendPath(file.second ? m_config_folder : folder, file.first);
+    std::string destination = file.second ? appendPath(folder, file.first) : std::string();
+    if (!copySnapshotFile(source, destination, entry.size, entry.hash)) {
+      logger(ERROR, BRIGHT_RED) << "Failed to write " << file.first << " to " << folder;
+      return false;
+    }
+
+    manifest.files.push_back(entry);
+  }
+
+  if (!manifest.store(appendPath(folder, parameters::CRYPTONOTE_SNAPSHOT_MANIFEST_FILENAME))) {
+    logger(ERROR, BRIGHT_RED) << "Failed to write snapshot manifest to " << folder;
+    return false;
+  }
+
+  std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+  logger(INFO, BRIGHT_WHITE) << "Blockchain snapshot is written, took " << duration.count() << " s";
+  return true;
+}
+
+// Brings loaded cache snapshot to the state of blocks file: rewinds blocks popped since the snapshot using journal, then indexes new blocks
+bool blockchain_storage::updateCache() {
+  uint32_t cacheHeight = static_cast<uint32_t>(m_blockIndex.size());
+  uint32_t commonHeight = static_cast<uint32_t>(std::min<uint64_t>(cacheHeight, m_blocks.size()));
+
+  // Snapshot chain and stored chain share prefix, find its length with binary search
+  if (commonHeight != 0 && m_blockIndex.getBlockId(commonHeight - 1) != get_block_hash(m_blocks[commonHeight - 1]->bl)) {
+    uint32_t low = 0;
+    uint32_t high = commonHeight - 1;
+    while (low < high) {
+      uint32_t middle = low + (high - low) / 2;
+      if (m_blockIndex.getBlockId(middle) == get_block_hash(m_blocks[middle]->bl)) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    commonHeight = low;
+  }
+
+  if (commonHeight == 0) {
+    return false;
+  }
+
+  if (commonHeight < cacheHeight) {
+    logger(INFO, BRIGHT_WHITE) << "Rewinding blockchain cache from height " << cacheHeight << " to " << commonHeight << "...";
+    // First record for a height is the block which was there when the snapshot was stored
+    std::map<uint32_t, BlockEntry> snapshotBlocks;
+    std::ifstream journal(appendPath(m_config_folder, m_currency.blocksCacheJournalFileName()), std::ios::binary);
+    if (journal) {
+      binary_archive<false> archive(journal);
+      while (journal.peek() != std::char_traits<char>::eof()) {
+        BlockEntry block;
+        if (!do_serialize(archive, block)) {
+          break;
+        }
+
+        if (block.height >= commonHeight && block.height < cacheHeight) {
+          snapshotBlocks.insert(std::make_pair(block.height, std::move(block)));
+        }
+      }
+    }
+
+    // transaction map resolves hashes of rewound transactions from journal blocks
+    for (const auto& snapshotBlock : snapshotBlocks) {
+      m_unstoredBlocks[snapshotBlock.first] = &snapshotBlock.second;
+    }
+
+    for (uint32_t height = cacheHeight; height > commonHeight; --height) {
+      auto blockIt = snapshotBlocks.find(height - 1);
+      if (blockIt == snapshotBlocks.end() || get_block_hash(blockIt->second.bl) != m_blockIndex.getBlockId(height - 1)) {
+        logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal has no block at height " << height - 1;
+        m_unstoredBlocks.clear();
+        return false;
+      }
+
+      const BlockEntry& block = blockIt->second;
+      // Transactions are not returned to the pool, node is not running yet
+      for (size_t i = block.transactions.size() - 1; i > 0; --i) {
+        popTransaction(block.transactions[i].tx, block.bl.txHashes[i - 1]);
+      }
+
+      popTransaction(block.bl.minerTx, get_transaction_hash(block.bl.minerTx));
+      m_blockIndex.pop();
+      m_blockHeaders.pop();
+      m_blockFilters.pop_back();
+    }
+
+    m_unstoredBlocks.clear();
+  }
+
+  if (commonHeight < m_blocks.size()) {
+    logger(INFO, BRIGHT_WHITE) << "Updating blockchain cache from height " << commonHeight << " to " << m_blocks.size() << "...";
+    rebuildCache(commonHeight);
+  }
+
+  return true;
+}
+
+void blockchain_storage::rebuildCache(uint32_t startHeight) {
+  // Blocks are loaded and hashed by workers in batches, indexes are filled in block order by this thread
+  size_t threadCount = m_verificationPool->threadCount() + 1;
+  // a replica indexes the few blocks of the writing node every refresh
+  Level level = m_blocks.size() - startHeight > BLOCKCACHE_REBUILD_BATCH_SIZE ? INFO : DEBUGGING;
+  logger(level, BRIGHT_WHITE) << "Rebuilding blockchain cache using " << threadCount << " threads";
+
+  for (uint32_t batchStart = startHeight; batchStart < m_blocks.size(); batchStart += BLOCKCACHE_REBUILD_BATCH_SIZE) {
+    logger(level, BRIGHT_WHITE) << "Height " << batchStart << " of " << m_blocks.size();
+    uint32_t batchSize = static_cast<uint32_t>(std::min<uint64_t>(BLOCKCACHE_REBUILD_BATCH_SIZE, m_blocks.size() - batchStart));
+    std::vector<BlockEntry> blocks(batchSize);
+    std::vector<crypto::hash> blockHashes(batchSize);
+    std::vector<std::vector<crypto::hash>> transactionHashes(batchSize);
+
+    auto worker = [&](size_t first) {
+      for (size_t i = first; i < batchSize; i += threadCount) {
+        m_blocks.load(batchStart + i, blocks[i]);
+        blockHashes[i] = get_block_hash(blocks[i].bl);
+        transactionHashes[i].reserve(blocks[i].transactions.size());
+        for (const TransactionEntry& transaction : blocks[i].transactions) {
+          transactionHashes[i].push_back(get_transaction_hash(transaction.tx));
+        }
+      }
+    };
+
+    m_verificationPool->parallelFor(threadCount, worker);
+
+    for (uint32_t n = 0; n < batchSize; ++n) {
+      uint32_t b = batchStart + n;
+      const BlockEntry& block = blocks[n];
+      m_blockIndex.push(blockHashes[n]);
+      m_blockHeaders.push(makeBlockSummary(block));
+      m_blockFilters.push_back(buildBlockFilter(block));
+      for (uint16_t t = 0; t < block.transactions.size(); ++t) {
+        const TransactionEntry& transaction = block.transactions[t];
+        TransactionIndex transactionIndex = {b, t};
+        m_transactionMap->insert(transactionHashes[n][t], transactionIndex);
+
+        // process inputs
+        for (auto& i : transaction.tx.vin) {
+          if (i.type() == typeid(TransactionInputToKey)) {
+            const crypto::key_image& keyImage = ::boost::get<TransactionInputToKey>(i).keyImage;
+            m_spent_keys.insert(keyImage);
+            addSpentKeyToFilter(keyImage);
+          } else if (i.type() == typeid(TransactionInputMultisignature)) {
+            auto out = ::boost::get<TransactionInputMultisignature>(i);
+            m_multisignatureOutputs[out.amount].setUsed(out.outputIndex, true);
+          }
+        }
+
+        // process outputs
+        for (uint16_t o = 0; o < transaction.tx.vout.size(); ++o) {
+          const auto& out = transaction.tx.vout[o];
+          if (out.target.type() == typeid(TransactionOutputToKey)) {
+            m_outputs[out.amount].push_back(transactionIndex, o, ::boost::get<TransactionOutputToKey>(out.target).key, transaction.tx.unlockTime);
+          } else if (out.target.type() == typeid(TransactionOutputMultisignature)) {
+            m_multisignatureOutputs[out.amount].push_back(transactionIndex, o);
+          }
+        }
+
+        if (m_explorerIndexes) {
+          addToExplorerIndexes(transaction.tx, transactionIndex);
+        }
+      }
+
+      if (m_replica) {
+        m_replicaTail.push_back(std::make_shared<BlockEntry>(std::move(blocks[n])));
+        if (m_replicaTail.size() > REPLICA_TAIL_BLOCKS) {
+          m_replicaTail.pop_front();
+        }
+      }
+    }
+  }
+}
+
+void blockchain_storage::clearCache() {
+  m_blockIndex.clear();
+  m_blockHeaders.clear();
+  m_blockFilters.clear();
+  m_transactionMap->clear();
+  m_spent_keys.clear();
+  m_spentKeysFilter.clear();
+  m_outputs.clear();
+  m_multisignatureOutputs.clear();
+  if (m_explorerIndexes) {
+    m_explorerIndexes.reset(new ExplorerIndexes());
+  }
+}
+
+bool blockchain_storage::set_blocks_cache_size(size_t cacheSize, uint64_t memoryBudget) {
+  if (cacheSize == 0 && memoryBudget == 0) {
+    return false;
+  }
+
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  m_blocksCacheSize = cacheSize != 0 ? cacheSize : BLOCKS_CACHE_DEFAULT_SIZE;
+  m_blocksCacheMemory = memoryBudget;
+  size_t poolSize = getBlocksCachePoolSize();
+  logger(INFO) << "Blocks cache size is set to " << poolSize << " blocks";
+  return m_blocks.setPoolSize(poolSize);
+}
+
+void blockchain_storage::set_blocks_cache_policy(SwappedCachePolicy policy) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  m_blocksCachePolicy = policy;
+  m_blocks.setCachePolicy(policy);
+}
+
+SwappedVectorCacheStatistics blockchain_storage::get_blocks_cache_statistics() {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blocks.getCacheStatistics();
+}
+
+void blockchain_storage::set_blocks_cache_memory_limit(uint64_t limit) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (limit == m_blocksCacheMemoryLimit) {
+    return;
+  }
+
+  m_blocksCacheMemoryLimit = limit;
+  m_blocks.setPoolSize(getBlocksCachePoolSize());
+}
+
+uint64_t blockchain_storage::get_blocks_cache_memory_usage() {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blocks.getCacheStatistics().size * m_blocks.getAverageItemSize() * BLOCKS_CACHE_ITEM_OVERHEAD;
+}
+
+size_t blockchain_storage::getBlocksCachePoolSize() const {
+  uint64_t itemSize = m_blocks.getAverageItemSize() * BLOCKS_CACHE_ITEM_OVERHEAD;
+  if (itemSize == 0) {
+    return m_blocksCacheSize;
+  }
+
+  uint64_t poolSize = m_blocksCacheMemory == 0 ? m_blocksCacheSize : std::max<uint64_t>(m_blocksCacheMemory / itemSize, 1);
+  if (m_blocksCacheMemoryLimit != 0) {
+    poolSize = std::min<uint64_t>(poolSize, std::max<uint64_t>(m_blocksCacheMemoryLimit / itemSize, 1));
+  }
+
+  return static_cast<size_t>(poolSize);
+}
+
+bool blockchain_storage::deinit() {
+  if (!m_replica) {
+    storeCache();
+  }
+
+  m_proofOfWorkPool.reset();
+  m_verificationPool.reset();
+  return true;
+}
+
+bool blockchain_storage::reset_and_set_genesis_block(const Block& b) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  m_blocks.clear();
+  m_blockUndos.clear();
+  m_blockIndex.clear();
+  m_blockHeaders.clear();
+  m_blockFilters.clear();
+  m_transactionMap->clear();
+
+  m_spent_keys.clear();
+  m_spentKeysFilter.clear();
+  m_alternative_chains.clear();
+  m_alternativeChildren.clear();
+  m_alternativeHeights.clear();
+  m_outputs.clear();
+  if (m_explorerIndexes) {
+    m_explorerIndexes.reset(new ExplorerIndexes());
+  }
+
+  block_verification_context bvc = boost::value_initialized<block_verification_context>();
+  add_new_block(b, bvc);
+  return bvc.m_added_to_main_chain && !bvc.m_verifivation_failed;
+}
+
+crypto::hash blockchain_storage::get_tail_id(uint64_t& height) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  height = get_current_blockchain_height() - 1;
+  return get_tail_id();
+}
+
+crypto::hash blockchain_storage::get_tail_id() {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blockIndex.getTailId();
+}
+
+bool blockchain_storage::getPoolSymmetricDifference(const std::vector<crypto::hash>& known_pool_tx_ids, const crypto::hash& known_block_id, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids) {
+  
+  std::lock_guard<decltype(m_tx_pool)> txLock(m_tx_pool);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
+
+  if (known_block_id != get_tail_id()) {
+    return false;
+  }
+
+  std::vector<crypto::hash> new_tx_ids;
+  m_tx_pool.get_difference(known_pool_tx_ids, new_tx_ids, deleted_tx_ids);
+
+  std::vector<crypto::hash> misses;
+  get_transactions(new_tx_ids, new_txs, misses, true);
+  assert(misses.empty());
+  return true;
+}
+
+bool blockchain_storage::getPoolChanges(uint64_t known_version, const crypto::hash& known_block_id, bool& isVersionActual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version) {
+  std::lock_guard<decltype(m_tx_pool)> txLock(m_tx_pool);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
+
+  if (known_block_id != get_tail_id()) {
+    return false;
+  }
+
+  std::vector<crypto::hash> new_tx_ids;
+  isVersionActual = m_tx_pool.get_changes(known_version, new_tx_ids, deleted_tx_ids, version);
+
+  std::vector<crypto::hash> misses;
+  get_transactions(new_tx_ids, new_txs, misses, true);
+  assert(misses.empty());
+  return true;
+}
+
+bool blockchain_storage::get_short_chain_history(std::list<crypto::hash>& ids) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blockIndex.getShortChainHistory(ids);
+}
+
+crypto::hash blockchain_storage::get_block_id_by_height(uint64_t height) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blockIndex.getBlockId(height);
+}
+
+bool blockchain_storage::get_block_by_hash(const crypto::hash& blockHash, Block& b) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
+  uint64_t height = 0;
+
+  if (m_blockIndex.getBlockHeight(blockHash, height)) {
+    b = m_blocks[height]->bl;
+    return true;
+  }
+
+  auto blockByHashIterator = m_alternative_chains.find(blockHash);
+  if (blockByHashIterator != m_alternative_chains.end()) {
+    b = blockByHashIterator->second.bl;
+    return true;
+  }
+
+  return false;
+}
+
+difficulty_type blockchain_storage::get_difficulty_for_next_block() {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::vector<uint64_t> timestamps;
+  std::vector<difficulty_type> commulative_difficulties;
+  size_t offset = m_blocks.size() - std::min(m_blocks.size(), static_cast<uint64_t>(m_currency.difficultyBlocksCount()));
+  if (offset == 0) {
+    ++offset;
+  }
+
+  for (; offset < m_blocks.size(); offset++) {
+    BlockSummary summary = getBlockSummary(offset);
+    timestamps.push_back(summary.timestamp);
+    commulative_difficulties.push_back(summary.cumulativeDifficulty);
+  }
+
+  return m_currency.nextDifficulty(timestamps, commulative_difficulties);
+}
+
+uint64_t blockchain_storage::getCoinsInCirculation() {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (m_blocks.empty()) {
     return 0;
   } else {
-    return m_blocks.back().already_generated_coins;
+    return getBlockSummary(m_blocks.size() - 1).generatedCoins;
   }
 }
 
@@ -486,14 +1538,14 @@ bool blockchain_storage::rollback_blockchain_switching(std::list<Block> &origina
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   // remove failed subchain
   for (size_t i = m_blocks.size() - 1; i >= rollback_height; i--) {
-    popBlock(get_block_hash(m_blocks.back().bl));
+    popBlock(m_blockIndex.getTailId());
   }
 
   // return back original chain
   for(auto &bl : original_chain) {
     block_verification_context bvc =
       boost::value_initialized<block_verification_context>();
-    bool r = pushBlock(bl, bvc);
+    bool r = pushBlock(bl, get_block_hash(bl), bvc);
     if (!(r && bvc.m_added_to_main_chain)) {
       logger(ERROR, BRIGHT_RED) << "PANIC!!! failed to add (again) block while "
         "chain switching during the rollback!";
@@ -523,8 +1575,8 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
   //disconnecting old chain
   std::list<Block> disconnected_chain;
   for (size_t i = m_blocks.size() - 1; i >= split_height; i--) {
-    Block b = m_blocks[i].bl;
-    popBlock(get_block_hash(b));
+    Block b = m_blocks[i]->bl;
+    popBlock(m_blockIndex.getTailId());
     //if (!(r)) { logger(ERROR, BRIGHT_RED) << "failed to remove block on chain switching"; return false; }
     disconnected_chain.push_front(b);
   }
@@ -533,18 +1585,18 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
   for (auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++) {
     auto ch_ent = *alt_ch_iter;
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    bool r = pushBlock(ch_ent->second.bl, bvc);
+    bool r = pushBlock(ch_ent->second.bl, ch_ent->first, bvc);
     if (!r || !bvc.m_added_to_main_chain) {
       logger(INFO, BRIGHT_WHITE) << "Failed to switch to alternative blockchain";
       rollback_blockchain_switching(disconnected_chain, split_height);
       //add_block_as_invalid(ch_ent->second, get_block_hash(ch_ent->second.bl));
-      logger(INFO, BRIGHT_WHITE) << "The block was inserted as invalid while connecting new alternative chain,  block_id: " << get_block_hash(ch_ent->second.bl);
-      m_alternative_chains.erase(ch_ent);
+      logger(INFO, BRIGHT_WHITE) << "The block was inserted as invalid while connecting new alternative chain,  block_id: " << ch_ent->first;
+      removeAlternativeBlock(ch_ent);
 
       for (auto alt_ch_to_orph_iter = ++alt_ch_iter; alt_ch_to_orph_iter != alt_chain.end(); alt_ch_to_orph_iter++) {
         //block_verification_context bvc = boost::value_initialized<block_verification_context>();
         //add_block_as_invalid((*alt_ch_iter)->second, (*alt_ch_iter)->first);
-        m_alternative_chains.erase(*alt_ch_to_orph_iter);
+        removeAlternativeBlock(*alt_ch_to_orph_iter);
       }
 
       return false;
@@ -566,7 +1618,7 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
 
   //removing all_chain entries from alternative chain
   for (auto ch_ent : alt_chain) {
-    m_alternative_chains.erase(ch_ent);
+    removeAlternativeBlock(ch_ent);
   }
 
   logger(INFO, BRIGHT_GREEN) << "REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_blocks.size();
@@ -577,7 +1629,7 @@ difficulty_type blockchain_storage::get_next_difficulty_for_alternative_chain(co
   std::vector<uint64_t> timestamps;
   std::vector<difficulty_type> commulative_difficulties;
   if (alt_chain.size() < m_currency.difficultyBlocksCount()) {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
     size_t main_chain_count = m_currency.difficultyBlocksCount() - std::min(m_currency.difficultyBlocksCount(), alt_chain.size());
     main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
@@ -586,8 +1638,9 @@ difficulty_type blockchain_storage::get_next_difficulty_for_alternative_chain(co
     if (!main_chain_start_offset)
       ++main_chain_start_offset; //skip genesis block
     for (; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset) {
-      timestamps.push_back(m_blocks[main_chain_start_offset].bl.timestamp);
-      commulative_difficulties.push_back(m_blocks[main_chain_start_offset].cumulative_difficulty);
+      BlockSummary summary = getBlockSummary(main_chain_start_offset);
+      timestamps.push_back(summary.timestamp);
+      commulative_difficulties.push_back(summary.cumulativeDifficulty);
     }
 
     if (!((alt_chain.size() + timestamps.size()) <= m_currency.difficultyBlocksCount())) {
@@ -655,6 +1708,7 @@ bool blockchain_storage::prevalidate_miner_transaction(const Block& b, uint64_t
 bool blockchain_storage::validate_miner_transaction(const Block& b, uint64_t height, size_t cumulativeBlockSize,
   uint64_t alreadyGeneratedCoins, uint64_t fee,
   uint64_t& reward, int64_t& emissionChange) {
+  Common::StageTimer stageTimer(BlockStages::get().minerTransaction);
   uint64_t minerReward = 0;
   for (auto& o : b.minerTx.vout) {
     minerReward += o.amount;
@@ -684,7 +1738,7 @@ bool blockchain_storage::validate_miner_transaction(const Block& b, uint64_t hei
 }
 
 bool blockchain_storage::get_backward_blocks_sizes(size_t from_height, std::vector<size_t>& sz, size_t count) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!(from_height < m_blocks.size())) {
     logger(ERROR, BRIGHT_RED)
       << "Internal error: get_backward_blocks_sizes called with from_height="
@@ -693,14 +1747,14 @@ bool blockchain_storage::get_backward_blocks_sizes(size_t from_height, std::vect
   }
   size_t start_offset = (from_height + 1) - std::min((from_height + 1), count);
   for (size_t i = start_offset; i != from_height + 1; i++) {
-    sz.push_back(m_blocks[i].block_cumulative_size);
+    sz.push_back(getBlockSummary(i).cumulativeSize);
   }
 
   return true;
 }
 
 bool blockchain_storage::get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!m_blocks.size()) {
     return true;
   }
@@ -717,7 +1771,7 @@ bool blockchain_storage::create_block_template(Block& b, const AccountPublicAddr
   uint64_t already_generated_coins;
 
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     height = static_cast<uint32_t>(m_blocks.size());
     diffic = get_difficulty_for_next_block();
     if (!(diffic)) {
@@ -748,7 +1802,7 @@ bool blockchain_storage::create_block_template(Block& b, const AccountPublicAddr
     b.timestamp = time(NULL);
 
     median_size = m_current_block_cumul_sz_limit / 2;
-    already_generated_coins = m_blocks.back().already_generated_coins;
+    already_generated_coins = getBlockSummary(m_blocks.size() - 1).generatedCoins;
   }
 
   size_t txs_size;
@@ -866,12 +1920,12 @@ bool blockchain_storage::complete_timestamps_vector(uint64_t start_top_height, s
   if (timestamps.size() >= m_currency.timestampCheckWindow())
     return true;
 
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   size_t need_elements = m_currency.timestampCheckWindow() - timestamps.size();
   if (!(start_top_height < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "internal error: passed start_height = " << start_top_height << " not less then m_blocks.size()=" << m_blocks.size(); return false; }
   size_t stop_offset = start_top_height > need_elements ? start_top_height - need_elements : 0;
   do {
-    timestamps.push_back(m_blocks[start_top_height].bl.timestamp);
+    timestamps.push_back(getBlockSummary(start_top_height).timestamp);
     if (start_top_height == 0)
       break;
     --start_top_height;
@@ -928,22 +1982,29 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
     //we have new block in alternative chain
 
     //build alternative subchain, front -> mainchain, back -> alternative head
+    //only blocks difficulty and timestamp checks need are taken, the rest of the fork is added if it is switched to
+    size_t window = std::max(m_currency.difficultyBlocksCount(), m_currency.timestampCheckWindow());
     blocks_ext_by_hash::iterator alt_it = it_prev; //m_alternative_chains.find()
     std::list<blocks_ext_by_hash::iterator> alt_chain;
     std::vector<uint64_t> timestamps;
-    while (alt_it != m_alternative_chains.end()) {
+    while (alt_it != m_alternative_chains.end() && alt_chain.size() < window) {
       alt_chain.push_front(alt_it);
-      timestamps.push_back(alt_it->second.bl.timestamp);
+      if (timestamps.size() < m_currency.timestampCheckWindow()) {
+        timestamps.push_back(alt_it->second.bl.timestamp);
+      }
+
       alt_it = m_alternative_chains.find(alt_it->second.bl.prevId);
     }
 
     if (alt_chain.size()) {
-      //make sure that it has right connection to main chain
-      if (!(m_blocks.size() > alt_chain.front()->second.height)) { logger(ERROR, BRIGHT_RED) << "main blockchain wrong height"; return false; }
-      crypto::hash h = null_hash;
-      get_block_hash(m_blocks[alt_chain.front()->second.height - 1].bl, h);
-      if (!(h == alt_chain.front()->second.bl.prevId)) { logger(ERROR, BRIGHT_RED) << "alternative chain have wrong connection to main chain"; return false; }
-      complete_timestamps_vector(alt_chain.front()->second.height - 1, timestamps);
+      if (alt_it == m_alternative_chains.end()) {
+        //make sure that it has right connection to main chain
+        if (!completeAlternativeChain(alt_chain)) {
+          return false;
+        }
+
+        complete_timestamps_vector(alt_chain.front()->second.height - 1, timestamps);
+      }
     } else {
       if (!(mainPrev)) { logger(ERROR, BRIGHT_RED) << "internal error: broken imperative condition it_main_prev != m_blocks_index.end()"; return false; }
       complete_timestamps_vector(mainPrevHeight, timestamps);
@@ -976,7 +2037,7 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
     difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
     if (!(current_diff)) { logger(ERROR, BRIGHT_RED) << "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!"; return false; }
     crypto::hash proof_of_work = null_hash;
-    if (!m_currency.checkProofOfWork(m_cn_context, bei.bl, current_diff, proof_of_work)) {
+    if (!checkProofOfWork(bei.bl, id, current_diff, proof_of_work)) {
       logger(INFO, BRIGHT_RED) <<
         "Block with id: " << id
         << ENDL << " for alternative chain, have not enough proof of work: " << proof_of_work
@@ -992,17 +2053,23 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
       return false;
     }
 
-    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blocks[mainPrevHeight].cumulative_difficulty;
+    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blocks[mainPrevHeight]->cumulative_difficulty;
     bei.cumulative_difficulty += current_diff;
 
+    //whole fork is switched to
+    bool reorganize = is_a_checkpoint || m_blocks.back()->cumulative_difficulty < bei.cumulative_difficulty;
+    if (reorganize && alt_chain.size() && !completeAlternativeChain(alt_chain)) {
+      return false;
+    }
+
 #ifdef _DEBUG
     auto i_dres = m_alternative_chains.find(id);
     if (!(i_dres == m_alternative_chains.end())) { logger(ERROR, BRIGHT_RED) << "insertion of new alternative block returned as it already exist"; return false; }
 #endif
 
-    auto i_res = m_alternative_chains.insert(blocks_ext_by_hash::value_type(id, bei));
-    if (!(i_res.second)) { logger(ERROR, BRIGHT_RED) << "insertion of new alternative block returned as it already exist"; return false; }
-    alt_chain.push_back(i_res.first);
+    auto i_res = addAlternativeBlock(id, bei);
+    if (i_res == m_alternative_chains.end()) { logger(ERROR, BRIGHT_RED) << "insertion of new alternative block returned as it already exist"; return false; }
+    alt_chain.push_back(i_res);
 
     if (is_a_checkpoint) {
       //do reorganize!
@@ -1013,11 +2080,11 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
       if (r) bvc.m_added_to_main_chain = true;
       else bvc.m_verifivation_failed = true;
       return r;
-    } else if (m_blocks.back().cumulative_difficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
+    } else if (reorganize) //check if difficulty bigger then in main chain
     {
       //do reorganize!
       logger(INFO, BRIGHT_GREEN) <<
-        "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cum_difficulty " << m_blocks.back().cumulative_difficulty
+        "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cum_difficulty " << m_blocks.back()->cumulative_difficulty
         << ENDL << " alternative blockchain size: " << alt_chain.size() << " with cum_difficulty " << bei.cumulative_difficulty;
       bool r = switch_to_alternative_blockchain(alt_chain, false);
       if (r) bvc.m_added_to_main_chain = true;
@@ -1029,6 +2096,7 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
         << ENDL << "id:\t" << id
         << ENDL << "PoW:\t" << proof_of_work
         << ENDL << "difficulty:\t" << current_diff;
+      bvc.m_added_to_alt_chain = true;
       return true;
     }
     } else {
@@ -1041,14 +2109,78 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
   return true;
     }
 
+// Extends alt_chain back to the first block of its fork and checks the fork still leaves main chain there
+bool blockchain_storage::completeAlternativeChain(std::list<blocks_ext_by_hash::iterator>& alt_chain) {
+  auto alt_it = m_alternative_chains.find(alt_chain.front()->second.bl.prevId);
+  while (alt_it != m_alternative_chains.end()) {
+    alt_chain.push_front(alt_it);
+    alt_it = m_alternative_chains.find(alt_it->second.bl.prevId);
+  }
+
+  if (!(m_blocks.size() > alt_chain.front()->second.height)) { logger(ERROR, BRIGHT_RED) << "main blockchain wrong height"; return false; }
+  crypto::hash h = m_blockIndex.getBlockId(alt_chain.front()->second.height - 1);
+  if (!(h == alt_chain.front()->second.bl.prevId)) { logger(ERROR, BRIGHT_RED) << "alternative chain have wrong connection to main chain"; return false; }
+  return true;
+}
+
+blockchain_storage::blocks_ext_by_hash::iterator blockchain_storage::addAlternativeBlock(const crypto::hash& id, const BlockEntry& block) {
+  auto result = m_alternative_chains.insert(blocks_ext_by_hash::value_type(id, block));
+  if (!result.second) {
+    return m_alternative_chains.end();
+  }
+
+  m_alternativeChildren.insert(std::make_pair(block.bl.prevId, id));
+  m_alternativeHeights.insert(std::make_pair(block.height, id));
+  return result.first;
+}
+
+void blockchain_storage::removeAlternativeBlock(blocks_ext_by_hash::iterator it) {
+  auto children = m_alternativeChildren.equal_range(it->second.bl.prevId);
+  for (auto child = children.first; child != children.second; ++child) {
+    if (child->second == it->first) {
+      m_alternativeChildren.erase(child);
+      break;
+    }
+  }
+
+  auto heights = m_alternativeHeights.equal_range(it->second.height);
+  for (auto height = heights.first; height != heights.second; ++height) {
+    if (height->second == it->first) {
+      m_alternativeHeights.erase(height);
+      break;
+    }
+  }
+
+  m_alternative_chains.erase(it);
+}
+
+// Lowest alternative block starts the oldest fork or what is left of one, it goes together with every block built on it
+void blockchain_storage::evictAlternativeBlocks() {
+  while (m_alternative_chains.size() > ALTERNATIVE_BLOCKS_LIMIT) {
+    std::vector<crypto::hash> fork(1, m_alternativeHeights.begin()->second);
+    for (size_t i = 0; i < fork.size(); ++i) {
+      auto children = m_alternativeChildren.equal_range(fork[i]);
+      for (auto child = children.first; child != children.second; ++child) {
+        fork.push_back(child->second);
+      }
+    }
+
+    logger(DEBUGGING) << "Evicting " << fork.size() << " alternative blocks from height " << m_alternativeHeights.begin()->first;
+    for (const crypto::hash& id : fork) {
+      removeAlternativeBlock(m_alternative_chains.find(id));
+    }
+  }
+}
+
 bool blockchain_storage::get_blocks(uint64_t start_offset, size_t count, std::list<Block>& blocks, std::list<Transaction>& txs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_offset >= m_blocks.size())
     return false;
+  m_blocks.prefetch(start_offset, start_offset + count);
   for (size_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++) {
-    blocks.push_back(m_blocks[i].bl);
+    blocks.push_back(m_blocks[i]->bl);
     std::list<crypto::hash> missed_ids;
-    get_transactions(m_blocks[i].bl.txHashes, txs, missed_ids);
+    get_transactions(m_blocks[i]->bl.txHashes, txs, missed_ids);
     if (!(!missed_ids.size())) { logger(ERROR, BRIGHT_RED) << "have missed transactions in own block in main blockchain"; return false; }
   }
 
@@ -1056,20 +2188,21 @@ bool blockchain_storage::get_blocks(uint64_t start_offset, size_t count, std::li
 }
 
 bool blockchain_storage::get_blocks(uint64_t start_offset, size_t count, std::list<Block>& blocks) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_offset >= m_blocks.size()) {
     return false;
   }
 
+  m_blocks.prefetch(start_offset, start_offset + count);
   for (size_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++) {
-    blocks.push_back(m_blocks[i].bl);
+    blocks.push_back(m_blocks[i]->bl);
   }
 
   return true;
 }
 
 bool blockchain_storage::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   rsp.current_blockchain_height = get_current_blockchain_height();
   std::list<Block> blocks;
   get_blocks(arg.blocks, blocks, rsp.missed_ids);
@@ -1101,7 +2234,7 @@ bool blockchain_storage::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request&
 }
 
 bool blockchain_storage::get_alternative_blocks(std::list<Block>& blocks) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   for (auto& alt_bl : m_alternative_chains) {
     blocks.push_back(alt_bl.second.bl);
   }
@@ -1110,49 +2243,40 @@ bool blockchain_storage::get_alternative_blocks(std::list<Block>& blocks) {
 }
 
 size_t blockchain_storage::get_alternative_blocks_count() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_alternative_chains.size();
 }
 
-bool blockchain_storage::add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  const Transaction& tx = transactionByIndex(amount_outs[i].first).tx;
-  if (!(tx.vout.size() > amount_outs[i].second)) {
-    logger(ERROR, BRIGHT_RED) << "internal error: in global outs index, transaction out index="
-      << amount_outs[i].second << " more than transaction outputs = " << tx.vout.size() << ", for tx id = " << get_transaction_hash(tx); return false;
-  }
-  if (!(tx.vout[amount_outs[i].second].target.type() == typeid(TransactionOutputToKey))) { logger(ERROR, BRIGHT_RED) << "unknown tx out type"; return false; }
-
+bool blockchain_storage::add_out_to_get_random_outs(const KeyOutputs& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t height, uint64_t currentTime, size_t i) {
   //check if transaction is unlocked
-  if (!is_tx_spendtime_unlocked(tx.unlockTime))
+  if (!is_tx_spendtime_unlocked(amount_outs.unlockTimes[i], height, currentTime))
     return false;
 
   COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
   oen.global_amount_index = i;
-  oen.out_key = boost::get<TransactionOutputToKey>(tx.vout[amount_outs[i].second].target).key;
+  oen.out_key = amount_outs.keys[i];
   return true;
 }
 
-size_t blockchain_storage::find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  if (amount_outs.empty()) {
+size_t blockchain_storage::find_end_of_allowed_index(const KeyOutputs& amount_outs) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  uint64_t height = get_current_blockchain_height();
+  if (height < m_currency.minedMoneyUnlockWindow()) {
     return 0;
   }
 
-  size_t i = amount_outs.size();
-  do {
-    --i;
-    if (amount_outs[i].first.block + m_currency.minedMoneyUnlockWindow() <= get_current_blockchain_height()) {
-      return i + 1;
-    }
-  } while (i != 0);
-
-  return 0;
+  // outputs of blocks with block + unlock window <= height
+  return amount_outs.countUpToHeight(static_cast<uint32_t>(height - m_currency.minedMoneyUnlockWindow()));
 }
 
 bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
+  // whole request is served against one chain state, sampling state is shared by all amounts
+  uint64_t height = get_current_blockchain_height();
+  uint64_t currentTime = static_cast<uint64_t>(time(NULL));
+  ShuffleGenerator<size_t, crypto::random_engine<size_t>> generator(0);
+  res.outs.reserve(req.amounts.size());
   for (uint64_t amount : req.amounts) {
     COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs = *res.outs.insert(res.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount());
     result_outs.amount = amount;
@@ -1163,16 +2287,16 @@ bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDO
       continue;//actually this is strange situation, wallet should use some real outs when it lookup for some mix, so, at least one out for this amount should exist
     }
 
-    std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs = it->second;
+    const KeyOutputs& amount_outs = it->second;
     //it is not good idea to use top fresh outs, because it increases possibility of transaction canceling on split
     //lets find upper bound of not fresh outs
     size_t up_index_limit = find_end_of_allowed_index(amount_outs);
     if (!(up_index_limit <= amount_outs.size())) { logger(ERROR, BRIGHT_RED) << "internal error: find_end_of_allowed_index returned wrong index=" << up_index_limit << ", with amount_outs.size = " << amount_outs.size(); return false; }
 
     if (up_index_limit > 0) {
-      ShuffleGenerator<size_t, crypto::random_engine<size_t>> generator(up_index_limit);
+      generator.reset(up_index_limit);
       for (uint64_t j = 0; j < up_index_limit && result_outs.outs.size() < req.outs_count; ++j) {
-        add_out_to_get_random_outs(amount_outs, result_outs, amount, generator());
+        add_out_to_get_random_outs(amount_outs, result_outs, height, currentTime, generator());
       }
     }
   }
@@ -1180,7 +2304,7 @@ bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDO
 }
 
 bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   if (!qblock_ids.size() /*|| !req.m_total_height*/) {
     logger(ERROR, BRIGHT_RED) <<
@@ -1188,10 +2312,10 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
     return false;
   }
   //check genesis match
-  if (qblock_ids.back() != get_block_hash(m_blocks[0].bl)) {
+  if (qblock_ids.back() != m_blockIndex.getBlockId(0)) {
     logger(ERROR, BRIGHT_RED) <<
       "Client sent wrong NOTIFY_REQUEST_CHAIN: genesis block missmatch: " << ENDL << "id: "
-      << qblock_ids.back() << ", " << ENDL << "expected: " << get_block_hash(m_blocks[0].bl)
+      << qblock_ids.back() << ", " << ENDL << "expected: " << m_blockIndex.getBlockId(0)
       << "," << ENDL << " dropping connection";
     return false;
   }
@@ -1208,37 +2332,153 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
 }
 
 uint64_t blockchain_storage::block_difficulty(size_t i) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!(i < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "wrong block index i = " << i << " at blockchain_storage::block_difficulty()"; return false; }
   if (i == 0)
-    return m_blocks[i].cumulative_difficulty;
+    return m_blocks[i]->cumulative_difficulty;
+
+  return m_blocks[i]->cumulative_difficulty - m_blocks[i - 1]->cumulative_difficulty;
+}
+
+bool blockchain_storage::get_block_short_headers(uint64_t start_height, size_t max_count, std::list<block_short_header>& headers) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (start_height >= m_blocks.size()) {
+    return false;
+  }
+
+  uint64_t end_height = std::min<uint64_t>(m_blocks.size(), start_height + max_count);
+  m_blocks.prefetch(start_height, end_height);
+  difficulty_type previous_cumulative_difficulty = start_height == 0 ? 0 : m_blocks[start_height - 1]->cumulative_difficulty;
+  for (uint64_t height = start_height; height < end_height; ++height) {
+    std::shared_ptr<const BlockEntry> entry = m_blocks[static_cast<size_t>(height)];
+    block_short_header header;
+    header.hash = m_blockIndex.getBlockId(height);
+    header.height = height;
+    header.timestamp = entry->bl.timestamp;
+    header.difficulty = entry->cumulative_difficulty - previous_cumulative_difficulty;
+    header.size = entry->block_cumulative_size;
+    header.reward = get_outs_money_amount(entry->bl.minerTx);
+    header.tx_count = entry->bl.txHashes.size();
+    headers.push_back(header);
+    previous_cumulative_difficulty = entry->cumulative_difficulty;
+  }
+
+  return true;
+}
+
+bool blockchain_storage::get_block_filters(uint64_t start_height, size_t max_count, std::list<std::string>& filters) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (start_height >= m_blockFilters.size()) {
+    return false;
+  }
+
+  uint64_t end_height = std::min<uint64_t>(m_blockFilters.size(), start_height + max_count);
+  filters.insert(filters.end(), m_blockFilters.begin() + static_cast<size_t>(start_height), m_blockFilters.begin() + static_cast<size_t>(end_height));
+  return true;
+}
+
+bool blockchain_storage::getBlockExportRows(uint64_t startHeight, size_t maxCount, std::vector<BlockExportRow>& rows) {
+  rows.clear();
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (startHeight >= m_blocks.size()) {
+    return false;
+  }
+
+  size_t endHeight = static_cast<size_t>(std::min<uint64_t>(m_blocks.size(), startHeight + maxCount));
+  rows.reserve(endHeight - static_cast<size_t>(startHeight));
+  for (size_t i = static_cast<size_t>(startHeight); i < endHeight; ++i) {
+    std::shared_ptr<const BlockEntry> block = m_blocks[i];
+    BlockExportRow row;
+    row.height = static_cast<uint32_t>(i);
+    row.id = m_blockIndex.getBlockId(i);
+    row.timestamp = block->bl.timestamp;
+    row.difficulty = block_difficulty(i);
+    row.cumulativeDifficulty = block->cumulative_difficulty;
+    row.cumulativeSize = block->block_cumulative_size;
+    row.generatedCoins = block->already_generated_coins;
+    row.nonce = block->bl.nonce;
+    row.majorVersion = block->bl.majorVersion;
+    row.transactionCount = static_cast<uint32_t>(block->bl.txHashes.size());
+    rows.push_back(row);
+  }
+
+  return true;
+}
+
+std::vector<uint64_t> blockchain_storage::getKeyOutputAmounts() {
+  std::vector<uint64_t> amounts;
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  amounts.reserve(m_outputs.size());
+  for (const outputs_container::value_type& v : m_outputs) {
+    if (!v.second.empty()) {
+      amounts.push_back(v.first);
+    }
+  }
+
+  std::sort(amounts.begin(), amounts.end());
+  return amounts;
+}
+
+bool blockchain_storage::getKeyOutputExportRows(uint64_t amount, uint32_t startIndex, size_t maxCount, std::vector<OutputExportRow>& rows) {
+  rows.clear();
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  auto it = m_outputs.find(amount);
+  if (it == m_outputs.end() || startIndex >= it->second.size()) {
+    return false;
+  }
+
+  const KeyOutputs& outputs = it->second;
+  size_t endIndex = std::min<size_t>(outputs.size(), static_cast<size_t>(startIndex) + maxCount);
+  rows.reserve(endIndex - startIndex);
+  for (size_t i = startIndex; i < endIndex; ++i) {
+    const TransactionIndex& transactionIndex = outputs.references[i].first;
+    std::shared_ptr<const BlockEntry> block = m_blocks[transactionIndex.block];
+    OutputExportRow row;
+    row.amount = amount;
+    row.globalIndex = static_cast<uint32_t>(i);
+    // hashes of block transactions are in the block, only the miner transaction is hashed
+    row.transactionHash = transactionIndex.transaction == 0 ? get_transaction_hash(block->bl.minerTx) :
+      block->bl.txHashes[transactionIndex.transaction - 1];
+    row.outputIndex = outputs.references[i].second;
+    row.key = outputs.keys[i];
+    row.unlockTime = outputs.unlockTimes[i];
+    rows.push_back(row);
+  }
 
-  return m_blocks[i].cumulative_difficulty - m_blocks[i - 1].cumulative_difficulty;
+  return true;
 }
 
 void blockchain_storage::print_blockchain(uint64_t start_index, uint64_t end_index) {
-  std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  if (start_index >= m_blocks.size()) {
+  if (start_index >= get_current_blockchain_height()) {
     logger(INFO, BRIGHT_WHITE) <<
-      "Wrong starter index set: " << start_index << ", expected max index " << m_blocks.size() - 1;
+      "Wrong starter index set: " << start_index << ", expected max index " << get_current_blockchain_height() - 1;
     return;
   }
 
-  for (size_t i = start_index; i != m_blocks.size() && i != end_index; i++) {
-    ss << "height " << i << ", timestamp " << m_blocks[i].bl.timestamp << ", cumul_dif " << m_blocks[i].cumulative_difficulty << ", cumul_size " << m_blocks[i].block_cumulative_size
-      << "\nid\t\t" << get_block_hash(m_blocks[i].bl)
-      << "\ndifficulty\t\t" << block_difficulty(i) << ", nonce " << m_blocks[i].bl.nonce << ", tx_count " << m_blocks[i].bl.txHashes.size() << ENDL;
+  logger(DEBUGGING) << "Current blockchain:";
+  std::vector<BlockExportRow> rows;
+  for (uint64_t height = start_index; height < end_index; height += rows.size()) {
+    if (!getBlockExportRows(height, static_cast<size_t>(std::min<uint64_t>(EXPORT_CHUNK_SIZE, end_index - height)), rows)) {
+      break;
+    }
+
+    std::stringstream ss;
+    for (const BlockExportRow& row : rows) {
+      ss << "height " << row.height << ", timestamp " << row.timestamp << ", cumul_dif " << row.cumulativeDifficulty << ", cumul_size " << row.cumulativeSize
+        << "\nid\t\t" << row.id
+        << "\ndifficulty\t\t" << row.difficulty << ", nonce " << row.nonce << ", tx_count " << row.transactionCount << ENDL;
+    }
+
+    logger(DEBUGGING) << ss.str();
   }
-  logger(DEBUGGING) <<
-    "Current blockchain:" << ENDL << ss.str();
+
   logger(INFO, BRIGHT_WHITE) <<
     "Blockchain printed with log level 1";
 }
 
 void blockchain_storage::print_blockchain_index() {
   std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   std::list<crypto::hash> blockIds;
   m_blockIndex.getBlockIds(0, std::numeric_limits<size_t>::max(), blockIds);
@@ -1255,19 +2495,19 @@ void blockchain_storage::print_blockchain_index() {
 }
 
 void blockchain_storage::print_blockchain_outs(const std::string& file) {
-  std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  for (const outputs_container::value_type& v : m_outputs) {
-    const std::vector<std::pair<TransactionIndex, uint16_t>>& vals = v.second;
-    if (!vals.empty()) {
-      ss << "amount: " << v.first << ENDL;
-      for (size_t i = 0; i != vals.size(); i++) {
-        ss << "\t" << get_transaction_hash(transactionByIndex(vals[i].first).tx) << ": " << vals[i].second << ENDL;
+  std::ofstream output(file, std::ios::out | std::ios::trunc);
+  std::vector<OutputExportRow> rows;
+  for (uint64_t amount : getKeyOutputAmounts()) {
+    output << "amount: " << amount << ENDL;
+    for (uint32_t index = 0; getKeyOutputExportRows(amount, index, EXPORT_CHUNK_SIZE, rows); index += static_cast<uint32_t>(rows.size())) {
+      for (const OutputExportRow& row : rows) {
+        output << "\t" << row.transactionHash << ": " << row.outputIndex << ENDL;
       }
     }
   }
 
-  if (Common::saveStringToFile(file, ss.str())) {
+  output.flush();
+  if (output) {
     logger(INFO, BRIGHT_WHITE) <<
       "Current outputs index writen to file: " << file;
   } else {
@@ -1277,7 +2517,7 @@ void blockchain_storage::print_blockchain_outs(const std::string& file) {
 }
 
 bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!find_blockchain_supplement(qblock_ids, resp.start_height))
     return false;
 
@@ -1288,26 +2528,95 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
 }
 
 bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<Block, std::list<Transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!find_blockchain_supplement(qblock_ids, start_height)) {
     return false;
   }
 
   total_height = get_current_blockchain_height();
+  m_blocks.prefetch(start_height, start_height + max_count);
   size_t count = 0;
   for (size_t i = start_height; i != m_blocks.size() && count < max_count; i++, count++) {
     blocks.resize(blocks.size() + 1);
-    blocks.back().first = m_blocks[i].bl;
+    blocks.back().first = m_blocks[i]->bl;
     std::list<crypto::hash> mis;
-    get_transactions(m_blocks[i].bl.txHashes, blocks.back().second, mis);
+    get_transactions(m_blocks[i]->bl.txHashes, blocks.back().second, mis);
     if (!(!mis.size())) { logger(ERROR, BRIGHT_RED) << "internal error, transaction from block not found"; return false; }
   }
 
   return true;
 }
 
+bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<block_complete_entry>& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (!find_blockchain_supplement(qblock_ids, start_height)) {
+    return false;
+  }
+
+  total_height = get_current_blockchain_height();
+  size_t count = std::min(max_count, static_cast<size_t>(m_blocks.size() - start_height));
+  m_blocks.prefetch(start_height, start_height + count);
+  std::vector<block_complete_entry> entries(count);
+  // Transactions are taken from the block entry itself, so no transaction map lookups are done. Pool threads only
+  // read m_blocks, which is safe while the shared lock is held by this thread.
+  auto serializeBlock = [&](size_t i) {
+    std::shared_ptr<const BlockEntry> block = m_blocks[start_height + i];
+    entries[i].block = block_to_blob(block->bl);
+    for (size_t t = 1; t < block->transactions.size(); ++t) {
+      entries[i].txs.push_back(tx_to_blob(block->transactions[t].tx));
+    }
+  };
+
+  if (count > 1 && m_verificationPool && m_verificationPool->threadCount() != 0) {
+    m_verificationPool->parallelFor(count, serializeBlock);
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      serializeBlock(i);
+    }
+  }
+
+  std::move(entries.begin(), entries.end(), std::back_inserter(blocks));
+
+  return true;
+}
+
+bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::vector<crypto::hash>& block_ids, uint64_t& total_height, uint64_t& start_height, size_t max_count) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (!find_blockchain_supplement(qblock_ids, start_height)) {
+    return false;
+  }
+
+  total_height = get_current_blockchain_height();
+  size_t count = std::min(max_count, static_cast<size_t>(m_blocks.size() - start_height));
+  block_ids.reserve(block_ids.size() + count);
+  for (size_t i = 0; i < count; ++i) {
+    block_ids.push_back(m_blockIndex.getBlockId(start_height + i));
+  }
+
+  return true;
+}
+
+bool blockchain_storage::get_serialized_blocks(const std::vector<crypto::hash>& block_ids, std::list<block_complete_entry>& blocks) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  for (const crypto::hash& id : block_ids) {
+    uint64_t height;
+    if (!m_blockIndex.getBlockHeight(id, height)) {
+      return false;
+    }
+
+    std::shared_ptr<const BlockEntry> block = m_blocks[static_cast<size_t>(height)];
+    blocks.emplace_back();
+    blocks.back().block = block_to_blob(block->bl);
+    for (size_t t = 1; t < block->transactions.size(); ++t) {
+      blocks.back().txs.push_back(tx_to_blob(block->transactions[t].tx));
+    }
+  }
+
+  return true;
+}
+
 bool blockchain_storage::have_block(const crypto::hash& id) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (m_blockIndex.hasBlock(id))
     return true;
 
@@ -1317,111 +2626,400 @@ bool blockchain_storage::have_block(const crypto::hash& id) {
   return false;
 }
 
-size_t blockchain_storage::get_total_transactions() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  return m_transactionMap.size();
-}
+size_t blockchain_storage::get_total_transactions() {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_transactionMap->size();
+}
+
+bool blockchain_storage::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  TransactionIndex transactionIndex;
+  if (!m_transactionMap->find(tx_id, transactionIndex)) {
+    logger(WARNING, YELLOW) << "warning: get_tx_outputs_gindexs failed to find transaction with id = " << tx_id;
+    return false;
+  }
+
+  std::shared_ptr<const TransactionEntry> transaction = transactionByIndex(transactionIndex);
+  const TransactionEntry& tx = *transaction;
+  if (!(tx.m_global_output_indexes.size())) { logger(ERROR, BRIGHT_RED) << "internal error: global indexes for transaction " << tx_id << " is empty"; return false; }
+  indexs.resize(tx.m_global_output_indexes.size());
+  for (size_t i = 0; i < tx.m_global_output_indexes.size(); ++i) {
+    indexs[i] = tx.m_global_output_indexes[i];
+  }
+
+  return true;
+}
+
+bool blockchain_storage::check_tx_inputs(const Transaction& tx, uint64_t& max_used_block_height, crypto::hash& max_used_block_id, BlockInfo* tail) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
+  if (tail)
+    tail->id = get_tail_id(tail->height);
+
+  bool res = check_tx_inputs(tx, &max_used_block_height);
+  if (!res) return false;
+  if (!(max_used_block_height < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_blocks.size(); return false; }
+  max_used_block_id = m_blockIndex.getBlockId(max_used_block_height);
+  return true;
+}
+
+bool blockchain_storage::have_tx_keyimges_as_spent(const Transaction &tx) {
+  for (const auto& in : tx.vin) {
+    if (in.type() == typeid(TransactionInputToKey)) {
+      if (have_tx_keyimg_as_spent(boost::get<TransactionInputToKey>(in).keyImage)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool blockchain_storage::check_tx_inputs(const Transaction& tx, uint64_t* pmax_used_block_height, std::vector<RingSignatureCheck>* deferredChecks) {
+  crypto::hash tx_prefix_hash = get_transaction_prefix_hash(tx);
+  return check_tx_inputs(tx, tx_prefix_hash, pmax_used_block_height, deferredChecks);
+}
+
+bool blockchain_storage::check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height, std::vector<RingSignatureCheck>* deferredChecks) {
+  BlockStages& stages = BlockStages::get();
+  Common::StageTimer stageTimer(stages.txInputs);
+  size_t inputIndex = 0;
+  if (pmax_used_block_height) {
+    *pmax_used_block_height = 0;
+  }
+
+  crypto::hash transactionHash = get_transaction_hash(tx);
+  // Ring signatures are collected while inputs are checked against indexes and verified together afterwards
+  std::vector<RingSignatureCheck> ringSignatureChecks;
+  ringSignatureChecks.reserve(tx.vin.size());
+  for (const auto& txin : tx.vin) {
+    assert(inputIndex < tx.signatures.size());
+    if (txin.type() == typeid(TransactionInputToKey)) {
+      const TransactionInputToKey& in_to_key = boost::get<TransactionInputToKey>(txin);
+      if (!(!in_to_key.keyOffsets.empty())) { logger(ERROR, BRIGHT_RED) << "empty in_to_key.keyOffsets in transaction with id " << get_transaction_hash(tx); return false; }
+
+      Common::StageTimer keyImageTimer(stages.keyImages);
+      if (have_tx_keyimg_as_spent(in_to_key.keyImage)) {
+        logger(DEBUGGING) <<
+          "Key image already spent in blockchain: " << Common::podToHex(in_to_key.keyImage);
+        return false;
+      }
+
+      keyImageTimer.stop();
+      ringSignatureChecks.emplace_back();
+      if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height, &ringSignatureChecks.back())) {
+        logger(INFO, BRIGHT_WHITE) <<
+          "Failed to check ring signature for tx " << transactionHash;
+        return false;
+      }
+
+      if (ringSignatureChecks.back().outputKeys.empty()) {
+        ringSignatureChecks.pop_back();
+      } else {
+        ringSignatureChecks.back().prefixHash = tx_prefix_hash;
+      }
+
+      ++inputIndex;
+    } else if (txin.type() == typeid(TransactionInputMultisignature)) {
+      if (!validateInput(::boost::get<TransactionInputMultisignature>(txin), transactionHash, tx_prefix_hash, tx.signatures[inputIndex])) {
+        return false;
+      }
+
+      ++inputIndex;
+    } else {
+      logger(INFO, BRIGHT_WHITE) <<
+        "Transaction << " << transactionHash << " contains input of unsupported type.";
+      return false;
+    }
+  }
+
+  if (deferredChecks) {
+    std::move(ringSignatureChecks.begin(), ringSignatureChecks.end(), std::back_inserter(*deferredChecks));
+    return true;
+  }
+
+  Common::StageTimer ringSignaturesTimer(stages.ringSignatures);
+  if (!checkRingSignatures(ringSignatureChecks)) {
+    logger(INFO, BRIGHT_WHITE) <<
+      "Failed to check ring signature for tx " << transactionHash;
+    return false;
+  }
+
+  return true;
+}
+
+void blockchain_storage::set_fast_sync(bool enabled) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  m_fastSync = enabled;
+  updateCheckpointZone();
+}
+
+bool blockchain_storage::is_fast_sync() {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_fastSync;
+}
+
+void blockchain_storage::prepareBlocks(const std::vector<Block>& blocks) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  // Without worker threads nobody would run the tasks, pushBlock computes proofs of work itself
+  if (!m_proofOfWorkPool || m_proofOfWorkPool->threadCount() == 0) {
+    return;
+  }
+
+  // Blocks are split between tasks, each task uses own cn_context for all its blocks
+  size_t taskCount = m_proofOfWorkPool->threadCount();
+  std::vector<std::vector<std::pair<const Block*, std::shared_ptr<std::promise<crypto::hash>>>>> tasks(taskCount);
+  {
+    std::lock_guard<std::mutex> lock(m_preparedProofsOfWorkMutex);
+    if (m_preparedProofsOfWork.size() > PREPARED_PROOFS_OF_WORK_LIMIT) {
+      m_preparedProofsOfWork.clear();
+    }
+
+    size_t taskIndex = 0;
+    for (const Block& block : blocks) {
+      if (m_checkpoints.is_in_checkpoint_zone(get_block_height(block))) {
+        continue;
+      }
+
+      crypto::hash blockHash = get_block_hash(block);
+      crypto::hash proofOfWork;
+      if (m_preparedProofsOfWork.count(blockHash) != 0 || m_longHashCache.get(blockHash, proofOfWork)) {
+        continue;
+      }
+
+      std::shared_ptr<std::promise<crypto::hash>> promise = std::make_shared<std::promise<crypto::hash>>();
+      m_preparedProofsOfWork.insert(std::make_pair(blockHash, promise->get_future().share()));
+      tasks[taskIndex++ % taskCount].push_back(std::make_pair(&block, promise));
+    }
+  }
+
+  for (auto& task : tasks) {
+    if (task.empty()) {
+      continue;
+    }
+
+    // Blocks are copied, caller does not have to keep them
+    std::vector<std::pair<Block, std::shared_ptr<std::promise<crypto::hash>>>> taskBlocks;
+    taskBlocks.reserve(task.size());
+    for (auto& item : task) {
+      taskBlocks.push_back(std::make_pair(*item.first, item.second));
+    }
+
+    auto taskData = std::make_shared<decltype(taskBlocks)>(std::move(taskBlocks));
+    m_proofOfWorkPool->addTask([taskData] {
+      crypto::cn_context context;
+      for (auto& item : *taskData) {
+        crypto::hash proofOfWork;
+        if (get_block_longhash(context, item.first, proofOfWork)) {
+          item.second->set_value(proofOfWork);
+        } else {
+          item.second->set_exception(std::make_exception_ptr(std::runtime_error("Failed to get block long hash")));
+        }
+      }
+    });
+  }
+}
+
+bool blockchain_storage::checkBlockHeaders(const std::vector<Block>& headers, bool& checked, bool& heavier) {
+  checked = false;
+  heavier = false;
+  if (headers.empty()) {
+    return true;
+  }
+
+  std::vector<crypto::hash> ids;
+  ids.reserve(headers.size());
+  for (size_t i = 0; i < headers.size(); ++i) {
+    ids.push_back(get_block_hash(headers[i]));
+    if (i != 0 && headers[i].prevId != ids[i - 1]) {
+      logger(DEBUGGING) << "Block header " << ids[i] << " doesn't continue the previous one";
+      return false;
+    }
+  }
+
+  size_t windowSize = m_currency.difficultyBlocksCount();
+  std::deque<uint64_t> timestamps;
+  std::deque<difficulty_type> cumulativeDifficulties;
+  std::vector<bool> inCheckpointZone(headers.size());
+  difficulty_type tailCumulativeDifficulty;
+  Common::ThreadPool* pool;
+  {
+    Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    uint64_t parentHeight;
+    if (!m_blockIndex.getBlockHeight(headers.front().prevId, parentHeight)) {
+      // alternative chain, its blocks are checked when they are added
+      return true;
+    }
+
+    uint64_t startHeight = parentHeight + 1;
+    for (uint64_t height = startHeight - std::min<uint64_t>(startHeight, windowSize); height < startHeight; ++height) {
+      if (height == 0) {
+        continue;
+      }
+
+      BlockSummary summary = getBlockSummary(height);
+      timestamps.push_back(summary.timestamp);
+      cumulativeDifficulties.push_back(summary.cumulativeDifficulty);
+    }
+
+    for (size_t i = 0; i < headers.size(); ++i) {
+      if (!m_checkpoints.check_block(startHeight + i, ids[i])) {
+        logger(DEBUGGING) << "Block header " << ids[i] << " doesn't match a checkpoint";
+        return false;
+      }
+
+      inCheckpointZone[i] = m_checkpoints.is_in_checkpoint_zone(startHeight + i);
+    }
+
+    tailCumulativeDifficulty = getBlockSummary(m_blocks.size() - 1).cumulativeDifficulty;
+    pool = m_proofOfWorkPool.get();
+  }
+
+  // difficulty of every header depends on the previous ones, it is cheap and computed in order
+  std::vector<difficulty_type> difficulties(headers.size());
+  difficulty_type cumulativeDifficulty = cumulativeDifficulties.empty() ? 0 : cumulativeDifficulties.back();
+  for (size_t i = 0; i < headers.size(); ++i) {
+    difficulties[i] = m_currency.nextDifficulty(std::vector<uint64_t>(timestamps.begin(), timestamps.end()),
+      std::vector<difficulty_type>(cumulativeDifficulties.begin(), cumulativeDifficulties.end()));
+    if (difficulties[i] == 0) {
+      return false;
+    }
+
+    cumulativeDifficulty += difficulties[i];
+    timestamps.push_back(headers[i].timestamp);
+    cumulativeDifficulties.push_back(cumulativeDifficulty);
+    if (timestamps.size() > windowSize) {
+      timestamps.pop_front();
+      cumulativeDifficulties.pop_front();
+    }
+  }
+
+  // Headers are split between tasks, each task uses own cn_context for all its headers
+  size_t taskCount = pool != nullptr && pool->threadCount() != 0 ? pool->threadCount() + 1 : 1;
+  std::vector<crypto::hash> proofsOfWork(headers.size());
+  std::atomic<bool> failed(false);
+  auto checkHeaders = [&](size_t task) {
+    crypto::cn_context context;
+    for (size_t i = task; i < headers.size() && !failed; i += taskCount) {
+      if (inCheckpointZone[i]) {
+        continue;
+      }
+
+      if (!get_block_longhash(context, headers[i], proofsOfWork[i]) ||
+        !m_currency.checkProofOfWork(headers[i], difficulties[i], proofsOfWork[i])) {
+        logger(DEBUGGING) << "Block header " << ids[i] << " has insufficient proof of work";
+        failed = true;
+      }
+    }
+  };
+
+  if (taskCount > 1) {
+    pool->parallelFor(taskCount, checkHeaders);
+  } else {
+    checkHeaders(0);
+  }
 
-bool blockchain_storage::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  auto it = m_transactionMap.find(tx_id);
-  if (it == m_transactionMap.end()) {
-    logger(WARNING, YELLOW) << "warning: get_tx_outputs_gindexs failed to find transaction with id = " << tx_id;
+  if (failed) {
     return false;
   }
 
-  const TransactionEntry& tx = transactionByIndex(it->second);
-  if (!(tx.m_global_output_indexes.size())) { logger(ERROR, BRIGHT_RED) << "internal error: global indexes for transaction " << tx_id << " is empty"; return false; }
-  indexs.resize(tx.m_global_output_indexes.size());
-  for (size_t i = 0; i < tx.m_global_output_indexes.size(); ++i) {
-    indexs[i] = tx.m_global_output_indexes[i];
+  {
+    std::lock_guard<std::mutex> lock(m_preparedProofsOfWorkMutex);
+    if (m_preparedProofsOfWork.size() + headers.size() > PREPARED_PROOFS_OF_WORK_LIMIT) {
+      m_preparedProofsOfWork.clear();
+    }
+
+    for (size_t i = 0; i < headers.size(); ++i) {
+      if (!inCheckpointZone[i]) {
+        std::promise<crypto::hash> proofOfWork;
+        proofOfWork.set_value(proofsOfWork[i]);
+        m_preparedProofsOfWork[ids[i]] = proofOfWork.get_future().share();
+      }
+    }
   }
 
+  checked = true;
+  heavier = cumulativeDifficulty > tailCumulativeDifficulty;
   return true;
 }
 
-bool blockchain_storage::check_tx_inputs(const Transaction& tx, uint64_t& max_used_block_height, crypto::hash& max_used_block_id, BlockInfo* tail) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-
-  if (tail)
-    tail->id = get_tail_id(tail->height);
+bool blockchain_storage::takePreparedProofOfWork(const crypto::hash& blockHash, crypto::hash& proofOfWork) {
+  std::shared_future<crypto::hash> preparedProofOfWork;
+  {
+    std::lock_guard<std::mutex> lock(m_preparedProofsOfWorkMutex);
+    auto it = m_preparedProofsOfWork.find(blockHash);
+    if (it == m_preparedProofsOfWork.end()) {
+      return false;
+    }
 
-  bool res = check_tx_inputs(tx, &max_used_block_height);
-  if (!res) return false;
-  if (!(max_used_block_height < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_blocks.size(); return false; }
-  get_block_hash(m_blocks[max_used_block_height].bl, max_used_block_id);
-  return true;
-}
+    preparedProofOfWork = it->second;
+    m_preparedProofsOfWork.erase(it);
+  }
 
-bool blockchain_storage::have_tx_keyimges_as_spent(const Transaction &tx) {
-  for (const auto& in : tx.vin) {
-    if (in.type() == typeid(TransactionInputToKey)) {
-      if (have_tx_keyimg_as_spent(boost::get<TransactionInputToKey>(in).keyImage)) {
-        return true;
-      }
-    }
+  try {
+    proofOfWork = preparedProofOfWork.get();
+  } catch (std::exception&) {
+    return false;
   }
 
-  return false;
+  return true;
 }
 
-bool blockchain_storage::check_tx_inputs(const Transaction& tx, uint64_t* pmax_used_block_height) {
-  crypto::hash tx_prefix_hash = get_transaction_prefix_hash(tx);
-  return check_tx_inputs(tx, tx_prefix_hash, pmax_used_block_height);
-}
+bool blockchain_storage::checkProofOfWork(const Block& block, const crypto::hash& blockHash, difficulty_type currentDifficulty, crypto::hash& proofOfWork) {
+  if (!m_longHashCache.get(blockHash, proofOfWork)) {
+    if (!takePreparedProofOfWork(blockHash, proofOfWork) && !get_block_longhash(m_cn_context, block, proofOfWork)) {
+      return false;
+    }
 
-bool blockchain_storage::check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height) {
-  size_t inputIndex = 0;
-  if (pmax_used_block_height) {
-    *pmax_used_block_height = 0;
+    m_longHashCache.put(blockHash, proofOfWork);
   }
 
-  crypto::hash transactionHash = get_transaction_hash(tx);
-  for (const auto& txin : tx.vin) {
-    assert(inputIndex < tx.signatures.size());
-    if (txin.type() == typeid(TransactionInputToKey)) {
-      const TransactionInputToKey& in_to_key = boost::get<TransactionInputToKey>(txin);
-      if (!(!in_to_key.keyOffsets.empty())) { logger(ERROR, BRIGHT_RED) << "empty in_to_key.keyOffsets in transaction with id " << get_transaction_hash(tx); return false; }
+  return m_currency.checkProofOfWork(block, currentDifficulty, proofOfWork);
+}
 
-      if (have_tx_keyimg_as_spent(in_to_key.keyImage)) {
-        logger(DEBUGGING) <<
-          "Key image already spent in blockchain: " << Common::podToHex(in_to_key.keyImage);
-        return false;
-      }
+bool blockchain_storage::checkRingSignatures(const std::vector<RingSignatureCheck>& checks) {
+  std::atomic<bool> failed(false);
+  auto checkSignature = [&](size_t i) {
+    if (failed) {
+      return;
+    }
 
-      if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height)) {
-        logger(INFO, BRIGHT_WHITE) <<
-          "Failed to check ring signature for tx " << transactionHash;
-        return false;
-      }
+    const RingSignatureCheck& check = checks[i];
+    std::vector<const crypto::public_key*> outputKeyPointers;
+    outputKeyPointers.reserve(check.outputKeys.size());
+    for (const crypto::public_key& key : check.outputKeys) {
+      outputKeyPointers.push_back(&key);
+    }
 
-      ++inputIndex;
-    } else if (txin.type() == typeid(TransactionInputMultisignature)) {
-      if (!validateInput(::boost::get<TransactionInputMultisignature>(txin), transactionHash, tx_prefix_hash, tx.signatures[inputIndex])) {
-        return false;
-      }
+    if (!crypto::check_ring_signature(check.prefixHash, check.input->keyImage, outputKeyPointers, check.signatures->data())) {
+      failed = true;
+    }
+  };
 
-      ++inputIndex;
-    } else {
-      logger(INFO, BRIGHT_WHITE) <<
-        "Transaction << " << transactionHash << " contains input of unsupported type.";
-      return false;
+  if (checks.size() > 1 && m_verificationPool && m_verificationPool->threadCount() != 0) {
+    m_verificationPool->parallelFor(checks.size(), checkSignature);
+  } else {
+    for (size_t i = 0; i < checks.size(); ++i) {
+      checkSignature(i);
     }
   }
 
-  return true;
+  return !failed;
 }
 
 bool blockchain_storage::is_tx_spendtime_unlocked(uint64_t unlock_time) {
+  return is_tx_spendtime_unlocked(unlock_time, get_current_blockchain_height(), static_cast<uint64_t>(time(NULL)));
+}
+
+bool blockchain_storage::is_tx_spendtime_unlocked(uint64_t unlock_time, uint64_t height, uint64_t current_time) {
   if (unlock_time < m_currency.maxBlockHeight()) {
     //interpret as block index
-    if (get_current_blockchain_height() - 1 + m_currency.lockedTxAllowedDeltaBlocks() >= unlock_time)
+    if (height - 1 + m_currency.lockedTxAllowedDeltaBlocks() >= unlock_time)
       return true;
     else
       return false;
   } else {
     //interpret as time
-    uint64_t current_time = static_cast<uint64_t>(time(NULL));
     if (current_time + m_currency.lockedTxAllowedDeltaSeconds() >= unlock_time)
       return true;
     else
@@ -1431,37 +3029,31 @@ bool blockchain_storage::is_tx_spendtime_unlocked(uint64_t unlock_time) {
   return false;
 }
 
-bool blockchain_storage::check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+bool blockchain_storage::check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height, RingSignatureCheck* deferredCheck) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   struct outputs_visitor {
-    std::vector<const crypto::public_key *>& m_results_collector;
+    std::vector<crypto::public_key>& m_results_collector;
     blockchain_storage& m_bch;
     LoggerRef logger;
-    outputs_visitor(std::vector<const crypto::public_key *>& results_collector, blockchain_storage& bch, ILogger& logger) :m_results_collector(results_collector), m_bch(bch), logger(logger, "outputs_visitor") {
+    outputs_visitor(std::vector<crypto::public_key>& results_collector, blockchain_storage& bch, ILogger& logger) :m_results_collector(results_collector), m_bch(bch), logger(logger, "outputs_visitor") {
     }
 
-    bool handle_output(const Transaction& tx, const TransactionOutput& out) {
+    bool handle_output(uint64_t unlockTime, const crypto::public_key& key) {
       //check tx unlock time
-      if (!m_bch.is_tx_spendtime_unlocked(tx.unlockTime)) {
-        logger(INFO, BRIGHT_WHITE) <<
-          "One of outputs for one of inputs have wrong tx.unlockTime = " << tx.unlockTime;
-        return false;
-      }
-
-      if (out.target.type() != typeid(TransactionOutputToKey)) {
+      if (!m_bch.is_tx_spendtime_unlocked(unlockTime)) {
         logger(INFO, BRIGHT_WHITE) <<
-          "Output have wrong type id, which=" << out.target.which();
+          "One of outputs for one of inputs have wrong tx.unlockTime = " << unlockTime;
         return false;
       }
 
-      m_results_collector.push_back(&boost::get<TransactionOutputToKey>(out.target).key);
+      m_results_collector.push_back(key);
       return true;
     }
   };
 
   //check ring signature
-  std::vector<const crypto::public_key *> output_keys;
+  std::vector<crypto::public_key> output_keys;
   outputs_visitor vi(output_keys, *this, logger.getLogger());
   if (!scan_outputkeys_for_indexes(txin, vi, pmax_related_block_height)) {
     logger(INFO, BRIGHT_WHITE) <<
@@ -1477,11 +3069,20 @@ bool blockchain_storage::check_tx_input(const TransactionInputToKey& txin, const
   }
 
   if (!(sig.size() == output_keys.size())) { logger(ERROR, BRIGHT_RED) << "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size(); return false; }
-  if (m_is_in_checkpoint_zone) {
+  if (deferredCheck) {
+    deferredCheck->input = &txin;
+    deferredCheck->signatures = &sig;
+    deferredCheck->outputKeys = std::move(output_keys);
     return true;
   }
 
-  return crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_keys, sig.data());
+  std::vector<const crypto::public_key*> output_key_pointers;
+  output_key_pointers.reserve(output_keys.size());
+  for (const crypto::public_key& key : output_keys) {
+    output_key_pointers.push_back(&key);
+  }
+
+  return crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_key_pointers, sig.data());
 }
 
 uint64_t blockchain_storage::get_adjusted_time() {
@@ -1499,7 +3100,7 @@ bool blockchain_storage::check_block_timestamp_main(const Block& b) {
   std::vector<uint64_t> timestamps;
   size_t offset = m_blocks.size() <= m_currency.timestampCheckWindow() ? 0 : m_blocks.size() - m_currency.timestampCheckWindow();
   for (; offset != m_blocks.size(); ++offset) {
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
+    timestamps.push_back(getBlockSummary(offset).timestamp);
   }
 
   return check_block_timestamp(std::move(timestamps), b);
@@ -1628,8 +3229,9 @@ bool blockchain_storage::add_new_block(const Block& bl_, block_verification_cont
       //chain switching or wrong block
       bvc.m_added_to_main_chain = false;
       add_result = handle_alternative_block(bl, id, bvc);
+      evictAlternativeBlocks();
     } else {
-      add_result = pushBlock(bl, bvc);
+      add_result = pushBlock(bl, id, bvc);
     }
   }
 
@@ -1640,16 +3242,90 @@ bool blockchain_storage::add_new_block(const Block& bl_, block_verification_cont
   return add_result;
 }
 
-const blockchain_storage::TransactionEntry& blockchain_storage::transactionByIndex(TransactionIndex index) {
-  return m_blocks[index.block].transactions[index.transaction];
+std::shared_ptr<const blockchain_storage::TransactionEntry> blockchain_storage::transactionByIndex(TransactionIndex index) {
+  std::shared_ptr<const BlockEntry> block = m_blocks[index.block];
+  return std::shared_ptr<const TransactionEntry>(block, &block->transactions[index.transaction]);
+}
+
+void blockchain_storage::transactionsByIndexes(const std::vector<TransactionIndex>& indexes, std::vector<Transaction>& transactions) {
+  transactions.resize(indexes.size());
+  // Requests are sorted by position in chain, so blocks are visited in storage order and every block is read once
+  // however ids are spread across history
+  std::vector<size_t> order(indexes.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+
+  std::sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+    return indexes[left].block < indexes[right].block ||
+      (indexes[left].block == indexes[right].block && indexes[left].transaction < indexes[right].transaction);
+  });
+
+  std::vector<size_t> groups;
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (i == 0 || indexes[order[i]].block != indexes[order[i - 1]].block) {
+      groups.push_back(i);
+    }
+  }
+
+  groups.push_back(order.size());
+  // Pool threads only read m_blocks, which is safe while the shared lock is held by the calling thread
+  auto copyGroup = [&](size_t group) {
+    std::shared_ptr<const BlockEntry> block = m_blocks[indexes[order[groups[group]]].block];
+    for (size_t i = groups[group]; i < groups[group + 1]; ++i) {
+      transactions[order[i]] = block->transactions[indexes[order[i]].transaction].tx;
+    }
+  };
+
+  size_t groupCount = groups.size() - 1;
+  if (groupCount > 1 && m_verificationPool && m_verificationPool->threadCount() != 0) {
+    m_verificationPool->parallelFor(groupCount, copyGroup);
+  } else {
+    for (size_t group = 0; group < groupCount; ++group) {
+      copyGroup(group);
+    }
+  }
+}
+
+BlockSummary blockchain_storage::makeBlockSummary(const BlockEntry& block) {
+  BlockSummary summary = {block.bl.timestamp, block.cumulative_difficulty, block.block_cumulative_size, block.already_generated_coins,
+    block.bl.majorVersion, block.bl.minorVersion};
+  return summary;
+}
+
+bool blockchain_storage::getIndexedTransactionHash(const TransactionIndex& index, crypto::hash& transactionHash) {
+  std::shared_ptr<const BlockEntry> storedBlock;
+  const BlockEntry* block;
+  auto unstoredIt = m_unstoredBlocks.find(index.block);
+  if (unstoredIt != m_unstoredBlocks.end()) {
+    block = unstoredIt->second;
+  } else if (index.block < m_blocks.size()) {
+    storedBlock = m_blocks[index.block];
+    block = storedBlock.get();
+  } else {
+    return false;
+  }
+
+  if (index.transaction == 0) {
+    transactionHash = get_transaction_hash(block->bl.minerTx);
+  } else if (index.transaction <= block->bl.txHashes.size()) {
+    transactionHash = block->bl.txHashes[index.transaction - 1];
+  } else {
+    return false;
+  }
+
+  return true;
 }
 
-bool blockchain_storage::pushBlock(const Block& blockData, block_verification_context& bvc) {
+bool blockchain_storage::pushBlock(const Block& blockData, const crypto::hash& blockHash, block_verification_context& bvc) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   auto blockProcessingStart = std::chrono::steady_clock::now();
-
-  crypto::hash blockHash = get_block_hash(blockData);
+  Common::MetricTimer timer(Common::MetricsRegistry::global().histogram("block_verification_duration_microseconds",
+    "Time to verify and add blocks to the main chain"));
+  BlockStages& stages = BlockStages::get();
+  Common::StageTimer stageTimer(stages.pushBlock);
+  Common::StageTimer headerChecksTimer(stages.headerChecks);
 
   if (m_blockIndex.hasBlock(blockHash)) {
     logger(ERROR, BRIGHT_RED) <<
@@ -1682,8 +3358,11 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
     return false;
   }
 
+  headerChecksTimer.stop();
   auto targetTimeStart = std::chrono::steady_clock::now();
+  Common::StageTimer difficultyTimer(stages.difficulty);
   difficulty_type currentDifficulty = get_difficulty_for_next_block();
+  difficultyTimer.stop();
   auto target_calculating_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - targetTimeStart).count();
 
   if (!(currentDifficulty)) { 
@@ -1694,6 +3373,7 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
   
   auto longhashTimeStart = std::chrono::steady_clock::now();
   crypto::hash proof_of_work = null_hash;
+  Common::StageTimer proofOfWorkTimer(stages.proofOfWork);
   if (m_checkpoints.is_in_checkpoint_zone(get_current_blockchain_height())) {
     if (!m_checkpoints.check_block(get_current_blockchain_height(), blockHash)) {
       logger(ERROR, BRIGHT_RED) <<
@@ -1702,7 +3382,7 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
       return false;
     }
   } else {
-    if (!m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work)) {
+    if (!checkProofOfWork(blockData, blockHash, currentDifficulty, proof_of_work)) {
       logger(INFO, BRIGHT_WHITE) <<
         "Block " << blockHash << ", has too weak proof of work: " << proof_of_work << ", expected difficulty: " << currentDifficulty;
       bvc.m_verifivation_failed = true;
@@ -1710,7 +3390,10 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
     }
   }
 
+  proofOfWorkTimer.stop();
   auto longhash_calculating_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - longhashTimeStart).count();
+  // Alternative chain processing resets the flag
+  updateCheckpointZone();
 
   if (!prevalidate_miner_transaction(blockData, m_blocks.size())) {
     logger(INFO, BRIGHT_WHITE) <<
@@ -1723,6 +3406,18 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
 
   BlockEntry block;
   block.bl = blockData;
+  // transactions are indexed before the block is stored, the index resolves their hashes from it meanwhile
+  struct UnstoredBlockGuard {
+    std::map<uint32_t, const BlockEntry*>& blocks;
+    uint32_t height;
+
+    ~UnstoredBlockGuard() {
+      blocks.erase(height);
+    }
+  } unstoredBlockGuard = {m_unstoredBlocks, static_cast<uint32_t>(m_blocks.size())};
+  m_unstoredBlocks[unstoredBlockGuard.height] = &block;
+  // Deferred ring signature checks point into transactions, so they must not be reallocated
+  block.transactions.reserve(blockData.txHashes.size() + 1);
   block.transactions.resize(1);
   block.transactions[0].tx = blockData.minerTx;
   TransactionIndex transactionIndex = {static_cast<uint32_t>(m_blocks.size()), static_cast<uint16_t>(0)};
@@ -1731,11 +3426,15 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
   size_t coinbase_blob_size = get_object_blobsize(blockData.minerTx);
   size_t cumulative_block_size = coinbase_blob_size;
   uint64_t fee_summary = 0;
+  std::vector<RingSignatureCheck> ringSignatureChecks;
+  bool skipRingSignatures = m_is_in_checkpoint_zone;
   for (const crypto::hash& tx_id : blockData.txHashes) {
     block.transactions.resize(block.transactions.size() + 1);
     size_t blob_size = 0;
     uint64_t fee = 0;
-    if (!m_tx_pool.take_tx(tx_id, block.transactions.back().tx, blob_size, fee)) {
+    BlockInfo verifiedAgainst;
+    bool poolVerifiedSignatures = false;
+    if (!m_tx_pool.take_tx(tx_id, block.transactions.back().tx, blob_size, fee, verifiedAgainst, poolVerifiedSignatures)) {
       logger(INFO, BRIGHT_WHITE) <<
         "Block " << blockHash << " has at least one unknown transaction: " << tx_id;
       bvc.m_verifivation_failed = true;
@@ -1745,7 +3444,12 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
       return false;
     }
 
-    if (!check_tx_inputs(block.transactions.back().tx)) {
+    // Pool verified ring signatures against outputs of blocks up to verifiedAgainst, they are the same outputs while
+    // that block is in the chain. Key images and unlock times are still checked, they depend on the new context.
+    bool signaturesVerified = poolVerifiedSignatures && !verifiedAgainst.empty() && verifiedAgainst.height < m_blocks.size() &&
+      m_blockIndex.getBlockId(verifiedAgainst.height) == verifiedAgainst.id;
+    size_t ringSignatureChecksCount = ringSignatureChecks.size();
+    if (!check_tx_inputs(block.transactions.back().tx, NULL, &ringSignatureChecks)) {
       logger(INFO, BRIGHT_WHITE) <<
         "Block " << blockHash << " has at least one transaction with wrong inputs: " << tx_id;
       bvc.m_verifivation_failed = true;
@@ -1760,6 +3464,11 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
       return false;
     }
 
+    if (signaturesVerified) {
+      ringSignatureChecks.erase(ringSignatureChecks.begin() + ringSignatureChecksCount, ringSignatureChecks.end());
+      stages.poolVerifiedTransactions.increment();
+    }
+
     ++transactionIndex.transaction;
     pushTransaction(block, tx_id, transactionIndex);
 
@@ -1767,6 +3476,18 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
     fee_summary += fee;
   }
 
+  // Signatures of all block transactions are verified in one batch. Fast sync trusts blocks below the last checkpoint
+  // and skips them, transactions coming to the pool are always verified.
+  Common::StageTimer ringSignaturesTimer(stages.ringSignatures);
+  if (!skipRingSignatures && !checkRingSignatures(ringSignatureChecks)) {
+    logger(INFO, BRIGHT_WHITE) <<
+      "Block " << blockHash << " has at least one transaction with wrong ring signature";
+    bvc.m_verifivation_failed = true;
+    popTransactions(block, minerTransactionHash);
+    return false;
+  }
+
+  ringSignaturesTimer.stop();
   if (!checkCumulativeBlockSize(blockHash, cumulative_block_size, m_blocks.size())) {
     bvc.m_verifivation_failed = true;
     return false;
@@ -1774,7 +3495,7 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
 
   int64_t emissionChange = 0;
   uint64_t reward = 0;
-  uint64_t already_generated_coins = m_blocks.empty() ? 0 : m_blocks.back().already_generated_coins;
+  uint64_t already_generated_coins = m_blocks.empty() ? 0 : getBlockSummary(m_blocks.size() - 1).generatedCoins;
   if (!validate_miner_transaction(blockData, m_blocks.size(), cumulative_block_size, already_generated_coins, fee_summary, reward, emissionChange)) {
     logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has invalid miner transaction";
     bvc.m_verifivation_failed = true;
@@ -1787,10 +3508,12 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
   block.cumulative_difficulty = currentDifficulty;
   block.already_generated_coins = already_generated_coins + emissionChange;
   if (m_blocks.size() > 0) {
-    block.cumulative_difficulty += m_blocks.back().cumulative_difficulty;
+    block.cumulative_difficulty += m_blocks.back()->cumulative_difficulty;
   }
 
-  pushBlock(block);
+  Common::StageTimer indexUpdateTimer(stages.indexUpdate);
+  pushBlock(block, blockHash, minerTransactionHash);
+  indexUpdateTimer.stop();
 
   auto block_processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - blockProcessingStart).count();
 
@@ -1806,18 +3529,47 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
 
   m_upgradeDetector.blockPushed();
   update_next_comulative_size_limit();
+  updateCheckpointZone();
+  std::vector<crypto::key_image> spentKeyImages;
+  for (const TransactionEntry& transaction : block.transactions) {
+    for (const auto& input : transaction.tx.vin) {
+      if (input.type() == typeid(TransactionInputToKey)) {
+        spentKeyImages.push_back(boost::get<TransactionInputToKey>(input).keyImage);
+      }
+    }
+  }
+
+  m_tx_pool.on_blockchain_inc(m_blocks.size(), blockHash, spentKeyImages);
 
   return true;
 }
 
-bool blockchain_storage::pushBlock(BlockEntry& block) {
-  crypto::hash blockHash = get_block_hash(block.bl);
+void blockchain_storage::updateCheckpointZone() {
+  m_is_in_checkpoint_zone = m_fastSync && m_checkpoints.is_in_checkpoint_zone(m_blocks.size());
+}
+
+bool blockchain_storage::pushBlock(BlockEntry& block, const crypto::hash& blockHash, const crypto::hash& minerTransactionHash) {
+  if (!m_blockUndos.empty() && m_blockUndos.back().height + 1 != m_blocks.size()) {
+    m_blockUndos.clear();
+  }
+
+  m_blockUndos.push_back(makeBlockUndo(block, minerTransactionHash));
+  if (m_blockUndos.size() > BLOCK_UNDO_DEPTH) {
+    m_blockUndos.pop_front();
+  }
 
   m_blocks.push_back(block);
   m_blockIndex.push(blockHash);
+  m_blockHeaders.push(makeBlockSummary(block));
+  m_blockFilters.push_back(buildBlockFilter(block));
 
   assert(m_blockIndex.size() == m_blocks.size());
 
+  // blocks grow over time, the cache keeps to the memory budget
+  if ((m_blocksCacheMemory != 0 || m_blocksCacheMemoryLimit != 0) && m_blocks.size() % BLOCKS_CACHE_RESIZE_INTERVAL == 0) {
+    m_blocks.setPoolSize(getBlocksCachePoolSize());
+  }
+
   return true;
 }
 
@@ -1828,18 +3580,38 @@ void blockchain_storage::popBlock(const crypto::hash& blockHash) {
     return;
   }
 
-  popTransactions(m_blocks.back(), get_transaction_hash(m_blocks.back().bl.minerTx));
+  if (m_blocks.size() <= std::max(m_cacheHeight, m_storingCacheHeight) && m_cacheJournal) {
+    binary_archive<true> archive(m_cacheJournal);
+    if (!do_serialize(archive, const_cast<BlockEntry&>(*m_blocks.back()))) {
+      logger(WARNING, BRIGHT_YELLOW) << "Failed to write blockchain cache journal";
+    }
+
+    m_cacheJournal.flush();
+  }
+
+  std::shared_ptr<const BlockEntry> block = m_blocks.back();
+  if (!m_blockUndos.empty() && m_blockUndos.back().height + 1 == m_blocks.size()) {
+    popTransactions(*block, m_blockUndos.back());
+    m_blockUndos.pop_back();
+  } else {
+    m_blockUndos.clear();
+    popTransactions(*block, get_transaction_hash(block->bl.minerTx));
+  }
+
   m_blocks.pop_back();
   m_blockIndex.pop();
+  m_blockHeaders.pop();
+  m_blockFilters.pop_back();
 
   assert(m_blockIndex.size() == m_blocks.size());
 
   m_upgradeDetector.blockPopped();
+  updateCheckpointZone();
+  m_tx_pool.on_blockchain_dec(m_blocks.size(), get_tail_id());
 }
 
 bool blockchain_storage::pushTransaction(BlockEntry& block, const crypto::hash& transactionHash, TransactionIndex transactionIndex) {
-  auto result = m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
-  if (!result.second) {
+  if (!m_transactionMap->insert(transactionHash, transactionIndex)) {
     logger(ERROR, BRIGHT_RED) <<
       "Duplicate transaction was pushed to blockchain.";
     return false;
@@ -1850,7 +3622,7 @@ bool blockchain_storage::pushTransaction(BlockEntry& block, const crypto::hash&
   if (!checkMultisignatureInputsDiff(transaction.tx)) {
     logger(ERROR, BRIGHT_RED) <<
       "Double spending transaction was pushed to blockchain.";
-    m_transactionMap.erase(transactionHash);
+    m_transactionMap->erase(transactionHash);
     return false;
   }
 
@@ -1864,17 +3636,18 @@ bool blockchain_storage::pushTransaction(BlockEntry& block, const crypto::hash&
           m_spent_keys.erase(::boost::get<TransactionInputToKey>(transaction.tx.vin[i - 1 - j]).keyImage);
         }
 
-        m_transactionMap.erase(transactionHash);
+        m_transactionMap->erase(transactionHash);
         return false;
       }
+
+      addSpentKeyToFilter(*result.first);
     }
   }
 
   for (const auto& inv : transaction.tx.vin) {
     if (inv.type() == typeid(TransactionInputMultisignature)) {
       const TransactionInputMultisignature& in = ::boost::get<TransactionInputMultisignature>(inv);
-      auto& amountOutputs = m_multisignatureOutputs[in.amount];
-      amountOutputs[in.outputIndex].isUsed = true;
+      m_multisignatureOutputs[in.amount].setUsed(in.outputIndex, true);
     }
   }
 
@@ -1883,23 +3656,72 @@ bool blockchain_storage::pushTransaction(BlockEntry& block, const crypto::hash&
     if (transaction.tx.vout[output].target.type() == typeid(TransactionOutputToKey)) {
       auto& amountOutputs = m_outputs[transaction.tx.vout[output].amount];
       transaction.m_global_output_indexes[output] = static_cast<uint32_t>(amountOutputs.size());
-      amountOutputs.push_back(std::make_pair<>(transactionIndex, output));
+      amountOutputs.push_back(transactionIndex, output, ::boost::get<TransactionOutputToKey>(transaction.tx.vout[output].target).key, transaction.tx.unlockTime);
     } else if (transaction.tx.vout[output].target.type() == typeid(TransactionOutputMultisignature)) {
       auto& amountOutputs = m_multisignatureOutputs[transaction.tx.vout[output].amount];
       transaction.m_global_output_indexes[output] = static_cast<uint32_t>(amountOutputs.size());
-      MultisignatureOutputUsage outputUsage = {transactionIndex, output, false};
-      amountOutputs.push_back(outputUsage);
+      amountOutputs.push_back(transactionIndex, output);
     }
   }
 
+  if (m_explorerIndexes) {
+    addToExplorerIndexes(transaction.tx, transactionIndex);
+  }
+
   return true;
 }
 
+blockchain_storage::TransactionUndo blockchain_storage::makeTransactionUndo(const Transaction& transaction, const crypto::hash& transactionHash) {
+  TransactionUndo undo;
+  undo.hash = transactionHash;
+  for (const auto& input : transaction.vin) {
+    if (input.type() == typeid(TransactionInputToKey)) {
+      undo.keyImages.push_back(::boost::get<TransactionInputToKey>(input).keyImage);
+    } else if (input.type() == typeid(TransactionInputMultisignature)) {
+      const TransactionInputMultisignature& in = ::boost::get<TransactionInputMultisignature>(input);
+      undo.multisignatureInputs.push_back(std::make_pair(in.amount, in.outputIndex));
+    }
+  }
+
+  for (uint16_t output = 0; output < transaction.vout.size(); ++output) {
+    const TransactionOutputTarget& target = transaction.vout[output].target;
+    if (target.type() == typeid(TransactionOutputToKey) || target.type() == typeid(TransactionOutputMultisignature)) {
+      TransactionUndo::Output outputUndo = {transaction.vout[output].amount, output, target.type() == typeid(TransactionOutputMultisignature)};
+      undo.outputs.push_back(outputUndo);
+    }
+  }
+
+  return undo;
+}
+
+blockchain_storage::BlockUndo blockchain_storage::makeBlockUndo(const BlockEntry& block, const crypto::hash& minerTransactionHash) {
+  BlockUndo undo;
+  undo.height = block.height;
+  undo.transactions.reserve(block.transactions.size());
+  for (size_t i = 0; i < block.transactions.size(); ++i) {
+    undo.transactions.push_back(makeTransactionUndo(block.transactions[i].tx, i == 0 ? minerTransactionHash : block.bl.txHashes[i - 1]));
+  }
+
+  return undo;
+}
+
 void blockchain_storage::popTransaction(const Transaction& transaction, const crypto::hash& transactionHash) {
-  TransactionIndex transactionIndex = m_transactionMap.at(transactionHash);
-  for (size_t outputIndex = 0; outputIndex < transaction.vout.size(); ++outputIndex) {
-    const TransactionOutput& output = transaction.vout[transaction.vout.size() - 1 - outputIndex];
-    if (output.target.type() == typeid(TransactionOutputToKey)) {
+  popTransaction(makeTransactionUndo(transaction, transactionHash), transaction);
+}
+
+void blockchain_storage::popTransaction(const TransactionUndo& undo, const Transaction& transaction) {
+  TransactionIndex transactionIndex;
+  if (!m_transactionMap->find(undo.hash, transactionIndex)) {
+    throw std::out_of_range("blockchain_storage::popTransaction");
+  }
+
+  if (m_explorerIndexes) {
+    removeFromExplorerIndexes(transaction, transactionIndex);
+  }
+
+  for (auto outputIt = undo.outputs.rbegin(); outputIt != undo.outputs.rend(); ++outputIt) {
+    const TransactionUndo::Output& output = *outputIt;
+    if (!output.multisignature) {
       auto amountOutputs = m_outputs.find(output.amount);
       if (amountOutputs == m_outputs.end()) {
         logger(ERROR, BRIGHT_RED) <<
@@ -1913,13 +3735,13 @@ void blockchain_storage::popTransaction(const Transaction& transaction, const cr
         continue;
       }
 
-      if (amountOutputs->second.back().first.block != transactionIndex.block || amountOutputs->second.back().first.transaction != transactionIndex.transaction) {
+      if (amountOutputs->second.references.back().first.block != transactionIndex.block || amountOutputs->second.references.back().first.transaction != transactionIndex.transaction) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - invalid transaction index.";
         continue;
       }
 
-      if (amountOutputs->second.back().second != transaction.vout.size() - 1 - outputIndex) {
+      if (amountOutputs->second.references.back().second != output.index) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - invalid output index.";
         continue;
@@ -1929,7 +3751,7 @@ void blockchain_storage::popTransaction(const Transaction& transaction, const cr
       if (amountOutputs->second.empty()) {
         m_outputs.erase(amountOutputs);
       }
-    } else if (output.target.type() == typeid(TransactionOutputMultisignature)) {
+    } else {
       auto amountOutputs = m_multisignatureOutputs.find(output.amount);
       if (amountOutputs == m_multisignatureOutputs.end()) {
         logger(ERROR, BRIGHT_RED) <<
@@ -1943,19 +3765,21 @@ void blockchain_storage::popTransaction(const Transaction& transaction, const cr
         continue;
       }
 
-      if (amountOutputs->second.back().isUsed) {
+      size_t lastOutput = amountOutputs->second.size() - 1;
+      if (amountOutputs->second.isUsed(lastOutput)) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - attempting to remove used output.";
         continue;
       }
 
-      if (amountOutputs->second.back().transactionIndex.block != transactionIndex.block || amountOutputs->second.back().transactionIndex.transaction != transactionIndex.transaction) {
+      const TransactionIndex& outputTransactionIndex = amountOutputs->second.references[lastOutput].first;
+      if (outputTransactionIndex.block != transactionIndex.block || outputTransactionIndex.transaction != transactionIndex.transaction) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - invalid transaction index.";
         continue;
       }
 
-      if (amountOutputs->second.back().outputIndex != transaction.vout.size() - 1 - outputIndex) {
+      if (amountOutputs->second.references[lastOutput].second != output.index) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - invalid output index.";
         continue;
@@ -1968,43 +3792,161 @@ void blockchain_storage::popTransaction(const Transaction& transaction, const cr
     }
   }
 
-  for (auto& input : transaction.vin) {
-    if (input.type() == typeid(TransactionInputToKey)) {
-      size_t count = m_spent_keys.erase(::boost::get<TransactionInputToKey>(input).keyImage);
-      if (count != 1) {
-        logger(ERROR, BRIGHT_RED) <<
-          "Blockchain consistency broken - cannot find spent key.";
-      }
-    } else if (input.type() == typeid(TransactionInputMultisignature)) {
-      const TransactionInputMultisignature& in = ::boost::get<TransactionInputMultisignature>(input);
-      auto& amountOutputs = m_multisignatureOutputs[in.amount];
-      if (!amountOutputs[in.outputIndex].isUsed) {
-        logger(ERROR, BRIGHT_RED) <<
-          "Blockchain consistency broken - multisignature output not marked as used.";
-      }
+  for (const crypto::key_image& keyImage : undo.keyImages) {
+    size_t count = m_spent_keys.erase(keyImage);
+    if (count != 1) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - cannot find spent key.";
+    }
+  }
+
+  for (const auto& input : undo.multisignatureInputs) {
+    auto amountOutputs = m_multisignatureOutputs.find(input.first);
+    if (amountOutputs == m_multisignatureOutputs.end() || input.second >= amountOutputs->second.size()) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - cannot find spent multisignature output.";
+      continue;
+    }
 
-      amountOutputs[in.outputIndex].isUsed = false;
+    if (!amountOutputs->second.isUsed(input.second)) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - multisignature output not marked as used.";
     }
+
+    amountOutputs->second.setUsed(input.second, false);
   }
 
-  size_t count = m_transactionMap.erase(transactionHash);
-  if (count != 1) {
+  if (!m_transactionMap->erase(undo.hash)) {
     logger(ERROR, BRIGHT_RED) <<
       "Blockchain consistency broken - cannot find transaction by hash.";
   }
 }
 
 void blockchain_storage::popTransactions(const BlockEntry& block, const crypto::hash& minerTransactionHash) {
-  for (size_t i = 0; i < block.transactions.size() - 1; ++i) {
-    popTransaction(block.transactions[block.transactions.size() - 1 - i].tx, block.bl.txHashes[block.transactions.size() - 2 - i]);
+  popTransactions(block, makeBlockUndo(block, minerTransactionHash));
+}
+
+void blockchain_storage::popTransactions(const BlockEntry& block, const BlockUndo& undo) {
+  for (size_t i = 0; i < undo.transactions.size() - 1; ++i) {
+    popTransaction(undo.transactions[undo.transactions.size() - 1 - i], block.transactions[undo.transactions.size() - 1 - i].tx);
     tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
-    if (!m_tx_pool.add_tx(block.transactions[block.transactions.size() - 1 - i].tx, tvc, true)) {
+    if (!m_tx_pool.add_tx(block.transactions[undo.transactions.size() - 1 - i].tx, tvc, true)) {
       logger(ERROR, BRIGHT_RED) <<
         "Cannot move transaction from blockchain to transaction pool.";
     }
   }
 
-  popTransaction(block.bl.minerTx, minerTransactionHash);
+  popTransaction(undo.transactions[0], block.transactions[0].tx);
+}
+
+void blockchain_storage::addToExplorerIndexes(const Transaction& transaction, TransactionIndex transactionIndex) {
+  for (const auto& input : transaction.vin) {
+    if (input.type() == typeid(TransactionInputToKey)) {
+      m_explorerIndexes->keyImages[::boost::get<TransactionInputToKey>(input).keyImage] = transactionIndex;
+    }
+  }
+
+  for (uint16_t output = 0; output < transaction.vout.size(); ++output) {
+    if (transaction.vout[output].target.type() == typeid(TransactionOutputToKey)) {
+      const crypto::public_key& key = ::boost::get<TransactionOutputToKey>(transaction.vout[output].target).key;
+      m_explorerIndexes->outputKeys.insert(std::make_pair(key, std::make_pair(transactionIndex, output)));
+    }
+  }
+
+  crypto::hash paymentId;
+  if (getPaymentIdFromTxExtra(transaction.extra, paymentId)) {
+    m_explorerIndexes->paymentIds[paymentId].push_back(transactionIndex);
+  }
+}
+
+void blockchain_storage::removeFromExplorerIndexes(const Transaction& transaction, TransactionIndex transactionIndex) {
+  auto isTransaction = [&transactionIndex](const TransactionIndex& index) {
+    return index.block == transactionIndex.block && index.transaction == transactionIndex.transaction;
+  };
+
+  for (const auto& input : transaction.vin) {
+    if (input.type() == typeid(TransactionInputToKey)) {
+      m_explorerIndexes->keyImages.erase(::boost::get<TransactionInputToKey>(input).keyImage);
+    }
+  }
+
+  for (const auto& output : transaction.vout) {
+    if (output.target.type() == typeid(TransactionOutputToKey)) {
+      auto it = m_explorerIndexes->outputKeys.find(::boost::get<TransactionOutputToKey>(output.target).key);
+      if (it != m_explorerIndexes->outputKeys.end() && isTransaction(it->second.first)) {
+        m_explorerIndexes->outputKeys.erase(it);
+      }
+    }
+  }
+
+  crypto::hash paymentId;
+  if (getPaymentIdFromTxExtra(transaction.extra, paymentId)) {
+    auto it = m_explorerIndexes->paymentIds.find(paymentId);
+    if (it == m_explorerIndexes->paymentIds.end() || !isTransaction(it->second.back())) {
+      logger(ERROR, BRIGHT_RED) <<
+        "Blockchain consistency broken - cannot find transaction by payment id.";
+      return;
+    }
+
+    it->second.pop_back();
+    if (it->second.empty()) {
+      m_explorerIndexes->paymentIds.erase(it);
+    }
+  }
+}
+
+bool blockchain_storage::makeExplorerTransaction(TransactionIndex transactionIndex, ExplorerTransaction& transaction) {
+  transaction.height = transactionIndex.block;
+  transaction.outputIndex = 0;
+  return getIndexedTransactionHash(transactionIndex, transaction.hash);
+}
+
+bool blockchain_storage::getTransactionByKeyImage(const crypto::key_image& keyImage, ExplorerTransaction& transaction) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (!m_explorerIndexes) {
+    return false;
+  }
+
+  auto it = m_explorerIndexes->keyImages.find(keyImage);
+  return it != m_explorerIndexes->keyImages.end() && makeExplorerTransaction(it->second, transaction);
+}
+
+bool blockchain_storage::getTransactionByOutputKey(const crypto::public_key& key, ExplorerTransaction& transaction) {
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (!m_explorerIndexes) {
+    return false;
+  }
+
+  auto it = m_explorerIndexes->outputKeys.find(key);
+  if (it == m_explorerIndexes->outputKeys.end() || !makeExplorerTransaction(it->second.first, transaction)) {
+    return false;
+  }
+
+  transaction.outputIndex = it->second.second;
+  return true;
+}
+
+bool blockchain_storage::getTransactionsByPaymentId(const crypto::hash& paymentId, std::vector<ExplorerTransaction>& transactions) {
+  transactions.clear();
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (!m_explorerIndexes) {
+    return false;
+  }
+
+  auto it = m_explorerIndexes->paymentIds.find(paymentId);
+  if (it == m_explorerIndexes->paymentIds.end()) {
+    return false;
+  }
+
+  transactions.resize(it->second.size());
+  for (size_t i = 0; i < it->second.size(); ++i) {
+    if (!makeExplorerTransaction(it->second[i], transactions[i])) {
+      transactions.clear();
+      return false;
+    }
+  }
+
+  return true;
 }
 
 bool blockchain_storage::validateInput(const TransactionInputMultisignature& input, const crypto::hash& transactionHash, const crypto::hash& transactionPrefixHash, const std::vector<crypto::signature>& transactionSignatures) {
@@ -2022,23 +3964,24 @@ bool blockchain_storage::validateInput(const TransactionInputMultisignature& inp
     return false;
   }
 
-  const MultisignatureOutputUsage& outputIndex = amountOutputs->second[input.outputIndex];
-  if (outputIndex.isUsed) {
+  const std::pair<TransactionIndex, uint16_t>& outputReference = amountOutputs->second.references[input.outputIndex];
+  if (amountOutputs->second.isUsed(input.outputIndex)) {
     logger(DEBUGGING) <<
       "Transaction << " << transactionHash << " contains double spending multisignature input.";
     return false;
   }
 
-  const Transaction& outputTransaction = m_blocks[outputIndex.transactionIndex.block].transactions[outputIndex.transactionIndex.transaction].tx;
+  std::shared_ptr<const TransactionEntry> outputTransactionEntry = transactionByIndex(outputReference.first);
+  const Transaction& outputTransaction = outputTransactionEntry->tx;
   if (!is_tx_spendtime_unlocked(outputTransaction.unlockTime)) {
     logger(DEBUGGING) <<
       "Transaction << " << transactionHash << " contains multisignature input which points to a locked transaction.";
     return false;
   }
 
-  assert(outputTransaction.vout[outputIndex.outputIndex].amount == input.amount);
-  assert(outputTransaction.vout[outputIndex.outputIndex].target.type() == typeid(TransactionOutputMultisignature));
-  const TransactionOutputMultisignature& output = ::boost::get<TransactionOutputMultisignature>(outputTransaction.vout[outputIndex.outputIndex].target);
+  assert(outputTransaction.vout[outputReference.second].amount == input.amount);
+  assert(outputTransaction.vout[outputReference.second].target.type() == typeid(TransactionOutputMultisignature));
+  const TransactionOutputMultisignature& output = ::boost::get<TransactionOutputMultisignature>(outputTransaction.vout[outputReference.second].target);
   if (input.signatures != output.requiredSignatures) {
     logger(DEBUGGING) <<
       "Transaction << " << transactionHash << " contains multisignature input with invalid signature count.";
@@ -2065,25 +4008,23 @@ bool blockchain_storage::validateInput(const TransactionInputMultisignature& inp
 }
 
 bool blockchain_storage::getLowerBound(uint64_t timestamp, uint64_t startOffset, uint64_t& height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   if (startOffset >= m_blocks.size()) {
     return false;
   }
 
-  auto bound = std::lower_bound(m_blocks.begin() + startOffset, m_blocks.end(), timestamp - m_currency.blockFutureTimeLimit(),
-    [](const BlockEntry& b, uint64_t timestamp) { return b.bl.timestamp < timestamp; });
-
-  if (bound == m_blocks.end()) {
+  uint64_t bound = m_blockHeaders.lowerBoundTimestamp(startOffset, timestamp - m_currency.blockFutureTimeLimit());
+  if (bound == m_blockHeaders.size()) {
     return false;
   }
 
-  height = std::distance(m_blocks.begin(), bound);
+  height = bound;
   return true;
 }
 
 bool blockchain_storage::getBlockIds(uint64_t startHeight, size_t maxCount, std::list<crypto::hash>& items) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_blockIndex.getBlockIds(startHeight, maxCount, items);
 }
 
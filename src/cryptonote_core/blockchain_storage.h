@@ -17,18 +17,34 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "google/sparse_hash_set"
 #include "google/sparse_hash_map"
 
 #include "Common/ObserverManager.h"
+#include "Common/RecursiveSharedMutex.h"
+#include "Common/ThreadPool.h"
 #include "Common/util.h"
 #include "cryptonote_core/BlockIndex.h"
+#include "cryptonote_core/BlockchainSnapshot.h"
+#include "cryptonote_core/BlockHeaderColumns.h"
+#include "cryptonote_core/BlockchainIndexStore.h"
 #include "cryptonote_core/checkpoints.h"
 #include "cryptonote_core/Currency.h"
 #include "cryptonote_core/IBlockchainStorageObserver.h"
 #include "cryptonote_core/ITransactionValidator.h"
+#include "cryptonote_core/BlockFilter.h"
+#include "cryptonote_core/KeyImagesFilter.h"
+#include "cryptonote_core/LongHashCache.h"
+#include "cryptonote_core/PrefixIndexStore.h"
 #include "cryptonote_core/SwappedVector.h"
 #include "cryptonote_core/UpgradeDetector.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
@@ -40,12 +56,14 @@
 #undef ERROR
 
 namespace CryptoNote {
+  struct block_complete_entry;
   struct NOTIFY_RESPONSE_CHAIN_ENTRY_request;
   struct NOTIFY_REQUEST_GET_OBJECTS_request;
   struct NOTIFY_RESPONSE_GET_OBJECTS_request;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount;
+  struct block_short_header;
 
   using CryptoNote::BlockInfo;
   class blockchain_storage : public CryptoNote::ITransactionValidator {
@@ -63,11 +81,56 @@ namespace CryptoNote {
     bool init() { return init(tools::get_default_data_dir(), true); }
     bool init(const std::string& config_folder, bool load_existing);
     bool deinit();
+    // Starts writing cache snapshot on own thread if the stored one is far enough behind and no snapshot is being
+    // written. Snapshot is taken under shared lock, blocks are pushed again while it is written to disk.
+    void storeCacheInBackground();
 
     bool getLowerBound(uint64_t timestamp, uint64_t startOffset, uint64_t& height);
     bool getBlockIds(uint64_t startHeight, size_t maxCount, std::list<crypto::hash>& items);
 
     void set_checkpoints(checkpoints&& chk_pts) { m_checkpoints = chk_pts; }
+    void set_blocks_file_mapping(bool enabled) { m_mapBlocksFile = enabled; }
+    void set_blocks_file_compression(bool enabled) { m_compressBlocksFile = enabled; }
+    // Transaction index is kept in a memory-mapped scratch file instead of process heap, applied on init
+    void set_disk_indexes(bool enabled) { m_diskIndexes = enabled; }
+    // Key image, output key and payment id indexes for explorers, applied on init. When they are off nothing is kept
+    // or stored for them.
+    void set_explorer_indexes(bool enabled) { m_explorerIndexesEnabled = enabled; }
+    bool has_explorer_indexes() const { return m_explorerIndexes != nullptr; }
+    // Empty data directory is filled from the snapshot bundle in this folder on init. Files are checked against the
+    // bundle manifest and blocks against checkpoints, indexes are taken from the bundle without rebuilding.
+    void set_snapshot_folder(const std::string& folder) { m_snapshotFolder = folder; }
+    // Opens blocks of a node running on the same data directory read-only, applied on init. Nothing is written to the
+    // directory, indexes are built from the blocks of the writing node without validation and follow them on
+    // refreshReplica.
+    void set_replica(bool enabled) { m_replica = enabled; }
+    bool is_replica() const { return m_replica; }
+    // Picks up blocks the writing node pushed or popped since the last call, observers are notified if the main chain
+    // changed. Returns false if its files couldn't be read consistently, the next call catches up.
+    bool refreshReplica();
+    // Writes snapshot bundle of the current chain to folder. Blocks are not pushed while it is written.
+    bool storeSnapshot(const std::string& folder);
+    // Blocks cache keeps cacheSize blocks, or as many as fit in memoryBudget bytes if it isn't 0. Takes effect right
+    // away if the blockchain is loaded, shrinking the cache evicts blocks its policy values least.
+    bool set_blocks_cache_size(size_t cacheSize, uint64_t memoryBudget = 0);
+    void set_blocks_cache_policy(SwappedCachePolicy policy);
+    SwappedVectorCacheStatistics get_blocks_cache_statistics();
+    // Limit given by the memory budget on top of the configured size, 0 means none
+    void set_blocks_cache_memory_limit(uint64_t limit);
+    // Estimate of memory taken by cached blocks
+    uint64_t get_blocks_cache_memory_usage();
+    void set_verification_threads(size_t count) { m_verificationThreads = count; }
+    // Blocks below the last checkpoint are committed to by its hash, in fast sync mode their ring signatures are not checked
+    // Can be changed while blocks are added, bulk import turns it on for its duration
+    void set_fast_sync(bool enabled);
+    bool is_fast_sync();
+    // Starts computing proof of work of blocks expected to be pushed soon, pushBlock picks up the results
+    void prepareBlocks(const std::vector<Block>& blocks);
+    // Checks blocks without transactions continuing the main chain and each other: checkpoints, and proofs of work
+    // against difficulties computed from the headers themselves. Proofs of work are computed in parallel and kept for
+    // pushBlock. checked is false if the first header doesn't continue the main chain, heavier is true if the last
+    // header has greater cumulative difficulty than the main chain tail. Returns false if a header is invalid.
+    bool checkBlockHeaders(const std::vector<Block>& headers, bool& checked, bool& heavier);
     bool get_blocks(uint64_t start_offset, size_t count, std::list<Block>& blocks, std::list<Transaction>& txs);
     bool get_blocks(uint64_t start_offset, size_t count, std::list<Block>& blocks);
     bool get_alternative_blocks(std::list<Block>& blocks);
@@ -95,6 +158,12 @@ namespace CryptoNote {
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset); // !!!!
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY_request& resp);
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<Block, std::list<Transaction>>>& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+    // Same, but blocks and their transactions are returned serialized. Blocks are loaded and serialized on verification threads.
+    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<block_complete_entry>& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+    // Same, but only ids of the blocks are returned, they can be loaded by get_serialized_blocks later
+    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::vector<crypto::hash>& block_ids, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+    // Serialized main chain blocks with their transactions, returns false if any of them isn't in the main chain anymore
+    bool get_serialized_blocks(const std::vector<crypto::hash>& block_ids, std::list<block_complete_entry>& blocks);
     bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp);
     bool get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response& res);
     bool get_backward_blocks_sizes(size_t from_height, std::vector<size_t>& sz, size_t count);
@@ -103,12 +172,19 @@ namespace CryptoNote {
     uint64_t get_current_comulative_blocksize_limit();
     bool is_storing_blockchain(){return m_is_blockchain_storing;}
     uint64_t block_difficulty(size_t i);
+    // Headers of main chain blocks from start_height, all of them are read under one lock. Returns false if start_height is above the top.
+    bool get_block_short_headers(uint64_t start_height, size_t max_count, std::list<block_short_header>& headers);
+    // BlockFilter of key images spent in each of at most max_count blocks from start_height
+    bool get_block_filters(uint64_t start_height, size_t max_count, std::list<std::string>& filters);
     bool getPoolSymmetricDifference(const std::vector<crypto::hash>& known_pool_tx_ids, const crypto::hash& known_block_id, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids);
+    // Same, but the pool is known by version returned before. Returns false if known_block_id isn't the tail, sets
+    // isVersionActual to false if changes since known_version are not kept anymore.
+    bool getPoolChanges(uint64_t known_version, const crypto::hash& known_block_id, bool& isVersionActual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version);
 
 
     template<class t_ids_container, class t_blocks_container, class t_missed_container>
     bool get_blocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs) {
-      std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+      Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
       for (const auto& bl_id : block_ids) {
         uint64_t height = 0;
@@ -117,7 +193,7 @@ namespace CryptoNote {
         } else {
           if (!(height < m_blocks.size())) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: bl_id=" << Common::podToHex(bl_id)
             << " have index record with offset=" << height << ", bigger then m_blocks.size()=" << m_blocks.size(); return false; }
-            blocks.push_back(m_blocks[height].bl);
+            blocks.push_back(m_blocks[height]->bl);
         }
       }
 
@@ -126,17 +202,22 @@ namespace CryptoNote {
 
     template<class t_ids_container, class t_tx_container, class t_missed_container>
     void get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool checkTxPool = false) {
-      std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+      Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
+      std::vector<TransactionIndex> indexes;
       for (const auto& tx_id : txs_ids) {
-        auto it = m_transactionMap.find(tx_id);
-        if (it == m_transactionMap.end()) {
+        TransactionIndex index;
+        if (!m_transactionMap->find(tx_id, index)) {
           missed_txs.push_back(tx_id);
         } else {
-          txs.push_back(transactionByIndex(it->second).tx);
+          indexes.push_back(index);
         }
       }
 
+      std::vector<Transaction> transactions;
+      transactionsByIndexes(indexes, transactions);
+      std::move(transactions.begin(), transactions.end(), std::back_inserter(txs));
+
       if (checkTxPool) {
         auto poolTxIds = std::move(missed_txs);
         missed_txs.clear();
@@ -144,6 +225,47 @@ namespace CryptoNote {
       }
     }
 
+    struct BlockExportRow {
+      uint32_t height;
+      crypto::hash id;
+      uint64_t timestamp;
+      difficulty_type difficulty;
+      difficulty_type cumulativeDifficulty;
+      uint64_t cumulativeSize;
+      uint64_t generatedCoins;
+      uint32_t nonce;
+      uint8_t majorVersion;
+      uint32_t transactionCount;
+    };
+
+    struct OutputExportRow {
+      uint64_t amount;
+      uint32_t globalIndex;
+      crypto::hash transactionHash;
+      uint16_t outputIndex;
+      crypto::public_key key;
+      uint64_t unlockTime;
+    };
+
+    // Exports read the chain in chunks, each taken under the lock on its own, so long dumps do not hold the chain.
+    // Chunks read after a reorganization follow the new chain.
+    bool getBlockExportRows(uint64_t startHeight, size_t maxCount, std::vector<BlockExportRow>& rows);
+    std::vector<uint64_t> getKeyOutputAmounts();
+    bool getKeyOutputExportRows(uint64_t amount, uint32_t startIndex, size_t maxCount, std::vector<OutputExportRow>& rows);
+
+    struct ExplorerTransaction {
+      crypto::hash hash;
+      uint32_t height;
+      // output having the key, set by lookup by output key only
+      uint16_t outputIndex;
+    };
+
+    // Main chain lookups by explorer indexes, they return false if nothing is found or the indexes are off
+    bool getTransactionByKeyImage(const crypto::key_image& keyImage, ExplorerTransaction& transaction);
+    bool getTransactionByOutputKey(const crypto::public_key& key, ExplorerTransaction& transaction);
+    // Transactions in chain order
+    bool getTransactionsByPaymentId(const crypto::hash& paymentId, std::vector<ExplorerTransaction>& transactions);
+
     //debug functions
     void print_blockchain(uint64_t start_index, uint64_t end_index);
     void print_blockchain_index();
@@ -186,66 +308,235 @@ namespace CryptoNote {
       uint32_t block;
       uint16_t transaction;
 
-      template<class Archive> void serialize(Archive& archive, unsigned int version);
+      void serialize(ISerializer& s, const std::string& name);
     };
 
-    struct MultisignatureOutputUsage {
-      TransactionIndex transactionIndex;
-      uint16_t outputIndex;
-      bool isUsed;
+    // What pushing a transaction added to indexes, popping it takes these back without walking the transaction
+    struct TransactionUndo {
+      struct Output {
+        uint64_t amount;
+        uint16_t index;
+        bool multisignature;
+      };
+
+      crypto::hash hash;
+      std::vector<crypto::key_image> keyImages;
+      // amount and output index of spent multisignature outputs
+      std::vector<std::pair<uint64_t, uint64_t>> multisignatureInputs;
+      std::vector<Output> outputs;
+    };
 
-      template<class Archive> void serialize(Archive& archive, unsigned int version);
+    struct BlockUndo {
+      uint32_t height;
+      // miner transaction first
+      std::vector<TransactionUndo> transactions;
+    };
+
+    struct ExplorerIndexes {
+      std::unordered_map<crypto::key_image, TransactionIndex> keyImages;
+      // first transaction creating the key, a repeated key does not replace it
+      std::unordered_map<crypto::public_key, std::pair<TransactionIndex, uint16_t>> outputKeys;
+      // transactions in chain order, so a popped one is the last of its payment id
+      std::unordered_map<crypto::hash, std::vector<TransactionIndex>> paymentIds;
     };
 
     typedef google::sparse_hash_set<crypto::key_image> key_images_container;
     typedef std::unordered_map<crypto::hash, BlockEntry> blocks_ext_by_hash;
-    typedef google::sparse_hash_map<uint64_t, std::vector<std::pair<TransactionIndex, uint16_t>>> outputs_container; //crypto::hash - tx hash, size_t - index of out in transaction
-    typedef std::map<uint64_t, std::vector<MultisignatureOutputUsage>> MultisignatureOutputsContainer;
+    // Key outputs of one amount in global index order, kept column by column. Output keys and unlock times are stored
+    // next to transaction references, so ring members and random outputs are resolved without loading transactions.
+    struct KeyOutputs {
+      std::vector<std::pair<TransactionIndex, uint16_t>> references;
+      std::vector<crypto::public_key> keys;
+      std::vector<uint64_t> unlockTimes;
+
+      size_t size() const {
+        return references.size();
+      }
+
+      bool empty() const {
+        return references.empty();
+      }
+
+      uint32_t height(size_t index) const {
+        return references[index].first.block;
+      }
+
+      // number of outputs from blocks up to the given height, outputs are ordered by height
+      size_t countUpToHeight(uint32_t maxHeight) const {
+        return std::upper_bound(references.begin(), references.end(), maxHeight,
+          [](uint32_t height, const std::pair<TransactionIndex, uint16_t>& reference) { return height < reference.first.block; }) -
+          references.begin();
+      }
+
+      void push_back(const TransactionIndex& transactionIndex, uint16_t outputIndex, const crypto::public_key& key, uint64_t unlockTime) {
+        references.emplace_back(transactionIndex, outputIndex);
+        keys.push_back(key);
+        unlockTimes.push_back(unlockTime);
+      }
+
+      void pop_back() {
+        references.pop_back();
+        keys.pop_back();
+        unlockTimes.pop_back();
+      }
+    };
+
+    // Multisignature outputs of one amount in global index order, laid out like KeyOutputs. Spent flags are packed
+    // 64 to a word.
+    struct MultisignatureOutputs {
+      std::vector<std::pair<TransactionIndex, uint16_t>> references;
+      std::vector<uint64_t> usedBits;
+
+      size_t size() const {
+        return references.size();
+      }
+
+      bool empty() const {
+        return references.empty();
+      }
+
+      bool isUsed(size_t index) const {
+        return (usedBits[index / 64] >> (index % 64) & 1) != 0;
+      }
+
+      void setUsed(size_t index, bool used) {
+        if (used) {
+          usedBits[index / 64] |= UINT64_C(1) << (index % 64);
+        } else {
+          usedBits[index / 64] &= ~(UINT64_C(1) << (index % 64));
+        }
+      }
+
+      void push_back(const TransactionIndex& transactionIndex, uint16_t outputIndex) {
+        if (references.size() % 64 == 0) {
+          usedBits.push_back(0);
+        }
+
+        references.emplace_back(transactionIndex, outputIndex);
+      }
+
+      void pop_back() {
+        references.pop_back();
+        if (references.size() % 64 == 0) {
+          usedBits.pop_back();
+        } else {
+          setUsed(references.size(), false);
+        }
+      }
+    };
+
+    typedef google::sparse_hash_map<uint64_t, KeyOutputs> outputs_container;
+    typedef std::unordered_map<uint64_t, MultisignatureOutputs> MultisignatureOutputsContainer;
 
     const Currency& m_currency;
     tx_memory_pool& m_tx_pool;
-    std::recursive_mutex m_blockchain_lock; // TODO: add here reader/writer lock
+    // Read-only queries take shared lock, chain mutations (push, pop, reorganize, cache store) take exclusive lock.
+    // Read paths must never call into mutating ones, shared lock cannot be upgraded.
+    Common::RecursiveSharedMutex m_blockchain_lock;
     crypto::cn_context m_cn_context;
     tools::ObserverManager<IBlockchainStorageObserver> m_observerManager;
 
     key_images_container m_spent_keys;
+    // Most looked up key images are not spent, the filter answers for them without probing m_spent_keys
+    KeyImagesFilter m_spentKeysFilter;
     size_t m_current_block_cumul_sz_limit;
     blocks_ext_by_hash m_alternative_chains; // crypto::hash -> block_extended_info
+    // Fork tree over m_alternative_chains, whole forks are evicted from the lowest one when there are too many blocks
+    std::unordered_multimap<crypto::hash, crypto::hash> m_alternativeChildren; // prevId -> id
+    std::multimap<uint32_t, crypto::hash> m_alternativeHeights;
     outputs_container m_outputs;
 
     std::string m_config_folder;
     checkpoints m_checkpoints;
     std::atomic<bool> m_is_in_checkpoint_zone;
     std::atomic<bool> m_is_blockchain_storing;
+    bool m_mapBlocksFile;
+    bool m_compressBlocksFile;
+    bool m_diskIndexes;
+    bool m_explorerIndexesEnabled;
+    // Allocated on init if explorer indexes are enabled
+    std::unique_ptr<ExplorerIndexes> m_explorerIndexes;
+    std::string m_snapshotFolder;
+    bool m_replica;
+    // Last blocks of a replica as they were indexed, the writing node overwrites popped blocks in the blocks file
+    std::deque<std::shared_ptr<const BlockEntry>> m_replicaTail;
+    size_t m_blocksCacheSize;
+    uint64_t m_blocksCacheMemory;
+    uint64_t m_blocksCacheMemoryLimit;
+    SwappedCachePolicy m_blocksCachePolicy;
+    bool m_fastSync;
+    // Height of the stored cache snapshot and journal of blocks popped below it
+    uint32_t m_cacheHeight;
+    std::ofstream m_cacheJournal;
+    // Height of the snapshot being written in background, 0 if none. Blocks popped below it are journaled too.
+    uint32_t m_storingCacheHeight;
+    std::atomic<bool> m_isCacheStoring;
+    std::thread m_cacheStoreThread;
+    // Threads checking ring signatures and hashing blocks on cache rebuild, including the calling one
+    size_t m_verificationThreads;
+    std::unique_ptr<Common::ThreadPool> m_verificationPool;
+    // Proofs of work of downloaded blocks are computed on own threads, so ring signature checks don't queue behind them
+    std::unique_ptr<Common::ThreadPool> m_proofOfWorkPool;
+    std::mutex m_preparedProofsOfWorkMutex;
+    std::unordered_map<crypto::hash, std::shared_future<crypto::hash>> m_preparedProofsOfWork;
+    LongHashCache m_longHashCache;
 
     typedef SwappedVector<BlockEntry> Blocks;
     typedef std::unordered_map<crypto::hash, uint32_t> BlockMap;
-    typedef std::unordered_map<crypto::hash, TransactionIndex> TransactionMap;
-    typedef BasicUpgradeDetector<Blocks> UpgradeDetector;
+    typedef IBlockchainIndexStore<crypto::hash, TransactionIndex> TransactionMap;
+    typedef BasicUpgradeDetector<BlockHeaderColumns> UpgradeDetector;
 
     friend class BlockCacheSerializer;
 
     Blocks m_blocks;
     CryptoNote::BlockIndex m_blockIndex;
-    TransactionMap m_transactionMap;
+    // Header fields of main chain blocks, kept along with the block index
+    BlockHeaderColumns m_blockHeaders;
+    // BlockFilter of every main chain block, kept along with the block index
+    std::vector<std::string> m_blockFilters;
+    std::unique_ptr<TransactionMap> m_transactionMap;
+    // Set while the transaction map is the default one keyed by hash prefixes, its snapshot holds prefixes only
+    PrefixIndexStore<crypto::hash, TransactionIndex>* m_compactTransactionMap;
+    // Blocks referenced by the transaction map which are not in m_blocks at their height, the block being pushed and
+    // journal blocks being rewound, for resolving transaction hashes
+    std::map<uint32_t, const BlockEntry*> m_unstoredBlocks;
+    // Undo records of the last pushed blocks in height order, blocks below them are popped by walking their transactions
+    std::deque<BlockUndo> m_blockUndos;
     MultisignatureOutputsContainer m_multisignatureOutputs;
     UpgradeDetector m_upgradeDetector;
 
     Logging::LoggerRef logger;
 
+    void addSpentKeyToFilter(const crypto::key_image& keyImage);
+    void rebuildSpentKeysFilter();
+    static std::string buildBlockFilter(const BlockEntry& block);
     bool storeCache();
+    void storeCacheSnapshot();
+    bool updateCache();
+    bool installSnapshot(const std::string& config_folder, SnapshotManifest& manifest);
+    bool checkCheckpoints();
+    size_t getBlocksCachePoolSize() const;
+    void rebuildCache(uint32_t startHeight);
+    void clearCache();
+    void popReplicaBlock();
+    void fillReplicaTail();
     template<class visitor_t> bool scan_outputkeys_for_indexes(const TransactionInputToKey& tx_in_to_key, visitor_t& vis, uint64_t* pmax_related_block_height = NULL);
     bool switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::iterator>& alt_chain, bool discard_disconnected_chain);
     bool handle_alternative_block(const Block& b, const crypto::hash& id, block_verification_context& bvc);
+    bool completeAlternativeChain(std::list<blocks_ext_by_hash::iterator>& alt_chain);
+    blocks_ext_by_hash::iterator addAlternativeBlock(const crypto::hash& id, const BlockEntry& block);
+    void removeAlternativeBlock(blocks_ext_by_hash::iterator it);
+    void evictAlternativeBlocks();
     difficulty_type get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, BlockEntry& bei);
     bool prevalidate_miner_transaction(const Block& b, uint64_t height);
     bool validate_miner_transaction(const Block& b, uint64_t height, size_t cumulativeBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint64_t& reward, int64_t& emissionChange);
     bool validate_transaction(const Block& b, uint64_t height, const Transaction& tx);
     bool rollback_blockchain_switching(std::list<Block>& original_chain, size_t rollback_height);
     bool get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count);
-    bool add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount& result_outs, uint64_t amount, size_t i);
+    bool add_out_to_get_random_outs(const KeyOutputs& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount& result_outs, uint64_t height, uint64_t currentTime, size_t i);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
-    size_t find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs);
+    bool is_tx_spendtime_unlocked(uint64_t unlock_time, uint64_t height, uint64_t current_time);
+    size_t find_end_of_allowed_index(const KeyOutputs& amount_outs);
     bool check_block_timestamp_main(const Block& b);
     bool check_block_timestamp(std::vector<uint64_t> timestamps, const Block& b);
     uint64_t get_adjusted_time();
@@ -255,20 +546,47 @@ namespace CryptoNote {
     bool checkCumulativeBlockSize(const crypto::hash& blockId, size_t cumulativeBlockSize, uint64_t height);
     bool getBlockCumulativeSize(const Block& block, size_t& cumulativeSize);
     bool update_next_comulative_size_limit();
-    bool check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL);
-    bool check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height = NULL);
-    bool check_tx_inputs(const Transaction& tx, uint64_t* pmax_used_block_height = NULL);
+    void updateCheckpointZone();
+    struct RingSignatureCheck {
+      crypto::hash prefixHash;
+      const TransactionInputToKey* input;
+      const std::vector<crypto::signature>* signatures;
+      std::vector<crypto::public_key> outputKeys;
+    };
+
+    bool check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL, RingSignatureCheck* deferredCheck = NULL);
+    bool checkRingSignatures(const std::vector<RingSignatureCheck>& checks);
+    bool takePreparedProofOfWork(const crypto::hash& blockHash, crypto::hash& proofOfWork);
+    bool checkProofOfWork(const Block& block, const crypto::hash& blockHash, difficulty_type currentDifficulty, crypto::hash& proofOfWork);
+    // With deferredChecks ring signatures are appended there instead of being verified
+    bool check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height = NULL, std::vector<RingSignatureCheck>* deferredChecks = NULL);
+    bool check_tx_inputs(const Transaction& tx, uint64_t* pmax_used_block_height = NULL, std::vector<RingSignatureCheck>* deferredChecks = NULL);
     bool have_tx_keyimg_as_spent(const crypto::key_image &key_im);
-    const TransactionEntry& transactionByIndex(TransactionIndex index);
-    bool pushBlock(const Block& blockData, block_verification_context& bvc);
-    bool pushBlock(BlockEntry& block);
+    // Entry shares ownership of its cached block, so it stays valid when concurrent reader evicts the block from cache
+    std::shared_ptr<const TransactionEntry> transactionByIndex(TransactionIndex index);
+    // Copies transactions in the order of indexes, each block is read once
+    void transactionsByIndexes(const std::vector<TransactionIndex>& indexes, std::vector<Transaction>& transactions);
+    bool getIndexedTransactionHash(const TransactionIndex& index, crypto::hash& transactionHash);
+    static BlockSummary makeBlockSummary(const BlockEntry& block);
+    BlockSummary getBlockSummary(uint64_t height) { return m_blockHeaders.get(height); }
+    // Block hash is computed once by the caller, it is already known whenever a block is pushed
+    bool pushBlock(const Block& blockData, const crypto::hash& blockHash, block_verification_context& bvc);
+    bool pushBlock(BlockEntry& block, const crypto::hash& blockHash, const crypto::hash& minerTransactionHash);
     void popBlock(const crypto::hash& blockHash);
     bool pushTransaction(BlockEntry& block, const crypto::hash& transactionHash, TransactionIndex transactionIndex);
+    static TransactionUndo makeTransactionUndo(const Transaction& transaction, const crypto::hash& transactionHash);
+    static BlockUndo makeBlockUndo(const BlockEntry& block, const crypto::hash& minerTransactionHash);
     void popTransaction(const Transaction& transaction, const crypto::hash& transactionHash);
+    void popTransaction(const TransactionUndo& undo, const Transaction& transaction);
+    void addToExplorerIndexes(const Transaction& transaction, TransactionIndex transactionIndex);
+    void removeFromExplorerIndexes(const Transaction& transaction, TransactionIndex transactionIndex);
+    bool makeExplorerTransaction(TransactionIndex transactionIndex, ExplorerTransaction& transaction);
     void popTransactions(const BlockEntry& block, const crypto::hash& minerTransactionHash);
+    void popTransactions(const BlockEntry& block, const BlockUndo& undo);
     bool validateInput(const TransactionInputMultisignature& input, const crypto::hash& transactionHash, const crypto::hash& transactionPrefixHash, const std::vector<crypto::signature>& transactionSignatures);
 
     friend class LockedBlockchainStorage;
+    friend class ReadLockedBlockchainStorage;
   };
 
   class LockedBlockchainStorage: boost::noncopyable {
@@ -284,45 +602,49 @@ namespace CryptoNote {
   private:
 
     blockchain_storage& m_bc;
-    std::lock_guard<std::recursive_mutex> m_lock;
+    std::lock_guard<Common::RecursiveSharedMutex> m_lock;
+  };
+
+  // Same as LockedBlockchainStorage, but holds shared lock. Only read-only methods may be called through it.
+  class ReadLockedBlockchainStorage: boost::noncopyable {
+  public:
+
+    ReadLockedBlockchainStorage(blockchain_storage& bc)
+      : m_bc(bc), m_lock(bc.m_blockchain_lock) {}
+
+    blockchain_storage* operator -> () {
+      return &m_bc;
+    }
+
+  private:
+
+    blockchain_storage& m_bc;
+    Common::SharedLockGuard<Common::RecursiveSharedMutex> m_lock;
   };
 
   template<class visitor_t> bool blockchain_storage::scan_outputkeys_for_indexes(const TransactionInputToKey& tx_in_to_key, visitor_t& vis, uint64_t* pmax_related_block_height) {
-    std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+    Common::SharedLockGuard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     auto it = m_outputs.find(tx_in_to_key.amount);
     if (it == m_outputs.end() || !tx_in_to_key.keyOffsets.size())
       return false;
 
     std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.keyOffsets);
-    std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs_vec = it->second;
+    const KeyOutputs& amount_outs = it->second;
     size_t count = 0;
     for (uint64_t i : absolute_offsets) {
-      if(i >= amount_outs_vec.size() ) {
-        logger(Logging::INFO) << "Wrong index in transaction inputs: " << i << ", expected maximum " << amount_outs_vec.size() - 1;
-        return false;
-      }
-
-      //auto tx_it = m_transactionMap.find(amount_outs_vec[i].first);
-      //if (!(tx_it != m_transactionMap.end())) { logger(ERROR, BRIGHT_RED) << "Wrong transaction id in output indexes: " << Common::podToHex(amount_outs_vec[i].first); return false; }
-
-      const TransactionEntry& tx = transactionByIndex(amount_outs_vec[i].first);
-
-      if (!(amount_outs_vec[i].second < tx.tx.vout.size())) {
-        logger(Logging::ERROR, Logging::BRIGHT_RED)
-            << "Wrong index in transaction outputs: "
-            << amount_outs_vec[i].second << ", expected less then "
-            << tx.tx.vout.size();
+      if(i >= amount_outs.size() ) {
+        logger(Logging::INFO) << "Wrong index in transaction inputs: " << i << ", expected maximum " << amount_outs.size() - 1;
         return false;
       }
 
-      if (!vis.handle_output(tx.tx, tx.tx.vout[amount_outs_vec[i].second])) {
+      if (!vis.handle_output(amount_outs.unlockTimes[i], amount_outs.keys[i])) {
         logger(Logging::INFO) << "Failed to handle_output for output no = " << count << ", with absolute offset " << i;
         return false;
       }
 
       if(count++ == absolute_offsets.size()-1 && pmax_related_block_height) {
-        if (*pmax_related_block_height < amount_outs_vec[i].first.block) {
-          *pmax_related_block_height = amount_outs_vec[i].first.block;
+        if (*pmax_related_block_height < amount_outs.height(i)) {
+          *pmax_related_block_height = amount_outs.height(i);
         }
       }
     }
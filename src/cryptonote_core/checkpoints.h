@@ -32,6 +32,7 @@ namespace CryptoNote
     bool check_block(uint64_t height, const crypto::hash& h) const;
     bool check_block(uint64_t height, const crypto::hash& h, bool& is_a_checkpoint) const;
     bool is_alternative_block_allowed(uint64_t blockchain_height, uint64_t block_height) const;
+    const std::map<uint64_t, crypto::hash>& get_points() const { return m_points; }
 
   private:
     std::map<uint64_t, crypto::hash> m_points;
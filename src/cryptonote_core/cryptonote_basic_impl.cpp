@@ -57,11 +57,16 @@ namespace CryptoNote {
     return penalizedAmountLo;
   }
   //-----------------------------------------------------------------------
+  // Binary form of an address is its spend key followed by its view key, same as 't_serializable_object_to_blob' gives
   std::string getAccountAddressAsStr(uint64_t prefix, const AccountPublicAddress& adr) {
-    blobdata blob;
-    bool r = t_serializable_object_to_blob(adr, blob);
+    char blob[2 * sizeof(crypto::public_key)];
+    memcpy(blob, &adr.m_spendPublicKey, sizeof(crypto::public_key));
+    memcpy(blob + sizeof(crypto::public_key), &adr.m_viewPublicKey, sizeof(crypto::public_key));
+
+    tools::base58::addr_buffer buffer;
+    bool r = tools::base58::encode_addr(prefix, blob, sizeof(blob), buffer);
     assert(r);
-    return tools::base58::encode_addr(prefix, blob);
+    return std::string(buffer.getData(), buffer.getSize());
   }
   //-----------------------------------------------------------------------
   bool is_coinbase(const Transaction& tx) {
@@ -77,11 +82,15 @@ namespace CryptoNote {
   }
   //-----------------------------------------------------------------------
   bool parseAccountAddressString(uint64_t& prefix, AccountPublicAddress& adr, const std::string& str) {
-    blobdata data;
+    char data[tools::base58::max_addr_size];
+    size_t size;
+    if (!tools::base58::decode_addr(str.data(), str.size(), prefix, data, sizeof(data), size) || size < 2 * sizeof(crypto::public_key)) {
+      return false;
+    }
 
+    memcpy(&adr.m_spendPublicKey, data, sizeof(crypto::public_key));
+    memcpy(&adr.m_viewPublicKey, data + sizeof(crypto::public_key), sizeof(crypto::public_key));
     return
-      tools::base58::decode_addr(str, prefix, data) &&
-      ::serialization::parse_binary(data, adr) &&
       crypto::check_key(adr.m_spendPublicKey) &&
       crypto::check_key(adr.m_viewPublicKey);
   }
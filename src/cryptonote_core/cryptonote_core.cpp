@@ -16,10 +16,14 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cryptonote_core.h"
+#include <future>
+#include <set>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 #include "../cryptonote_config.h"
 #include "../Common/command_line.h"
+#include "../Common/StageProfiler.h"
 #include "../Common/util.h"
 #include "../crypto/crypto.h"
 #include "../cryptonote_protocol/cryptonote_protocol_defs.h"
@@ -28,11 +32,23 @@
 #include "cryptonote_format_utils.h"
 #include "cryptonote_stat_info.h"
 #include "miner.h"
+#include "TrackingKeysFilter.h"
 #undef ERROR
 
 using namespace Logging;
 #include "cryptonote_core/CoreConfig.h"
 
+#define TRANSACTION_ADMISSION_CACHE_SIZE 10000
+
+namespace {
+// Blocks cache gets the larger share, it is read by syncing peers and its misses cost disk reads
+const uint32_t BLOCKS_CACHE_MEMORY_WEIGHT = 3;
+const uint32_t POOL_MEMORY_WEIGHT = 1;
+// Parsed transaction with its indexes takes about this many times its blob size
+const uint64_t POOL_TRANSACTION_OVERHEAD = 3;
+const unsigned MEMORY_BUDGET_UPDATE_INTERVAL = 10;
+}
+
 namespace CryptoNote {
 
 core::core(const Currency& currency, i_cryptonote_protocol* pprotocol, Logging::ILogger& logger) :
@@ -41,7 +57,15 @@ logger(logger, "core"),
 m_mempool(currency, m_blockchain_storage, m_timeProvider, logger),
 m_blockchain_storage(currency, m_mempool, logger),
 m_miner(new miner(currency, *this, logger)),
-m_starter_message_showed(false) {
+m_starter_message_showed(false),
+m_memoryBudgetInterval(MEMORY_BUDGET_UPDATE_INTERVAL),
+m_blockTemplateVersion(0),
+m_admissionCache(TRANSACTION_ADMISSION_CACHE_SIZE),
+m_admissionCacheVersion(0),
+m_rejectedTransactionsVersion(0),
+m_parseBlockStage(Common::StageProfiler::stage("parse_block")),
+m_handleBlockStage(Common::StageProfiler::stage("handle_incoming_block")) {
+  m_blockTemplate.valid = false;
   set_cryptonote_protocol(pprotocol);
   m_blockchain_storage.addObserver(this);
     m_mempool.addObserver(this);
@@ -105,10 +129,39 @@ size_t core::get_alternative_blocks_count() {
   //-----------------------------------------------------------------------------------------------
   bool core::init(const CoreConfig& config, const MinerConfig& minerConfig, bool load_existing) {
     m_config_folder = config.configFolder;
-    bool r = m_mempool.init(m_config_folder);
-  if (!(r)) { logger(ERROR, BRIGHT_RED) << "Failed to initialize memory pool"; return false; }
-
-  r = m_blockchain_storage.init(m_config_folder, load_existing);
+    m_mempool.setSizeLimits(config.poolMaxTransactions, config.poolMaxSize);
+  // Pool state is loaded while blockchain is, pool serializes its own state and calls from blockchain storage.
+  // Pool state file belongs to the writing node of a replica, replica pool stays empty.
+  bool replica = config.replica;
+  std::future<bool> poolInit = std::async(std::launch::async, [this, replica] { return replica || m_mempool.init(m_config_folder); });
+
+  m_blockchain_storage.set_blocks_file_mapping(config.mapBlocksFile);
+  m_blockchain_storage.set_blocks_file_compression(config.compressBlocksFile);
+  m_blockchain_storage.set_disk_indexes(config.diskIndexes);
+  m_blockchain_storage.set_explorer_indexes(config.explorerIndexes);
+  m_blockchain_storage.set_fast_sync(config.fastSync);
+  m_blockchain_storage.set_snapshot_folder(config.snapshotFolder);
+  m_blockchain_storage.set_replica(config.replica);
+  m_blockchain_storage.set_blocks_cache_size(static_cast<size_t>(config.blocksCacheSize), config.blocksCacheMemory);
+  m_blockchain_storage.set_blocks_cache_policy(config.blocksCachePolicy);
+  if (config.verificationThreads != 0) {
+    m_blockchain_storage.set_verification_threads(config.verificationThreads);
+  }
+
+  size_t transactionThreads = config.verificationThreads != 0 ? config.verificationThreads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  m_transactionsPool.reset(new Common::ThreadPool(transactionThreads - 1));
+
+  m_memoryBudget.setBudget(config.memoryBudget);
+  m_memoryBudget.addConsumer("blocks_cache", BLOCKS_CACHE_MEMORY_WEIGHT,
+    [this] { return m_blockchain_storage.get_blocks_cache_memory_usage(); },
+    [this](uint64_t limit) { m_blockchain_storage.set_blocks_cache_memory_limit(limit); });
+  m_memoryBudget.addConsumer("tx_pool", POOL_MEMORY_WEIGHT,
+    [this] { return static_cast<uint64_t>(m_mempool.getTransactionsSize()) * POOL_TRANSACTION_OVERHEAD; },
+    [this](uint64_t limit) {
+      m_mempool.setMemoryLimit(limit == 0 ? 0 : static_cast<size_t>(std::max<uint64_t>(limit / POOL_TRANSACTION_OVERHEAD, 1)));
+    });
+  bool r = m_blockchain_storage.init(m_config_folder, load_existing);
+  if (!poolInit.get()) { logger(ERROR, BRIGHT_RED) << "Failed to initialize memory pool"; return false; }
   if (!(r)) { logger(ERROR, BRIGHT_RED) << "Failed to initialize blockchain storage"; return false; }
 
     r = m_miner->init(minerConfig);
@@ -128,23 +181,79 @@ bool core::load_state_data() {
 
 bool core::deinit() {
   m_miner->stop();
-  m_mempool.deinit();
+  m_transactionsPool.reset();
+  if (!m_blockchain_storage.is_replica()) {
+    m_mempool.deinit();
+  }
+
   m_blockchain_storage.deinit();
   return true;
 }
 
-bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block) {
+bool core::handle_incoming_tx(Common::StringView tx_blob, tx_verification_context& tvc, bool keeped_by_block) {
   tvc = boost::value_initialized<tx_verification_context>();
-  //want to process all transactions sequentially
-  std::lock_guard<std::mutex> lk(m_incoming_tx_lock);
-
-  if (tx_blob.size() > m_currency.maxTxSize()) {
-    logger(INFO) << "WRONG TRANSACTION BLOB, too big size " << tx_blob.size() << ", rejected";
+  if (tx_blob.getSize() > m_currency.maxTxSize()) {
+    logger(INFO) << "WRONG TRANSACTION BLOB, too big size " << tx_blob.getSize() << ", rejected";
     tvc.m_verifivation_failed = true;
     return false;
   }
 
+  crypto::hash blobHash = crypto::cn_fast_hash(tx_blob.getData(), tx_blob.getSize());
   crypto::hash tx_hash = null_hash;
+  bool accepted;
+  bool rejected;
+  // a rejection is cached only if the chain and pool haven't changed while the transaction was verified
+  uint64_t rejectedVersion;
+  {
+    std::lock_guard<std::mutex> lk(m_incoming_tx_lock);
+    rejectedVersion = m_rejectedTransactionsVersion;
+    if (m_admissionCacheVersion != rejectedVersion) {
+      m_admissionCache.clearRejected();
+      m_admissionCacheVersion = rejectedVersion;
+    }
+
+    accepted = m_admissionCache.getAccepted(blobHash, tx_hash);
+    rejected = !keeped_by_block && m_admissionCache.isRejected(blobHash);
+  }
+
+  if (accepted && (m_mempool.have_tx(tx_hash) || m_blockchain_storage.have_tx(tx_hash))) {
+    logger(TRACE) << "tx " << tx_hash << " is already known";
+    return true;
+  }
+
+  if (rejected) {
+    logger(DEBUGGING) << "tx with blob hash " << blobHash << " was rejected recently";
+    tvc.m_verifivation_failed = true;
+    return false;
+  }
+
+  // Parsing and checks against the chain run without core lock, pool locks itself only to insert the transaction
+  bool r = handle_incoming_tx_blob(tx_blob, tvc, keeped_by_block, tx_hash);
+  std::lock_guard<std::mutex> lk(m_incoming_tx_lock);
+  if (tvc.m_verifivation_failed) {
+    if (!keeped_by_block && m_rejectedTransactionsVersion == rejectedVersion) {
+      m_admissionCache.addRejected(blobHash);
+    }
+  } else if (r && !tvc.m_verifivation_impossible) {
+    m_admissionCache.addAccepted(blobHash, tx_hash);
+  }
+
+  return r;
+}
+
+void core::handle_incoming_txs(const std::vector<Common::StringView>& tx_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block) {
+  tvcs.resize(tx_blobs.size());
+  auto handleTransaction = [&](size_t i) { handle_incoming_tx(tx_blobs[i], tvcs[i], keeped_by_block); };
+  if (tx_blobs.size() > 1 && m_transactionsPool && m_transactionsPool->threadCount() != 0) {
+    m_transactionsPool->parallelFor(tx_blobs.size(), handleTransaction);
+  } else {
+    for (size_t i = 0; i < tx_blobs.size(); ++i) {
+      handleTransaction(i);
+    }
+  }
+}
+
+bool core::handle_incoming_tx_blob(Common::StringView tx_blob, tx_verification_context& tvc, bool keeped_by_block, crypto::hash& tx_hash) {
   crypto::hash tx_prefixt_hash = null_hash;
   Transaction tx;
 
@@ -167,7 +276,7 @@ bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context&
     return false;
   }
 
-  bool r = add_new_tx(tx, tx_hash, tx_prefixt_hash, tx_blob.size(), tvc, keeped_by_block);
+  bool r = add_new_tx(tx, tx_hash, tx_prefixt_hash, tx_blob.getSize(), tvc, keeped_by_block);
   if (tvc.m_verifivation_failed) {
     if (!tvc.m_tx_fee_too_small) {
       logger(ERROR) << "Transaction verification failed: " << tx_hash;
@@ -259,11 +368,15 @@ bool core::check_tx_inputs_keyimages_diff(const Transaction& tx) {
 }
 
 bool core::add_new_tx(const Transaction& tx, tx_verification_context& tvc, bool keeped_by_block) {
-  crypto::hash tx_hash = get_transaction_hash(tx);
-  crypto::hash tx_prefix_hash = get_transaction_prefix_hash(tx);
-  blobdata bl;
-  t_serializable_object_to_blob(tx, bl);
-  return add_new_tx(tx, tx_hash, tx_prefix_hash, bl.size(), tvc, keeped_by_block);
+  crypto::hash tx_hash;
+  crypto::hash tx_prefix_hash;
+  size_t blob_size;
+  if (!get_transaction_hashes(tx, tx_hash, tx_prefix_hash, blob_size)) {
+    tvc.m_verifivation_failed = true;
+    return false;
+  }
+
+  return add_new_tx(tx, tx_hash, tx_prefix_hash, blob_size, tvc, keeped_by_block);
 }
 
 size_t core::get_blockchain_total_transactions() {
@@ -281,10 +394,7 @@ bool core::add_new_tx(const Transaction& tx, const crypto::hash& tx_hash, const
     return true;
   }
 
-  // It's not very good to lock on m_mempool here, because it's very hard to understand the order of locking
-  // tx_memory_pool::m_transactions_lock, blockchain_storage::m_blockchain_lock, and core::m_incoming_tx_lock
-  std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-
+  // Pool is not locked here, add_tx checks inputs unlocked and rechecks duplicates and key images when inserting
   if (m_mempool.have_tx(tx_hash)) {
     logger(TRACE) << "tx " << tx_hash << " is already in transaction pool";
     return true;
@@ -294,7 +404,54 @@ bool core::add_new_tx(const Transaction& tx, const crypto::hash& tx_hash, const
 }
 
 bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficulty_type& diffic, uint32_t& height, const blobdata& ex_nonce) {
-  return m_blockchain_storage.create_block_template(b, adr, diffic, height, ex_nonce);
+  if (getCachedBlockTemplate(b, adr, diffic, height, ex_nonce)) {
+    return true;
+  }
+
+  uint64_t version = m_blockTemplateVersion;
+  if (!m_blockchain_storage.create_block_template(b, adr, diffic, height, ex_nonce)) {
+    return false;
+  }
+
+  cacheBlockTemplate(b, adr, diffic, height, ex_nonce, version);
+  return true;
+}
+
+bool core::getCachedBlockTemplate(Block& b, const AccountPublicAddress& adr, difficulty_type& diffic, uint32_t& height, const blobdata& ex_nonce) {
+  std::lock_guard<std::mutex> lock(m_blockTemplateLock);
+  if (!m_blockTemplate.valid || m_blockTemplate.version != m_blockTemplateVersion ||
+    m_blockTemplate.extraNonceSize != ex_nonce.size() ||
+    m_blockTemplate.address.m_spendPublicKey != adr.m_spendPublicKey ||
+    m_blockTemplate.address.m_viewPublicKey != adr.m_viewPublicKey ||
+    m_blockTemplate.block.prevId != m_blockchain_storage.get_tail_id()) {
+    return false;
+  }
+
+  b = m_blockTemplate.block;
+  b.timestamp = time(NULL);
+  // Extra nonce of the same size occupies the same bytes right after the public key, so sizes and reward stay valid
+  std::copy(ex_nonce.begin(), ex_nonce.end(), b.minerTx.extra.begin() + 1 + sizeof(crypto::public_key) + 2);
+  diffic = m_blockTemplate.difficulty;
+  height = m_blockTemplate.height;
+  return true;
+}
+
+void core::cacheBlockTemplate(const Block& b, const AccountPublicAddress& adr, difficulty_type diffic, uint32_t height, const blobdata& ex_nonce, uint64_t version) {
+  const size_t nonceOffset = 1 + sizeof(crypto::public_key);
+  const auto& extra = b.minerTx.extra;
+  if (!ex_nonce.empty() && (extra.size() < nonceOffset + 2 + ex_nonce.size() || extra[0] != TX_EXTRA_TAG_PUBKEY ||
+    extra[nonceOffset] != TX_EXTRA_NONCE || extra[nonceOffset + 1] != ex_nonce.size())) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_blockTemplateLock);
+  m_blockTemplate.valid = true;
+  m_blockTemplate.version = version;
+  m_blockTemplate.block = b;
+  m_blockTemplate.address = adr;
+  m_blockTemplate.extraNonceSize = ex_nonce.size();
+  m_blockTemplate.difficulty = diffic;
+  m_blockTemplate.height = height;
 }
 
 bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) {
@@ -305,6 +462,10 @@ bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids,
   return m_blockchain_storage.find_blockchain_supplement(qblock_ids, blocks, total_height, start_height, max_count);
 }
 
+bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<block_complete_entry>& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) {
+  return m_blockchain_storage.find_blockchain_supplement(qblock_ids, blocks, total_height, start_height, max_count);
+}
+
 void core::print_blockchain(uint64_t start_index, uint64_t end_index) {
   m_blockchain_storage.print_blockchain(start_index, end_index);
 }
@@ -354,32 +515,51 @@ void core::on_synchronized() {
     return true;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::handle_incoming_block_blob(const blobdata& block_blob, block_verification_context& bvc, bool control_miner, bool relay_block) {
-  if (block_blob.size() > m_currency.maxBlockBlobSize()) {
-    logger(INFO) << "WRONG BLOCK BLOB, too big size " << block_blob.size() << ", rejected";
+  bool core::getPoolChanges(uint64_t known_version, const crypto::hash& known_block_id, bool& isBcActual, bool& isVersionActual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version) {
+    isVersionActual = false;
+    isBcActual = m_blockchain_storage.getPoolChanges(known_version, known_block_id, isVersionActual, new_txs, deleted_tx_ids, version);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_block_blob(Common::StringView block_blob, block_verification_context& bvc, bool control_miner, bool relay_block) {
+  if (block_blob.getSize() > m_currency.maxBlockBlobSize()) {
+    logger(INFO) << "WRONG BLOCK BLOB, too big size " << block_blob.getSize() << ", rejected";
     bvc.m_verifivation_failed = true;
     return false;
   }
 
   Block b;
+  Common::StageTimer parseTimer(m_parseBlockStage);
   if (!parse_and_validate_block_from_blob(block_blob, b)) {
     logger(INFO) << "Failed to parse and validate new block";
     bvc.m_verifivation_failed = true;
     return false;
   }
 
+  parseTimer.stop();
+
   return handle_incoming_block(b, bvc, control_miner, relay_block);
 }
 
+void core::prepare_incoming_blocks(const std::vector<Block>& blocks) {
+  m_blockchain_storage.prepareBlocks(blocks);
+}
+
+bool core::check_block_headers(const std::vector<Block>& headers, bool& checked, bool& heavier) {
+  return m_blockchain_storage.checkBlockHeaders(headers, checked, heavier);
+}
+
 bool core::handle_incoming_block(const Block& b, block_verification_context& bvc, bool control_miner, bool relay_block) {
-  if (control_miner) {
-    pause_mining();
-  }
+  Common::StageTimer stageTimer(m_handleBlockStage);
+  // miner yields the CPU to validation of every block, synced ones included
+  pause_mining();
 
   m_blockchain_storage.add_new_block(b, bvc);
 
   if (control_miner) {
     update_block_template_and_resume_mining();
+  } else {
+    m_miner->resume();
   }
 
   if (relay_block && bvc.m_added_to_main_chain) {
@@ -418,11 +598,19 @@ size_t core::get_pool_transactions_count() {
   return m_mempool.get_transactions_count();
 }
 
+bool core::set_blocks_cache_size(size_t cacheSize, uint64_t memoryBudget) {
+  return m_blockchain_storage.set_blocks_cache_size(cacheSize, memoryBudget);
+}
+
+SwappedVectorCacheStatistics core::get_blocks_cache_statistics() {
+  return m_blockchain_storage.get_blocks_cache_statistics();
+}
+
 bool core::have_block(const crypto::hash& id) {
   return m_blockchain_storage.have_block(id);
 }
 
-bool core::parse_tx_from_blob(Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash, const blobdata& blob) {
+bool core::parse_tx_from_blob(Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash, Common::StringView blob) {
   return parse_and_validate_tx_from_blob(blob, tx, tx_hash, tx_prefix_hash);
 }
 
@@ -446,6 +634,14 @@ bool core::getBlockByHash(const crypto::hash &h, Block &blk) {
   return core::get_block_by_hash(h, blk);
 }
 
+bool core::havePoolTransaction(const crypto::hash& id) {
+  return m_mempool.have_tx(id);
+}
+
+void core::getPoolTransactions(const std::list<crypto::hash>& ids, std::list<Transaction>& txs, std::list<crypto::hash>& missedIds) {
+  m_mempool.getTransactions(ids, txs, missedIds);
+}
+
 crypto::hash core::get_block_id_by_height(uint64_t height) {
   return m_blockchain_storage.get_block_id_by_height(height);
 }
@@ -483,6 +679,8 @@ bool core::on_idle() {
 
   m_miner->on_idle();
   m_mempool.on_idle();
+  m_blockchain_storage.storeCacheInBackground();
+  m_memoryBudgetInterval.call([this] { m_memoryBudget.update(); return true; });
   return true;
 }
 
@@ -495,21 +693,56 @@ bool core::removeObserver(ICoreObserver* observer) {
 }
 
 void core::blockchainUpdated() {
+  ++m_blockTemplateVersion;
+  ++m_rejectedTransactionsVersion;
   m_observerManager.notify(&ICoreObserver::blockchainUpdated);
 }
 
   void core::txDeletedFromPool() {
+    ++m_rejectedTransactionsVersion;
     poolUpdated();
   }
 
+  void core::txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) {
+    logger(DEBUGGING) << transactionIds.size() << " transactions evicted from full transaction pool";
+    m_observerManager.notify(&ICoreObserver::txsEvictedFromPool, transactionIds);
+    txDeletedFromPool();
+  }
+
   void core::poolUpdated() {
+    ++m_blockTemplateVersion;
     m_observerManager.notify(&ICoreObserver::poolUpdated);
   }
 
+  // blocks are serialized after the blockchain lock is released
   bool core::queryBlocks(const std::list<crypto::hash>& knownBlockIds, uint64_t timestamp,
   uint64_t& resStartHeight, uint64_t& resCurrentHeight, uint64_t& resFullOffset, std::list<BlockFullInfo>& entries) {
+  std::list<BlockParsedInfo> parsedEntries;
+  if (!queryBlocksParsed(knownBlockIds, timestamp, resStartHeight, resCurrentHeight, resFullOffset, parsedEntries)) {
+    return false;
+  }
+
+  for (const auto& parsedEntry : parsedEntries) {
+    BlockFullInfo item;
+    item.block_id = parsedEntry.blockId;
+    if (parsedEntry.hasBlock) {
+      block_complete_entry& completeEntry = item;
+      completeEntry.block = block_to_blob(parsedEntry.block);
+      for (const auto& tx : parsedEntry.txs) {
+        completeEntry.txs.push_back(tx_to_blob(tx));
+      }
+    }
 
-  LockedBlockchainStorage lbs(m_blockchain_storage);
+    entries.push_back(std::move(item));
+  }
+
+  return true;
+}
+
+bool core::queryBlocksParsed(const std::list<crypto::hash>& knownBlockIds, uint64_t timestamp,
+  uint64_t& resStartHeight, uint64_t& resCurrentHeight, uint64_t& resFullOffset, std::list<BlockParsedInfo>& entries) {
+
+  ReadLockedBlockchainStorage lbs(m_blockchain_storage);
 
   uint64_t currentHeight = lbs->get_current_blockchain_height();
   uint64_t startOffset = 0;
@@ -532,8 +765,9 @@ void core::blockchainUpdated() {
     }
 
     for (const auto& id : blockIds) {
-      entries.push_back(BlockFullInfo());
-      entries.back().block_id = id;
+      entries.push_back(BlockParsedInfo());
+      entries.back().blockId = id;
+      entries.back().hasBlock = false;
     }
   }
 
@@ -544,22 +778,15 @@ void core::blockchainUpdated() {
     lbs->get_blocks(startFullOffset, blocksLeft, blocks);
 
     for (auto& b : blocks) {
-      BlockFullInfo item;
+      BlockParsedInfo item;
 
-      item.block_id = get_block_hash(b);
+      item.blockId = get_block_hash(b);
+      item.hasBlock = b.timestamp >= timestamp;
 
-      if (b.timestamp >= timestamp) {
-        // query transactions
-        std::list<Transaction> txs;
+      if (item.hasBlock) {
         std::list<crypto::hash> missedTxs;
-        lbs->get_transactions(b.txHashes, txs, missedTxs);
-
-        // fill data
-        block_complete_entry& completeEntry = item;
-        completeEntry.block = block_to_blob(b);
-        for (auto& tx : txs) {
-          completeEntry.txs.push_back(tx_to_blob(tx));
-        }
+        lbs->get_transactions(b.txHashes, item.txs, missedTxs);
+        item.block = std::move(b);
       }
 
       entries.push_back(std::move(item));
@@ -572,4 +799,104 @@ void core::blockchainUpdated() {
   return true;
 }
 
+bool core::queryBlocksFiltered(const std::list<crypto::hash>& knownBlockIds, uint64_t timestamp, const std::vector<TrackingKey>& trackingKeys,
+  const std::vector<crypto::key_image>& keyImages, uint64_t& resStartHeight, uint64_t& resCurrentHeight, uint64_t& resFullOffset,
+  std::list<BlockFullInfo>& entries) {
+  if (!queryBlocks(knownBlockIds, timestamp, resStartHeight, resCurrentHeight, resFullOffset, entries)) {
+    return false;
+  }
+
+  TrackingKeysFilter filter(trackingKeys);
+  std::unordered_set<crypto::key_image> trackedKeyImages(keyImages.begin(), keyImages.end());
+  // outputs found in this query, key images of them are unknown yet, so transactions referencing them are returned
+  std::set<std::pair<uint64_t, uint64_t>> foundKeyOutputs;
+  std::set<std::pair<uint64_t, uint64_t>> foundMultisignatureOutputs;
+
+  auto addFoundOutputs = [&](const Transaction& tx, const crypto::hash& txHash, const std::vector<size_t>& outputs) -> bool {
+    std::vector<uint64_t> globalIndexes;
+    if (!get_tx_outputs_gindexs(txHash, globalIndexes) || globalIndexes.size() != tx.vout.size()) {
+      return false;
+    }
+
+    for (size_t output : outputs) {
+      const TransactionOutput& out = tx.vout[output];
+      auto& found = out.target.type() == typeid(TransactionOutputToKey) ? foundKeyOutputs : foundMultisignatureOutputs;
+      found.insert(std::make_pair(out.amount, globalIndexes[output]));
+    }
+
+    return true;
+  };
+
+  auto spendsTrackedOutput = [&](const Transaction& tx) -> bool {
+    for (const TransactionInput& input : tx.vin) {
+      if (input.type() == typeid(TransactionInputToKey)) {
+        const TransactionInputToKey& in = boost::get<TransactionInputToKey>(input);
+        if (trackedKeyImages.count(in.keyImage) != 0) {
+          return true;
+        }
+
+        if (!foundKeyOutputs.empty()) {
+          for (uint64_t index : relative_output_offsets_to_absolute(in.keyOffsets)) {
+            if (foundKeyOutputs.count(std::make_pair(in.amount, index)) != 0) {
+              return true;
+            }
+          }
+        }
+      } else if (input.type() == typeid(TransactionInputMultisignature)) {
+        const TransactionInputMultisignature& in = boost::get<TransactionInputMultisignature>(input);
+        if (foundMultisignatureOutputs.count(std::make_pair(in.amount, in.outputIndex)) != 0) {
+          return true;
+        }
+      }
+    }
+
+    return false;
+  };
+
+  for (BlockFullInfo& entry : entries) {
+    if (entry.block.empty()) {
+      continue;
+    }
+
+    Block block;
+    if (!parse_and_validate_block_from_blob(entry.block, block)) {
+      return false;
+    }
+
+    // block blob carries the coinbase transaction anyway, its outputs are still needed to find their spends
+    std::vector<size_t> outputs;
+    if (filter.findOutputs(block.minerTx, outputs) && !addFoundOutputs(block.minerTx, get_transaction_hash(block.minerTx), outputs)) {
+      return false;
+    }
+
+    std::list<blobdata> matchingTxs;
+    for (blobdata& txBlob : entry.txs) {
+      Transaction tx;
+      crypto::hash txHash;
+      crypto::hash txPrefixHash;
+      if (!parse_and_validate_tx_from_blob(txBlob, tx, txHash, txPrefixHash)) {
+        return false;
+      }
+
+      outputs.clear();
+      bool matches = spendsTrackedOutput(tx);
+      if (filter.findOutputs(tx, outputs)) {
+        if (!addFoundOutputs(tx, txHash, outputs)) {
+          return false;
+        }
+
+        matches = true;
+      }
+
+      if (matches) {
+        matchingTxs.push_back(std::move(txBlob));
+      }
+    }
+
+    entry.txs.swap(matchingTxs);
+  }
+
+  return true;
+}
+
 }
@@ -27,12 +27,19 @@
 #include "blockchain_storage.h"
 #include "cryptonote_core/i_miner_handler.h"
 #include "cryptonote_core/MinerConfig.h"
+#include "cryptonote_core/OnceInInterval.h"
+#include "cryptonote_core/TransactionAdmissionCache.h"
 #include "crypto/hash.h"
 #include "ICore.h"
 #include "ICoreObserver.h"
+#include "Common/MemoryBudget.h"
 #include "Common/ObserverManager.h"
 #include <Logging/LoggerMessage.h>
 
+namespace Common {
+class MetricHistogram;
+}
+
 namespace CryptoNote {
 
   struct core_stat_info;
@@ -45,8 +52,11 @@ namespace CryptoNote {
      ~core();
 
      bool on_idle();
-     virtual bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block);
-     bool handle_incoming_block_blob(const blobdata& block_blob, block_verification_context& bvc, bool control_miner, bool relay_block);
+     virtual bool handle_incoming_tx(Common::StringView tx_blob, tx_verification_context& tvc, bool keeped_by_block);
+     virtual void handle_incoming_txs(const std::vector<Common::StringView>& tx_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block) override;
+     bool handle_incoming_block_blob(Common::StringView block_blob, block_verification_context& bvc, bool control_miner, bool relay_block);
+     virtual void prepare_incoming_blocks(const std::vector<Block>& blocks);
+     virtual bool check_block_headers(const std::vector<Block>& headers, bool& checked, bool& heavier) override;
      virtual i_cryptonote_protocol* get_protocol(){return m_pprotocol;}
      const Currency& currency() const { return m_currency; }
 
@@ -62,6 +72,9 @@ namespace CryptoNote {
      bool init(const CoreConfig& config, const MinerConfig& minerConfig, bool load_existing);
      bool set_genesis_block(const Block& b);
      bool deinit();
+     // Set if the blockchain follows the blocks of another node read-only, no blocks or transactions are accepted then
+     bool is_replica() { return m_blockchain_storage.is_replica(); }
+     bool refresh_replica() { return m_blockchain_storage.refreshReplica(); }
 
      // ICore
      virtual bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp) override;
@@ -82,12 +95,19 @@ namespace CryptoNote {
      }
      virtual bool queryBlocks(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
          uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<BlockFullInfo>& entries);
+     virtual bool queryBlocksParsed(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
+         uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<BlockParsedInfo>& entries) override;
+     virtual bool queryBlocksFiltered(const std::list<crypto::hash>& block_ids, uint64_t timestamp, const std::vector<TrackingKey>& tracking_keys,
+         const std::vector<crypto::key_image>& key_images, uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset,
+         std::list<BlockFullInfo>& entries);
      crypto::hash get_block_id_by_height(uint64_t height);
      void get_transactions(const std::vector<crypto::hash>& txs_ids, std::list<Transaction>& txs, std::list<crypto::hash>& missed_txs);
      bool get_block_by_hash(const crypto::hash &h, Block &blk);
      //void get_all_known_block_ids(std::list<crypto::hash> &main, std::list<crypto::hash> &alt, std::list<crypto::hash> &invalid);
 
      virtual bool getBlockByHash(const crypto::hash &h, Block &blk) override;
+     virtual bool havePoolTransaction(const crypto::hash& id) override;
+     virtual void getPoolTransactions(const std::list<crypto::hash>& ids, std::list<Transaction>& txs, std::list<crypto::hash>& missedIds) override;
 
      bool get_alternative_blocks(std::list<Block>& blocks);
      size_t get_alternative_blocks_count();
@@ -98,9 +118,12 @@ namespace CryptoNote {
      void get_pool_transactions(std::list<Transaction>& txs);
      size_t get_pool_transactions_count();
      size_t get_blockchain_total_transactions();
+     bool set_blocks_cache_size(size_t cacheSize, uint64_t memoryBudget = 0);
+     SwappedVectorCacheStatistics get_blocks_cache_statistics();
      //bool get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys);
      virtual bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY_request& resp);
      virtual bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<Block, std::list<Transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<block_complete_entry>& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
      bool get_stat_info(core_stat_info& st_inf);
      //bool get_backward_blocks_sizes(uint64_t from_height, std::vector<size_t>& sizes, size_t count);
      virtual bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs);
@@ -109,19 +132,22 @@ namespace CryptoNote {
      void pause_mining();
      void update_block_template_and_resume_mining();
      blockchain_storage& get_blockchain_storage(){return m_blockchain_storage;}
+     Common::MemoryBudget& get_memory_budget() { return m_memoryBudget; }
      //debug functions
      void print_blockchain(uint64_t start_index, uint64_t end_index);
      void print_blockchain_index();
      std::string print_pool(bool short_format);
      void print_blockchain_outs(const std::string& file);
      virtual bool getPoolSymmetricDifference(const std::vector<crypto::hash>& known_pool_tx_ids, const crypto::hash& known_block_id, bool& isBcActual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids) override;
+     virtual bool getPoolChanges(uint64_t known_version, const crypto::hash& known_block_id, bool& isBcActual, bool& isVersionActual, std::vector<Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version) override;
 
    private:
      bool add_new_tx(const Transaction& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prefix_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block);
      bool add_new_tx(const Transaction& tx, tx_verification_context& tvc, bool keeped_by_block);
      bool load_state_data();
-     bool parse_tx_from_blob(Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash, const blobdata& blob);
+     bool parse_tx_from_blob(Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash, Common::StringView blob);
      bool handle_incoming_block(const Block& b, block_verification_context& bvc, bool control_miner, bool relay_block);
+     bool handle_incoming_tx_blob(Common::StringView tx_blob, tx_verification_context& tvc, bool keeped_by_block, crypto::hash& tx_hash);
 
      bool check_tx_syntax(const Transaction& tx);
      //check correct values, amounts and all lightweight checks not related with database
@@ -138,7 +164,10 @@ namespace CryptoNote {
      bool check_tx_inputs_keyimages_diff(const Transaction& tx);
      virtual void blockchainUpdated() override;
      virtual void txDeletedFromPool() override;
+     virtual void txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) override;
      void poolUpdated();
+     bool getCachedBlockTemplate(Block& b, const AccountPublicAddress& adr, difficulty_type& diffic, uint32_t& height, const blobdata& ex_nonce);
+     void cacheBlockTemplate(const Block& b, const AccountPublicAddress& adr, difficulty_type diffic, uint32_t height, const blobdata& ex_nonce, uint64_t version);
 
      const Currency& m_currency;
      Logging::LoggerRef logger;
@@ -153,5 +182,35 @@ namespace CryptoNote {
      friend class tx_validate_inputs;
      std::atomic<bool> m_starter_message_showed;
      tools::ObserverManager<ICoreObserver> m_observerManager;
+     // Blocks cache and pool are shrunk to fit the budget on idle
+     Common::MemoryBudget m_memoryBudget;
+     OnceInInterval m_memoryBudgetInterval;
+
+     // Last block template, reused while neither blockchain tail nor pool change. Version is bumped by
+     // notifications without taking the lock, since they come from threads holding pool or blockchain lock.
+     struct BlockTemplateCache {
+       bool valid;
+       uint64_t version;
+       Block block;
+       AccountPublicAddress address;
+       size_t extraNonceSize;
+       difficulty_type difficulty;
+       uint32_t height;
+     };
+
+     std::mutex m_blockTemplateLock;
+     BlockTemplateCache m_blockTemplate;
+     std::atomic<uint64_t> m_blockTemplateVersion;
+
+     // Recently handled transaction blobs, accessed under m_incoming_tx_lock. Rejections are dropped when blockchain
+     // or pool changes, which is signalled by version to keep notifications lock free.
+     TransactionAdmissionCache m_admissionCache;
+     uint64_t m_admissionCacheVersion;
+     std::atomic<uint64_t> m_rejectedTransactionsVersion;
+     // Transactions of one batch are admitted in parallel, calling thread takes part
+     std::unique_ptr<Common::ThreadPool> m_transactionsPool;
+
+     Common::MetricHistogram& m_parseBlockStage;
+     Common::MetricHistogram& m_handleBlockStage;
    };
 }
@@ -17,6 +17,9 @@
 
 #include "cryptonote_format_utils.h"
 #include <set>
+#include <functional>
+#include "Common/MemoryStreambuf.h"
+#include "Common/ThreadPool.h"
 #include "../Logging/LoggerRef.h"
 #include "account.h"
 #include "cryptonote_basic_impl.h"
@@ -39,17 +42,27 @@ crypto::hash get_transaction_prefix_hash(const TransactionPrefix& tx) {
   return h;
 }
 
-bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, Transaction& tx) {
-  std::stringstream ss;
-  ss << tx_blob;
-  binary_archive<false> ba(ss);
+bool parse_and_validate_tx_from_blob(Common::StringView tx_blob, Transaction& tx) {
+  Common::MemoryStreambuf buffer(tx_blob.getData(), tx_blob.getSize());
+  std::istream stream(&buffer);
+  binary_archive<false> ba(stream);
   return ::serialization::serialize(ba, tx);
 }
 
-bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash) {
-  std::stringstream ss;
-  ss << tx_blob;
-  binary_archive<false> ba(ss);
+// signatures are stored after the prefix without any framing
+size_t get_signatures_size(const Transaction& tx) {
+  size_t size = 0;
+  for (const auto& signatures : tx.signatures) {
+    size += signatures.size() * sizeof(crypto::signature);
+  }
+
+  return size;
+}
+
+bool parse_and_validate_tx_from_blob(Common::StringView tx_blob, Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash) {
+  Common::MemoryStreambuf buffer(tx_blob.getData(), tx_blob.getSize());
+  std::istream stream(&buffer);
+  binary_archive<false> ba(stream);
   bool r = ::serialization::serialize(ba, tx);
 
   if (!r) {
@@ -57,8 +70,16 @@ bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, Transaction& tx, c
   }
 
   //TODO: validate tx
-  crypto::cn_fast_hash(tx_blob.data(), tx_blob.size(), tx_hash);
-  get_transaction_prefix_hash(tx, tx_prefix_hash);
+  crypto::cn_fast_hash(tx_blob.getData(), tx_blob.getSize(), tx_hash);
+
+  // the whole blob has been read, its head is the prefix as long as it is encoded the way it is serialized
+  size_t signaturesSize = get_signatures_size(tx);
+  if (ba.canonical_varints() && signaturesSize <= tx_blob.getSize()) {
+    crypto::cn_fast_hash(tx_blob.getData(), tx_blob.getSize() - signaturesSize, tx_prefix_hash);
+  } else {
+    get_transaction_prefix_hash(tx, tx_prefix_hash);
+  }
+
   return true;
 }
 
@@ -156,15 +177,134 @@ bool parse_tx_extra(const std::vector<uint8_t>& tx_extra, std::vector<tx_extra_f
   return true;
 }
 
-crypto::public_key get_tx_pub_key_from_extra(const std::vector<uint8_t>& tx_extra) {
-  std::vector<tx_extra_field> tx_extra_fields;
-  parse_tx_extra(tx_extra, tx_extra_fields);
+TransactionExtraIndex::TransactionExtraIndex(const std::vector<uint8_t>& tx_extra) : m_valid(true) {
+  m_publicKey.data = nullptr;
+  m_nonce.data = nullptr;
+  m_mergeMiningTag.data = nullptr;
+
+  const uint8_t* position = tx_extra.data();
+  const uint8_t* end = position + tx_extra.size();
+  while (position != end) {
+    if (!readField(position, end)) {
+      m_valid = false;
+      break;
+    }
+  }
+}
+
+// mirrors do_serialize of tx_extra_field on binary_archive, varints are taken as leniently as the archive does
+bool TransactionExtraIndex::readField(const uint8_t*& position, const uint8_t* end) {
+  uint8_t tag = *position++;
+  if (tag == TX_EXTRA_TAG_PADDING) {
+    size_t size;
+    for (size = 1; size <= TX_EXTRA_PADDING_MAX_COUNT && position != end; ++size) {
+      if (*position++ != 0) {
+        return false;
+      }
+    }
 
-  tx_extra_pub_key pub_key_field;
-  if (!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field))
+    return size <= TX_EXTRA_PADDING_MAX_COUNT;
+  }
+
+  if (tag == TX_EXTRA_TAG_PUBKEY) {
+    if (static_cast<size_t>(end - position) < sizeof(crypto::public_key)) {
+      return false;
+    }
+
+    if (m_publicKey.data == nullptr) {
+      m_publicKey.data = position;
+      m_publicKey.size = sizeof(crypto::public_key);
+    }
+
+    position += sizeof(crypto::public_key);
+    return true;
+  }
+
+  if (tag != TX_EXTRA_NONCE && tag != TX_EXTRA_MERGE_MINING_TAG) {
+    return false;
+  }
+
+  size_t size = 0;
+  tools::read_varint<std::numeric_limits<size_t>::digits>(position, end, size);
+  if (static_cast<size_t>(end - position) < size) {
+    return false;
+  }
+
+  Field field = { position, size };
+  position += size;
+  if (tag == TX_EXTRA_NONCE) {
+    if (size > TX_EXTRA_NONCE_MAX_COUNT) {
+      return false;
+    }
+
+    if (m_nonce.data == nullptr) {
+      m_nonce = field;
+    }
+
+    return true;
+  }
+
+  // merge mining tag is a varint depth and a merkle root, nothing else
+  const uint8_t* fieldPosition = field.data;
+  const uint8_t* fieldEnd = field.data + field.size;
+  size_t depth;
+  tools::read_varint<std::numeric_limits<size_t>::digits>(fieldPosition, fieldEnd, depth);
+  if (static_cast<size_t>(fieldEnd - fieldPosition) != sizeof(crypto::hash)) {
+    return false;
+  }
+
+  if (m_mergeMiningTag.data == nullptr) {
+    m_mergeMiningTag = field;
+  }
+
+  return true;
+}
+
+bool TransactionExtraIndex::getPublicKey(crypto::public_key& pub_key) const {
+  if (m_publicKey.data == nullptr) {
+    return false;
+  }
+
+  memcpy(&pub_key, m_publicKey.data, sizeof(pub_key));
+  return true;
+}
+
+bool TransactionExtraIndex::getNonce(blobdata& nonce) const {
+  if (m_nonce.data == nullptr) {
+    return false;
+  }
+
+  nonce.assign(reinterpret_cast<const char*>(m_nonce.data), m_nonce.size);
+  return true;
+}
+
+bool TransactionExtraIndex::getPaymentId(crypto::hash& payment_id) const {
+  if (m_nonce.data == nullptr || m_nonce.size != sizeof(crypto::hash) + 1 || m_nonce.data[0] != TX_EXTRA_NONCE_PAYMENT_ID) {
+    return false;
+  }
+
+  memcpy(&payment_id, m_nonce.data + 1, sizeof(payment_id));
+  return true;
+}
+
+bool TransactionExtraIndex::getMergeMiningTag(tx_extra_merge_mining_tag& mm_tag) const {
+  if (m_mergeMiningTag.data == nullptr) {
+    return false;
+  }
+
+  const uint8_t* position = m_mergeMiningTag.data;
+  const uint8_t* end = m_mergeMiningTag.data + m_mergeMiningTag.size;
+  tools::read_varint<std::numeric_limits<size_t>::digits>(position, end, mm_tag.depth);
+  memcpy(&mm_tag.merkle_root, position, sizeof(mm_tag.merkle_root));
+  return true;
+}
+
+crypto::public_key get_tx_pub_key_from_extra(const std::vector<uint8_t>& tx_extra) {
+  crypto::public_key pub_key;
+  if (!TransactionExtraIndex(tx_extra).getPublicKey(pub_key))
     return null_pkey;
 
-  return pub_key_field.pub_key;
+  return pub_key;
 }
 
 crypto::public_key get_tx_pub_key_from_extra(const Transaction& tx) {
@@ -208,10 +348,7 @@ bool append_mm_tag_to_extra(std::vector<uint8_t>& tx_extra, const tx_extra_merge
 }
 
 bool get_mm_tag_from_extra(const std::vector<uint8_t>& tx_extra, tx_extra_merge_mining_tag& mm_tag) {
-  std::vector<tx_extra_field> tx_extra_fields;
-  parse_tx_extra(tx_extra, tx_extra_fields);
-
-  return find_tx_extra_field_by_type(tx_extra_fields, mm_tag);
+  return TransactionExtraIndex(tx_extra).getMergeMiningTag(mm_tag);
 }
 
 void set_payment_id_to_tx_extra_nonce(blobdata& extra_nonce, const crypto::hash& payment_id) {
@@ -252,21 +389,8 @@ bool createTxExtraWithPaymentId(const std::string& paymentIdString, std::vector<
 }
 
 bool getPaymentIdFromTxExtra(const std::vector<uint8_t>& extra, crypto::hash& paymentId) {
-  std::vector<tx_extra_field> tx_extra_fields;
-  if (!parse_tx_extra(extra, tx_extra_fields)) {
-    return false;
-  }
-
-  tx_extra_nonce extra_nonce;
-  if (find_tx_extra_field_by_type(tx_extra_fields, extra_nonce)) {
-    if (!get_payment_id_from_tx_extra_nonce(extra_nonce.nonce, paymentId)) {
-      return false;
-    }
-  } else {
-    return false;
-  }
-
-  return true;
+  TransactionExtraIndex index(extra);
+  return index.valid() && index.getPaymentId(paymentId);
 }
 
 bool construct_tx(
@@ -276,9 +400,21 @@ bool construct_tx(
   std::vector<uint8_t> extra,
   Transaction& tx,
   uint64_t unlock_time,
-  Logging::ILogger& log) {
+  Logging::ILogger& log,
+  Common::ThreadPool* signingPool) {
   LoggerRef logger(log, "construct_tx");
 
+  // each input is handled separately, nothing is logged from the body
+  auto forEachSource = [&](const std::function<void(size_t)>& body) {
+    if (signingPool != nullptr) {
+      signingPool->parallelFor(sources.size(), body);
+    } else {
+      for (size_t i = 0; i < sources.size(); ++i) {
+        body(i);
+      }
+    }
+  };
+
   tx.vin.clear();
   tx.vout.clear();
   tx.signatures.clear();
@@ -292,25 +428,37 @@ bool construct_tx(
 
   struct input_generation_context_data {
     KeyPair in_ephemeral;
+    crypto::key_image img;
+    bool generated;
   };
 
-  std::vector<input_generation_context_data> in_contexts;
-  uint64_t summary_inputs_money = 0;
-  //fill inputs
   for (const tx_source_entry& src_entr : sources) {
     if (src_entr.real_output >= src_entr.outputs.size()) {
       logger(ERROR) << "real_output index (" << src_entr.real_output << ")bigger than output_keys.size()=" << src_entr.outputs.size();
       return false;
     }
+  }
+
+  std::vector<input_generation_context_data> in_contexts(sources.size());
+  forEachSource([&](size_t i) {
+    input_generation_context_data& context = in_contexts[i];
+    context.generated = generate_key_image_helper(sender_account_keys, sources[i].real_out_tx_key, sources[i].real_output_in_tx_index,
+      context.in_ephemeral, context.img);
+  });
+
+  uint64_t summary_inputs_money = 0;
+  //fill inputs
+  for (size_t i = 0; i < sources.size(); ++i) {
+    const tx_source_entry& src_entr = sources[i];
     summary_inputs_money += src_entr.amount;
 
     //key_derivation recv_derivation;
-    in_contexts.push_back(input_generation_context_data());
-    KeyPair& in_ephemeral = in_contexts.back().in_ephemeral;
-    crypto::key_image img;
-    if (!generate_key_image_helper(sender_account_keys, src_entr.real_out_tx_key, src_entr.real_output_in_tx_index, in_ephemeral, img))
+    if (!in_contexts[i].generated)
       return false;
 
+    KeyPair& in_ephemeral = in_contexts[i].in_ephemeral;
+    const crypto::key_image& img = in_contexts[i].img;
+
     //check that derivated key is equal with real output key
     if (!(in_ephemeral.pub == src_entr.outputs[src_entr.real_output].second)) {
       logger(ERROR) << "derived public key missmatch with output public key! " << ENDL << "derived_key:"
@@ -387,20 +535,19 @@ bool construct_tx(
   crypto::hash tx_prefix_hash;
   get_transaction_prefix_hash(tx, tx_prefix_hash);
 
-  size_t i = 0;
-  for (const tx_source_entry& src_entr : sources) {
+  tx.signatures.resize(sources.size());
+  forEachSource([&](size_t i) {
+    const tx_source_entry& src_entr = sources[i];
     std::vector<const crypto::public_key*> keys_ptrs;
     for (const tx_source_entry::output_entry& o : src_entr.outputs) {
       keys_ptrs.push_back(&o.second);
     }
 
-    tx.signatures.push_back(std::vector<crypto::signature>());
-    std::vector<crypto::signature>& sigs = tx.signatures.back();
+    std::vector<crypto::signature>& sigs = tx.signatures[i];
     sigs.resize(src_entr.outputs.size());
     crypto::generate_ring_signature(tx_prefix_hash, boost::get<TransactionInputToKey>(tx.vin[i]).keyImage, keys_ptrs,
       in_contexts[i].in_ephemeral.sec, src_entr.real_output, sigs.data());
-    i++;
-  }
+  });
 
   return true;
 }
@@ -597,11 +744,11 @@ bool lookup_acc_outs(const account_keys& acc, const Transaction& tx, const crypt
   return true;
 }
 
-void get_blob_hash(const blobdata& blob, crypto::hash& res) {
-  cn_fast_hash(blob.data(), blob.size(), res);
+void get_blob_hash(Common::StringView blob, crypto::hash& res) {
+  cn_fast_hash(blob.getData(), blob.getSize(), res);
 }
 
-crypto::hash get_blob_hash(const blobdata& blob) {
+crypto::hash get_blob_hash(Common::StringView blob) {
   crypto::hash h = null_hash;
   get_blob_hash(blob, h);
   return h;
@@ -623,6 +770,23 @@ bool get_transaction_hash(const Transaction& t, crypto::hash& res, size_t& blob_
   return get_object_hash(t, res, blob_size);
 }
 
+bool get_transaction_hashes(const Transaction& t, crypto::hash& res, crypto::hash& prefix_hash, size_t& blob_size) {
+  blobdata blob;
+  if (!t_serializable_object_to_blob(t, blob)) {
+    return false;
+  }
+
+  size_t signaturesSize = get_signatures_size(t);
+  if (signaturesSize > blob.size()) {
+    return false;
+  }
+
+  get_blob_hash(blob, res);
+  crypto::cn_fast_hash(blob.data(), blob.size() - signaturesSize, prefix_hash);
+  blob_size = blob.size();
+  return true;
+}
+
 bool get_block_hashing_blob(const Block& b, blobdata& blob) {
   if (!t_serializable_object_to_blob(static_cast<const BlockHeader&>(b), blob)) {
     return false;
@@ -672,17 +836,44 @@ bool get_aux_block_header_hash(const Block& b, crypto::hash& res) {
   return get_object_hash(blob, res);
 }
 
-bool get_block_longhash(crypto::cn_context &context, const Block& b, crypto::hash& res) {
-  blobdata bd;
+bool get_block_longhash_blob(const Block& b, blobdata& blob) {
   if (b.majorVersion == BLOCK_MAJOR_VERSION_1) {
-    if (!get_block_hashing_blob(b, bd)) {
-      return false;
-    }
+    return get_block_hashing_blob(b, blob);
   } else if (b.majorVersion == BLOCK_MAJOR_VERSION_2) {
-    if (!get_parent_block_hashing_blob(b, bd)) {
-      return false;
-    }
-  } else {
+    return get_parent_block_hashing_blob(b, blob);
+  }
+
+  return false;
+}
+
+bool get_block_longhash_blob(const Block& b, blobdata& blob, size_t& nonceOffset) {
+  if (!get_block_longhash_blob(b, blob)) {
+    return false;
+  }
+
+  // Both the block header and the parent block start with major and minor versions, timestamp, previous id and nonce
+  const uint8_t majorVersion = b.majorVersion == BLOCK_MAJOR_VERSION_1 ? b.majorVersion : b.parentBlock.majorVersion;
+  const uint8_t minorVersion = b.majorVersion == BLOCK_MAJOR_VERSION_1 ? b.minorVersion : b.parentBlock.minorVersion;
+  nonceOffset = tools::get_varint_data(majorVersion).size() + tools::get_varint_data(minorVersion).size() +
+    tools::get_varint_data(b.timestamp).size() + sizeof(crypto::hash);
+  if (nonceOffset + sizeof(uint32_t) > blob.size()) {
+    return false;
+  }
+
+  blobdata expected = blob;
+  set_block_longhash_blob_nonce(expected, nonceOffset, b.nonce);
+  return expected == blob;
+}
+
+void set_block_longhash_blob_nonce(blobdata& blob, size_t nonceOffset, uint32_t nonce) {
+  for (size_t i = 0; i < sizeof(nonce); ++i) {
+    blob[nonceOffset + i] = static_cast<char>(nonce >> (8 * i));
+  }
+}
+
+bool get_block_longhash(crypto::cn_context &context, const Block& b, crypto::hash& res) {
+  blobdata bd;
+  if (!get_block_longhash_blob(b, bd)) {
     return false;
   }
   crypto::cn_slow_hash(context, bd.data(), bd.size(), res);
@@ -707,10 +898,10 @@ std::vector<uint64_t> absolute_output_offsets_to_relative(const std::vector<uint
   return res;
 }
 
-bool parse_and_validate_block_from_blob(const blobdata& b_blob, Block& b) {
-  std::stringstream ss;
-  ss << b_blob;
-  binary_archive<false> ba(ss);
+bool parse_and_validate_block_from_blob(Common::StringView b_blob, Block& b) {
+  Common::MemoryStreambuf buffer(b_blob.getData(), b_blob.getSize());
+  std::istream stream(&buffer);
+  binary_archive<false> ba(stream);
   return ::serialization::serialize(ba, b);
 }
 
@@ -18,8 +18,13 @@
 #pragma once
 
 #include "../cryptonote_protocol/blobdatatype.h"
+#include "Common/StringView.h"
 #include "cryptonote_basic.h"
 
+namespace Common {
+class ThreadPool;
+}
+
 namespace Logging {
 class ILogger;
 }
@@ -28,8 +33,11 @@ namespace CryptoNote {
 
 void get_transaction_prefix_hash(const TransactionPrefix& tx, crypto::hash& h);
 crypto::hash get_transaction_prefix_hash(const TransactionPrefix& tx);
-bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash);
-bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, Transaction& tx);
+size_t get_signatures_size(const Transaction& tx);
+// hashes are taken from the blob itself, blob size is the size of tx_blob
+// blobs are taken by view, so they are parsed and hashed in place in network and storage buffers
+bool parse_and_validate_tx_from_blob(Common::StringView tx_blob, Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash);
+bool parse_and_validate_tx_from_blob(Common::StringView tx_blob, Transaction& tx);
 
 struct tx_source_entry {
   typedef std::pair<uint64_t, crypto::public_key> output_entry;
@@ -50,11 +58,13 @@ struct tx_destination_entry {
 };
 
 
+// Key images and ring signatures of inputs are computed on signingPool if it is given, signatures keep the order of inputs
 bool construct_tx(
   const account_keys& sender_account_keys,
   const std::vector<tx_source_entry>& sources,
   const std::vector<tx_destination_entry>& destinations,
-  std::vector<uint8_t> extra, Transaction& tx, uint64_t unlock_time, Logging::ILogger& log);
+  std::vector<uint8_t> extra, Transaction& tx, uint64_t unlock_time, Logging::ILogger& log,
+  Common::ThreadPool* signingPool = nullptr);
 
 template<typename T>
 bool find_tx_extra_field_by_type(const std::vector<tx_extra_field>& tx_extra_fields, T& field) {
@@ -69,6 +79,35 @@ bool find_tx_extra_field_by_type(const std::vector<tx_extra_field>& tx_extra_fie
 }
 
 bool parse_tx_extra(const std::vector<uint8_t>& tx_extra, std::vector<tx_extra_field>& tx_extra_fields);
+
+// Reads tx extra in one pass the way parse_tx_extra does, but only records where the first field of each type is,
+// so lookups don't copy the extra or build tx_extra_field variants. Extra must outlive the index.
+class TransactionExtraIndex {
+public:
+  explicit TransactionExtraIndex(const std::vector<uint8_t>& tx_extra);
+
+  // false if parse_tx_extra would fail, fields read before the error are still served
+  bool valid() const { return m_valid; }
+
+  bool getPublicKey(crypto::public_key& pub_key) const;
+  bool getNonce(blobdata& nonce) const;
+  bool getPaymentId(crypto::hash& payment_id) const;
+  bool getMergeMiningTag(tx_extra_merge_mining_tag& mm_tag) const;
+
+private:
+  struct Field {
+    const uint8_t* data;
+    size_t size;
+  };
+
+  bool readField(const uint8_t*& position, const uint8_t* end);
+
+  Field m_publicKey;
+  Field m_nonce;
+  Field m_mergeMiningTag;
+  bool m_valid;
+};
+
 crypto::public_key get_tx_pub_key_from_extra(const std::vector<uint8_t>& tx_extra);
 crypto::public_key get_tx_pub_key_from_extra(const Transaction& tx);
 bool add_tx_pub_key_to_extra(Transaction& tx, const crypto::public_key& tx_pub_key);
@@ -84,8 +123,8 @@ bool lookup_acc_outs(const account_keys& acc, const Transaction& tx, std::vector
 bool get_tx_fee(const Transaction& tx, uint64_t & fee);
 uint64_t get_tx_fee(const Transaction& tx);
 bool generate_key_image_helper(const account_keys& ack, const crypto::public_key& tx_public_key, size_t real_output_index, KeyPair& in_ephemeral, crypto::key_image& ki);
-void get_blob_hash(const blobdata& blob, crypto::hash& res);
-crypto::hash get_blob_hash(const blobdata& blob);
+void get_blob_hash(Common::StringView blob, crypto::hash& res);
+crypto::hash get_blob_hash(Common::StringView blob);
 std::string short_hash_str(const crypto::hash& h);
 bool createTxExtraWithPaymentId(const std::string& paymentIdString, std::vector<uint8_t>& extra);
 //returns false if payment id is not found or parse error
@@ -95,13 +134,20 @@ bool parsePaymentId(const std::string& paymentIdString, crypto::hash& paymentId)
 crypto::hash get_transaction_hash(const Transaction& t);
 bool get_transaction_hash(const Transaction& t, crypto::hash& res);
 bool get_transaction_hash(const Transaction& t, crypto::hash& res, size_t& blob_size);
+// serializes the transaction once for both hashes and the blob size
+bool get_transaction_hashes(const Transaction& t, crypto::hash& res, crypto::hash& prefix_hash, size_t& blob_size);
 bool get_block_hashing_blob(const Block& b, blobdata& blob);
 bool get_parent_block_hashing_blob(const Block& b, blobdata& blob);
 bool get_aux_block_header_hash(const Block& b, crypto::hash& res);
 bool get_block_hash(const Block& b, crypto::hash& res);
 crypto::hash get_block_hash(const Block& b);
 bool get_block_longhash(crypto::cn_context &context, const Block& b, crypto::hash& res);
-bool parse_and_validate_block_from_blob(const blobdata& b_blob, Block& b);
+// Blob which is hashed with cn_slow_hash to get block long hash
+bool get_block_longhash_blob(const Block& b, blobdata& blob);
+// Same blob with position of the nonce in it, so a miner builds it once per template and only patches the nonce
+bool get_block_longhash_blob(const Block& b, blobdata& blob, size_t& nonceOffset);
+void set_block_longhash_blob_nonce(blobdata& blob, size_t nonceOffset, uint32_t nonce);
+bool parse_and_validate_block_from_blob(Common::StringView b_blob, Block& b);
 bool get_inputs_money_amount(const Transaction& tx, uint64_t& money);
 uint64_t get_outs_money_amount(const Transaction& tx);
 bool check_inputs_types_supported(const Transaction& tx);
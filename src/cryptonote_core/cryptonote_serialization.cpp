@@ -223,8 +223,9 @@ void serialize(Transaction& tx, const std::string& name, ISerializer& serializer
       tx.signatures[i].resize(signatureSize);
     }
 
-    for (crypto::signature& sig: tx.signatures[i]) {
-      serializePod(sig, "", serializer);
+    // signatures of an input are contiguous, binary serializers store them back to back anyway
+    if (signatureSize != 0) {
+      serializer.binary(tx.signatures[i].data(), signatureSize * sizeof(crypto::signature), "");
     }
   }
 //  serializer.endArray();
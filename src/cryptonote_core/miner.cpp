@@ -18,6 +18,7 @@
 #include "miner.h"
 
 #include <future>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <thread>
@@ -30,6 +31,7 @@
 
 #include "cryptonote_format_utils.h"
 #include "Common/command_line.h"
+#include "Common/ThreadTopology.h"
 
 // epee
 #include "storages/portable_storage_template_helper.h"
@@ -43,15 +45,12 @@ namespace CryptoNote
     m_currency(currency),
     logger(log, "miner"),
     m_stop(true),
-    m_template(boost::value_initialized<Block>()),
     m_template_no(0),
-    m_diffic(0),
     m_handler(handler),
     m_pausers_count(0),
     m_threads_total(0),
-    m_starter_nonce(0),
+    m_lanes(1),
     m_last_hr_merge_time(0),
-    m_hashes(0),
     m_do_print_hashrate(false),
     m_do_mining(false),
     m_current_hash_rate(0),
@@ -65,26 +64,28 @@ namespace CryptoNote
   }
   //-----------------------------------------------------------------------------------------------------
   bool miner::set_block_template(const Block& bl, const difficulty_type& di) {
-    std::lock_guard<decltype(m_template_lock)> lk(m_template_lock);
-
-    m_template = bl;
+    std::shared_ptr<BlockTemplate> blockTemplate = std::make_shared<BlockTemplate>();
+    blockTemplate->block = bl;
 
-    if (BLOCK_MAJOR_VERSION_2 == m_template.majorVersion) {
+    if (BLOCK_MAJOR_VERSION_2 == blockTemplate->block.majorVersion) {
       CryptoNote::tx_extra_merge_mining_tag mm_tag;
       mm_tag.depth = 0;
-      if (!CryptoNote::get_aux_block_header_hash(m_template, mm_tag.merkle_root)) {
+      if (!CryptoNote::get_aux_block_header_hash(blockTemplate->block, mm_tag.merkle_root)) {
         return false;
       }
 
-      m_template.parentBlock.minerTx.extra.clear();
-      if (!CryptoNote::append_mm_tag_to_extra(m_template.parentBlock.minerTx.extra, mm_tag)) {
+      blockTemplate->block.parentBlock.minerTx.extra.clear();
+      if (!CryptoNote::append_mm_tag_to_extra(blockTemplate->block.parentBlock.minerTx.extra, mm_tag)) {
         return false;
       }
     }
 
-    m_diffic = di;
+    blockTemplate->difficulty = di;
+    blockTemplate->startNonce = crypto::rand<uint32_t>();
+
+    std::lock_guard<decltype(m_template_lock)> lk(m_template_lock);
+    std::atomic_store(&m_template, std::shared_ptr<const BlockTemplate>(std::move(blockTemplate)));
     ++m_template_no;
-    m_starter_nonce = crypto::rand<uint32_t>();
     return true;
   }
   //-----------------------------------------------------------------------------------------------------
@@ -144,8 +145,16 @@ namespace CryptoNote
   //-----------------------------------------------------------------------------------------------------
   void miner::merge_hr()
   {
+    uint64_t hashes = 0;
+    {
+      std::lock_guard<std::mutex> lk(m_threads_lock);
+      for (size_t i = 0; i < m_threads.size(); ++i) {
+        hashes += m_hash_counters[i].hashes.exchange(0, std::memory_order_relaxed);
+      }
+    }
+
     if(m_last_hr_merge_time && is_mining()) {
-      m_current_hash_rate = m_hashes * 1000 / (millisecondsSinceEpoch() - m_last_hr_merge_time + 1);
+      m_current_hash_rate = hashes * 1000 / (millisecondsSinceEpoch() - m_last_hr_merge_time + 1);
       std::lock_guard<std::mutex> lk(m_last_hash_rates_lock);
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
@@ -159,7 +168,6 @@ namespace CryptoNote
     }
     
     m_last_hr_merge_time = millisecondsSinceEpoch();
-    m_hashes = 0;
   }
 
   bool miner::init(const MinerConfig& config) {
@@ -186,6 +194,13 @@ namespace CryptoNote
       logger(INFO) << "Loaded " << m_extra_messages.size() << " extra messages, current index " << m_config.current_extra_message_index;
     }
 
+    if (config.miningLanes != 1 && config.miningLanes != 2 && config.miningLanes != crypto::CN_SLOW_HASH_MAX_LANES) {
+      logger(ERROR, BRIGHT_RED) << "Wrong mining lanes count: " << config.miningLanes << ", expected 1, 2 or 4";
+      return false;
+    }
+
+    m_lanes = config.miningLanes;
+
     if(!config.startMining.empty()) {
       if (!m_currency.parseAccountAddressString(config.startMining, m_mine_address)) {
         LOG_ERROR("Target account address " << config.startMining << " has wrong format, starting daemon canceled");
@@ -222,7 +237,10 @@ namespace CryptoNote
 
     m_mine_address = adr;
     m_threads_total = static_cast<uint32_t>(threads_count);
-    m_starter_nonce = crypto::rand<uint32_t>();
+    m_hash_counters.reset(new HashCounter[threads_count]);
+    for (size_t i = 0; i != threads_count; i++) {
+      m_hash_counters[i].hashes = 0;
+    }
 
     if (!m_template_no) {
       request_block_template(); //lets update block template
@@ -272,6 +290,13 @@ namespace CryptoNote
 
     unsigned nthreads = std::thread::hardware_concurrency();
 
+    // Hashing blob is built once, every attempt only writes the nonce into it
+    blobdata blob;
+    size_t nonceOffset;
+    if (!get_block_longhash_blob(bl, blob, nonceOffset)) {
+      return false;
+    }
+
     if (nthreads > 0 && diffic > 5) {
       std::vector<std::future<void>> threads(nthreads);
       std::atomic<uint32_t> foundNonce;
@@ -283,14 +308,11 @@ namespace CryptoNote
           crypto::cn_context localctx;
           crypto::hash h;
 
-          Block lb(bl); // copy to local block
+          blobdata localBlob(blob);
 
           for (uint32_t nonce = startNonce + i; !found; nonce += nthreads) {
-            lb.nonce = nonce;
-
-            if (!get_block_longhash(localctx, lb, h)) {
-              return;
-            }
+            set_block_longhash_blob_nonce(localBlob, nonceOffset, nonce);
+            crypto::cn_slow_hash(localctx, localBlob.data(), localBlob.size(), h);
 
             if (check_hash(h, diffic)) {
               foundNonce = nonce;
@@ -313,9 +335,8 @@ namespace CryptoNote
     } else {
       for (; bl.nonce != std::numeric_limits<uint32_t>::max(); bl.nonce++) {
         crypto::hash h;
-        if (!get_block_longhash(context, bl, h)) {
-          return false;
-        }
+        set_block_longhash_blob_nonce(blob, nonceOffset, bl.nonce);
+        crypto::cn_slow_hash(context, blob.data(), blob.size(), h);
 
         if (check_hash(h, diffic)) {
           return true;
@@ -361,10 +382,33 @@ namespace CryptoNote
   bool miner::worker_thread(uint32_t th_local_index)
   {
     logger(INFO) << "Miner thread was started ["<< th_local_index << "]";
-    uint32_t nonce = m_starter_nonce + th_local_index;
-    difficulty_type local_diff = 0;
+    if (!Common::ThreadTopology::global().applyToCurrentThread(Common::ThreadClass::MINER)) {
+      logger(WARNING) << "Miner thread [" << th_local_index << "] placement is not applied";
+    }
+
+    // Every thread searches own part of nonce space, so threads share nothing they write to
+    const uint32_t threads_total = m_threads_total;
+    const uint32_t nonce_partition = std::numeric_limits<uint32_t>::max() / threads_total;
+    HashCounter& hash_counter = m_hash_counters[th_local_index];
+    uint32_t nonce = 0;
     uint32_t local_template_ver = 0;
-    crypto::cn_context context;
+    std::shared_ptr<const BlockTemplate> local_template;
+    // Every lane hashes own nonce with own context, nonces of lanes follow each other
+    std::vector<std::unique_ptr<crypto::cn_context>> contexts;
+    crypto::cn_context* contextPointers[crypto::CN_SLOW_HASH_MAX_LANES];
+    for (uint32_t lane = 0; lane < m_lanes; ++lane) {
+      contexts.emplace_back(new crypto::cn_context());
+      contextPointers[lane] = contexts.back().get();
+    }
+
+    logger(INFO) << "Miner thread [" << th_local_index << "] scratchpads are allocated in " <<
+      (contexts.front()->uses_large_pages() ? "large pages" : "regular pages");
+
+    blobdata blobs[crypto::CN_SLOW_HASH_MAX_LANES];
+    const void* blobPointers[crypto::CN_SLOW_HASH_MAX_LANES];
+    size_t blobSizes[crypto::CN_SLOW_HASH_MAX_LANES];
+    crypto::hash hashes[crypto::CN_SLOW_HASH_MAX_LANES];
+    size_t nonceOffset = 0;
     Block b;
 
     while(!m_stop)
@@ -375,47 +419,63 @@ namespace CryptoNote
         continue;
       }
 
-      if(local_template_ver != m_template_no) {
-        std::unique_lock<std::mutex> lk(m_template_lock);
-        b = m_template;
-        local_diff = m_diffic;
-        lk.unlock();
+      uint32_t template_no = m_template_no.load(std::memory_order_acquire);
+      if(local_template_ver != template_no) {
+        local_template = std::atomic_load(&m_template);
+        local_template_ver = template_no;
+        if (local_template) {
+          b = local_template->block;
+          nonce = local_template->startNonce + th_local_index * nonce_partition;
+          // Hashing blob of a template differs between attempts only in the nonce
+          if (!get_block_longhash_blob(b, blobs[0], nonceOffset)) {
+            logger(ERROR) << "Failed to get block long hash";
+            m_stop = true;
+            break;
+          }
 
-        local_template_ver = m_template_no;
-        nonce = m_starter_nonce + th_local_index;
+          for (uint32_t lane = 0; lane < m_lanes; ++lane) {
+            blobs[lane] = blobs[0];
+            blobPointers[lane] = &blobs[lane][0];
+            blobSizes[lane] = blobs[lane].size();
+          }
+        }
       }
 
-      if(!local_template_ver)//no any set_block_template call
+      if(!local_template)//no any set_block_template call
       {
         logger(TRACE) << "Block template not set yet";
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
         continue;
       }
 
-      b.nonce = nonce;
-      crypto::hash h;
-      if (!m_stop && !get_block_longhash(context, b, h)) {
-        logger(ERROR) << "Failed to get block long hash";
-        m_stop = true;
+      for (uint32_t lane = 0; lane < m_lanes; ++lane) {
+        set_block_longhash_blob_nonce(blobs[lane], nonceOffset, nonce + lane);
       }
 
-      if (!m_stop && check_hash(h, local_diff))
-      {
-        //we lucky!
-        ++m_config.current_extra_message_index;
+      crypto::cn_slow_hash_multi(contextPointers, blobPointers, blobSizes, hashes, m_lanes);
+
+      for (uint32_t lane = 0; lane < m_lanes && !m_stop; ++lane) {
+        if (check_hash(hashes[lane], local_template->difficulty))
+        {
+          //we lucky!
+          b.nonce = nonce + lane;
+          ++m_config.current_extra_message_index;
 
-        logger(INFO, GREEN) << "Found block for difficulty: " << local_diff;
+          logger(INFO, GREEN) << "Found block for difficulty: " << local_template->difficulty;
+
+          if(!m_handler.handle_block_found(b)) {
+            --m_config.current_extra_message_index;
+          } else {
+            //success update, lets update config
+            epee::serialization::store_t_to_json_file(m_config, m_config_folder_path + "/" + CryptoNote::parameters::MINER_CONFIG_FILE_NAME);
+          }
 
-        if(!m_handler.handle_block_found(b)) {
-          --m_config.current_extra_message_index;
-        } else {
-          //success update, lets update config
-          epee::serialization::store_t_to_json_file(m_config, m_config_folder_path + "/" + CryptoNote::parameters::MINER_CONFIG_FILE_NAME);
+          break;
         }
       }
 
-      nonce += m_threads_total;
-      ++m_hashes;
+      nonce += m_lanes;
+      hash_counter.hashes.fetch_add(m_lanes, std::memory_order_relaxed);
     }
     logger(INFO) << "Miner thread stopped ["<< th_local_index << "]";
     return true;
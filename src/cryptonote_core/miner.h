@@ -18,6 +18,7 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 
 #include <boost/program_options.hpp>
 #include <boost/thread.hpp>
@@ -61,6 +62,19 @@ namespace CryptoNote {
     bool request_block_template();
     void  merge_hr();
 
+    // Published as a whole, so mining threads take a snapshot without locking
+    struct BlockTemplate {
+      Block block;
+      difficulty_type difficulty;
+      uint32_t startNonce;
+    };
+
+    // Hashes done by one thread, padded to own cache line so threads don't invalidate each other's counters
+    struct HashCounter {
+      std::atomic<uint64_t> hashes;
+      char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
     struct miner_config
     {
       uint64_t current_extra_message_index;
@@ -75,18 +89,21 @@ namespace CryptoNote {
     Logging::LoggerRef logger;
 
     std::atomic<bool> m_stop;
+    // serializes template writers only, readers use atomic_load
     std::mutex m_template_lock;
-    Block m_template;
+    std::shared_ptr<const BlockTemplate> m_template;
+    // changes after m_template is published, threads reload template when it differs from theirs
     std::atomic<uint32_t> m_template_no;
-    std::atomic<uint32_t> m_starter_nonce;
-    difficulty_type m_diffic;
 
     // volatile uint32_t m_thread_index;
     std::atomic<uint32_t> m_threads_total;
+    uint32_t m_lanes;
     std::atomic<int32_t> m_pausers_count;
     std::mutex m_miners_count_lock;
 
     std::list<boost::thread> m_threads;
+    // one per thread, guarded by m_threads_lock
+    std::unique_ptr<HashCounter[]> m_hash_counters;
     std::mutex m_threads_lock;
     i_miner_handler& m_handler;
     AccountPublicAddress m_mine_address;
@@ -99,7 +116,6 @@ namespace CryptoNote {
     miner_config m_config;
     std::string m_config_folder_path;
     std::atomic<uint64_t> m_last_hr_merge_time;
-    std::atomic<uint64_t> m_hashes;
     std::atomic<uint64_t> m_current_hash_rate;
     std::mutex m_last_hash_rates_lock;
     std::list<uint64_t> m_last_hash_rates;
@@ -18,19 +18,24 @@
 #include "tx_pool.h"
 
 #include <algorithm>
+#include <chrono>
 #include <ctime>
+#include <iterator>
+#include <limits>
 #include <vector>
 #include <unordered_set>
 
 #include <boost/filesystem.hpp>
 
-#include "Common/boost_serialization_helper.h"
 #include "Common/int-util.h"
+#include "Common/Metrics.h"
 #include "Common/util.h"
 #include "crypto/hash.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
-#include "cryptonote_core/cryptonote_boost_serialization.h"
+#include "cryptonote_core/cryptonote_serialization.h"
 #include "cryptonote_config.h"
+#include "serialization/BinarySerializationTools.h"
+#include "serialization/SerializationOverloads.h"
 
 using namespace Logging;
 
@@ -92,6 +97,9 @@ namespace CryptoNote {
 
   using CryptoNote::BlockInfo;
 
+  // Number of ready set changes kept for clients asking for changes since their version
+  const size_t READY_CHANGES_LOG_SIZE = 100000;
+
   //---------------------------------------------------------------------------------
   tx_memory_pool::tx_memory_pool(
     const CryptoNote::Currency& currency, 
@@ -103,11 +111,26 @@ namespace CryptoNote {
     m_timeProvider(timeProvider), 
     m_txCheckInterval(60, timeProvider),
     m_fee_index(boost::get<1>(m_transactions)),
+    m_ready_index(boost::get<2>(m_transactions)),
+    m_expiry_index(boost::get<3>(m_transactions)),
+    m_readyStale(true),
+    m_readyTailId(null_hash),
+    m_tailId(null_hash),
+    m_poppedHeight(std::numeric_limits<uint64_t>::max()),
+    m_readyVersion(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count())),
+    m_transactionsSize(0),
+    m_maxTransactions(0),
+    m_maxTransactionsSize(0),
+    m_memoryLimit(0),
     logger(log, "txpool") {
   }
 
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::add_tx(const Transaction &tx, /*const crypto::hash& tx_prefix_hash,*/ const crypto::hash &id, size_t blobSize, tx_verification_context& tvc, bool keptByBlock) {
+    Common::MetricTimer timer(Common::MetricsRegistry::global().histogram("tx_verification_duration_microseconds",
+      "Time to verify transactions added to the pool"));
+
     if (!check_inputs_types_supported(tx)) {
       tvc.m_verifivation_failed = true;
       return false;
@@ -140,6 +163,11 @@ namespace CryptoNote {
     //check key images for transaction if it is not kept by block
     if (!keptByBlock) {
       std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+      if (m_transactions.count(id) != 0) {
+        logger(TRACE) << "tx " << id << " is already in transaction pool";
+        return true;
+      }
+
       if (haveSpentInputs(tx)) {
         logger(INFO) << "Transaction with id= " << id << " used already spent inputs";
         tvc.m_verifivation_failed = true;
@@ -149,7 +177,7 @@ namespace CryptoNote {
 
     BlockInfo maxUsedBlock;
 
-    // check inputs
+    // check inputs, pool is not locked meanwhile so several transactions are checked at once
     bool inputsValid = m_validator.checkTransactionInputs(tx, maxUsedBlock);
 
     if (!inputsValid) {
@@ -163,8 +191,22 @@ namespace CryptoNote {
       tvc.m_verifivation_impossible = true;
     }
 
+    std::vector<crypto::hash> evictedIds;
+    {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
 
+    // the same transaction or another one spending its inputs may have been added while inputs were checked
+    if (m_transactions.count(id) != 0) {
+      logger(TRACE) << "tx " << id << " is already in transaction pool";
+      return true;
+    }
+
+    if (!keptByBlock && haveSpentInputs(tx)) {
+      logger(INFO) << "Transaction with id= " << id << " used already spent inputs";
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
     // add to pool
     {
       TransactionDetails txd;
@@ -175,12 +217,21 @@ namespace CryptoNote {
       txd.fee = fee;
       txd.keptByBlock = keptByBlock;
       txd.receiveTime = m_timeProvider.now();
+      txd.expiryTime = getExpiryTime(txd);
 
       txd.maxUsedBlock = maxUsedBlock;
       txd.lastFailedBlock.clear();
+      txd.signaturesVerified = inputsValid;
+      txd.ready = !m_readyStale && inputsValid && is_transaction_ready_to_go(tx, txd);
 
       auto txd_p = m_transactions.insert(std::move(txd));
       if (!(txd_p.second)) { logger(ERROR, BRIGHT_RED) << "transaction already exists at inserting in memory pool"; return false; }
+      m_transactionsSize += blobSize;
+      if (txd_p.first->ready) {
+        addReadyChange(id, true);
+      } else if (m_readyStale) {
+        m_readyToRecheck.insert(id);
+      }
     }
 
     tvc.m_added_to_pool = true;
@@ -194,6 +245,20 @@ namespace CryptoNote {
       return false;
 
     tvc.m_verifivation_failed = false;
+    evictTransactions(evictedIds);
+    }
+
+    if (!evictedIds.empty()) {
+      m_observerManager.notify(&ITxPoolObserver::txsEvictedFromPool, evictedIds);
+      if (std::find(evictedIds.begin(), evictedIds.end(), id) != evictedIds.end()) {
+        logger(INFO) << "Transaction " << id << " has too low fee to fit into full transaction pool";
+        tvc.m_added_to_pool = false;
+        tvc.m_should_be_relayed = false;
+        tvc.m_tx_fee_too_small = true;
+        return false;
+      }
+    }
+
     //succeed
     return true;
   }
@@ -206,6 +271,12 @@ namespace CryptoNote {
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::take_tx(const crypto::hash &id, Transaction &tx, size_t& blobSize, uint64_t& fee) {
+    BlockInfo maxUsedBlock;
+    bool signaturesVerified;
+    return take_tx(id, tx, blobSize, fee, maxUsedBlock, signaturesVerified);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::take_tx(const crypto::hash &id, Transaction &tx, size_t& blobSize, uint64_t& fee, BlockInfo& maxUsedBlock, bool& signaturesVerified) {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
     auto it = m_transactions.find(id);
     if (it == m_transactions.end()) {
@@ -217,6 +288,8 @@ namespace CryptoNote {
     tx = txd.tx;
     blobSize = txd.blobSize;
     fee = txd.fee;
+    maxUsedBlock = txd.maxUsedBlock;
+    signaturesVerified = txd.signaturesVerified;
 
     removeTransaction(it);
     return true;
@@ -234,14 +307,12 @@ namespace CryptoNote {
     }
   }
   //---------------------------------------------------------------------------------
-  void tx_memory_pool::get_difference(const std::vector<crypto::hash>& known_tx_ids, std::vector<crypto::hash>& new_tx_ids, std::vector<crypto::hash>& deleted_tx_ids) const {
+  void tx_memory_pool::get_difference(const std::vector<crypto::hash>& known_tx_ids, std::vector<crypto::hash>& new_tx_ids, std::vector<crypto::hash>& deleted_tx_ids) {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    updateReadyTransactions();
     std::unordered_set<crypto::hash> ready_tx_ids;
-    for (const auto& tx : m_transactions) {
-      TransactionCheckInfo checkInfo(tx);
-      if (is_transaction_ready_to_go(tx.tx, checkInfo)) {
-        ready_tx_ids.insert(tx.id);
-      }
+    for (auto i = m_ready_index.begin(); i != m_ready_index.end() && i->ready; ++i) {
+      ready_tx_ids.insert(i->id);
     }
 
     std::unordered_set<crypto::hash> known_set(known_tx_ids.begin(), known_tx_ids.end());
@@ -260,11 +331,69 @@ namespace CryptoNote {
     deleted_tx_ids.assign(known_set.begin(), known_set.end());
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id) {
+  bool tx_memory_pool::get_changes(uint64_t known_version, std::vector<crypto::hash>& new_tx_ids, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version) {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    updateReadyTransactions();
+    version = m_readyVersion;
+    if (known_version == 0) {
+      for (auto i = m_ready_index.begin(); i != m_ready_index.end() && i->ready; ++i) {
+        new_tx_ids.push_back(i->id);
+      }
+
+      return true;
+    }
+
+    if (known_version > m_readyVersion) {
+      return false;
+    }
+
+    // the change following known_version must still be in the log
+    if (known_version < m_readyVersion && (m_readyChanges.empty() || m_readyChanges.front().version > known_version + 1)) {
+      return false;
+    }
+
+    auto first = std::upper_bound(m_readyChanges.begin(), m_readyChanges.end(), known_version,
+      [](uint64_t knownVersion, const ReadyChange& change) { return knownVersion < change.version; });
+
+    // a transaction was ready at known_version if its first change is removal, it is ready now if its last one is addition
+    std::unordered_map<crypto::hash, std::pair<bool, bool>> changes;
+    for (auto i = first; i != m_readyChanges.end(); ++i) {
+      auto inserted = changes.insert(std::make_pair(i->id, std::make_pair(!i->added, i->added)));
+      if (!inserted.second) {
+        inserted.first->second.second = i->added;
+      }
+    }
+
+    for (const auto& change : changes) {
+      if (!change.second.first && change.second.second) {
+        new_tx_ids.push_back(change.first);
+      } else if (change.second.first && !change.second.second) {
+        deleted_tx_ids.push_back(change.first);
+      }
+    }
+
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id, const std::vector<crypto::key_image>& spentKeyImages) {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    m_readyStale = true;
+    m_tailId = top_block_id;
+    std::vector<crypto::hash> transactionIds;
+    for (const crypto::key_image& keyImage : spentKeyImages) {
+      transactionIds.clear();
+      m_spent_key_images.getTransactions(keyImage, transactionIds);
+      m_readyToRecheck.insert(transactionIds.begin(), transactionIds.end());
+    }
+
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id) {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    m_readyStale = true;
+    m_tailId = top_block_id;
+    m_poppedHeight = std::min(m_poppedHeight, new_block_height);
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -286,7 +415,9 @@ namespace CryptoNote {
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::is_transaction_ready_to_go(const Transaction& tx, TransactionCheckInfo& txd) const {
 
-    if (!m_validator.checkTransactionInputs(tx, txd.maxUsedBlock, txd.lastFailedBlock))
+    // the validator checks ring signatures unless they were checked against the same maxUsedBlock already
+    txd.signaturesVerified = m_validator.checkTransactionInputs(tx, txd.maxUsedBlock, txd.lastFailedBlock);
+    if (!txd.signaturesVerified)
       return false;
 
     //if we here, transaction seems valid, but, anyway, check for key_images collisions with blockchain, just to be sure
@@ -297,6 +428,64 @@ namespace CryptoNote {
     return true;
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::updateReadyTransactions() {
+    if (!m_readyStale) {
+      return;
+    }
+
+    // on the same tail as the last recheck only transactions added since then are not checked yet
+    bool tailChanged = m_tailId == null_hash || m_tailId != m_readyTailId;
+
+    // transactions which weren't ready are always rechecked, pushed blocks could bring their outputs or unlock them;
+    // they are kept at the end of ready index
+    std::vector<crypto::hash> transactionIds(m_readyToRecheck.begin(), m_readyToRecheck.end());
+    for (auto i = m_ready_index.rbegin(); tailChanged && i != m_ready_index.rend() && !i->ready; ++i) {
+      transactionIds.push_back(i->id);
+    }
+
+    if (tailChanged && m_poppedHeight != std::numeric_limits<uint64_t>::max()) {
+      for (auto i = m_ready_index.begin(); i != m_ready_index.end() && i->ready; ++i) {
+        if (i->maxUsedBlock.height >= m_poppedHeight) {
+          transactionIds.push_back(i->id);
+        }
+      }
+    }
+
+    // modification reorders ready index, so transactions are found through main index
+    for (const crypto::hash& id : transactionIds) {
+      auto i = m_transactions.find(id);
+      if (i == m_transactions.end()) {
+        continue;
+      }
+
+      TransactionCheckInfo checkInfo(*i);
+      checkInfo.ready = is_transaction_ready_to_go(i->tx, checkInfo);
+      if (checkInfo.ready != i->ready) {
+        addReadyChange(id, checkInfo.ready);
+      }
+
+      m_transactions.modify(i, [&checkInfo](TransactionCheckInfo& item) {
+        item = checkInfo;
+      });
+    }
+
+    m_readyToRecheck.clear();
+    m_poppedHeight = std::numeric_limits<uint64_t>::max();
+    m_readyTailId = m_tailId;
+    m_readyStale = false;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::addReadyChange(const crypto::hash& id, bool added) {
+    ReadyChange change;
+    change.version = ++m_readyVersion;
+    change.id = id;
+    change.added = added;
+    m_readyChanges.push_back(change);
+    if (m_readyChanges.size() > READY_CHANGES_LOG_SIZE) {
+      m_readyChanges.pop_front();
+    }
+  }
+  //---------------------------------------------------------------------------------
   std::string tx_memory_pool::print_pool(bool short_format) const {
     std::stringstream ss;
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
@@ -330,22 +519,15 @@ namespace CryptoNote {
 
     BlockTemplate blockTemplate;
 
-    for (auto i = m_fee_index.begin(); i != m_fee_index.end(); ++i) {
+    updateReadyTransactions();
+    for (auto i = m_ready_index.begin(); i != m_ready_index.end() && i->ready; ++i) {
       const auto& txd = *i;
 
       if (max_total_size < total_size + txd.blobSize) {
         continue;
       }
 
-      TransactionCheckInfo checkInfo(txd);
-      bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
-
-      // update item state
-      m_fee_index.modify(i, [&checkInfo](TransactionCheckInfo& item) {
-        item = checkInfo;
-      });
-      
-      if (ready && blockTemplate.addTransaction(txd.id, txd.tx)) {
+      if (blockTemplate.addTransaction(txd.id, txd.tx)) {
         total_size += txd.blobSize;
         fee += txd.fee;
       }
@@ -364,7 +546,7 @@ namespace CryptoNote {
     if (!boost::filesystem::exists(state_file_path, ec)) {
       return true;
     }
-    bool res = tools::unserialize_obj_from_file(*this, state_file_path);
+    bool res = loadFromBinaryFile(*this, state_file_path);
     if (!res) {
       logger(ERROR) << "Failed to load memory pool from file " << state_file_path;
 
@@ -372,6 +554,11 @@ namespace CryptoNote {
       m_spent_key_images.clear();
       m_spentOutputs.clear();
     }
+
+    m_transactionsSize = 0;
+    for (const auto& txd : m_transactions) {
+      m_transactionsSize += txd.blobSize;
+    }
     // Ignore deserialization error
     return true;
   }
@@ -383,13 +570,87 @@ namespace CryptoNote {
     }
 
     std::string state_file_path = m_config_folder + "/" + m_currency.txPoolFileName();
-    bool res = tools::serialize_obj_to_file(*this, state_file_path);
+    bool res = storeToBinaryFile(*this, state_file_path);
     if (!res) {
       logger(INFO) << "Failed to serialize memory pool to file " << state_file_path;
     }
     return true;
   }
 
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::serialize(ISerializer& s, const std::string& name) {
+    uint32_t version = CURRENT_MEMPOOL_ARCHIVE_VER;
+    s(version, "version");
+    if (version != CURRENT_MEMPOOL_ARCHIVE_VER) {
+      return;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+
+    size_t count = m_transactions.size();
+    s.beginArray(count, "transactions");
+    if (s.type() == ISerializer::INPUT) {
+      m_transactions.clear();
+      for (size_t i = 0; i < count; ++i) {
+        TransactionDetails txd;
+        s(txd, "");
+        txd.expiryTime = getExpiryTime(txd);
+        m_transactions.insert(std::move(txd));
+      }
+    } else {
+      for (const auto& txd : m_transactions) {
+        s(const_cast<TransactionDetails&>(txd), "");
+      }
+    }
+
+    s.endArray();
+
+    s(m_spent_key_images, "spent_key_images");
+
+    std::vector<GlobalOutput> spentOutputs;
+    if (s.type() == ISerializer::OUTPUT) {
+      spentOutputs.assign(m_spentOutputs.begin(), m_spentOutputs.end());
+    }
+
+    count = spentOutputs.size();
+    s.beginArray(count, "spent_outputs");
+    spentOutputs.resize(count);
+    for (auto& output : spentOutputs) {
+      s(output.first, "amount");
+      s(output.second, "index");
+    }
+
+    s.endArray();
+
+    if (s.type() == ISerializer::INPUT) {
+      m_spentOutputs.clear();
+      m_spentOutputs.insert(spentOutputs.begin(), spentOutputs.end());
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::TransactionDetails::serialize(ISerializer& s, const std::string& name) {
+    s.beginObject(name);
+    s(id, "id");
+    uint64_t size = blobSize;
+    s(size, "blob_size");
+    blobSize = static_cast<size_t>(size);
+    s(fee, "fee");
+    s(tx, "tx");
+    s(maxUsedBlock.height, "max_used_block_height");
+    s(maxUsedBlock.id, "max_used_block_id");
+    s(lastFailedBlock.height, "last_failed_block_height");
+    s(lastFailedBlock.id, "last_failed_block_id");
+    s(signaturesVerified, "signatures_verified");
+    s(keptByBlock, "kept_by_block");
+    int64_t time = static_cast<int64_t>(receiveTime);
+    s(time, "receive_time");
+    receiveTime = static_cast<time_t>(time);
+    s.endObject();
+
+    if (s.type() == ISerializer::INPUT) {
+      ready = false;
+    }
+  }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::on_idle() {
     m_txCheckInterval.call([this](){ return removeExpiredTransactions(); });
@@ -403,17 +664,12 @@ namespace CryptoNote {
 
     auto now = m_timeProvider.now();
 
-    for (auto it = m_transactions.begin(); it != m_transactions.end();) {
-      uint64_t txAge = now - it->receiveTime;
-      bool remove = txAge > (it->keptByBlock ? m_currency.mempoolTxFromAltBlockLiveTime() : m_currency.mempoolTxLiveTime());
-
-      if (remove) {
-        logger(TRACE) << "Tx " << it->id << " removed from tx pool due to outdated, age: " << txAge;
-        it = removeTransaction(it);
-          somethingRemoved = true;
-      } else {
-        ++it;
-      }
+    // expiry index is ordered by time, so only expired transactions are visited
+    while (!m_expiry_index.empty() && m_expiry_index.begin()->expiryTime < now) {
+      auto it = m_transactions.project<0>(m_expiry_index.begin());
+      logger(TRACE) << "Tx " << it->id << " removed from tx pool due to outdated, age: " << now - it->receiveTime;
+      removeTransaction(it);
+      somethingRemoved = true;
     }
     }
 
@@ -424,8 +680,66 @@ namespace CryptoNote {
     return true;
   }
 
+  time_t tx_memory_pool::getExpiryTime(const TransactionDetails& txd) const {
+    uint64_t liveTime = txd.keptByBlock ? m_currency.mempoolTxFromAltBlockLiveTime() : m_currency.mempoolTxLiveTime();
+    return txd.receiveTime + static_cast<time_t>(liveTime);
+  }
+
+  void tx_memory_pool::setSizeLimits(size_t maxTransactions, size_t maxBytes) {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    m_maxTransactions = maxTransactions;
+    m_maxTransactionsSize = maxBytes;
+  }
+
+  void tx_memory_pool::setMemoryLimit(size_t maxBytes) {
+    std::vector<crypto::hash> evictedIds;
+    {
+      std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+      m_memoryLimit = maxBytes;
+      evictTransactions(evictedIds);
+    }
+
+    if (!evictedIds.empty()) {
+      logger(INFO) << evictedIds.size() << " transactions evicted from tx pool to fit memory budget";
+      m_observerManager.notify(&ITxPoolObserver::txsEvictedFromPool, evictedIds);
+    }
+  }
+
+  size_t tx_memory_pool::getTransactionsSize() const {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    return m_transactionsSize;
+  }
+
+  void tx_memory_pool::evictTransactions(std::vector<crypto::hash>& evictedIds) {
+    auto overLimits = [this] {
+      return (m_maxTransactions != 0 && m_transactions.size() > m_maxTransactions) ||
+        (m_maxTransactionsSize != 0 && m_transactionsSize > m_maxTransactionsSize) ||
+        (m_memoryLimit != 0 && m_transactionsSize > m_memoryLimit);
+    };
+
+    // walk from the lowest priority, i is either end or a transaction kept by block, so erasing before it is safe
+    auto i = m_fee_index.end();
+    while (overLimits() && i != m_fee_index.begin()) {
+      auto victim = std::prev(i);
+      if (victim->keptByBlock) {
+        i = victim;
+        continue;
+      }
+
+      logger(DEBUGGING) << "Tx " << victim->id << " evicted from full tx pool, fee " << m_currency.formatAmount(victim->fee) <<
+        ", size " << victim->blobSize;
+      evictedIds.push_back(victim->id);
+      removeTransaction(m_transactions.project<0>(victim));
+    }
+  }
+
   tx_memory_pool::tx_container_t::iterator tx_memory_pool::removeTransaction(tx_memory_pool::tx_container_t::iterator i) {
+    if (i->ready) {
+      addReadyChange(i->id, false);
+    }
+
     removeTransactionInputs(i->id, i->tx, i->keptByBlock);
+    m_transactionsSize -= i->blobSize;
     return m_transactions.erase(i);
   }
 
@@ -433,21 +747,11 @@ namespace CryptoNote {
     for (const auto& in : tx.vin) {
       if (in.type() == typeid(TransactionInputToKey)) {
         const auto& txin = boost::get<TransactionInputToKey>(in);
-        auto it = m_spent_key_images.find(txin.keyImage);
-        if (!(it != m_spent_key_images.end())) { logger(ERROR, BRIGHT_RED) << "failed to find transaction input in key images. img=" << txin.keyImage << std::endl
-          << "transaction id = " << tx_id; return false; }
-        std::unordered_set<crypto::hash>& key_image_set = it->second;
-        if (!(!key_image_set.empty())) { logger(ERROR, BRIGHT_RED) << "empty key_image set, img=" << txin.keyImage << std::endl
+        if (!m_spent_key_images.contains(txin.keyImage)) { logger(ERROR, BRIGHT_RED) << "failed to find transaction input in key images. img=" << txin.keyImage << std::endl
           << "transaction id = " << tx_id; return false; }
 
-        auto it_in_set = key_image_set.find(tx_id);
-        if (!(it_in_set != key_image_set.end())) { logger(ERROR, BRIGHT_RED) << "transaction id not found in key_image set, img=" << txin.keyImage << std::endl
+        if (!m_spent_key_images.erase(txin.keyImage, tx_id)) { logger(ERROR, BRIGHT_RED) << "transaction id not found in key_image set, img=" << txin.keyImage << std::endl
           << "transaction id = " << tx_id; return false; }
-        key_image_set.erase(it_in_set);
-        if (key_image_set.empty()) {
-          //it is now empty hash container for this key_image
-          m_spent_key_images.erase(it);
-        }
       } else if (in.type() == typeid(TransactionInputMultisignature)) {
         if (!keptByBlock) {
           const auto& msig = boost::get<TransactionInputMultisignature>(in);
@@ -467,16 +771,15 @@ namespace CryptoNote {
     for (const auto& in : tx.vin) {
       if (in.type() == typeid(TransactionInputToKey)) {
         const auto& txin = boost::get<TransactionInputToKey>(in);
-        std::unordered_set<crypto::hash>& kei_image_set = m_spent_key_images[txin.keyImage];
-        if (!(keptByBlock || kei_image_set.size() == 0)) {
+        size_t keyImageTransactions = m_spent_key_images.count(txin.keyImage);
+        if (!(keptByBlock || keyImageTransactions == 0)) {
           logger(ERROR, BRIGHT_RED)
               << "internal error: keptByBlock=" << keptByBlock
-              << ",  kei_image_set.size()=" << kei_image_set.size() << ENDL
+              << ",  kei_image_set.size()=" << keyImageTransactions << ENDL
               << "txin.keyImage=" << txin.keyImage << ENDL << "tx_id=" << id;
           return false;
         }
-        auto ins_res = kei_image_set.insert(id);
-        if (!(ins_res.second)) {
+        if (!m_spent_key_images.insert(txin.keyImage, id)) {
           logger(ERROR, BRIGHT_RED) << "internal error: try to insert duplicate iterator in key_image set";
           return false;
         }
@@ -498,7 +801,7 @@ namespace CryptoNote {
     for (const auto& in : tx.vin) {
       if (in.type() == typeid(TransactionInputToKey)) {
         const auto& tokey_in = boost::get<TransactionInputToKey>(in);
-        if (m_spent_key_images.count(tokey_in.keyImage)) {
+        if (m_spent_key_images.contains(tokey_in.keyImage)) {
           return true;
         }
       } else if (in.type() == typeid(TransactionInputMultisignature)) {
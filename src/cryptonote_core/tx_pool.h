@@ -17,11 +17,11 @@
 
 #pragma once
 
+#include <deque>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
 
-#include <boost/serialization/version.hpp>
 #include <boost/utility.hpp>
 
 // multi index
@@ -39,6 +39,7 @@
 #include "cryptonote_core/ITimeProvider.h"
 #include "cryptonote_core/ITransactionValidator.h"
 #include "cryptonote_core/ITxPoolObserver.h"
+#include "cryptonote_core/KeyImagesIndex.h"
 #include "cryptonote_core/verification_context.h"
 
 #include <Logging/LoggerRef.h>
@@ -93,13 +94,26 @@ namespace CryptoNote {
     bool init(const std::string& config_folder);
     bool deinit();
 
+    // Pool keeps at most maxTransactions transactions of maxBytes total blob size, zero means no limit. Transactions
+    // with the lowest fee per byte are evicted first, transactions kept by blocks are never evicted.
+    void setSizeLimits(size_t maxTransactions, size_t maxBytes);
+    // Limit of total blob size given by the memory budget on top of the configured one, 0 means none. Shrinking it
+    // evicts transactions right away.
+    void setMemoryLimit(size_t maxBytes);
+    size_t getTransactionsSize() const;
+
     bool have_tx(const crypto::hash &id) const;
     bool add_tx(const Transaction &tx, const crypto::hash &id, size_t blobSize, tx_verification_context& tvc, bool keeped_by_block);
     bool add_tx(const Transaction &tx, tx_verification_context& tvc, bool keeped_by_block);
     //gets tx and remove it from pool
     bool take_tx(const crypto::hash &id, Transaction &tx, size_t& blobSize, uint64_t& fee);
+    // Also returns the block the inputs were last resolved against and whether ring signatures were verified against it
+    bool take_tx(const crypto::hash &id, Transaction &tx, size_t& blobSize, uint64_t& fee, BlockInfo& maxUsedBlock, bool& signaturesVerified);
 
-    bool on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id);
+    // Readiness for block template is rechecked only for transactions affected by the change: ones spending key images
+    // of the pushed block, ones using popped blocks and ones which weren't ready. Results are kept for the tail they
+    // were checked on, returning to it after a push and pop rechecks only transactions added meanwhile.
+    bool on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id, const std::vector<crypto::key_image>& spentKeyImages);
     bool on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id);
 
     void lock() const;
@@ -108,7 +122,10 @@ namespace CryptoNote {
     bool fill_block_template(Block &bl, size_t median_size, size_t maxCumulativeSize, uint64_t already_generated_coins, size_t &total_size, uint64_t &fee);
 
     void get_transactions(std::list<Transaction>& txs) const;
-    void get_difference(const std::vector<crypto::hash>& known_tx_ids, std::vector<crypto::hash>& new_tx_ids, std::vector<crypto::hash>& deleted_tx_ids) const;
+    void get_difference(const std::vector<crypto::hash>& known_tx_ids, std::vector<crypto::hash>& new_tx_ids, std::vector<crypto::hash>& deleted_tx_ids);
+    // Ready transactions which were added and removed since known_version, which is one returned before as version,
+    // all ready ones for 0. Returns false if changes since then are not kept anymore.
+    bool get_changes(uint64_t known_version, std::vector<crypto::hash>& new_tx_ids, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version);
     size_t get_transactions_count() const;
     std::string print_pool(bool short_format) const;
     void on_idle();
@@ -127,23 +144,17 @@ namespace CryptoNote {
       }
     }
 
-#define CURRENT_MEMPOOL_ARCHIVE_VER    10
-
-    template<class archive_t>
-    void serialize(archive_t & a, const unsigned int version) {
-      if (version < CURRENT_MEMPOOL_ARCHIVE_VER) {
-        return;
-      }
+#define CURRENT_MEMPOOL_ARCHIVE_VER    13
 
-      std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
-      a & m_transactions;
-      a & m_spent_key_images;
-      a & m_spentOutputs;
-    }
+    void serialize(ISerializer& s, const std::string& name);
 
     struct TransactionCheckInfo {
       BlockInfo maxUsedBlock;
       BlockInfo lastFailedBlock;
+      // ring signatures passed a check against outputs up to maxUsedBlock, blocks skip checking them again
+      bool signaturesVerified;
+      // result of the last is_transaction_ready_to_go, valid while the pool isn't stale
+      bool ready;
     };
 
     struct TransactionDetails : public TransactionCheckInfo {
@@ -153,6 +164,10 @@ namespace CryptoNote {
       uint64_t fee;
       bool keptByBlock;
       time_t receiveTime;
+      // receiveTime plus the live time of the pool, not serialized
+      time_t expiryTime;
+
+      void serialize(ISerializer& s, const std::string& name);
     };
 
   private:
@@ -178,16 +193,29 @@ namespace CryptoNote {
       }
     };
 
+    struct ReadyTransactionComparator {
+      // ready transactions go first, both groups are sorted by priority
+      bool operator()(const TransactionDetails& lhs, const TransactionDetails& rhs) const {
+        if (lhs.ready != rhs.ready) {
+          return lhs.ready;
+        }
+
+        return TransactionPriorityComparator()(lhs, rhs);
+      }
+    };
+
     typedef hashed_unique<BOOST_MULTI_INDEX_MEMBER(TransactionDetails, crypto::hash, id)> main_index_t;
     typedef ordered_non_unique<identity<TransactionDetails>, TransactionPriorityComparator> fee_index_t;
+    typedef ordered_non_unique<identity<TransactionDetails>, ReadyTransactionComparator> ready_index_t;
+    typedef ordered_non_unique<BOOST_MULTI_INDEX_MEMBER(TransactionDetails, time_t, expiryTime)> expiry_index_t;
 
     typedef multi_index_container<TransactionDetails,
-      indexed_by<main_index_t, fee_index_t>
+      indexed_by<main_index_t, fee_index_t, ready_index_t, expiry_index_t>
     > tx_container_t;
 
     typedef std::pair<uint64_t, uint64_t> GlobalOutput;
     typedef std::set<GlobalOutput> GlobalOutputsContainer;
-    typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
+    typedef KeyImagesIndex key_images_container;
 
 
     // double spending checking
@@ -197,7 +225,17 @@ namespace CryptoNote {
 
     tx_container_t::iterator removeTransaction(tx_container_t::iterator i);
     bool removeExpiredTransactions();
+    time_t getExpiryTime(const TransactionDetails& txd) const;
+    void evictTransactions(std::vector<crypto::hash>& evictedIds);
     bool is_transaction_ready_to_go(const Transaction& tx, TransactionCheckInfo& txd) const;
+    void updateReadyTransactions();
+    void addReadyChange(const crypto::hash& id, bool added);
+
+    struct ReadyChange {
+      uint64_t version;
+      crypto::hash id;
+      bool added;
+    };
 
     tools::ObserverManager<ITxPoolObserver> m_observerManager;
     const CryptoNote::Currency& m_currency;
@@ -211,7 +249,26 @@ namespace CryptoNote {
     CryptoNote::ITimeProvider& m_timeProvider;
 
     tx_container_t m_transactions;  
+    size_t m_transactionsSize;
+    size_t m_maxTransactions;
+    size_t m_maxTransactionsSize;
+    size_t m_memoryLimit;
     tx_container_t::nth_index<1>::type& m_fee_index;
+    tx_container_t::nth_index<2>::type& m_ready_index;
+    tx_container_t::nth_index<3>::type& m_expiry_index;
+    // set when blockchain changed, affected transactions are rechecked once on the next template request
+    bool m_readyStale;
+    // ready transactions spending key images of blocks pushed since the last recheck, and transactions added meanwhile
+    std::unordered_set<crypto::hash> m_readyToRecheck;
+    // tail readiness was checked on and the current one, null if unknown
+    crypto::hash m_readyTailId;
+    crypto::hash m_tailId;
+    // lowest height of blocks popped since the last recheck, ready transactions using blocks from it are rechecked
+    uint64_t m_poppedHeight;
+    // Every change of the ready set gets the next version, the latest of them are kept for get_changes. Versions start
+    // from the time the pool is created, so ones from before a restart aren't mistaken for current ones.
+    std::deque<ReadyChange> m_readyChanges;
+    uint64_t m_readyVersion;
 
     Logging::LoggerRef logger;
 
@@ -220,23 +277,3 @@ namespace CryptoNote {
 #endif
   };
 }
-
-namespace boost {
-  namespace serialization {
-    template<class archive_t>
-    void serialize(archive_t & ar, CryptoNote::tx_memory_pool::TransactionDetails& td, const unsigned int version) {
-      ar & td.id;
-      ar & td.blobSize;
-      ar & td.fee;
-      ar & td.tx;
-      ar & td.maxUsedBlock.height;
-      ar & td.maxUsedBlock.id;
-      ar & td.lastFailedBlock.height;
-      ar & td.lastFailedBlock.id;
-      ar & td.keptByBlock;
-      ar & td.receiveTime;
-    }
-  }
-}
-
-BOOST_CLASS_VERSION(CryptoNote::tx_memory_pool, CURRENT_MEMPOOL_ARCHIVE_VER)
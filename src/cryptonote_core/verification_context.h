@@ -36,5 +36,6 @@ namespace CryptoNote
     bool m_verifivation_failed; //bad block, should drop connection
     bool m_marked_as_orphaned;
     bool m_already_exists;
+    bool m_added_to_alt_chain;
   };
 }
@@ -0,0 +1,241 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/uuid/uuid.hpp>
+
+#include "crypto/hash.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+
+namespace CryptoNote
+{
+  // Blocks being downloaded during synchronization, shared by all connections. Block ids are kept in the order they
+  // have to be added to the blockchain. Each id is requested from one connection at a time, ids requested from a
+  // connection which hasn't delivered them in time may be requested from another one. Received blocks wait until all
+  // blocks before them are received, so they can be added in order while later ones are still downloading.
+  // Every id gets a position, positions grow by one with each added id and are never reused, so connections refer
+  // to the blocks they can send by ranges of positions instead of keeping their own copies of ids.
+  // Connections which announced an id are its candidates. When the last candidate of a block not received yet is
+  // released, nobody can send it, so it is dropped together with all the blocks after it, which can't be added
+  // without it. Connections still having those blocks announce them again when they request the chain.
+  // Scheduler doesn't synchronize access itself.
+  class BlockDownloadScheduler {
+
+  public:
+
+    typedef std::chrono::steady_clock Clock;
+    typedef boost::uuids::uuid ConnectionId;
+    // [first, second) positions of ids
+    typedef std::pair<uint64_t, uint64_t> PositionRange;
+
+    struct ReceivedBlock {
+      ConnectionId source;
+      block_complete_entry block;
+    };
+
+    explicit BlockDownloadScheduler(Clock::duration stallTimeout) : m_stallTimeout(stallTimeout), m_firstPosition(0) {}
+
+    // Appends ids not registered yet, the connection becomes a candidate of all the ids. Returns number of appended ones.
+    template<class Ids> size_t addBlockIds(const Ids& ids, const ConnectionId& connection) {
+      std::vector<PositionRange> ranges;
+      return addBlockIds(ids, connection, ranges);
+    }
+
+    // Same as above, positions of all the ids, registered before or not, are appended to ranges
+    template<class Ids> size_t addBlockIds(const Ids& ids, const ConnectionId& connection, std::vector<PositionRange>& ranges) {
+      size_t added = 0;
+      for (const crypto::hash& id : ids) {
+        auto it = m_index.find(id);
+        uint64_t position;
+        if (it != m_index.end()) {
+          position = it->second;
+        } else {
+          position = m_firstPosition + m_blocks.size();
+          m_blocks.push_back(Entry(id));
+          m_index.emplace(id, position);
+          ++added;
+        }
+
+        std::vector<ConnectionId>& candidates = getEntry(position).candidates;
+        if (std::find(candidates.begin(), candidates.end(), connection) == candidates.end()) {
+          candidates.push_back(connection);
+        }
+
+        if (!ranges.empty() && ranges.back().second == position) {
+          ++ranges.back().second;
+        } else {
+          ranges.push_back(PositionRange(position, position + 1));
+        }
+      }
+
+      return added;
+    }
+
+    // Returns false if nothing is awaited from the connection for the position: block is already received, taken or
+    // removed, or it is requested from this connection
+    bool getAwaitedBlockId(uint64_t position, const ConnectionId& connection, crypto::hash& id) const {
+      if (position < m_firstPosition || position - m_firstPosition >= m_blocks.size()) {
+        return false;
+      }
+
+      const Entry& entry = m_blocks[static_cast<size_t>(position - m_firstPosition)];
+      if (entry.removed || entry.received || (entry.assigned && entry.connection == connection)) {
+        return false;
+      }
+
+      id = entry.id;
+      return true;
+    }
+
+    // Assigns block to the connection if nobody has requested it yet or the one who did is stalled
+    bool assign(const crypto::hash& id, const ConnectionId& connection, Clock::time_point now) {
+      auto it = m_index.find(id);
+      if (it == m_index.end()) {
+        return false;
+      }
+
+      Entry& entry = getEntry(it->second);
+      if (entry.received || (entry.assigned && entry.connection != connection && now - entry.assignedAt < m_stallTimeout)) {
+        return false;
+      }
+
+      entry.assigned = true;
+      entry.connection = connection;
+      entry.assignedAt = now;
+      return true;
+    }
+
+    // Stores received block, returns false if it isn't awaited anymore, for example was delivered by another connection
+    bool addBlock(const crypto::hash& id, const ConnectionId& source, block_complete_entry&& block) {
+      auto it = m_index.find(id);
+      if (it == m_index.end() || getEntry(it->second).received) {
+        return false;
+      }
+
+      Entry& entry = getEntry(it->second);
+      entry.received = true;
+      entry.block.source = source;
+      entry.block.block = std::move(block);
+      return true;
+    }
+
+    // Removes and returns received blocks which have no missing blocks before them
+    std::vector<ReceivedBlock> takeReadyBlocks() {
+      std::vector<ReceivedBlock> blocks;
+      while (!m_blocks.empty() && (m_blocks.front().received || m_blocks.front().removed)) {
+        if (!m_blocks.front().removed) {
+          blocks.push_back(std::move(m_blocks.front().block));
+          m_index.erase(m_blocks.front().id);
+        }
+
+        m_blocks.pop_front();
+        ++m_firstPosition;
+      }
+
+      return blocks;
+    }
+
+    // Blocks requested from the connection become available to others. Returns number of blocks dropped because no
+    // other connection can send them or a block before them.
+    size_t releaseConnection(const ConnectionId& connection) {
+      auto dropFrom = m_blocks.end();
+      for (auto it = m_blocks.begin(); it != m_blocks.end(); ++it) {
+        Entry& entry = *it;
+        if (entry.assigned && !entry.received && !entry.removed && entry.connection == connection) {
+          entry.assigned = false;
+        }
+
+        entry.candidates.erase(std::remove(entry.candidates.begin(), entry.candidates.end(), connection), entry.candidates.end());
+        if (dropFrom == m_blocks.end() && entry.candidates.empty() && !entry.received && !entry.removed) {
+          dropFrom = it;
+        }
+      }
+
+      size_t dropped = 0;
+      for (auto it = dropFrom; it != m_blocks.end(); ++it) {
+        if (!it->removed) {
+          remove(it->id);
+          ++dropped;
+        }
+      }
+
+      return dropped;
+    }
+
+    // Forgets block known from elsewhere, for example relayed as a new block. Its entry keeps the position until
+    // blocks before it are taken.
+    void remove(const crypto::hash& id) {
+      auto it = m_index.find(id);
+      if (it != m_index.end()) {
+        Entry& entry = getEntry(it->second);
+        entry.removed = true;
+        entry.block = ReceivedBlock();
+        m_index.erase(it);
+      }
+    }
+
+    bool contains(const crypto::hash& id) const {
+      return m_index.count(id) != 0;
+    }
+
+    size_t size() const {
+      return m_index.size();
+    }
+
+    void clear() {
+      m_firstPosition += m_blocks.size();
+      m_blocks.clear();
+      m_index.clear();
+    }
+
+  private:
+
+    struct Entry {
+      explicit Entry(const crypto::hash& blockId) : id(blockId), assigned(false), received(false), removed(false) {}
+
+      crypto::hash id;
+      bool assigned;
+      bool received;
+      bool removed;
+      ConnectionId connection;
+      Clock::time_point assignedAt;
+      ReceivedBlock block;
+      // connections which announced the block
+      std::vector<ConnectionId> candidates;
+    };
+
+    Entry& getEntry(uint64_t position) {
+      return m_blocks[static_cast<size_t>(position - m_firstPosition)];
+    }
+
+    Clock::duration m_stallTimeout;
+    // position of the front entry
+    uint64_t m_firstPosition;
+    std::deque<Entry> m_blocks;
+    // positions of entries not removed
+    std::unordered_map<crypto::hash, uint64_t> m_index;
+
+  };
+}
@@ -52,6 +52,13 @@ namespace CryptoNote
     END_KV_SERIALIZE_MAP()
   };
 
+  // View secret key and spend public key of an address, they are enough to find outputs to the address, but not to spend them
+  struct TrackingKey
+  {
+    crypto::secret_key viewSecretKey;
+    crypto::public_key spendPublicKey;
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -166,4 +173,133 @@ namespace CryptoNote
     typedef NOTIFY_RESPONSE_CHAIN_ENTRY_request request;
   };
 
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Block without transactions, the receiver takes them from its pool by hashes listed in the block and requests
+  // missing ones by NOTIFY_REQUEST_BLOCK_TRANSACTIONS. Sent only to peers of P2P_COMPACT_BLOCKS_VERSION or above.
+  struct NOTIFY_NEW_COMPACT_BLOCK_request
+  {
+    blobdata block;
+    uint64_t current_blockchain_height;
+    uint32_t hop;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(block)
+      KV_SERIALIZE(current_blockchain_height)
+      KV_SERIALIZE(hop)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 8;
+    typedef NOTIFY_NEW_COMPACT_BLOCK_request request;
+  };
+
+  struct NOTIFY_REQUEST_BLOCK_TRANSACTIONS_request
+  {
+    crypto::hash block_id;
+    std::list<crypto::hash> txs;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_VAL_POD_AS_BLOB(block_id)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_REQUEST_BLOCK_TRANSACTIONS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 9;
+    typedef NOTIFY_REQUEST_BLOCK_TRANSACTIONS_request request;
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_TRANSACTIONS_request
+  {
+    crypto::hash block_id;
+    std::list<blobdata> txs;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_VAL_POD_AS_BLOB(block_id)
+      KV_SERIALIZE(txs)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_TRANSACTIONS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+    typedef NOTIFY_RESPONSE_BLOCK_TRANSACTIONS_request request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Hashes of new pool transactions, the receiver requests unknown ones by NOTIFY_REQUEST_TXS and gets them
+  // by NOTIFY_NEW_TRANSACTIONS. Sent only to peers of P2P_TX_ANNOUNCE_VERSION or above.
+  struct NOTIFY_TX_ANNOUNCE_request
+  {
+    std::list<crypto::hash> txs;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_TX_ANNOUNCE
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+    typedef NOTIFY_TX_ANNOUNCE_request request;
+  };
+
+  struct NOTIFY_REQUEST_TXS_request
+  {
+    std::list<crypto::hash> txs;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_REQUEST_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+    typedef NOTIFY_REQUEST_TXS_request request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Blocks without transactions for ids of a chain entry, so proofs of work of the whole range are checked before
+  // transactions are downloaded. Requested only from peers of P2P_BLOCK_HEADERS_VERSION or above.
+  struct NOTIFY_REQUEST_BLOCK_HEADERS_request
+  {
+    std::list<crypto::hash> blocks;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(blocks)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_REQUEST_BLOCK_HEADERS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+    typedef NOTIFY_REQUEST_BLOCK_HEADERS_request request;
+  };
+
+  // Block blobs in the order of requested ids, the response may end before the last one to keep its size bounded
+  struct NOTIFY_RESPONSE_BLOCK_HEADERS_request
+  {
+    std::list<blobdata> blocks;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocks)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_HEADERS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 14;
+    typedef NOTIFY_RESPONSE_BLOCK_HEADERS_request request;
+  };
+
 }
@@ -17,14 +17,18 @@
 
 #include "cryptonote_protocol_handler.h"
 
+#include <algorithm>
+#include <cstring>
 #include <future>
 #include <boost/scope_exit.hpp>
 #include <System/Dispatcher.h>
+#include <System/Timer.h>
 
 #include "cryptonote_core/cryptonote_basic_impl.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "cryptonote_core/Currency.h"
 #include "cryptonote_core/verification_context.h"
+#include "Common/Metrics.h"
 #include "p2p/LevinProtocol.h"
 
 using namespace Logging;
@@ -43,6 +47,23 @@ void relay_post_notify(i_p2p_endpoint& p2p, typename t_parametr::request& arg, c
   p2p.relay_notify_to_all(t_parametr::ID, LevinProtocol::encode(arg), excludeConnection);
 }
 
+// Work units of requests, a block served costs about as much as reading and sending a few transactions, a chain
+// request looks up the peer's ids and sends up to BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT ids back
+const uint64_t REQUEST_BASE_COST = 1;
+const uint64_t REQUEST_BLOCK_COST = 4;
+const uint64_t REQUEST_TRANSACTION_COST = 1;
+const uint64_t REQUEST_CHAIN_COST = 100;
+const uint64_t REQUEST_HEADER_COST = 1;
+// Peer which owes more work than this is dropped instead of waiting
+const std::chrono::seconds REQUEST_MAX_DELAY(30);
+// Hashes of recently processed block blobs, enough to cover the blocks relayed while a new one spreads
+const size_t SEEN_BLOCKS_MAX_COUNT = 1024;
+
+// order of requested block ids
+bool hashLess(const crypto::hash& hash1, const crypto::hash& hash2) {
+  return memcmp(&hash1, &hash2, sizeof(crypto::hash)) < 0;
+}
+
 }
 
 cryptonote_protocol_handler::cryptonote_protocol_handler(const Currency& currency, System::Dispatcher& dispatcher, ICore& rcore, i_p2p_endpoint* p_net_layout, Logging::ILogger& log) :
@@ -54,6 +75,12 @@ cryptonote_protocol_handler::cryptonote_protocol_handler(const Currency& currenc
   m_stop(false),
   m_observedHeight(0),
   m_peersCount(0),
+  m_requestRate(0),
+  m_requestBurst(0),
+  m_txRequestTimeout(P2P_TX_REQUEST_TIMEOUT),
+  m_blockHeadersRequestTimeout(BLOCK_HEADERS_SYNCHRONIZING_TIMEOUT),
+  m_downloads(std::chrono::seconds(BLOCKS_SYNCHRONIZING_STALL_TIMEOUT)),
+  m_committingBlocks(false),
   logger(log, "protocol") {
   
   if (!m_p2p) {
@@ -72,7 +99,21 @@ void cryptonote_protocol_handler::set_p2p_endpoint(i_p2p_endpoint* p2p) {
     m_p2p = &m_p2p_stub;
 }
 
+void cryptonote_protocol_handler::set_request_limits(uint64_t rate, uint64_t burst) {
+  m_requestRate = rate;
+  m_requestBurst = burst;
+}
+
+void cryptonote_protocol_handler::set_tx_request_timeout(std::chrono::seconds timeout) {
+  m_txRequestTimeout = timeout;
+}
+
+void cryptonote_protocol_handler::set_block_headers_request_timeout(std::chrono::seconds timeout) {
+  m_blockHeadersRequestTimeout = timeout;
+}
+
 void cryptonote_protocol_handler::onConnectionOpened(cryptonote_connection_context& context) {
+  context.m_request_budget = Common::TokenBucket(m_requestRate, m_requestBurst, Common::TokenBucket::Clock::now());
 }
 
 void cryptonote_protocol_handler::onConnectionClosed(cryptonote_connection_context& context) {
@@ -91,6 +132,28 @@ void cryptonote_protocol_handler::onConnectionClosed(cryptonote_connection_conte
     m_observerManager.notify(&ICryptonoteProtocolObserver::lastKnownBlockHeightUpdated, m_observedHeight);
   }
 
+  size_t dropped = m_downloads.releaseConnection(context.m_connection_id);
+  if (dropped != 0) {
+    logger(Logging::DEBUGGING) << context << "No other connection can send " << dropped << " blocks, they are dropped";
+  }
+  m_headerSyncs.erase(context.m_connection_id);
+  for (auto it = m_pendingBlocks.begin(); it != m_pendingBlocks.end();) {
+    if (it->second.connection == context.m_connection_id) {
+      it = m_pendingBlocks.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // transactions requested from the connection are requested from the next announcer by on_idle without waiting
+  for (auto& requested : m_requestedTransactions) {
+    auto& announcers = requested.second.announcers;
+    announcers.erase(std::remove(announcers.begin(), announcers.end(), context.m_connection_id), announcers.end());
+    if (requested.second.connection == context.m_connection_id) {
+      requested.second.time = std::chrono::steady_clock::time_point();
+    }
+  }
+
   if (context.m_state != cryptonote_connection_context::state_befor_handshake) {
     m_peersCount--;
     m_observerManager.notify(&ICryptonoteProtocolObserver::peerCountUpdated, m_peersCount.load());
@@ -108,6 +171,7 @@ bool cryptonote_protocol_handler::start_sync(cryptonote_connection_context& cont
     NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
     m_core.get_short_chain_history(r.block_ids);
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
+    context.m_transfer_statistics.requestSent(PeerTransferStatistics::Clock::now());
     post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
   }
 
@@ -146,6 +210,8 @@ uint64_t cryptonote_protocol_handler::get_current_blockchain_height() {
 }
 
 bool cryptonote_protocol_handler::process_payload_sync_data(const CORE_SYNC_DATA& hshd, cryptonote_connection_context& context, bool is_inital) {
+  context.m_version = hshd.version;
+
   if (context.m_state == cryptonote_connection_context::state_befor_handshake && !is_inital)
     return true;
 
@@ -182,12 +248,13 @@ bool cryptonote_protocol_handler::process_payload_sync_data(const CORE_SYNC_DATA
 bool cryptonote_protocol_handler::get_payload_sync_data(CORE_SYNC_DATA& hshd) {
   m_core.get_blockchain_top(hshd.current_height, hshd.top_id);
   hshd.current_height += 1;
+  hshd.version = P2P_CURRENT_VERSION;
   return true;
 }
 
 
 template <typename Command, typename Handler>
-int notifyAdaptor(const std::string& reqBuf, cryptonote_connection_context& ctx, Handler handler) {
+int notifyAdaptor(Common::StringView reqBuf, cryptonote_connection_context& ctx, Handler handler) {
 
   typedef typename Command::request Request;
   int command = Command::ID;
@@ -213,6 +280,13 @@ int cryptonote_protocol_handler::handleCommand(bool is_notify, int command, cons
     HANDLE_NOTIFY(NOTIFY_RESPONSE_GET_OBJECTS, &cryptonote_protocol_handler::handle_response_get_objects)
     HANDLE_NOTIFY(NOTIFY_REQUEST_CHAIN, &cryptonote_protocol_handler::handle_request_chain)
     HANDLE_NOTIFY(NOTIFY_RESPONSE_CHAIN_ENTRY, &cryptonote_protocol_handler::handle_response_chain_entry)
+    HANDLE_NOTIFY(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_BLOCK_TRANSACTIONS, &cryptonote_protocol_handler::handle_request_block_transactions)
+    HANDLE_NOTIFY(NOTIFY_RESPONSE_BLOCK_TRANSACTIONS, &cryptonote_protocol_handler::handle_response_block_transactions)
+    HANDLE_NOTIFY(NOTIFY_TX_ANNOUNCE, &cryptonote_protocol_handler::handle_notify_tx_announce)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_TXS, &cryptonote_protocol_handler::handle_request_txs)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_BLOCK_HEADERS, &cryptonote_protocol_handler::handle_request_block_headers)
+    HANDLE_NOTIFY(NOTIFY_RESPONSE_BLOCK_HEADERS, &cryptonote_protocol_handler::handle_response_block_headers)
 
   default:
     handled = false;
@@ -234,6 +308,10 @@ int cryptonote_protocol_handler::handle_notify_new_block(int command, NOTIFY_NEW
     return 1;
   }
 
+  if (isBlockSeen(arg.b.block)) {
+    return 1;
+  }
+
   for (auto tx_blob_it = arg.b.txs.begin(); tx_blob_it != arg.b.txs.end(); tx_blob_it++) {
     CryptoNote::tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
     m_core.handle_incoming_tx(*tx_blob_it, tvc, true);
@@ -244,26 +322,158 @@ int cryptonote_protocol_handler::handle_notify_new_block(int command, NOTIFY_NEW
     }
   }
 
+  processNewBlock(arg, context);
+  return 1;
+}
+
+void cryptonote_protocol_handler::processNewBlock(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& context) {
   block_verification_context bvc = boost::value_initialized<block_verification_context>();
   m_core.handle_incoming_block_blob(arg.b.block, bvc, true, false);
   if (bvc.m_verifivation_failed) {
     logger(Logging::DEBUGGING) << context << "Block verification failed, dropping connection";
     context.m_state = cryptonote_connection_context::state_shutdown;
-    return 1;
+    return;
+  }
+
+  // only blocks which were added to a chain are remembered: a peer sending a valid block with invalid transactions
+  // doesn't keep honest copies of it out, and later copies of an orphan still make their senders fetch its parents
+  if (bvc.m_added_to_main_chain || bvc.m_added_to_alt_chain) {
+    rememberSeenBlock(arg.b.block);
   }
   if (bvc.m_added_to_main_chain) {
     ++arg.hop;
-    //TODO: Add here announce protocol usage
-    relay_post_notify<NOTIFY_NEW_BLOCK>(*m_p2p, arg, &context.m_connection_id);
-    // relay_block(arg, context);
+    relayBlock(arg, &context.m_connection_id);
   } else if (bvc.m_marked_as_orphaned) {
     context.m_state = cryptonote_connection_context::state_synchronizing;
     NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
     m_core.get_short_chain_history(r.block_ids);
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
+    context.m_transfer_statistics.requestSent(PeerTransferStatistics::Clock::now());
     post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
   }
+}
+
+int cryptonote_protocol_handler::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_NEW_COMPACT_BLOCK (hop " << arg.hop << ")";
+
+  updateObservedHeight(arg.current_blockchain_height, context);
+
+  context.m_remote_blockchain_height = arg.current_blockchain_height;
+
+  if (context.m_state != cryptonote_connection_context::state_normal) {
+    return 1;
+  }
+
+  if (isBlockSeen(arg.block)) {
+    return 1;
+  }
+
+  Block b;
+  if (!parse_and_validate_block_from_blob(arg.block, b)) {
+    logger(Logging::INFO) << context << "sent wrong compact block: failed to parse and validate block, dropping connection";
+    context.m_state = cryptonote_connection_context::state_shutdown;
+    return 1;
+  }
+
+  crypto::hash blockId = get_block_hash(b);
+  if (m_core.have_block(blockId) || m_pendingBlocks.count(blockId) != 0) {
+    return 1;
+  }
+
+  NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request req;
+  req.block_id = blockId;
+  for (const crypto::hash& txHash : b.txHashes) {
+    if (!m_core.havePoolTransaction(txHash)) {
+      req.txs.push_back(txHash);
+    }
+  }
+
+  if (req.txs.empty()) {
+    NOTIFY_NEW_BLOCK::request block;
+    block.b.block = std::move(arg.block);
+    block.current_blockchain_height = arg.current_blockchain_height;
+    block.hop = arg.hop;
+    processNewBlock(block, context);
+    return 1;
+  }
+
+  for (auto it = m_pendingBlocks.begin(); it != m_pendingBlocks.end(); ++it) {
+    if (it->second.connection == context.m_connection_id) {
+      m_pendingBlocks.erase(it);
+      break;
+    }
+  }
+
+  m_pendingBlocks[blockId] = PendingBlock{ std::move(arg), context.m_connection_id };
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_BLOCK_TRANSACTIONS: txs.size()=" << req.txs.size();
+  post_notify<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(*m_p2p, req, context);
+  return 1;
+}
+
+int cryptonote_protocol_handler::handle_request_block_transactions(int command, NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request& arg, cryptonote_connection_context& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_BLOCK_TRANSACTIONS: txs.size()=" << arg.txs.size();
+  if (!throttleRequest(context, REQUEST_BASE_COST + arg.txs.size() * REQUEST_TRANSACTION_COST)) {
+    return 1;
+  }
+
+  // relayed block is in the blockchain already, unless this node is still reconstructing it and its transactions are
+  // in the pool
+  NOTIFY_REQUEST_GET_OBJECTS::request objects;
+  objects.txs = std::move(arg.txs);
+  NOTIFY_RESPONSE_GET_OBJECTS::request found;
+  if (!m_core.handle_get_objects(objects, found)) {
+    logger(Logging::ERROR) << context << "failed to handle request NOTIFY_REQUEST_BLOCK_TRANSACTIONS, dropping connection";
+    context.m_state = cryptonote_connection_context::state_shutdown;
+    return 1;
+  }
+
+  NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request rsp;
+  rsp.block_id = arg.block_id;
+  rsp.txs = std::move(found.txs);
+  if (!found.missed_ids.empty()) {
+    std::list<Transaction> poolTxs;
+    std::list<crypto::hash> missedIds;
+    m_core.getPoolTransactions(found.missed_ids, poolTxs, missedIds);
+    for (const Transaction& tx : poolTxs) {
+      rsp.txs.push_back(tx_to_blob(tx));
+    }
+  }
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_RESPONSE_BLOCK_TRANSACTIONS: txs.size()=" << rsp.txs.size();
+  post_notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(*m_p2p, rsp, context);
+  return 1;
+}
+
+int cryptonote_protocol_handler::handle_response_block_transactions(int command, NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request& arg, cryptonote_connection_context& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_RESPONSE_BLOCK_TRANSACTIONS: txs.size()=" << arg.txs.size();
+
+  auto it = m_pendingBlocks.find(arg.block_id);
+  if (it == m_pendingBlocks.end() || it->second.connection != context.m_connection_id) {
+    logger(Logging::DEBUGGING) << context << "sent transactions of block which wasn't requested";
+    return 1;
+  }
+
+  NOTIFY_NEW_BLOCK::request block;
+  block.b.block = std::move(it->second.notification.block);
+  block.current_blockchain_height = it->second.notification.current_blockchain_height;
+  block.hop = it->second.notification.hop;
+  m_pendingBlocks.erase(it);
+
+  if (context.m_state != cryptonote_connection_context::state_normal) {
+    return 1;
+  }
+
+  for (const blobdata& txBlob : arg.txs) {
+    tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
+    m_core.handle_incoming_tx(txBlob, tvc, true);
+    if (tvc.m_verifivation_failed) {
+      logger(Logging::INFO) << context << "Block verification failed: transaction verification failed, dropping connection";
+      context.m_state = cryptonote_connection_context::state_shutdown;
+      return 1;
+    }
+  }
 
+  processNewBlock(block, context);
   return 1;
 }
 
@@ -272,30 +482,98 @@ int cryptonote_protocol_handler::handle_notify_new_transactions(int command, NOT
   if (context.m_state != cryptonote_connection_context::state_normal)
     return 1;
 
-  for (auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end();) {
-    CryptoNote::tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
-    m_core.handle_incoming_tx(*tx_blob_it, tvc, false);
-    if (tvc.m_verifivation_failed) {
+  std::vector<Common::StringView> txBlobs;
+  txBlobs.reserve(arg.txs.size());
+  for (const blobdata& txBlob : arg.txs) {
+    m_requestedTransactions.erase(get_blob_hash(txBlob));
+    txBlobs.push_back(txBlob);
+  }
+
+  // Transactions of the notification are verified in parallel
+  std::vector<CryptoNote::tx_verification_context> tvcs;
+  m_core.handle_incoming_txs(txBlobs, tvcs, false);
+
+  size_t i = 0;
+  for (auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end(); ++i) {
+    if (tvcs[i].m_verifivation_failed) {
       logger(Logging::INFO) << context << "Tx verification failed, dropping connection";
       context.m_state = cryptonote_connection_context::state_shutdown;
       return 1;
     }
-    if (tvc.m_should_be_relayed)
+    if (tvcs[i].m_should_be_relayed)
       ++tx_blob_it;
     else
       arg.txs.erase(tx_blob_it++);
   }
 
   if (arg.txs.size()) {
-    //TODO: add announce usage here
-    relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(*m_p2p, arg, &context.m_connection_id);
+    relayTransactions(arg, &context.m_connection_id);
   }
 
   return true;
 }
 
+int cryptonote_protocol_handler::handle_notify_tx_announce(int command, NOTIFY_TX_ANNOUNCE::request& arg, cryptonote_connection_context& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_TX_ANNOUNCE: txs.size()=" << arg.txs.size();
+  if (context.m_state != cryptonote_connection_context::state_normal) {
+    return 1;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  NOTIFY_REQUEST_TXS::request req;
+  for (const crypto::hash& txHash : arg.txs) {
+    if (m_core.havePoolTransaction(txHash)) {
+      continue;
+    }
+
+    auto it = m_requestedTransactions.find(txHash);
+    if (it == m_requestedTransactions.end()) {
+      m_requestedTransactions[txHash] = RequestedTransaction{ context.m_connection_id, now, std::deque<net_connection_id>() };
+      req.txs.push_back(txHash);
+    } else if (it->second.connection != context.m_connection_id &&
+      std::find(it->second.announcers.begin(), it->second.announcers.end(), context.m_connection_id) == it->second.announcers.end()) {
+      it->second.announcers.push_back(context.m_connection_id);
+    }
+  }
+
+  if (!req.txs.empty()) {
+    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_TXS: txs.size()=" << req.txs.size();
+    post_notify<NOTIFY_REQUEST_TXS>(*m_p2p, req, context);
+  }
+
+  return 1;
+}
+
+int cryptonote_protocol_handler::handle_request_txs(int command, NOTIFY_REQUEST_TXS::request& arg, cryptonote_connection_context& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_TXS: txs.size()=" << arg.txs.size();
+  if (!throttleRequest(context, REQUEST_BASE_COST + arg.txs.size() * REQUEST_TRANSACTION_COST)) {
+    return 1;
+  }
+
+  // transactions which left the pool meanwhile are skipped, the peer gets them with a block
+  std::list<Transaction> txs;
+  std::list<crypto::hash> missedIds;
+  m_core.getPoolTransactions(arg.txs, txs, missedIds);
+  if (txs.empty()) {
+    return 1;
+  }
+
+  NOTIFY_NEW_TRANSACTIONS::request rsp;
+  for (const Transaction& tx : txs) {
+    rsp.txs.push_back(tx_to_blob(tx));
+  }
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << rsp.txs.size();
+  post_notify<NOTIFY_NEW_TRANSACTIONS>(*m_p2p, rsp, context);
+  return 1;
+}
+
 int cryptonote_protocol_handler::handle_request_get_objects(int command, NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context) {
   logger(Logging::TRACE) << context << "NOTIFY_REQUEST_GET_OBJECTS";
+  if (!throttleRequest(context, REQUEST_BASE_COST + arg.blocks.size() * REQUEST_BLOCK_COST + arg.txs.size() * REQUEST_TRANSACTION_COST)) {
+    return 1;
+  }
+
   NOTIFY_RESPONSE_GET_OBJECTS::request rsp;
   if (!m_core.handle_get_objects(arg, rsp)) {
     logger(Logging::ERROR) << context << "failed to handle request NOTIFY_REQUEST_GET_OBJECTS, dropping connection";
@@ -310,6 +588,16 @@ int cryptonote_protocol_handler::handle_request_get_objects(int command, NOTIFY_
 int cryptonote_protocol_handler::handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context) {
   logger(Logging::TRACE) << context << "NOTIFY_RESPONSE_GET_OBJECTS";
 
+  uint64_t size = 0;
+  for (const block_complete_entry& block_entry : arg.blocks) {
+    size += block_entry.block.size();
+    for (const blobdata& tx : block_entry.txs) {
+      size += tx.size();
+    }
+  }
+
+  context.m_transfer_statistics.objectsReceived(PeerTransferStatistics::Clock::now(), size, arg.blocks.size());
+
   if (context.m_last_response_height > arg.current_blockchain_height) {
     logger(Logging::ERROR) << context << "sent wrong NOTIFY_HAVE_OBJECTS: arg.m_current_blockchain_height=" << arg.current_blockchain_height
       << " < m_last_response_height=" << context.m_last_response_height << ", dropping connection";
@@ -321,9 +609,9 @@ int cryptonote_protocol_handler::handle_response_get_objects(int command, NOTIFY
 
   context.m_remote_blockchain_height = arg.current_blockchain_height;
 
-  size_t count = 0;
-  for (const block_complete_entry& block_entry : arg.blocks) {
-    ++count;
+  std::vector<crypto::hash> receivedIds;
+  receivedIds.reserve(arg.blocks.size());
+  for (block_complete_entry& block_entry : arg.blocks) {
     Block b;
     if (!parse_and_validate_block_from_blob(block_entry.block, b)) {
       logger(Logging::ERROR) << context << "sent wrong block: failed to parse and validate block: \r\n"
@@ -332,19 +620,8 @@ int cryptonote_protocol_handler::handle_response_get_objects(int command, NOTIFY
       return 1;
     }
 
-    //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
-    if (count == 2) {
-      if (m_core.have_block(get_block_hash(b))) {
-        context.m_state = cryptonote_connection_context::state_idle;
-        context.m_needed_objects.clear();
-        context.m_requested_objects.clear();
-        logger(Logging::DEBUGGING) << context << "Connection set to idle state.";
-        return 1;
-      }
-    }
-
-    auto req_it = context.m_requested_objects.find(get_block_hash(b));
-    if (req_it == context.m_requested_objects.end()) {
+    crypto::hash blockId = get_block_hash(b);
+    if (!std::binary_search(context.m_requested_objects.begin(), context.m_requested_objects.end(), blockId, hashLess)) {
       logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(get_blob_hash(block_entry.block))
         << " wasn't requested, dropping connection";
       context.m_state = cryptonote_connection_context::state_shutdown;
@@ -357,26 +634,69 @@ int cryptonote_protocol_handler::handle_response_get_objects(int command, NOTIFY
       return 1;
     }
 
-    context.m_requested_objects.erase(req_it);
+    receivedIds.push_back(blockId);
+    // block requested from a stalled connection may be already delivered by another one
+    m_downloads.addBlock(blockId, context.m_connection_id, std::move(block_entry));
   }
 
-  if (context.m_requested_objects.size()) {
+  // each requested block is returned exactly once
+  std::sort(receivedIds.begin(), receivedIds.end(), hashLess);
+  if (receivedIds != context.m_requested_objects) {
     logger(Logging::ERROR, Logging::BRIGHT_RED) << context <<
       "returned not all requested objects (context.m_requested_objects.size()="
-      << context.m_requested_objects.size() << "), dropping connection";
+      << context.m_requested_objects.size() << ", received " << receivedIds.size() << "), dropping connection";
     context.m_state = cryptonote_connection_context::state_shutdown;
     return 1;
   }
 
-  {
+  context.m_requested_objects.clear();
+
+  // Next blocks are requested before committing, so this connection keeps downloading while blocks are added
+  if (!m_stop && context.m_state == cryptonote_connection_context::state_synchronizing && !context.m_needed_objects.empty()) {
+    request_missing_objects(context, false);
+  }
+
+  commitReceivedBlocks(context);
+
+  // block ids are requested only after known blocks are committed, otherwise the chain entry repeats them
+  if (!m_stop && context.m_state == cryptonote_connection_context::state_synchronizing && context.m_requested_objects.empty()) {
+    request_missing_objects(context, true);
+  }
+
+  return 1;
+}
+
+// Blocks delivered by other connections while blocks are committed are picked up by the same loop
+void cryptonote_protocol_handler::commitReceivedBlocks(cryptonote_connection_context& context) {
+  if (m_committingBlocks) {
+    return;
+  }
+
+  m_committingBlocks = true;
+  BOOST_SCOPE_EXIT_ALL(this) { m_committingBlocks = false; };
+
+  for (;;) {
+    std::vector<BlockDownloadScheduler::ReceivedBlock> received = m_downloads.takeReadyBlocks();
+    if (received.empty() || m_stop) {
+      break;
+    }
+
+    std::vector<Block> blocks(received.size());
+    for (size_t i = 0; i < received.size(); ++i) {
+      parse_and_validate_block_from_blob(received[i].block.block, blocks[i]);
+    }
+
     m_core.pause_mining();
 
     BOOST_SCOPE_EXIT_ALL(this) { m_core.update_block_template_and_resume_mining(); };
 
     auto currentContext = m_dispatcher.getCurrentContext();
+    BlockDownloadScheduler::ConnectionId failedConnection;
 
     auto resultFuture = std::async(std::launch::async, [&]{
-      int result = processObjects(context, arg.blocks);
+      // Proof of work of the whole batch is computed in background while blocks are added one by one
+      m_core.prepare_incoming_blocks(blocks);
+      int result = processObjects(received, failedConnection);
       m_dispatcher.remoteSpawn([&] {
         m_dispatcher.pushContext(currentContext);
       });
@@ -385,39 +705,50 @@ int cryptonote_protocol_handler::handle_response_get_objects(int command, NOTIFY
     });
 
     m_dispatcher.dispatch();
-    int result = resultFuture.get();
-    if (result != 0) {
-      return result;
+    if (resultFuture.get() != 0) {
+      // blocks after the failed one can't be added either, synchronizing connections start over
+      m_downloads.clear();
+      dropConnection(failedConnection, context);
+      break;
     }
-  }
 
-  uint64_t height;
-  crypto::hash top;
-  m_core.get_blockchain_top(height, top);
-  logger(INFO, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
+    uint64_t height;
+    crypto::hash top;
+    m_core.get_blockchain_top(height, top);
+    logger(INFO, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
+  }
+}
 
-  if (!m_stop && context.m_state == cryptonote_connection_context::state_synchronizing) {
-    request_missing_objects(context, true);
+void cryptonote_protocol_handler::dropConnection(const BlockDownloadScheduler::ConnectionId& connection, cryptonote_connection_context& context) {
+  if (connection == context.m_connection_id) {
+    context.m_state = cryptonote_connection_context::state_shutdown;
+    return;
   }
 
-  return 1;
+  m_p2p->for_each_connection([&connection](cryptonote_connection_context& ctx, peerid_type peerId) {
+    if (ctx.m_connection_id == connection) {
+      ctx.m_state = cryptonote_connection_context::state_shutdown;
+    }
+  });
 }
 
-int cryptonote_protocol_handler::processObjects(cryptonote_connection_context& context, const std::list<block_complete_entry>& blocks) {
+int cryptonote_protocol_handler::processObjects(const std::vector<BlockDownloadScheduler::ReceivedBlock>& blocks, BlockDownloadScheduler::ConnectionId& failedConnection) {
 
-  for (const block_complete_entry& block_entry : blocks) {
+  for (const BlockDownloadScheduler::ReceivedBlock& received : blocks) {
     if (m_stop) {
       break;
     }
 
+    const block_complete_entry& block_entry = received.block;
+    failedConnection = received.source;
+
     //process transactions
     for (auto& tx_blob : block_entry.txs) {
       tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
       m_core.handle_incoming_tx(tx_blob, tvc, true);
       if (tvc.m_verifivation_failed) {
-        logger(Logging::ERROR) << context << "transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
+        logger(Logging::ERROR) << "transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
           << Common::podToHex(get_blob_hash(tx_blob)) << ", dropping connection";
-        context.m_state = cryptonote_connection_context::state_shutdown;
         return 1;
       }
     }
@@ -427,17 +758,14 @@ int cryptonote_protocol_handler::processObjects(cryptonote_connection_context& c
     m_core.handle_incoming_block_blob(block_entry.block, bvc, false, false);
 
     if (bvc.m_verifivation_failed) {
-      logger(Logging::DEBUGGING) << context << "Block verification failed, dropping connection";
-      context.m_state = cryptonote_connection_context::state_shutdown;
+      logger(Logging::DEBUGGING) << "Block verification failed, dropping connection";
       return 1;
     } else if (bvc.m_marked_as_orphaned) {
-      logger(Logging::INFO) << context << "Block received at sync phase was marked as orphaned, dropping connection";
-      context.m_state = cryptonote_connection_context::state_shutdown;
+      logger(Logging::INFO) << "Block received at sync phase was marked as orphaned, dropping connection";
       return 1;
     } else if (bvc.m_already_exists) {
-      logger(Logging::DEBUGGING) << context << "Block already exists, switching to idle state";
-      context.m_state = cryptonote_connection_context::state_idle;
-      return 1;
+      // the block was relayed meanwhile
+      logger(Logging::DEBUGGING) << "Block already exists";
     }
   }
 
@@ -447,11 +775,18 @@ int cryptonote_protocol_handler::processObjects(cryptonote_connection_context& c
 
 
 bool cryptonote_protocol_handler::on_idle() {
+  sendTransactionAnnouncements();
+  requestAnnouncedTransactions();
+  expireBlockHeadersRequests();
   return m_core.on_idle();
 }
 
 int cryptonote_protocol_handler::handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, cryptonote_connection_context& context) {
   logger(Logging::TRACE) << context << "NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << arg.block_ids.size();
+  if (!throttleRequest(context, REQUEST_CHAIN_COST)) {
+    return 1;
+  }
+
   NOTIFY_RESPONSE_CHAIN_ENTRY::request r;
   if (!m_core.find_blockchain_supplement(arg.block_ids, r)) {
     logger(Logging::ERROR) << context << "Failed to handle NOTIFY_REQUEST_CHAIN.";
@@ -463,27 +798,62 @@ int cryptonote_protocol_handler::handle_request_chain(int command, NOTIFY_REQUES
 }
 
 bool cryptonote_protocol_handler::request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks) {
-  if (context.m_needed_objects.size()) {
-    //we know objects that we need, request this objects
-    NOTIFY_REQUEST_GET_OBJECTS::request req;
-    size_t count = 0;
-    auto it = context.m_needed_objects.begin();
-
-    while (it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT) {
-      if (!(check_having_blocks && m_core.have_block(*it))) {
-        req.blocks.push_back(*it);
-        ++count;
-        context.m_requested_objects.insert(*it);
+  NOTIFY_REQUEST_GET_OBJECTS::request req;
+  auto now = BlockDownloadScheduler::Clock::now();
+  // response is limited by packet size, half of it is left for error of block size estimation
+  size_t count = context.m_transfer_statistics.blocksPerRequest(std::chrono::seconds(BLOCKS_SYNCHRONIZING_RESPONSE_TIME),
+    P2P_DEFAULT_PACKET_MAX_SIZE / 2, BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT);
+  // leading positions nothing is awaited from this connection for are dropped
+  bool dropping = true;
+  auto range = context.m_needed_objects.begin();
+  while (range != context.m_needed_objects.end() && req.blocks.size() < count) {
+    for (uint64_t position = range->first; position < range->second && req.blocks.size() < count; ++position) {
+      crypto::hash id;
+      // false if already committed, requested from this connection or dropped after a failed block
+      bool awaited = m_downloads.getAwaitedBlockId(position, context.m_connection_id, id);
+      if (awaited && check_having_blocks && m_core.have_block(id)) {
+        m_downloads.remove(id);
+        awaited = false;
+      }
+
+      if (awaited && m_downloads.assign(id, context.m_connection_id, now)) {
+        req.blocks.push_back(id);
+        awaited = false;
+      }
+
+      if (awaited) {
+        // requested from another connection, kept in case it stalls
+        dropping = false;
+      } else if (dropping) {
+        range->first = position + 1;
       }
-      context.m_needed_objects.erase(it++);
     }
+
+    if (range->first == range->second) {
+      range = context.m_needed_objects.erase(range);
+    } else {
+      ++range;
+    }
+  }
+
+  if (!req.blocks.empty()) {
+    context.m_requested_objects.insert(context.m_requested_objects.end(), req.blocks.begin(), req.blocks.end());
+    std::sort(context.m_requested_objects.begin(), context.m_requested_objects.end(), hashLess);
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
+    context.m_transfer_statistics.requestSent(PeerTransferStatistics::Clock::now());
     post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+  } else if (!context.m_requested_objects.empty()) {
+    // response is awaited
+  } else if (!context.m_needed_objects.empty()) {
+    // everything this connection can send is being downloaded from others, timed sync resumes synchronization
+    context.m_state = cryptonote_connection_context::state_idle;
+    logger(Logging::DEBUGGING) << context << "Connection set to idle state.";
   } else if (context.m_last_response_height < context.m_remote_blockchain_height - 1) {//we have to fetch more objects ids, request blockchain entry
 
     NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
     m_core.get_short_chain_history(r.block_ids);
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
+    context.m_transfer_statistics.requestSent(PeerTransferStatistics::Clock::now());
     post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
   } else {
     if (!(context.m_last_response_height ==
@@ -494,7 +864,7 @@ bool cryptonote_protocol_handler::request_missing_objects(cryptonote_connection_
         << "request_missing_blocks final condition failed!"
         << "\r\nm_last_response_height=" << context.m_last_response_height
         << "\r\nm_remote_blockchain_height=" << context.m_remote_blockchain_height
-        << "\r\nm_needed_objects.size()=" << context.m_needed_objects.size()
+        << "\r\nm_needed_objects ranges=" << context.m_needed_objects.size()
         << "\r\nm_requested_objects.size()=" << context.m_requested_objects.size() 
         << "\r\non connection [" << context << "]";
       return false;
@@ -527,6 +897,8 @@ int cryptonote_protocol_handler::handle_response_chain_entry(int command, NOTIFY
   logger(Logging::TRACE) << context << "NOTIFY_RESPONSE_CHAIN_ENTRY: m_block_ids.size()=" << arg.m_block_ids.size()
     << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height;
 
+  context.m_transfer_statistics.idsReceived(PeerTransferStatistics::Clock::now(), arg.m_block_ids.size() * sizeof(crypto::hash));
+
   if (!arg.m_block_ids.size()) {
     logger(Logging::ERROR) << context << "sent empty m_block_ids, dropping connection";
     context.m_state = cryptonote_connection_context::state_shutdown;
@@ -554,23 +926,371 @@ int cryptonote_protocol_handler::handle_response_chain_entry(int command, NOTIFY
     context.m_state = cryptonote_connection_context::state_shutdown;
   }
 
+  std::vector<crypto::hash> neededIds;
+  // unknown ids after the known ones are a range of headers continuing the chain
+  bool neededIdsContinueChain = true;
   for (auto& bl_id : arg.m_block_ids) {
-    if (!m_core.have_block(bl_id))
-      context.m_needed_objects.push_back(bl_id);
+    if (!m_core.have_block(bl_id)) {
+      neededIds.push_back(bl_id);
+    } else if (!neededIds.empty()) {
+      neededIdsContinueChain = false;
+    }
+  }
+
+  if (context.m_version >= P2P_BLOCK_HEADERS_VERSION && !neededIds.empty() && neededIdsContinueChain) {
+    HeaderSync& sync = m_headerSyncs[context.m_connection_id];
+    sync.ids = std::move(neededIds);
+    sync.headers.clear();
+    requestBlockHeaders(context);
+    return 1;
   }
 
+  m_downloads.addBlockIds(neededIds, context.m_connection_id, context.m_needed_objects);
+
   request_missing_objects(context, false);
   return 1;
 }
 
+void cryptonote_protocol_handler::requestBlockHeaders(cryptonote_connection_context& context) {
+  HeaderSync& sync = m_headerSyncs[context.m_connection_id];
+  sync.requestTime = std::chrono::steady_clock::now();
+  NOTIFY_REQUEST_BLOCK_HEADERS::request req;
+  for (size_t i = sync.headers.size(); i < sync.ids.size() && req.blocks.size() < BLOCK_HEADERS_SYNCHRONIZING_COUNT; ++i) {
+    req.blocks.push_back(sync.ids[i]);
+  }
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_BLOCK_HEADERS: blocks.size()=" << req.blocks.size();
+  context.m_transfer_statistics.requestSent(PeerTransferStatistics::Clock::now());
+  post_notify<NOTIFY_REQUEST_BLOCK_HEADERS>(*m_p2p, req, context);
+}
+
+int cryptonote_protocol_handler::handle_request_block_headers(int command, NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_BLOCK_HEADERS: blocks.size()=" << arg.blocks.size();
+  if (arg.blocks.size() > BLOCK_HEADERS_SYNCHRONIZING_COUNT) {
+    logger(Logging::DEBUGGING) << context << "requested too many block headers, dropping connection";
+    context.m_state = cryptonote_connection_context::state_shutdown;
+    return 1;
+  }
+
+  if (!throttleRequest(context, REQUEST_BASE_COST + arg.blocks.size() * REQUEST_HEADER_COST)) {
+    return 1;
+  }
+
+  // half of the packet is left for blocks with many transaction hashes, the rest is requested again
+  NOTIFY_RESPONSE_BLOCK_HEADERS::request rsp;
+  size_t size = 0;
+  for (const crypto::hash& id : arg.blocks) {
+    Block b;
+    if (size >= P2P_DEFAULT_PACKET_MAX_SIZE / 2 || !m_core.getBlockByHash(id, b)) {
+      break;
+    }
+
+    rsp.blocks.push_back(block_to_blob(b));
+    size += rsp.blocks.back().size();
+  }
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_RESPONSE_BLOCK_HEADERS: blocks.size()=" << rsp.blocks.size();
+  post_notify<NOTIFY_RESPONSE_BLOCK_HEADERS>(*m_p2p, rsp, context);
+  return 1;
+}
+
+int cryptonote_protocol_handler::handle_response_block_headers(int command, NOTIFY_RESPONSE_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context) {
+  logger(Logging::TRACE) << context << "NOTIFY_RESPONSE_BLOCK_HEADERS: blocks.size()=" << arg.blocks.size();
+
+  uint64_t size = 0;
+  for (const blobdata& blob : arg.blocks) {
+    size += blob.size();
+  }
+
+  context.m_transfer_statistics.objectsReceived(PeerTransferStatistics::Clock::now(), size, arg.blocks.size());
+
+  auto it = m_headerSyncs.find(context.m_connection_id);
+  if (it == m_headerSyncs.end()) {
+    // request expired, blocks of the chain entry are downloaded already
+    logger(Logging::DEBUGGING) << context << "sent block headers after the request expired";
+    return 1;
+  }
+
+  size_t requested = std::min(it->second.ids.size() - it->second.headers.size(), BLOCK_HEADERS_SYNCHRONIZING_COUNT);
+  if (arg.blocks.empty() || arg.blocks.size() > requested) {
+    logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_BLOCK_HEADERS: blocks.size()=" << arg.blocks.size()
+      << ", requested " << requested << ", dropping connection";
+    context.m_state = cryptonote_connection_context::state_shutdown;
+    return 1;
+  }
+
+  HeaderSync& sync = it->second;
+  for (const blobdata& blob : arg.blocks) {
+    Block b;
+    if (!parse_and_validate_block_from_blob(blob, b) || get_block_hash(b) != sync.ids[sync.headers.size()]) {
+      logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_BLOCK_HEADERS: block " << sync.ids[sync.headers.size()]
+        << " wasn't returned, dropping connection";
+      context.m_state = cryptonote_connection_context::state_shutdown;
+      return 1;
+    }
+
+    sync.headers.push_back(std::move(b));
+  }
+
+  if (sync.headers.size() < sync.ids.size()) {
+    requestBlockHeaders(context);
+  } else {
+    checkBlockHeaders(context);
+  }
+
+  return 1;
+}
+
+// Proofs of work of all headers of the chain entry are checked at once on verification threads, blocks are downloaded
+// only for headers that passed
+void cryptonote_protocol_handler::checkBlockHeaders(cryptonote_connection_context& context) {
+  auto it = m_headerSyncs.find(context.m_connection_id);
+  HeaderSync sync = std::move(it->second);
+  m_headerSyncs.erase(it);
+
+  bool checked = false;
+  bool heavier = false;
+  auto currentContext = m_dispatcher.getCurrentContext();
+  auto resultFuture = std::async(std::launch::async, [&] {
+    bool result = m_core.check_block_headers(sync.headers, checked, heavier);
+    m_dispatcher.remoteSpawn([&] {
+      m_dispatcher.pushContext(currentContext);
+    });
+
+    return result;
+  });
+
+  m_dispatcher.dispatch();
+  if (!resultFuture.get()) {
+    logger(Logging::INFO) << context << "sent block headers that failed proof of work check, dropping connection";
+    context.m_state = cryptonote_connection_context::state_shutdown;
+    return;
+  }
+
+  if (m_stop || context.m_state != cryptonote_connection_context::state_synchronizing) {
+    return;
+  }
+
+  if (checked && !heavier && context.m_last_response_height + 1 >= context.m_remote_blockchain_height) {
+    // peer chain ends here and doesn't outweigh the local one, its blocks would not be switched to
+    logger(Logging::INFO) << context << "Peer chain is not heavier than the local one, its blocks are not downloaded";
+    context.m_state = cryptonote_connection_context::state_normal;
+    on_connection_synchronized();
+    return;
+  }
+
+  m_downloads.addBlockIds(sync.ids, context.m_connection_id, context.m_needed_objects);
+  request_missing_objects(context, false);
+}
+
+// A peer that doesn't send requested headers doesn't keep its connection synchronizing, blocks of its chain entry are
+// requested without checking the headers first, as from peers not accepting NOTIFY_REQUEST_BLOCK_HEADERS
+void cryptonote_protocol_handler::expireBlockHeadersRequests() {
+  auto now = std::chrono::steady_clock::now();
+  std::vector<net_connection_id> expired;
+  for (const auto& sync : m_headerSyncs) {
+    if (now - sync.second.requestTime >= m_blockHeadersRequestTimeout) {
+      expired.push_back(sync.first);
+    }
+  }
+
+  if (expired.empty()) {
+    return;
+  }
+
+  m_p2p->for_each_connection([&](cryptonote_connection_context& context, peerid_type peerId) {
+    auto it = m_headerSyncs.find(context.m_connection_id);
+    if (it == m_headerSyncs.end() || std::find(expired.begin(), expired.end(), context.m_connection_id) == expired.end()) {
+      return;
+    }
+
+    HeaderSync sync = std::move(it->second);
+    m_headerSyncs.erase(it);
+    if (m_stop || context.m_state != cryptonote_connection_context::state_synchronizing) {
+      return;
+    }
+
+    logger(Logging::DEBUGGING) << context << "Block headers weren't received in time, blocks are requested without checking them";
+    m_downloads.addBlockIds(sync.ids, context.m_connection_id, context.m_needed_objects);
+    request_missing_objects(context, false);
+  });
+
+  for (const net_connection_id& connection : expired) {
+    m_headerSyncs.erase(connection);
+  }
+}
+
 void cryptonote_protocol_handler::relay_block(NOTIFY_NEW_BLOCK::request& arg) {
-  auto buf = LevinProtocol::encode(arg);
-  m_p2p->externalRelayNotifyToAll(NOTIFY_NEW_BLOCK::ID, buf);
+  // called from external threads, connections are enumerated in the dispatcher thread
+  m_dispatcher.remoteSpawn([this, arg]() mutable {
+    rememberSeenBlock(arg.b.block);
+    relayBlock(arg, nullptr);
+  });
+}
+
+// Copies of a block relayed by several peers are byte for byte the same, so the hash of the blob identifies them
+// before the block is parsed and its transactions are looked up
+bool cryptonote_protocol_handler::isBlockSeen(const blobdata& blob) {
+  if (m_seenBlocks.count(crypto::cn_fast_hash(blob.data(), blob.size())) == 0) {
+    return false;
+  }
+
+  Common::MetricsRegistry::global().counter("p2p_duplicate_blocks_total", "Relayed blocks dropped as already processed").increment();
+  return true;
+}
+
+void cryptonote_protocol_handler::rememberSeenBlock(const blobdata& blob) {
+  crypto::hash blobHash = crypto::cn_fast_hash(blob.data(), blob.size());
+  if (!m_seenBlocks.insert(blobHash).second) {
+    return;
+  }
+
+  m_seenBlocksOrder.push_back(blobHash);
+  if (m_seenBlocksOrder.size() > SEEN_BLOCKS_MAX_COUNT) {
+    m_seenBlocks.erase(m_seenBlocksOrder.front());
+    m_seenBlocksOrder.pop_front();
+  }
+}
+
+// Peers accepting compact blocks get the block without transactions, the rest get the full one
+void cryptonote_protocol_handler::relayBlock(NOTIFY_NEW_BLOCK::request& arg, const net_connection_id* excludeConnection) {
+  std::list<net_connection_id> compactPeers;
+  std::list<net_connection_id> fullPeers;
+  m_p2p->for_each_connection([&](cryptonote_connection_context& context, peerid_type peerId) {
+    if (peerId && (excludeConnection == nullptr || context.m_connection_id != *excludeConnection)) {
+      (context.m_version >= P2P_COMPACT_BLOCKS_VERSION ? compactPeers : fullPeers).push_back(context.m_connection_id);
+    }
+  });
+
+  if (!compactPeers.empty()) {
+    NOTIFY_NEW_COMPACT_BLOCK::request compact;
+    compact.block = arg.b.block;
+    compact.current_blockchain_height = arg.current_blockchain_height;
+    compact.hop = arg.hop;
+    m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, LevinProtocol::encode(compact), compactPeers);
+  }
+
+  if (fullPeers.empty()) {
+    return;
+  }
+
+  // block received as compact one has no transactions attached, they are in the blockchain already
+  if (arg.b.txs.empty()) {
+    Block b;
+    if (!parse_and_validate_block_from_blob(arg.b.block, b)) {
+      return;
+    }
+
+    NOTIFY_REQUEST_GET_OBJECTS::request objects;
+    objects.txs.assign(b.txHashes.begin(), b.txHashes.end());
+    NOTIFY_RESPONSE_GET_OBJECTS::request found;
+    if (!m_core.handle_get_objects(objects, found) || found.txs.size() != b.txHashes.size()) {
+      logger(Logging::DEBUGGING) << "Block transactions not found, block isn't relayed to peers not accepting compact blocks";
+      return;
+    }
+
+    arg.b.txs = std::move(found.txs);
+  }
+
+  m_p2p->relay_notify_to_list(NOTIFY_NEW_BLOCK::ID, LevinProtocol::encode(arg), fullPeers);
 }
 
 void cryptonote_protocol_handler::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg) {
-  auto buf = LevinProtocol::encode(arg);
-  m_p2p->externalRelayNotifyToAll(NOTIFY_NEW_TRANSACTIONS::ID, buf);
+  // called from external threads, connections are enumerated in the dispatcher thread
+  m_dispatcher.remoteSpawn([this, arg]() mutable {
+    relayTransactions(arg, nullptr);
+  });
+}
+
+// Peers accepting announcements get transaction hashes with the next batch sent by on_idle, the rest get transactions
+void cryptonote_protocol_handler::relayTransactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const net_connection_id* excludeConnection) {
+  std::vector<crypto::hash> txHashes;
+  txHashes.reserve(arg.txs.size());
+  for (const blobdata& txBlob : arg.txs) {
+    txHashes.push_back(get_blob_hash(txBlob));
+  }
+
+  std::list<net_connection_id> fullPeers;
+  m_p2p->for_each_connection([&](cryptonote_connection_context& context, peerid_type peerId) {
+    if (peerId && (excludeConnection == nullptr || context.m_connection_id != *excludeConnection)) {
+      if (context.m_version >= P2P_TX_ANNOUNCE_VERSION) {
+        context.m_tx_announcements.insert(context.m_tx_announcements.end(), txHashes.begin(), txHashes.end());
+      } else {
+        fullPeers.push_back(context.m_connection_id);
+      }
+    }
+  });
+
+  if (!fullPeers.empty()) {
+    m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, LevinProtocol::encode(arg), fullPeers);
+  }
+}
+
+void cryptonote_protocol_handler::sendTransactionAnnouncements() {
+  std::vector<std::pair<net_connection_id, NOTIFY_TX_ANNOUNCE::request>> announcements;
+  m_p2p->for_each_connection([&](cryptonote_connection_context& context, peerid_type peerId) {
+    if (!context.m_tx_announcements.empty()) {
+      announcements.emplace_back(context.m_connection_id, NOTIFY_TX_ANNOUNCE::request());
+      announcements.back().second.txs.assign(context.m_tx_announcements.begin(), context.m_tx_announcements.end());
+      context.m_tx_announcements.clear();
+    }
+  });
+
+  // connections can be closed while announcements are written, so they are sent after enumeration
+  for (auto& announcement : announcements) {
+    m_p2p->relay_notify_to_list(NOTIFY_TX_ANNOUNCE::ID, LevinProtocol::encode(announcement.second), std::list<net_connection_id>{ announcement.first });
+  }
+}
+
+// A peer that doesn't send an announced transaction in time doesn't hold it back, the transaction is requested from the
+// next peer which announced it and forgotten when none is left
+void cryptonote_protocol_handler::requestAnnouncedTransactions() {
+  auto now = std::chrono::steady_clock::now();
+  std::map<net_connection_id, NOTIFY_REQUEST_TXS::request> requests;
+  for (auto it = m_requestedTransactions.begin(); it != m_requestedTransactions.end();) {
+    RequestedTransaction& requested = it->second;
+    if (now - requested.time < m_txRequestTimeout) {
+      ++it;
+    } else if (requested.announcers.empty()) {
+      it = m_requestedTransactions.erase(it);
+    } else {
+      requested.connection = requested.announcers.front();
+      requested.time = now;
+      requested.announcers.pop_front();
+      requests[requested.connection].txs.push_back(it->first);
+      ++it;
+    }
+  }
+
+  for (auto& request : requests) {
+    logger(Logging::TRACE) << "-->>NOTIFY_REQUEST_TXS: txs.size()=" << request.second.txs.size() << " after request timeout";
+    m_p2p->relay_notify_to_list(NOTIFY_REQUEST_TXS::ID, LevinProtocol::encode(request.second), std::list<net_connection_id>{ request.first });
+  }
+}
+
+// Requests of a peer wait until the work of its previous ones is paid back, so other peers are served meanwhile.
+// Handlers run in the coroutine of the peer's connection, waiting there holds back only that peer.
+bool cryptonote_protocol_handler::throttleRequest(cryptonote_connection_context& context, uint64_t cost) {
+  if (!context.m_request_budget.isLimited()) {
+    return true;
+  }
+
+  auto delay = context.m_request_budget.getDelay(Common::TokenBucket::Clock::now());
+  if (delay > REQUEST_MAX_DELAY) {
+    logger(Logging::INFO) << context << "Peer requests too much work, dropping connection";
+    context.m_state = cryptonote_connection_context::state_shutdown;
+    return false;
+  }
+
+  if (delay > Common::TokenBucket::Clock::duration::zero()) {
+    logger(Logging::DEBUGGING) << context << "Request is delayed by " <<
+      std::chrono::duration_cast<std::chrono::milliseconds>(delay).count() << " ms";
+    Common::MetricsRegistry::global().counter("p2p_throttled_requests_total", "P2P requests delayed by per peer work limits").increment();
+    System::Timer(m_dispatcher).sleep(std::chrono::duration_cast<std::chrono::nanoseconds>(delay));
+  }
+
+  context.m_request_budget.charge(cost, Common::TokenBucket::Clock::now());
+  return true;
 }
 
 void cryptonote_protocol_handler::updateObservedHeight(uint64_t peerHeight, const cryptonote_connection_context& context) {
@@ -18,12 +18,18 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <boost/program_options/variables_map.hpp>
 #include <Common/ObserverManager.h>
 
 #include "cryptonote_core/ICore.h"
 
+#include "cryptonote_protocol/BlockDownloadScheduler.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler_common.h"
 #include "cryptonote_protocol/ICryptonoteProtocolObserver.h"
@@ -58,6 +64,13 @@ namespace CryptoNote
     virtual bool removeObserver(ICryptonoteProtocolObserver* observer);
 
     void set_p2p_endpoint(i_p2p_endpoint* p2p);
+    // Work units a peer may spend on requests per second and at once, 0 rate disables the limit. Applies to
+    // connections opened afterwards.
+    void set_request_limits(uint64_t rate, uint64_t burst);
+    // Announced transaction not received in this time is requested from the next peer which announced it
+    void set_tx_request_timeout(std::chrono::seconds timeout);
+    // Blocks of a chain entry whose headers aren't received in this time are requested without checking the headers
+    void set_block_headers_request_timeout(std::chrono::seconds timeout);
     // ICore& get_core() { return m_core; }
     bool is_synchronized() const { return m_synchronized; }
     void log_connections();
@@ -83,6 +96,13 @@ namespace CryptoNote
     int handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context);
     int handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, cryptonote_connection_context& context);
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_request_block_transactions(int command, NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request& arg, cryptonote_connection_context& context);
+    int handle_response_block_transactions(int command, NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request& arg, cryptonote_connection_context& context);
+    int handle_notify_tx_announce(int command, NOTIFY_TX_ANNOUNCE::request& arg, cryptonote_connection_context& context);
+    int handle_request_txs(int command, NOTIFY_REQUEST_TXS::request& arg, cryptonote_connection_context& context);
+    int handle_request_block_headers(int command, NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context);
+    int handle_response_block_headers(int command, NOTIFY_RESPONSE_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context);
 
     //----------------- i_cryptonote_protocol ----------------------------------
     virtual void relay_block(NOTIFY_NEW_BLOCK::request& arg) override;
@@ -91,10 +111,23 @@ namespace CryptoNote
     //----------------------------------------------------------------------------------
     uint64_t get_current_blockchain_height();
     bool request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks);
+    void requestBlockHeaders(cryptonote_connection_context& context);
+    void checkBlockHeaders(cryptonote_connection_context& context);
+    void expireBlockHeadersRequests();
     bool on_connection_synchronized();
     void updateObservedHeight(uint64_t peerHeight, const cryptonote_connection_context& context);
     void recalculateMaxObservedHeight(const cryptonote_connection_context& context);
-    int processObjects(cryptonote_connection_context& context, const std::list<block_complete_entry>& blocks);
+    void commitReceivedBlocks(cryptonote_connection_context& context);
+    int processObjects(const std::vector<BlockDownloadScheduler::ReceivedBlock>& blocks, BlockDownloadScheduler::ConnectionId& failedConnection);
+    void dropConnection(const BlockDownloadScheduler::ConnectionId& connection, cryptonote_connection_context& context);
+    void processNewBlock(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& context);
+    void relayBlock(NOTIFY_NEW_BLOCK::request& arg, const net_connection_id* excludeConnection);
+    void relayTransactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const net_connection_id* excludeConnection);
+    void sendTransactionAnnouncements();
+    void requestAnnouncedTransactions();
+    bool throttleRequest(cryptonote_connection_context& context, uint64_t cost);
+    bool isBlockSeen(const blobdata& blob);
+    void rememberSeenBlock(const blobdata& blob);
     Logging::LoggerRef logger;
 
   private:
@@ -112,6 +145,44 @@ namespace CryptoNote
     uint64_t m_observedHeight;
 
     std::atomic<size_t> m_peersCount;
+    uint64_t m_requestRate;
+    uint64_t m_requestBurst;
+    std::chrono::seconds m_txRequestTimeout;
+    std::chrono::seconds m_blockHeadersRequestTimeout;
+    // Blocks are downloaded from all synchronizing connections at once and committed in order by one of them
+    BlockDownloadScheduler m_downloads;
+    bool m_committingBlocks;
+
+    struct PendingBlock {
+      NOTIFY_NEW_COMPACT_BLOCK::request notification;
+      net_connection_id connection;
+    };
+
+    // Compact blocks waiting for missing transactions, at most one per connection
+    std::unordered_map<crypto::hash, PendingBlock> m_pendingBlocks;
+    struct RequestedTransaction {
+      net_connection_id connection;
+      std::chrono::steady_clock::time_point time;
+      // other peers which announced the transaction, asked in turn if the requested one doesn't send it in time
+      std::deque<net_connection_id> announcers;
+    };
+
+    // Announced transactions requested from a peer, they aren't requested from others until m_txRequestTimeout
+    std::unordered_map<crypto::hash, RequestedTransaction> m_requestedTransactions;
+    struct HeaderSync {
+      // ids of a chain entry not known locally, in chain order
+      std::vector<crypto::hash> ids;
+      // headers received for the leading ids
+      std::vector<Block> headers;
+      std::chrono::steady_clock::time_point requestTime;
+    };
+
+    // Chain entries of synchronizing connections whose headers are being downloaded, blocks are requested only after
+    // all headers of an entry pass proof of work checks
+    std::map<net_connection_id, HeaderSync> m_headerSyncs;
+    // Hashes of block blobs processed or relayed lately, oldest first in m_seenBlocksOrder
+    std::unordered_set<crypto::hash> m_seenBlocks;
+    std::deque<crypto::hash> m_seenBlocksOrder;
     tools::ObserverManager<ICryptonoteProtocolObserver> m_observerManager;
   };
 }
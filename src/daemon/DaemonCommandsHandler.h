@@ -67,6 +67,14 @@ private:
   bool print_tx(const std::vector<std::string>& args);
   bool print_pool(const std::vector<std::string>& args);
   bool print_pool_sh(const std::vector<std::string>& args);
+  bool print_cache(const std::vector<std::string>& args);
+  bool set_cache(const std::vector<std::string>& args);
+  bool print_profile(const std::vector<std::string>& args);
+  bool set_profile(const std::vector<std::string>& args);
+  bool export_blocks(const std::vector<std::string>& args);
+  bool import_blocks(const std::vector<std::string>& args);
+  bool save_snapshot(const std::vector<std::string>& args);
+  bool export_chain(const std::vector<std::string>& args);
   bool start_mining(const std::vector<std::string>& args);
   bool stop_mining(const std::vector<std::string>& args);
 };
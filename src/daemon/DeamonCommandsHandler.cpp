@@ -17,7 +17,10 @@
 
 #include "DaemonCommandsHandler.h"
 
+#include "Common/StageProfiler.h"
 #include "p2p/net_node.h"
+#include "cryptonote_core/BlocksBootstrap.h"
+#include "cryptonote_core/ChainExport.h"
 #include "cryptonote_core/miner.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
@@ -48,6 +51,14 @@ DaemonCommandsHandler::DaemonCommandsHandler(CryptoNote::core& core, CryptoNote:
   m_consoleHandler.setHandler("stop_mining", boost::bind(&DaemonCommandsHandler::stop_mining, this, _1), "Stop mining");
   m_consoleHandler.setHandler("print_pool", boost::bind(&DaemonCommandsHandler::print_pool, this, _1), "Print transaction pool (long format)");
   m_consoleHandler.setHandler("print_pool_sh", boost::bind(&DaemonCommandsHandler::print_pool_sh, this, _1), "Print transaction pool (short format)");
+  m_consoleHandler.setHandler("print_cache", boost::bind(&DaemonCommandsHandler::print_cache, this, _1), "Print blocks cache statistics");
+  m_consoleHandler.setHandler("set_cache", boost::bind(&DaemonCommandsHandler::set_cache, this, _1), "Resize blocks cache, set_cache <blocks> | <megabytes>MB");
+  m_consoleHandler.setHandler("print_profile", boost::bind(&DaemonCommandsHandler::print_profile, this, _1), "Print block verification stage timings");
+  m_consoleHandler.setHandler("set_profile", boost::bind(&DaemonCommandsHandler::set_profile, this, _1), "Turn block verification profiling on or off, set_profile on | off");
+  m_consoleHandler.setHandler("export_blocks", boost::bind(&DaemonCommandsHandler::export_blocks, this, _1), "Write blocks to a bootstrap file, export_blocks <file> [<end_height>]");
+  m_consoleHandler.setHandler("import_blocks", boost::bind(&DaemonCommandsHandler::import_blocks, this, _1), "Add blocks from a bootstrap file, import_blocks <file> [fast]");
+  m_consoleHandler.setHandler("export_chain", boost::bind(&DaemonCommandsHandler::export_chain, this, _1), "Write block headers or key outputs for analysis, export_chain blocks | outputs <file> [csv | binary] [<start_height> [<end_height>]]");
+  m_consoleHandler.setHandler("save_snapshot", boost::bind(&DaemonCommandsHandler::save_snapshot, this, _1), "Write blockchain snapshot bundle for --load-snapshot, save_snapshot <directory>");
   m_consoleHandler.setHandler("show_hr", boost::bind(&DaemonCommandsHandler::show_hr, this, _1), "Start showing hash rate");
   m_consoleHandler.setHandler("hide_hr", boost::bind(&DaemonCommandsHandler::hide_hr, this, _1), "Stop showing hash rate");
   m_consoleHandler.setHandler("set_log", boost::bind(&DaemonCommandsHandler::set_log, this, _1), "set_log <level> - Change current log detalization level, <level> is a number 0-4");
@@ -288,6 +299,127 @@ bool DaemonCommandsHandler::print_pool_sh(const std::vector<std::string>& args)
   return true;
 }
 //--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::print_cache(const std::vector<std::string>& args)
+{
+  SwappedVectorCacheStatistics statistics = m_core.get_blocks_cache_statistics();
+  uint64_t requests = statistics.hits + statistics.misses;
+  std::cout << "Blocks cache: " << statistics.size << " of " << statistics.capacity << " blocks, hits: " << statistics.hits <<
+    ", misses: " << statistics.misses << " (" << std::fixed << std::setprecision(2) <<
+    (requests != 0 ? static_cast<double>(statistics.misses) / requests * 100 : 0.0) << "%)" << ENDL;
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::set_cache(const std::vector<std::string>& args)
+{
+  if (args.size() != 1) {
+    std::cout << "use: set_cache <blocks> | <megabytes>MB" << ENDL;
+    return true;
+  }
+
+  std::string size = args[0];
+  bool megabytes = size.size() > 2 && size.compare(size.size() - 2, 2, "MB") == 0;
+  if (megabytes) {
+    size.resize(size.size() - 2);
+  }
+
+  uint64_t value = 0;
+  if (!Common::fromString(size, value) || value == 0) {
+    std::cout << "wrong size format, use: set_cache <blocks> | <megabytes>MB" << ENDL;
+    return true;
+  }
+
+  bool result = megabytes ? m_core.set_blocks_cache_size(0, value * 1024 * 1024) : m_core.set_blocks_cache_size(static_cast<size_t>(value));
+  if (!result) {
+    std::cout << "failed to resize blocks cache" << ENDL;
+  }
+
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::print_profile(const std::vector<std::string>& args)
+{
+  if (!Common::StageProfiler::isEnabled()) {
+    std::cout << "Profiling is off, turn it on with set_profile on" << ENDL;
+  }
+
+  std::cout << Common::StageProfiler::format();
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::set_profile(const std::vector<std::string>& args)
+{
+  if (args.size() != 1 || (args[0] != "on" && args[0] != "off")) {
+    std::cout << "use: set_profile on | off" << ENDL;
+    return true;
+  }
+
+  Common::StageProfiler::setEnabled(args[0] == "on");
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::export_blocks(const std::vector<std::string>& args)
+{
+  uint64_t endHeight = 0;
+  if (args.empty() || args.size() > 2 || (args.size() == 2 && !Common::fromString(args[1], endHeight))) {
+    std::cout << "use: export_blocks <file> [<end_height>]" << ENDL;
+    return true;
+  }
+
+  CryptoNote::BlocksBootstrap bootstrap(m_core, m_logManager);
+  bootstrap.exportBlocks(args[0], endHeight);
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::import_blocks(const std::vector<std::string>& args)
+{
+  if (args.empty() || args.size() > 2 || (args.size() == 2 && args[1] != "fast")) {
+    std::cout << "use: import_blocks <file> [fast]" << ENDL;
+    return true;
+  }
+
+  CryptoNote::BlocksBootstrap bootstrap(m_core, m_logManager);
+  bootstrap.importBlocks(args[0], args.size() == 2);
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::save_snapshot(const std::vector<std::string>& args)
+{
+  if (args.size() != 1) {
+    std::cout << "use: save_snapshot <directory>" << ENDL;
+    return true;
+  }
+
+  if (!m_core.get_blockchain_storage().storeSnapshot(args[0])) {
+    std::cout << "failed to save blockchain snapshot" << ENDL;
+  }
+
+  return true;
+}
+//--------------------------------------------------------------------------------
+bool DaemonCommandsHandler::export_chain(const std::vector<std::string>& args)
+{
+  CryptoNote::ChainExportFormat format = CryptoNote::ChainExportFormat::CSV;
+  uint64_t startHeight = 0;
+  uint64_t endHeight = 0;
+  bool blocks = !args.empty() && args[0] == "blocks";
+  if (args.size() < 2 || (!blocks && args[0] != "outputs") || args.size() > (blocks ? 5 : 3) ||
+      (args.size() > 2 && !CryptoNote::ChainExport::parseFormat(args[2], format)) ||
+      (args.size() > 3 && !Common::fromString(args[3], startHeight)) ||
+      (args.size() > 4 && !Common::fromString(args[4], endHeight))) {
+    std::cout << "use: export_chain blocks | outputs <file> [csv | binary] [<start_height> [<end_height>]]" << ENDL;
+    return true;
+  }
+
+  CryptoNote::ChainExport chainExport(m_core.get_blockchain_storage(), m_logManager);
+  if (blocks) {
+    chainExport.exportBlocks(args[1], format, startHeight, endHeight);
+  } else {
+    chainExport.exportOutputs(args[1], format);
+  }
+
+  return true;
+}
+//--------------------------------------------------------------------------------
 bool DaemonCommandsHandler::start_mining(const std::vector<std::string> &args) {
   if (!args.size()) {
     std::cout << "Please, specify wallet address to mine for: start_mining <addr> [threads=1]" << std::endl;
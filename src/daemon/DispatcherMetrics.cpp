@@ -0,0 +1,55 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "DispatcherMetrics.h"
+
+using namespace Logging;
+
+DispatcherMetrics::DispatcherMetrics(Logging::ILogger& log, std::chrono::milliseconds slowContextThreshold) :
+  logger(log, "dispatcher"),
+  slowContextThreshold(slowContextThreshold),
+  runQueueLength(Common::MetricsRegistry::global().histogram("dispatcher_run_queue_length",
+    "Contexts waiting to run when the network thread resumes one")),
+  eventsWait(Common::MetricsRegistry::global().histogram("dispatcher_events_wait_microseconds",
+    "Time the network thread waited for events with nothing to run")),
+  slowContexts(Common::MetricsRegistry::global().counter("dispatcher_slow_contexts_total",
+    "Contexts that ran on the network thread longer than the slow context threshold")) {
+}
+
+void DispatcherMetrics::contextRan(std::chrono::nanoseconds duration, const char* site) {
+  Common::MetricHistogram*& runTime = contextRunTimes[site];
+  if (runTime == nullptr) {
+    runTime = &Common::MetricsRegistry::global().histogram("dispatcher_context_run_microseconds",
+      "Time contexts ran on the network thread between blocking operations, by spawn site",
+      { { "site", site != nullptr ? site : "untagged" } });
+  }
+
+  runTime->observe(std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+  if (duration >= slowContextThreshold) {
+    slowContexts.increment();
+    logger(WARNING) << "Context spawned at " << (site != nullptr ? site : "untagged site") << " ran for " <<
+      std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << " ms without yielding the network thread";
+  }
+}
+
+void DispatcherMetrics::contextResumed(std::size_t runQueueLength) {
+  this->runQueueLength.observe(static_cast<uint64_t>(runQueueLength));
+}
+
+void DispatcherMetrics::eventsWaited(std::chrono::nanoseconds duration) {
+  eventsWait.observe(std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <unordered_map>
+
+#include "Common/Metrics.h"
+#include "Logging/LoggerRef.h"
+#include "System/DispatcherTracer.h"
+
+// Exports scheduling of the daemon dispatcher as metrics and warns about contexts that hold it longer than the
+// threshold, so handlers starving the event loop can be found by their spawn sites
+class DispatcherMetrics : public System::DispatcherTracer {
+public:
+  DispatcherMetrics(Logging::ILogger& log, std::chrono::milliseconds slowContextThreshold);
+
+  virtual void contextRan(std::chrono::nanoseconds duration, const char* site) override;
+  virtual void contextResumed(std::size_t runQueueLength) override;
+  virtual void eventsWaited(std::chrono::nanoseconds duration) override;
+
+private:
+  Logging::LoggerRef logger;
+  std::chrono::nanoseconds slowContextThreshold;
+  Common::MetricHistogram& runQueueLength;
+  Common::MetricHistogram& eventsWait;
+  Common::MetricCounter& slowContexts;
+  // sites are string literals, so their addresses identify them
+  std::unordered_map<const char*, Common::MetricHistogram*> contextRunTimes;
+};
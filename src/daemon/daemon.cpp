@@ -20,10 +20,13 @@
 #include <boost/program_options.hpp>
 
 #include "DaemonCommandsHandler.h"
+#include "DispatcherMetrics.h"
 
 #include "Common/SignalHandler.h"
 #include "Common/PathTools.h"
+#include "Common/ThreadTopology.h"
 #include "crypto/hash.h"
+#include "cryptonote_core/ChainExport.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/CoreConfig.h"
 #include "cryptonote_core/Currency.h"
@@ -35,6 +38,8 @@
 #include "rpc/RpcServerConfig.h"
 #include "version.h"
 
+#include <System/Timer.h>
+
 #include <Logging/LoggerManager.h>
 
 #if defined(WIN32)
@@ -56,6 +61,35 @@ namespace
   const command_line::arg_descriptor<bool>        arg_console     = {"no-console", "Disable daemon console commands"};
   const command_line::arg_descriptor<bool>        arg_testnet_on  = {"testnet", "Used to deploy test nets. Checkpoints and hardcoded seeds are ignored, "
     "network id is changed. Use it with --data-dir flag. The wallet must be launched with --testnet flag.", false};
+  const command_line::arg_descriptor<bool>        arg_trace_dispatcher = {"trace-dispatcher", "Export network thread scheduling metrics and warn about contexts holding it"};
+  const command_line::arg_descriptor<uint32_t>    arg_slow_context_ms  = {"slow-context-ms", "Warn about contexts running on the network thread longer than this, with --trace-dispatcher", 100};
+  const command_line::arg_descriptor<std::string> arg_export_blocks    = {"export-blocks", "Write block headers of the data directory to <arg> and exit without starting the node", ""};
+  const command_line::arg_descriptor<std::string> arg_export_outputs   = {"export-outputs", "Write key outputs of the data directory to <arg> and exit without starting the node", ""};
+  const command_line::arg_descriptor<std::string> arg_export_format    = {"export-format", "Format of --export-blocks and --export-outputs, csv or binary (a file per column)", "csv"};
+  const command_line::arg_descriptor<std::string> arg_miner_cpus       = {"miner-cpus", "CPUs mining threads run on, e.g. 0-3,6, any if not set", ""};
+  const command_line::arg_descriptor<std::string> arg_miner_priority   = {"miner-priority", "Priority of mining threads, low, normal or high", "low"};
+  const command_line::arg_descriptor<std::string> arg_network_cpus     = {"network-cpus", "CPUs the network thread runs on, any if not set", ""};
+  const command_line::arg_descriptor<std::string> arg_network_priority = {"network-priority", "Priority of the network thread", "normal"};
+  const command_line::arg_descriptor<std::string> arg_verification_cpus     = {"verification-cpus", "CPUs block verification threads run on, any if not set", ""};
+  const command_line::arg_descriptor<std::string> arg_verification_priority = {"verification-priority", "Priority of block verification threads", "normal"};
+  const command_line::arg_descriptor<std::string> arg_record_traffic   = {"record-traffic", "Append inbound P2P commands and RPC requests to <arg> for replay with traffic_replay", ""};
+
+  // How often a replica looks for blocks of the node it follows
+  const std::chrono::seconds REPLICA_REFRESH_INTERVAL(1);
+
+  void initThreadPlacement(const po::variables_map& vm, Common::ThreadClass threadClass,
+    const command_line::arg_descriptor<std::string>& cpusArg, const command_line::arg_descriptor<std::string>& priorityArg) {
+    Common::ThreadPlacement placement;
+    if (!Common::ThreadTopology::parseCpus(command_line::get_arg(vm, cpusArg), placement.cpus)) {
+      throw std::runtime_error("Wrong CPU set in --" + std::string(cpusArg.name));
+    }
+
+    if (!Common::ThreadTopology::parsePriority(command_line::get_arg(vm, priorityArg), placement.priority)) {
+      throw std::runtime_error("Wrong priority in --" + std::string(priorityArg.name));
+    }
+
+    Common::ThreadTopology::global().setPlacement(threadClass, placement);
+  }
 }
 
 bool command_line_preprocessor(const boost::program_options::variables_map& vm, LoggerRef& logger);
@@ -70,6 +104,7 @@ JsonValue buildLoggerConfiguration(Level level, const std::string& logfile) {
   fileLogger.insert("type", "file");
   fileLogger.insert("filename", logfile);
   fileLogger.insert("level", static_cast<int64_t>(TRACE));
+  fileLogger.insert("async", JsonValue(true));
 
   JsonValue& consoleLogger = cfgLoggers.pushBack(JsonValue::OBJECT);
   consoleLogger.insert("type", "console");
@@ -106,6 +141,18 @@ int main(int argc, char* argv[])
     command_line::add_arg(desc_cmd_sett, arg_log_level);
     command_line::add_arg(desc_cmd_sett, arg_console);
     command_line::add_arg(desc_cmd_sett, arg_testnet_on);
+    command_line::add_arg(desc_cmd_sett, arg_trace_dispatcher);
+    command_line::add_arg(desc_cmd_sett, arg_slow_context_ms);
+    command_line::add_arg(desc_cmd_sett, arg_export_blocks);
+    command_line::add_arg(desc_cmd_sett, arg_export_outputs);
+    command_line::add_arg(desc_cmd_sett, arg_export_format);
+    command_line::add_arg(desc_cmd_sett, arg_miner_cpus);
+    command_line::add_arg(desc_cmd_sett, arg_miner_priority);
+    command_line::add_arg(desc_cmd_sett, arg_network_cpus);
+    command_line::add_arg(desc_cmd_sett, arg_network_priority);
+    command_line::add_arg(desc_cmd_sett, arg_verification_cpus);
+    command_line::add_arg(desc_cmd_sett, arg_verification_priority);
+    command_line::add_arg(desc_cmd_sett, arg_record_traffic);
 
     RpcServerConfig::initOptions(desc_cmd_sett);
     CoreConfig::initOptions(desc_cmd_sett);
@@ -200,23 +247,72 @@ int main(int argc, char* argv[])
     RpcServerConfig rpcConfig;
     rpcConfig.init(vm);
 
+    // placement of threads started by components has to be known before they are created
+    initThreadPlacement(vm, Common::ThreadClass::MINER, arg_miner_cpus, arg_miner_priority);
+    initThreadPlacement(vm, Common::ThreadClass::NETWORK, arg_network_cpus, arg_network_priority);
+    initThreadPlacement(vm, Common::ThreadClass::VERIFICATION, arg_verification_cpus, arg_verification_priority);
+
     System::Dispatcher dispatcher;
+    std::unique_ptr<DispatcherMetrics> dispatcherMetrics;
+    if (command_line::get_arg(vm, arg_trace_dispatcher)) {
+      dispatcherMetrics.reset(new DispatcherMetrics(logManager, std::chrono::milliseconds(command_line::get_arg(vm, arg_slow_context_ms))));
+      dispatcher.setTracer(dispatcherMetrics.get());
+    }
 
     CryptoNote::cryptonote_protocol_handler cprotocol(currency, dispatcher, ccore, nullptr, logManager);
     CryptoNote::node_server p2psrv(dispatcher, cprotocol, logManager);
-    CryptoNote::RpcServer rpcServer(dispatcher, logManager, ccore, p2psrv);
+    CryptoNote::RpcServer rpcServer(dispatcher, logManager, ccore, p2psrv, rpcConfig.threadCount);
 
     cprotocol.set_p2p_endpoint(&p2psrv);
     ccore.set_cryptonote_protocol(&cprotocol);
     DaemonCommandsHandler dch(ccore, p2psrv, logManager);
 
-    // initialize objects
-    logger(INFO) << "Initializing p2p server...";
-    if (!p2psrv.init(netNodeConfig, testnet_mode)) {
-      logger(ERROR, BRIGHT_RED) << "Failed to initialize p2p server.";
-      return 1;
+    // offline export works over the data directory without network, so it may run next to a stopped node's files
+    std::string exportBlocksPath = command_line::get_arg(vm, arg_export_blocks);
+    std::string exportOutputsPath = command_line::get_arg(vm, arg_export_outputs);
+    if (!exportBlocksPath.empty() || !exportOutputsPath.empty()) {
+      ChainExportFormat format;
+      if (!ChainExport::parseFormat(command_line::get_arg(vm, arg_export_format), format)) {
+        logger(ERROR, BRIGHT_RED) << "Unknown export format " << command_line::get_arg(vm, arg_export_format);
+        return 1;
+      }
+
+      logger(INFO) << "Initializing core...";
+      if (!ccore.init(coreConfig, minerConfig, true)) {
+        logger(ERROR, BRIGHT_RED) << "Failed to initialize core";
+        return 1;
+      }
+
+      ChainExport chainExport(ccore.get_blockchain_storage(), logManager);
+      bool exported = (exportBlocksPath.empty() || chainExport.exportBlocks(exportBlocksPath, format, 0, 0)) &&
+        (exportOutputsPath.empty() || chainExport.exportOutputs(exportOutputsPath, format));
+      ccore.deinit();
+      ccore.set_cryptonote_protocol(NULL);
+      return exported ? 0 : 1;
+    }
+
+    // initialize objects, a replica neither connects to peers nor accepts them
+    if (!coreConfig.replica) {
+      logger(INFO) << "Initializing p2p server...";
+      if (!p2psrv.init(netNodeConfig, testnet_mode)) {
+        logger(ERROR, BRIGHT_RED) << "Failed to initialize p2p server.";
+        return 1;
+      }
+      logger(INFO) << "P2p server initialized OK";
+    }
+
+    Common::TrafficLogWriter trafficLog;
+    std::string trafficLogPath = command_line::get_arg(vm, arg_record_traffic);
+    if (!trafficLogPath.empty()) {
+      if (!trafficLog.open(trafficLogPath)) {
+        logger(ERROR, BRIGHT_RED) << "Failed to open " << trafficLogPath << " for recording traffic";
+        return 1;
+      }
+
+      logger(INFO) << "Recording inbound traffic to " << trafficLogPath;
+      p2psrv.setTrafficLog(&trafficLog);
+      rpcServer.setTrafficLog(&trafficLog);
     }
-    logger(INFO) << "P2p server initialized OK";
 
     //logger(INFO) << "Initializing core rpc server...";
     //if (!rpc_server.init(vm)) {
@@ -239,6 +335,9 @@ int main(int argc, char* argv[])
     }
 
     logger(INFO) << "Starting core rpc server on address " << rpcConfig.getBindAddress();
+    rpcServer.setMaxConnections(rpcConfig.maxConnections);
+    rpcServer.setIdleTimeout(std::chrono::seconds(rpcConfig.idleTimeout));
+    rpcServer.setClientLimits(rpcConfig.clientRate, rpcConfig.clientBurst);
     rpcServer.start(rpcConfig.bindIp, rpcConfig.bindPort);
     logger(INFO) << "Core rpc server started ok";
 
@@ -247,21 +346,42 @@ int main(int argc, char* argv[])
       p2psrv.send_stop_signal();
     });
 
-    logger(INFO) << "Starting p2p net loop...";
-    p2psrv.run();
-    logger(INFO) << "p2p net loop stopped";
+    // applied last, threads created by this one would inherit its placement
+    if (!Common::ThreadTopology::global().applyToCurrentThread(Common::ThreadClass::NETWORK)) {
+      logger(WARNING) << "Network thread placement is not applied";
+    }
+
+    if (coreConfig.replica) {
+      // blocks of the writing node are picked up here, RPC is served by the dispatcher meanwhile
+      logger(INFO) << "Following blocks in " << coreConfig.configFolder << "...";
+      System::Timer refreshTimer(dispatcher);
+      while (!p2psrv.stop_signal_sent()) {
+        refreshTimer.sleep(REPLICA_REFRESH_INTERVAL);
+        ccore.refresh_replica();
+      }
+      logger(INFO) << "Replica stopped following blocks";
+    } else {
+      logger(INFO) << "Starting p2p net loop...";
+      p2psrv.run();
+      logger(INFO) << "p2p net loop stopped";
+    }
 
     dch.stop_handling();
 
     //stop components
     logger(INFO) << "Stopping core rpc server...";
     rpcServer.stop();
+    rpcServer.setTrafficLog(nullptr);
+    p2psrv.setTrafficLog(nullptr);
+    trafficLog.close();
 
     //deinitialize components
     logger(INFO) << "Deinitializing core...";
     ccore.deinit();
-    logger(INFO) << "Deinitializing p2p...";
-    p2psrv.deinit();
+    if (!coreConfig.replica) {
+      logger(INFO) << "Deinitializing p2p...";
+      p2psrv.deinit();
+    }
 
     ccore.set_cryptonote_protocol(NULL);
     cprotocol.set_p2p_endpoint(NULL);
@@ -18,6 +18,7 @@
 #include "NodeRpcProxy.h"
 #include "NodeErrors.h"
 
+#include <algorithm>
 #include <atomic>
 #include <system_error>
 #include <thread>
@@ -25,7 +26,10 @@
 #include <HTTP/HttpRequest.h>
 #include <HTTP/HttpResponse.h>
 #include <System/Dispatcher.h>
+#include <System/InterruptedException.h>
+#include <System/Timer.h>
 
+#include "cryptonote_config.h"
 #include "cryptonote_core/cryptonote_basic_impl.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "rpc/core_rpc_server_commands_defs.h"
@@ -35,6 +39,10 @@
 namespace CryptoNote {
 
 namespace {
+
+// unreachable and busy daemons aren't asked again for this long
+const std::chrono::seconds NODE_RETRY_DELAY(30);
+
 std::error_code interpretResponseStatus(const std::string& status) {
   if (CORE_RPC_STATUS_BUSY == status) {
     return make_error_code(error::NODE_BUSY);
@@ -109,11 +117,15 @@ std::error_code jsonRpcCommand(HttpClient& client, const std::string& method, co
 }
 
 NodeRpcProxy::NodeRpcProxy(const std::string& nodeHost, unsigned short nodePort) :
+  NodeRpcProxy(std::vector<NodeAddress>{ NodeAddress{ nodeHost, nodePort } }) {
+}
+
+NodeRpcProxy::NodeRpcProxy(const std::vector<NodeAddress>& nodes) :
+  m_nodes(nodes),
+  m_nodeSelector(nodes.size(), NODE_RETRY_DELAY),
   m_rpcTimeout(10000),
-  m_pullTimer(m_ioService),
+  m_statusStopped(false),
   m_pullInterval(10000),
-  m_nodeHost(nodeHost),
-  m_nodePort(nodePort),
   m_lastLocalBlockTimestamp(0) {
   resetInternalState();
 }
@@ -124,10 +136,12 @@ NodeRpcProxy::~NodeRpcProxy() {
 
 void NodeRpcProxy::resetInternalState() {
   m_ioService.reset();
+  m_syncIoService.reset();
   m_peerCount = 0;
   m_nodeHeight = 0;
   m_networkHeight = 0;
   m_lastKnowHash = CryptoNote::null_hash;
+  m_stateVersion = 0;
 }
 
 void NodeRpcProxy::init(const INode::Callback& callback) {
@@ -137,7 +151,10 @@ void NodeRpcProxy::init(const INode::Callback& callback) {
   }
 
   resetInternalState();
+  m_statusStopped = false;
   m_workerThread = std::thread(std::bind(&NodeRpcProxy::workerThread, this, callback));
+  m_syncThread = std::thread(std::bind(&NodeRpcProxy::syncThread, this));
+  m_statusThread = std::thread(std::bind(&NodeRpcProxy::statusThread, this));
 }
 
 bool NodeRpcProxy::shutdown() {
@@ -145,8 +162,24 @@ bool NodeRpcProxy::shutdown() {
     return false;
   }
 
-  boost::system::error_code ignored_ec;
-  m_pullTimer.cancel(ignored_ec);
+  {
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    m_statusStopped = true;
+    if (m_stopStatus) {
+      m_stopStatus();
+    }
+  }
+
+  // status thread posts to m_ioService, it is stopped first
+  if (m_statusThread.joinable()) {
+    m_statusThread.join();
+  }
+
+  m_syncIoService.stop();
+  if (m_syncThread.joinable()) {
+    m_syncThread.join();
+  }
+
   m_ioService.stop();
   if (m_workerThread.joinable()) {
     m_workerThread.join();
@@ -162,34 +195,131 @@ void NodeRpcProxy::workerThread(const INode::Callback& initialized_callback) {
   }
 
   System::Dispatcher dispatcher;
-  HttpClient httpClient(dispatcher, m_nodeHost, m_nodePort);
-  m_httpClient = &httpClient;
+  m_httpClients = createHttpClients(dispatcher);
 
   initialized_callback(std::error_code());
 
-  pullNodeStatusAndScheduleTheNext();
+  // requests are posted from other threads, the queue is served even while it's empty
+  {
+    boost::asio::io_service::work work(m_ioService);
+    while (!m_ioService.stopped()) {
+      m_ioService.run_one();
+    }
+  }
 
-  while (!m_ioService.stopped()) {
-    m_ioService.run_one();
+  m_httpClients.clear();
+}
+
+void NodeRpcProxy::syncThread() {
+  System::Dispatcher dispatcher;
+  m_syncHttpClients = createHttpClients(dispatcher);
+
+  {
+    boost::asio::io_service::work work(m_syncIoService);
+    while (!m_syncIoService.stopped()) {
+      m_syncIoService.run_one();
+    }
   }
+
+  m_syncHttpClients.clear();
 }
 
-void NodeRpcProxy::pullNodeStatusAndScheduleTheNext() {
-  updateNodeStatus();
+NodeRpcProxy::HttpClients NodeRpcProxy::createHttpClients(System::Dispatcher& dispatcher) const {
+  HttpClients clients;
+  for (const auto& node : m_nodes) {
+    clients.emplace_back(new HttpClient(dispatcher, node.host, node.port));
+  }
 
-  m_pullTimer.expires_from_now(boost::posix_time::milliseconds(m_pullInterval));
-  m_pullTimer.async_wait([=](const boost::system::error_code& ec) {
-    if (ec != boost::asio::error::operation_aborted) {
-      pullNodeStatusAndScheduleTheNext();
+  return clients;
+}
+
+// unreachable and busy daemons are reported to the selector and the next one is asked, each daemon once at most
+std::error_code NodeRpcProxy::request(HttpClients& clients, const std::function<std::error_code(HttpClient&)>& command) {
+  std::error_code ec = make_error_code(error::NETWORK_ERROR);
+  std::vector<bool> asked(clients.size(), false);
+  for (;;) {
+    NodeSelector::Clock::time_point start = NodeSelector::Clock::now();
+    size_t node = m_nodeSelector.select(start);
+    if (asked[node]) {
+      break;
     }
-  });
+
+    asked[node] = true;
+    ec = command(*clients[node]);
+    if (ec != make_error_code(error::NETWORK_ERROR) && ec != make_error_code(error::NODE_BUSY)) {
+      m_nodeSelector.reportSuccess(node, NodeSelector::Clock::now() - start);
+      break;
+    }
+
+    m_nodeSelector.reportFailure(node, NodeSelector::Clock::now());
+  }
+
+  return ec;
+}
+
+void NodeRpcProxy::statusThread() {
+  System::Dispatcher dispatcher;
+  HttpClients clients = createHttpClients(dispatcher);
+  System::Timer retryTimer(dispatcher);
+  bool stopped = false;
+
+  {
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    if (m_statusStopped) {
+      return;
+    }
+
+    m_stopStatus = [&] {
+      dispatcher.remoteSpawn([&] {
+        stopped = true;
+        for (auto& client : clients) {
+          client->stop();
+        }
+
+        retryTimer.stop();
+      });
+    };
+  }
+
+  CryptoNote::COMMAND_RPC_WAIT_STATE_CHANGE::request req = AUTO_VAL_INIT(req);
+  req.timeout = m_pullInterval;
+
+  // the daemon currently preferred for requests is polled. Failures aren't reported from here, daemons without
+  // long polls fail them too; requests of the fallback update report unreachable ones
+  while (!stopped) {
+    CryptoNote::COMMAND_RPC_WAIT_STATE_CHANGE::response rsp = AUTO_VAL_INIT(rsp);
+    size_t node = m_nodeSelector.select(NodeSelector::Clock::now());
+    std::error_code ec = binaryCommand(*clients[node], "/waitstatechange.bin", req, rsp);
+    if (stopped) {
+      break;
+    }
+
+    if (!ec) {
+      req.known_version = rsp.version;
+      m_ioService.post([this, rsp] { updateNodeStatus(rsp); });
+      continue;
+    }
+
+    // daemons without long polls and busy ones are polled every m_pullInterval
+    m_ioService.post([this] { updateNodeStatus(); });
+    try {
+      retryTimer.sleep(std::chrono::milliseconds(m_pullInterval));
+    } catch (System::InterruptedException&) {
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_statusMutex);
+  m_stopStatus = nullptr;
+  clients.clear();
 }
 
 void NodeRpcProxy::updateNodeStatus() {
   CryptoNote::COMMAND_RPC_GET_LAST_BLOCK_HEADER::request req = AUTO_VAL_INIT(req);
   CryptoNote::COMMAND_RPC_GET_LAST_BLOCK_HEADER::response rsp = AUTO_VAL_INIT(rsp);
 
-  std::error_code ec = jsonRpcCommand(*m_httpClient, "getlastblockheader", req, rsp);
+  std::error_code ec = request(m_httpClients, [&](HttpClient& client) {
+    return jsonRpcCommand(client, "getlastblockheader", req, rsp);
+  });
 
   if (!ec) {
     crypto::hash blockHash;
@@ -197,37 +327,59 @@ void NodeRpcProxy::updateNodeStatus() {
       return;
     }
 
-    if (blockHash != m_lastKnowHash) {
-      m_lastKnowHash = blockHash;
-      m_nodeHeight = rsp.block_header.height;
-      m_lastLocalBlockTimestamp = rsp.block_header.timestamp;
-      // TODO request and update network height
-      m_networkHeight = m_nodeHeight;
-      m_observerManager.notify(&INodeObserver::lastKnownBlockHeightUpdated, m_networkHeight);
-      //if (m_networkHeight != rsp.block_header.network_height) {
-      //  m_networkHeight = rsp.block_header.network_height;
-      //  m_observerManager.notify(&INodeObserver::lastKnownBlockHeightUpdated, m_networkHeight);
-      //}
-      m_observerManager.notify(&INodeObserver::localBlockchainUpdated, m_nodeHeight);
-    }
+    updateBlockchainStatus(blockHash, rsp.block_header.height, rsp.block_header.timestamp);
   }
 
   updatePeerCount();
 }
 
+void NodeRpcProxy::updateNodeStatus(const COMMAND_RPC_WAIT_STATE_CHANGE::response& rsp) {
+  bool poolChanged = rsp.top_block_hash == m_lastKnowHash && rsp.version != m_stateVersion;
+  m_stateVersion = rsp.version;
+
+  updateBlockchainStatus(rsp.top_block_hash, rsp.height, rsp.top_block_timestamp);
+  if (poolChanged) {
+    m_observerManager.notify(&INodeObserver::poolChanged);
+  }
+
+  updatePeerCount(rsp.incoming_connections_count + rsp.outgoing_connections_count);
+}
+
+void NodeRpcProxy::updateBlockchainStatus(const crypto::hash& topBlockHash, uint64_t height, uint64_t timestamp) {
+  if (topBlockHash != m_lastKnowHash) {
+    m_lastKnowHash = topBlockHash;
+    m_nodeHeight = height;
+    m_lastLocalBlockTimestamp = timestamp;
+    // TODO request and update network height
+    // daemons may lag behind each other, the known height doesn't go back when requests move to a slower one
+    m_networkHeight = std::max(m_networkHeight, m_nodeHeight);
+    m_observerManager.notify(&INodeObserver::lastKnownBlockHeightUpdated, m_networkHeight);
+    //if (m_networkHeight != rsp.block_header.network_height) {
+    //  m_networkHeight = rsp.block_header.network_height;
+    //  m_observerManager.notify(&INodeObserver::lastKnownBlockHeightUpdated, m_networkHeight);
+    //}
+    m_observerManager.notify(&INodeObserver::localBlockchainUpdated, m_nodeHeight);
+  }
+}
+
 void NodeRpcProxy::updatePeerCount() {
 
   CryptoNote::COMMAND_RPC_GET_INFO::request req = AUTO_VAL_INIT(req);
   CryptoNote::COMMAND_RPC_GET_INFO::response rsp = AUTO_VAL_INIT(rsp);
 
-  std::error_code ec = jsonCommand(*m_httpClient, "/getinfo", req, rsp);
+  std::error_code ec = request(m_httpClients, [&](HttpClient& client) {
+    return jsonCommand(client, "/getinfo", req, rsp);
+  });
 
   if (!ec) {
-    size_t peerCount = rsp.incoming_connections_count + rsp.outgoing_connections_count;
-    if (peerCount != m_peerCount) {
-      m_peerCount = peerCount;
-      m_observerManager.notify(&INodeObserver::peerCountUpdated, m_peerCount);
-    }
+    updatePeerCount(rsp.incoming_connections_count + rsp.outgoing_connections_count);
+  }
+}
+
+void NodeRpcProxy::updatePeerCount(size_t peerCount) {
+  if (peerCount != m_peerCount) {
+    m_peerCount = peerCount;
+    m_observerManager.notify(&INodeObserver::peerCountUpdated, m_peerCount);
   }
 }
 
@@ -288,7 +440,7 @@ void NodeRpcProxy::getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::li
     return;
   }
 
-  m_ioService.post(std::bind(&NodeRpcProxy::doGetNewBlocks, this, std::move(knownBlockIds), std::ref(newBlocks), std::ref(startHeight), callback));
+  m_syncIoService.post(std::bind(&NodeRpcProxy::doGetNewBlocks, this, std::move(knownBlockIds), std::ref(newBlocks), std::ref(startHeight), callback));
 }
 
 void NodeRpcProxy::getTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices, const Callback& callback) {
@@ -297,7 +449,16 @@ void NodeRpcProxy::getTransactionOutsGlobalIndices(const crypto::hash& transacti
     return;
   }
 
-  m_ioService.post(std::bind(&NodeRpcProxy::doGetTransactionOutsGlobalIndices, this, transactionHash, std::ref(outsGlobalIndices), callback));
+  m_syncIoService.post(std::bind(&NodeRpcProxy::doGetTransactionOutsGlobalIndices, this, transactionHash, std::ref(outsGlobalIndices), callback));
+}
+
+void NodeRpcProxy::getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices, const Callback& callback) {
+  if (!m_initState.initialized()) {
+    callback(make_error_code(error::NOT_INITIALIZED));
+    return;
+  }
+
+  m_syncIoService.post(std::bind(&NodeRpcProxy::doGetTransactionsOutsGlobalIndices, this, std::move(transactionHashes), std::ref(outsGlobalIndices), callback));
 }
 
 void NodeRpcProxy::queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) {
@@ -306,14 +467,32 @@ void NodeRpcProxy::queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t
     return;
   }
 
-  m_ioService.post(std::bind(&NodeRpcProxy::doQueryBlocks, this, std::move(knownBlockIds), timestamp, std::ref(newBlocks), std::ref(startHeight), callback));
+  m_syncIoService.post(std::bind(&NodeRpcProxy::doQueryBlocks, this, std::move(knownBlockIds), timestamp, std::ref(newBlocks), std::ref(startHeight), callback));
+}
+
+void NodeRpcProxy::queryBlocksFiltered(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::vector<CryptoNote::TrackingKey>&& trackingKeys,
+  std::vector<crypto::key_image>&& knownKeyImages, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) {
+  if (!m_initState.initialized()) {
+    callback(make_error_code(error::NOT_INITIALIZED));
+    return;
+  }
+
+  CryptoNote::COMMAND_RPC_QUERY_BLOCKS_FILTERED::request req = AUTO_VAL_INIT(req);
+  req.block_ids = std::move(knownBlockIds);
+  req.timestamp = timestamp;
+  req.tracking_keys = std::move(trackingKeys);
+  req.key_images = std::move(knownKeyImages);
+
+  m_syncIoService.post(std::bind(&NodeRpcProxy::doQueryBlocksFiltered, this, std::move(req), std::ref(newBlocks), std::ref(startHeight), callback));
 }
 
 void NodeRpcProxy::doRelayTransaction(const CryptoNote::Transaction& transaction, const Callback& callback) {
   COMMAND_RPC_SEND_RAW_TX::request req;
   COMMAND_RPC_SEND_RAW_TX::response rsp;
   req.tx_as_hex = blobToHex(CryptoNote::tx_to_blob(transaction));
-  std::error_code ec = jsonCommand(*m_httpClient, "/sendrawtransaction", req, rsp); 
+  std::error_code ec = request(m_httpClients, [&](HttpClient& client) {
+    return jsonCommand(client, "/sendrawtransaction", req, rsp);
+  });
   callback(ec);
 }
 
@@ -323,7 +502,10 @@ void NodeRpcProxy::doGetRandomOutsByAmounts(std::vector<uint64_t>& amounts, uint
   req.amounts = std::move(amounts);
   req.outs_count = outsCount;
 
-  std::error_code ec = binaryCommand(*m_httpClient, "/getrandom_outs.bin", req, rsp);
+  std::error_code ec = request(m_httpClients, [&](HttpClient& client) {
+    rsp = COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response();
+    return binaryCommand(client, "/getrandom_outs.bin", req, rsp);
+  });
 
   if (!ec) {
     outs = std::move(rsp.outs);
@@ -336,7 +518,10 @@ void NodeRpcProxy::doGetNewBlocks(std::list<crypto::hash>& knownBlockIds, std::l
   CryptoNote::COMMAND_RPC_GET_BLOCKS_FAST::response rsp = AUTO_VAL_INIT(rsp);
   req.block_ids = std::move(knownBlockIds);
 
-  std::error_code ec = binaryCommand(*m_httpClient, "/getblocks.bin", req, rsp);
+  std::error_code ec = request(m_syncHttpClients, [&](HttpClient& client) {
+    rsp = CryptoNote::COMMAND_RPC_GET_BLOCKS_FAST::response();
+    return binaryCommand(client, "/getblocks.bin", req, rsp);
+  });
 
   if (!ec) {
     newBlocks = std::move(rsp.blocks);
@@ -351,7 +536,10 @@ void NodeRpcProxy::doGetTransactionOutsGlobalIndices(const crypto::hash& transac
   CryptoNote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response rsp = AUTO_VAL_INIT(rsp);
   req.txid = transactionHash;
 
-  std::error_code ec = binaryCommand(*m_httpClient, "/get_o_indexes.bin", req, rsp);
+  std::error_code ec = request(m_syncHttpClients, [&](HttpClient& client) {
+    rsp = CryptoNote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response();
+    return binaryCommand(client, "/get_o_indexes.bin", req, rsp);
+  });
 
   if (!ec) {
     outsGlobalIndices = std::move(rsp.o_indexes);
@@ -360,6 +548,55 @@ void NodeRpcProxy::doGetTransactionOutsGlobalIndices(const crypto::hash& transac
   callback(ec);
 }
 
+void NodeRpcProxy::doGetTransactionsOutsGlobalIndices(const std::vector<crypto::hash>& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices, const Callback& callback) {
+  std::error_code ec;
+  outsGlobalIndices.clear();
+  outsGlobalIndices.reserve(transactionHashes.size());
+
+  // daemon limits the number of transactions per request
+  for (size_t first = 0; first < transactionHashes.size() && !ec; first += CryptoNote::COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES_MAX_COUNT) {
+    size_t last = std::min(transactionHashes.size(), first + CryptoNote::COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES_MAX_COUNT);
+
+    CryptoNote::COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
+    CryptoNote::COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES::response rsp = AUTO_VAL_INIT(rsp);
+    req.txids.assign(transactionHashes.begin() + first, transactionHashes.begin() + last);
+
+    ec = request(m_syncHttpClients, [&](HttpClient& client) {
+      rsp = CryptoNote::COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES::response();
+      return binaryCommand(client, "/get_txs_o_indexes.bin", req, rsp);
+    });
+    if (!ec && rsp.txs.size() != req.txids.size()) {
+      ec = make_error_code(error::INTERNAL_NODE_ERROR);
+    }
+
+    if (!ec) {
+      for (auto& tx : rsp.txs) {
+        outsGlobalIndices.push_back(std::move(tx.o_indexes));
+      }
+    }
+  }
+
+  callback(ec);
+}
+
+namespace {
+
+void appendBlockEntries(CryptoNote::COMMAND_RPC_QUERY_BLOCKS::response& rsp, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight) {
+  for (auto& item : rsp.items) {
+    BlockCompleteEntry entry;
+
+    entry.blockHash = item.block_id;
+    entry.block = std::move(item.block);
+    entry.txs = std::move(item.txs);
+
+    newBlocks.push_back(std::move(entry));
+  }
+
+  startHeight = rsp.start_height;
+}
+
+}
+
 void NodeRpcProxy::doQueryBlocks(const std::list<crypto::hash>& knownBlockIds, uint64_t timestamp, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) {
   CryptoNote::COMMAND_RPC_QUERY_BLOCKS::request req = AUTO_VAL_INIT(req);
   CryptoNote::COMMAND_RPC_QUERY_BLOCKS::response rsp = AUTO_VAL_INIT(rsp);
@@ -367,20 +604,27 @@ void NodeRpcProxy::doQueryBlocks(const std::list<crypto::hash>& knownBlockIds, u
   req.block_ids = knownBlockIds;
   req.timestamp = timestamp;
 
-  std::error_code ec = binaryCommand(*m_httpClient, "/queryblocks.bin", req, rsp);
+  std::error_code ec = request(m_syncHttpClients, [&](HttpClient& client) {
+    rsp = CryptoNote::COMMAND_RPC_QUERY_BLOCKS::response();
+    return binaryCommand(client, "/queryblocks.bin", req, rsp);
+  });
 
   if (!ec) {
-    for (auto& item : rsp.items) {
-      BlockCompleteEntry entry;
+    appendBlockEntries(rsp, newBlocks, startHeight);
+  }
+  callback(ec);
+}
 
-      entry.blockHash = item.block_id;
-      entry.block = std::move(item.block);
-      entry.txs = std::move(item.txs);
+void NodeRpcProxy::doQueryBlocksFiltered(CryptoNote::COMMAND_RPC_QUERY_BLOCKS_FILTERED::request& req, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) {
+  CryptoNote::COMMAND_RPC_QUERY_BLOCKS_FILTERED::response rsp = AUTO_VAL_INIT(rsp);
 
-      newBlocks.push_back(std::move(entry));
-    }
+  std::error_code ec = request(m_syncHttpClients, [&](HttpClient& client) {
+    rsp = CryptoNote::COMMAND_RPC_QUERY_BLOCKS_FILTERED::response();
+    return binaryCommand(client, "/queryblocksfiltered.bin", req, rsp);
+  });
 
-    startHeight = rsp.start_height;
+  if (!ec) {
+    appendBlockEntries(rsp, newBlocks, startHeight);
   }
   callback(ec);
 }
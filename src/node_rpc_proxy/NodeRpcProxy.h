@@ -17,15 +17,23 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <boost/asio/io_service.hpp>
-#include <boost/asio/deadline_timer.hpp>
 
 #include "Common/ObserverManager.h"
 #include "InitState.h"
 #include "INode.h"
+#include "NodeSelector.h"
+
+namespace System {
+class Dispatcher;
+}
 
 namespace CryptoNote {
 
@@ -33,7 +41,15 @@ class HttpClient;
 
 class NodeRpcProxy : public CryptoNote::INode {
 public:
+  struct NodeAddress {
+    std::string host;
+    unsigned short port;
+  };
+
   NodeRpcProxy(const std::string& nodeHost, unsigned short nodePort);
+  // Daemons have to be equivalent, each request goes to the one answering fastest and fails over to the others
+  // when it's unreachable or busy
+  explicit NodeRpcProxy(const std::vector<NodeAddress>& nodes);
   virtual ~NodeRpcProxy();
 
   virtual bool addObserver(CryptoNote::INodeObserver* observer);
@@ -53,7 +69,10 @@ public:
   virtual void getRandomOutsByAmounts(std::vector<uint64_t>&& amounts, uint64_t outsCount, std::vector<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result, const Callback& callback);
   virtual void getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks, uint64_t& startHeight, const Callback& callback);
   virtual void getTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices, const Callback& callback);
+  virtual void getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices, const Callback& callback) override;
   virtual void queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) override;
+  virtual void queryBlocksFiltered(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::vector<CryptoNote::TrackingKey>&& trackingKeys,
+    std::vector<crypto::key_image>&& knownKeyImages, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback) override;
   virtual void getPoolSymmetricDifference(std::vector<crypto::hash>&& known_pool_tx_ids, crypto::hash known_block_id, bool& is_bc_actual, std::vector<CryptoNote::Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, const Callback& callback) override;
 
 
@@ -63,29 +82,51 @@ public:
 private:
   void resetInternalState();
   void workerThread(const Callback& initialized_callback);
+  void syncThread();
 
-  void pullNodeStatusAndScheduleTheNext();
+  typedef std::vector<std::unique_ptr<HttpClient>> HttpClients;
+  HttpClients createHttpClients(System::Dispatcher& dispatcher) const;
+  std::error_code request(HttpClients& clients, const std::function<std::error_code(HttpClient&)>& command);
+
+  void statusThread();
   void updateNodeStatus();
+  void updateNodeStatus(const COMMAND_RPC_WAIT_STATE_CHANGE::response& rsp);
+  void updateBlockchainStatus(const crypto::hash& topBlockHash, uint64_t height, uint64_t timestamp);
   void updatePeerCount();
+  void updatePeerCount(size_t peerCount);
 
   void doRelayTransaction(const CryptoNote::Transaction& transaction, const Callback& callback);
   void doGetRandomOutsByAmounts(std::vector<uint64_t>& amounts, uint64_t outsCount, std::vector<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result, const Callback& callback);
   void doGetNewBlocks(std::list<crypto::hash>& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks, uint64_t& startHeight, const Callback& callback);
   void doGetTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices, const Callback& callback);
+  void doGetTransactionsOutsGlobalIndices(const std::vector<crypto::hash>& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices, const Callback& callback);
   void doQueryBlocks(const std::list<crypto::hash>& knownBlockIds, uint64_t timestamp, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback);
+  void doQueryBlocksFiltered(CryptoNote::COMMAND_RPC_QUERY_BLOCKS_FILTERED::request& req, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const Callback& callback);
 
 private:
   tools::InitState m_initState;
+  // Requests are queued by priority, each queue is served by its own thread with its own daemon connection.
+  // Transactions are sent and status is updated through m_ioService, bulk blockchain sync requests go through
+  // m_syncIoService and can't hold them up.
   std::thread m_workerThread;
   boost::asio::io_service m_ioService;
+  std::thread m_syncThread;
+  boost::asio::io_service m_syncIoService;
   tools::ObserverManager<CryptoNote::INodeObserver> m_observerManager;
 
-  const std::string m_nodeHost;
-  const unsigned short m_nodePort;
+  const std::vector<NodeAddress> m_nodes;
+  NodeSelector m_nodeSelector;
   unsigned int m_rpcTimeout;
-  HttpClient* m_httpClient = nullptr;
-
-  boost::asio::deadline_timer m_pullTimer;
+  // connections to every daemon, index is the one in m_nodes
+  HttpClients m_httpClients;
+  HttpClients m_syncHttpClients;
+
+  // Daemon is long polled for blockchain and pool changes in a separate thread with its own connections,
+  // requests in m_ioService aren't held up meanwhile. Polls return at least every m_pullInterval milliseconds.
+  std::thread m_statusThread;
+  std::mutex m_statusMutex;
+  bool m_statusStopped;
+  std::function<void()> m_stopStatus;
   uint64_t m_pullInterval;
 
   // Internal state
@@ -93,6 +134,7 @@ private:
   uint64_t m_nodeHeight;
   uint64_t m_networkHeight;
   crypto::hash m_lastKnowHash;
+  uint64_t m_stateVersion;
   uint64_t m_lastLocalBlockTimestamp;
 };
 
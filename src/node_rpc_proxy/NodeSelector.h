@@ -0,0 +1,116 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace CryptoNote {
+
+// Picks the daemon for the next request out of equivalent ones. Daemons are scored by a moving average of their
+// response times, the fastest one gets the requests. A failed daemon is skipped for retryDelay, then it is tried
+// again. Used from several request threads, access is synchronized.
+class NodeSelector {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  NodeSelector(size_t nodeCount, Clock::duration retryDelay) : m_retryDelay(retryDelay), m_nodes(nodeCount) {
+    assert(nodeCount > 0);
+  }
+
+  size_t nodeCount() const {
+    return m_nodes.size();
+  }
+
+  // The available daemon with the lowest average response time, the one failed longest ago if none is available
+  size_t select(Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t best = 0;
+    for (size_t i = 1; i < m_nodes.size(); ++i) {
+      if (better(i, best, now)) {
+        best = i;
+      }
+    }
+
+    return best;
+  }
+
+  bool available(size_t node, Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return isAvailable(m_nodes[node], now);
+  }
+
+  void reportSuccess(size_t node, Clock::duration responseTime) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Node& state = m_nodes[node];
+    // the first response sets the average, later ones move it by a quarter
+    state.averageResponseTime = state.responded ? (state.averageResponseTime * 3 + responseTime) / 4 : responseTime;
+    state.responded = true;
+    state.failed = false;
+  }
+
+  void reportFailure(size_t node, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nodes[node].failed = true;
+    m_nodes[node].failedAt = now;
+  }
+
+private:
+  struct Node {
+    Node() : averageResponseTime(Clock::duration::zero()), responded(false), failed(false) {
+    }
+
+    Clock::duration averageResponseTime;
+    bool responded;
+    bool failed;
+    Clock::time_point failedAt;
+  };
+
+  bool isAvailable(const Node& node, Clock::time_point now) const {
+    return !node.failed || now - node.failedAt >= m_retryDelay;
+  }
+
+  // daemons not asked yet go before scored ones, so each gets a score
+  bool better(size_t candidate, size_t best, Clock::time_point now) const {
+    const Node& c = m_nodes[candidate];
+    const Node& b = m_nodes[best];
+    bool candidateAvailable = isAvailable(c, now);
+    bool bestAvailable = isAvailable(b, now);
+    if (candidateAvailable != bestAvailable) {
+      return candidateAvailable;
+    }
+
+    if (!candidateAvailable) {
+      return c.failedAt < b.failedAt;
+    }
+
+    if (c.responded != b.responded) {
+      return !c.responded;
+    }
+
+    return c.averageResponseTime < b.averageResponseTime;
+  }
+
+  Clock::duration m_retryDelay;
+  mutable std::mutex m_mutex;
+  std::vector<Node> m_nodes;
+};
+
+}
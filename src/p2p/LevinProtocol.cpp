@@ -16,7 +16,10 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "LevinProtocol.h"
+#include <algorithm>
+#include <cstring>
 #include <System/TcpConnection.h>
+#include "Common/Lz4.h"
 
 using namespace CryptoNote;
 
@@ -25,6 +28,12 @@ namespace {
 const uint64_t LEVIN_SIGNATURE = 0x0101010101012101LL;  //Bender's nightmare
 const uint32_t LEVIN_PACKET_REQUEST = 0x00000001;
 const uint32_t LEVIN_PACKET_RESPONSE = 0x00000002;
+// body is the uncompressed size as 4 bytes followed by LZ4 block
+const uint32_t LEVIN_PACKET_COMPRESSED = 0x00000100;
+// body is a part of another message with its header, the parts are joined when the last one is read
+const uint32_t LEVIN_PACKET_FRAGMENT = 0x00000200;
+const uint32_t LEVIN_PACKET_FRAGMENT_BEGIN = 0x00000400;
+const uint32_t LEVIN_PACKET_FRAGMENT_END = 0x00000800;
 const uint32_t LEVIN_DEFAULT_MAX_PACKET_SIZE = 100000000;      //100MB by default
 const uint32_t LEVIN_PROTOCOL_VER_1 = 1;
 
@@ -42,26 +51,100 @@ struct bucket_head2
 };
 #pragma pack(pop)
 
-}
-
-LevinProtocol::LevinProtocol(System::TcpConnection& connection) 
-  : m_conn(connection) {}
+const size_t LEVIN_RETAINED_BUFFER_SIZE = 1024 * 1024;
+// smaller payloads aren't worth the compression time
+const size_t LEVIN_COMPRESSION_MIN_SIZE = 16 * 1024;
 
-std::string LevinProtocol::sendBuf(uint32_t command, const std::string& out, bool needResponse, bool readResponse) {
+bucket_head2 makeHead(uint32_t command, size_t size, bool needResponse, uint32_t flags, int32_t returnCode) {
   bucket_head2 head = { 0 };
   head.m_signature = LEVIN_SIGNATURE;
-  head.m_cb = out.size();
+  head.m_cb = size;
   head.m_have_to_return_data = needResponse;
   head.m_command = command;
   head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-  head.m_flags = LEVIN_PACKET_REQUEST;
+  head.m_flags = flags;
+  head.m_return_code = returnCode;
+  return head;
+}
+
+std::string makeFrame(uint32_t command, const std::string& out, bool needResponse, uint32_t flags, int32_t returnCode) {
+  bucket_head2 head = makeHead(command, out.size(), needResponse, flags, returnCode);
+  std::string frame;
+  frame.reserve(sizeof(head) + out.size());
+  frame.append(reinterpret_cast<const char*>(&head), sizeof(head));
+  frame.append(out);
+  return frame;
+}
+
+// Returns false if compressed payload isn't smaller than the original
+bool compressPayload(const std::string& out, std::string& compressed) {
+  std::vector<char> block;
+  Common::lz4Compress(out.data(), out.size(), block);
+  if (sizeof(uint32_t) + block.size() >= out.size()) {
+    return false;
+  }
+
+  uint32_t size = static_cast<uint32_t>(out.size());
+  compressed.reserve(sizeof(size) + block.size());
+  compressed.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  compressed.append(block.data(), block.size());
+  return true;
+}
+
+void decompressPayload(std::string& buf) {
+  uint32_t size;
+  if (buf.size() < sizeof(size)) {
+    throw std::runtime_error("Levin compressed packet is truncated");
+  }
+
+  memcpy(&size, buf.data(), sizeof(size));
+  if (size > LEVIN_DEFAULT_MAX_PACKET_SIZE) {
+    throw std::runtime_error("Levin packet size is too big");
+  }
+
+  std::string payload(size, '\0');
+  if (size != 0 && !Common::lz4Decompress(buf.data() + sizeof(size), buf.size() - sizeof(size), &payload[0], size)) {
+    throw std::runtime_error("Levin compressed packet is corrupted");
+  }
+
+  buf.swap(payload);
+}
+
+// connection may send less than asked, the rest is written by next calls
+void writeStrict(System::TcpConnection& connection, System::TcpConnection::Buffer* buffers, size_t count) {
+  while (count > 0) {
+    size_t transferred = connection.write(buffers, count);
+    while (count > 0 && transferred >= buffers->size) {
+      transferred -= buffers->size;
+      ++buffers;
+      --count;
+    }
+
+    if (count > 0) {
+      buffers->data += transferred;
+      buffers->size -= transferred;
+    }
+  }
+}
+
+// header and body are sent by one system call without joining them
+void writeMessage(System::TcpConnection& connection, const bucket_head2& head, const std::string& out) {
+  System::TcpConnection::Buffer buffers[] = {
+    { reinterpret_cast<const uint8_t*>(&head), sizeof(head) },
+    { reinterpret_cast<const uint8_t*>(out.data()), out.size() }
+  };
+
+  writeStrict(connection, buffers, out.empty() ? 1 : 2);
+}
+
+}
+
+LevinProtocol::LevinProtocol(System::TcpConnection& connection) 
+  : m_conn(connection), m_fragmented(false) {}
 
-  // write header and body in one operation
-  std::string writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-  writeBuffer.append(reinterpret_cast<const char*>(&head), sizeof(head));
-  writeBuffer.append(out);
-  m_conn.write(reinterpret_cast<const uint8_t*>(writeBuffer.data()), writeBuffer.size());
+std::string LevinProtocol::sendBuf(uint32_t command, const std::string& out, bool needResponse, bool readResponse) {
+  bucket_head2 head = makeHead(command, out.size(), needResponse, LEVIN_PACKET_REQUEST, 0);
+  writeMessage(m_conn, head, out);
 
   std::string response;
 
@@ -89,29 +172,74 @@ std::string LevinProtocol::sendBuf(uint32_t command, const std::string& out, boo
 bool LevinProtocol::readCommand(Command& cmd) {
   bucket_head2 head = { 0 };
 
-  if (!readStrict(&head, sizeof(head))) {
-    return false;
-  }
+  for (;;) {
+    if (!readStrict(&head, sizeof(head))) {
+      return false;
+    }
 
-  if (head.m_signature != LEVIN_SIGNATURE) {
-    throw std::runtime_error("Levin signature mismatch");
-  }
+    if (head.m_signature != LEVIN_SIGNATURE) {
+      throw std::runtime_error("Levin signature mismatch");
+    }
 
-  if (head.m_cb > LEVIN_DEFAULT_MAX_PACKET_SIZE) {
-    throw std::runtime_error("Levin packet size is too big");
-  }
+    if (head.m_cb > LEVIN_DEFAULT_MAX_PACKET_SIZE) {
+      throw std::runtime_error("Levin packet size is too big");
+    }
 
-  std::string buf;
-  buf.resize(head.m_cb);
+    // memory of a rare large message isn't kept for the lifetime of the connection
+    if (cmd.buf.capacity() > LEVIN_RETAINED_BUFFER_SIZE && head.m_cb <= LEVIN_RETAINED_BUFFER_SIZE) {
+      std::string().swap(cmd.buf);
+    }
 
-  if (!buf.empty()) {
-    if (!readStrict(&buf[0], head.m_cb)) {
-      return false;
+    cmd.buf.resize(head.m_cb);
+
+    if (!cmd.buf.empty()) {
+      if (!readStrict(&cmd.buf[0], head.m_cb)) {
+        return false;
+      }
+    }
+
+    if ((head.m_flags & LEVIN_PACKET_FRAGMENT) == 0) {
+      break;
+    }
+
+    // other messages may come between fragments, they are returned while the fragmented one is collected
+    if ((head.m_flags & LEVIN_PACKET_FRAGMENT_BEGIN) != 0) {
+      m_fragments.clear();
+      m_fragmented = true;
+    } else if (!m_fragmented) {
+      throw std::runtime_error("Levin fragment without beginning");
+    }
+
+    if (m_fragments.size() + cmd.buf.size() > sizeof(head) + LEVIN_DEFAULT_MAX_PACKET_SIZE) {
+      throw std::runtime_error("Levin packet size is too big");
+    }
+
+    m_fragments.append(cmd.buf);
+    if ((head.m_flags & LEVIN_PACKET_FRAGMENT_END) == 0) {
+      continue;
+    }
+
+    m_fragmented = false;
+    if (m_fragments.size() < sizeof(head)) {
+      throw std::runtime_error("Levin fragmented packet is truncated");
+    }
+
+    memcpy(&head, m_fragments.data(), sizeof(head));
+    if (head.m_signature != LEVIN_SIGNATURE || head.m_cb != m_fragments.size() - sizeof(head) ||
+      (head.m_flags & LEVIN_PACKET_FRAGMENT) != 0) {
+      throw std::runtime_error("Levin fragmented packet is corrupted");
     }
+
+    cmd.buf.assign(m_fragments, sizeof(head), std::string::npos);
+    std::string().swap(m_fragments);
+    break;
+  }
+
+  if ((head.m_flags & LEVIN_PACKET_COMPRESSED) != 0) {
+    decompressPayload(cmd.buf);
   }
 
   cmd.command = head.m_command;
-  cmd.buf = std::move(buf);
   cmd.isNotify = !head.m_have_to_return_data;
   cmd.isResponse = (head.m_flags & LEVIN_PACKET_RESPONSE) == LEVIN_PACKET_RESPONSE;
 
@@ -119,19 +247,45 @@ bool LevinProtocol::readCommand(Command& cmd) {
 }
 
 void LevinProtocol::sendReply(uint32_t command, const std::string& out, int32_t returnCode) {
-  bucket_head2 head = { 0 };
-  head.m_signature = LEVIN_SIGNATURE;
-  head.m_cb = out.size();
-  head.m_have_to_return_data = false;
-  head.m_command = command;
-  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-  head.m_flags = LEVIN_PACKET_RESPONSE;
-  head.m_return_code = returnCode;
+  writeMessage(m_conn, makeHead(command, out.size(), false, LEVIN_PACKET_RESPONSE, returnCode), out);
+}
 
-  m_conn.write(reinterpret_cast<const uint8_t*>(&head), sizeof(head));
-  if (out.size() > 0) {
-    m_conn.write(reinterpret_cast<const uint8_t*>(out.data()), out.size());
+LevinProtocol::Frame LevinProtocol::makeNotification(uint32_t command, const std::string& out, bool compress) {
+  std::string compressed;
+  if (compress && out.size() >= LEVIN_COMPRESSION_MIN_SIZE && compressPayload(out, compressed)) {
+    return std::make_shared<const std::string>(makeFrame(command, compressed, false, LEVIN_PACKET_REQUEST | LEVIN_PACKET_COMPRESSED, 0));
   }
+
+  return std::make_shared<const std::string>(makeFrame(command, out, false, LEVIN_PACKET_REQUEST, 0));
+}
+
+LevinProtocol::Frame LevinProtocol::makeRequest(uint32_t command, const std::string& out) {
+  return std::make_shared<const std::string>(makeFrame(command, out, true, LEVIN_PACKET_REQUEST, 0));
+}
+
+std::vector<LevinProtocol::Frame> LevinProtocol::splitFrame(const Frame& frame, size_t fragmentSize) {
+  bucket_head2 head;
+  memcpy(&head, frame->data(), sizeof(head));
+
+  std::vector<Frame> fragments;
+  for (size_t offset = 0; offset < frame->size(); offset += fragmentSize) {
+    size_t size = std::min(fragmentSize, frame->size() - offset);
+    uint32_t flags = LEVIN_PACKET_FRAGMENT | (offset == 0 ? LEVIN_PACKET_FRAGMENT_BEGIN : 0) |
+      (offset + size == frame->size() ? LEVIN_PACKET_FRAGMENT_END : 0);
+    fragments.push_back(std::make_shared<const std::string>(makeFrame(head.m_command, frame->substr(offset, size), false, flags, 0)));
+  }
+
+  return fragments;
+}
+
+void LevinProtocol::sendFrames(const std::vector<Frame>& frames) {
+  std::vector<System::TcpConnection::Buffer> buffers;
+  buffers.reserve(frames.size());
+  for (const Frame& frame : frames) {
+    buffers.push_back({ reinterpret_cast<const uint8_t*>(frame->data()), frame->size() });
+  }
+
+  writeStrict(m_conn, buffers.data(), buffers.size());
 }
 
 bool LevinProtocol::readStrict(void* ptr, size_t size) {
@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include "Common/StringView.h"
 #include "misc_log_ex.h"
 #include "storages/portable_storage.h"
 #include "storages/portable_storage_from_bin.h"
@@ -65,15 +69,31 @@ public:
     }
   };
 
+  // cmd.buf is reused, so reading into the same Command doesn't allocate for every message
   bool readCommand(Command& cmd);
 
   std::string sendBuf(uint32_t command, const std::string& out, bool needResponse, bool readResponse = false);
   void sendReply(uint32_t command, const std::string& out, int32_t returnCode);
 
+  // Notification with its header, serialized once and shared by all connections it is relayed to
+  typedef std::shared_ptr<const std::string> Frame;
+
+  // Large payload is compressed if asked and it gets smaller, only for peers that announced P2P_FEATURE_COMPRESSION.
+  // readCommand decompresses such messages transparently.
+  static Frame makeNotification(uint32_t command, const std::string& out, bool compress = false);
+  // Request whose response is read later together with other incoming commands
+  static Frame makeRequest(uint32_t command, const std::string& out);
+  // Splits the frame into fragments of at most fragmentSize bytes, only for peers that announced P2P_FEATURE_FRAGMENTS.
+  // Other messages may be sent between fragments, readCommand joins the fragments and returns the original message.
+  static std::vector<Frame> splitFrame(const Frame& frame, size_t fragmentSize);
+  // Frames are gathered into as few writes as connection allows
+  void sendFrames(const std::vector<Frame>& frames);
+
+  // Parses the message in place, buf may point into a connection buffer
   template <typename T>
-  static bool decode(const std::string& buf, T& value) {
+  static bool decode(Common::StringView buf, T& value) {
     epee::serialization::portable_storage stg;
-    if (!stg.load_from_binary(buf)) {
+    if (!stg.load_from_binary(buf.getData(), buf.getSize())) {
       return false;
     }
     return value.load(stg);
@@ -92,6 +112,9 @@ private:
 
   bool readStrict(void* ptr, size_t size);
   System::TcpConnection& m_conn;
+  // fragments of the message being received, with its header
+  std::string m_fragments;
+  bool m_fragmented;
 };
 
 }
@@ -38,6 +38,9 @@ const command_line::arg_descriptor<std::vector<std::string> > arg_p2p_add_exclus
       " If this option is given the options add-priority-node and seed-node are ignored"};
 const command_line::arg_descriptor<std::vector<std::string> > arg_p2p_seed_node   = {"seed-node", "Connect to a node to retrieve peer addresses, and disconnect"};
 const command_line::arg_descriptor<bool> arg_p2p_hide_my_port   =    {"hide-my-port", "Do not announce yourself as peerlist candidate", false, true};
+const command_line::arg_descriptor<uint32_t> arg_p2p_connection_fanout = {"p2p-connection-fanout", "Number of outgoing connections attempted concurrently", P2P_DEFAULT_CONNECTION_FANOUT};
+const command_line::arg_descriptor<uint32_t> arg_p2p_request_rate = {"p2p-request-rate", "Work units per second a peer may spend on block and transaction requests, a block is 4 units, 0 is unlimited", P2P_DEFAULT_REQUEST_RATE};
+const command_line::arg_descriptor<uint32_t> arg_p2p_request_burst = {"p2p-request-burst", "Work units a peer may spend on requests at once", P2P_DEFAULT_REQUEST_BURST};
 
 bool parsePeerFromString(net_address& pe, const std::string& node_addr) {
   return Common::parseIpAddressAndPort(pe.ip, pe.port, node_addr);
@@ -71,6 +74,9 @@ void NetNodeConfig::initOptions(boost::program_options::options_description& des
   command_line::add_arg(desc, arg_p2p_add_exclusive_node);
   command_line::add_arg(desc, arg_p2p_seed_node);
   command_line::add_arg(desc, arg_p2p_hide_my_port);
+  command_line::add_arg(desc, arg_p2p_connection_fanout);
+  command_line::add_arg(desc, arg_p2p_request_rate);
+  command_line::add_arg(desc, arg_p2p_request_burst);
 }
 
 NetNodeConfig::NetNodeConfig() {
@@ -79,6 +85,9 @@ NetNodeConfig::NetNodeConfig() {
   externalPort = 0;
   allowLocalIp = false;
   hideMyPort = false;
+  connectionFanout = P2P_DEFAULT_CONNECTION_FANOUT;
+  requestRate = P2P_DEFAULT_REQUEST_RATE;
+  requestBurst = P2P_DEFAULT_REQUEST_BURST;
   configFolder = tools::get_default_data_dir();
 }
 
@@ -122,6 +131,10 @@ bool NetNodeConfig::init(const boost::program_options::variables_map& vm)
   if(command_line::has_arg(vm, arg_p2p_hide_my_port))
     hideMyPort = true;
 
+  connectionFanout = std::max<uint32_t>(command_line::get_arg(vm, arg_p2p_connection_fanout), 1);
+  requestRate = command_line::get_arg(vm, arg_p2p_request_rate);
+  requestBurst = command_line::get_arg(vm, arg_p2p_request_burst);
+
   return true;
 }
 
@@ -41,6 +41,10 @@ public:
   std::vector<net_address> exclusiveNodes;
   std::vector<net_address> seedNodes;
   bool hideMyPort;
+  uint32_t connectionFanout;
+  // work units per second and at once a peer may spend on its requests, 0 rate disables the limit
+  uint32_t requestRate;
+  uint32_t requestBurst;
   std::string configFolder;
 };
 
@@ -17,6 +17,7 @@
 
 #include "PeerListManager.h"
 
+#include <algorithm>
 #include <time.h>
 #include <boost/foreach.hpp>
 #include <System/Ipv4Address.h>
@@ -31,32 +32,66 @@ bool peerlist_manager::init(bool allow_local_ip)
 }
 
 //--------------------------------------------------------------------------------------------------
- void peerlist_manager::trim_white_peerlist()
+void peerlist_manager::insert_sorted(peers_indexed& peers, const peerlist_entry& ple)
 {
-  while (m_peers_gray.size() > CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT)
-  {
-    peers_indexed::index<by_time>::type& sorted_index = m_peers_gray.get<by_time>();
-    sorted_index.erase(sorted_index.begin());
+  peers_indexed::index<by_time>::type& by_time_index = peers.get<by_time>();
+  auto it = std::upper_bound(by_time_index.begin(), by_time_index.end(), ple, [](const peerlist_entry& a, const peerlist_entry& b) {
+    return a.last_seen < b.last_seen;
+  });
+
+  by_time_index.insert(it, ple);
+}
+//--------------------------------------------------------------------------------------------------
+
+void peerlist_manager::trim_peerlist(peers_indexed& peers, size_t limit)
+{
+  if (peers.size() > limit) {
+    // the oldest entries are in front
+    peers_indexed::index<by_time>::type& by_time_index = peers.get<by_time>();
+    by_time_index.erase(by_time_index.begin(), by_time_index.begin() + (peers.size() - limit));
   }
 }
 //--------------------------------------------------------------------------------------------------
- void peerlist_manager::trim_gray_peerlist()
+
+void peerlist_manager::load_legacy_peerlist(peers_indexed& peers, const legacy_peers_indexed& legacy)
 {
-  while (m_peers_white.size() > CryptoNote::P2P_LOCAL_WHITE_PEERLIST_LIMIT)
-  {
-    peers_indexed::index<by_time>::type& sorted_index = m_peers_white.get<by_time>();
-    sorted_index.erase(sorted_index.begin());
+  peers.clear();
+  for (const peerlist_entry& ple : legacy.get<by_time>()) {
+    peers.get<by_time>().push_back(ple);
   }
 }
 //--------------------------------------------------------------------------------------------------
 
-bool peerlist_manager::merge_peerlist(const std::list<peerlist_entry>& outer_bs)
+void peerlist_manager::trim_white_peerlist()
+{
+  trim_peerlist(m_peers_white, CryptoNote::P2P_LOCAL_WHITE_PEERLIST_LIMIT);
+}
+//--------------------------------------------------------------------------------------------------
+
+void peerlist_manager::trim_gray_peerlist()
+{
+  trim_peerlist(m_peers_gray, CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT);
+}
+//--------------------------------------------------------------------------------------------------
+
+bool peerlist_manager::merge_peerlist(const std::list<peerlist_entry>& outer_bs, int64_t time_delta)
 { 
   for(const peerlist_entry& be : outer_bs) {
-    append_with_peer_gray(be);
+    if (!is_ip_allowed(be.adr.ip) || m_peers_white.get<by_addr>().count(be.adr) != 0) {
+      continue;
+    }
+
+    peerlist_entry ple = be;
+    ple.last_seen += time_delta;
+    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
+    if (by_addr_it_gr != m_peers_gray.get<by_addr>().end()) {
+      m_peers_gray.get<by_addr>().erase(by_addr_it_gr);
+    }
+
+    insert_sorted(m_peers_gray, ple);
   }
 
-  // delete extra elements
+  // delete extra elements once for the whole list
   trim_gray_peerlist();
   return true;
 }
@@ -67,12 +102,8 @@ bool peerlist_manager::get_white_peer_by_index(peerlist_entry& p, size_t i)
   if (i >= m_peers_white.size())
     return false;
 
-  peers_indexed::index<by_time>::type& by_time_index = m_peers_white.get<by_time>();
-
-  auto it = by_time_index.rbegin();
-  std::advance(it, i);
-  p = *it;
-
+  // most recent peer is the last one
+  p = m_peers_white.get<by_time>()[m_peers_white.size() - 1 - i];
   return true;
 }
 //--------------------------------------------------------------------------------------------------
@@ -82,12 +113,7 @@ bool peerlist_manager::get_gray_peer_by_index(peerlist_entry& p, size_t i)
   if (i >= m_peers_gray.size())
     return false;
 
-  peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
-  
-  auto it = by_time_index.rbegin();
-  std::advance(it, i);
-  p = *it;
-
+  p = m_peers_gray.get<by_time>()[m_peers_gray.size() - 1 - i];
   return true;
 }
 //--------------------------------------------------------------------------------------------------
@@ -109,13 +135,15 @@ bool peerlist_manager::is_ip_allowed(uint32_t ip)
 }
 //--------------------------------------------------------------------------------------------------
 
-bool peerlist_manager::get_peerlist_head(std::list<peerlist_entry>& bs_head, uint32_t depth)
+bool peerlist_manager::get_peerlist_head(std::list<peerlist_entry>& bs_head, uint32_t depth, time_t seen_since)
 {
   peers_indexed::index<by_time>::type& by_time_index = m_peers_white.get<by_time>();
   uint32_t cnt = 0;
 
   BOOST_REVERSE_FOREACH(const peers_indexed::value_type& vl, by_time_index)
   {
+    if (vl.last_seen < seen_since)
+      break;
     if (!vl.last_seen)
       continue;
     bs_head.push_back(vl);
@@ -173,16 +201,17 @@ bool peerlist_manager::append_with_peer_white(const peerlist_entry& ple)
     auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
     if (by_addr_it_wt == m_peers_white.get<by_addr>().end()) {
       //put new record into white list
-      m_peers_white.insert(ple);
+      insert_sorted(m_peers_white, ple);
       trim_white_peerlist();
     } else {
-      //update record in white list 
-      m_peers_white.replace(by_addr_it_wt, ple);
+      //update record in white list, last_seen changes its position
+      m_peers_white.get<by_addr>().erase(by_addr_it_wt);
+      insert_sorted(m_peers_white, ple);
     }
     //remove from gray list, if need
     auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
     if (by_addr_it_gr != m_peers_gray.get<by_addr>().end()) {
-      m_peers_gray.erase(by_addr_it_gr);
+      m_peers_gray.get<by_addr>().erase(by_addr_it_gr);
     }
     return true;
   } catch (std::exception&) {
@@ -206,13 +235,14 @@ bool peerlist_manager::append_with_peer_gray(const peerlist_entry& ple)
     auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
     if (by_addr_it_gr == m_peers_gray.get<by_addr>().end())
     {
-      //put new record into white list
-      m_peers_gray.insert(ple);
+      //put new record into gray list
+      insert_sorted(m_peers_gray, ple);
       trim_gray_peerlist();
     } else
     {
-      //update record in white list 
-      m_peers_gray.replace(by_addr_it_gr, ple);
+      //update record in gray list, last_seen changes its position
+      m_peers_gray.get<by_addr>().erase(by_addr_it_gr);
+      insert_sorted(m_peers_gray, ple);
     }
     return true;
   } catch (std::exception&) {
@@ -220,3 +250,46 @@ bool peerlist_manager::append_with_peer_gray(const peerlist_entry& ple)
   return false;
 }
 //--------------------------------------------------------------------------------------------------
+
+PeerPerformance peerlist_manager::get_peer_performance(const net_address& adr) const
+{
+  auto it = m_performance.find(adr);
+  return it != m_performance.end() ? it->second : PeerPerformance();
+}
+//--------------------------------------------------------------------------------------------------
+
+void peerlist_manager::set_peer_connected(const net_address& adr, std::chrono::microseconds connect_time)
+{
+  get_performance_record(adr).connected(connect_time);
+}
+//--------------------------------------------------------------------------------------------------
+
+void peerlist_manager::set_peer_connection_failed(const net_address& adr)
+{
+  get_performance_record(adr).failed();
+}
+//--------------------------------------------------------------------------------------------------
+
+void peerlist_manager::set_peer_transfer_speed(const net_address& adr, uint64_t bytes_per_second)
+{
+  get_performance_record(adr).transferMeasured(bytes_per_second);
+}
+//--------------------------------------------------------------------------------------------------
+
+PeerPerformance& peerlist_manager::get_performance_record(const net_address& adr)
+{
+  if (m_performance.size() >= CryptoNote::P2P_LOCAL_WHITE_PEERLIST_LIMIT + CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT &&
+    m_performance.count(adr) == 0) {
+    // drop records of peers which left both lists
+    for (auto it = m_performance.begin(); it != m_performance.end();) {
+      if (m_peers_white.get<by_addr>().count(it->first) == 0 && m_peers_gray.get<by_addr>().count(it->first) == 0) {
+        it = m_performance.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  return m_performance[adr];
+}
+//--------------------------------------------------------------------------------------------------
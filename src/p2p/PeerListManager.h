@@ -17,14 +17,20 @@
 
 #pragma once
 
+#include <functional>
 #include <list>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/random_access_index.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/member.hpp>
 
 #include "p2p_protocol_types.h"
+#include "PeerPerformance.h"
 #include "cryptonote_config.h"
 
 namespace CryptoNote {
@@ -38,8 +44,10 @@ public:
   bool init(bool allow_local_ip);
   size_t get_white_peers_count(){ return m_peers_white.size(); }
   size_t get_gray_peers_count(){ return m_peers_gray.size(); }
-  bool merge_peerlist(const std::list<peerlist_entry>& outer_bs);
-  bool get_peerlist_head(std::list<peerlist_entry>& bs_head, uint32_t depth = CryptoNote::P2P_DEFAULT_PEERS_IN_HANDSHAKE);
+  // time_delta is added to last_seen of every merged entry
+  bool merge_peerlist(const std::list<peerlist_entry>& outer_bs, int64_t time_delta = 0);
+  // seen_since limits the head to peers seen at or after the time, for sending changes only
+  bool get_peerlist_head(std::list<peerlist_entry>& bs_head, uint32_t depth = CryptoNote::P2P_DEFAULT_PEERS_IN_HANDSHAKE, time_t seen_since = 0);
   bool get_peerlist_full(std::list<peerlist_entry>& pl_gray, std::list<peerlist_entry>& pl_white);
   bool get_white_peer_by_index(peerlist_entry& p, size_t i);
   bool get_gray_peer_by_index(peerlist_entry& p, size_t i);
@@ -51,6 +59,11 @@ public:
   bool is_ip_allowed(uint32_t ip);
   void trim_white_peerlist();
   void trim_gray_peerlist();
+  // performance records of peers, a peer without record gets a default one
+  PeerPerformance get_peer_performance(const net_address& adr) const;
+  void set_peer_connected(const net_address& adr, std::chrono::microseconds connect_time);
+  void set_peer_connection_failed(const net_address& adr);
+  void set_peer_transfer_speed(const net_address& adr, uint64_t bytes_per_second);
 
 private:
 
@@ -58,15 +71,49 @@ private:
   struct by_id{};
   struct by_addr{};
 
+  struct address_hash {
+    size_t operator()(const net_address& adr) const {
+      return std::hash<uint64_t>()(static_cast<uint64_t>(adr.ip) << 32 | adr.port);
+    }
+  };
+
   typedef boost::multi_index_container<
     peerlist_entry,
     boost::multi_index::indexed_by<
+    // kept sorted by peerlist_entry::last_seen, so the i-th most recent peer is taken without walking the list
+    boost::multi_index::random_access<boost::multi_index::tag<by_time> >,
     // access by peerlist_entry::net_adress
+    boost::multi_index::hashed_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry, net_address, &peerlist_entry::adr>, address_hash>
+    >
+  > peers_indexed;
+
+  // layout of peer lists in archives of version 4
+  typedef boost::multi_index_container<
+    peerlist_entry,
+    boost::multi_index::indexed_by<
     boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry, net_address, &peerlist_entry::adr> >,
-    // sort by peerlist_entry::last_seen<
     boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry, time_t, &peerlist_entry::last_seen> >
     >
-  > peers_indexed;
+  > legacy_peers_indexed;
+
+  static void insert_sorted(peers_indexed& peers, const peerlist_entry& ple);
+  static void trim_peerlist(peers_indexed& peers, size_t limit);
+  static void load_legacy_peerlist(peers_indexed& peers, const legacy_peers_indexed& legacy);
+
+  typedef std::unordered_map<net_address, PeerPerformance, address_hash> performance_map;
+
+  struct performance_entry {
+    net_address adr;
+    PeerPerformance performance;
+
+    template <class Archive>
+    void serialize(Archive& a, const unsigned int /*version*/) {
+      a & adr;
+      a & performance;
+    }
+  };
+
+  PeerPerformance& get_performance_record(const net_address& adr);
 
 public:
 
@@ -76,8 +123,40 @@ public:
     if (ver < 4)
       return;
 
+    if (ver < 5) {
+      legacy_peers_indexed white;
+      legacy_peers_indexed gray;
+      a & white;
+      a & gray;
+      load_legacy_peerlist(m_peers_white, white);
+      load_legacy_peerlist(m_peers_gray, gray);
+      return;
+    }
+
     a & m_peers_white;
     a & m_peers_gray;
+
+    if (ver < 6)
+      return;
+
+    std::vector<performance_entry> performance;
+    if (Archive::is_saving::value) {
+      for (const auto& record : m_performance) {
+        performance_entry entry;
+        entry.adr = record.first;
+        entry.performance = record.second;
+        performance.push_back(entry);
+      }
+    }
+
+    a & performance;
+
+    if (Archive::is_loading::value) {
+      m_performance.clear();
+      for (const performance_entry& entry : performance) {
+        m_performance.insert(std::make_pair(entry.adr, entry.performance));
+      }
+    }
   }
 
 private:
@@ -87,8 +166,9 @@ private:
   bool m_allow_local_ip;
   peers_indexed m_peers_gray;
   peers_indexed m_peers_white;
+  performance_map m_performance;
 };
 
 }
 
-BOOST_CLASS_VERSION(CryptoNote::peerlist_manager, 4)
+BOOST_CLASS_VERSION(CryptoNote::peerlist_manager, 6)
@@ -0,0 +1,114 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace CryptoNote {
+
+// Record of a peer kept across connections: time to connect and handshake, download speed of past connections and
+// share of failed connection attempts. Outgoing connections prefer peers with lower expected cost, a peer without
+// record gets moderate defaults, so it is tried before known slow peers and after known fast ones.
+class PeerPerformance {
+public:
+  PeerPerformance() : m_connectTime(0), m_bytesPerSecond(0), m_attempts(0), m_failures(0) {}
+
+  void connected(std::chrono::microseconds connectTime) {
+    m_connectTime = average(m_connectTime, std::max<uint64_t>(connectTime.count(), 1));
+    addAttempt(false);
+  }
+
+  void failed() {
+    addAttempt(true);
+  }
+
+  void transferMeasured(uint64_t bytesPerSecond) {
+    if (bytesPerSecond != 0) {
+      m_bytesPerSecond = average(m_bytesPerSecond, bytesPerSecond);
+    }
+  }
+
+  // Expected microseconds to connect and download REFERENCE_BYTES, divided by the estimated chance of connecting
+  uint64_t cost() const {
+    uint64_t connectTime = m_connectTime != 0 ? m_connectTime : DEFAULT_CONNECT_TIME;
+    uint64_t bytesPerSecond = m_bytesPerSecond != 0 ? m_bytesPerSecond : DEFAULT_BYTES_PER_SECOND;
+    uint64_t time = connectTime + REFERENCE_BYTES * MICROSECONDS / bytesPerSecond;
+    // add-one smoothing, so a single failure of a new peer doesn't rule it out
+    return time * (m_attempts + 2) / (m_attempts - m_failures + 1);
+  }
+
+  bool measured() const {
+    return m_attempts != 0;
+  }
+
+  uint64_t connectTime() const {
+    return m_connectTime;
+  }
+
+  uint64_t bytesPerSecond() const {
+    return m_bytesPerSecond;
+  }
+
+  uint32_t attempts() const {
+    return m_attempts;
+  }
+
+  uint32_t failures() const {
+    return m_failures;
+  }
+
+  template<class Archive> void serialize(Archive& a, const unsigned int /*version*/) {
+    a & m_connectTime;
+    a & m_bytesPerSecond;
+    a & m_attempts;
+    a & m_failures;
+  }
+
+private:
+  static const uint64_t MICROSECONDS = 1000000;
+  static const uint64_t DEFAULT_CONNECT_TIME = 500000;
+  static const uint64_t DEFAULT_BYTES_PER_SECOND = 256 * 1024;
+  static const uint64_t REFERENCE_BYTES = 1024 * 1024;
+  // counters are halved on reaching it, so old failures weigh less than recent ones
+  static const uint32_t MAX_ATTEMPTS = 16;
+
+  void addAttempt(bool failure) {
+    if (m_attempts == MAX_ATTEMPTS) {
+      m_attempts /= 2;
+      m_failures /= 2;
+    }
+
+    ++m_attempts;
+    if (failure) {
+      ++m_failures;
+    }
+  }
+
+  static uint64_t average(uint64_t current, uint64_t sample) {
+    return current == 0 ? sample : (current * 3 + sample) / 4;
+  }
+
+  uint64_t m_connectTime;
+  uint64_t m_bytesPerSecond;
+  uint32_t m_attempts;
+  uint32_t m_failures;
+};
+
+}
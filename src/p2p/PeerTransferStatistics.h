@@ -0,0 +1,97 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace CryptoNote {
+
+// Round trip time and download speed of a peer measured on synchronization requests. Peer answers one request at
+// a time, so the delay of a response of block ids is mostly the round trip time and the rest of the delay of a
+// response of blocks is spent transferring them. Samples are smoothed by exponential moving average.
+class PeerTransferStatistics {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  PeerTransferStatistics() : m_roundTripTime(0), m_bytesPerSecond(0), m_blockSize(0) {}
+
+  void requestSent(Clock::time_point now) {
+    m_requestSentAt = now;
+  }
+
+  // response to a request of block ids, it is small compared to blocks, so it mostly measures the round trip
+  void idsReceived(Clock::time_point now, uint64_t bytes) {
+    uint64_t transferTime = m_bytesPerSecond == 0 ? 0 : bytes * MICROSECONDS / m_bytesPerSecond;
+    m_roundTripTime = average(m_roundTripTime, std::max<uint64_t>(elapsed(now) - std::min(elapsed(now), transferTime), 1));
+  }
+
+  void objectsReceived(Clock::time_point now, uint64_t bytes, size_t blocks) {
+    if (blocks == 0) {
+      return;
+    }
+
+    uint64_t transferTime = elapsed(now) - std::min(elapsed(now), m_roundTripTime);
+    if (transferTime < MIN_TRANSFER_TIME) {
+      transferTime = MIN_TRANSFER_TIME;
+    }
+
+    m_bytesPerSecond = average(m_bytesPerSecond, std::max<uint64_t>(bytes * MICROSECONDS / transferTime, 1));
+    m_blockSize = average(m_blockSize, std::max<uint64_t>(bytes / blocks, 1));
+  }
+
+  // Count of blocks to request so that the response takes responseTime and several round trips to transfer
+  // and fits into maxBytes. defaultCount is returned until speed of the peer is measured.
+  size_t blocksPerRequest(Clock::duration responseTime, uint64_t maxBytes, size_t defaultCount, size_t maxCount) const {
+    if (m_bytesPerSecond == 0) {
+      return std::min(defaultCount, maxCount);
+    }
+
+    uint64_t time = std::max<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(responseTime).count(), 4 * m_roundTripTime);
+    uint64_t budget = std::min(maxBytes, static_cast<uint64_t>(static_cast<double>(m_bytesPerSecond) * time / MICROSECONDS));
+    return static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(maxCount, budget / m_blockSize)));
+  }
+
+  std::chrono::microseconds roundTripTime() const {
+    return std::chrono::microseconds(m_roundTripTime);
+  }
+
+  uint64_t bytesPerSecond() const {
+    return m_bytesPerSecond;
+  }
+
+private:
+  static const uint64_t MICROSECONDS = 1000000;
+  static const uint64_t MIN_TRANSFER_TIME = 1000;
+
+  uint64_t elapsed(Clock::time_point now) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - m_requestSentAt).count();
+  }
+
+  static uint64_t average(uint64_t current, uint64_t sample) {
+    return current == 0 ? sample : (current * 3 + sample) / 4;
+  }
+
+  Clock::time_point m_requestSentAt;
+  uint64_t m_roundTripTime;
+  uint64_t m_bytesPerSecond;
+  uint64_t m_blockSize;
+};
+
+}
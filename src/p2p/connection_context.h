@@ -17,13 +17,15 @@
 
 #pragma once
 
-#include <list>
 #include <ostream>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <boost/uuid/uuid.hpp>
 #include "Common/StringTools.h"
+#include "Common/TokenBucket.h"
 #include "crypto/hash.h"
+#include "PeerTransferStatistics.h"
 
 namespace CryptoNote {
 
@@ -44,10 +46,17 @@ struct cryptonote_connection_context {
   };
 
   state m_state = state_befor_handshake;
-  std::list<crypto::hash> m_needed_objects;
-  std::unordered_set<crypto::hash> m_requested_objects;
+  // positions of blocks the peer can send in the download queue shared by connections, see BlockDownloadScheduler
+  std::vector<std::pair<uint64_t, uint64_t>> m_needed_objects;
+  // sorted ids of blocks awaited in response to the last request
+  std::vector<crypto::hash> m_requested_objects;
   uint64_t m_remote_blockchain_height = 0;
   uint64_t m_last_response_height = 0;
+  uint8_t m_version = 0;
+  std::vector<crypto::hash> m_tx_announcements;
+  PeerTransferStatistics m_transfer_statistics;
+  // work of serving requests of the peer, see cryptonote_protocol_handler::throttleRequest
+  Common::TokenBucket m_request_budget;
 };
 
 inline std::string get_protocol_state_string(cryptonote_connection_context::state s) {
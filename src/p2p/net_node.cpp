@@ -51,6 +51,19 @@ using namespace CryptoNote;
 
 namespace {
 
+// FNV-1a of the entries
+uint64_t get_peerlist_checksum(const std::list<peerlist_entry>& peerlist) {
+  uint64_t checksum = 14695981039346656037ULL;
+  for (const peerlist_entry& entry : peerlist) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&entry);
+    for (size_t i = 0; i < sizeof(entry); ++i) {
+      checksum = (checksum ^ data[i]) * 1099511628211ULL;
+    }
+  }
+
+  return checksum;
+}
+
 size_t get_random_index_with_fixed_probability(size_t max_index) {
   //divide by zero workaround
   if (!max_index)
@@ -98,6 +111,25 @@ bool parse_peer_from_string(net_address& pe, const std::string& node_addr) {
   return Common::parseIpAddressAndPort(pe.ip, pe.port, node_addr);
 }
 
+// Blocks just mined or relayed and transactions completing them are waited for by the whole network, while served
+// blocks and transaction relays are bulk traffic nobody is blocked on
+p2p_connection_context::WritePriority writePriority(int command) {
+  switch (command) {
+  case NOTIFY_NEW_BLOCK::ID:
+  case NOTIFY_NEW_COMPACT_BLOCK::ID:
+  case NOTIFY_REQUEST_BLOCK_TRANSACTIONS::ID:
+  case NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::ID:
+    return p2p_connection_context::WRITE_PRIORITY_HIGH;
+  case NOTIFY_RESPONSE_GET_OBJECTS::ID:
+  case NOTIFY_NEW_TRANSACTIONS::ID:
+  case NOTIFY_TX_ANNOUNCE::ID:
+  case NOTIFY_REQUEST_TXS::ID:
+    return p2p_connection_context::WRITE_PRIORITY_BULK;
+  default:
+    return p2p_connection_context::WRITE_PRIORITY_NORMAL;
+  }
+}
+
 }
 
 
@@ -130,7 +162,7 @@ namespace CryptoNote
 
 
   template <typename Command, typename Handler>
-  int invokeAdaptor(const std::string& reqBuf, std::string& resBuf, p2p_connection_context& ctx, Handler handler) {
+  int invokeAdaptor(Common::StringView reqBuf, std::string& resBuf, p2p_connection_context& ctx, Handler handler) {
     typedef typename Command::request Request;
     typedef typename Command::response Response;
     int command = Command::ID;
@@ -152,12 +184,14 @@ namespace CryptoNote
     m_payload_handler(payload_handler),
     m_allow_local_ip(false),
     m_hide_my_port(false),
+    m_connection_fanout(CryptoNote::P2P_DEFAULT_CONNECTION_FANOUT),
     m_network_id(BYTECOIN_NETWORK),
     logger(log, "node_server"),
     m_stopEvent(m_dispatcher),
     m_shutdownCompleteEvent(m_dispatcher),
     m_idleTimer(m_dispatcher),
     m_timedSyncTimer(m_dispatcher),
+    m_trafficLog(nullptr),
     m_spawnCount(0),
     m_stop(false),
     // intervals
@@ -170,6 +204,34 @@ namespace CryptoNote
 #define INVOKE_HANDLER(CMD, Handler) case CMD::ID: { ret = invokeAdaptor<CMD>(cmd.buf, out, ctx,  boost::bind(Handler, this, _1, _2, _3, _4)); break; }
 
   int node_server::handleCommand(const LevinProtocol::Command& cmd, std::string& out, p2p_connection_context& ctx, bool& handled) {
+    if (m_trafficLog != nullptr) {
+      // first bytes of the connection id tell connections apart in the log
+      uint64_t stream;
+      memcpy(&stream, ctx.m_connection_id.data, sizeof(stream));
+      uint8_t flags = (cmd.isNotify ? Common::TrafficRecord::NOTIFY : 0) | (cmd.isResponse ? Common::TrafficRecord::RESPONSE : 0);
+      m_trafficLog->write(Common::TrafficRecord::P2P, flags, cmd.command, stream, std::string(), cmd.buf);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int ret = processCommand(cmd, out, ctx, handled);
+    // command ids come from peers, unhandled ones share a label so they can't grow the registry
+    getCommandMetric(handled ? cmd.command : 0).observe(std::chrono::steady_clock::now() - start);
+    return ret;
+  }
+
+  Common::MetricHistogram& node_server::getCommandMetric(int command) {
+    auto it = m_commandMetrics.find(command);
+    if (it == m_commandMetrics.end()) {
+      std::string label = command != 0 ? std::to_string(command) : "unknown";
+      Common::MetricHistogram& metric = Common::MetricsRegistry::global().histogram("p2p_command_duration_microseconds",
+        "Time to handle Levin commands by command id", { { "command", label } });
+      it = m_commandMetrics.emplace(command, &metric).first;
+    }
+
+    return *it->second;
+  }
+
+  int node_server::processCommand(const LevinProtocol::Command& cmd, std::string& out, p2p_connection_context& ctx, bool& handled) {
     int ret = 0;
     handled = true;
 
@@ -257,8 +319,10 @@ namespace CryptoNote
 
   //----------------------------------------------------------------------------------- 
   void node_server::externalRelayNotifyToAll(int command, const std::string& data_buff) {
-    m_dispatcher.remoteSpawn([this, command, data_buff] {
-      relay_notify_to_all(command, data_buff, nullptr);
+    // serialized in the calling thread, the dispatcher only writes the shared frame
+    LevinProtocol::Frame frame = LevinProtocol::makeNotification(command, data_buff);
+    m_dispatcher.remoteSpawn([this, command, frame] {
+      relayFrame(command, frame, nullptr);
     });
   }
 
@@ -323,6 +387,8 @@ namespace CryptoNote
     std::copy(config.seedNodes.begin(), config.seedNodes.end(), std::back_inserter(m_seed_nodes));
 
     m_hide_my_port = config.hideMyPort;
+    m_connection_fanout = config.connectionFanout;
+    m_payload_handler.set_request_limits(config.requestRate, config.requestBurst);
     return true;
   }
 
@@ -419,13 +485,13 @@ namespace CryptoNote
     logger(INFO) << "Starting node_server";
 
     ++m_spawnCount;
-    m_dispatcher.spawn(std::bind(&node_server::acceptLoop, this));
+    m_dispatcher.spawn(std::bind(&node_server::acceptLoop, this), "node_server::acceptLoop");
 
     ++m_spawnCount;
-    m_dispatcher.spawn(std::bind(&node_server::onIdle, this));
+    m_dispatcher.spawn(std::bind(&node_server::onIdle, this), "node_server::onIdle");
 
     ++m_spawnCount;
-    m_dispatcher.spawn(std::bind(&node_server::timedSyncLoop, this));
+    m_dispatcher.spawn(std::bind(&node_server::timedSyncLoop, this), "node_server::timedSyncLoop");
 
     m_stopEvent.wait();
 
@@ -438,7 +504,7 @@ namespace CryptoNote
     logger(INFO) << "Stopping " << m_connections.size() << " connections";
 
     for (auto& conn : m_connections) {
-      conn.second.connection.stop();
+      conn.second.stop();
     }
 
     m_shutdownCompleteEvent.wait();
@@ -528,6 +594,8 @@ namespace CryptoNote
     }
 
     context.peer_id = rsp.node_data.peer_id;
+    context.compression = (rsp.node_data.features & P2P_FEATURE_COMPRESSION) != 0;
+    context.fragments = (rsp.node_data.features & P2P_FEATURE_FRAGMENTS) != 0;
     m_peerlist.set_peer_just_seen(rsp.node_data.peer_id, context.m_remote_ip, context.m_remote_port);
 
     if (rsp.node_data.peer_id == m_config.m_peer_id)  {
@@ -543,21 +611,14 @@ namespace CryptoNote
   bool node_server::timedSync() {   
     COMMAND_TIMED_SYNC::request arg = AUTO_VAL_INIT(arg);
     m_payload_handler.get_payload_sync_data(arg.payload_data);
-    auto cmdBuf = LevinProtocol::encode<COMMAND_TIMED_SYNC::request>(arg);
+    LevinProtocol::Frame frame = LevinProtocol::makeRequest(COMMAND_TIMED_SYNC::ID, LevinProtocol::encode<COMMAND_TIMED_SYNC::request>(arg));
 
-    forEachConnection([&](p2p_connection_context& conn) {
-      if (conn.peer_id && 
-          (conn.m_state == cryptonote_connection_context::state_normal || 
-           conn.m_state == cryptonote_connection_context::state_idle)) {
-        try {
-          System::LatchGuard latch(conn.writeLatch);
-          System::EventLock lock(conn.connectionEvent);
-          LevinProtocol(conn.connection).sendBuf(COMMAND_TIMED_SYNC::ID, cmdBuf, true, false);
-        } catch (std::exception&) {
-          logger(DEBUGGING) << conn << "Failed to send COMMAND_TIMED_SYNC";
-        }
+    for (size_t i = 0; i < m_relayTargets.size(); ++i) {
+      p2p_connection_context& conn = *m_relayTargets[i];
+      if (conn.m_state == cryptonote_connection_context::state_normal || conn.m_state == cryptonote_connection_context::state_idle) {
+        enqueueFrame(conn, frame, p2p_connection_context::WRITE_PRIORITY_NORMAL);
       }
-    });
+    }
 
     return true;
   }
@@ -568,9 +629,15 @@ namespace CryptoNote
       return false;
     }
 
-    if (!handle_remote_peerlist(rsp.local_peerlist, rsp.local_time, context)) {
-      logger(Logging::ERROR) << context << "COMMAND_TIMED_SYNC: failed to handle_remote_peerlist(...), closing connection.";
-      return false;
+    //peers sending changes only send empty list when nothing changed, others repeat the same head
+    uint64_t checksum = get_peerlist_checksum(rsp.local_peerlist);
+    if (!rsp.local_peerlist.empty() && checksum != context.peerlistReceivedChecksum) {
+      if (!handle_remote_peerlist(rsp.local_peerlist, rsp.local_time, context)) {
+        logger(Logging::ERROR) << context << "COMMAND_TIMED_SYNC: failed to handle_remote_peerlist(...), closing connection.";
+        return false;
+      }
+
+      context.peerlistReceivedChecksum = checksum;
     }
 
     if (!context.m_is_income) {
@@ -584,28 +651,14 @@ namespace CryptoNote
     return true;
   }
 
-  void node_server::forEachConnection(std::function<void(p2p_connection_context&)> action) {
-
-    // create copy of connection ids because the list can be changed during action
-    std::vector<boost::uuids::uuid> connectionIds;
-    connectionIds.reserve(m_connections.size());
-    for (const auto& c : m_connections) {
-      connectionIds.push_back(c.first);
-    }
-
-    for (const auto& connId : connectionIds) {
-      auto it = m_connections.find(connId);
-      if (it != m_connections.end()) {
-        action(it->second);
-      }
-    }
-  }
-
   //----------------------------------------------------------------------------------- 
   bool node_server::is_peer_used(const peerlist_entry& peer) {
     if(m_config.m_peer_id == peer.id)
       return true; //dont make connections to ourself
 
+    if (m_connecting_peers.count(peer.adr) != 0)
+      return true;
+
     for (const auto& kv : m_connections) {
       const auto& cntxt = kv.second;
       if(cntxt.peer_id == peer.id || (!cntxt.m_is_income && peer.adr.ip == cntxt.m_remote_ip && peer.adr.port == cntxt.m_remote_port)) {
@@ -631,6 +684,7 @@ namespace CryptoNote
     logger(DEBUGGING) << "Connecting to " << na << " (white=" << white << ", last_seen: "
         << (last_seen_stamp ? Common::timeIntervalToString(time(NULL) - last_seen_stamp) : "never") << ")...";
 
+    auto connect_started = std::chrono::steady_clock::now();
     try {
       System::TcpConnector connector(m_dispatcher);
       
@@ -651,6 +705,10 @@ namespace CryptoNote
         connection = connector.connect(System::Ipv4Address(Common::ipAddressToString(na.ip)), static_cast<uint16_t>(na.port));
       } catch (System::InterruptedException&) {
         timeoutEvent.wait();
+        if (!m_stop) {
+          m_peerlist.set_peer_connection_failed(na);
+        }
+
         return false;
       } catch (std::exception&) {
         timeoutTimer.stop();
@@ -675,9 +733,12 @@ namespace CryptoNote
 
       if (!handshake(proto, ctx, just_take_peerlist)) {
         logger(WARNING) << "Failed to HANDSHAKE with peer " << na;
+        m_peerlist.set_peer_connection_failed(na);
         return false;
       }
 
+      m_peerlist.set_peer_connected(na, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - connect_started));
+
       if (just_take_peerlist) {
         logger(Logging::DEBUGGING, Logging::BRIGHT_GREEN) << ctx << "CONNECTION HANDSHAKED OK AND CLOSED.";
         return true;
@@ -696,7 +757,7 @@ namespace CryptoNote
       auto iter = m_connections.emplace(ctx.m_connection_id, std::move(ctx)).first;
 
       ++m_spawnCount;
-      m_dispatcher.spawn(std::bind(&node_server::connectionHandler, this, iter));
+      m_dispatcher.spawn(std::bind(&node_server::connectionHandler, this, iter), "node_server::connectionHandler");
 
       return true;
     } catch (System::InterruptedException&) {
@@ -704,6 +765,7 @@ namespace CryptoNote
       throw;
     } catch (const std::exception& e) {
       logger(DEBUGGING) << "Connection to " << na << " failed: " << e.what();
+      m_peerlist.set_peer_connection_failed(na);
     }
 
     return false;
@@ -730,11 +792,32 @@ namespace CryptoNote
       if(tried_peers.count(random_index))
         continue;
 
-      tried_peers.insert(random_index);
       peerlist_entry pe = AUTO_VAL_INIT(pe);
       bool r = use_white_list ? m_peerlist.get_white_peer_by_index(pe, random_index):m_peerlist.get_gray_peer_by_index(pe, random_index);
       if (!(r)) { logger(ERROR, BRIGHT_RED) << "Failed to get random peer from peerlist(white:" << use_white_list << ")"; return false; }
 
+      //prefer the peer which served fastest among a few candidates, unless exploring
+      if (crypto::rand<size_t>() % 100 >= CryptoNote::P2P_PEER_EXPLORATION_PERCENT) {
+        uint64_t cost = m_peerlist.get_peer_performance(pe.adr).cost();
+        for (size_t i = 1; i < CryptoNote::P2P_PEER_SELECTION_CANDIDATES; ++i) {
+          size_t candidate_index = get_random_index_with_fixed_probability(max_random_index);
+          peerlist_entry candidate = AUTO_VAL_INIT(candidate);
+          if (tried_peers.count(candidate_index) || !(use_white_list ? m_peerlist.get_white_peer_by_index(candidate, candidate_index) :
+            m_peerlist.get_gray_peer_by_index(candidate, candidate_index))) {
+            continue;
+          }
+
+          uint64_t candidate_cost = m_peerlist.get_peer_performance(candidate.adr).cost();
+          if (candidate_cost < cost) {
+            random_index = candidate_index;
+            pe = candidate;
+            cost = candidate_cost;
+          }
+        }
+      }
+
+      tried_peers.insert(random_index);
+
       ++try_count;
 
       if(is_peer_used(pe))
@@ -743,7 +826,18 @@ namespace CryptoNote
       logger(DEBUGGING) << "Selected peer: " << pe.id << " " << pe.adr << " [white=" << use_white_list
                     << "] last_seen: " << (pe.last_seen ? Common::timeIntervalToString(time(NULL) - pe.last_seen) : "never");
       
-      if(!try_to_connect_and_handshake_with_new_peer(pe.adr, false, pe.last_seen, use_white_list))
+      //other coroutines of connections maker skip the peer while it is being connected
+      m_connecting_peers.insert(pe.adr);
+      bool connected;
+      try {
+        connected = try_to_connect_and_handshake_with_new_peer(pe.adr, false, pe.last_seen, use_white_list);
+      } catch (...) {
+        m_connecting_peers.erase(pe.adr);
+        throw;
+      }
+
+      m_connecting_peers.erase(pe.adr);
+      if (!connected)
         continue;
 
       return true;
@@ -811,18 +905,45 @@ namespace CryptoNote
   
   bool node_server::make_expected_connections_count(bool white_list, size_t expected_connections)
   {
-    size_t conn_count = get_outgoing_connections_count();
-    //add new connections from white peers
-    while(conn_count < expected_connections)
-    {
-      if(m_stopEvent.get())
-        return false;
+    //connections are attempted by up to m_connection_fanout coroutines, so dead peers time out in parallel; there are
+    //never more attempts in flight than missing connections, so the first handshakes to succeed fill the slots
+    size_t connecting = 0;
+    size_t workers = 0;
+    System::Latch workersLatch(m_dispatcher);
+
+    auto worker = [this, white_list, expected_connections, &connecting, &workersLatch]() {
+      try {
+        while (!m_stop && get_outgoing_connections_count() + connecting < expected_connections) {
+          ++connecting;
+          bool connected;
+          try {
+            connected = make_new_connection_from_peerlist(white_list);
+          } catch (...) {
+            --connecting;
+            throw;
+          }
+
+          --connecting;
+          if (!connected)
+            break;
+        }
+      } catch (System::InterruptedException&) {
+      } catch (std::exception& e) {
+        logger(WARNING) << "Exception in connections maker: " << e.what();
+      }
 
-      if(!make_new_connection_from_peerlist(white_list))
-        break;
-      conn_count = get_outgoing_connections_count();
+      workersLatch.decrease();
+    };
+
+    size_t conn_count = get_outgoing_connections_count();
+    while (workers < m_connection_fanout && conn_count + workers < expected_connections) {
+      ++workers;
+      workersLatch.increase();
+      m_dispatcher.spawn(worker, "node_server::make_expected_connections_count");
     }
-    return true;
+
+    workersLatch.wait();
+    return !m_stopEvent.get();
   }
 
   //-----------------------------------------------------------------------------------
@@ -843,21 +964,20 @@ namespace CryptoNote
   }
 
   //-----------------------------------------------------------------------------------
-  bool node_server::fix_time_delta(std::list<peerlist_entry>& local_peerlist, time_t local_time, int64_t& delta)
+  bool node_server::fix_time_delta(const std::list<peerlist_entry>& local_peerlist, time_t local_time, int64_t& delta)
   {
-    //fix time delta
+    //fix time delta, entries are shifted by it when merged
     time_t now = 0;
     time(&now);
     delta = now - local_time;
 
-    BOOST_FOREACH(peerlist_entry& be, local_peerlist)
+    BOOST_FOREACH(const peerlist_entry& be, local_peerlist)
     {
       if(be.last_seen > local_time)
       {
         logger(ERROR) << "FOUND FUTURE peerlist for entry " << be.adr << " last_seen: " << be.last_seen << ", local_time(on remote node):" << local_time;
         return false;
       }
-      be.last_seen += delta;
     }
     return true;
   }
@@ -867,12 +987,11 @@ namespace CryptoNote
   bool node_server::handle_remote_peerlist(const std::list<peerlist_entry>& peerlist, time_t local_time, const cryptonote_connection_context& context)
   {
     int64_t delta = 0;
-    std::list<peerlist_entry> peerlist_ = peerlist;
-    if(!fix_time_delta(peerlist_, local_time, delta))
+    if(!fix_time_delta(peerlist, local_time, delta))
       return false;
-    logger(Logging::TRACE) << context << "REMOTE PEERLIST: TIME_DELTA: " << delta << ", remote peerlist size=" << peerlist_.size();
-    logger(Logging::TRACE) << context << "REMOTE PEERLIST: " <<  print_peerlist_to_string(peerlist_);
-    return m_peerlist.merge_peerlist(peerlist_);
+    logger(Logging::TRACE) << context << "REMOTE PEERLIST: TIME_DELTA: " << delta << ", remote peerlist size=" << peerlist.size();
+    logger(Logging::TRACE) << context << "REMOTE PEERLIST: " <<  print_peerlist_to_string(peerlist);
+    return m_peerlist.merge_peerlist(peerlist, delta);
   }
   //-----------------------------------------------------------------------------------
   
@@ -887,6 +1006,7 @@ namespace CryptoNote
     else 
       node_data.my_port = 0;
     node_data.network_id = m_network_id;
+    node_data.features = P2P_FEATURE_COMPRESSION | P2P_FEATURE_FRAGMENTS;
     return true;
   }
   //-----------------------------------------------------------------------------------
@@ -973,22 +1093,88 @@ namespace CryptoNote
   //-----------------------------------------------------------------------------------
   
   void node_server::relay_notify_to_all(int command, const std::string& data_buff, const net_connection_id* excludeConnection) {
+    relayFrame(command, LevinProtocol::makeNotification(command, data_buff), excludeConnection);
+  }
+
+  //-----------------------------------------------------------------------------------
+  void node_server::relayFrame(int command, const LevinProtocol::Frame& frame, const net_connection_id* excludeConnection) {
     net_connection_id excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<net_connection_id>();
 
-    forEachConnection([&](p2p_connection_context& conn) {
-      if (conn.peer_id && conn.m_connection_id != excludeId) {
-        try {
-          logger(TRACE) << conn << "Relay command " << command;
-          System::LatchGuard latch(conn.writeLatch);
-          System::EventLock lock(conn.connectionEvent);
-          LevinProtocol(conn.connection).sendBuf(command, data_buff, false);
-        } catch (const std::exception& e) {
-          logger(DEBUGGING) << conn << "Failed to relay notification id=" << command << ": " << e.what();
-        }
+    //queueing doesn't switch coroutines, so the list can't change meanwhile
+    p2p_connection_context::WritePriority priority = writePriority(command);
+    for (size_t i = 0; i < m_relayTargets.size(); ++i) {
+      p2p_connection_context& conn = *m_relayTargets[i];
+      if (conn.m_connection_id != excludeId) {
+        logger(TRACE) << conn << "Relay command " << command;
+        enqueueFrame(conn, frame, priority);
       }
-    });
+    }
+  }
+
+  //-----------------------------------------------------------------------------------
+  void node_server::addRelayTarget(p2p_connection_context& ctx) {
+    if (ctx.relayIndex == p2p_connection_context::NOT_RELAYED) {
+      ctx.relayIndex = m_relayTargets.size();
+      m_relayTargets.push_back(&ctx);
+    }
+  }
+
+  //-----------------------------------------------------------------------------------
+  void node_server::removeRelayTarget(p2p_connection_context& ctx) {
+    if (ctx.relayIndex != p2p_connection_context::NOT_RELAYED) {
+      m_relayTargets[ctx.relayIndex] = m_relayTargets.back();
+      m_relayTargets[ctx.relayIndex]->relayIndex = ctx.relayIndex;
+      m_relayTargets.pop_back();
+      ctx.relayIndex = p2p_connection_context::NOT_RELAYED;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------
+  void node_server::enqueueFrame(p2p_connection_context& context, const LevinProtocol::Frame& frame, p2p_connection_context::WritePriority priority) {
+    if (context.stopped) {
+      return;
+    }
+
+    // a large frame is accepted when nothing else is pending, otherwise it couldn't be sent at all
+    if (context.writeQueueSize != 0 && context.writeQueueSize + frame->size() > P2P_CONNECTION_MAX_WRITE_BUFFER_SIZE) {
+      logger(DEBUGGING) << context << "Peer doesn't read fast enough, " << context.writeQueueSize << " bytes are waiting to be sent, dropping connection";
+      context.m_state = cryptonote_connection_context::state_shutdown;
+      context.stop();
+      return;
+    }
+
+    // fragments of bulk notifications are queued together, so they never interleave with fragments of another message
+    std::deque<LevinProtocol::Frame>& queue = context.writeQueues[priority];
+    if (priority == p2p_connection_context::WRITE_PRIORITY_BULK && context.fragments && frame->size() > P2P_CONNECTION_FRAGMENT_SIZE) {
+      for (LevinProtocol::Frame& fragment : LevinProtocol::splitFrame(frame, P2P_CONNECTION_FRAGMENT_SIZE)) {
+        context.writeQueueSize += fragment->size();
+        queue.push_back(std::move(fragment));
+      }
+    } else {
+      queue.push_back(frame);
+      context.writeQueueSize += frame->size();
+    }
+
+    if (!context.writing) {
+      context.writing = true;
+      context.writeLatch.increase();
+      m_dispatcher.spawn(std::bind(&node_server::writeHandler, this, std::ref(context)), "node_server::writeHandler");
+    }
   }
  
+  //-----------------------------------------------------------------------------------
+  void node_server::relay_notify_to_list(int command, const std::string& data_buff, const std::list<net_connection_id>& connections) {
+    LevinProtocol::Frame frame = LevinProtocol::makeNotification(command, data_buff);
+    p2p_connection_context::WritePriority priority = writePriority(command);
+    for (const net_connection_id& connectionId : connections) {
+      auto it = m_connections.find(connectionId);
+      if (it != m_connections.end()) {
+        logger(TRACE) << it->second << "Relay command " << command;
+        enqueueFrame(it->second, frame, priority);
+      }
+    }
+  }
+
   //-----------------------------------------------------------------------------------
   bool node_server::invoke_notify_to_peer(int command, const std::string& req_buff, const cryptonote_connection_context& context) {
     auto it = m_connections.find(context.m_connection_id);
@@ -996,14 +1182,7 @@ namespace CryptoNote
       return false;
     }
 
-    try {
-      System::LatchGuard latch(it->second.writeLatch);
-      System::EventLock lock(it->second.connectionEvent);
-      LevinProtocol(it->second.connection).sendBuf(command, req_buff, false);
-    } catch (const std::exception& e) {
-      logger(DEBUGGING) << it->second << "Failed to invoke notification id=" << command << ": " << e.what();
-    }
-
+    enqueueFrame(it->second, LevinProtocol::makeNotification(command, req_buff, it->second.compression), writePriority(command));
     return true;
   }
 
@@ -1021,6 +1200,7 @@ namespace CryptoNote
     auto port = node_data.my_port;
     peerid_type pr = node_data.peer_id;
 
+    auto connect_started = std::chrono::steady_clock::now();
     try {
       System::TcpConnector connector(m_dispatcher);
       System::TcpConnection conn = connector.connect(System::Ipv4Address(ip), static_cast<uint16_t>(port));
@@ -1054,9 +1234,10 @@ namespace CryptoNote
       return 1;
     }
 
-    //fill response
+    //fill response, the peer got older entries with earlier responses
     rsp.local_time = time(NULL);
-    m_peerlist.get_peerlist_head(rsp.local_peerlist);
+    m_peerlist.get_peerlist_head(rsp.local_peerlist, CryptoNote::P2P_DEFAULT_PEERS_IN_HANDSHAKE, context.peerlistSentTime);
+    context.peerlistSentTime = rsp.local_time;
     m_payload_handler.get_payload_sync_data(rsp.payload_data);
     logger(Logging::TRACE) << context << "COMMAND_TIMED_SYNC";
     return 1;
@@ -1090,6 +1271,9 @@ namespace CryptoNote
     }
     //associate peer_id with this connection
     context.peer_id = arg.node_data.peer_id;
+    context.compression = (arg.node_data.features & P2P_FEATURE_COMPRESSION) != 0;
+    context.fragments = (arg.node_data.features & P2P_FEATURE_FRAGMENTS) != 0;
+    addRelayTarget(context);
 
     if(arg.node_data.peer_id != m_config.m_peer_id && arg.node_data.my_port) {
       peerid_type peer_id_l = arg.node_data.peer_id;
@@ -1110,6 +1294,7 @@ namespace CryptoNote
 
     //fill response
     m_peerlist.get_peerlist_head(rsp.local_peerlist);
+    context.peerlistSentTime = time(NULL);
     get_local_node_data(rsp.node_data);
     m_payload_handler.get_payload_sync_data(rsp.payload_data);
 
@@ -1169,6 +1354,14 @@ namespace CryptoNote
   {
     logger(TRACE) << context << "CLOSE CONNECTION";
     m_payload_handler.onConnectionClosed(context);
+
+    //remote port of incoming connection is not the one the peer listens on
+    if (!context.m_is_income && context.m_transfer_statistics.bytesPerSecond() != 0) {
+      net_address na;
+      na.ip = context.m_remote_ip;
+      na.port = context.m_remote_port;
+      m_peerlist.set_peer_transfer_speed(na, context.m_transfer_statistics.bytesPerSecond());
+    }
   }
   
   bool node_server::is_priority_node(const net_address& na)
@@ -1221,7 +1414,7 @@ namespace CryptoNote
         auto iter = m_connections.emplace(ctx.m_connection_id, std::move(ctx)).first;
 
         ++m_spawnCount;
-        m_dispatcher.spawn(std::bind(&node_server::connectionHandler, this, iter));
+        m_dispatcher.spawn(std::bind(&node_server::connectionHandler, this, iter), "node_server::connectionHandler");
       }
     } catch (System::InterruptedException&) {
     } catch (const std::exception& e) {
@@ -1278,6 +1471,11 @@ namespace CryptoNote
 
     try {
       auto& ctx = connIter->second;
+      //outgoing connections are handshaked before they are added
+      if (ctx.peer_id) {
+        addRelayTarget(ctx);
+      }
+
       on_connection_new(ctx);
 
       LevinProtocol proto(ctx.connection);
@@ -1320,6 +1518,9 @@ namespace CryptoNote
       logger(WARNING) << "Exception in connectionHandler: " << e.what();
     }
 
+    // queued frames are dropped, connection is closing anyway
+    removeRelayTarget(connIter->second);
+    connIter->second.stop();
     connIter->second.writeLatch.wait();
 
     on_connection_close(connIter->second);
@@ -1330,6 +1531,57 @@ namespace CryptoNote
     }
 
   }
-   
+
+  void node_server::writeHandler(p2p_connection_context& ctx) {
+    try {
+      LevinProtocol proto(ctx.connection);
+      std::vector<LevinProtocol::Frame> frames;
+
+      while (!ctx.stopped) {
+        size_t priority = 0;
+        while (priority < p2p_connection_context::WRITE_PRIORITY_COUNT && ctx.writeQueues[priority].empty()) {
+          ++priority;
+        }
+
+        if (priority == p2p_connection_context::WRITE_PRIORITY_COUNT) {
+          break;
+        }
+
+        // high priority frames queued meanwhile go out together, others in bounded batches, so a new block queued
+        // during a large transfer waits for one batch at most
+        std::deque<LevinProtocol::Frame>& queue = ctx.writeQueues[priority];
+        size_t size = 0;
+        do {
+          size += queue.front()->size();
+          frames.push_back(std::move(queue.front()));
+          queue.pop_front();
+        } while (!queue.empty() && (priority == p2p_connection_context::WRITE_PRIORITY_HIGH ||
+          size + queue.front()->size() <= P2P_CONNECTION_FRAGMENT_SIZE));
+
+        {
+          System::EventLock lock(ctx.connectionEvent);
+          proto.sendFrames(frames);
+        }
+
+        ctx.writeQueueSize -= size;
+        frames.clear();
+      }
+    } catch (System::InterruptedException&) {
+    } catch (std::exception& e) {
+      logger(DEBUGGING) << ctx << "Failed to write to connection: " << e.what();
+      ctx.stop();
+    }
+
+    if (ctx.stopped) {
+      for (std::deque<LevinProtocol::Frame>& queue : ctx.writeQueues) {
+        std::deque<LevinProtocol::Frame>().swap(queue);
+      }
+
+      ctx.writeQueueSize = 0;
+    }
+
+    ctx.writing = false;
+    ctx.writeLatch.decrease();
+  }
 
 }
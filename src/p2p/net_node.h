@@ -17,8 +17,11 @@
 
 #pragma once
 
+#include <deque>
 #include <functional>
+#include <set>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
@@ -37,6 +40,8 @@
 #include "cryptonote_core/OnceInInterval.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
 #include "Common/command_line.h"
+#include "Common/Metrics.h"
+#include "Common/TrafficLog.h"
 #include "Logging/LoggerRef.h"
 
 #include "connection_context.h"
@@ -58,9 +63,21 @@ namespace CryptoNote
   std::string print_peerlist_to_string(const std::list<peerlist_entry>& pl);
 
   struct p2p_connection_context : public cryptonote_connection_context {
+    enum : size_t {
+      NOT_RELAYED = static_cast<size_t>(-1)
+    };
+
+    // new blocks go out before anything else waiting, transactions and served blocks go last
+    enum WritePriority : size_t {
+      WRITE_PRIORITY_HIGH,
+      WRITE_PRIORITY_NORMAL,
+      WRITE_PRIORITY_BULK,
+      WRITE_PRIORITY_COUNT
+    };
 
     p2p_connection_context(System::Dispatcher& dispatcher, System::TcpConnection&& conn) : 
-      peer_id(0), connectionEvent(dispatcher), writeLatch(dispatcher), connection(std::move(conn)) {
+      peer_id(0), peerlistSentTime(0), peerlistReceivedChecksum(0), relayIndex(NOT_RELAYED), compression(false), fragments(false), connectionEvent(dispatcher),
+      writeLatch(dispatcher), writeQueueSize(0), writing(false), stopped(false), connection(std::move(conn)) {
       connectionEvent.set();
     }
 
@@ -69,13 +86,49 @@ namespace CryptoNote
       connection = std::move(ctx.connection);
       connectionEvent = std::move(ctx.connectionEvent);
       writeLatch = std::move(ctx.writeLatch);
+      for (size_t i = 0; i < WRITE_PRIORITY_COUNT; ++i) {
+        writeQueues[i] = std::move(ctx.writeQueues[i]);
+      }
+
+      writeQueueSize = ctx.writeQueueSize;
+      writing = ctx.writing;
+      stopped = ctx.stopped;
       peer_id = ctx.peer_id;
+      peerlistSentTime = ctx.peerlistSentTime;
+      peerlistReceivedChecksum = ctx.peerlistReceivedChecksum;
+      relayIndex = ctx.relayIndex;
+      compression = ctx.compression;
+      fragments = ctx.fragments;
+    }
+
+    // interrupts reading and writing, connection is closed when its handler finishes
+    void stop() {
+      if (!stopped) {
+        stopped = true;
+        connection.stop();
+      }
     }
 
     peerid_type peer_id;
+    // peers seen before this time were already sent to the connection, timed sync responses carry newer ones only
+    time_t peerlistSentTime;
+    // checksum of the last peerlist received from the connection, unchanged list is not merged again
+    uint64_t peerlistReceivedChecksum;
+    // position in the list of handshaked connections notifications are relayed to
+    size_t relayIndex;
+    // peer announced P2P_FEATURE_COMPRESSION in handshake, large notifications sent only to it are compressed
+    bool compression;
+    // peer announced P2P_FEATURE_FRAGMENTS in handshake, large bulk notifications are split so others can be sent between
+    bool fragments;
     System::TcpConnection connection;
     System::Event connectionEvent;
     System::Latch writeLatch;
+    // frames waiting for the writer coroutine of the connection by priority, size includes the ones being written; the
+    // writer is spawned when frames are queued and exits when the queues are drained, so idle connections don't keep its stack
+    std::deque<LevinProtocol::Frame> writeQueues[WRITE_PRIORITY_COUNT];
+    size_t writeQueueSize;
+    bool writing;
+    bool stopped;
   };
 
   class node_server :  public i_p2p_endpoint
@@ -90,6 +143,7 @@ namespace CryptoNote
     bool init(const NetNodeConfig& config, bool testnet);
     bool deinit();
     bool send_stop_signal();
+    bool stop_signal_sent() const { return m_stop; }
     uint32_t get_this_peer_port(){return m_listeningPort;}
     CryptoNote::cryptonote_protocol_handler& get_payload_object();
 
@@ -106,10 +160,14 @@ namespace CryptoNote
     size_t get_outgoing_connections_count();
 
     CryptoNote::peerlist_manager& get_peerlist_manager() { return m_peerlist; }
+    // Inbound commands are appended to the log for replay, null stops recording
+    void setTrafficLog(Common::TrafficLogWriter* trafficLog) { m_trafficLog = trafficLog; }
 
   private:
 
     int handleCommand(const LevinProtocol::Command& cmd, std::string& buff_out, p2p_connection_context& context, bool& handled);
+    int processCommand(const LevinProtocol::Command& cmd, std::string& buff_out, p2p_connection_context& context, bool& handled);
+    Common::MetricHistogram& getCommandMetric(int command);
 
     //----------------- commands handlers ----------------------------------------------
     int handle_handshake(int command, COMMAND_HANDSHAKE::request& arg, COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context);
@@ -130,13 +188,15 @@ namespace CryptoNote
     bool handshake(CryptoNote::LevinProtocol& proto, p2p_connection_context& context, bool just_take_peerlist = false);
     bool timedSync();
     bool handleTimedSyncResponse(const std::string& in, p2p_connection_context& context);
-    void forEachConnection(std::function<void(p2p_connection_context&)> action);
+    void relayFrame(int command, const LevinProtocol::Frame& frame, const net_connection_id* excludeConnection);
+    void enqueueFrame(p2p_connection_context& context, const LevinProtocol::Frame& frame, p2p_connection_context::WritePriority priority);
 
     void on_connection_new(p2p_connection_context& context);
     void on_connection_close(p2p_connection_context& context);
 
     //----------------- i_p2p_endpoint -------------------------------------------------------------
     virtual void relay_notify_to_all(int command, const std::string& data_buff, const net_connection_id* excludeConnection) override;
+    virtual void relay_notify_to_list(int command, const std::string& data_buff, const std::list<net_connection_id>& connections) override;
     virtual bool invoke_notify_to_peer(int command, const std::string& req_buff, const cryptonote_connection_context& context) override;
     virtual void for_each_connection(std::function<void(CryptoNote::cryptonote_connection_context&, peerid_type)> f) override;
     virtual void externalRelayNotifyToAll(int command, const std::string& data_buff) override;
@@ -150,7 +210,7 @@ namespace CryptoNote
     bool get_local_node_data(basic_node_data& node_data);
 
     bool merge_peerlist_with_local(const std::list<peerlist_entry>& bs);
-    bool fix_time_delta(std::list<peerlist_entry>& local_peerlist, time_t local_time, int64_t& delta);
+    bool fix_time_delta(const std::list<peerlist_entry>& local_peerlist, time_t local_time, int64_t& delta);
 
     bool connections_maker();
     bool make_new_connection_from_peerlist(bool use_white_list);
@@ -172,9 +232,14 @@ namespace CryptoNote
     typedef std::unordered_map<boost::uuids::uuid, p2p_connection_context, boost::hash<boost::uuids::uuid>> ConnectionContainer;
     typedef ConnectionContainer::iterator ConnectionIterator;
     ConnectionContainer m_connections;
+    // handshaked connections, relaying walks this dense list instead of the whole container
+    std::vector<p2p_connection_context*> m_relayTargets;
 
     void acceptLoop();
     void connectionHandler(ConnectionIterator connIter);
+    void writeHandler(p2p_connection_context& ctx);
+    void addRelayTarget(p2p_connection_context& ctx);
+    void removeRelayTarget(p2p_connection_context& ctx);
     void onIdle();
     void timedSyncLoop();
 
@@ -199,6 +264,7 @@ namespace CryptoNote
     uint32_t m_ip_address;
     bool m_allow_local_ip;
     bool m_hide_my_port;
+    uint32_t m_connection_fanout;
 
     System::Dispatcher& m_dispatcher;
     System::Event m_stopEvent;
@@ -206,6 +272,9 @@ namespace CryptoNote
     System::Timer m_idleTimer;
     System::TcpListener m_listener;
     Logging::LoggerRef logger;
+    // handling time histograms by command id, touched in the dispatcher thread only
+    std::unordered_map<int, Common::MetricHistogram*> m_commandMetrics;
+    Common::TrafficLogWriter* m_trafficLog;
     size_t m_spawnCount;
     std::atomic<bool> m_stop;
 
@@ -226,6 +295,8 @@ namespace CryptoNote
     std::vector<net_address> m_exclusive_peers;
     std::vector<net_address> m_seed_nodes;
     std::list<peerlist_entry> m_command_line_peers;
+    // addresses of outgoing connections being established
+    std::set<net_address> m_connecting_peers;
     uint64_t m_peer_livetime;
     boost::uuids::uuid m_network_id;
   };
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <list>
+
 #include "p2p_protocol_types.h"
 
 namespace CryptoNote {
@@ -25,6 +27,7 @@ namespace CryptoNote {
 
   struct i_p2p_endpoint {
     virtual void relay_notify_to_all(int command, const std::string& data_buff, const net_connection_id* excludeConnection) = 0;
+    virtual void relay_notify_to_list(int command, const std::string& data_buff, const std::list<net_connection_id>& connections) = 0;
     virtual bool invoke_notify_to_peer(int command, const std::string& req_buff, const CryptoNote::cryptonote_connection_context& context) = 0;
     virtual uint64_t get_connections_count()=0;
     virtual void for_each_connection(std::function<void(CryptoNote::cryptonote_connection_context&, peerid_type)> f) = 0;
@@ -34,6 +37,7 @@ namespace CryptoNote {
 
   struct p2p_endpoint_stub: public i_p2p_endpoint {
     virtual void relay_notify_to_all(int command, const std::string& data_buff, const net_connection_id* excludeConnection) {}
+    virtual void relay_notify_to_list(int command, const std::string& data_buff, const std::list<net_connection_id>& connections) {}
     virtual bool invoke_notify_to_peer(int command, const std::string& req_buff, const CryptoNote::cryptonote_connection_context& context) { return true; }
     virtual void for_each_connection(std::function<void(CryptoNote::cryptonote_connection_context&, peerid_type)> f) {}
     virtual uint64_t get_connections_count() { return 0; }   
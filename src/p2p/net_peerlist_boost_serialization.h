@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <boost/serialization/vector.hpp>
+
 namespace boost
 {
   namespace serialization
@@ -52,12 +52,14 @@ namespace CryptoNote
     uint64_t local_time;
     uint32_t my_port;
     peerid_type peer_id;
+    uint32_t features = 0; // P2P_FEATURE_* bits, not sent by older peers
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE_VAL_POD_AS_BLOB(network_id)
       KV_SERIALIZE(peer_id)
       KV_SERIALIZE(local_time)
       KV_SERIALIZE(my_port)
+      KV_SERIALIZE(features)
     END_KV_SERIALIZE_MAP()
   };
   
@@ -65,10 +67,12 @@ namespace CryptoNote
   {
     uint64_t current_height;
     crypto::hash top_id;
+    uint8_t version = 0; // not sent by peers older than P2P_COMPACT_BLOCKS_VERSION
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(current_height)
       KV_SERIALIZE_VAL_POD_AS_BLOB(top_id)
+      KV_SERIALIZE(version)
     END_KV_SERIALIZE_MAP()
   };
 
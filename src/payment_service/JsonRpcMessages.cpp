@@ -65,10 +65,11 @@ void TransferDestination::serialize(CryptoNote::ISerializer& serializer, const s
 }
 
 void SendTransactionRequest::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
-  throwIfRequiredParamsMissing(serializer, {"destinations", "fee", "mixin"});
-
   serializer.beginObject(name);
 
+  // checked inside the object, so that send_transactions can read it as an array item
+  throwIfRequiredParamsMissing(serializer, {"destinations", "fee", "mixin"});
+
   size_t size = destinations.size();
   serializer.beginArray(size, "destinations");
   destinations.resize(size);
@@ -99,6 +100,37 @@ void SendTransactionResponse::serialize(CryptoNote::ISerializer& serializer, con
   serializer.endObject();
 }
 
+void SendTransactionsRequest::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
+  throwIfRequiredParamsMissing(serializer, "transactions");
+
+  serializer.beginObject(name);
+
+  size_t size = transactions.size();
+  serializer.beginArray(size, "transactions");
+  transactions.resize(size);
+
+  for (auto& transaction : transactions) {
+    transaction.serialize(serializer, "");
+  }
+  serializer.endArray();
+
+  serializer.endObject();
+}
+
+void SendTransactionResult::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
+  serializer.beginObject(name);
+  serializer(transactionId, "transaction_id");
+  serializer(errorCode, "error_code");
+  serializer(errorMessage, "error_message");
+  serializer.endObject();
+}
+
+void SendTransactionsResponse::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
+  serializer.beginObject(name);
+  serializer(transactions, "transactions");
+  serializer.endObject();
+}
+
 void GetAddressResponse::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
   serializer.beginObject(name);
   serializer(address, "address");
@@ -189,6 +221,38 @@ void TransferRpcInfo::serialize(CryptoNote::ISerializer& serializer, const std::
   serializer.endObject();
 }
 
+void GetTransactionsRequest::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
+  throwIfRequiredParamsMissing(serializer, {"first_height", "limit"});
+
+  serializer.beginObject(name);
+  serializer(firstHeight, "first_height");
+
+  if (serializer.hasObject("last_height")) {
+    serializer(lastHeight, "last_height");
+  }
+
+  if (serializer.hasObject("offset")) {
+    serializer(offset, "offset");
+  }
+
+  serializer(limit, "limit");
+  serializer.endObject();
+}
+
+void TransactionWithTransfersRpcInfo::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
+  serializer.beginObject(name);
+  serializer(transactionId, "transaction_id");
+  transactionInfo.serialize(serializer, "transaction_info");
+  serializer(transfers, "transfers");
+  serializer.endObject();
+}
+
+void GetTransactionsResponse::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
+  serializer.beginObject(name);
+  serializer(transactions, "transactions");
+  serializer.endObject();
+}
+
 void GetTransferRequest::serialize(CryptoNote::ISerializer& serializer, const std::string& name) {
   throwIfRequiredParamsMissing(serializer, "transfer_id");
 
@@ -37,6 +37,7 @@
 #include "serialization/ISerializer.h"
 #include <vector>
 #include <exception>
+#include <limits>
 
 namespace PaymentService {
 
@@ -68,6 +69,26 @@ struct SendTransactionResponse {
   void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
 };
 
+struct SendTransactionsRequest {
+  std::vector<SendTransactionRequest> transactions;
+
+  void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
+};
+
+struct SendTransactionResult {
+  uint64_t transactionId;
+  int32_t errorCode;
+  std::string errorMessage;
+
+  void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
+};
+
+struct SendTransactionsResponse {
+  std::vector<SendTransactionResult> transactions;
+
+  void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
+};
+
 struct GetAddressResponse {
   std::string address;
   void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
@@ -143,6 +164,30 @@ struct TransferRpcInfo {
   void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
 };
 
+struct GetTransactionsRequest {
+  GetTransactionsRequest() : lastHeight(std::numeric_limits<uint64_t>::max()), offset(0) {}
+  uint64_t firstHeight;
+  uint64_t lastHeight;
+  uint64_t offset;
+  uint64_t limit;
+
+  void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
+};
+
+struct TransactionWithTransfersRpcInfo {
+  uint64_t transactionId;
+  TransactionRpcInfo transactionInfo;
+  std::vector<TransferRpcInfo> transfers;
+
+  void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
+};
+
+struct GetTransactionsResponse {
+  std::vector<TransactionWithTransfersRpcInfo> transactions;
+
+  void serialize(CryptoNote::ISerializer& serializer, const std::string& name);
+};
+
 struct GetTransferRequest {
   uint64_t transferId;
 
@@ -34,6 +34,8 @@
 
 #include "JsonRpcServer.h"
 
+#include <cassert>
+#include <exception>
 #include <fstream>
 #include <future>
 #include <system_error>
@@ -53,22 +55,43 @@
 #include "WalletServiceErrorCodes.h"
 
 #include "Common/JsonValue.h"
+#include "Common/StringOutputStream.h"
 #include "serialization/JsonInputValueSerializer.h"
 #include "serialization/JsonOutputStreamSerializer.h"
 
 namespace PaymentService {
 
-JsonRpcServer::JsonRpcServer(System::Dispatcher& sys, System::Event& stopEvent, WalletService& service, Logging::ILogger& loggerGroup) :
+namespace {
+
+// smaller responses gain too little from compression
+const size_t RESPONSE_COMPRESSION_MIN_SIZE = 1024;
+
+}
+
+JsonRpcServer::JsonRpcServer(System::Dispatcher& sys, System::Event& stopEvent, const std::vector<WalletService*>& services, Logging::ILogger& loggerGroup) :
     system(sys),
     stopEvent(stopEvent),
-    service(service),
+    services(services),
     logger(loggerGroup, "JsonRpcServer")
 {
+  assert(!services.empty());
+
+  for (WalletService* service : services) {
+    std::string address;
+    std::error_code ec = service->getAddress(address);
+    if (ec) {
+      throw std::system_error(ec);
+    }
+
+    servicesByAddress[address] = service;
+  }
 }
 
 void JsonRpcServer::start(const Configuration& config) {
   logger(Logging::INFO) << "Starting server on " << config.bindAddress << ":" << config.bindPort;
 
+  workers.reset(new Common::ThreadPool(config.rpcThreads));
+
   try {
     System::TcpListener listener(system, System::Ipv4Address(config.bindAddress), config.bindPort);
     system.spawn([this, &listener] () {this->stopEvent.wait(); listener.stop(); });
@@ -98,7 +121,10 @@ void JsonRpcServer::sessionProcedure(System::TcpConnection* tcpConnection) {
       CryptoNote::HttpResponse resp;
 
       parser.receiveRequest(stream, req);
-      processHttpRequest(req, resp);
+      processInWorker([&] {
+        processHttpRequest(req, resp);
+        resp.compressBody(req, RESPONSE_COMPRESSION_MIN_SIZE);
+      });
 
       stream << resp;
       stream.flush();
@@ -117,6 +143,27 @@ void JsonRpcServer::sessionProcedure(System::TcpConnection* tcpConnection) {
   }
 }
 
+// connection coroutine waits while other connections are served, request and response aren't touched meanwhile
+void JsonRpcServer::processInWorker(const std::function<void()>& task) {
+  System::Event processed(system);
+  std::exception_ptr error;
+
+  workers->addTask([&] {
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    system.remoteSpawn([&processed] { processed.set(); });
+  });
+
+  processed.wait();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
 void JsonRpcServer::processHttpRequest(const CryptoNote::HttpRequest& req, CryptoNote::HttpResponse& resp) {
   try {
     logger(Logging::TRACE) << "HTTP request came: \n" << req;
@@ -124,25 +171,27 @@ void JsonRpcServer::processHttpRequest(const CryptoNote::HttpRequest& req, Crypt
     if (req.getUrl() == "/json_rpc") {
       std::stringstream jsonInputStream(req.getBody());
       Common::JsonValue jsonRpcRequest;
-      Common::JsonValue jsonRpcResponse(Common::JsonValue::OBJECT);
 
       try {
         jsonInputStream >> jsonRpcRequest;
       } catch (std::runtime_error&) {
         logger(Logging::WARNING) << "Couldn't parse request: \"" << req.getBody() << "\"";
+        Common::JsonValue jsonRpcResponse(Common::JsonValue::OBJECT);
         makeJsonParsingErrorResponse(jsonRpcResponse);
         resp.setStatus(CryptoNote::HttpResponse::STATUS_200);
         resp.setBody(jsonRpcResponse.toString());
         return;
       }
 
-      processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse);
-
-      std::stringstream jsonOutputStream;
-      jsonOutputStream << jsonRpcResponse;
+      std::string jsonRpcResponse;
+      if (jsonRpcRequest.isArray()) {
+        processJsonRpcBatch(jsonRpcRequest, jsonRpcResponse);
+      } else {
+        processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse);
+      }
 
       resp.setStatus(CryptoNote::HttpResponse::STATUS_200);
-      resp.setBody(jsonOutputStream.str());
+      resp.setBody(jsonRpcResponse);
 
     } else {
       logger(Logging::WARNING) << "Requested url \"" << req.getUrl() << "\" is not found";
@@ -155,14 +204,68 @@ void JsonRpcServer::processHttpRequest(const CryptoNote::HttpRequest& req, Crypt
   }
 }
 
-void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) {
+// calls of a batch are processed in order, their responses are sent back as one array
+void JsonRpcServer::processJsonRpcBatch(const Common::JsonValue& req, std::string& resp) {
+  // responses to malformed calls carry no id
+  Common::JsonValue noId(Common::JsonValue::OBJECT);
+  if (req.size() == 0) {
+    Common::JsonValue errorResponse(Common::JsonValue::OBJECT);
+    prepareJsonResponse(noId, errorResponse);
+    makeGenericErrorReponse(errorResponse, "Invalid Request", -32600);
+    resp = errorResponse.toString();
+    return;
+  }
+
+  resp = "[";
+  for (size_t i = 0; i < req.size(); ++i) {
+    std::string callResponse;
+    if (req[i].isObject()) {
+      processJsonRpcRequest(req[i], callResponse);
+    } else {
+      Common::JsonValue errorResponse(Common::JsonValue::OBJECT);
+      prepareJsonResponse(noId, errorResponse);
+      makeGenericErrorReponse(errorResponse, "Invalid Request", -32600);
+      callResponse = errorResponse.toString();
+    }
+
+    if (i != 0) {
+      resp += ',';
+    }
+
+    resp += callResponse;
+  }
+
+  resp += ']';
+}
+
+void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, std::string& resp) {
+  Common::JsonValue envelope(Common::JsonValue::OBJECT);
+  std::string result;
+  if (processJsonRpcCall(req, envelope, result)) {
+    fillJsonResponse(result, envelope, resp);
+  } else {
+    resp = envelope.toString();
+  }
+}
+
+// result is written as text, false means resp holds an error instead
+bool JsonRpcServer::processJsonRpcCall(const Common::JsonValue& req, Common::JsonValue& resp, std::string& result) {
   try {
     prepareJsonResponse(req, resp);
 
     std::string method = req("method").getString();
 
+    WalletService* walletService = findService(req("params"));
+    if (walletService == nullptr) {
+      makeGenericErrorReponse(resp, "Wallet not found", -32600);
+      return false;
+    }
+
+    WalletService& service = *walletService;
+
     CryptoNote::JsonInputValueSerializer inputSerializer;
-    CryptoNote::JsonOutputStreamSerializer outputSerializer;
+    Common::StringOutputStream resultStream(result);
+    CryptoNote::JsonOutputStreamSerializer outputSerializer(resultStream);
 
     inputSerializer.setJsonValue(&req("params"));
 
@@ -175,13 +278,31 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
         sendReq.serialize(inputSerializer, "");
       } catch (std::exception&) {
         makeGenericErrorReponse(resp, "Invalid Request", -32600);
-        return;
+        return false;
       }
 
       std::error_code ec = service.sendTransaction(sendReq, sendResp);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
+      }
+
+      sendResp.serialize(outputSerializer, "");
+    } else if (method == "send_transactions") {
+      SendTransactionsRequest sendReq;
+      SendTransactionsResponse sendResp;
+
+      try {
+        sendReq.serialize(inputSerializer, "");
+      } catch (std::exception&) {
+        makeGenericErrorReponse(resp, "Invalid Request", -32600);
+        return false;
+      }
+
+      std::error_code ec = service.sendTransactions(sendReq, sendResp);
+      if (ec) {
+        makeErrorResponse(ec, resp);
+        return false;
       }
 
       sendResp.serialize(outputSerializer, "");
@@ -191,7 +312,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
       std::error_code ec = service.getAddress(getAddrResp.address);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
       }
 
       getAddrResp.serialize(outputSerializer, "");
@@ -201,7 +322,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
       std::error_code ec = service.getActualBalance(actualResp.actualBalance);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
       }
 
       actualResp.serialize(outputSerializer, "");
@@ -211,7 +332,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
       std::error_code ec = service.getPendingBalance(pendingResp.pendingBalance);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
       }
 
       pendingResp.serialize(outputSerializer, "");
@@ -221,7 +342,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
       std::error_code ec = service.getTransactionsCount(txResp.transactionsCount);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
       }
 
       txResp.serialize(outputSerializer, "");
@@ -231,7 +352,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
       std::error_code ec = service.getTransfersCount(trResp.transfersCount);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
       }
 
       trResp.serialize(outputSerializer, "");
@@ -244,7 +365,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
         getReq.serialize(inputSerializer, "");
       } catch (std::exception&) {
         makeGenericErrorReponse(resp, "Invalid Request", -32600);
-        return;
+        return false;
       }
 
       CryptoNote::TransactionId txId;
@@ -252,7 +373,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
       getResp.transactionid = txId;
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
       }
 
       getResp.serialize(outputSerializer, "");
@@ -265,13 +386,13 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
         getReq.serialize(inputSerializer, "");
       } catch (std::exception&) {
         makeGenericErrorReponse(resp, "Invalid Request", -32600);
-        return;
+        return false;
       }
 
       std::error_code ec = service.getTransaction(getReq.transactionId, getResp.found, getResp.transactionInfo);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
       }
 
       getResp.serialize(outputSerializer, "");
@@ -284,13 +405,31 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
         getReq.serialize(inputSerializer, "");
       } catch (std::exception&) {
         makeGenericErrorReponse(resp, "Invalid Request", -32600);
-        return;
+        return false;
       }
 
       std::error_code ec = service.getTransfer(getReq.transferId, getResp.found, getResp.transferInfo);
       if (ec) {
         makeErrorResponse(ec, resp);
-        return;
+        return false;
+      }
+
+      getResp.serialize(outputSerializer, "");
+    } else if (method == "get_transactions") {
+      GetTransactionsRequest getReq;
+      GetTransactionsResponse getResp;
+
+      try {
+        getReq.serialize(inputSerializer, "");
+      } catch (std::exception&) {
+        makeGenericErrorReponse(resp, "Invalid Request", -32600);
+        return false;
+      }
+
+      std::error_code ec = service.getTransactions(getReq, getResp);
+      if (ec) {
+        makeErrorResponse(ec, resp);
+        return false;
       }
 
       getResp.serialize(outputSerializer, "");
@@ -303,7 +442,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
         getReq.serialize(inputSerializer, "");
       } catch (std::exception&) {
         makeGenericErrorReponse(resp, "Invalid Request", -32600);
-        return;
+        return false;
       }
 
       WalletService::IncomingPayments payments;
@@ -315,7 +454,7 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
           makeErrorResponse(ec, resp);
         }
 
-        return;
+        return false;
       }
 
       for (auto p: payments) {
@@ -330,12 +469,10 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
     } else {
       logger(Logging::DEBUGGING) << "Requested method not found: " << method;
       makeMethodNotFoundResponse(resp);
-      return;
+      return false;
     }
 
-    Common::JsonValue v = outputSerializer.getJsonValue();
-    fillJsonResponse(v, resp);
-
+    return true;
   } catch (RequestSerializationError&) {
     logger(Logging::WARNING) << "Wrong request came";
     makeGenericErrorReponse(resp, "Invalid Request", -32600);
@@ -343,6 +480,8 @@ void JsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::
     logger(Logging::WARNING) << "Error occured while processing JsonRpc request";
     makeGenericErrorReponse(resp, e.what());
   }
+
+  return false;
 }
 
 void JsonRpcServer::prepareJsonResponse(const Common::JsonValue& req, Common::JsonValue& resp) {
@@ -359,6 +498,15 @@ void JsonRpcServer::prepareJsonResponse(const Common::JsonValue& req, Common::Js
   resp.insert("jsonrpc", jsonRpc);
 }
 
+WalletService* JsonRpcServer::findService(const Common::JsonValue& params) {
+  if (!params.isObject() || !params.count("wallet")) {
+    return services.front();
+  }
+
+  auto it = servicesByAddress.find(params("wallet").getString());
+  return it != servicesByAddress.end() ? it->second : nullptr;
+}
+
 void JsonRpcServer::makeErrorResponse(const std::error_code& ec, Common::JsonValue& resp) {
   using Common::JsonValue;
 
@@ -424,8 +572,13 @@ void JsonRpcServer::makeMethodNotFoundResponse(Common::JsonValue& resp) {
   resp.insert("error", error);
 }
 
-void JsonRpcServer::fillJsonResponse(const Common::JsonValue& v, Common::JsonValue& resp) {
-  resp.insert("result", v);
+// envelope always has members, the result is appended after them
+void JsonRpcServer::fillJsonResponse(const std::string& result, const Common::JsonValue& envelope, std::string& resp) {
+  resp = envelope.toString();
+  resp.pop_back();
+  resp += ",\"result\":";
+  resp += result;
+  resp += '}';
 }
 
 void JsonRpcServer::makeJsonParsingErrorResponse(Common::JsonValue& resp) {
@@ -39,8 +39,14 @@
 #include <System/Event.h>
 #include "Logging/ILogger.h"
 #include "Logging/LoggerRef.h"
+#include "Common/ThreadPool.h"
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
 #include <system_error>
+#include <vector>
 
 namespace CryptoNote {
 class HttpResponse;
@@ -61,29 +67,38 @@ class WalletService;
 
 class JsonRpcServer {
 public:
-  JsonRpcServer(System::Dispatcher& sys, System::Event& stopEvent, WalletService& service, Logging::ILogger& loggerGroup);
+  // the first service is the default one, the others are chosen by their address in the "wallet" parameter.
+  // Requests are parsed, processed and their responses serialized by config.rpcThreads worker threads, the dispatcher
+  // thread only reads and writes connections. Services serialize calls changing a wallet themselves.
+  JsonRpcServer(System::Dispatcher& sys, System::Event& stopEvent, const std::vector<WalletService*>& services, Logging::ILogger& loggerGroup);
   JsonRpcServer(const JsonRpcServer&) = delete;
 
   void start(const Configuration& config);
 
 private:
   void sessionProcedure(System::TcpConnection* tcpConnection);
+  void processInWorker(const std::function<void()>& task);
 
   void processHttpRequest(const CryptoNote::HttpRequest& req, CryptoNote::HttpResponse& resp);
-  void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp);
+  void processJsonRpcBatch(const Common::JsonValue& req, std::string& resp);
+  void processJsonRpcRequest(const Common::JsonValue& req, std::string& resp);
+  bool processJsonRpcCall(const Common::JsonValue& req, Common::JsonValue& resp, std::string& result);
   void prepareJsonResponse(const Common::JsonValue& req, Common::JsonValue& resp);
+  WalletService* findService(const Common::JsonValue& params);
 
   void makeErrorResponse(const std::error_code& ec, Common::JsonValue& resp);
   void makeMethodNotFoundResponse(Common::JsonValue& resp);
   void makeGenericErrorReponse(Common::JsonValue& resp, const char* what, int errorCode = -32001);
   void makeJsonParsingErrorResponse(Common::JsonValue& resp);
 
-  void fillJsonResponse(const Common::JsonValue& v, Common::JsonValue& resp);
+  void fillJsonResponse(const std::string& result, const Common::JsonValue& envelope, std::string& resp);
 
   System::Dispatcher& system;
   System::Event& stopEvent;
-  WalletService& service;
+  std::vector<WalletService*> services;
+  std::map<std::string, WalletService*> servicesByAddress;
   Logging::LoggerRef logger;
+  std::unique_ptr<Common::ThreadPool> workers;
 };
 
 } //namespace PaymentService
@@ -61,9 +61,14 @@ public:
     std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& result, const Callback& callback) { callback(std::error_code()); }
   virtual void getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks, uint64_t& startHeight, const Callback& callback) { callback(std::error_code()); }
   virtual void getTransactionOutsGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices, const Callback& callback) { callback(std::error_code()); }
+  virtual void getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices,
+      const Callback& callback) { outsGlobalIndices.resize(transactionHashes.size()); callback(std::error_code()); }
 
   virtual void queryBlocks(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::list<CryptoNote::BlockCompleteEntry>& newBlocks,
       uint64_t& startHeight, const CryptoNote::INode::Callback& callback) { startHeight = 0; callback(std::error_code()); }
+  virtual void queryBlocksFiltered(std::list<crypto::hash>&& knownBlockIds, uint64_t timestamp, std::vector<CryptoNote::TrackingKey>&& trackingKeys,
+      std::vector<crypto::key_image>&& knownKeyImages, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight,
+      const CryptoNote::INode::Callback& callback) { startHeight = 0; callback(std::error_code()); }
 
   virtual void getPoolSymmetricDifference(std::vector<crypto::hash>&& known_pool_tx_ids, crypto::hash known_block_id,
     bool& is_bc_actual, std::vector<CryptoNote::Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids,
@@ -52,6 +52,8 @@ Configuration::Configuration() {
   logFile = "payment_gate.log";
   testnet = false;
   logLevel = Logging::INFO;
+  autosaveInterval = 600;
+  rpcThreads = 2;
 }
 
 void Configuration::initOptions(boost::program_options::options_description& desc) {
@@ -60,6 +62,7 @@ void Configuration::initOptions(boost::program_options::options_description& des
       ("bind-port", po::value<uint16_t>()->default_value(8070), "payment service bind port")
       ("wallet-file,w", po::value<std::string>(), "wallet file")
       ("wallet-password,p", po::value<std::string>(), "wallet password")
+      ("hosted-wallet-file", po::value<std::vector<std::string>>()->composing(), "another wallet file to serve with wallet-password, can be repeated. Requests choose it by its address in the \"wallet\" parameter")
       ("generate-wallet,g", "generate new wallet file and exit")
       ("daemon,d", "run as daemon in Unix or as service in Windows")
       ("register-service", "register service and exit (Windows only)")
@@ -67,7 +70,9 @@ void Configuration::initOptions(boost::program_options::options_description& des
       ("import-keys,i", po::value<std::string>(), "import legacy keys file and exit")
       ("log-file,l", po::value<std::string>(), "log file")
       ("server-root", po::value<std::string>(), "server root. The service will use it as working directory. Don't set it if don't want to change it")
-      ("log-level", po::value<std::size_t>(), "log level");
+      ("log-level", po::value<std::size_t>(), "log level")
+      ("autosave-interval", po::value<uint32_t>()->default_value(600), "interval in seconds between background wallet saves, 0 to save only on exit")
+      ("rpc-threads", po::value<uint32_t>()->default_value(2), "number of threads processing requests, at least 1");
 }
 
 void Configuration::init(const boost::program_options::variables_map& options) {
@@ -115,6 +120,17 @@ void Configuration::init(const boost::program_options::variables_map& options) {
     bindPort = options["bind-port"].as<uint16_t>();
   }
 
+  if (options.count("autosave-interval")) {
+    autosaveInterval = options["autosave-interval"].as<uint32_t>();
+  }
+
+  if (options.count("rpc-threads")) {
+    rpcThreads = options["rpc-threads"].as<uint32_t>();
+    if (rpcThreads == 0) {
+      throw ConfigurationError("rpc-threads option must be at least 1");
+    }
+  }
+
   if (options.count("wallet-file")) {
     walletFile = options["wallet-file"].as<std::string>();
   }
@@ -123,6 +139,10 @@ void Configuration::init(const boost::program_options::variables_map& options) {
     walletPassword = options["wallet-password"].as<std::string>();
   }
 
+  if (options.count("hosted-wallet-file")) {
+    hostedWalletFiles = options["hosted-wallet-file"].as<std::vector<std::string>>();
+  }
+
   if (options.count("generate-wallet")) {
     generateNewWallet = true;
   }
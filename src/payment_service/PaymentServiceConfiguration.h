@@ -37,6 +37,7 @@
 #include <string>
 #include <stdexcept>
 #include <cstdint>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
@@ -58,9 +59,15 @@ struct Configuration {
 
   std::string walletFile;
   std::string walletPassword;
+  // served next to walletFile, on the same node connection and synchronizer
+  std::vector<std::string> hostedWalletFiles;
   std::string importKeys;
   std::string logFile;
   std::string serverRoot;
+  // wallets are saved in the background every autosaveInterval seconds, 0 saves them only on exit
+  uint32_t autosaveInterval;
+  // requests are processed by rpcThreads worker threads, sends block theirs until the transaction is relayed
+  uint32_t rpcThreads;
 
   bool generateNewWallet;
   bool daemonize;
@@ -56,4 +56,9 @@ CryptoNote::IWallet* WalletFactory::createWallet(const CryptoNote::Currency& cur
   return wallet;
 }
 
+CryptoNote::IWallet* WalletFactory::createWallet(const CryptoNote::Currency& currency, CryptoNote::INode& node, CryptoNote::WalletSynchronizer& sync) {
+  CryptoNote::Wallet* wallet = new CryptoNote::Wallet(currency, node, sync);
+  return wallet;
+}
+
 }
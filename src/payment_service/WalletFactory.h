@@ -42,6 +42,7 @@
 
 namespace CryptoNote {
 class Currency;
+class WalletSynchronizer;
 }
 
 namespace PaymentService {
@@ -49,6 +50,7 @@ namespace PaymentService {
 class WalletFactory {
 public:
   static CryptoNote::IWallet* createWallet(const CryptoNote::Currency& currency, CryptoNote::INode& node);
+  static CryptoNote::IWallet* createWallet(const CryptoNote::Currency& currency, CryptoNote::INode& node, CryptoNote::WalletSynchronizer& sync);
 private:
   WalletFactory();
   ~WalletFactory();
@@ -67,23 +67,24 @@ void WalletSaveObserver::waitForSaveEnd() {
 }
 
 void WalletTransactionSendObserver::sendTransactionCompleted(CryptoNote::TransactionId transactionId, std::error_code result) {
-  std::lock_guard<std::mutex> lock(finishedTransactionsLock);
-  finishedTransactions.insert(std::make_pair(transactionId, result));
+  {
+    std::lock_guard<std::mutex> lock(finishedTransactionsLock);
+    finishedTransactions.insert(std::make_pair(transactionId, result));
+  }
+
+  transactionFinished.notify_all();
 }
 
 void WalletTransactionSendObserver::waitForTransactionFinished(CryptoNote::TransactionId transactionId, std::error_code& result) {
-  while (true) {
-    {
-      std::lock_guard<std::mutex> lock(finishedTransactionsLock);
-
-      auto it = finishedTransactions.find(transactionId);
-      if (it != finishedTransactions.end()) {
-        result = it->second;
-        break;
-      }
+  std::unique_lock<std::mutex> lock(finishedTransactionsLock);
+  for (;;) {
+    auto it = finishedTransactions.find(transactionId);
+    if (it != finishedTransactions.end()) {
+      result = it->second;
+      break;
     }
 
-    timer.sleep(std::chrono::milliseconds(10));
+    transactionFinished.wait(lock);
   }
 }
 
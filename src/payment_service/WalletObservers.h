@@ -36,9 +36,7 @@
 
 #include "IWallet.h"
 
-#include <System/Timer.h>
-#include <System/Dispatcher.h>
-
+#include <condition_variable>
 #include <future>
 #include <map>
 #include <mutex>
@@ -70,10 +68,11 @@ private:
   std::promise<std::error_code> savePromise;
 };
 
+// waits are made by request worker threads, the results come from wallet threads
 class WalletTransactionSendObserver : public CryptoNote::IWalletObserver {
 public:
-  WalletTransactionSendObserver(System::Dispatcher& sys) : system(sys), timer(system) {}
-  ~WalletTransactionSendObserver() { timer.stop(); }
+  WalletTransactionSendObserver() {}
+  virtual ~WalletTransactionSendObserver() {}
 
   virtual void sendTransactionCompleted(CryptoNote::TransactionId transactionId, std::error_code result);
 
@@ -81,9 +80,7 @@ public:
 private:
   std::map<CryptoNote::TransactionId, std::error_code> finishedTransactions;
   std::mutex finishedTransactionsLock;
-
-  System::Dispatcher& system;
-  System::Timer timer;
+  std::condition_variable transactionFinished;
 };
 
 } //namespace PaymentService
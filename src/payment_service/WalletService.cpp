@@ -43,6 +43,8 @@
 #include "crypto/crypto.h"
 #include "wallet/LegacyKeysImporter.h"
 #include "Common/util.h"
+#include "serialization/BinaryInputStreamSerializer.h"
+#include "serialization/BinaryOutputStreamSerializer.h"
 
 #include <future>
 #include <assert.h>
@@ -133,6 +135,12 @@ void replaceWalletFiles(const std::string &path, const std::string &tempFilePath
   tools::replace_file(tempFilePath, path);
 }
 
+const uint32_t PAYMENTS_CACHE_VERSION = 1;
+
+std::string getPaymentsCacheFile(const std::string& walletFile) {
+  return walletFile + ".payments";
+}
+
 }
 
 namespace PaymentService {
@@ -217,19 +225,31 @@ void importLegacyKeys(const Configuration& conf) {
   walletFile.flush();
 }
 
-WalletService::WalletService(const CryptoNote::Currency& currency, System::Dispatcher& sys, CryptoNote::INode& node,
-  const Configuration& conf, Logging::ILogger& logger) :
+WalletService::WalletService(const CryptoNote::Currency& currency, CryptoNote::INode& node,
+  const Configuration& conf, Logging::ILogger& logger, const std::string& walletFile, CryptoNote::WalletSynchronizer& sync) :
     config(conf),
+    walletFile(walletFile),
     inited(false),
-    sendObserver(sys),
     logger(logger, "WaleltService"),
     txIdIndex(boost::get<0>(paymentsCache)),
-    paymentIdIndex(boost::get<1>(paymentsCache))
+    paymentIdIndex(boost::get<1>(paymentsCache)),
+    indexedTransactionCount(0),
+    stopAutosave(false)
 {
-  wallet.reset(WalletFactory::createWallet(currency, node));
+  wallet.reset(WalletFactory::createWallet(currency, node, sync));
 }
 
 WalletService::~WalletService() {
+  if (autosaveThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(autosaveMutex);
+      stopAutosave = true;
+    }
+
+    autosaveStopped.notify_one();
+    autosaveThread.join();
+  }
+
   if (wallet) {
     if (inited) {
       wallet->removeObserver(&sendObserver);
@@ -247,21 +267,52 @@ void WalletService::init() {
   wallet->addObserver(this);
 
   inited = true;
+
+  if (config.autosaveInterval != 0) {
+    autosaveThread = std::thread(&WalletService::autosave, this);
+  }
 }
 
 void WalletService::saveWallet() {
-  PaymentService::secureSaveWallet(wallet.get(), config.walletFile, true, true);
+  std::lock_guard<std::mutex> lock(saveMutex);
+
+  PaymentService::secureSaveWallet(wallet.get(), walletFile, true, true);
   logger(Logging::INFO) << "Wallet is saved";
+
+  try {
+    savePaymentsCache();
+  } catch (std::exception& e) {
+    //it's rebuilt from the wallet on the next start
+    logger(Logging::WARNING) << "Couldn't save payments cache: " << e.what();
+  }
+}
+
+void WalletService::autosave() {
+  std::unique_lock<std::mutex> lock(autosaveMutex);
+  for (;;) {
+    if (autosaveStopped.wait_for(lock, std::chrono::seconds(config.autosaveInterval), [this] { return stopAutosave; })) {
+      break;
+    }
+
+    lock.unlock();
+    try {
+      saveWallet();
+    } catch (std::exception& e) {
+      logger(Logging::WARNING) << "Couldn't autosave wallet: " << e.what();
+    }
+
+    lock.lock();
+  }
 }
 
 void WalletService::loadWallet() {
   std::ifstream inputWalletFile;
-  inputWalletFile.open(config.walletFile.c_str(), std::fstream::in | std::fstream::binary);
+  inputWalletFile.open(walletFile.c_str(), std::fstream::in | std::fstream::binary);
   if (!inputWalletFile) {
     throw std::runtime_error("Couldn't open wallet file");
   }
 
-  logger(Logging::INFO) << "Loading wallet";
+  logger(Logging::INFO) << "Loading wallet " << walletFile;
 
   WalletLoadObserver loadObserver;
   wallet->addObserver(&loadObserver);
@@ -276,17 +327,147 @@ void WalletService::loadWallet() {
 }
 
 void WalletService::loadPaymentsCache() {
+  if (!loadSavedPaymentsCache()) {
+    paymentsCache.clear();
+    indexedTransactionCount = 0;
+  }
+
   size_t txCount = wallet->getTransactionCount();
+  size_t firstId = indexedTransactionCount;
+
+  logger(Logging::DEBUGGING) << "seeking for payments among " << txCount - firstId << " transactions";
+
+  std::vector<CryptoNote::TransactionId> ids;
+  ids.reserve(txCount - firstId);
+  for (size_t id = firstId; id < txCount; ++id) {
+    ids.push_back(id);
+  }
+
+  indexTransactions(ids);
+}
+
+bool WalletService::loadSavedPaymentsCache() {
+  std::ifstream cacheFile(getPaymentsCacheFile(walletFile).c_str(), std::ifstream::binary);
+  if (!cacheFile) {
+    return false;
+  }
+
+  try {
+    CryptoNote::BinaryInputStreamSerializer serializer(cacheFile);
+    serializer.beginObject("paymentsCache");
+
+    uint32_t version;
+    serializer(version, "version");
+    if (version != PAYMENTS_CACHE_VERSION) {
+      logger(Logging::INFO) << "Payments cache version " << version << " is not supported, rebuilding it";
+      return false;
+    }
+
+    uint64_t txCount;
+    CryptoNote::TransactionHash lastHash;
+    serializer(txCount, "transactionCount");
+    serializer.binary(lastHash.data(), lastHash.size(), "lastTransactionHash");
+
+    //the cache belongs to this wallet if the last transaction it has seen is still there
+    if (txCount > 0) {
+      CryptoNote::TransactionInfo tx;
+      if (txCount > wallet->getTransactionCount() || !wallet->getTransaction(txCount - 1, tx) || tx.hash != lastHash) {
+        logger(Logging::INFO) << "Payments cache doesn't match the wallet, rebuilding it";
+        return false;
+      }
+    }
+
+    size_t size;
+    serializer.beginArray(size, "payments");
+    for (size_t i = 0; i < size; ++i) {
+      PaymentItem item;
+      uint64_t txId;
+      serializer(item.paymentId, "paymentId");
+      serializer(txId, "transactionId");
+      item.transactionId = static_cast<CryptoNote::TransactionId>(txId);
+      paymentsCache.insert(std::move(item));
+    }
+    serializer.endArray();
+    serializer.endObject();
+
+    indexedTransactionCount = static_cast<size_t>(txCount);
+  } catch (std::exception& e) {
+    logger(Logging::WARNING) << "Couldn't load payments cache: " << e.what();
+    return false;
+  }
+
+  logger(Logging::INFO) << "Payments cache is loaded, " << paymentsCache.size() << " payments";
+  return true;
+}
+
+void WalletService::savePaymentsCache() {
+  // serialized under the lock and written without it, so requests looking up payments don't wait for the disk
+  std::stringstream archive;
+  {
+    std::lock_guard<std::mutex> lock(paymentsCacheMutex);
+
+    uint64_t txCount = indexedTransactionCount;
+    CryptoNote::TransactionHash lastHash = {};
+    if (txCount > 0) {
+      CryptoNote::TransactionInfo tx;
+      if (!wallet->getTransaction(txCount - 1, tx)) {
+        throw std::runtime_error("Transaction " + std::to_string(txCount - 1) + " doesn't exist");
+      }
+
+      lastHash = tx.hash;
+    }
+
+    CryptoNote::BinaryOutputStreamSerializer serializer(archive);
+    serializer.beginObject("paymentsCache");
+
+    uint32_t version = PAYMENTS_CACHE_VERSION;
+    serializer(version, "version");
+    serializer(txCount, "transactionCount");
+    serializer.binary(lastHash.data(), lastHash.size(), "lastTransactionHash");
+
+    size_t size = paymentsCache.size();
+    serializer.beginArray(size, "payments");
+    for (const PaymentItem& item : txIdIndex) {
+      std::string paymentId = item.paymentId;
+      uint64_t txId = item.transactionId;
+      serializer(paymentId, "paymentId");
+      serializer(txId, "transactionId");
+    }
+    serializer.endArray();
+    serializer.endObject();
+  }
+
+  std::string path = getPaymentsCacheFile(walletFile);
+  std::fstream tempFile;
+  std::string tempFilePath = createTemporaryFile(path, tempFile);
+
+  tempFile << archive.rdbuf();
+  tempFile.flush();
+  if (!tempFile) {
+    tempFile.close();
+    deleteFile(tempFilePath);
+    throw std::runtime_error("Couldn't write payments cache");
+  }
+  tempFile.close();
 
-  logger(Logging::DEBUGGING) << "seeking for payments among " << txCount << " transactions";
+  replaceWalletFiles(path, tempFilePath);
+}
+
+//returns false if the transaction doesn't exist
+// transactions are read from the wallet first, the cache is locked once for the whole batch
+void WalletService::indexTransactions(const std::vector<CryptoNote::TransactionId>& ids) {
+  std::vector<std::pair<CryptoNote::TransactionId, crypto::hash>> payments;
+  size_t indexedCount = 0;
 
-  for (size_t id = 0; id < txCount; ++id) {
+  for (CryptoNote::TransactionId id : ids) {
     CryptoNote::TransactionInfo tx;
     if (!wallet->getTransaction(id, tx)) {
       logger(Logging::DEBUGGING) << "tx " << id << " doesn't exist";
       continue;
     }
 
+    indexedCount = std::max(indexedCount, id + 1);
+
     if (tx.totalAmount < 0) {
       logger(Logging::DEBUGGING) << "tx " << id << " has negative amount";
       continue;
@@ -301,7 +482,13 @@ void WalletService::loadPaymentsCache() {
     }
 
     logger(Logging::DEBUGGING) << "transaction " << id << " has been inserted with payment id " << paymentId;
-    insertTransaction(id, paymentId);
+    payments.push_back(std::make_pair(id, paymentId));
+  }
+
+  std::lock_guard<std::mutex> lock(paymentsCacheMutex);
+  indexedTransactionCount = std::max(indexedTransactionCount, indexedCount);
+  for (const auto& payment : payments) {
+    insertTransaction(payment.first, payment.second);
   }
 }
 
@@ -309,6 +496,7 @@ std::error_code WalletService::sendTransaction(const SendTransactionRequest& req
   assert(wallet);
   logger(Logging::DEBUGGING) << "Send transaction request came";
 
+  std::lock_guard<std::mutex> sendLock(sendMutex);
   try {
     std::vector<CryptoNote::Transfer> transfers;
     makeTransfers(req.destinations, transfers);
@@ -318,7 +506,12 @@ std::error_code WalletService::sendTransaction(const SendTransactionRequest& req
       addPaymentIdToExtra(req.paymentId, extra);
     }
 
-    CryptoNote::TransactionId txId = wallet->sendTransaction(transfers, req.fee, extra, req.mixin, req.unlockTime);
+    CryptoNote::TransactionId txId;
+    {
+      std::lock_guard<Common::RecursiveSharedMutex> lock(stateLock);
+      txId = wallet->sendTransaction(transfers, req.fee, extra, req.mixin, req.unlockTime);
+    }
+
     if (txId == CryptoNote::INVALID_TRANSACTION_ID) {
       logger(Logging::WARNING) << "Unable to send transaction";
       throw std::runtime_error("Error occured while sending transaction");
@@ -340,6 +533,53 @@ std::error_code WalletService::sendTransaction(const SendTransactionRequest& req
   return std::error_code();
 }
 
+// Transactions of a request are built together, each one succeeds or fails on its own
+std::error_code WalletService::sendTransactions(const SendTransactionsRequest& req, SendTransactionsResponse& resp) {
+  assert(wallet);
+  logger(Logging::DEBUGGING) << "Send transactions request came, " << req.transactions.size() << " transactions";
+
+  std::lock_guard<std::mutex> sendLock(sendMutex);
+  try {
+    std::vector<CryptoNote::TransactionParameters> transactions;
+    transactions.reserve(req.transactions.size());
+
+    for (const SendTransactionRequest& sendReq : req.transactions) {
+      CryptoNote::TransactionParameters parameters;
+      makeTransfers(sendReq.destinations, parameters.transfers);
+      if (!sendReq.paymentId.empty()) {
+        addPaymentIdToExtra(sendReq.paymentId, parameters.extra);
+      }
+
+      parameters.fee = sendReq.fee;
+      parameters.mixIn = sendReq.mixin;
+      parameters.unlockTimestamp = sendReq.unlockTime;
+      transactions.push_back(std::move(parameters));
+    }
+
+    std::vector<CryptoNote::TransactionId> txIds;
+    {
+      std::lock_guard<Common::RecursiveSharedMutex> lock(stateLock);
+      txIds = wallet->sendTransactions(transactions);
+    }
+
+    for (CryptoNote::TransactionId txId : txIds) {
+      std::error_code ec;
+      sendObserver.waitForTransactionFinished(txId, ec);
+
+      SendTransactionResult result;
+      result.transactionId = txId;
+      result.errorCode = ec.value();
+      result.errorMessage = ec ? ec.message() : std::string();
+      resp.transactions.push_back(result);
+    }
+  } catch (std::system_error& x) {
+    logger(Logging::WARNING) << "Error while sending transactions: " << x.what();
+    return x.code();
+  }
+
+  return std::error_code();
+}
+
 void WalletService::makeTransfers(const std::vector<PaymentService::TransferDestination>& destinations, std::vector<CryptoNote::Transfer>& transfers) {
   transfers.reserve(destinations.size());
 
@@ -478,6 +718,48 @@ std::error_code WalletService::getTransfer(CryptoNote::TransferId txId, bool& fo
   return std::error_code();
 }
 
+// one page of history with transfers, in place of a getTransaction and getTransfer call per item
+std::error_code WalletService::getTransactions(const GetTransactionsRequest& req, GetTransactionsResponse& resp) {
+  logger(Logging::DEBUGGING) << "getTransactions request came";
+
+  Common::SharedLockGuard<Common::RecursiveSharedMutex> lock(stateLock);
+  try {
+    std::vector<CryptoNote::TransactionId> txIds = wallet->getTransactionsByHeight(req.firstHeight, req.lastHeight,
+      static_cast<size_t>(req.offset), static_cast<size_t>(req.limit));
+
+    resp.transactions.reserve(txIds.size());
+    for (CryptoNote::TransactionId txId : txIds) {
+      CryptoNote::TransactionInfo txInfo;
+      if (!wallet->getTransaction(txId, txInfo)) {
+        continue;
+      }
+
+      TransactionWithTransfersRpcInfo item;
+      item.transactionId = txId;
+      fillTransactionRpcInfo(txInfo, item.transactionInfo);
+
+      if (txInfo.firstTransferId != CryptoNote::INVALID_TRANSFER_ID) {
+        item.transfers.reserve(txInfo.transferCount);
+        for (size_t i = 0; i < txInfo.transferCount; ++i) {
+          CryptoNote::Transfer transfer;
+          if (wallet->getTransfer(txInfo.firstTransferId + i, transfer)) {
+            TransferRpcInfo transferInfo;
+            fillTransferRpcInfo(transfer, transferInfo);
+            item.transfers.push_back(std::move(transferInfo));
+          }
+        }
+      }
+
+      resp.transactions.push_back(std::move(item));
+    }
+  } catch (std::system_error& x) {
+    logger(Logging::WARNING) << "Unable to get transactions: " << x.what();
+    return x.code();
+  }
+
+  return std::error_code();
+}
+
 void WalletService::fillTransferRpcInfo(const CryptoNote::Transfer& transfer, TransferRpcInfo& rpcInfo) {
   rpcInfo.address = transfer.address;
   rpcInfo.amount = transfer.amount;
@@ -486,6 +768,8 @@ void WalletService::fillTransferRpcInfo(const CryptoNote::Transfer& transfer, Tr
 std::error_code WalletService::getIncomingPayments(const std::vector<std::string>& payments, IncomingPayments& result) {
   logger(Logging::DEBUGGING) << "getIncomingPayments request came";
 
+  Common::SharedLockGuard<Common::RecursiveSharedMutex> stateGuard(stateLock);
+
   for (const std::string& payment: payments) {
     if (!checkPaymentId(payment)) {
       return make_error_code(error::REQUEST_ERROR);
@@ -494,11 +778,18 @@ std::error_code WalletService::getIncomingPayments(const std::vector<std::string
     std::string paymentString = payment;
     std::transform(paymentString.begin(), paymentString.end(), paymentString.begin(), ::tolower);
 
-    auto pair = paymentIdIndex.equal_range(paymentString);
+    std::vector<CryptoNote::TransactionId> transactions;
+    {
+      std::lock_guard<std::mutex> lock(paymentsCacheMutex);
+      auto pair = paymentIdIndex.equal_range(paymentString);
+      for (auto it = pair.first; it != pair.second; ++it) {
+        transactions.push_back(it->transactionId);
+      }
+    }
 
-    for (auto it = pair.first; it != pair.second; ++it) {
+    for (CryptoNote::TransactionId txId : transactions) {
       CryptoNote::TransactionInfo tx;
-      if (!wallet->getTransaction(it->transactionId, tx)) {
+      if (!wallet->getTransaction(txId, tx) || tx.state != CryptoNote::TransactionState::Active) {
         continue;
       }
 
@@ -510,7 +801,7 @@ std::error_code WalletService::getIncomingPayments(const std::vector<std::string
       details.blockHeight = tx.blockHeight;
       details.unlockTime = 0; //TODO: this is stub. fix it when wallet api allows to retrieve it
 
-      result[it->paymentId].push_back(std::move(details));
+      result[paymentString].push_back(std::move(details));
     }
   }
 
@@ -518,62 +809,31 @@ std::error_code WalletService::getIncomingPayments(const std::vector<std::string
 }
 
 void WalletService::externalTransactionCreated(CryptoNote::TransactionId transactionId) {
-  logger(Logging::DEBUGGING) << "external transaction created " << transactionId;
-  CryptoNote::TransactionInfo tx;
-  if (!wallet->getTransaction(transactionId, tx)) {
-    return;
-  }
-
-  if (tx.totalAmount < 0) {
-    return;
-  }
-
-  logger(Logging::DEBUGGING) << "external transaction created " << transactionId << " extra size: " << tx.extra.size();
-  std::vector<uint8_t> extraVector(tx.extra.begin(), tx.extra.end());
-  crypto::hash paymentId;
-  if (!CryptoNote::getPaymentIdFromTxExtra(extraVector, paymentId)) {
-    logger(Logging::DEBUGGING) << "transaction " << transactionId << " has no payment id";
-    return;
-  }
-
-  insertTransaction(transactionId, paymentId);
-
-  logger(Logging::DEBUGGING) << "transaction " << transactionId << " has been added to payments cache";
+  externalTransactionsCreated(std::vector<CryptoNote::TransactionId>(1, transactionId));
 }
 
 void WalletService::transactionUpdated(CryptoNote::TransactionId transactionId) {
-  CryptoNote::TransactionInfo tx;
-  if (!wallet->getTransaction(transactionId, tx)) {
-    return;
-  }
-
-  if (tx.totalAmount < 0) {
-    return;
-  }
-
-  if (tx.blockHeight != CryptoNote::UNCONFIRMED_TRANSACTION_HEIGHT) {
-    auto it = txIdIndex.find(transactionId);
-    if (it != txIdIndex.end()) {
-      return;
-    }
+  transactionsUpdated(std::vector<CryptoNote::TransactionId>(1, transactionId));
+}
 
-    //insert confirmed transaction
-    std::vector<uint8_t> extraVector(tx.extra.begin(), tx.extra.end());
-    crypto::hash paymentId;
-    if (!CryptoNote::getPaymentIdFromTxExtra(extraVector, paymentId)) {
-      logger(Logging::DEBUGGING) << "transaction " << transactionId << " has no payment id";
-      return;
-    }
+void WalletService::externalTransactionsCreated(const std::vector<CryptoNote::TransactionId>& transactionIds) {
+  logger(Logging::DEBUGGING) << transactionIds.size() << " external transactions created";
+  indexTransactions(transactionIds);
+}
 
-    insertTransaction(transactionId, paymentId);
-    logger(Logging::DEBUGGING) << "transaction " << transactionId << " has been inserted to payments cache";
-  } else {
-    auto it = txIdIndex.find(transactionId);
-    if (it != txIdIndex.end()) {
-      txIdIndex.erase(it);
-      logger(Logging::DEBUGGING) << "transaction " << transactionId << " has been erased from payments cache";
+//deleted transactions stay in the cache, they are skipped on lookup until they are added back
+void WalletService::transactionsUpdated(const std::vector<CryptoNote::TransactionId>& transactionIds) {
+  std::vector<CryptoNote::TransactionId> unindexed;
+  {
+    std::lock_guard<std::mutex> lock(paymentsCacheMutex);
+    for (CryptoNote::TransactionId transactionId : transactionIds) {
+      if (txIdIndex.find(transactionId) == txIdIndex.end()) {
+        unindexed.push_back(transactionId);
+      }
     }
   }
+
+  indexTransactions(unindexed);
 }
 
 void WalletService::insertTransaction(CryptoNote::TransactionId id, const crypto::hash& paymentIdBin) {
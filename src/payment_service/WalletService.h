@@ -43,20 +43,32 @@
 #include "JsonRpcMessages.h"
 #undef ERROR //TODO: workaround for windows build. fix it
 #include "Logging/LoggerRef.h"
+#include "Common/RecursiveSharedMutex.h"
 
+#include <condition_variable>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+namespace CryptoNote {
+class WalletSynchronizer;
+}
+
 namespace PaymentService {
 
 struct SendTransactionRequest;
 struct SendTransactionResponse;
+struct SendTransactionsRequest;
+struct SendTransactionsResponse;
 struct TransferDestination;
 struct TransactionRpcInfo;
 struct TransferRpcInfo;
+struct GetTransactionsRequest;
+struct GetTransactionsResponse;
 
 void importLegacyKeys(const Configuration& conf);
 void generateNewWallet (CryptoNote::Currency &currency, const Configuration &conf, Logging::ILogger &logger);
@@ -65,13 +77,18 @@ class WalletService : public CryptoNote::IWalletObserver {
 public:
   typedef std::map<std::string, std::vector<PaymentDetails> > IncomingPayments;
 
-  explicit WalletService(const CryptoNote::Currency& currency, System::Dispatcher& sys, CryptoNote::INode& node, const Configuration& conf, Logging::ILogger& logger);
+  // serves walletFile, synchronized by sync together with the other wallets of the process. Requests may come from
+  // several threads at once: sends are processed one at a time, reads run concurrently with each other and with sends
+  WalletService(const CryptoNote::Currency& currency, CryptoNote::INode& node, const Configuration& conf,
+    Logging::ILogger& logger, const std::string& walletFile, CryptoNote::WalletSynchronizer& sync);
   virtual ~WalletService();
 
   void init();
+  // blocks only while the wallet state is copied, the copy is written to a temporary file that replaces the wallet one
   void saveWallet();
 
   std::error_code sendTransaction(const SendTransactionRequest& req, SendTransactionResponse& resp);
+  std::error_code sendTransactions(const SendTransactionsRequest& req, SendTransactionsResponse& resp);
   std::error_code getIncomingPayments(const std::vector<std::string>& payments, IncomingPayments& result);
   std::error_code getAddress(std::string& address);
   std::error_code getActualBalance(uint64_t& actualBalance);
@@ -81,10 +98,15 @@ public:
   std::error_code getTransactionByTransferId(CryptoNote::TransferId transfer, CryptoNote::TransactionId& transaction);
   std::error_code getTransaction(CryptoNote::TransactionId txId, bool& found, TransactionRpcInfo& rpcInfo);
   std::error_code getTransfer(CryptoNote::TransferId txId, bool& found, TransferRpcInfo& rpcInfo);
+  std::error_code getTransactions(const GetTransactionsRequest& req, GetTransactionsResponse& resp);
 
 private:
   void loadWallet();
   void loadPaymentsCache();
+  bool loadSavedPaymentsCache();
+  void savePaymentsCache();
+  void autosave();
+  void indexTransactions(const std::vector<CryptoNote::TransactionId>& ids);
   void insertTransaction(CryptoNote::TransactionId id, const crypto::hash& paymentIdBin);
 
   void makeTransfers(const std::vector<TransferDestination>& destinations, std::vector<CryptoNote::Transfer>& transfers);
@@ -93,6 +115,8 @@ private:
 
   virtual void externalTransactionCreated(CryptoNote::TransactionId transactionId);
   virtual void transactionUpdated(CryptoNote::TransactionId transactionId);
+  virtual void externalTransactionsCreated(const std::vector<CryptoNote::TransactionId>& transactionIds);
+  virtual void transactionsUpdated(const std::vector<CryptoNote::TransactionId>& transactionIds);
 
   struct PaymentItem {
     std::string paymentId;
@@ -112,13 +136,32 @@ private:
   std::unique_ptr<CryptoNote::IWallet> wallet;
   CryptoNote::INode* node;
   const Configuration& config;
+  std::string walletFile;
   bool inited;
   WalletTransactionSendObserver sendObserver;
   Logging::LoggerRef logger;
 
+  // Incoming transactions by payment id. Entries are only added, transaction ids are stable, so the cache is saved
+  // next to the wallet and on start only transactions after the saved ones are parsed. Transactions that are not
+  // active are filtered out on lookup.
   PaymentsContainer paymentsCache;
   PaymentsContainer::nth_index<0>::type& txIdIndex;
   PaymentsContainer::nth_index<1>::type& paymentIdIndex;
+  size_t indexedTransactionCount;
+  std::mutex paymentsCacheMutex;
+
+  // autosaves run on their own thread, saveMutex keeps them from overlapping with saves on exit
+  std::mutex saveMutex;
+  std::thread autosaveThread;
+  std::mutex autosaveMutex;
+  std::condition_variable autosaveStopped;
+  bool stopAutosave;
+
+  // held by a send for its whole duration, waiting for the result included
+  std::mutex sendMutex;
+  // transactions are handed to the wallet under it exclusively, reads made of several wallet calls take it shared so
+  // they see the wallet either before or after a send
+  Common::RecursiveSharedMutex stateLock;
 };
 
 } //namespace PaymentService
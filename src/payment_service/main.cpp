@@ -48,6 +48,7 @@
 #include "Logging/LoggerRef.h"
 #include "Logging/StreamLogger.h"
 #include "NodeFactory.h"
+#include "wallet/WalletSynchronizer.h"
 
 #include <boost/asio/io_service.hpp>
 
@@ -76,7 +77,7 @@
 PaymentService::ConfigurationManager config;
 System::Dispatcher systemService;
 System::Event stopEvent(systemService);
-PaymentService::WalletService* service;
+std::vector<PaymentService::WalletService*> services;
 std::unique_ptr<CryptoNote::CurrencyBuilder> currencyBuilder;
 Logging::LoggerGroup logger;
 CryptoNote::node_server * gP2pNode = nullptr;
@@ -91,12 +92,12 @@ void stopSignalHandler() {
   Logging::LoggerRef log(logger, "StopSignalHandler");
   log(Logging::INFO) << "Stop signal caught";
 
-  try {
-    if (service) {
+  for (PaymentService::WalletService* service : services) {
+    try {
       service->saveWallet();
+    } catch (std::exception& ex) {
+      log(Logging::WARNING) << "Couldn't save wallet: " << ex.what();
     }
-  } catch (std::exception& ex) {
-    log(Logging::WARNING) << "Couldn't save wallet: " << ex.what();
   }
 
 
@@ -129,13 +130,13 @@ void __stdcall serviceHandler(DWORD fdwControl) {
     SERVICE_STATUS serviceStatus{ SERVICE_WIN32_OWN_PROCESS, SERVICE_STOP_PENDING, 0, NO_ERROR, 0, 0, 0 };
     SetServiceStatus(serviceStatusHandle, &serviceStatus);
 
-    try {
-      if (service) {
+    for (PaymentService::WalletService* service : services) {
+      try {
         log(Logging::INFO) << "Saving wallet";
         service->saveWallet();
+      } catch (std::exception& ex) {
+        log(Logging::WARNING) << "Couldn't save wallet: " << ex.what();
       }
-    } catch (std::exception& ex) {
-      log(Logging::WARNING) << "Couldn't save wallet: " << ex.what();
     }
 
     log(Logging::INFO) << "Stopping service";
@@ -375,6 +376,27 @@ void changeDirectory(const std::string& path) {
 #endif
 }
 
+// all the wallets share one synchronizer, so each block is fetched and scanned once for them
+void runWalletServices(const CryptoNote::Currency& currency, CryptoNote::INode& node) {
+  CryptoNote::WalletSynchronizer sync(currency, node);
+
+  std::vector<std::string> walletFiles(1, config.gateConfiguration.walletFile);
+  walletFiles.insert(walletFiles.end(), config.gateConfiguration.hostedWalletFiles.begin(), config.gateConfiguration.hostedWalletFiles.end());
+
+  std::vector<std::unique_ptr<PaymentService::WalletService>> serviceGuards;
+  for (const std::string& walletFile : walletFiles) {
+    serviceGuards.emplace_back(new PaymentService::WalletService(currency, node, config.gateConfiguration, logger, walletFile, sync));
+    serviceGuards.back()->init();
+    services.push_back(serviceGuards.back().get());
+  }
+
+  PaymentService::JsonRpcServer rpcServer(systemService, stopEvent, services, logger);
+
+  rpcServer.start(config.gateConfiguration);
+
+  services.clear();
+}
+
 void runInProcess() {
   Logging::LoggerRef(logger, "run")(Logging::INFO) << "Starting Payment Gate with local node";
 
@@ -431,16 +453,8 @@ void runInProcess() {
   p2pStarted.wait();
   Logging::LoggerRef(logger, "run")(Logging::INFO) << "p2p server is started";
 
-  service = new PaymentService::WalletService(currency, systemService, *node, config.gateConfiguration, logger);
-  std::unique_ptr<PaymentService::WalletService> serviceGuard(service);
-
-  service->init();
-
-  PaymentService::JsonRpcServer rpcServer(systemService, stopEvent, *service, logger);
+  runWalletServices(currency, *node);
 
-  rpcServer.start(config.gateConfiguration);
-
-  serviceGuard.reset();
   node->shutdown();
   core.deinit();
   p2pNode.deinit();
@@ -454,14 +468,7 @@ void runRpcProxy() {
 
   node.reset(PaymentService::NodeFactory::createNode(config.remoteNodeConfig.daemonHost, config.remoteNodeConfig.daemonPort));
 
-  service = new PaymentService::WalletService(currency, systemService, *node, config.gateConfiguration, logger);
-  std::unique_ptr<PaymentService::WalletService> serviceGuard(service);
-
-  service->init();
-
-  PaymentService::JsonRpcServer rpcServer(systemService, stopEvent, *service, logger);
-
-  rpcServer.start(config.gateConfiguration);
+  runWalletServices(currency, *node);
 }
 
 void run() {
@@ -17,45 +17,216 @@
 
 #include "HttpClient.h"
 
-#include <HTTP/HttpParser.h>
+#include <algorithm>
+
+#include <HTTP/HttpParserErrorCodes.h>
+#include <HTTP/HttpStreamParser.h>
+#include <System/InterruptedException.h>
 #include <System/Ipv4Resolver.h>
 #include <System/Ipv4Address.h>
+#include <System/Mutex.h>
+#include <System/TcpConnection.h>
 #include <System/TcpConnector.h>
+#include <System/TcpStream.h>
+#include <System/UnixAddress.h>
 
 namespace CryptoNote {
 
-HttpClient::HttpClient(System::Dispatcher& dispatcher, const std::string& address, uint16_t port) :
-  m_dispatcher(dispatcher), m_address(address), m_port(port) {
+struct HttpClient::Connection {
+  Connection(System::Dispatcher& dispatcher, size_t maxResponseSize) :
+    parser(maxResponseSize), writeMutex(dispatcher), readTurn(dispatcher) {
+  }
+
+  System::TcpConnection connection;
+  std::unique_ptr<System::TcpStreambuf> streamBuf;
+  HttpStreamParser parser;
+  // requests are written whole one after another, each takes a ticket and reads its response when nextRead gets to it
+  System::Mutex writeMutex;
+  System::Event readTurn;
+  uint64_t nextTicket = 0;
+  uint64_t nextRead = 0;
+  size_t pending = 0;
+  size_t served = 0;
+  // new requests go only to connected connections the server hasn't asked to close
+  bool reusable = false;
+  bool broken = false;
+  bool stopped = false;
+};
+
+HttpClient::HttpClient(System::Dispatcher& dispatcher, const std::string& address, uint16_t port, size_t maxResponseSize) :
+  m_dispatcher(dispatcher), m_address(address), m_port(port), m_maxResponseSize(maxResponseSize),
+  m_maxConnections(DEFAULT_MAX_CONNECTIONS), m_pipelineDepth(DEFAULT_PIPELINE_DEPTH), m_connectionReleased(dispatcher) {
+}
+
+void HttpClient::setMaxConnections(size_t maxConnections) {
+  m_maxConnections = std::max<size_t>(maxConnections, 1);
+}
+
+void HttpClient::setPipelineDepth(size_t pipelineDepth) {
+  m_pipelineDepth = std::max<size_t>(pipelineDepth, 1);
 }
 
 void HttpClient::request(const HttpRequest &req, HttpResponse &res) {
-  if (!m_connected) {
-    connect();
+  for (bool retried = false;; retried = true) {
+    std::shared_ptr<Connection> connection = acquireConnection();
+    bool reused = false;
+    size_t received = 0;
+
+    try {
+      uint64_t ticket;
+      {
+        std::lock_guard<System::Mutex> lock(connection->writeMutex);
+        if (connection->broken) {
+          throw std::system_error(make_error_code(error::HttpParserErrorCodes::END_OF_STREAM));
+        }
+
+        reused = connection->served > 0;
+        std::ostream stream(connection->streamBuf.get());
+        stream << req;
+        stream.flush();
+        if (!stream) {
+          throw std::system_error(make_error_code(error::HttpParserErrorCodes::END_OF_STREAM));
+        }
+
+        ticket = connection->nextTicket++;
+      }
+
+      while (connection->nextRead != ticket && !connection->broken) {
+        connection->readTurn.clear();
+        connection->readTurn.wait();
+      }
+
+      if (connection->broken) {
+        throw std::system_error(make_error_code(error::HttpParserErrorCodes::END_OF_STREAM));
+      }
+
+      // responses are read past the stream buffer, it is used only for writing
+      HttpStreamParser& parser = connection->parser;
+      while (!parser.parseResponse()) {
+        size_t size;
+        uint8_t* buffer = parser.getReadBuffer(size);
+        size = connection->connection.read(buffer, size);
+        if (size == 0) {
+          throw std::system_error(make_error_code(error::HttpParserErrorCodes::END_OF_STREAM));
+        }
+
+        received += size;
+        parser.commit(size);
+      }
+
+      parser.getResponse(res);
+      if (!parser.keepAlive()) {
+        connection->reusable = false;
+      }
+
+      parser.consume();
+      ++connection->served;
+      ++connection->nextRead;
+      connection->readTurn.set();
+      releaseConnection(connection);
+      return;
+    } catch (const std::exception&) {
+      breakConnection(*connection);
+      releaseConnection(connection);
+      if (retried || m_stopped || !reused || received > 0) {
+        throw;
+      }
+    }
+  }
+}
+
+// Takes an idle connection, opens a new one below the limit or pipelines behind the least loaded one
+std::shared_ptr<HttpClient::Connection> HttpClient::acquireConnection() {
+  for (;;) {
+    if (m_stopped) {
+      throw System::InterruptedException();
+    }
+
+    std::shared_ptr<Connection> best;
+    size_t connectionCount = 0;
+    for (const std::shared_ptr<Connection>& connection : m_connections) {
+      if (connection->broken) {
+        continue;
+      }
+
+      ++connectionCount;
+      if (connection->reusable && connection->pending < m_pipelineDepth && (!best || connection->pending < best->pending)) {
+        best = connection;
+      }
+    }
+
+    if (best && (best->pending == 0 || connectionCount >= m_maxConnections)) {
+      ++best->pending;
+      return best;
+    }
+
+    if (connectionCount < m_maxConnections) {
+      std::shared_ptr<Connection> connection = std::make_shared<Connection>(m_dispatcher, m_maxResponseSize);
+      connection->pending = 1;
+      m_connections.push_back(connection);
+      try {
+        connect(*connection);
+      } catch (const std::exception&) {
+        breakConnection(*connection);
+        releaseConnection(connection);
+        throw;
+      }
+
+      return connection;
+    }
+
+    m_connectionReleased.clear();
+    m_connectionReleased.wait();
   }
+}
 
-  try {
-    std::iostream stream(m_streamBuf.get());
-    HttpParser parser;
-    stream << req;
-    stream.flush();
-    parser.receiveResponse(stream, res);
-  } catch (const std::exception &) {
-    disconnect();
-    throw;
+void HttpClient::releaseConnection(const std::shared_ptr<Connection>& connection) {
+  --connection->pending;
+  if (connection->pending == 0 && !connection->reusable) {
+    m_connections.remove(connection);
   }
+
+  m_connectionReleased.set();
 }
 
-void HttpClient::connect() {
-  auto ipAddr = System::Ipv4Resolver(m_dispatcher).resolve(m_address);
-  m_connection = System::TcpConnector(m_dispatcher).connect(ipAddr, m_port);
-  m_streamBuf.reset(new System::TcpStreambuf(m_connection));
-  m_connected = true;
+void HttpClient::connect(Connection& connection) {
+  if (System::isUnixAddress(m_address)) {
+    connection.connection = System::TcpConnector(m_dispatcher).connect(System::getUnixPath(m_address));
+  } else {
+    auto ipAddr = System::Ipv4Resolver(m_dispatcher).resolve(m_address);
+    connection.connection = System::TcpConnector(m_dispatcher).connect(ipAddr, m_port);
+  }
+
+  connection.streamBuf.reset(new System::TcpStreambuf(connection.connection));
+
+  // stop may come while connecting, there was no connection to stop then
+  if (m_stopped) {
+    throw System::InterruptedException();
+  }
+
+  connection.reusable = true;
 }
 
-void HttpClient::disconnect() {
-  m_streamBuf.reset();
-  m_connection = System::TcpConnection();
-  m_connected = false;
+// Requests waiting on the connection fail, ones reading or writing it are interrupted
+void HttpClient::breakConnection(Connection& connection) {
+  connection.reusable = false;
+  if (!connection.broken) {
+    connection.broken = true;
+    connection.readTurn.set();
+    if (connection.streamBuf && !connection.stopped) {
+      connection.stopped = true;
+      connection.connection.stop();
+    }
+  }
+}
+
+void HttpClient::stop() {
+  m_stopped = true;
+  for (const std::shared_ptr<Connection>& connection : m_connections) {
+    breakConnection(*connection);
+  }
+
+  m_connectionReleased.set();
 }
 
 }
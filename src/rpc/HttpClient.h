@@ -17,12 +17,12 @@
 
 #pragma once
 
+#include <list>
 #include <memory>
 
 #include <HTTP/HttpRequest.h>
 #include <HTTP/HttpResponse.h>
-#include <System/TcpConnection.h>
-#include <System/TcpStream.h>
+#include <System/Event.h>
 
 // epee serialization
 #include "misc_log_ex.h"
@@ -30,24 +30,52 @@
 
 namespace CryptoNote {
 
+// Keeps a pool of keep-alive connections to one server. Requests of several contexts of the dispatcher run on
+// separate connections up to the connection limit, after that they are pipelined, written behind requests still
+// waiting for responses, up to the pipeline depth per connection. Responses are read in the order requests were
+// written. A request that fails on a reused connection before any byte of its response is received is sent once
+// more on another connection, the server may have closed the idle connection meanwhile.
 class HttpClient {
 public:
 
-  HttpClient(System::Dispatcher& dispatcher, const std::string& address, uint16_t port);
+  // Responses are buffered whole, getblocks.bin ones may take tens of megabytes
+  static const size_t DEFAULT_MAX_RESPONSE_SIZE = 256 * 1024 * 1024;
+  static const size_t DEFAULT_MAX_CONNECTIONS = 4;
+  static const size_t DEFAULT_PIPELINE_DEPTH = 1;
+
+  // Address may be unix:<path> for a Unix domain socket, the port is ignored then
+  HttpClient(System::Dispatcher& dispatcher, const std::string& address, uint16_t port, size_t maxResponseSize = DEFAULT_MAX_RESPONSE_SIZE);
+  HttpClient(const HttpClient&) = delete;
+  HttpClient& operator=(const HttpClient&) = delete;
+
+  void setMaxConnections(size_t maxConnections);
+  // Requests in flight on one connection, 1 disables pipelining
+  void setPipelineDepth(size_t pipelineDepth);
   void request(const HttpRequest& req, HttpResponse& res);
+  // Interrupts running requests with InterruptedException, later ones fail the same way.
+  // Has to be called in the dispatcher thread.
+  void stop();
 
 private:
 
-  void connect();
-  void disconnect();
+  struct Connection;
+
+  std::shared_ptr<Connection> acquireConnection();
+  void releaseConnection(const std::shared_ptr<Connection>& connection);
+  void connect(Connection& connection);
+  void breakConnection(Connection& connection);
 
   const std::string m_address;
   const uint16_t m_port;
+  const size_t m_maxResponseSize;
+  size_t m_maxConnections;
+  size_t m_pipelineDepth;
 
-  bool m_connected = false;
+  bool m_stopped = false;
   System::Dispatcher& m_dispatcher;
-  System::TcpConnection m_connection;
-  std::unique_ptr<System::TcpStreambuf> m_streamBuf;
+  // all open connections, including ones broken or closed by the server that still have requests on them
+  std::list<std::shared_ptr<Connection>> m_connections;
+  System::Event m_connectionReleased;
 };
 
 template <typename Request, typename Response>
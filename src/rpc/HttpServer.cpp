@@ -16,26 +16,109 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "HttpServer.h"
+#include <sstream>
 #include <boost/scope_exit.hpp>
 
-#include <HTTP/HttpParser.h>
+#include <HTTP/HttpParserErrorCodes.h>
+#include <HTTP/HttpStreamParser.h>
 #include <System/InterruptedException.h>
-#include <System/TcpStream.h>
 #include <System/Ipv4Address.h>
+#include <System/Timer.h>
+#include <System/UnixAddress.h>
 
 using namespace Logging;
 
 namespace CryptoNote {
 
-HttpServer::HttpServer(System::Dispatcher& dispatcher, Logging::ILogger& log)
-  : m_dispatcher(dispatcher), logger(log, "HttpServer"), m_shutdownCompleteEvent(dispatcher) {
+namespace {
+
+// connection may send less than asked, the rest is written by next calls
+void writeStrict(System::TcpConnection& connection, System::TcpConnection::Buffer* buffers, size_t count) {
+  while (count > 0) {
+    size_t transferred = connection.write(buffers, count);
+    while (count > 0 && transferred >= buffers->size) {
+      transferred -= buffers->size;
+      ++buffers;
+      --count;
+    }
+
+    if (count > 0) {
+      buffers->data += transferred;
+      buffers->size -= transferred;
+    }
+  }
+}
+
+void sendResponse(System::TcpConnection& connection, const HttpResponse& response, std::string& head) {
+  head.clear();
+  response.appendHead(head);
+  if (!response.getBodyProducer()) {
+    System::TcpConnection::Buffer buffers[] = {
+      { reinterpret_cast<const uint8_t*>(head.data()), head.size() },
+      { reinterpret_cast<const uint8_t*>(response.getBody().data()), response.getBody().size() }
+    };
+
+    writeStrict(connection, buffers, 2);
+    return;
+  }
+
+  // the head goes out with the first chunk, each chunk is framed by its size line and CRLF in one gather write.
+  // Producer errors leave the body without the last chunk, so the peer doesn't take it for a complete one.
+  static const char CRLF[] = "\r\n";
+  std::string sizeLine;
+  response.getBodyProducer()([&](const std::string& chunk) {
+    if (chunk.empty()) {
+      return;
+    }
+
+    std::ostringstream size;
+    size << std::hex << chunk.size() << CRLF;
+    sizeLine = size.str();
+    System::TcpConnection::Buffer buffers[] = {
+      { reinterpret_cast<const uint8_t*>(head.data()), head.size() },
+      { reinterpret_cast<const uint8_t*>(sizeLine.data()), sizeLine.size() },
+      { reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size() },
+      { reinterpret_cast<const uint8_t*>(CRLF), 2 }
+    };
+
+    writeStrict(connection, buffers, 4);
+    head.clear();
+  });
+
+  head += "0\r\n\r\n";
+  System::TcpConnection::Buffer last = { reinterpret_cast<const uint8_t*>(head.data()), head.size() };
+  writeStrict(connection, &last, 1);
+}
 
 }
 
+HttpServer::HttpServer(System::Dispatcher& dispatcher, Logging::ILogger& log, size_t maxRequestSize)
+  : m_dispatcher(dispatcher), logger(log, "HttpServer"), m_shutdownCompleteEvent(dispatcher), m_maxRequestSize(maxRequestSize),
+  m_maxConnections(0), m_idleTimeout(0), m_compressionMinSize(DEFAULT_COMPRESSION_MIN_SIZE) {
+
+}
+
+void HttpServer::setMaxConnections(size_t maxConnections) {
+  m_maxConnections = maxConnections;
+}
+
+void HttpServer::setIdleTimeout(std::chrono::milliseconds timeout) {
+  m_idleTimeout = timeout;
+}
+
+void HttpServer::setCompressionMinSize(size_t minSize) {
+  m_compressionMinSize = minSize;
+}
+
 void HttpServer::start(const std::string& address, uint16_t port) {
-  m_listener = System::TcpListener(m_dispatcher, System::Ipv4Address(address), port);
+  if (System::isUnixAddress(address)) {
+    m_listener = System::TcpListener(m_dispatcher, System::getUnixPath(address));
+  } else {
+    m_listener = System::TcpListener(m_dispatcher, System::Ipv4Address(address), port);
+  }
+
   ++m_spawnCount;
-  m_dispatcher.spawn(std::bind(&HttpServer::acceptLoop, this));
+  m_dispatcher.spawn(std::bind(&HttpServer::acceptLoop, this), "HttpServer::acceptLoop");
 }
 
 void HttpServer::stop() {
@@ -66,33 +149,25 @@ void HttpServer::acceptLoop() {
       }
     }
 
-    m_connections.insert(&connection);
-    BOOST_SCOPE_EXIT_ALL(this, &connection) { 
-      m_connections.erase(&connection); };
-
-    auto addr = connection.getPeerAddressAndPort();
-
-    logger(DEBUGGING) << "Incoming connection from " << addr.first.toDottedDecimal() << ":" << addr.second;
-
     ++m_spawnCount;
-    m_dispatcher.spawn(std::bind(&HttpServer::acceptLoop, this));
+    m_dispatcher.spawn(std::bind(&HttpServer::acceptLoop, this), "HttpServer::acceptLoop");
 
-    System::TcpStreambuf streambuf(connection);
-    std::iostream stream(&streambuf);
-    HttpParser parser;
+    if (m_maxConnections != 0 && m_connections.size() >= m_maxConnections) {
+      logger(DEBUGGING) << "Rejecting connection, " << m_connections.size() << " connections are open";
+      rejectConnection(connection);
+    } else {
+      m_connections.insert(&connection);
+      BOOST_SCOPE_EXIT_ALL(this, &connection) {
+        m_connections.erase(&connection); };
 
-    for (;;) {
-      HttpRequest req;
-      HttpResponse resp;
+      auto addr = connection.getPeerAddressAndPort();
 
-      parser.receiveRequest(stream, req);
-      processRequest(req, resp);
+      logger(DEBUGGING) << "Incoming connection from " << addr.first.toDottedDecimal() << ":" << addr.second;
 
-      stream << resp;
-      stream.flush();
-    }
+      serveConnection(connection, addr.first.getValue());
 
-    logger(DEBUGGING) << "Closing connection from " << addr.first.toDottedDecimal() << ":" << addr.second << " total=" << m_connections.size();
+      logger(DEBUGGING) << "Closing connection from " << addr.first.toDottedDecimal() << ":" << addr.second << " total=" << m_connections.size();
+    }
 
   } catch (System::InterruptedException&) {
   } catch (std::exception& e) {
@@ -104,4 +179,101 @@ void HttpServer::acceptLoop() {
   }
 }
 
+void HttpServer::rejectConnection(System::TcpConnection& connection) {
+  // request isn't even read, the peer learns about the limit as soon as possible
+  HttpResponse resp;
+  resp.setStatus(HttpResponse::STATUS_503);
+  resp.addHeader("Connection", "close");
+  std::string head;
+  sendResponse(connection, resp, head);
+  // empty write shuts the sending side down
+  connection.write(static_cast<const uint8_t*>(nullptr), 0);
+}
+
+void HttpServer::serveConnection(System::TcpConnection& connection, uint32_t peerAddress) {
+  typedef std::chrono::steady_clock Clock;
+
+  // request and head buffers live as long as the connection, requests don't allocate them again
+  HttpStreamParser parser(m_maxRequestSize);
+  HttpRequest req;
+  std::string head;
+
+  // next request has to be received within the idle timeout after the previous response, including slowly sent ones
+  bool waiting = true;
+  Clock::time_point deadline = Clock::now() + m_idleTimeout;
+  System::Timer idleTimer(m_dispatcher);
+  System::Event idleTimerStopped(m_dispatcher);
+  if (m_idleTimeout.count() != 0) {
+    m_dispatcher.spawn([&] {
+      try {
+        for (;;) {
+          Clock::time_point now = Clock::now();
+          if (waiting && now >= deadline) {
+            logger(DEBUGGING) << "Closing idle connection";
+            m_connections.erase(&connection);
+            connection.stop();
+            break;
+          }
+
+          idleTimer.sleep(waiting ? std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) + std::chrono::milliseconds(1) : m_idleTimeout);
+        }
+      } catch (System::InterruptedException&) {
+      }
+
+      idleTimerStopped.set();
+    });
+  } else {
+    idleTimerStopped.set();
+  }
+
+  BOOST_SCOPE_EXIT_ALL(&idleTimer, &idleTimerStopped) {
+    idleTimer.stop();
+    idleTimerStopped.wait(); };
+
+  // pipelined requests already buffered by the parser are answered in order without reading the connection
+  for (;;) {
+    while (!parser.parseRequest()) {
+      size_t size;
+      uint8_t* buffer = parser.getReadBuffer(size);
+      size = connection.read(buffer, size);
+      if (size == 0) {
+        return;
+      }
+
+      parser.commit(size);
+    }
+
+    waiting = false;
+    bool keepAlive = parser.keepAlive();
+    bool chunkedAccepted = parser.getVersion() == Common::StringView("HTTP/1.1");
+    HttpResponse resp;
+    parser.getRequest(req);
+    req.setPeerAddress(peerAddress);
+    parser.consume();
+    processRequest(req, resp);
+    if (m_compressionMinSize != 0) {
+      resp.compressBody(req, m_compressionMinSize);
+    }
+
+    // chunked transfer encoding is HTTP/1.1 only, older clients get the produced body whole with its length
+    if (resp.getBodyProducer() && !chunkedAccepted) {
+      std::string body;
+      resp.getBodyProducer()([&body](const std::string& chunk) { body += chunk; });
+      resp.setBody(body);
+    }
+
+    if (!keepAlive) {
+      resp.addHeader("Connection", "close");
+    }
+
+    sendResponse(connection, resp, head);
+    if (!keepAlive) {
+      return;
+    }
+
+    deadline = Clock::now() + m_idleTimeout;
+    waiting = true;
+  }
+}
+
 }
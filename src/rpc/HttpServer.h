@@ -17,6 +17,7 @@
 
 #pragma once 
 
+#include <chrono>
 #include <unordered_set>
 
 #include <HTTP/HttpRequest.h>
@@ -35,10 +36,22 @@ class HttpServer {
 
 public:
 
-  HttpServer(System::Dispatcher& dispatcher, Logging::ILogger& log);
+  // Requests are buffered whole, larger ones close the connection
+  static const size_t DEFAULT_MAX_REQUEST_SIZE = 16 * 1024 * 1024;
+  // Smaller responses gain too little from compression
+  static const size_t DEFAULT_COMPRESSION_MIN_SIZE = 1024;
 
+  HttpServer(System::Dispatcher& dispatcher, Logging::ILogger& log, size_t maxRequestSize = DEFAULT_MAX_REQUEST_SIZE);
+
+  // 0 disables the limit, connections over it are answered with 503 and closed right away
+  void setMaxConnections(size_t maxConnections);
+  // Connection is closed if its next request isn't received within the timeout, 0 disables it
+  void setIdleTimeout(std::chrono::milliseconds timeout);
+  // Responses of at least this size are compressed for clients that accept gzip or deflate, 0 disables compression
+  void setCompressionMinSize(size_t minSize);
+  // Address may be unix:<path> for a Unix domain socket, the port is ignored then
   void start(const std::string& address, uint16_t port);
-  void stop();
+  virtual void stop();
 
   virtual void processRequest(const HttpRequest& request, HttpResponse& response) = 0;
 
@@ -50,11 +63,17 @@ private:
 
   void acceptLoop();
   void connectionHandler(System::TcpConnection&& conn);
+  void rejectConnection(System::TcpConnection& connection);
+  void serveConnection(System::TcpConnection& connection, uint32_t peerAddress);
 
   Logging::LoggerRef logger;
   System::TcpListener m_listener;
   System::Event m_shutdownCompleteEvent;
   size_t m_spawnCount = 0;
+  size_t m_maxRequestSize;
+  size_t m_maxConnections;
+  std::chrono::milliseconds m_idleTimeout;
+  size_t m_compressionMinSize;
   std::unordered_set<System::TcpConnection*> m_connections;
 };
 
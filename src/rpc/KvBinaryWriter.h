@@ -0,0 +1,92 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "misc_log_ex.h"
+#include "storages/portable_storage_to_bin.h"
+
+namespace CryptoNote {
+
+// Appends epee portable storage binary encoding piece by piece, so large arrays can be sent while their items are
+// still being produced. Entry counts of sections and arrays have to be known when they are begun, entries of
+// a section are then written one by one, an object array is followed by exactly count sections.
+class KvBinaryWriter {
+public:
+  explicit KvBinaryWriter(std::string& buffer) : m_stream{ buffer } {
+  }
+
+  void beginRoot(size_t entryCount) {
+    uint32_t signatureA = PORTABLE_STORAGE_SIGNATUREA;
+    uint32_t signatureB = PORTABLE_STORAGE_SIGNATUREB;
+    uint8_t version = PORTABLE_STORAGE_FORMAT_VER;
+    m_stream.write(reinterpret_cast<const char*>(&signatureA), sizeof(signatureA));
+    m_stream.write(reinterpret_cast<const char*>(&signatureB), sizeof(signatureB));
+    m_stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    beginSection(entryCount);
+  }
+
+  void beginSection(size_t entryCount) {
+    epee::serialization::pack_varint(m_stream, entryCount);
+  }
+
+  void writeUint64(const std::string& name, uint64_t value) {
+    writeName(name, SERIALIZE_TYPE_UINT64);
+    m_stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void writeString(const std::string& name, const std::string& value) {
+    writeName(name, SERIALIZE_TYPE_STRING);
+    epee::serialization::put_string(m_stream, value);
+  }
+
+  template<class Strings> void writeStringArray(const std::string& name, const Strings& values) {
+    writeName(name, SERIALIZE_TYPE_STRING | SERIALIZE_FLAG_ARRAY);
+    epee::serialization::pack_varint(m_stream, values.size());
+    for (const std::string& value : values) {
+      epee::serialization::put_string(m_stream, value);
+    }
+  }
+
+  void beginObjectArray(const std::string& name, size_t count) {
+    writeName(name, SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY);
+    epee::serialization::pack_varint(m_stream, count);
+  }
+
+private:
+  struct Stream {
+    std::string& buffer;
+
+    void write(const char* data, size_t size) {
+      buffer.append(data, size);
+    }
+  };
+
+  void writeName(const std::string& name, uint8_t type) {
+    uint8_t size = static_cast<uint8_t>(name.size());
+    m_stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    m_stream.write(name.data(), name.size());
+    m_stream.write(reinterpret_cast<const char*>(&type), sizeof(type));
+  }
+
+  Stream m_stream;
+};
+
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "cryptonote_core/ICoreObserver.h"
+
+namespace CryptoNote {
+
+// Serialized responses of read-only RPC calls keyed by url and request body. Everything is dropped when the
+// blockchain or the pool changes, entries also expire after maxAge for data the core doesn't notify about.
+// Observer notifications come from core threads, access is synchronized.
+class RpcResponseCache : public ICoreObserver {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  RpcResponseCache(Clock::duration maxAge, size_t maxEntries) : m_maxAge(maxAge), m_maxEntries(maxEntries), m_generation(0) {
+  }
+
+  // Responses computed from the state before a change can't be stored after it, callers take the generation
+  // before computing a response and pass it to store
+  uint64_t getGeneration() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+  }
+
+  bool find(const std::string& key, Clock::time_point now, std::string& response) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end() || now - it->second.storedAt >= m_maxAge) {
+      return false;
+    }
+
+    response = it->second.response;
+    return true;
+  }
+
+  void store(const std::string& key, const std::string& response, uint64_t generation, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (generation != m_generation) {
+      return;
+    }
+
+    // keys include request parameters, the map is bounded by dropping it whole
+    if (m_entries.size() >= m_maxEntries && m_entries.count(key) == 0) {
+      m_entries.clear();
+    }
+
+    Entry& entry = m_entries[key];
+    entry.response = response;
+    entry.storedAt = now;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    ++m_generation;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+  virtual void blockchainUpdated() override {
+    clear();
+  }
+
+  virtual void poolUpdated() override {
+    clear();
+  }
+
+  virtual void txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) override {
+    clear();
+  }
+
+private:
+  struct Entry {
+    std::string response;
+    Clock::time_point storedAt;
+  };
+
+  Clock::duration m_maxAge;
+  size_t m_maxEntries;
+  mutable std::mutex m_mutex;
+  uint64_t m_generation;
+  std::unordered_map<std::string, Entry> m_entries;
+};
+
+}
@@ -17,16 +17,23 @@
 
 #include "RpcServer.h"
 
-#include <future>
+#include <exception>
 #include <unordered_map>
 
+#include <System/InterruptedException.h>
+#include <System/Timer.h>
+
 // CryptoNote
+#include "Common/JsonValue.h"
+#include "Common/Metrics.h"
+#include "Common/TokenBucket.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/miner.h"
 #include "p2p/net_node.h"
 
 #include "core_rpc_server_error_codes.h"
 #include "JsonRpc.h"
+#include "KvBinaryWriter.h"
 
 #undef ERROR
 
@@ -36,6 +43,26 @@ namespace CryptoNote {
 
 namespace {
 
+// getinfo reports p2p connection counts the core doesn't notify about, cached responses don't outlive a second
+const std::chrono::steady_clock::duration RESPONSE_CACHE_MAX_AGE = std::chrono::seconds(1);
+const size_t RESPONSE_CACHE_MAX_ENTRIES = 1024;
+// blocks of a /getblocks.bin response are loaded and sent by batches of this size
+const size_t GET_BLOCKS_BATCH_SIZE = 20;
+// long polls are answered at least this often, milliseconds
+const uint64_t WAIT_STATE_CHANGE_MAX_TIMEOUT = 60000;
+// work units of a request, plus one per kilobyte of its response
+const uint64_t CLIENT_REQUEST_COST = 1;
+const size_t CLIENT_RESPONSE_COST_SIZE = 1024;
+// client owing more work than this is answered with 429 instead of waiting
+const std::chrono::seconds CLIENT_MAX_DELAY(10);
+// budgets of idle clients are forgotten once there are this many
+const size_t CLIENT_BUDGETS_MAX_COUNT = 4096;
+
+// local clients, including those of a Unix domain socket, are not limited
+bool isLocalClient(uint32_t address) {
+  return address == 0 || (address >> 24) == 127;
+}
+
 template <typename Command>
 RpcServer::HandlerFunction binMethod(bool (RpcServer::*handler)(typename Command::request const&, typename Command::response&)) {
   return [handler](RpcServer* obj, const HttpRequest& request, HttpResponse& response) {
@@ -72,33 +99,88 @@ RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Comman
 
 }
   
-std::unordered_map<std::string, RpcServer::HandlerFunction> RpcServer::s_handlers = {
+// concurrent handlers may run in worker threads, they must not touch p2p state or wait for dispatcher events.
+// Cheap handlers stay in the network thread, handing them over to a worker would cost more than running them.
+// Responses of cached handlers depend on the request and the blockchain and pool state only, they are served from
+// m_cache until the state changes.
+std::unordered_map<std::string, RpcServer::RpcHandler> RpcServer::s_handlers = {
   
   // binary handlers
-  { "/getblocks.bin", binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks) },
-  { "/queryblocks.bin", binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks) },
-  { "/get_o_indexes.bin", binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes) },
-  { "/getrandom_outs.bin", binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs) },
+  { "/getblocks.bin", { std::bind(&RpcServer::processGetBlocksRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), false, false } },
+  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), true, false } },
+  { "/queryblocksfiltered.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_FILTERED>(&RpcServer::on_query_blocks_filtered), true, false } },
+  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), true, false } },
+  { "/get_txs_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_txs_indexes), true, false } },
+  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), true, false } },
+  { "/getblockheaders.bin", { binMethod<COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_BIN>(&RpcServer::on_get_block_headers_range_bin), true, false } },
+  { "/getblockfilters.bin", { binMethod<COMMAND_RPC_GET_BLOCK_FILTERS>(&RpcServer::on_get_block_filters), true, false } },
+  { "/waitstatechange.bin", { binMethod<COMMAND_RPC_WAIT_STATE_CHANGE>(&RpcServer::on_wait_state_change), false, false } },
+  { "/getpoolchanges.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::on_get_pool_changes), true, false } },
 
   // json handlers
-  { "/getinfo", jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info) },
-  { "/getheight", jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height) },
-  { "/gettransactions", jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions)},
-  { "/sendrawtransaction", jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx) },
-  { "/start_mining", jsonMethod<COMMAND_RPC_START_MINING>(&RpcServer::on_start_mining) },
-  { "/stop_mining", jsonMethod<COMMAND_RPC_STOP_MINING>(&RpcServer::on_stop_mining) },
-  { "/stop_daemon", jsonMethod<COMMAND_RPC_STOP_DAEMON>(&RpcServer::on_stop_daemon) },
+  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), false, true } },
+  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), false, true } },
+  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), true, false } },
+  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), true, false } },
+  { "/start_mining", { jsonMethod<COMMAND_RPC_START_MINING>(&RpcServer::on_start_mining), false, false } },
+  { "/stop_mining", { jsonMethod<COMMAND_RPC_STOP_MINING>(&RpcServer::on_stop_mining), false, false } },
+  { "/stop_daemon", { jsonMethod<COMMAND_RPC_STOP_DAEMON>(&RpcServer::on_stop_daemon), false, false } },
+  { "/getmemoryusage", { jsonMethod<COMMAND_RPC_GET_MEMORY_USAGE>(&RpcServer::on_get_memory_usage), true, false } },
 
   // json rpc
-  { "/json_rpc", std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3) }
+  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), false, false } },
+
+  // Prometheus text exposition of Common::MetricsRegistry::global()
+  { "/metrics", { std::bind(&RpcServer::processMetricsRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), false, false } }
 };
 
-RpcServer::RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, node_server& p2p) :
-  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p) {
+RpcServer::RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, node_server& p2p, size_t threadCount) :
+  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_cache(RESPONSE_CACHE_MAX_AGE, RESPONSE_CACHE_MAX_ENTRIES),
+  m_stateVersion(1), m_stopping(false), m_stateChanged(dispatcher), m_clientRate(0), m_clientBurst(0),
+  m_trafficLog(nullptr) {
+  if (threadCount > 0) {
+    m_workers.reset(new Common::ThreadPool(threadCount));
+  }
+
+  m_core.addObserver(&m_cache);
+  m_core.addObserver(this);
+}
+
+RpcServer::~RpcServer() {
+  m_core.removeObserver(this);
+  m_core.removeObserver(&m_cache);
+}
+
+void RpcServer::stop() {
+  m_stopping = true;
+  m_stateChanged.set();
+  m_stateChanged.clear();
+  HttpServer::stop();
+}
+
+void RpcServer::blockchainUpdated() {
+  m_dispatcher.remoteSpawn(std::bind(&RpcServer::onStateChanged, this));
+}
+
+void RpcServer::poolUpdated() {
+  m_dispatcher.remoteSpawn(std::bind(&RpcServer::onStateChanged, this));
+}
+
+void RpcServer::txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) {
+  m_dispatcher.remoteSpawn(std::bind(&RpcServer::onStateChanged, this));
+}
+
+void RpcServer::onStateChanged() {
+  ++m_stateVersion;
+  m_stateChanged.set();
+  m_stateChanged.clear();
 }
 
 void RpcServer::processRequest(const HttpRequest& request, HttpResponse& response) {
   auto url = request.getUrl();
+  if (m_trafficLog != nullptr) {
+    m_trafficLog->write(Common::TrafficRecord::RPC, 0, 0, request.getPeerAddress(), url, request.getBody());
+  }
   
   auto it = s_handlers.find(url);
   if (it == s_handlers.end()) {
@@ -106,13 +188,131 @@ void RpcServer::processRequest(const HttpRequest& request, HttpResponse& respons
     return;
   }
 
-  if (url != "/json_rpc" && !checkCoreReady()) {
+  if (url != "/json_rpc" && url != "/metrics" && !checkCoreReady()) {
     response.setStatus(HttpResponse::STATUS_500);
     response.setBody("Core is busy");
     return;
   }
 
-  it->second(this, request, response);
+  uint32_t client = request.getPeerAddress();
+  if (!waitForClientBudget(client)) {
+    response.setStatus(HttpResponse::STATUS_429);
+    return;
+  }
+
+  {
+    // only known urls are labels, so requests can't grow the registry
+    Common::MetricTimer timer(Common::MetricsRegistry::global().histogram("rpc_request_duration_microseconds",
+      "Time to process RPC requests by url", { { "url", url } }));
+    processHandler(it->second, request, response);
+  }
+
+  chargeClient(client, CLIENT_REQUEST_COST + response.getBody().size() / CLIENT_RESPONSE_COST_SIZE);
+}
+
+void RpcServer::processHandler(const RpcHandler& handler, const HttpRequest& request, HttpResponse& response) {
+  if (handler.cached) {
+    std::string cacheKey = request.getUrl() + '\n' + request.getBody();
+    std::string body;
+    if (m_cache.find(cacheKey, RpcResponseCache::Clock::now(), body)) {
+      response.setBody(body);
+      return;
+    }
+
+    uint64_t generation = m_cache.getGeneration();
+    if (handler.function(this, request, response)) {
+      m_cache.store(cacheKey, response.getBody(), generation, RpcResponseCache::Clock::now());
+    }
+
+    return;
+  }
+
+  if (m_workers && handler.concurrent) {
+    const HandlerFunction& function = handler.function;
+    processInWorker([this, &function, &request, &response] { function(this, request, response); });
+  } else {
+    handler.function(this, request, response);
+  }
+}
+
+void RpcServer::setClientLimits(uint64_t rate, uint64_t burst) {
+  m_clientRate = rate;
+  m_clientBurst = burst;
+}
+
+void RpcServer::setTrafficLog(Common::TrafficLogWriter* trafficLog) {
+  m_trafficLog = trafficLog;
+}
+
+Common::TokenBucket* RpcServer::getClientBudget(uint32_t client) {
+  if (m_clientRate == 0 || isLocalClient(client)) {
+    return nullptr;
+  }
+
+  auto now = Common::TokenBucket::Clock::now();
+  auto it = m_clientBudgets.find(client);
+  if (it != m_clientBudgets.end()) {
+    return &it->second;
+  }
+
+  if (m_clientBudgets.size() >= CLIENT_BUDGETS_MAX_COUNT) {
+    for (auto budget = m_clientBudgets.begin(); budget != m_clientBudgets.end();) {
+      budget = budget->second.isFull(now) ? m_clientBudgets.erase(budget) : std::next(budget);
+    }
+  }
+
+  return &m_clientBudgets.emplace(client, Common::TokenBucket(m_clientRate, m_clientBurst, now)).first->second;
+}
+
+// Requests of a client wait until the work of its previous ones is paid back, other clients are served meanwhile.
+// Waiting happens in the connection coroutine, so the client doesn't take a worker thread either.
+bool RpcServer::waitForClientBudget(uint32_t client) {
+  Common::TokenBucket* budget = getClientBudget(client);
+  if (budget == nullptr) {
+    return true;
+  }
+
+  auto delay = budget->getDelay(Common::TokenBucket::Clock::now());
+  if (delay > CLIENT_MAX_DELAY) {
+    Common::MetricsRegistry::global().counter("rpc_rejected_requests_total", "RPC requests rejected by per client work limits").increment();
+    return false;
+  }
+
+  if (delay > Common::TokenBucket::Clock::duration::zero()) {
+    Common::MetricsRegistry::global().counter("rpc_throttled_requests_total", "RPC requests delayed by per client work limits").increment();
+    System::Timer(m_dispatcher).sleep(std::chrono::duration_cast<std::chrono::nanoseconds>(delay));
+  }
+
+  return true;
+}
+
+// budget is looked up again, other connections may have pruned the map while this one waited
+void RpcServer::chargeClient(uint32_t client, uint64_t cost) {
+  Common::TokenBucket* budget = getClientBudget(client);
+  if (budget != nullptr) {
+    budget->charge(cost, Common::TokenBucket::Clock::now());
+  }
+}
+
+// connection coroutine waits while other connections are served, request and response aren't touched meanwhile
+void RpcServer::processInWorker(const std::function<void()>& task) {
+  System::Event processed(m_dispatcher);
+  std::exception_ptr error;
+
+  m_workers->addTask([&] {
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    m_dispatcher.remoteSpawn([&processed] { processed.set(); });
+  });
+
+  processed.wait();
+  if (error) {
+    std::rethrow_exception(error);
+  }
 }
 
 bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse& response) {
@@ -121,23 +321,78 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
 
   response.addHeader("Content-Type", "application/json");
 
+  const std::string& body = request.getBody();
+  size_t first = body.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos || body[first] != '[') {
+    response.setBody(processJsonRpcCall(body));
+    return true;
+  }
+
+  // batch, calls are processed in order and their responses are sent back as one array
+  Common::JsonValue calls;
+  try {
+    calls = Common::JsonValue::fromString(body);
+  } catch (std::exception&) {
+    JsonRpcResponse jsonResponse;
+    jsonResponse.setError(JsonRpcError(errParseError));
+    response.setBody(jsonResponse.getBody());
+    return true;
+  }
+
+  if (calls.size() == 0) {
+    JsonRpcResponse jsonResponse;
+    jsonResponse.setError(JsonRpcError(errInvalidRequest));
+    response.setBody(jsonResponse.getBody());
+    return true;
+  }
+
+  std::string responses = "[";
+  for (size_t i = 0; i < calls.size(); ++i) {
+    if (i > 0) {
+      responses += ',';
+    }
+
+    responses += processJsonRpcCall(calls[i].toString());
+  }
+
+  responses += ']';
+  response.setBody(responses);
+  return true;
+}
+
+std::string RpcServer::processJsonRpcCall(const std::string& body) {
+
+  using namespace JsonRpc;
+
   JsonRpcRequest jsonRequest;
   JsonRpcResponse jsonResponse;
 
   try {
 
-    jsonRequest.parseRequest(request.getBody());
+    jsonRequest.parseRequest(body);
     jsonResponse.setId(jsonRequest.getId()); // copy id
 
-    static std::unordered_map<std::string, JsonMemberMethod> jsonRpcHandlers = {
-      { "getblockcount", makeMemberMethod(&RpcServer::on_getblockcount) },
-      { "on_getblockhash", makeMemberMethod(&RpcServer::on_getblockhash) },
-      { "getblocktemplate", makeMemberMethod(&RpcServer::on_getblocktemplate) },
-      { "getcurrencyid", makeMemberMethod(&RpcServer::on_get_currency_id) },
-      { "submitblock", makeMemberMethod(&RpcServer::on_submitblock) },
-      { "getlastblockheader", makeMemberMethod(&RpcServer::on_get_last_block_header) },
-      { "getblockheaderbyhash", makeMemberMethod(&RpcServer::on_get_block_header_by_hash) },
-      { "getblockheaderbyheight", makeMemberMethod(&RpcServer::on_get_block_header_by_height) }
+    struct JsonRpcHandler {
+      JsonMemberMethod method;
+      bool concurrent;
+      bool cached;
+    };
+
+    // template creation and block verification are heavy, they run in worker threads as concurrent handlers above.
+    // getblocktemplate may wait for state changes, so it stays in the network thread and hands template creation over itself
+    static std::unordered_map<std::string, JsonRpcHandler> jsonRpcHandlers = {
+      { "getblockcount", { makeMemberMethod(&RpcServer::on_getblockcount), false, false } },
+      { "on_getblockhash", { makeMemberMethod(&RpcServer::on_getblockhash), false, false } },
+      { "getblocktemplate", { makeMemberMethod(&RpcServer::on_getblocktemplate), false, false } },
+      { "getcurrencyid", { makeMemberMethod(&RpcServer::on_get_currency_id), false, false } },
+      { "submitblock", { makeMemberMethod(&RpcServer::on_submitblock), true, false } },
+      { "getlastblockheader", { makeMemberMethod(&RpcServer::on_get_last_block_header), false, true } },
+      { "getblockheaderbyhash", { makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false, false } },
+      { "getblockheaderbyheight", { makeMemberMethod(&RpcServer::on_get_block_header_by_height), false, true } },
+      { "getblockheadersrange", { makeMemberMethod(&RpcServer::on_get_block_headers_range), true, false } },
+      { "gettransactionbykeyimage", { makeMemberMethod(&RpcServer::on_get_transaction_by_key_image), true, false } },
+      { "gettransactionbyoutputkey", { makeMemberMethod(&RpcServer::on_get_transaction_by_output_key), true, false } },
+      { "gettransactionsbypaymentid", { makeMemberMethod(&RpcServer::on_get_transactions_by_payment_id), true, false } }
     };
 
     auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
@@ -149,43 +404,129 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
       throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
     }
 
-    it->second(this, jsonRequest, jsonResponse);
+    Common::MetricTimer timer(Common::MetricsRegistry::global().histogram("rpc_json_call_duration_microseconds",
+      "Time to process JSON RPC calls by method", { { "method", jsonRequest.getMethod() } }));
+
+    // the whole request body is the key, cached responses carry the matching id
+    if (it->second.cached) {
+      std::string cacheKey = "/json_rpc\n" + body;
+      std::string responseBody;
+      if (m_cache.find(cacheKey, RpcResponseCache::Clock::now(), responseBody)) {
+        return responseBody;
+      }
+
+      uint64_t generation = m_cache.getGeneration();
+      bool result = it->second.method(this, jsonRequest, jsonResponse);
+      responseBody = jsonResponse.getBody();
+      if (result) {
+        m_cache.store(cacheKey, responseBody, generation, RpcResponseCache::Clock::now());
+      }
+
+      return responseBody;
+    }
+
+    const JsonMemberMethod& method = it->second.method;
+    if (m_workers && it->second.concurrent) {
+      processInWorker([this, &method, &jsonRequest, &jsonResponse] { method(this, jsonRequest, jsonResponse); });
+    } else {
+      method(this, jsonRequest, jsonResponse);
+    }
 
   } catch (const JsonRpcError& err) {
     jsonResponse.setError(err);
   }
 
-  response.setBody(jsonResponse.getBody());
-  return true;
+  return jsonResponse.getBody();
 }
 
 #define CHECK_CORE_READY()
 
+// a replica doesn't synchronize itself, it is as current as the node it follows
 bool RpcServer::checkCoreReady() {
-  return m_core.is_ready() && m_p2p.get_payload_object().is_synchronized();
+  return m_core.is_ready() && (m_core.is_replica() || m_p2p.get_payload_object().is_synchronized());
 }
 
 //
 // Binary handlers
 //
 
-bool RpcServer::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res) {
-  
-  std::list<std::pair<Block, std::list<Transaction>>> bs;
-  if (!m_core.find_blockchain_supplement(req.block_ids, bs, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT)) {
-    res.status = "Failed";
+// COMMAND_RPC_GET_BLOCKS_FAST response is written by the encoder itself, this way blocks are sent as they are loaded
+// and only a batch of them is kept in memory. Block ids are taken at once, a block which leaves the main chain
+// meanwhile breaks the response off.
+bool RpcServer::processMetricsRequest(const HttpRequest& request, HttpResponse& response) {
+  // gauges of state kept elsewhere are sampled on scrape
+  Common::MetricsRegistry& metrics = Common::MetricsRegistry::global();
+  metrics.gauge("blockchain_height", "Number of blocks in the main chain").set(m_core.get_current_blockchain_height());
+  metrics.gauge("tx_pool_size", "Number of transactions in the pool").set(m_core.get_pool_transactions_count());
+  metrics.gauge("dispatcher_queue_depth", "Procedures waiting to be spawned by the network thread").set(m_dispatcher.getRemoteSpawnQueueSize());
+  SwappedVectorCacheStatistics blocksCache = m_core.get_blocks_cache_statistics();
+  metrics.gauge("blocks_cache_size", "Number of blocks in the blocks cache").set(blocksCache.size);
+  metrics.gauge("blocks_cache_capacity", "Most blocks the blocks cache keeps").set(blocksCache.capacity);
+
+  response.addHeader("Content-Type", "text/plain; version=0.0.4");
+  response.setBody(metrics.format());
+  return true;
+}
+
+bool RpcServer::processGetBlocksRequest(const HttpRequest& request, HttpResponse& response) {
+  boost::value_initialized<COMMAND_RPC_GET_BLOCKS_FAST::request> req;
+  if (!epee::serialization::load_t_from_binary(static_cast<COMMAND_RPC_GET_BLOCKS_FAST::request&>(req), request.getBody())) {
     return false;
   }
 
-  for (auto& b : bs) {
-    res.blocks.resize(res.blocks.size() + 1);
-    res.blocks.back().block = block_to_blob(b.first);
-    for (auto& t : b.second) {
-      res.blocks.back().txs.push_back(tx_to_blob(t));
-    }
+  auto blockIds = std::make_shared<std::vector<crypto::hash>>();
+  uint64_t currentHeight;
+  uint64_t startHeight;
+  if (!m_core.get_blockchain_storage().find_blockchain_supplement(static_cast<COMMAND_RPC_GET_BLOCKS_FAST::request&>(req).block_ids, *blockIds,
+    currentHeight, startHeight, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT)) {
+    boost::value_initialized<COMMAND_RPC_GET_BLOCKS_FAST::response> res;
+    static_cast<COMMAND_RPC_GET_BLOCKS_FAST::response&>(res).status = "Failed";
+    response.setBody(epee::serialization::store_t_to_binary(res.data()));
+    return false;
   }
 
-  res.status = CORE_RPC_STATUS_OK;
+  response.setBodyProducer([this, blockIds, currentHeight, startHeight](const HttpResponse::ChunkWriter& write) {
+    std::string chunk;
+    KvBinaryWriter writer(chunk);
+    // empty arrays aren't stored at all
+    writer.beginRoot(blockIds->empty() ? 3 : 4);
+    writer.writeUint64("current_height", currentHeight);
+    writer.writeUint64("start_height", startHeight);
+    writer.writeString("status", CORE_RPC_STATUS_OK);
+    if (!blockIds->empty()) {
+      writer.beginObjectArray("blocks", blockIds->size());
+    }
+
+    for (size_t first = 0; first < blockIds->size(); first += GET_BLOCKS_BATCH_SIZE) {
+      std::vector<crypto::hash> batch(blockIds->begin() + first, blockIds->begin() + std::min(first + GET_BLOCKS_BATCH_SIZE, blockIds->size()));
+      std::list<block_complete_entry> blocks;
+      auto load = [this, &batch, &blocks] {
+        if (!m_core.get_blockchain_storage().get_serialized_blocks(batch, blocks)) {
+          throw std::runtime_error("Blockchain has changed while blocks were sent");
+        }
+      };
+
+      if (m_workers) {
+        processInWorker(load);
+      } else {
+        load();
+      }
+
+      for (const block_complete_entry& block : blocks) {
+        writer.beginSection(block.txs.empty() ? 1 : 2);
+        writer.writeString("block", block.block);
+        if (!block.txs.empty()) {
+          writer.writeStringArray("txs", block.txs);
+        }
+      }
+
+      write(chunk);
+      chunk.clear();
+    }
+
+    write(chunk);
+  });
+
   return true;
 }
 
@@ -201,6 +542,41 @@ bool RpcServer::on_query_blocks(const COMMAND_RPC_QUERY_BLOCKS::request& req, CO
   return true;
 }
 
+bool RpcServer::on_query_blocks_filtered(const COMMAND_RPC_QUERY_BLOCKS_FILTERED::request& req, COMMAND_RPC_QUERY_BLOCKS_FILTERED::response& res) {
+  CHECK_CORE_READY();
+
+  if (!m_core.queryBlocksFiltered(req.block_ids, req.timestamp, req.tracking_keys, req.key_images, res.start_height, res.current_height,
+    res.full_offset, res.items)) {
+    res.status = "Failed to perform query";
+    return false;
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
+bool RpcServer::on_get_pool_changes(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& res) {
+  CHECK_CORE_READY();
+
+  std::vector<Transaction> addedTransactions;
+  bool isTailBlockActual = false;
+  bool isVersionActual = false;
+  if (!m_core.getPoolChanges(req.known_version, req.tail_block_id, isTailBlockActual, isVersionActual, addedTransactions,
+    res.deleted_txs_ids, res.version)) {
+    res.status = "Failed to get pool changes";
+    return false;
+  }
+
+  res.is_tail_block_actual = isTailBlockActual;
+  res.is_version_actual = isVersionActual;
+  for (const Transaction& transaction : addedTransactions) {
+    res.added_txs.push_back(tx_to_blob(transaction));
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
 bool RpcServer::on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res) {
   CHECK_CORE_READY();
 
@@ -214,6 +590,100 @@ bool RpcServer::on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::
   return true;
 }
 
+bool RpcServer::on_get_txs_indexes(const COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES::response& res) {
+  CHECK_CORE_READY();
+
+  if (req.txids.size() > COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES_MAX_COUNT) {
+    res.status = "Too many transactions requested";
+    return true;
+  }
+
+  res.txs.resize(req.txids.size());
+  for (size_t i = 0; i < req.txids.size(); ++i) {
+    if (!m_core.get_tx_outputs_gindexs(req.txids[i], res.txs[i].o_indexes)) {
+      res.txs.clear();
+      res.status = "Failed";
+      return true;
+    }
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  logger(TRACE) << "COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES: [" << res.txs.size() << "]";
+  return true;
+}
+
+bool RpcServer::on_get_block_headers_range_bin(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_BIN::request& req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_BIN::response& res) {
+  size_t count = static_cast<size_t>(std::min<uint64_t>(req.count, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_MAX_COUNT));
+  if (!m_core.get_blockchain_storage().get_block_short_headers(req.start_height, count, res.headers)) {
+    res.status = "Failed";
+    return false;
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
+bool RpcServer::on_get_block_filters(const COMMAND_RPC_GET_BLOCK_FILTERS::request& req, COMMAND_RPC_GET_BLOCK_FILTERS::response& res) {
+  size_t count = static_cast<size_t>(std::min<uint64_t>(req.count, COMMAND_RPC_GET_BLOCK_FILTERS_MAX_COUNT));
+  if (!m_core.get_blockchain_storage().get_block_filters(req.start_height, count, res.filters)) {
+    res.status = "Failed";
+    return false;
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
+// runs in the connection coroutine, other connections are served while it waits
+void RpcServer::waitStateChange(uint64_t knownVersion, std::chrono::milliseconds timeout) {
+  if (knownVersion != m_stateVersion || m_stopping) {
+    return;
+  }
+
+  bool timedOut = false;
+  System::Timer timer(m_dispatcher);
+  System::Event timerStopped(m_dispatcher);
+  m_dispatcher.spawn([&] {
+    try {
+      timer.sleep(timeout);
+      timedOut = true;
+      m_stateChanged.set();
+      m_stateChanged.clear();
+    } catch (System::InterruptedException&) {
+    }
+
+    timerStopped.set();
+  });
+
+  while (knownVersion == m_stateVersion && !timedOut && !m_stopping) {
+    m_stateChanged.wait();
+  }
+
+  timer.stop();
+  timerStopped.wait();
+}
+
+bool RpcServer::on_wait_state_change(const COMMAND_RPC_WAIT_STATE_CHANGE::request& req, COMMAND_RPC_WAIT_STATE_CHANGE::response& res) {
+  waitStateChange(req.known_version, std::chrono::milliseconds(std::min(req.timeout, WAIT_STATE_CHANGE_MAX_TIMEOUT)));
+
+  if (!m_core.get_blockchain_top(res.height, res.top_block_hash)) {
+    res.status = "Failed";
+    return false;
+  }
+
+  Block topBlock;
+  if (m_core.get_block_by_hash(res.top_block_hash, topBlock)) {
+    res.top_block_timestamp = topBlock.timestamp;
+  }
+
+  uint64_t totalConnections = m_p2p.get_connections_count();
+  res.outgoing_connections_count = m_p2p.get_outgoing_connections_count();
+  res.incoming_connections_count = totalConnections - res.outgoing_connections_count;
+  res.version = m_stateVersion;
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
 bool RpcServer::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
   CHECK_CORE_READY();
   res.status = "Failed";
@@ -305,6 +775,10 @@ bool RpcServer::on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::request&
 
 bool RpcServer::on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request& req, COMMAND_RPC_SEND_RAW_TX::response& res) {
   CHECK_CORE_READY();
+  if (m_core.is_replica()) {
+    res.status = "Failed, node is a read-only replica";
+    return true;
+  }
 
   std::string tx_blob;
   if (!hexToBlob(req.tx_as_hex, tx_blob))
@@ -347,6 +821,10 @@ bool RpcServer::on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request& req, COMM
 
 bool RpcServer::on_start_mining(const COMMAND_RPC_START_MINING::request& req, COMMAND_RPC_START_MINING::response& res) {
   CHECK_CORE_READY();
+  if (m_core.is_replica()) {
+    res.status = "Failed, node is a read-only replica";
+    return true;
+  }
   AccountPublicAddress adr;
   if (!m_core.currency().parseAccountAddressString(req.miner_address, adr)) {
     res.status = "Failed, wrong address";
@@ -387,6 +865,24 @@ bool RpcServer::on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMM
   return true;
 }
 
+bool RpcServer::on_get_memory_usage(const COMMAND_RPC_GET_MEMORY_USAGE::request& req, COMMAND_RPC_GET_MEMORY_USAGE::response& res) {
+  Common::MemoryBudget& memoryBudget = m_core.get_memory_budget();
+  res.budget = memoryBudget.getBudget();
+  res.usage = 0;
+  for (const Common::MemoryBudget::ConsumerUsage& consumer : memoryBudget.getUsage()) {
+    memory_consumer_entry entry;
+    entry.name = consumer.name;
+    entry.weight = consumer.weight;
+    entry.usage = consumer.usage;
+    entry.limit = consumer.limit;
+    res.consumers.push_back(entry);
+    res.usage += consumer.usage;
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------
 // JSON RPC methods
 //------------------------------------------------------------------------------------------------------------------------------
@@ -430,7 +926,13 @@ namespace {
   }
 }
 
+// Runs in the network thread, templates are made by workers. Long poll waits for state changes, every change makes
+// a new template, which core serves from its cache to other pollers until blockchain or pool changes again.
 bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request& req, COMMAND_RPC_GETBLOCKTEMPLATE::response& res) {
+  if (m_core.is_replica()) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_READ_ONLY, "Node is a read-only replica" };
+  }
+
   if (req.reserve_size > TX_EXTRA_NONCE_MAX_COUNT) {
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_TOO_BIG_RESERVE_SIZE, "To big reserved size, maximum 255" };
   }
@@ -441,10 +943,33 @@ bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request&
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_WALLET_ADDRESS, "Failed to parse wallet address" };
   }
 
+  uint64_t timeout = req.timeout == 0 ? WAIT_STATE_CHANGE_MAX_TIMEOUT : std::min(req.timeout, WAIT_STATE_CHANGE_MAX_TIMEOUT);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  for (;;) {
+    // version is taken before the template, a change made meanwhile ends the wait below at once
+    uint64_t version = m_stateVersion;
+    if (m_workers) {
+      processInWorker([&] { makeBlockTemplate(acc, static_cast<size_t>(req.reserve_size), res); });
+    } else {
+      makeBlockTemplate(acc, static_cast<size_t>(req.reserve_size), res);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (req.template_id.empty() || req.template_id != res.template_id || m_stopping || now >= deadline) {
+      break;
+    }
+
+    waitStateChange(version, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now));
+  }
+
+  return true;
+}
+
+void RpcServer::makeBlockTemplate(const AccountPublicAddress& address, size_t reserveSize, COMMAND_RPC_GETBLOCKTEMPLATE::response& res) {
   Block b = AUTO_VAL_INIT(b);
   CryptoNote::blobdata blob_reserve;
-  blob_reserve.resize(req.reserve_size, 0);
-  if (!m_core.get_block_template(b, acc, res.difficulty, res.height, blob_reserve)) {
+  blob_reserve.resize(reserveSize, 0);
+  if (!m_core.get_block_template(b, address, res.difficulty, res.height, blob_reserve)) {
     logger(ERROR) << "Failed to create block template";
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INTERNAL_ERROR, "Internal error: failed to create block template" };
   }
@@ -456,14 +981,14 @@ bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request&
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INTERNAL_ERROR, "Internal error: failed to find tx pub key in coinbase extra" };
   }
 
-  if (0 < req.reserve_size) {
+  if (0 < reserveSize) {
     res.reserved_offset = slow_memmem((void*)block_blob.data(), block_blob.size(), &tx_pub_key, sizeof(tx_pub_key));
     if (!res.reserved_offset) {
       logger(ERROR) << "Failed to find tx pub key in blockblob";
       throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INTERNAL_ERROR, "Internal error: failed to create block template" };
     }
     res.reserved_offset += sizeof(tx_pub_key) + 3; //3 bytes: tag for TX_EXTRA_TAG_PUBKEY(1 byte), tag for TX_EXTRA_NONCE(1 byte), counter in TX_EXTRA_NONCE(1 byte)
-    if (res.reserved_offset + req.reserve_size > block_blob.size()) {
+    if (res.reserved_offset + reserveSize > block_blob.size()) {
       logger(ERROR) << "Failed to calculate offset for reserved bytes";
       throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INTERNAL_ERROR, "Internal error: failed to create block template" };
     }
@@ -471,10 +996,15 @@ bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request&
     res.reserved_offset = 0;
   }
 
+  // parent block and transactions identify the work, timestamp and miner transaction keys change with every call
+  std::string templateData(reinterpret_cast<const char*>(&b.prevId), sizeof(b.prevId));
+  for (const crypto::hash& transactionHash : b.txHashes) {
+    templateData.append(reinterpret_cast<const char*>(&transactionHash), sizeof(transactionHash));
+  }
+
+  res.template_id = Common::podToHex(crypto::cn_fast_hash(templateData.data(), templateData.size()));
   res.blocktemplate_blob = blobToHex(block_blob);
   res.status = CORE_RPC_STATUS_OK;
-
-  return true;
 }
 
 bool RpcServer::on_get_currency_id(const COMMAND_RPC_GET_CURRENCY_ID::request& /*req*/, COMMAND_RPC_GET_CURRENCY_ID::response& res) {
@@ -485,6 +1015,10 @@ bool RpcServer::on_get_currency_id(const COMMAND_RPC_GET_CURRENCY_ID::request& /
 }
 
 bool RpcServer::on_submitblock(const COMMAND_RPC_SUBMITBLOCK::request& req, COMMAND_RPC_SUBMITBLOCK::response& res) {
+  if (m_core.is_replica()) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_READ_ONLY, "Node is a read-only replica" };
+  }
+
   if (req.size() != 1) {
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_PARAM, "Wrong param" };
   }
@@ -495,15 +1029,7 @@ bool RpcServer::on_submitblock(const COMMAND_RPC_SUBMITBLOCK::request& req, COMM
   }
 
   CryptoNote::block_verification_context bvc = AUTO_VAL_INIT(bvc);
-
-  System::Event event(m_dispatcher);
-  auto resultFuture = std::async(std::launch::async, [this, &event, &bvc, &blockblob]{
-    m_core.handle_incoming_block_blob(blockblob, bvc, true, true);
-    m_dispatcher.remoteSpawn([&event]() { event.set(); });
-  });
-
-  event.wait();
-  resultFuture.get();
+  m_core.handle_incoming_block_blob(blockblob, bvc, true, true);
 
   if (!bvc.m_added_to_main_chain) {
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_BLOCK_NOT_ACCEPTED, "Block not accepted" };
@@ -602,5 +1128,102 @@ bool RpcServer::on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_HEADER
   return true;
 }
 
+bool RpcServer::on_get_block_headers_range(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request& req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response& res) {
+  std::list<block_short_header> headers;
+  size_t count = static_cast<size_t>(std::min<uint64_t>(req.count, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_MAX_COUNT));
+  if (!m_core.get_blockchain_storage().get_block_short_headers(req.start_height, count, headers)) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_TOO_BIG_HEIGHT,
+      std::string("To big height: ") + std::to_string(req.start_height) + ", current blockchain height = " + std::to_string(m_core.get_current_blockchain_height()) };
+  }
+
+  for (const block_short_header& header : headers) {
+    block_short_header_responce responce;
+    responce.hash = Common::podToHex(header.hash);
+    responce.height = header.height;
+    responce.timestamp = header.timestamp;
+    responce.difficulty = header.difficulty;
+    responce.size = header.size;
+    responce.reward = header.reward;
+    responce.tx_count = header.tx_count;
+    res.headers.push_back(responce);
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
+namespace {
+
+void checkExplorerIndexes(blockchain_storage& storage) {
+  if (!storage.has_explorer_indexes()) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INDEX_DISABLED, "Explorer indexes are disabled, start the daemon with --explorer-indexes" };
+  }
+}
+
+explorer_transaction_responce makeExplorerTransactionResponce(const blockchain_storage::ExplorerTransaction& transaction) {
+  explorer_transaction_responce responce;
+  responce.hash = Common::podToHex(transaction.hash);
+  responce.height = transaction.height;
+  return responce;
+}
+
+}
+
+bool RpcServer::on_get_transaction_by_key_image(const COMMAND_RPC_GET_TRANSACTION_BY_KEY_IMAGE::request& req, COMMAND_RPC_GET_TRANSACTION_BY_KEY_IMAGE::response& res) {
+  blockchain_storage& storage = m_core.get_blockchain_storage();
+  checkExplorerIndexes(storage);
+  crypto::key_image keyImage;
+  if (!Common::podFromHex(req.key_image, keyImage)) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_PARAM, "Failed to parse hex representation of key image. Hex = " + req.key_image + '.' };
+  }
+
+  blockchain_storage::ExplorerTransaction transaction;
+  if (!storage.getTransactionByKeyImage(keyImage, transaction)) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_NOT_FOUND, "Key image is not spent in the main chain" };
+  }
+
+  res.transaction = makeExplorerTransactionResponce(transaction);
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
+bool RpcServer::on_get_transaction_by_output_key(const COMMAND_RPC_GET_TRANSACTION_BY_OUTPUT_KEY::request& req, COMMAND_RPC_GET_TRANSACTION_BY_OUTPUT_KEY::response& res) {
+  blockchain_storage& storage = m_core.get_blockchain_storage();
+  checkExplorerIndexes(storage);
+  crypto::public_key key;
+  if (!Common::podFromHex(req.key, key)) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_PARAM, "Failed to parse hex representation of output key. Hex = " + req.key + '.' };
+  }
+
+  blockchain_storage::ExplorerTransaction transaction;
+  if (!storage.getTransactionByOutputKey(key, transaction)) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_NOT_FOUND, "Output key is not found in the main chain" };
+  }
+
+  res.transaction = makeExplorerTransactionResponce(transaction);
+  res.output_index = transaction.outputIndex;
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
+bool RpcServer::on_get_transactions_by_payment_id(const COMMAND_RPC_GET_TRANSACTIONS_BY_PAYMENT_ID::request& req, COMMAND_RPC_GET_TRANSACTIONS_BY_PAYMENT_ID::response& res) {
+  blockchain_storage& storage = m_core.get_blockchain_storage();
+  checkExplorerIndexes(storage);
+  crypto::hash paymentId;
+  if (!parse_hash256(req.payment_id, paymentId)) {
+    throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_PARAM, "Failed to parse hex representation of payment id. Hex = " + req.payment_id + '.' };
+  }
+
+  // no transactions with the payment id is an empty list
+  std::vector<blockchain_storage::ExplorerTransaction> transactions;
+  storage.getTransactionsByPaymentId(paymentId, transactions);
+  for (const blockchain_storage::ExplorerTransaction& transaction : transactions) {
+    res.transactions.push_back(makeExplorerTransactionResponce(transaction));
+  }
+
+  res.status = CORE_RPC_STATUS_OK;
+  return true;
+}
+
 
 }
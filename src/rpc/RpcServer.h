@@ -17,37 +17,85 @@
 
 #include "HttpServer.h"
 
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
+#include <Common/ThreadPool.h>
+#include <Common/TokenBucket.h>
+#include <Common/TrafficLog.h>
+#include <System/Event.h>
+
 #include <Logging/LoggerRef.h>
+#include "cryptonote_core/ICoreObserver.h"
 #include "core_rpc_server_commands_defs.h"
+#include "RpcResponseCache.h"
 
 namespace CryptoNote {
 
 class core;
 class node_server;
 
-class RpcServer : public HttpServer {
+class RpcServer : public HttpServer, private ICoreObserver {
 public:
-  RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, node_server& p2p);
+  // Requests to handlers using only core are processed by threadCount worker threads, they run concurrently with
+  // the network thread and each other. Handlers touching p2p state always run in the network thread.
+  RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, node_server& p2p, size_t threadCount = 0);
+  ~RpcServer();
+
+  // Long polls waiting for state changes are answered before connections are closed
+  virtual void stop() override;
+  // Work units per second and at once a remote client may spend, a unit is a request or a kilobyte of response.
+  // Requests over the limit wait, ones that would wait too long are answered with 429. 0 rate disables the limit,
+  // local clients are never limited.
+  void setClientLimits(uint64_t rate, uint64_t burst);
+  // Requests are appended to the log for replay, null stops recording
+  void setTrafficLog(Common::TrafficLogWriter* trafficLog);
 
   typedef std::function<bool(RpcServer*, const HttpRequest& request, HttpResponse& response)> HandlerFunction;
 
+  struct RpcHandler {
+    HandlerFunction function;
+    bool concurrent;
+    bool cached;
+  };
+
 private:
 
   typedef void (RpcServer::*HandlerPtr)(const HttpRequest& request, HttpResponse& response);
-  static std::unordered_map<std::string, HandlerFunction> s_handlers;
+  static std::unordered_map<std::string, RpcHandler> s_handlers;
 
   virtual void processRequest(const HttpRequest& request, HttpResponse& response) override;
+  void processHandler(const RpcHandler& handler, const HttpRequest& request, HttpResponse& response);
+  void processInWorker(const std::function<void()>& task);
   bool processJsonRpcRequest(const HttpRequest& request, HttpResponse& response);
+  bool processGetBlocksRequest(const HttpRequest& request, HttpResponse& response);
+  bool processMetricsRequest(const HttpRequest& request, HttpResponse& response);
+  std::string processJsonRpcCall(const std::string& body);
   bool checkCoreReady();
+  Common::TokenBucket* getClientBudget(uint32_t client);
+  bool waitForClientBudget(uint32_t client);
+  void chargeClient(uint32_t client, uint64_t cost);
+
+  // ICoreObserver, called from core threads
+  virtual void blockchainUpdated() override;
+  virtual void poolUpdated() override;
+  virtual void txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) override;
+  void onStateChanged();
+  // Returns when the state version differs from knownVersion, the timeout passes or the server stops, dispatcher thread only
+  void waitStateChange(uint64_t knownVersion, std::chrono::milliseconds timeout);
 
   // binary handlers
-  bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res);
   bool on_query_blocks(const COMMAND_RPC_QUERY_BLOCKS::request& req, COMMAND_RPC_QUERY_BLOCKS::response& res);
+  bool on_get_pool_changes(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& res);
+  bool on_query_blocks_filtered(const COMMAND_RPC_QUERY_BLOCKS_FILTERED::request& req, COMMAND_RPC_QUERY_BLOCKS_FILTERED::response& res);
   bool on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res);
+  bool on_get_txs_indexes(const COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES::response& res);
   bool on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
+  bool on_get_block_headers_range_bin(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_BIN::request& req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_BIN::response& res);
+  bool on_get_block_filters(const COMMAND_RPC_GET_BLOCK_FILTERS::request& req, COMMAND_RPC_GET_BLOCK_FILTERS::response& res);
+  bool on_wait_state_change(const COMMAND_RPC_WAIT_STATE_CHANGE::request& req, COMMAND_RPC_WAIT_STATE_CHANGE::response& res);
 
   // json handlers
   bool on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res);
@@ -57,22 +105,41 @@ private:
   bool on_start_mining(const COMMAND_RPC_START_MINING::request& req, COMMAND_RPC_START_MINING::response& res);
   bool on_stop_mining(const COMMAND_RPC_STOP_MINING::request& req, COMMAND_RPC_STOP_MINING::response& res);
   bool on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res);
+  bool on_get_memory_usage(const COMMAND_RPC_GET_MEMORY_USAGE::request& req, COMMAND_RPC_GET_MEMORY_USAGE::response& res);
 
   // json rpc
   bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request& req, COMMAND_RPC_GETBLOCKCOUNT::response& res);
   bool on_getblockhash(const COMMAND_RPC_GETBLOCKHASH::request& req, COMMAND_RPC_GETBLOCKHASH::response& res);
   bool on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request& req, COMMAND_RPC_GETBLOCKTEMPLATE::response& res);
+  void makeBlockTemplate(const AccountPublicAddress& address, size_t reserveSize, COMMAND_RPC_GETBLOCKTEMPLATE::response& res);
   bool on_get_currency_id(const COMMAND_RPC_GET_CURRENCY_ID::request& req, COMMAND_RPC_GET_CURRENCY_ID::response& res);
   bool on_submitblock(const COMMAND_RPC_SUBMITBLOCK::request& req, COMMAND_RPC_SUBMITBLOCK::response& res);
   bool on_get_last_block_header(const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res);
   bool on_get_block_header_by_hash(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::response& res);
   bool on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res);
+  bool on_get_block_headers_range(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request& req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response& res);
+  bool on_get_transaction_by_key_image(const COMMAND_RPC_GET_TRANSACTION_BY_KEY_IMAGE::request& req, COMMAND_RPC_GET_TRANSACTION_BY_KEY_IMAGE::response& res);
+  bool on_get_transaction_by_output_key(const COMMAND_RPC_GET_TRANSACTION_BY_OUTPUT_KEY::request& req, COMMAND_RPC_GET_TRANSACTION_BY_OUTPUT_KEY::response& res);
+  bool on_get_transactions_by_payment_id(const COMMAND_RPC_GET_TRANSACTIONS_BY_PAYMENT_ID::request& req, COMMAND_RPC_GET_TRANSACTIONS_BY_PAYMENT_ID::response& res);
 
   void fill_block_header_responce(const Block& blk, bool orphan_status, uint64_t height, const crypto::hash& hash, block_header_responce& responce);
 
   Logging::LoggerRef logger;
   core& m_core;
   node_server& m_p2p;
+  std::unique_ptr<Common::ThreadPool> m_workers;
+  RpcResponseCache m_cache;
+  // by client address, touched in the dispatcher thread only
+  std::unordered_map<uint32_t, Common::TokenBucket> m_clientBudgets;
+  uint64_t m_clientRate;
+  uint64_t m_clientBurst;
+  Common::TrafficLogWriter* m_trafficLog;
+
+  // long poll state, touched in the dispatcher thread only. m_stateChanged is set and cleared right away,
+  // waiters wake up and check the version themselves
+  uint64_t m_stateVersion;
+  bool m_stopping;
+  System::Event m_stateChanged;
 };
 
 }
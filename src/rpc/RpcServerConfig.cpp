@@ -16,7 +16,11 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "RpcServerConfig.h"
+
+#include <thread>
+
 #include "Common/command_line.h"
+#include "System/UnixAddress.h"
 #include "cryptonote_config.h"
 
 namespace CryptoNote {
@@ -25,27 +29,58 @@ namespace CryptoNote {
 
     const std::string DEFAULT_RPC_IP = "127.0.0.1";
     const uint16_t DEFAULT_RPC_PORT = RPC_DEFAULT_PORT;
+    const uint32_t DEFAULT_RPC_MAX_CONNECTIONS = 256;
+    const uint32_t DEFAULT_RPC_IDLE_TIMEOUT = 60;
+    const uint64_t DEFAULT_RPC_CLIENT_RATE = 4096;
+    const uint64_t DEFAULT_RPC_CLIENT_BURST = 32768;
 
-    const command_line::arg_descriptor<std::string> arg_rpc_bind_ip = { "rpc-bind-ip", "", DEFAULT_RPC_IP };
+    const command_line::arg_descriptor<std::string> arg_rpc_bind_ip = { "rpc-bind-ip",
+      "IP address to listen on for RPC, or unix:<path> for a Unix domain socket", DEFAULT_RPC_IP };
     const command_line::arg_descriptor<uint16_t> arg_rpc_bind_port = { "rpc-bind-port", "", DEFAULT_RPC_PORT };
+    const command_line::arg_descriptor<uint32_t> arg_rpc_threads = { "rpc-threads",
+      "Number of threads processing RPC requests, 0 processes them in the network thread", std::thread::hardware_concurrency() };
+    const command_line::arg_descriptor<uint32_t> arg_rpc_max_connections = { "rpc-max-connections",
+      "Maximum number of open RPC connections, further ones are answered with 503, 0 is unlimited", DEFAULT_RPC_MAX_CONNECTIONS };
+    const command_line::arg_descriptor<uint32_t> arg_rpc_idle_timeout = { "rpc-idle-timeout",
+      "Seconds an RPC connection may wait for the next request before it is closed, 0 disables the timeout", DEFAULT_RPC_IDLE_TIMEOUT };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_client_rate = { "rpc-client-rate",
+      "Work units per second a remote RPC client may spend, a unit is one request or 1 KB of response, 0 is unlimited", DEFAULT_RPC_CLIENT_RATE };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_client_burst = { "rpc-client-burst",
+      "Work units a remote RPC client may spend at once before its requests are delayed", DEFAULT_RPC_CLIENT_BURST };
   }
 
 
-  RpcServerConfig::RpcServerConfig() : bindIp(DEFAULT_RPC_IP), bindPort(DEFAULT_RPC_PORT) {
+  RpcServerConfig::RpcServerConfig() : bindIp(DEFAULT_RPC_IP), bindPort(DEFAULT_RPC_PORT), threadCount(std::thread::hardware_concurrency()),
+    maxConnections(DEFAULT_RPC_MAX_CONNECTIONS), idleTimeout(DEFAULT_RPC_IDLE_TIMEOUT),
+    clientRate(DEFAULT_RPC_CLIENT_RATE), clientBurst(DEFAULT_RPC_CLIENT_BURST) {
   }
 
   std::string RpcServerConfig::getBindAddress() const {
+    if (System::isUnixAddress(bindIp)) {
+      return bindIp;
+    }
+
     return bindIp + ":" + std::to_string(bindPort);
   }
   
   void RpcServerConfig::initOptions(boost::program_options::options_description& desc) {
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
+    command_line::add_arg(desc, arg_rpc_threads);
+    command_line::add_arg(desc, arg_rpc_max_connections);
+    command_line::add_arg(desc, arg_rpc_idle_timeout);
+    command_line::add_arg(desc, arg_rpc_client_rate);
+    command_line::add_arg(desc, arg_rpc_client_burst);
   }
 
   void RpcServerConfig::init(const boost::program_options::variables_map& vm)  {
     bindIp = command_line::get_arg(vm, arg_rpc_bind_ip);
     bindPort = command_line::get_arg(vm, arg_rpc_bind_port);
+    threadCount = command_line::get_arg(vm, arg_rpc_threads);
+    maxConnections = command_line::get_arg(vm, arg_rpc_max_connections);
+    idleTimeout = command_line::get_arg(vm, arg_rpc_idle_timeout);
+    clientRate = command_line::get_arg(vm, arg_rpc_client_rate);
+    clientBurst = command_line::get_arg(vm, arg_rpc_client_burst);
   }
 
 }
@@ -33,6 +33,15 @@ public:
 
   std::string bindIp;
   uint16_t bindPort;
+  // threads processing requests which don't need the network thread, 0 processes all of them in it
+  size_t threadCount;
+  // 0 disables the limit
+  size_t maxConnections;
+  // seconds a connection may wait for its next request, 0 keeps idle connections forever
+  uint32_t idleTimeout;
+  // work units per second and at once of a remote client, 0 rate disables the limit
+  uint64_t clientRate;
+  uint64_t clientBurst;
 };
 
 }
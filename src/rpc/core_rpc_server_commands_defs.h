@@ -123,6 +123,37 @@ namespace CryptoNote
       END_KV_SERIALIZE_MAP()
     };
   };
+
+  //-----------------------------------------------
+  struct COMMAND_RPC_GET_TXS_GLOBAL_OUTPUTS_INDEXES
+  {
+    struct request
+    {
+      std::vector<crypto::hash> txids;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txids)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct tx_indexes
+    {
+      std::vector<uint64_t> o_indexes;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(o_indexes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    // indexes go in the order of requested transactions
+    struct response
+    {
+      std::vector<tx_indexes> txs;
+      std::string status;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(txs)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
   //-----------------------------------------------
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request
   {
@@ -257,6 +288,80 @@ namespace CryptoNote
     };
   };
 
+  //-----------------------------------------------
+  // Long poll, the response is sent as soon as the blockchain or the pool changes after known_version
+  // or when timeout milliseconds pass. Versions are daemon's counters, clients pass back the last one received.
+  struct COMMAND_RPC_WAIT_STATE_CHANGE
+  {
+    struct request
+    {
+      uint64_t known_version;
+      uint64_t timeout;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(known_version)
+        KV_SERIALIZE(timeout)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      uint64_t version;
+      uint64_t height;
+      crypto::hash top_block_hash;
+      uint64_t top_block_timestamp;
+      uint64_t outgoing_connections_count;
+      uint64_t incoming_connections_count;
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(top_block_hash)
+        KV_SERIALIZE(top_block_timestamp)
+        KV_SERIALIZE(outgoing_connections_count)
+        KV_SERIALIZE(incoming_connections_count)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  // Transactions added to the pool and removed from it since known_version, the version comes from a previous response.
+  // If is_version_actual is false, changes since known_version are not kept anymore and the pool has to be requested
+  // from scratch with known_version 0.
+  struct COMMAND_RPC_GET_POOL_CHANGES
+  {
+    struct request
+    {
+      uint64_t known_version;
+      crypto::hash tail_block_id;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(known_version)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(tail_block_id)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      bool is_tail_block_actual;
+      bool is_version_actual;
+      uint64_t version;
+      std::vector<blobdata> added_txs;
+      std::vector<crypto::hash> deleted_txs_ids;
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(is_tail_block_actual)
+        KV_SERIALIZE(is_version_actual)
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(added_txs)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(deleted_txs_ids)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
     
   //-----------------------------------------------
   struct COMMAND_RPC_STOP_MINING
@@ -298,6 +403,45 @@ namespace CryptoNote
   };
 
 
+  //-----------------------------------------------
+  struct memory_consumer_entry {
+    std::string name;
+    uint32_t weight;
+    // bytes as of the last budget update, limit is 0 if none
+    uint64_t usage;
+    uint64_t limit;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(weight)
+      KV_SERIALIZE(usage)
+      KV_SERIALIZE(limit)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_GET_MEMORY_USAGE {
+    struct request {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response {
+      // 0 if no budget is set
+      uint64_t budget;
+      uint64_t usage;
+      std::vector<memory_consumer_entry> consumers;
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(budget)
+        KV_SERIALIZE(usage)
+        KV_SERIALIZE(consumers)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+
   //
   struct COMMAND_RPC_GETBLOCKCOUNT
   {
@@ -324,16 +468,22 @@ namespace CryptoNote
   };
 
 
+  // With template_id of the previous response the call is a long poll, it is answered when the template would get
+  // another parent block or transactions, or when timeout milliseconds pass
   struct COMMAND_RPC_GETBLOCKTEMPLATE
   {
     struct request
     {
       uint64_t reserve_size;       //max 255 bytes
       std::string wallet_address;
+      std::string template_id;
+      uint64_t timeout = 0;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(reserve_size)
         KV_SERIALIZE(wallet_address)
+        KV_SERIALIZE(template_id)
+        KV_SERIALIZE(timeout)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -343,6 +493,7 @@ namespace CryptoNote
       uint32_t height;
       uint64_t reserved_offset;
       blobdata blocktemplate_blob;
+      std::string template_id;
       std::string status;
 
       BEGIN_KV_SERIALIZE_MAP()
@@ -350,6 +501,7 @@ namespace CryptoNote
         KV_SERIALIZE(height)
         KV_SERIALIZE(reserved_offset)
         KV_SERIALIZE(blocktemplate_blob)
+        KV_SERIALIZE(template_id)
         KV_SERIALIZE(status)
       END_KV_SERIALIZE_MAP()
     };
@@ -485,6 +637,192 @@ namespace CryptoNote
 
   };
 
+  // compact header of a main chain block, the transactions count doesn't include the coinbase one
+  struct block_short_header
+  {
+    crypto::hash hash;
+    uint64_t height;
+    uint64_t timestamp;
+    difficulty_type difficulty;
+    uint64_t size;
+    uint64_t reward;
+    uint64_t tx_count;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_VAL_POD_AS_BLOB(hash)
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(timestamp)
+      KV_SERIALIZE(difficulty)
+      KV_SERIALIZE(size)
+      KV_SERIALIZE(reward)
+      KV_SERIALIZE(tx_count)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct block_short_header_responce
+  {
+    std::string hash;
+    uint64_t height;
+    uint64_t timestamp;
+    difficulty_type difficulty;
+    uint64_t size;
+    uint64_t reward;
+    uint64_t tx_count;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(hash)
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(timestamp)
+      KV_SERIALIZE(difficulty)
+      KV_SERIALIZE(size)
+      KV_SERIALIZE(reward)
+      KV_SERIALIZE(tx_count)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // headers of at most count blocks from start_height, the response is shorter at the end of the chain
+  struct COMMAND_RPC_GET_BLOCK_HEADERS_RANGE
+  {
+    struct request
+    {
+      uint64_t start_height;
+      uint64_t count;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(count)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      std::list<block_short_header_responce> headers;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(headers)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct explorer_transaction_responce
+  {
+    std::string hash;
+    uint64_t height;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(hash)
+      KV_SERIALIZE(height)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // Explorer lookups are served only by a daemon started with --explorer-indexes
+  struct COMMAND_RPC_GET_TRANSACTION_BY_KEY_IMAGE
+  {
+    struct request
+    {
+      std::string key_image;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(key_image)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      explorer_transaction_responce transaction;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(transaction)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_GET_TRANSACTION_BY_OUTPUT_KEY
+  {
+    struct request
+    {
+      std::string key;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(key)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      explorer_transaction_responce transaction;
+      uint64_t output_index;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(transaction)
+        KV_SERIALIZE(output_index)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_GET_TRANSACTIONS_BY_PAYMENT_ID
+  {
+    struct request
+    {
+      std::string payment_id;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(payment_id)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      // in chain order
+      std::list<explorer_transaction_responce> transactions;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(transactions)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_BIN
+  {
+    typedef COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request request;
+
+    struct response
+    {
+      std::string status;
+      std::list<block_short_header> headers;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(headers)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  // BlockFilter of key images spent in each of at most count blocks from start_height
+  struct COMMAND_RPC_GET_BLOCK_FILTERS
+  {
+    typedef COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request request;
+
+    struct response
+    {
+      std::string status;
+      std::list<std::string> filters;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(filters)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_QUERY_BLOCKS
   {
     struct request
@@ -516,4 +854,26 @@ namespace CryptoNote
       END_KV_SERIALIZE_MAP()
     };
   };
+
+  // Tracking keys of the addresses are given to the daemon, it has to be trusted
+  struct COMMAND_RPC_QUERY_BLOCKS_FILTERED
+  {
+    struct request
+    {
+      std::list<crypto::hash> block_ids;
+      uint64_t timestamp;
+      std::vector<TrackingKey> tracking_keys;
+      // unspent key images of the addresses, transactions spending them are returned
+      std::vector<crypto::key_image> key_images;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
+        KV_SERIALIZE(timestamp)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(tracking_keys)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    typedef COMMAND_RPC_QUERY_BLOCKS::response response;
+  };
 }
@@ -26,3 +26,6 @@
 #define CORE_RPC_ERROR_CODE_WRONG_BLOCKBLOB       -6
 #define CORE_RPC_ERROR_CODE_BLOCK_NOT_ACCEPTED    -7
 #define CORE_RPC_ERROR_CODE_CORE_BUSY             -9
+#define CORE_RPC_ERROR_CODE_NOT_FOUND             -10
+#define CORE_RPC_ERROR_CODE_INDEX_DISABLED        -11
+#define CORE_RPC_ERROR_CODE_READ_ONLY             -12
@@ -17,6 +17,8 @@
 
 #include "BinaryInputStreamSerializer.h"
 #include "SerializationOverloads.h"
+#include "Common/MemoryStreambuf.h"
+#include "Common/varint.h"
 
 #include <algorithm>
 #include <cassert>
@@ -26,7 +28,15 @@ namespace {
 
 template<typename T, int bits = std::numeric_limits<T>::digits>
 typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, size_t>::type
-readVarint(std::istream& s, T &i) {
+readVarint(std::istream& s, Common::MemoryStreambuf* memory, T &i) {
+  if (memory != nullptr) {
+    size_t size = tools::read_varint_buffer<bits>(memory->position(), memory->end(), i);
+    if (size != 0) {
+      memory->skip(size);
+      return size;
+    }
+  }
+
   size_t read = 0;
   i = 0;
   for (int shift = 0;; shift += 7) {
@@ -53,9 +63,9 @@ readVarint(std::istream& s, T &i) {
 }
 
 template<typename StorageType, typename T>
-void readVarintAs(std::istream& s, T &i) {
+void readVarintAs(std::istream& s, Common::MemoryStreambuf* memory, T &i) {
   StorageType v;
-  readVarint(s, v);
+  readVarint(s, memory, v);
   i = static_cast<T>(v);
 }
 
@@ -64,6 +74,10 @@ void readVarintAs(std::istream& s, T &i) {
 
 namespace CryptoNote {
 
+BinaryInputStreamSerializer::BinaryInputStreamSerializer(std::istream& strm) :
+  stream(strm), memory(dynamic_cast<Common::MemoryStreambuf*>(strm.rdbuf())) {
+}
+
 ISerializer::SerializerType BinaryInputStreamSerializer::type() const {
   return ISerializer::INPUT;
 }
@@ -77,7 +91,7 @@ ISerializer& BinaryInputStreamSerializer::endObject() {
 }
 
 ISerializer& BinaryInputStreamSerializer::beginArray(std::size_t& size, const std::string& name) {
-  readVarintAs<uint64_t>(stream, size);
+  readVarintAs<uint64_t>(stream, memory, size);
   return *this;
 }
 
@@ -86,27 +100,27 @@ ISerializer& BinaryInputStreamSerializer::endArray() {
 }
 
 ISerializer& BinaryInputStreamSerializer::operator()(uint8_t& value, const std::string& name) {
-  readVarint(stream, value);
+  readVarint(stream, memory, value);
   return *this;
 }
 
 ISerializer& BinaryInputStreamSerializer::operator()(uint32_t& value, const std::string& name) {
-  readVarint(stream, value);
+  readVarint(stream, memory, value);
   return *this;
 }
 
 ISerializer& BinaryInputStreamSerializer::operator()(int32_t& value, const std::string& name) {
-  readVarintAs<uint32_t>(stream, value);
+  readVarintAs<uint32_t>(stream, memory, value);
   return *this;
 }
 
 ISerializer& BinaryInputStreamSerializer::operator()(int64_t& value, const std::string& name) {
-  readVarintAs<uint64_t>(stream, value);
+  readVarintAs<uint64_t>(stream, memory, value);
   return *this;
 }
 
 ISerializer& BinaryInputStreamSerializer::operator()(uint64_t& value, const std::string& name) {
-  readVarint(stream, value);
+  readVarint(stream, memory, value);
   return *this;
 }
 
@@ -117,7 +131,7 @@ ISerializer& BinaryInputStreamSerializer::operator()(bool& value, const std::str
 
 ISerializer& BinaryInputStreamSerializer::operator()(std::string& value, const std::string& name) {
   uint64_t size;
-  readVarint(stream, size);
+  readVarint(stream, memory, size);
 
   if (size > 0) {
     std::vector<char> temp;
@@ -22,11 +22,15 @@
 
 #include <istream>
 
+namespace Common {
+class MemoryStreambuf;
+}
+
 namespace CryptoNote {
 
 class BinaryInputStreamSerializer : public ISerializer {
 public:
-  BinaryInputStreamSerializer(std::istream& strm) : stream(strm) {}
+  BinaryInputStreamSerializer(std::istream& strm);
   virtual ~BinaryInputStreamSerializer() {}
 
   virtual ISerializer::SerializerType type() const;
@@ -62,6 +66,8 @@ private:
   void checkedRead(char* buf, size_t size);
 
   std::istream& stream;
+  // set when the stream reads a memory block, varints are decoded from it in place then
+  Common::MemoryStreambuf* memory;
 };
 
 }
@@ -0,0 +1,72 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BinaryInputStreamSerializer.h"
+#include "BinaryOutputStreamSerializer.h"
+
+namespace CryptoNote {
+
+// Buffer of file streams, large enough for the stream to hit disk with few big writes and reads
+const size_t BINARY_FILE_BUFFER_SIZE = 1024 * 1024;
+
+template<class T>
+bool storeToBinaryFile(T& object, const std::string& fileName) {
+  try {
+    std::vector<char> buffer(BINARY_FILE_BUFFER_SIZE);
+    std::ofstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(fileName, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    if (file.fail()) {
+      return false;
+    }
+
+    BinaryOutputStreamSerializer serializer(file);
+    serializer(object, "");
+    file.flush();
+    return !file.fail();
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
+template<class T>
+bool loadFromBinaryFile(T& object, const std::string& fileName) {
+  try {
+    std::vector<char> buffer(BINARY_FILE_BUFFER_SIZE);
+    std::ifstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(fileName, std::ios_base::binary | std::ios_base::in);
+    if (file.fail()) {
+      return false;
+    }
+
+    BinaryInputStreamSerializer serializer(file);
+    serializer(object, "");
+    return !file.fail();
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
+}
@@ -17,17 +17,558 @@
 
 #include "serialization/JsonInputStreamSerializer.h"
 
-#include <ctype.h>
-#include <exception>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <Common/StringTools.h>
 
 namespace CryptoNote {
 
-JsonInputStreamSerializer::JsonInputStreamSerializer(std::istream& stream) {
-  stream >> root;
-  JsonInputValueSerializer::setJsonValue(&root);
+namespace {
+
+// nesting deeper than this is rejected, skipping values recurses into nested objects and arrays
+const size_t MAX_NESTING_LEVEL = 100;
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+void appendUtf8(uint32_t codePoint, std::string& value) {
+  if (codePoint < 0x80) {
+    value += static_cast<char>(codePoint);
+  } else if (codePoint < 0x800) {
+    value += static_cast<char>(0xc0 | (codePoint >> 6));
+    value += static_cast<char>(0x80 | (codePoint & 0x3f));
+  } else if (codePoint < 0x10000) {
+    value += static_cast<char>(0xe0 | (codePoint >> 12));
+    value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+    value += static_cast<char>(0x80 | (codePoint & 0x3f));
+  } else {
+    value += static_cast<char>(0xf0 | (codePoint >> 18));
+    value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+    value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+    value += static_cast<char>(0x80 | (codePoint & 0x3f));
+  }
+}
+
+}
+
+JsonInputStreamSerializer::JsonInputStreamSerializer(std::istream& stream) : depth(0) {
+  text.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+  size_t offset = skipSpaces(0);
+  if (at(offset) != '{') {
+    throw std::runtime_error("JSON root is not an object");
+  }
+
+  openObject(pushFrame(), offset);
+  depth = 0;
 }
 
 JsonInputStreamSerializer::~JsonInputStreamSerializer() {
 }
 
+ISerializer::SerializerType JsonInputStreamSerializer::type() const {
+  return ISerializer::INPUT;
+}
+
+ISerializer& JsonInputStreamSerializer::beginObject(const std::string& name) {
+  assert(!frames.empty());
+
+  if (depth == 0) {
+    depth = 1;
+    return *this;
+  }
+
+  size_t offset = takeValue(name);
+  if (text[offset] != '{') {
+    throw std::runtime_error("Value is not an object: " + name);
+  }
+
+  openObject(pushFrame(), offset);
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::endObject() {
+  assert(depth > 0);
+  --depth;
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::beginArray(std::size_t& size, const std::string& name) {
+  assert(depth > 0);
+
+  size_t offset;
+  if (frames[depth - 1].array) {
+    offset = takeValue(name);
+  } else if (!findMember(name, offset)) {
+    Frame& frame = pushFrame();
+    frame.array = true;
+    frame.remaining = 0;
+    size = 0;
+    return *this;
+  }
+
+  if (text[offset] != '[') {
+    throw std::runtime_error("Value is not an array: " + name);
+  }
+
+  size = openArray(pushFrame(), offset);
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::endArray() {
+  assert(depth > 0);
+  --depth;
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(uint8_t& value, const std::string& name) {
+  value = static_cast<uint8_t>(readInteger(takeValue(name)));
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(int32_t& value, const std::string& name) {
+  value = static_cast<int32_t>(readInteger(takeValue(name)));
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(uint32_t& value, const std::string& name) {
+  value = static_cast<uint32_t>(readInteger(takeValue(name)));
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(int64_t& value, const std::string& name) {
+  value = readInteger(takeValue(name));
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(uint64_t& value, const std::string& name) {
+  value = static_cast<uint64_t>(readInteger(takeValue(name)));
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(double& value, const std::string& name) {
+  value = readReal(takeValue(name));
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(bool& value, const std::string& name) {
+  size_t offset = takeValue(name);
+  if (text.compare(offset, 4, "true") == 0) {
+    value = true;
+  } else if (text.compare(offset, 5, "false") == 0) {
+    value = false;
+  } else {
+    throw std::runtime_error("Value is not a bool: " + name);
+  }
+
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::operator()(std::string& value, const std::string& name) {
+  readString(takeValue(name), value);
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::binary(void* value, std::size_t size, const std::string& name) {
+  std::string str;
+  readString(takeValue(name), str);
+  Common::fromHex(str, value, size);
+  return *this;
+}
+
+ISerializer& JsonInputStreamSerializer::binary(std::string& value, const std::string& name) {
+  std::string str;
+  readString(takeValue(name), str);
+  value = Common::asString(Common::fromHex(str));
+  return *this;
+}
+
+bool JsonInputStreamSerializer::hasObject(const std::string& name) {
+  assert(!frames.empty());
+
+  const Frame& frame = frames[depth == 0 ? 0 : depth - 1];
+  if (frame.array) {
+    return frame.remaining != 0;
+  }
+
+  size_t offset;
+  return findMember(name, offset);
+}
+
+JsonInputStreamSerializer::Frame& JsonInputStreamSerializer::pushFrame() {
+  if (depth == MAX_NESTING_LEVEL) {
+    throw std::runtime_error("JSON is nested too deep");
+  }
+
+  if (frames.size() == depth) {
+    frames.emplace_back();
+  }
+
+  return frames[depth++];
+}
+
+// offset points to the opening brace, members are validated while they are indexed
+void JsonInputStreamSerializer::openObject(Frame& frame, size_t offset) {
+  frame.array = false;
+  frame.members.clear();
+  offset = skipSpaces(offset + 1);
+  if (at(offset) == '}') {
+    return;
+  }
+
+  for (;;) {
+    if (at(offset) != '"') {
+      throw std::runtime_error("JSON member name expected");
+    }
+
+    Member member;
+    member.nameOffset = offset + 1;
+    offset = skipString(offset);
+    member.nameSize = offset - 1 - member.nameOffset;
+    offset = skipSpaces(offset);
+    if (at(offset) != ':') {
+      throw std::runtime_error("JSON member has no value");
+    }
+
+    member.valueOffset = skipSpaces(offset + 1);
+    offset = skipSpaces(skipValue(member.valueOffset, depth));
+    frame.members.push_back(member);
+
+    char c = at(offset);
+    if (c == '}') {
+      return;
+    }
+
+    if (c != ',') {
+      throw std::runtime_error("JSON object is malformed");
+    }
+
+    offset = skipSpaces(offset + 1);
+  }
+}
+
+// offset points to the opening bracket, returns count of items
+size_t JsonInputStreamSerializer::openArray(Frame& frame, size_t offset) {
+  frame.array = true;
+  frame.position = skipSpaces(offset + 1);
+  frame.remaining = 0;
+  if (at(frame.position) == ']') {
+    return 0;
+  }
+
+  offset = frame.position;
+  for (;;) {
+    offset = skipSpaces(skipValue(offset, depth));
+    ++frame.remaining;
+
+    char c = at(offset);
+    if (c == ']') {
+      return frame.remaining;
+    }
+
+    if (c != ',') {
+      throw std::runtime_error("JSON array is malformed");
+    }
+
+    offset = skipSpaces(offset + 1);
+  }
+}
+
+bool JsonInputStreamSerializer::findMember(const std::string& name, size_t& offset) const {
+  const Frame& frame = frames[depth == 0 ? 0 : depth - 1];
+  for (const Member& member : frame.members) {
+    if (member.nameSize == name.size() && text.compare(member.nameOffset, member.nameSize, name) == 0) {
+      offset = member.valueOffset;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// returns offset of the first character of the value, inside arrays the name is ignored and the next item is taken
+size_t JsonInputStreamSerializer::takeValue(const std::string& name) {
+  assert(depth > 0);
+
+  Frame& frame = frames[depth - 1];
+  if (!frame.array) {
+    size_t offset;
+    if (!findMember(name, offset)) {
+      throw std::runtime_error("Value is not found: " + name);
+    }
+
+    return offset;
+  }
+
+  if (frame.remaining == 0) {
+    throw std::runtime_error("Array has no more items");
+  }
+
+  // the array has been validated when it was opened
+  size_t offset = frame.position;
+  frame.position = skipSpaces(skipValue(offset, depth));
+  if (text[frame.position] == ',') {
+    frame.position = skipSpaces(frame.position + 1);
+  }
+
+  --frame.remaining;
+  return offset;
+}
+
+int64_t JsonInputStreamSerializer::readInteger(size_t offset) const {
+  size_t end = skipNumber(offset);
+  bool negative = text[offset] == '-';
+  size_t first = negative ? offset + 1 : offset;
+  if (first == end || !isDigit(text[first])) {
+    throw std::runtime_error("Value is not an integer");
+  }
+
+  uint64_t limit = negative ? uint64_t(std::numeric_limits<int64_t>::max()) + 1 : std::numeric_limits<int64_t>::max();
+  uint64_t value = 0;
+  size_t i = first;
+  for (; i < end && isDigit(text[i]); ++i) {
+    uint64_t digit = text[i] - '0';
+    if (value > (limit - digit) / 10) {
+      throw std::runtime_error("Integer value is out of range");
+    }
+
+    value = value * 10 + digit;
+  }
+
+  if (i != end) {
+    throw std::runtime_error("Value is not an integer");
+  }
+
+  if (i - first > 1 && text[first] == '0') {
+    throw std::runtime_error("Integer has leading zero");
+  }
+
+  // negating in unsigned arithmetic keeps the minimal value representable
+  return negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+}
+
+// integers are accepted as well, JSON writers drop the fraction of whole numbers
+double JsonInputStreamSerializer::readReal(size_t offset) const {
+  size_t end = skipNumber(offset);
+  if (end == offset) {
+    throw std::runtime_error("Value is not a number");
+  }
+
+  double value;
+  std::istringstream stream(text.substr(offset, end - offset));
+  if (!(stream >> value)) {
+    throw std::runtime_error("Value is not a number");
+  }
+
+  return value;
+}
+
+void JsonInputStreamSerializer::readString(size_t offset, std::string& value) const {
+  if (text[offset] != '"') {
+    throw std::runtime_error("Value is not a string");
+  }
+
+  size_t end = skipString(offset) - 1;
+  value.clear();
+  size_t run = offset + 1;
+  for (size_t i = run; i < end; ++i) {
+    if (text[i] != '\\') {
+      continue;
+    }
+
+    value.append(text, run, i - run);
+    ++i;
+    switch (text[i]) {
+    case 'b': value += '\b'; break;
+    case 'f': value += '\f'; break;
+    case 'n': value += '\n'; break;
+    case 'r': value += '\r'; break;
+    case 't': value += '\t'; break;
+    case 'u': {
+      uint32_t codePoint = readCodeUnit(i + 1, end);
+      i += 4;
+      if (codePoint >= 0xd800 && codePoint < 0xdc00 && i + 6 < end && text[i + 1] == '\\' && text[i + 2] == 'u') {
+        uint32_t low = readCodeUnit(i + 3, end);
+        if (low >= 0xdc00 && low < 0xe000) {
+          codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+          i += 6;
+        }
+      }
+
+      appendUtf8(codePoint, value);
+      break;
+    }
+
+    default:
+      // quote, backslash and slash stand for themselves
+      value += text[i];
+      break;
+    }
+
+    run = i + 1;
+  }
+
+  value.append(text, run, end - run);
+}
+
+uint32_t JsonInputStreamSerializer::readCodeUnit(size_t offset, size_t end) const {
+  if (end - offset < 4) {
+    throw std::runtime_error("JSON string has malformed escape sequence");
+  }
+
+  uint32_t codeUnit = 0;
+  for (size_t i = offset; i < offset + 4; ++i) {
+    uint8_t digit;
+    if (!Common::fromHex(text[i], digit)) {
+      throw std::runtime_error("JSON string has malformed escape sequence");
+    }
+
+    codeUnit = codeUnit * 16 + digit;
+  }
+
+  return codeUnit;
+}
+
+// returns offset right after the value
+size_t JsonInputStreamSerializer::skipValue(size_t offset, size_t level) const {
+  if (level >= MAX_NESTING_LEVEL) {
+    throw std::runtime_error("JSON is nested too deep");
+  }
+
+  char c = at(offset);
+  if (c == '"') {
+    return skipString(offset);
+  }
+
+  if (c == '{' || c == '[') {
+    char close = c == '{' ? '}' : ']';
+    offset = skipSpaces(offset + 1);
+    if (at(offset) == close) {
+      return offset + 1;
+    }
+
+    for (;;) {
+      if (c == '{') {
+        if (at(offset) != '"') {
+          throw std::runtime_error("JSON member name expected");
+        }
+
+        offset = skipSpaces(skipString(offset));
+        if (at(offset) != ':') {
+          throw std::runtime_error("JSON member has no value");
+        }
+
+        offset = skipSpaces(offset + 1);
+      }
+
+      offset = skipSpaces(skipValue(offset, level + 1));
+      char next = at(offset);
+      if (next == close) {
+        return offset + 1;
+      }
+
+      if (next != ',') {
+        throw std::runtime_error("JSON is malformed");
+      }
+
+      offset = skipSpaces(offset + 1);
+    }
+  }
+
+  const char* literals[] = { "true", "false", "null" };
+  for (const char* literal : literals) {
+    size_t size = strlen(literal);
+    if (text.compare(offset, size, literal) == 0) {
+      return offset + size;
+    }
+  }
+
+  size_t end = skipNumber(offset);
+  if (end == offset) {
+    throw std::runtime_error("JSON value expected");
+  }
+
+  return end;
+}
+
+// offset points to the opening quote, returns offset right after the closing one
+size_t JsonInputStreamSerializer::skipString(size_t offset) const {
+  for (++offset;; ++offset) {
+    char c = at(offset);
+    if (c == '"') {
+      return offset + 1;
+    }
+
+    if (c == '\\') {
+      ++offset;
+    }
+  }
+}
+
+// returns offset right after the number, or the same offset if there is no number there
+size_t JsonInputStreamSerializer::skipNumber(size_t offset) const {
+  size_t i = offset;
+  if (i < text.size() && text[i] == '-') {
+    ++i;
+  }
+
+  size_t digits = i;
+  while (i < text.size() && isDigit(text[i])) {
+    ++i;
+  }
+
+  if (i == digits) {
+    return offset;
+  }
+
+  if (i < text.size() && text[i] == '.') {
+    size_t fraction = ++i;
+    while (i < text.size() && isDigit(text[i])) {
+      ++i;
+    }
+
+    if (i == fraction) {
+      throw std::runtime_error("JSON number is malformed");
+    }
+  }
+
+  if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+    ++i;
+    if (i < text.size() && (text[i] == '+' || text[i] == '-')) {
+      ++i;
+    }
+
+    size_t exponent = i;
+    while (i < text.size() && isDigit(text[i])) {
+      ++i;
+    }
+
+    if (i == exponent) {
+      throw std::runtime_error("JSON number is malformed");
+    }
+  }
+
+  return i;
+}
+
+size_t JsonInputStreamSerializer::skipSpaces(size_t offset) const {
+  while (offset < text.size() && (text[offset] == ' ' || text[offset] == '\t' || text[offset] == '\n' || text[offset] == '\r')) {
+    ++offset;
+  }
+
+  return offset;
+}
+
+char JsonInputStreamSerializer::at(size_t offset) const {
+  if (offset >= text.size()) {
+    throw std::runtime_error("JSON is truncated");
+  }
+
+  return text[offset];
+}
+
 } //namespace CryptoNote
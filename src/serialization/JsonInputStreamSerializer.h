@@ -17,22 +17,84 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 #include <vector>
-#include "../Common/JsonValue.h"
-#include "JsonInputValueSerializer.h"
+#include "ISerializer.h"
 
 namespace CryptoNote {
 
-//deserialization
-class JsonInputStreamSerializer : public JsonInputValueSerializer {
+// Reads JSON straight from its text. Members of an opened object are indexed by their offsets, values are parsed
+// only when they are asked for, so no JsonValue tree of the whole document is built. Escape sequences of strings
+// are decoded, unicode escapes to UTF-8. Malformed JSON is reported as std::runtime_error.
+class JsonInputStreamSerializer : public ISerializer {
 public:
   JsonInputStreamSerializer(std::istream& stream);
   virtual ~JsonInputStreamSerializer();
 
+  virtual SerializerType type() const override;
+
+  virtual ISerializer& beginObject(const std::string& name) override;
+  virtual ISerializer& endObject() override;
+
+  virtual ISerializer& beginArray(std::size_t& size, const std::string& name) override;
+  virtual ISerializer& endArray() override;
+
+  virtual ISerializer& operator()(uint8_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(int32_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(uint32_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(int64_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(uint64_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(double& value, const std::string& name) override;
+  virtual ISerializer& operator()(bool& value, const std::string& name) override;
+  virtual ISerializer& operator()(std::string& value, const std::string& name) override;
+
+  virtual ISerializer& binary(void* value, std::size_t size, const std::string& name) override;
+  virtual ISerializer& binary(std::string& value, const std::string& name) override;
+
+  virtual bool hasObject(const std::string& name) override;
+
+  template<typename T>
+  ISerializer& operator()(T& value, const std::string& name) {
+    return ISerializer::operator()(value, name);
+  }
+
 private:
-  Common::JsonValue root;
+  // name offset points right after the opening quote, value offset points to the first character of the value
+  struct Member {
+    size_t nameOffset;
+    size_t nameSize;
+    size_t valueOffset;
+  };
+
+  // object frames hold members of the object, array frames read items one after another
+  struct Frame {
+    bool array;
+    std::vector<Member> members;
+    size_t remaining;
+    size_t position;
+  };
+
+  Frame& pushFrame();
+  void openObject(Frame& frame, size_t offset);
+  size_t openArray(Frame& frame, size_t offset);
+  bool findMember(const std::string& name, size_t& offset) const;
+  size_t takeValue(const std::string& name);
+  int64_t readInteger(size_t offset) const;
+  double readReal(size_t offset) const;
+  void readString(size_t offset, std::string& value) const;
+  uint32_t readCodeUnit(size_t offset, size_t end) const;
+  size_t skipValue(size_t offset, size_t level) const;
+  size_t skipString(size_t offset) const;
+  size_t skipNumber(size_t offset) const;
+  size_t skipSpaces(size_t offset) const;
+  char at(size_t offset) const;
+
+  std::string text;
+  // the root object is the first frame, it is opened by the constructor. Frames aren't removed when they are closed, their member vectors are reused by next objects
+  std::vector<Frame> frames;
+  size_t depth;
 };
 
 }
@@ -16,28 +16,24 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "JsonOutputStreamSerializer.h"
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <stdexcept>
-#include "Common/StringTools.h"
+#include "Common/StreamTools.h"
 
-using Common::JsonValue;
 using namespace CryptoNote;
 
-namespace CryptoNote {
-std::ostream& operator<<(std::ostream& out, const JsonOutputStreamSerializer& enumerator) {
-  out << enumerator.root;
-  return out;
-}
-}
+namespace {
+
+const char HEX_DIGITS[] = "0123456789abcdef";
 
-JsonOutputStreamSerializer::JsonOutputStreamSerializer() : root(JsonValue::OBJECT) {
 }
 
-JsonOutputStreamSerializer::~JsonOutputStreamSerializer() {
+JsonOutputStreamSerializer::JsonOutputStreamSerializer(Common::IOutputStream& stream) : stream(stream) {
 }
 
-JsonValue JsonOutputStreamSerializer::getJsonValue() const {
-  return root;
+JsonOutputStreamSerializer::~JsonOutputStreamSerializer() {
 }
 
 ISerializer::SerializerType JsonOutputStreamSerializer::type() const {
@@ -45,39 +41,33 @@ ISerializer::SerializerType JsonOutputStreamSerializer::type() const {
 }
 
 ISerializer& JsonOutputStreamSerializer::beginObject(const std::string& name) {
-  if (chain.size() == 0) {
-    chain.push_back(&root);
-    return *this;
-  }
-
-  JsonValue* parent = chain.back();
-  JsonValue obj(JsonValue::OBJECT);
-
-  if (parent->isObject()) {
-    JsonValue& res = parent->insert(name, obj);
-    chain.push_back(&res);
-  } else {
-    JsonValue& res = parent->pushBack(obj);
-    chain.push_back(&res);
+  if (!levels.empty()) {
+    beginValue(name);
   }
 
+  write('{');
+  levels.push_back(Level{ false, true });
   return *this;
 }
 
 ISerializer& JsonOutputStreamSerializer::endObject() {
-  chain.pop_back();
+  assert(!levels.empty() && !levels.back().array);
+  levels.pop_back();
+  write('}');
   return *this;
 }
 
 ISerializer& JsonOutputStreamSerializer::beginArray(std::size_t& size, const std::string& name) {
-  JsonValue val(JsonValue::ARRAY);
-  JsonValue& res = chain.back()->insert(name, val);
-  chain.push_back(&res);
+  beginValue(name);
+  write('[');
+  levels.push_back(Level{ true, true });
   return *this;
 }
 
 ISerializer& JsonOutputStreamSerializer::endArray() {
-  chain.pop_back();
+  assert(!levels.empty() && levels.back().array);
+  levels.pop_back();
+  write(']');
   return *this;
 }
 
@@ -97,40 +87,31 @@ ISerializer& JsonOutputStreamSerializer::operator()(int32_t& value, const std::s
 }
 
 ISerializer& JsonOutputStreamSerializer::operator()(int64_t& value, const std::string& name) {
-  JsonValue* val = chain.back();
-  JsonValue v;
-  v = static_cast<int64_t>(value);
-  if (val->isArray()) {
-    val->pushBack(v);
-  } else {
-    val->insert(name, v);
-  }
+  beginValue(name);
+  writeInteger(value);
   return *this;
 }
 
+// same text as JsonValue writes, fixed notation with trailing zeros of the fraction dropped
 ISerializer& JsonOutputStreamSerializer::operator()(double& value, const std::string& name) {
-  JsonValue* val = chain.back();
-  JsonValue v;
-  v = static_cast<double>(value);
+  beginValue(name);
+  char buffer[400];
+  int size = snprintf(buffer, sizeof(buffer), "%.11f", value);
+  if (size < 0 || static_cast<std::size_t>(size) >= sizeof(buffer)) {
+    throw std::runtime_error("Unable to format real value");
+  }
 
-  if (val->isArray()) {
-    val->pushBack(v);
-  } else {
-    val->insert(name, v);
+  while (size > 1 && buffer[size - 2] != '.' && buffer[size - 1] == '0') {
+    --size;
   }
+
+  write(buffer, size);
   return *this;
 }
 
 ISerializer& JsonOutputStreamSerializer::operator()(std::string& value, const std::string& name) {
-  JsonValue* val = chain.back();
-  JsonValue v;
-  v = value;
-
-  if (val->isArray()) {
-    val->pushBack(v);
-  } else {
-    val->insert(name, v);
-  }
+  beginValue(name);
+  writeString(value.data(), value.size());
   return *this;
 }
 
@@ -140,19 +121,36 @@ ISerializer& JsonOutputStreamSerializer::operator()(uint8_t& value, const std::s
 }
 
 ISerializer& JsonOutputStreamSerializer::operator()(bool& value, const std::string& name) {
-  JsonValue* val = chain.back();
-  if (val->isArray()) {
-    val->pushBack(JsonValue(value));
+  beginValue(name);
+  if (value) {
+    write("true", 4);
   } else {
-    val->insert(name, JsonValue(value));
+    write("false", 5);
   }
 
   return *this;
 }
 
 ISerializer& JsonOutputStreamSerializer::binary(void* value, std::size_t size, const std::string& name) {
-  auto hex = Common::toHex(value, size);
-  return (*this)(hex, name);
+  beginValue(name);
+  write('"');
+
+  const uint8_t* data = static_cast<const uint8_t*>(value);
+  char buffer[128];
+  while (size > 0) {
+    std::size_t chunk = std::min(size, sizeof(buffer) / 2);
+    for (std::size_t i = 0; i < chunk; ++i) {
+      buffer[2 * i] = HEX_DIGITS[data[i] >> 4];
+      buffer[2 * i + 1] = HEX_DIGITS[data[i] & 15];
+    }
+
+    write(buffer, 2 * chunk);
+    data += chunk;
+    size -= chunk;
+  }
+
+  write('"');
+  return *this;
 }
 
 ISerializer& JsonOutputStreamSerializer::binary(std::string& value, const std::string& name) {
@@ -165,3 +163,87 @@ bool JsonOutputStreamSerializer::hasObject(const std::string& name) {
 
   return false;
 }
+
+// writes the separator and, inside objects, the member name
+void JsonOutputStreamSerializer::beginValue(const std::string& name) {
+  assert(!levels.empty());
+
+  Level& level = levels.back();
+  if (!level.empty) {
+    write(',');
+  }
+
+  level.empty = false;
+  if (!level.array) {
+    writeString(name.data(), name.size());
+    write(':');
+  }
+}
+
+void JsonOutputStreamSerializer::writeInteger(int64_t value) {
+  char buffer[20];
+  char* end = buffer + sizeof(buffer);
+  char* begin = end;
+  // unsigned arithmetic keeps the minimal value representable
+  uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+  do {
+    *--begin = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+
+  if (value < 0) {
+    *--begin = '-';
+  }
+
+  write(begin, end - begin);
+}
+
+// runs of characters which need no escaping are written at once
+void JsonOutputStreamSerializer::writeString(const char* data, std::size_t size) {
+  write('"');
+  std::size_t run = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    unsigned char c = static_cast<unsigned char>(data[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    write(data + run, i - run);
+    run = i + 1;
+
+    char escape[6] = { '\\', 0, 0, 0, 0, 0 };
+    std::size_t escapeSize = 2;
+    switch (c) {
+    case '"':  escape[1] = '"'; break;
+    case '\\': escape[1] = '\\'; break;
+    case '\b': escape[1] = 'b'; break;
+    case '\f': escape[1] = 'f'; break;
+    case '\n': escape[1] = 'n'; break;
+    case '\r': escape[1] = 'r'; break;
+    case '\t': escape[1] = 't'; break;
+    default:
+      escape[1] = 'u';
+      escape[2] = '0';
+      escape[3] = '0';
+      escape[4] = HEX_DIGITS[c >> 4];
+      escape[5] = HEX_DIGITS[c & 15];
+      escapeSize = 6;
+      break;
+    }
+
+    write(escape, escapeSize);
+  }
+
+  write(data + run, size - run);
+  write('"');
+}
+
+void JsonOutputStreamSerializer::write(const char* data, std::size_t size) {
+  if (size != 0) {
+    Common::write(stream, data, size);
+  }
+}
+
+void JsonOutputStreamSerializer::write(char c) {
+  Common::write(stream, &c, 1);
+}
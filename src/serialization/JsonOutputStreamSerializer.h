@@ -17,18 +17,20 @@
 
 #pragma once
 
-#include <iostream>
-#include "../Common/JsonValue.h"
+#include <string>
+#include <vector>
+#include "Common/IOutputStream.h"
 #include "ISerializer.h"
 
 namespace CryptoNote {
 
+// Writes JSON text straight to the stream while values are serialized, no JsonValue tree is built. Strings are
+// escaped, integers are written like JsonValue writes them, unsigned ones above INT64_MAX come out negative.
 class JsonOutputStreamSerializer : public ISerializer {
 public:
-  JsonOutputStreamSerializer();
+  JsonOutputStreamSerializer(Common::IOutputStream& stream);
   virtual ~JsonOutputStreamSerializer();
 
-  Common::JsonValue getJsonValue() const;
   SerializerType type() const;
 
   virtual ISerializer& beginObject(const std::string& name) override;
@@ -56,11 +58,21 @@ public:
     return ISerializer::operator()(value, name);
   }
 
-  friend std::ostream& operator<<(std::ostream& out, const JsonOutputStreamSerializer& enumerator);
-
 private:
-  Common::JsonValue root;
-  std::vector<Common::JsonValue*> chain;
+  struct Level {
+    bool array;
+    bool empty;
+  };
+
+  void beginValue(const std::string& name);
+  void writeInteger(int64_t value);
+  void writeString(const char* data, std::size_t size);
+  void write(const char* data, std::size_t size);
+  void write(char c);
+
+  Common::IOutputStream& stream;
+  // open objects and arrays, the root object is the first one
+  std::vector<Level> levels;
 };
 
 }
@@ -19,109 +19,185 @@
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <iterator>
 #include <stdexcept>
 #include "KVBinaryCommon.h"
 
-using Common::JsonValue;
 using namespace CryptoNote;
 
 namespace {
 
+// nesting deeper than this is rejected, skipping values recurses into nested objects and arrays
+const size_t MAX_NESTING_LEVEL = 100;
+
+size_t fixedValueSize(uint8_t type) {
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_INT64:  return sizeof(int64_t);
+  case BIN_KV_SERIALIZE_TYPE_INT32:  return sizeof(int32_t);
+  case BIN_KV_SERIALIZE_TYPE_INT16:  return sizeof(int16_t);
+  case BIN_KV_SERIALIZE_TYPE_INT8:   return sizeof(int8_t);
+  case BIN_KV_SERIALIZE_TYPE_UINT64: return sizeof(uint64_t);
+  case BIN_KV_SERIALIZE_TYPE_UINT32: return sizeof(uint32_t);
+  case BIN_KV_SERIALIZE_TYPE_UINT16: return sizeof(uint16_t);
+  case BIN_KV_SERIALIZE_TYPE_UINT8:  return sizeof(uint8_t);
+  case BIN_KV_SERIALIZE_TYPE_DOUBLE: return sizeof(double);
+  case BIN_KV_SERIALIZE_TYPE_BOOL:   return sizeof(uint8_t);
+  default:
+    return 0;
+  }
+}
+
 template <typename T>
-T readPod(std::istream& s) {
+T readPod(const std::string& data, size_t offset) {
   T v;
-  s.read(reinterpret_cast<char*>(&v), sizeof(T));
+  memcpy(&v, data.data() + offset, sizeof(T));
   return v;
 }
 
-template <typename T, typename JsonT = T>
-JsonValue readPodJson(std::istream& s) {
-  T v;
-  s.read(reinterpret_cast<char*>(&v), sizeof(T));
-  JsonValue jv;
-  jv = static_cast<JsonT>(v);
-  return jv;
 }
 
-template <typename T>
-JsonValue readIntegerJson(std::istream& s) {
-  return readPodJson<T, int64_t>(s);
+void KVBinaryInputStreamSerializer::parse() {
+  data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+  need(0, sizeof(KVBinaryStorageBlockHeader));
+  auto hdr = readPod<KVBinaryStorageBlockHeader>(data, 0);
+
+  if (
+    hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
+    hdr.m_signature_b != PORTABLE_STORAGE_SIGNATUREB) {
+    throw std::runtime_error("Invalid binary storage signature");
+  }
+
+  if (hdr.m_ver != PORTABLE_STORAGE_FORMAT_VER) {
+    throw std::runtime_error("Unknown binary storage format version");
+  }
+
+  depth = 0;
+  openSection(pushFrame(), sizeof(KVBinaryStorageBlockHeader));
+  depth = 0;
 }
 
-size_t readVarint(std::istream& s) {
-  size_t v = 0;
-  uint8_t size_mask = uint8_t(s.peek()) & PORTABLE_RAW_SIZE_MARK_MASK;
+ISerializer::SerializerType KVBinaryInputStreamSerializer::type() const {
+  return ISerializer::INPUT;
+}
 
-  switch (size_mask) {
-  case PORTABLE_RAW_SIZE_MARK_BYTE:
-    v = readPod<uint8_t>(s);
-    break;
-  case PORTABLE_RAW_SIZE_MARK_WORD:
-    v = readPod<uint16_t>(s);
-    break;
-  case PORTABLE_RAW_SIZE_MARK_DWORD:
-    v = readPod<uint32_t>(s);
-    break;
-  case PORTABLE_RAW_SIZE_MARK_INT64:
-    v = readPod<uint64_t>(s);
-    break;
-  default:
-    throw std::runtime_error("unknown varint size_mask");
+ISerializer& KVBinaryInputStreamSerializer::beginObject(const std::string& name) {
+  assert(!frames.empty());
+
+  if (depth == 0) {
+    depth = 1;
+    return *this;
   }
 
-  v >>= 2;
-  return v;
+  Value value = takeValue(name);
+  if (value.type != BIN_KV_SERIALIZE_TYPE_OBJECT) {
+    throw std::runtime_error("Value is not an object: " + name);
+  }
+
+  openSection(pushFrame(), value.offset);
+  return *this;
 }
 
-std::string readString(std::istream& s) {
-  auto size = readVarint(s);
-  std::string str;
-  str.resize(size);
-  s.read(&str[0], size);
-  return str;
+ISerializer& KVBinaryInputStreamSerializer::endObject() {
+  assert(depth > 0);
+  --depth;
+  return *this;
 }
 
-JsonValue readStringJson(std::istream& s) {
-  JsonValue js;
-  js = readString(s);
-  return js;
+ISerializer& KVBinaryInputStreamSerializer::beginArray(std::size_t& size, const std::string& name) {
+  assert(depth > 0);
+
+  Value value;
+  if (frames[depth - 1].array) {
+    value = takeValue(name);
+  } else if (!findField(name, value)) {
+    Frame& frame = pushFrame();
+    frame.array = true;
+    frame.remaining = 0;
+    size = 0;
+    return *this;
+  }
+
+  if ((value.type & BIN_KV_SERIALIZE_FLAG_ARRAY) == 0) {
+    throw std::runtime_error("Value is not an array: " + name);
+  }
+
+  size_t offset = value.offset;
+  size = readVarint(offset);
+  Frame& frame = pushFrame();
+  frame.array = true;
+  frame.itemType = value.type & ~BIN_KV_SERIALIZE_FLAG_ARRAY;
+  frame.remaining = size;
+  frame.position = offset;
+  return *this;
 }
 
-void readName(std::istream& s, std::string& name) {
-  uint8_t len = readPod<uint8_t>(s);
-  name.resize(len);
-  s.read(&name[0], len);
+ISerializer& KVBinaryInputStreamSerializer::endArray() {
+  assert(depth > 0);
+  --depth;
+  return *this;
 }
 
+ISerializer& KVBinaryInputStreamSerializer::operator()(uint8_t& value, const std::string& name) {
+  value = static_cast<uint8_t>(readInteger(takeValue(name)));
+  return *this;
 }
 
-void KVBinaryInputStreamSerializer::parse() {
-  auto hdr = readPod<KVBinaryStorageBlockHeader>(stream);
+ISerializer& KVBinaryInputStreamSerializer::operator()(int32_t& value, const std::string& name) {
+  value = static_cast<int32_t>(readInteger(takeValue(name)));
+  return *this;
+}
 
-  if (
-    hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
-    hdr.m_signature_b != PORTABLE_STORAGE_SIGNATUREB) {
-    throw std::runtime_error("Invalid binary storage signature");
-  }
+ISerializer& KVBinaryInputStreamSerializer::operator()(uint32_t& value, const std::string& name) {
+  value = static_cast<uint32_t>(readInteger(takeValue(name)));
+  return *this;
+}
 
-  if (hdr.m_ver != PORTABLE_STORAGE_FORMAT_VER) {
-    throw std::runtime_error("Unknown binary storage format version");
+ISerializer& KVBinaryInputStreamSerializer::operator()(int64_t& value, const std::string& name) {
+  value = readInteger(takeValue(name));
+  return *this;
+}
+
+ISerializer& KVBinaryInputStreamSerializer::operator()(uint64_t& value, const std::string& name) {
+  value = static_cast<uint64_t>(readInteger(takeValue(name)));
+  return *this;
+}
+
+ISerializer& KVBinaryInputStreamSerializer::operator()(double& value, const std::string& name) {
+  Value v = takeValue(name);
+  if (v.type != BIN_KV_SERIALIZE_TYPE_DOUBLE) {
+    throw std::runtime_error("Value is not a double: " + name);
   }
 
-  root.reset(new JsonValue(loadSection()));
-  setJsonValue(root.get());
+  need(v.offset, sizeof(double));
+  value = readPod<double>(data, v.offset);
+  return *this;
 }
 
-ISerializer& KVBinaryInputStreamSerializer::binary(void* value, std::size_t size, const std::string& name) {
-  std::string str;
+ISerializer& KVBinaryInputStreamSerializer::operator()(bool& value, const std::string& name) {
+  Value v = takeValue(name);
+  if (v.type != BIN_KV_SERIALIZE_TYPE_BOOL) {
+    throw std::runtime_error("Value is not a bool: " + name);
+  }
+
+  need(v.offset, 1);
+  value = data[v.offset] != 0;
+  return *this;
+}
 
-  (*this)(str, name);
+ISerializer& KVBinaryInputStreamSerializer::operator()(std::string& value, const std::string& name) {
+  size_t offset;
+  size_t size = readStringSize(takeValue(name), offset);
+  value.assign(data, offset, size);
+  return *this;
+}
 
-  if (str.size() != size) {
+ISerializer& KVBinaryInputStreamSerializer::binary(void* value, std::size_t size, const std::string& name) {
+  size_t offset;
+  if (readStringSize(takeValue(name), offset) != size) {
     throw std::runtime_error("Binary block size mismatch");
   }
 
-  memcpy(value, str.data(), size);
+  memcpy(value, data.data() + offset, size);
   return *this;
 }
 
@@ -134,58 +210,219 @@ ISerializer& KVBinaryInputStreamSerializer::binary(std::string& value, const std
   return (*this)(value, name); // load as string
 }
 
-JsonValue KVBinaryInputStreamSerializer::loadSection() {
-  JsonValue sec(JsonValue::OBJECT);
-  size_t count = readVarint(stream);
-  std::string name;
+bool KVBinaryInputStreamSerializer::hasObject(const std::string& name) {
+  assert(!frames.empty());
+
+  const Frame& frame = frames[depth == 0 ? 0 : depth - 1];
+  if (frame.array) {
+    return frame.remaining != 0;
+  }
+
+  Value value;
+  return findField(name, value);
+}
+
+KVBinaryInputStreamSerializer::Frame& KVBinaryInputStreamSerializer::pushFrame() {
+  if (depth == MAX_NESTING_LEVEL) {
+    throw std::runtime_error("KV binary data is nested too deep");
+  }
+
+  if (frames.size() == depth) {
+    frames.emplace_back();
+  }
+
+  return frames[depth++];
+}
 
+void KVBinaryInputStreamSerializer::openSection(Frame& frame, size_t offset) {
+  frame.array = false;
+  frame.fields.clear();
+  size_t count = readVarint(offset);
+  // every field takes at least a name size and a type byte, a count above it can't be trusted for reservation
+  frame.fields.reserve(std::min(count, (data.size() - offset) / 2));
   while (count--) {
-    readName(stream, name);
-    sec.insert(name, loadEntry());
+    Field field;
+    need(offset, 1);
+    field.nameSize = static_cast<uint8_t>(data[offset]);
+    field.nameOffset = offset + 1;
+    offset = field.nameOffset + field.nameSize;
+    need(offset, 1);
+    field.value.type = static_cast<uint8_t>(data[offset]);
+    field.value.offset = offset + 1;
+    offset = skipValue(field.value.type, field.value.offset, depth);
+    frame.fields.push_back(field);
+  }
+}
+
+bool KVBinaryInputStreamSerializer::findField(const std::string& name, Value& value) const {
+  const Frame& frame = frames[depth == 0 ? 0 : depth - 1];
+  for (const Field& field : frame.fields) {
+    if (field.nameSize == name.size() && data.compare(field.nameOffset, field.nameSize, name) == 0) {
+      value = field.value;
+      return true;
+    }
   }
 
-  return sec;
+  return false;
 }
 
-JsonValue KVBinaryInputStreamSerializer::loadValue(uint8_t type) {
-  switch (type) {
-  case BIN_KV_SERIALIZE_TYPE_INT64:  return readIntegerJson<int64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT32:  return readIntegerJson<int32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT16:  return readIntegerJson<int16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT8:   return readIntegerJson<int8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT64: return readIntegerJson<uint64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT32: return readIntegerJson<uint32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT16: return readIntegerJson<uint16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT8:  return readIntegerJson<uint8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_DOUBLE: return readPodJson<double>(stream);
-  case BIN_KV_SERIALIZE_TYPE_BOOL:   return JsonValue(stream.get() != 0);
-  case BIN_KV_SERIALIZE_TYPE_STRING: return readStringJson(stream);
-  case BIN_KV_SERIALIZE_TYPE_OBJECT: return loadSection();
-  case BIN_KV_SERIALIZE_TYPE_ARRAY:  return loadArray(type);
+KVBinaryInputStreamSerializer::Value KVBinaryInputStreamSerializer::takeValue(const std::string& name) {
+  assert(depth > 0);
+
+  Frame& frame = frames[depth - 1];
+  if (!frame.array) {
+    Value value;
+    if (!findField(name, value)) {
+      throw std::runtime_error("Value is not found: " + name);
+    }
+
+    return value;
+  }
+
+  if (frame.remaining == 0) {
+    throw std::runtime_error("Array has no more items");
+  }
+
+  // items of nested arrays carry their own types
+  Value value;
+  if (frame.itemType == BIN_KV_SERIALIZE_TYPE_ARRAY) {
+    need(frame.position, 1);
+    value.type = static_cast<uint8_t>(data[frame.position]);
+    value.offset = frame.position + 1;
+  } else {
+    value.type = frame.itemType;
+    value.offset = frame.position;
+  }
+
+  frame.position = skipValue(value.type, value.offset, depth);
+  --frame.remaining;
+  return value;
+}
+
+int64_t KVBinaryInputStreamSerializer::readInteger(const Value& value) const {
+  size_t size = fixedValueSize(value.type);
+  if (size == 0 || value.type == BIN_KV_SERIALIZE_TYPE_DOUBLE || value.type == BIN_KV_SERIALIZE_TYPE_BOOL) {
+    throw std::runtime_error("Value is not an integer");
+  }
+
+  need(value.offset, size);
+  switch (value.type) {
+  case BIN_KV_SERIALIZE_TYPE_INT64:  return readPod<int64_t>(data, value.offset);
+  case BIN_KV_SERIALIZE_TYPE_INT32:  return readPod<int32_t>(data, value.offset);
+  case BIN_KV_SERIALIZE_TYPE_INT16:  return readPod<int16_t>(data, value.offset);
+  case BIN_KV_SERIALIZE_TYPE_INT8:   return readPod<int8_t>(data, value.offset);
+  case BIN_KV_SERIALIZE_TYPE_UINT64: return static_cast<int64_t>(readPod<uint64_t>(data, value.offset));
+  case BIN_KV_SERIALIZE_TYPE_UINT32: return readPod<uint32_t>(data, value.offset);
+  case BIN_KV_SERIALIZE_TYPE_UINT16: return readPod<uint16_t>(data, value.offset);
+  default:                           return readPod<uint8_t>(data, value.offset);
+  }
+}
+
+size_t KVBinaryInputStreamSerializer::readStringSize(const Value& value, size_t& offset) const {
+  if (value.type != BIN_KV_SERIALIZE_TYPE_STRING) {
+    throw std::runtime_error("Value is not a string");
+  }
+
+  offset = value.offset;
+  size_t size = readVarint(offset);
+  need(offset, size);
+  return size;
+}
+
+size_t KVBinaryInputStreamSerializer::readVarint(size_t& offset) const {
+  need(offset, 1);
+  size_t v = 0;
+  uint8_t size_mask = uint8_t(data[offset]) & PORTABLE_RAW_SIZE_MARK_MASK;
+
+  switch (size_mask) {
+  case PORTABLE_RAW_SIZE_MARK_BYTE:
+    v = readPod<uint8_t>(data, offset);
+    offset += sizeof(uint8_t);
+    break;
+  case PORTABLE_RAW_SIZE_MARK_WORD:
+    need(offset, sizeof(uint16_t));
+    v = readPod<uint16_t>(data, offset);
+    offset += sizeof(uint16_t);
+    break;
+  case PORTABLE_RAW_SIZE_MARK_DWORD:
+    need(offset, sizeof(uint32_t));
+    v = readPod<uint32_t>(data, offset);
+    offset += sizeof(uint32_t);
+    break;
   default:
-    throw std::runtime_error("Unknown data type");
+    need(offset, sizeof(uint64_t));
+    v = static_cast<size_t>(readPod<uint64_t>(data, offset));
+    offset += sizeof(uint64_t);
     break;
   }
+
+  v >>= 2;
+  return v;
 }
 
-JsonValue KVBinaryInputStreamSerializer::loadEntry() {
-  uint8_t type = readPod<uint8_t>(stream);
+// returns offset right after the value
+size_t KVBinaryInputStreamSerializer::skipValue(uint8_t type, size_t offset, size_t level) const {
+  if (level >= MAX_NESTING_LEVEL) {
+    throw std::runtime_error("KV binary data is nested too deep");
+  }
 
-  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
-    type &= ~BIN_KV_SERIALIZE_FLAG_ARRAY;
-    return loadArray(type);
+  if ((type & BIN_KV_SERIALIZE_FLAG_ARRAY) != 0) {
+    size_t count = readVarint(offset);
+    return skipItems(type & ~BIN_KV_SERIALIZE_FLAG_ARRAY, count, offset, level + 1);
   }
 
-  return loadValue(type);
+  return skipItems(type, 1, offset, level);
 }
 
-JsonValue KVBinaryInputStreamSerializer::loadArray(uint8_t itemType) {
-  JsonValue arr(JsonValue::ARRAY);
-  size_t count = readVarint(stream);
+size_t KVBinaryInputStreamSerializer::skipItems(uint8_t itemType, size_t count, size_t offset, size_t level) const {
+  size_t size = fixedValueSize(itemType);
+  if (size != 0) {
+    if (count > (data.size() - offset) / size) {
+      throw std::runtime_error("KV binary data is truncated");
+    }
 
-  while (count--) {
-    arr.pushBack(loadValue(itemType));
+    return offset + count * size;
+  }
+
+  for (; count > 0; --count) {
+    switch (itemType) {
+    case BIN_KV_SERIALIZE_TYPE_STRING: {
+      size_t stringSize = readVarint(offset);
+      need(offset, stringSize);
+      offset += stringSize;
+      break;
+    }
+
+    case BIN_KV_SERIALIZE_TYPE_OBJECT: {
+      size_t fieldCount = readVarint(offset);
+      for (; fieldCount > 0; --fieldCount) {
+        need(offset, 1);
+        offset += 1 + static_cast<uint8_t>(data[offset]);
+        need(offset, 1);
+        uint8_t fieldType = static_cast<uint8_t>(data[offset]);
+        offset = skipValue(fieldType, offset + 1, level + 1);
+      }
+
+      break;
+    }
+
+    case BIN_KV_SERIALIZE_TYPE_ARRAY: {
+      need(offset, 1);
+      uint8_t nestedType = static_cast<uint8_t>(data[offset]);
+      offset = skipValue(nestedType, offset + 1, level + 1);
+      break;
+    }
+
+    default:
+      throw std::runtime_error("Unknown data type");
+    }
   }
 
-  return arr;
+  return offset;
+}
+
+void KVBinaryInputStreamSerializer::need(size_t offset, size_t size) const {
+  if (offset > data.size() || size > data.size() - offset) {
+    throw std::runtime_error("KV binary data is truncated");
+  }
 }
@@ -18,32 +18,88 @@
 #pragma once
 
 #include <istream>
-#include <memory>
-#include "../Common/JsonValue.h"
+#include <string>
+#include <vector>
 #include "ISerializer.h"
-#include "JsonInputValueSerializer.h"
 #include "SerializationOverloads.h"
 
 namespace CryptoNote {
 
-class KVBinaryInputStreamSerializer : public JsonInputValueSerializer {
+// Reads KV binary (epee portable storage) data straight from the received bytes. Fields of an opened object are
+// indexed by their offsets, values are decoded only when they are asked for, so no tree of the whole message is
+// built. Malformed or truncated data is reported as std::runtime_error.
+class KVBinaryInputStreamSerializer : public ISerializer {
 public:
-  KVBinaryInputStreamSerializer(std::istream& strm) : stream(strm) {}
+  KVBinaryInputStreamSerializer(std::istream& strm) : stream(strm), depth(0) {}
   virtual ~KVBinaryInputStreamSerializer() {}
 
   void parse();
 
+  virtual SerializerType type() const override;
+
+  virtual ISerializer& beginObject(const std::string& name) override;
+  virtual ISerializer& endObject() override;
+
+  virtual ISerializer& beginArray(std::size_t& size, const std::string& name) override;
+  virtual ISerializer& endArray() override;
+
+  virtual ISerializer& operator()(uint8_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(int32_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(uint32_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(int64_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(uint64_t& value, const std::string& name) override;
+  virtual ISerializer& operator()(double& value, const std::string& name) override;
+  virtual ISerializer& operator()(bool& value, const std::string& name) override;
+  virtual ISerializer& operator()(std::string& value, const std::string& name) override;
+
   virtual ISerializer& binary(void* value, std::size_t size, const std::string& name) override;
   virtual ISerializer& binary(std::string& value, const std::string& name) override;
 
+  virtual bool hasObject(const std::string& name) override;
+
+  template<typename T>
+  ISerializer& operator()(T& value, const std::string& name) {
+    return ISerializer::operator()(value, name);
+  }
+
 private:
-  std::unique_ptr<Common::JsonValue> root;
-  std::istream& stream;
+  // type has BIN_KV_SERIALIZE_FLAG_ARRAY set for arrays, offset points right after the type
+  struct Value {
+    uint8_t type;
+    size_t offset;
+  };
+
+  struct Field {
+    size_t nameOffset;
+    size_t nameSize;
+    Value value;
+  };
+
+  // object frames hold fields of the object, array frames read items one after another
+  struct Frame {
+    bool array;
+    std::vector<Field> fields;
+    uint8_t itemType;
+    size_t remaining;
+    size_t position;
+  };
 
-  Common::JsonValue loadSection();
-  Common::JsonValue loadEntry();
-  Common::JsonValue loadValue(uint8_t type);
-  Common::JsonValue loadArray(uint8_t itemType);
+  Frame& pushFrame();
+  void openSection(Frame& frame, size_t offset);
+  bool findField(const std::string& name, Value& value) const;
+  Value takeValue(const std::string& name);
+  int64_t readInteger(const Value& value) const;
+  size_t readStringSize(const Value& value, size_t& offset) const;
+  size_t readVarint(size_t& offset) const;
+  size_t skipValue(uint8_t type, size_t offset, size_t level) const;
+  size_t skipItems(uint8_t itemType, size_t count, size_t offset, size_t level) const;
+  void need(size_t offset, size_t size) const;
+
+  std::istream& stream;
+  std::string data;
+  // the root object is the first frame, it is opened by parse. Frames aren't removed when they are closed, their field vectors are reused by next objects
+  std::vector<Frame> frames;
+  size_t depth;
 };
 
 }
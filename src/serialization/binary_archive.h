@@ -22,6 +22,7 @@
 #include <iterator>
 #include <boost/type_traits/make_unsigned.hpp>
 
+#include "Common/MemoryStreambuf.h"
 #include "Common/varint.h"
 
 //TODO: fix size_t warning in x32 platform
@@ -47,13 +48,43 @@ protected:
   stream_type &stream_;
 };
 
+// Input iterator over a stream which remembers the last byte taken, so a reader can tell how a varint ended
+class last_byte_iterator
+{
+public:
+  struct value_proxy
+  {
+    char value;
+    char operator*() const { return value; }
+  };
+
+  last_byte_iterator(std::istreambuf_iterator<char> it, char &last) : it_(it), last_(&last) { }
+
+  char operator*() const { return *it_; }
+  value_proxy operator++(int)
+  {
+    value_proxy proxy = { *it_ };
+    ++it_;
+    *last_ = proxy.value;
+    return proxy;
+  }
+
+  bool operator==(const last_byte_iterator &other) const { return it_ == other.it_; }
+  bool operator!=(const last_byte_iterator &other) const { return !(*this == other); }
+
+private:
+  std::istreambuf_iterator<char> it_;
+  char *last_;
+};
+
 template <bool W>
 struct binary_archive;
 
 template <>
 struct binary_archive<false> : public binary_archive_base<std::istream, false>
 {
-  explicit binary_archive(stream_type &s) : base_type(s) {
+  explicit binary_archive(stream_type &s) : base_type(s), canonical_varints_(true) {
+    memory_ = dynamic_cast<Common::MemoryStreambuf *>(stream_.rdbuf());
     stream_type::streampos pos = stream_.tellg();
     stream_.seekg(0, std::ios_base::end);
     eof_pos_ = stream_.tellg();
@@ -92,8 +123,21 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
   template <class T>
   void serialize_uvarint(T &v)
   {
+    // blobs and mapped files are read in place, anything unusual is left to the byte by byte reader below
+    if (memory_ != nullptr) {
+      size_t size = tools::read_varint_buffer(memory_->position(), memory_->end(), v);
+      if (size != 0) {
+        memory_->skip(size);
+        return;
+      }
+    }
+
     typedef std::istreambuf_iterator<char> it;
-    tools::read_varint(it(stream_), it(), v); // XXX handle failure
+    char last = 0;
+    int read = tools::read_varint(last_byte_iterator(it(stream_), last), last_byte_iterator(it(), last), v); // XXX handle failure
+    // overflowed, padded or cut off by the end of data
+    if (read <= 0 || (last & 0x80) != 0)
+      canonical_varints_ = false;
   }
   void begin_array(size_t &s)
   {
@@ -118,8 +162,13 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
     assert(stream_.tellg() <= eof_pos_);
     return eof_pos_ - stream_.tellg();
   }
+
+  // false if any varint read so far isn't in the form it is written in, writing the data back wouldn't give the same bytes then
+  bool canonical_varints() const { return canonical_varints_; }
 protected:
   std::streamoff eof_pos_;
+  bool canonical_varints_;
+  Common::MemoryStreambuf *memory_;
 };
 
 template <>
@@ -19,6 +19,7 @@
 
 #include <vector>
 
+#include "binary_archive.h"
 #include "serialization.h"
 #include "crypto/chacha8.h"
 #include "crypto/crypto.h"
@@ -70,3 +71,28 @@ BLOB_SERIALIZER(crypto::secret_key);
 BLOB_SERIALIZER(crypto::key_derivation);
 BLOB_SERIALIZER(crypto::key_image);
 BLOB_SERIALIZER(crypto::signature);
+
+// binary archive keeps signatures of an input back to back, they are read and written as one block
+inline bool do_serialize(binary_archive<false> &ar, std::vector<crypto::signature> &v)
+{
+  size_t cnt = v.size();
+  v.clear();
+
+  // very basic sanity check
+  if (ar.remaining_bytes() / sizeof(crypto::signature) < cnt) {
+    ar.stream().setstate(std::ios::failbit);
+    return false;
+  }
+
+  v.resize(cnt);
+  if (cnt != 0)
+    ar.serialize_blob(v.data(), cnt * sizeof(crypto::signature), "");
+  return ar.stream().good();
+}
+
+inline bool do_serialize(binary_archive<true> &ar, std::vector<crypto::signature> &v)
+{
+  if (!v.empty())
+    ar.serialize_blob(v.data(), v.size() * sizeof(crypto::signature), "");
+  return ar.stream().good();
+}
@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <type_traits>
+
+#include "binary_archive.h"
 #include "serialization.h"
 
 namespace serialization
@@ -92,3 +95,39 @@ bool do_serialize(Archive<true> &ar, std::vector<T> &v)
   ar.end_array();
   return true;
 }
+
+// binary archive stores vectors of blobs as count followed by raw items, contiguous items are read and written at once
+template <class T>
+typename std::enable_if<is_blob_type<T>::type::value, bool>::type do_serialize(binary_archive<false> &ar, std::vector<T> &v)
+{
+  size_t cnt;
+  ar.begin_array(cnt);
+  if (!ar.stream().good())
+    return false;
+  v.clear();
+
+  // very basic sanity check
+  if (ar.remaining_bytes() / sizeof(T) < cnt) {
+    ar.stream().setstate(std::ios::failbit);
+    return false;
+  }
+
+  v.resize(cnt);
+  if (cnt != 0)
+    ar.serialize_blob(v.data(), cnt * sizeof(T));
+  if (!ar.stream().good())
+    return false;
+  ar.end_array();
+  return true;
+}
+
+template <class T>
+typename std::enable_if<is_blob_type<T>::type::value, bool>::type do_serialize(binary_archive<true> &ar, std::vector<T> &v)
+{
+  size_t cnt = v.size();
+  ar.begin_array(cnt);
+  if (cnt != 0)
+    ar.serialize_blob(v.data(), cnt * sizeof(T));
+  ar.end_array();
+  return ar.stream().good();
+}
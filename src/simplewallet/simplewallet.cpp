@@ -64,13 +64,16 @@ namespace {
 const command_line::arg_descriptor<std::string> arg_wallet_file = { "wallet-file", "Use wallet <arg>", "" };
 const command_line::arg_descriptor<std::string> arg_generate_new_wallet = { "generate-new-wallet", "Generate new wallet and save it to <arg>", "" };
 const command_line::arg_descriptor<std::string> arg_daemon_address = { "daemon-address", "Use daemon instance at <host>:<port>", "" };
-const command_line::arg_descriptor<std::string> arg_daemon_host = { "daemon-host", "Use daemon instance at host <arg> instead of localhost", "" };
+const command_line::arg_descriptor<std::string> arg_daemon_host = { "daemon-host", "Use daemon instance at host <arg> instead of localhost, unix:<path> for a Unix domain socket", "" };
 const command_line::arg_descriptor<std::string> arg_password = { "password", "Wallet password", "", true };
 const command_line::arg_descriptor<uint16_t> arg_daemon_port = { "daemon-port", "Use daemon instance at port <arg> instead of 8081", 0 };
+const command_line::arg_descriptor< std::vector<std::string> > arg_backup_daemon_address = { "backup-daemon-address", "Also use daemon instance at <host>:<port>, requests go to the fastest one and fail over to others" };
 const command_line::arg_descriptor<uint32_t> arg_log_level = { "set_log", "", INFO, true };
 const command_line::arg_descriptor<bool> arg_testnet = { "testnet", "Used to deploy test nets. The daemon must be launched with --testnet flag", false };
 const command_line::arg_descriptor< std::vector<std::string> > arg_command = { "command", "" };
 
+const size_t INCOMING_TRANSFERS_PAGE_SIZE = 50;
+
 
 bool parseUrlAddress(const std::string& url, std::string& address, uint16_t& port) {
 
@@ -391,7 +394,9 @@ simple_wallet::simple_wallet(System::Dispatcher& dispatcher, const CryptoNote::C
   m_consoleHandler.setHandler("stop_mining", boost::bind(&simple_wallet::stop_mining, this, _1), "Stop mining in daemon");
   //m_consoleHandler.setHandler("refresh", boost::bind(&simple_wallet::refresh, this, _1), "Resynchronize transactions and balance");
   m_consoleHandler.setHandler("balance", boost::bind(&simple_wallet::show_balance, this, _1), "Show current wallet balance");
-  m_consoleHandler.setHandler("incoming_transfers", boost::bind(&simple_wallet::show_incoming_transfers, this, _1), "Show incoming transfers");
+  m_consoleHandler.setHandler("incoming_transfers", boost::bind(&simple_wallet::show_incoming_transfers, this, _1),
+    "incoming_transfers [spent|unspent|all] [-s <start_height>] [-e <end_height>] [-m <min_amount>] [-p <page>] - Show incoming transfers, " +
+    std::to_string(INCOMING_TRANSFERS_PAGE_SIZE) + " per page");
   m_consoleHandler.setHandler("list_transfers", boost::bind(&simple_wallet::listTransfers, this, _1), "Show all known transfers");
   m_consoleHandler.setHandler("payments", boost::bind(&simple_wallet::show_payments, this, _1), "payments <payment_id_1> [<payment_id_2> ... <payment_id_N>] - Show payments <payment_id_1>, ... <payment_id_N>");
   m_consoleHandler.setHandler("bc_height", boost::bind(&simple_wallet::show_blockchain_height, this, _1), "Show blockchain height");
@@ -503,6 +508,18 @@ bool simple_wallet::init(const boost::program_options::variables_map& vm)
     m_daemon_address = std::string("http://") + m_daemon_host + ":" + std::to_string(m_daemon_port);
   }
 
+  m_daemon_nodes.clear();
+  m_daemon_nodes.push_back(NodeRpcProxy::NodeAddress{ m_daemon_host, m_daemon_port });
+  for (const auto& address : m_backup_daemon_addresses) {
+    NodeRpcProxy::NodeAddress node;
+    if (!parseUrlAddress(address, node.host, node.port)) {
+      fail_msg_writer() << "failed to parse daemon address: " << address;
+      return false;
+    }
+
+    m_daemon_nodes.push_back(node);
+  }
+
   tools::password_container pwd_container;
   if (command_line::has_arg(vm, arg_password)) {
     pwd_container.password(command_line::get_arg(vm, arg_password));
@@ -511,7 +528,7 @@ bool simple_wallet::init(const boost::program_options::variables_map& vm)
     return false;
   }
 
-  this->m_node.reset(new NodeRpcProxy(m_daemon_host, m_daemon_port));
+  this->m_node.reset(new NodeRpcProxy(m_daemon_nodes));
 
   std::promise<std::error_code> errorPromise;
   std::future<std::error_code> f_error = errorPromise.get_future();
@@ -568,6 +585,7 @@ void simple_wallet::handle_command_line(const boost::program_options::variables_
   m_daemon_address = command_line::get_arg(vm, arg_daemon_address);
   m_daemon_host = command_line::get_arg(vm, arg_daemon_host);
   m_daemon_port = command_line::get_arg(vm, arg_daemon_port);
+  m_backup_daemon_addresses = command_line::get_arg(vm, arg_backup_daemon_address);
 }
 //----------------------------------------------------------------------------------------------------
 bool simple_wallet::new_wallet(const std::string &wallet_file, const std::string& password)
@@ -739,7 +757,12 @@ void simple_wallet::initCompleted(std::error_code result) {
 //----------------------------------------------------------------------------------------------------
 void simple_wallet::localBlockchainUpdated(uint64_t height)
 {
-  m_refresh_progress_reporter.update(height, false);
+  m_refresh_progress_reporter.update_blockchain_height(height);
+}
+//----------------------------------------------------------------------------------------------------
+void simple_wallet::synchronizationProgressUpdated(uint64_t current, uint64_t total)
+{
+  m_refresh_progress_reporter.update(current, false, total);
 }
 //----------------------------------------------------------------------------------------------------
 void simple_wallet::externalTransactionCreated(CryptoNote::TransactionId transactionId) 
@@ -770,19 +793,79 @@ bool simple_wallet::show_balance(const std::vector<std::string>& args/* = std::v
 //----------------------------------------------------------------------------------------------------
 bool simple_wallet::show_incoming_transfers(const std::vector<std::string>& args)
 {
-  bool hasTransfers = false;
-  size_t transactionsCount = m_wallet->getTransactionCount();
-  for (size_t trantransactionNumber = 0; trantransactionNumber < transactionsCount; ++trantransactionNumber) {
-    TransactionInfo txInfo;
-    m_wallet->getTransaction(trantransactionNumber, txInfo);
-    if (txInfo.totalAmount < 0) continue;
-    hasTransfers = true;
-    logger(INFO) << "        amount       \t                              tx id";
-    logger(INFO, GREEN) <<  // spent - magenta
-      std::setw(21) << m_currency.formatAmount(txInfo.totalAmount) << '\t' << Common::podToHex(txInfo.hash);
+  IncomingTransfersFilter filter;
+  filter.firstHeight = 0;
+  filter.lastHeight = UNCONFIRMED_TRANSACTION_HEIGHT;
+  filter.includeUnspent = true;
+  filter.includeSpent = true;
+  filter.minAmount = 0;
+  size_t page = 1;
+
+  ArgumentReader<std::vector<std::string>::const_iterator> ar(args.begin(), args.end());
+  try {
+    while (!ar.eof()) {
+      auto arg = ar.next();
+      if (arg == "spent") {
+        filter.includeUnspent = false;
+      } else if (arg == "unspent") {
+        filter.includeSpent = false;
+      } else if (arg == "all") {
+        filter.includeUnspent = true;
+        filter.includeSpent = true;
+      } else if (arg.size() == 2 && arg[0] == '-') {
+        auto value = ar.next();
+        bool ok = true;
+        if (arg == "-s") {
+          ok = Common::fromString(value, filter.firstHeight);
+        } else if (arg == "-e") {
+          ok = Common::fromString(value, filter.lastHeight);
+        } else if (arg == "-m") {
+          ok = m_currency.parseAmount(value, filter.minAmount);
+        } else if (arg == "-p") {
+          ok = Common::fromString(value, page) && page > 0;
+        } else {
+          ok = false;
+        }
+
+        if (!ok) {
+          fail_msg_writer() << "wrong value of " << arg << ": " << value;
+          return true;
+        }
+      } else {
+        fail_msg_writer() << "unknown argument: " << arg;
+        return true;
+      }
+    }
+  } catch (const std::exception& e) {
+    fail_msg_writer() << e.what();
+    return true;
+  }
+
+  // one more transfer than a page tells whether the next page exists
+  std::vector<IncomingTransfer> transfers = m_wallet->getIncomingTransfers(filter, (page - 1) * INCOMING_TRANSFERS_PAGE_SIZE,
+    INCOMING_TRANSFERS_PAGE_SIZE + 1);
+  if (transfers.empty()) {
+    success_msg_writer() << "No incoming transfers";
+    return true;
+  }
+
+  bool hasMore = transfers.size() > INCOMING_TRANSFERS_PAGE_SIZE;
+  if (hasMore) {
+    transfers.pop_back();
+  }
+
+  logger(INFO) << "        amount       \t  height\t spent\t                              tx id";
+  for (const IncomingTransfer& transfer : transfers) {
+    logger(INFO, transfer.spent ? MAGENTA : GREEN) <<
+      std::setw(21) << m_currency.formatAmount(transfer.amount) << '\t' <<
+      std::setw(8) << (transfer.blockHeight == UNCONFIRMED_TRANSACTION_HEIGHT ? std::string("-") : std::to_string(transfer.blockHeight)) << '\t' <<
+      std::setw(6) << (transfer.spent ? "T" : "F") << '\t' << Common::podToHex(transfer.transactionHash);
+  }
+
+  if (hasMore) {
+    success_msg_writer() << "More transfers follow, use -p " << page + 1 << " to show them";
   }
 
-  if (!hasTransfers) success_msg_writer() << "No incoming transfers";
   return true;
 }
 
@@ -984,6 +1067,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_params, arg_daemon_address);
   command_line::add_arg(desc_params, arg_daemon_host);
   command_line::add_arg(desc_params, arg_daemon_port);
+  command_line::add_arg(desc_params, arg_backup_daemon_address);
   command_line::add_arg(desc_params, arg_command);
   command_line::add_arg(desc_params, arg_log_level);
   command_line::add_arg(desc_params, arg_testnet);
@@ -24,6 +24,7 @@
 
 #include "IWallet.h"
 #include "INode.h"
+#include "node_rpc_proxy/NodeRpcProxy.h"
 #include "password_container.h"
 
 #include "Common/ConsoleHandler.h"
@@ -97,6 +98,7 @@ namespace CryptoNote
     //---------------- IWalletObserver -------------------------
     virtual void initCompleted(std::error_code result) override;
     virtual void externalTransactionCreated(CryptoNote::TransactionId transactionId) override;
+    virtual void synchronizationProgressUpdated(uint64_t current, uint64_t total) override;
     //----------------------------------------------------------
 
     //----------------- INodeObserver --------------------------
@@ -113,25 +115,48 @@ namespace CryptoNote
         , m_blockchain_height(0)
         , m_blockchain_height_update_time()
         , m_print_time()
+        , m_rate_height(0)
+        , m_rate_time()
+        , m_blocks_per_second(0)
       {
       }
 
-      void update(uint64_t height, bool force = false)
+      // height is the height wallet has scanned up to, total is the blockchain height if the caller knows it
+      void update(uint64_t height, bool force = false, uint64_t total = 0)
       {
         auto current_time = std::chrono::system_clock::now();
-        if (std::chrono::seconds(m_simple_wallet.currency().difficultyTarget() / 2) < current_time - m_blockchain_height_update_time ||
+        if (total != 0) {
+          m_blockchain_height = total;
+          m_blockchain_height_update_time = current_time;
+        } else if (std::chrono::seconds(m_simple_wallet.currency().difficultyTarget() / 2) < current_time - m_blockchain_height_update_time ||
             m_blockchain_height <= height) {
           update_blockchain_height();
           m_blockchain_height = (std::max)(m_blockchain_height, height);
         }
 
-        if (std::chrono::milliseconds(1) < current_time - m_print_time || force)
+        update_rate(height, current_time);
+
+        if (std::chrono::milliseconds(100) < current_time - m_print_time || force)
         {
-          std::cout << "Height " << height << " of " << m_blockchain_height << '\r';
+          std::cout << "Height " << height << " of " << m_blockchain_height;
+          if (m_blocks_per_second > 0 && height < m_blockchain_height) {
+            uint64_t seconds_left = static_cast<uint64_t>((m_blockchain_height - height) / m_blocks_per_second);
+            std::cout << ", " << static_cast<uint64_t>(m_blocks_per_second) << " blocks/s, " << seconds_left / 60 << " min " <<
+              seconds_left % 60 << " s left";
+          }
+
+          // trailing spaces overwrite the rest of a longer previous line
+          std::cout << "          \r";
           m_print_time = current_time;
         }
       }
 
+      // Node height only moves the target, progress and throughput follow the heights wallet has scanned
+      void update_blockchain_height(uint64_t height)
+      {
+        m_blockchain_height = (std::max)(m_blockchain_height, height);
+      }
+
     private:
       void update_blockchain_height()
       {
@@ -148,11 +173,35 @@ namespace CryptoNote
         }
       }
 
+      // Throughput is measured over intervals of a few seconds and smoothed, so the estimate follows the actual speed
+      // of the scan without jumping with every batch
+      void update_rate(uint64_t height, std::chrono::system_clock::time_point current_time)
+      {
+        if (height < m_rate_height || m_rate_time == std::chrono::system_clock::time_point()) {
+          m_rate_height = height;
+          m_rate_time = current_time;
+          return;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - m_rate_time).count();
+        if (elapsed < 3000) {
+          return;
+        }
+
+        double rate = static_cast<double>(height - m_rate_height) * 1000 / elapsed;
+        m_blocks_per_second = m_blocks_per_second > 0 ? (m_blocks_per_second + rate) / 2 : rate;
+        m_rate_height = height;
+        m_rate_time = current_time;
+      }
+
     private:
       CryptoNote::simple_wallet& m_simple_wallet;
       uint64_t m_blockchain_height;
       std::chrono::system_clock::time_point m_blockchain_height_update_time;
       std::chrono::system_clock::time_point m_print_time;
+      uint64_t m_rate_height;
+      std::chrono::system_clock::time_point m_rate_time;
+      double m_blocks_per_second;
     };
 
   private:
@@ -163,6 +212,8 @@ namespace CryptoNote
     std::string m_daemon_address;
     std::string m_daemon_host;
     uint16_t m_daemon_port;
+    std::vector<std::string> m_backup_daemon_addresses;
+    std::vector<CryptoNote::NodeRpcProxy::NodeAddress> m_daemon_nodes;
 
     std::string m_wallet_file;
 
@@ -0,0 +1,377 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <System/Dispatcher.h>
+#include <System/Event.h>
+#include <System/InterruptedException.h>
+#include <System/Ipv4Address.h>
+#include <System/TcpConnection.h>
+#include <System/TcpConnector.h>
+#include <System/Timer.h>
+
+#include "Common/command_line.h"
+#include "Common/StringTools.h"
+#include "Common/TrafficLog.h"
+#include "p2p/LevinProtocol.h"
+#include "rpc/HttpClient.h"
+
+namespace po = boost::program_options;
+using namespace CryptoNote;
+
+namespace {
+  const command_line::arg_descriptor<std::string, true> arg_log = {"log", "Traffic log recorded by the daemon with --record-traffic"};
+  const command_line::arg_descriptor<std::string> arg_p2p      = {"p2p", "P2P address of the test node, ip:port, P2P records are skipped if not set", ""};
+  const command_line::arg_descriptor<std::string> arg_rpc      = {"rpc", "RPC address of the test node, ip:port, RPC records are skipped if not set", ""};
+  const command_line::arg_descriptor<double>      arg_speed    = {"speed", "Replay speed relative to the recording, 0 sends records as fast as possible", 1.0};
+  const command_line::arg_descriptor<uint32_t>    arg_drain    = {"drain", "Seconds to wait for responses after the last record", 10};
+  const command_line::arg_descriptor<size_t>      arg_rpc_connections = {"rpc-connections", "RPC connections opened to the test node", 16};
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct LatencyStats {
+    std::vector<uint64_t> samples;
+    size_t errors = 0;
+  };
+
+  // by "p2p <command>" and "rpc <url>"
+  typedef std::map<std::string, LatencyStats> StatsMap;
+
+  // Recorded peer connection, commands are written in the replay context and responses are read by its own one
+  struct ReplayConnection {
+    System::TcpConnection connection;
+    std::unique_ptr<LevinProtocol> levin;
+    // send times of requests waiting for responses, by command id
+    std::map<uint32_t, std::deque<Clock::time_point>> pending;
+    bool closed = false;
+  };
+
+  bool parseAddress(const std::string& address, System::Ipv4Address& ip, uint16_t& port) {
+    size_t pos = address.find_last_of(':');
+    if (pos == std::string::npos) {
+      return false;
+    }
+
+    try {
+      ip = System::Ipv4Address(address.substr(0, pos));
+      port = Common::fromString<uint16_t>(address.substr(pos + 1));
+    } catch (const std::exception&) {
+      return false;
+    }
+
+    return true;
+  }
+
+  void readResponses(ReplayConnection& replayConnection, LatencyStats& unmatched, StatsMap& stats) {
+    LevinProtocol::Command cmd;
+    try {
+      while (replayConnection.levin->readCommand(cmd)) {
+        // requests of the node are answered by responses recorded from the peer
+        if (!cmd.isResponse) {
+          continue;
+        }
+
+        auto it = replayConnection.pending.find(cmd.command);
+        if (it == replayConnection.pending.end() || it->second.empty()) {
+          ++unmatched.errors;
+          continue;
+        }
+
+        stats["p2p " + std::to_string(cmd.command)].samples.push_back(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - it->second.front()).count()));
+        it->second.pop_front();
+      }
+    } catch (const std::exception&) {
+      // connection closed by the node or stopped at the end of replay
+    }
+
+    replayConnection.closed = true;
+  }
+
+  // Sums of handling time histograms of the node's /metrics, "name{labels}" -> microseconds
+  std::map<std::string, double> fetchHandlingTime(HttpClient& client) {
+    std::map<std::string, double> sums;
+    HttpRequest request;
+    HttpResponse response;
+    request.setUrl("/metrics");
+    try {
+      client.request(request, response);
+    } catch (const std::exception&) {
+      return sums;
+    }
+
+    std::istringstream lines(response.getBody());
+    std::string line;
+    while (std::getline(lines, line)) {
+      size_t valuePos = line.find_last_of(' ');
+      size_t sumPos = line.find("_duration_microseconds_sum");
+      if (line.empty() || line[0] == '#' || valuePos == std::string::npos || sumPos == std::string::npos) {
+        continue;
+      }
+
+      sums[line.substr(0, valuePos)] = std::strtod(line.c_str() + valuePos + 1, nullptr);
+    }
+
+    return sums;
+  }
+
+  void printStats(const StatsMap& stats) {
+    std::cout << std::left << std::setw(32) << "request" << std::right << std::setw(10) << "count" << std::setw(10) << "errors" <<
+      std::setw(12) << "mean us" << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+    for (auto& entry : stats) {
+      std::vector<uint64_t> samples = entry.second.samples;
+      std::sort(samples.begin(), samples.end());
+      uint64_t total = 0;
+      for (uint64_t sample : samples) {
+        total += sample;
+      }
+
+      auto percentile = [&samples](size_t percent) {
+        return samples.empty() ? 0 : samples[std::min(samples.size() - 1, samples.size() * percent / 100)];
+      };
+
+      std::cout << std::left << std::setw(32) << entry.first << std::right << std::setw(10) << samples.size() <<
+        std::setw(10) << entry.second.errors << std::setw(12) << (samples.empty() ? 0 : total / samples.size()) <<
+        std::setw(12) << percentile(50) << std::setw(12) << percentile(99) << std::setw(12) << (samples.empty() ? 0 : samples.back()) << std::endl;
+    }
+  }
+
+  bool replay(const po::variables_map& vm) {
+    Common::TrafficLogReader reader;
+    std::string logPath = command_line::get_arg(vm, arg_log);
+    if (!reader.open(logPath)) {
+      std::cerr << "Failed to open traffic log " << logPath << std::endl;
+      return false;
+    }
+
+    System::Ipv4Address p2pIp(0);
+    uint16_t p2pPort = 0;
+    bool replayP2p = !command_line::get_arg(vm, arg_p2p).empty();
+    if (replayP2p && !parseAddress(command_line::get_arg(vm, arg_p2p), p2pIp, p2pPort)) {
+      std::cerr << "Wrong P2P address " << command_line::get_arg(vm, arg_p2p) << std::endl;
+      return false;
+    }
+
+    System::Ipv4Address rpcIp(0);
+    uint16_t rpcPort = 0;
+    bool replayRpc = !command_line::get_arg(vm, arg_rpc).empty();
+    if (replayRpc && !parseAddress(command_line::get_arg(vm, arg_rpc), rpcIp, rpcPort)) {
+      std::cerr << "Wrong RPC address " << command_line::get_arg(vm, arg_rpc) << std::endl;
+      return false;
+    }
+
+    double speed = command_line::get_arg(vm, arg_speed);
+    StatsMap stats;
+    LatencyStats unmatched;
+    size_t records = 0;
+
+    System::Dispatcher dispatcher;
+    System::Event contextDone(dispatcher);
+    size_t activeContexts = 0;
+    std::map<uint64_t, std::unique_ptr<ReplayConnection>> connections;
+    std::unique_ptr<HttpClient> rpcClient;
+    std::map<std::string, double> handlingTimeBefore;
+    if (replayRpc) {
+      rpcClient.reset(new HttpClient(dispatcher, rpcIp.toDottedDecimal(), rpcPort));
+      rpcClient->setMaxConnections(command_line::get_arg(vm, arg_rpc_connections));
+      handlingTimeBefore = fetchHandlingTime(*rpcClient);
+    }
+
+    auto start = Clock::now();
+    System::Timer timer(dispatcher);
+    Common::TrafficRecord record;
+    while (reader.read(record)) {
+      bool isP2p = record.kind == Common::TrafficRecord::P2P;
+      if ((isP2p && !replayP2p) || (!isP2p && !replayRpc)) {
+        continue;
+      }
+
+      if (speed > 0) {
+        auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(record.time / speed));
+        auto now = Clock::now();
+        if (due > now) {
+          timer.sleep(std::chrono::duration_cast<std::chrono::nanoseconds>(due - now));
+        }
+      }
+
+      ++records;
+      if (!isP2p) {
+        auto request = std::make_shared<HttpRequest>();
+        request->setUrl(record.url);
+        request->setBody(record.body);
+        ++activeContexts;
+        dispatcher.spawn([&, request] {
+          LatencyStats& entry = stats["rpc " + request->getUrl()];
+          HttpResponse response;
+          auto sent = Clock::now();
+          try {
+            rpcClient->request(*request, response);
+            if (response.getStatus() == HttpResponse::STATUS_200) {
+              entry.samples.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sent).count()));
+            } else {
+              ++entry.errors;
+            }
+          } catch (const std::exception&) {
+            ++entry.errors;
+          }
+
+          --activeContexts;
+          contextDone.set();
+        });
+
+        continue;
+      }
+
+      std::unique_ptr<ReplayConnection>& replayConnection = connections[record.stream];
+      if (!replayConnection) {
+        replayConnection.reset(new ReplayConnection);
+        try {
+          replayConnection->connection = System::TcpConnector(dispatcher).connect(p2pIp, p2pPort);
+        } catch (const std::exception& e) {
+          std::cerr << "Failed to connect to " << command_line::get_arg(vm, arg_p2p) << ": " << e.what() << std::endl;
+          replayConnection->closed = true;
+        }
+
+        if (!replayConnection->closed) {
+          replayConnection->levin.reset(new LevinProtocol(replayConnection->connection));
+          ReplayConnection* connection = replayConnection.get();
+          ++activeContexts;
+          dispatcher.spawn([&, connection] {
+            readResponses(*connection, unmatched, stats);
+            --activeContexts;
+            contextDone.set();
+          });
+        }
+      }
+
+      LatencyStats& entry = stats["p2p " + std::to_string(record.command)];
+      if (replayConnection->closed) {
+        ++entry.errors;
+        continue;
+      }
+
+      try {
+        if (record.flags & Common::TrafficRecord::RESPONSE) {
+          replayConnection->levin->sendReply(record.command, record.body, 1);
+        } else if (record.flags & Common::TrafficRecord::NOTIFY) {
+          replayConnection->levin->sendBuf(record.command, record.body, false);
+        } else {
+          replayConnection->pending[record.command].push_back(Clock::now());
+          replayConnection->levin->sendBuf(record.command, record.body, true);
+        }
+      } catch (const std::exception&) {
+        ++entry.errors;
+      }
+    }
+
+    if (reader.failed()) {
+      std::cerr << "Traffic log is truncated or damaged, replayed " << records << " records" << std::endl;
+    }
+
+    // RPC requests finish by themselves, P2P connections are closed once responses had time to arrive
+    timer.sleep(std::chrono::seconds(command_line::get_arg(vm, arg_drain)));
+    for (auto& entry : connections) {
+      if (!entry.second->closed) {
+        entry.second->connection.stop();
+      }
+    }
+
+    while (activeContexts != 0) {
+      contextDone.wait();
+      contextDone.clear();
+    }
+
+    for (auto& connection : connections) {
+      for (auto& pending : connection.second->pending) {
+        stats["p2p " + std::to_string(pending.first)].errors += pending.second.size();
+      }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    std::cout << "Replayed " << records << " records over " << connections.size() << " P2P connections in " << elapsed << " ms" << std::endl;
+    printStats(stats);
+    if (unmatched.errors != 0) {
+      std::cout << unmatched.errors << " P2P responses didn't match any request" << std::endl;
+    }
+
+    // handling time spent by the node itself, from its own histograms
+    if (rpcClient) {
+      std::map<std::string, double> handlingTimeAfter = fetchHandlingTime(*rpcClient);
+      std::cout << std::endl << "Node handling time, us:" << std::endl;
+      for (auto& entry : handlingTimeAfter) {
+        double spent = entry.second - handlingTimeBefore[entry.first];
+        if (spent > 0) {
+          std::cout << std::left << std::setw(72) << entry.first << std::right << std::setw(16) << static_cast<uint64_t>(spent) << std::endl;
+        }
+      }
+    }
+
+    return true;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description desc_general("General options");
+  command_line::add_arg(desc_general, command_line::arg_help);
+
+  po::options_description desc_params("Replay options");
+  command_line::add_arg(desc_params, arg_log);
+  command_line::add_arg(desc_params, arg_p2p);
+  command_line::add_arg(desc_params, arg_rpc);
+  command_line::add_arg(desc_params, arg_speed);
+  command_line::add_arg(desc_params, arg_drain);
+  command_line::add_arg(desc_params, arg_rpc_connections);
+
+  po::options_description desc_all;
+  desc_all.add(desc_general).add(desc_params);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_all, [&]() {
+    po::store(command_line::parse_command_line(argc, argv, desc_general, true), vm);
+    if (command_line::get_arg(vm, command_line::arg_help)) {
+      std::cout << desc_all << std::endl;
+      return false;
+    }
+
+    po::store(command_line::parse_command_line(argc, argv, desc_params, false), vm);
+    po::notify(vm);
+    return true;
+  });
+
+  if (!r) {
+    return 1;
+  }
+
+  try {
+    return replay(vm) ? 0 : 1;
+  } catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
+}
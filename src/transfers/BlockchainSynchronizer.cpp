@@ -25,6 +25,11 @@
 
 namespace {
 
+// Raw size of blocks and transactions parsed and handed to consumers at once
+const size_t PROCESSING_CHUNK_SIZE_LIMIT = 4 * 1024 * 1024;
+// Blocks from an in-process node come without blobs, their transactions are counted at a typical size instead
+const size_t PARSED_TRANSACTION_SIZE_ESTIMATE = 2 * 1024;
+
 inline std::vector<uint8_t> stringToVector(const std::string& s) {
   std::vector<uint8_t> vec(
     reinterpret_cast<const uint8_t*>(s.data()),
@@ -167,6 +172,8 @@ void BlockchainSynchronizer::workingProcedure() {
   }
 
   actualizeFutureState();
+  // output of the query refers to the synchronizer, it has to complete before the thread exits
+  waitPrefetchedBlocks();
 }
 
 void BlockchainSynchronizer::start() {
@@ -254,7 +261,7 @@ BlockchainSynchronizer::GetPoolRequest BlockchainSynchronizer::getIntersectedPoo
   return request;
 }
 
-BlockchainSynchronizer::GetBlocksRequest BlockchainSynchronizer::getCommonHistory() {
+BlockchainSynchronizer::GetBlocksRequest BlockchainSynchronizer::getCommonHistory(const BlockchainInterval* pendingBlocks) {
   GetBlocksRequest request;
   std::unique_lock<std::mutex> lk(m_consumersMutex);
   if (m_consumers.empty()) {
@@ -275,39 +282,106 @@ BlockchainSynchronizer::GetBlocksRequest BlockchainSynchronizer::getCommonHistor
     syncStart.height = std::min(syncStart.height, consumerStart.height);
   }
 
-  request.knownBlocks = shortest->second->getShortHistory(m_node.getLastLocalBlockHeight());
+  if (pendingBlocks) {
+    // the blocks are applied to a copy of the state the way updateConsumers does it
+    SynchronizationState state(*shortest->second);
+    auto result = state.checkInterval(*pendingBlocks);
+    if (result.detachRequired) {
+      state.detach(result.detachHeight);
+    }
+
+    if (result.hasNewBlocks) {
+      size_t startOffset = result.newBlockHeight - pendingBlocks->startHeight;
+      state.addBlocks(pendingBlocks->blocks.data() + startOffset, result.newBlockHeight, pendingBlocks->blocks.size() - startOffset);
+    }
+
+    request.knownBlocks = state.getShortHistory(m_node.getLastLocalBlockHeight());
+  } else {
+    request.knownBlocks = shortest->second->getShortHistory(m_node.getLastLocalBlockHeight());
+  }
+
   request.syncStart = syncStart;
   return request;
 }
 
-void BlockchainSynchronizer::startBlockchainSync() {
-  GetBlocksResponse response;
-  GetBlocksRequest req = getCommonHistory();
+std::unique_ptr<BlockchainSynchronizer::BlocksQuery> BlockchainSynchronizer::queryBlocks(const GetBlocksRequest& request,
+  std::list<crypto::hash>&& knownBlocks, uint64_t expectedStartHeight) {
+  std::unique_ptr<BlocksQuery> query(new BlocksQuery());
+  query->request = request;
+  query->expectedStartHeight = expectedStartHeight;
+  query->completion = NodeFutures(m_node).queryBlocks(std::move(knownBlocks), request.syncStart.timestamp);
+  return query;
+}
 
+void BlockchainSynchronizer::waitPrefetchedBlocks() {
+  if (m_prefetchedBlocks) {
+    m_prefetchedBlocks->completion.wait();
+    m_prefetchedBlocks.reset();
+  }
+}
+
+void BlockchainSynchronizer::startBlockchainSync() {
   try {
-    if (!req.knownBlocks.empty()) {
-      asyncOperationCompleted = std::promise<std::error_code>();
-      asyncOperationWaitFuture = asyncOperationCompleted.get_future();
+    std::unique_ptr<BlocksQuery> query = std::move(m_prefetchedBlocks);
+    NodeResult<GetBlocksResponse> result;
+    if (query) {
+      result = query->completion.get();
+      // the node has switched to another chain meanwhile, blocks are queried again from the consumers' history
+      if (!result.error && result.value.startHeight != query->expectedStartHeight) {
+        query.reset();
+      }
+    }
 
-      m_node.queryBlocks(std::move(req.knownBlocks), req.syncStart.timestamp, response.newBlocks, response.startHeight,
-        std::bind(&BlockchainSynchronizer::onGetBlocksCompleted, this, std::placeholders::_1));
+    if (!query) {
+      GetBlocksRequest req = getCommonHistory(nullptr);
+      if (req.knownBlocks.empty()) {
+        return;
+      }
 
-      std::error_code ec = asyncOperationWaitFuture.get();
+      std::list<crypto::hash> knownBlocks = req.knownBlocks;
+      query = queryBlocks(req, std::move(knownBlocks), 0);
+      result = query->completion.get();
+    }
 
-      if (ec) {
-        setFutureStateIf(State::idle, std::bind(
-          [](State futureState) -> bool {
-          return futureState != State::stopped;
-        }, std::ref(m_futureState)));
-        m_observerManager.notify(
-          &IBlockchainSynchronizerObserver::synchronizationCompleted,
-          ec);
-      } else {
-        processBlocks(response);
+    std::error_code ec = result.error;
+    if (ec) {
+      setFutureStateIf(State::idle, std::bind(
+        [](State futureState) -> bool {
+        return futureState != State::stopped;
+      }, std::ref(m_futureState)));
+      m_observerManager.notify(
+        &IBlockchainSynchronizerObserver::synchronizationCompleted,
+        ec);
+    } else {
+      GetBlocksResponse& response = result.value;
+      // the next batch starts with the last block of this one, it is downloaded while this one is processed. It is
+      // requested with the history the consumers will have then, the same one a query after this batch would send
+      if (response.newBlocks.size() > 1 && !checkIfShouldStop()) {
+        BlockchainInterval interval;
+        interval.startHeight = response.startHeight;
+        for (const auto& block : response.newBlocks) {
+          interval.blocks.push_back(block.blockHash);
+        }
+
+        GetBlocksRequest req = getCommonHistory(&interval);
+        if (!req.knownBlocks.empty()) {
+          std::list<crypto::hash> knownBlocks = req.knownBlocks;
+          m_prefetchedBlocks = queryBlocks(req, std::move(knownBlocks), response.startHeight + response.newBlocks.size() - 1);
+        }
+      }
+
+      processBlocks(response);
+
+      std::unique_lock<std::mutex> lk(m_stateMutex);
+      bool continueSync = m_futureState == State::blockchainSync;
+      lk.unlock();
+      if (!continueSync) {
+        waitPrefetchedBlocks();
       }
     }
   } catch (std::exception& e) {
     std::cout << e.what() << std::endl;
+    waitPrefetchedBlocks();
     setFutureStateIf(State::idle, std::bind(
       [](State futureState) -> bool {
       return futureState != State::stopped;
@@ -318,67 +392,96 @@ void BlockchainSynchronizer::startBlockchainSync() {
   }
 }
 
-void BlockchainSynchronizer::onGetBlocksCompleted(std::error_code ec) {
-  decltype(asyncOperationCompleted) detachedPromise = std::move(asyncOperationCompleted);
-  detachedPromise.set_value(ec);
-}
-
 void BlockchainSynchronizer::processBlocks(GetBlocksResponse& response) {
-  auto newHeight = response.startHeight + response.newBlocks.size();
-  BlockchainInterval interval;
-  interval.startHeight = response.startHeight;
-  std::vector<CompleteBlock> blocks;
-
-  // parse blocks
-  for (const auto& block : response.newBlocks) {
-    if (checkIfShouldStop()) {
-      break;
-    }
-    CompleteBlock completeBlock;
-    completeBlock.blockHash = block.blockHash;
-    interval.blocks.push_back(completeBlock.blockHash);
-    if (!block.block.empty()) {
-      Block parsedBlock;
-      if (!parse_and_validate_block_from_blob(block.block, parsedBlock)) {
-        setFutureStateIf(State::idle, std::bind(
-          [](State futureState) -> bool {
-          return futureState != State::stopped;
-        }, std::ref(m_futureState)));
-        m_observerManager.notify(
-          &IBlockchainSynchronizerObserver::synchronizationCompleted,
-          std::make_error_code(std::errc::invalid_argument));
-        return;
+  uint64_t chunkStartHeight = response.startHeight;
+
+  // blocks are parsed, handed to consumers and released in chunks, so memory taken by a batch of full blocks and
+  // transactions preprocessed by consumers stays within the budget however large the blocks are
+  while (!response.newBlocks.empty() && !checkIfShouldStop()) {
+    BlockchainInterval interval;
+    interval.startHeight = chunkStartHeight;
+    std::vector<CompleteBlock> blocks;
+    size_t chunkSize = 0;
+
+    // parse blocks
+    while (!response.newBlocks.empty() && chunkSize < PROCESSING_CHUNK_SIZE_LIMIT) {
+      if (checkIfShouldStop()) {
+        break;
       }
 
-      completeBlock.block = std::move(parsedBlock);
+      BlockCompleteEntry& block = response.newBlocks.front();
+      CompleteBlock completeBlock;
+      completeBlock.blockHash = block.blockHash;
+      interval.blocks.push_back(completeBlock.blockHash);
+      if (block.parsedBlock) {
+        // in-process node, objects are taken over as they are
+        chunkSize += (block.parsedTxs.size() + 1) * PARSED_TRANSACTION_SIZE_ESTIMATE;
+        completeBlock.block = std::move(*block.parsedBlock);
+        completeBlock.transactions.push_back(createTransaction(completeBlock.block->minerTx));
+
+        // hashes from the block save serializing transactions to compute them, unless the node missed some
+        const auto& txHashes = completeBlock.block->txHashes;
+        bool knownHashes = block.parsedTxs.size() == txHashes.size();
+        auto hashIt = txHashes.begin();
+        for (auto& tx : block.parsedTxs) {
+          if (knownHashes) {
+            completeBlock.transactions.push_back(createTransaction(std::move(tx), *hashIt++));
+          } else {
+            completeBlock.transactions.push_back(createTransaction(tx));
+          }
+        }
+      } else if (!block.block.empty()) {
+        chunkSize += block.block.size();
+        Block parsedBlock;
+        if (!parse_and_validate_block_from_blob(block.block, parsedBlock)) {
+          setFutureStateIf(State::idle, std::bind(
+            [](State futureState) -> bool {
+            return futureState != State::stopped;
+          }, std::ref(m_futureState)));
+          m_observerManager.notify(
+            &IBlockchainSynchronizerObserver::synchronizationCompleted,
+            std::make_error_code(std::errc::invalid_argument));
+          return;
+        }
+
+        completeBlock.block = std::move(parsedBlock);
 
-      completeBlock.transactions.push_back(createTransaction(completeBlock.block->minerTx));
+        completeBlock.transactions.push_back(createTransaction(completeBlock.block->minerTx));
 
-      try {
-        for (const auto& txblob : block.txs) {
-          completeBlock.transactions.push_back(createTransaction(stringToVector(txblob)));
+        try {
+          for (const auto& txblob : block.txs) {
+            chunkSize += txblob.size();
+            completeBlock.transactions.push_back(createTransaction(stringToVector(txblob)));
+          }
+        } catch (std::exception &) {
+          setFutureStateIf(State::idle, std::bind(
+            [](State futureState) -> bool {
+            return futureState != State::stopped;
+          }, std::ref(m_futureState)));
+          m_observerManager.notify(
+            &IBlockchainSynchronizerObserver::synchronizationCompleted,
+            std::make_error_code(std::errc::invalid_argument));
+          return;
         }
-      } catch (std::exception &) {
-        setFutureStateIf(State::idle, std::bind(
-          [](State futureState) -> bool {
-          return futureState != State::stopped;
-        }, std::ref(m_futureState)));
-        m_observerManager.notify(
-          &IBlockchainSynchronizerObserver::synchronizationCompleted,
-          std::make_error_code(std::errc::invalid_argument));
-        return;
       }
+
+      blocks.push_back(std::move(completeBlock));
+      response.newBlocks.pop_front();
     }
 
-    blocks.push_back(std::move(completeBlock));
-  }
+    if (checkIfShouldStop()) {
+      break;
+    }
 
-  if (!checkIfShouldStop()) {
-    response.newBlocks.clear();
+    chunkStartHeight += blocks.size();
     std::unique_lock<std::mutex> lk(m_consumersMutex);
     auto result = updateConsumers(interval, blocks);
     lk.unlock();
 
+    if (!blocks.empty()) {
+      lastBlockId = blocks.back().blockHash;
+    }
+
     switch (result) {
     case UpdateConsumersResult::errorOccured:
       if (setFutureStateIf(State::idle, std::bind(
@@ -390,8 +493,13 @@ void BlockchainSynchronizer::processBlocks(GetBlocksResponse& response) {
           std::make_error_code(std::errc::invalid_argument));
       }
 
-      break;
+      return;
     case UpdateConsumersResult::nothingChanged:
+      // consumers already have the rest of the batch, wait for the node to download more
+      if (!response.newBlocks.empty()) {
+        break;
+      }
+
       if (m_node.getLastKnownBlockHeight() != m_node.getLastLocalBlockHeight()) {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
       } else {
@@ -401,14 +509,10 @@ void BlockchainSynchronizer::processBlocks(GetBlocksResponse& response) {
       setFutureState(State::blockchainSync);
       m_observerManager.notify(
         &IBlockchainSynchronizerObserver::synchronizationProgressUpdated,
-        newHeight,
+        chunkStartHeight,
         std::max(m_node.getKnownBlockCount(), m_node.getLocalBlockCount()));
       break;
     }
-
-    if (!blocks.empty()) {
-      lastBlockId = blocks.back().blockHash;
-    }
   }
 
   if (checkIfShouldStop()) { //Sic!
@@ -452,18 +556,25 @@ BlockchainSynchronizer::UpdateConsumersResult BlockchainSynchronizer::updateCons
 }
 
 void BlockchainSynchronizer::startPoolSync() {
-  GetPoolResponse unionResponse;
+  NodeFutures node(m_node);
   GetPoolRequest unionRequest = getUnionPoolHistory();
+  std::future<NodeResult<GetPoolResponse>> unionQuery = node.getPoolSymmetricDifference(std::move(unionRequest.knownTxIds), unionRequest.lastKnownBlock);
 
-  asyncOperationCompleted = std::promise<std::error_code>();
-  asyncOperationWaitFuture = asyncOperationCompleted.get_future();
-
-  unionResponse.isLastKnownBlockActual = false;
+  // on first launch consumers' pools are synced from the intersection of their histories, it is queried along with the union
+  std::future<NodeResult<GetPoolResponse>> intersectionQuery;
+  if (shouldSyncConsumersPool) {
+    GetPoolRequest intersectionRequest = getIntersectedPoolHistory();
+    intersectionQuery = node.getPoolSymmetricDifference(std::move(intersectionRequest.knownTxIds), intersectionRequest.lastKnownBlock);
+  }
 
-  m_node.getPoolSymmetricDifference(std::move(unionRequest.knownTxIds), std::move(unionRequest.lastKnownBlock), unionResponse.isLastKnownBlockActual,
-    unionResponse.newTxs, unionResponse.deletedTxIds, std::bind(&BlockchainSynchronizer::onGetPoolChanges, this, std::placeholders::_1));
+  NodeResult<GetPoolResponse> unionResult = unionQuery.get();
+  NodeResult<GetPoolResponse> intersectionResult;
+  if (intersectionQuery.valid()) {
+    intersectionResult = intersectionQuery.get();
+  }
 
-  std::error_code ec = asyncOperationWaitFuture.get();
+  GetPoolResponse& unionResponse = unionResult.value;
+  std::error_code ec = unionResult.error;
 
   if (ec) {
     setFutureStateIf(State::idle, std::bind(
@@ -481,19 +592,9 @@ void BlockchainSynchronizer::startPoolSync() {
         m_observerManager.notify(
           &IBlockchainSynchronizerObserver::synchronizationCompleted,
           processPoolTxs(unionResponse));
-      } else {// first launch, we should sync consumers' pools, so let's ask for intersection
-        GetPoolResponse intersectionResponse;
-        GetPoolRequest intersectionRequest = getIntersectedPoolHistory();
-
-        asyncOperationCompleted = std::promise<std::error_code>();
-        asyncOperationWaitFuture = asyncOperationCompleted.get_future();
-
-        intersectionResponse.isLastKnownBlockActual = false;
-
-        m_node.getPoolSymmetricDifference(std::move(intersectionRequest.knownTxIds), std::move(intersectionRequest.lastKnownBlock), intersectionResponse.isLastKnownBlockActual,
-          intersectionResponse.newTxs, intersectionResponse.deletedTxIds, std::bind(&BlockchainSynchronizer::onGetPoolChanges, this, std::placeholders::_1));
-
-        std::error_code ec2 = asyncOperationWaitFuture.get();
+      } else {// first launch, we should sync consumers' pools, so let's use the intersection
+        GetPoolResponse& intersectionResponse = intersectionResult.value;
+        std::error_code ec2 = intersectionResult.error;
 
         if (ec2) {
           setFutureStateIf(State::idle, std::bind(
@@ -525,11 +626,6 @@ void BlockchainSynchronizer::startPoolSync() {
   }
 }
 
-void BlockchainSynchronizer::onGetPoolChanges(std::error_code ec) {
-  decltype(asyncOperationCompleted) detachedPromise = std::move(asyncOperationCompleted);
-  detachedPromise.set_value(ec);
-}
-
 std::error_code BlockchainSynchronizer::processPoolTxs(GetPoolResponse& response) {
   std::error_code error;
   {
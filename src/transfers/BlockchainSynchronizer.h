@@ -18,6 +18,7 @@
 #pragma once
 
 #include "INode.h"
+#include "NodeFutures.h"
 #include "SynchronizationState.h"
 #include "IBlockchainSynchronizer.h"
 #include "IObservableImpl.h"
@@ -56,10 +57,7 @@ public:
 
 private:
 
-  struct GetBlocksResponse {
-    uint64_t startHeight;
-    std::list<BlockCompleteEntry> newBlocks;
-  };
+  typedef QueriedBlocks GetBlocksResponse;
 
   struct GetBlocksRequest {
     GetBlocksRequest() {
@@ -70,12 +68,15 @@ private:
     std::list<crypto::hash> knownBlocks;
   };
 
-  struct GetPoolResponse {
-    bool isLastKnownBlockActual;
-    std::vector<Transaction> newTxs;
-    std::vector<crypto::hash> deletedTxIds;
+  // queryBlocks call in flight with its output, request keeps the consumers' history the query was started from
+  struct BlocksQuery {
+    GetBlocksRequest request;
+    uint64_t expectedStartHeight;
+    std::future<NodeResult<GetBlocksResponse>> completion;
   };
 
+  typedef PoolDifference GetPoolResponse;
+
   struct GetPoolRequest {
     std::vector<crypto::hash> knownTxIds;
     crypto::hash lastKnownBlock;
@@ -99,10 +100,10 @@ private:
   void startPoolSync();
   void startBlockchainSync();
 
-  void onGetBlocksCompleted(std::error_code ec);
+  std::unique_ptr<BlocksQuery> queryBlocks(const GetBlocksRequest& request, std::list<crypto::hash>&& knownBlocks, uint64_t expectedStartHeight);
+  void waitPrefetchedBlocks();
   void processBlocks(GetBlocksResponse& response);
   UpdateConsumersResult updateConsumers(const BlockchainInterval& interval, const std::vector<CompleteBlock>& blocks);
-  void onGetPoolChanges(std::error_code ec);
   std::error_code processPoolTxs(GetPoolResponse& response);
   
   ///second parameter is used only in case of errors returned into callback from INode, such as aborted or connection lost
@@ -115,7 +116,8 @@ private:
 
   void workingProcedure();
 
-  GetBlocksRequest getCommonHistory();
+  // pendingBlocks, if set, are counted as already added to the consumers, the next batch is requested with it
+  GetBlocksRequest getCommonHistory(const BlockchainInterval* pendingBlocks);
   GetPoolRequest getUnionPoolHistory();
   GetPoolRequest getIntersectedPoolHistory();
 
@@ -132,8 +134,8 @@ private:
   State m_futureState;
   std::unique_ptr<std::thread> workingThread;
 
-  std::future<std::error_code> asyncOperationWaitFuture;
-  std::promise<std::error_code> asyncOperationCompleted;
+  // next batch of blocks, requested while the previous one is processed
+  std::unique_ptr<BlocksQuery> m_prefetchedBlocks;
 
   std::mutex m_consumersMutex;
   std::mutex m_stateMutex;
@@ -20,26 +20,43 @@
 #include "serialization/BinaryInputStreamSerializer.h"
 #include "serialization/BinaryOutputStreamSerializer.h"
 #include "cryptonote_core/cryptonote_serialization.h"
+#include "serialization/SerializationOverloads.h"
 
 namespace CryptoNote {
 
+namespace {
+// Hashes of this many last blocks at least are all kept, the tail is trimmed when it gets twice as long
+const uint64_t TAIL_SIZE = 1024;
+const uint64_t SPARSE_INTERVAL = 128;
+const uint32_t SYNCHRONIZATION_STATE_VERSION = 1;
+}
+
 SynchronizationState::ShortHistory SynchronizationState::getShortHistory(size_t localHeight) const {
 
   ShortHistory history;
   size_t i = 0;
   size_t current_multiplier = 1;
-  size_t sz = std::min(m_blockchain.size(), localHeight + 1);
+  uint64_t sz = std::min<uint64_t>(getHeight(), localHeight + 1);
 
   if (!sz)
     return history;
 
   size_t current_back_offset = 1;
   bool genesis_included = false;
+  // heights below the tail are rounded down to kept ones, each of them is added once
+  uint64_t lastHeight = sz;
+  crypto::hash hash;
 
   while (current_back_offset < sz) {
-    history.push_back(m_blockchain[sz - current_back_offset]);
-    if (sz - current_back_offset == 0)
-      genesis_included = true;
+    uint64_t height = getKeptHeight(sz - current_back_offset);
+    if (height < lastHeight) {
+      getHash(height, hash);
+      history.push_back(hash);
+      lastHeight = height;
+      if (height == 0)
+        genesis_included = true;
+    }
+
     if (i < 10) {
       ++current_back_offset;
     } else {
@@ -48,26 +65,38 @@ SynchronizationState::ShortHistory SynchronizationState::getShortHistory(size_t
     ++i;
   }
 
-  if (!genesis_included)
-    history.push_back(m_blockchain[0]);
+  if (!genesis_included) {
+    getHash(0, hash);
+    history.push_back(hash);
+  }
 
   return history;
 }
 
+// A block differs from the stored one if any block above it does, so the chain is detached right above the last
+// kept hash that matches
 SynchronizationState::CheckResult SynchronizationState::checkInterval(const BlockchainInterval& interval) const {
-  assert(interval.startHeight <= m_blockchain.size());
+  assert(interval.startHeight <= getHeight());
 
   CheckResult result = { false, 0, false, 0 };
 
-  size_t intervalEnd = interval.startHeight + interval.blocks.size();
-  size_t iterationEnd = std::min(m_blockchain.size(), intervalEnd);
+  uint64_t intervalEnd = interval.startHeight + interval.blocks.size();
+  uint64_t iterationEnd = std::min(getHeight(), intervalEnd);
+  uint64_t firstUnchecked = interval.startHeight;
+
+  for (uint64_t i = interval.startHeight; i < iterationEnd; ++i) {
+    crypto::hash hash;
+    if (!getHash(i, hash)) {
+      continue;
+    }
 
-  for (size_t i = interval.startHeight; i < iterationEnd; ++i) {
-    if (m_blockchain[i] != interval.blocks[i - interval.startHeight]) {
+    if (hash != interval.blocks[i - interval.startHeight]) {
       result.detachRequired = true;
-      result.detachHeight = i;
+      result.detachHeight = firstUnchecked;
       break;
     }
+
+    firstUnchecked = i + 1;
   }
 
   if (result.detachRequired) {
@@ -76,28 +105,68 @@ SynchronizationState::CheckResult SynchronizationState::checkInterval(const Bloc
     return result;
   }
 
-  if (intervalEnd > m_blockchain.size()) {
+  if (intervalEnd > getHeight()) {
     result.hasNewBlocks = true;
-    result.newBlockHeight = m_blockchain.size();
+    result.newBlockHeight = getHeight();
   }
 
   return result;
 }
 
 void SynchronizationState::detach(uint64_t height) {
-  assert(height < m_blockchain.size());
-  m_blockchain.resize(height);
+  assert(height < getHeight());
+  if (height >= m_tailStart) {
+    m_tail.resize(height - m_tailStart);
+  } else {
+    m_tail.clear();
+    m_tailStart = height;
+    m_sparse.resize((height + SPARSE_INTERVAL - 1) / SPARSE_INTERVAL);
+  }
 }
 
 void SynchronizationState::addBlocks(const crypto::hash* blockHashes, uint64_t height, size_t count) {
   assert(blockHashes);
-  auto size = m_blockchain.size();
-  assert( size == height);
-  m_blockchain.insert(m_blockchain.end(), blockHashes, blockHashes + count);
+  assert(getHeight() == height);
+  m_tail.insert(m_tail.end(), blockHashes, blockHashes + count);
+  trimTail();
 }
 
 uint64_t SynchronizationState::getHeight() const {
-  return m_blockchain.size();
+  return m_tailStart + m_tail.size();
+}
+
+bool SynchronizationState::getHash(uint64_t height, crypto::hash& hash) const {
+  if (height >= m_tailStart) {
+    hash = m_tail[height - m_tailStart];
+    return true;
+  }
+
+  if (height % SPARSE_INTERVAL != 0) {
+    return false;
+  }
+
+  hash = m_sparse[height / SPARSE_INTERVAL];
+  return true;
+}
+
+uint64_t SynchronizationState::getKeptHeight(uint64_t height) const {
+  return height >= m_tailStart ? height : height - height % SPARSE_INTERVAL;
+}
+
+void SynchronizationState::trimTail() {
+  if (m_tail.size() < 2 * TAIL_SIZE) {
+    return;
+  }
+
+  size_t count = m_tail.size() - TAIL_SIZE;
+  for (size_t i = 0; i < count; ++i) {
+    if ((m_tailStart + i) % SPARSE_INTERVAL == 0) {
+      m_sparse.push_back(m_tail[i]);
+    }
+  }
+
+  m_tail.erase(m_tail.begin(), m_tail.begin() + count);
+  m_tailStart += count;
 }
 
 void SynchronizationState::save(std::ostream& os) {
@@ -110,9 +179,32 @@ void SynchronizationState::load(std::istream& in) {
   serialize(s, "state");
 }
 
+// State used to be the full list of hashes, it always has the genesis one. An empty list is stored in its place, so
+// a stored full list is told apart and converted on load.
 CryptoNote::ISerializer& SynchronizationState::serialize(CryptoNote::ISerializer& s, const std::string& name) {
   s.beginObject(name);
-  s(m_blockchain, "blockchain");
+  std::vector<crypto::hash> blockchain;
+  s(blockchain, "blockchain");
+  if (s.type() == CryptoNote::ISerializer::INPUT && !blockchain.empty()) {
+    m_tail = std::move(blockchain);
+    m_tailStart = 0;
+    m_sparse.clear();
+    trimTail();
+  } else {
+    uint32_t version = SYNCHRONIZATION_STATE_VERSION;
+    s(version, "version");
+    if (version != SYNCHRONIZATION_STATE_VERSION) {
+      throw std::runtime_error("SynchronizationState version mismatch");
+    }
+
+    s(m_tailStart, "tail_start");
+    serializeAsBinary(m_tail, "tail", s);
+    serializeAsBinary(m_sparse, "sparse", s);
+    if (s.type() == CryptoNote::ISerializer::INPUT && m_sparse.size() != (m_tailStart + SPARSE_INTERVAL - 1) / SPARSE_INTERVAL) {
+      throw std::runtime_error("Invalid synchronization state");
+    }
+  }
+
   s.endObject();
   return s;
 }
@@ -25,6 +25,8 @@
 
 namespace CryptoNote {
 
+// Block hashes the consumer has processed. Hashes of the last thousand or so blocks are all kept, below them only
+// every 128th one is, which is enough to find where the chain forked for the short history and the interval check.
 class SynchronizationState : public IStreamSerializable {
 public:
 
@@ -37,8 +39,8 @@ public:
 
   typedef std::list<crypto::hash> ShortHistory;
 
-  explicit SynchronizationState(const crypto::hash& genesisBlockHash) {
-    m_blockchain.push_back(genesisBlockHash);
+  explicit SynchronizationState(const crypto::hash& genesisBlockHash) : m_tailStart(0) {
+    m_tail.push_back(genesisBlockHash);
   }
 
   ShortHistory getShortHistory(size_t localHeight) const;
@@ -57,7 +59,17 @@ public:
 
 private:
 
-  std::vector<crypto::hash> m_blockchain;
+  // Returns false if the hash at this height is not kept
+  bool getHash(uint64_t height, crypto::hash& hash) const;
+  // Highest height not above the given one which has its hash kept
+  uint64_t getKeptHeight(uint64_t height) const;
+  void trimTail();
+
+  // hashes of heights from m_tailStart
+  std::vector<crypto::hash> m_tail;
+  uint64_t m_tailStart;
+  // hashes of heights multiple of the sparse interval below m_tailStart
+  std::vector<crypto::hash> m_sparse;
 };
 
 }
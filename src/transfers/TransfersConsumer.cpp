@@ -18,53 +18,40 @@
 #include "TransfersConsumer.h"
 #include "CommonTypes.h"
 
-#include "Common/BlockingQueue.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "cryptonote_core/TransactionApi.h"
 
 #include "IWallet.h"
 #include "INode.h"
+#include "NodeFutures.h"
+#include <algorithm>
+#include <atomic>
 #include <future>
+#include <memory>
 
 namespace {
 
 using namespace CryptoNote;
 
-void checkOutputKey(
-  const crypto::key_derivation& derivation,
-  const PublicKey& key,
-  size_t keyIndex,
-  size_t outputIndex,
-  const std::unordered_set<PublicKey>& spendKeys,
-  std::unordered_map<PublicKey, std::vector<uint32_t>>& outputs) {
-
-  PublicKey spendKey;
-  crypto::underive_public_key(derivation, keyIndex,
-    reinterpret_cast<const crypto::public_key&>(key),
-    reinterpret_cast<crypto::public_key&>(spendKey));
-
-  if (spendKeys.find(spendKey) != spendKeys.end()) {
-    outputs[spendKey].push_back(static_cast<uint32_t>(outputIndex));
-  }
-
-}
+struct ScannedViewKey {
+  PublicKey publicKey;
+  const std::unordered_set<PublicKey>* spendKeys;
+};
 
 void findMyOutputs(
   const ITransactionReader& tx,
-  const SecretKey& viewSecretKey,
-  const std::unordered_set<PublicKey>& spendKeys,
-  std::unordered_map<PublicKey, std::vector<uint32_t>>& outputs) {
+  const std::vector<ScannedViewKey>& viewKeys,
+  const std::vector<crypto::secret_key>& viewSecretKeys,
+  std::unordered_map<AccountAddress, std::vector<uint32_t>>& outputs) {
 
-  auto txPublicKey = tx.getTransactionPublicKey();
-  crypto::key_derivation derivation;
-
-  if (!crypto::generate_key_derivation(
-    reinterpret_cast<const crypto::public_key&>(txPublicKey),
-    reinterpret_cast<const crypto::secret_key&>(viewSecretKey), 
-    derivation)) {
+  if (viewKeys.empty()) {
     return;
   }
 
+  // all output keys are underived at once, it is cheaper than one by one
+  std::vector<crypto::public_key> keys;
+  std::vector<size_t> keyIndexes;
+  std::vector<uint32_t> outputIndexes;
   size_t keyIndex = 0;
   size_t outputCount = tx.getOutputCount();
 
@@ -76,7 +63,9 @@ void findMyOutputs(
 
       TransactionTypes::OutputKey out;
       tx.getOutput(idx, out);
-      checkOutputKey(derivation, out.key, keyIndex, idx, spendKeys, outputs);
+      keys.push_back(reinterpret_cast<const crypto::public_key&>(out.key));
+      keyIndexes.push_back(keyIndex);
+      outputIndexes.push_back(static_cast<uint32_t>(idx));
       ++keyIndex;
 
     } else if (outType == TransactionTypes::OutputType::Multisignature) {
@@ -84,32 +73,99 @@ void findMyOutputs(
       TransactionTypes::OutputMultisignature out;
       tx.getOutput(idx, out);
       for (const auto& key : out.keys) {
-        checkOutputKey(derivation, key, idx, idx, spendKeys, outputs);
+        keys.push_back(reinterpret_cast<const crypto::public_key&>(key));
+        keyIndexes.push_back(idx);
+        outputIndexes.push_back(static_cast<uint32_t>(idx));
         ++keyIndex;
       }
     }
   }
+
+  if (keys.empty()) {
+    return;
+  }
+
+  // transaction key is decompressed once for all view keys
+  auto txPublicKey = tx.getTransactionPublicKey();
+  std::vector<crypto::key_derivation> derivations(viewKeys.size());
+  if (!crypto::generate_key_derivations(reinterpret_cast<const crypto::public_key&>(txPublicKey),
+    viewSecretKeys.data(), viewSecretKeys.size(), derivations.data())) {
+    return;
+  }
+
+  std::vector<crypto::public_key> candidates(keys.size());
+  std::unique_ptr<bool[]> valid(new bool[keys.size()]);
+
+  for (size_t viewKeyIndex = 0; viewKeyIndex < viewKeys.size(); ++viewKeyIndex) {
+    const crypto::key_derivation& derivation = derivations[viewKeyIndex];
+    const std::unordered_set<PublicKey>& spendKeys = *viewKeys[viewKeyIndex].spendKeys;
+    AccountAddress address;
+    address.viewPublicKey = viewKeys[viewKeyIndex].publicKey;
+
+    if (spendKeys.size() == 1) {
+      // comparing with keys derived from the only spend key saves decompression of every output key
+      address.spendPublicKey = *spendKeys.begin();
+      if (!crypto::derive_public_keys(derivation, keyIndexes.data(), keyIndexes.size(),
+        reinterpret_cast<const crypto::public_key&>(address.spendPublicKey), candidates.data())) {
+        continue;
+      }
+
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if (candidates[i] == keys[i]) {
+          outputs[address].push_back(outputIndexes[i]);
+        }
+      }
+
+      continue;
+    }
+
+    crypto::underive_public_keys(derivation, keyIndexes.data(), keys.data(), keys.size(), candidates.data(), valid.get());
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+      address.spendPublicKey = reinterpret_cast<const PublicKey&>(candidates[i]);
+      if (valid[i] && spendKeys.find(address.spendPublicKey) != spendKeys.end()) {
+        outputs[address].push_back(outputIndexes[i]);
+      }
+    }
+  }
 }
 
 }
 
 namespace CryptoNote {
 
-TransfersConsumer::TransfersConsumer(const CryptoNote::Currency& currency, INode& node, const SecretKey& viewSecret) :
-  m_node(node), m_viewSecret(viewSecret), m_currency(currency) {
+TransfersConsumer::TransfersConsumer(const CryptoNote::Currency& currency, INode& node, const SecretKey& viewSecret,
+  Common::ThreadPool& scanningPool) :
+  m_node(node), m_singleViewKey(true), m_viewSecret(viewSecret), m_currency(currency), m_scanningPool(scanningPool) {
+  updateSyncStart();
+}
+
+TransfersConsumer::TransfersConsumer(const CryptoNote::Currency& currency, INode& node, Common::ThreadPool& scanningPool) :
+  m_node(node), m_singleViewKey(false), m_viewSecret(), m_currency(currency), m_scanningPool(scanningPool) {
   updateSyncStart();
 }
 
 ITransfersSubscription& TransfersConsumer::addSubscription(const AccountSubscription& subscription) {
-  if (subscription.keys.viewSecretKey != m_viewSecret) {
+  if (m_singleViewKey && subscription.keys.viewSecretKey != m_viewSecret) {
     throw std::runtime_error("TransfersConsumer: view secret key mismatch");
   }
 
-  auto& res = m_subscriptions[subscription.keys.address.spendPublicKey];
+  const AccountAddress& address = subscription.keys.address;
+  auto& res = m_subscriptions[address];
 
   if (res.get() == nullptr) {
     res.reset(new TransfersSubscription(m_currency, subscription));
-    m_spendKeys.insert(subscription.keys.address.spendPublicKey);
+
+    auto it = m_viewKeyIndexes.find(address.viewPublicKey);
+    if (it == m_viewKeyIndexes.end()) {
+      ViewKey viewKey;
+      viewKey.publicKey = address.viewPublicKey;
+      viewKey.secretKey = subscription.keys.viewSecretKey;
+      m_viewKeys.push_back(std::move(viewKey));
+      it = m_viewKeyIndexes.emplace(address.viewPublicKey, m_viewKeys.size() - 1).first;
+    }
+
+    m_viewKeys[it->second].spendKeys.insert(address.spendPublicKey);
     updateSyncStart();
   }
 
@@ -117,14 +173,29 @@ ITransfersSubscription& TransfersConsumer::addSubscription(const AccountSubscrip
 }
 
 bool TransfersConsumer::removeSubscription(const AccountAddress& address) {
-  m_subscriptions.erase(address.spendPublicKey);
-  m_spendKeys.erase(address.spendPublicKey);
+  if (m_subscriptions.erase(address) != 0) {
+    auto it = m_viewKeyIndexes.find(address.viewPublicKey);
+    assert(it != m_viewKeyIndexes.end());
+    size_t index = it->second;
+    m_viewKeys[index].spendKeys.erase(address.spendPublicKey);
+    if (m_viewKeys[index].spendKeys.empty()) {
+      // the last view key takes place of the removed one
+      m_viewKeyIndexes.erase(it);
+      if (index + 1 != m_viewKeys.size()) {
+        m_viewKeys[index] = std::move(m_viewKeys.back());
+        m_viewKeyIndexes[m_viewKeys[index].publicKey] = index;
+      }
+
+      m_viewKeys.pop_back();
+    }
+  }
+
   updateSyncStart();
   return m_subscriptions.empty();
 }
 
 ITransfersSubscription* TransfersConsumer::getSubscription(const AccountAddress& acc) {
-  auto it = m_subscriptions.find(acc.spendPublicKey);
+  auto it = m_subscriptions.find(acc);
   return it == m_subscriptions.end() ? nullptr : it->second.get();
 }
 
@@ -167,98 +238,109 @@ bool TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint64_t startH
     const ITransactionReader* tx;
   };
 
-  struct PreprocessedTx : Tx, PreprocessInfo {};
+  struct PreprocessedTx : Tx, PreprocessInfo {
+    std::error_code error;
+  };
 
+  // every transaction has own result slot, so workers don't synchronize and results stay in chain order
   std::vector<PreprocessedTx> preprocessedTransactions;
-  std::mutex preprocessedTransactionsMutex;
+  for (size_t i = 0; i < count; ++i) {
+    const auto& block = blocks[i].block;
 
-  size_t workers = std::thread::hardware_concurrency();
-  if (workers == 0) {
-    workers = 2;
-  }
+    if (!block.is_initialized()) {
+      continue;
+    }
 
-  BlockingQueue<Tx> inputQueue(workers * 2);
+    // filter by syncStartTimestamp
+    if (m_syncStart.timestamp && block->timestamp < m_syncStart.timestamp) {
+      continue;
+    }
 
-  std::atomic<bool> stopProcessing(false);
+    BlockInfo blockInfo;
+    blockInfo.height = startHeight + i;
+    blockInfo.timestamp = block->timestamp;
+    blockInfo.transactionIndex = 0; // position in block
+
+    for (const auto& tx : blocks[i].transactions) {
+      auto pubKey = tx->getTransactionPublicKey();
+      if (*reinterpret_cast<crypto::public_key*>(&pubKey) != CryptoNote::null_pkey) {
+        PreprocessedTx item;
+        item.blockInfo = blockInfo;
+        item.tx = tx.get();
+        preprocessedTransactions.push_back(std::move(item));
+      }
 
-  auto pushingThread = std::async(std::launch::async, [&] {
-    for (size_t i = 0; i < count && !stopProcessing; ++i) {
-      const auto& block = blocks[i].block;
+      ++blockInfo.transactionIndex;
+    }
+  }
 
-      if (!block.is_initialized()) {
-        continue;
+  std::atomic<bool> stopProcessing(false);
+  auto preprocessInParallel = [&](const std::function<std::error_code(PreprocessedTx&)>& stage) {
+    m_scanningPool.parallelFor(preprocessedTransactions.size(), [&](size_t index) {
+      if (stopProcessing) {
+        return;
       }
 
-      // filter by syncStartTimestamp
-      if (m_syncStart.timestamp && block->timestamp < m_syncStart.timestamp) {
-        continue;
+      PreprocessedTx& item = preprocessedTransactions[index];
+      try {
+        item.error = stage(item);
+      } catch (const std::system_error& e) {
+        item.error = e.code();
+      } catch (const std::exception&) {
+        item.error = std::make_error_code(std::errc::operation_canceled);
       }
 
-      BlockInfo blockInfo;
-      blockInfo.height = startHeight + i;
-      blockInfo.timestamp = block->timestamp;
-      blockInfo.transactionIndex = 0; // position in block
-
-      for (const auto& tx : blocks[i].transactions) {
-        auto pubKey = tx->getTransactionPublicKey();
-        if (*reinterpret_cast<crypto::public_key*>(&pubKey) == CryptoNote::null_pkey) {
-          ++blockInfo.transactionIndex;
-          continue;
-        }
+      if (item.error) {
+        stopProcessing = true;
+      }
+    });
 
-        Tx item = { blockInfo, tx.get() };
-        inputQueue.push(item);
-        ++blockInfo.transactionIndex;
+    for (const auto& tx : preprocessedTransactions) {
+      if (tx.error) {
+        return tx.error;
       }
     }
 
-    inputQueue.close();
-  });
+    return std::error_code();
+  };
 
-  auto processingFunction = [&] {
-    Tx item;
-    std::error_code ec;
-    while (!stopProcessing && inputQueue.pop(item)) {
-      PreprocessedTx output;
-      static_cast<Tx&>(output) = item;
+  std::error_code processingError = preprocessInParallel([this](PreprocessedTx& item) {
+    findOutputs(*item.tx, item);
+    return std::error_code();
+  });
 
-      ec = preprocessOutputs(item.blockInfo, *item.tx, output);
-      if (ec) {
-        stopProcessing = true;
-        break;
+  // global indices of all transactions with found outputs are requested at once, not one round-trip per transaction
+  if (!processingError) {
+    std::vector<crypto::hash> transactionHashes;
+    std::vector<PreprocessedTx*> relevantTransactions;
+    for (auto& item : preprocessedTransactions) {
+      if (!item.foundOutputs.empty()) {
+        auto txHash = item.tx->getTransactionHash();
+        transactionHashes.push_back(reinterpret_cast<const crypto::hash&>(txHash));
+        relevantTransactions.push_back(&item);
       }
-
-      std::lock_guard<std::mutex> lk(preprocessedTransactionsMutex);
-      preprocessedTransactions.push_back(std::move(output));
     }
-    return ec;
-  };
 
-  std::vector<std::future<std::error_code>> processingThreads;
-  for (size_t i = 0; i < workers; ++i) {
-    processingThreads.push_back(std::async(std::launch::async, processingFunction));
-  }
+    if (!transactionHashes.empty()) {
+      std::vector<std::vector<uint64_t>> globalIndices;
+      processingError = getGlobalIndices(std::move(transactionHashes), globalIndices);
+      if (!processingError && globalIndices.size() != relevantTransactions.size()) {
+        processingError = std::make_error_code(std::errc::invalid_argument);
+      }
 
-  std::error_code processingError;
-  for (auto& f : processingThreads) {
-    try {
-      std::error_code ec = f.get();
-      if (!processingError && ec) {
-        processingError = ec;
+      for (size_t i = 0; !processingError && i < relevantTransactions.size(); ++i) {
+        relevantTransactions[i]->globalIdxs = std::move(globalIndices[i]);
       }
-    } catch (const std::system_error& e) {
-      processingError = e.code();
-    } catch (const std::exception&) {
-      processingError = std::make_error_code(std::errc::operation_canceled);
     }
   }
 
   if (!processingError) {
-    // sort by block height and transaction index in block
-    std::sort(preprocessedTransactions.begin(), preprocessedTransactions.end(), [](const PreprocessedTx& a, const PreprocessedTx& b) {
-      return std::tie(a.blockInfo.height, a.blockInfo.transactionIndex) < std::tie(b.blockInfo.height, b.blockInfo.transactionIndex);
+    processingError = preprocessInParallel([this](PreprocessedTx& item) {
+      return createTransfers(item.blockInfo, *item.tx, item);
     });
+  }
 
+  if (!processingError) {
     for (const auto& tx : preprocessedTransactions) {
       processingError = processTransaction(tx.blockInfo, *tx.tx, tx);
       if (processingError) {
@@ -326,7 +408,7 @@ void TransfersConsumer::getKnownPoolTxIds(std::vector<crypto::hash>& ids) {
 
 
 std::error_code createTransfers(
-  const AccountKeys& account,
+  TransfersSubscription& sub,
   const BlockInfo& blockInfo,
   const ITransactionReader& tx,
   const std::vector<uint32_t>& outputs,
@@ -334,6 +416,8 @@ std::error_code createTransfers(
   std::vector<TransactionOutputInformationIn>& transfers) {
 
   auto txPubKey = tx.getTransactionPublicKey();
+  auto cachedKeyImages = sub.getCachedKeyImages(txPubKey);
+  std::vector<std::pair<uint32_t, KeyImage>> newKeyImages;
 
   for (auto idx : outputs) {
 
@@ -361,15 +445,22 @@ std::error_code createTransfers(
       TransactionTypes::OutputKey out;
       tx.getOutput(idx, out);
 
-      CryptoNote::KeyPair in_ephemeral;
-      CryptoNote::generate_key_image_helper(
-        reinterpret_cast<const CryptoNote::account_keys&>(account),
-        reinterpret_cast<const crypto::public_key&>(txPubKey),
-        idx,
-        in_ephemeral,
-        reinterpret_cast<crypto::key_image&>(info.keyImage));
-
-      assert(out.key == reinterpret_cast<const PublicKey&>(in_ephemeral.pub));
+      auto cached = std::find_if(cachedKeyImages.begin(), cachedKeyImages.end(),
+        [idx](const std::pair<uint32_t, KeyImage>& entry) { return entry.first == idx; });
+      if (cached != cachedKeyImages.end()) {
+        info.keyImage = cached->second;
+      } else {
+        CryptoNote::KeyPair in_ephemeral;
+        CryptoNote::generate_key_image_helper(
+          reinterpret_cast<const CryptoNote::account_keys&>(sub.getKeys()),
+          reinterpret_cast<const crypto::public_key&>(txPubKey),
+          idx,
+          in_ephemeral,
+          reinterpret_cast<crypto::key_image&>(info.keyImage));
+
+        assert(out.key == reinterpret_cast<const PublicKey&>(in_ephemeral.pub));
+        newKeyImages.push_back(std::make_pair(idx, info.keyImage));
+      }
 
       info.amount = out.amount;
       info.outputKey = out.key;
@@ -385,31 +476,50 @@ std::error_code createTransfers(
     transfers.push_back(info);
   }
 
+  if (!newKeyImages.empty()) {
+    sub.cacheKeyImages(txPubKey, newKeyImages);
+  }
+
   return std::error_code();
 }
 
 std::error_code TransfersConsumer::preprocessOutputs(const BlockInfo& blockInfo, const ITransactionReader& tx, PreprocessInfo& info) {
-  std::unordered_map<PublicKey, std::vector<uint32_t>> outputs;
-  findMyOutputs(tx, m_viewSecret, m_spendKeys, outputs);
-
-  if (outputs.empty()) {
+  findOutputs(tx, info);
+  if (info.foundOutputs.empty()) {
     return std::error_code();
   }
 
-  std::error_code errorCode;
-  auto txHash = tx.getTransactionHash();
   if (blockInfo.height != UNCONFIRMED_TRANSACTION_HEIGHT) {
-    errorCode = getGlobalIndices(reinterpret_cast<const crypto::hash&>(txHash), info.globalIdxs);
+    auto txHash = tx.getTransactionHash();
+    std::error_code errorCode = getGlobalIndices(reinterpret_cast<const crypto::hash&>(txHash), info.globalIdxs);
     if (errorCode) {
       return errorCode;
     }
   }
 
-  for (const auto& kv : outputs) {
+  return createTransfers(blockInfo, tx, info);
+}
+
+void TransfersConsumer::findOutputs(const ITransactionReader& tx, PreprocessInfo& info) {
+  std::vector<ScannedViewKey> viewKeys;
+  std::vector<crypto::secret_key> viewSecretKeys;
+  viewKeys.reserve(m_viewKeys.size());
+  viewSecretKeys.reserve(m_viewKeys.size());
+  for (const ViewKey& viewKey : m_viewKeys) {
+    viewKeys.push_back(ScannedViewKey{ viewKey.publicKey, &viewKey.spendKeys });
+    viewSecretKeys.push_back(reinterpret_cast<const crypto::secret_key&>(viewKey.secretKey));
+  }
+
+  findMyOutputs(tx, viewKeys, viewSecretKeys, info.foundOutputs);
+}
+
+std::error_code TransfersConsumer::createTransfers(const BlockInfo& blockInfo, const ITransactionReader& tx, PreprocessInfo& info) {
+  std::error_code errorCode;
+  for (const auto& kv : info.foundOutputs) {
     auto it = m_subscriptions.find(kv.first);
     if (it != m_subscriptions.end()) {
       auto& transfers = info.outputs[kv.first];
-      errorCode = createTransfers(it->second->getKeys(), blockInfo, tx, kv.second, info.globalIdxs, transfers);
+      errorCode = CryptoNote::createTransfers(*it->second, blockInfo, tx, kv.second, info.globalIdxs, transfers);
       if (errorCode) {
         return errorCode;
       }
@@ -471,19 +581,16 @@ std::error_code TransfersConsumer::processOutputs(const BlockInfo& blockInfo, Tr
 }
 
 
-std::error_code TransfersConsumer::getGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices) {  
-  std::promise<std::error_code> prom;
-  std::future<std::error_code> f = prom.get_future();
-
-  INode::Callback cb = [&prom](std::error_code ec) { 
-    std::promise<std::error_code> p(std::move(prom));
-    p.set_value(ec);
-  };
-
-  outsGlobalIndices.clear();
-  m_node.getTransactionOutsGlobalIndices(transactionHash, outsGlobalIndices, cb);
+std::error_code TransfersConsumer::getGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices) {
+  NodeResult<std::vector<uint64_t>> result = NodeFutures(m_node).getTransactionOutsGlobalIndices(transactionHash).get();
+  outsGlobalIndices = std::move(result.value);
+  return result.error;
+}
 
-  return f.get();
+std::error_code TransfersConsumer::getGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices) {
+  NodeResult<std::vector<std::vector<uint64_t>>> result = NodeFutures(m_node).getTransactionsOutsGlobalIndices(std::move(transactionHashes)).get();
+  outsGlobalIndices = std::move(result.value);
+  return result.error;
 }
 
 }
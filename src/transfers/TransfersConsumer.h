@@ -22,6 +22,7 @@
 #include "TransfersSubscription.h"
 #include "TypeHelpers.h"
 
+#include "Common/ThreadPool.h"
 #include "crypto/crypto.h"
 
 #include "IObservableImpl.h"
@@ -36,7 +37,10 @@ class TransfersConsumer : public IBlockchainConsumer {
 
 public:
 
-  TransfersConsumer(const CryptoNote::Currency& currency, INode& node, const SecretKey& viewSecret);
+  // Transactions of new blocks are scanned on scanningPool threads, the pool is shared by consumers of one synchronizer
+  TransfersConsumer(const CryptoNote::Currency& currency, INode& node, const SecretKey& viewSecret, Common::ThreadPool& scanningPool);
+  // Accepts subscriptions with any view key, every transaction is parsed once and tested for all of them in one pass
+  TransfersConsumer(const CryptoNote::Currency& currency, INode& node, Common::ThreadPool& scanningPool);
 
   ITransfersSubscription& addSubscription(const AccountSubscription& subscription);
   // returns true if no subscribers left
@@ -53,6 +57,12 @@ public:
 
 private:
 
+  struct ViewKey {
+    PublicKey publicKey;
+    SecretKey secretKey;
+    std::unordered_set<PublicKey> spendKeys;
+  };
+
   template <typename F>
   void forEachSubscription(F action) {
     for (const auto& kv : m_subscriptions) {
@@ -61,28 +71,38 @@ private:
   }
 
   struct PreprocessInfo {
-    std::unordered_map<PublicKey, std::vector<TransactionOutputInformationIn>> outputs;
+    // indexes of outputs to subscribed addresses, transfers are created from them once global indices are known
+    std::unordered_map<AccountAddress, std::vector<uint32_t>> foundOutputs;
+    std::unordered_map<AccountAddress, std::vector<TransactionOutputInformationIn>> outputs;
     std::vector<uint64_t> globalIdxs;
   };
 
   std::error_code preprocessOutputs(const BlockInfo& blockInfo, const ITransactionReader& tx, PreprocessInfo& info);
+  void findOutputs(const ITransactionReader& tx, PreprocessInfo& info);
+  std::error_code createTransfers(const BlockInfo& blockInfo, const ITransactionReader& tx, PreprocessInfo& info);
   std::error_code processTransaction(const BlockInfo& blockInfo, const ITransactionReader& tx);
   std::error_code processTransaction(const BlockInfo& blockInfo, const ITransactionReader& tx, const PreprocessInfo& info);
   std::error_code processOutputs(const BlockInfo& blockInfo, TransfersSubscription& sub, const ITransactionReader& tx,
     const std::vector<TransactionOutputInformationIn>& outputs, const std::vector<uint64_t>& globalIdxs);
 
   std::error_code getGlobalIndices(const crypto::hash& transactionHash, std::vector<uint64_t>& outsGlobalIndices);
+  std::error_code getGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices);
 
   void updateSyncStart();
 
   SynchronizationStart m_syncStart;
+  // the only accepted view key, unless the consumer accepts any
+  const bool m_singleViewKey;
   const SecretKey m_viewSecret;
-  // map { spend public key -> subscription }
-  std::unordered_map<PublicKey, std::unique_ptr<TransfersSubscription>> m_subscriptions;
-  std::unordered_set<PublicKey> m_spendKeys;
+  std::unordered_map<AccountAddress, std::unique_ptr<TransfersSubscription>> m_subscriptions;
+  // view keys of subscriptions with their spend keys, derivations for all of them are generated together
+  std::vector<ViewKey> m_viewKeys;
+  // map { view public key -> index in m_viewKeys }
+  std::unordered_map<PublicKey, size_t> m_viewKeyIndexes;
 
   INode& m_node;
   const CryptoNote::Currency& m_currency;
+  Common::ThreadPool& m_scanningPool;
 };
 
 }
@@ -16,6 +16,13 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "TransfersContainer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+
 #include "IWallet.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 
@@ -91,6 +98,71 @@ namespace {
   TransferIteratorList<TIterator> createTransferIteratorList(const std::pair<TIterator, TIterator>& itPair) {
     return TransferIteratorList<TIterator>(itPair.first, itPair.second);
   }
+
+  // rows and columns of cached balances
+  const TransactionTypes::OutputType BALANCE_TYPES[] = { TransactionTypes::OutputType::Key, TransactionTypes::OutputType::Multisignature };
+  const uint32_t BALANCE_STATES[] = { ITransfersContainer::IncludeStateLocked, ITransfersContainer::IncludeStateSoftLocked,
+    ITransfersContainer::IncludeStateUnlocked };
+
+  size_t balanceTypeIndex(TransactionTypes::OutputType type) {
+    return type == TransactionTypes::OutputType::Key ? 0 : 1;
+  }
+
+  size_t balanceStateIndex(uint32_t state) {
+    return state == ITransfersContainer::IncludeStateLocked ? 0 : (state == ITransfersContainer::IncludeStateSoftLocked ? 1 : 2);
+  }
+
+  // Random one of accepted transfers of the smallest amount in [first, last) having any, last if there is none
+  template<typename TIterator, typename TPredicate, typename URNG>
+  TIterator pickSmallestAmount(TIterator first, TIterator last, const TPredicate& accepted, URNG& randomGenerator) {
+    TIterator picked = last;
+    size_t count = 0;
+    for (auto it = first; it != last && (picked == last || it->amount == picked->amount); ++it) {
+      if (accepted(*it)) {
+        ++count;
+        if (std::uniform_int_distribution<size_t>(0, count - 1)(randomGenerator) == 0) {
+          picked = it;
+        }
+      }
+    }
+
+    return picked;
+  }
+
+  // Takes transfers from [first, last) of an amount ordered index until they cover neededMoney. The smallest amount
+  // covering the rest ends it, otherwise the largest one left is taken, so last moves down over taken transfers.
+  template<typename TIndex, typename TPredicate, typename URNG>
+  uint64_t selectByAmount(const TIndex& index, typename TIndex::iterator first, typename TIndex::iterator last,
+                          uint64_t neededMoney, const TPredicate& accepted, URNG& randomGenerator,
+                          std::vector<TransactionOutputInformation>& transfers) {
+    uint64_t foundMoney = 0;
+    while (foundMoney < neededMoney && first != last) {
+      uint64_t rest = neededMoney - foundMoney;
+      if (last == index.end() || rest <= last->amount) {
+        auto lower = rest <= first->amount ? first : index.lower_bound(rest);
+        auto it = pickSmallestAmount(lower, last, accepted, randomGenerator);
+        if (it != last) {
+          transfers.push_back(*it);
+          foundMoney += it->amount;
+          break;
+        }
+      }
+
+      while (last != first && !accepted(*std::prev(last))) {
+        --last;
+      }
+
+      if (last == first) {
+        break;
+      }
+
+      --last;
+      transfers.push_back(*last);
+      foundMoney += last->amount;
+    }
+
+    return foundMoney;
+  }
 }
 
 
@@ -162,7 +234,9 @@ size_t SpentOutputDescriptor::hash() const {
 TransfersContainer::TransfersContainer(const Currency& currency, size_t transactionSpendableAge) :
   m_currentHeight(0),
   m_currency(currency),
-  m_transactionSpendableAge(transactionSpendableAge) {
+  m_transactionSpendableAge(transactionSpendableAge),
+  m_balancesValid(false),
+  m_balancesHeight(0) {
 }
 
 bool TransfersContainer::addTransaction(const BlockInfo& block, const ITransactionReader& tx,
@@ -245,6 +319,7 @@ bool TransfersContainer::addTransactionOutputs(const BlockInfo& block, const ITr
     if (transferIsUnconfirmed) {
       auto result = m_unconfirmedTransfers.emplace(std::move(info));
       assert(result.second);
+      addTransferToBalances(*result.first, true);
     } else {
       if (info.type == TransactionTypes::OutputType::Multisignature) {
       SpentOutputDescriptor descriptor(transfer);
@@ -256,6 +331,7 @@ bool TransfersContainer::addTransactionOutputs(const BlockInfo& block, const ITr
 
       auto result = m_availableTransfers.emplace(std::move(info));
       assert(result.second);
+      addTransferToBalances(*result.first, false);
     }
 
     if (info.type == TransactionTypes::OutputType::Key) {
@@ -315,6 +391,7 @@ bool TransfersContainer::addTransactionInputs(const BlockInfo& block, const ITra
       assert(spendingTransferIt->keyImage == input.keyImage);
       copyToSpent(block, tx, i, *spendingTransferIt);
       // erase from available outputs
+      removeTransferFromBalances(*spendingTransferIt, false);
       outputDescriptorIndex.erase(spendingTransferIt);
       updateTransfersVisibility(input.keyImage);
 
@@ -328,6 +405,7 @@ bool TransfersContainer::addTransactionInputs(const BlockInfo& block, const ITra
       if (availableOutputIt != outputDescriptorIndex.end()) {
         copyToSpent(block, tx, i, *availableOutputIt);
         // erase from available outputs
+        removeTransferFromBalances(*availableOutputIt, false);
         outputDescriptorIndex.erase(availableOutputIt);
 
         inputsAdded = true;
@@ -401,7 +479,9 @@ bool TransfersContainer::markTransactionConfirmed(const BlockInfo& block, const
 
     auto result = m_availableTransfers.emplace(std::move(transfer));
     assert(result.second);
+    addTransferToBalances(*result.first, false);
 
+    removeTransferFromBalances(*transferIt, true);
     transferIt = m_unconfirmedTransfers.get<ContainingTransactionIndex>().erase(transferIt);
 
     if (transfer.type == TransactionTypes::OutputType::Key) {
@@ -434,6 +514,7 @@ void TransfersContainer::deleteTransactionTransfers(const Hash& transactionHash)
 
     auto result = m_availableTransfers.emplace(static_cast<const TransactionOutputInformationEx&>(*it));
     assert(result.second);
+    addTransferToBalances(*result.first, false);
     it = spendingTransactionIndex.erase(it);
 
     if (result.first->type == TransactionTypes::OutputType::Key) {
@@ -443,6 +524,7 @@ void TransfersContainer::deleteTransactionTransfers(const Hash& transactionHash)
 
   auto unconfirmedTransfersRange = m_unconfirmedTransfers.get<ContainingTransactionIndex>().equal_range(transactionHash);
   for (auto it = unconfirmedTransfersRange.first; it != unconfirmedTransfersRange.second;) {
+    removeTransferFromBalances(*it, true);
     if (it->type == TransactionTypes::OutputType::Key) {
       KeyImage keyImage = it->keyImage;
       it = m_unconfirmedTransfers.get<ContainingTransactionIndex>().erase(it);
@@ -455,6 +537,7 @@ void TransfersContainer::deleteTransactionTransfers(const Hash& transactionHash)
   auto& transactionTransfersIndex = m_availableTransfers.get<ContainingTransactionIndex>();
   auto transactionTransfersRange = transactionTransfersIndex.equal_range(transactionHash);
   for (auto it = transactionTransfersRange.first; it != transactionTransfersRange.second;) {
+    removeTransferFromBalances(*it, false);
     if (it->type == TransactionTypes::OutputType::Key) {
       KeyImage keyImage = it->keyImage;
     it = transactionTransfersIndex.erase(it);
@@ -491,34 +574,37 @@ std::vector<Hash> TransfersContainer::detach(uint64_t height) {
   std::vector<Hash> deletedTransactions;
   auto& spendingTransactionIndex = m_spentTransfers.get<SpendingTransactionIndex>();
   auto& blockHeightIndex = m_transactions.get<1>();
-  auto it = blockHeightIndex.end();
-  while (it != blockHeightIndex.begin()) {
-    --it;
 
-    bool doDelete = false;
-    if (it->blockHeight == UNCONFIRMED_TRANSACTION_HEIGHT) {
-      auto range = spendingTransactionIndex.equal_range(it->transactionHash);
-      for (auto spentTransferIt = range.first; spentTransferIt != range.second; ++spentTransferIt) {
-        if (spentTransferIt->blockHeight >= height) {
-          doDelete = true;
-          break;
-    }
-  }
-    } else if (it->blockHeight >= height) {
-      doDelete = true;
-    } else {
-      break;
-    }
+  // unconfirmed transactions spending detached outputs go away with them
+  for (auto it = blockHeightIndex.lower_bound(UNCONFIRMED_TRANSACTION_HEIGHT); it != blockHeightIndex.end();) {
+    auto range = spendingTransactionIndex.equal_range(it->transactionHash);
+    bool doDelete = std::any_of(range.first, range.second, [height](const SpentTransactionOutput& spentTransfer) {
+      return spentTransfer.blockHeight >= height;
+    });
 
     if (doDelete) {
       deleteTransactionTransfers(it->transactionHash);
       deletedTransactions.emplace_back(it->transactionHash);
       it = blockHeightIndex.erase(it);
+    } else {
+      ++it;
+    }
   }
+
+  // transfers are deleted from the top, so outputs spent by a detached transaction come back before they are deleted
+  // themselves, transactions are erased as one segment afterwards
+  auto first = blockHeightIndex.lower_bound(height);
+  auto last = blockHeightIndex.lower_bound(UNCONFIRMED_TRANSACTION_HEIGHT);
+  for (auto it = last; it != first;) {
+    --it;
+    deleteTransactionTransfers(it->transactionHash);
+    deletedTransactions.emplace_back(it->transactionHash);
   }
 
+  blockHeightIndex.erase(first, last);
+
   // TODO: notification on detach
-  m_currentHeight = height == 0 ? 0 : height - 1;
+  detachBalances(height == 0 ? 0 : height - 1);
 
   return deletedTransactions;
 }
@@ -534,6 +620,22 @@ namespace {
   }
 }
 
+/**
+ * \pre m_mutex is locked.
+ */
+template<typename C, typename T>
+void TransfersContainer::setVisibility(C& collection, const T& range, bool visible, bool unconfirmed) {
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->visible != visible) {
+      removeTransferFromBalances(*it, unconfirmed);
+      auto updated = *it;
+      updated.visible = visible;
+      collection.replace(it, updated);
+      addTransferToBalances(*it, unconfirmed);
+    }
+  }
+}
+
 /**
  * \pre m_mutex is locked.
  */
@@ -553,12 +655,12 @@ void TransfersContainer::updateTransfersVisibility(const KeyImage& keyImage) {
   assert(spentCount == 0 || spentCount == 1);
 
   if (spentCount > 0) {
-    updateVisibility(unconfirmedIndex, unconfirmedRange, false);
-    updateVisibility(availableIndex, availableRange, false);
+    setVisibility(unconfirmedIndex, unconfirmedRange, false, true);
+    setVisibility(availableIndex, availableRange, false, false);
     updateVisibility(spentIndex, spentRange, true);
   } else if (availableCount > 0) {
-    updateVisibility(unconfirmedIndex, unconfirmedRange, false);
-    updateVisibility(availableIndex, availableRange, false);
+    setVisibility(unconfirmedIndex, unconfirmedRange, false, true);
+    setVisibility(availableIndex, availableRange, false, false);
 
     auto iteratorList = createTransferIteratorList(availableRange);
     auto earliestTransferIt = iteratorList.minElement();
@@ -567,8 +669,9 @@ void TransfersContainer::updateTransfersVisibility(const KeyImage& keyImage) {
     auto earliestTransfer = *earliestTransferIt;
     earliestTransfer.visible = true;
     availableIndex.replace(earliestTransferIt, earliestTransfer);
+    addTransferToBalances(*earliestTransferIt, false);
   } else {
-    updateVisibility(unconfirmedIndex, unconfirmedRange, unconfirmedCount == 1);
+    setVisibility(unconfirmedIndex, unconfirmedRange, unconfirmedCount == 1, true);
   }
 }
 
@@ -595,25 +698,190 @@ size_t TransfersContainer::transactionsCount() {
 
 uint64_t TransfersContainer::balance(uint32_t flags) {
   std::lock_guard<std::mutex> lk(m_mutex);
-  uint64_t amount = 0;
+  if (!syncBalances()) {
+    rebuildBalances();
+  }
 
-  for (const auto& t : m_availableTransfers) {
-    if (t.visible && isIncluded(t, flags)) {
-      amount += t.amount;
+  uint64_t amount = 0;
+  for (size_t type = 0; type < 2; ++type) {
+    for (size_t state = 0; state < 3; ++state) {
+      if (isIncluded(BALANCE_TYPES[type], BALANCE_STATES[state], flags)) {
+        amount += m_balances[type][state];
+      }
     }
   }
 
-  if ((flags & IncludeStateLocked) != 0) {
-    for (const auto& t : m_unconfirmedTransfers) {
-      if (t.visible && isIncluded(t.type, IncludeStateLocked, flags)) {
-        amount += t.amount;
-      }
+  for (const TransactionOutputInformationEx* t : m_timeLockedTransfers) {
+    if (isIncluded(*t, flags)) {
+      amount += t->amount;
     }
   }
 
   return amount;
 }
 
+/**
+ * \pre m_mutex is locked.
+ */
+void TransfersContainer::rebuildBalances() {
+  memset(m_balances, 0, sizeof(m_balances));
+  m_stateChanges.clear();
+  m_stateUndo.clear();
+  m_timeLockedTransfers.clear();
+  m_balancesHeight = m_currentHeight;
+  m_balancesValid = true;
+
+  for (const auto& t : m_availableTransfers) {
+    addTransferToBalances(t, false);
+  }
+
+  for (const auto& t : m_unconfirmedTransfers) {
+    addTransferToBalances(t, true);
+  }
+}
+
+/**
+ * \pre m_mutex is locked.
+ */
+bool TransfersContainer::syncBalances() {
+  if (!m_balancesValid) {
+    return false;
+  }
+
+  if (m_currentHeight < m_balancesHeight) {
+    m_balancesValid = false;
+    return false;
+  }
+
+  updateBalances();
+  return true;
+}
+
+/**
+ * \pre m_mutex is locked.
+ */
+void TransfersContainer::addTransferToBalances(const TransactionOutputInformationEx& info, bool unconfirmed) {
+  if (!info.visible || !syncBalances()) {
+    return;
+  }
+
+  if (unconfirmed) {
+    m_balances[balanceTypeIndex(info.type)][balanceStateIndex(IncludeStateLocked)] += info.amount;
+  } else if (info.unlockTime >= m_currency.maxBlockHeight()) {
+    m_timeLockedTransfers.push_back(&info);
+  } else {
+    addToBalances(info);
+  }
+}
+
+/**
+ * \pre m_mutex is locked, info is still in its container.
+ */
+void TransfersContainer::removeTransferFromBalances(const TransactionOutputInformationEx& info, bool unconfirmed) {
+  if (!info.visible || !syncBalances()) {
+    return;
+  }
+
+  if (unconfirmed) {
+    m_balances[balanceTypeIndex(info.type)][balanceStateIndex(IncludeStateLocked)] -= info.amount;
+  } else if (info.unlockTime >= m_currency.maxBlockHeight()) {
+    auto it = std::find(m_timeLockedTransfers.begin(), m_timeLockedTransfers.end(), &info);
+    assert(it != m_timeLockedTransfers.end());
+    *it = m_timeLockedTransfers.back();
+    m_timeLockedTransfers.pop_back();
+  } else {
+    m_balances[balanceTypeIndex(info.type)][balanceStateIndex(transferState(info))] -= info.amount;
+    // queue is up to date, so the transfer waits for its next state change from the current height
+    uint64_t changeHeight = nextStateChangeHeight(info);
+    if (changeHeight != std::numeric_limits<uint64_t>::max()) {
+      auto range = m_stateChanges.equal_range(changeHeight);
+      auto it = std::find_if(range.first, range.second, [&info](const std::pair<const uint64_t, StateChange>& change) {
+        return change.second.transfer == &info;
+      });
+
+      assert(it != range.second);
+      m_stateChanges.erase(it);
+    }
+
+    eraseStateUndo(info, lastStateChangeHeight(info));
+  }
+}
+
+/**
+ * \pre m_mutex is locked.
+ */
+void TransfersContainer::eraseStateUndo(const TransactionOutputInformationEx& info, uint64_t changeHeight) {
+  if (changeHeight == 0) {
+    return;
+  }
+
+  auto range = m_stateUndo.equal_range(changeHeight);
+  auto it = std::find_if(range.first, range.second, [&info](const std::pair<const uint64_t, const TransactionOutputInformationEx*>& undo) {
+    return undo.second == &info;
+  });
+
+  assert(it != range.second);
+  m_stateUndo.erase(it);
+}
+
+/**
+ * \pre m_mutex is locked.
+ */
+void TransfersContainer::detachBalances(uint64_t height) {
+  // balances catch up with a grown height themselves
+  if (height >= m_currentHeight || !syncBalances()) {
+    m_currentHeight = height;
+    return;
+  }
+
+  // state of a transfer changes only at the heights it is queued by, the rest keep their state below them
+  std::vector<const TransactionOutputInformationEx*> transfers;
+  while (!m_stateUndo.empty() && std::prev(m_stateUndo.end())->first > height) {
+    const TransactionOutputInformationEx* transfer = std::prev(m_stateUndo.end())->second;
+    removeTransferFromBalances(*transfer, false);
+    transfers.push_back(transfer);
+  }
+
+  m_currentHeight = height;
+  m_balancesHeight = height;
+  for (const TransactionOutputInformationEx* transfer : transfers) {
+    addToBalances(*transfer);
+  }
+}
+
+/**
+ * \pre m_mutex is locked, balances are valid for a height not above m_currentHeight.
+ */
+void TransfersContainer::updateBalances() {
+  while (!m_stateChanges.empty() && m_stateChanges.begin()->first <= m_currentHeight) {
+    StateChange change = m_stateChanges.begin()->second;
+    m_stateChanges.erase(m_stateChanges.begin());
+    eraseStateUndo(*change.transfer, change.lastChangeHeight);
+    m_balances[balanceTypeIndex(change.transfer->type)][balanceStateIndex(change.state)] -= change.transfer->amount;
+    addToBalances(*change.transfer);
+  }
+
+  m_balancesHeight = m_currentHeight;
+}
+
+/**
+ * \pre m_mutex is locked.
+ */
+void TransfersContainer::addToBalances(const TransactionOutputInformationEx& info) {
+  uint32_t state = transferState(info);
+  m_balances[balanceTypeIndex(info.type)][balanceStateIndex(state)] += info.amount;
+
+  uint64_t lastChangeHeight = lastStateChangeHeight(info);
+  if (lastChangeHeight != 0) {
+    m_stateUndo.emplace(lastChangeHeight, &info);
+  }
+
+  uint64_t changeHeight = nextStateChangeHeight(info);
+  if (changeHeight != std::numeric_limits<uint64_t>::max()) {
+    m_stateChanges.emplace(changeHeight, StateChange{ &info, state, lastChangeHeight });
+  }
+}
+
 void TransfersContainer::getOutputs(std::vector<TransactionOutputInformation>& transfers, uint32_t flags) {
   std::lock_guard<std::mutex> lk(m_mutex);
   for (const auto& t : m_availableTransfers) {
@@ -695,6 +963,45 @@ std::vector<TransactionOutputInformation> TransfersContainer::getTransactionOutp
   return result;
 }
 
+void TransfersContainer::getTransfersByHeight(uint64_t firstHeight, uint64_t lastHeight, uint32_t flags, bool includeSpent,
+  const std::function<bool(const TransactionOutputInformation&, uint64_t blockHeight, bool spent)>& visitor) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  if (firstHeight > lastHeight) {
+    return;
+  }
+
+  // transactions come from the height index and their transfers from indexes by containing transaction, so a page
+  // costs only the transactions it covers
+  auto& blockHeightIndex = m_transactions.get<1>();
+  for (auto it = blockHeightIndex.lower_bound(firstHeight); it != blockHeightIndex.end() && it->blockHeight <= lastHeight; ++it) {
+    const Hash& transactionHash = it->transactionHash;
+    auto availableRange = m_availableTransfers.get<ContainingTransactionIndex>().equal_range(transactionHash);
+    for (auto i = availableRange.first; i != availableRange.second; ++i) {
+      if (isIncluded(*i, flags) && !visitor(*i, it->blockHeight, false)) {
+        return;
+      }
+    }
+
+    if ((flags & IncludeStateLocked) != 0) {
+      auto unconfirmedRange = m_unconfirmedTransfers.get<ContainingTransactionIndex>().equal_range(transactionHash);
+      for (auto i = unconfirmedRange.first; i != unconfirmedRange.second; ++i) {
+        if (isIncluded(i->type, IncludeStateLocked, flags) && !visitor(*i, it->blockHeight, false)) {
+          return;
+        }
+      }
+    }
+
+    if (includeSpent) {
+      auto spentRange = m_spentTransfers.get<ContainingTransactionIndex>().equal_range(transactionHash);
+      for (auto i = spentRange.first; i != spentRange.second; ++i) {
+        if (isIncluded(i->type, IncludeStateAll, flags | IncludeStateAll) && !visitor(*i, it->blockHeight, true)) {
+          return;
+        }
+      }
+    }
+  }
+}
+
 void TransfersContainer::getUnconfirmedTransactions(std::vector<crypto::hash>& transactions) {
   std::lock_guard<std::mutex> lk(m_mutex);
   transactions.clear();
@@ -728,6 +1035,41 @@ std::vector<TransactionSpentOutputInformation> TransfersContainer::getSpentOutpu
   return spentOutputs;
 }
 
+uint64_t TransfersContainer::selectOutputs(uint64_t neededMoney, uint64_t dustThreshold, bool addDust,
+  const std::function<bool(const TransactionOutputInformation&)>& skip, std::vector<TransactionOutputInformation>& transfers,
+  uint32_t flags) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+
+  auto& amountIndex = m_availableTransfers.get<AmountIndex>();
+  auto dustEnd = amountIndex.upper_bound(dustThreshold);
+  std::default_random_engine randomGenerator(crypto::rand<std::default_random_engine::result_type>());
+
+  const TransactionOutputInformationEx* dust = nullptr;
+  auto accepted = [&](const TransactionOutputInformationEx& t) {
+    return &t != dust && t.visible && isIncluded(t, flags) && !skip(t);
+  };
+
+  uint64_t foundMoney = 0;
+  if (addDust && neededMoney > 0) {
+    auto it = pickSmallestAmount(amountIndex.begin(), dustEnd, accepted, randomGenerator);
+    if (it != dustEnd) {
+      dust = &*it;
+      transfers.push_back(*it);
+      foundMoney += it->amount;
+    }
+  }
+
+  if (foundMoney < neededMoney) {
+    foundMoney += selectByAmount(amountIndex, dustEnd, amountIndex.end(), neededMoney - foundMoney, accepted, randomGenerator, transfers);
+  }
+
+  if (foundMoney < neededMoney) {
+    foundMoney += selectByAmount(amountIndex, amountIndex.begin(), dustEnd, neededMoney - foundMoney, accepted, randomGenerator, transfers);
+  }
+
+  return foundMoney;
+}
+
 void TransfersContainer::save(std::ostream& os) {
   std::lock_guard<std::mutex> lk(m_mutex);
   CryptoNote::BinaryOutputStreamSerializer s(os);
@@ -769,6 +1111,7 @@ void TransfersContainer::load(std::istream& in) {
   m_unconfirmedTransfers = std::move(unconfirmedTransfers);
   m_availableTransfers = std::move(availableTransfers);
   m_spentTransfers = std::move(spentTransfers);
+  m_balancesValid = false;
 }
 
 bool TransfersContainer::isSpendTimeUnlocked(uint64_t unlockTime) const {
@@ -784,17 +1127,60 @@ bool TransfersContainer::isSpendTimeUnlocked(uint64_t unlockTime) const {
   return false;
 }
 
-bool TransfersContainer::isIncluded(const TransactionOutputInformationEx& info, uint32_t flags) const {
-  uint32_t state;
+uint32_t TransfersContainer::transferState(const TransactionOutputInformationEx& info) const {
   if (info.blockHeight == UNCONFIRMED_TRANSACTION_HEIGHT || !isSpendTimeUnlocked(info.unlockTime)) {
-    state = IncludeStateLocked;
+    return IncludeStateLocked;
   } else if (m_currentHeight < info.blockHeight + m_transactionSpendableAge) {
-    state = IncludeStateSoftLocked;
+    return IncludeStateSoftLocked;
   } else {
-    state = IncludeStateUnlocked;
+    return IncludeStateUnlocked;
+  }
+}
+
+// State of a confirmed transfer locked by height changes only at heights where one of transferState() conditions
+// flips, returns the nearest one above m_currentHeight
+uint64_t TransfersContainer::nextStateChangeHeight(const TransactionOutputInformationEx& info) const {
+  assert(info.unlockTime < m_currency.maxBlockHeight());
+  uint64_t delta = m_currency.lockedTxAllowedDeltaBlocks();
+  uint64_t candidates[] = {
+    // isSpendTimeUnlocked() wraps around at zero height
+    1,
+    info.unlockTime + 1 > delta ? info.unlockTime + 1 - delta : 0,
+    info.blockHeight + m_transactionSpendableAge
+  };
+
+  uint64_t changeHeight = std::numeric_limits<uint64_t>::max();
+  for (uint64_t candidate : candidates) {
+    if (candidate > m_currentHeight && candidate < changeHeight) {
+      changeHeight = candidate;
+    }
   }
 
-  return isIncluded(info.type, state, flags);
+  return changeHeight;
+}
+
+// The nearest one of the same heights not above m_currentHeight, zero if there is none
+uint64_t TransfersContainer::lastStateChangeHeight(const TransactionOutputInformationEx& info) const {
+  assert(info.unlockTime < m_currency.maxBlockHeight());
+  uint64_t delta = m_currency.lockedTxAllowedDeltaBlocks();
+  uint64_t candidates[] = {
+    1,
+    info.unlockTime + 1 > delta ? info.unlockTime + 1 - delta : 0,
+    info.blockHeight + m_transactionSpendableAge
+  };
+
+  uint64_t changeHeight = 0;
+  for (uint64_t candidate : candidates) {
+    if (candidate <= m_currentHeight && candidate > changeHeight) {
+      changeHeight = candidate;
+    }
+  }
+
+  return changeHeight;
+}
+
+bool TransfersContainer::isIncluded(const TransactionOutputInformationEx& info, uint32_t flags) const {
+  return isIncluded(info.type, transferState(info), flags);
 }
 
 bool TransfersContainer::isIncluded(TransactionTypes::OutputType type, uint32_t state, uint32_t flags) {
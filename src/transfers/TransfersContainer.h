@@ -18,6 +18,7 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
 #include <unordered_map>
 #include <mutex>
 
@@ -85,6 +86,7 @@ struct TransactionOutputInformationEx : public TransactionOutputInformationIn {
 
   SpentOutputDescriptor getSpentOutputDescriptor() const { return SpentOutputDescriptor(*this); }
   const Hash& getTransactionHash() const { return transactionHash; }
+  uint64_t getAmount() const { return amount; }
 
   void serialize(CryptoNote::ISerializer& s, const std::string& name) {
     s(reinterpret_cast<uint8_t&>(type), "type");
@@ -169,6 +171,11 @@ public:
   virtual std::vector<TransactionOutputInformation> getTransactionOutputs(const Hash& transactionHash, uint32_t flags) override;
   virtual void getUnconfirmedTransactions(std::vector<crypto::hash>& transactions) override;
   virtual std::vector<TransactionSpentOutputInformation> getSpentOutputs() override;
+  virtual void getTransfersByHeight(uint64_t firstHeight, uint64_t lastHeight, uint32_t flags, bool includeSpent,
+    const std::function<bool(const TransactionOutputInformation&, uint64_t blockHeight, bool spent)>& visitor) override;
+  virtual uint64_t selectOutputs(uint64_t neededMoney, uint64_t dustThreshold, bool addDust,
+    const std::function<bool(const TransactionOutputInformation&)>& skip, std::vector<TransactionOutputInformation>& transfers,
+    uint32_t flags) override;
 
   // IStreamSerializable
   virtual void save(std::ostream& os) override;
@@ -178,6 +185,7 @@ private:
   struct ContainingTransactionIndex { };
   struct SpendingTransactionIndex { };
   struct SpentOutputDescriptorIndex { };
+  struct AmountIndex { };
 
   typedef boost::multi_index_container<
     TransactionInformation,
@@ -225,6 +233,14 @@ private:
           TransactionOutputInformationEx,
           const Hash&,
           &TransactionOutputInformationEx::getTransactionHash>
+      >,
+      // outputs for spending are selected by amount
+      boost::multi_index::ordered_non_unique<
+        boost::multi_index::tag<AmountIndex>,
+        boost::multi_index::const_mem_fun<
+          TransactionOutputInformationEx,
+          uint64_t,
+          &TransactionOutputInformationEx::getAmount>
       >
     >
   > AvailableTransfersMultiIndex;
@@ -264,9 +280,21 @@ private:
   bool addTransactionInputs(const BlockInfo& block, const ITransactionReader& tx);
   void deleteTransactionTransfers(const Hash& transactionHash);
   bool isSpendTimeUnlocked(uint64_t unlockTime) const;
+  uint32_t transferState(const TransactionOutputInformationEx& info) const;
+  uint64_t nextStateChangeHeight(const TransactionOutputInformationEx& info) const;
+  uint64_t lastStateChangeHeight(const TransactionOutputInformationEx& info) const;
   bool isIncluded(const TransactionOutputInformationEx& info, uint32_t flags) const;
   static bool isIncluded(TransactionTypes::OutputType type, uint32_t state, uint32_t flags);
   void updateTransfersVisibility(const KeyImage& keyImage);
+  template<typename C, typename T> void setVisibility(C& collection, const T& range, bool visible, bool unconfirmed);
+  bool syncBalances();
+  void rebuildBalances();
+  void updateBalances();
+  void addToBalances(const TransactionOutputInformationEx& info);
+  void detachBalances(uint64_t height);
+  void eraseStateUndo(const TransactionOutputInformationEx& info, uint64_t changeHeight);
+  void addTransferToBalances(const TransactionOutputInformationEx& info, bool unconfirmed);
+  void removeTransferFromBalances(const TransactionOutputInformationEx& info, bool unconfirmed);
 
   void copyToSpent(const BlockInfo& block, const ITransactionReader& tx, size_t inputIndex, const TransactionOutputInformationEx& output);
 
@@ -281,6 +309,25 @@ private:
   size_t m_transactionSpendableAge;
   const CryptoNote::Currency& m_currency;
   std::mutex m_mutex;
+
+  // Balances of visible transfers by output type and state at m_balancesHeight. Transfers entering and leaving available
+  // and unconfirmed sets or changing visibility update them in place, load drops them until the next balance() call.
+  // When height grows only transfers whose state changes are moved, they are queued by the height of their next
+  // possible state change. Undo data keeps the same transfers by the height of their last possible state change, so
+  // detach moves back only the transfers which could have changed state above the new height. Transfers locked by
+  // time are checked on every call.
+  struct StateChange {
+    const TransactionOutputInformationEx* transfer;
+    uint32_t state;
+    uint64_t lastChangeHeight;
+  };
+
+  bool m_balancesValid;
+  uint64_t m_balancesHeight;
+  uint64_t m_balances[2][3];
+  std::multimap<uint64_t, StateChange> m_stateChanges;
+  std::multimap<uint64_t, const TransactionOutputInformationEx*> m_stateUndo;
+  std::vector<const TransactionOutputInformationEx*> m_timeLockedTransfers;
 };
 
 }
@@ -78,4 +78,17 @@ void TransfersSubscription::markTransactionConfirmed(const BlockInfo& block, con
   m_observerManager.notify(&ITransfersObserver::onTransactionUpdated, this, transactionHash);
 }
 
+std::vector<std::pair<uint32_t, KeyImage>> TransfersSubscription::getCachedKeyImages(const PublicKey& transactionPublicKey) {
+  std::lock_guard<std::mutex> lock(m_keyImagesMutex);
+  auto it = m_keyImages.find(transactionPublicKey);
+  return it == m_keyImages.end() ? std::vector<std::pair<uint32_t, KeyImage>>() : it->second;
+}
+
+void TransfersSubscription::cacheKeyImages(const PublicKey& transactionPublicKey,
+                                           const std::vector<std::pair<uint32_t, KeyImage>>& keyImages) {
+  std::lock_guard<std::mutex> lock(m_keyImagesMutex);
+  auto& cached = m_keyImages[transactionPublicKey];
+  cached.insert(cached.end(), keyImages.begin(), keyImages.end());
+}
+
 }
@@ -20,6 +20,10 @@
 #include "ITransfersSynchronizer.h"
 #include "TransfersContainer.h"
 #include "IObservableImpl.h"
+#include "TypeHelpers.h"
+
+#include <mutex>
+#include <unordered_map>
 
 namespace CryptoNote {
 
@@ -39,6 +43,11 @@ public:
   void deleteUnconfirmedTransaction(const Hash& transactionHash);
   void markTransactionConfirmed(const BlockInfo& block, const Hash& transactionHash, const std::vector<uint64_t>& globalIndices);
 
+  // Key images of owned outputs by transaction public key and output index. They are kept on detach, so transactions
+  // scanned again after a reorganization or a resync don't generate them once more. Called from scanning threads.
+  std::vector<std::pair<uint32_t, KeyImage>> getCachedKeyImages(const PublicKey& transactionPublicKey);
+  void cacheKeyImages(const PublicKey& transactionPublicKey, const std::vector<std::pair<uint32_t, KeyImage>>& keyImages);
+
   // ITransfersSubscription
   virtual AccountAddress getAddress() override;
   virtual ITransfersContainer& getContainer() override;
@@ -48,6 +57,9 @@ private:
   TransfersContainer m_transfers;
   AccountSubscription m_subscription;
   const CryptoNote::Currency& m_currency;
+
+  std::mutex m_keyImagesMutex;
+  std::unordered_map<PublicKey, std::vector<std::pair<uint32_t, KeyImage>>> m_keyImages;
 };
 
 }
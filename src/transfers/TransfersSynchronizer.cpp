@@ -21,6 +21,8 @@
 #include "serialization/BinaryInputStreamSerializer.h"
 #include "serialization/BinaryOutputStreamSerializer.h"
 
+#include <thread>
+
 namespace CryptoNote {
 
 void serialize(AccountAddress& acc, const std::string& name, CryptoNote::ISerializer& s) {
@@ -30,10 +32,20 @@ void serialize(AccountAddress& acc, const std::string& name, CryptoNote::ISerial
   s.endObject();
 }
 
-const uint32_t TRANSFERS_STORAGE_ARCHIVE_VERSION = 0;
+const uint32_t TRANSFERS_STORAGE_ARCHIVE_VERSION = 1;
+
+namespace {
+
+// the thread calling onNewBlocks scans too
+size_t scanningThreadCount() {
+  size_t threads = std::thread::hardware_concurrency();
+  return threads > 1 ? threads - 1 : 1;
+}
+
+}
 
 TransfersSyncronizer::TransfersSyncronizer(const CryptoNote::Currency& currency, IBlockchainSynchronizer& sync, INode& node) :
-  m_currency(currency), m_sync(sync), m_node(node) {
+  m_scanningPool(scanningThreadCount()), m_currency(currency), m_sync(sync), m_node(node) {
 }
 
 TransfersSyncronizer::~TransfersSyncronizer() {
@@ -48,7 +60,7 @@ ITransfersSubscription& TransfersSyncronizer::addSubscription(const AccountSubsc
 
   if (it == m_consumers.end()) {
     std::unique_ptr<TransfersConsumer> consumer(
-      new TransfersConsumer(m_currency, m_node, acc.keys.viewSecretKey));
+      new TransfersConsumer(m_currency, m_node, acc.keys.viewSecretKey, m_scanningPool));
     m_sync.addConsumer(consumer.get());
     it = m_consumers.insert(std::make_pair(acc.keys.address.viewPublicKey, std::move(consumer))).first;
   }
@@ -81,16 +93,28 @@ ITransfersSubscription* TransfersSyncronizer::getSubscription(const AccountAddre
 }
 
 void TransfersSyncronizer::save(std::ostream& os) {
+  saveConsumers(os, nullptr);
+}
+
+void TransfersSyncronizer::saveConsumer(std::ostream& os, const PublicKey& viewKey) {
+  saveConsumers(os, &viewKey);
+}
+
+void TransfersSyncronizer::saveConsumers(std::ostream& os, const PublicKey* viewKey) {
   m_sync.save(os);
 
   CryptoNote::BinaryOutputStreamSerializer s(os);
   s(const_cast<uint32_t&>(TRANSFERS_STORAGE_ARCHIVE_VERSION), "version");
 
-  size_t subscriptionCount = m_consumers.size();
+  size_t subscriptionCount = viewKey == nullptr ? m_consumers.size() : m_consumers.count(*viewKey);
 
   s.beginArray(subscriptionCount, "consumers");
 
   for (const auto& consumer : m_consumers) {
+    if (viewKey != nullptr && consumer.first != *viewKey) {
+      continue;
+    }
+
     s.beginObject("");
     s(const_cast<PublicKey&>(consumer.first), "view_key");
 
@@ -21,6 +21,8 @@
 #include "IBlockchainSynchronizer.h"
 #include "TypeHelpers.h"
 
+#include "Common/ThreadPool.h"
+
 #include <unordered_map>
 #include <memory>
 #include <cstring>
@@ -50,7 +52,15 @@ public:
   virtual void save(std::ostream& os) override;
   virtual void load(std::istream& in) override;
 
+  // state of the consumer of one view key only, in the format of save(); load() skips consumers it doesn't have, so
+  // wallets sharing the synchronizer keep their own states
+  void saveConsumer(std::ostream& os, const PublicKey& viewKey);
+
 private:
+  void saveConsumers(std::ostream& os, const PublicKey* viewKey);
+
+  // shared by all consumers, has to outlive them
+  Common::ThreadPool m_scanningPool;
 
   // map { view public key -> consumer }
   std::unordered_map<PublicKey, std::unique_ptr<TransfersConsumer>> m_consumers;
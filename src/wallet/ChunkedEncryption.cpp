@@ -0,0 +1,134 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ChunkedEncryption.h"
+
+#include <stdexcept>
+
+#include "crypto/crypto.h"
+#include "serialization/BinaryInputStreamSerializer.h"
+#include "serialization/BinaryOutputStreamSerializer.h"
+
+namespace CryptoNote {
+
+EncryptingStreambuf::EncryptingStreambuf(std::ostream& destination, const crypto::chacha8_key& key) :
+  destination(destination), key(key), plain(CHUNK_SIZE), cipher(CHUNK_SIZE), finished(false) {
+  setp(plain.data(), plain.data() + plain.size());
+}
+
+void EncryptingStreambuf::finish() {
+  if (finished) {
+    return;
+  }
+
+  if (pptr() != pbase()) {
+    writeChunk(pptr() - pbase());
+  }
+
+  writeChunk(0);
+  setp(nullptr, nullptr);
+  finished = true;
+}
+
+EncryptingStreambuf::int_type EncryptingStreambuf::overflow(int_type ch) {
+  if (finished) {
+    return traits_type::eof();
+  }
+
+  if (pptr() != pbase()) {
+    writeChunk(pptr() - pbase());
+    setp(plain.data(), plain.data() + plain.size());
+  }
+
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+
+  return traits_type::not_eof(ch);
+}
+
+// chunk is its size followed by iv and data for a non-empty one
+void EncryptingStreambuf::writeChunk(size_t size) {
+  BinaryOutputStreamSerializer s(destination);
+  uint64_t chunkSize = size;
+  s(chunkSize, "size");
+  if (size != 0) {
+    crypto::chacha8_iv iv = crypto::rand<crypto::chacha8_iv>();
+    crypto::chacha8(plain.data(), size, key, iv, cipher.data());
+    s.binary(&iv, sizeof(iv), "iv");
+    s.binary(cipher.data(), size, "data");
+  }
+
+  if (!destination) {
+    throw std::runtime_error("Failed to write encrypted chunk");
+  }
+}
+
+DecryptingStreambuf::DecryptingStreambuf(std::istream& source, const crypto::chacha8_key& key) :
+  source(source), key(key), plain(EncryptingStreambuf::CHUNK_SIZE), cipher(EncryptingStreambuf::CHUNK_SIZE), finished(false) {
+  setg(plain.data(), plain.data(), plain.data());
+}
+
+void DecryptingStreambuf::finish() {
+  while (readChunk()) {
+  }
+}
+
+DecryptingStreambuf::int_type DecryptingStreambuf::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  if (!readChunk()) {
+    return traits_type::eof();
+  }
+
+  return traits_type::to_int_type(*gptr());
+}
+
+bool DecryptingStreambuf::readChunk() {
+  if (finished) {
+    return false;
+  }
+
+  BinaryInputStreamSerializer s(source);
+  uint64_t size;
+  s(size, "size");
+  if (size == 0) {
+    finished = true;
+    setg(plain.data(), plain.data(), plain.data());
+    return false;
+  }
+
+  if (size > plain.size()) {
+    throw std::runtime_error("Encrypted chunk is too large");
+  }
+
+  crypto::chacha8_iv iv;
+  s.binary(&iv, sizeof(iv), "iv");
+  s.binary(cipher.data(), static_cast<size_t>(size), "data");
+  if (!source) {
+    throw std::runtime_error("Failed to read encrypted chunk");
+  }
+
+  crypto::chacha8(cipher.data(), static_cast<size_t>(size), key, iv, plain.data());
+  setg(plain.data(), plain.data(), plain.data() + size);
+  return true;
+}
+
+}
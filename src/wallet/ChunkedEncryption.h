@@ -0,0 +1,77 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include "crypto/chacha8.h"
+
+namespace CryptoNote {
+
+// Sections of wallet files since version 3 are sequences of chunks encrypted with own random iv each, ended by an
+// empty chunk. They are written and read through a buffer of one chunk, so memory doesn't grow with the section.
+class EncryptingStreambuf : public std::streambuf {
+public:
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+  EncryptingStreambuf(std::ostream& destination, const crypto::chacha8_key& key);
+  EncryptingStreambuf(const EncryptingStreambuf&) = delete;
+  EncryptingStreambuf& operator=(const EncryptingStreambuf&) = delete;
+
+  // Writes buffered data and the end of the section, nothing can be written after it
+  void finish();
+
+protected:
+  virtual int_type overflow(int_type ch) override;
+
+private:
+  void writeChunk(size_t size);
+
+  std::ostream& destination;
+  const crypto::chacha8_key& key;
+  std::vector<char> plain;
+  std::vector<char> cipher;
+  bool finished;
+};
+
+class DecryptingStreambuf : public std::streambuf {
+public:
+  DecryptingStreambuf(std::istream& source, const crypto::chacha8_key& key);
+  DecryptingStreambuf(const DecryptingStreambuf&) = delete;
+  DecryptingStreambuf& operator=(const DecryptingStreambuf&) = delete;
+
+  // Skips the rest of the section, so the source is positioned after it
+  void finish();
+
+protected:
+  virtual int_type underflow() override;
+
+private:
+  bool readChunk();
+
+  std::istream& source;
+  const crypto::chacha8_key& key;
+  std::vector<char> plain;
+  std::vector<char> cipher;
+  bool finished;
+};
+
+}
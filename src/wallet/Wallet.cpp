@@ -99,7 +99,7 @@ namespace CryptoNote {
 
 class SyncStarter : public CryptoNote::IWalletObserver {
 public:
-  SyncStarter(BlockchainSynchronizer& sync) : m_sync(sync) {}
+  SyncStarter(WalletSynchronizer& sync) : m_sync(sync) {}
   virtual ~SyncStarter() {}
 
   virtual void initCompleted(std::error_code result) {
@@ -108,7 +108,7 @@ public:
     }
   }
 
-  BlockchainSynchronizer& m_sync;
+  WalletSynchronizer& m_sync;
 };
 
 Wallet::Wallet(const CryptoNote::Currency& currency, INode& node) :
@@ -118,14 +118,30 @@ Wallet::Wallet(const CryptoNote::Currency& currency, INode& node) :
   m_isStopping(false),
   m_lastNotifiedActualBalance(0),
   m_lastNotifiedPendingBalance(0),
-  m_blockchainSync(node, currency.genesisBlockHash()),
-  m_transfersSync(currency, m_blockchainSync, node),
+  m_ownSync(new WalletSynchronizer(currency, node)),
+  m_sync(*m_ownSync),
   m_transferDetails(nullptr),
   m_sender(nullptr),
-  m_onInitSyncStarter(new SyncStarter(m_blockchainSync))
+  m_onInitSyncStarter(new SyncStarter(m_sync))
 {
   addObserver(m_onInitSyncStarter.get());
-  m_blockchainSync.addObserver(this);
+  m_sync.blockchain().addObserver(this);
+}
+
+Wallet::Wallet(const CryptoNote::Currency& currency, INode& node, WalletSynchronizer& sync) :
+  m_state(NOT_INITIALIZED),
+  m_currency(currency),
+  m_node(node),
+  m_isStopping(false),
+  m_lastNotifiedActualBalance(0),
+  m_lastNotifiedPendingBalance(0),
+  m_sync(sync),
+  m_transferDetails(nullptr),
+  m_sender(nullptr),
+  m_onInitSyncStarter(new SyncStarter(m_sync))
+{
+  // observes the shared synchronizer from initSync on, balances aren't available before
+  addObserver(m_onInitSyncStarter.get());
 }
 
 Wallet::~Wallet() {
@@ -139,10 +155,10 @@ Wallet::~Wallet() {
     }
   }
 
-    m_blockchainSync.removeObserver(this);
-    m_blockchainSync.stop();
-    m_asyncContextCounter.waitAsyncContextsFinish();
-    m_sender.release();
+  stopSync();
+  m_asyncContextCounter.waitAsyncContextsFinish();
+  releaseSync();
+  m_sender.release();
 }
 
 void Wallet::addObserver(IWalletObserver* observer) {
@@ -155,6 +171,7 @@ void Wallet::removeObserver(IWalletObserver* observer) {
 
 void Wallet::initAndGenerate(const std::string& password) {
   {
+    SynchronizationPause pause(m_sync);
     std::unique_lock<std::mutex> stateLock(m_cacheMutex);
 
     if (m_state != NOT_INITIALIZED) {
@@ -163,8 +180,10 @@ void Wallet::initAndGenerate(const std::string& password) {
 
     m_account.generate();
     m_password = password;
+    deriveKey();
 
     initSync();
+    m_state = INITIALIZED;
   }
 
   m_observerManager.notify(&IWalletObserver::initCompleted, std::error_code());
@@ -172,6 +191,7 @@ void Wallet::initAndGenerate(const std::string& password) {
 
 void Wallet::initWithKeys(const WalletAccountKeys& accountKeys, const std::string& password) {
   {
+    SynchronizationPause pause(m_sync);
     std::unique_lock<std::mutex> stateLock(m_cacheMutex);
 
     if (m_state != NOT_INITIALIZED) {
@@ -199,8 +219,10 @@ void Wallet::initWithKeys(const WalletAccountKeys& accountKeys, const std::strin
     m_account.set_keys(keys);
     m_account.set_createtime(ACCOUN_CREATE_TIME_ACCURACY);
     m_password = password;
+    deriveKey();
 
     initSync();
+    m_state = INITIALIZED;
   }
 
   m_observerManager.notify(&IWalletObserver::initCompleted, std::error_code());
@@ -228,33 +250,70 @@ void Wallet::initSync() {
   sub.syncStart.height = 0;
   sub.syncStart.timestamp = m_account.get_createtime() - ACCOUN_CREATE_TIME_ACCURACY;
   
-  auto& subObject = m_transfersSync.addSubscription(sub);
+  auto& subObject = m_sync.transfers().addSubscription(sub);
   m_transferDetails = &subObject.getContainer();
   subObject.addObserver(this);
 
+  if (!m_ownSync) {
+    m_sync.blockchain().addObserver(this);
+  }
+
   m_sender.reset(new WalletTransactionSender(m_currency, m_transactionsCache, m_account.get_keys(), *m_transferDetails));
-  m_state = INITIALIZED;
+}
+
+void Wallet::stopSync() {
+  m_sync.blockchain().removeObserver(this);
+  if (m_ownSync) {
+    m_sync.stop();
+  } else {
+    m_sync.pause();
+  }
+}
+
+// the subscription is dropped from a shared synchronizer, the other wallets go on synchronizing
+void Wallet::releaseSync() {
+  if (m_ownSync) {
+    return;
+  }
+
+  if (m_transferDetails != nullptr) {
+    m_sync.transfers().removeSubscription(reinterpret_cast<const AccountKeys&>(m_account.get_keys()).address);
+    m_transferDetails = nullptr;
+  }
+
+  m_sync.resume();
 }
 
 void Wallet::doLoad(std::istream& source) {
   ContextCounterHolder counterHolder(m_asyncContextCounter);
   try {
-    std::unique_lock<std::mutex> lock(m_cacheMutex);
-    
-    std::string cache;
     WalletSerializer serializer(m_account, m_transactionsCache);
-    serializer.deserialize(source, m_password, cache);
-      
-    initSync();
 
-    try {
-    if (!cache.empty()) {
-      std::stringstream stream(cache);
-      m_transfersSync.load(stream);
+    {
+      std::unique_lock<std::mutex> lock(m_cacheMutex);
+      // password is checked before the rest of the file is read
+      deriveKey();
+      serializer.deserializeKeys(source, m_key.get());
+      m_state = LOADING_CACHE;
+    }
+
+    // other calls don't touch transactions and transfers until the state is INITIALIZED, address is available already
+    {
+      SynchronizationPause pause(m_sync);
+      initSync();
+
+      // the cache is loaded while it is read from the source
+      serializer.deserializeDetails([this](std::istream& stream) {
+        try {
+          m_sync.transfers().load(stream);
+        } catch (const std::exception&) {
+          // ignore cache loading errors
+        }
+      });
+
+      // a shared synchronizer resumes notifying this wallet right after the pause
+      runAtomic(m_cacheMutex, [this] () {this->m_state = Wallet::INITIALIZED;} );
     }
-    } catch (const std::exception&) {
-      // ignore cache loading errors
-  }
   }
   catch (std::system_error& e) {
     runAtomic(m_cacheMutex, [this] () {this->m_state = Wallet::NOT_INITIALIZED;} );
@@ -285,9 +344,9 @@ void Wallet::shutdown() {
     m_sender->stop();
   }
 
-  m_blockchainSync.removeObserver(this);
-  m_blockchainSync.stop();
+  stopSync();
   m_asyncContextCounter.waitAsyncContextsFinish();
+  releaseSync();
 
   m_sender.release();
    
@@ -295,6 +354,7 @@ void Wallet::shutdown() {
     std::unique_lock<std::mutex> lock(m_cacheMutex);
     m_isStopping = false;
     m_state = NOT_INITIALIZED;
+    m_transactionsBatch.clear();
   }
 }
 
@@ -345,22 +405,35 @@ void Wallet::doSave(std::ostream& destination, bool saveDetailed, bool saveCache
   ContextCounterHolder counterHolder(m_asyncContextCounter);
 
   try {
-    m_blockchainSync.stop();
-    std::unique_lock<std::mutex> lock(m_cacheMutex);
-    
-    WalletSerializer serializer(m_account, m_transactionsCache);
+    // the state is copied under the lock and encrypted and written without it, so the wallet keeps serving requests
+    // while a big wallet is being saved. The state stays SAVING until then so saves don't overlap.
+    CryptoNote::account_base account;
+    WalletUserTransactionsCache transactions;
+    crypto::chacha8_key key;
     std::string cache;
 
-    if (saveCache) {
-      std::stringstream stream;
-      m_transfersSync.save(stream);
-      cache = stream.str();
+    {
+      SynchronizationPause pause(m_sync);
+      std::unique_lock<std::mutex> lock(m_cacheMutex);
+
+      account = m_account;
+      key = m_key.get();
+      if (saveDetailed) {
+        transactions = m_transactionsCache;
+      }
+
+      if (saveCache) {
+        std::stringstream cacheStream;
+        m_sync.transfers().saveConsumer(cacheStream, reinterpret_cast<const AccountKeys&>(m_account.get_keys()).address.viewPublicKey);
+        cache = cacheStream.str();
+      }
     }
 
-    serializer.serialize(destination, m_password, saveDetailed, cache);
+    WalletSerializer serializer(account, transactions);
+    serializer.serialize(destination, key, saveDetailed, cache);
 
-    m_state = INITIALIZED;
-    m_blockchainSync.start(); //XXX: start can throw. what to do in this case?
+    runAtomic(m_cacheMutex, [this] () {this->m_state = Wallet::INITIALIZED;} );
+    //XXX: resuming the synchronization can throw. what to do in this case?
     }
   catch (std::system_error& e) {
     runAtomic(m_cacheMutex, [this] () {this->m_state = Wallet::INITIALIZED;} );
@@ -386,13 +459,21 @@ std::error_code Wallet::changePassword(const std::string& oldPassword, const std
 
   //we don't let the user to change the password while saving
   m_password = newPassword;
+  deriveKey();
 
   return std::error_code();
 }
 
+void Wallet::deriveKey() {
+  crypto::cn_context context;
+  crypto::generate_chacha8_key(context, m_password, m_key.get());
+}
+
 std::string Wallet::getAddress() {
   std::unique_lock<std::mutex> lock(m_cacheMutex);
-  throwIfNotInitialised();
+  if (m_state == NOT_INITIALIZED || m_state == LOADING) {
+    throw std::system_error(make_error_code(CryptoNote::error::NOT_INITIALIZED));
+  }
 
   return m_currency.accountAddressAsString(m_account);
 }
@@ -448,6 +529,46 @@ bool Wallet::getTransfer(TransferId transferId, Transfer& transfer) {
   return m_transactionsCache.getTransfer(transferId, transfer);
 }
 
+std::vector<TransactionId> Wallet::getTransactionsByHeight(uint64_t firstHeight, uint64_t lastHeight, size_t offset, size_t limit) {
+  std::unique_lock<std::mutex> lock(m_cacheMutex);
+  throwIfNotInitialised();
+
+  return m_transactionsCache.getTransactionsByHeight(firstHeight, lastHeight, offset, limit);
+}
+
+std::vector<IncomingTransfer> Wallet::getIncomingTransfers(const IncomingTransfersFilter& filter, size_t offset, size_t limit) {
+  std::unique_lock<std::mutex> lock(m_cacheMutex);
+  throwIfNotInitialised();
+
+  std::vector<IncomingTransfer> transfers;
+  if (limit == 0) {
+    return transfers;
+  }
+
+  uint32_t flags = filter.includeUnspent ? ITransfersContainer::IncludeAll : ITransfersContainer::IncludeTypeAll;
+  m_transferDetails->getTransfersByHeight(filter.firstHeight, filter.lastHeight, flags, filter.includeSpent,
+    [&](const TransactionOutputInformation& output, uint64_t blockHeight, bool spent) {
+    if (output.amount < filter.minAmount) {
+      return true;
+    }
+
+    if (offset > 0) {
+      --offset;
+      return true;
+    }
+
+    IncomingTransfer transfer;
+    transfer.transactionHash = output.transactionHash;
+    transfer.amount = output.amount;
+    transfer.blockHeight = blockHeight;
+    transfer.spent = spent;
+    transfers.push_back(transfer);
+    return transfers.size() < limit;
+  });
+
+  return transfers;
+}
+
 TransactionId Wallet::sendTransaction(const Transfer& transfer, uint64_t fee, const std::string& extra, uint64_t mixIn, uint64_t unlockTimestamp) {
   std::vector<Transfer> transfers;
   transfers.push_back(transfer);
@@ -477,6 +598,27 @@ TransactionId Wallet::sendTransaction(const std::vector<Transfer>& transfers, ui
   return txId;
 }
 
+std::vector<TransactionId> Wallet::sendTransactions(const std::vector<TransactionParameters>& transactions) {
+  std::vector<TransactionId> txIds;
+  std::shared_ptr<WalletRequest> request;
+  std::deque<std::shared_ptr<WalletEvent> > events;
+  throwIfNotInitialised();
+
+  {
+    std::unique_lock<std::mutex> lock(m_cacheMutex);
+    request = m_sender->makeSendBatchRequest(txIds, events, transactions);
+  }
+
+  notifyClients(events);
+
+  if (request) {
+    m_asyncContextCounter.addAsyncContext();
+    request->perform(m_node, std::bind(&Wallet::sendTransactionCallback, this, std::placeholders::_1, std::placeholders::_2));
+  }
+
+  return txIds;
+}
+
 void Wallet::sendTransactionCallback(WalletRequest::Callback callback, std::error_code ec) {
   ContextCounterHolder counterHolder(m_asyncContextCounter);
   std::deque<std::shared_ptr<WalletEvent> > events;
@@ -518,6 +660,9 @@ std::error_code Wallet::cancelTransaction(size_t transactionId) {
 }
 
 void Wallet::synchronizationProgressUpdated(uint64_t current, uint64_t total) {
+  // transactions changed by the processed blocks
+  notifyTransactionsBatch();
+
   // forward notification
   m_observerManager.notify(&IWalletObserver::synchronizationProgressUpdated, current, total);
 
@@ -526,6 +671,8 @@ void Wallet::synchronizationProgressUpdated(uint64_t current, uint64_t total) {
 }
 
 void Wallet::synchronizationCompleted(std::error_code result) {
+  notifyTransactionsBatch();
+
   if (result != std::make_error_code(std::errc::interrupted)) {
     m_observerManager.notify(&IWalletObserver::synchronizationCompleted, result);
   }
@@ -536,35 +683,21 @@ void Wallet::synchronizationCompleted(std::error_code result) {
 }
 
 void Wallet::onTransactionUpdated(ITransfersSubscription* object, const Hash& transactionHash) {
-  std::shared_ptr<WalletEvent> event;
-
   TransactionInformation txInfo;
   int64_t txBalance;
   if (m_transferDetails->getTransactionInformation(transactionHash, txInfo, txBalance)) {
     std::unique_lock<std::mutex> lock(m_cacheMutex);
-    event = m_transactionsCache.onTransactionUpdated(txInfo, txBalance);
-  }
-
-  if (event.get()) {
-    event->notify(m_observerManager);
+    m_transactionsCache.onTransactionUpdated(txInfo, txBalance, m_transactionsBatch);
   }
 }
 
 void Wallet::onTransactionDeleted(ITransfersSubscription* object, const Hash& transactionHash) {
-  std::shared_ptr<WalletEvent> event;
-
-  {
   std::unique_lock<std::mutex> lock(m_cacheMutex);
-    event = m_transactionsCache.onTransactionDeleted(transactionHash);
-  }
-
-  if (event.get()) {
-    event->notify(m_observerManager);
-  }
+  m_transactionsCache.onTransactionDeleted(transactionHash, m_transactionsBatch);
 }
 
 void Wallet::throwIfNotInitialised() {
-  if (m_state == NOT_INITIALIZED || m_state == LOADING) {
+  if (m_state == NOT_INITIALIZED || m_state == LOADING || m_state == LOADING_CACHE) {
     throw std::system_error(make_error_code(CryptoNote::error::NOT_INITIALIZED));
   }
   assert(m_transferDetails);
@@ -578,6 +711,17 @@ void Wallet::notifyClients(std::deque<std::shared_ptr<WalletEvent> >& events) {
   }
 }
 
+// synchronizer threads only, so batches are delivered in order
+void Wallet::notifyTransactionsBatch() {
+  WalletTransactionsBatchEvent batch;
+  {
+    std::unique_lock<std::mutex> lock(m_cacheMutex);
+    batch.swap(m_transactionsBatch);
+  }
+
+  batch.notify(m_observerManager);
+}
+
 void Wallet::notifyIfBalanceChanged() {
   auto actual = actualBalance();
   auto prevActual = m_lastNotifiedActualBalance.exchange(actual);
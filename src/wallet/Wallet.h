@@ -31,14 +31,14 @@
 #include "cryptonote_core/tx_extra.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "cryptonote_core/Currency.h"
+#include "crypto/locked-key.h"
 #include "WalletUserTransactionsCache.h"
 #include "WalletUnconfirmedTransactions.h"
 
 #include "WalletTransactionSender.h"
 #include "WalletRequest.h"
 
-#include "transfers/BlockchainSynchronizer.h"
-#include "transfers/TransfersSynchronizer.h"
+#include "WalletSynchronizer.h"
 
 namespace CryptoNote {
 
@@ -51,6 +51,8 @@ class Wallet :
 
 public:
   Wallet(const CryptoNote::Currency& currency, INode& node);
+  // subscribes to a synchronizer shared with other wallets, shutdown leaves it running for them
+  Wallet(const CryptoNote::Currency& currency, INode& node, WalletSynchronizer& sync);
   virtual ~Wallet();
 
   virtual void addObserver(IWalletObserver* observer);
@@ -78,9 +80,12 @@ public:
 
   virtual bool getTransaction(TransactionId transactionId, TransactionInfo& transaction);
   virtual bool getTransfer(TransferId transferId, Transfer& transfer);
+  virtual std::vector<TransactionId> getTransactionsByHeight(uint64_t firstHeight, uint64_t lastHeight, size_t offset, size_t limit);
+  virtual std::vector<IncomingTransfer> getIncomingTransfers(const IncomingTransfersFilter& filter, size_t offset, size_t limit);
 
   virtual TransactionId sendTransaction(const Transfer& transfer, uint64_t fee, const std::string& extra = "", uint64_t mixIn = 0, uint64_t unlockTimestamp = 0);
   virtual TransactionId sendTransaction(const std::vector<Transfer>& transfers, uint64_t fee, const std::string& extra = "", uint64_t mixIn = 0, uint64_t unlockTimestamp = 0);
+  virtual std::vector<TransactionId> sendTransactions(const std::vector<TransactionParameters>& transactions);
   virtual std::error_code cancelTransaction(size_t transactionId);
 
   virtual void getAccountKeys(WalletAccountKeys& keys);
@@ -96,7 +101,10 @@ private:
   virtual void onTransactionDeleted(ITransfersSubscription* object, const Hash& transactionHash) override;
 
   void initSync();
+  void stopSync();
+  void releaseSync();
   void throwIfNotInitialised();
+  void deriveKey();
 
   void doSave(std::ostream& destination, bool saveDetailed, bool saveCache);
   void doLoad(std::istream& source);
@@ -105,12 +113,15 @@ private:
   void sendTransactionCallback(WalletRequest::Callback callback, std::error_code ec);
   void notifyClients(std::deque<std::shared_ptr<WalletEvent> >& events);
   void notifyIfBalanceChanged();
+  void notifyTransactionsBatch();
 
   enum WalletState
   {
     NOT_INITIALIZED = 0,
     INITIALIZED,
     LOADING,
+    // keys are loaded, transactions and transfers are not yet
+    LOADING_CACHE,
     SAVING
   };
 
@@ -118,6 +129,10 @@ private:
   std::mutex m_cacheMutex;
   CryptoNote::account_base m_account;
   std::string m_password;
+  // derived from m_password once, saves encrypt with it instead of running the slow hash each time
+  crypto::locked_chacha8_key m_key;
+  // transaction changes made by the synchronizer, delivered when it reports progress. Guarded by m_cacheMutex
+  WalletTransactionsBatchEvent m_transactionsBatch;
   const CryptoNote::Currency& m_currency;
   INode& m_node;
   bool m_isStopping;
@@ -125,8 +140,8 @@ private:
   std::atomic<uint64_t> m_lastNotifiedActualBalance;
   std::atomic<uint64_t> m_lastNotifiedPendingBalance;
 
-  BlockchainSynchronizer m_blockchainSync;
-  TransfersSyncronizer m_transfersSync;
+  std::unique_ptr<WalletSynchronizer> m_ownSync;
+  WalletSynchronizer& m_sync;
   ITransfersContainer* m_transferDetails;
 
   WalletUserTransactionsCache m_transactionsCache;
@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <unordered_set>
+#include <vector>
+
 #include "IWallet.h"
 #include "Common/ObserverManager.h"
 
@@ -76,6 +79,62 @@ private:
   TransactionId m_id;
 };
 
+// Collects transaction changes until a block range is processed, then delivers them in two calls
+class WalletTransactionsBatchEvent : public WalletEvent
+{
+public:
+  virtual ~WalletTransactionsBatchEvent() {};
+
+  void addCreated(TransactionId transactionId)
+  {
+    if (m_reported.insert(transactionId).second) {
+      m_created.push_back(transactionId);
+    }
+  }
+
+  void addUpdated(TransactionId transactionId)
+  {
+    if (m_reported.insert(transactionId).second) {
+      m_updated.push_back(transactionId);
+    }
+  }
+
+  bool empty() const
+  {
+    return m_reported.empty();
+  }
+
+  void clear()
+  {
+    m_created.clear();
+    m_updated.clear();
+    m_reported.clear();
+  }
+
+  void swap(WalletTransactionsBatchEvent& other)
+  {
+    m_created.swap(other.m_created);
+    m_updated.swap(other.m_updated);
+    m_reported.swap(other.m_reported);
+  }
+
+  virtual void notify(tools::ObserverManager<CryptoNote::IWalletObserver>& observer)
+  {
+    if (!m_created.empty()) {
+      observer.notify(&IWalletObserver::externalTransactionsCreated, m_created);
+    }
+
+    if (!m_updated.empty()) {
+      observer.notify(&IWalletObserver::transactionsUpdated, m_updated);
+    }
+  }
+
+private:
+  std::vector<TransactionId> m_created;
+  std::vector<TransactionId> m_updated;
+  std::unordered_set<TransactionId> m_reported;
+};
+
 class WalletSynchronizationProgressUpdatedEvent : public WalletEvent
 {
 public:
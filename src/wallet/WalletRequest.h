@@ -60,6 +60,26 @@ private:
   Callback m_cb;
 };
 
+class WalletGetRandomOutsByAmountsBatchRequest: public WalletRequest
+{
+public:
+  WalletGetRandomOutsByAmountsBatchRequest(const std::vector<uint64_t>& amounts, uint64_t outsCount, std::shared_ptr<SendTransactionBatchContext> context, Callback cb) :
+    m_amounts(amounts), m_outsCount(outsCount), m_context(context), m_cb(cb) {};
+
+  virtual ~WalletGetRandomOutsByAmountsBatchRequest() {};
+
+  virtual void perform(INode& node, std::function<void (WalletRequest::Callback, std::error_code)> cb)
+  {
+    node.getRandomOutsByAmounts(std::move(m_amounts), m_outsCount, std::ref(m_context->outs), std::bind(cb, m_cb, std::placeholders::_1));
+  };
+
+private:
+  std::vector<uint64_t> m_amounts;
+  uint64_t m_outsCount;
+  std::shared_ptr<SendTransactionBatchContext> m_context;
+  Callback m_cb;
+};
+
 class WalletRelayTransactionRequest: public WalletRequest
 {
 public:
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <list>
+#include <memory>
 #include <vector>
 
 #include "cryptonote_core/cryptonote_basic.h"
@@ -46,4 +47,13 @@ struct SendTransactionContext
   uint64_t mixIn;
 };
 
+struct SendTransactionBatchContext
+{
+  std::vector<std::shared_ptr<SendTransactionContext>> contexts;
+  // random outputs for selected transfers of all contexts with mixin, in the same order
+  std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount> outs;
+  // signed transactions waiting for relay
+  std::list<std::pair<TransactionId, CryptoNote::Transaction>> relayQueue;
+};
+
 } //namespace CryptoNote
@@ -17,12 +17,15 @@
 
 #include "WalletSerializer.h"
 
+#include <cassert>
+#include <iterator>
 #include <stdexcept>
 
 #include "serialization/BinaryOutputStreamSerializer.h"
 #include "serialization/BinaryInputStreamSerializer.h"
 #include "cryptonote_core/account.h"
 #include "cryptonote_core/cryptonote_serialization.h"
+#include "ChunkedEncryption.h"
 #include "WalletUserTransactionsCache.h"
 #include "WalletErrors.h"
 #include "KeysStorage.h"
@@ -47,39 +50,57 @@ namespace CryptoNote {
 WalletSerializer::WalletSerializer(CryptoNote::account_base& account, WalletUserTransactionsCache& transactionsCache) :
   account(account),
   transactionsCache(transactionsCache),
-  walletSerializationVersion(1)
+  walletSerializationVersion(3),
+  m_source(nullptr),
+  m_loadedVersion(0)
 {
 }
 
-void WalletSerializer::serialize(std::ostream& stream, const std::string& password, bool saveDetailed, const std::string& cache) {
-  std::stringstream plainArchive;
-  CryptoNote::BinaryOutputStreamSerializer serializer(plainArchive);
-  saveKeys(serializer);
-
-  serializer(saveDetailed, "has_details");
-
-  if (saveDetailed) {
-    serializer(transactionsCache, "details");
-  }
-
-  serializer.binary(const_cast<std::string&>(cache), "cache");
-
-  std::string plain = plainArchive.str();
-  std::string cipher;
+void WalletSerializer::serialize(std::ostream& stream, const std::string& password, bool saveDetailed, const std::function<void(std::ostream&)>& saveCache) {
+  crypto::chacha8_key key;
+  crypto::cn_context context;
+  crypto::generate_chacha8_key(context, password, key);
+  serialize(stream, key, saveDetailed, saveCache);
+}
 
-  crypto::chacha8_iv iv = encrypt(plain, password, cipher);
+void WalletSerializer::serialize(std::ostream& stream, const crypto::chacha8_key& key, bool saveDetailed, const std::function<void(std::ostream&)>& saveCache) {
+  std::stringstream keysArchive;
+  CryptoNote::BinaryOutputStreamSerializer keysSerializer(keysArchive);
+  saveKeys(keysSerializer);
 
   uint32_t version = walletSerializationVersion;
   CryptoNote::BinaryOutputStreamSerializer s(stream);
   s.beginObject("wallet");
   s(version, "version");
-  s(iv, "iv");
-  s(cipher, "data");
+  writeSection(s, keysArchive.str(), key, "keys");
+  writeStreamedSection(stream, key, [this, saveDetailed](std::ostream& details) {
+    CryptoNote::BinaryOutputStreamSerializer detailsSerializer(details);
+    saveDetails(detailsSerializer, saveDetailed);
+  });
+
+  writeStreamedSection(stream, key, [&saveCache](std::ostream& cache) {
+    if (saveCache) {
+      saveCache(cache);
+    }
+  });
+
   s.endObject();
 
   stream.flush();
 }
 
+void WalletSerializer::serialize(std::ostream& stream, const std::string& password, bool saveDetailed, const std::string& cache) {
+  serialize(stream, password, saveDetailed, [&cache](std::ostream& cacheStream) {
+    cacheStream.write(cache.data(), cache.size());
+  });
+}
+
+void WalletSerializer::serialize(std::ostream& stream, const crypto::chacha8_key& key, bool saveDetailed, const std::string& cache) {
+  serialize(stream, key, saveDetailed, [&cache](std::ostream& cacheStream) {
+    cacheStream.write(cache.data(), cache.size());
+  });
+}
+
 void WalletSerializer::saveKeys(CryptoNote::ISerializer& serializer) {
   CryptoNote::KeysStorage keys;
   CryptoNote::account_keys acc = account.get_keys();
@@ -93,11 +114,56 @@ void WalletSerializer::saveKeys(CryptoNote::ISerializer& serializer) {
   keys.serialize(serializer, "keys");
 }
 
-crypto::chacha8_iv WalletSerializer::encrypt(const std::string& plain, const std::string& password, std::string& cipher) {
-  crypto::chacha8_key key;
-  crypto::cn_context context;
-  crypto::generate_chacha8_key(context, password, key);
+void WalletSerializer::saveDetails(CryptoNote::ISerializer& serializer, bool saveDetailed) {
+  serializer(saveDetailed, "has_details");
+
+  if (saveDetailed) {
+    serializer(transactionsCache, "details");
+  }
+}
+
+void WalletSerializer::writeSection(CryptoNote::ISerializer& serializer, const std::string& plain, const crypto::chacha8_key& key, const std::string& name) {
+  std::string cipher;
+  crypto::chacha8_iv iv = encrypt(plain, key, cipher);
+
+  serializer.beginObject(name);
+  serializer(iv, "iv");
+  serializer(cipher, "data");
+  serializer.endObject();
+}
+
+void WalletSerializer::writeStreamedSection(std::ostream& stream, const crypto::chacha8_key& key, const std::function<void(std::ostream&)>& write) {
+  EncryptingStreambuf buffer(stream, key);
+  std::ostream plain(&buffer);
+  write(plain);
+  // streams keep errors of their buffers as the bad state
+  if (!plain) {
+    throw std::runtime_error("Failed to write wallet section");
+  }
+
+  buffer.finish();
+}
 
+void WalletSerializer::readStreamedSection(std::istream& stream, const crypto::chacha8_key& key, const std::function<void(std::istream&)>& read) {
+  DecryptingStreambuf buffer(stream, key);
+  std::istream plain(&buffer);
+  read(plain);
+  buffer.finish();
+}
+
+void WalletSerializer::readSection(CryptoNote::ISerializer& serializer, std::string& plain, const crypto::chacha8_key& key, const std::string& name) {
+  crypto::chacha8_iv iv;
+  std::string cipher;
+
+  serializer.beginObject(name);
+  serializer(iv, "iv");
+  serializer(cipher, "data");
+  serializer.endObject();
+
+  decrypt(cipher, plain, iv, key);
+}
+
+crypto::chacha8_iv WalletSerializer::encrypt(const std::string& plain, const crypto::chacha8_key& key, std::string& cipher) {
   cipher.resize(plain.size());
 
   crypto::chacha8_iv iv = crypto::rand<crypto::chacha8_iv>();
@@ -106,8 +172,19 @@ crypto::chacha8_iv WalletSerializer::encrypt(const std::string& plain, const std
   return iv;
 }
 
-
 void WalletSerializer::deserialize(std::istream& stream, const std::string& password, std::string& cache) {
+  deserializeKeys(stream, password);
+  deserializeDetails(cache);
+}
+
+void WalletSerializer::deserializeKeys(std::istream& stream, const std::string& password) {
+  crypto::chacha8_key key;
+  crypto::cn_context context;
+  crypto::generate_chacha8_key(context, password, key);
+  deserializeKeys(stream, key);
+}
+
+void WalletSerializer::deserializeKeys(std::istream& stream, const crypto::chacha8_key& key) {
   CryptoNote::BinaryInputStreamSerializer serializerEncrypted(stream);
 
   serializerEncrypted.beginObject("wallet");
@@ -115,20 +192,30 @@ void WalletSerializer::deserialize(std::istream& stream, const std::string& pass
   uint32_t version;
   serializerEncrypted(version, "version");
 
-  crypto::chacha8_iv iv;
-  serializerEncrypted(iv, "iv");
-
-  std::string cipher;
-  serializerEncrypted(cipher, "data");
+  if (version > walletSerializationVersion) {
+    throw std::runtime_error("Unsupported wallet version");
+  }
 
-  serializerEncrypted.endObject();
+  m_key = key;
 
   std::string plain;
-  decrypt(cipher, plain, iv, password);
+  if (version < 2) {
+    crypto::chacha8_iv iv;
+    serializerEncrypted(iv, "iv");
+
+    std::string cipher;
+    serializerEncrypted(cipher, "data");
 
-  std::stringstream decryptedStream(plain);
+    serializerEncrypted.endObject();
+
+    decrypt(cipher, plain, iv, m_key);
+    m_plainArchive.str(plain);
+  } else {
+    readSection(serializerEncrypted, plain, m_key, "keys");
+    m_plainArchive.str(plain);
+  }
 
-  CryptoNote::BinaryInputStreamSerializer serializer(decryptedStream);
+  CryptoNote::BinaryInputStreamSerializer serializer(m_plainArchive);
 
   try
   {
@@ -140,6 +227,64 @@ void WalletSerializer::deserialize(std::istream& stream, const std::string& pass
     throw std::system_error(make_error_code(CryptoNote::error::WRONG_PASSWORD));
   }
 
+  m_source = &stream;
+  m_loadedVersion = version;
+}
+
+void WalletSerializer::deserializeDetails(const std::function<void(std::istream&)>& loadCache) {
+  assert(m_source != nullptr);
+
+  if (m_loadedVersion < 2) {
+    CryptoNote::BinaryInputStreamSerializer serializer(m_plainArchive);
+    loadDetails(serializer);
+    std::string cache;
+    serializer.binary(cache, "cache");
+    if (!cache.empty()) {
+      std::stringstream cacheStream(cache);
+      loadCache(cacheStream);
+    }
+  } else if (m_loadedVersion < 3) {
+    CryptoNote::BinaryInputStreamSerializer serializerEncrypted(*m_source);
+
+    std::string plain;
+    readSection(serializerEncrypted, plain, m_key, "details");
+    std::stringstream detailsArchive(plain);
+    CryptoNote::BinaryInputStreamSerializer serializer(detailsArchive);
+    loadDetails(serializer);
+
+    std::string cache;
+    readSection(serializerEncrypted, cache, m_key, "cache");
+    serializerEncrypted.endObject();
+    if (!cache.empty()) {
+      std::stringstream cacheStream(cache);
+      loadCache(cacheStream);
+    }
+  } else {
+    readStreamedSection(*m_source, m_key, [this](std::istream& details) {
+      CryptoNote::BinaryInputStreamSerializer serializer(details);
+      loadDetails(serializer);
+    });
+
+    readStreamedSection(*m_source, m_key, [&loadCache](std::istream& cache) {
+      if (cache.peek() != std::istream::traits_type::eof()) {
+        loadCache(cache);
+      }
+    });
+
+    CryptoNote::BinaryInputStreamSerializer serializerEncrypted(*m_source);
+    serializerEncrypted.endObject();
+  }
+
+  m_source = nullptr;
+}
+
+void WalletSerializer::deserializeDetails(std::string& cache) {
+  deserializeDetails([&cache](std::istream& cacheStream) {
+    cache.assign(std::istreambuf_iterator<char>(cacheStream), std::istreambuf_iterator<char>());
+  });
+}
+
+void WalletSerializer::loadDetails(CryptoNote::ISerializer& serializer) {
   bool detailsSaved;
 
   serializer(detailsSaved, "has_details");
@@ -147,15 +292,9 @@ void WalletSerializer::deserialize(std::istream& stream, const std::string& pass
   if (detailsSaved) {
     serializer(transactionsCache, "details");
   }
-
-  serializer.binary(cache, "cache");
 }
 
-void WalletSerializer::decrypt(const std::string& cipher, std::string& plain, crypto::chacha8_iv iv, const std::string& password) {
-  crypto::chacha8_key key;
-  crypto::cn_context context;
-  crypto::generate_chacha8_key(context, password, key);
-
+void WalletSerializer::decrypt(const std::string& cipher, std::string& plain, crypto::chacha8_iv iv, const crypto::chacha8_key& key) {
   plain.resize(cipher.size());
 
   crypto::chacha8(cipher.data(), cipher.size(), key, iv, &plain[0]);
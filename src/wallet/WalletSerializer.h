@@ -17,9 +17,11 @@
 
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <ostream>
 #include <istream>
+#include <sstream>
 
 #include "crypto/hash.h"
 #include "crypto/chacha8.h"
@@ -33,23 +35,53 @@ namespace CryptoNote {
 
 class WalletUserTransactionsCache;
 
+// Since version 2 keys, transactions details and transfers cache are stored in separately encrypted sections, in this
+// order. Keys are read and checked without reading the rest of the stream, which may be large. Since version 3 details
+// and cache are streamed through chunked encryption, so they are never held in memory as a whole.
 class WalletSerializer {
 public:
   WalletSerializer(CryptoNote::account_base& account, WalletUserTransactionsCache& transactionsCache);
 
+  // saveCache writes the transfers cache, empty one saves no cache
+  void serialize(std::ostream& stream, const std::string& password, bool saveDetailed, const std::function<void(std::ostream&)>& saveCache);
   void serialize(std::ostream& stream, const std::string& password, bool saveDetailed, const std::string& cache);
+  // Take the key derived from the password with generate_chacha8_key, so callers saving often derive it once
+  void serialize(std::ostream& stream, const crypto::chacha8_key& key, bool saveDetailed, const std::function<void(std::ostream&)>& saveCache);
+  void serialize(std::ostream& stream, const crypto::chacha8_key& key, bool saveDetailed, const std::string& cache);
   void deserialize(std::istream& stream, const std::string& password, std::string& cache);
 
+  // deserialize() in two steps, the stream must stay valid until deserializeDetails() returns
+  void deserializeKeys(std::istream& stream, const std::string& password);
+  void deserializeKeys(std::istream& stream, const crypto::chacha8_key& key);
+  // loadCache reads the transfers cache, it isn't called if no cache was saved
+  void deserializeDetails(const std::function<void(std::istream&)>& loadCache);
+  void deserializeDetails(std::string& cache);
+
 private:
   void saveKeys(CryptoNote::ISerializer& serializer);
   void loadKeys(CryptoNote::ISerializer& serializer);
+  void loadDetails(CryptoNote::ISerializer& serializer);
+
+  void saveDetails(CryptoNote::ISerializer& serializer, bool saveDetailed);
 
-  crypto::chacha8_iv encrypt(const std::string& plain, const std::string& password, std::string& cipher);
-  void decrypt(const std::string& cipher, std::string& plain, crypto::chacha8_iv iv, const std::string& password);
+  void writeSection(CryptoNote::ISerializer& serializer, const std::string& plain, const crypto::chacha8_key& key, const std::string& name);
+  void writeStreamedSection(std::ostream& stream, const crypto::chacha8_key& key, const std::function<void(std::ostream&)>& write);
+  void readStreamedSection(std::istream& stream, const crypto::chacha8_key& key, const std::function<void(std::istream&)>& read);
+  void readSection(CryptoNote::ISerializer& serializer, std::string& plain, const crypto::chacha8_key& key, const std::string& name);
+
+  crypto::chacha8_iv encrypt(const std::string& plain, const crypto::chacha8_key& key, std::string& cipher);
+  void decrypt(const std::string& cipher, std::string& plain, crypto::chacha8_iv iv, const crypto::chacha8_key& key);
 
   CryptoNote::account_base& account;
   WalletUserTransactionsCache& transactionsCache;
   const uint32_t walletSerializationVersion;
+
+  // state between deserializeKeys() and deserializeDetails()
+  std::istream* m_source;
+  uint32_t m_loadedVersion;
+  crypto::chacha8_key m_key;
+  // version 1 stores everything in one section, the part after keys
+  std::stringstream m_plainArchive;
 };
 
 } //namespace CryptoNote
@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "WalletSynchronizer.h"
+
+#include <cassert>
+
+#include "cryptonote_core/Currency.h"
+
+namespace CryptoNote {
+
+WalletSynchronizer::WalletSynchronizer(const CryptoNote::Currency& currency, INode& node) :
+  m_blockchainSync(node, currency.genesisBlockHash()),
+  m_transfersSync(currency, m_blockchainSync, node),
+  m_started(false),
+  m_running(false),
+  m_pauseCount(0) {
+}
+
+void WalletSynchronizer::start() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_started = true;
+  startIfReady();
+}
+
+void WalletSynchronizer::stop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_started = false;
+  if (m_running) {
+    m_blockchainSync.stop();
+    m_running = false;
+  }
+}
+
+void WalletSynchronizer::pause() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  ++m_pauseCount;
+  if (m_running) {
+    m_blockchainSync.stop();
+    m_running = false;
+  }
+}
+
+void WalletSynchronizer::resume() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  assert(m_pauseCount > 0);
+  --m_pauseCount;
+  startIfReady();
+}
+
+void WalletSynchronizer::startIfReady() {
+  if (!m_started || m_running || m_pauseCount > 0) {
+    return;
+  }
+
+  // the last wallet has left, the next one starts it again
+  std::vector<AccountAddress> subscriptions;
+  m_transfersSync.getSubscriptions(subscriptions);
+  if (subscriptions.empty()) {
+    return;
+  }
+
+  m_blockchainSync.start();
+  m_running = true;
+}
+
+}
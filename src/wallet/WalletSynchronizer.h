@@ -0,0 +1,67 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <mutex>
+
+#include "transfers/BlockchainSynchronizer.h"
+#include "transfers/TransfersSynchronizer.h"
+
+namespace CryptoNote {
+
+class Currency;
+class INode;
+
+// Blockchain and transfers synchronizers of one node connection. Wallets sharing it fetch and scan each block once
+// for all of their subscriptions. Subscriptions are changed and states are saved while synchronization is paused;
+// pauses nest and synchronization resumes after the last one if it has been started.
+class WalletSynchronizer {
+public:
+  WalletSynchronizer(const CryptoNote::Currency& currency, INode& node);
+
+  BlockchainSynchronizer& blockchain() { return m_blockchainSync; }
+  TransfersSyncronizer& transfers() { return m_transfersSync; }
+
+  void start();
+  void stop();
+  void pause();
+  void resume();
+
+private:
+  void startIfReady();
+
+  BlockchainSynchronizer m_blockchainSync;
+  TransfersSyncronizer m_transfersSync;
+
+  std::mutex m_mutex;
+  bool m_started;
+  bool m_running;
+  size_t m_pauseCount;
+};
+
+class SynchronizationPause {
+public:
+  explicit SynchronizationPause(WalletSynchronizer& sync) : m_sync(sync) { m_sync.pause(); }
+  SynchronizationPause(const SynchronizationPause&) = delete;
+  ~SynchronizationPause() { m_sync.resume(); }
+
+private:
+  WalletSynchronizer& m_sync;
+};
+
+}
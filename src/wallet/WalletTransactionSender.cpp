@@ -25,12 +25,14 @@
 
 #include <Logging/LoggerGroup.h>
 
-#include <random>
+#include <thread>
 
 namespace {
 
 using namespace CryptoNote;
 
+const size_t ADDRESS_CACHE_SIZE = 1024;
+
 uint64_t countNeededMoney(uint64_t fee, const std::vector<CryptoNote::Transfer>& transfers) {
   uint64_t needed_money = fee;
   for (auto& transfer: transfers) {
@@ -52,13 +54,13 @@ void createChangeDestinations(const CryptoNote::AccountPublicAddress& address, u
 }
 
 void constructTx(const CryptoNote::account_keys keys, const std::vector<CryptoNote::tx_source_entry>& sources, const std::vector<CryptoNote::tx_destination_entry>& splittedDests,
-    const std::string& extra, uint64_t unlockTimestamp, uint64_t sizeLimit, CryptoNote::Transaction& tx) {
+    const std::string& extra, uint64_t unlockTimestamp, uint64_t sizeLimit, Common::ThreadPool& signingPool, CryptoNote::Transaction& tx) {
   std::vector<uint8_t> extraVec;
   extraVec.reserve(extra.size());
   std::for_each(extra.begin(), extra.end(), [&extraVec] (const char el) { extraVec.push_back(el);});
 
   Logging::LoggerGroup nullLog;
-  bool r = CryptoNote::construct_tx(keys, sources, splittedDests, extraVec, tx, unlockTimestamp, nullLog);
+  bool r = CryptoNote::construct_tx(keys, sources, splittedDests, extraVec, tx, unlockTimestamp, nullLog, &signingPool);
 
   CryptoNote::throwIf(!r, CryptoNote::error::INTERNAL_WALLET_ERROR);
   CryptoNote::throwIf(CryptoNote::get_object_blobsize(tx) >= sizeLimit, CryptoNote::error::TRANSACTION_SIZE_TOO_BIG);
@@ -69,6 +71,12 @@ void fillTransactionHash(const CryptoNote::Transaction& tx, CryptoNote::Transact
   memcpy(hash.data(), reinterpret_cast<const uint8_t *>(&h), hash.size());
 }
 
+// the thread handling wallet requests signs too
+size_t signingThreadCount() {
+  size_t threads = std::thread::hardware_concurrency();
+  return threads > 1 ? threads - 1 : 0;
+}
+
 std::shared_ptr<WalletEvent> makeCompleteEvent(WalletUserTransactionsCache& transactionCache, size_t transactionId, std::error_code ec) {
   transactionCache.updateTransactionSendingState(transactionId, ec);
   return std::make_shared<WalletSendTransactionCompletedEvent>(transactionId, ec);
@@ -84,7 +92,8 @@ WalletTransactionSender::WalletTransactionSender(const CryptoNote::Currency& cur
   m_isStoping(false),
   m_keys(keys),
   m_transferDetails(transfersContainer),
-  m_upperTransactionSizeLimit(m_currency.blockGrantedFullRewardZone() * 125 / 100 - m_currency.minerTxBlobReservedSize()) {}
+  m_upperTransactionSizeLimit(m_currency.blockGrantedFullRewardZone() * 125 / 100 - m_currency.minerTxBlobReservedSize()),
+  m_signingPool(signingThreadCount()) {}
 
 void WalletTransactionSender::stop() {
   m_isStoping = true;
@@ -92,7 +101,27 @@ void WalletTransactionSender::stop() {
 
 bool WalletTransactionSender::validateDestinationAddress(const std::string& address) {
   CryptoNote::AccountPublicAddress ignore;
-  return m_currency.parseAccountAddressString(address, ignore);
+  return parseDestinationAddress(address, ignore);
+}
+
+bool WalletTransactionSender::parseDestinationAddress(const std::string& address, CryptoNote::AccountPublicAddress& result) {
+  std::lock_guard<std::mutex> lock(m_addressCacheMutex);
+  auto it = m_addressCache.find(address);
+  if (it != m_addressCache.end()) {
+    result = it->second;
+    return true;
+  }
+
+  if (!m_currency.parseAccountAddressString(address, result)) {
+    return false;
+  }
+
+  if (m_addressCache.size() >= ADDRESS_CACHE_SIZE) {
+    m_addressCache.clear();
+  }
+
+  m_addressCache.emplace(address, result);
+  return true;
 }
 
 void WalletTransactionSender::validateTransfersAddresses(const std::vector<Transfer>& transfers) {
@@ -114,7 +143,8 @@ std::shared_ptr<WalletRequest> WalletTransactionSender::makeSendRequest(Transact
 
   std::shared_ptr<SendTransactionContext> context = std::make_shared<SendTransactionContext>();
 
-  context->foundMoney = selectTransfersToSend(neededMoney, 0 == mixIn, context->dustPolicy.dustThreshold, context->selectedTransfers);
+  OutputSet selectedOutputs;
+  context->foundMoney = selectTransfersToSend(neededMoney, 0 == mixIn, context->dustPolicy.dustThreshold, context->selectedTransfers, selectedOutputs);
   throwIf(context->foundMoney < neededMoney, CryptoNote::error::WRONG_AMOUNT);
 
   transactionId = m_transactionsCache.addNewTransaction(neededMoney, fee, extra, transfers, unlockTimestamp);
@@ -129,6 +159,49 @@ std::shared_ptr<WalletRequest> WalletTransactionSender::makeSendRequest(Transact
   return doSendTransaction(context, events);
 }
 
+std::shared_ptr<WalletRequest> WalletTransactionSender::makeSendBatchRequest(std::vector<TransactionId>& transactionIds, std::deque<std::shared_ptr<WalletEvent> >& events,
+    const std::vector<TransactionParameters>& transactions) {
+
+  using namespace CryptoNote;
+
+  throwIf(transactions.empty(), CryptoNote::error::ZERO_DESTINATION);
+
+  std::vector<uint64_t> neededMoney;
+  for (const TransactionParameters& parameters : transactions) {
+    throwIf(parameters.transfers.empty(), CryptoNote::error::ZERO_DESTINATION);
+    validateTransfersAddresses(parameters.transfers);
+    neededMoney.push_back(countNeededMoney(parameters.fee, parameters.transfers));
+  }
+
+  // every transaction gets its inputs before any of them is added to the cache
+  std::shared_ptr<SendTransactionBatchContext> batch = std::make_shared<SendTransactionBatchContext>();
+  OutputSet batchOutputs;
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    std::shared_ptr<SendTransactionContext> context = std::make_shared<SendTransactionContext>();
+    context->foundMoney = selectTransfersToSend(neededMoney[i], 0 == transactions[i].mixIn, context->dustPolicy.dustThreshold,
+      context->selectedTransfers, batchOutputs);
+    throwIf(context->foundMoney < neededMoney[i], CryptoNote::error::WRONG_AMOUNT);
+    context->mixIn = transactions[i].mixIn;
+    batch->contexts.push_back(context);
+  }
+
+  bool needOuts = false;
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    const TransactionParameters& parameters = transactions[i];
+    TransactionId transactionId = m_transactionsCache.addNewTransaction(neededMoney[i], parameters.fee, parameters.extra, parameters.transfers,
+      parameters.unlockTimestamp);
+    batch->contexts[i]->transactionId = transactionId;
+    transactionIds.push_back(transactionId);
+    needOuts = needOuts || parameters.mixIn != 0;
+  }
+
+  if (needOuts) {
+    return makeGetRandomOutsBatchRequest(batch);
+  }
+
+  return doSendTransactions(batch, events);
+}
+
 std::shared_ptr<WalletRequest> WalletTransactionSender::makeGetRandomOutsRequest(std::shared_ptr<SendTransactionContext> context) {
   uint64_t outsCount = context->mixIn + 1;// add one to make possible (if need) to skip real output key
   std::vector<uint64_t> amounts;
@@ -166,6 +239,77 @@ void WalletTransactionSender::sendTransactionRandomOutsByAmount(std::shared_ptr<
     nextRequest = req;
 }
 
+// one request brings random outputs for the selected transfers of all transactions with mixin
+std::shared_ptr<WalletRequest> WalletTransactionSender::makeGetRandomOutsBatchRequest(std::shared_ptr<SendTransactionBatchContext> batch) {
+  uint64_t mixIn = 0;
+  std::vector<uint64_t> amounts;
+
+  for (const auto& context : batch->contexts) {
+    if (context->mixIn != 0) {
+      mixIn = std::max(mixIn, context->mixIn);
+      for (const auto& td : context->selectedTransfers) {
+        amounts.push_back(td.amount);
+      }
+    }
+  }
+
+  return std::make_shared<WalletGetRandomOutsByAmountsBatchRequest>(amounts, mixIn + 1, batch, std::bind(&WalletTransactionSender::sendBatchRandomOutsByAmount,
+      this, batch, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void WalletTransactionSender::sendBatchRandomOutsByAmount(std::shared_ptr<SendTransactionBatchContext> batch, std::deque<std::shared_ptr<WalletEvent> >& events,
+    boost::optional<std::shared_ptr<WalletRequest> >& nextRequest, std::error_code ec) {
+
+  if (m_isStoping) {
+    ec = make_error_code(CryptoNote::error::TX_CANCELLED);
+  }
+
+  if (ec) {
+    for (const auto& context : batch->contexts) {
+      events.push_back(makeCompleteEvent(m_transactionsCache, context->transactionId, ec));
+    }
+
+    return;
+  }
+
+  // each transaction takes its part of the outputs, the ones short of their mixin fail alone
+  std::vector<std::shared_ptr<SendTransactionContext>> contexts;
+  size_t outsIndex = 0;
+  for (const auto& context : batch->contexts) {
+    if (context->mixIn == 0) {
+      contexts.push_back(context);
+      continue;
+    }
+
+    size_t count = context->selectedTransfers.size();
+    if (batch->outs.size() - outsIndex < count) {
+      events.push_back(makeCompleteEvent(m_transactionsCache, context->transactionId, make_error_code(CryptoNote::error::INTERNAL_WALLET_ERROR)));
+      outsIndex = batch->outs.size();
+      continue;
+    }
+
+    context->outs.assign(std::make_move_iterator(batch->outs.begin() + outsIndex), std::make_move_iterator(batch->outs.begin() + outsIndex + count));
+    outsIndex += count;
+
+    auto scanty_it = std::find_if(context->outs.begin(), context->outs.end(),
+      [&] (CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& out) {return out.outs.size() < context->mixIn;});
+
+    if (scanty_it != context->outs.end()) {
+      events.push_back(makeCompleteEvent(m_transactionsCache, context->transactionId, make_error_code(CryptoNote::error::MIXIN_COUNT_TOO_BIG)));
+      continue;
+    }
+
+    contexts.push_back(context);
+  }
+
+  batch->contexts.swap(contexts);
+  batch->outs.clear();
+
+  std::shared_ptr<WalletRequest> req = doSendTransactions(batch, events);
+  if (req)
+    nextRequest = req;
+}
+
 std::shared_ptr<WalletRequest> WalletTransactionSender::doSendTransaction(std::shared_ptr<SendTransactionContext> context, std::deque<std::shared_ptr<WalletEvent> >& events) {
   if (m_isStoping) {
     events.push_back(makeCompleteEvent(m_transactionsCache, context->transactionId, make_error_code(CryptoNote::error::TX_CANCELLED)));
@@ -177,18 +321,12 @@ std::shared_ptr<WalletRequest> WalletTransactionSender::doSendTransaction(std::s
     TransactionInfo& transaction = m_transactionsCache.getTransaction(context->transactionId);
 
     std::vector<CryptoNote::tx_source_entry> sources;
-    prepareInputs(context->selectedTransfers, context->outs, sources, context->mixIn);
-
-    CryptoNote::tx_destination_entry changeDts;
-    changeDts.amount = 0;
-    uint64_t totalAmount = -transaction.totalAmount;
-    createChangeDestinations(m_keys.m_account_address, totalAmount, context->foundMoney, changeDts);
-
     std::vector<CryptoNote::tx_destination_entry> splittedDests;
-    splitDestinations(transaction.firstTransferId, transaction.transferCount, changeDts, context->dustPolicy, splittedDests);
+    prepareTransaction(*context, sources, splittedDests);
 
+    uint64_t totalAmount = -transaction.totalAmount;
     CryptoNote::Transaction tx;
-    constructTx(m_keys, sources, splittedDests, transaction.extra, transaction.unlockTime, m_upperTransactionSizeLimit, tx);
+    constructTx(m_keys, sources, splittedDests, transaction.extra, transaction.unlockTime, m_upperTransactionSizeLimit, m_signingPool, tx);
 
     fillTransactionHash(tx, transaction.hash);
 
@@ -209,6 +347,90 @@ std::shared_ptr<WalletRequest> WalletTransactionSender::doSendTransaction(std::s
   return std::shared_ptr<WalletRequest>();
 }
 
+// Signing is the costly part, transactions are signed on the pool. The cache is only read until all of them are signed,
+// the wallet lock is held by the caller.
+std::shared_ptr<WalletRequest> WalletTransactionSender::doSendTransactions(std::shared_ptr<SendTransactionBatchContext> batch, std::deque<std::shared_ptr<WalletEvent> >& events) {
+  if (m_isStoping) {
+    for (const auto& context : batch->contexts) {
+      events.push_back(makeCompleteEvent(m_transactionsCache, context->transactionId, make_error_code(CryptoNote::error::TX_CANCELLED)));
+    }
+
+    return std::shared_ptr<WalletRequest>();
+  }
+
+  size_t count = batch->contexts.size();
+  std::vector<CryptoNote::Transaction> transactions(count);
+  std::vector<std::error_code> errors(count);
+
+  m_signingPool.parallelFor(count, [&](size_t i) {
+    SendTransactionContext& context = *batch->contexts[i];
+    try {
+      std::vector<CryptoNote::tx_source_entry> sources;
+      std::vector<CryptoNote::tx_destination_entry> splittedDests;
+      prepareTransaction(context, sources, splittedDests);
+
+      const TransactionInfo& transaction = m_transactionsCache.getTransaction(context.transactionId);
+      constructTx(m_keys, sources, splittedDests, transaction.extra, transaction.unlockTime, m_upperTransactionSizeLimit, m_signingPool, transactions[i]);
+    }
+    catch(std::system_error& ec) {
+      errors[i] = ec.code();
+    }
+    catch(std::exception&) {
+      errors[i] = make_error_code(CryptoNote::error::INTERNAL_WALLET_ERROR);
+    }
+  });
+
+  bool signedAny = false;
+  for (size_t i = 0; i < count; ++i) {
+    const SendTransactionContext& context = *batch->contexts[i];
+    if (errors[i]) {
+      events.push_back(makeCompleteEvent(m_transactionsCache, context.transactionId, errors[i]));
+      continue;
+    }
+
+    TransactionInfo& transaction = m_transactionsCache.getTransaction(context.transactionId);
+    fillTransactionHash(transactions[i], transaction.hash);
+
+    uint64_t totalAmount = -transaction.totalAmount;
+    m_transactionsCache.updateTransaction(context.transactionId, transactions[i], totalAmount, context.selectedTransfers);
+    batch->relayQueue.emplace_back(context.transactionId, std::move(transactions[i]));
+    signedAny = true;
+  }
+
+  if (signedAny) {
+    notifyBalanceChanged(events);
+  }
+
+  return makeRelayBatchRequest(batch);
+}
+
+// transactions of a batch are relayed one after another
+std::shared_ptr<WalletRequest> WalletTransactionSender::makeRelayBatchRequest(std::shared_ptr<SendTransactionBatchContext> batch) {
+  if (batch->relayQueue.empty()) {
+    return std::shared_ptr<WalletRequest>();
+  }
+
+  const auto& next = batch->relayQueue.front();
+  std::shared_ptr<WalletRequest> request = std::make_shared<WalletRelayTransactionRequest>(next.second, std::bind(&WalletTransactionSender::relayBatchCallback,
+      this, batch, next.first, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+  batch->relayQueue.pop_front();
+
+  return request;
+}
+
+void WalletTransactionSender::relayBatchCallback(std::shared_ptr<SendTransactionBatchContext> batch, TransactionId transactionId, std::deque<std::shared_ptr<WalletEvent> >& events,
+                                                  boost::optional<std::shared_ptr<WalletRequest> >& nextRequest, std::error_code ec) {
+  if (m_isStoping) {
+    return;
+  }
+
+  events.push_back(makeCompleteEvent(m_transactionsCache, transactionId, ec));
+
+  std::shared_ptr<WalletRequest> req = makeRelayBatchRequest(batch);
+  if (req)
+    nextRequest = req;
+}
+
 void WalletTransactionSender::relayTransactionCallback(std::shared_ptr<SendTransactionContext> context, std::deque<std::shared_ptr<WalletEvent> >& events,
                                                         boost::optional<std::shared_ptr<WalletRequest> >& nextRequest, std::error_code ec) {
   if (m_isStoping) {
@@ -219,6 +441,20 @@ void WalletTransactionSender::relayTransactionCallback(std::shared_ptr<SendTrans
 }
 
 
+void WalletTransactionSender::prepareTransaction(SendTransactionContext& context, std::vector<CryptoNote::tx_source_entry>& sources,
+                                                 std::vector<CryptoNote::tx_destination_entry>& splittedDests) {
+  const TransactionInfo& transaction = m_transactionsCache.getTransaction(context.transactionId);
+
+  prepareInputs(context.selectedTransfers, context.outs, sources, context.mixIn);
+
+  CryptoNote::tx_destination_entry changeDts;
+  changeDts.amount = 0;
+  uint64_t totalAmount = -transaction.totalAmount;
+  createChangeDestinations(m_keys.m_account_address, totalAmount, context.foundMoney, changeDts);
+
+  splitDestinations(transaction.firstTransferId, transaction.transferCount, changeDts, context.dustPolicy, splittedDests);
+}
+
 void WalletTransactionSender::splitDestinations(TransferId firstTransferId, size_t transfersCount, const CryptoNote::tx_destination_entry& changeDts,
                                                 const TxDustPolicy& dustPolicy, std::vector<CryptoNote::tx_destination_entry>& splittedDests) {
   uint64_t dust = 0;
@@ -242,7 +478,7 @@ void WalletTransactionSender::digitSplitStrategy(TransferId firstTransferId, siz
     Transfer& de = m_transactionsCache.getTransfer(idx);
 
     CryptoNote::AccountPublicAddress addr;
-    if (!m_currency.parseAccountAddressString(de.address, addr)) {
+    if (!parseDestinationAddress(de.address, addr)) {
       throw std::system_error(make_error_code(CryptoNote::error::BAD_ADDRESS));
     }
 
@@ -312,64 +548,20 @@ void WalletTransactionSender::notifyBalanceChanged(std::deque<std::shared_ptr<Wa
   events.push_back(std::make_shared<WalletPendingBalanceUpdatedEvent>(pendingBalance));
 }
 
-namespace {
-
-template<typename URNG, typename T>
-T popRandomValue(URNG& randomGenerator, std::vector<T>& vec) {
-  CHECK_AND_ASSERT_MES(!vec.empty(), T(), "Vector must be non-empty");
-
-  std::uniform_int_distribution<size_t> distribution(0, vec.size() - 1);
-  size_t idx = distribution(randomGenerator);
-
-  T res = vec[idx];
-  if (idx + 1 != vec.size()) {
-    vec[idx] = vec.back();
-  }
-  vec.resize(vec.size() - 1);
-
-  return res;
-}
-
-}
-
-
-uint64_t WalletTransactionSender::selectTransfersToSend(uint64_t neededMoney, bool addDust, uint64_t dust, std::list<TransactionOutputInformation>& selectedTransfers) {
-
-  std::vector<size_t> unusedTransfers;
-  std::vector<size_t> unusedDust;
-
+// Outputs taken by earlier transactions of a batch aren't used in the cache yet, batchOutputs keeps them
+uint64_t WalletTransactionSender::selectTransfersToSend(uint64_t neededMoney, bool addDust, uint64_t dust, std::list<TransactionOutputInformation>& selectedTransfers,
+    OutputSet& batchOutputs) {
   std::vector<TransactionOutputInformation> outputs;
-  m_transferDetails.getOutputs(outputs, ITransfersContainer::IncludeKeyUnlocked);
-
-  for (size_t i = 0; i < outputs.size(); ++i) {
-    const auto& out = outputs[i];
-    if (!m_transactionsCache.isUsed(out)) {
-      if (dust < out.amount)
-        unusedTransfers.push_back(i);
-      else
-        unusedDust.push_back(i);
-    }
-  }
-
-  std::default_random_engine randomGenerator(crypto::rand<std::default_random_engine::result_type>());
-  bool selectOneDust = addDust && !unusedDust.empty();
-  uint64_t foundMoney = 0;
+  uint64_t foundMoney = m_transferDetails.selectOutputs(neededMoney, dust, addDust, [this, &batchOutputs](const TransactionOutputInformation& out) {
+    return m_transactionsCache.isUsed(out) || batchOutputs.count(std::make_pair(out.transactionHash, out.outputInTransaction)) != 0;
+  }, outputs, ITransfersContainer::IncludeKeyUnlocked);
 
-  while (foundMoney < neededMoney && (!unusedTransfers.empty() || !unusedDust.empty())) {
-    size_t idx;
-    if (selectOneDust) {
-      idx = popRandomValue(randomGenerator, unusedDust);
-      selectOneDust = false;
-    } else {
-      idx = !unusedTransfers.empty() ? popRandomValue(randomGenerator, unusedTransfers) : popRandomValue(randomGenerator, unusedDust);
-    }
-
-    selectedTransfers.push_back(outputs[idx]);
-    foundMoney += outputs[idx].amount;
+  for (const auto& out : outputs) {
+    batchOutputs.insert(std::make_pair(out.transactionHash, out.outputInTransaction));
   }
 
+  selectedTransfers.assign(outputs.begin(), outputs.end());
   return foundMoney;
-
 }
 
 
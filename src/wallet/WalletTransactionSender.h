@@ -17,6 +17,11 @@
 
 #pragma once
 
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+#include "Common/ThreadPool.h"
 #include "cryptonote_core/account.h"
 #include "cryptonote_core/Currency.h"
 
@@ -40,10 +45,20 @@ public:
 
   std::shared_ptr<WalletRequest> makeSendRequest(TransactionId& transactionId, std::deque<std::shared_ptr<WalletEvent> >& events, const std::vector<Transfer>& transfers,
       uint64_t fee, const std::string& extra = "", uint64_t mixIn = 0, uint64_t unlockTimestamp = 0);
+  std::shared_ptr<WalletRequest> makeSendBatchRequest(std::vector<TransactionId>& transactionIds, std::deque<std::shared_ptr<WalletEvent> >& events,
+      const std::vector<TransactionParameters>& transactions);
 
 private:
+  typedef std::set<std::pair<Hash, uint32_t>> OutputSet;
+
+
   std::shared_ptr<WalletRequest> makeGetRandomOutsRequest(std::shared_ptr<SendTransactionContext> context);
   std::shared_ptr<WalletRequest> doSendTransaction(std::shared_ptr<SendTransactionContext> context, std::deque<std::shared_ptr<WalletEvent> >& events);
+  std::shared_ptr<WalletRequest> makeGetRandomOutsBatchRequest(std::shared_ptr<SendTransactionBatchContext> batch);
+  std::shared_ptr<WalletRequest> doSendTransactions(std::shared_ptr<SendTransactionBatchContext> batch, std::deque<std::shared_ptr<WalletEvent> >& events);
+  std::shared_ptr<WalletRequest> makeRelayBatchRequest(std::shared_ptr<SendTransactionBatchContext> batch);
+  void prepareTransaction(SendTransactionContext& context, std::vector<CryptoNote::tx_source_entry>& sources,
+      std::vector<CryptoNote::tx_destination_entry>& splittedDests);
   void prepareInputs(const std::list<TransactionOutputInformation>& selectedTransfers, std::vector<CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount>& outs,
       std::vector<CryptoNote::tx_source_entry>& sources, uint64_t mixIn);
   void splitDestinations(TransferId firstTransferId, size_t transfersCount, const CryptoNote::tx_destination_entry& changeDts,
@@ -54,12 +69,18 @@ private:
       boost::optional<std::shared_ptr<WalletRequest> >& nextRequest, std::error_code ec);
   void relayTransactionCallback(std::shared_ptr<SendTransactionContext> context, std::deque<std::shared_ptr<WalletEvent> >& events,
                                 boost::optional<std::shared_ptr<WalletRequest> >& nextRequest, std::error_code ec);
+  void sendBatchRandomOutsByAmount(std::shared_ptr<SendTransactionBatchContext> batch, std::deque<std::shared_ptr<WalletEvent> >& events,
+      boost::optional<std::shared_ptr<WalletRequest> >& nextRequest, std::error_code ec);
+  void relayBatchCallback(std::shared_ptr<SendTransactionBatchContext> batch, TransactionId transactionId, std::deque<std::shared_ptr<WalletEvent> >& events,
+      boost::optional<std::shared_ptr<WalletRequest> >& nextRequest, std::error_code ec);
   void notifyBalanceChanged(std::deque<std::shared_ptr<WalletEvent> >& events);
 
   void validateTransfersAddresses(const std::vector<Transfer>& transfers);
   bool validateDestinationAddress(const std::string& address);
+  bool parseDestinationAddress(const std::string& address, CryptoNote::AccountPublicAddress& result);
 
-  uint64_t selectTransfersToSend(uint64_t neededMoney, bool addDust, uint64_t dust, std::list<TransactionOutputInformation>& selectedTransfers);
+  uint64_t selectTransfersToSend(uint64_t neededMoney, bool addDust, uint64_t dust, std::list<TransactionOutputInformation>& selectedTransfers,
+      OutputSet& batchOutputs);
 
   const CryptoNote::Currency& m_currency;
   CryptoNote::account_keys m_keys;
@@ -68,6 +89,11 @@ private:
 
   bool m_isStoping;
   ITransfersContainer& m_transferDetails;
+  Common::ThreadPool m_signingPool;
+
+  // Services paying the same destinations over and over parse each of them once
+  std::mutex m_addressCacheMutex;
+  std::unordered_map<std::string, CryptoNote::AccountPublicAddress> m_addressCache;
 };
 
 } /* namespace CryptoNote */
@@ -35,6 +35,7 @@ void WalletUnconfirmedTransactions::serialize(CryptoNote::ISerializer& s, const
 
   if (s.type() == CryptoNote::ISerializer::INPUT) {
     collectUsedOutputs();
+    updateAmounts();
   }
 }
 
@@ -57,6 +58,8 @@ void WalletUnconfirmedTransactions::erase(const TransactionHash& hash) {
   for (const auto& o : it->second.usedOutputs) {
     m_usedOutputs.erase(o);
   }
+  m_amount -= it->second.amount;
+  m_outsAmount -= it->second.outsAmount;
   m_unconfirmedTxs.erase(it);
 }
 
@@ -66,6 +69,12 @@ void WalletUnconfirmedTransactions::add(const CryptoNote::Transaction& tx, Trans
   auto cryptoHash = CryptoNote::get_transaction_hash(tx);
   TransactionHash hash = reinterpret_cast<const TransactionHash&>(cryptoHash);
 
+  auto it = m_unconfirmedTxs.find(hash);
+  if (it != m_unconfirmedTxs.end()) {
+    m_amount -= it->second.amount;
+    m_outsAmount -= it->second.outsAmount;
+  }
+
   UnconfirmedTransferDetails& utd = m_unconfirmedTxs[hash];
 
   utd.amount = amount;
@@ -84,6 +93,8 @@ void WalletUnconfirmedTransactions::add(const CryptoNote::Transaction& tx, Trans
   }
 
   utd.outsAmount = outsAmount;
+  m_amount += amount;
+  m_outsAmount += outsAmount;
 }
 
 void WalletUnconfirmedTransactions::updateTransactionId(const TransactionHash& hash, TransactionId id) {
@@ -94,21 +105,11 @@ void WalletUnconfirmedTransactions::updateTransactionId(const TransactionHash& h
 }
 
 uint64_t WalletUnconfirmedTransactions::countUnconfirmedOutsAmount() const {
-  uint64_t amount = 0;
-
-  for (auto& utx: m_unconfirmedTxs)
-    amount+= utx.second.outsAmount;
-
-  return amount;
+  return m_outsAmount;
 }
 
 uint64_t WalletUnconfirmedTransactions::countUnconfirmedTransactionsAmount() const {
-  uint64_t amount = 0;
-
-  for (auto& utx: m_unconfirmedTxs)
-    amount+= utx.second.amount;
-
-  return amount;
+  return m_amount;
 }
 
 bool WalletUnconfirmedTransactions::isUsed(const TransactionOutputInformation& out) const {
@@ -123,5 +124,14 @@ void WalletUnconfirmedTransactions::collectUsedOutputs() {
   m_usedOutputs = std::move(used);
 }
 
+void WalletUnconfirmedTransactions::updateAmounts() {
+  m_amount = 0;
+  m_outsAmount = 0;
+  for (const auto& kv : m_unconfirmedTxs) {
+    m_amount += kv.second.amount;
+    m_outsAmount += kv.second.outsAmount;
+  }
+}
+
 
 } /* namespace CryptoNote */
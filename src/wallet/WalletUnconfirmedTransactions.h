@@ -53,6 +53,8 @@ class WalletUnconfirmedTransactions
 {
 public:
 
+  WalletUnconfirmedTransactions() : m_amount(0), m_outsAmount(0) {}
+
   void serialize(CryptoNote::ISerializer& s, const std::string& name);
 
   bool findTransactionId(const TransactionHash& hash, TransactionId& id);
@@ -68,12 +70,16 @@ public:
 private:
 
   void collectUsedOutputs();
+  void updateAmounts();
 
   typedef std::unordered_map<TransactionHash, UnconfirmedTransferDetails, boost::hash<TransactionHash>> UnconfirmedTxsContainer;
   typedef std::set<TransactionOutputId> UsedOutputsContainer;
 
   UnconfirmedTxsContainer m_unconfirmedTxs;
   UsedOutputsContainer m_usedOutputs;
+  // sums of amount and outsAmount of all transactions, balance queries read them on every call
+  uint64_t m_amount;
+  uint64_t m_outsAmount;
 };
 
 } // namespace CryptoNote
@@ -35,6 +35,7 @@ void WalletUserTransactionsCache::serialize(CryptoNote::ISerializer& s, const st
     s(m_transfers, "transfers");
     s(m_unconfirmedTransactions, "unconfirmed");
     updateUnconfirmedTransactions();
+    rebuildHeightIndex();
   } else {
     UserTransactions txsToSave;
     UserTransfers transfersToSave;
@@ -103,10 +104,8 @@ void WalletUserTransactionsCache::updateTransactionSendingState(TransactionId tr
   }
 }
 
-std::shared_ptr<WalletEvent> WalletUserTransactionsCache::onTransactionUpdated(const TransactionInformation& txInfo,
-                                                                               int64_t txBalance) {
-  std::shared_ptr<WalletEvent> event;
-
+void WalletUserTransactionsCache::onTransactionUpdated(const TransactionInformation& txInfo, int64_t txBalance,
+                                                       WalletTransactionsBatchEvent& events) {
   TransactionId id = CryptoNote::INVALID_TRANSACTION_ID;
 
   if (!m_unconfirmedTransactions.findTransactionId(txInfo.transactionHash, id)) {
@@ -134,20 +133,18 @@ std::shared_ptr<WalletEvent> WalletUserTransactionsCache::onTransactionUpdated(c
 
     id = insertTransaction(std::move(transaction));
     // notification event
-    event = std::make_shared<WalletExternalTransactionCreatedEvent>(id);
+    events.addCreated(id);
   } else {
     TransactionInfo& tr = getTransaction(id);
-    tr.blockHeight = txInfo.blockHeight;
+    setTransactionHeight(tr, id, txInfo.blockHeight);
     tr.timestamp = txInfo.timestamp;
     tr.state = TransactionState::Active;
     // notification event
-    event = std::make_shared<WalletTransactionUpdatedEvent>(id);
+    events.addUpdated(id);
   }
-
-  return event;
 }
 
-std::shared_ptr<WalletEvent> WalletUserTransactionsCache::onTransactionDeleted(const TransactionHash& transactionHash) {
+void WalletUserTransactionsCache::onTransactionDeleted(const TransactionHash& transactionHash, WalletTransactionsBatchEvent& events) {
   TransactionId id = CryptoNote::INVALID_TRANSACTION_ID;
   if (m_unconfirmedTransactions.findTransactionId(transactionHash, id)) {
     m_unconfirmedTransactions.erase(transactionHash);
@@ -157,20 +154,17 @@ std::shared_ptr<WalletEvent> WalletUserTransactionsCache::onTransactionDeleted(c
     id = findTransactionByHash(transactionHash);
   }
 
-  std::shared_ptr<WalletEvent> event;
   if (id != CryptoNote::INVALID_TRANSACTION_ID) {
     TransactionInfo& tr = getTransaction(id);
-    tr.blockHeight = UNCONFIRMED_TRANSACTION_HEIGHT;
+    setTransactionHeight(tr, id, UNCONFIRMED_TRANSACTION_HEIGHT);
     tr.timestamp = 0;
     tr.state = TransactionState::Deleted;
 
-    event = std::make_shared<WalletTransactionUpdatedEvent>(id);
+    events.addUpdated(id);
   } else {
     LOG_ERROR("Transaction wasn't found: " << transactionHash);
     assert(false);
   }
-
-  return event;
 }
 
 TransactionId WalletUserTransactionsCache::findTransactionByTransferId(TransferId transferId) const
@@ -212,9 +206,43 @@ bool WalletUserTransactionsCache::getTransfer(TransferId transferId, Transfer& t
   return true;
 }
 
+std::vector<TransactionId> WalletUserTransactionsCache::getTransactionsByHeight(uint64_t firstHeight, uint64_t lastHeight,
+                                                                               size_t offset, size_t limit) const {
+  std::vector<TransactionId> ids;
+  if (firstHeight > lastHeight) {
+    return ids;
+  }
+
+  auto it = m_transactionsByHeight.lower_bound(std::make_pair(firstHeight, static_cast<TransactionId>(0)));
+  for (; it != m_transactionsByHeight.end() && offset > 0 && it->first <= lastHeight; ++it) {
+    --offset;
+  }
+
+  for (; it != m_transactionsByHeight.end() && ids.size() < limit && it->first <= lastHeight; ++it) {
+    ids.push_back(it->second);
+  }
+
+  return ids;
+}
+
 TransactionId WalletUserTransactionsCache::insertTransaction(TransactionInfo&& Transaction) {
   m_transactions.emplace_back(std::move(Transaction));
-  return m_transactions.size() - 1;
+  TransactionId id = m_transactions.size() - 1;
+  m_transactionsByHeight.insert(std::make_pair(m_transactions[id].blockHeight, id));
+  return id;
+}
+
+void WalletUserTransactionsCache::setTransactionHeight(TransactionInfo& transaction, TransactionId transactionId, uint64_t blockHeight) {
+  m_transactionsByHeight.erase(std::make_pair(transaction.blockHeight, transactionId));
+  transaction.blockHeight = blockHeight;
+  m_transactionsByHeight.insert(std::make_pair(blockHeight, transactionId));
+}
+
+void WalletUserTransactionsCache::rebuildHeightIndex() {
+  m_transactionsByHeight.clear();
+  for (TransactionId id = 0; id < m_transactions.size(); ++id) {
+    m_transactionsByHeight.insert(std::make_pair(m_transactions[id].blockHeight, id));
+  }
 }
 
 TransactionId WalletUserTransactionsCache::findTransactionByHash(const TransactionHash& hash) {
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <set>
+
 #include "crypto/hash.h"
 #include "IWallet.h"
 #include "ITransfersContainer.h"
@@ -46,13 +48,16 @@ public:
   void updateTransaction(TransactionId transactionId, const CryptoNote::Transaction& tx, uint64_t amount, const std::list<TransactionOutputInformation>& usedOutputs);
   void updateTransactionSendingState(TransactionId transactionId, std::error_code ec);
 
-  std::shared_ptr<WalletEvent> onTransactionUpdated(const TransactionInformation& txInfo, int64_t txBalance);
-  std::shared_ptr<WalletEvent> onTransactionDeleted(const TransactionHash& transactionHash);
+  void onTransactionUpdated(const TransactionInformation& txInfo, int64_t txBalance, WalletTransactionsBatchEvent& events);
+  void onTransactionDeleted(const TransactionHash& transactionHash, WalletTransactionsBatchEvent& events);
 
   TransactionId findTransactionByTransferId(TransferId transferId) const;
 
   bool getTransaction(TransactionId transactionId, TransactionInfo& transaction) const;
   TransactionInfo& getTransaction(TransactionId transactionId);
+  // ids of transactions with block height in [firstHeight, lastHeight], ordered by height then id; unconfirmed ones
+  // have UNCONFIRMED_TRANSACTION_HEIGHT and come last
+  std::vector<TransactionId> getTransactionsByHeight(uint64_t firstHeight, uint64_t lastHeight, size_t offset, size_t limit) const;
   bool getTransfer(TransferId transferId, Transfer& transfer) const;
   Transfer& getTransfer(TransferId transferId);
 
@@ -64,6 +69,8 @@ private:
   TransactionId insertTransaction(TransactionInfo&& Transaction);
   TransferId insertTransfers(const std::vector<Transfer>& transfers);
   void updateUnconfirmedTransactions();
+  void setTransactionHeight(TransactionInfo& transaction, TransactionId transactionId, uint64_t blockHeight);
+  void rebuildHeightIndex();
 
   typedef std::vector<Transfer> UserTransfers;
   typedef std::vector<TransactionInfo> UserTransactions;
@@ -75,6 +82,7 @@ private:
 
   UserTransactions m_transactions;
   UserTransfers m_transfers;
+  std::set<std::pair<uint64_t, TransactionId>> m_transactionsByHeight;
   WalletUnconfirmedTransactions m_unconfirmedTransactions;
 };
 
@@ -16,7 +16,10 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <future>
+#include <map>
+#include <string>
 #include <System/Dispatcher.h>
+#include <System/DispatcherTracer.h>
 #include <System/Event.h>
 #include <System/Timer.h>
 #include <gtest/gtest.h>
@@ -321,6 +324,31 @@ TEST(DispatcherTests, remoteSpawnSpawnsProcedureAndKeepsOrder) {
   ASSERT_EQ(executionOrder, expectedOrder);
 }
 
+TEST(DispatcherTests, remoteSpawnFromSeveralThreadsSpawnsAllProcedures) {
+  Dispatcher dispatcher;
+  Event remoteSpawnDone(dispatcher);
+  size_t spawned = 0;
+  std::vector<std::thread> remoteSpawnThreads;
+  for (size_t i = 0; i < 4; ++i) {
+    remoteSpawnThreads.emplace_back([&] {
+      for (size_t j = 0; j < 1000; ++j) {
+        dispatcher.remoteSpawn([&]() {
+          if (++spawned == 4000) {
+            remoteSpawnDone.set();
+          }
+        });
+      }
+    });
+  }
+
+  remoteSpawnDone.wait();
+  for (auto& remoteSpawnThread : remoteSpawnThreads) {
+    remoteSpawnThread.join();
+  }
+
+  ASSERT_EQ(4000, spawned);
+}
+
 TEST(DispatcherTests, remoteSpawnActuallyWorksParallel) {
   Dispatcher dispatcher;
   Event remoteSpawnDone(dispatcher);
@@ -338,6 +366,41 @@ TEST(DispatcherTests, remoteSpawnActuallyWorksParallel) {
   }
 }
 
+TEST(DispatcherTests, spawnedProcedureUsesConfiguredStackSize) {
+  Dispatcher dispatcher(512 * 1024);
+  bool spawnDone = false;
+  dispatcher.spawn([&]() {
+    // would run over the guard page of a default sized stack
+    volatile uint8_t buffer[256 * 1024];
+    buffer[0] = 1;
+    buffer[sizeof(buffer) - 1] = 1;
+    spawnDone = buffer[0] == buffer[sizeof(buffer) - 1];
+  });
+
+  dispatcher.yield();
+  ASSERT_TRUE(spawnDone);
+}
+
+TEST(DispatcherTests, manyParallelSpawnsFinishAndContextsAreReused) {
+  Dispatcher dispatcher;
+  size_t finished = 0;
+  for (size_t round = 0; round < 2; ++round) {
+    Event release(dispatcher);
+    for (size_t i = 0; i < 2000; ++i) {
+      dispatcher.spawn([&]() {
+        release.wait();
+        ++finished;
+      });
+    }
+
+    dispatcher.yield();
+    release.set();
+    dispatcher.yield();
+  }
+
+  ASSERT_EQ(4000, finished);
+}
+
 TEST(DispatcherTests, spawnActuallySpawns) {
   Dispatcher dispatcher;
   bool spawnDone = false;
@@ -403,3 +466,53 @@ TEST(DispatcherTests, yieldExecutesIoOnItsFront) {
   dispatcher.yield();
   ASSERT_TRUE(spawnDone);
 }
+
+namespace {
+
+class TestTracer : public DispatcherTracer {
+public:
+  TestTracer() : waits(0), maxRunQueueLength(0) {
+  }
+
+  virtual void contextRan(std::chrono::nanoseconds duration, const char* site) override {
+    runTimes[site != nullptr ? site : ""] += duration;
+  }
+
+  virtual void contextResumed(std::size_t runQueueLength) override {
+    maxRunQueueLength = std::max(maxRunQueueLength, runQueueLength);
+  }
+
+  virtual void eventsWaited(std::chrono::nanoseconds duration) override {
+    ++waits;
+  }
+
+  std::map<std::string, std::chrono::nanoseconds> runTimes;
+  size_t waits;
+  size_t maxRunQueueLength;
+};
+
+}
+
+TEST(DispatcherTests, tracerGetsRunTimesBySpawnSite) {
+  Dispatcher dispatcher;
+  TestTracer tracer;
+  dispatcher.setTracer(&tracer);
+  Event done(dispatcher);
+  dispatcher.spawn([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Timer(dispatcher).sleep(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    done.set();
+  }, "slow");
+
+  dispatcher.spawn([&]() {
+    dispatcher.yield();
+  }, "fast");
+
+  done.wait();
+  dispatcher.setTracer(nullptr);
+  ASSERT_GE(tracer.runTimes["slow"], std::chrono::milliseconds(40));
+  ASSERT_LT(tracer.runTimes["fast"], std::chrono::milliseconds(20));
+  ASSERT_GE(tracer.maxRunQueueLength, 1);
+  ASSERT_GE(tracer.waits, 1);
+}
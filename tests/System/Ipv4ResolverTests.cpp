@@ -62,3 +62,12 @@ TEST(Ipv4ResolverTest, resolve) {
   ASSERT_THROW(resolver.resolve("256.0.0.0"), std::runtime_error);
   ASSERT_THROW(resolver.resolve("invalid"), std::runtime_error);
 }
+
+TEST(Ipv4ResolverTest, otherContextsRunWhileResolving) {
+  Dispatcher dispatcher;
+  bool spawnedRan = false;
+  dispatcher.spawn([&] { spawnedRan = true; });
+  Ipv4Resolver resolver(dispatcher);
+  ASSERT_EQ(Ipv4Address("127.0.0.3"), resolver.resolve("127.0.0.3"));
+  ASSERT_TRUE(spawnedRan);
+}
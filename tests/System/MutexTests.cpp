@@ -0,0 +1,58 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <mutex>
+#include <System/Dispatcher.h>
+#include <System/Mutex.h>
+#include <gtest/gtest.h>
+
+using namespace System;
+
+TEST(MutexTests, lockExcludesOtherContexts) {
+  Dispatcher dispatcher;
+  Mutex mutex(dispatcher);
+  int inside = 0;
+  int maxInside = 0;
+  int done = 0;
+  for (int i = 0; i < 3; ++i) {
+    dispatcher.spawn([&]() {
+      std::lock_guard<Mutex> lock(mutex);
+      ++inside;
+      maxInside = std::max(maxInside, inside);
+      dispatcher.yield();
+      --inside;
+      ++done;
+    });
+  }
+
+  while (done < 3) {
+    dispatcher.yield();
+  }
+
+  ASSERT_EQ(1, maxInside);
+}
+
+TEST(MutexTests, tryLockFailsWhileLocked) {
+  Dispatcher dispatcher;
+  Mutex mutex(dispatcher);
+  ASSERT_TRUE(mutex.try_lock());
+  ASSERT_FALSE(mutex.try_lock());
+  mutex.unlock();
+  ASSERT_TRUE(mutex.try_lock());
+  mutex.unlock();
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <System/RemoteProcedureQueue.h>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace System;
+
+TEST(RemoteProcedureQueueTest, onlyFirstPushToEmptyQueueRequiresWakeup) {
+  RemoteProcedureQueue queue;
+  ASSERT_TRUE(queue.empty());
+  ASSERT_TRUE(queue.push([] {}));
+  ASSERT_FALSE(queue.push([] {}));
+  ASSERT_FALSE(queue.empty());
+
+  std::queue<std::function<void()>> procedures;
+  queue.takeAll(procedures);
+  ASSERT_EQ(2, procedures.size());
+  ASSERT_TRUE(queue.empty());
+  ASSERT_TRUE(queue.push([] {}));
+}
+
+TEST(RemoteProcedureQueueTest, proceduresAreTakenInPushOrder) {
+  RemoteProcedureQueue queue;
+  std::vector<int> order;
+  for (int i = 0; i < 5; ++i) {
+    queue.push([&order, i] { order.push_back(i); });
+  }
+
+  std::queue<std::function<void()>> procedures;
+  queue.takeAll(procedures);
+  while (!procedures.empty()) {
+    procedures.front()();
+    procedures.pop();
+  }
+
+  ASSERT_EQ(std::vector<int>({ 0, 1, 2, 3, 4 }), order);
+}
+
+TEST(RemoteProcedureQueueTest, concurrentPushesAreNotLost) {
+  RemoteProcedureQueue queue;
+  std::vector<std::thread> producers;
+  for (int i = 0; i < 4; ++i) {
+    producers.emplace_back([&queue] {
+      for (int j = 0; j < 10000; ++j) {
+        queue.push([] {});
+      }
+    });
+  }
+
+  size_t taken = 0;
+  std::queue<std::function<void()>> procedures;
+  while (taken < 40000) {
+    queue.takeAll(procedures);
+    taken += procedures.size();
+    procedures = std::queue<std::function<void()>>();
+  }
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  ASSERT_EQ(40000, taken);
+  ASSERT_TRUE(queue.empty());
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <System/Dispatcher.h>
+#include <System/Semaphore.h>
+#include <gtest/gtest.h>
+
+using namespace System;
+
+TEST(SemaphoreTests, acquireDecreasesValue) {
+  Dispatcher dispatcher;
+  Semaphore semaphore(dispatcher, 2);
+  semaphore.acquire();
+  ASSERT_EQ(1, semaphore.get());
+  ASSERT_TRUE(semaphore.tryAcquire());
+  ASSERT_EQ(0, semaphore.get());
+  ASSERT_FALSE(semaphore.tryAcquire());
+  semaphore.release();
+  ASSERT_EQ(1, semaphore.get());
+}
+
+TEST(SemaphoreTests, acquireWaitsForRelease) {
+  Dispatcher dispatcher;
+  Semaphore semaphore(dispatcher, 0);
+  bool done = false;
+  dispatcher.spawn([&]() {
+    semaphore.acquire();
+    done = true;
+  });
+
+  dispatcher.yield();
+  ASSERT_FALSE(done);
+  semaphore.release();
+  ASSERT_EQ(0, semaphore.get());
+  dispatcher.yield();
+  ASSERT_TRUE(done);
+}
+
+TEST(SemaphoreTests, waitersAreServedInOrder) {
+  Dispatcher dispatcher;
+  Semaphore semaphore(dispatcher, 0);
+  std::string order;
+  dispatcher.spawn([&]() {
+    semaphore.acquire();
+    order += '1';
+  });
+
+  dispatcher.spawn([&]() {
+    semaphore.acquire();
+    order += '2';
+  });
+
+  dispatcher.yield();
+  ASSERT_FALSE(semaphore.tryAcquire());
+  semaphore.release();
+  semaphore.release();
+  dispatcher.yield();
+  ASSERT_EQ("12", order);
+}
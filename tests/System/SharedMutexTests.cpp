@@ -0,0 +1,86 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <System/Dispatcher.h>
+#include <System/SharedMutex.h>
+#include <gtest/gtest.h>
+
+using namespace System;
+
+TEST(SharedMutexTests, readersShareLock) {
+  Dispatcher dispatcher;
+  SharedMutex mutex(dispatcher);
+  ASSERT_TRUE(mutex.try_lock_shared());
+  ASSERT_TRUE(mutex.try_lock_shared());
+  ASSERT_FALSE(mutex.try_lock());
+  mutex.unlock_shared();
+  mutex.unlock_shared();
+  ASSERT_TRUE(mutex.try_lock());
+  ASSERT_FALSE(mutex.try_lock_shared());
+  mutex.unlock();
+}
+
+TEST(SharedMutexTests, writerWaitsForReaders) {
+  Dispatcher dispatcher;
+  SharedMutex mutex(dispatcher);
+  mutex.lock_shared();
+  bool locked = false;
+  dispatcher.spawn([&]() {
+    mutex.lock();
+    locked = true;
+    mutex.unlock();
+  });
+
+  dispatcher.yield();
+  ASSERT_FALSE(locked);
+  mutex.unlock_shared();
+  dispatcher.yield();
+  ASSERT_TRUE(locked);
+}
+
+TEST(SharedMutexTests, waitingWriterHoldsBackNewReaders) {
+  Dispatcher dispatcher;
+  SharedMutex mutex(dispatcher);
+  std::string order;
+  mutex.lock_shared();
+  dispatcher.spawn([&]() {
+    mutex.lock();
+    order += 'w';
+    mutex.unlock();
+  });
+
+  dispatcher.spawn([&]() {
+    mutex.lock_shared();
+    order += 'r';
+    mutex.unlock_shared();
+  });
+
+  dispatcher.spawn([&]() {
+    mutex.lock_shared();
+    order += 'r';
+    mutex.unlock_shared();
+  });
+
+  dispatcher.yield();
+  ASSERT_FALSE(mutex.try_lock_shared());
+  mutex.unlock_shared();
+  while (order.size() < 3) {
+    dispatcher.yield();
+  }
+
+  ASSERT_EQ("wrr", order);
+}
@@ -170,6 +170,56 @@ TEST_F(TcpConnectionTest, sendBigChunk) {
   ASSERT_EQ(buf, incoming);
 }
 
+TEST_F(TcpConnectionTest, gatherWrite) {
+  connect();
+
+  std::vector<std::string> parts{ std::string(100, 'a'), std::string(), std::string(3 * 1024 * 1024, 'b'), std::string(1, 'c') };
+  for (auto& part : parts) {
+    fillRandomString(part);
+  }
+
+  std::string incoming;
+  Event readComplete(dispatcher);
+
+  dispatcher.spawn([&]{
+    uint8_t readBuf[1024];
+    size_t readSize;
+    while ((readSize = connection2.read(readBuf, sizeof(readBuf))) > 0) {
+      incoming.append(reinterpret_cast<const char*>(readBuf), readSize);
+    }
+
+    readComplete.set();
+  });
+
+  dispatcher.spawn([&]{
+    std::vector<TcpConnection::Buffer> buffers;
+    for (const auto& part : parts) {
+      buffers.push_back({ reinterpret_cast<const uint8_t*>(part.data()), part.size() });
+    }
+
+    // resume from the part sent partially
+    size_t first = 0;
+    while (first < buffers.size()) {
+      size_t transferred = connection1.write(&buffers[first], buffers.size() - first);
+      while (first < buffers.size() && transferred >= buffers[first].size) {
+        transferred -= buffers[first].size;
+        ++first;
+      }
+
+      if (first < buffers.size()) {
+        buffers[first].data += transferred;
+        buffers[first].size -= transferred;
+      }
+    }
+
+    connection1 = TcpConnection(); // close connection
+  });
+
+  readComplete.wait();
+
+  ASSERT_EQ(parts[0] + parts[1] + parts[2] + parts[3], incoming);
+}
+
 TEST_F(TcpConnectionTest, writeWhenReadWaiting) {
   connect();
 
@@ -218,6 +268,32 @@ TEST_F(TcpConnectionTest, writeWhenReadWaiting) {
   writeCompleted.wait();
 }
 
+TEST_F(TcpConnectionTest, movedConnectionWaitsForData) {
+  connect();
+  TcpConnection connection(std::move(connection2));
+  dispatcher.spawn([&]() {
+    Timer(dispatcher).sleep(std::chrono::milliseconds(10));
+    connection1.write(reinterpret_cast<const uint8_t*>("Test"), 4);
+  });
+
+  uint8_t data[1024];
+  ASSERT_EQ(4, connection.read(data, 1024));
+  ASSERT_EQ(0, memcmp(data, "Test", 4));
+}
+
+TEST_F(TcpConnectionTest, restartedConnectionWaitsForData) {
+  connect();
+  connection2.stop();
+  connection2.start();
+  dispatcher.spawn([&]() {
+    Timer(dispatcher).sleep(std::chrono::milliseconds(10));
+    connection1.write(reinterpret_cast<const uint8_t*>("Test"), 4);
+  });
+
+  uint8_t data[1024];
+  ASSERT_EQ(4, connection2.read(data, 1024));
+}
+
 TEST_F(TcpConnectionTest, sendBigChunkThruTcpStream) {
   connect();
   const size_t bufsize = 15 * 1024 * 1024; // 15MB
@@ -74,3 +74,30 @@ TEST(TcpConnectorTest, bindToTheSameAddressFails) {
   TcpListener listener1(dispatcher, Ipv4Address("127.0.0.1"), 6666);
   ASSERT_THROW(TcpListener listener2(dispatcher, Ipv4Address("127.0.0.1"), 6666), std::runtime_error);
 }
+
+#ifndef _WIN32
+TEST(TcpConnectorTest, connectsToUnixSocket) {
+  Dispatcher dispatcher;
+  TcpListener listener(dispatcher, std::string("TcpConnectorTest.sock"));
+  uint8_t received = 0;
+  dispatcher.spawn([&]() {
+    TcpConnection connection = listener.accept();
+    ASSERT_EQ(0, connection.getPeerAddressAndPort().second);
+    connection.read(&received, 1);
+  });
+
+  TcpConnection connection = TcpConnector(dispatcher).connect(std::string("TcpConnectorTest.sock"));
+  uint8_t sent = 42;
+  ASSERT_EQ(1, connection.write(&sent, 1));
+  while (received == 0) {
+    dispatcher.yield();
+  }
+
+  ASSERT_EQ(42, received);
+}
+
+TEST(TcpConnectorTest, connectToMissingUnixSocketFails) {
+  Dispatcher dispatcher;
+  ASSERT_THROW(TcpConnector(dispatcher).connect(std::string("TcpConnectorTest.missing.sock")), std::runtime_error);
+}
+#endif
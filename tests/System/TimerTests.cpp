@@ -159,3 +159,35 @@ TEST(TimerTests, timerWithZeroTimeIsYielding) {
   Timer(dispatcher).sleep(std::chrono::milliseconds(0));
   ASSERT_TRUE(done);
 }
+
+TEST(TimerTests, concurrentTimersWakeInDeadlineOrder) {
+  Dispatcher dispatcher;
+  Event done(dispatcher);
+  std::vector<int> order;
+  std::vector<Timer> timers;
+  for (int i = 0; i < 5; ++i) {
+    timers.emplace_back(dispatcher);
+  }
+
+  // later timers are started first and some are stopped, the earliest remaining deadline has to be rearmed each time
+  for (int i = 4; i >= 0; --i) {
+    dispatcher.spawn([&, i]() {
+      try {
+        timers[i].sleep(std::chrono::milliseconds(10 + 20 * i));
+        order.push_back(i);
+      } catch (InterruptedException&) {
+        order.push_back(-i);
+      }
+
+      if (order.size() == timers.size()) {
+        done.set();
+      }
+    });
+  }
+
+  dispatcher.yield();
+  timers[1].stop();
+  timers[3].stop();
+  done.wait();
+  ASSERT_EQ((std::vector<int>{-1, -3, 0, 2, 4}), order);
+}
@@ -0,0 +1,364 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "block_ingestion_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "chaingen.h"
+#include "TransactionBuilder.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+  typedef std::chrono::steady_clock clock_type;
+
+  struct chain_output
+  {
+    crypto::public_key key;
+    // index of the first block which may spend or mix in the output
+    uint64_t unlock_height;
+  };
+
+  struct owned_output
+  {
+    uint64_t amount;
+    uint64_t global_index;
+    crypto::public_key tx_key;
+    size_t index_in_tx;
+    uint64_t unlock_height;
+  };
+
+  struct benchmark_block
+  {
+    blobdata block;
+    std::vector<blobdata> txs;
+  };
+
+  // Keeps global output indices of the generated chain, so transactions reference outputs the way wallets do
+  class benchmark_chain_builder
+  {
+  public:
+    benchmark_chain_builder(const Currency& currency, const block_ingestion_benchmark_config& config)
+      : m_currency(currency)
+      , m_generator(currency)
+      , m_config(config)
+      , m_height(0)
+    {
+      m_miner.generate();
+      m_recipient.generate();
+    }
+
+    const Block& genesis() const { return m_genesis; }
+
+    bool build(std::vector<benchmark_block>& funding_blocks, std::vector<benchmark_block>& measured_blocks)
+    {
+      if (!m_generator.constructBlock(m_genesis, m_miner, 1338224400))
+        return false;
+
+      m_last_block = m_genesis;
+      add_outputs(m_genesis, std::list<Transaction>());
+
+      // measured blocks spend coinbase outputs, enough of them have to be unlocked and have enough decoys
+      size_t needed = m_config.blocks * m_config.txs_per_block * m_config.inputs_per_tx;
+      while (count_spendable() < needed)
+      {
+        funding_blocks.push_back(benchmark_block());
+        if (!make_block(std::list<Transaction>(), funding_blocks.back()))
+          return false;
+      }
+
+      for (size_t i = 0; i < m_config.blocks; ++i)
+      {
+        std::list<Transaction> txs;
+        for (size_t j = 0; j < m_config.txs_per_block; ++j)
+        {
+          txs.push_back(make_tx());
+        }
+
+        measured_blocks.push_back(benchmark_block());
+        if (!make_block(txs, measured_blocks.back()))
+          return false;
+      }
+
+      return true;
+    }
+
+  private:
+    bool make_block(const std::list<Transaction>& txs, benchmark_block& result)
+    {
+      Block block;
+      if (!m_generator.constructBlock(block, m_last_block, m_miner, txs))
+        return false;
+
+      result.block = t_serializable_object_to_blob(block);
+      for (const Transaction& tx : txs)
+      {
+        result.txs.push_back(t_serializable_object_to_blob(tx));
+      }
+
+      add_outputs(block, txs);
+      m_last_block = block;
+      return true;
+    }
+
+    // outputs get global indices in the order core stores them, coinbase first
+    void add_outputs(const Block& block, const std::list<Transaction>& txs)
+    {
+      m_height = get_block_height(block);
+      crypto::public_key coinbase_key = get_tx_pub_key_from_extra(block.minerTx);
+      for (size_t i = 0; i < block.minerTx.vout.size(); ++i)
+      {
+        const TransactionOutput& out = block.minerTx.vout[i];
+        uint64_t unlock_height = std::max<uint64_t>(block.minerTx.unlockTime, m_height + 1);
+        uint64_t global_index = add_output(out, unlock_height);
+        // every input has to pay its share of the fee
+        if (out.amount > m_currency.minimumFee())
+        {
+          owned_output owned = { out.amount, global_index, coinbase_key, i, unlock_height };
+          m_owned.push_back(owned);
+        }
+      }
+
+      for (const Transaction& tx : txs)
+      {
+        for (const TransactionOutput& out : tx.vout)
+        {
+          add_output(out, std::max<uint64_t>(tx.unlockTime, m_height + 1));
+        }
+      }
+    }
+
+    uint64_t add_output(const TransactionOutput& out, uint64_t unlock_height)
+    {
+      std::vector<chain_output>& outputs = m_outputs[out.amount];
+      chain_output output = { boost::get<TransactionOutputToKey>(out.target).key, unlock_height };
+      outputs.push_back(output);
+      return outputs.size() - 1;
+    }
+
+    // in the next block
+    bool is_unlocked(const chain_output& output) const
+    {
+      return output.unlock_height <= m_height + 1;
+    }
+
+    typedef std::unordered_map<uint64_t, size_t> unlocked_counts;
+
+    unlocked_counts count_unlocked() const
+    {
+      unlocked_counts counts;
+      for (const auto& amount_outputs : m_outputs)
+      {
+        const std::vector<chain_output>& outputs = amount_outputs.second;
+        counts[amount_outputs.first] = std::count_if(outputs.begin(), outputs.end(), [this](const chain_output& o) { return is_unlocked(o); });
+      }
+
+      return counts;
+    }
+
+    // output and its decoys are unlocked
+    bool is_spendable(const owned_output& output, const unlocked_counts& unlocked) const
+    {
+      return output.unlock_height <= m_height + 1 && unlocked.find(output.amount)->second > m_config.mixin;
+    }
+
+    size_t count_spendable() const
+    {
+      unlocked_counts unlocked = count_unlocked();
+      return std::count_if(m_owned.begin(), m_owned.end(), [&](const owned_output& o) { return is_spendable(o, unlocked); });
+    }
+
+    tx_source_entry make_source(const owned_output& output) const
+    {
+      const std::vector<chain_output>& outputs = m_outputs.find(output.amount)->second;
+      std::vector<uint64_t> candidates;
+      for (uint64_t i = 0; i < outputs.size(); ++i)
+      {
+        if (i != output.global_index && is_unlocked(outputs[i]))
+          candidates.push_back(i);
+      }
+
+      std::set<uint64_t> indices;
+      indices.insert(output.global_index);
+      while (indices.size() <= m_config.mixin)
+      {
+        indices.insert(candidates[crypto::rand<size_t>() % candidates.size()]);
+      }
+
+      tx_source_entry source;
+      source.amount = output.amount;
+      source.real_out_tx_key = output.tx_key;
+      source.real_output_in_tx_index = output.index_in_tx;
+      for (uint64_t index : indices)
+      {
+        if (index == output.global_index)
+          source.real_output = source.outputs.size();
+
+        source.outputs.push_back(tx_source_entry::output_entry(index, outputs[index].key));
+      }
+
+      return source;
+    }
+
+    Transaction make_tx()
+    {
+      std::vector<tx_source_entry> sources;
+      uint64_t inputs_amount = 0;
+      unlocked_counts unlocked = count_unlocked();
+      for (auto it = m_owned.begin(); it != m_owned.end() && sources.size() < m_config.inputs_per_tx;)
+      {
+        if (is_spendable(*it, unlocked))
+        {
+          sources.push_back(make_source(*it));
+          inputs_amount += it->amount;
+          it = m_owned.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+
+      if (sources.size() < m_config.inputs_per_tx)
+        throw std::runtime_error("not enough spendable outputs");
+
+      std::vector<tx_destination_entry> destinations;
+      destinations.push_back(tx_destination_entry(inputs_amount - m_currency.minimumFee(), m_recipient.get_keys().m_account_address));
+
+      TransactionBuilder builder(m_currency);
+      builder.setInput(sources, m_miner.get_keys());
+      builder.setOutput(destinations);
+      return builder.build();
+    }
+
+    const Currency& m_currency;
+    test_generator m_generator;
+    block_ingestion_benchmark_config m_config;
+    account_base m_miner;
+    account_base m_recipient;
+    Block m_genesis;
+    Block m_last_block;
+    uint64_t m_height;
+    std::unordered_map<uint64_t, std::vector<chain_output>> m_outputs;
+    std::list<owned_output> m_owned;
+  };
+
+  bool push_block(core& c, const benchmark_block& block)
+  {
+    for (const blobdata& tx : block.txs)
+    {
+      tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
+      if (!c.handle_incoming_tx(tx, tvc, true) || tvc.m_verifivation_failed)
+        return false;
+    }
+
+    block_verification_context bvc = boost::value_initialized<decltype(bvc)>();
+    return c.handle_incoming_block_blob(block.block, bvc, false, false) && !bvc.m_verifivation_failed && bvc.m_added_to_main_chain;
+  }
+
+  double percentile_ms(const std::vector<clock_type::duration>& sorted, size_t percent)
+  {
+    size_t index = std::min(sorted.size() - 1, sorted.size() * percent / 100);
+    return std::chrono::duration<double, std::milli>(sorted[index]).count();
+  }
+}
+
+bool run_block_ingestion_benchmark(const block_ingestion_benchmark_config& config)
+{
+  if (config.blocks == 0 || config.inputs_per_tx == 0)
+  {
+    std::cout << concolor::magenta << "Benchmark needs at least one block and one input per transaction" << concolor::normal << std::endl;
+    return false;
+  }
+
+  Logging::ConsoleLogger logger(Logging::ERROR);
+  Currency currency = CurrencyBuilder(logger).currency();
+
+  std::vector<benchmark_block> funding_blocks;
+  std::vector<benchmark_block> measured_blocks;
+  benchmark_chain_builder builder(currency, config);
+  if (!builder.build(funding_blocks, measured_blocks))
+  {
+    std::cout << concolor::magenta << "Failed to generate benchmark chain" << concolor::normal << std::endl;
+    return false;
+  }
+
+  boost::program_options::options_description desc("Allowed options");
+  CoreConfig::initOptions(desc);
+  command_line::add_arg(desc, command_line::arg_data_dir);
+  boost::program_options::variables_map vm;
+  boost::program_options::store(boost::program_options::basic_parsed_options<char>(&desc), vm);
+  boost::program_options::notify(vm);
+
+  CoreConfig coreConfig;
+  coreConfig.init(vm);
+  MinerConfig emptyMinerConfig;
+  cryptonote_protocol_stub pr;
+  core c(currency, &pr, logger);
+  if (!c.init(coreConfig, emptyMinerConfig, false))
+  {
+    std::cout << concolor::magenta << "Failed to init core" << concolor::normal << std::endl;
+    return false;
+  }
+
+  c.set_genesis_block(builder.genesis());
+  for (const benchmark_block& block : funding_blocks)
+  {
+    if (!push_block(c, block))
+    {
+      std::cout << concolor::magenta << "Funding block rejected" << concolor::normal << std::endl;
+      return false;
+    }
+  }
+
+  std::vector<clock_type::duration> latencies;
+  latencies.reserve(measured_blocks.size());
+  clock_type::duration total = clock_type::duration::zero();
+  for (const benchmark_block& block : measured_blocks)
+  {
+    clock_type::time_point start = clock_type::now();
+    bool added = push_block(c, block);
+    latencies.push_back(clock_type::now() - start);
+    total += latencies.back();
+    if (!added)
+    {
+      std::cout << concolor::magenta << "Block " << latencies.size() << " rejected" << concolor::normal << std::endl;
+      return false;
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  double seconds = std::chrono::duration<double>(total).count();
+  size_t txs = config.blocks * config.txs_per_block;
+
+  std::cout << "Block ingestion: " << config.blocks << " blocks, " << config.txs_per_block << " txs per block, " <<
+    config.inputs_per_tx << " inputs per tx, mixin " << config.mixin << " (" << funding_blocks.size() << " funding blocks)" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "  blocks/sec: " << config.blocks / seconds << ", tx/sec: " << txs / seconds << std::endl;
+  std::cout << "  block latency, ms: p50 " << percentile_ms(latencies, 50) << ", p90 " << percentile_ms(latencies, 90) <<
+    ", p99 " << percentile_ms(latencies, 99) << ", max " << percentile_ms(latencies, 100) << std::endl;
+  return true;
+}
@@ -0,0 +1,33 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+
+struct block_ingestion_benchmark_config
+{
+  size_t blocks;
+  size_t txs_per_block;
+  size_t mixin;
+  size_t inputs_per_tx;
+};
+
+// Builds a chain whose blocks carry transactions spending earlier coinbase outputs, then feeds it to core the way
+// synchronization does, transactions of a block first, and reports blocks/sec, tx/sec and per-block latency
+// percentiles. Chain generation and blocks mined to fund the transactions aren't measured.
+bool run_block_ingestion_benchmark(const block_ingestion_benchmark_config& config);
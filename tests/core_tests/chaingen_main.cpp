@@ -19,6 +19,7 @@
 
 #include "Common/command_line.h"
 
+#include "block_ingestion_benchmark.h"
 #include "block_reward.h"
 #include "block_validation.h"
 #include "chain_split_1.h"
@@ -41,6 +42,11 @@ namespace
   const command_line::arg_descriptor<bool>        arg_play_test_data              = {"play_test_data", ""};
   const command_line::arg_descriptor<bool>        arg_generate_and_play_test_data = {"generate_and_play_test_data", ""};
   const command_line::arg_descriptor<bool>        arg_test_transactions           = {"test_transactions", ""};
+  const command_line::arg_descriptor<bool>        arg_benchmark_block_ingestion   = {"benchmark_block_ingestion", "Measure how fast core accepts blocks with transactions"};
+  const command_line::arg_descriptor<size_t>      arg_benchmark_blocks            = {"benchmark_blocks", "Blocks measured by benchmark", 100};
+  const command_line::arg_descriptor<size_t>      arg_benchmark_txs_per_block     = {"benchmark_txs_per_block", "Transactions in every measured block", 10};
+  const command_line::arg_descriptor<size_t>      arg_benchmark_mixin             = {"benchmark_mixin", "Decoys of every transaction input", 2};
+  const command_line::arg_descriptor<size_t>      arg_benchmark_inputs_per_tx     = {"benchmark_inputs_per_tx", "Inputs of every transaction", 2};
 }
 
 int main(int argc, char* argv[])
@@ -63,6 +69,11 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_options, arg_play_test_data);
   command_line::add_arg(desc_options, arg_generate_and_play_test_data);
   command_line::add_arg(desc_options, arg_test_transactions);
+  command_line::add_arg(desc_options, arg_benchmark_block_ingestion);
+  command_line::add_arg(desc_options, arg_benchmark_blocks);
+  command_line::add_arg(desc_options, arg_benchmark_txs_per_block);
+  command_line::add_arg(desc_options, arg_benchmark_mixin);
+  command_line::add_arg(desc_options, arg_benchmark_inputs_per_tx);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -229,6 +240,15 @@ int main(int argc, char* argv[])
   {
     CALL_TEST("TRANSACTIONS TESTS", test_transactions);
   }
+  else if (command_line::get_arg(vm, arg_benchmark_block_ingestion))
+  {
+    block_ingestion_benchmark_config config;
+    config.blocks = command_line::get_arg(vm, arg_benchmark_blocks);
+    config.txs_per_block = command_line::get_arg(vm, arg_benchmark_txs_per_block);
+    config.mixin = command_line::get_arg(vm, arg_benchmark_mixin);
+    config.inputs_per_tx = command_line::get_arg(vm, arg_benchmark_inputs_per_tx);
+    return run_block_ingestion_benchmark(config) ? 0 : 1;
+  }
   else
   {
     std::cout << concolor::magenta << "Wrong arguments" << concolor::normal << std::endl;
@@ -55,26 +55,122 @@ struct hash_func {
   {"extra-blake", hash_extra_blake}, {"extra-groestl", hash_extra_groestl},
   {"extra-jh", hash_extra_jh}, {"extra-skein", hash_extra_skein}};
 
+struct test_case {
+  chash expected;
+  vector<char> data;
+};
+
+static void print_mismatch(size_t test, const vector<char> &data, const chash &expected, const chash &actual) {
+  size_t i;
+  cerr << "Hash mismatch on test " << test << endl << "Input: ";
+  if (data.size() == 0) {
+    cerr << "empty";
+  } else {
+    for (i = 0; i < data.size(); i++) {
+      cerr << setbase(16) << setw(2) << setfill('0') << int(static_cast<unsigned char>(data[i]));
+    }
+  }
+  cerr << endl << "Expected hash: ";
+  for (i = 0; i < 32; i++) {
+      cerr << setbase(16) << setw(2) << setfill('0') << int(reinterpret_cast<const unsigned char *>(&expected)[i]);
+  }
+  cerr << endl << "Actual hash: ";
+  for (i = 0; i < 32; i++) {
+      cerr << setbase(16) << setw(2) << setfill('0') << int(reinterpret_cast<const unsigned char *>(&actual)[i]);
+  }
+  cerr << endl;
+}
+
+// Lanes of cn_slow_hash_multi hash different test inputs, each result is checked against own expected hash,
+// so state shared between lanes or swapped outputs are caught
+static bool test_slow_hash_lanes(size_t lanes, const vector<test_case> &tests) {
+  cn_context *laneContexts[CN_SLOW_HASH_MAX_LANES];
+  for (size_t i = 0; i < lanes; i++) {
+    laneContexts[i] = new cn_context();
+  }
+  bool error = false;
+  // every test case goes through every lane position
+  for (size_t first = 0; first < tests.size(); first++) {
+    const void *laneData[CN_SLOW_HASH_MAX_LANES];
+    size_t laneLengths[CN_SLOW_HASH_MAX_LANES];
+    chash laneHashes[CN_SLOW_HASH_MAX_LANES];
+    for (size_t i = 0; i < lanes; i++) {
+      const test_case &test = tests[(first + i) % tests.size()];
+      laneData[i] = test.data.data();
+      laneLengths[i] = test.data.size();
+    }
+    cn_slow_hash_multi(laneContexts, laneData, laneLengths, laneHashes, lanes);
+    for (size_t i = 0; i < lanes; i++) {
+      size_t index = (first + i) % tests.size();
+      if (laneHashes[i] != tests[index].expected) {
+        cerr << "Lane " << i << ": ";
+        print_mismatch(index + 1, tests[index].data, tests[index].expected, laneHashes[i]);
+        error = true;
+      }
+    }
+  }
+  for (size_t i = 0; i < lanes; i++) {
+    delete laneContexts[i];
+  }
+  return !error;
+}
+
+// Same for cn_fast_hash_x4, lanes get inputs of different lengths
+static bool test_fast_hash_lanes(const vector<test_case> &tests) {
+  bool error = false;
+  for (size_t first = 0; first < tests.size(); first++) {
+    const void *laneData[4];
+    size_t laneLengths[4];
+    chash laneHashes[4];
+    char *laneOutputs[4];
+    for (size_t i = 0; i < 4; i++) {
+      const test_case &test = tests[(first + i) % tests.size()];
+      laneData[i] = test.data.data();
+      laneLengths[i] = test.data.size();
+      laneOutputs[i] = reinterpret_cast<char *>(&laneHashes[i]);
+    }
+    cn_fast_hash_x4(laneData, laneLengths, laneOutputs);
+    for (size_t i = 0; i < 4; i++) {
+      size_t index = (first + i) % tests.size();
+      if (laneHashes[i] != tests[index].expected) {
+        cerr << "Lane " << i << ": ";
+        print_mismatch(index + 1, tests[index].data, tests[index].expected, laneHashes[i]);
+        error = true;
+      }
+    }
+  }
+  return !error;
+}
+
 int main(int argc, char *argv[]) {
-  hash_f *f;
+  hash_f *f = nullptr;
   hash_func *hf;
+  size_t lanes = 0;
+  bool fastLanes = false;
   fstream input;
-  vector<char> data;
-  chash expected, actual;
-  size_t test = 0;
+  vector<test_case> tests;
+  chash actual;
   bool error = false;
   if (argc != 3) {
     cerr << "Wrong number of arguments" << endl;
     return 1;
   }
-  for (hf = hashes;; hf++) {
-    if (hf >= &hashes[sizeof(hashes) / sizeof(hash_func)]) {
-      cerr << "Unknown function" << endl;
-      return 1;
-    }
-    if (argv[1] == hf->name) {
-      f = &hf->f;
-      break;
+  if (argv[1] == string("slow-2")) {
+    lanes = 2;
+  } else if (argv[1] == string("slow-4")) {
+    lanes = 4;
+  } else if (argv[1] == string("fast-4")) {
+    fastLanes = true;
+  } else {
+    for (hf = hashes;; hf++) {
+      if (hf >= &hashes[sizeof(hashes) / sizeof(hash_func)]) {
+        cerr << "Unknown function" << endl;
+        return 1;
+      }
+      if (argv[1] == hf->name) {
+        f = &hf->f;
+        break;
+      }
     }
   }
   if (f == slow_hash) {
@@ -82,35 +178,27 @@ int main(int argc, char *argv[]) {
   }
   input.open(argv[2], ios_base::in);
   for (;;) {
-    ++test;
+    test_case test;
     input.exceptions(ios_base::badbit);
-    get(input, expected);
+    get(input, test.expected);
     if (input.rdstate() & ios_base::eofbit) {
       break;
     }
     input.exceptions(ios_base::badbit | ios_base::failbit | ios_base::eofbit);
     input.clear(input.rdstate());
-    get(input, data);
-    f(data.data(), data.size(), (char *) &actual);
-    if (expected != actual) {
-      size_t i;
-      cerr << "Hash mismatch on test " << test << endl << "Input: ";
-      if (data.size() == 0) {
-        cerr << "empty";
-      } else {
-        for (i = 0; i < data.size(); i++) {
-          cerr << setbase(16) << setw(2) << setfill('0') << int(static_cast<unsigned char>(data[i]));
-        }
-      }
-      cerr << endl << "Expected hash: ";
-      for (i = 0; i < 32; i++) {
-          cerr << setbase(16) << setw(2) << setfill('0') << int(reinterpret_cast<unsigned char *>(&expected)[i]);
-      }
-      cerr << endl << "Actual hash: ";
-      for (i = 0; i < 32; i++) {
-          cerr << setbase(16) << setw(2) << setfill('0') << int(reinterpret_cast<unsigned char *>(&actual)[i]);
-      }
-      cerr << endl;
+    get(input, test.data);
+    tests.push_back(test);
+  }
+  if (lanes != 0) {
+    return test_slow_hash_lanes(lanes, tests) ? 0 : 1;
+  }
+  if (fastLanes) {
+    return test_fast_hash_lanes(tests) ? 0 : 1;
+  }
+  for (size_t test = 0; test < tests.size(); test++) {
+    f(tests[test].data.data(), tests[test].data.size(), (char *) &actual);
+    if (tests[test].expected != actual) {
+      print_mismatch(test + 1, tests[test].data, tests[test].expected, actual);
       error = true;
     }
   }
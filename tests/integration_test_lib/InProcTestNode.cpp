@@ -160,8 +160,14 @@ bool InProcTestNode::getBlockTemplate(const std::string &minerAddress, CryptoNot
 }
 
 bool InProcTestNode::submitBlock(const std::string &block) {
+  // hex, as for RPC nodes
+  std::vector<uint8_t> blob;
+  if (!::Common::fromHex(block, blob)) {
+    return false;
+  }
+
   block_verification_context bvc = boost::value_initialized<block_verification_context>();
-  core->handle_incoming_block_blob(block, bvc, true, true);
+  core->handle_incoming_block_blob(::Common::StringView(reinterpret_cast<const char*>(blob.data()), blob.size()), bvc, true, true);
   return bvc.m_added_to_main_chain;
 }
 
@@ -0,0 +1,260 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "LinkShaper.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <System/Dispatcher.h>
+#include <System/InterruptedException.h>
+#include <System/Ipv4Address.h>
+#include <System/Latch.h>
+#include <System/TcpConnector.h>
+#include <System/TcpListener.h>
+
+using namespace System;
+
+namespace Tests {
+
+namespace {
+
+const size_t CHUNK_SIZE = 4096;
+
+}
+
+LinkShaper::Pipe::Pipe(Dispatcher& dispatcher, TcpConnection& from, TcpConnection& to) :
+  from(from), to(to), chunkAdded(dispatcher), timer(dispatcher), busyUntil(Clock::now()) {
+}
+
+LinkShaper::Session::Session(Dispatcher& dispatcher, TcpConnection&& incoming, TcpConnection&& outgoing, const LinkShape& shape) :
+  incoming(std::move(incoming)),
+  outgoing(std::move(outgoing)),
+  shape(shape),
+  forward(dispatcher, this->incoming, this->outgoing),
+  backward(dispatcher, this->outgoing, this->incoming),
+  stopped(false) {
+}
+
+LinkShaper::LinkShaper() : m_dispatcher(nullptr), m_stopEvent(nullptr), m_stopping(false) {
+}
+
+LinkShaper::~LinkShaper() {
+  stop();
+}
+
+void LinkShaper::addLink(uint16_t listenPort, uint16_t targetPort, const LinkShape& shape) {
+  assert(!m_thread.joinable());
+  Link link = { listenPort, targetPort, shape };
+  m_links.push_back(link);
+}
+
+void LinkShaper::start() {
+  std::promise<void> started;
+  std::future<void> startedFuture = started.get_future();
+  m_thread = std::thread(std::bind(&LinkShaper::run, this, std::ref(started)));
+  try {
+    startedFuture.get();
+  } catch (...) {
+    m_thread.join();
+    throw;
+  }
+}
+
+void LinkShaper::stop() {
+  if (!m_thread.joinable()) {
+    return;
+  }
+
+  m_dispatcher->remoteSpawn([this]() {
+    m_stopEvent->set();
+  });
+
+  m_thread.join();
+}
+
+void LinkShaper::run(std::promise<void>& started) {
+  Dispatcher dispatcher;
+  Event stopEvent(dispatcher);
+  std::list<TcpListener> listeners;
+  try {
+    for (const Link& link : m_links) {
+      listeners.emplace_back(dispatcher, Ipv4Address("127.0.0.1"), link.listenPort);
+    }
+  } catch (...) {
+    started.set_exception(std::current_exception());
+    return;
+  }
+
+  m_dispatcher = &dispatcher;
+  m_stopEvent = &stopEvent;
+  m_stopping = false;
+  started.set_value();
+
+  Latch running(dispatcher);
+  auto listener = listeners.begin();
+  for (const Link& link : m_links) {
+    TcpListener& linkListener = *listener++;
+    running.increase();
+    dispatcher.spawn([this, &linkListener, &link, &running]() {
+      acceptConnections(linkListener, link);
+      running.decrease();
+    });
+  }
+
+  stopEvent.wait();
+  m_stopping = true;
+  for (TcpListener& listener : listeners) {
+    listener.stop();
+  }
+
+  for (Session& session : m_sessions) {
+    stopSession(session);
+  }
+
+  running.wait();
+  // sessions are waited for by their acceptors
+  assert(m_sessions.empty());
+  m_dispatcher = nullptr;
+  m_stopEvent = nullptr;
+}
+
+void LinkShaper::acceptConnections(TcpListener& listener, const Link& link) {
+  Latch sessions(*m_dispatcher);
+  while (!m_stopping) {
+    try {
+      TcpConnection incoming = listener.accept();
+      TcpConnector connector(*m_dispatcher);
+      TcpConnection outgoing = connector.connect(Ipv4Address("127.0.0.1"), link.targetPort);
+      if (m_stopping) {
+        break;
+      }
+
+      m_sessions.emplace_back(*m_dispatcher, std::move(incoming), std::move(outgoing), link.shape);
+      auto session = std::prev(m_sessions.end());
+      sessions.increase();
+      m_dispatcher->spawn([this, session, &sessions]() {
+        forwardConnection(session);
+        sessions.decrease();
+      });
+    } catch (InterruptedException&) {
+      break;
+    } catch (std::exception&) {
+      // target isn't listening yet, the connecting side retries
+    }
+  }
+
+  sessions.wait();
+}
+
+void LinkShaper::forwardConnection(std::list<Session>::iterator session) {
+  Latch pipes(*m_dispatcher);
+  pipes.increase(4);
+  for (Pipe* pipe : { &session->forward, &session->backward }) {
+    m_dispatcher->spawn([this, session, pipe, &pipes]() {
+      readPipe(*session, *pipe);
+      pipes.decrease();
+    });
+
+    m_dispatcher->spawn([this, session, pipe, &pipes]() {
+      writePipe(*session, *pipe);
+      pipes.decrease();
+    });
+  }
+
+  pipes.wait();
+  m_sessions.erase(session);
+}
+
+void LinkShaper::readPipe(Session& session, Pipe& pipe) {
+  try {
+    for (;;) {
+      Chunk chunk;
+      chunk.data.resize(CHUNK_SIZE);
+      chunk.data.resize(pipe.from.read(chunk.data.data(), chunk.data.size()));
+
+      // a chunk leaves the link after chunks read before it and its own bytes are transmitted
+      Clock::time_point now = Clock::now();
+      pipe.busyUntil = std::max(pipe.busyUntil, now);
+      if (session.shape.bandwidth != 0) {
+        pipe.busyUntil += std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(static_cast<double>(chunk.data.size()) / session.shape.bandwidth));
+      }
+
+      chunk.deliveryTime = pipe.busyUntil + session.shape.latency;
+      bool last = chunk.data.empty();
+      pipe.chunks.push_back(std::move(chunk));
+      pipe.chunkAdded.set();
+      if (last) {
+        break;
+      }
+    }
+  } catch (std::exception&) {
+    stopSession(session);
+  }
+}
+
+void LinkShaper::writePipe(Session& session, Pipe& pipe) {
+  try {
+    for (;;) {
+      while (pipe.chunks.empty()) {
+        if (session.stopped) {
+          return;
+        }
+
+        pipe.chunkAdded.wait();
+        pipe.chunkAdded.clear();
+      }
+
+      Chunk& chunk = pipe.chunks.front();
+      Clock::time_point now = Clock::now();
+      if (chunk.deliveryTime > now) {
+        pipe.timer.sleep(std::chrono::duration_cast<std::chrono::nanoseconds>(chunk.deliveryTime - now));
+      }
+
+      if (chunk.data.empty()) {
+        // passes the end of data on, the other direction may still be in use
+        pipe.to.write(static_cast<const uint8_t*>(nullptr), 0);
+        return;
+      }
+
+      for (size_t offset = 0; offset < chunk.data.size();) {
+        offset += pipe.to.write(chunk.data.data() + offset, chunk.data.size() - offset);
+      }
+
+      pipe.chunks.pop_front();
+    }
+  } catch (std::exception&) {
+    stopSession(session);
+  }
+}
+
+void LinkShaper::stopSession(Session& session) {
+  if (session.stopped) {
+    return;
+  }
+
+  session.stopped = true;
+  session.incoming.stop();
+  session.outgoing.stop();
+  for (Pipe* pipe : { &session.forward, &session.backward }) {
+    pipe->timer.stop();
+    pipe->chunkAdded.set();
+  }
+}
+
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include <System/Event.h>
+#include <System/TcpConnection.h>
+#include <System/Timer.h>
+
+namespace System {
+class Dispatcher;
+class TcpListener;
+}
+
+namespace Tests {
+
+struct LinkShape {
+  std::chrono::milliseconds latency;
+  // bytes per second in each direction, 0 for unlimited
+  uint64_t bandwidth;
+};
+
+// Forwards TCP connections accepted on local ports to other local ports, delaying data by the latency of the link
+// and not passing it faster than its bandwidth, so nodes pointed at the listening ports talk over a simulated network.
+// Connections are forwarded from its own thread.
+class LinkShaper {
+public:
+  LinkShaper();
+  ~LinkShaper();
+
+  // Links are added before start
+  void addLink(uint16_t listenPort, uint16_t targetPort, const LinkShape& shape);
+  void start();
+  // Does nothing if not started
+  void stop();
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Link {
+    uint16_t listenPort;
+    uint16_t targetPort;
+    LinkShape shape;
+  };
+
+  struct Chunk {
+    // empty one marks the end of data
+    std::vector<uint8_t> data;
+    Clock::time_point deliveryTime;
+  };
+
+  struct Pipe {
+    Pipe(System::Dispatcher& dispatcher, System::TcpConnection& from, System::TcpConnection& to);
+
+    System::TcpConnection& from;
+    System::TcpConnection& to;
+    std::deque<Chunk> chunks;
+    System::Event chunkAdded;
+    System::Timer timer;
+    // when the link finishes transmitting chunks read so far
+    Clock::time_point busyUntil;
+  };
+
+  struct Session {
+    Session(System::Dispatcher& dispatcher, System::TcpConnection&& incoming, System::TcpConnection&& outgoing, const LinkShape& shape);
+
+    System::TcpConnection incoming;
+    System::TcpConnection outgoing;
+    LinkShape shape;
+    Pipe forward;
+    Pipe backward;
+    bool stopped;
+  };
+
+  void run(std::promise<void>& started);
+  void acceptConnections(System::TcpListener& listener, const Link& link);
+  void forwardConnection(std::list<Session>::iterator session);
+  void readPipe(Session& session, Pipe& pipe);
+  void writePipe(Session& session, Pipe& pipe);
+  void stopSession(Session& session);
+
+  std::vector<Link> m_links;
+  std::thread m_thread;
+  System::Dispatcher* m_dispatcher;
+  System::Event* m_stopEvent;
+  std::list<Session> m_sessions;
+  bool m_stopping;
+};
+
+}
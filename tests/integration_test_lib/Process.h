@@ -27,6 +27,8 @@ namespace Tests {
 
     void startChild(const std::string& executablePath, const std::vector<std::string>& args = {});
     void wait();
+    // 0 if the child isn't running or its pid isn't known, as on Windows
+    size_t getPid() const { return m_pid; }
 
   private:
 
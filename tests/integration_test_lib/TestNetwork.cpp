@@ -194,6 +194,7 @@ void TestNetwork::addNode(const TestNodeConfiguration& cfg) {
   }
 
   nodes.push_back(std::make_pair(std::move(node), cfg));
+  m_nodePids.push_back(cfg.nodeType == NodeType::RPC ? m_daemons.back().getPid() : 0);
 }
 
 void TestNetwork::waitNodesReady() {
@@ -212,6 +213,14 @@ TestNode& TestNetwork::getNode(size_t index) {
   return *nodes[index].first;
 }
 
+size_t TestNetwork::getDaemonPid(size_t index) {
+  if (index >= m_nodePids.size()) {
+    throw std::runtime_error("Invalid node index");
+  }
+
+  return m_nodePids[index];
+}
+
 void TestNetwork::shutdown() {
   for (auto& node : nodes) {
     node.first->stopDaemon();
@@ -73,6 +73,8 @@ public:
   void shutdown();
 
   TestNode& getNode(size_t index);
+  // 0 for in-process nodes
+  size_t getDaemonPid(size_t index);
 
 private:
 
@@ -82,6 +84,7 @@ private:
   System::Dispatcher& m_dispatcher;
   const CryptoNote::Currency& m_currency;
   std::vector<Process> m_daemons;
+  std::vector<size_t> m_nodePids;
 };
 
 }
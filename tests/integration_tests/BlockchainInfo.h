@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "Common/StringOutputStream.h"
 #include "serialization/SerializationOverloads.h"
 #include "cryptonote_core/cryptonote_serialization.h"
 
@@ -53,10 +54,12 @@ namespace CryptoNote {
   };
 
   void storeBlockchainInfo(const std::string& filename, BlockchainInfo& bc) {
-    JsonOutputStreamSerializer s;
+    std::string json;
+    Common::StringOutputStream stream(json);
+    JsonOutputStreamSerializer s(stream);
     s(bc, "");
     std::ofstream jsonBlocks(filename, std::ios::trunc);
-    jsonBlocks << s;
+    jsonBlocks << json;
   }
 
   void loadBlockchainInfo(const std::string& filename, BlockchainInfo& bc) {
@@ -0,0 +1,145 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+
+#include <Logging/LoggerRef.h>
+#include <System/Ipv4Address.h>
+#include <System/Latch.h>
+#include <System/TcpConnection.h>
+#include <System/TcpConnector.h>
+#include <boost/uuid/uuid.hpp>
+
+#include "crypto/crypto.h"
+#include "cryptonote_core/account.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "p2p/LevinProtocol.h"
+#include "p2p/p2p_networks.h"
+#include "p2p/p2p_protocol_defs.h"
+
+#include "../integration_test_lib/BaseFunctionalTest.h"
+
+using namespace CryptoNote;
+using namespace Logging;
+
+extern Tests::Common::BaseFunctionalTestConfig baseCfg;
+extern System::Dispatcher globalDispatcher;
+
+namespace {
+
+// every simulated peer takes two descriptors in this process, one on each side of the loopback connection
+const size_t PEERS_COUNT = 256;
+
+class ManyPeersTest : public Tests::Common::BaseFunctionalTest, public ::testing::Test {
+public:
+  ManyPeersTest() :
+    currency(CryptoNote::CurrencyBuilder(log).testnet(true).currency()),
+    BaseFunctionalTest(currency, globalDispatcher, baseCfg),
+    logger(log, "ManyPeersTest") {
+  }
+
+  ~ManyPeersTest() {
+    stopTestnet();
+  }
+
+protected:
+  // Connects to the first node as a peer on the same chain, then waits for a relayed block
+  void simulatePeer(System::Latch& handshaked, System::Latch& relayed, size_t& failures) {
+    bool counted = false;
+    try {
+      System::TcpConnector connector(globalDispatcher);
+      System::TcpConnection connection = connector.connect(System::Ipv4Address("127.0.0.1"), Tests::Common::P2P_FIRST_PORT);
+      LevinProtocol proto(connection);
+
+      COMMAND_HANDSHAKE::request request;
+      request.node_data.network_id = BYTECOIN_NETWORK;
+      request.node_data.network_id.data[0] += 1;
+      request.node_data.local_time = time(nullptr);
+      request.node_data.my_port = 0;
+      request.node_data.peer_id = crypto::rand<uint64_t>();
+      request.payload_data.current_height = nodeDaemons.front()->getLocalHeight();
+      nodeDaemons.front()->getTailBlockId(request.payload_data.top_id);
+      request.payload_data.version = P2P_CURRENT_VERSION;
+
+      COMMAND_HANDSHAKE::response response;
+      proto.invoke(COMMAND_HANDSHAKE::ID, request, response);
+      handshaked.decrease();
+      counted = true;
+
+      LevinProtocol::Command command;
+      while (proto.readCommand(command)) {
+        if (command.command == NOTIFY_NEW_COMPACT_BLOCK::ID || command.command == NOTIFY_NEW_BLOCK::ID) {
+          break;
+        }
+      }
+    } catch (std::exception& e) {
+      logger(ERROR) << "Simulated peer failed: " << e.what();
+      ++failures;
+      if (!counted) {
+        handshaked.decrease();
+      }
+    }
+
+    relayed.decrease();
+  }
+
+  Logging::ConsoleLogger log;
+  CryptoNote::Currency currency;
+  Logging::LoggerRef logger;
+};
+
+}
+
+TEST_F(ManyPeersTest, RelayBlockToManyPeers) {
+  launchInprocTestnet(1);
+
+  System::Latch handshaked(globalDispatcher);
+  System::Latch relayed(globalDispatcher);
+  size_t failures = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  handshaked.increase(PEERS_COUNT);
+  relayed.increase(PEERS_COUNT);
+  for (size_t i = 0; i < PEERS_COUNT; ++i) {
+    globalDispatcher.spawn([this, &handshaked, &relayed, &failures] {
+      simulatePeer(handshaked, relayed, failures);
+    });
+  }
+
+  handshaked.wait();
+  auto handshakeTime = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(0, failures);
+
+  account_base miner;
+  miner.generate();
+  start = std::chrono::steady_clock::now();
+  bool mined = mineBlocks(*nodeDaemons.front(), miner.get_keys().m_account_address, 1);
+  if (!mined) {
+    // peers waiting for the block are released by closed connections
+    stopTestnet();
+  }
+
+  relayed.wait();
+  auto relayTime = std::chrono::steady_clock::now() - start;
+  ASSERT_TRUE(mined);
+  ASSERT_EQ(0, failures);
+
+  logger(INFO) << PEERS_COUNT << " peers handshaked in " << std::chrono::duration_cast<std::chrono::milliseconds>(handshakeTime).count() <<
+    " ms, block relayed to all of them in " << std::chrono::duration_cast<std::chrono::milliseconds>(relayTime).count() << " ms";
+}
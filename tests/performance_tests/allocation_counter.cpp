@@ -0,0 +1,63 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+  std::atomic<uint64_t> g_allocations(0);
+
+  void* counted_alloc(std::size_t size)
+  {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size != 0 ? size : 1);
+    if (p == nullptr)
+      throw std::bad_alloc();
+
+    return p;
+  }
+}
+
+uint64_t allocation_count()
+{
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+// replaced for the whole program, array and nothrow forms of the standard library call these
+void* operator new(std::size_t size)
+{
+  return counted_alloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+  return counted_alloc(size);
+}
+
+void operator delete(void* p) throw()
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+  std::free(p);
+}
@@ -29,6 +29,10 @@
 #include "generate_key_image.h"
 #include "generate_key_image_helper.h"
 #include "is_out_to_acc.h"
+#include "parse_block.h"
+#include "parse_tx.h"
+#include "serialize_payload.h"
+#include "underive_public_keys.h"
 
 int main(int argc, char** argv)
 {
@@ -64,15 +68,37 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(test_check_ring_signature, 10);
   TEST_PERFORMANCE1(test_check_ring_signature, 100);
 
+  TEST_PERFORMANCE1(test_parse_tx, 1);
+  TEST_PERFORMANCE1(test_parse_tx, 10);
+  TEST_PERFORMANCE1(test_parse_tx, 100);
+
+  TEST_PERFORMANCE1(test_parse_block, 1);
+  TEST_PERFORMANCE1(test_parse_block, 100);
+
   TEST_PERFORMANCE0(test_is_out_to_acc);
   TEST_PERFORMANCE0(test_generate_key_image_helper);
   TEST_PERFORMANCE0(test_generate_key_derivation);
   TEST_PERFORMANCE0(test_generate_key_image);
   TEST_PERFORMANCE0(test_derive_public_key);
   TEST_PERFORMANCE0(test_derive_secret_key);
+  TEST_PERFORMANCE2(test_underive_public_keys, 10, false);
+  TEST_PERFORMANCE2(test_underive_public_keys, 10, true);
 
   TEST_PERFORMANCE0(test_cn_slow_hash);
 
+  serialization_payloads payloads;
+  if (payloads.init())
+  {
+    TEST_SERIALIZATION(payloads, transaction);
+    TEST_SERIALIZATION(payloads, block);
+    TEST_SERIALIZATION(payloads, get_objects);
+    TEST_SERIALIZATION(payloads, query_blocks);
+  }
+  else
+  {
+    std::cout << "serialization payloads - FAILED to init" << std::endl;
+  }
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
   return 0;
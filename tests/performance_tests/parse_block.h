@@ -0,0 +1,89 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+
+#include "cryptonote_core/account.h"
+#include "cryptonote_core/cryptonote_basic.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+
+#include "multi_tx_test_base.h"
+
+// parses a block and its transactions from their blobs the way a received block is taken, most of the varints of
+// the transactions are key offsets, amounts and sizes
+template<size_t a_tx_count>
+class test_parse_block : private multi_tx_test_base<10>
+{
+  static_assert(0 < a_tx_count, "tx_count must be greater than 0");
+
+public:
+  static const size_t loop_count = 100;
+  static const size_t tx_count = a_tx_count;
+
+  typedef multi_tx_test_base<10> base_class;
+
+  bool init()
+  {
+    using namespace CryptoNote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount, m_alice.get_keys().m_account_address));
+
+    Transaction tx;
+    if (!construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, destinations, std::vector<uint8_t>(), tx, 0, this->m_logger))
+      return false;
+
+    Block block = boost::value_initialized<Block>();
+    block.majorVersion = BLOCK_MAJOR_VERSION_1;
+    block.minorVersion = BLOCK_MINOR_VERSION_0;
+    block.timestamp = 1400000000;
+    block.minerTx = this->m_miner_txs[0];
+    block.txHashes.assign(tx_count, get_transaction_hash(tx));
+
+    m_block_blob = block_to_blob(block);
+    m_tx_blobs.assign(tx_count, tx_to_blob(tx));
+    return true;
+  }
+
+  bool test()
+  {
+    CryptoNote::Block block;
+    if (!CryptoNote::parse_and_validate_block_from_blob(m_block_blob, block) || block.txHashes.size() != tx_count)
+      return false;
+
+    for (const CryptoNote::blobdata& blob : m_tx_blobs)
+    {
+      CryptoNote::Transaction tx;
+      if (!CryptoNote::parse_and_validate_tx_from_blob(blob, tx))
+        return false;
+    }
+
+    return true;
+  }
+
+private:
+  CryptoNote::account_base m_alice;
+  CryptoNote::blobdata m_block_blob;
+  std::vector<CryptoNote::blobdata> m_tx_blobs;
+};
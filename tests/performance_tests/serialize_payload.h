@@ -0,0 +1,295 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <iomanip>
+#include <list>
+#include <sstream>
+#include <string>
+
+#include <boost/chrono.hpp>
+
+#include "Common/StringOutputStream.h"
+#include "cryptonote_core/cryptonote_serialization.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "serialization/BinaryInputStreamSerializer.h"
+#include "serialization/BinaryOutputStreamSerializer.h"
+#include "serialization/JsonInputStreamSerializer.h"
+#include "serialization/JsonOutputStreamSerializer.h"
+#include "serialization/KVBinaryInputStreamSerializer.h"
+#include "serialization/KVBinaryOutputStreamSerializer.h"
+#include "serialization/SerializationOverloads.h"
+
+#include "allocation_counter.h"
+#include "multi_tx_test_base.h"
+
+// Protocol and RPC messages are stored by epee, these mirror their layout for ISerializer backends
+namespace CryptoNote
+{
+  inline void serialize_blobs(std::list<blobdata>& blobs, const std::string& name, ISerializer& s)
+  {
+    size_t size = blobs.size();
+    s.beginArray(size, name);
+    if (s.type() == ISerializer::INPUT)
+      blobs.resize(size);
+
+    for (blobdata& blob : blobs)
+      s.binary(blob, "");
+
+    s.endArray();
+  }
+
+  inline void serialize(block_complete_entry& entry, const std::string& name, ISerializer& s)
+  {
+    s.beginObject(name);
+    s.binary(entry.block, "block");
+    serialize_blobs(entry.txs, "txs", s);
+    s.endObject();
+  }
+
+  inline void serialize(BlockFullInfo& info, const std::string& name, ISerializer& s)
+  {
+    s.beginObject(name);
+    s(info.block_id, "block_id");
+    s.binary(info.block, "block");
+    serialize_blobs(info.txs, "txs", s);
+    s.endObject();
+  }
+
+  inline void serialize(NOTIFY_RESPONSE_GET_OBJECTS_request& response, const std::string& name, ISerializer& s)
+  {
+    s.beginObject(name);
+    serialize_blobs(response.txs, "txs", s);
+    s(response.blocks, "blocks");
+    s(response.missed_ids, "missed_ids");
+    s(response.current_blockchain_height, "current_blockchain_height");
+    s.endObject();
+  }
+
+  inline void serialize(COMMAND_RPC_QUERY_BLOCKS::response& response, const std::string& name, ISerializer& s)
+  {
+    s.beginObject(name);
+    s(response.status, "status");
+    s(response.start_height, "start_height");
+    s(response.current_height, "current_height");
+    s(response.full_offset, "full_offset");
+    s(response.items, "items");
+    s.endObject();
+  }
+}
+
+struct binary_backend
+{
+  static const char* name() { return "binary"; }
+
+  template<typename T>
+  static void encode(T& value, std::string& data)
+  {
+    std::ostringstream stream;
+    CryptoNote::BinaryOutputStreamSerializer s(stream);
+    serialize(value, "", s);
+    data = stream.str();
+  }
+
+  template<typename T>
+  static void decode(const std::string& data, T& value)
+  {
+    std::istringstream stream(data);
+    CryptoNote::BinaryInputStreamSerializer s(stream);
+    serialize(value, "", s);
+  }
+};
+
+struct kv_binary_backend
+{
+  static const char* name() { return "kv binary"; }
+
+  template<typename T>
+  static void encode(T& value, std::string& data)
+  {
+    CryptoNote::KVBinaryOutputStreamSerializer s;
+    serialize(value, "", s);
+    std::ostringstream stream;
+    s.write(stream);
+    data = stream.str();
+  }
+
+  template<typename T>
+  static void decode(const std::string& data, T& value)
+  {
+    std::istringstream stream(data);
+    CryptoNote::KVBinaryInputStreamSerializer s(stream);
+    s.parse();
+    serialize(value, "", s);
+  }
+};
+
+struct json_backend
+{
+  static const char* name() { return "json"; }
+
+  template<typename T>
+  static void encode(T& value, std::string& data)
+  {
+    data.clear();
+    Common::StringOutputStream stream(data);
+    CryptoNote::JsonOutputStreamSerializer s(stream);
+    serialize(value, "", s);
+  }
+
+  template<typename T>
+  static void decode(const std::string& data, T& value)
+  {
+    std::istringstream stream(data);
+    CryptoNote::JsonInputStreamSerializer s(stream);
+    serialize(value, "", s);
+  }
+};
+
+// Payloads shaped like the ones nodes and wallets exchange, one input transactions with a ring of 5 and 8 outputs
+class serialization_payloads : private multi_tx_test_base<5>
+{
+public:
+  static const size_t block_tx_count = 50;
+  static const size_t get_objects_block_count = 20;
+  static const size_t query_blocks_block_count = 100;
+  static const size_t txs_per_block = 10;
+
+  bool init()
+  {
+    using namespace CryptoNote;
+
+    if (!multi_tx_test_base<5>::init())
+      return false;
+
+    m_alice.generate();
+    std::vector<tx_destination_entry> destinations;
+    for (size_t i = 0; i < 8; ++i)
+      destinations.push_back(tx_destination_entry(m_source_amount / 8, m_alice.get_keys().m_account_address));
+
+    if (!construct_tx(m_miners[real_source_idx].get_keys(), m_sources, destinations, std::vector<uint8_t>(), m_transaction, 0, m_logger))
+      return false;
+
+    Currency currency = CurrencyBuilder(m_logger).currency();
+    m_block = currency.genesisBlock();
+    m_block.prevId = get_block_hash(m_block);
+    for (size_t i = 0; i < block_tx_count; ++i)
+    {
+      crypto::hash tx_hash = get_transaction_hash(m_transaction);
+      reinterpret_cast<uint32_t&>(tx_hash) = static_cast<uint32_t>(i);
+      m_block.txHashes.push_back(tx_hash);
+    }
+
+    block_complete_entry entry;
+    entry.block = block_to_blob(m_block);
+    entry.txs.assign(txs_per_block, tx_to_blob(m_transaction));
+
+    m_get_objects.blocks.assign(get_objects_block_count, entry);
+    m_get_objects.current_blockchain_height = 100000;
+
+    BlockFullInfo info;
+    info.block_id = get_block_hash(m_block);
+    info.block = entry.block;
+    info.txs = entry.txs;
+    m_query_blocks.status = CORE_RPC_STATUS_OK;
+    m_query_blocks.start_height = 100000;
+    m_query_blocks.current_height = 100000 + query_blocks_block_count;
+    m_query_blocks.full_offset = 0;
+    m_query_blocks.items.assign(query_blocks_block_count, info);
+    return true;
+  }
+
+  CryptoNote::Transaction& transaction() { return m_transaction; }
+  CryptoNote::Block& block() { return m_block; }
+  CryptoNote::NOTIFY_RESPONSE_GET_OBJECTS_request& get_objects() { return m_get_objects; }
+  CryptoNote::COMMAND_RPC_QUERY_BLOCKS::response& query_blocks() { return m_query_blocks; }
+
+private:
+  CryptoNote::account_base m_alice;
+  CryptoNote::Transaction m_transaction;
+  CryptoNote::Block m_block;
+  CryptoNote::NOTIFY_RESPONSE_GET_OBJECTS_request m_get_objects;
+  CryptoNote::COMMAND_RPC_QUERY_BLOCKS::response m_query_blocks;
+};
+
+// Encodes and decodes the payload for about a second each way, reports MB/s of the encoded form and operator new
+// calls per message
+template<typename Backend, typename T>
+void run_serialization_test(const char* payload_name, T& payload)
+{
+  typedef boost::chrono::high_resolution_clock clock;
+  const clock::duration min_duration = boost::chrono::seconds(1);
+
+  std::string data;
+  Backend::encode(payload, data);
+
+  size_t encoded = 0;
+  uint64_t allocations = allocation_count();
+  clock::time_point start = clock::now();
+  clock::duration encode_time;
+  do
+  {
+    std::string encoded_data;
+    Backend::encode(payload, encoded_data);
+    ++encoded;
+    encode_time = clock::now() - start;
+  } while (encode_time < min_duration);
+  uint64_t encode_allocations = allocation_count() - allocations;
+
+  size_t decoded = 0;
+  allocations = allocation_count();
+  start = clock::now();
+  clock::duration decode_time;
+  do
+  {
+    T value;
+    Backend::decode(data, value);
+    ++decoded;
+    decode_time = clock::now() - start;
+  } while (decode_time < min_duration);
+  uint64_t decode_allocations = allocation_count() - allocations;
+
+  double encode_seconds = boost::chrono::duration<double>(encode_time).count();
+  double decode_seconds = boost::chrono::duration<double>(decode_time).count();
+  std::cout << "serialize " << payload_name << ", " << Backend::name() << ":\n";
+  std::cout << "  message size:  " << data.size() << " bytes\n";
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "  encode:        " << data.size() * encoded / encode_seconds / 1000000 << " MB/s, " <<
+    static_cast<double>(encode_allocations) / encoded << " allocations/message\n";
+  std::cout << "  decode:        " << data.size() * decoded / decode_seconds / 1000000 << " MB/s, " <<
+    static_cast<double>(decode_allocations) / decoded << " allocations/message\n" << std::endl;
+  std::cout.unsetf(std::ios_base::floatfield);
+}
+
+template<typename T>
+void run_serialization_tests(const char* payload_name, T& payload)
+{
+  try
+  {
+    run_serialization_test<binary_backend>(payload_name, payload);
+    run_serialization_test<kv_binary_backend>(payload_name, payload);
+    run_serialization_test<json_backend>(payload_name, payload);
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "serialize " << payload_name << " - FAILED: " << e.what() << std::endl;
+  }
+}
+
+#define TEST_SERIALIZATION(payloads, payload) run_serialization_tests(QUOTEME(payload), payloads.payload())
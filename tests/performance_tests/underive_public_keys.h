@@ -0,0 +1,70 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_core/cryptonote_basic.h"
+
+#include "single_tx_test_base.h"
+
+// Finding own outputs among keyCount outputs of a transaction, key by key or all keys at once
+template<size_t keyCount, bool batch>
+class test_underive_public_keys : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 1000 / keyCount + 10;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+
+    crypto::generate_key_derivation(m_tx_pub_key, m_bob.get_keys().m_view_secret_key, m_key_derivation);
+    for (size_t i = 0; i < keyCount; ++i) {
+      crypto::public_key key;
+      crypto::derive_public_key(m_key_derivation, i, m_bob.get_keys().m_account_address.m_spendPublicKey, key);
+      m_keys.push_back(key);
+      m_indexes.push_back(i);
+    }
+
+    m_bases.resize(keyCount);
+    return true;
+  }
+
+  bool test()
+  {
+    if (batch) {
+      bool valid[keyCount];
+      crypto::underive_public_keys(m_key_derivation, m_indexes.data(), m_keys.data(), keyCount, m_bases.data(), valid);
+    } else {
+      for (size_t i = 0; i < keyCount; ++i) {
+        crypto::underive_public_key(m_key_derivation, i, m_keys[i], m_bases[i]);
+      }
+    }
+
+    return m_bases.back() == m_bob.get_keys().m_account_address.m_spendPublicKey;
+  }
+
+private:
+  crypto::key_derivation m_key_derivation;
+  std::vector<crypto::public_key> m_keys;
+  std::vector<size_t> m_indexes;
+  std::vector<crypto::public_key> m_bases;
+};
@@ -0,0 +1,523 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+// Runs a network of in-process nodes connected through links with simulated latency and bandwidth, mines blocks and
+// sends transactions on the first node and measures how long they take to reach 50%, 90% and all of the other nodes.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <Logging/ConsoleLogger.h>
+#include <System/Dispatcher.h>
+
+#include "Common/command_line.h"
+#include "Common/StringTools.h"
+#include "cryptonote_core/account.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/Currency.h"
+#include "cryptonote_core/miner.h"
+
+#include "../integration_test_lib/LinkShaper.h"
+#include "../integration_test_lib/TestNetwork.h"
+
+using namespace CryptoNote;
+
+namespace po = boost::program_options;
+
+namespace {
+
+const command_line::arg_descriptor<size_t> argNodes = { "nodes", "Nodes in the network", 20 };
+const command_line::arg_descriptor<std::string> argTopology = { "topology", "random, ring, line or star", "random" };
+const command_line::arg_descriptor<size_t> argDegree = { "degree", "Outgoing links of a node in random topology", 3 };
+const command_line::arg_descriptor<uint32_t> argLatency = { "latency", "Latency of a link, ms", 50 };
+const command_line::arg_descriptor<uint64_t> argBandwidth = { "bandwidth", "Bandwidth of a link each way, bytes/sec, 0 for unlimited", 1000000 };
+const command_line::arg_descriptor<size_t> argBlocks = { "blocks", "Blocks to propagate", 10 };
+const command_line::arg_descriptor<size_t> argTransactions = { "transactions", "Transactions to propagate", 10 };
+const command_line::arg_descriptor<uint16_t> argP2pBasePort = { "p2p-base-port", "P2P port of the first node", 9000 };
+const command_line::arg_descriptor<uint16_t> argLinkBasePort = { "link-base-port", "Port of the first link", 10000 };
+const command_line::arg_descriptor<std::string> argDataDir = { "data-dir", "Directory for node data, removed on exit", "propagation_simulator" };
+const command_line::arg_descriptor<uint32_t> argSeed = { "seed", "Seed of random topology", 0 };
+
+typedef std::chrono::steady_clock Clock;
+
+const std::chrono::seconds ROUND_TIMEOUT(60);
+
+// Arrival times of the block or transaction of the current round, the first one reported by a node counts
+class ArrivalTracker {
+public:
+  explicit ArrivalTracker(size_t nodeCount) : m_arrivals(nodeCount), m_expectedHeight(0), m_expectingTransaction(false), m_arrivedCount(0) {
+  }
+
+  void expectBlock(uint64_t height) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    reset();
+    m_expectedHeight = height;
+  }
+
+  void expectTransaction() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    reset();
+    m_expectingTransaction = true;
+  }
+
+  void blockchainUpdated(size_t node, uint64_t height) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_expectedHeight != 0 && height >= m_expectedHeight) {
+      arrived(node);
+    }
+  }
+
+  void poolChanged(size_t node) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_expectingTransaction) {
+      arrived(node);
+    }
+  }
+
+  // Arrival delays of the nodes except the origin, sorted, fewer on timeout
+  std::vector<Clock::duration> wait(size_t origin, Clock::time_point start) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_arrivedCondition.wait_for(lock, ROUND_TIMEOUT, [&] {
+      return m_arrivedCount - (m_arrivals[origin].first ? 1 : 0) == m_arrivals.size() - 1;
+    });
+
+    std::vector<Clock::duration> delays;
+    for (size_t i = 0; i < m_arrivals.size(); ++i) {
+      if (i != origin && m_arrivals[i].first) {
+        delays.push_back(m_arrivals[i].second - start);
+      }
+    }
+
+    m_expectedHeight = 0;
+    m_expectingTransaction = false;
+    std::sort(delays.begin(), delays.end());
+    return delays;
+  }
+
+private:
+  void reset() {
+    std::fill(m_arrivals.begin(), m_arrivals.end(), std::make_pair(false, Clock::time_point()));
+    m_arrivedCount = 0;
+    m_expectedHeight = 0;
+    m_expectingTransaction = false;
+  }
+
+  void arrived(size_t node) {
+    if (!m_arrivals[node].first) {
+      m_arrivals[node] = std::make_pair(true, Clock::now());
+      ++m_arrivedCount;
+      m_arrivedCondition.notify_all();
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_arrivedCondition;
+  std::vector<std::pair<bool, Clock::time_point>> m_arrivals;
+  uint64_t m_expectedHeight;
+  bool m_expectingTransaction;
+  size_t m_arrivedCount;
+};
+
+class ArrivalObserver : public INodeObserver {
+public:
+  ArrivalObserver(ArrivalTracker& tracker, size_t node) : m_tracker(tracker), m_node(node) {
+  }
+
+  virtual void localBlockchainUpdated(uint64_t height) override {
+    m_tracker.blockchainUpdated(m_node, height);
+  }
+
+  virtual void poolChanged() override {
+    m_tracker.poolChanged(m_node);
+  }
+
+private:
+  ArrivalTracker& m_tracker;
+  size_t m_node;
+};
+
+// Times to reach 50%, 90% and 100% of nodes, summed over rounds
+struct PropagationStats {
+  PropagationStats() : rounds(0), incompleteRounds(0) {
+    std::fill(sums, sums + 3, 0.0);
+    std::fill(maximums, maximums + 3, 0.0);
+  }
+
+  void add(const std::vector<Clock::duration>& delays, size_t nodeCount) {
+    ++rounds;
+    if (delays.size() < nodeCount) {
+      ++incompleteRounds;
+      return;
+    }
+
+    const size_t percents[] = { 50, 90, 100 };
+    for (size_t i = 0; i < 3; ++i) {
+      size_t reached = std::max<size_t>((nodeCount * percents[i] + 99) / 100, 1);
+      double ms = std::chrono::duration<double, std::milli>(delays[reached - 1]).count();
+      sums[i] += ms;
+      maximums[i] = std::max(maximums[i], ms);
+    }
+  }
+
+  void print(const std::string& name) const {
+    size_t complete = rounds - incompleteRounds;
+    std::cout << name << ": " << rounds << " rounds, " << incompleteRounds << " didn't reach every node in " << ROUND_TIMEOUT.count() << " sec" << std::endl;
+    if (complete != 0) {
+      std::cout << "  mean ms to 50% / 90% / 100%: " << sums[0] / complete << " / " << sums[1] / complete << " / " << sums[2] / complete << std::endl;
+      std::cout << "  max ms to 50% / 90% / 100%: " << maximums[0] << " / " << maximums[1] << " / " << maximums[2] << std::endl;
+    }
+  }
+
+  size_t rounds;
+  size_t incompleteRounds;
+  double sums[3];
+  double maximums[3];
+};
+
+struct CoinbaseOutput {
+  tx_source_entry source;
+  uint64_t unlockTime;
+};
+
+std::vector<std::pair<size_t, size_t>> makeLinks(const std::string& topology, size_t nodeCount, size_t degree, uint32_t seed) {
+  std::vector<std::pair<size_t, size_t>> links;
+  if (topology == "line") {
+    for (size_t i = 1; i < nodeCount; ++i) {
+      links.emplace_back(i, i - 1);
+    }
+  } else if (topology == "ring") {
+    for (size_t i = 0; i < nodeCount && nodeCount > 1; ++i) {
+      links.emplace_back(i, (i + 1) % nodeCount);
+    }
+  } else if (topology == "star") {
+    for (size_t i = 1; i < nodeCount; ++i) {
+      links.emplace_back(0, i);
+    }
+  } else if (topology == "random") {
+    // a random tree keeps the network connected, the rest of the links are random
+    std::mt19937 random(seed);
+    std::set<std::pair<size_t, size_t>> connected;
+    auto connect = [&](size_t from, size_t to) {
+      if (from != to && connected.count(std::make_pair(std::min(from, to), std::max(from, to))) == 0) {
+        connected.insert(std::make_pair(std::min(from, to), std::max(from, to)));
+        links.emplace_back(from, to);
+        return true;
+      }
+
+      return false;
+    };
+
+    for (size_t i = 1; i < nodeCount; ++i) {
+      connect(i, random() % i);
+    }
+
+    for (size_t i = 0; i < nodeCount; ++i) {
+      size_t outgoing = i == 0 ? 0 : 1;
+      for (size_t attempt = 0; outgoing < std::min(degree, nodeCount - 1) && attempt < 10 * nodeCount; ++attempt) {
+        if (connect(i, random() % nodeCount)) {
+          ++outgoing;
+        }
+      }
+    }
+  } else {
+    throw std::runtime_error("Unknown topology: " + topology);
+  }
+
+  return links;
+}
+
+template<typename Request> std::error_code waitForNode(Request request) {
+  std::promise<std::error_code> result;
+  std::future<std::error_code> future = result.get_future();
+  request([&result](std::error_code ec) {
+    std::promise<std::error_code> detachedPromise = std::move(result);
+    detachedPromise.set_value(ec);
+  });
+
+  return future.get();
+}
+
+class Simulation {
+public:
+  Simulation(const Currency& currency, Tests::TestNetwork& network, std::vector<std::unique_ptr<INode>>& nodes, ArrivalTracker& tracker) :
+    m_currency(currency), m_network(network), m_nodes(nodes), m_tracker(tracker),
+    // timestamps in the past keep difficulty low
+    m_timestamp(time(nullptr) - 365 * 24 * 60 * 60) {
+    m_miner.generate();
+  }
+
+  bool propagateBlock(PropagationStats& stats) {
+    Tests::TestNode& origin = m_network.getNode(0);
+    Block block;
+    uint64_t difficulty;
+    if (!origin.getBlockTemplate(m_currency.accountAddressAsString(m_miner), block, difficulty)) {
+      return false;
+    }
+
+    block.timestamp = m_timestamp;
+    m_timestamp += 2 * m_currency.difficultyTarget();
+
+    if (block.majorVersion == BLOCK_MAJOR_VERSION_2) {
+      block.parentBlock.majorVersion = BLOCK_MAJOR_VERSION_1;
+      block.parentBlock.minorVersion = BLOCK_MINOR_VERSION_0;
+      block.parentBlock.numberOfTransactions = 1;
+
+      tx_extra_merge_mining_tag mmTag;
+      mmTag.depth = 0;
+      if (!get_aux_block_header_hash(block, mmTag.merkle_root)) {
+        return false;
+      }
+
+      block.parentBlock.minerTx.extra.clear();
+      if (!append_mm_tag_to_extra(block.parentBlock.minerTx.extra, mmTag)) {
+        return false;
+      }
+    }
+
+    if (!miner::find_nonce_for_given_block(m_context, block, difficulty)) {
+      return false;
+    }
+
+    uint64_t height = origin.getLocalHeight();
+    blobdata blob = block_to_blob(block);
+    m_tracker.expectBlock(height);
+    Clock::time_point start = Clock::now();
+    if (!origin.submitBlock(Common::toHex(blob.data(), blob.size()))) {
+      return false;
+    }
+
+    stats.add(m_tracker.wait(0, start), m_nodes.size() - 1);
+    return addCoinbaseOutputs(block.minerTx);
+  }
+
+  size_t spendableOutputCount() const {
+    uint64_t height = m_network.getNode(0).getLocalHeight();
+    return std::count_if(m_outputs.begin(), m_outputs.end(), [height](const CoinbaseOutput& output) { return output.unlockTime < height; });
+  }
+
+  bool propagateTransaction(PropagationStats& stats) {
+    uint64_t height = m_network.getNode(0).getLocalHeight();
+    auto output = std::find_if(m_outputs.begin(), m_outputs.end(), [height](const CoinbaseOutput& output) { return output.unlockTime < height; });
+    if (output == m_outputs.end()) {
+      return false;
+    }
+
+    std::vector<tx_source_entry> sources(1, output->source);
+    m_outputs.erase(output);
+
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(sources.front().amount - m_currency.minimumFee(), m_miner.get_keys().m_account_address));
+    Transaction tx;
+    Logging::ConsoleLogger logger(Logging::ERROR);
+    if (!construct_tx(m_miner.get_keys(), sources, destinations, std::vector<uint8_t>(), tx, 0, logger)) {
+      return false;
+    }
+
+    m_tracker.expectTransaction();
+    Clock::time_point start = Clock::now();
+    std::error_code ec = waitForNode([&](const INode::Callback& callback) { m_nodes[0]->relayTransaction(tx, callback); });
+    if (ec) {
+      return false;
+    }
+
+    stats.add(m_tracker.wait(0, start), m_nodes.size() - 1);
+    return true;
+  }
+
+private:
+  bool addCoinbaseOutputs(const Transaction& minerTx) {
+    std::vector<uint64_t> globalIndices;
+    crypto::hash hash = get_transaction_hash(minerTx);
+    std::error_code ec = waitForNode([&](const INode::Callback& callback) {
+      m_nodes[0]->getTransactionOutsGlobalIndices(hash, globalIndices, callback);
+    });
+
+    if (ec || globalIndices.size() != minerTx.vout.size()) {
+      return false;
+    }
+
+    crypto::public_key txKey = get_tx_pub_key_from_extra(minerTx);
+    for (size_t i = 0; i < minerTx.vout.size(); ++i) {
+      const TransactionOutput& out = minerTx.vout[i];
+      if (out.amount <= m_currency.minimumFee()) {
+        continue;
+      }
+
+      CoinbaseOutput output;
+      output.source.outputs.push_back(tx_source_entry::output_entry(globalIndices[i], boost::get<TransactionOutputToKey>(out.target).key));
+      output.source.real_output = 0;
+      output.source.real_out_tx_key = txKey;
+      output.source.real_output_in_tx_index = i;
+      output.source.amount = out.amount;
+      output.unlockTime = minerTx.unlockTime;
+      m_outputs.push_back(output);
+    }
+
+    return true;
+  }
+
+  const Currency& m_currency;
+  Tests::TestNetwork& m_network;
+  std::vector<std::unique_ptr<INode>>& m_nodes;
+  ArrivalTracker& m_tracker;
+  account_base m_miner;
+  crypto::cn_context m_context;
+  uint64_t m_timestamp;
+  std::vector<CoinbaseOutput> m_outputs;
+};
+
+}
+
+int main(int argc, char** argv) {
+  po::options_description desc("Allowed options");
+  command_line::add_arg(desc, command_line::arg_help);
+  command_line::add_arg(desc, argNodes);
+  command_line::add_arg(desc, argTopology);
+  command_line::add_arg(desc, argDegree);
+  command_line::add_arg(desc, argLatency);
+  command_line::add_arg(desc, argBandwidth);
+  command_line::add_arg(desc, argBlocks);
+  command_line::add_arg(desc, argTransactions);
+  command_line::add_arg(desc, argP2pBasePort);
+  command_line::add_arg(desc, argLinkBasePort);
+  command_line::add_arg(desc, argDataDir);
+  command_line::add_arg(desc, argSeed);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc, [&]() {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    return true;
+  });
+
+  if (!r) {
+    return 1;
+  }
+
+  if (command_line::get_arg(vm, command_line::arg_help)) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  size_t nodeCount = command_line::get_arg(vm, argNodes);
+  if (nodeCount < 2) {
+    std::cout << "Simulation needs at least two nodes" << std::endl;
+    return 1;
+  }
+
+  Logging::ConsoleLogger logger(Logging::ERROR);
+  Currency currency = CurrencyBuilder(logger).testnet(true).currency();
+  System::Dispatcher dispatcher;
+  Tests::TestNetwork network(dispatcher, currency);
+  Tests::LinkShaper shaper;
+  std::vector<std::unique_ptr<INode>> nodes;
+  std::vector<std::unique_ptr<ArrivalObserver>> observers;
+  ArrivalTracker tracker(nodeCount);
+
+  int result = 1;
+  try {
+    uint16_t p2pBasePort = command_line::get_arg(vm, argP2pBasePort);
+    uint16_t linkBasePort = command_line::get_arg(vm, argLinkBasePort);
+    auto configs = Tests::TestNetworkBuilder(nodeCount, Tests::Topology::Line, 0, p2pBasePort).setDataDirectory(command_line::get_arg(vm, argDataDir)).build();
+    for (auto& config : configs) {
+      config.nodeType = Tests::NodeType::InProcess;
+      config.exclusiveNodes.clear();
+    }
+
+    // nodes connect to listening ports of links instead of each other
+    Tests::LinkShape shape = { std::chrono::milliseconds(command_line::get_arg(vm, argLatency)), command_line::get_arg(vm, argBandwidth) };
+    auto links = makeLinks(command_line::get_arg(vm, argTopology), nodeCount, command_line::get_arg(vm, argDegree), command_line::get_arg(vm, argSeed));
+    for (size_t i = 0; i < links.size(); ++i) {
+      uint16_t linkPort = static_cast<uint16_t>(linkBasePort + i);
+      shaper.addLink(linkPort, configs[links[i].second].p2pPort, shape);
+      configs[links[i].first].exclusiveNodes.push_back("127.0.0.1:" + std::to_string(linkPort));
+    }
+
+    shaper.start();
+    network.addNodes(configs);
+    network.waitNodesReady();
+
+    for (size_t i = 0; i < nodeCount; ++i) {
+      std::unique_ptr<INode> node;
+      if (!network.getNode(i).makeINode(node)) {
+        throw std::runtime_error("Failed to create INode");
+      }
+
+      observers.emplace_back(new ArrivalObserver(tracker, i));
+      node->addObserver(observers.back().get());
+      nodes.push_back(std::move(node));
+    }
+
+    std::cout << "Connecting " << nodeCount << " nodes with " << links.size() << " links..." << std::endl;
+    Clock::time_point deadline = Clock::now() + ROUND_TIMEOUT;
+    while (std::any_of(nodes.begin(), nodes.end(), [](const std::unique_ptr<INode>& node) { return node->getPeerCount() == 0; })) {
+      if (Clock::now() > deadline) {
+        throw std::runtime_error("Nodes failed to connect");
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    Simulation simulation(currency, network, nodes, tracker);
+    PropagationStats blockStats;
+    PropagationStats transactionStats;
+    size_t blocks = command_line::get_arg(vm, argBlocks);
+    size_t transactions = command_line::get_arg(vm, argTransactions);
+    // blocks mined to unlock coinbase outputs for transactions are measured as well
+    while (blockStats.rounds < blocks || simulation.spendableOutputCount() < transactions) {
+      if (!simulation.propagateBlock(blockStats)) {
+        throw std::runtime_error("Failed to mine block");
+      }
+    }
+
+    for (size_t i = 0; i < transactions; ++i) {
+      if (!simulation.propagateTransaction(transactionStats)) {
+        throw std::runtime_error("Failed to send transaction");
+      }
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Topology " << command_line::get_arg(vm, argTopology) << ", latency " << shape.latency.count() << " ms, bandwidth " <<
+      shape.bandwidth << " bytes/sec" << std::endl;
+    blockStats.print("Blocks");
+    transactionStats.print("Transactions");
+    result = 0;
+  } catch (std::exception& e) {
+    std::cout << "Simulation failed: " << e.what() << std::endl;
+  }
+
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    nodes[i]->removeObserver(observers[i].get());
+    nodes[i]->shutdown();
+  }
+
+  nodes.clear();
+  network.shutdown();
+  shaper.stop();
+  return result;
+}
@@ -0,0 +1,331 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+// Starts a daemon on a freshly mined testnet chain and measures how its RPC server copes with a fixed number of
+// clients sending a weighted mix of requests.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+
+#include <Logging/ConsoleLogger.h>
+#include <System/Dispatcher.h>
+#include <System/Latch.h>
+
+#include "Common/command_line.h"
+#include "Common/StringTools.h"
+#include "cryptonote_core/account.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/Currency.h"
+#include "cryptonote_core/miner.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "rpc/HttpClient.h"
+
+#include "../integration_test_lib/TestNetwork.h"
+
+using namespace CryptoNote;
+
+namespace po = boost::program_options;
+
+namespace {
+
+const command_line::arg_descriptor<std::string> argDaemonPath = { "daemon-path", "Path to bytecoind", "bytecoind" };
+const command_line::arg_descriptor<std::string> argDataDir = { "data-dir", "Directory for daemon data, removed on exit", "rpc_benchmark" };
+const command_line::arg_descriptor<size_t> argBlocks = { "blocks", "Blocks mined before measuring", 100 };
+const command_line::arg_descriptor<size_t> argConcurrency = { "concurrency", "Requests in flight", 8 };
+const command_line::arg_descriptor<size_t> argDuration = { "duration", "Seconds to send requests for", 30 };
+const command_line::arg_descriptor<std::string> argMix = { "mix", "Weights of requests",
+  "getblocks.bin:1,queryblocks.bin:1,getrandom_outs.bin:1,getinfo:4,json_rpc:2" };
+
+typedef std::chrono::steady_clock Clock;
+
+struct RequestKind {
+  std::string name;
+  HttpRequest request;
+  size_t weight;
+  size_t errors;
+  std::vector<Clock::duration> latencies;
+};
+
+bool mineBlocks(Tests::TestNode& node, const Currency& currency, size_t count, std::vector<uint64_t>& amounts) {
+  account_base miner;
+  miner.generate();
+  std::string minerAddress = currency.accountAddressAsString(miner);
+  crypto::cn_context context;
+  // timestamps in the past keep difficulty low
+  uint64_t timestamp = time(nullptr) - 365 * 24 * 60 * 60;
+  std::set<uint64_t> seenAmounts;
+
+  for (size_t i = 0; i < count; ++i) {
+    Block block;
+    uint64_t difficulty;
+    if (!node.getBlockTemplate(minerAddress, block, difficulty)) {
+      return false;
+    }
+
+    block.timestamp = timestamp;
+    timestamp += 2 * currency.difficultyTarget();
+
+    if (block.majorVersion == BLOCK_MAJOR_VERSION_2) {
+      block.parentBlock.majorVersion = BLOCK_MAJOR_VERSION_1;
+      block.parentBlock.minorVersion = BLOCK_MINOR_VERSION_0;
+      block.parentBlock.numberOfTransactions = 1;
+
+      tx_extra_merge_mining_tag mmTag;
+      mmTag.depth = 0;
+      if (!get_aux_block_header_hash(block, mmTag.merkle_root)) {
+        return false;
+      }
+
+      block.parentBlock.minerTx.extra.clear();
+      if (!append_mm_tag_to_extra(block.parentBlock.minerTx.extra, mmTag)) {
+        return false;
+      }
+    }
+
+    if (!miner::find_nonce_for_given_block(context, block, difficulty)) {
+      return false;
+    }
+
+    blobdata blob = block_to_blob(block);
+    if (!node.submitBlock(Common::toHex(blob.data(), blob.size()))) {
+      return false;
+    }
+
+    for (const TransactionOutput& out : block.minerTx.vout) {
+      if (seenAmounts.insert(out.amount).second) {
+        amounts.push_back(out.amount);
+      }
+    }
+  }
+
+  return true;
+}
+
+HttpRequest makeRequest(const std::string& url, const std::string& body) {
+  HttpRequest request;
+  request.setUrl(url);
+  request.setBody(body);
+  return request;
+}
+
+bool makeRequestKinds(const std::string& mix, const Currency& currency, const std::vector<uint64_t>& amounts,
+  std::vector<RequestKind>& kinds) {
+  COMMAND_RPC_GET_BLOCKS_FAST::request getBlocks;
+  getBlocks.block_ids.push_back(currency.genesisBlockHash());
+
+  COMMAND_RPC_GET_INFO::request getInfo;
+
+  COMMAND_RPC_QUERY_BLOCKS::request queryBlocks;
+  queryBlocks.block_ids.push_back(currency.genesisBlockHash());
+  queryBlocks.timestamp = 0;
+
+  COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request randomOuts;
+  randomOuts.amounts.assign(amounts.begin(), amounts.begin() + std::min<size_t>(amounts.size(), 5));
+  randomOuts.outs_count = 10;
+
+  std::vector<std::string> items;
+  boost::split(items, mix, boost::is_any_of(","), boost::token_compress_on);
+  for (const std::string& item : items) {
+    std::vector<std::string> parts;
+    boost::split(parts, item, boost::is_any_of(":"));
+    if (parts.size() != 2) {
+      std::cout << "Wrong mix item: " << item << std::endl;
+      return false;
+    }
+
+    RequestKind kind;
+    kind.name = boost::trim_copy(parts[0]);
+    kind.weight = std::stoul(parts[1]);
+    kind.errors = 0;
+    if (kind.name == "getblocks.bin") {
+      kind.request = makeRequest("/getblocks.bin", epee::serialization::store_t_to_binary(getBlocks));
+    } else if (kind.name == "queryblocks.bin") {
+      kind.request = makeRequest("/queryblocks.bin", epee::serialization::store_t_to_binary(queryBlocks));
+    } else if (kind.name == "getrandom_outs.bin") {
+      kind.request = makeRequest("/getrandom_outs.bin", epee::serialization::store_t_to_binary(randomOuts));
+    } else if (kind.name == "getinfo") {
+      kind.request = makeRequest("/getinfo", epee::serialization::store_t_to_json(getInfo));
+    } else if (kind.name == "json_rpc") {
+      kind.request = makeRequest("/json_rpc", "{\"jsonrpc\":\"2.0\",\"id\":\"0\",\"method\":\"getblockcount\",\"params\":{}}");
+    } else {
+      std::cout << "Unknown request: " << kind.name << std::endl;
+      return false;
+    }
+
+    if (kind.weight != 0) {
+      kinds.push_back(std::move(kind));
+    }
+  }
+
+  return !kinds.empty();
+}
+
+// Every client walks the same weighted sequence of requests from own offset
+void runClient(System::Dispatcher& dispatcher, uint16_t port, size_t index, Clock::time_point deadline,
+  const std::vector<size_t>& sequence, std::vector<RequestKind>& kinds) {
+  HttpClient client(dispatcher, "127.0.0.1", port);
+  for (size_t i = index; Clock::now() < deadline; ++i) {
+    RequestKind& kind = kinds[sequence[i % sequence.size()]];
+    HttpResponse response;
+    Clock::time_point start = Clock::now();
+    try {
+      client.request(kind.request, response);
+      if (response.getStatus() != HttpResponse::STATUS_200) {
+        ++kind.errors;
+        continue;
+      }
+    } catch (std::exception&) {
+      ++kind.errors;
+      continue;
+    }
+
+    kind.latencies.push_back(Clock::now() - start);
+  }
+}
+
+double percentileMs(const std::vector<Clock::duration>& sorted, size_t percent) {
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  size_t index = std::min(sorted.size() - 1, sorted.size() * percent / 100);
+  return std::chrono::duration<double, std::milli>(sorted[index]).count();
+}
+
+// Resident and peak resident memory of the process in kB, zeros where /proc isn't available
+void readProcessMemory(size_t pid, uint64_t& residentKb, uint64_t& peakKb) {
+  residentKb = 0;
+  peakKb = 0;
+#ifdef __linux__
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    std::istringstream fields(line);
+    std::string name;
+    uint64_t value = 0;
+    fields >> name >> value;
+    if (name == "VmRSS:") {
+      residentKb = value;
+    } else if (name == "VmHWM:") {
+      peakKb = value;
+    }
+  }
+#endif
+}
+
+}
+
+int main(int argc, char** argv) {
+  po::options_description desc("Allowed options");
+  command_line::add_arg(desc, command_line::arg_help);
+  command_line::add_arg(desc, argDaemonPath);
+  command_line::add_arg(desc, argDataDir);
+  command_line::add_arg(desc, argBlocks);
+  command_line::add_arg(desc, argConcurrency);
+  command_line::add_arg(desc, argDuration);
+  command_line::add_arg(desc, argMix);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc, [&]() {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    return true;
+  });
+
+  if (!r) {
+    return 1;
+  }
+
+  if (command_line::get_arg(vm, command_line::arg_help)) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  Logging::ConsoleLogger logger(Logging::ERROR);
+  Currency currency = CurrencyBuilder(logger).testnet(true).currency();
+  System::Dispatcher dispatcher;
+  Tests::TestNetwork network(dispatcher, currency);
+
+  int result = 1;
+  try {
+    auto configs = Tests::TestNetworkBuilder(1).setDataDirectory(command_line::get_arg(vm, argDataDir)).build();
+    configs.front().daemonPath = command_line::get_arg(vm, argDaemonPath);
+    network.addNodes(configs);
+    network.waitNodesReady();
+
+    std::vector<uint64_t> amounts;
+    std::vector<RequestKind> kinds;
+    size_t blocks = command_line::get_arg(vm, argBlocks);
+    std::cout << "Mining " << blocks << " blocks..." << std::endl;
+    if (!mineBlocks(network.getNode(0), currency, blocks, amounts)) {
+      std::cout << "Failed to mine blocks" << std::endl;
+    } else if (makeRequestKinds(command_line::get_arg(vm, argMix), currency, amounts, kinds)) {
+      std::vector<size_t> sequence;
+      for (size_t i = 0; i < kinds.size(); ++i) {
+        sequence.insert(sequence.end(), kinds[i].weight, i);
+      }
+
+      size_t concurrency = std::max<size_t>(command_line::get_arg(vm, argConcurrency), 1);
+      Clock::time_point start = Clock::now();
+      Clock::time_point deadline = start + std::chrono::seconds(command_line::get_arg(vm, argDuration));
+      System::Latch clients(dispatcher);
+      clients.increase(concurrency);
+      for (size_t i = 0; i < concurrency; ++i) {
+        dispatcher.spawn([&, i]() {
+          runClient(dispatcher, configs.front().rpcPort, i, deadline, sequence, kinds);
+          clients.decrease();
+        });
+      }
+
+      clients.wait();
+      double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+      uint64_t residentKb;
+      uint64_t peakKb;
+      readProcessMemory(network.getDaemonPid(0), residentKb, peakKb);
+
+      size_t total = 0;
+      std::cout << "Concurrency " << concurrency << ", " << std::fixed << std::setprecision(1) << seconds << " sec" << std::endl;
+      std::cout << std::setprecision(2);
+      for (RequestKind& kind : kinds) {
+        std::sort(kind.latencies.begin(), kind.latencies.end());
+        total += kind.latencies.size();
+        std::cout << "  " << std::left << std::setw(20) << kind.name << std::right << kind.latencies.size() / seconds << " req/sec, p50 " <<
+          percentileMs(kind.latencies, 50) << " ms, p99 " << percentileMs(kind.latencies, 99) << " ms, errors " << kind.errors << std::endl;
+      }
+
+      std::cout << "Total: " << total / seconds << " req/sec" << std::endl;
+      std::cout << "Daemon memory: " << residentKb << " kB resident, " << peakKb << " kB peak" << std::endl;
+      result = 0;
+    }
+  } catch (std::exception& e) {
+    std::cout << "Benchmark failed: " << e.what() << std::endl;
+  }
+
+  network.shutdown();
+  return result;
+}
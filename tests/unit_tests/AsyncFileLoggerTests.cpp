@@ -0,0 +1,108 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Logging/AsyncFileLogger.h"
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Logging;
+
+namespace {
+
+const char TEST_LOG_FILE[] = "async_file_logger_test.log";
+
+std::vector<std::string> readLines(const std::string& filename) {
+  std::ifstream file(filename);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(file, line)) {
+    lines.push_back(line);
+  }
+
+  return lines;
+}
+
+void logFromThreads(size_t capacity, size_t threadCount, size_t messageCount) {
+  std::remove(TEST_LOG_FILE);
+
+  {
+    AsyncFileLogger logger(TRACE, capacity);
+    logger.setPattern("");
+    logger.init(TEST_LOG_FILE);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+      threads.emplace_back([&logger, t, messageCount] {
+        for (size_t i = 0; i < messageCount; ++i) {
+          logger("test", INFO, boost::posix_time::ptime(), std::to_string(t) + " " + std::to_string(i) + "\n");
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  std::vector<std::string> lines = readLines(TEST_LOG_FILE);
+  std::remove(TEST_LOG_FILE);
+  ASSERT_EQ(threadCount * messageCount, lines.size());
+
+  // messages of one thread keep their order
+  std::map<size_t, size_t> nextMessage;
+  for (const std::string& line : lines) {
+    size_t space = line.find(' ');
+    ASSERT_NE(std::string::npos, space);
+    size_t thread = std::stoul(line.substr(0, space));
+    size_t message = std::stoul(line.substr(space + 1));
+    ASSERT_EQ(nextMessage[thread], message);
+    ++nextMessage[thread];
+  }
+}
+
+}
+
+TEST(AsyncFileLogger, writesAllMessagesOnDestruction) {
+  logFromThreads(1024, 4, 1000);
+}
+
+TEST(AsyncFileLogger, waitsWhenQueueIsFull) {
+  logFromThreads(4, 4, 1000);
+}
+
+TEST(AsyncFileLogger, dropsMessagesBeforeInit) {
+  std::remove(TEST_LOG_FILE);
+
+  {
+    AsyncFileLogger logger(TRACE);
+    logger.setPattern("");
+    logger("test", INFO, boost::posix_time::ptime(), "dropped\n");
+    logger.init(TEST_LOG_FILE);
+    logger("test", INFO, boost::posix_time::ptime(), "written\n");
+  }
+
+  std::vector<std::string> lines = readLines(TEST_LOG_FILE);
+  std::remove(TEST_LOG_FILE);
+  ASSERT_EQ(1, lines.size());
+  ASSERT_EQ("written", lines[0]);
+}
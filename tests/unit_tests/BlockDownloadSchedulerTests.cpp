@@ -0,0 +1,182 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_protocol/BlockDownloadScheduler.h"
+
+using namespace CryptoNote;
+
+namespace {
+crypto::hash makeId(uint8_t index) {
+  crypto::hash id = boost::value_initialized<crypto::hash>();
+  reinterpret_cast<uint8_t*>(&id)[0] = index;
+  return id;
+}
+
+BlockDownloadScheduler::ConnectionId makeConnection(uint8_t index) {
+  BlockDownloadScheduler::ConnectionId connection = boost::value_initialized<BlockDownloadScheduler::ConnectionId>();
+  connection.data[0] = index;
+  return connection;
+}
+
+block_complete_entry makeBlock(uint8_t index) {
+  block_complete_entry block;
+  block.block = std::string(1, static_cast<char>(index));
+  return block;
+}
+
+class BlockDownloadSchedulerTest : public ::testing::Test {
+public:
+  BlockDownloadSchedulerTest() :
+    scheduler(std::chrono::seconds(10)),
+    now(BlockDownloadScheduler::Clock::now()),
+    first(makeConnection(1)),
+    second(makeConnection(2)) {
+    std::vector<crypto::hash> ids;
+    for (uint8_t i = 0; i < 4; ++i) {
+      ids.push_back(makeId(i));
+    }
+
+    scheduler.addBlockIds(ids, first);
+    scheduler.addBlockIds(ids, second);
+  }
+
+protected:
+  BlockDownloadScheduler scheduler;
+  BlockDownloadScheduler::Clock::time_point now;
+  BlockDownloadScheduler::ConnectionId first;
+  BlockDownloadScheduler::ConnectionId second;
+};
+}
+
+TEST_F(BlockDownloadSchedulerTest, knownIdsAreNotAddedAgain) {
+  std::vector<crypto::hash> ids{ makeId(3), makeId(4) };
+  ASSERT_EQ(1, scheduler.addBlockIds(ids, first));
+  ASSERT_EQ(5, scheduler.size());
+}
+
+TEST_F(BlockDownloadSchedulerTest, blockIsAssignedToOneConnection) {
+  ASSERT_TRUE(scheduler.assign(makeId(0), first, now));
+  ASSERT_FALSE(scheduler.assign(makeId(0), second, now));
+  ASSERT_TRUE(scheduler.assign(makeId(0), first, now));
+  ASSERT_FALSE(scheduler.assign(makeId(10), first, now));
+}
+
+TEST_F(BlockDownloadSchedulerTest, blocksAreReadyInChainOrder) {
+  ASSERT_TRUE(scheduler.addBlock(makeId(1), second, makeBlock(1)));
+  ASSERT_TRUE(scheduler.addBlock(makeId(2), second, makeBlock(2)));
+  ASSERT_TRUE(scheduler.takeReadyBlocks().empty());
+
+  ASSERT_TRUE(scheduler.addBlock(makeId(0), first, makeBlock(0)));
+  auto blocks = scheduler.takeReadyBlocks();
+  ASSERT_EQ(3, blocks.size());
+  for (uint8_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(std::string(1, static_cast<char>(i)), blocks[i].block.block);
+  }
+
+  ASSERT_TRUE(blocks[0].source == first);
+  ASSERT_TRUE(blocks[1].source == second);
+  ASSERT_EQ(1, scheduler.size());
+  ASSERT_FALSE(scheduler.contains(makeId(0)));
+}
+
+TEST_F(BlockDownloadSchedulerTest, stalledBlockIsReassigned) {
+  ASSERT_TRUE(scheduler.assign(makeId(0), first, now));
+  ASSERT_FALSE(scheduler.assign(makeId(0), second, now + std::chrono::seconds(9)));
+  ASSERT_TRUE(scheduler.assign(makeId(0), second, now + std::chrono::seconds(10)));
+  ASSERT_FALSE(scheduler.assign(makeId(0), first, now + std::chrono::seconds(11)));
+}
+
+TEST_F(BlockDownloadSchedulerTest, releasedConnectionBlocksAreReassigned) {
+  ASSERT_TRUE(scheduler.assign(makeId(0), first, now));
+  ASSERT_TRUE(scheduler.assign(makeId(1), second, now));
+  scheduler.releaseConnection(first);
+  ASSERT_TRUE(scheduler.assign(makeId(0), second, now));
+  ASSERT_FALSE(scheduler.assign(makeId(1), first, now));
+}
+
+TEST_F(BlockDownloadSchedulerTest, blocksNobodyCanSendAreDropped) {
+  BlockDownloadScheduler::ConnectionId third = makeConnection(3);
+  std::vector<crypto::hash> ids{ makeId(4), makeId(5), makeId(6) };
+  scheduler.addBlockIds(ids, third);
+  std::vector<crypto::hash> tail{ makeId(6) };
+  scheduler.addBlockIds(tail, first);
+
+  ASSERT_TRUE(scheduler.assign(makeId(4), third, now));
+  ASSERT_TRUE(scheduler.addBlock(makeId(5), third, makeBlock(5)));
+  ASSERT_EQ(0, scheduler.releaseConnection(second));
+  ASSERT_EQ(3, scheduler.releaseConnection(third));
+  ASSERT_FALSE(scheduler.contains(makeId(4)));
+  ASSERT_FALSE(scheduler.contains(makeId(5)));
+  ASSERT_FALSE(scheduler.contains(makeId(6)));
+  ASSERT_TRUE(scheduler.contains(makeId(3)));
+
+  // blocks before the gap are still ready, the gap doesn't hold anything back
+  for (uint8_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(scheduler.addBlock(makeId(i), first, makeBlock(i)));
+  }
+
+  ASSERT_EQ(4, scheduler.takeReadyBlocks().size());
+  ASSERT_EQ(0, scheduler.size());
+
+  // dropped ids are announced again
+  ASSERT_EQ(3, scheduler.addBlockIds(ids, first));
+  ASSERT_TRUE(scheduler.assign(makeId(4), first, now));
+}
+
+TEST_F(BlockDownloadSchedulerTest, receivedBlockIsNotRequestedAgain) {
+  ASSERT_TRUE(scheduler.assign(makeId(0), first, now));
+  ASSERT_TRUE(scheduler.assign(makeId(0), second, now + std::chrono::seconds(10)));
+  ASSERT_TRUE(scheduler.addBlock(makeId(0), second, makeBlock(0)));
+  ASSERT_FALSE(scheduler.addBlock(makeId(0), first, makeBlock(0)));
+  ASSERT_FALSE(scheduler.assign(makeId(0), first, now + std::chrono::seconds(20)));
+
+  scheduler.remove(makeId(1));
+  ASSERT_FALSE(scheduler.addBlock(makeId(1), first, makeBlock(1)));
+  ASSERT_EQ(1, scheduler.takeReadyBlocks().size());
+}
+
+TEST_F(BlockDownloadSchedulerTest, positionsReferToSharedIds) {
+  std::vector<BlockDownloadScheduler::PositionRange> ranges;
+  std::vector<crypto::hash> ids{ makeId(2), makeId(3), makeId(4), makeId(0) };
+  ASSERT_EQ(1, scheduler.addBlockIds(ids, first, ranges));
+  ASSERT_EQ(2, ranges.size());
+  ASSERT_EQ(BlockDownloadScheduler::PositionRange(2, 5), ranges[0]);
+  ASSERT_EQ(BlockDownloadScheduler::PositionRange(0, 1), ranges[1]);
+
+  crypto::hash id;
+  ASSERT_TRUE(scheduler.getAwaitedBlockId(4, first, id));
+  ASSERT_EQ(makeId(4), id);
+
+  ASSERT_TRUE(scheduler.assign(makeId(0), first, now));
+  ASSERT_FALSE(scheduler.getAwaitedBlockId(0, first, id));
+  ASSERT_TRUE(scheduler.getAwaitedBlockId(0, second, id));
+
+  scheduler.remove(makeId(1));
+  ASSERT_FALSE(scheduler.getAwaitedBlockId(1, second, id));
+  ASSERT_TRUE(scheduler.addBlock(makeId(0), first, makeBlock(0)));
+  ASSERT_EQ(1, scheduler.takeReadyBlocks().size());
+  ASSERT_FALSE(scheduler.getAwaitedBlockId(0, second, id));
+  ASSERT_TRUE(scheduler.getAwaitedBlockId(2, second, id));
+  ASSERT_EQ(makeId(2), id);
+
+  scheduler.clear();
+  ASSERT_FALSE(scheduler.getAwaitedBlockId(2, second, id));
+  ranges.clear();
+  scheduler.addBlockIds(ids, first, ranges);
+  ASSERT_EQ(BlockDownloadScheduler::PositionRange(5, 9), ranges[0]);
+}
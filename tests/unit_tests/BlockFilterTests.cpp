@@ -0,0 +1,67 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/BlockFilter.h"
+
+using namespace CryptoNote;
+
+namespace {
+crypto::key_image makeKeyImage(uint32_t value) {
+  crypto::key_image keyImage = crypto::key_image();
+  memcpy(reinterpret_cast<unsigned char*>(&keyImage) + 16, &value, sizeof(value));
+  return keyImage;
+}
+
+std::vector<crypto::key_image> makeKeyImages(uint32_t first, uint32_t count) {
+  std::vector<crypto::key_image> keyImages;
+  for (uint32_t i = 0; i < count; ++i) {
+    keyImages.push_back(makeKeyImage(first + i));
+  }
+
+  return keyImages;
+}
+}
+
+TEST(BlockFilter, emptyFilterContainsNothing) {
+  std::string filter = BlockFilter::build({});
+  ASSERT_TRUE(filter.empty());
+  ASSERT_FALSE(BlockFilter::mayContain(filter, makeKeyImage(1)));
+}
+
+TEST(BlockFilter, builtKeyImagesAreFound) {
+  for (uint32_t count : { 1, 2, 7, 100 }) {
+    std::string filter = BlockFilter::build(makeKeyImages(0, count));
+    ASSERT_EQ(2 * count, filter.size());
+    for (const crypto::key_image& keyImage : makeKeyImages(0, count)) {
+      ASSERT_TRUE(BlockFilter::mayContain(filter, keyImage));
+    }
+  }
+}
+
+TEST(BlockFilter, falsePositivesAreRare) {
+  std::string filter = BlockFilter::build(makeKeyImages(0, 1000));
+  size_t falsePositives = 0;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    if (BlockFilter::mayContain(filter, makeKeyImage(0x80000000 + i))) {
+      ++falsePositives;
+    }
+  }
+
+  ASSERT_LT(falsePositives, 1000);
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/BlockHeaderColumns.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+BlockSummary makeSummary(uint64_t height) {
+  BlockSummary summary = {1000 + height * 10, height * 10, height, height * 100, 1, static_cast<uint8_t>(height % 2)};
+  return summary;
+}
+
+}
+
+TEST(BlockHeaderColumns, pushGetPop) {
+  BlockHeaderColumns headers;
+  for (uint64_t height = 0; height < 5; ++height) {
+    headers.push(makeSummary(height));
+  }
+
+  ASSERT_EQ(5, headers.size());
+  BlockSummary summary = headers.get(3);
+  ASSERT_EQ(1030, summary.timestamp);
+  ASSERT_EQ(30, summary.cumulativeDifficulty);
+  ASSERT_EQ(3, summary.cumulativeSize);
+  ASSERT_EQ(300, summary.generatedCoins);
+  ASSERT_EQ(1, headers.minorVersion(3));
+
+  headers.pop();
+  ASSERT_EQ(4, headers.size());
+  ASSERT_EQ(1030, headers.timestamp(3));
+
+  headers.clear();
+  ASSERT_TRUE(headers.empty());
+}
+
+TEST(BlockHeaderColumns, lowerBoundTimestamp) {
+  BlockHeaderColumns headers;
+  for (uint64_t height = 0; height < 10; ++height) {
+    headers.push(makeSummary(height));
+  }
+
+  ASSERT_EQ(3, headers.lowerBoundTimestamp(0, 1025));
+  ASSERT_EQ(3, headers.lowerBoundTimestamp(0, 1030));
+  ASSERT_EQ(6, headers.lowerBoundTimestamp(6, 1000));
+  ASSERT_EQ(10, headers.lowerBoundTimestamp(0, 2000));
+  ASSERT_EQ(10, headers.lowerBoundTimestamp(12, 0));
+}
+
+TEST(BlockHeaderColumns, lowerBoundTimestampSkipsTimestampsGoingBack) {
+  BlockHeaderColumns headers;
+  const uint64_t timestamps[] = {100, 200, 150, 120, 300, 250};
+  for (uint64_t timestamp : timestamps) {
+    BlockSummary summary = makeSummary(0);
+    summary.timestamp = timestamp;
+    headers.push(summary);
+  }
+
+  ASSERT_EQ(1, headers.lowerBoundTimestamp(0, 150));
+  ASSERT_EQ(4, headers.lowerBoundTimestamp(2, 210));
+  ASSERT_EQ(3, headers.lowerBoundTimestamp(3, 110));
+
+  headers.pop();
+  headers.pop();
+  ASSERT_EQ(4, headers.lowerBoundTimestamp(0, 210));
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/BlockIndex.h"
+
+#include <cstring>
+
+using namespace CryptoNote;
+
+namespace {
+
+// ids differing in the last bytes only share the prefix used for lookups, so they collide
+crypto::hash makeId(uint32_t tail, uint64_t prefix = 0) {
+  crypto::hash id;
+  memset(&id, 0, sizeof id);
+  memcpy(&id, &prefix, sizeof prefix);
+  memcpy(reinterpret_cast<char*>(&id) + sizeof id - sizeof tail, &tail, sizeof tail);
+  return id;
+}
+
+}
+
+TEST(BlockIndex, pushFindPop) {
+  BlockIndex index;
+  for (uint32_t i = 0; i < 5000; ++i) {
+    ASSERT_TRUE(index.push(makeId(i, i * 0x9e3779b97f4a7c15ULL)));
+  }
+
+  ASSERT_FALSE(index.push(makeId(7, 7 * 0x9e3779b97f4a7c15ULL)));
+  ASSERT_EQ(5000, index.size());
+
+  uint64_t height;
+  ASSERT_TRUE(index.getBlockHeight(makeId(4321, 4321 * 0x9e3779b97f4a7c15ULL), height));
+  ASSERT_EQ(4321, height);
+  ASSERT_EQ(makeId(4321, 4321 * 0x9e3779b97f4a7c15ULL), index.getBlockId(4321));
+
+  index.pop();
+  ASSERT_EQ(makeId(4998, 4998 * 0x9e3779b97f4a7c15ULL), index.getTailId());
+  ASSERT_FALSE(index.hasBlock(makeId(4999, 4999 * 0x9e3779b97f4a7c15ULL)));
+  ASSERT_TRUE(index.push(makeId(4999, 4999 * 0x9e3779b97f4a7c15ULL)));
+}
+
+TEST(BlockIndex, popKeepsCollidingIdsReachable) {
+  BlockIndex index;
+  for (uint32_t i = 0; i < 10; ++i) {
+    ASSERT_TRUE(index.push(makeId(i)));
+  }
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    index.pop();
+  }
+
+  for (uint32_t i = 0; i < 6; ++i) {
+    uint64_t height;
+    ASSERT_TRUE(index.getBlockHeight(makeId(i), height));
+    ASSERT_EQ(i, height);
+  }
+
+  ASSERT_FALSE(index.hasBlock(makeId(6)));
+}
+
+TEST(BlockIndex, clear) {
+  BlockIndex index;
+  ASSERT_TRUE(index.push(makeId(1)));
+  index.clear();
+  ASSERT_EQ(0, index.size());
+  ASSERT_FALSE(index.hasBlock(makeId(1)));
+  ASSERT_TRUE(index.push(makeId(1)));
+}
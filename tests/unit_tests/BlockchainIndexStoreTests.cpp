@@ -0,0 +1,239 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/BlockchainIndexStore.h"
+#include "cryptonote_core/MappedIndexStore.h"
+#include "cryptonote_core/PrefixIndexStore.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+using namespace CryptoNote;
+
+namespace {
+
+typedef IBlockchainIndexStore<uint64_t, uint32_t> Store;
+typedef MappedIndexStore<uint64_t, uint32_t> MappedStore;
+
+class MappedIndexStoreTest : public ::testing::Test {
+public:
+  MappedIndexStoreTest() :
+    m_directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()) {
+    boost::filesystem::create_directories(m_directory);
+  }
+
+  ~MappedIndexStoreTest() {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(m_directory, ec);
+  }
+
+  std::string fileName() const {
+    return (m_directory / "index").string();
+  }
+
+private:
+  boost::filesystem::path m_directory;
+};
+
+void checkStore(Store& store) {
+  ASSERT_TRUE(store.insert(1, 10));
+  ASSERT_TRUE(store.insert(2, 20));
+  ASSERT_FALSE(store.insert(1, 11));
+
+  uint32_t value = 0;
+  ASSERT_TRUE(store.find(1, value));
+  ASSERT_EQ(10, value);
+  ASSERT_FALSE(store.find(3, value));
+  ASSERT_TRUE(store.contains(2));
+  ASSERT_EQ(2, store.size());
+
+  ASSERT_TRUE(store.erase(1));
+  ASSERT_FALSE(store.erase(1));
+  ASSERT_FALSE(store.contains(1));
+  ASSERT_EQ(1, store.size());
+
+  store.clear();
+  ASSERT_EQ(0, store.size());
+  ASSERT_FALSE(store.contains(2));
+}
+
+}
+
+TEST(MemoryIndexStore, insertFindErase) {
+  MemoryIndexStore<uint64_t, uint32_t> store;
+  checkStore(store);
+}
+
+TEST_F(MappedIndexStoreTest, insertFindErase) {
+  MappedStore store;
+  ASSERT_TRUE(store.open(fileName()));
+  checkStore(store);
+}
+
+TEST_F(MappedIndexStoreTest, eraseKeepsCollidingKeysReachable) {
+  MappedStore store;
+  ASSERT_TRUE(store.open(fileName()));
+
+  // hash of an integer is the integer itself, keys a capacity apart share the home slot
+  const uint64_t step = MappedStore::INITIAL_CAPACITY;
+  for (uint64_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(store.insert(5 + i * step, static_cast<uint32_t>(i)));
+  }
+
+  ASSERT_TRUE(store.insert(6, 100));
+  ASSERT_TRUE(store.erase(5 + step));
+  ASSERT_TRUE(store.erase(5));
+
+  uint32_t value;
+  ASSERT_TRUE(store.find(5 + 2 * step, value));
+  ASSERT_EQ(2, value);
+  ASSERT_TRUE(store.find(5 + 3 * step, value));
+  ASSERT_EQ(3, value);
+  ASSERT_TRUE(store.find(6, value));
+  ASSERT_EQ(100, value);
+  ASSERT_EQ(3, store.size());
+}
+
+TEST_F(MappedIndexStoreTest, growKeepsItems) {
+  MappedStore store;
+  ASSERT_TRUE(store.open(fileName()));
+
+  const uint64_t count = MappedStore::INITIAL_CAPACITY * 2;
+  for (uint64_t key = 0; key < count; ++key) {
+    ASSERT_TRUE(store.insert(key * 7919, static_cast<uint32_t>(key)));
+  }
+
+  for (uint64_t key = 0; key < count; key += 2) {
+    ASSERT_TRUE(store.erase(key * 7919));
+  }
+
+  ASSERT_EQ(count / 2, store.size());
+
+  std::map<uint64_t, uint32_t> items;
+  store.forEach([&items](const uint64_t& key, const uint32_t& value) {
+    items[key] = value;
+  });
+
+  ASSERT_EQ(count / 2, items.size());
+  for (uint64_t key = 1; key < count; key += 2) {
+    ASSERT_EQ(key, items[key * 7919]);
+  }
+}
+
+TEST_F(MappedIndexStoreTest, reserveThenClear) {
+  MappedStore store;
+  ASSERT_TRUE(store.open(fileName()));
+
+  store.reserve(MappedStore::INITIAL_CAPACITY * 3);
+  ASSERT_TRUE(store.insert(42, 1));
+  store.clear();
+  ASSERT_EQ(0, store.size());
+  ASSERT_TRUE(store.insert(42, 2));
+
+  uint32_t value;
+  ASSERT_TRUE(store.find(42, value));
+  ASSERT_EQ(2, value);
+}
+
+namespace {
+
+// key of an entry is its value, prefix is the first 8 bytes
+typedef std::array<uint8_t, 16> LongKey;
+
+LongKey makeKey(uint64_t prefix, uint64_t suffix) {
+  LongKey key;
+  memcpy(key.data(), &prefix, sizeof prefix);
+  memcpy(key.data() + sizeof prefix, &suffix, sizeof suffix);
+  return key;
+}
+
+class PrefixIndexStoreTest : public ::testing::Test {
+public:
+  PrefixIndexStoreTest() : m_resolves(0), m_store([this](const uint32_t& value, LongKey& key) {
+    ++m_resolves;
+    if (value >= m_keys.size()) {
+      return false;
+    }
+
+    key = m_keys[value];
+    return true;
+  }) {
+  }
+
+  uint32_t add(const LongKey& key) {
+    m_keys.push_back(key);
+    return static_cast<uint32_t>(m_keys.size() - 1);
+  }
+
+protected:
+  std::vector<LongKey> m_keys;
+  size_t m_resolves;
+  PrefixIndexStore<LongKey, uint32_t> m_store;
+};
+
+}
+
+TEST_F(PrefixIndexStoreTest, collidingPrefixesAreResolved) {
+  LongKey first = makeKey(7, 1);
+  LongKey second = makeKey(7, 2);
+  ASSERT_TRUE(m_store.insert(first, add(first)));
+  ASSERT_TRUE(m_store.insert(second, add(second)));
+  ASSERT_FALSE(m_store.insert(second, 5));
+
+  uint32_t value;
+  ASSERT_TRUE(m_store.find(second, value));
+  ASSERT_EQ(1, value);
+  ASSERT_FALSE(m_store.contains(makeKey(7, 3)));
+
+  ASSERT_TRUE(m_store.erase(first));
+  ASSERT_TRUE(m_store.find(second, value));
+  ASSERT_EQ(1, value);
+  ASSERT_EQ(1, m_store.size());
+}
+
+TEST_F(PrefixIndexStoreTest, missDoesNotResolve) {
+  for (uint64_t i = 1; i <= 5000; ++i) {
+    LongKey key = makeKey(i * 0x9e3779b97f4a7c15ULL, i);
+    ASSERT_TRUE(m_store.insert(key, add(key)));
+  }
+
+  m_resolves = 0;
+  ASSERT_FALSE(m_store.contains(makeKey(12345, 0)));
+  ASSERT_EQ(0, m_resolves);
+
+  std::vector<std::pair<uint64_t, uint32_t>> entries;
+  m_store.forEachPrefix([&entries](uint64_t prefix, const uint32_t& value) {
+    entries.push_back(std::make_pair(prefix, value));
+  });
+
+  m_store.clear();
+  m_store.reserve(entries.size());
+  for (const auto& entry : entries) {
+    m_store.insertPrefix(entry.first, entry.second);
+  }
+
+  ASSERT_EQ(5000, m_store.size());
+  uint32_t value;
+  ASSERT_TRUE(m_store.find(m_keys[4321], value));
+  ASSERT_EQ(4321, value);
+}
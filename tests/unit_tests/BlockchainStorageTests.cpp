@@ -0,0 +1,397 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/blockchain_storage.h"
+
+#include <fstream>
+#include <unordered_set>
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_core/account.h"
+#include "cryptonote_core/Currency.h"
+#include "cryptonote_core/verification_context.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+
+namespace {
+class TransactionValidator : public ITransactionValidator {
+  virtual bool checkTransactionInputs(const Transaction& tx, BlockInfo& maxUsedBlock) {
+    return true;
+  }
+
+  virtual bool checkTransactionInputs(const Transaction& tx, BlockInfo& maxUsedBlock, BlockInfo& lastFailed) {
+    return true;
+  }
+
+  virtual bool haveSpentKeyImages(const Transaction& tx) {
+    return false;
+  }
+};
+
+class BlockchainStorageTest : public ::testing::Test {
+public:
+  BlockchainStorageTest() :
+    // difficulty of blocks created within the same second stays at 1, any nonce fits
+    currency(CurrencyBuilder(logger).difficultyTarget(1).difficultyWindow(2).difficultyCut(0).difficultyLag(0).currency()),
+    pool(currency, validator, timeProvider, logger),
+    storage(currency, pool, logger),
+    dataDir((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string()) {
+    account.generate();
+  }
+
+  ~BlockchainStorageTest() {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(dataDir, ec);
+  }
+
+  bool addBlock() {
+    return addBlock(storage);
+  }
+
+  bool addBlock(blockchain_storage& blockchain) {
+    Block block;
+    difficulty_type difficulty;
+    uint32_t height;
+    if (!blockchain.create_block_template(block, account.get_keys().m_account_address, difficulty, height, blobdata())) {
+      return false;
+    }
+
+    blockchain.prepareBlocks(std::vector<Block>{ block });
+    block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    return blockchain.add_new_block(block, bvc) && bvc.m_added_to_main_chain;
+  }
+
+  // every coinbase output of every unlocked block must be returned when all outputs of its amount are requested,
+  // outputs of blocks still in the unlock window must not
+  void checkRandomOutputsCoverCoinbases(blockchain_storage& blockchain) {
+    uint64_t height = blockchain.get_current_blockchain_height();
+    std::list<Block> blocks;
+    ASSERT_TRUE(blockchain.get_blocks(0, static_cast<size_t>(height), blocks));
+    ASSERT_GT(blocks.size(), currency.minedMoneyUnlockWindow());
+
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request request;
+    request.outs_count = 100;
+    for (const Block& block : blocks) {
+      for (const TransactionOutput& output : block.minerTx.vout) {
+        request.amounts.push_back(output.amount);
+      }
+    }
+
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response response;
+    ASSERT_TRUE(blockchain.get_random_outs_for_amounts(request, response));
+    ASSERT_EQ(request.amounts.size(), response.outs.size());
+
+    std::unordered_set<crypto::public_key> keys;
+    for (const auto& outs : response.outs) {
+      for (const auto& entry : outs.outs) {
+        keys.insert(entry.out_key);
+      }
+    }
+
+    size_t blockHeight = 0;
+    for (const Block& block : blocks) {
+      bool unlocked = blockHeight + currency.minedMoneyUnlockWindow() <= height;
+      ++blockHeight;
+      for (const TransactionOutput& output : block.minerTx.vout) {
+        ASSERT_EQ(unlocked ? 1 : 0, keys.count(boost::get<TransactionOutputToKey>(output.target).key));
+      }
+    }
+  }
+
+protected:
+  Logging::LoggerGroup logger;
+  Currency currency;
+  TransactionValidator validator;
+  RealTimeProvider timeProvider;
+  tx_memory_pool pool;
+  blockchain_storage storage;
+  std::string dataDir;
+  account_base account;
+};
+}
+
+TEST_F(BlockchainStorageTest, pushesPreparedBlocksWithOneVerificationThread) {
+  storage.set_verification_threads(1);
+  ASSERT_TRUE(storage.init(dataDir, false));
+
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_TRUE(addBlock());
+  }
+
+  ASSERT_EQ(3, storage.get_current_blockchain_height());
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, pushesPreparedBlocksWithSeveralVerificationThreads) {
+  storage.set_verification_threads(3);
+  ASSERT_TRUE(storage.init(dataDir, false));
+
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_TRUE(addBlock());
+  }
+
+  ASSERT_EQ(3, storage.get_current_blockchain_height());
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, randomOutputsAreServedFromOutputIndexAfterReload) {
+  {
+    blockchain_storage blockchain(currency, pool, logger);
+    ASSERT_TRUE(blockchain.init(dataDir, false));
+    for (size_t i = 0; i < currency.minedMoneyUnlockWindow() + 1; ++i) {
+      ASSERT_TRUE(addBlock(blockchain));
+    }
+
+    checkRandomOutputsCoverCoinbases(blockchain);
+    ASSERT_TRUE(blockchain.deinit());
+  }
+
+  // index is loaded from the stored cache now
+  ASSERT_TRUE(storage.init(dataDir, true));
+  ASSERT_EQ(currency.minedMoneyUnlockWindow() + 2, storage.get_current_blockchain_height());
+  checkRandomOutputsCoverCoinbases(storage);
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, serializedSupplementMatchesBlocks) {
+  storage.set_verification_threads(3);
+  ASSERT_TRUE(storage.init(dataDir, false));
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(addBlock());
+  }
+
+  std::list<crypto::hash> knownIds{ currency.genesisBlockHash() };
+  std::list<std::pair<Block, std::list<Transaction>>> blocks;
+  uint64_t totalHeight;
+  uint64_t startHeight;
+  ASSERT_TRUE(storage.find_blockchain_supplement(knownIds, blocks, totalHeight, startHeight, 3));
+
+  std::list<block_complete_entry> entries;
+  uint64_t entriesTotalHeight;
+  uint64_t entriesStartHeight;
+  ASSERT_TRUE(storage.find_blockchain_supplement(knownIds, entries, entriesTotalHeight, entriesStartHeight, 3));
+
+  ASSERT_EQ(totalHeight, entriesTotalHeight);
+  ASSERT_EQ(startHeight, entriesStartHeight);
+  ASSERT_EQ(3, entries.size());
+  auto entry = entries.begin();
+  for (const auto& block : blocks) {
+    ASSERT_EQ(block_to_blob(block.first), entry->block);
+    ASSERT_EQ(block.second.size(), entry->txs.size());
+    ++entry;
+  }
+
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, shortHeadersMatchBlocks) {
+  ASSERT_TRUE(storage.init(dataDir, false));
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(addBlock());
+  }
+
+  std::list<block_short_header> headers;
+  ASSERT_TRUE(storage.get_block_short_headers(2, 10, headers));
+  ASSERT_EQ(3, headers.size());
+
+  uint64_t height = 2;
+  for (const block_short_header& header : headers) {
+    Block block;
+    ASSERT_TRUE(storage.get_block_by_hash(header.hash, block));
+    ASSERT_EQ(height, header.height);
+    ASSERT_EQ(block.timestamp, header.timestamp);
+    ASSERT_EQ(storage.block_difficulty(height), header.difficulty);
+    ASSERT_EQ(get_outs_money_amount(block.minerTx), header.reward);
+    ASSERT_EQ(block.txHashes.size(), header.tx_count);
+    ++height;
+  }
+
+  headers.clear();
+  ASSERT_FALSE(storage.get_block_short_headers(5, 10, headers));
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, blockFiltersFollowBlocksAfterReload) {
+  {
+    blockchain_storage blockchain(currency, pool, logger);
+    ASSERT_TRUE(blockchain.init(dataDir, false));
+    for (size_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(addBlock(blockchain));
+    }
+
+    ASSERT_TRUE(blockchain.deinit());
+  }
+
+  ASSERT_TRUE(storage.init(dataDir, true));
+  ASSERT_TRUE(addBlock());
+
+  // blocks have coinbase transactions only, nothing is spent
+  std::list<std::string> filters;
+  ASSERT_TRUE(storage.get_block_filters(1, 10, filters));
+  ASSERT_EQ(4, filters.size());
+  for (const std::string& filter : filters) {
+    ASSERT_TRUE(filter.empty());
+  }
+
+  filters.clear();
+  ASSERT_FALSE(storage.get_block_filters(5, 10, filters));
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, emptyDataDirectoryIsFilledFromSnapshot) {
+  std::string snapshotDir = dataDir + "/snapshot";
+  crypto::hash tailId;
+  {
+    blockchain_storage blockchain(currency, pool, logger);
+    ASSERT_TRUE(blockchain.init(dataDir + "/source", false));
+    for (size_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(addBlock(blockchain));
+    }
+
+    ASSERT_TRUE(blockchain.storeSnapshot(snapshotDir));
+    tailId = blockchain.get_tail_id();
+    ASSERT_TRUE(blockchain.deinit());
+  }
+
+  storage.set_snapshot_folder(snapshotDir);
+  ASSERT_TRUE(storage.init(dataDir + "/target", true));
+  ASSERT_EQ(4, storage.get_current_blockchain_height());
+  ASSERT_EQ(tailId, storage.get_tail_id());
+  ASSERT_TRUE(addBlock());
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, damagedSnapshotIsNotLoaded) {
+  std::string snapshotDir = dataDir + "/snapshot";
+  {
+    blockchain_storage blockchain(currency, pool, logger);
+    ASSERT_TRUE(blockchain.init(dataDir + "/source", false));
+    ASSERT_TRUE(addBlock(blockchain));
+    ASSERT_TRUE(blockchain.storeSnapshot(snapshotDir));
+    ASSERT_TRUE(blockchain.deinit());
+  }
+
+  {
+    std::fstream blocksFile(snapshotDir + "/" + currency.blocksFileName(), std::ios::in | std::ios::out | std::ios::binary);
+    char byte;
+    blocksFile.read(&byte, 1);
+    byte ^= 1;
+    blocksFile.seekp(0);
+    blocksFile.write(&byte, 1);
+  }
+
+  storage.set_snapshot_folder(snapshotDir);
+  ASSERT_FALSE(storage.init(dataDir + "/target", true));
+  ASSERT_FALSE(boost::filesystem::exists(dataDir + "/target/" + currency.blocksFileName()));
+}
+
+TEST_F(BlockchainStorageTest, explorerIndexesAreOffByDefault) {
+  ASSERT_TRUE(storage.init(dataDir, false));
+  ASSERT_TRUE(addBlock());
+  ASSERT_FALSE(storage.has_explorer_indexes());
+
+  Block block;
+  ASSERT_TRUE(storage.get_block_by_hash(storage.get_tail_id(), block));
+  blockchain_storage::ExplorerTransaction transaction;
+  ASSERT_FALSE(storage.getTransactionByOutputKey(boost::get<TransactionOutputToKey>(block.minerTx.vout[0].target).key, transaction));
+  ASSERT_TRUE(storage.deinit());
+}
+
+TEST_F(BlockchainStorageTest, explorerIndexesFindOutputKeysAfterReload) {
+  // the chain is stored without explorer indexes, they are built when the cache is loaded with them enabled
+  {
+    blockchain_storage blockchain(currency, pool, logger);
+    ASSERT_TRUE(blockchain.init(dataDir, false));
+    for (size_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(addBlock(blockchain));
+    }
+
+    ASSERT_TRUE(blockchain.deinit());
+  }
+
+  for (size_t reload = 0; reload < 2; ++reload) {
+    blockchain_storage blockchain(currency, pool, logger);
+    blockchain.set_explorer_indexes(true);
+    ASSERT_TRUE(blockchain.init(dataDir, true));
+    ASSERT_TRUE(blockchain.has_explorer_indexes());
+
+    std::list<Block> blocks;
+    ASSERT_TRUE(blockchain.get_blocks(0, 4, blocks));
+    uint32_t height = 0;
+    for (const Block& block : blocks) {
+      for (uint16_t output = 0; output < block.minerTx.vout.size(); ++output) {
+        blockchain_storage::ExplorerTransaction transaction;
+        ASSERT_TRUE(blockchain.getTransactionByOutputKey(boost::get<TransactionOutputToKey>(block.minerTx.vout[output].target).key, transaction));
+        ASSERT_EQ(get_transaction_hash(block.minerTx), transaction.hash);
+        ASSERT_EQ(height, transaction.height);
+        ASSERT_EQ(output, transaction.outputIndex);
+      }
+
+      ++height;
+    }
+
+    std::vector<blockchain_storage::ExplorerTransaction> transactions;
+    ASSERT_FALSE(blockchain.getTransactionsByPaymentId(crypto::hash(), transactions));
+    ASSERT_TRUE(blockchain.deinit());
+  }
+}
+
+TEST_F(BlockchainStorageTest, blockHeadersAreCheckedBeforeBlocks) {
+  std::vector<Block> headers;
+  {
+    blockchain_storage blockchain(currency, pool, logger);
+    ASSERT_TRUE(blockchain.init((boost::filesystem::path(dataDir) / "headers").string(), false));
+    for (size_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(addBlock(blockchain));
+    }
+
+    std::list<Block> blocks;
+    ASSERT_TRUE(blockchain.get_blocks(1, 3, blocks));
+    headers.assign(blocks.begin(), blocks.end());
+    ASSERT_TRUE(blockchain.deinit());
+  }
+
+  storage.set_verification_threads(2);
+  ASSERT_TRUE(storage.init(dataDir, false));
+  bool checked;
+  bool heavier;
+  ASSERT_TRUE(storage.checkBlockHeaders(headers, checked, heavier));
+  ASSERT_TRUE(checked);
+  ASSERT_TRUE(heavier);
+
+  std::vector<Block> reversedHeaders(headers.rbegin(), headers.rend());
+  ASSERT_FALSE(storage.checkBlockHeaders(reversedHeaders, checked, heavier));
+
+  // headers continuing blocks not in the main chain are left to be checked with the blocks
+  std::vector<Block> tailHeaders(headers.begin() + 1, headers.end());
+  ASSERT_TRUE(storage.checkBlockHeaders(tailHeaders, checked, heavier));
+  ASSERT_FALSE(checked);
+
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(addBlock());
+  }
+
+  ASSERT_TRUE(storage.checkBlockHeaders(headers, checked, heavier));
+  ASSERT_TRUE(checked);
+  ASSERT_FALSE(heavier);
+  ASSERT_TRUE(storage.deinit());
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "crypto/crypto.h"
+#include "wallet/ChunkedEncryption.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+std::string encrypt(const std::string& plain, const crypto::chacha8_key& key) {
+  std::stringstream destination;
+  EncryptingStreambuf buffer(destination, key);
+  std::ostream stream(&buffer);
+  stream.write(plain.data(), plain.size());
+  buffer.finish();
+  return destination.str();
+}
+
+std::string decrypt(std::istream& source, const crypto::chacha8_key& key) {
+  DecryptingStreambuf buffer(source, key);
+  std::istream stream(&buffer);
+  std::string plain((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  buffer.finish();
+  return plain;
+}
+
+crypto::chacha8_key makeKey() {
+  crypto::chacha8_key key;
+  crypto::generate_random_bytes(sizeof(key), &key);
+  return key;
+}
+
+}
+
+TEST(ChunkedEncryption, emptySectionRoundTrips) {
+  crypto::chacha8_key key = makeKey();
+  std::istringstream source(encrypt("", key));
+  ASSERT_EQ("", decrypt(source, key));
+  ASSERT_EQ(std::istringstream::traits_type::eof(), source.peek());
+}
+
+TEST(ChunkedEncryption, sectionsLongerThanChunkRoundTrip) {
+  crypto::chacha8_key key = makeKey();
+  std::string plain(EncryptingStreambuf::CHUNK_SIZE * 3 + 123, '\0');
+  for (size_t i = 0; i < plain.size(); ++i) {
+    plain[i] = static_cast<char>(i * 7);
+  }
+
+  std::string cipher = encrypt(plain, key);
+  ASSERT_EQ(std::string::npos, cipher.find(plain.substr(0, 64)));
+
+  std::istringstream source(cipher + "tail");
+  ASSERT_EQ(plain, decrypt(source, key));
+  std::string tail;
+  source >> tail;
+  ASSERT_EQ("tail", tail);
+}
+
+TEST(ChunkedEncryption, finishSkipsUnreadData) {
+  crypto::chacha8_key key = makeKey();
+  std::string plain(EncryptingStreambuf::CHUNK_SIZE * 2, 'a');
+  std::istringstream source(encrypt(plain, key) + encrypt("second", key));
+
+  {
+    DecryptingStreambuf buffer(source, key);
+    std::istream stream(&buffer);
+    char c;
+    stream.get(c);
+    ASSERT_EQ('a', c);
+    buffer.finish();
+  }
+
+  ASSERT_EQ("second", decrypt(source, key));
+}
+
+TEST(ChunkedEncryption, truncatedSectionThrows) {
+  crypto::chacha8_key key = makeKey();
+  std::string cipher = encrypt(std::string(1000, 'a'), key);
+  std::istringstream source(cipher.substr(0, cipher.size() / 2));
+  DecryptingStreambuf buffer(source, key);
+  ASSERT_ANY_THROW(buffer.finish());
+}
@@ -0,0 +1,495 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+
+#include <System/Dispatcher.h>
+
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/Currency.h"
+#include "cryptonote_core/verification_context.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "Logging/ConsoleLogger.h"
+#include "p2p/LevinProtocol.h"
+
+#include "ICoreStub.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+net_connection_id makeConnection(uint8_t index) {
+  net_connection_id connection = boost::value_initialized<net_connection_id>();
+  connection.data[0] = index;
+  return connection;
+}
+
+cryptonote_connection_context makeContext(uint8_t index) {
+  cryptonote_connection_context context;
+  context.m_connection_id = makeConnection(index);
+  context.m_state = cryptonote_connection_context::state_normal;
+  context.m_version = P2P_CURRENT_VERSION;
+  return context;
+}
+
+class P2pEndpointStub : public p2p_endpoint_stub {
+public:
+  struct Notification {
+    int command;
+    std::string data;
+    net_connection_id connection;
+  };
+
+  virtual void relay_notify_to_list(int command, const std::string& data_buff, const std::list<net_connection_id>& connections) override {
+    for (const net_connection_id& connection : connections) {
+      notifications.push_back(Notification{ command, data_buff, connection });
+    }
+  }
+
+  virtual bool invoke_notify_to_peer(int command, const std::string& req_buff, const cryptonote_connection_context& context) override {
+    notifications.push_back(Notification{ command, req_buff, context.m_connection_id });
+    return true;
+  }
+
+  virtual void for_each_connection(std::function<void(cryptonote_connection_context&, peerid_type)> f) override {
+    for (cryptonote_connection_context* context : connections) {
+      f(*context, 1);
+    }
+  }
+
+  template <typename Command>
+  std::vector<typename Command::request> sent(const cryptonote_connection_context& context) const {
+    std::vector<typename Command::request> requests;
+    for (const Notification& notification : notifications) {
+      if (notification.command == Command::ID && notification.connection == context.m_connection_id) {
+        requests.emplace_back();
+        EXPECT_TRUE(LevinProtocol::decode(notification.data, requests.back()));
+      }
+    }
+
+    return requests;
+  }
+
+  std::vector<Notification> notifications;
+  std::vector<cryptonote_connection_context*> connections;
+};
+
+Transaction makeTransaction(uint64_t unlockTime) {
+  Transaction tx;
+  tx.version = CURRENT_TRANSACTION_VERSION;
+  tx.unlockTime = unlockTime;
+  return tx;
+}
+
+class CoreStub : public ICoreStub {
+public:
+  virtual bool have_block(const crypto::hash& id) override {
+    return blocks.count(id) != 0;
+  }
+
+  virtual bool handle_incoming_tx(Common::StringView tx_blob, tx_verification_context& tvc, bool keeped_by_block) override {
+    Transaction tx;
+    if (!parse_and_validate_tx_from_blob(tx_blob, tx)) {
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
+    addPoolTransaction(tx);
+    return true;
+  }
+
+  virtual bool handle_incoming_block_blob(Common::StringView block_blob, block_verification_context& bvc, bool control_miner, bool relay_block) override {
+    addedBlocks.emplace_back(block_blob.getData(), block_blob.getSize());
+    bvc.m_added_to_main_chain = true;
+    return true;
+  }
+
+  virtual bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) override {
+    for (const crypto::hash& id : arg.txs) {
+      auto it = blockchain.find(id);
+      if (it == blockchain.end()) {
+        rsp.missed_ids.push_back(id);
+      } else {
+        rsp.txs.push_back(tx_to_blob(it->second));
+      }
+    }
+
+    return true;
+  }
+
+  virtual bool havePoolTransaction(const crypto::hash& id) override {
+    return pool.count(id) != 0;
+  }
+
+  virtual void getPoolTransactions(const std::list<crypto::hash>& ids, std::list<Transaction>& txs, std::list<crypto::hash>& missedIds) override {
+    for (const crypto::hash& id : ids) {
+      auto it = pool.find(id);
+      if (it == pool.end()) {
+        missedIds.push_back(id);
+      } else {
+        txs.push_back(it->second);
+      }
+    }
+  }
+
+  void addPoolTransaction(const Transaction& tx) {
+    pool[get_transaction_hash(tx)] = tx;
+  }
+
+  void addBlockchainTransaction(const Transaction& tx) {
+    blockchain[get_transaction_hash(tx)] = tx;
+  }
+
+  std::unordered_map<crypto::hash, Transaction> pool;
+  std::unordered_map<crypto::hash, Transaction> blockchain;
+  std::unordered_set<crypto::hash> blocks;
+  std::vector<blobdata> addedBlocks;
+};
+
+class CryptoNoteProtocolHandlerTest : public ::testing::Test {
+public:
+  CryptoNoteProtocolHandlerTest() :
+    currency(CurrencyBuilder(logger).currency()),
+    handler(currency, dispatcher, core, &p2p, logger),
+    first(makeContext(1)),
+    second(makeContext(2)),
+    third(makeContext(3)) {
+    p2p.connections = { &first, &second, &third };
+  }
+
+protected:
+  template <typename Command>
+  void notify(typename Command::request request, cryptonote_connection_context& context) {
+    std::string out;
+    bool handled = false;
+    handler.handleCommand(true, Command::ID, LevinProtocol::encode(request), out, context, handled);
+    ASSERT_TRUE(handled);
+  }
+
+  void announce(const crypto::hash& txHash, cryptonote_connection_context& context) {
+    NOTIFY_TX_ANNOUNCE::request announcement;
+    announcement.txs.push_back(txHash);
+    notify<NOTIFY_TX_ANNOUNCE>(announcement, context);
+  }
+
+  Block makeBlock(const crypto::hash& prevId, const std::vector<Transaction>& txs) {
+    Block b;
+    b.majorVersion = BLOCK_MAJOR_VERSION_1;
+    b.minorVersion = 0;
+    b.timestamp = 0;
+    b.prevId = prevId;
+    b.nonce = 0;
+    b.minerTx = makeTransaction(0);
+    for (const Transaction& tx : txs) {
+      b.txHashes.push_back(get_transaction_hash(tx));
+    }
+
+    return b;
+  }
+
+  NOTIFY_NEW_COMPACT_BLOCK::request makeCompactBlock(const std::vector<Transaction>& txs) {
+    Block b = makeBlock(boost::value_initialized<crypto::hash>(), txs);
+    NOTIFY_NEW_COMPACT_BLOCK::request block;
+    block.block = block_to_blob(b);
+    block.current_blockchain_height = 1;
+    block.hop = 0;
+    return block;
+  }
+
+  // chain entry of a known block followed by the given ones, headers of unknown blocks are requested first
+  void sendChainEntry(const std::vector<Block>& blocks, cryptonote_connection_context& context) {
+    crypto::hash knownId = get_blob_hash("known");
+    core.blocks.insert(knownId);
+    context.m_state = cryptonote_connection_context::state_synchronizing;
+
+    NOTIFY_RESPONSE_CHAIN_ENTRY::request entry;
+    entry.start_height = 0;
+    entry.total_height = blocks.size() + 1;
+    entry.m_block_ids.push_back(knownId);
+    for (const Block& b : blocks) {
+      entry.m_block_ids.push_back(get_block_hash(b));
+    }
+
+    notify<NOTIFY_RESPONSE_CHAIN_ENTRY>(entry, context);
+  }
+
+  std::list<crypto::hash> requestedBlocks(const cryptonote_connection_context& context) {
+    std::list<crypto::hash> ids;
+    for (const NOTIFY_REQUEST_GET_OBJECTS::request& request : p2p.sent<NOTIFY_REQUEST_GET_OBJECTS>(context)) {
+      ids.insert(ids.end(), request.blocks.begin(), request.blocks.end());
+    }
+
+    return ids;
+  }
+
+  size_t requestedTransactions(const cryptonote_connection_context& context) {
+    size_t count = 0;
+    for (const NOTIFY_REQUEST_TXS::request& request : p2p.sent<NOTIFY_REQUEST_TXS>(context)) {
+      count += request.txs.size();
+    }
+
+    return count;
+  }
+
+  Logging::ConsoleLogger logger;
+  System::Dispatcher dispatcher;
+  Currency currency;
+  CoreStub core;
+  P2pEndpointStub p2p;
+  cryptonote_protocol_handler handler;
+  cryptonote_connection_context first;
+  cryptonote_connection_context second;
+  cryptonote_connection_context third;
+};
+
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, announcedTransactionIsRequestedFromFirstAnnouncer) {
+  crypto::hash txHash = get_blob_hash("tx");
+  announce(txHash, first);
+  announce(txHash, second);
+  announce(txHash, first);
+
+  ASSERT_EQ(1, requestedTransactions(first));
+  ASSERT_EQ(0, requestedTransactions(second));
+  ASSERT_EQ(txHash, p2p.sent<NOTIFY_REQUEST_TXS>(first)[0].txs.front());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, poolTransactionIsNotRequested) {
+  Transaction tx = makeTransaction(1);
+  core.addPoolTransaction(tx);
+  announce(get_transaction_hash(tx), first);
+
+  ASSERT_EQ(0, requestedTransactions(first));
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, announcedTransactionIsRequestedFromNextAnnouncerOnTimeout) {
+  crypto::hash txHash = get_blob_hash("tx");
+  handler.set_tx_request_timeout(std::chrono::seconds(0));
+  announce(txHash, first);
+  announce(txHash, second);
+  announce(txHash, third);
+
+  handler.on_idle();
+  ASSERT_EQ(1, requestedTransactions(second));
+  ASSERT_EQ(0, requestedTransactions(third));
+
+  handler.on_idle();
+  ASSERT_EQ(1, requestedTransactions(third));
+
+  // nobody else announced it, so it is forgotten and requested from whoever announces it next
+  handler.on_idle();
+  ASSERT_EQ(1, requestedTransactions(first));
+  announce(txHash, first);
+  ASSERT_EQ(2, requestedTransactions(first));
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, announcedTransactionIsNotRequestedAgainBeforeTimeout) {
+  crypto::hash txHash = get_blob_hash("tx");
+  announce(txHash, first);
+  announce(txHash, second);
+
+  handler.on_idle();
+  ASSERT_EQ(0, requestedTransactions(second));
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, receivedTransactionIsNotRequestedFromOtherAnnouncers) {
+  blobdata txBlob = "tx";
+  handler.set_tx_request_timeout(std::chrono::seconds(0));
+  announce(get_blob_hash(txBlob), first);
+  announce(get_blob_hash(txBlob), second);
+
+  NOTIFY_NEW_TRANSACTIONS::request transactions;
+  transactions.txs.push_back(txBlob);
+  notify<NOTIFY_NEW_TRANSACTIONS>(transactions, first);
+
+  handler.on_idle();
+  ASSERT_EQ(0, requestedTransactions(second));
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, transactionOfClosedConnectionIsRequestedFromNextAnnouncer) {
+  crypto::hash txHash = get_blob_hash("tx");
+  announce(txHash, first);
+  announce(txHash, second);
+  announce(txHash, third);
+
+  handler.onConnectionClosed(second);
+  handler.onConnectionClosed(first);
+
+  handler.on_idle();
+  ASSERT_EQ(0, requestedTransactions(second));
+  ASSERT_EQ(1, requestedTransactions(third));
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, compactBlockIsReconstructedFromPool) {
+  std::vector<Transaction> txs{ makeTransaction(1), makeTransaction(2) };
+  core.addPoolTransaction(txs[0]);
+  core.addPoolTransaction(txs[1]);
+  NOTIFY_NEW_COMPACT_BLOCK::request block = makeCompactBlock(txs);
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(block, first);
+
+  ASSERT_TRUE(p2p.sent<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(first).empty());
+  ASSERT_EQ(1, core.addedBlocks.size());
+  ASSERT_EQ(block.block, core.addedBlocks[0]);
+  ASSERT_EQ(1, p2p.sent<NOTIFY_NEW_COMPACT_BLOCK>(second).size());
+  ASSERT_TRUE(p2p.sent<NOTIFY_NEW_COMPACT_BLOCK>(first).empty());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, compactBlockWaitsForMissingTransactions) {
+  std::vector<Transaction> txs{ makeTransaction(1), makeTransaction(2) };
+  core.addPoolTransaction(txs[0]);
+  NOTIFY_NEW_COMPACT_BLOCK::request block = makeCompactBlock(txs);
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(block, first);
+
+  auto requests = p2p.sent<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(first);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(1, requests[0].txs.size());
+  ASSERT_EQ(get_transaction_hash(txs[1]), requests[0].txs.front());
+  ASSERT_TRUE(core.addedBlocks.empty());
+
+  NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request response;
+  response.block_id = requests[0].block_id;
+  response.txs.push_back(tx_to_blob(txs[1]));
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(response, first);
+
+  ASSERT_EQ(1, core.addedBlocks.size());
+  ASSERT_EQ(block.block, core.addedBlocks[0]);
+  ASSERT_TRUE(core.havePoolTransaction(get_transaction_hash(txs[1])));
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, blockTransactionsFromOtherConnectionAreIgnored) {
+  std::vector<Transaction> txs{ makeTransaction(1) };
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(makeCompactBlock(txs), first);
+  auto requests = p2p.sent<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(first);
+  ASSERT_EQ(1, requests.size());
+
+  NOTIFY_RESPONSE_BLOCK_TRANSACTIONS::request response;
+  response.block_id = requests[0].block_id;
+  response.txs.push_back(tx_to_blob(txs[0]));
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(response, second);
+  ASSERT_TRUE(core.addedBlocks.empty());
+
+  // the block waits for the requested connection until it is closed
+  handler.onConnectionClosed(first);
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(response, first);
+  ASSERT_TRUE(core.addedBlocks.empty());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, blockTransactionsAreServedFromBlockchainAndPool) {
+  Transaction chainTx = makeTransaction(1);
+  Transaction poolTx = makeTransaction(2);
+  core.addBlockchainTransaction(chainTx);
+  core.addPoolTransaction(poolTx);
+
+  NOTIFY_REQUEST_BLOCK_TRANSACTIONS::request request;
+  request.block_id = get_blob_hash("block");
+  request.txs = { get_transaction_hash(chainTx), get_transaction_hash(poolTx), get_blob_hash("unknown") };
+  notify<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(request, first);
+
+  auto responses = p2p.sent<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(first);
+  ASSERT_EQ(1, responses.size());
+  ASSERT_EQ(request.block_id, responses[0].block_id);
+  ASSERT_EQ((std::list<blobdata>{ tx_to_blob(chainTx), tx_to_blob(poolTx) }), responses[0].txs);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, peerStillReconstructingBlockServesItsTransactions) {
+  std::vector<Transaction> txs{ makeTransaction(1), makeTransaction(2) };
+  core.addPoolTransaction(txs[0]);
+
+  // the peer relaying the block has both transactions in its pool, the block isn't added there yet
+  CoreStub peerCore;
+  peerCore.addPoolTransaction(txs[0]);
+  peerCore.addPoolTransaction(txs[1]);
+  P2pEndpointStub peerP2p;
+  cryptonote_protocol_handler peer(currency, dispatcher, peerCore, &peerP2p, logger);
+  cryptonote_connection_context peerContext = makeContext(4);
+
+  NOTIFY_NEW_COMPACT_BLOCK::request block = makeCompactBlock(txs);
+  notify<NOTIFY_NEW_COMPACT_BLOCK>(block, first);
+  auto requests = p2p.sent<NOTIFY_REQUEST_BLOCK_TRANSACTIONS>(first);
+  ASSERT_EQ(1, requests.size());
+
+  std::string out;
+  bool handled = false;
+  peer.handleCommand(true, NOTIFY_REQUEST_BLOCK_TRANSACTIONS::ID, LevinProtocol::encode(requests[0]), out, peerContext, handled);
+  auto responses = peerP2p.sent<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(peerContext);
+  ASSERT_EQ(1, responses.size());
+  ASSERT_EQ(std::list<blobdata>{ tx_to_blob(txs[1]) }, responses[0].txs);
+
+  notify<NOTIFY_RESPONSE_BLOCK_TRANSACTIONS>(responses[0], first);
+  ASSERT_EQ(1, core.addedBlocks.size());
+  ASSERT_EQ(block.block, core.addedBlocks[0]);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, headersOfChainEntryAreRequestedBeforeBlocks) {
+  std::vector<Block> blocks{ makeBlock(get_blob_hash("known"), {}) };
+  blocks.push_back(makeBlock(get_block_hash(blocks[0]), {}));
+  sendChainEntry(blocks, first);
+
+  auto requests = p2p.sent<NOTIFY_REQUEST_BLOCK_HEADERS>(first);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ((std::list<crypto::hash>{ get_block_hash(blocks[0]), get_block_hash(blocks[1]) }), requests[0].blocks);
+  ASSERT_TRUE(requestedBlocks(first).empty());
+
+  NOTIFY_RESPONSE_BLOCK_HEADERS::request response;
+  response.blocks = { block_to_blob(blocks[0]), block_to_blob(blocks[1]) };
+  notify<NOTIFY_RESPONSE_BLOCK_HEADERS>(response, first);
+
+  ASSERT_EQ((std::list<crypto::hash>{ get_block_hash(blocks[0]), get_block_hash(blocks[1]) }), requestedBlocks(first));
+  ASSERT_EQ(cryptonote_connection_context::state_synchronizing, first.m_state);
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, blockHeadersRequestIsKeptBeforeTimeout) {
+  std::vector<Block> blocks{ makeBlock(get_blob_hash("known"), {}) };
+  sendChainEntry(blocks, first);
+
+  handler.on_idle();
+  ASSERT_TRUE(requestedBlocks(first).empty());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, blocksAreRequestedWhenBlockHeadersRequestExpires) {
+  std::vector<Block> blocks{ makeBlock(get_blob_hash("known"), {}) };
+  blocks.push_back(makeBlock(get_block_hash(blocks[0]), {}));
+  sendChainEntry(blocks, first);
+  ASSERT_EQ(1, p2p.sent<NOTIFY_REQUEST_BLOCK_HEADERS>(first).size());
+
+  handler.set_block_headers_request_timeout(std::chrono::seconds(0));
+  handler.on_idle();
+  ASSERT_EQ((std::list<crypto::hash>{ get_block_hash(blocks[0]), get_block_hash(blocks[1]) }), requestedBlocks(first));
+
+  // headers sent too late are ignored, the connection keeps downloading blocks
+  NOTIFY_RESPONSE_BLOCK_HEADERS::request response;
+  response.blocks = { block_to_blob(blocks[0]) };
+  notify<NOTIFY_RESPONSE_BLOCK_HEADERS>(response, first);
+  ASSERT_EQ(cryptonote_connection_context::state_synchronizing, first.m_state);
+  ASSERT_EQ(2, requestedBlocks(first).size());
+}
+
+TEST_F(CryptoNoteProtocolHandlerTest, blockHeadersRequestOfClosedConnectionIsDropped) {
+  std::vector<Block> blocks{ makeBlock(get_blob_hash("known"), {}) };
+  sendChainEntry(blocks, first);
+
+  handler.onConnectionClosed(first);
+  p2p.connections = { &second, &third };
+  handler.set_block_headers_request_timeout(std::chrono::seconds(0));
+  handler.on_idle();
+  ASSERT_TRUE(requestedBlocks(first).empty());
+}
@@ -0,0 +1,283 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/Deflate.h"
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+
+using namespace Common;
+
+namespace {
+
+// Minimal DEFLATE decoder, enough to check what the encoder produces
+class Inflater {
+public:
+  Inflater(const std::string& data, size_t offset) : m_data(data), m_position(offset), m_bitBuffer(0), m_bitCount(0) {
+  }
+
+  std::string inflate() {
+    std::string out;
+    bool final;
+    do {
+      final = bits(1) != 0;
+      unsigned type = bits(2);
+      if (type == 0) {
+        storedBlock(out);
+      } else if (type == 1) {
+        std::vector<uint8_t> lengths(288);
+        for (size_t i = 0; i < lengths.size(); ++i) {
+          lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        }
+
+        codedBlock(Code(lengths), Code(std::vector<uint8_t>(30, 5)), out);
+      } else if (type == 2) {
+        dynamicBlock(out);
+      } else {
+        throw std::runtime_error("bad block type");
+      }
+    } while (!final);
+
+    return out;
+  }
+
+  size_t position() const {
+    return m_position;
+  }
+
+private:
+  struct Code {
+    explicit Code(const std::vector<uint8_t>& lengths) : counts(16, 0) {
+      for (uint8_t length : lengths) {
+        ++counts[length];
+      }
+
+      counts[0] = 0;
+      std::vector<uint16_t> offsets(16, 0);
+      for (size_t i = 1; i < 16; ++i) {
+        offsets[i] = offsets[i - 1] + counts[i - 1];
+      }
+
+      symbols.resize(lengths.size());
+      for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+        if (lengths[symbol] != 0) {
+          symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+        }
+      }
+    }
+
+    std::vector<uint16_t> counts;
+    std::vector<uint16_t> symbols;
+  };
+
+  unsigned bits(unsigned count) {
+    while (m_bitCount < count) {
+      if (m_position == m_data.size()) {
+        throw std::runtime_error("unexpected end of data");
+      }
+
+      m_bitBuffer |= static_cast<uint32_t>(static_cast<uint8_t>(m_data[m_position++])) << m_bitCount;
+      m_bitCount += 8;
+    }
+
+    unsigned value = m_bitBuffer & ((1u << count) - 1);
+    m_bitBuffer >>= count;
+    m_bitCount -= count;
+    return value;
+  }
+
+  unsigned decode(const Code& code) {
+    int value = 0;
+    int first = 0;
+    int index = 0;
+    for (size_t length = 1; length < 16; ++length) {
+      value |= bits(1);
+      int count = code.counts[length];
+      if (value - first < count) {
+        return code.symbols[index + value - first];
+      }
+
+      index += count;
+      first = (first + count) << 1;
+      value <<= 1;
+    }
+
+    throw std::runtime_error("bad code");
+  }
+
+  void storedBlock(std::string& out) {
+    m_bitBuffer = 0;
+    m_bitCount = 0;
+    unsigned length = bits(16);
+    if ((bits(16) ^ 0xffff) != length) {
+      throw std::runtime_error("bad stored length");
+    }
+
+    out.append(m_data, m_position, length);
+    m_position += length;
+  }
+
+  void dynamicBlock(std::string& out) {
+    static const uint8_t ORDER[] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    size_t literalCount = bits(5) + 257;
+    size_t distanceCount = bits(5) + 1;
+    size_t codeLengthCount = bits(4) + 4;
+    std::vector<uint8_t> codeLengthLengths(19, 0);
+    for (size_t i = 0; i < codeLengthCount; ++i) {
+      codeLengthLengths[ORDER[i]] = static_cast<uint8_t>(bits(3));
+    }
+
+    Code codeLengthCode(codeLengthLengths);
+    std::vector<uint8_t> lengths;
+    while (lengths.size() < literalCount + distanceCount) {
+      unsigned symbol = decode(codeLengthCode);
+      if (symbol < 16) {
+        lengths.push_back(static_cast<uint8_t>(symbol));
+      } else if (symbol == 16) {
+        lengths.insert(lengths.end(), 3 + bits(2), lengths.back());
+      } else {
+        lengths.insert(lengths.end(), symbol == 17 ? 3 + bits(3) : 11 + bits(7), 0);
+      }
+    }
+
+    codedBlock(Code(std::vector<uint8_t>(lengths.begin(), lengths.begin() + literalCount)),
+      Code(std::vector<uint8_t>(lengths.begin() + literalCount, lengths.end())), out);
+  }
+
+  void codedBlock(const Code& literals, const Code& distances, std::string& out) {
+    static const uint16_t LENGTH_BASE[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const uint8_t LENGTH_EXTRA[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const uint16_t DISTANCE_BASE[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const uint8_t DISTANCE_EXTRA[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    for (;;) {
+      unsigned symbol = decode(literals);
+      if (symbol < 256) {
+        out.push_back(static_cast<char>(symbol));
+      } else if (symbol == 256) {
+        return;
+      } else {
+        size_t length = LENGTH_BASE[symbol - 257] + bits(LENGTH_EXTRA[symbol - 257]);
+        unsigned distanceSymbol = decode(distances);
+        size_t distance = DISTANCE_BASE[distanceSymbol] + bits(DISTANCE_EXTRA[distanceSymbol]);
+        if (distance > out.size()) {
+          throw std::runtime_error("distance is too far back");
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+          out.push_back(out[out.size() - distance]);
+        }
+      }
+    }
+  }
+
+  const std::string& m_data;
+  size_t m_position;
+  uint32_t m_bitBuffer;
+  unsigned m_bitCount;
+};
+
+uint32_t readLittleEndian(const std::string& data, size_t offset) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset + i])) << (8 * i);
+  }
+
+  return value;
+}
+
+std::string compress(DeflateEncoder::Format format, const std::string& data, size_t step) {
+  DeflateEncoder encoder(format);
+  std::string out;
+  for (size_t offset = 0; offset < data.size(); offset += step) {
+    encoder.write(data.data() + offset, std::min(step, data.size() - offset), out);
+  }
+
+  encoder.finish(out);
+  return out;
+}
+
+std::string jsonLikeData(size_t size) {
+  std::mt19937 generator(1);
+  std::string data = "[";
+  while (data.size() < size) {
+    data += "{\"hash\":\"";
+    for (size_t i = 0; i < 64; ++i) {
+      data.push_back("0123456789abcdef"[generator() % 16]);
+    }
+
+    data += "\",\"height\":" + std::to_string(generator() % 1000000) + ",\"status\":\"OK\"},";
+  }
+
+  return data;
+}
+
+std::string randomData(size_t size) {
+  std::mt19937 generator(2);
+  std::string data(size, '\0');
+  for (char& c : data) {
+    c = static_cast<char>(generator());
+  }
+
+  return data;
+}
+
+}
+
+TEST(Deflate, gzipRoundTrip) {
+  std::string data = jsonLikeData(300000);
+  std::string compressed = compress(DeflateEncoder::GZIP, data, data.size());
+  ASSERT_EQ('\x1f', compressed[0]);
+  ASSERT_EQ('\x8b', compressed[1]);
+  ASSERT_LT(compressed.size(), data.size() * 2 / 3);
+
+  Inflater inflater(compressed, 10);
+  ASSERT_EQ(data, inflater.inflate());
+  ASSERT_EQ(compressed.size(), inflater.position() + 8);
+  ASSERT_EQ(data.size(), readLittleEndian(compressed, compressed.size() - 4));
+}
+
+TEST(Deflate, zlibRoundTripBySmallWrites) {
+  std::string data = jsonLikeData(200000);
+  std::string compressed = compress(DeflateEncoder::ZLIB, data, 1000);
+  ASSERT_EQ(0, ((static_cast<uint8_t>(compressed[0]) << 8) | static_cast<uint8_t>(compressed[1])) % 31);
+
+  Inflater inflater(compressed, 2);
+  ASSERT_EQ(data, inflater.inflate());
+  ASSERT_EQ(compressed.size(), inflater.position() + 4);
+}
+
+TEST(Deflate, storesIncompressibleData) {
+  std::string data = randomData(200000);
+  std::string compressed = compress(DeflateEncoder::GZIP, data, 4096);
+  ASSERT_LT(compressed.size(), data.size() + 100);
+  ASSERT_EQ(data, Inflater(compressed, 10).inflate());
+}
+
+TEST(Deflate, compressesEmptyAndShortData) {
+  for (const std::string& data : { std::string(), std::string("a"), std::string("abcabcabcabc") }) {
+    ASSERT_EQ(data, Inflater(compress(DeflateEncoder::GZIP, data, 1), 10).inflate());
+  }
+}
+
+TEST(Deflate, compressesLongRuns) {
+  std::string data(1000000, 'x');
+  std::string compressed = compress(DeflateEncoder::ZLIB, data, 65536);
+  ASSERT_LT(compressed.size(), 5000);
+  ASSERT_EQ(data, Inflater(compressed, 2).inflate());
+}
@@ -0,0 +1,229 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "rpc/HttpClient.h"
+#include "rpc/HttpServer.h"
+
+#include <System/Dispatcher.h>
+#include <System/InterruptedException.h>
+#include <System/Ipv4Address.h>
+#include <System/Latch.h>
+#include <System/TcpConnection.h>
+#include <System/TcpConnector.h>
+#include <System/Timer.h>
+
+#include "Logging/ConsoleLogger.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+const uint16_t TEST_PORT = 28771;
+
+// Answers every request with its url after a delay, counts requests seen by each connection
+class EchoServer : public HttpServer {
+public:
+  EchoServer(System::Dispatcher& dispatcher, Logging::ILogger& logger) : HttpServer(dispatcher, logger), delay(0), closeConnections(false),
+    produceBody(false) {
+  }
+
+  virtual void processRequest(const HttpRequest& request, HttpResponse& response) override {
+    if (delay.count() != 0) {
+      System::Timer(m_dispatcher).sleep(delay);
+    }
+
+    response.setStatus(HttpResponse::STATUS_200);
+    if (closeConnections) {
+      response.addHeader("Connection", "close");
+    }
+
+    if (produceBody) {
+      std::string url = request.getUrl();
+      response.setBodyProducer([url](const HttpResponse::ChunkWriter& writer) {
+        writer(url.substr(0, url.size() / 2));
+        writer(url.substr(url.size() / 2));
+      });
+    } else {
+      response.setBody(request.getUrl());
+    }
+  }
+
+  std::chrono::milliseconds delay;
+  bool closeConnections;
+  bool produceBody;
+};
+
+class HttpClientTest : public ::testing::Test {
+public:
+  HttpClientTest() : logger(Logging::ERROR), server(dispatcher, logger), client(dispatcher, "127.0.0.1", TEST_PORT) {
+  }
+
+  virtual void SetUp() override {
+    server.start("127.0.0.1", TEST_PORT);
+  }
+
+  virtual void TearDown() override {
+    client.stop();
+    server.stop();
+  }
+
+  std::string get(const std::string& url) {
+    HttpRequest request;
+    HttpResponse response;
+    request.setUrl(url);
+    client.request(request, response);
+    return response.getBody();
+  }
+
+protected:
+  System::Dispatcher dispatcher;
+  Logging::ConsoleLogger logger;
+  EchoServer server;
+  HttpClient client;
+};
+
+}
+
+TEST_F(HttpClientTest, reusesConnection) {
+  ASSERT_EQ("/first", get("/first"));
+  ASSERT_EQ("/second", get("/second"));
+}
+
+TEST_F(HttpClientTest, concurrentRequestsGetTheirResponses) {
+  server.delay = std::chrono::milliseconds(10);
+  client.setMaxConnections(2);
+  client.setPipelineDepth(4);
+
+  System::Latch done(dispatcher);
+  size_t matched = 0;
+  for (size_t i = 0; i < 16; ++i) {
+    done.increase();
+    dispatcher.spawn([&, i] {
+      std::string url = "/request" + std::to_string(i);
+      if (get(url) == url) {
+        ++matched;
+      }
+
+      done.decrease();
+    });
+  }
+
+  done.wait();
+  ASSERT_EQ(16, matched);
+}
+
+TEST_F(HttpClientTest, retriesRequestWhenIdleConnectionIsClosed) {
+  // timeout is taken by connections when they are accepted
+  server.setIdleTimeout(std::chrono::milliseconds(20));
+
+  ASSERT_EQ("/first", get("/first"));
+  System::Timer(dispatcher).sleep(std::chrono::milliseconds(100));
+  ASSERT_EQ("/second", get("/second"));
+}
+
+TEST_F(HttpClientTest, opensNewConnectionWhenServerClosesIt) {
+  server.closeConnections = true;
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ("/request", get("/request"));
+  }
+}
+
+TEST_F(HttpClientTest, stopInterruptsWaitingRequests) {
+  server.delay = std::chrono::milliseconds(100);
+  client.setMaxConnections(1);
+
+  System::Latch done(dispatcher);
+  size_t interrupted = 0;
+  for (size_t i = 0; i < 3; ++i) {
+    done.increase();
+    dispatcher.spawn([&] {
+      try {
+        get("/request");
+      } catch (System::InterruptedException&) {
+        ++interrupted;
+      }
+
+      done.decrease();
+    });
+  }
+
+  System::Timer(dispatcher).sleep(std::chrono::milliseconds(20));
+  client.stop();
+  done.wait();
+  ASSERT_EQ(3, interrupted);
+}
+
+#ifndef _WIN32
+TEST_F(HttpClientTest, worksOverUnixSocket) {
+  EchoServer unixServer(dispatcher, logger);
+  unixServer.start("unix:HttpClientTest.sock", 0);
+  HttpClient unixClient(dispatcher, "unix:HttpClientTest.sock", 0);
+
+  HttpRequest request;
+  HttpResponse response;
+  request.setUrl("/unix");
+  unixClient.request(request, response);
+  ASSERT_EQ("/unix", response.getBody());
+
+  unixClient.stop();
+  unixServer.stop();
+}
+#endif
+
+TEST_F(HttpClientTest, producedBodyIsSentChunked) {
+  server.produceBody = true;
+  ASSERT_EQ("/produced", get("/produced"));
+  ASSERT_EQ("/second", get("/second"));
+}
+
+TEST_F(HttpClientTest, producedBodyIsSentWithLengthToHttp10Client) {
+  server.produceBody = true;
+  System::TcpConnection connection = System::TcpConnector(dispatcher).connect(System::Ipv4Address("127.0.0.1"), TEST_PORT);
+  std::string request = "GET /produced HTTP/1.0\r\n\r\n";
+  connection.write(reinterpret_cast<const uint8_t*>(request.data()), request.size());
+
+  // HTTP/1.0 connection is closed after the response
+  std::string response;
+  uint8_t buffer[1024];
+  for (size_t size; (size = connection.read(buffer, sizeof(buffer))) != 0;) {
+    response.append(reinterpret_cast<const char*>(buffer), size);
+  }
+
+  ASSERT_EQ(std::string::npos, response.find("Transfer-Encoding"));
+  ASSERT_NE(std::string::npos, response.find("Content-Length: 9\r\n"));
+  ASSERT_EQ("\r\n\r\n/produced", response.substr(response.size() - 13));
+}
+
+TEST_F(HttpClientTest, compressesLargeResponseWhenAccepted) {
+  std::string url = "/" + std::string(5000, 'a');
+  HttpRequest request;
+  HttpResponse response;
+  request.setUrl(url);
+  request.addHeader("Accept-Encoding", "deflate, gzip;q=0.5");
+  client.request(request, response);
+  ASSERT_EQ("gzip", response.getHeaders().at("Content-Encoding"));
+  ASSERT_LT(response.getBody().size(), 1000);
+
+  HttpRequest plainRequest;
+  HttpResponse plainResponse;
+  plainRequest.setUrl(url);
+  plainRequest.addHeader("Accept-Encoding", "gzip;q=0");
+  client.request(plainRequest, plainResponse);
+  ASSERT_EQ(0, plainResponse.getHeaders().count("Content-Encoding"));
+  ASSERT_EQ(url, plainResponse.getBody());
+}
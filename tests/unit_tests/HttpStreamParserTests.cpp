@@ -0,0 +1,174 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "HTTP/HttpStreamParser.h"
+
+#include <cstring>
+
+#include "HTTP/HttpParserErrorCodes.h"
+
+using namespace CryptoNote;
+
+namespace {
+// feeds data by parts of given size, returns whether the message became complete
+bool feed(HttpStreamParser& parser, const std::string& data, size_t partSize, bool request = true) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    size_t size;
+    uint8_t* buffer = parser.getReadBuffer(size);
+    size = std::min(std::min(size, partSize), data.size() - offset);
+    memcpy(buffer, data.data() + offset, size);
+    parser.commit(size);
+    offset += size;
+  }
+
+  return request ? parser.parseRequest() : parser.parseResponse();
+}
+
+bool parseErrorIs(HttpStreamParser& parser, const std::string& data, error::HttpParserErrorCodes code) {
+  try {
+    feed(parser, data, data.size());
+  } catch (std::system_error& e) {
+    return e.code() == make_error_code(code);
+  }
+
+  return false;
+}
+}
+
+TEST(HttpStreamParserTest, parsesRequestReceivedByteByByte) {
+  HttpStreamParser parser(1024);
+  std::string request = "POST /json_rpc HTTP/1.1\r\nHost: 127.0.0.1\r\ncontent-length:  5 \r\n\r\nhello";
+  size_t offset = 0;
+  for (; offset + 1 < request.size(); ++offset) {
+    ASSERT_FALSE(feed(parser, request.substr(offset, 1), 1));
+  }
+
+  ASSERT_TRUE(feed(parser, request.substr(offset), 1));
+  ASSERT_EQ(Common::StringView("POST"), parser.getMethod());
+  ASSERT_EQ(Common::StringView("/json_rpc"), parser.getUrl());
+  ASSERT_EQ(2, parser.getHeaders().size());
+  ASSERT_EQ(Common::StringView("5"), parser.findHeader("Content-Length"));
+  ASSERT_TRUE(parser.findHeader("Connection").isNil());
+  ASSERT_EQ(Common::StringView("hello"), parser.getBody());
+
+  HttpRequest httpRequest;
+  parser.getRequest(httpRequest);
+  ASSERT_EQ("POST", httpRequest.getMethod());
+  ASSERT_EQ("hello", httpRequest.getBody());
+}
+
+TEST(HttpStreamParserTest, keepsPipelinedRequestAfterConsume) {
+  HttpStreamParser parser(1024);
+  ASSERT_TRUE(feed(parser, "GET /getheight HTTP/1.1\r\n\r\nGET /getinfo HTTP/1.1\r\n\r\n", 1024));
+  ASSERT_EQ(Common::StringView("/getheight"), parser.getUrl());
+  ASSERT_TRUE(parser.getBody().isEmpty());
+
+  parser.consume();
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ(Common::StringView("/getinfo"), parser.getUrl());
+
+  parser.consume();
+  ASSERT_FALSE(parser.parseRequest());
+}
+
+TEST(HttpStreamParserTest, growsBufferForLargeBody) {
+  HttpStreamParser parser(1024 * 1024);
+  std::string body(300 * 1024, 'x');
+  std::string response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  // head is parsed before the buffer is grown for the body
+  ASSERT_FALSE(feed(parser, response.substr(0, 100), 1000, false));
+  ASSERT_TRUE(feed(parser, response.substr(100), 1000, false));
+  ASSERT_EQ(Common::StringView("200 OK"), parser.getStatus());
+  ASSERT_EQ(Common::StringView(body), parser.getBody());
+
+  HttpResponse httpResponse;
+  parser.getResponse(httpResponse);
+  ASSERT_EQ(HttpResponse::STATUS_200, httpResponse.getStatus());
+  ASSERT_EQ(body, httpResponse.getBody());
+}
+
+TEST(HttpStreamParserTest, rejectsMalformedAndOversizedMessages) {
+  HttpStreamParser parser1(1024);
+  ASSERT_TRUE(parseErrorIs(parser1, "POST /json_rpc HTTP/1.1\r\n: value\r\n\r\n", error::HttpParserErrorCodes::EMPTY_HEADER));
+  HttpStreamParser parser2(1024);
+  ASSERT_TRUE(parseErrorIs(parser2, "POST /json_rpc HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+  HttpStreamParser parser3(1024);
+  ASSERT_TRUE(parseErrorIs(parser3, "POST\r\n\r\n", error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+  HttpStreamParser parser4(1024);
+  ASSERT_TRUE(parseErrorIs(parser4, "POST /json_rpc HTTP/1.1\r\nContent-Length: 2000\r\n\r\n", error::HttpParserErrorCodes::MESSAGE_TOO_LARGE));
+  HttpStreamParser parser5(64);
+  ASSERT_TRUE(parseErrorIs(parser5, "POST /json_rpc HTTP/1.1\r\nHost: " + std::string(100, 'a'), error::HttpParserErrorCodes::MESSAGE_TOO_LARGE));
+}
+
+TEST(HttpStreamParserTest, keepAliveDependsOnVersionAndConnectionHeader) {
+  HttpStreamParser parser(1024);
+  ASSERT_TRUE(feed(parser, "GET / HTTP/1.1\r\n\r\n", 1024));
+  ASSERT_TRUE(parser.keepAlive());
+  parser.consume();
+
+  ASSERT_TRUE(feed(parser, "GET / HTTP/1.1\r\nConnection: Close\r\n\r\n", 1024));
+  ASSERT_FALSE(parser.keepAlive());
+  parser.consume();
+
+  ASSERT_TRUE(feed(parser, "GET / HTTP/1.0\r\n\r\n", 1024));
+  ASSERT_FALSE(parser.keepAlive());
+  parser.consume();
+
+  ASSERT_TRUE(feed(parser, "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n", 1024));
+  ASSERT_TRUE(parser.keepAlive());
+}
+
+TEST(HttpStreamParserTest, decodesChunkedBodyReceivedByteByByte) {
+  HttpStreamParser parser(1024);
+  std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5;name=value\r\nhello\r\nA\r\n, chunked!\r\n0\r\n\r\n";
+  size_t offset = 0;
+  for (; offset + 1 < response.size(); ++offset) {
+    ASSERT_FALSE(feed(parser, response.substr(offset, 1), 1, false));
+  }
+
+  ASSERT_TRUE(feed(parser, response.substr(offset), 1, false));
+  ASSERT_EQ(Common::StringView("hello, chunked!"), parser.getBody());
+
+  HttpResponse httpResponse;
+  parser.getResponse(httpResponse);
+  ASSERT_EQ("hello, chunked!", httpResponse.getBody());
+}
+
+TEST(HttpStreamParserTest, keepsMessageAfterChunkedOne) {
+  HttpStreamParser parser(1024);
+  ASSERT_TRUE(feed(parser, "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\nTrailer: x\r\n\r\nGET /b HTTP/1.1\r\n\r\n", 1024));
+  ASSERT_EQ(Common::StringView("abc"), parser.getBody());
+  ASSERT_TRUE(parser.parseRequest());
+
+  parser.consume();
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ(Common::StringView("/b"), parser.getUrl());
+  ASSERT_TRUE(parser.getBody().isEmpty());
+}
+
+TEST(HttpStreamParserTest, rejectsMalformedAndOversizedChunks) {
+  HttpStreamParser parser(1024);
+  ASSERT_TRUE(parseErrorIs(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n", error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+  parser.clear();
+  ASSERT_TRUE(parseErrorIs(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1\r\nab\r\n", error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+  parser.clear();
+  ASSERT_TRUE(parseErrorIs(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n400\r\n", error::HttpParserErrorCodes::MESSAGE_TOO_LARGE));
+  parser.clear();
+  ASSERT_TRUE(parseErrorIs(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+}
@@ -17,6 +17,8 @@
 
 #include "ICoreStub.h"
 
+#include "cryptonote_core/verification_context.h"
+
 bool ICoreStub::addObserver(CryptoNote::ICoreObserver* observer) {
   return true;
 }
@@ -56,10 +58,17 @@ CryptoNote::i_cryptonote_protocol* ICoreStub::get_protocol() {
   return nullptr;
 }
 
-bool ICoreStub::handle_incoming_tx(CryptoNote::blobdata const& tx_blob, CryptoNote::tx_verification_context& tvc, bool keeped_by_block) {
+bool ICoreStub::handle_incoming_tx(Common::StringView tx_blob, CryptoNote::tx_verification_context& tvc, bool keeped_by_block) {
   return true;
 }
 
+void ICoreStub::handle_incoming_txs(const std::vector<Common::StringView>& tx_blobs, std::vector<CryptoNote::tx_verification_context>& tvcs, bool keeped_by_block) {
+  tvcs.resize(tx_blobs.size());
+  for (size_t i = 0; i < tx_blobs.size(); ++i) {
+    handle_incoming_tx(tx_blobs[i], tvcs[i], keeped_by_block);
+  }
+}
+
 void ICoreStub::set_blockchain_top(uint64_t height, const crypto::hash& top_id, bool result) {
   topHeight = height;
   topId = top_id;
@@ -81,12 +90,29 @@ bool ICoreStub::getPoolSymmetricDifference(const std::vector<crypto::hash>& know
   return true;
 }
 
+bool ICoreStub::getPoolChanges(uint64_t known_version, const crypto::hash& known_block_id, bool& isBcActual, bool& isVersionActual, std::vector<CryptoNote::Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version) {
+  return true;
+}
+
 bool ICoreStub::queryBlocks(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
     uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<CryptoNote::BlockFullInfo>& entries) {
   //stub
   return true;
 }
 
+bool ICoreStub::queryBlocksParsed(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
+    uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<CryptoNote::BlockParsedInfo>& entries) {
+  //stub
+  return true;
+}
+
+bool ICoreStub::queryBlocksFiltered(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
+    const std::vector<CryptoNote::TrackingKey>& tracking_keys, const std::vector<crypto::key_image>& key_images,
+    uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<CryptoNote::BlockFullInfo>& entries) {
+  //stub
+  return true;
+}
+
 bool ICoreStub::getBlockByHash(const crypto::hash &h, CryptoNote::Block &blk) {
   //stub
   return true;
@@ -39,10 +39,17 @@ public:
       CryptoNote::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response& res);
   virtual bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs);
   virtual CryptoNote::i_cryptonote_protocol* get_protocol();
-  virtual bool handle_incoming_tx(CryptoNote::blobdata const& tx_blob, CryptoNote::tx_verification_context& tvc, bool keeped_by_block);
+  virtual bool handle_incoming_tx(Common::StringView tx_blob, CryptoNote::tx_verification_context& tvc, bool keeped_by_block);
+  virtual void handle_incoming_txs(const std::vector<Common::StringView>& tx_blobs, std::vector<CryptoNote::tx_verification_context>& tvcs, bool keeped_by_block) override;
   virtual bool getPoolSymmetricDifference(const std::vector<crypto::hash>& known_pool_tx_ids, const crypto::hash& known_block_id, bool& isBcActual, std::vector<CryptoNote::Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids) override;
+  virtual bool getPoolChanges(uint64_t known_version, const crypto::hash& known_block_id, bool& isBcActual, bool& isVersionActual, std::vector<CryptoNote::Transaction>& new_txs, std::vector<crypto::hash>& deleted_tx_ids, uint64_t& version) override;
   virtual bool queryBlocks(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
       uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<CryptoNote::BlockFullInfo>& entries);
+  virtual bool queryBlocksParsed(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
+      uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<CryptoNote::BlockParsedInfo>& entries) override;
+  virtual bool queryBlocksFiltered(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
+      const std::vector<CryptoNote::TrackingKey>& tracking_keys, const std::vector<crypto::key_image>& key_images,
+      uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<CryptoNote::BlockFullInfo>& entries) override;
 
   virtual bool getBlockByHash(const crypto::hash &h, CryptoNote::Block &blk) override;
 
@@ -52,10 +59,14 @@ public:
   virtual bool on_idle() override { return false; }
   virtual void pause_mining() override {}
   virtual void update_block_template_and_resume_mining() override {}
-  virtual bool handle_incoming_block_blob(const CryptoNote::blobdata& block_blob, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) override { return false; }
+  virtual bool handle_incoming_block_blob(Common::StringView block_blob, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) override { return false; }
+  virtual void prepare_incoming_blocks(const std::vector<CryptoNote::Block>& blocks) override {}
+  virtual bool check_block_headers(const std::vector<CryptoNote::Block>& headers, bool& checked, bool& heavier) override { checked = false; heavier = false; return true; }
   virtual bool handle_get_objects(CryptoNote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, CryptoNote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) override { return false; }
   virtual void on_synchronized() override {}
   virtual bool is_ready() override { return true; }
+  virtual bool havePoolTransaction(const crypto::hash& id) override { return false; }
+  virtual void getPoolTransactions(const std::list<crypto::hash>& ids, std::list<CryptoNote::Transaction>& txs, std::list<crypto::hash>& missedIds) override {}
 
   void set_blockchain_top(uint64_t height, const crypto::hash& top_id, bool result);
   void set_outputs_gindexs(const std::vector<uint64_t>& indexs, bool result);
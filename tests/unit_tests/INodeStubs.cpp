@@ -20,6 +20,7 @@
 #include "wallet/WalletErrors.h"
 
 #include <functional>
+#include <future>
 #include <thread>
 #include <iterator>
 #include <cassert>
@@ -53,6 +54,20 @@ bool INodeDummyStub::removeObserver(CryptoNote::INodeObserver* observer) {
   return observerManager.remove(observer);
 }
 
+void INodeDummyStub::getTransactionsOutsGlobalIndices(std::vector<crypto::hash>&& transactionHashes, std::vector<std::vector<uint64_t>>& outsGlobalIndices,
+  const Callback& callback) {
+  std::error_code ec;
+  outsGlobalIndices.resize(transactionHashes.size());
+  for (size_t i = 0; i < transactionHashes.size() && !ec; ++i) {
+    std::promise<std::error_code> prom;
+    std::future<std::error_code> f = prom.get_future();
+    getTransactionOutsGlobalIndices(transactionHashes[i], outsGlobalIndices[i], [&prom](std::error_code e) { prom.set_value(e); });
+    ec = f.get();
+  }
+
+  callback(ec);
+}
+
 void INodeTrivialRefreshStub::getNewBlocks(std::list<crypto::hash>&& knownBlockIds, std::list<CryptoNote::block_complete_entry>& newBlocks, uint64_t& startHeight, const Callback& callback)
 {
   m_asyncCounter.addAsyncContext();
@@ -0,0 +1,134 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "serialization/JsonInputStreamSerializer.h"
+
+#include <sstream>
+
+#include "Common/StringOutputStream.h"
+#include "serialization/JsonOutputStreamSerializer.h"
+#include "serialization/SerializationOverloads.h"
+
+using namespace CryptoNote;
+
+namespace {
+struct TestItem {
+  std::string name;
+  uint64_t amount;
+  bool flag;
+
+  void serialize(ISerializer& s, const std::string& nm) {
+    s.beginObject(nm);
+    s(name, "name");
+    s(amount, "amount");
+    s(flag, "flag");
+    s.endObject();
+  }
+
+  bool operator==(const TestItem& other) const {
+    return name == other.name && amount == other.amount && flag == other.flag;
+  }
+};
+
+struct TestStruct {
+  int64_t i64;
+  uint32_t u32;
+  double real;
+  std::string blob;
+  std::vector<TestItem> items;
+  TestItem item;
+
+  void serialize(ISerializer& s, const std::string& nm) {
+    s.beginObject(nm);
+    s(i64, "i64");
+    s(u32, "u32");
+    s(real, "real");
+    s.binary(blob, "blob");
+    s(items, "items");
+    s(item, "item");
+    s.endObject();
+  }
+};
+
+template <typename T>
+void readJson(const std::string& text, T& value) {
+  std::istringstream stream(text);
+  JsonInputStreamSerializer s(stream);
+  s(value, "");
+}
+}
+
+TEST(JsonInputStreamSerializer, readsWrittenValues) {
+  TestStruct in;
+  in.i64 = -1234567890123LL;
+  in.u32 = 42;
+  in.real = 2.5;
+  in.blob = std::string("\x00\x01\xff", 3);
+  in.items = { { "first", 1, true }, { "second", 0xffffffffffffffffULL, false } };
+  in.item = { "quote \" backslash \\ newline \n", 7, true };
+
+  std::string text;
+  Common::StringOutputStream stream(text);
+  JsonOutputStreamSerializer output(stream);
+  output(in, "");
+
+  TestStruct out;
+  readJson(text, out);
+  ASSERT_EQ(in.i64, out.i64);
+  ASSERT_EQ(in.u32, out.u32);
+  ASSERT_DOUBLE_EQ(in.real, out.real);
+  ASSERT_EQ(in.blob, out.blob);
+  ASSERT_TRUE(in.items == out.items);
+  ASSERT_TRUE(in.item == out.item);
+}
+
+TEST(JsonInputStreamSerializer, skipsUnknownMembers) {
+  TestItem item;
+  readJson(" { \"unknown\" : [ { \"a\" : [ 1, 2.5e3, null ] }, \"x\\\"}\" ], \"flag\": false, \"name\": \"n\", \"amount\": 5 } ", item);
+  ASSERT_EQ("n", item.name);
+  ASSERT_EQ(5, item.amount);
+  ASSERT_FALSE(item.flag);
+}
+
+TEST(JsonInputStreamSerializer, decodesEscapeSequences) {
+  TestItem item;
+  readJson("{\"name\": \"\\\"\\\\\\/\\t\\u0041\\u00e9\\ud83d\\ude00\", \"amount\": 1, \"flag\": true}", item);
+  ASSERT_EQ("\"\\/\tA\xc3\xa9\xf0\x9f\x98\x80", item.name);
+}
+
+TEST(JsonInputStreamSerializer, missingArrayIsEmpty) {
+  std::istringstream stream("{}");
+  JsonInputStreamSerializer s(stream);
+  std::vector<uint32_t> values{ 1 };
+  s.beginObject("");
+  ASSERT_FALSE(s.hasObject("values"));
+  s(values, "values");
+  s.endObject();
+  ASSERT_TRUE(values.empty());
+}
+
+TEST(JsonInputStreamSerializer, rejectsMalformedJson) {
+  TestItem item;
+  ASSERT_THROW(readJson("{\"name\": \"n\", \"amount\": 5, \"flag\": true", item), std::runtime_error);
+  ASSERT_THROW(readJson("{\"name\": \"n\", \"amount\": 05, \"flag\": true}", item), std::runtime_error);
+  ASSERT_THROW(readJson("{\"name\": \"n\", \"amount\": 5.5, \"flag\": true}", item), std::runtime_error);
+  ASSERT_THROW(readJson("{\"name\": \"n\", \"flag\": true}", item), std::runtime_error);
+  ASSERT_THROW(readJson("{\"name\" \"n\"}", item), std::runtime_error);
+  ASSERT_THROW(readJson("[1]", item), std::runtime_error);
+  ASSERT_THROW(readJson(std::string(1000, '[') , item), std::runtime_error);
+}
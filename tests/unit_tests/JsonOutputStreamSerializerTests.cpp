@@ -0,0 +1,76 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "serialization/JsonOutputStreamSerializer.h"
+
+#include "Common/StringOutputStream.h"
+#include "serialization/SerializationOverloads.h"
+
+using namespace CryptoNote;
+
+namespace {
+struct TestStruct {
+  int64_t i64;
+  uint64_t u64;
+  double real;
+  bool flag;
+  std::string text;
+  std::string blob;
+  std::vector<std::vector<uint32_t>> matrix;
+
+  void serialize(ISerializer& s, const std::string& nm) {
+    s.beginObject(nm);
+    s(i64, "i64");
+    s(u64, "u64");
+    s(real, "real");
+    s(flag, "flag");
+    s(text, "text");
+    s.binary(blob, "blob");
+    s(matrix, "matrix");
+    s.endObject();
+  }
+};
+}
+
+TEST(JsonOutputStreamSerializer, writesMembersInSerializationOrder) {
+  TestStruct value;
+  value.i64 = std::numeric_limits<int64_t>::min();
+  value.u64 = 18446744073709551615ULL;
+  value.real = 2.5;
+  value.flag = false;
+  value.text = std::string("q\"b\\n\n\x01", 7);
+  value.blob = std::string("\x00\xab", 2);
+  value.matrix = { { 1, 2 }, {} };
+
+  std::string json;
+  Common::StringOutputStream stream(json);
+  JsonOutputStreamSerializer s(stream);
+  s(value, "");
+
+  ASSERT_EQ("{\"i64\":-9223372036854775808,\"u64\":-1,\"real\":2.5,\"flag\":false,"
+    "\"text\":\"q\\\"b\\\\n\\n\\u0001\",\"blob\":\"00ab\",\"matrix\":[[1,2],[]]}", json);
+}
+
+TEST(JsonOutputStreamSerializer, writesEmptyObject) {
+  std::string json;
+  Common::StringOutputStream stream(json);
+  JsonOutputStreamSerializer s(stream);
+  s.beginObject("");
+  s.endObject();
+  ASSERT_EQ("{}", json);
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/JsonValue.h"
+
+using Common::JsonValue;
+
+TEST(JsonValue, objectMembersAreOrderedByKey) {
+  JsonValue object(JsonValue::OBJECT);
+  object.insert("b", JsonValue::Integer(2));
+  object.insert("c", JsonValue::Integer(3));
+  object.insert("a", JsonValue::Integer(1));
+  // existing member is kept
+  object.insert("b", JsonValue::Integer(20));
+
+  ASSERT_EQ(3, object.size());
+  ASSERT_EQ(2, object("b").getInteger());
+  ASSERT_EQ("{\"a\":1,\"b\":2,\"c\":3}", object.toString());
+
+  ASSERT_EQ(1, object.erase("b"));
+  ASSERT_EQ(0, object.erase("b"));
+  ASSERT_EQ(0, object.count("b"));
+  ASSERT_THROW(object("b"), std::out_of_range);
+  ASSERT_EQ("{\"a\":1,\"c\":3}", object.toString());
+}
+
+TEST(JsonValue, parsedObjectKeepsAllMembers) {
+  JsonValue value = JsonValue::fromString("{\"z\":{\"y\":[1,2],\"x\":\"s\"},\"a\":null,\"m\":1.5}");
+  ASSERT_EQ(3, value.size());
+  ASSERT_TRUE(value("a").isNil());
+  ASSERT_EQ(2, value("z")("y").size());
+  ASSERT_EQ("s", value("z")("x").getString());
+  ASSERT_EQ("{\"a\":null,\"m\":1.5,\"z\":{\"x\":\"s\",\"y\":[1,2]}}", value.toString());
+
+  JsonValue copy = value;
+  value.erase("z");
+  ASSERT_EQ(3, copy.size());
+  ASSERT_EQ("s", copy("z")("x").getString());
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+namespace {
+class KeyDerivationBatchTest : public ::testing::Test {
+public:
+  KeyDerivationBatchTest() {
+    crypto::public_key txPublicKey;
+    crypto::secret_key txSecretKey;
+    crypto::generate_keys(txPublicKey, txSecretKey);
+    crypto::secret_key viewSecretKey;
+    crypto::generate_keys(viewPublicKey, viewSecretKey);
+    crypto::generate_keys(spendPublicKey, spendSecretKey);
+    crypto::generate_key_derivation(txPublicKey, viewSecretKey, derivation);
+  }
+
+  // every key is underived as if it were output i * 3
+  void checkBatch(const std::vector<crypto::public_key>& keys, std::vector<crypto::public_key>& bases) {
+    std::vector<size_t> indexes;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      indexes.push_back(i * 3);
+    }
+
+    bases.resize(keys.size());
+    std::unique_ptr<bool[]> valid(new bool[keys.size()]);
+    crypto::underive_public_keys(derivation, indexes.data(), keys.data(), keys.size(), bases.data(), valid.get());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      crypto::public_key base;
+      ASSERT_EQ(crypto::underive_public_key(derivation, indexes[i], keys[i], base), valid[i]);
+      if (valid[i]) {
+        ASSERT_EQ(base, bases[i]);
+      }
+    }
+  }
+
+protected:
+  crypto::key_derivation derivation;
+  crypto::public_key viewPublicKey;
+  crypto::public_key spendPublicKey;
+  crypto::secret_key spendSecretKey;
+};
+}
+
+TEST_F(KeyDerivationBatchTest, batchMatchesSingleKeys) {
+  std::vector<crypto::public_key> keys;
+  for (size_t i = 0; i < 17; ++i) {
+    crypto::public_key key;
+    ASSERT_TRUE(crypto::derive_public_key(derivation, i * 3, spendPublicKey, key));
+    keys.push_back(key);
+
+    std::vector<crypto::public_key> bases;
+    checkBatch(keys, bases);
+    for (const crypto::public_key& base : bases) {
+      ASSERT_EQ(spendPublicKey, base);
+    }
+  }
+}
+
+TEST_F(KeyDerivationBatchTest, invalidKeysAreSkipped) {
+  std::vector<crypto::public_key> keys;
+  for (size_t i = 0; i < 8; ++i) {
+    crypto::public_key key;
+    if (i % 3 == 1) {
+      // y = 2 has no x on the curve
+      memset(&key, 0, sizeof(key));
+      reinterpret_cast<unsigned char&>(key) = 2;
+      ASSERT_FALSE(crypto::check_key(key));
+    } else {
+      crypto::derive_public_key(derivation, i * 3, viewPublicKey, key);
+    }
+
+    keys.push_back(key);
+  }
+
+  std::vector<crypto::public_key> bases;
+  checkBatch(keys, bases);
+
+  std::vector<crypto::public_key> invalidKeys(3, keys[1]);
+  checkBatch(invalidKeys, bases);
+}
+
+TEST_F(KeyDerivationBatchTest, derivedKeysMatchSingleKeys) {
+  std::vector<size_t> indexes{ 0, 1, 5, 2, 100, 7 };
+  std::vector<crypto::public_key> keys(indexes.size());
+  ASSERT_TRUE(crypto::derive_public_keys(derivation, indexes.data(), indexes.size(), spendPublicKey, keys.data()));
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    crypto::public_key key;
+    ASSERT_TRUE(crypto::derive_public_key(derivation, indexes[i], spendPublicKey, key));
+    ASSERT_EQ(key, keys[i]);
+  }
+
+  crypto::public_key invalidKey;
+  memset(&invalidKey, 0, sizeof(invalidKey));
+  reinterpret_cast<unsigned char&>(invalidKey) = 2;
+  ASSERT_FALSE(crypto::derive_public_keys(derivation, indexes.data(), indexes.size(), invalidKey, keys.data()));
+}
+
+TEST_F(KeyDerivationBatchTest, derivationsMatchSingleDerivations) {
+  crypto::public_key txPublicKey;
+  crypto::secret_key txSecretKey;
+  crypto::generate_keys(txPublicKey, txSecretKey);
+
+  std::vector<crypto::secret_key> viewSecretKeys(9);
+  for (crypto::secret_key& viewSecretKey : viewSecretKeys) {
+    crypto::public_key viewPublicKey;
+    crypto::generate_keys(viewPublicKey, viewSecretKey);
+  }
+
+  std::vector<crypto::key_derivation> derivations(viewSecretKeys.size());
+  ASSERT_TRUE(crypto::generate_key_derivations(txPublicKey, viewSecretKeys.data(), viewSecretKeys.size(), derivations.data()));
+  for (size_t i = 0; i < viewSecretKeys.size(); ++i) {
+    crypto::key_derivation singleDerivation;
+    ASSERT_TRUE(crypto::generate_key_derivation(txPublicKey, viewSecretKeys[i], singleDerivation));
+    ASSERT_EQ(0, memcmp(&singleDerivation, &derivations[i], sizeof(singleDerivation)));
+  }
+
+  crypto::public_key invalidKey;
+  memset(&invalidKey, 0, sizeof(invalidKey));
+  reinterpret_cast<unsigned char&>(invalidKey) = 2;
+  ASSERT_FALSE(crypto::generate_key_derivations(invalidKey, viewSecretKeys.data(), viewSecretKeys.size(), derivations.data()));
+}
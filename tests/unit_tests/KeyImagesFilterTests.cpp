@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/KeyImagesFilter.h"
+
+using namespace CryptoNote;
+
+namespace {
+crypto::key_image makeKeyImage(uint32_t value) {
+  // structured values, the filter must spread them over all blocks anyway
+  crypto::key_image keyImage = crypto::key_image();
+  memcpy(reinterpret_cast<unsigned char*>(&keyImage) + 16, &value, sizeof(value));
+  return keyImage;
+}
+}
+
+TEST(KeyImagesFilter, emptyFilterContainsNothing) {
+  KeyImagesFilter filter;
+  ASSERT_FALSE(filter.mayContain(makeKeyImage(1)));
+  ASSERT_TRUE(filter.full());
+
+  filter.reset(100);
+  ASSERT_FALSE(filter.mayContain(makeKeyImage(1)));
+  ASSERT_FALSE(filter.full());
+}
+
+TEST(KeyImagesFilter, insertedKeyImagesAreFound) {
+  const uint32_t COUNT = 10000;
+  KeyImagesFilter filter;
+  filter.reset(COUNT);
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    filter.insert(makeKeyImage(i));
+  }
+
+  ASSERT_EQ(COUNT, filter.size());
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    ASSERT_TRUE(filter.mayContain(makeKeyImage(i)));
+  }
+}
+
+TEST(KeyImagesFilter, falsePositivesAreRare) {
+  const uint32_t COUNT = 10000;
+  KeyImagesFilter filter;
+  filter.reset(COUNT);
+  for (uint32_t i = 0; !filter.full(); ++i) {
+    filter.insert(makeKeyImage(i));
+  }
+
+  size_t falsePositives = 0;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    if (filter.mayContain(makeKeyImage(0x80000000 + i))) {
+      ++falsePositives;
+    }
+  }
+
+  ASSERT_LT(falsePositives, 1000);
+}
+
+TEST(KeyImagesFilter, clearDropsKeyImages) {
+  KeyImagesFilter filter;
+  filter.reset(10);
+  filter.insert(makeKeyImage(1));
+  filter.clear();
+  ASSERT_FALSE(filter.mayContain(makeKeyImage(1)));
+  ASSERT_EQ(0, filter.size());
+}
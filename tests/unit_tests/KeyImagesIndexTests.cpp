@@ -0,0 +1,123 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/KeyImagesIndex.h"
+
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include "cryptonote_core/cryptonote_serialization.h"
+#include "serialization/BinaryInputStreamSerializer.h"
+#include "serialization/BinaryOutputStreamSerializer.h"
+
+using namespace CryptoNote;
+
+namespace {
+crypto::key_image makeKeyImage(uint32_t value) {
+  crypto::key_image keyImage = crypto::key_image();
+  // low bytes feed the hash, keep few distinct values there to get long probe sequences
+  reinterpret_cast<unsigned char*>(&keyImage)[0] = static_cast<unsigned char>(value % 7);
+  memcpy(reinterpret_cast<unsigned char*>(&keyImage) + 16, &value, sizeof(value));
+  return keyImage;
+}
+
+crypto::hash makeHash(uint32_t value) {
+  crypto::hash hash = crypto::hash();
+  memcpy(&hash, &value, sizeof(value));
+  return hash;
+}
+}
+
+TEST(KeyImagesIndex, insertsAndErasesSingleTransaction) {
+  KeyImagesIndex index;
+  ASSERT_FALSE(index.contains(makeKeyImage(1)));
+  ASSERT_TRUE(index.insert(makeKeyImage(1), makeHash(1)));
+  ASSERT_FALSE(index.insert(makeKeyImage(1), makeHash(1)));
+  ASSERT_TRUE(index.contains(makeKeyImage(1)));
+  ASSERT_EQ(1, index.count(makeKeyImage(1)));
+  ASSERT_FALSE(index.erase(makeKeyImage(1), makeHash(2)));
+  ASSERT_TRUE(index.erase(makeKeyImage(1), makeHash(1)));
+  ASSERT_FALSE(index.contains(makeKeyImage(1)));
+  ASSERT_EQ(0, index.size());
+}
+
+TEST(KeyImagesIndex, keepsSeveralTransactionsPerKeyImage) {
+  KeyImagesIndex index;
+  ASSERT_TRUE(index.insert(makeKeyImage(1), makeHash(1)));
+  ASSERT_TRUE(index.insert(makeKeyImage(1), makeHash(2)));
+  ASSERT_TRUE(index.insert(makeKeyImage(1), makeHash(3)));
+  ASSERT_FALSE(index.insert(makeKeyImage(1), makeHash(2)));
+  ASSERT_EQ(3, index.count(makeKeyImage(1)));
+  ASSERT_EQ(1, index.size());
+
+  ASSERT_TRUE(index.erase(makeKeyImage(1), makeHash(1)));
+  ASSERT_EQ(2, index.count(makeKeyImage(1)));
+  ASSERT_TRUE(index.erase(makeKeyImage(1), makeHash(3)));
+  ASSERT_FALSE(index.erase(makeKeyImage(1), makeHash(3)));
+  ASSERT_EQ(1, index.count(makeKeyImage(1)));
+  ASSERT_TRUE(index.erase(makeKeyImage(1), makeHash(2)));
+  ASSERT_FALSE(index.contains(makeKeyImage(1)));
+}
+
+TEST(KeyImagesIndex, matchesReferenceMapOnRandomOperations) {
+  KeyImagesIndex index;
+  std::map<uint32_t, std::set<uint32_t>> reference;
+  std::mt19937 random(1);
+
+  for (int i = 0; i < 20000; ++i) {
+    uint32_t keyImage = random() % 500;
+    uint32_t transaction = random() % 3;
+    if (random() % 2) {
+      ASSERT_EQ(reference[keyImage].insert(transaction).second, index.insert(makeKeyImage(keyImage), makeHash(transaction)));
+    } else {
+      ASSERT_EQ(reference[keyImage].erase(transaction) != 0, index.erase(makeKeyImage(keyImage), makeHash(transaction)));
+    }
+  }
+
+  size_t distinct = 0;
+  for (auto& entry : reference) {
+    ASSERT_EQ(entry.second.size(), index.count(makeKeyImage(entry.first)));
+    distinct += entry.second.empty() ? 0 : 1;
+  }
+
+  ASSERT_EQ(distinct, index.size());
+}
+
+TEST(KeyImagesIndex, serializationRestoresContents) {
+  KeyImagesIndex index;
+  for (uint32_t i = 0; i < 100; ++i) {
+    index.insert(makeKeyImage(i), makeHash(i));
+  }
+  index.insert(makeKeyImage(5), makeHash(1000));
+
+  std::stringstream stream;
+  CryptoNote::BinaryOutputStreamSerializer output(stream);
+  output(index, "key_images");
+
+  KeyImagesIndex restored;
+  restored.insert(makeKeyImage(1000), makeHash(1000));
+  CryptoNote::BinaryInputStreamSerializer input(stream);
+  input(restored, "key_images");
+
+  ASSERT_EQ(100, restored.size());
+  ASSERT_EQ(2, restored.count(makeKeyImage(5)));
+  ASSERT_EQ(1, restored.count(makeKeyImage(99)));
+  ASSERT_FALSE(restored.contains(makeKeyImage(100)));
+}
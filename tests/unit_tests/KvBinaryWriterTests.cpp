@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "rpc/KvBinaryWriter.h"
+
+#include "storages/portable_storage_template_helper.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+using namespace CryptoNote;
+
+namespace {
+block_complete_entry makeBlock(size_t index, size_t txCount) {
+  block_complete_entry block;
+  block.block = std::string(100 + index, static_cast<char>('a' + index));
+  for (size_t i = 0; i < txCount; ++i) {
+    block.txs.push_back(std::string(10 * (i + 1), static_cast<char>('0' + i)));
+  }
+
+  return block;
+}
+}
+
+TEST(KvBinaryWriterTest, streamedBlocksResponseLoadsAsStoredOne) {
+  std::vector<block_complete_entry> blocks{ makeBlock(0, 0), makeBlock(1, 3), makeBlock(2, 1) };
+
+  std::string buffer;
+  KvBinaryWriter writer(buffer);
+  writer.beginRoot(4);
+  writer.writeUint64("current_height", 100);
+  writer.writeUint64("start_height", 7);
+  writer.writeString("status", CORE_RPC_STATUS_OK);
+  writer.beginObjectArray("blocks", blocks.size());
+  for (const block_complete_entry& block : blocks) {
+    writer.beginSection(block.txs.empty() ? 1 : 2);
+    writer.writeString("block", block.block);
+    if (!block.txs.empty()) {
+      writer.writeStringArray("txs", block.txs);
+    }
+  }
+
+  COMMAND_RPC_GET_BLOCKS_FAST::response response;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(response, buffer));
+  ASSERT_EQ(100, response.current_height);
+  ASSERT_EQ(7, response.start_height);
+  ASSERT_EQ(CORE_RPC_STATUS_OK, response.status);
+  ASSERT_EQ(blocks.size(), response.blocks.size());
+  auto loaded = response.blocks.begin();
+  for (const block_complete_entry& block : blocks) {
+    ASSERT_EQ(block.block, loaded->block);
+    ASSERT_EQ(block.txs, loaded->txs);
+    ++loaded;
+  }
+}
+
+TEST(KvBinaryWriterTest, sectionMatchesPortableStorageEncoding) {
+  COMMAND_RPC_GET_HEIGHT::response response;
+  response.height = 12345;
+  response.status = "OK";
+
+  std::string buffer;
+  KvBinaryWriter writer(buffer);
+  writer.beginRoot(2);
+  writer.writeUint64("height", response.height);
+  writer.writeString("status", response.status);
+  ASSERT_EQ(epee::serialization::store_t_to_binary(response), buffer);
+}
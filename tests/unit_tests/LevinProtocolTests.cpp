@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "p2p/LevinProtocol.h"
+
+#include <System/Dispatcher.h>
+#include <System/Ipv4Address.h>
+#include <System/TcpConnection.h>
+#include <System/TcpConnector.h>
+#include <System/TcpListener.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+const uint16_t TEST_PORT = 28772;
+
+class LevinProtocolTest : public ::testing::Test {
+public:
+  LevinProtocolTest() : listener(dispatcher, System::Ipv4Address("127.0.0.1"), TEST_PORT) {
+    System::TcpConnector connector(dispatcher);
+    client = connector.connect(System::Ipv4Address("127.0.0.1"), TEST_PORT);
+    server = listener.accept();
+  }
+
+  // Sends the frame from client and reads it back on server side
+  LevinProtocol::Command transfer(const LevinProtocol::Frame& frame) {
+    LevinProtocol(client).sendFrames({ frame });
+    LevinProtocol::Command cmd;
+    EXPECT_TRUE(LevinProtocol(server).readCommand(cmd));
+    return cmd;
+  }
+
+protected:
+  System::Dispatcher dispatcher;
+  System::TcpListener listener;
+  System::TcpConnection client;
+  System::TcpConnection server;
+};
+
+std::string repetitivePayload(size_t size) {
+  std::string payload;
+  for (size_t i = 0; payload.size() < size; ++i) {
+    payload += "block " + std::to_string(i % 100) + ";";
+  }
+
+  return payload;
+}
+
+}
+
+TEST_F(LevinProtocolTest, compressesLargeNotification) {
+  std::string payload = repetitivePayload(100000);
+  LevinProtocol::Frame frame = LevinProtocol::makeNotification(1001, payload, true);
+  ASSERT_LT(frame->size(), payload.size());
+
+  LevinProtocol::Command cmd = transfer(frame);
+  ASSERT_EQ(1001, cmd.command);
+  ASSERT_TRUE(cmd.isNotify);
+  ASSERT_EQ(payload, cmd.buf);
+}
+
+TEST_F(LevinProtocolTest, leavesSmallNotificationUncompressed) {
+  std::string payload = repetitivePayload(1000);
+  ASSERT_EQ(*LevinProtocol::makeNotification(1001, payload, false), *LevinProtocol::makeNotification(1001, payload, true));
+  ASSERT_EQ(payload, transfer(LevinProtocol::makeNotification(1001, payload, true)).buf);
+}
+
+TEST_F(LevinProtocolTest, leavesIncompressibleNotificationUncompressed) {
+  std::string payload(100000, '\0');
+  uint32_t state = 1;
+  for (char& c : payload) {
+    state = state * 1103515245 + 12345;
+    c = static_cast<char>(state >> 24);
+  }
+
+  ASSERT_EQ(*LevinProtocol::makeNotification(1001, payload, false), *LevinProtocol::makeNotification(1001, payload, true));
+  ASSERT_EQ(payload, transfer(LevinProtocol::makeNotification(1001, payload, true)).buf);
+}
+
+TEST_F(LevinProtocolTest, rejectsCompressedPayloadOfWrongSize) {
+  std::string frame = *LevinProtocol::makeNotification(1001, repetitivePayload(100000), true);
+  // uncompressed size follows the 33 byte header
+  ++frame[33];
+  LevinProtocol(client).sendFrames({ std::make_shared<const std::string>(frame) });
+
+  LevinProtocol::Command cmd;
+  ASSERT_THROW(LevinProtocol(server).readCommand(cmd), std::runtime_error);
+}
+
+TEST_F(LevinProtocolTest, joinsFragmentedNotification) {
+  std::string payload = repetitivePayload(50000);
+  std::vector<LevinProtocol::Frame> fragments = LevinProtocol::splitFrame(LevinProtocol::makeNotification(1001, payload, true), 256);
+  ASSERT_LT(2, fragments.size());
+  LevinProtocol(client).sendFrames(fragments);
+
+  LevinProtocol::Command cmd;
+  ASSERT_TRUE(LevinProtocol(server).readCommand(cmd));
+  ASSERT_EQ(1001, cmd.command);
+  ASSERT_TRUE(cmd.isNotify);
+  ASSERT_EQ(payload, cmd.buf);
+}
+
+TEST_F(LevinProtocolTest, readsMessagesSentBetweenFragments) {
+  std::string payload = repetitivePayload(50000);
+  std::vector<LevinProtocol::Frame> fragments = LevinProtocol::splitFrame(LevinProtocol::makeNotification(1001, payload), 4096);
+  std::vector<LevinProtocol::Frame> frames(fragments.begin(), fragments.end());
+  frames.insert(frames.begin() + 1, LevinProtocol::makeNotification(1002, "block"));
+  LevinProtocol(client).sendFrames(frames);
+
+  LevinProtocol reader(server);
+  LevinProtocol::Command cmd;
+  ASSERT_TRUE(reader.readCommand(cmd));
+  ASSERT_EQ(1002, cmd.command);
+  ASSERT_EQ("block", cmd.buf);
+
+  ASSERT_TRUE(reader.readCommand(cmd));
+  ASSERT_EQ(1001, cmd.command);
+  ASSERT_EQ(payload, cmd.buf);
+}
+
+TEST_F(LevinProtocolTest, rejectsFragmentWithoutBeginning) {
+  std::vector<LevinProtocol::Frame> fragments = LevinProtocol::splitFrame(LevinProtocol::makeNotification(1001, repetitivePayload(10000)), 4096);
+  LevinProtocol(client).sendFrames({ fragments[1] });
+
+  LevinProtocol::Command cmd;
+  ASSERT_THROW(LevinProtocol(server).readCommand(cmd), std::runtime_error);
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Logging/LoggerGroup.h"
+#include "Logging/LoggerManager.h"
+#include "Logging/LoggerRef.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace Logging;
+
+namespace {
+
+class MemoryLogger : public CommonLogger {
+public:
+  MemoryLogger(Level level) : CommonLogger(level) {
+    setPattern("");
+  }
+
+  std::vector<std::string> messages;
+
+protected:
+  virtual void doLogString(const std::string& message) override {
+    messages.push_back(message);
+  }
+};
+
+// counts how many times it was formatted
+struct Formatted {
+  mutable size_t count = 0;
+};
+
+std::ostream& operator<<(std::ostream& os, const Formatted& formatted) {
+  ++formatted.count;
+  return os << "formatted";
+}
+
+Common::JsonValue buildConfiguration(Level loggerLevel, const std::string& disabledCategory) {
+  Common::JsonValue logger(Common::JsonValue::OBJECT);
+  logger.insert("type", std::string("console"));
+  logger.insert("level", static_cast<int64_t>(loggerLevel));
+  Common::JsonValue& disabledCategories = logger.insert("disabledCategories", Common::JsonValue(Common::JsonValue::ARRAY));
+  if (!disabledCategory.empty()) {
+    disabledCategories.pushBack(disabledCategory);
+  }
+
+  Common::JsonValue configuration(Common::JsonValue::OBJECT);
+  configuration.insert("globalLevel", static_cast<int64_t>(TRACE));
+  Common::JsonValue& loggers = configuration.insert("loggers", Common::JsonValue(Common::JsonValue::ARRAY));
+  loggers.pushBack(logger);
+  return configuration;
+}
+
+}
+
+TEST(LoggerFilter, disabledLevelIsNotFormatted) {
+  MemoryLogger logger(INFO);
+  LoggerRef ref(logger, "level_test");
+  Formatted formatted;
+
+  ref(DEBUGGING) << formatted << std::endl;
+  ref(INFO) << formatted << std::endl;
+
+  ASSERT_EQ(1, formatted.count);
+  ASSERT_EQ(1, logger.messages.size());
+}
+
+TEST(LoggerFilter, disabledCategoryIsNotFormatted) {
+  MemoryLogger logger(TRACE);
+  logger.disableCategory("disabled_test");
+  LoggerRef disabled(logger, "disabled_test");
+  LoggerRef enabled(logger, "enabled_test");
+  Formatted formatted;
+
+  disabled(INFO) << formatted;
+  enabled(INFO) << formatted;
+  ASSERT_EQ(1, formatted.count);
+  ASSERT_EQ(1, logger.messages.size());
+
+  logger.enableCategory("disabled_test");
+  disabled(INFO) << formatted;
+  ASSERT_EQ(2, formatted.count);
+  ASSERT_EQ(2, logger.messages.size());
+}
+
+TEST(LoggerFilter, groupIsEnabledIfAnyLoggerIs) {
+  MemoryLogger infoLogger(INFO);
+  MemoryLogger traceLogger(TRACE);
+  traceLogger.disableCategory("group_test");
+  LoggerGroup group(TRACE);
+  group.addLogger(infoLogger);
+  group.addLogger(traceLogger);
+  size_t category = ILogger::getCategoryId("group_test");
+
+  ASSERT_TRUE(group.isEnabled(category, INFO));
+  ASSERT_FALSE(group.isEnabled(category, DEBUGGING));
+
+  group.setMaxLevel(WARNING);
+  ASSERT_FALSE(group.isEnabled(category, INFO));
+}
+
+TEST(LoggerFilter, managerFoldsLoggerFilters) {
+  LoggerManager manager;
+  manager.configure(buildConfiguration(WARNING, "manager_test"));
+  size_t disabled = ILogger::getCategoryId("manager_test");
+  size_t enabled = ILogger::getCategoryId("manager_test_enabled");
+
+  ASSERT_TRUE(manager.isEnabled(enabled, WARNING));
+  ASSERT_FALSE(manager.isEnabled(enabled, INFO));
+  ASSERT_FALSE(manager.isEnabled(disabled, WARNING));
+
+  manager.configure(buildConfiguration(INFO, ""));
+  ASSERT_TRUE(manager.isEnabled(enabled, INFO));
+  ASSERT_TRUE(manager.isEnabled(disabled, WARNING));
+}
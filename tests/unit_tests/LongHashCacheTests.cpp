@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/LongHashCache.h"
+
+#include <sstream>
+
+#include "cryptonote_core/cryptonote_serialization.h"
+#include "serialization/BinaryInputStreamSerializer.h"
+#include "serialization/BinaryOutputStreamSerializer.h"
+
+using namespace CryptoNote;
+
+namespace {
+crypto::hash makeHash(unsigned char value) {
+  crypto::hash hash = crypto::hash();
+  reinterpret_cast<unsigned char*>(&hash)[0] = value;
+  return hash;
+}
+}
+
+TEST(LongHashCache, returnsStoredHash) {
+  LongHashCache cache(10);
+  cache.put(makeHash(1), makeHash(101));
+  crypto::hash longHash;
+  ASSERT_TRUE(cache.get(makeHash(1), longHash));
+  ASSERT_EQ(makeHash(101), longHash);
+  ASSERT_FALSE(cache.get(makeHash(2), longHash));
+}
+
+TEST(LongHashCache, evictsOldestEntries) {
+  LongHashCache cache(2);
+  cache.put(makeHash(1), makeHash(101));
+  cache.put(makeHash(2), makeHash(102));
+  cache.put(makeHash(3), makeHash(103));
+
+  crypto::hash longHash;
+  ASSERT_EQ(2, cache.size());
+  ASSERT_FALSE(cache.get(makeHash(1), longHash));
+  ASSERT_TRUE(cache.get(makeHash(2), longHash));
+  ASSERT_TRUE(cache.get(makeHash(3), longHash));
+}
+
+TEST(LongHashCache, serializationKeepsEvictionOrder) {
+  LongHashCache cache(3);
+  cache.put(makeHash(1), makeHash(101));
+  cache.put(makeHash(2), makeHash(102));
+  cache.put(makeHash(3), makeHash(103));
+
+  std::stringstream stream;
+  BinaryOutputStreamSerializer output(stream);
+  output(cache, "cache");
+
+  LongHashCache restored(3);
+  BinaryInputStreamSerializer input(stream);
+  input(restored, "cache");
+
+  crypto::hash longHash;
+  ASSERT_EQ(3, restored.size());
+  ASSERT_TRUE(restored.get(makeHash(1), longHash));
+  ASSERT_EQ(makeHash(101), longHash);
+
+  restored.put(makeHash(4), makeHash(104));
+  ASSERT_FALSE(restored.get(makeHash(1), longHash));
+  ASSERT_TRUE(restored.get(makeHash(2), longHash));
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/Lz4.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Common;
+
+namespace {
+
+void checkRoundTrip(const std::string& data) {
+  std::vector<char> compressed;
+  lz4Compress(data.data(), data.size(), compressed);
+  std::string decompressed(data.size(), '\0');
+  ASSERT_TRUE(lz4Decompress(compressed.data(), compressed.size(), &decompressed[0], decompressed.size()));
+  ASSERT_EQ(data, decompressed);
+}
+
+}
+
+TEST(Lz4, roundTrip) {
+  checkRoundTrip("");
+  checkRoundTrip("a");
+  checkRoundTrip("abcdefghijklmnop");
+  checkRoundTrip(std::string(100000, 'x'));
+
+  std::mt19937 generator(1);
+  std::string random;
+  for (size_t i = 0; i < 70000; ++i) {
+    random += static_cast<char>(generator());
+  }
+
+  checkRoundTrip(random);
+  // repeats far and near, longer than the 64 KB window
+  checkRoundTrip(random.substr(0, 1000) + random + random.substr(0, 1000) + random.substr(500, 300));
+}
+
+TEST(Lz4, repeatedDataShrinks) {
+  std::string data;
+  for (size_t i = 0; i < 1000; ++i) {
+    data += "block " + std::to_string(i % 10) + " ";
+  }
+
+  std::vector<char> compressed;
+  lz4Compress(data.data(), data.size(), compressed);
+  ASSERT_LT(compressed.size(), data.size() / 10);
+}
+
+TEST(Lz4, corruptedDataIsRejected) {
+  std::string data(1000, 'y');
+  std::vector<char> compressed;
+  lz4Compress(data.data(), data.size(), compressed);
+
+  std::string output(data.size(), '\0');
+  ASSERT_FALSE(lz4Decompress(compressed.data(), compressed.size() - 1, &output[0], output.size()));
+  ASSERT_FALSE(lz4Decompress(compressed.data(), compressed.size(), &output[0], output.size() - 1));
+
+  // match offset pointing before the start of output
+  const char badOffset[] = { 0x10, 'a', 0x05, 0x00 };
+  ASSERT_FALSE(lz4Decompress(badOffset, sizeof badOffset, &output[0], 10));
+}
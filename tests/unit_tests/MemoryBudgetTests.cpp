@@ -0,0 +1,103 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include "Common/MemoryBudget.h"
+
+using namespace Common;
+
+namespace {
+
+struct TestConsumer {
+  uint64_t usage;
+  uint64_t limit;
+  size_t limitCalls;
+
+  TestConsumer(uint64_t usage) : usage(usage), limit(0), limitCalls(0) {
+  }
+
+  void add(MemoryBudget& budget, const std::string& name, uint32_t weight) {
+    budget.addConsumer(name, weight, [this] { return usage; }, [this](uint64_t newLimit) {
+      limit = newLimit;
+      ++limitCalls;
+    });
+  }
+};
+
+}
+
+TEST(MemoryBudget, noLimitsWithoutBudget) {
+  std::vector<uint64_t> limits = MemoryBudget::computeLimits(0, { 100, 200 }, { 1, 3 });
+  ASSERT_EQ(std::vector<uint64_t>({ 0, 0 }), limits);
+}
+
+TEST(MemoryBudget, splitsBudgetByWeights) {
+  std::vector<uint64_t> limits = MemoryBudget::computeLimits(1000, { 2000, 2000 }, { 1, 3 });
+  ASSERT_EQ(std::vector<uint64_t>({ 250, 750 }), limits);
+}
+
+TEST(MemoryBudget, unusedShareGoesToOthers) {
+  // first consumer uses 100 of its 400, the other two split the remaining 1500
+  std::vector<uint64_t> limits = MemoryBudget::computeLimits(1600, { 100, 2000, 2000 }, { 1, 1, 2 });
+  ASSERT_EQ(std::vector<uint64_t>({ 400, 500, 1000 }), limits);
+}
+
+TEST(MemoryBudget, consumersWithinSharesKeepThem) {
+  std::vector<uint64_t> limits = MemoryBudget::computeLimits(1000, { 100, 200 }, { 1, 1 });
+  ASSERT_EQ(std::vector<uint64_t>({ 500, 500 }), limits);
+}
+
+TEST(MemoryBudget, updateSetsLimitsAndReportsUsage) {
+  MemoryBudget budget(1000);
+  TestConsumer blocks(5000);
+  TestConsumer pool(100);
+  blocks.add(budget, "blocks", 3);
+  pool.add(budget, "pool", 1);
+
+  budget.update();
+  ASSERT_EQ(900, blocks.limit);
+  ASSERT_EQ(250, pool.limit);
+
+  std::vector<MemoryBudget::ConsumerUsage> usage = budget.getUsage();
+  ASSERT_EQ(2, usage.size());
+  ASSERT_EQ("blocks", usage[0].name);
+  ASSERT_EQ(5000, usage[0].usage);
+  ASSERT_EQ(900, usage[0].limit);
+  ASSERT_EQ(100, usage[1].usage);
+
+  // unchanged limits are not set again
+  budget.update();
+  ASSERT_EQ(1, blocks.limitCalls);
+  ASSERT_EQ(1, pool.limitCalls);
+
+  budget.setBudget(0);
+  budget.update();
+  ASSERT_EQ(0, blocks.limit);
+  ASSERT_EQ(0, pool.limit);
+}
+
+TEST(MemoryBudget, removedConsumerIsNotUpdated) {
+  MemoryBudget budget(1000);
+  TestConsumer blocks(5000);
+  blocks.add(budget, "blocks", 1);
+  budget.removeConsumer("blocks");
+
+  budget.update();
+  ASSERT_EQ(0, blocks.limitCalls);
+  ASSERT_TRUE(budget.getUsage().empty());
+}
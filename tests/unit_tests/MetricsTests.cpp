@@ -0,0 +1,129 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/Metrics.h"
+#include "Common/StageProfiler.h"
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Common;
+
+namespace {
+
+bool contains(const std::string& text, const std::string& line) {
+  return text.find(line + '\n') != std::string::npos;
+}
+
+}
+
+TEST(Metrics, sameNameAndLabelsGiveSameMetric) {
+  MetricsRegistry registry;
+  MetricCounter& counter = registry.counter("requests_total", "Requests", { { "url", "/a" } });
+  ASSERT_EQ(&counter, &registry.counter("requests_total", "Requests", { { "url", "/a" } }));
+  ASSERT_NE(&counter, &registry.counter("requests_total", "Requests", { { "url", "/b" } }));
+}
+
+TEST(Metrics, nameRegisteredWithAnotherTypeThrows) {
+  MetricsRegistry registry;
+  registry.counter("value", "Value");
+  ASSERT_THROW(registry.gauge("value", "Value"), std::runtime_error);
+}
+
+TEST(Metrics, countersAreUpdatedFromThreads) {
+  MetricsRegistry registry;
+  MetricCounter& counter = registry.counter("events_total", "Events");
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&counter] {
+      for (size_t i = 0; i < 10000; ++i) {
+        counter.increment();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(40000, counter.get());
+}
+
+TEST(Metrics, histogramBucketsArePowersOfTwo) {
+  MetricHistogram histogram;
+  histogram.observe(static_cast<uint64_t>(0));
+  histogram.observe(static_cast<uint64_t>(1));
+  histogram.observe(static_cast<uint64_t>(3));
+  histogram.observe(static_cast<uint64_t>(4));
+  histogram.observe(static_cast<uint64_t>(5));
+  histogram.observe(std::numeric_limits<uint64_t>::max() / 2);
+
+  ASSERT_EQ(2, histogram.getBucketCount(0));
+  ASSERT_EQ(0, histogram.getBucketCount(1));
+  ASSERT_EQ(2, histogram.getBucketCount(2));
+  ASSERT_EQ(1, histogram.getBucketCount(3));
+  ASSERT_EQ(1, histogram.getBucketCount(MetricHistogram::BUCKET_COUNT - 1));
+  ASSERT_EQ(6, histogram.getCount());
+}
+
+TEST(Metrics, formatIsPrometheusText) {
+  MetricsRegistry registry;
+  registry.counter("requests_total", "Requests by url", { { "url", "/a\"b" } }).increment(3);
+  registry.gauge("pool_size", "Pool size").set(-2);
+  registry.histogram("duration_microseconds", "Duration", { { "method", "m" } }).observe(static_cast<uint64_t>(3));
+
+  std::string text = registry.format();
+  ASSERT_TRUE(contains(text, "# HELP requests_total Requests by url"));
+  ASSERT_TRUE(contains(text, "# TYPE requests_total counter"));
+  ASSERT_TRUE(contains(text, "requests_total{url=\"/a\\\"b\"} 3"));
+  ASSERT_TRUE(contains(text, "# TYPE pool_size gauge"));
+  ASSERT_TRUE(contains(text, "pool_size -2"));
+  ASSERT_TRUE(contains(text, "# TYPE duration_microseconds histogram"));
+  ASSERT_TRUE(contains(text, "duration_microseconds_bucket{method=\"m\",le=\"2\"} 0"));
+  ASSERT_TRUE(contains(text, "duration_microseconds_bucket{method=\"m\",le=\"4\"} 1"));
+  ASSERT_TRUE(contains(text, "duration_microseconds_bucket{method=\"m\",le=\"+Inf\"} 1"));
+  ASSERT_TRUE(contains(text, "duration_microseconds_sum{method=\"m\"} 3"));
+  ASSERT_TRUE(contains(text, "duration_microseconds_count{method=\"m\"} 1"));
+}
+
+TEST(Metrics, stageTimerObservesOnlyWhenProfilingIsEnabled) {
+  MetricHistogram& stage = StageProfiler::stage("unit_test_stage");
+  uint64_t count = stage.getCount();
+
+  StageProfiler::setEnabled(false);
+  {
+    StageTimer timer(stage);
+  }
+
+  ASSERT_EQ(count, stage.getCount());
+
+  StageProfiler::setEnabled(true);
+  {
+    StageTimer timer(stage);
+    timer.stop();
+  }
+
+  StageProfiler::setEnabled(false);
+  ASSERT_EQ(count + 1, stage.getCount());
+  ASSERT_EQ(&stage, &StageProfiler::stage("unit_test_stage"));
+  ASSERT_NE(std::string::npos, StageProfiler::format().find("unit_test_stage"));
+}
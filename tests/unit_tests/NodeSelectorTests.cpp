@@ -0,0 +1,71 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "node_rpc_proxy/NodeSelector.h"
+
+using namespace CryptoNote;
+
+namespace {
+const NodeSelector::Clock::time_point START = NodeSelector::Clock::now();
+const NodeSelector::Clock::duration RETRY_DELAY = std::chrono::seconds(30);
+}
+
+TEST(NodeSelectorTest, nodesNotAskedYetGoFirst) {
+  NodeSelector selector(3, RETRY_DELAY);
+  ASSERT_EQ(0, selector.select(START));
+  selector.reportSuccess(0, std::chrono::milliseconds(10));
+  ASSERT_EQ(1, selector.select(START));
+  selector.reportSuccess(1, std::chrono::milliseconds(20));
+  ASSERT_EQ(2, selector.select(START));
+}
+
+TEST(NodeSelectorTest, fastestNodeIsSelected) {
+  NodeSelector selector(3, RETRY_DELAY);
+  selector.reportSuccess(0, std::chrono::milliseconds(300));
+  selector.reportSuccess(1, std::chrono::milliseconds(100));
+  selector.reportSuccess(2, std::chrono::milliseconds(200));
+  ASSERT_EQ(1, selector.select(START));
+
+  // a slow response moves the average a quarter of the way
+  selector.reportSuccess(1, std::chrono::milliseconds(900));
+  ASSERT_EQ(2, selector.select(START));
+}
+
+TEST(NodeSelectorTest, failedNodeIsSkippedUntilRetryDelayPasses) {
+  NodeSelector selector(2, RETRY_DELAY);
+  selector.reportSuccess(0, std::chrono::milliseconds(10));
+  selector.reportSuccess(1, std::chrono::milliseconds(100));
+
+  selector.reportFailure(0, START);
+  ASSERT_FALSE(selector.available(0, START + RETRY_DELAY / 2));
+  ASSERT_EQ(1, selector.select(START + RETRY_DELAY / 2));
+
+  ASSERT_TRUE(selector.available(0, START + RETRY_DELAY));
+  ASSERT_EQ(0, selector.select(START + RETRY_DELAY));
+}
+
+TEST(NodeSelectorTest, nodeFailedLongestAgoIsSelectedWhenAllFailed) {
+  NodeSelector selector(2, RETRY_DELAY);
+  selector.reportFailure(1, START);
+  selector.reportFailure(0, START + std::chrono::seconds(1));
+  ASSERT_EQ(1, selector.select(START + std::chrono::seconds(2)));
+
+  selector.reportSuccess(0, std::chrono::milliseconds(10));
+  ASSERT_TRUE(selector.available(0, START + std::chrono::seconds(2)));
+  ASSERT_EQ(0, selector.select(START + std::chrono::seconds(2)));
+}
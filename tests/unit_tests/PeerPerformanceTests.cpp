@@ -0,0 +1,63 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "p2p/PeerPerformance.h"
+
+using namespace CryptoNote;
+
+namespace {
+PeerPerformance measure(std::chrono::milliseconds connectTime, uint64_t bytesPerSecond) {
+  PeerPerformance performance;
+  performance.connected(connectTime);
+  performance.transferMeasured(bytesPerSecond);
+  return performance;
+}
+}
+
+TEST(PeerPerformance, fastPeerCostsLessThanUnknown) {
+  PeerPerformance unknown;
+  ASSERT_FALSE(unknown.measured());
+  ASSERT_LT(measure(std::chrono::milliseconds(50), 4 * 1024 * 1024).cost(), unknown.cost());
+  ASSERT_GT(measure(std::chrono::milliseconds(800), 16 * 1024).cost(), unknown.cost());
+}
+
+TEST(PeerPerformance, failuresRaiseCost) {
+  PeerPerformance reliable = measure(std::chrono::milliseconds(50), 1024 * 1024);
+  PeerPerformance failing = reliable;
+  failing.failed();
+  failing.failed();
+  ASSERT_EQ(3, failing.attempts());
+  ASSERT_EQ(2, failing.failures());
+  ASSERT_GT(failing.cost(), reliable.cost() * 3 / 2);
+}
+
+TEST(PeerPerformance, oldFailuresFade) {
+  PeerPerformance performance;
+  for (int i = 0; i < 16; ++i) {
+    performance.failed();
+  }
+
+  uint64_t failingCost = performance.cost();
+  for (int i = 0; i < 16; ++i) {
+    performance.connected(std::chrono::milliseconds(100));
+  }
+
+  ASSERT_LE(performance.attempts(), 16);
+  ASSERT_LE(performance.failures(), 4);
+  ASSERT_LT(performance.cost() * 4, failingCost);
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "p2p/PeerTransferStatistics.h"
+
+using namespace CryptoNote;
+
+namespace {
+const uint64_t MAX_BYTES = 25000000;
+const size_t DEFAULT_COUNT = 200;
+const size_t MAX_COUNT = 10000;
+
+size_t blocksPerRequest(const PeerTransferStatistics& statistics) {
+  return statistics.blocksPerRequest(std::chrono::seconds(2), MAX_BYTES, DEFAULT_COUNT, MAX_COUNT);
+}
+
+// peer with the given round trip answers chain request and then sends blocks of 1000 bytes at the given speed
+PeerTransferStatistics measure(std::chrono::milliseconds roundTrip, uint64_t bytesPerSecond, size_t blocks) {
+  PeerTransferStatistics statistics;
+  auto now = PeerTransferStatistics::Clock::now();
+  statistics.requestSent(now);
+  statistics.idsReceived(now + roundTrip, 32);
+
+  uint64_t bytes = blocks * 1000;
+  statistics.requestSent(now);
+  statistics.objectsReceived(now + roundTrip + std::chrono::microseconds(bytes * 1000000 / bytesPerSecond), bytes, blocks);
+  return statistics;
+}
+}
+
+TEST(PeerTransferStatistics, defaultCountIsUsedUntilMeasured) {
+  PeerTransferStatistics statistics;
+  ASSERT_EQ(DEFAULT_COUNT, blocksPerRequest(statistics));
+}
+
+TEST(PeerTransferStatistics, speedExcludesRoundTrip) {
+  PeerTransferStatistics statistics = measure(std::chrono::milliseconds(100), 1000000, 200);
+  ASSERT_EQ(100000, statistics.roundTripTime().count());
+  ASSERT_EQ(1000000, statistics.bytesPerSecond());
+  ASSERT_EQ(2000, blocksPerRequest(statistics));
+}
+
+TEST(PeerTransferStatistics, slowPeerGetsSmallRequests) {
+  PeerTransferStatistics statistics = measure(std::chrono::milliseconds(50), 10000, 200);
+  ASSERT_EQ(20, blocksPerRequest(statistics));
+}
+
+TEST(PeerTransferStatistics, longRoundTripGetsLargerRequests) {
+  PeerTransferStatistics statistics = measure(std::chrono::milliseconds(1000), 100000, 200);
+  ASSERT_EQ(400, blocksPerRequest(statistics));
+}
+
+TEST(PeerTransferStatistics, requestIsLimitedByPacketSizeAndCount) {
+  PeerTransferStatistics statistics = measure(std::chrono::milliseconds(1), 1000000000, 1000);
+  ASSERT_EQ(MAX_COUNT, blocksPerRequest(statistics));
+  ASSERT_EQ(500, statistics.blocksPerRequest(std::chrono::seconds(2), 500000, DEFAULT_COUNT, MAX_COUNT));
+}
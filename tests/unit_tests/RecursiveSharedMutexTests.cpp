@@ -0,0 +1,97 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/RecursiveSharedMutex.h"
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+
+using namespace Common;
+
+TEST(RecursiveSharedMutex, readersRunConcurrently) {
+  RecursiveSharedMutex mutex;
+  std::atomic<int> inside(0);
+  std::atomic<int> maxInside(0);
+
+  auto reader = [&] {
+    SharedLockGuard<RecursiveSharedMutex> lock(mutex);
+    int current = ++inside;
+    while (maxInside < current) {
+      maxInside = current;
+    }
+
+    // wait until second reader enters or give up after a while
+    for (int i = 0; i < 1000 && maxInside < 2; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    --inside;
+  };
+
+  auto f1 = std::async(std::launch::async, reader);
+  auto f2 = std::async(std::launch::async, reader);
+  f1.get();
+  f2.get();
+
+  ASSERT_EQ(2, maxInside.load());
+}
+
+TEST(RecursiveSharedMutex, writerExcludesReaders) {
+  RecursiveSharedMutex mutex;
+  std::atomic<bool> readerEntered(false);
+
+  std::unique_lock<RecursiveSharedMutex> writeLock(mutex);
+  auto f = std::async(std::launch::async, [&] {
+    SharedLockGuard<RecursiveSharedMutex> lock(mutex);
+    readerEntered = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_FALSE(readerEntered);
+  writeLock.unlock();
+  f.get();
+  ASSERT_TRUE(readerEntered);
+}
+
+TEST(RecursiveSharedMutex, isRecursiveInBothModes) {
+  RecursiveSharedMutex mutex;
+
+  {
+    std::lock_guard<RecursiveSharedMutex> lock1(mutex);
+    std::lock_guard<RecursiveSharedMutex> lock2(mutex);
+    SharedLockGuard<RecursiveSharedMutex> lock3(mutex);
+  }
+
+  {
+    SharedLockGuard<RecursiveSharedMutex> lock1(mutex);
+    SharedLockGuard<RecursiveSharedMutex> lock2(mutex);
+  }
+
+  auto f = std::async(std::launch::async, [&] {
+    std::lock_guard<RecursiveSharedMutex> lock(mutex);
+  });
+
+  f.get();
+}
+
+TEST(RecursiveSharedMutex, upgradeThrows) {
+  RecursiveSharedMutex mutex;
+  SharedLockGuard<RecursiveSharedMutex> lock(mutex);
+  ASSERT_THROW(mutex.lock(), std::logic_error);
+}
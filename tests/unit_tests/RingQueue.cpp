@@ -0,0 +1,255 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/BlockingQueue.h"
+#include "Common/RingQueue.h"
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Each of producerCount threads pushes its share of 0..iterations-1, consumers sum what they pop
+template <typename QueueT>
+int64_t transfer(QueueT& queue, unsigned iterations, unsigned producerCount, unsigned consumerCount) {
+  std::atomic<unsigned> counter(0);
+  std::atomic<int64_t> result(0);
+  GroupClose<QueueT> groupClose(queue, producerCount);
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < producerCount; ++i) {
+    threads.emplace_back([&] {
+      for (;;) {
+        unsigned value = counter.fetch_add(1);
+        if (value >= iterations) {
+          break;
+        }
+
+        queue.push(static_cast<int>(value));
+      }
+
+      groupClose.close();
+    });
+  }
+
+  for (unsigned i = 0; i < consumerCount; ++i) {
+    threads.emplace_back([&] {
+      int v = 0;
+      int64_t sum = 0;
+      while (queue.pop(v)) {
+        sum += v;
+      }
+
+      result += sum;
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  return result.load();
+}
+
+int64_t expectedSum(unsigned iterations) {
+  return static_cast<int64_t>(iterations) * (iterations - 1) / 2;
+}
+
+}
+
+TEST(RingQueue, SPMC)
+{
+  for (unsigned size : {1, 4, 16, 100}) {
+    RingQueue<int> queue(size);
+    ASSERT_EQ(expectedSum(10000), transfer(queue, 10000, 1, 4));
+  }
+}
+
+TEST(RingQueue, MPSC)
+{
+  for (unsigned size : {1, 4, 16, 100}) {
+    RingQueue<int> queue(size);
+    ASSERT_EQ(expectedSum(10000), transfer(queue, 10000, 4, 1));
+    ASSERT_EQ(0, queue.size());
+  }
+}
+
+TEST(RingQueue, MPMC)
+{
+  RingQueue<int> queue(16);
+  ASSERT_EQ(expectedSum(100000), transfer(queue, 100000, 8, 8));
+}
+
+TEST(RingQueue, RoundsCapacity)
+{
+  ASSERT_EQ(2, RingQueue<int>(1).capacity());
+  ASSERT_EQ(8, RingQueue<int>(5).capacity());
+  ASSERT_EQ(16, RingQueue<int>(16).capacity());
+}
+
+TEST(RingQueue, PushFailsAfterClose)
+{
+  RingQueue<int> queue(4);
+  ASSERT_TRUE(queue.push(1));
+  queue.close();
+  ASSERT_FALSE(queue.push(2));
+
+  int v;
+  ASSERT_TRUE(queue.pop(v));
+  ASSERT_EQ(1, v);
+  ASSERT_FALSE(queue.pop(v));
+}
+
+TEST(RingQueue, Close)
+{
+  RingQueue<int> queue(4);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&queue] {
+      int v;
+      while (queue.pop(v))
+        ;
+    });
+  }
+
+  queue.push(10); // enqueue 1 item
+
+  queue.close(); // all threads should unblock and finish
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+TEST(RingQueue, CloseAndWait)
+{
+  size_t queueSize = 64;
+  RingQueue<int> queue(queueSize);
+  std::atomic<size_t> itemsPopped(0);
+
+  // fill the queue
+  for (int i = 0; i < queueSize; ++i)
+    queue.push(i);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&queue, &itemsPopped] {
+      int v;
+      while (queue.pop(v)) {
+        itemsPopped += 1;
+        // some delay to make close() really wait
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    });
+  }
+
+  // check with multiple closing
+  auto f1 = std::async(std::launch::async, [&] { queue.close(true); });
+  auto f2 = std::async(std::launch::async, [&] { queue.close(true); });
+
+  queue.close(true);
+  f1.get();
+  f2.get();
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  ASSERT_EQ(queueSize, itemsPopped.load());
+}
+
+TEST(RingQueue, AllowsMoveOnly)
+{
+  RingQueue<std::unique_ptr<int>> queue(1);
+
+  std::unique_ptr<int> v(new int(100));
+  ASSERT_TRUE(queue.push(std::move(v)));
+
+  std::unique_ptr<int> popval;
+  queue.pop(popval);
+
+  ASSERT_EQ(*popval, 100);
+}
+
+TEST(RingQueue, Batches)
+{
+  RingQueue<int> queue(8);
+  const int itemCount = 10000;
+
+  auto producer = std::async(std::launch::async, [&queue, itemCount] {
+    std::vector<int> batch;
+    for (int i = 0; i < itemCount; ++i) {
+      batch.push_back(i);
+      if (batch.size() == 20 || i == itemCount - 1) {
+        queue.pushBatch(batch.begin(), batch.end());
+        batch.clear();
+      }
+    }
+
+    queue.close();
+  });
+
+  std::vector<int> items;
+  int expected = 0;
+  while (queue.popBatch(items, 7) != 0) {
+    ASSERT_LE(items.size(), 7);
+    for (int item : items) {
+      ASSERT_EQ(expected, item);
+      ++expected;
+    }
+  }
+
+  producer.get();
+  ASSERT_EQ(itemCount, expected);
+}
+
+TEST(RingQueue, PushBatchStopsOnClose)
+{
+  RingQueue<int> queue(4);
+  std::vector<int> items(10, 1);
+  auto producer = std::async(std::launch::async, [&] { return queue.pushBatch(items.begin(), items.end()); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  queue.close();
+  ASSERT_EQ(4, producer.get());
+}
+
+// Run with --gtest_also_run_disabled_tests to compare throughput
+TEST(RingQueue, DISABLED_ComparedToBlockingQueue)
+{
+  const unsigned iterations = 1000000;
+  const size_t queueSize = 1024;
+  const unsigned configurations[][2] = { { 1, 1 }, { 4, 1 }, { 1, 4 }, { 4, 4 }, { 16, 4 } };
+
+  for (auto& configuration : configurations) {
+    auto start = std::chrono::steady_clock::now();
+    BlockingQueue<int> blockingQueue(queueSize);
+    ASSERT_EQ(expectedSum(iterations), transfer(blockingQueue, iterations, configuration[0], configuration[1]));
+    auto blockingTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    RingQueue<int> ringQueue(queueSize);
+    ASSERT_EQ(expectedSum(iterations), transfer(ringQueue, iterations, configuration[0], configuration[1]));
+    auto ringTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << configuration[0] << " producers, " << configuration[1] << " consumers: BlockingQueue " << blockingTime <<
+      " ms, RingQueue " << ringTime << " ms" << std::endl;
+  }
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "rpc/RpcResponseCache.h"
+
+using namespace CryptoNote;
+
+namespace {
+const RpcResponseCache::Clock::time_point START = RpcResponseCache::Clock::now();
+}
+
+TEST(RpcResponseCacheTest, storedResponseIsFoundUntilExpired) {
+  RpcResponseCache cache(std::chrono::seconds(1), 16);
+  cache.store("/getheight\n", "{\"height\": 1}", cache.getGeneration(), START);
+
+  std::string response;
+  ASSERT_TRUE(cache.find("/getheight\n", START + std::chrono::milliseconds(999), response));
+  ASSERT_EQ("{\"height\": 1}", response);
+  ASSERT_FALSE(cache.find("/getinfo\n", START, response));
+  ASSERT_FALSE(cache.find("/getheight\n", START + std::chrono::seconds(1), response));
+}
+
+TEST(RpcResponseCacheTest, blockchainAndPoolUpdatesDropResponses) {
+  RpcResponseCache cache(std::chrono::seconds(1), 16);
+  std::string response;
+
+  cache.store("a", "1", cache.getGeneration(), START);
+  cache.blockchainUpdated();
+  ASSERT_FALSE(cache.find("a", START, response));
+
+  cache.store("a", "1", cache.getGeneration(), START);
+  cache.poolUpdated();
+  ASSERT_FALSE(cache.find("a", START, response));
+
+  cache.store("a", "1", cache.getGeneration(), START);
+  cache.txsEvictedFromPool(std::vector<crypto::hash>());
+  ASSERT_FALSE(cache.find("a", START, response));
+}
+
+TEST(RpcResponseCacheTest, responseComputedBeforeUpdateIsNotStored) {
+  RpcResponseCache cache(std::chrono::seconds(1), 16);
+  uint64_t generation = cache.getGeneration();
+  cache.blockchainUpdated();
+  cache.store("a", "1", generation, START);
+
+  std::string response;
+  ASSERT_FALSE(cache.find("a", START, response));
+  ASSERT_EQ(0, cache.size());
+}
+
+TEST(RpcResponseCacheTest, sizeIsBounded) {
+  RpcResponseCache cache(std::chrono::seconds(1), 4);
+  for (size_t i = 0; i < 10; ++i) {
+    cache.store(std::to_string(i), "response", cache.getGeneration(), START);
+    ASSERT_LE(cache.size(), 4);
+  }
+
+  std::string response;
+  ASSERT_TRUE(cache.find("9", START, response));
+}
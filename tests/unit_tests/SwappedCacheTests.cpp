@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/SwappedCache.h"
+
+#include <cstdint>
+
+namespace {
+
+typedef SwappedCache<uint64_t, uint64_t> Cache;
+
+// reads key through the cache like SwappedVector does, returns true on a hit
+bool read(Cache& cache, uint64_t key) {
+  if (cache.find(key) != nullptr) {
+    return true;
+  }
+
+  cache.insert(key, uint64_t(key));
+  return false;
+}
+
+// hits of reading a hot set repeatedly while a scan of cold keys passes through the cache
+size_t hotHitsDuringScan(SwappedCachePolicy policy) {
+  Cache cache(16, policy);
+  for (size_t round = 0; round < 2; ++round) {
+    for (uint64_t key = 0; key < 8; ++key) {
+      read(cache, key);
+    }
+  }
+
+  size_t hits = 0;
+  for (uint64_t scanKey = 1000; scanKey < 1100; ++scanKey) {
+    read(cache, scanKey);
+    if (scanKey % 10 == 0) {
+      for (uint64_t key = 0; key < 8; ++key) {
+        hits += read(cache, key) ? 1 : 0;
+      }
+    }
+  }
+
+  return hits;
+}
+
+}
+
+TEST(SwappedCache, lruEvictsLeastRecentlyUsed) {
+  Cache cache(2, SwappedCachePolicy::LRU);
+  read(cache, 1);
+  read(cache, 2);
+  ASSERT_TRUE(read(cache, 1));
+  read(cache, 3);
+
+  ASSERT_EQ(2, cache.size());
+  ASSERT_TRUE(cache.find(1) != nullptr);
+  ASSERT_TRUE(cache.find(2) == nullptr);
+}
+
+TEST(SwappedCache, twoQueuePromotesKeyReadAgainAfterEviction) {
+  Cache cache(4, SwappedCachePolicy::TWO_QUEUE);
+  for (uint64_t key = 0; key < 6; ++key) {
+    read(cache, key);
+  }
+
+  // 0 and 1 left the FIFO and are remembered, reading 0 again puts it into the LRU part
+  ASSERT_FALSE(read(cache, 0));
+  for (uint64_t key = 100; key < 110; ++key) {
+    read(cache, key);
+  }
+
+  ASSERT_TRUE(cache.find(0) != nullptr);
+  ASSERT_TRUE(cache.find(1) == nullptr);
+  ASSERT_EQ(4, cache.size());
+}
+
+TEST(SwappedCache, twoQueueResistsScan) {
+  ASSERT_GT(hotHitsDuringScan(SwappedCachePolicy::TWO_QUEUE), hotHitsDuringScan(SwappedCachePolicy::LRU));
+}
+
+TEST(SwappedCache, shrinkAndPolicyChange) {
+  Cache cache(8, SwappedCachePolicy::LRU);
+  for (uint64_t key = 0; key < 8; ++key) {
+    read(cache, key);
+  }
+
+  cache.reset(3, SwappedCachePolicy::LRU);
+  ASSERT_EQ(3, cache.size());
+  ASSERT_TRUE(cache.find(7) != nullptr);
+  ASSERT_TRUE(cache.find(4) == nullptr);
+
+  cache.reset(3, SwappedCachePolicy::TWO_QUEUE);
+  ASSERT_EQ(0, cache.size());
+  ASSERT_EQ(SwappedCachePolicy::TWO_QUEUE, cache.policy());
+
+  read(cache, 1);
+  cache.erase(1);
+  ASSERT_TRUE(cache.find(1) == nullptr);
+}
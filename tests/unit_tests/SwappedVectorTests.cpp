@@ -0,0 +1,455 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/SwappedVector.h"
+
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include "serialization/serialization.h"
+#include "serialization/string.h"
+
+namespace {
+std::string makeItem(size_t index) {
+  return std::string(100 + index % 50, static_cast<char>('a' + index % 26));
+}
+
+class SwappedVectorTest : public ::testing::Test {
+public:
+  SwappedVectorTest() :
+    m_directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()) {
+    boost::filesystem::create_directories(m_directory);
+  }
+
+  ~SwappedVectorTest() {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(m_directory, ec);
+  }
+
+  bool open(SwappedVector<std::string>& vector, size_t poolSize, bool mapItems = false, bool compressItems = false) {
+    return vector.open((m_directory / "items").string(), (m_directory / "indexes").string(), poolSize, mapItems, compressItems);
+  }
+
+  bool openReadOnly(SwappedVector<std::string>& vector, size_t poolSize, bool mapItems = false) {
+    return vector.openReadOnly((m_directory / "items").string(), (m_directory / "indexes").string(), poolSize, mapItems);
+  }
+
+  uint64_t itemsFileSize() const {
+    return boost::filesystem::file_size(m_directory / "items");
+  }
+
+  std::string readFile(const std::string& name) const {
+    std::ifstream file((m_directory / name).string(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  void writeFile(const std::string& name, const std::string& data) const {
+    std::ofstream file((m_directory / name).string(), std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+  }
+
+private:
+  boost::filesystem::path m_directory;
+};
+
+void readConcurrently(SwappedVector<std::string>& vector) {
+  std::atomic<size_t> mismatches(0);
+  std::vector<std::thread> readers;
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    readers.emplace_back([&vector, &mismatches, seed] {
+      std::mt19937 generator(seed);
+      std::uniform_int_distribution<size_t> distribution(0, vector.size() - 1);
+      for (size_t i = 0; i < 5000; ++i) {
+        size_t index = distribution(generator);
+        std::shared_ptr<const std::string> item = vector[index];
+        // other readers evict the item from cache meanwhile, it must stay intact
+        std::this_thread::yield();
+        if (*item != makeItem(index)) {
+          ++mismatches;
+        }
+
+        auto it = vector.begin() + index;
+        if (it->size() != makeItem(index).size()) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  ASSERT_EQ(0, mismatches.load());
+}
+}
+
+TEST_F(SwappedVectorTest, itemsSurviveReopen) {
+  {
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 2));
+    for (size_t i = 0; i < 10; ++i) {
+      vector.push_back(makeItem(i));
+    }
+
+    vector.pop_back();
+    ASSERT_EQ(9, vector.size());
+    ASSERT_EQ(makeItem(8), *vector.back());
+  }
+
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 2));
+  ASSERT_EQ(9, vector.size());
+  for (size_t i = 0; i < vector.size(); ++i) {
+    ASSERT_EQ(makeItem(i), *vector[i]);
+  }
+
+  std::string item;
+  vector.load(4, item);
+  ASSERT_EQ(makeItem(4), item);
+}
+
+TEST_F(SwappedVectorTest, itemStaysValidAfterEviction) {
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 2));
+  for (size_t i = 0; i < 10; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  std::shared_ptr<const std::string> item = vector[0];
+  for (size_t i = 1; i < 10; ++i) {
+    vector[i];
+  }
+
+  ASSERT_EQ(makeItem(0), *item);
+}
+
+TEST_F(SwappedVectorTest, concurrentReadersWithSmallCache) {
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 4));
+  for (size_t i = 0; i < 64; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  readConcurrently(vector);
+}
+
+TEST_F(SwappedVectorTest, concurrentReadersWithMappedItems) {
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 4, true));
+  for (size_t i = 0; i < 64; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  readConcurrently(vector);
+}
+
+TEST_F(SwappedVectorTest, concurrentLoadFromFile) {
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 4));
+  for (size_t i = 0; i < 64; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  std::vector<std::string> items(vector.size());
+  std::vector<std::thread> workers;
+  for (size_t first = 0; first < 4; ++first) {
+    workers.emplace_back([&vector, &items, first] {
+      for (size_t i = first; i < items.size(); i += 4) {
+        vector.load(i, items[i]);
+      }
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    ASSERT_EQ(makeItem(i), items[i]);
+  }
+}
+
+TEST_F(SwappedVectorTest, cacheStatisticsCountHitsAndMisses) {
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 2));
+  for (size_t i = 0; i < 4; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  vector[3];
+  vector[0];
+  vector[0];
+
+  SwappedVectorCacheStatistics statistics = vector.getCacheStatistics();
+  ASSERT_EQ(2, statistics.hits);
+  ASSERT_EQ(1, statistics.misses);
+  ASSERT_EQ(2, statistics.size);
+  ASSERT_EQ(2, statistics.capacity);
+}
+
+TEST_F(SwappedVectorTest, shrinkingPoolEvictsLeastRecentlyUsed) {
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 8));
+  for (size_t i = 0; i < 8; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  vector[2];
+  ASSERT_FALSE(vector.setPoolSize(0));
+  ASSERT_TRUE(vector.setPoolSize(2));
+  ASSERT_EQ(2, vector.getCacheStatistics().size);
+
+  // the item read last and the last pushed one stay
+  uint64_t misses = vector.getCacheStatistics().misses;
+  ASSERT_EQ(makeItem(2), *vector[2]);
+  ASSERT_EQ(makeItem(7), *vector[7]);
+  ASSERT_EQ(misses, vector.getCacheStatistics().misses);
+
+  ASSERT_TRUE(vector.setPoolSize(4));
+  for (size_t i = 0; i < 8; ++i) {
+    vector[i];
+  }
+
+  ASSERT_EQ(4, vector.getCacheStatistics().size);
+  ASSERT_EQ(4, vector.getCacheStatistics().capacity);
+}
+
+TEST_F(SwappedVectorTest, sequentialMissesReadAhead) {
+  for (bool mapItems : { false, true }) {
+    {
+      SwappedVector<std::string> vector;
+      ASSERT_TRUE(open(vector, 64, mapItems));
+      vector.clear();
+      for (size_t i = 0; i < 40; ++i) {
+        vector.push_back(makeItem(i));
+      }
+    }
+
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 64, mapItems));
+    vector.setReadAhead(8);
+    for (size_t i = 0; i < 40; ++i) {
+      ASSERT_EQ(makeItem(i), *vector[i]);
+    }
+
+    ASSERT_EQ(5, vector.getCacheStatistics().misses);
+    ASSERT_EQ(35, vector.getCacheStatistics().hits);
+  }
+}
+
+TEST_F(SwappedVectorTest, prefetchCachesRange) {
+  {
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 64));
+    for (size_t i = 0; i < 40; ++i) {
+      vector.push_back(makeItem(i));
+    }
+  }
+
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 64));
+  vector[7];
+  vector.prefetch(5, 15);
+  ASSERT_EQ(1, vector.getCacheStatistics().misses);
+  for (size_t i = 5; i < 15; ++i) {
+    ASSERT_EQ(makeItem(i), *vector[i]);
+  }
+
+  ASSERT_EQ(1, vector.getCacheStatistics().misses);
+  // the range is clamped to the vector
+  vector.prefetch(35, 100);
+  ASSERT_EQ(makeItem(39), *vector[39]);
+  ASSERT_EQ(1, vector.getCacheStatistics().misses);
+}
+
+TEST_F(SwappedVectorTest, compressedItems) {
+  const size_t count = SwappedVector<std::string>::UNCOMPRESSED_TAIL_ITEMS + 4 * SwappedVector<std::string>::SEGMENT_ITEMS;
+  uint64_t uncompressedSize;
+  {
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 8));
+    for (size_t i = 0; i < count; ++i) {
+      vector.push_back(makeItem(i));
+    }
+
+    uncompressedSize = itemsFileSize();
+  }
+
+  for (bool mapItems : { false, true }) {
+    // existing items are compressed on open
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 8, mapItems, true));
+    ASSERT_LT(itemsFileSize(), uncompressedSize);
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_EQ(makeItem(i), *vector[i]);
+    }
+
+    std::string item;
+    vector.load(5, item);
+    ASSERT_EQ(makeItem(5), item);
+    vector.prefetch(count - SwappedVector<std::string>::UNCOMPRESSED_TAIL_ITEMS - 3, count - SwappedVector<std::string>::UNCOMPRESSED_TAIL_ITEMS + 3);
+  }
+
+  {
+    // popping below the uncompressed tail expands segments, pushing compresses them again
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 8, false, true));
+    for (size_t i = 0; i < SwappedVector<std::string>::UNCOMPRESSED_TAIL_ITEMS + 10; ++i) {
+      vector.pop_back();
+    }
+
+    for (size_t i = vector.size(); i < count + 40; ++i) {
+      vector.push_back(makeItem(i));
+    }
+  }
+
+  // segments are read without compression too
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 8));
+  ASSERT_EQ(count + 40, vector.size());
+  for (size_t i = 0; i < vector.size(); ++i) {
+    ASSERT_EQ(makeItem(i), *vector[i]);
+  }
+
+  vector.clear();
+  vector.push_back(makeItem(0));
+  ASSERT_EQ(makeItem(0), *vector[0]);
+}
+
+// Compaction writes segments past the end of items file and records their relocation in segments file header: segment
+// count, count after the relocation, its source and destination. Files are put in states a crash leaves at each step.
+TEST_F(SwappedVectorTest, interruptedCompactionIsRecovered) {
+  const size_t count = SwappedVector<std::string>::UNCOMPRESSED_TAIL_ITEMS + 4 * SwappedVector<std::string>::SEGMENT_ITEMS;
+  {
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 8));
+    for (size_t i = 0; i < count; ++i) {
+      vector.push_back(makeItem(i));
+    }
+  }
+
+  std::string indexes = readFile("indexes");
+  std::string uncompressed = readFile("items");
+  {
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 8, false, true));
+  }
+
+  std::string compacted = readFile("items");
+  std::string segments = readFile("items.segments");
+  ASSERT_LT(compacted.size(), uncompressed.size());
+
+  uint64_t segmentCount = 4;
+  uint64_t source = uncompressed.size();
+  uint64_t before[4] = { 0, 0, 0, 0 };
+  uint64_t committed[4] = { 0, segmentCount, source, 0 };
+  uint64_t counted[4] = { segmentCount, segmentCount, source, 0 };
+  struct Interruption {
+    const uint64_t* header;
+    // bytes of compacted items already moved in place
+    size_t moved;
+  };
+
+  Interruption interruptions[] = {
+    { before, 0 },
+    { committed, 0 },
+    { committed, compacted.size() / 2 },
+    { counted, compacted.size() }
+  };
+
+  for (const Interruption& interruption : interruptions) {
+    std::string items = uncompressed + compacted;
+    items.replace(0, interruption.moved, compacted, 0, interruption.moved);
+    std::string header(reinterpret_cast<const char*>(interruption.header), 4 * sizeof(uint64_t));
+    writeFile("items", items);
+    writeFile("items.segments", header + segments.substr(header.size()));
+    writeFile("indexes", indexes);
+
+    SwappedVector<std::string> vector;
+    ASSERT_TRUE(open(vector, 8));
+    ASSERT_EQ(count, vector.size());
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_EQ(makeItem(i), *vector[i]);
+    }
+
+    vector.push_back(makeItem(count));
+    ASSERT_EQ(makeItem(count), *vector[count]);
+  }
+
+  // popping into a segment expands it the same way
+  SwappedVector<std::string> vector;
+  ASSERT_TRUE(open(vector, 8, false, true));
+  for (size_t i = 0; i < SwappedVector<std::string>::UNCOMPRESSED_TAIL_ITEMS + 10; ++i) {
+    vector.pop_back();
+  }
+
+  vector.close();
+  SwappedVector<std::string> reopened;
+  ASSERT_TRUE(open(reopened, 8));
+  for (size_t i = 0; i < reopened.size(); ++i) {
+    ASSERT_EQ(makeItem(i), *reopened[i]);
+  }
+}
+
+TEST_F(SwappedVectorTest, readOnlyVectorFollowsWriter) {
+  for (bool mapItems : { false, true }) {
+    SwappedVector<std::string> writer;
+    ASSERT_TRUE(open(writer, 8));
+    writer.clear();
+    for (size_t i = 0; i < 20; ++i) {
+      writer.push_back(makeItem(i));
+    }
+
+    SwappedVector<std::string> reader;
+    ASSERT_TRUE(openReadOnly(reader, 8, mapItems));
+    ASSERT_EQ(20, reader.size());
+    ASSERT_EQ(makeItem(19), *reader[19]);
+
+    writer.push_back(makeItem(20));
+    ASSERT_EQ(20, reader.size());
+    ASSERT_TRUE(reader.refresh(reader.size()));
+    ASSERT_EQ(21, reader.size());
+    ASSERT_EQ(makeItem(20), *reader[20]);
+
+    // popped items are overwritten in place, cached ones must be read again
+    writer.pop_back();
+    writer.pop_back();
+    writer.push_back(makeItem(100));
+    ASSERT_TRUE(reader.refresh(reader.size() - 2));
+    ASSERT_EQ(20, reader.size());
+    ASSERT_EQ(makeItem(18), *reader[18]);
+    ASSERT_EQ(makeItem(100), *reader[19]);
+    ASSERT_EQ(makeItem(0), *reader[0]);
+  }
+}
+
+TEST_F(SwappedVectorTest, readOnlyVectorRejectsCompressedItems) {
+  {
+    SwappedVector<std::string> writer;
+    ASSERT_TRUE(open(writer, 8, false, true));
+    writer.push_back(makeItem(0));
+  }
+
+  SwappedVector<std::string> reader;
+  ASSERT_FALSE(openReadOnly(reader, 8));
+}
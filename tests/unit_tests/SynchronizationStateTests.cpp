@@ -0,0 +1,154 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "transfers/SynchronizationState.h"
+
+#include <sstream>
+
+#include "cryptonote_core/cryptonote_serialization.h"
+#include "serialization/BinaryOutputStreamSerializer.h"
+#include "serialization/SerializationOverloads.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+crypto::hash blockHash(uint64_t height, uint8_t chain = 0) {
+  crypto::hash hash = crypto::hash();
+  memcpy(&hash, &height, sizeof(height));
+  reinterpret_cast<uint8_t*>(&hash)[sizeof(height)] = chain;
+  return hash;
+}
+
+std::vector<crypto::hash> blockHashes(uint64_t start, size_t count, uint8_t chain = 0) {
+  std::vector<crypto::hash> hashes;
+  for (uint64_t height = start; height < start + count; ++height) {
+    hashes.push_back(blockHash(height, chain));
+  }
+
+  return hashes;
+}
+
+void addBlocks(SynchronizationState& state, size_t count) {
+  std::vector<crypto::hash> hashes = blockHashes(state.getHeight(), count);
+  state.addBlocks(hashes.data(), state.getHeight(), hashes.size());
+}
+
+}
+
+TEST(SynchronizationState, shortHistoryHasLastBlocksAndGenesis) {
+  SynchronizationState state(blockHash(0));
+  addBlocks(state, 10000);
+  ASSERT_EQ(10001, state.getHeight());
+
+  SynchronizationState::ShortHistory history = state.getShortHistory(10000);
+  ASSERT_LT(11, history.size());
+  auto it = history.begin();
+  for (uint64_t height = 10000; height > 9989; --height) {
+    ASSERT_EQ(blockHash(height), *it++);
+  }
+
+  ASSERT_EQ(blockHash(0), history.back());
+  // every hash is one of the chain, heights go down
+  uint64_t lastHeight = 10001;
+  for (const crypto::hash& hash : history) {
+    uint64_t height;
+    memcpy(&height, &hash, sizeof(height));
+    ASSERT_EQ(blockHash(height), hash);
+    ASSERT_LT(height, lastHeight);
+    lastHeight = height;
+  }
+}
+
+TEST(SynchronizationState, forkBelowKeptHashesIsDetachedAboveLastMatchingOne) {
+  SynchronizationState state(blockHash(0));
+  addBlocks(state, 10000);
+
+  // blocks from 1000 are on another chain, hash of 1000 is not kept but the one of 1024 is
+  BlockchainInterval interval;
+  interval.startHeight = 896;
+  interval.blocks = blockHashes(896, 104);
+  std::vector<crypto::hash> fork = blockHashes(1000, 200, 1);
+  interval.blocks.insert(interval.blocks.end(), fork.begin(), fork.end());
+
+  SynchronizationState::CheckResult result = state.checkInterval(interval);
+  ASSERT_TRUE(result.detachRequired);
+  ASSERT_EQ(897, result.detachHeight);
+  ASSERT_TRUE(result.hasNewBlocks);
+  ASSERT_EQ(897, result.newBlockHeight);
+
+  state.detach(result.detachHeight);
+  ASSERT_EQ(897, state.getHeight());
+  state.addBlocks(interval.blocks.data() + 1, 897, interval.blocks.size() - 1);
+  ASSERT_EQ(1200, state.getHeight());
+
+  interval.startHeight = 1190;
+  interval.blocks = blockHashes(1190, 20, 1);
+  result = state.checkInterval(interval);
+  ASSERT_FALSE(result.detachRequired);
+  ASSERT_TRUE(result.hasNewBlocks);
+  ASSERT_EQ(1200, result.newBlockHeight);
+}
+
+TEST(SynchronizationState, forkInLastBlocksIsDetachedExactly) {
+  SynchronizationState state(blockHash(0));
+  addBlocks(state, 5000);
+
+  BlockchainInterval interval;
+  interval.startHeight = 4990;
+  interval.blocks = blockHashes(4990, 5);
+  std::vector<crypto::hash> fork = blockHashes(4995, 10, 1);
+  interval.blocks.insert(interval.blocks.end(), fork.begin(), fork.end());
+
+  SynchronizationState::CheckResult result = state.checkInterval(interval);
+  ASSERT_TRUE(result.detachRequired);
+  ASSERT_EQ(4995, result.detachHeight);
+}
+
+TEST(SynchronizationState, savedStateIsLoaded) {
+  SynchronizationState state(blockHash(0));
+  addBlocks(state, 3000);
+
+  std::stringstream stream;
+  state.save(stream);
+  ASSERT_LT(stream.str().size(), 3000 * sizeof(crypto::hash) / 2);
+
+  SynchronizationState loaded(blockHash(0));
+  loaded.load(stream);
+  ASSERT_EQ(state.getHeight(), loaded.getHeight());
+  ASSERT_EQ(state.getShortHistory(3000), loaded.getShortHistory(3000));
+}
+
+TEST(SynchronizationState, fullListOfHashesIsLoaded) {
+  std::vector<crypto::hash> hashes = blockHashes(0, 3001);
+  std::stringstream stream;
+  {
+    BinaryOutputStreamSerializer s(stream);
+    s.beginObject("state");
+    s(hashes, "blockchain");
+    s.endObject();
+  }
+
+  SynchronizationState state(blockHash(0));
+  state.load(stream);
+  ASSERT_EQ(3001, state.getHeight());
+
+  SynchronizationState expected(blockHash(0));
+  addBlocks(expected, 3000);
+  ASSERT_EQ(expected.getShortHistory(3000), state.getShortHistory(3000));
+}
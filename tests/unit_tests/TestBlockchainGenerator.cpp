@@ -53,6 +53,11 @@ public:
     destinations.push_back(tx_destination_entry(amount, address));
     construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, destinations, std::vector<uint8_t>(), tx, 0, m_logger);
   }
+
+  void generateMultiOutputTx(const AccountPublicAddress& address, size_t outputCount, Transaction& tx) {
+    std::vector<tx_destination_entry> destinations(outputCount, tx_destination_entry(this->m_source_amount / outputCount, address));
+    construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, destinations, std::vector<uint8_t>(), tx, 0, m_logger);
+  }
 };
 
 
@@ -181,6 +186,30 @@ bool TestBlockchainGenerator::doGenerateTransactionsInOneBlock(const AccountPubl
   return true;
 }
 
+bool TestBlockchainGenerator::generateOutputsInOneBlock(const std::vector<AccountPublicAddress>& addresses, size_t outputCount) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  TransactionForAddressCreator creator;
+  if (!creator.init())
+    return false;
+
+  std::vector<Transaction> txs;
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    size_t count = outputCount / addresses.size() + (i < outputCount % addresses.size() ? 1 : 0);
+    if (count == 0) {
+      continue;
+    }
+
+    Transaction tx;
+    creator.generateMultiOutputTx(addresses[i], count, tx);
+    txs.push_back(tx);
+  }
+
+  addToBlockchain(txs);
+
+  return true;
+}
+
 bool TestBlockchainGenerator::getSingleOutputTransaction(const CryptoNote::AccountPublicAddress& address, uint64_t amount) {
   std::unique_lock<std::mutex> lock(m_mutex);
 
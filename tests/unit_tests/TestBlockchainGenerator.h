@@ -38,6 +38,8 @@ public:
   void generateEmptyBlocks(size_t count);
   bool getBlockRewardForAddress(const CryptoNote::AccountPublicAddress& address);
   bool generateTransactionsInOneBlock(const CryptoNote::AccountPublicAddress& address, size_t n);
+  // Adds a block with a transaction per address, outputCount outputs are split among them as evenly as possible
+  bool generateOutputsInOneBlock(const std::vector<CryptoNote::AccountPublicAddress>& addresses, size_t outputCount);
   bool getSingleOutputTransaction(const CryptoNote::AccountPublicAddress& address, uint64_t amount);
   void addTxToBlockchain(const CryptoNote::Transaction& transaction);
   bool getTransactionByHash(const crypto::hash& hash, CryptoNote::Transaction& tx, bool checkTxPool = false);
@@ -0,0 +1,78 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/ThreadPool.h"
+
+#include <atomic>
+#include <stdexcept>
+
+using namespace Common;
+
+TEST(ThreadPool, addTaskRunsTask) {
+  ThreadPool pool(2);
+  std::atomic<int> counter(0);
+  auto f1 = pool.addTask([&] { ++counter; });
+  auto f2 = pool.addTask([&] { ++counter; });
+  f1.get();
+  f2.get();
+  ASSERT_EQ(2, counter.load());
+}
+
+TEST(ThreadPool, parallelForVisitsEveryIndexOnce) {
+  ThreadPool pool(3);
+  std::vector<std::atomic<int>> visits(1000);
+  for (auto& v : visits) {
+    v = 0;
+  }
+
+  pool.parallelFor(visits.size(), [&](size_t i) { ++visits[i]; });
+  for (auto& v : visits) {
+    ASSERT_EQ(1, v.load());
+  }
+}
+
+TEST(ThreadPool, parallelForWorksWithoutThreads) {
+  ThreadPool pool(0);
+  size_t sum = 0;
+  pool.parallelFor(10, [&](size_t i) { sum += i; });
+  ASSERT_EQ(45, sum);
+}
+
+TEST(ThreadPool, parallelForRethrowsException) {
+  ThreadPool pool(2);
+  ASSERT_THROW(pool.parallelFor(100, [](size_t i) { if (i == 50) throw std::runtime_error("test"); }), std::runtime_error);
+}
+
+TEST(ThreadPool, nestedParallelForDoesNotDeadlock) {
+  ThreadPool pool(2);
+  std::atomic<int> counter(0);
+  pool.parallelFor(4, [&](size_t) {
+    pool.parallelFor(4, [&](size_t) { ++counter; });
+  });
+
+  ASSERT_EQ(16, counter.load());
+}
+
+TEST(ThreadPool, threadInitRunsInEveryThread) {
+  std::atomic<int> counter(0);
+  {
+    ThreadPool pool(3, [&] { ++counter; });
+  }
+
+  ASSERT_EQ(3, counter.load());
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/ThreadTopology.h"
+
+#include <thread>
+
+using namespace Common;
+
+TEST(ThreadTopology, parsesCpus) {
+  std::vector<unsigned> cpus;
+  ASSERT_TRUE(ThreadTopology::parseCpus("4,0-2,1", cpus));
+  ASSERT_EQ(std::vector<unsigned>({ 0, 1, 2, 4 }), cpus);
+
+  ASSERT_TRUE(ThreadTopology::parseCpus("", cpus));
+  ASSERT_TRUE(cpus.empty());
+}
+
+TEST(ThreadTopology, rejectsWrongCpus) {
+  std::vector<unsigned> cpus;
+  ASSERT_FALSE(ThreadTopology::parseCpus("3-1", cpus));
+  ASSERT_FALSE(ThreadTopology::parseCpus("1,,2", cpus));
+  ASSERT_FALSE(ThreadTopology::parseCpus("a", cpus));
+  ASSERT_FALSE(ThreadTopology::parseCpus("-1", cpus));
+  ASSERT_FALSE(ThreadTopology::parseCpus("100000", cpus));
+}
+
+TEST(ThreadTopology, parsesPriority) {
+  ThreadPriority priority;
+  ASSERT_TRUE(ThreadTopology::parsePriority("low", priority));
+  ASSERT_EQ(ThreadPriority::LOW, priority);
+  ASSERT_TRUE(ThreadTopology::parsePriority("high", priority));
+  ASSERT_EQ(ThreadPriority::HIGH, priority);
+  ASSERT_FALSE(ThreadTopology::parsePriority("idle", priority));
+}
+
+TEST(ThreadTopology, keepsPlacementPerClass) {
+  ThreadTopology topology;
+  ThreadPlacement placement;
+  placement.cpus.push_back(0);
+  placement.priority = ThreadPriority::LOW;
+  topology.setPlacement(ThreadClass::MINER, placement);
+
+  ASSERT_EQ(placement.cpus, topology.getPlacement(ThreadClass::MINER).cpus);
+  ASSERT_EQ(ThreadPriority::LOW, topology.getPlacement(ThreadClass::MINER).priority);
+  ASSERT_TRUE(topology.getPlacement(ThreadClass::NETWORK).cpus.empty());
+  ASSERT_EQ(ThreadPriority::NORMAL, topology.getPlacement(ThreadClass::NETWORK).priority);
+}
+
+TEST(ThreadTopology, defaultPlacementIsApplied) {
+  ThreadTopology topology;
+  bool applied = false;
+  std::thread thread([&] { applied = topology.applyToCurrentThread(ThreadClass::VERIFICATION); });
+  thread.join();
+  ASSERT_TRUE(applied);
+}
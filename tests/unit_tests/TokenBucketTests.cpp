@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/TokenBucket.h"
+
+using Common::TokenBucket;
+
+namespace {
+
+const TokenBucket::Clock::time_point START;
+
+}
+
+TEST(TokenBucket, DefaultIsUnlimited)
+{
+  TokenBucket bucket;
+  ASSERT_FALSE(bucket.isLimited());
+  bucket.charge(1000000, START);
+  ASSERT_EQ(TokenBucket::Clock::duration::zero(), bucket.getDelay(START));
+}
+
+TEST(TokenBucket, ZeroRateIsUnlimited)
+{
+  TokenBucket bucket(0, 10, START);
+  ASSERT_FALSE(bucket.isLimited());
+  bucket.charge(100, START);
+  ASSERT_EQ(TokenBucket::Clock::duration::zero(), bucket.getDelay(START));
+}
+
+TEST(TokenBucket, BurstIsFreeDebtIsDelayed)
+{
+  TokenBucket bucket(100, 200, START);
+  ASSERT_TRUE(bucket.isLimited());
+  bucket.charge(200, START);
+  ASSERT_EQ(TokenBucket::Clock::duration::zero(), bucket.getDelay(START));
+
+  bucket.charge(200, START);
+  auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(bucket.getDelay(START));
+  ASSERT_NEAR(2000, delay.count(), 1);
+
+  delay = std::chrono::duration_cast<std::chrono::milliseconds>(bucket.getDelay(START + std::chrono::seconds(1)));
+  ASSERT_NEAR(1000, delay.count(), 1);
+  ASSERT_EQ(TokenBucket::Clock::duration::zero(), bucket.getDelay(START + std::chrono::seconds(2)));
+}
+
+TEST(TokenBucket, RefillStopsAtBurst)
+{
+  TokenBucket bucket(10, 20, START);
+  bucket.charge(15, START);
+  ASSERT_FALSE(bucket.isFull(START + std::chrono::seconds(1)));
+  ASSERT_TRUE(bucket.isFull(START + std::chrono::seconds(2)));
+
+  // idle time beyond the burst isn't saved up
+  auto later = START + std::chrono::seconds(100);
+  bucket.charge(30, later);
+  ASSERT_NE(TokenBucket::Clock::duration::zero(), bucket.getDelay(later));
+  ASSERT_EQ(TokenBucket::Clock::duration::zero(), bucket.getDelay(later + std::chrono::seconds(1)));
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/TrackingKeysFilter.h"
+
+#include "cryptonote_core/TransactionApi.h"
+#include "TransactionApiHelpers.h"
+
+using namespace CryptoNote;
+
+namespace {
+TrackingKey toTrackingKey(const AccountKeys& keys) {
+  TrackingKey key;
+  key.viewSecretKey = reinterpret_cast<const crypto::secret_key&>(keys.viewSecretKey);
+  key.spendPublicKey = reinterpret_cast<const crypto::public_key&>(keys.address.spendPublicKey);
+  return key;
+}
+
+AccountKeys generateAccountKeysWithViewKey(const AccountKeys& viewKeys) {
+  AccountKeys keys = generateAccountKeys();
+  keys.address.viewPublicKey = viewKeys.address.viewPublicKey;
+  keys.viewSecretKey = viewKeys.viewSecretKey;
+  return keys;
+}
+
+Transaction toTransaction(const ITransaction& tx) {
+  Blob data = tx.getTransactionData();
+  Transaction transaction;
+  parse_and_validate_tx_from_blob(blobdata(data.begin(), data.end()), transaction); // unsigned, only prefix is needed
+  return transaction;
+}
+}
+
+TEST(TrackingKeysFilter, findsOutputsOfAllTrackedAddresses) {
+  AccountKeys account1 = generateAccountKeys();
+  AccountKeys account2 = generateAccountKeysWithViewKey(account1);
+  AccountKeys account3 = generateAccountKeys();
+
+  auto tx = createTransaction();
+  addTestInput(*tx, 1000);
+  tx->addOutput(100, account1.address);
+  tx->addOutput(200, generateAccountKeys().address);
+  tx->addOutput(300, account2.address);
+  tx->addOutput(400, account3.address);
+  tx->addOutput(500, generateAccountKeysWithViewKey(account1).address);
+
+  TrackingKeysFilter filter({ toTrackingKey(account1), toTrackingKey(account2), toTrackingKey(account3) });
+  std::vector<size_t> outputs;
+  ASSERT_TRUE(filter.findOutputs(toTransaction(*tx), outputs));
+  ASSERT_EQ(std::vector<size_t>({ 0, 2, 3 }), outputs);
+}
+
+TEST(TrackingKeysFilter, findsMultisignatureOutputs) {
+  AccountKeys account = generateAccountKeys();
+
+  auto tx = createTransaction();
+  addTestInput(*tx, 1000);
+  tx->addOutput(100, account.address);
+  tx->addOutput(200, generateAccountKeys().address);
+  tx->addOutput(300, { generateAccountKeys().address, account.address }, 2);
+
+  TrackingKeysFilter filter({ toTrackingKey(account) });
+  std::vector<size_t> outputs;
+  ASSERT_TRUE(filter.findOutputs(toTransaction(*tx), outputs));
+  ASSERT_EQ(std::vector<size_t>({ 0, 2 }), outputs);
+}
+
+TEST(TrackingKeysFilter, ignoresOtherTransactions) {
+  auto tx = createTransaction();
+  addTestInput(*tx, 1000);
+  tx->addOutput(100, generateAccountKeys().address);
+
+  std::vector<size_t> outputs;
+  ASSERT_FALSE(TrackingKeysFilter({ toTrackingKey(generateAccountKeys()) }).findOutputs(toTransaction(*tx), outputs));
+
+  TrackingKeysFilter emptyFilter({});
+  ASSERT_TRUE(emptyFilter.empty());
+  ASSERT_FALSE(emptyFilter.findOutputs(toTransaction(*tx), outputs));
+  ASSERT_TRUE(outputs.empty());
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "Common/TrafficLog.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+using namespace Common;
+
+namespace {
+
+class TrafficLogTest : public ::testing::Test {
+public:
+  TrafficLogTest() : m_path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()) {
+  }
+
+  ~TrafficLogTest() {
+    boost::system::error_code ec;
+    boost::filesystem::remove(m_path, ec);
+  }
+
+  std::string path() const {
+    return m_path.string();
+  }
+
+private:
+  boost::filesystem::path m_path;
+};
+
+}
+
+TEST_F(TrafficLogTest, recordsAreReadBackInOrder)
+{
+  TrafficLogWriter writer;
+  ASSERT_TRUE(writer.open(path()));
+  writer.write(TrafficRecord::P2P, TrafficRecord::NOTIFY, 2001, 7, std::string(), std::string("block\0blob", 10));
+  writer.write(TrafficRecord::RPC, 0, 0, 0x7f000001, "/getinfo", "");
+  writer.close();
+
+  TrafficLogReader reader;
+  ASSERT_TRUE(reader.open(path()));
+  TrafficRecord record;
+  ASSERT_TRUE(reader.read(record));
+  ASSERT_EQ(TrafficRecord::P2P, record.kind);
+  ASSERT_EQ(TrafficRecord::NOTIFY, record.flags);
+  ASSERT_EQ(2001, record.command);
+  ASSERT_EQ(7, record.stream);
+  ASSERT_TRUE(record.url.empty());
+  ASSERT_EQ(std::string("block\0blob", 10), record.body);
+  uint64_t firstTime = record.time;
+
+  ASSERT_TRUE(reader.read(record));
+  ASSERT_EQ(TrafficRecord::RPC, record.kind);
+  ASSERT_EQ(0x7f000001, record.stream);
+  ASSERT_EQ("/getinfo", record.url);
+  ASSERT_TRUE(record.body.empty());
+  ASSERT_LE(firstTime, record.time);
+
+  ASSERT_FALSE(reader.read(record));
+  ASSERT_FALSE(reader.failed());
+}
+
+TEST_F(TrafficLogTest, truncatedRecordFails)
+{
+  TrafficLogWriter writer;
+  ASSERT_TRUE(writer.open(path()));
+  writer.write(TrafficRecord::RPC, 0, 0, 1, "/getheight", "{}");
+  writer.close();
+  boost::filesystem::resize_file(path(), boost::filesystem::file_size(path()) - 1);
+
+  TrafficLogReader reader;
+  ASSERT_TRUE(reader.open(path()));
+  TrafficRecord record;
+  ASSERT_FALSE(reader.read(record));
+  ASSERT_TRUE(reader.failed());
+}
+
+TEST_F(TrafficLogTest, otherFilesAreRejected)
+{
+  std::ofstream(path()) << "not a traffic log";
+  TrafficLogReader reader;
+  ASSERT_FALSE(reader.open(path()));
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "cryptonote_core/TransactionAdmissionCache.h"
+
+using namespace CryptoNote;
+
+namespace {
+crypto::hash makeHash(unsigned char value) {
+  crypto::hash hash = crypto::hash();
+  reinterpret_cast<unsigned char*>(&hash)[0] = value;
+  return hash;
+}
+}
+
+TEST(TransactionAdmissionCache, remembersAcceptedAndRejected) {
+  TransactionAdmissionCache cache(10);
+  cache.addAccepted(makeHash(1), makeHash(101));
+  cache.addRejected(makeHash(2));
+
+  crypto::hash transactionId;
+  ASSERT_TRUE(cache.getAccepted(makeHash(1), transactionId));
+  ASSERT_EQ(makeHash(101), transactionId);
+  ASSERT_FALSE(cache.isRejected(makeHash(1)));
+  ASSERT_TRUE(cache.isRejected(makeHash(2)));
+  ASSERT_FALSE(cache.getAccepted(makeHash(2), transactionId));
+  ASSERT_FALSE(cache.isRejected(makeHash(3)));
+}
+
+TEST(TransactionAdmissionCache, clearRejectedKeepsAccepted) {
+  TransactionAdmissionCache cache(10);
+  cache.addAccepted(makeHash(1), makeHash(101));
+  cache.addRejected(makeHash(2));
+  cache.clearRejected();
+
+  crypto::hash transactionId;
+  ASSERT_EQ(1, cache.size());
+  ASSERT_TRUE(cache.getAccepted(makeHash(1), transactionId));
+  ASSERT_FALSE(cache.isRejected(makeHash(2)));
+}
+
+TEST(TransactionAdmissionCache, laterResultReplacesEarlier) {
+  TransactionAdmissionCache cache(10);
+  cache.addRejected(makeHash(1));
+  cache.addAccepted(makeHash(1), makeHash(101));
+
+  crypto::hash transactionId;
+  ASSERT_EQ(1, cache.size());
+  ASSERT_FALSE(cache.isRejected(makeHash(1)));
+  ASSERT_TRUE(cache.getAccepted(makeHash(1), transactionId));
+}
+
+TEST(TransactionAdmissionCache, evictsOldestEntries) {
+  TransactionAdmissionCache cache(2);
+  cache.addRejected(makeHash(1));
+  cache.addRejected(makeHash(2));
+  cache.addRejected(makeHash(3));
+
+  ASSERT_EQ(2, cache.size());
+  ASSERT_FALSE(cache.isRejected(makeHash(1)));
+  ASSERT_TRUE(cache.isRejected(makeHash(3)));
+}
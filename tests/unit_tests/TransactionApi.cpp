@@ -21,6 +21,7 @@
 #include "cryptonote_core/cryptonote_format_utils.h" // TODO: delete
 #include "cryptonote_core/account.h"
 #include "crypto/crypto.h"
+#include "Common/StringTools.h"
 #include "TransactionApiHelpers.h"
 
 using namespace CryptoNote;
@@ -147,6 +148,63 @@ TEST_F(TransactionApi, addAndSignInput) {
   EXPECT_NO_FATAL_FAILURE(checkHashChanged());
 }
 
+TEST_F(TransactionApi, signInputKeys) {
+  std::vector<std::pair<TransactionTypes::InputKeyInfo, TransactionTypes::KeyPair>> inputs;
+  for (size_t i = 0; i < 3; ++i) {
+    TransactionTypes::InputKeyInfo info = createInputInfo(1000);
+    TransactionTypes::KeyPair ephKeys;
+    tx->addInput(sender, info, ephKeys);
+    inputs.push_back(std::make_pair(info, ephKeys));
+  }
+
+  auto prefixHash = tx->getTransactionPrefixHash();
+  tx->signInputKeys(inputs);
+
+  ASSERT_TRUE(tx->validateSignatures());
+  // signatures are not part of the prefix
+  ASSERT_EQ(prefixHash, tx->getTransactionPrefixHash());
+  ASSERT_EQ(prefixHash, reloadedTx(tx)->getTransactionPrefixHash());
+  ASSERT_EQ(tx->getTransactionHash(), reloadedTx(tx)->getTransactionHash());
+  EXPECT_NO_FATAL_FAILURE(checkHashChanged());
+}
+
+TEST_F(TransactionApi, signInputKeysMatchesSignInputKey) {
+  // both transactions get the same key and inputs, so they have the same prefix
+  auto txByOne = reloadedTx(tx);
+  std::vector<std::pair<TransactionTypes::InputKeyInfo, TransactionTypes::KeyPair>> inputs;
+  for (size_t i = 0; i < 3; ++i) {
+    TransactionTypes::InputKeyInfo info = createInputInfo(1000);
+    TransactionTypes::KeyPair ephKeys;
+    tx->addInput(sender, info, ephKeys);
+    txByOne->addInput(sender, info, ephKeys);
+    inputs.push_back(std::make_pair(info, ephKeys));
+  }
+
+  tx->signInputKeys(inputs);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    txByOne->signInputKey(i, inputs[i].first, inputs[i].second);
+  }
+
+  ASSERT_TRUE(tx->validateSignatures());
+  ASSERT_TRUE(txByOne->validateSignatures());
+
+  CryptoNote::Transaction batchSigned;
+  CryptoNote::Transaction oneByOneSigned;
+  ASSERT_TRUE(parse_and_validate_tx_from_blob(Common::asString(tx->getTransactionData()), batchSigned));
+  ASSERT_TRUE(parse_and_validate_tx_from_blob(Common::asString(txByOne->getTransactionData()), oneByOneSigned));
+  ASSERT_EQ(get_transaction_prefix_hash(oneByOneSigned), get_transaction_prefix_hash(batchSigned));
+  ASSERT_EQ(oneByOneSigned.signatures.size(), batchSigned.signatures.size());
+  for (size_t i = 0; i < batchSigned.signatures.size(); ++i) {
+    ASSERT_EQ(oneByOneSigned.signatures[i].size(), batchSigned.signatures[i].size());
+  }
+
+  // ring signatures are randomized, so the ones signInputKey made have to be valid in place of the batch ones
+  batchSigned.signatures = oneByOneSigned.signatures;
+  auto swapped = createTransaction(batchSigned);
+  ASSERT_TRUE(swapped->validateSignatures());
+  ASSERT_EQ(txByOne->getTransactionHash(), swapped->getTransactionHash());
+}
+
 TEST_F(TransactionApi, addAndSignInputMsig) {
 
   TransactionTypes::InputMultisignature inputMsig;
@@ -448,6 +448,56 @@ TEST_decode_addr_neg("111111", decode_fails_due_address_too_short_3);
 TEST_decode_addr_neg("999999", decode_fails_due_address_too_short_4);
 TEST_decode_addr_neg("ZZZZZZ", decode_fails_due_address_too_short_5);
 
+TEST(base58_buffer, encodes_same_as_string)
+{
+  std::string data;
+  for (size_t size = 0; size < 80; ++size)
+  {
+    std::string enc(base58::encoded_size(data.size()), '\0');
+    base58::encode(data.data(), data.size(), &enc[0]);
+    ASSERT_EQ(base58::encode(data), enc);
+
+    char dec[80];
+    size_t dec_size;
+    ASSERT_TRUE(base58::decode(enc.data(), enc.size(), dec, sizeof(dec), dec_size));
+    ASSERT_EQ(data, std::string(dec, dec_size));
+
+    data.push_back(static_cast<char>(size * 37 + 255));
+  }
+}
+
+TEST(base58_buffer, decode_fails_on_small_capacity)
+{
+  char dec[8];
+  size_t dec_size;
+  ASSERT_FALSE(base58::decode("jpXCZedGfVQ", 11, dec, sizeof(dec) - 1, dec_size));
+  ASSERT_TRUE(base58::decode("jpXCZedGfVQ", 11, dec, sizeof(dec), dec_size));
+  ASSERT_EQ(sizeof(dec), dec_size);
+}
+
+TEST(base58_buffer, encodes_addr_same_as_string)
+{
+  std::string data = MAKE_STR("\x11\x22\x33\x44\x55\x66\x77");
+  base58::addr_buffer addr;
+  ASSERT_TRUE(base58::encode_addr(6, data.data(), data.size(), addr));
+  ASSERT_EQ(std::string("21rhHRT48LN4PriP9"), std::string(addr.getData(), addr.getSize()));
+
+  uint64_t tag;
+  char dec[base58::max_addr_size];
+  size_t dec_size;
+  ASSERT_TRUE(base58::decode_addr(addr.getData(), addr.getSize(), tag, dec, sizeof(dec), dec_size));
+  ASSERT_EQ(6, tag);
+  ASSERT_EQ(data, std::string(dec, dec_size));
+  ASSERT_FALSE(base58::decode_addr("11efCaY6UjG7JrxuC", 17, tag, dec, sizeof(dec), dec_size));
+}
+
+TEST(base58_buffer, encode_addr_fails_on_long_data)
+{
+  std::string data(base58::max_addr_size, '\x01');
+  base58::addr_buffer addr;
+  ASSERT_FALSE(base58::encode_addr(0, data.data(), data.size(), addr));
+}
+
 namespace
 {
   std::string test_serialized_keys = MAKE_STR(
@@ -507,6 +507,26 @@ TEST(BinarySerializationCompatibility, BlockVersion2) {
   checkCompatibility(block);
 }
 
+TEST(BinarySerializationCompatibility, longhashBlobNoncePatching) {
+  for (uint8_t majorVersion : {CryptoNote::BLOCK_MAJOR_VERSION_1, CryptoNote::BLOCK_MAJOR_VERSION_2}) {
+    CryptoNote::Block block;
+    fillBlockHeaderVersion1(block);
+    block.majorVersion = majorVersion;
+    fillParentBlock(block.parentBlock);
+    fillTransaction(block.minerTx);
+
+    CryptoNote::blobdata blob;
+    size_t nonceOffset;
+    ASSERT_TRUE(CryptoNote::get_block_longhash_blob(block, blob, nonceOffset));
+
+    block.nonce = 0x01020304;
+    CryptoNote::set_block_longhash_blob_nonce(blob, nonceOffset, block.nonce);
+    CryptoNote::blobdata expected;
+    ASSERT_TRUE(CryptoNote::get_block_longhash_blob(block, expected));
+    ASSERT_EQ(expected, blob);
+  }
+}
+
 TEST(BinarySerializationCompatibility, account_public_address) {
   CryptoNote::AccountPublicAddress addr;
 
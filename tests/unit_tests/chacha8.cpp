@@ -95,3 +95,37 @@ TEST_CHACHA8(0)
 TEST_CHACHA8(1)
 TEST_CHACHA8(2)
 TEST_CHACHA8(3)
+
+// Inputs of four blocks and more are encrypted four blocks at a time where supported, the rest block by block.
+// Every block of a long keystream is compared with the same block produced as the tail of a shorter one.
+TEST(chacha8, long_inputs_match_block_by_block)
+{
+  uint8_t key[CHACHA8_KEY_SIZE];
+  uint8_t iv[CHACHA8_IV_SIZE];
+  for (size_t i = 0; i < sizeof(key); ++i) {
+    key[i] = static_cast<uint8_t>(i * 7 + 1);
+  }
+
+  for (size_t i = 0; i < sizeof(iv); ++i) {
+    iv[i] = static_cast<uint8_t>(i * 13 + 5);
+  }
+
+  const size_t length = 1000;
+  std::string plain(length, '\0');
+  for (size_t i = 0; i < length; ++i) {
+    plain[i] = static_cast<char>(i);
+  }
+
+  std::string cipher(length, '\0');
+  crypto::chacha8(plain.data(), length, key, iv, &cipher[0]);
+  for (size_t prefix = 1; prefix < length; ++prefix) {
+    std::string prefixCipher(prefix, '\0');
+    crypto::chacha8(plain.data(), prefix, key, iv, &prefixCipher[0]);
+    ASSERT_EQ(cipher.substr(0, prefix), prefixCipher) << "prefix " << prefix;
+  }
+
+  // in place
+  std::string buffer = plain;
+  crypto::chacha8(buffer.data(), length, key, iv, &buffer[0]);
+  ASSERT_EQ(cipher, buffer);
+}
@@ -23,12 +23,15 @@
 #include <boost/foreach.hpp>
 #include "cryptonote_core/cryptonote_basic.h"
 #include "cryptonote_core/cryptonote_basic_impl.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
 #include "serialization/serialization.h"
 #include "serialization/binary_archive.h"
 #include "serialization/json_archive.h"
 #include "serialization/variant.h"
 #include "serialization/vector.h"
 #include "serialization/binary_utils.h"
+#include "Common/MemoryStreambuf.h"
+#include "Common/varint.h"
 #include "gtest/gtest.h"
 using namespace std;
 
@@ -136,6 +139,79 @@ TEST(Serialization, BinaryArchiveVarInts) {
   ASSERT_EQ(x, x1);
 }
 
+namespace {
+
+template <typename T>
+void checkBufferVarint(const string& data) {
+  const unsigned char* begin = reinterpret_cast<const unsigned char*>(data.data());
+  const unsigned char* end = begin + data.size();
+  const unsigned char* position = begin;
+  T expected;
+  int expectedSize = tools::read_varint<numeric_limits<T>::digits>(position, end, expected);
+  T value;
+  size_t size = tools::read_varint_buffer(begin, end, value);
+  if (expectedSize > 0 && (data[expectedSize - 1] & 0x80) == 0) {
+    ASSERT_EQ(expectedSize, size) << "data size " << data.size();
+    ASSERT_EQ(expected, value);
+  } else {
+    ASSERT_EQ(0, size) << "data size " << data.size();
+  }
+}
+
+}
+
+TEST(Serialization, BufferVarintsMatchByteByByteReading) {
+  vector<string> inputs;
+  for (uint64_t value : { 0ULL, 1ULL, 0x7fULL, 0x80ULL, 0xffULL, 0x3fffULL, 0x4000ULL, 0xffffULL, 0x10000ULL, 0xffffffffULL,
+      0x100000000ULL, 0xff00000000ULL, 0x7fffffffffffffffULL, 0xffffffffffffffffULL }) {
+    string data = tools::get_varint_data(value);
+    inputs.push_back(data);
+    inputs.push_back(data + "\x05");
+    for (size_t size = 1; size < data.size(); ++size) {
+      inputs.push_back(data.substr(0, size));
+    }
+  }
+
+  // padded, overlong and empty representations
+  inputs.push_back(string("\x80\x00", 2));
+  inputs.push_back(string("\xff\x80\x00", 3));
+  inputs.push_back(string("\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02", 10));
+  inputs.push_back(string("\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", 11));
+  inputs.push_back(string("\xff\xff\xff\xff\x10", 5));
+  inputs.push_back(string("\xff\x02", 2));
+  inputs.push_back(string());
+
+  for (const string& data : inputs) {
+    checkBufferVarint<uint8_t>(data);
+    checkBufferVarint<uint16_t>(data);
+    checkBufferVarint<uint32_t>(data);
+    checkBufferVarint<uint64_t>(data);
+  }
+}
+
+TEST(Serialization, BinaryArchiveReadsVarintsFromMemory) {
+  string data = tools::get_varint_data(uint64_t(0xff00000000)) + tools::get_varint_data(uint64_t(300)) + string("\x80\x00\x05", 3);
+
+  Common::MemoryStreambuf buffer(data.data(), data.size());
+  istream stream(&buffer);
+  binary_archive<false> archive(stream);
+  uint64_t value;
+  archive.serialize_varint(value);
+  ASSERT_EQ(0xff00000000, value);
+  archive.serialize_varint(value);
+  ASSERT_EQ(300, value);
+  ASSERT_TRUE(archive.canonical_varints());
+
+  // padded value falls back to the byte by byte reader, which marks it
+  archive.serialize_varint(value);
+  ASSERT_EQ(0, value);
+  ASSERT_FALSE(archive.canonical_varints());
+  ASSERT_EQ(1, archive.remaining_bytes());
+  archive.serialize_varint(value);
+  ASSERT_EQ(5, value);
+  ASSERT_EQ(0, archive.remaining_bytes());
+}
+
 TEST(Serialization, Test1) {
   ostringstream str;
   binary_archive<true> ar(str);
@@ -425,3 +501,50 @@ TEST(Serialization, serializes_transacion_signatures_correctly)
   blob.resize(blob.size() + sizeof(crypto::signature) / 2);
   ASSERT_FALSE(serialization::parse_binary(blob, tx1));
 }
+
+TEST(Serialization, parsed_transaction_hashes_match_serialized_ones)
+{
+  using namespace CryptoNote;
+
+  Transaction tx;
+  tx.version = CURRENT_TRANSACTION_VERSION;
+  for (uint64_t i = 0; i < 2; ++i) {
+    TransactionInputToKey input;
+    input.amount = 1000 + i;
+    input.keyOffsets = { 1, 2, 300 };
+    tx.vin.push_back(input);
+  }
+
+  tx.signatures.resize(2);
+  for (auto& signatures : tx.signatures) {
+    signatures.resize(3);
+    for (auto& signature : signatures) {
+      memset(&signature, static_cast<int>(&signature - signatures.data()) + 1, sizeof(signature));
+    }
+  }
+
+  blobdata blob = tx_to_blob(tx);
+  Transaction tx1;
+  crypto::hash hash;
+  crypto::hash prefixHash;
+  ASSERT_TRUE(parse_and_validate_tx_from_blob(blob, tx1, hash, prefixHash));
+  ASSERT_EQ(tx, tx1);
+  ASSERT_EQ(get_transaction_hash(tx), hash);
+  ASSERT_EQ(get_transaction_prefix_hash(tx), prefixHash);
+
+  crypto::hash serializedHash;
+  crypto::hash serializedPrefixHash;
+  size_t blobSize;
+  ASSERT_TRUE(get_transaction_hashes(tx, serializedHash, serializedPrefixHash, blobSize));
+  ASSERT_EQ(hash, serializedHash);
+  ASSERT_EQ(prefixHash, serializedPrefixHash);
+  ASSERT_EQ(blob.size(), blobSize);
+
+  // zero unlock time padded to two bytes is still read, prefix hash has to be taken from the prefix written back
+  ASSERT_EQ(0, blob[1]);
+  blobdata paddedBlob = blob.substr(0, 1) + std::string("\x80\x00", 2) + blob.substr(2);
+  ASSERT_TRUE(parse_and_validate_tx_from_blob(paddedBlob, tx1, hash, prefixHash));
+  ASSERT_EQ(tx, tx1);
+  ASSERT_EQ(get_blob_hash(paddedBlob), hash);
+  ASSERT_EQ(get_transaction_prefix_hash(tx), prefixHash);
+}
@@ -238,3 +238,36 @@ TEST(KVSerialize, NewWriterOldReader) {
 
 
 }
+
+TEST(KVSerialize, MissingArrayIsEmpty) {
+  TestStruct s1;
+  s1.vec1.resize(3);
+  s1.vec1[1].name = "second";
+  std::string buf;
+  epee::serialization::store_t_to_binary(s1, buf);
+
+  TestStruct s2;
+  s2.vec2.resize(5);
+  std::stringstream s(buf);
+  KVBinaryInputStreamSerializer kvInput(s);
+  kvInput.parse();
+  kvInput(s2, "");
+
+  EXPECT_EQ(s1, s2);
+  EXPECT_TRUE(s2.vec2.empty());
+}
+
+TEST(KVSerialize, TruncatedDataIsRejected) {
+  TestStruct s1;
+  s1.vec1.resize(3);
+  s1.root.name = "somename";
+  std::string buf;
+  epee::serialization::store_t_to_binary(s1, buf);
+
+  for (size_t size = 0; size < buf.size(); size += 7) {
+    std::stringstream s(buf.substr(0, size));
+    KVBinaryInputStreamSerializer kvInput(s);
+    TestStruct s2;
+    EXPECT_THROW({ kvInput.parse(); kvInput(s2, ""); }, std::runtime_error);
+  }
+}
@@ -1303,25 +1303,28 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
   generator.generateEmptyBlocks(20);
   m_node.setGetNewBlocksLimit(10);
   
-  int requestsCount = 0;
-  std::list<crypto::hash> firstlyKnownBlockIdsTaken;
-  std::list<crypto::hash> secondlyKnownBlockIdsTaken;
+  // the next batch may be requested before the current one is processed, so batches are counted by consumer calls
+  int callsCount = 0;
+  std::vector<std::list<crypto::hash>> knownBlockIdsTaken;
+  size_t requestsBeforeError = 0;
 
   std::vector<crypto::hash> firstlyReceivedBlocks;
   std::vector<crypto::hash> secondlyReceivedBlocks;
 
 
   c.onNewBlocksFunctor = [&](const CompleteBlock* blocks, uint64_t, size_t count) -> bool {
+    ++callsCount;
 
-    if (requestsCount == 2) {
+    if (callsCount == 2) {
       for (size_t i = 0; i < count; ++i) {
         firstlyReceivedBlocks.push_back(blocks[i].blockHash);
       }
 
+      requestsBeforeError = knownBlockIdsTaken.size();
       return false;
     }
 
-    if (requestsCount == 3) {
+    if (callsCount == 3) {
       for (size_t i = 0; i < count; ++i) {
         secondlyReceivedBlocks.push_back(blocks[i].blockHash);
       }
@@ -1331,16 +1334,7 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
   };
 
   m_node.queryBlocksFunctor = [&](const std::list<crypto::hash>& knownBlockIds, uint64_t timestamp, std::list<CryptoNote::BlockCompleteEntry>& newBlocks, uint64_t& startHeight, const INode::Callback& callback) -> bool {
-    if (requestsCount == 1) {
-      firstlyKnownBlockIdsTaken.assign(knownBlockIds.begin(), knownBlockIds.end());
-    }
-
-    if (requestsCount == 2) {
-      secondlyKnownBlockIdsTaken.assign(knownBlockIds.begin(), knownBlockIds.end());
-    }
-
-
-    ++requestsCount;
+    knownBlockIdsTaken.push_back(knownBlockIds);
     return true;
   };
 
@@ -1356,10 +1350,63 @@ TEST_F(BcSTest, checkBlocksRerequestingOnError) {
   m_sync.removeObserver(&o1);
   o1.syncFunc = [](std::error_code) {};
 
-  EXPECT_EQ(firstlyKnownBlockIdsTaken, secondlyKnownBlockIdsTaken);
+  // the failed batch came from the second request, the first request after the error must repeat it
+  ASSERT_GT(knownBlockIdsTaken.size(), requestsBeforeError);
+  ASSERT_GE(requestsBeforeError, 2);
+  EXPECT_EQ(knownBlockIdsTaken[1], knownBlockIdsTaken[requestsBeforeError]);
+
+  EXPECT_FALSE(firstlyReceivedBlocks.empty());
   EXPECT_EQ(firstlyReceivedBlocks, secondlyReceivedBlocks);
 }
 
+TEST_F(BcSTest, nextBlocksAreRequestedWhileBlocksAreProcessed) {
+  FunctorialBlockhainConsumerStub c(m_currency.genesisBlockHash());
+  IBlockchainSynchronizerFunctorialObserver o1;
+  EventWaiter e;
+  o1.syncFunc = [&](std::error_code) {
+    e.notify();
+  };
+
+  generator.generateEmptyBlocks(20);
+  m_node.setGetNewBlocksLimit(10);
+
+  size_t queriesCount = 0;
+  std::vector<size_t> queriesBeforeProcessing;
+  std::vector<crypto::hash> receivedBlocks;
+
+  m_node.queryBlocksFunctor = [&](const std::list<crypto::hash>&, uint64_t, std::list<CryptoNote::BlockCompleteEntry>&, uint64_t&, const INode::Callback&) -> bool {
+    ++queriesCount;
+    return true;
+  };
+
+  c.onNewBlocksFunctor = [&](const CompleteBlock* blocks, uint64_t, size_t count) -> bool {
+    queriesBeforeProcessing.push_back(queriesCount);
+    for (size_t i = 0; i < count; ++i) {
+      receivedBlocks.push_back(blocks[i].blockHash);
+    }
+
+    return true;
+  };
+
+  m_sync.addObserver(&o1);
+  m_sync.addConsumer(&c);
+  m_sync.start();
+  e.wait();
+  m_sync.stop();
+  m_sync.removeObserver(&o1);
+  o1.syncFunc = [](std::error_code) {};
+
+  ASSERT_LE(2, queriesBeforeProcessing.size());
+  EXPECT_EQ(2, queriesBeforeProcessing[0]);
+  EXPECT_EQ(3, queriesBeforeProcessing[1]);
+
+  // genesis block is known to the consumer from the start
+  ASSERT_EQ(generator.getBlockchain().size() - 1, receivedBlocks.size());
+  for (size_t i = 0; i < receivedBlocks.size(); ++i) {
+    EXPECT_EQ(CryptoNote::get_block_hash(generator.getBlockchain()[i + 1]), receivedBlocks[i]);
+  }
+}
+
 TEST_F(BcSTest, checkTxOrder) {
   FunctorialBlockhainConsumerStub c(m_currency.genesisBlockHash());
   IBlockchainSynchronizerFunctorialObserver o1;
@@ -94,6 +94,7 @@ protected:
   TestBlockchainGenerator m_generator;
   INodeTrivialRefreshStub m_node;
   AccountKeys m_accountKeys;
+  Common::ThreadPool m_scanningPool;
   TransfersConsumer m_consumer;
 };
 
@@ -102,7 +103,8 @@ TransfersConsumerTest::TransfersConsumerTest() :
   m_generator(m_currency),
   m_node(m_generator),
   m_accountKeys(generateAccountKeys()),
-  m_consumer(m_currency, m_node, m_accountKeys.viewSecretKey)
+  m_scanningPool(2),
+  m_consumer(m_currency, m_node, m_accountKeys.viewSecretKey, m_scanningPool)
 {
 }
 
@@ -421,7 +423,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_getTransactionOutsGlobalIndicesError)
 
   INodeGlobalIndicesStub node;
 
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey, m_scanningPool);
 
   auto subscription = getAccountSubscriptionWithSyncStart(m_accountKeys, 1234, 10);
 
@@ -500,6 +502,73 @@ TEST_F(TransfersConsumerTest, onNewBlocks_DifferentSubscribers) {
   ASSERT_EQ(amount2, outs2[0].amount);
 }
 
+TEST_F(TransfersConsumerTest, onNewBlocks_DifferentViewKeys) {
+  TransfersConsumer consumer(m_currency, m_node, m_scanningPool);
+  auto& container1 = addSubscription(consumer).getContainer();
+
+  auto keys2 = generateAccountKeys();
+  auto& container2 = addSubscription(consumer, keys2).getContainer();
+
+  // two subscriptions with the same view key and one with another
+  auto keys3 = getAccountKeysWithViewKey(keys2.address.viewPublicKey, keys2.viewSecretKey);
+  auto& container3 = addSubscription(consumer, keys3).getContainer();
+
+  std::shared_ptr<ITransaction> tx(createTransaction());
+  addTestInput(*tx, 10000);
+  addTestKeyOutput(*tx, 900, 0, m_accountKeys);
+  addTestKeyOutput(*tx, 850, 1, keys2);
+  addTestKeyOutput(*tx, 800, 2, keys3);
+  addTestKeyOutput(*tx, 750, 3, generateAccountKeys());
+
+  CompleteBlock block;
+  block.block = CryptoNote::Block();
+  block.block->timestamp = 0;
+  block.transactions.push_back(tx);
+
+  ASSERT_TRUE(consumer.onNewBlocks(&block, 0, 1));
+
+  auto outs1 = container1.getTransactionOutputs(tx->getTransactionHash(), ITransfersContainer::IncludeAll);
+  ASSERT_EQ(1, outs1.size());
+  ASSERT_EQ(900, outs1[0].amount);
+
+  auto outs2 = container2.getTransactionOutputs(tx->getTransactionHash(), ITransfersContainer::IncludeAll);
+  ASSERT_EQ(1, outs2.size());
+  ASSERT_EQ(850, outs2[0].amount);
+
+  auto outs3 = container3.getTransactionOutputs(tx->getTransactionHash(), ITransfersContainer::IncludeAll);
+  ASSERT_EQ(1, outs3.size());
+  ASSERT_EQ(800, outs3[0].amount);
+}
+
+TEST_F(TransfersConsumerTest, removeSubscription_DifferentViewKeys) {
+  TransfersConsumer consumer(m_currency, m_node, m_scanningPool);
+  addSubscription(consumer);
+
+  auto keys = generateAccountKeys();
+  auto& container = addSubscription(consumer, keys).getContainer();
+
+  ASSERT_FALSE(consumer.removeSubscription(m_accountKeys.address));
+  ASSERT_EQ(nullptr, consumer.getSubscription(m_accountKeys.address));
+
+  std::shared_ptr<ITransaction> tx(createTransaction());
+  addTestInput(*tx, 10000);
+  addTestKeyOutput(*tx, 900, 0, m_accountKeys);
+  addTestKeyOutput(*tx, 850, 1, keys);
+
+  CompleteBlock block;
+  block.block = CryptoNote::Block();
+  block.block->timestamp = 0;
+  block.transactions.push_back(tx);
+
+  ASSERT_TRUE(consumer.onNewBlocks(&block, 0, 1));
+
+  auto outs = container.getTransactionOutputs(tx->getTransactionHash(), ITransfersContainer::IncludeAll);
+  ASSERT_EQ(1, outs.size());
+  ASSERT_EQ(850, outs[0].amount);
+
+  ASSERT_TRUE(consumer.removeSubscription(keys.address));
+}
+
 TEST_F(TransfersConsumerTest, onNewBlocks_MultisignatureTransaction) {
   auto& container1 = addSubscription().getContainer();
 
@@ -540,7 +609,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_getTransactionOutsGlobalIndicesIsPrope
   };
 
   INodeGlobalIndicesStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey, m_scanningPool);
 
   AccountSubscription subscription = getAccountSubscription(m_accountKeys);
   subscription.syncStart.height = 0;
@@ -578,7 +647,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_getTransactionOutsGlobalIndicesIsNotCa
   };
 
   INodeGlobalIndicesStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey, m_scanningPool);
 
   AccountSubscription subscription = getAccountSubscription(m_accountKeys);
   subscription.syncStart.height = 0;
@@ -642,7 +711,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_checkTransactionOutputInformation) {
   const uint64_t index = 2;
 
   INodeGlobalIndexStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey, m_scanningPool);
 
   node.globalIndex = index;
 
@@ -675,7 +744,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_checkTransactionOutputInformationMulti
   const uint64_t index = 2;
 
   INodeGlobalIndexStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey, m_scanningPool);
 
   node.globalIndex = index;
 
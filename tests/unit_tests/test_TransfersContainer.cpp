@@ -1073,6 +1073,75 @@ TEST_F(TransfersContainer_balance, filtersByStateAndKeySimultaneously) {
   ASSERT_EQ(AMOUNT_1 + AMOUNT_2, container.balance(ITransfersContainer::IncludeStateUnlocked | ITransfersContainer::IncludeTypeKey));
 }
 
+TEST_F(TransfersContainer_balance, followsStateChangesWhileHeightGrows) {
+  auto tx1 = createTransaction();
+  tx1->setUnlockTime(TEST_BLOCK_HEIGHT + 5);
+  addTestInput(*tx1, AMOUNT_1 + 1);
+  auto outInfo = addTestKeyOutput(*tx1, AMOUNT_1, TEST_TRANSACTION_OUTPUT_GLOBAL_INDEX, account);
+  std::vector<TransactionOutputInformationIn> outputs = { outInfo };
+  ASSERT_TRUE(container.addTransaction(blockInfo(TEST_BLOCK_HEIGHT), *tx1, outputs));
+  auto tx2 = addTransaction(TEST_BLOCK_HEIGHT + 1, AMOUNT_2);
+
+  for (uint64_t height = TEST_BLOCK_HEIGHT + 1; height < TEST_BLOCK_HEIGHT + 10; ++height) {
+    container.advanceHeight(height);
+    for (uint32_t state : { ITransfersContainer::IncludeStateLocked, ITransfersContainer::IncludeStateSoftLocked, ITransfersContainer::IncludeStateUnlocked }) {
+      std::vector<TransactionOutputInformation> transfers;
+      container.getOutputs(transfers, state | ITransfersContainer::IncludeTypeAll);
+      uint64_t amount = 0;
+      for (const auto& transfer : transfers) {
+        amount += transfer.amount;
+      }
+
+      ASSERT_EQ(amount, container.balance(state | ITransfersContainer::IncludeTypeAll));
+    }
+  }
+
+  ASSERT_EQ(AMOUNT_1 + AMOUNT_2, container.balance(ITransfersContainer::IncludeAllUnlocked));
+  container.detach(TEST_BLOCK_HEIGHT + 1);
+  ASSERT_EQ(AMOUNT_1, container.balance(ITransfersContainer::IncludeStateLocked | ITransfersContainer::IncludeTypeAll));
+}
+
+TEST_F(TransfersContainer_balance, followsStateChangesAfterDetach) {
+  auto checkBalances = [this] {
+    for (uint32_t state : { ITransfersContainer::IncludeStateLocked, ITransfersContainer::IncludeStateSoftLocked, ITransfersContainer::IncludeStateUnlocked }) {
+      std::vector<TransactionOutputInformation> transfers;
+      container.getOutputs(transfers, state | ITransfersContainer::IncludeTypeAll);
+      uint64_t amount = 0;
+      for (const auto& transfer : transfers) {
+        amount += transfer.amount;
+      }
+
+      EXPECT_EQ(amount, container.balance(state | ITransfersContainer::IncludeTypeAll));
+    }
+  };
+
+  for (uint64_t i = 0; i < 3; ++i) {
+    auto tx = createTransaction();
+    tx->setUnlockTime(TEST_BLOCK_HEIGHT + 5 + i * 2);
+    addTestInput(*tx, AMOUNT_1 + 1);
+    auto outInfo = addTestKeyOutput(*tx, AMOUNT_1, TEST_TRANSACTION_OUTPUT_GLOBAL_INDEX + i, account);
+    std::vector<TransactionOutputInformationIn> outputs = { outInfo };
+    ASSERT_TRUE(container.addTransaction(blockInfo(TEST_BLOCK_HEIGHT + i), *tx, outputs));
+  }
+
+  auto tx = addTransaction(TEST_BLOCK_HEIGHT + 3, AMOUNT_2);
+  container.advanceHeight(TEST_BLOCK_HEIGHT + 5);
+  addSpendingTransaction(tx->getTransactionHash(), TEST_BLOCK_HEIGHT + 6, TEST_TRANSACTION_OUTPUT_GLOBAL_INDEX + 10, AMOUNT_2 - 1);
+
+  for (uint64_t height = TEST_BLOCK_HEIGHT + 6; height < TEST_BLOCK_HEIGHT + 12; ++height) {
+    container.advanceHeight(height);
+    checkBalances();
+  }
+
+  // each detach moves back transfers unlocked above the new height and restores the spent one
+  for (uint64_t height : { TEST_BLOCK_HEIGHT + 9, TEST_BLOCK_HEIGHT + 6, TEST_BLOCK_HEIGHT + 4, TEST_BLOCK_HEIGHT + 1 }) {
+    container.detach(height);
+    checkBalances();
+  }
+
+  ASSERT_EQ(AMOUNT_1, container.balance(ITransfersContainer::IncludeStateLocked | ITransfersContainer::IncludeTypeAll));
+}
+
 
 //--------------------------------------------------------------------------- 
 // TransfersContainer_getOutputs
@@ -1207,3 +1276,164 @@ TEST_F(TransfersContainer_getOutputs, filtersByStateAndKeySimultaneously) {
   ASSERT_EQ(1, transfers.size());
   ASSERT_EQ(AMOUNT_1 + AMOUNT_2, transfers.front().amount);
 }
+
+//--------------------------------------------------------------------------- 
+// TransfersContainer_selectOutputs
+//--------------------------------------------------------------------------- 
+class TransfersContainer_selectOutputs : public TransfersContainerTest {
+public:
+  TransfersContainer_selectOutputs() {
+  }
+
+  enum TestAmounts : uint64_t {
+    DUST_THRESHOLD = 10,
+    AMOUNT_DUST = 10,
+    AMOUNT_1 = 30,
+    AMOUNT_2 = 50,
+    AMOUNT_3 = 70
+  };
+
+  void addUnlockedOutputs() {
+    addTransaction(TEST_BLOCK_HEIGHT, AMOUNT_DUST);
+    addTransaction(TEST_BLOCK_HEIGHT, AMOUNT_1);
+    addTransaction(TEST_BLOCK_HEIGHT, AMOUNT_2);
+    addTransaction(TEST_BLOCK_HEIGHT, AMOUNT_3);
+    container.advanceHeight(TEST_CONTAINER_CURRENT_HEIGHT);
+  }
+
+  std::vector<uint64_t> select(uint64_t neededMoney, bool addDust,
+                               const std::function<bool(const TransactionOutputInformation&)>& skip = nullSkip) {
+    std::vector<TransactionOutputInformation> transfers;
+    uint64_t foundMoney = container.selectOutputs(neededMoney, DUST_THRESHOLD, addDust, skip, transfers,
+      ITransfersContainer::IncludeKeyUnlocked);
+
+    std::vector<uint64_t> amounts;
+    uint64_t sum = 0;
+    for (const auto& t : transfers) {
+      amounts.push_back(t.amount);
+      sum += t.amount;
+    }
+
+    EXPECT_EQ(sum, foundMoney);
+    return amounts;
+  }
+
+  static bool nullSkip(const TransactionOutputInformation&) {
+    return false;
+  }
+};
+
+TEST_F(TransfersContainer_selectOutputs, takesExactAmount) {
+  addUnlockedOutputs();
+  ASSERT_EQ(std::vector<uint64_t>({ AMOUNT_1 }), select(AMOUNT_1, false));
+}
+
+TEST_F(TransfersContainer_selectOutputs, takesSmallestCoveringAmount) {
+  addUnlockedOutputs();
+  ASSERT_EQ(std::vector<uint64_t>({ AMOUNT_2 }), select(AMOUNT_1 + 1, false));
+}
+
+TEST_F(TransfersContainer_selectOutputs, takesLargestAmountsIfNoneCovers) {
+  addUnlockedOutputs();
+  ASSERT_EQ(std::vector<uint64_t>({ AMOUNT_3, AMOUNT_2 }), select(AMOUNT_3 + AMOUNT_1 + 1, false));
+}
+
+TEST_F(TransfersContainer_selectOutputs, addsDustFirst) {
+  addUnlockedOutputs();
+  ASSERT_EQ(std::vector<uint64_t>({ AMOUNT_DUST, AMOUNT_1 }), select(AMOUNT_1, true));
+}
+
+TEST_F(TransfersContainer_selectOutputs, usesDustLast) {
+  addUnlockedOutputs();
+  ASSERT_EQ(std::vector<uint64_t>({ AMOUNT_3, AMOUNT_2, AMOUNT_1, AMOUNT_DUST }), select(AMOUNT_3 + AMOUNT_2 + AMOUNT_1 + 1, false));
+}
+
+TEST_F(TransfersContainer_selectOutputs, returnsLessIfNotEnough) {
+  addUnlockedOutputs();
+  std::vector<TransactionOutputInformation> transfers;
+  ASSERT_EQ(AMOUNT_DUST + AMOUNT_1 + AMOUNT_2 + AMOUNT_3, container.selectOutputs(1000, DUST_THRESHOLD, true, nullSkip, transfers,
+    ITransfersContainer::IncludeKeyUnlocked));
+  ASSERT_EQ(4, transfers.size());
+}
+
+TEST_F(TransfersContainer_selectOutputs, skipsRejectedAndLockedOutputs) {
+  addUnlockedOutputs();
+  addTransaction(TEST_CONTAINER_CURRENT_HEIGHT, AMOUNT_1 + 1);
+  addTransaction(UNCONFIRMED_TRANSACTION_HEIGHT, AMOUNT_1 + 1);
+
+  ASSERT_EQ(std::vector<uint64_t>({ AMOUNT_3 }), select(AMOUNT_1 + 1, false, [](const TransactionOutputInformation& t) {
+    return t.amount == AMOUNT_2;
+  }));
+}
+
+//--------------------------------------------------------------------------- 
+// TransfersContainer_getTransfersByHeight
+//--------------------------------------------------------------------------- 
+class TransfersContainer_getTransfersByHeight : public TransfersContainerTest {
+public:
+  struct VisitedTransfer {
+    uint64_t amount;
+    uint64_t blockHeight;
+    bool spent;
+  };
+
+  std::vector<VisitedTransfer> visit(uint64_t firstHeight, uint64_t lastHeight, uint32_t flags, bool includeSpent,
+                                     size_t limit = std::numeric_limits<size_t>::max()) {
+    std::vector<VisitedTransfer> transfers;
+    container.getTransfersByHeight(firstHeight, lastHeight, flags, includeSpent,
+      [&](const TransactionOutputInformation& output, uint64_t blockHeight, bool spent) {
+      transfers.push_back(VisitedTransfer{ output.amount, blockHeight, spent });
+      return transfers.size() < limit;
+    });
+
+    return transfers;
+  }
+};
+
+TEST_F(TransfersContainer_getTransfersByHeight, visitsRangeInHeightOrder) {
+  addTransaction(TEST_BLOCK_HEIGHT, 1);
+  addTransaction(TEST_BLOCK_HEIGHT + 1, 2);
+  addTransaction(TEST_BLOCK_HEIGHT + 2, 3);
+  addTransaction(UNCONFIRMED_TRANSACTION_HEIGHT, 4);
+  container.advanceHeight(TEST_CONTAINER_CURRENT_HEIGHT);
+
+  auto transfers = visit(TEST_BLOCK_HEIGHT + 1, TEST_BLOCK_HEIGHT + 2, ITransfersContainer::IncludeAll, true);
+  ASSERT_EQ(2, transfers.size());
+  ASSERT_EQ(2, transfers[0].amount);
+  ASSERT_EQ(TEST_BLOCK_HEIGHT + 1, transfers[0].blockHeight);
+  ASSERT_EQ(3, transfers[1].amount);
+  ASSERT_EQ(TEST_BLOCK_HEIGHT + 2, transfers[1].blockHeight);
+
+  transfers = visit(TEST_BLOCK_HEIGHT + 2, UNCONFIRMED_TRANSACTION_HEIGHT, ITransfersContainer::IncludeAll, true);
+  ASSERT_EQ(2, transfers.size());
+  ASSERT_EQ(4, transfers[1].amount);
+  ASSERT_EQ(UNCONFIRMED_TRANSACTION_HEIGHT, transfers[1].blockHeight);
+}
+
+TEST_F(TransfersContainer_getTransfersByHeight, stopsWhenVisitorReturnsFalse) {
+  addTransaction(TEST_BLOCK_HEIGHT, 1);
+  addTransaction(TEST_BLOCK_HEIGHT + 1, 2);
+  addTransaction(TEST_BLOCK_HEIGHT + 2, 3);
+  container.advanceHeight(TEST_CONTAINER_CURRENT_HEIGHT);
+
+  auto transfers = visit(0, UNCONFIRMED_TRANSACTION_HEIGHT, ITransfersContainer::IncludeAll, true, 2);
+  ASSERT_EQ(2, transfers.size());
+  ASSERT_EQ(2, transfers[1].amount);
+}
+
+TEST_F(TransfersContainer_getTransfersByHeight, filtersSpentAndUnspent) {
+  auto tx = addTransaction(TEST_BLOCK_HEIGHT, TEST_OUTPUT_AMOUNT);
+  addTransaction(TEST_BLOCK_HEIGHT + 1, TEST_OUTPUT_AMOUNT + 1);
+  container.advanceHeight(TEST_CONTAINER_CURRENT_HEIGHT);
+  addSpendingTransaction(tx->getTransactionHash(), TEST_CONTAINER_CURRENT_HEIGHT + 1, TEST_TRANSACTION_OUTPUT_GLOBAL_INDEX + 1);
+
+  auto transfers = visit(0, TEST_BLOCK_HEIGHT + 1, ITransfersContainer::IncludeTypeAll, true);
+  ASSERT_EQ(1, transfers.size());
+  ASSERT_EQ(TEST_OUTPUT_AMOUNT, transfers[0].amount);
+  ASSERT_TRUE(transfers[0].spent);
+
+  transfers = visit(0, TEST_BLOCK_HEIGHT + 1, ITransfersContainer::IncludeAll, false);
+  ASSERT_EQ(1, transfers.size());
+  ASSERT_EQ(TEST_OUTPUT_AMOUNT + 1, transfers[0].amount);
+  ASSERT_FALSE(transfers[0].spent);
+}
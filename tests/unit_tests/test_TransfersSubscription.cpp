@@ -154,3 +154,19 @@ TEST_F(TransfersSubscriptionTest, deleteUnconfirmedTransaction) {
   ASSERT_EQ(1, observer.deleted.size());
   ASSERT_EQ(txHash, observer.deleted[0]);
 }
+
+TEST_F(TransfersSubscriptionTest, keyImagesCacheSurvivesDetach) {
+  auto tx = addTransaction(10000, 1, 0);
+  auto txPublicKey = tx->getTransactionPublicKey();
+  KeyImage keyImage;
+  keyImage.fill(7);
+  sub.cacheKeyImages(txPublicKey, { std::make_pair(uint32_t(0), keyImage) });
+
+  sub.onBlockchainDetach(0);
+
+  auto cached = sub.getCachedKeyImages(txPublicKey);
+  ASSERT_EQ(1, cached.size());
+  ASSERT_EQ(0, cached[0].first);
+  ASSERT_EQ(keyImage, cached[0].second);
+  ASSERT_TRUE(sub.getCachedKeyImages(PublicKey()).empty());
+}
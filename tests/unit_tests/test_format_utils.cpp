@@ -17,11 +17,13 @@
 
 #include "gtest/gtest.h"
 
+#include <random>
 #include <vector>
 
 // epee
 #include "misc_language.h"
 
+#include "Common/ThreadPool.h"
 #include "Common/util.h"
 #include "cryptonote_core/account.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
@@ -153,6 +155,147 @@ TEST(parse_and_validate_tx_extra, fails_on_wrong_size_in_extra_nonce)
   std::vector<CryptoNote::tx_extra_field> tx_extra_fields;
   ASSERT_FALSE(CryptoNote::parse_tx_extra(tx.extra, tx_extra_fields));
 }
+namespace
+{
+  void check_extra_index_matches_parse(const std::vector<uint8_t>& extra)
+  {
+    std::vector<CryptoNote::tx_extra_field> tx_extra_fields;
+    bool parsed = CryptoNote::parse_tx_extra(extra, tx_extra_fields);
+    CryptoNote::TransactionExtraIndex index(extra);
+    ASSERT_EQ(parsed, index.valid());
+
+    CryptoNote::tx_extra_pub_key pub_key_field;
+    crypto::public_key pub_key;
+    ASSERT_EQ(CryptoNote::find_tx_extra_field_by_type(tx_extra_fields, pub_key_field), index.getPublicKey(pub_key));
+    if (index.getPublicKey(pub_key))
+      ASSERT_EQ(pub_key_field.pub_key, pub_key);
+
+    CryptoNote::tx_extra_nonce nonce_field;
+    CryptoNote::blobdata nonce;
+    ASSERT_EQ(CryptoNote::find_tx_extra_field_by_type(tx_extra_fields, nonce_field), index.getNonce(nonce));
+    if (index.getNonce(nonce))
+      ASSERT_EQ(nonce_field.nonce, nonce);
+
+    CryptoNote::tx_extra_merge_mining_tag mm_tag_field;
+    CryptoNote::tx_extra_merge_mining_tag mm_tag;
+    ASSERT_EQ(CryptoNote::find_tx_extra_field_by_type(tx_extra_fields, mm_tag_field), index.getMergeMiningTag(mm_tag));
+    if (index.getMergeMiningTag(mm_tag))
+    {
+      ASSERT_EQ(mm_tag_field.depth, mm_tag.depth);
+      ASSERT_EQ(mm_tag_field.merkle_root, mm_tag.merkle_root);
+    }
+  }
+}
+
+TEST(TransactionExtraIndex, finds_fields_parse_tx_extra_finds)
+{
+  crypto::hash payment_id = crypto::cn_fast_hash("payment id", 10);
+  CryptoNote::blobdata payment_id_nonce;
+  CryptoNote::set_payment_id_to_tx_extra_nonce(payment_id_nonce, payment_id);
+
+  CryptoNote::Transaction tx = AUTO_VAL_INIT(tx);
+  CryptoNote::add_tx_pub_key_to_extra(tx, CryptoNote::KeyPair::generate().pub);
+  ASSERT_TRUE(CryptoNote::add_extra_nonce_to_tx_extra(tx.extra, payment_id_nonce));
+  CryptoNote::tx_extra_merge_mining_tag mm_tag;
+  mm_tag.depth = 300;
+  mm_tag.merkle_root = crypto::cn_fast_hash("merkle root", 11);
+  ASSERT_TRUE(CryptoNote::append_mm_tag_to_extra(tx.extra, mm_tag));
+  tx.extra.resize(tx.extra.size() + 10, 0);
+
+  ASSERT_NO_FATAL_FAILURE(check_extra_index_matches_parse(tx.extra));
+
+  CryptoNote::TransactionExtraIndex index(tx.extra);
+  crypto::hash found_payment_id;
+  ASSERT_TRUE(index.getPaymentId(found_payment_id));
+  ASSERT_EQ(payment_id, found_payment_id);
+  ASSERT_TRUE(CryptoNote::getPaymentIdFromTxExtra(tx.extra, found_payment_id));
+  ASSERT_EQ(payment_id, found_payment_id);
+  CryptoNote::tx_extra_merge_mining_tag found_mm_tag;
+  ASSERT_TRUE(CryptoNote::get_mm_tag_from_extra(tx.extra, found_mm_tag));
+  ASSERT_EQ(mm_tag.depth, found_mm_tag.depth);
+  ASSERT_EQ(mm_tag.merkle_root, found_mm_tag.merkle_root);
+
+  // every truncation of valid extra, fields before the cut are still served
+  for (size_t size = 0; size < tx.extra.size(); ++size)
+  {
+    std::vector<uint8_t> truncated(tx.extra.begin(), tx.extra.begin() + size);
+    ASSERT_NO_FATAL_FAILURE(check_extra_index_matches_parse(truncated));
+  }
+}
+
+TEST(TransactionExtraIndex, agrees_with_parse_tx_extra_on_random_extra)
+{
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  for (size_t i = 0; i < 20000; ++i)
+  {
+    std::vector<uint8_t> extra(generator() % 80);
+    for (uint8_t& byte : extra)
+    {
+      // mostly small values, so tags and sizes are often meaningful
+      byte = static_cast<uint8_t>(generator() % 2 == 0 ? generator() % 4 : byte_distribution(generator));
+    }
+
+    ASSERT_NO_FATAL_FAILURE(check_extra_index_matches_parse(extra));
+  }
+}
+
+TEST(construct_tx, signs_inputs_on_pool_in_order)
+{
+  Logging::LoggerGroup logger;
+  CryptoNote::Currency currency = CryptoNote::CurrencyBuilder(logger).currency();
+  CryptoNote::account_base sender;
+  sender.generate();
+  CryptoNote::account_base decoy;
+  decoy.generate();
+
+  const size_t inputCount = 4;
+  std::vector<CryptoNote::tx_source_entry> sources;
+  uint64_t inputsAmount = 0;
+  for (size_t i = 0; i < inputCount; ++i) {
+    CryptoNote::Transaction realTx;
+    CryptoNote::Transaction decoyTx;
+    ASSERT_TRUE(currency.constructMinerTx(0, 0, 0, 2, 0, sender.get_keys().m_account_address, realTx));
+    ASSERT_TRUE(currency.constructMinerTx(0, 0, 0, 2, 0, decoy.get_keys().m_account_address, decoyTx));
+
+    CryptoNote::tx_source_entry source;
+    source.amount = realTx.vout[0].amount;
+    source.outputs.push_back(std::make_pair(2 * i, boost::get<CryptoNote::TransactionOutputToKey>(decoyTx.vout[0].target).key));
+    source.outputs.push_back(std::make_pair(2 * i + 1, boost::get<CryptoNote::TransactionOutputToKey>(realTx.vout[0].target).key));
+    source.real_output = 1;
+    source.real_out_tx_key = CryptoNote::get_tx_pub_key_from_extra(realTx);
+    source.real_output_in_tx_index = 0;
+    sources.push_back(source);
+    inputsAmount += source.amount;
+  }
+
+  std::vector<CryptoNote::tx_destination_entry> destinations;
+  destinations.push_back(CryptoNote::tx_destination_entry(inputsAmount, decoy.get_keys().m_account_address));
+
+  Common::ThreadPool pool(2);
+  CryptoNote::Transaction tx;
+  ASSERT_TRUE(CryptoNote::construct_tx(sender.get_keys(), sources, destinations, std::vector<uint8_t>(), tx, 0, logger, &pool));
+  ASSERT_EQ(inputCount, tx.vin.size());
+  ASSERT_EQ(inputCount, tx.signatures.size());
+
+  crypto::hash prefixHash = CryptoNote::get_transaction_prefix_hash(tx);
+  for (size_t i = 0; i < inputCount; ++i) {
+    CryptoNote::KeyPair ephemeral;
+    crypto::key_image keyImage;
+    ASSERT_TRUE(CryptoNote::generate_key_image_helper(sender.get_keys(), sources[i].real_out_tx_key, 0, ephemeral, keyImage));
+
+    const CryptoNote::TransactionInputToKey& input = boost::get<CryptoNote::TransactionInputToKey>(tx.vin[i]);
+    ASSERT_EQ(keyImage, input.keyImage);
+
+    std::vector<const crypto::public_key*> keys;
+    for (const auto& output : sources[i].outputs) {
+      keys.push_back(&output.second);
+    }
+
+    ASSERT_TRUE(crypto::check_ring_signature(prefixHash, input.keyImage, keys, tx.signatures[i].data()));
+  }
+}
+
 TEST(validate_parse_amount_case, validate_parse_amount)
 {
   Logging::LoggerGroup logger;
@@ -139,6 +139,34 @@ TEST_F(InProcessNode, getTransactionOutsGlobalIndicesFailure) {
   ASSERT_NE(std::error_code(), status.getStatus());
 }
 
+TEST_F(InProcessNode, getTransactionsOutsGlobalIndicesSuccess) {
+  std::vector<std::vector<uint64_t>> indices;
+  std::vector<uint64_t> expectedIndices;
+
+  uint64_t start = 10;
+  std::generate_n(std::back_inserter(expectedIndices), 5, [&start] () { return start++; });
+  coreStub.set_outputs_gindexs(expectedIndices, true);
+
+  CallbackStatus status;
+  node.getTransactionsOutsGlobalIndices(std::vector<crypto::hash>(3), indices, [&status] (std::error_code ec) { status.setStatus(ec); });
+  ASSERT_TRUE(status.ok());
+
+  ASSERT_EQ(3, indices.size());
+  for (auto& txIndices : indices) {
+    ASSERT_EQ(expectedIndices, txIndices);
+  }
+}
+
+TEST_F(InProcessNode, getTransactionsOutsGlobalIndicesFailure) {
+  std::vector<std::vector<uint64_t>> indices;
+  coreStub.set_outputs_gindexs(std::vector<uint64_t>(), false);
+
+  CallbackStatus status;
+  node.getTransactionsOutsGlobalIndices(std::vector<crypto::hash>(2), indices, [&status] (std::error_code ec) { status.setStatus(ec); });
+  ASSERT_TRUE(status.wait());
+  ASSERT_NE(std::error_code(), status.getStatus());
+}
+
 TEST_F(InProcessNode, getRandomOutsByAmountsSuccess) {
   crypto::public_key ignoredPublicKey;
   crypto::secret_key ignoredSectetKey;
@@ -282,6 +310,45 @@ TEST_F(InProcessNode, getLastLocalBlockTimestampError) {
   ASSERT_THROW(newNode.getLastLocalBlockTimestamp(), std::exception);
 }
 
+TEST_F(InProcessNode, interactiveRequestIsNotDelayedBySyncQuery) {
+  class BlockingQueryCore : public ICoreStub {
+  public:
+    virtual bool queryBlocksParsed(const std::list<crypto::hash>& block_ids, uint64_t timestamp,
+        uint64_t& start_height, uint64_t& current_height, uint64_t& full_offset, std::list<CryptoNote::BlockParsedInfo>& entries) override {
+      queryStarted.notify();
+      queryReleased.wait();
+      return false;
+    }
+
+    EventWaiter queryStarted;
+    EventWaiter queryReleased;
+  };
+
+  BlockingQueryCore core;
+  core.set_outputs_gindexs({ 1, 2, 3 }, true);
+  CryptoNote::InProcessNode newNode(core, protocolQueryStub);
+
+  CallbackStatus initStatus;
+  newNode.init([&initStatus] (std::error_code ec) { initStatus.setStatus(ec); });
+  ASSERT_TRUE(initStatus.wait());
+
+  std::list<CryptoNote::BlockCompleteEntry> newBlocks;
+  uint64_t startHeight;
+  CallbackStatus queryStatus;
+  newNode.queryBlocks({}, 0, newBlocks, startHeight, [&queryStatus] (std::error_code ec) { queryStatus.setStatus(ec); });
+  ASSERT_TRUE(core.queryStarted.wait_for(std::chrono::milliseconds(3000)));
+
+  std::vector<uint64_t> indices;
+  CallbackStatus indicesStatus;
+  newNode.getTransactionOutsGlobalIndices(crypto::hash(), indices, [&indicesStatus] (std::error_code ec) { indicesStatus.setStatus(ec); });
+  bool indicesReceived = indicesStatus.ok();
+
+  core.queryReleased.notify();
+  ASSERT_TRUE(queryStatus.wait());
+  ASSERT_TRUE(indicesReceived);
+  ASSERT_EQ(3, indices.size());
+}
+
 //TODO: make relayTransaction unit test
 //TODO: make getNewBlocks unit test
 //TODO: make queryBlocks unit test
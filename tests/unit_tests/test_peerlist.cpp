@@ -75,3 +75,82 @@ TEST(peer_list, merge_peer_lists)
 
 
 }
+
+TEST(peer_list, peers_by_index_are_sorted_by_last_seen)
+{
+  peerlist_manager plm;
+  plm.init(false);
+
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,1), 8080, 1, 300);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,2), 8080, 2, 100);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,3), 8080, 3, 200);
+  // update moves the entry
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,2), 8080, 2, 400);
+
+  peerlist_entry pe;
+  ASSERT_TRUE(plm.get_white_peer_by_index(pe, 0));
+  ASSERT_EQ(2, pe.id);
+  ASSERT_TRUE(plm.get_white_peer_by_index(pe, 2));
+  ASSERT_EQ(3, pe.id);
+  ASSERT_FALSE(plm.get_white_peer_by_index(pe, 3));
+
+  std::list<peerlist_entry> outer_bs;
+  for (uint32_t i = 0; i < CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT + 10; ++i) {
+    peerlist_entry ple;
+    uint32_t high = (i >> 8) & 0xff;
+    uint32_t low = i & 0xff;
+    ple.adr.ip = MAKE_IP(123, 44, high, low);
+    ple.adr.port = 8080;
+    ple.id = i;
+    ple.last_seen = i;
+    outer_bs.push_back(ple);
+  }
+
+  ASSERT_TRUE(plm.merge_peerlist(outer_bs, 1000));
+  ASSERT_EQ(CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT, plm.get_gray_peers_count());
+  ASSERT_TRUE(plm.get_gray_peer_by_index(pe, 0));
+  ASSERT_EQ(CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT + 9, pe.id);
+  ASSERT_EQ(CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT + 1009, pe.last_seen);
+  ASSERT_TRUE(plm.get_gray_peer_by_index(pe, CryptoNote::P2P_LOCAL_GRAY_PEERLIST_LIMIT - 1));
+  ASSERT_EQ(10, pe.id);
+}
+
+TEST(peer_list, performance_records)
+{
+  peerlist_manager plm;
+  plm.init(false);
+
+  net_address adr;
+  adr.ip = MAKE_IP(123,43,12,1);
+  adr.port = 8080;
+  ASSERT_FALSE(plm.get_peer_performance(adr).measured());
+
+  plm.set_peer_connected(adr, std::chrono::milliseconds(40));
+  plm.set_peer_transfer_speed(adr, 1000000);
+  plm.set_peer_connection_failed(adr);
+
+  PeerPerformance performance = plm.get_peer_performance(adr);
+  ASSERT_EQ(40000, performance.connectTime());
+  ASSERT_EQ(1000000, performance.bytesPerSecond());
+  ASSERT_EQ(2, performance.attempts());
+  ASSERT_EQ(1, performance.failures());
+}
+
+TEST(peer_list, peerlist_head_since)
+{
+  peerlist_manager plm;
+  plm.init(false);
+
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,1), 8080, 1, 100);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,2), 8080, 2, 200);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,3), 8080, 3, 300);
+
+  std::list<peerlist_entry> bs_head;
+  ASSERT_TRUE(plm.get_peerlist_head(bs_head, 100, 200));
+  ASSERT_EQ(2, bs_head.size());
+  ASSERT_EQ(3, bs_head.front().id);
+
+  bs_head.clear();
+  ASSERT_TRUE(plm.get_peerlist_head(bs_head, 100, 301));
+  ASSERT_TRUE(bs_head.empty());
+}
@@ -20,6 +20,9 @@
 #include <future>
 #include <chrono>
 #include <array>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 
 #include "EventWaiter.h"
 #include "INode.h"
@@ -112,6 +115,27 @@ struct SaveOnInitWalletObserver: public CryptoNote::IWalletObserver {
   std::stringstream stream;
 };
 
+// collects completions of several transactions sent at once
+class BatchSendWalletObserver : public CryptoNote::IWalletObserver {
+public:
+  virtual void sendTransactionCompleted(CryptoNote::TransactionId transactionId, std::error_code result) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    results[transactionId] = result;
+    completed.notify_all();
+  }
+
+  bool waitForSendEnd(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return completed.wait_for(lock, std::chrono::milliseconds(5000), [this, count] { return results.size() >= count; });
+  }
+
+  std::map<CryptoNote::TransactionId, std::error_code> results;
+
+private:
+  std::mutex mutex;
+  std::condition_variable completed;
+};
+
 static const uint64_t TEST_BLOCK_REWARD = 70368744177663;
 
 CryptoNote::TransactionId TransferMoney(CryptoNote::Wallet& from, CryptoNote::Wallet& to, int64_t amount, uint64_t fee, uint64_t mixIn = 0, const std::string& extra = "") {
@@ -624,6 +648,80 @@ TEST_F(WalletApi, getTransactionFailure) {
   alice->shutdown();
 }
 
+TEST_F(WalletApi, getTransactionsByHeight) {
+  alice->initAndGenerate("pass");
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(aliceWalletObserver.get()));
+
+  ASSERT_NO_FATAL_FAILURE(GetOneBlockReward(*alice));
+  generator.generateEmptyBlocks(5);
+  ASSERT_NO_FATAL_FAILURE(GetOneBlockReward(*alice));
+
+  aliceNode->updateObservers();
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(aliceWalletObserver.get()));
+
+  auto all = alice->getTransactionsByHeight(0, CryptoNote::UNCONFIRMED_TRANSACTION_HEIGHT, 0, 10);
+  ASSERT_EQ(2, all.size());
+
+  CryptoNote::TransactionInfo first;
+  CryptoNote::TransactionInfo second;
+  ASSERT_TRUE(alice->getTransaction(all[0], first));
+  ASSERT_TRUE(alice->getTransaction(all[1], second));
+  ASSERT_LT(first.blockHeight, second.blockHeight);
+
+  auto page = alice->getTransactionsByHeight(0, CryptoNote::UNCONFIRMED_TRANSACTION_HEIGHT, 1, 10);
+  ASSERT_EQ(1, page.size());
+  EXPECT_EQ(all[1], page[0]);
+
+  page = alice->getTransactionsByHeight(0, CryptoNote::UNCONFIRMED_TRANSACTION_HEIGHT, 0, 1);
+  ASSERT_EQ(1, page.size());
+  EXPECT_EQ(all[0], page[0]);
+
+  page = alice->getTransactionsByHeight(first.blockHeight + 1, second.blockHeight, 0, 10);
+  ASSERT_EQ(1, page.size());
+  EXPECT_EQ(all[1], page[0]);
+
+  EXPECT_TRUE(alice->getTransactionsByHeight(first.blockHeight + 1, second.blockHeight - 1, 0, 10).empty());
+
+  alice->shutdown();
+}
+
+TEST_F(WalletApi, walletsShareSynchronizer) {
+  CryptoNote::WalletSynchronizer sync(m_currency, *aliceNode);
+
+  TrivialWalletObserver firstObserver;
+  CryptoNote::Wallet first(m_currency, *aliceNode, sync);
+  first.addObserver(&firstObserver);
+
+  TrivialWalletObserver secondObserver;
+  CryptoNote::Wallet second(m_currency, *aliceNode, sync);
+  second.addObserver(&secondObserver);
+
+  first.initAndGenerate("pass");
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(&firstObserver));
+  second.initAndGenerate("pass");
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(&secondObserver));
+
+  ASSERT_NO_FATAL_FAILURE(GetOneBlockReward(first));
+  ASSERT_NO_FATAL_FAILURE(GetOneBlockReward(second));
+  aliceNode->updateObservers();
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(&firstObserver));
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(&secondObserver));
+
+  EXPECT_EQ(TEST_BLOCK_REWARD, first.pendingBalance());
+  EXPECT_EQ(TEST_BLOCK_REWARD, second.pendingBalance());
+
+  // the other wallet goes on synchronizing
+  first.shutdown();
+
+  ASSERT_NO_FATAL_FAILURE(GetOneBlockReward(second));
+  aliceNode->updateObservers();
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(&secondObserver));
+
+  EXPECT_EQ(2 * TEST_BLOCK_REWARD, second.pendingBalance());
+
+  second.shutdown();
+}
+
 TEST_F(WalletApi, useNotInitializedObject) {
   EXPECT_THROW(alice->pendingBalance(), std::system_error);
   EXPECT_THROW(alice->actualBalance(), std::system_error);
@@ -948,6 +1046,65 @@ TEST_F(WalletApi, sendSeveralTransactions) {
   EXPECT_EQ(aliceBalance - transactionCount * (sendAmount + m_currency.minimumFee()), aliceTotalBalance);
 }
 
+TEST_F(WalletApi, sendTransactionsAtOnce) {
+  alice->initAndGenerate("pass");
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(aliceWalletObserver.get()));
+
+  prepareBobWallet();
+  bob->initAndGenerate("pass");
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(bobWalletObserver.get()));
+
+  for (int i = 0; i < 5; ++i) {
+    GetOneBlockReward(*alice);
+  }
+
+  generator.generateEmptyBlocks(10);
+
+  aliceNode->updateObservers();
+  ASSERT_NO_FATAL_FAILURE(WaitWalletSync(aliceWalletObserver.get()));
+
+  auto aliceBalance = alice->actualBalance();
+
+  const uint64_t sendAmount = 100000;
+  const size_t transactionCount = 3;
+
+  std::vector<CryptoNote::TransactionParameters> transactions;
+  for (size_t i = 0; i < transactionCount; ++i) {
+    CryptoNote::TransactionParameters parameters;
+    parameters.transfers.push_back({ bob->getAddress(), static_cast<int64_t>(sendAmount) });
+    parameters.fee = m_currency.minimumFee();
+    parameters.mixIn = i % 2;
+    parameters.unlockTimestamp = 0;
+    transactions.push_back(parameters);
+  }
+
+  BatchSendWalletObserver batchObserver;
+  alice->addObserver(&batchObserver);
+
+  auto txIds = alice->sendTransactions(transactions);
+  ASSERT_EQ(transactionCount, txIds.size());
+  bool sent = batchObserver.waitForSendEnd(transactionCount);
+  alice->removeObserver(&batchObserver);
+  ASSERT_TRUE(sent);
+
+  for (auto txId : txIds) {
+    EXPECT_EQ(std::error_code(), batchObserver.results[txId]);
+  }
+
+  generator.generateEmptyBlocks(10);
+
+  bobNode->updateObservers();
+
+  while (transactionCount * sendAmount != bob->actualBalance()) {
+    ASSERT_NO_FATAL_FAILURE(WaitWalletSync(bobWalletObserver.get()));
+  }
+
+  EXPECT_EQ(transactionCount, bob->getTransactionCount());
+
+  uint64_t aliceTotalBalance = alice->actualBalance() + alice->pendingBalance();
+  EXPECT_EQ(aliceBalance - transactionCount * (sendAmount + m_currency.minimumFee()), aliceTotalBalance);
+}
+
 TEST_F(WalletApi, balanceAfterFailedTransaction) {
   alice->initAndGenerate("pass");
   ASSERT_NO_FATAL_FAILURE(WaitWalletSync(aliceWalletObserver.get()));
@@ -1327,3 +1484,43 @@ TEST_F(WalletApi, DISABLED_loadingBrokenCache) {
   ASSERT_NO_FATAL_FAILURE(WaitWalletLoad(aliceWalletObserver.get(), result));
   ASSERT_EQ(result.value(), 0);
 }
+
+namespace {
+
+class TransactionEventsRecorder : public CryptoNote::IWalletObserver {
+public:
+  virtual void externalTransactionCreated(CryptoNote::TransactionId transactionId) override {
+    created.push_back(transactionId);
+  }
+
+  virtual void transactionUpdated(CryptoNote::TransactionId transactionId) override {
+    updated.push_back(transactionId);
+  }
+
+  std::vector<CryptoNote::TransactionId> created;
+  std::vector<CryptoNote::TransactionId> updated;
+};
+
+}
+
+TEST(WalletTransactionsBatchEvent, reportsEachTransactionOnce) {
+  CryptoNote::WalletTransactionsBatchEvent batch;
+  batch.addUpdated(3);
+  batch.addCreated(5);
+  batch.addUpdated(5);
+  batch.addUpdated(3);
+  batch.addCreated(6);
+
+  tools::ObserverManager<CryptoNote::IWalletObserver> observers;
+  TransactionEventsRecorder recorder;
+  observers.add(&recorder);
+  batch.notify(observers);
+
+  ASSERT_EQ(std::vector<CryptoNote::TransactionId>({ 5, 6 }), recorder.created);
+  ASSERT_EQ(std::vector<CryptoNote::TransactionId>({ 3 }), recorder.updated);
+
+  CryptoNote::WalletTransactionsBatchEvent delivered;
+  delivered.swap(batch);
+  ASSERT_TRUE(batch.empty());
+  ASSERT_FALSE(delivered.empty());
+}
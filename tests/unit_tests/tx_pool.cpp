@@ -18,11 +18,17 @@
 #include "gtest/gtest.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <sstream>
 
 #include "cryptonote_core/account.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "cryptonote_core/Currency.h"
 #include "cryptonote_core/tx_pool.h"
+#include "serialization/BinaryInputStreamSerializer.h"
+#include "serialization/BinaryOutputStreamSerializer.h"
 
 #include <Logging/ConsoleLogger.h>
 #include <Logging/LoggerGroup.h>
@@ -32,7 +38,8 @@ using namespace CryptoNote;
 
 class TransactionValidator : public CryptoNote::ITransactionValidator {
   virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) {
-    return true;
+    maxUsedBlock = verifiedBlock;
+    return inputsValid;
   }
 
   virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock, BlockInfo& lastFailed) {
@@ -42,6 +49,50 @@ class TransactionValidator : public CryptoNote::ITransactionValidator {
   virtual bool haveSpentKeyImages(const CryptoNote::Transaction& tx) {
     return false;
   }
+
+public:
+  TransactionValidator() : inputsValid(true) {}
+
+  BlockInfo verifiedBlock;
+  bool inputsValid;
+};
+
+class SwitchableValidator : public TransactionValidator {
+public:
+  SwitchableValidator() : keyImagesSpent(false), checkCount(0) {}
+
+  virtual bool haveSpentKeyImages(const CryptoNote::Transaction& tx) override {
+    ++checkCount;
+    return keyImagesSpent;
+  }
+
+  bool keyImagesSpent;
+  size_t checkCount;
+};
+
+// Lets checks proceed only once the expected number of them is running, or after a timeout
+class ConcurrentValidator : public TransactionValidator {
+public:
+  ConcurrentValidator() : expectedChecks(2), runningChecks(0), allRunning(false), overlapped(false) {}
+
+  virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) override {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (++runningChecks == expectedChecks) {
+      allRunning = true;
+      condition.notify_all();
+    } else {
+      overlapped = condition.wait_for(lock, std::chrono::seconds(5), [this] { return allRunning; });
+    }
+
+    return true;
+  }
+
+  size_t expectedChecks;
+  size_t runningChecks;
+  bool allRunning;
+  bool overlapped;
+  std::mutex mutex;
+  std::condition_variable condition;
 };
 
 class FakeTimeProvider : public ITimeProvider {
@@ -231,6 +282,50 @@ TEST_F(tx_pool, take_tx)
 };
 
 
+TEST_F(tx_pool, take_tx_returns_block_inputs_were_verified_against)
+{
+  TxTestBase test(1);
+  test.validator.verifiedBlock.height = 10;
+  test.validator.verifiedBlock.id = crypto::rand<crypto::hash>();
+
+  Transaction tx;
+  test.construct(test.m_currency.minimumFee(), 1, tx);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(test.pool.add_tx(tx, tvc, false));
+
+  Transaction txOut;
+  size_t blobSize;
+  uint64_t fee = 0;
+  BlockInfo maxUsedBlock;
+  bool signaturesVerified = false;
+  ASSERT_TRUE(test.pool.take_tx(get_transaction_hash(tx), txOut, blobSize, fee, maxUsedBlock, signaturesVerified));
+  ASSERT_EQ(test.validator.verifiedBlock.height, maxUsedBlock.height);
+  ASSERT_EQ(test.validator.verifiedBlock.id, maxUsedBlock.id);
+  ASSERT_TRUE(signaturesVerified);
+}
+
+TEST_F(tx_pool, take_tx_doesnt_report_unverified_signatures)
+{
+  TxTestBase test(1);
+  test.validator.inputsValid = false;
+
+  Transaction tx;
+  test.construct(test.m_currency.minimumFee(), 1, tx);
+
+  // transactions of popped blocks are kept even when their inputs can't be verified
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(test.pool.add_tx(tx, tvc, true));
+
+  Transaction txOut;
+  size_t blobSize;
+  uint64_t fee = 0;
+  BlockInfo maxUsedBlock;
+  bool signaturesVerified = true;
+  ASSERT_TRUE(test.pool.take_tx(get_transaction_hash(tx), txOut, blobSize, fee, maxUsedBlock, signaturesVerified));
+  ASSERT_FALSE(signaturesVerified);
+}
+
 TEST_F(tx_pool, double_spend_tx)
 {
   TxTestBase test(1);
@@ -251,6 +346,49 @@ TEST_F(tx_pool, double_spend_tx)
 }
 
 
+TEST_F(tx_pool, checks_inputs_concurrently_and_rejects_double_spend_when_inserting)
+{
+  TestTransactionGenerator txGenerator(currency, 1);
+  txGenerator.createSources();
+  Transaction tx;
+  Transaction txDouble;
+  txGenerator.construct(txGenerator.m_source_amount, currency.minimumFee(), 1, tx);
+  txGenerator.rv_acc.generate();
+  txGenerator.construct(txGenerator.m_source_amount, currency.minimumFee(), 1, txDouble);
+
+  TestPool<ConcurrentValidator, RealTimeProvider> pool(currency, logger);
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  tx_verification_context tvcDouble = boost::value_initialized<tx_verification_context>();
+  auto added = std::async(std::launch::async, [&] { return pool.add_tx(tx, tvc, false); });
+  bool addedDouble = pool.add_tx(txDouble, tvcDouble, false);
+
+  ASSERT_NE(added.get(), addedDouble);
+  ASSERT_TRUE(pool.validator.overlapped);
+  ASSERT_NE(tvc.m_verifivation_failed, tvcDouble.m_verifivation_failed);
+  ASSERT_EQ(1, pool.get_transactions_count());
+}
+
+TEST_F(tx_pool, same_transaction_added_concurrently_is_accepted_once)
+{
+  TestTransactionGenerator txGenerator(currency, 1);
+  txGenerator.createSources();
+  Transaction tx;
+  txGenerator.construct(txGenerator.m_source_amount, currency.minimumFee(), 1, tx);
+
+  TestPool<ConcurrentValidator, RealTimeProvider> pool(currency, logger);
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  tx_verification_context tvcOther = boost::value_initialized<tx_verification_context>();
+  auto added = std::async(std::launch::async, [&] { return pool.add_tx(tx, tvc, false); });
+  ASSERT_TRUE(pool.add_tx(tx, tvcOther, false));
+  ASSERT_TRUE(added.get());
+
+  ASSERT_TRUE(pool.validator.overlapped);
+  ASSERT_FALSE(tvc.m_verifivation_failed);
+  ASSERT_FALSE(tvcOther.m_verifivation_failed);
+  ASSERT_NE(tvc.m_added_to_pool, tvcOther.m_added_to_pool);
+  ASSERT_EQ(1, pool.get_transactions_count());
+}
+
 TEST_F(tx_pool, fillblock_same_fee)
 {
   TestPool<TransactionValidator, RealTimeProvider> pool(currency, logger);
@@ -433,3 +571,262 @@ TEST_F(tx_pool, add_tx_after_cleanup)
   ASSERT_EQ(1, pool.get_transactions_count());
 
 }
+
+TEST_F(tx_pool, cleanup_stale_tx_restored_from_file)
+{
+  TestPool<TransactionValidator, FakeTimeProvider> pool(currency, logger);
+  const uint64_t fee = currency.minimumFee();
+  time_t startTime = pool.timeProvider.now();
+
+  Transaction tx;
+  GenerateTransaction(currency, tx, fee, 1);
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(tx, tvc, false));
+
+  std::stringstream stream;
+  BinaryOutputStreamSerializer output(stream);
+  output(static_cast<tx_memory_pool&>(pool), "pool");
+
+  TestPool<TransactionValidator, FakeTimeProvider> restored(currency, logger);
+  BinaryInputStreamSerializer input(stream);
+  input(static_cast<tx_memory_pool&>(restored), "pool");
+  ASSERT_EQ(1, restored.get_transactions_count());
+
+  restored.timeProvider.timeNow = startTime + currency.mempoolTxLiveTime() - 1;
+  restored.on_idle();
+  ASSERT_EQ(1, restored.get_transactions_count());
+
+  restored.timeProvider.timeNow = startTime + currency.mempoolTxLiveTime() + 60 * 60;
+  restored.on_idle();
+  ASSERT_EQ(0, restored.get_transactions_count());
+}
+
+TEST_F(tx_pool, fillblock_rechecks_transactions_after_blockchain_change)
+{
+  TestPool<SwitchableValidator, RealTimeProvider> pool(currency, logger);
+
+  Transaction tx;
+  GenerateTransaction(currency, tx, currency.minimumFee(), 1);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(tx, tvc, false));
+
+  Block bl;
+  InitBlock(bl);
+  size_t totalSize = 0;
+  uint64_t txFee = 0;
+
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(1, bl.txHashes.size());
+
+  // readiness is rechecked only when blockchain changes
+  pool.validator.keyImagesSpent = true;
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(1, bl.txHashes.size());
+
+  pool.on_blockchain_inc(1, null_hash, std::vector<crypto::key_image>{ boost::get<TransactionInputToKey>(tx.vin[0]).keyImage });
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(0, bl.txHashes.size());
+  ASSERT_EQ(0, txFee);
+
+  pool.validator.keyImagesSpent = false;
+  pool.on_blockchain_dec(0, null_hash);
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(1, bl.txHashes.size());
+}
+
+TEST_F(tx_pool, fillblock_rechecks_only_transactions_affected_by_blockchain_change)
+{
+  TestPool<SwitchableValidator, RealTimeProvider> pool(currency, logger);
+
+  Transaction tx1, tx2;
+  GenerateTransaction(currency, tx1, currency.minimumFee(), 1);
+  GenerateTransaction(currency, tx2, currency.minimumFee(), 1);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(tx1, tvc, false));
+  ASSERT_TRUE(pool.add_tx(tx2, tvc, false));
+
+  Block bl;
+  InitBlock(bl);
+  size_t totalSize = 0;
+  uint64_t txFee = 0;
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(2, bl.txHashes.size());
+
+  // block spending key image of tx1 makes only tx1 checked again
+  pool.validator.checkCount = 0;
+  pool.on_blockchain_inc(1, null_hash, std::vector<crypto::key_image>{ boost::get<TransactionInputToKey>(tx1.vin[0]).keyImage });
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(1, pool.validator.checkCount);
+  ASSERT_EQ(2, bl.txHashes.size());
+
+  // block spending nothing from pool doesn't recheck ready transactions
+  pool.validator.checkCount = 0;
+  pool.on_blockchain_inc(2, null_hash, std::vector<crypto::key_image>());
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(0, pool.validator.checkCount);
+
+  // popping blocks used by ready transactions rechecks them
+  pool.on_blockchain_dec(0, null_hash);
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(2, pool.validator.checkCount);
+}
+
+TEST_F(tx_pool, fillblock_keeps_readiness_checked_on_the_same_tail)
+{
+  TestPool<SwitchableValidator, RealTimeProvider> pool(currency, logger);
+
+  crypto::hash tail = crypto::rand<crypto::hash>();
+  crypto::hash pushed = crypto::rand<crypto::hash>();
+  pool.on_blockchain_inc(1, tail, std::vector<crypto::key_image>());
+
+  Transaction tx1, tx2;
+  GenerateTransaction(currency, tx1, currency.minimumFee(), 1);
+  GenerateTransaction(currency, tx2, currency.minimumFee(), 1);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(tx1, tvc, false));
+
+  Block bl;
+  InitBlock(bl);
+  size_t totalSize = 0;
+  uint64_t txFee = 0;
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(1, bl.txHashes.size());
+
+  // block pushed and popped, only transaction added meanwhile is checked
+  pool.on_blockchain_inc(2, pushed, std::vector<crypto::key_image>());
+  ASSERT_TRUE(pool.add_tx(tx2, tvc, false));
+  pool.on_blockchain_dec(1, tail);
+
+  pool.validator.checkCount = 0;
+  ASSERT_TRUE(pool.fill_block_template(bl, 5000, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(1, pool.validator.checkCount);
+  ASSERT_EQ(2, bl.txHashes.size());
+}
+
+TEST_F(tx_pool, get_changes_returns_ready_transactions_changed_since_version)
+{
+  TestPool<SwitchableValidator, RealTimeProvider> pool(currency, logger);
+
+  Transaction tx1, tx2;
+  GenerateTransaction(currency, tx1, currency.minimumFee(), 1);
+  GenerateTransaction(currency, tx2, currency.minimumFee(), 1);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(tx1, tvc, false));
+
+  std::vector<crypto::hash> added;
+  std::vector<crypto::hash> deleted;
+  uint64_t version1 = 0;
+  ASSERT_TRUE(pool.get_changes(0, added, deleted, version1));
+  ASSERT_EQ(std::vector<crypto::hash>{ get_transaction_hash(tx1) }, added);
+  ASSERT_TRUE(deleted.empty());
+
+  // a transaction added and removed between two requests isn't reported
+  ASSERT_TRUE(pool.add_tx(tx2, tvc, false));
+  pool.validator.keyImagesSpent = true;
+  pool.on_blockchain_inc(1, null_hash, std::vector<crypto::key_image>{
+    boost::get<TransactionInputToKey>(tx1.vin[0]).keyImage, boost::get<TransactionInputToKey>(tx2.vin[0]).keyImage });
+
+  added.clear();
+  uint64_t version2 = 0;
+  ASSERT_TRUE(pool.get_changes(version1, added, deleted, version2));
+  ASSERT_TRUE(added.empty());
+  ASSERT_EQ(std::vector<crypto::hash>{ get_transaction_hash(tx1) }, deleted);
+  ASSERT_GT(version2, version1);
+
+  deleted.clear();
+  uint64_t version3 = 0;
+  ASSERT_TRUE(pool.get_changes(version2, added, deleted, version3));
+  ASSERT_TRUE(added.empty());
+  ASSERT_TRUE(deleted.empty());
+  ASSERT_EQ(version2, version3);
+
+  ASSERT_FALSE(pool.get_changes(version3 + 1, added, deleted, version3));
+}
+
+namespace {
+  class EvictionObserver : public ITxPoolObserver {
+  public:
+    virtual void txDeletedFromPool() override {
+    }
+
+    virtual void txsEvictedFromPool(const std::vector<crypto::hash>& transactionIds) override {
+      evicted.insert(evicted.end(), transactionIds.begin(), transactionIds.end());
+    }
+
+    std::vector<crypto::hash> evicted;
+  };
+}
+
+TEST_F(tx_pool, evicts_lowest_fee_transactions_when_full)
+{
+  TestPool<TransactionValidator, RealTimeProvider> pool(currency, logger);
+  EvictionObserver observer;
+  pool.addObserver(&observer);
+  pool.setSizeLimits(2, 0);
+
+  const uint64_t fee = currency.minimumFee();
+  Transaction lowFeeTx, middleFeeTx, highFeeTx, lowestFeeTx;
+  GenerateTransaction(currency, middleFeeTx, fee * 2, 1);
+  GenerateTransaction(currency, lowFeeTx, fee, 1);
+  GenerateTransaction(currency, highFeeTx, fee * 3, 1);
+  GenerateTransaction(currency, lowestFeeTx, fee, 2);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(middleFeeTx, tvc, false));
+  ASSERT_TRUE(pool.add_tx(lowFeeTx, tvc, false));
+  ASSERT_TRUE(observer.evicted.empty());
+
+  ASSERT_TRUE(pool.add_tx(highFeeTx, tvc, false));
+  ASSERT_EQ(2, pool.get_transactions_count());
+  ASSERT_EQ(1, observer.evicted.size());
+  ASSERT_EQ(get_transaction_hash(lowFeeTx), observer.evicted[0]);
+  ASSERT_FALSE(pool.have_tx(get_transaction_hash(lowFeeTx)));
+
+  // new transaction paying less than everything in pool is not added
+  tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_FALSE(pool.add_tx(lowestFeeTx, tvc, false));
+  ASSERT_FALSE(tvc.m_verifivation_failed);
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_TRUE(tvc.m_tx_fee_too_small);
+  ASSERT_EQ(2, pool.get_transactions_count());
+  ASSERT_TRUE(pool.have_tx(get_transaction_hash(middleFeeTx)));
+  ASSERT_TRUE(pool.have_tx(get_transaction_hash(highFeeTx)));
+}
+
+TEST_F(tx_pool, serialization_restores_transactions_and_spent_inputs)
+{
+  TxTestBase test(1);
+  Transaction tx, tx_double;
+  test.construct(test.m_currency.minimumFee(), 1, tx);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(test.pool.add_tx(tx, tvc, false));
+
+  std::stringstream stream;
+  BinaryOutputStreamSerializer output(stream);
+  output(test.pool, "pool");
+
+  tx_memory_pool restored(test.m_currency, test.validator, test.m_time, test.m_logger);
+  BinaryInputStreamSerializer input(stream);
+  input(restored, "pool");
+
+  ASSERT_EQ(1, restored.get_transactions_count());
+  ASSERT_TRUE(restored.have_tx(get_transaction_hash(tx)));
+
+  Transaction txOut;
+  size_t blobSize;
+  uint64_t fee = 0;
+  ASSERT_TRUE(restored.take_tx(get_transaction_hash(tx), txOut, blobSize, fee));
+  ASSERT_EQ(tx, txOut);
+  ASSERT_EQ(test.m_currency.minimumFee(), fee);
+  ASSERT_TRUE(restored.add_tx(tx, tvc, false));
+
+  test.txGenerator.rv_acc.generate();
+  test.construct(test.m_currency.minimumFee(), 1, tx_double);
+  ASSERT_FALSE(restored.add_tx(tx_double, tvc, false));
+  ASSERT_TRUE(tvc.m_verifivation_failed);
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2012-2015, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+// Syncs wallets with a generated blockchain through BlockchainSynchronizer and TransfersSyncronizer, the way
+// WalletLegacy does, and measures scanning, memory and saving and loading of the synchronized state.
+
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <Logging/ConsoleLogger.h>
+
+#include "Common/command_line.h"
+#include "transfers/BlockchainSynchronizer.h"
+#include "transfers/TransfersSynchronizer.h"
+
+#include "../unit_tests/INodeStubs.h"
+#include "../unit_tests/TestBlockchainGenerator.h"
+#include "../unit_tests/TransactionApiHelpers.h"
+
+using namespace CryptoNote;
+
+namespace po = boost::program_options;
+
+namespace {
+
+const command_line::arg_descriptor<size_t> argBlocks = { "blocks", "Blocks with outputs to the wallets", 100 };
+const command_line::arg_descriptor<size_t> argOutputs = { "outputs", "Outputs to the wallets in every block", 100 };
+const command_line::arg_descriptor<size_t> argAccounts = { "accounts", "Subscribed accounts", 1 };
+
+typedef std::chrono::steady_clock Clock;
+
+class SyncCompletion : public IBlockchainSynchronizerObserver {
+public:
+  explicit SyncCompletion(BlockchainSynchronizer& sync) : m_sync(sync) {
+    m_sync.addObserver(this);
+  }
+
+  ~SyncCompletion() {
+    m_sync.removeObserver(this);
+  }
+
+  virtual void synchronizationCompleted(std::error_code result) override {
+    decltype(m_completed) detachedPromise = std::move(m_completed);
+    detachedPromise.set_value(result);
+  }
+
+  std::error_code wait() {
+    return m_completed.get_future().get();
+  }
+
+private:
+  BlockchainSynchronizer& m_sync;
+  std::promise<std::error_code> m_completed;
+};
+
+struct Wallets {
+  Wallets(const Currency& currency, INode& node, const std::vector<AccountKeys>& accounts) :
+    sync(node, currency.genesisBlockHash()),
+    transfersSync(currency, sync, node) {
+    for (const AccountKeys& keys : accounts) {
+      AccountSubscription subscription;
+      subscription.keys = keys;
+      subscription.syncStart.timestamp = 0;
+      subscription.syncStart.height = 0;
+      subscription.transactionSpendableAge = 5;
+      transfersSync.addSubscription(subscription);
+    }
+  }
+
+  BlockchainSynchronizer sync;
+  TransfersSyncronizer transfersSync;
+};
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Peak resident memory of the process in kB, 0 where /proc isn't available
+uint64_t readPeakMemory() {
+  uint64_t peakKb = 0;
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    std::istringstream fields(line);
+    std::string name;
+    fields >> name;
+    if (name == "VmHWM:") {
+      fields >> peakKb;
+    }
+  }
+#endif
+  return peakKb;
+}
+
+}
+
+int main(int argc, char** argv) {
+  po::options_description desc("Allowed options");
+  command_line::add_arg(desc, command_line::arg_help);
+  command_line::add_arg(desc, argBlocks);
+  command_line::add_arg(desc, argOutputs);
+  command_line::add_arg(desc, argAccounts);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc, [&]() {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    return true;
+  });
+
+  if (!r) {
+    return 1;
+  }
+
+  if (command_line::get_arg(vm, command_line::arg_help)) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  size_t blocks = command_line::get_arg(vm, argBlocks);
+  size_t outputs = command_line::get_arg(vm, argOutputs);
+  size_t accountCount = command_line::get_arg(vm, argAccounts);
+  if (accountCount == 0) {
+    std::cout << "Benchmark needs at least one account" << std::endl;
+    return 1;
+  }
+
+  Logging::ConsoleLogger logger(Logging::ERROR);
+  Currency currency = CurrencyBuilder(logger).currency();
+  TestBlockchainGenerator generator(currency);
+  INodeTrivialRefreshStub node(generator);
+
+  std::vector<AccountKeys> accounts;
+  std::vector<AccountPublicAddress> addresses;
+  for (size_t i = 0; i < accountCount; ++i) {
+    accounts.push_back(generateAccountKeys());
+    addresses.push_back(reinterpret_cast<const AccountPublicAddress&>(accounts.back().address));
+  }
+
+  std::cout << "Generating " << blocks << " blocks..." << std::endl;
+  for (size_t i = 0; i < blocks; ++i) {
+    if (!generator.generateOutputsInOneBlock(addresses, outputs)) {
+      std::cout << "Failed to generate blockchain" << std::endl;
+      return 1;
+    }
+  }
+
+  uint64_t peakBeforeSync = readPeakMemory();
+  size_t chainSize = generator.getBlockchain().size();
+
+  Wallets wallets(currency, node, accounts);
+  Clock::time_point start = Clock::now();
+  std::error_code result;
+  {
+    SyncCompletion completion(wallets.sync);
+    wallets.sync.start();
+    result = completion.wait();
+  }
+
+  double syncSeconds = secondsSince(start);
+  wallets.sync.stop();
+  if (result) {
+    std::cout << "Synchronization failed: " << result.message() << std::endl;
+    return 1;
+  }
+
+  size_t transfers = 0;
+  for (const AccountKeys& keys : accounts) {
+    transfers += wallets.transfersSync.getSubscription(keys.address)->getContainer().transfersCount();
+  }
+
+  uint64_t peakAfterSync = readPeakMemory();
+
+  std::stringstream state;
+  start = Clock::now();
+  wallets.transfersSync.save(state);
+  double saveSeconds = secondsSince(start);
+  size_t stateSize = state.str().size();
+
+  Wallets loaded(currency, node, accounts);
+  start = Clock::now();
+  loaded.transfersSync.load(state);
+  double loadSeconds = secondsSince(start);
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Wallet sync: " << chainSize << " blocks, " << outputs << " outputs per block, " << accountCount << " accounts" << std::endl;
+  std::cout << "  scan: " << syncSeconds << " sec, " << chainSize / syncSeconds << " blocks/sec, " <<
+    blocks * outputs / syncSeconds << " outputs/sec, " << transfers << " transfers found" << std::endl;
+  std::cout << "  peak memory: " << peakBeforeSync << " kB before sync, " << peakAfterSync << " kB after" << std::endl;
+  std::cout << "  state: " << stateSize << " bytes, save " << saveSeconds * 1000 << " ms, load " << loadSeconds * 1000 << " ms" << std::endl;
+  return 0;
+}